@@ -13,67 +13,207 @@
  *
  */
 
-#include <sstream>
+#include <core/Base64.hpp>
 
-#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <vector>
 
-#include <boost/archive/iterators/base64_from_binary.hpp>
-#include <boost/archive/iterators/transform_width.hpp>
-#include <boost/archive/iterators/ostream_iterator.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <core/Error.hpp>
-#include <core/Log.hpp>
-#include <core/FileSerializer.hpp>
+#include <core/FilePath.hpp>
 
 namespace rstudio {
 namespace core {
 namespace base64 {
 
-Error encode(const std::string& input, std::string* pOutput)
+namespace {
+
+const char kEncodeTable[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 0xFF marks bytes which aren't part of the alphabet
+struct DecodeTable
 {
-   using namespace boost::archive::iterators;
+   DecodeTable()
+   {
+      for (int i = 0; i < 256; i++)
+         values[i] = 0xFF;
+      for (int i = 0; i < 64; i++)
+         values[static_cast<unsigned char>(kEncodeTable[i])] =
+                                          static_cast<boost::uint8_t>(i);
+   }
+
+   boost::uint8_t values[256];
+};
+
+const DecodeTable s_decodeTable;
 
-   try
+// size of the chunks in which streams are read (a multiple of 3 so that
+// chunks encode without padding)
+const std::size_t kStreamChunkSize = 3 * 16384;
+
+// encode the input into out (which must have room for encodedSize(n)
+// characters), returning the end of the encoded output. the input is
+// encoded 3 bytes (one 24 bit group) at a time through a lookup table
+char* encodeInto(const unsigned char* pIn, std::size_t n, char* pOut)
+{
+   const unsigned char* pEnd = pIn + (n - n % 3);
+   for (; pIn < pEnd; pIn += 3)
    {
-      typedef base64_from_binary<transform_width<const char *,6,8> > b64_text;
-      std::stringstream os;
-      std::copy(b64_text(input.c_str()),
-                b64_text(input.c_str() + input.size()),
-                ostream_iterator<char>(os));
-
-      pOutput->clear();
-      pOutput->reserve(((input.size() * 4) / 3) + 3);
-      pOutput->append(os.str());
-
-      std::size_t mod = input.size() % 3;
-      if (mod == 1)
-         pOutput->append("==");
-      else if(mod == 2)
-         pOutput->append("=");
-
-      return Success();
+      boost::uint32_t group = (pIn[0] << 16) | (pIn[1] << 8) | pIn[2];
+      *pOut++ = kEncodeTable[(group >> 18) & 0x3F];
+      *pOut++ = kEncodeTable[(group >> 12) & 0x3F];
+      *pOut++ = kEncodeTable[(group >> 6) & 0x3F];
+      *pOut++ = kEncodeTable[group & 0x3F];
    }
-   CATCH_UNEXPECTED_EXCEPTION
 
-   // keep compiler happy
+   switch (n % 3)
+   {
+   case 1:
+   {
+      boost::uint32_t group = pIn[0] << 16;
+      *pOut++ = kEncodeTable[(group >> 18) & 0x3F];
+      *pOut++ = kEncodeTable[(group >> 12) & 0x3F];
+      *pOut++ = '=';
+      *pOut++ = '=';
+      break;
+   }
+   case 2:
+   {
+      boost::uint32_t group = (pIn[0] << 16) | (pIn[1] << 8);
+      *pOut++ = kEncodeTable[(group >> 18) & 0x3F];
+      *pOut++ = kEncodeTable[(group >> 12) & 0x3F];
+      *pOut++ = kEncodeTable[(group >> 6) & 0x3F];
+      *pOut++ = '=';
+      break;
+   }
+   }
+
+   return pOut;
+}
+
+Error invalidInputError(const ErrorLocation& location)
+{
+   return systemError(boost::system::errc::illegal_byte_sequence, location);
+}
+
+} // anonymous namespace
+
+std::size_t encodedSize(std::size_t size)
+{
+   return ((size + 2) / 3) * 4;
+}
+
+Error encode(const std::string& input, std::string* pOutput)
+{
+   pOutput->resize(encodedSize(input.size()));
+   if (!input.empty())
+   {
+      encodeInto(reinterpret_cast<const unsigned char*>(input.data()),
+                 input.size(),
+                 &(*pOutput)[0]);
+   }
    return Success();
 }
 
 Error encode(const FilePath& inputFile, std::string* pOutput)
 {
-   std::string contents;
-   Error error = core::readStringFromFile(inputFile, &contents);
+   boost::shared_ptr<std::istream> pIfs;
+   Error error = inputFile.open_r(&pIfs);
    if (error)
       return error;
 
-   return encode(contents, pOutput);
+   // encode directly into the output rather than reading the whole file
+   // into memory first
+   pOutput->clear();
+   pOutput->reserve(encodedSize(static_cast<std::size_t>(inputFile.size())));
+   std::vector<char> buffer(kStreamChunkSize);
+   std::vector<char> encoded(encodedSize(kStreamChunkSize));
+   while (pIfs->read(&buffer[0], buffer.size()) || pIfs->gcount() > 0)
+   {
+      char* pEnd = encodeInto(
+                  reinterpret_cast<const unsigned char*>(&buffer[0]),
+                  static_cast<std::size_t>(pIfs->gcount()),
+                  &encoded[0]);
+      pOutput->append(&encoded[0], pEnd);
+   }
+
+   if (pIfs->bad())
+   {
+      return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+   }
+
+   return Success();
 }
 
+Error encode(std::istream& is, std::ostream& os)
+{
+   std::vector<char> buffer(kStreamChunkSize);
+   std::vector<char> encoded(encodedSize(kStreamChunkSize));
+   while (is.read(&buffer[0], buffer.size()) || is.gcount() > 0)
+   {
+      char* pEnd = encodeInto(
+                  reinterpret_cast<const unsigned char*>(&buffer[0]),
+                  static_cast<std::size_t>(is.gcount()),
+                  &encoded[0]);
+      os.write(&encoded[0], pEnd - &encoded[0]);
+      if (!os)
+         return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+   }
 
-} // namespace base64
-} // namespace core
-} // namespace rstudio
+   if (is.bad())
+      return systemError(boost::system::errc::io_error, ERROR_LOCATION);
 
+   return Success();
+}
 
+Error decode(const std::string& input, std::string* pOutput)
+{
+   pOutput->clear();
+   pOutput->reserve((input.size() / 4) * 3);
+
+   // accumulate 6 bit values, emitting a byte whenever 8 bits are
+   // available. whitespace (e.g. line breaks in MIME output) is skipped
+   // and padding ends the input
+   boost::uint32_t bits = 0;
+   int bitCount = 0;
+   std::size_t padding = 0;
+   for (std::string::const_iterator it = input.begin();
+        it != input.end(); ++it)
+   {
+      unsigned char ch = static_cast<unsigned char>(*it);
+      if (ch == '=')
+      {
+         padding++;
+         continue;
+      }
+
+      if (ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t')
+         continue;
+
+      boost::uint8_t value = s_decodeTable.values[ch];
+      if (value == 0xFF || padding > 0)
+         return invalidInputError(ERROR_LOCATION);
+
+      bits = (bits << 6) | value;
+      bitCount += 6;
+      if (bitCount >= 8)
+      {
+         bitCount -= 8;
+         pOutput->push_back(static_cast<char>((bits >> bitCount) & 0xFF));
+      }
+   }
 
+   // a trailing group of a single character can't encode a byte
+   if (bitCount >= 6 || padding > 2)
+      return invalidInputError(ERROR_LOCATION);
 
+   return Success();
+}
+
+} // namespace base64
+} // namespace core
+} // namespace rstudio
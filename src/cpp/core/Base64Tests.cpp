@@ -0,0 +1,93 @@
+/*
+ * Base64Tests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/Base64.hpp>
+
+#include <sstream>
+
+#include <core/Error.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace base64 {
+
+namespace {
+
+std::string encoded(const std::string& input)
+{
+   std::string output;
+   Error error = encode(input, &output);
+   return error ? std::string() : output;
+}
+
+std::string decoded(const std::string& input)
+{
+   std::string output;
+   Error error = decode(input, &output);
+   return error ? std::string("<error>") : output;
+}
+
+} // anonymous namespace
+
+context("Base64")
+{
+   test_that("Encoding matches RFC 4648 test vectors")
+   {
+      expect_true(encoded("") == "");
+      expect_true(encoded("f") == "Zg==");
+      expect_true(encoded("fo") == "Zm8=");
+      expect_true(encoded("foo") == "Zm9v");
+      expect_true(encoded("foob") == "Zm9vYg==");
+      expect_true(encoded("fooba") == "Zm9vYmE=");
+      expect_true(encoded("foobar") == "Zm9vYmFy");
+   }
+
+   test_that("Decoding reverses encoding")
+   {
+      std::string binary;
+      for (int i = 0; i < 1000; i++)
+         binary.push_back(static_cast<char>((i * 37) & 0xFF));
+
+      for (std::size_t n = 0; n < binary.size(); n += 7)
+         expect_true(decoded(encoded(binary.substr(0, n))) ==
+                     binary.substr(0, n));
+
+      expect_true(decoded("Zm9v\r\nYmFy") == "foobar");
+   }
+
+   test_that("Invalid input is rejected")
+   {
+      expect_true(decoded("Zm9v!") == "<error>");
+      expect_true(decoded("Zg==Zg==") == "<error>");
+      expect_true(decoded("Z") == "<error>");
+   }
+
+   test_that("Streams are encoded in chunks")
+   {
+      std::string input(200000, 'x');
+      input[12345] = '\xFF';
+      std::istringstream is(input);
+      std::ostringstream os;
+      expect_true(!encode(is, os));
+      expect_true(os.str() == encoded(input));
+      expect_true(os.str().size() == encodedSize(input.size()));
+   }
+}
+
+} // namespace base64
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,395 @@
+/*
+ * CoreBenchmarks.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// microbenchmarks of core hot paths. each benchmark is run repeatedly for at
+// least the minimum time and reported as a json object on its own line:
+//
+//    {"name":"json_parse","iterations":1234,"ns_per_op":5678.9,
+//     "bytes_per_sec":12345678}
+//
+// usage: rstudio-core-benchmarks [--min-time <seconds>] [filter]
+//
+// (only benchmarks whose name contains the filter are run)
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Base64.hpp>
+#include <core/Error.hpp>
+#include <core/FileInfo.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/StringUtils.hpp>
+#include <core/http/Request.hpp>
+#include <core/http/RequestParser.hpp>
+#include <core/json/Json.hpp>
+#include <core/r_util/RTokenizer.hpp>
+#include <core/system/FileScanner.hpp>
+#include <core/text/DcfParser.hpp>
+
+using namespace rstudio::core;
+
+namespace {
+
+// prevents the compiler from discarding the work being measured
+volatile std::size_t s_sink = 0;
+
+struct Benchmark
+{
+   Benchmark(const std::string& name,
+             const boost::function<void()>& run,
+             std::size_t bytesPerOp = 0)
+      : name(name), run(run), bytesPerOp(bytesPerOp)
+   {
+   }
+
+   std::string name;
+   boost::function<void()> run;
+   std::size_t bytesPerOp;
+};
+
+void runBenchmark(const Benchmark& benchmark, double minSeconds)
+{
+   using namespace boost::posix_time;
+
+   // warm up (caches, allocator) before measuring
+   benchmark.run();
+
+   long iterations = 0;
+   long batch = 1;
+   double seconds = 0;
+   ptime startTime = microsec_clock::universal_time();
+   while (seconds < minSeconds)
+   {
+      for (long i = 0; i < batch; i++)
+         benchmark.run();
+      iterations += batch;
+      batch *= 2;
+
+      seconds = (microsec_clock::universal_time() - startTime)
+                                          .total_microseconds() / 1e6;
+   }
+
+   json::Object result;
+   result["name"] = benchmark.name;
+   result["iterations"] = static_cast<boost::int64_t>(iterations);
+   result["ns_per_op"] = seconds * 1e9 / iterations;
+   if (benchmark.bytesPerOp > 0)
+   {
+      result["bytes_per_sec"] = static_cast<boost::int64_t>(
+                     benchmark.bytesPerOp * iterations / seconds);
+   }
+
+   json::write(result, std::cout);
+   std::cout << std::endl;
+}
+
+// inputs
+
+std::string rCode()
+{
+   std::string code =
+      "# compute summary statistics\n"
+      "summarize <- function(x, na.rm = TRUE, ...) {\n"
+      "   if (!is.numeric(x)) stop(\"'x' must be numeric\")\n"
+      "   list(mean = mean(x, na.rm = na.rm), sd = sd(x, na.rm = na.rm),\n"
+      "        range = range(x, na.rm = na.rm), n = length(x[!is.na(x)]))\n"
+      "}\n"
+      "result <- lapply(split(mtcars$mpg, mtcars$cyl), summarize)\n"
+      "df[df$value >= 1e-3 & !is.na(df$name), c(\"a\", 'b')] <- NULL\n"
+      "x %>% filter(y %in% c(1L, 2L)) %>% mutate(z = y ^ 2 %% 3)\n";
+
+   std::string result;
+   for (int i = 0; i < 50; i++)
+      result += code;
+   return result;
+}
+
+std::string jsonText()
+{
+   json::Array rows;
+   for (int i = 0; i < 200; i++)
+   {
+      json::Object row;
+      row["id"] = i;
+      row["name"] = "item " + safe_convert::numberToString(i);
+      row["value"] = i * 1.5;
+      row["enabled"] = (i % 2) == 0;
+      json::Array tags;
+      tags.push_back("alpha");
+      tags.push_back("beta \"quoted\"\n");
+      row["tags"] = tags;
+      rows.push_back(row);
+   }
+
+   json::Object doc;
+   doc["rows"] = rows;
+   std::ostringstream ostr;
+   json::write(doc, ostr);
+   return ostr.str();
+}
+
+std::string httpRequestText()
+{
+   std::string body = "{\"method\":\"get_completions\",\"params\":"
+                      "[\"lib\",[],[],[]],\"clientId\":\"abc\"}";
+   return "POST /rpc/get_completions HTTP/1.1\r\n"
+          "Host: localhost:8787\r\n"
+          "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+          "Accept: application/json\r\n"
+          "Accept-Encoding: gzip, deflate\r\n"
+          "Accept-Language: en-US,en;q=0.8\r\n"
+          "Content-Type: application/json\r\n"
+          "Cookie: user-id=user|Tue%2C%2001%20Jan%202030; csrf-token=1234\r\n"
+          "X-RS-RPC: 1\r\n"
+          "Content-Length: " + safe_convert::numberToString(body.size()) +
+          "\r\n\r\n" + body;
+}
+
+std::string dcfText()
+{
+   std::string record =
+      "Package: example\n"
+      "Type: Package\n"
+      "Title: An Example Package for Benchmarking\n"
+      "Version: 1.2.3\n"
+      "Authors@R: c(person(\"First\", \"Last\", email = \"a@b.org\",\n"
+      "    role = c(\"aut\", \"cre\")))\n"
+      "Description: A longer description which continues over several\n"
+      "    lines, as descriptions usually do, and is folded when the\n"
+      "    fields are read.\n"
+      "Depends: R (>= 3.0.0)\n"
+      "Imports: utils, stats, methods, tools\n"
+      "License: GPL-2 | GPL-3\n"
+      "LazyData: true\n";
+   return record;
+}
+
+std::string binaryData(std::size_t size)
+{
+   std::string data(size, '\0');
+   unsigned int state = 12345;
+   for (std::size_t i = 0; i < size; i++)
+   {
+      state = state * 1103515245 + 12345;
+      data[i] = static_cast<char>(state >> 16);
+   }
+   return data;
+}
+
+// benchmarks
+
+void tokenizeR(const std::wstring& code)
+{
+   r_util::RTokens tokens(code);
+   s_sink += tokens.size();
+}
+
+void parseJson(const std::string& text)
+{
+   json::Value value;
+   if (json::parse(text, &value))
+      s_sink += value.type();
+}
+
+void writeJson(const json::Value& value)
+{
+   std::ostringstream ostr;
+   json::write(value, ostr);
+   s_sink += ostr.str().size();
+}
+
+void parseHttpRequest(const std::string& text)
+{
+   http::Request request;
+   http::RequestParser parser;
+   parser.parse(request, text.begin(), text.end());
+   s_sink += request.body().size();
+}
+
+void parseDcf(const std::string& text)
+{
+   std::map<std::string,std::string> fields;
+   std::string errMsg;
+   Error error = text::parseDcfFile(text, false, &fields, &errMsg);
+   s_sink += fields.size();
+}
+
+void checkAscii(const std::string& text)
+{
+   s_sink += string_utils::isAscii(text);
+}
+
+void validateUtf8(const std::string& text)
+{
+   s_sink += string_utils::isValidUtf8(text);
+}
+
+void hashCrc32(const std::string& data)
+{
+   s_sink += hash::crc32Hash(data).size();
+}
+
+void encodeBase64(const std::string& data)
+{
+   std::string encoded;
+   Error error = base64::encode(data, &encoded);
+   s_sink += encoded.size();
+}
+
+void filePathOperations(const FilePath& root)
+{
+   FilePath file = root.childPath("src/cpp/core/FilePath.cpp");
+   s_sink += file.relativePath(root).size();
+   s_sink += file.extension().size();
+   s_sink += file.parent().filename().size();
+   s_sink += file.absolutePath().size();
+}
+
+void filePathExists(const FilePath& file)
+{
+   s_sink += file.exists();
+}
+
+void scanDirectory(const FilePath& root)
+{
+   system::FileScannerOptions options;
+   options.recursive = true;
+   tree<FileInfo> tree;
+   Error error = system::scanFiles(FileInfo(root), options, &tree);
+   s_sink += tree.size();
+}
+
+// creates a directory tree of 10 directories with 20 files each
+Error createScanTree(FilePath* pRoot)
+{
+   Error error = FilePath::tempFilePath(pRoot);
+   if (error)
+      return error;
+
+   for (int i = 0; i < 10; i++)
+   {
+      FilePath dir = pRoot->childPath("dir" + safe_convert::numberToString(i));
+      error = dir.ensureDirectory();
+      if (error)
+         return error;
+
+      for (int j = 0; j < 20; j++)
+      {
+         std::string name = "file" + safe_convert::numberToString(j) + ".R";
+         error = writeStringToFile(dir.childPath(name), "x <- 1\n");
+         if (error)
+            return error;
+      }
+   }
+
+   return Success();
+}
+
+} // anonymous namespace
+
+int main(int argc, char * const argv[])
+{
+   double minSeconds = 0.5;
+   std::string filter;
+   for (int i = 1; i < argc; i++)
+   {
+      std::string arg(argv[i]);
+      if (arg == "--min-time" && i + 1 < argc)
+         minSeconds = std::atof(argv[++i]);
+      else
+         filter = arg;
+   }
+
+   std::string code = rCode();
+   std::wstring wideCode = string_utils::utf8ToWide(code);
+   std::string json = jsonText();
+   json::Value jsonValue;
+   json::parse(json, &jsonValue);
+   std::string request = httpRequestText();
+   std::string dcf = dcfText();
+   std::string data = binaryData(64 * 1024);
+
+   // mostly ascii text with the occasional multibyte character
+   std::string text;
+   while (text.size() < 64 * 1024)
+      text += code + "# r\xC3\xA9sum\xC3\xA9 \xE2\x82\xAC\n";
+
+   FilePath scanRoot;
+   Error error = createScanTree(&scanRoot);
+   if (error)
+   {
+      std::cerr << error.summary() << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   std::vector<Benchmark> benchmarks;
+   benchmarks.push_back(Benchmark("r_tokenize",
+                                  boost::bind(tokenizeR, wideCode),
+                                  code.size()));
+   benchmarks.push_back(Benchmark("json_parse",
+                                  boost::bind(parseJson, json),
+                                  json.size()));
+   benchmarks.push_back(Benchmark("json_write",
+                                  boost::bind(writeJson, jsonValue),
+                                  json.size()));
+   benchmarks.push_back(Benchmark("http_request_parse",
+                                  boost::bind(parseHttpRequest, request),
+                                  request.size()));
+   benchmarks.push_back(Benchmark("dcf_parse",
+                                  boost::bind(parseDcf, dcf),
+                                  dcf.size()));
+   benchmarks.push_back(Benchmark("ascii_check",
+                                  boost::bind(checkAscii, code),
+                                  code.size()));
+   benchmarks.push_back(Benchmark("utf8_validate",
+                                  boost::bind(validateUtf8, text),
+                                  text.size()));
+   benchmarks.push_back(Benchmark("crc32_hash",
+                                  boost::bind(hashCrc32, data),
+                                  data.size()));
+   benchmarks.push_back(Benchmark("base64_encode",
+                                  boost::bind(encodeBase64, data),
+                                  data.size()));
+   benchmarks.push_back(Benchmark("file_path_operations",
+                                  boost::bind(filePathOperations, scanRoot)));
+   benchmarks.push_back(Benchmark("file_path_exists",
+                                  boost::bind(filePathExists,
+                                              scanRoot.childPath("dir0"))));
+   benchmarks.push_back(Benchmark("scan_files",
+                                  boost::bind(scanDirectory, scanRoot)));
+
+   for (std::size_t i = 0; i < benchmarks.size(); i++)
+   {
+      if (benchmarks[i].name.find(filter) != std::string::npos)
+         runBenchmark(benchmarks[i], minSeconds);
+   }
+
+   error = scanRoot.remove();
+   if (error)
+      std::cerr << error.summary() << std::endl;
+
+   return EXIT_SUCCESS;
+}
@@ -15,18 +15,85 @@
 
 #include <core/FileInfo.hpp>
 
+#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
 #include <core/FilePath.hpp>
+#include <core/Thread.hpp>
 
 namespace rstudio {
 namespace core {
 
+namespace {
+
+// table of interned directory paths. entries are removed when the last
+// FileInfo referencing them is destroyed
+class PathTable : boost::noncopyable
+{
+public:
+   boost::shared_ptr<const std::string> intern(const std::string& path)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         boost::weak_ptr<const std::string>& entry = paths_[path];
+         boost::shared_ptr<const std::string> pPath = entry.lock();
+         if (!pPath)
+         {
+            // NOTE: copy via c_str so the interned string never shares a
+            // buffer with the caller's string
+            pPath.reset(new std::string(path.c_str()),
+                        boost::bind(&PathTable::release, this, _1));
+            entry = pPath;
+         }
+         return pPath;
+      }
+      END_LOCK_MUTEX
+
+      // keep compiler happy (only reached if locking failed)
+      return boost::shared_ptr<const std::string>(new std::string(path.c_str()));
+   }
+
+private:
+   void release(const std::string* pPath)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         // only remove the entry if it hasn't since been re-interned
+         Paths::iterator it = paths_.find(*pPath);
+         if (it != paths_.end() && it->second.expired())
+            paths_.erase(it);
+      }
+      END_LOCK_MUTEX
+
+      delete pPath;
+   }
+
+private:
+   typedef boost::unordered_map<std::string,
+                                boost::weak_ptr<const std::string> > Paths;
+   boost::mutex mutex_;
+   Paths paths_;
+};
+
+PathTable& pathTable()
+{
+   // intentionally leaked (FileInfo objects may be destroyed during
+   // static destruction)
+   static PathTable* pTable = new PathTable();
+   return *pTable;
+}
+
+} // anonymous namespace
+
 FileInfo::FileInfo(const FilePath& filePath, bool isSymlink)
-   :  absolutePath_(filePath.absolutePath()),
-      isDirectory_(filePath.isDirectory()),
-      size_(0),
+   :  size_(0),
       lastWriteTime_(0),
+      isDirectory_(filePath.isDirectory()),
       isSymlink_(isSymlink)
 {
+   setAbsolutePath(filePath.absolutePath());
+
    if (!isDirectory_ && filePath.exists())
    {
       size_ = filePath.size();
@@ -37,12 +104,12 @@ FileInfo::FileInfo(const FilePath& filePath, bool isSymlink)
 FileInfo::FileInfo(const std::string& absolutePath,
                    bool isDirectory,
                    bool isSymlink)
- :    absolutePath_(absolutePath),
-      isDirectory_(isDirectory),
-      size_(0),
+ :    size_(0),
       lastWriteTime_(0),
+      isDirectory_(isDirectory),
       isSymlink_(isSymlink)
 {
+   setAbsolutePath(absolutePath);
 }
    
 FileInfo::FileInfo(const std::string& absolutePath,
@@ -50,14 +117,67 @@ FileInfo::FileInfo(const std::string& absolutePath,
                    uintmax_t size,
                    std::time_t lastWriteTime,
                    bool isSymlink)
-   :  absolutePath_(absolutePath),
-      isDirectory_(isDirectory),
-      size_(size),
+   :  size_(size),
       lastWriteTime_(lastWriteTime),
+      isDirectory_(isDirectory),
       isSymlink_(isSymlink)
 {
+   setAbsolutePath(absolutePath);
 }
-   
+
+void FileInfo::setAbsolutePath(const std::string& absolutePath)
+{
+   std::string::size_type pos = absolutePath.find_last_of('/');
+   if (pos == std::string::npos)
+   {
+      name_ = absolutePath.c_str();
+   }
+   else
+   {
+      pParentPath_ = pathTable().intern(absolutePath.substr(0, pos));
+      name_ = absolutePath.substr(pos + 1);
+   }
+}
+
+std::string FileInfo::absolutePath() const
+{
+   if (!pParentPath_)
+      return name_.c_str();
+
+   std::string path;
+   path.reserve(pParentPath_->size() + 1 + name_.size());
+   path.append(*pParentPath_);
+   path.append(1, '/');
+   path.append(name_);
+   return path;
+}
+
+bool FileInfo::hasPath(const std::string& absolutePath) const
+{
+   if (!pParentPath_)
+      return name_ == absolutePath;
+
+   const std::string& parent = *pParentPath_;
+   return absolutePath.size() == parent.size() + 1 + name_.size() &&
+          absolutePath.compare(0, parent.size(), parent) == 0 &&
+          absolutePath[parent.size()] == '/' &&
+          absolutePath.compare(parent.size() + 1, name_.size(), name_) == 0;
+}
+
+bool FileInfo::hasSamePath(const FileInfo& other) const
+{
+   // interned parent paths are equal only if they are the same object
+   return pParentPath_ == other.pParentPath_ && name_ == other.name_;
+}
+
+int FileInfo::comparePath(const FileInfo& other) const
+{
+   if (pParentPath_ == other.pParentPath_)
+      return ::strcmp(name_.c_str(), other.name_.c_str());
+   else
+      return ::strcmp(absolutePath().c_str(), other.absolutePath().c_str());
+}
+
 std::ostream& operator << (std::ostream& stream, const FileInfo& fileInfo)
 {
    stream << fileInfo.absolutePath();
@@ -69,6 +189,3 @@ std::ostream& operator << (std::ostream& stream, const FileInfo& fileInfo)
    
 } // namespace core 
 } // namespace rstudio
-
-
-
@@ -0,0 +1,71 @@
+/*
+ * FileInfoTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <core/FileInfo.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+context("FileInfo")
+{
+   test_that("absolute paths are preserved")
+   {
+      expect_true(FileInfo("/", true).absolutePath() == "/");
+      expect_true(FileInfo("/a", false).absolutePath() == "/a");
+      expect_true(FileInfo("/a/b/c.R", false).absolutePath() == "/a/b/c.R");
+      expect_true(FileInfo("/a/b/", true).absolutePath() == "/a/b/");
+      expect_true(FileInfo("relative", false).absolutePath() == "relative");
+      expect_true(FileInfo().absolutePath().empty());
+      expect_true(FileInfo().empty());
+      expect_false(FileInfo("/", true).empty());
+   }
+
+   test_that("paths can be compared without constructing them")
+   {
+      FileInfo a("/project/R/a.R", false);
+      FileInfo b("/project/R/b.R", false);
+      FileInfo other("/project/src/a.R", false);
+
+      expect_true(a.hasPath("/project/R/a.R"));
+      expect_false(a.hasPath("/project/R/a.Rx"));
+      expect_false(a.hasPath("/project/Ra.R"));
+      expect_false(a.hasPath("/project/R/b.R"));
+
+      expect_true(a.hasSamePath(FileInfo("/project/R/a.R", true)));
+      expect_false(a.hasSamePath(b));
+      expect_false(a.hasSamePath(other));
+
+      expect_true(a.comparePath(b) < 0);
+      expect_true(b.comparePath(a) > 0);
+      expect_true(a.comparePath(other) < 0);
+      expect_true(fileInfoPathLessThan(FileInfo("/project/R", true), a));
+   }
+
+   test_that("equality includes attributes")
+   {
+      FileInfo a("/project/a.R", false, 10, 100);
+      expect_true(a == FileInfo("/project/a.R", false, 10, 100));
+      expect_true(a != FileInfo("/project/a.R", false, 11, 100));
+      expect_true(a != FileInfo("/project/a.R", false, 10, 101));
+      expect_true(a != FileInfo("/project/b.R", false, 10, 100));
+   }
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
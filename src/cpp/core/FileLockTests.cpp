@@ -87,6 +87,28 @@ TEST_CASE("File Locking")
       s_lockFilePath.removeIfExists();
    }
    
+   SECTION("A link-based lock whose lease has expired can be taken over")
+   {
+      LinkBasedFileLock lock1;
+      LinkBasedFileLock lock2;
+
+      Error error = lock1.acquire(s_lockFilePath);
+      CHECK((error == Success()));
+      CHECK(lock2.isLocked(s_lockFilePath));
+
+      // age the lock file past the timeout (as if its holder had crashed)
+      s_lockFilePath.setLastWriteTime(
+               ::time(NULL) - FileLock::getTimeoutInterval().total_seconds() - 1);
+      CHECK_FALSE(lock2.isLocked(s_lockFilePath));
+
+      error = lock2.acquire(s_lockFilePath);
+      CHECK((error == Success()));
+      CHECK(lock1.isLocked(s_lockFilePath));
+
+      lock2.release();
+      CHECK_FALSE(lock1.isLocked(s_lockFilePath));
+   }
+
    SECTION("Only one thread successfully acquires link-based file lock")
    {
       for (std::size_t i = 0; i < 1000; ++i)
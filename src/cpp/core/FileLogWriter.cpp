@@ -15,19 +15,66 @@
 
 #include <core/FileLogWriter.hpp>
 
+#include <errno.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
 
 #include <core/FileInfo.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/system/System.hpp>
 
+using namespace boost::posix_time;
+
 namespace rstudio {
 namespace core {
 
+namespace {
+
+// maximum number of queued entries (beyond this entries are dropped)
+const long kMaxQueuedEntries = 10000;
+
+// interval at which the writer thread checks for queued entries
+const int kWriteIntervalMs = 250;
+
+// interval at which the log file is synced to disk
+const int kSyncIntervalSeconds = 5;
+
+// writers to flush at exit
+std::vector<FileLogWriter*> s_writers;
+
+void flushWritersAtExit()
+{
+   BOOST_FOREACH(FileLogWriter* pWriter, s_writers)
+   {
+      pWriter->flush();
+   }
+}
+
+} // anonymous namespace
+
 FileLogWriter::FileLogWriter(const std::string& programIdentity,
                              int logLevel,
                              const FilePath& logDir)
                                 : programIdentity_(programIdentity),
-                                  logLevel_(logLevel)
+                                  logLevel_(logLevel),
+                                  queuedCount_(0),
+                                  droppedCount_(0),
+                                  reportedDroppedCount_(0),
+                                  writing_(0),
+                                  writerPid_(0),
+                                  pWriterThread_(NULL),
+                                  lastSyncTime_(microsec_clock::universal_time())
 {
    logDir.ensureDirectory();
 
@@ -39,13 +86,28 @@ FileLogWriter::FileLogWriter(const std::string& programIdentity,
       // swallow errors -- we can't log so it doesn't matter
       core::appendToFile(logFile_, "");
    }
+
+   // make sure queued entries are written at exit
+   if (s_writers.empty())
+      ::atexit(flushWritersAtExit);
+   s_writers.push_back(this);
 }
 
 FileLogWriter::~FileLogWriter()
 {
    try
    {
-      // we don't keep a file handle open so do nothing here
+      s_writers.erase(std::remove(s_writers.begin(), s_writers.end(), this),
+                      s_writers.end());
+
+      if (pWriterThread_ != NULL && !isForkedChild())
+      {
+         pWriterThread_->interrupt();
+         pWriterThread_->join();
+         delete pWriterThread_;
+      }
+
+      flush();
    }
    catch(...)
    {
@@ -65,13 +127,195 @@ void FileLogWriter::log(const std::string& programIdentity,
    if (logLevel > logLevel_)
       return;
 
+   ensureWriterThread();
+
+   // drop the entry if the queue is full
+   if (__sync_add_and_fetch(&queuedCount_, 1) > kMaxQueuedEntries)
+   {
+      __sync_sub_and_fetch(&queuedCount_, 1);
+      __sync_add_and_fetch(&droppedCount_, 1);
+      return;
+   }
+
+   queue_.push(formatLogEntry(programIdentity, message));
+}
+
+void FileLogWriter::flush()
+{
+   // if we are a forked child which hasn't logged then the queued entries
+   // belong to (and are written by) our parent
+   if (isForkedChild())
+   {
+      discardQueuedEntries();
+      return;
+   }
+
+   // wait for the writer thread to finish any write in progress
+   while (!__sync_bool_compare_and_swap(&writing_, 0, 1))
+      boost::this_thread::sleep(milliseconds(1));
+
+   try
+   {
+      writeQueuedEntries();
+   }
+   catch(...)
+   {
+   }
+
+   __sync_lock_release(&writing_);
+}
+
+long FileLogWriter::droppedCount() const
+{
+   return __sync_add_and_fetch(const_cast<volatile long*>(&droppedCount_), 0);
+}
+
+void FileLogWriter::ensureWriterThread()
+{
+   long pid = core::system::currentProcessId();
+   long writerPid = writerPid_;
+   if (writerPid == pid)
+      return;
+
+   // only one thread gets to start the writer
+   if (!__sync_bool_compare_and_swap(&writerPid_, writerPid, pid))
+      return;
+
+   // if there was a writer it was in our parent process (threads don't
+   // survive fork) so reset the state it owned. entries queued prior to
+   // the fork are written by the parent so we discard our copy of them.
+   // (the parent's thread object is intentionally leaked)
+   if (writerPid != 0)
+   {
+      discardQueuedEntries();
+      writing_ = 0;
+   }
+
+   try
+   {
+      pWriterThread_ = new boost::thread(
+                  boost::bind(&FileLogWriter::writerThreadMain, this));
+   }
+   catch(...)
+   {
+      // without a writer thread entries are written at exit
+      pWriterThread_ = NULL;
+   }
+}
+
+bool FileLogWriter::isForkedChild() const
+{
+   long writerPid = writerPid_;
+   return writerPid != 0 &&
+          writerPid != static_cast<long>(core::system::currentProcessId());
+}
+
+void FileLogWriter::discardQueuedEntries()
+{
+   std::vector<std::string> entries;
+   queue_.popAll(&entries);
+   __sync_sub_and_fetch(&queuedCount_, static_cast<long>(entries.size()));
+}
+
+void FileLogWriter::writerThreadMain()
+{
+   try
+   {
+      while (true)
+      {
+         boost::this_thread::sleep(milliseconds(kWriteIntervalMs));
+
+         if (__sync_bool_compare_and_swap(&writing_, 0, 1))
+         {
+            try
+            {
+               writeQueuedEntries();
+            }
+            catch(...)
+            {
+            }
+
+            __sync_lock_release(&writing_);
+         }
+      }
+   }
+   catch(const boost::thread_interrupted&)
+   {
+   }
+}
+
+// NOTE: caller must hold writing_
+bool FileLogWriter::writeQueuedEntries()
+{
+   std::vector<std::string> entries;
+   queue_.popAll(&entries);
+   __sync_sub_and_fetch(&queuedCount_, static_cast<long>(entries.size()));
+
+   // note any entries dropped since we last wrote
+   long droppedCount = droppedCount_;
+   bool dropped = droppedCount != reportedDroppedCount_;
+
+   if (entries.empty() && !dropped)
+      return false;
+
+   std::string batch;
+   BOOST_FOREACH(const std::string& entry, entries)
+   {
+      batch.append(entry);
+   }
+
+   if (dropped)
+   {
+      batch.append(formatLogEntry(
+         programIdentity_,
+         boost::str(boost::format("%1% log entries dropped (log queue full)")
+                    % (droppedCount - reportedDroppedCount_))));
+      reportedDroppedCount_ = droppedCount;
+   }
+
    rotateLogFile();
+   writeEntries(batch);
+   return true;
+}
 
+void FileLogWriter::writeEntries(const std::string& entries)
+{
    // Swallow errors--we can't do anything anyway
-   core::appendToFile(logFile_, formatLogEntry(programIdentity, message));
-}
+#ifndef _WIN32
+   int fd = ::open(logFile_.absolutePath().c_str(),
+                   O_WRONLY | O_APPEND | O_CREAT,
+                   0666);
+   if (fd == -1)
+      return;
 
+   const char* data = entries.data();
+   std::size_t remaining = entries.size();
+   while (remaining > 0)
+   {
+      ssize_t written = ::write(fd, data, remaining);
+      if (written == -1)
+      {
+         if (errno == EINTR)
+            continue;
+         break;
+      }
+      data += written;
+      remaining -= written;
+   }
 
+   // periodically sync to disk
+   ptime now = microsec_clock::universal_time();
+   if (now - lastSyncTime_ > seconds(kSyncIntervalSeconds))
+   {
+      ::fsync(fd);
+      lastSyncTime_ = now;
+   }
+
+   ::close(fd);
+#else
+   core::appendToFile(logFile_, entries);
+#endif
+}
 
 #define LOGMAX (2048*1024)  // rotate/remove every 2 megabytes
 bool FileLogWriter::rotateLogFile()
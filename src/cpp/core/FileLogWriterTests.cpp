@@ -0,0 +1,105 @@
+/*
+ * FileLogWriterTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <core/FileLogWriter.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+void logMessages(FileLogWriter* pWriter, int thread, int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      pWriter->log(core::system::kLogLevelError,
+                   "thread " + boost::lexical_cast<std::string>(thread) +
+                   " message " + boost::lexical_cast<std::string>(i));
+   }
+}
+
+std::string readLog(const FilePath& logDir)
+{
+   std::string contents;
+   readStringFromFile(logDir.childPath("test.log"), &contents);
+   return contents;
+}
+
+} // anonymous namespace
+
+context("FileLogWriter")
+{
+   test_that("queued entries are written on flush")
+   {
+      FilePath logDir;
+      expect_false(FilePath::tempFilePath(&logDir));
+      {
+         FileLogWriter writer("test", core::system::kLogLevelWarning, logDir);
+         writer.log(core::system::kLogLevelError, "first");
+         writer.log(core::system::kLogLevelInfo, "filtered");
+         writer.log(core::system::kLogLevelWarning, "second");
+         writer.flush();
+
+         std::string contents = readLog(logDir);
+         std::string::size_type first = contents.find("first");
+         std::string::size_type second = contents.find("second");
+         expect_true(first != std::string::npos);
+         expect_true(second != std::string::npos);
+         expect_true(first < second);
+         expect_true(contents.find("filtered") == std::string::npos);
+      }
+      logDir.removeIfExists();
+   }
+
+   test_that("entries from concurrent threads are all written")
+   {
+      FilePath logDir;
+      expect_false(FilePath::tempFilePath(&logDir));
+      {
+         FileLogWriter writer("test", core::system::kLogLevelError, logDir);
+
+         boost::thread_group threads;
+         for (int i = 0; i < 4; i++)
+            threads.create_thread(boost::bind(logMessages, &writer, i, 100));
+         threads.join_all();
+         writer.flush();
+
+         std::string contents = readLog(logDir);
+         expect_true(writer.droppedCount() == 0);
+         for (int i = 0; i < 4; i++)
+         {
+            std::string thread = boost::lexical_cast<std::string>(i);
+            expect_true(contents.find("thread " + thread + " message 0") !=
+                        std::string::npos);
+            expect_true(contents.find("thread " + thread + " message 99") !=
+                        std::string::npos);
+         }
+      }
+      logDir.removeIfExists();
+   }
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
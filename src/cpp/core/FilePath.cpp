@@ -26,6 +26,7 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/stream.hpp>
 #include <boost/iostreams/device/file_descriptor.hpp>
@@ -35,6 +36,7 @@
 
 #include <core/Log.hpp>
 #include <core/Error.hpp>
+#include <core/StatCache.hpp>
 
 
 typedef boost::filesystem::path path_t;
@@ -123,6 +125,15 @@ void logError(path_t path,
               const boost::filesystem::filesystem_error& e,
               const ErrorLocation& errorLocation);
 void addErrorProperties(path_t path, Error* pError) ;
+
+// closes a stream returned by open_w (and invalidates any cached
+// metadata for the file, which the writes have likely changed)
+void closeOutputStream(std::ostream* pStream, const std::string& path)
+{
+   delete pStream;
+   stat_cache::invalidate(path);
+}
+
 }
 
 struct FilePath::Impl
@@ -223,6 +234,10 @@ bool FilePath::exists(const std::string& path)
    if (path.empty())
       return false;
 
+   stat_cache::Entry entry;
+   if (stat_cache::lookup(path, &entry))
+      return entry.exists;
+
    path_t p(fromString(path));
    try
    {
@@ -297,8 +312,25 @@ bool FilePath::empty() const
    return pImpl_->path.empty() ;
 }
 
+bool FilePath::cachedStat(stat_cache::Entry* pEntry) const
+{
+   return stat_cache::enabled() &&
+          !empty() &&
+          stat_cache::lookup(BOOST_FS_PATH2STR(pImpl_->path), pEntry);
+}
+
+void FilePath::invalidateStatCache() const
+{
+   if (stat_cache::enabled() && !empty())
+      stat_cache::invalidate(BOOST_FS_PATH2STR(pImpl_->path));
+}
+
 bool FilePath::exists() const
 {
+    stat_cache::Entry entry;
+    if (cachedStat(&entry))
+       return entry.exists;
+
     try
     {
        return !empty() && boost::filesystem::exists(pImpl_->path) ;
@@ -326,6 +358,10 @@ bool FilePath::isSymlink() const
 
 uintmax_t FilePath::size() const
 {
+   stat_cache::Entry entry;
+   if (cachedStat(&entry))
+      return entry.size;
+
    try
    {
       if (!exists() || !boost::filesystem::is_regular_file(pImpl_->path))
@@ -541,7 +577,10 @@ void FilePath::setLastWriteTime(std::time_t time) const
       if (!exists())
          return;
       else
+      {
          boost::filesystem::last_write_time(pImpl_->path, time);
+         invalidateStatCache();
+      }
    }
    catch(const boost::filesystem::filesystem_error& e)
    {
@@ -552,6 +591,10 @@ void FilePath::setLastWriteTime(std::time_t time) const
 
 std::time_t FilePath::lastWriteTime() const
 {
+   stat_cache::Entry entry;
+   if (cachedStat(&entry))
+      return entry.lastWriteTime;
+
    try
    {
       if (!exists())
@@ -643,10 +686,12 @@ Error FilePath::remove() const
          boost::filesystem::remove_all(pImpl_->path);
       else
          boost::filesystem::remove(pImpl_->path) ;
+      invalidateStatCache();
       return Success() ;
    }
    catch(const boost::filesystem::filesystem_error& e)
    {
+      invalidateStatCache();
       Error error(e.code(), ERROR_LOCATION) ;
       addErrorProperties(pImpl_->path, &error) ;
       return error ;
@@ -666,6 +711,8 @@ Error FilePath::move(const FilePath& targetPath) const
    try
    {
       boost::filesystem::rename(pImpl_->path, targetPath.pImpl_->path) ;
+      invalidateStatCache();
+      targetPath.invalidateStatCache();
       return Success() ;
    }
    catch(const boost::filesystem::filesystem_error& e)
@@ -683,6 +730,24 @@ Error FilePath::copy(const FilePath& targetPath) const
    try
    {
       boost::filesystem::copy_file(pImpl_->path, targetPath.pImpl_->path) ;
+      targetPath.invalidateStatCache();
+      return Success() ;
+   }
+   catch(const boost::filesystem::filesystem_error& e)
+   {
+      Error error(e.code(), ERROR_LOCATION) ;
+      addErrorProperties(pImpl_->path, &error) ;
+      error.addProperty("target-path", targetPath.absolutePath()) ;
+      return error ;
+   }
+}
+
+Error FilePath::link(const FilePath& targetPath) const
+{
+   try
+   {
+      boost::filesystem::create_hard_link(pImpl_->path, targetPath.pImpl_->path);
+      targetPath.invalidateStatCache();
       return Success() ;
    }
    catch(const boost::filesystem::filesystem_error& e)
@@ -729,6 +794,10 @@ bool FilePath::isJunction() const
 
 bool FilePath::isDirectory() const
 {
+   stat_cache::Entry entry;
+   if (cachedStat(&entry))
+      return entry.isDirectory;
+
    try
    {
       if (!exists())
@@ -769,6 +838,13 @@ Error FilePath::createDirectory(const std::string& name) const
       else
          targetDirectory = BOOST_FS_COMPLETE(name, pImpl_->path) ;
       boost::filesystem::create_directories(targetDirectory) ;
+
+      // create_directories may have created any of the target's ancestors
+      if (stat_cache::enabled())
+      {
+         for (path_t dir = targetDirectory; !dir.empty(); dir = dir.parent_path())
+            stat_cache::invalidate(BOOST_FS_PATH2STR(dir));
+      }
       return Success() ;
    }
    catch(const boost::filesystem::filesystem_error& e)
@@ -1075,7 +1151,11 @@ Error FilePath::open_w(boost::shared_ptr<std::ostream>* pStream, bool truncate)
          return error;
       }
 
-      pStream->reset(pResult);
+      invalidateStatCache();
+      if (stat_cache::enabled())
+         pStream->reset(pResult, boost::bind(closeOutputStream, _1, absolutePath()));
+      else
+         pStream->reset(pResult);
    }
    catch(const std::exception& e)
    {
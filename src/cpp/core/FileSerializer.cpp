@@ -25,11 +25,47 @@
 #include <boost/iostreams/copy.hpp>
 
 #include <core/FilePath.hpp>
+#include <core/MappedFile.hpp>
 #include <core/StringUtils.hpp>
 
 namespace rstudio {
 namespace core {
 
+namespace {
+
+// files at least this large are read via a memory mapping (which avoids
+// the intermediate copies made by reading through a stream)
+const uintmax_t kMappedReadMinSize = 1024 * 1024;
+
+Error readMappedStringFromFile(const FilePath& filePath,
+                               std::string* pStr,
+                               string_utils::LineEnding lineEnding)
+{
+   MappedFile file;
+   Error error = file.open(filePath);
+   if (error)
+      return error;
+
+   try
+   {
+      string_utils::convertLineEndings(file.begin(),
+                                       file.end(),
+                                       lineEnding,
+                                       pStr);
+      return Success();
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", filePath.absolutePath());
+      return error;
+   }
+}
+
+} // anonymous namespace
+
 std::string stringifyStringPair(const std::pair<std::string,std::string>& pair)
 {
    return pair.first + "=\"" + string_utils::jsonLiteralEscape(pair.second) + "\"" ;
@@ -161,6 +197,11 @@ Error readStringFromFile(const FilePath& filePath,
                          int endCharacter)
 {
    using namespace boost::system::errc ;
+
+   // read large files in their entirety via a mapping (note that files
+   // which report a size of zero, e.g. those in /proc, must be streamed)
+   if (endLine <= startLine && filePath.size() >= kMappedReadMinSize)
+      return readMappedStringFromFile(filePath, pStr, lineEnding);
    
    // open file
    boost::shared_ptr<std::istream> pIfs;
@@ -15,17 +15,255 @@
 
 #include <core/Hash.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include <boost/crc.hpp>
+#include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/MappedFile.hpp>
 #include <core/SafeConvert.hpp>
 
+// hardware crc32c: on x86-64 the SSE 4.2 code path is compiled regardless of
+// the target architecture flags and then chosen at runtime if the CPU
+// supports it; on ARM it's used if the compiler targets ARMv8 with CRC
+#if defined(__x86_64__) && \
+    (defined(__clang__) || \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+# define HASH_CRC32C_SSE42
+# define HASH_CRC32C_TARGET __attribute__((target("sse4.2")))
+# include <nmmintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+# define HASH_CRC32C_SSE42
+# define HASH_CRC32C_TARGET
+# include <intrin.h>
+# include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+# define HASH_CRC32C_ARM
+# include <arm_acle.h>
+#endif
+
 namespace rstudio {
 namespace core {
 namespace hash {   
 
+namespace {
+
+// CRC-32C ----------------------------------------------------------------
+
+const boost::uint32_t kCrc32cPolynomial = 0x82F63B78;
+
+struct Crc32cTable
+{
+   Crc32cTable()
+   {
+      for (boost::uint32_t i = 0; i < 256; i++)
+      {
+         boost::uint32_t crc = i;
+         for (int j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ ((crc & 1) ? kCrc32cPolynomial : 0);
+         values[i] = crc;
+      }
+   }
+
+   boost::uint32_t values[256];
+};
+
+const Crc32cTable s_crc32cTable;
+
+boost::uint32_t crc32cSoftware(const unsigned char* pData,
+                               std::size_t size,
+                               boost::uint32_t crc)
+{
+   for (std::size_t i = 0; i < size; i++)
+      crc = s_crc32cTable.values[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+   return crc;
+}
+
+#ifdef HASH_CRC32C_SSE42
+
+bool haveSse42()
+{
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info, 1);
+   return (info[2] & (1 << 20)) != 0;
+#else
+   return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+const bool s_haveSse42 = haveSse42();
+
+HASH_CRC32C_TARGET
+boost::uint32_t crc32cHardware(const unsigned char* pData,
+                               std::size_t size,
+                               boost::uint32_t crc)
+{
+   boost::uint64_t crc64 = crc;
+   for (; size >= 8; size -= 8, pData += 8)
+   {
+      boost::uint64_t value;
+      std::memcpy(&value, pData, 8);
+      crc64 = _mm_crc32_u64(crc64, value);
+   }
+
+   crc = static_cast<boost::uint32_t>(crc64);
+   for (; size > 0; size--, pData++)
+      crc = _mm_crc32_u8(crc, *pData);
+   return crc;
+}
+
+#elif defined(HASH_CRC32C_ARM)
+
+boost::uint32_t crc32cHardware(const unsigned char* pData,
+                               std::size_t size,
+                               boost::uint32_t crc)
+{
+   for (; size >= 8; size -= 8, pData += 8)
+   {
+      boost::uint64_t value;
+      std::memcpy(&value, pData, 8);
+      crc = __crc32cd(crc, value);
+   }
+
+   for (; size > 0; size--, pData++)
+      crc = __crc32cb(crc, *pData);
+   return crc;
+}
+
+#endif
+
+// xxHash64 ---------------------------------------------------------------
+//
+// See https://github.com/Cyan4973/xxHash (values are read little-endian,
+// which matches the reference implementation on the platforms we support)
+
+const boost::uint64_t kPrime1 = 11400714785074694791ULL;
+const boost::uint64_t kPrime2 = 14029467366897019727ULL;
+const boost::uint64_t kPrime3 = 1609587929392839161ULL;
+const boost::uint64_t kPrime4 = 9650029242287828579ULL;
+const boost::uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline boost::uint64_t rotateLeft(boost::uint64_t value, int bits)
+{
+   return (value << bits) | (value >> (64 - bits));
+}
+
+inline boost::uint64_t read64(const unsigned char* pData)
+{
+   boost::uint64_t value;
+   std::memcpy(&value, pData, sizeof(value));
+   return value;
+}
+
+inline boost::uint32_t read32(const unsigned char* pData)
+{
+   boost::uint32_t value;
+   std::memcpy(&value, pData, sizeof(value));
+   return value;
+}
+
+inline boost::uint64_t xxRound(boost::uint64_t acc, boost::uint64_t input)
+{
+   acc += input * kPrime2;
+   acc = rotateLeft(acc, 31);
+   return acc * kPrime1;
+}
+
+inline boost::uint64_t xxMergeRound(boost::uint64_t acc, boost::uint64_t value)
+{
+   acc ^= xxRound(0, value);
+   return acc * kPrime1 + kPrime4;
+}
+
+void xxInitAccumulators(boost::uint64_t seed, boost::uint64_t* pAcc)
+{
+   pAcc[0] = seed + kPrime1 + kPrime2;
+   pAcc[1] = seed + kPrime2;
+   pAcc[2] = seed;
+   pAcc[3] = seed - kPrime1;
+}
+
+// consumes as many 32 byte stripes as are available, returning the number
+// of bytes consumed
+std::size_t xxConsumeStripes(const unsigned char* pData,
+                             std::size_t size,
+                             boost::uint64_t* pAcc)
+{
+   std::size_t consumed = 0;
+   for (; consumed + 32 <= size; consumed += 32)
+   {
+      const unsigned char* pStripe = pData + consumed;
+      pAcc[0] = xxRound(pAcc[0], read64(pStripe));
+      pAcc[1] = xxRound(pAcc[1], read64(pStripe + 8));
+      pAcc[2] = xxRound(pAcc[2], read64(pStripe + 16));
+      pAcc[3] = xxRound(pAcc[3], read64(pStripe + 24));
+   }
+   return consumed;
+}
+
+boost::uint64_t xxFinish(const boost::uint64_t* pAcc,
+                         bool haveStripes,
+                         boost::uint64_t seed,
+                         boost::uint64_t totalSize,
+                         const unsigned char* pTail,
+                         std::size_t tailSize)
+{
+   boost::uint64_t hash;
+   if (haveStripes)
+   {
+      hash = rotateLeft(pAcc[0], 1) + rotateLeft(pAcc[1], 7) +
+             rotateLeft(pAcc[2], 12) + rotateLeft(pAcc[3], 18);
+      for (int i = 0; i < 4; i++)
+         hash = xxMergeRound(hash, pAcc[i]);
+   }
+   else
+   {
+      hash = seed + kPrime5;
+   }
+
+   hash += totalSize;
+
+   for (; tailSize >= 8; tailSize -= 8, pTail += 8)
+   {
+      hash ^= xxRound(0, read64(pTail));
+      hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+   }
+
+   if (tailSize >= 4)
+   {
+      hash ^= static_cast<boost::uint64_t>(read32(pTail)) * kPrime1;
+      hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+      tailSize -= 4;
+      pTail += 4;
+   }
+
+   for (; tailSize > 0; tailSize--, pTail++)
+   {
+      hash ^= (*pTail) * kPrime5;
+      hash = rotateLeft(hash, 11) * kPrime1;
+   }
+
+   hash ^= hash >> 33;
+   hash *= kPrime2;
+   hash ^= hash >> 29;
+   hash *= kPrime3;
+   hash ^= hash >> 32;
+   return hash;
+}
+
+std::string toHex(boost::uint64_t value)
+{
+   return boost::str(boost::format("%016X") % value);
+}
+
+} // anonymous namespace
+
 std::string crc32Hash(const std::string& content)
 {
    boost::crc_32_type result;
@@ -44,6 +282,111 @@ std::string crc32HexHash(const std::string& content)
    output << std::uppercase << std::hex << result.checksum();
    return output.str();
 }
+
+boost::uint32_t crc32c(const void* pData,
+                       std::size_t size,
+                       boost::uint32_t crc)
+{
+   const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+   crc = ~crc;
+
+#if defined(HASH_CRC32C_SSE42)
+   if (s_haveSse42)
+      return ~crc32cHardware(pBytes, size, crc);
+#elif defined(HASH_CRC32C_ARM)
+   return ~crc32cHardware(pBytes, size, crc);
+#endif
+
+   return ~crc32cSoftware(pBytes, size, crc);
+}
+
+boost::uint64_t xxHash64(const void* pData,
+                         std::size_t size,
+                         boost::uint64_t seed)
+{
+   const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+
+   boost::uint64_t acc[4];
+   xxInitAccumulators(seed, acc);
+   std::size_t consumed = xxConsumeStripes(pBytes, size, acc);
+
+   return xxFinish(acc,
+                   size >= 32,
+                   seed,
+                   size,
+                   pBytes + consumed,
+                   size - consumed);
+}
+
+std::string xxHash64Hex(const std::string& content)
+{
+   return toHex(xxHash64(content.data(), content.size()));
+}
+
+Hasher::Hasher(boost::uint64_t seed)
+   : seed_(seed), totalSize_(0), bufferSize_(0)
+{
+   xxInitAccumulators(seed, acc_);
+}
+
+void Hasher::update(const void* pData, std::size_t size)
+{
+   const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+   totalSize_ += size;
+
+   // complete any partial stripe left by the previous update
+   if (bufferSize_ > 0)
+   {
+      std::size_t count = std::min(size, sizeof(buffer_) - bufferSize_);
+      std::memcpy(buffer_ + bufferSize_, pBytes, count);
+      bufferSize_ += count;
+      pBytes += count;
+      size -= count;
+
+      if (bufferSize_ < sizeof(buffer_))
+         return;
+
+      xxConsumeStripes(buffer_, sizeof(buffer_), acc_);
+      bufferSize_ = 0;
+   }
+
+   std::size_t consumed = xxConsumeStripes(pBytes, size, acc_);
+
+   // save what's left over for next time
+   bufferSize_ = size - consumed;
+   std::memcpy(buffer_, pBytes + consumed, bufferSize_);
+}
+
+void Hasher::update(const std::string& content)
+{
+   update(content.data(), content.size());
+}
+
+boost::uint64_t Hasher::digest() const
+{
+   return xxFinish(acc_,
+                   totalSize_ >= 32,
+                   seed_,
+                   totalSize_,
+                   buffer_,
+                   bufferSize_);
+}
+
+std::string Hasher::hexDigest() const
+{
+   return toHex(digest());
+}
+
+Error fileHash(const FilePath& filePath, std::string* pHash)
+{
+   MappedFile file;
+   Error error = file.open(filePath);
+   if (error)
+      return error;
+
+   *pHash = toHex(xxHash64(file.data(), file.size()));
+   return Success();
+}
    
 } // namespace hash
 } // namespace core 
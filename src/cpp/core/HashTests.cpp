@@ -0,0 +1,102 @@
+/*
+ * HashTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+
+namespace rstudio {
+namespace core {
+namespace hash {
+
+namespace {
+
+boost::uint32_t crc32c(const std::string& content)
+{
+   return hash::crc32c(content.data(), content.size());
+}
+
+boost::uint64_t xxHash64(const std::string& content, boost::uint64_t seed = 0)
+{
+   return hash::xxHash64(content.data(), content.size(), seed);
+}
+
+} // anonymous namespace
+
+context("Hash")
+{
+   test_that("crc32c matches reference values")
+   {
+      expect_true(crc32c("") == 0);
+      expect_true(crc32c("123456789") == 0xE3069283);
+      expect_true(crc32c(std::string(32, '\0')) == 0x8A9136AA);
+      expect_true(crc32c(std::string(32, '\xFF')) == 0x62A8AB43);
+   }
+
+   test_that("crc32c can be continued across buffers")
+   {
+      std::string content = "123456789";
+      boost::uint32_t crc = hash::crc32c(content.data(), 4);
+      crc = hash::crc32c(content.data() + 4, content.size() - 4, crc);
+      expect_true(crc == 0xE3069283);
+   }
+
+   test_that("xxHash64 matches reference values")
+   {
+      expect_true(xxHash64("") == 0xEF46DB3751D8E999ULL);
+      expect_true(xxHash64("abc") == 0x44BC2CF5AD770999ULL);
+      expect_true(xxHash64("xxhash") == 0x32DD38952C4BC720ULL);
+      expect_true(xxHash64("xxhash", 20141025) == 0xB559B98D844E0635ULL);
+      expect_true(xxHash64("Nobody inspects the spammish repetition") ==
+                  0xFBCEA83C8A378BF1ULL);
+      expect_true(xxHash64Hex("abc") == "44BC2CF5AD770999");
+   }
+
+   test_that("hashing in chunks gives the same result")
+   {
+      std::string content;
+      for (int i = 0; i < 1000; i++)
+         content.push_back(static_cast<char>(i * 7));
+
+      for (std::size_t chunkSize = 1; chunkSize < 100; chunkSize += 9)
+      {
+         Hasher hasher;
+         for (std::size_t pos = 0; pos < content.size(); pos += chunkSize)
+            hasher.update(content.substr(pos, chunkSize));
+         expect_true(hasher.digest() == xxHash64(content));
+      }
+
+      expect_true(Hasher().hexDigest() == xxHash64Hex(""));
+   }
+
+   test_that("files can be hashed")
+   {
+      FilePath filePath;
+      expect_false(FilePath::tempFilePath(&filePath));
+      expect_false(writeStringToFile(filePath, "xxhash"));
+
+      std::string hash;
+      expect_false(fileHash(filePath, &hash));
+      expect_true(hash == "32DD38952C4BC720");
+
+      filePath.remove();
+   }
+}
+
+} // namespace hash
+} // namespace core
+} // namespace rstudio
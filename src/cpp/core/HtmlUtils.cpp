@@ -17,7 +17,9 @@
 
 #include <core/system/System.hpp>
 
-#include <boost/format.hpp>
+#include <algorithm>
+#include <cctype>
+
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -52,84 +54,237 @@ std::string defaultTitle(const std::string& htmlContent)
 }
 
 
-Base64ImageFilter::Base64ImageFilter(const FilePath& basePath)
-   : boost::iostreams::regex_filter(
-       boost::regex(
-        "(<\\s*[Ii][Mm][Gg] [^\\>]*[Ss][Rr][Cc]\\s*=\\s*)([\"'])(.*?)(\\2)"),
-        boost::bind(&Base64ImageFilter::toBase64Image, this, _1)),
-     basePath_(basePath)
+// the data uris of the files inlined by a filter, so that repeated
+// references to the same image or font are only read and encoded once
+class InlineAssets : boost::noncopyable
 {
+public:
+   // the data uri for the file (empty if it couldn't be read)
+   const std::string& dataUri(const FilePath& filePath,
+                              const std::string& mimeType)
+   {
+      std::string path = filePath.absolutePath();
+      std::map<std::string,std::string>::const_iterator it = uris_.find(path);
+      if (it != uris_.end())
+         return it->second;
+
+      std::string& uri = uris_[path];
+      std::string encoded;
+      Error error = core::base64::encode(filePath, &encoded);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return uri;
+      }
+
+      std::string prefix = "data:" + mimeType + ";base64,";
+      uri.reserve(prefix.size() + encoded.size());
+      uri.append(prefix);
+      uri.append(encoded);
+      return uri;
+   }
+
+private:
+   std::map<std::string,std::string> uris_;
+};
+
+namespace {
+
+typedef std::vector<char> Chars;
+
+void append(const char* begin, const char* end, Chars* pDest)
+{
+   pDest->insert(pDest->end(), begin, end);
 }
 
+void append(const std::string& str, Chars* pDest)
+{
+   pDest->insert(pDest->end(), str.begin(), str.end());
+}
 
-std::string Base64ImageFilter::toBase64Image(const boost::cmatch& match)
+bool isSpace(char ch)
 {
-   // extract image reference
-   std::string imgRef = match[3];
+   return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' ||
+          ch == '\f' || ch == '\v';
+}
 
-   // url decode it
-   imgRef = http::util::urlDecode(imgRef);
+const char* skipSpace(const char* pos, const char* end)
+{
+   while (pos != end && isSpace(*pos))
+      ++pos;
+   return pos;
+}
 
-   // see if this is an image within the base directory. if it is then
-   // base64 encode it
-   FilePath imagePath = basePath_.childPath(imgRef);
-   if (imagePath.exists() &&
-       boost::algorithm::starts_with(imagePath.mimeContentType(), "image/"))
-   {     
-      std::string imageBase64;
-      Error error = core::base64::encode(imagePath, &imageBase64);
-      if (!error)
+bool matchesNoCase(const char* pos, const char* end, const char* lower)
+{
+   for (; *lower; ++lower, ++pos)
+   {
+      if (pos == end || std::tolower(static_cast<unsigned char>(*pos)) != *lower)
+         return false;
+   }
+   return true;
+}
+
+// the attributes of an <img ...> tag beginning at pos (or NULL if there
+// isn't one)
+const char* imgTagAttributes(const char* pos, const char* end)
+{
+   pos = skipSpace(pos + 1, end);
+   if (!matchesNoCase(pos, end, "img "))
+      return NULL;
+   return pos + 4;
+}
+
+// find the (last) src attribute value of a tag
+bool findSrcValue(const char* attrs,
+                  const char* tagEnd,
+                  const char* end,
+                  const char** pValueBegin,
+                  const char** pValueEnd)
+{
+   for (const char* src = tagEnd - 3; src >= attrs; --src)
+   {
+      if (!matchesNoCase(src, tagEnd, "src"))
+         continue;
+
+      const char* pos = skipSpace(src + 3, tagEnd);
+      if (pos == tagEnd || *pos != '=')
+         continue;
+      pos = skipSpace(pos + 1, tagEnd);
+      if (pos == tagEnd || (*pos != '"' && *pos != '\''))
+         continue;
+
+      // the value itself may extend beyond the tag
+      const char* close = std::find(pos + 1, end, *pos);
+      if (close == end)
+         continue;
+
+      *pValueBegin = pos + 1;
+      *pValueEnd = close;
+      return true;
+   }
+
+   return false;
+}
+
+} // anonymous namespace
+
+Base64ImageFilter::Base64ImageFilter(const FilePath& basePath)
+   : basePath_(basePath), pAssets_(new InlineAssets())
+{
+}
+
+void Base64ImageFilter::do_filter(const vector_type& src, vector_type& dest)
+{
+   dest.reserve(src.size());
+   if (src.empty())
+      return;
+
+   // copy the html through, replacing the src of <img> tags which refer to
+   // images within the base directory with their data uris
+   const char* begin = &src[0];
+   const char* end = begin + src.size();
+   const char* copied = begin;
+   const char* pos = begin;
+   while ((pos = std::find(pos, end, '<')) != end)
+   {
+      const char* attrs = imgTagAttributes(pos, end);
+      if (attrs == NULL)
       {
-         imgRef = "data:" + imagePath.mimeContentType() + ";base64,";
-         imgRef.append(imageBase64);
+         ++pos;
+         continue;
       }
-      else
+
+      const char* tagEnd = std::find(attrs, end, '>');
+      const char* valueBegin;
+      const char* valueEnd;
+      if (!findSrcValue(attrs, tagEnd, end, &valueBegin, &valueEnd))
       {
-         LOG_ERROR(error);
+         pos = attrs;
+         continue;
+      }
+
+      append(copied, valueBegin, &dest);
+
+      // see if this is an image within the base directory (the reference
+      // is url encoded)
+      std::string imgRef = http::util::urlDecode(
+                                       std::string(valueBegin, valueEnd));
+      FilePath imagePath = basePath_.childPath(imgRef);
+      const std::string* pDataUri = NULL;
+      if (imagePath.exists())
+      {
+         std::string mimeType = imagePath.mimeContentType();
+         if (boost::algorithm::starts_with(mimeType, "image/"))
+            pDataUri = &pAssets_->dataUri(imagePath, mimeType);
       }
+
+      if (pDataUri != NULL && !pDataUri->empty())
+         append(*pDataUri, &dest);
+      else
+         append(valueBegin, valueEnd, &dest);
+
+      copied = pos = valueEnd;
    }
 
-   // return the filtered result
-   return match[1] + match[2] + imgRef + match[4];
+   append(copied, end, &dest);
 }
 
 // convert fonts to base64
 
 CssUrlFilter::CssUrlFilter(const FilePath& basePath)
-   : boost::iostreams::regex_filter(
-        boost::regex("url\\('([^'']+)'\\)"),
-        boost::bind(&CssUrlFilter::toBase64Url, this, _1)),
-     basePath_(basePath)
+   : basePath_(basePath), pAssets_(new InlineAssets())
 {
 }
 
-std::string CssUrlFilter::toBase64Url(const boost::cmatch& match)
+void CssUrlFilter::do_filter(const vector_type& src, vector_type& dest)
 {
-   // is this a local file?
-   std::string urlRef = match[1];
-   FilePath urlPath = basePath_.childPath(urlRef);
-   std::string ext = urlPath.extensionLowerCase();
-   if (urlPath.exists() && (ext == ".ttf" || ext == ".otf"))
+   dest.reserve(src.size());
+   if (src.empty())
+      return;
+
+   // copy the css through, replacing url('...') references to local
+   // truetype and opentype fonts with their data uris
+   const char* begin = &src[0];
+   const char* end = begin + src.size();
+   const char* copied = begin;
+   const char* pos = begin;
+   const std::size_t kUrlLength = 5; // url('
+   while ((pos = std::search(pos, end, "url('", "url('" + kUrlLength)) != end)
    {
-      std::string fontBase64;
-      Error error = core::base64::encode(urlPath, &fontBase64);
-      if (!error)
+      const char* valueBegin = pos + kUrlLength;
+      const char* valueEnd = std::find(valueBegin, end, '\'');
+      if (valueEnd == valueBegin || valueEnd == end ||
+          valueEnd + 1 == end || *(valueEnd + 1) != ')')
+      {
+         ++pos;
+         continue;
+      }
+
+      // is this a local font?
+      FilePath urlPath = basePath_.childPath(std::string(valueBegin, valueEnd));
+      std::string ext = urlPath.extensionLowerCase();
+      const std::string* pDataUri = NULL;
+      if ((ext == ".ttf" || ext == ".otf") && urlPath.exists())
       {
-         // return base64 encoded font
          std::string type = (ext == ".ttf") ? "truetype" : "opentype";
-         boost::format fmt("url(data:font/%1%;base64,%2%)");
-         return boost::str(fmt % type % fontBase64);
+         pDataUri = &pAssets_->dataUri(urlPath, "font/" + type);
       }
-      else
+
+      const char* urlEnd = valueEnd + 2;
+      if (pDataUri != NULL && !pDataUri->empty())
       {
-         LOG_ERROR(error);
-         return match[0];
+         append(copied, pos, &dest);
+         append("url(", &dest);
+         append(*pDataUri, &dest);
+         append(")", &dest);
+         copied = urlEnd;
       }
+
+      pos = urlEnd;
    }
-   else
-   {
-      return match[0];
-   }
+
+   append(copied, end, &dest);
 }
 
 TextRange findClosestRange(std::string::const_iterator pos,
@@ -148,88 +303,79 @@ TextRange findClosestRange(std::string::const_iterator pos,
 
 void HtmlPreserver::preserve(std::string* pInput)
 {
-   // begin and end regexes
-   boost::regex beginPreserve("<!--html_preserve-->");
-   boost::regex endPreserve("<!--\\/html_preserve-->");
+   const std::string kBeginPreserve = "<!--html_preserve-->";
+   const std::string kEndPreserve = "<!--/html_preserve-->";
 
-   // discover ranges we need to preserve
-   std::vector<TextRange> ranges;
-   std::string::const_iterator pos = pInput->begin();
-   std::string::const_iterator inputEnd = pInput->end();
-   while (pos != inputEnd)
+   // substitute guids for all of the preserved ranges
+   const std::string& input = *pInput;
+   std::string modifiedInput;
+   modifiedInput.reserve(input.size());
+   std::string::size_type pos = 0;
+   while (pos < input.size())
    {
       // look for begin marker
-      boost::smatch m;
-      if (boost::regex_search(pos, inputEnd, m, beginPreserve))
+      std::string::size_type begin = input.find(kBeginPreserve, pos);
+      if (begin == std::string::npos)
       {
-         // set begin iterator
-         std::string::const_iterator begin = m[0].first;
-         std::string::const_iterator end = m[0].second;
-
-         // look for end marker
-         if (boost::regex_search(end, inputEnd, m, endPreserve))
-         {
-            // update end to be the end of the match
-            end = m[0].second;
-         }
-         else
-         {
-            // didn't find a matching end pattern so set the end to the
-            // end of the document -- this will cause us to exclude the
-            // rest of the document from processing
-            end = inputEnd;
-         }
-
-         // mark everything before the match as requiring processing
-         ranges.push_back(TextRange(true, pos, begin));
-
-         // add the matched range to our list
-         ranges.push_back(TextRange(false, begin, end));
-
-         // update the position
-         pos = end + 1;
-
+         modifiedInput.append(input, pos, std::string::npos);
+         break;
       }
-      else
-      {
-         // no more preserve regions, set termination condition
-         ranges.push_back(TextRange(true, pos, pInput->end()));
-         pos = inputEnd;
-      }
-   }
 
-   // substitute guids for all of the matched ranges
-   std::string modifiedInput;
-   for (std::vector<TextRange>::iterator it = ranges.begin();
-        it != ranges.end(); it++)
-   {
-      if (it->process)
-      {
-         modifiedInput += std::string(it->begin, it->end);
-      }
+      // look for end marker (if there isn't one then the rest of the
+      // document is excluded from processing)
+      std::string::size_type end = input.find(kEndPreserve,
+                                              begin + kBeginPreserve.size());
+      if (end == std::string::npos)
+         end = input.size();
       else
-      {
-         std::string guid = core::system::generateUuid();
-         std::string html = std::string(it->begin, it->end);
-         preserved_[guid] = html;
-         modifiedInput += guid;
-      }
+         end += kEndPreserve.size();
+
+      modifiedInput.append(input, pos, begin - pos);
+      std::string guid = core::system::generateUuid();
+      preserved_[guid] = input.substr(begin, end - begin);
+      modifiedInput.append(guid);
+
+      // continue after the character following the range
+      pos = end + 1;
    }
 
    // return the modified input
-   *pInput = modifiedInput;
-
+   pInput->swap(modifiedInput);
 }
 
 void HtmlPreserver::restore(std::string* pOutput)
 {
-   typedef std::pair<std::string,std::string> StringPair;
-   BOOST_FOREACH(const StringPair& preserve, preserved_)
+   if (preserved_.empty())
+      return;
+
+   // locate the guids and then rebuild the output once (rather than once
+   // per preserved range)
+   typedef std::map<std::string,std::string>::value_type Preserved;
+   std::vector<std::pair<std::string::size_type, const Preserved*> > found;
+   std::string::size_type restoredSize = pOutput->size();
+   BOOST_FOREACH(const Preserved& preserve, preserved_)
+   {
+      std::string::size_type pos = pOutput->find(preserve.first);
+      if (pos != std::string::npos)
+      {
+         found.push_back(std::make_pair(pos, &preserve));
+         restoredSize += preserve.second.size();
+      }
+   }
+   std::sort(found.begin(), found.end());
+
+   std::string restored;
+   restored.reserve(restoredSize);
+   std::string::size_type pos = 0;
+   for (std::size_t i = 0; i < found.size(); i++)
    {
-      boost::algorithm::replace_first(*pOutput,
-                                      preserve.first,
-                                      preserve.second);
+      restored.append(*pOutput, pos, found[i].first - pos);
+      restored.append(found[i].second->second);
+      pos = found[i].first + found[i].second->first.size();
    }
+   restored.append(*pOutput, pos, std::string::npos);
+
+   pOutput->swap(restored);
 }
 
 
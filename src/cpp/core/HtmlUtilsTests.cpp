@@ -0,0 +1,87 @@
+/*
+ * HtmlUtilsTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/HtmlUtils.hpp>
+
+#include <sstream>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace html_utils {
+
+namespace {
+
+template <typename Filter>
+std::string filter(const Filter& filter, const std::string& input)
+{
+   std::istringstream is(input);
+   std::ostringstream os;
+   boost::iostreams::filtering_ostream filteredStream;
+   filteredStream.push(filter);
+   filteredStream.push(os);
+   boost::iostreams::copy(is, filteredStream);
+   return os.str();
+}
+
+} // anonymous namespace
+
+context("HtmlUtils")
+{
+   test_that("Preserved ranges are restored")
+   {
+      std::string input = "a<!--html_preserve-->x<!--/html_preserve-->\n"
+                          "b<!--html_preserve-->y<!--/html_preserve-->\n";
+
+      HtmlPreserver preserver;
+      std::string html = input;
+      preserver.preserve(&html);
+      expect_true(html.find("html_preserve") == std::string::npos);
+
+      preserver.restore(&html);
+      expect_true(html == "a<!--html_preserve-->x<!--/html_preserve-->"
+                          "b<!--html_preserve-->y<!--/html_preserve-->");
+   }
+
+   test_that("Unterminated preserved ranges extend to the end")
+   {
+      HtmlPreserver preserver;
+      std::string html = "a<!--html_preserve-->b";
+      preserver.preserve(&html);
+      expect_true(html.find("<!--") == std::string::npos);
+      preserver.restore(&html);
+      expect_true(html == "a<!--html_preserve-->b");
+   }
+
+   test_that("Images which can't be inlined are left as they are")
+   {
+      std::string html = "<p><IMG alt='x' src=\"missing%20image.png\">"
+                         "<img src='missing.png'/><imgs src='a.png'></p>";
+      Base64ImageFilter imageFilter(FilePath("/nonexistent/directory"));
+      expect_true(filter(imageFilter, html) == html);
+
+      std::string css = "a { src: url('missing.ttf'); } b { url('') }";
+      CssUrlFilter cssFilter(FilePath("/nonexistent/directory"));
+      expect_true(filter(cssFilter, css) == css);
+   }
+}
+
+} // namespace html_utils
+} // namespace core
+} // namespace rstudio
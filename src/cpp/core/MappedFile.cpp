@@ -0,0 +1,117 @@
+/*
+ * MappedFile.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/MappedFile.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+
+struct MappedFile::Impl
+{
+   Impl() : isOpen(false) {}
+   bool isOpen;
+   boost::iostreams::mapped_file_source source;
+};
+
+MappedFile::MappedFile()
+   : pImpl_(new Impl())
+{
+}
+
+MappedFile::~MappedFile()
+{
+   try
+   {
+      close();
+   }
+   catch(...)
+   {
+   }
+}
+
+Error MappedFile::open(const FilePath& filePath)
+{
+   close();
+
+   if (!filePath.exists())
+      return fileNotFoundError(filePath, ERROR_LOCATION);
+
+   try
+   {
+#ifdef _WIN32
+      boost::filesystem::path path(filePath.absolutePathW());
+#else
+      boost::filesystem::path path(filePath.absolutePath());
+#endif
+
+      // empty files can't be mapped (they're simply an empty view)
+      if (boost::filesystem::file_size(path) > 0)
+         pImpl_->source.open(path);
+
+      pImpl_->isOpen = true;
+      return Success();
+   }
+   catch(const boost::filesystem::filesystem_error& e)
+   {
+      Error error(e.code(), ERROR_LOCATION);
+      error.addProperty("path", filePath.absolutePath());
+      return error;
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", filePath.absolutePath());
+      return error;
+   }
+}
+
+void MappedFile::close()
+{
+   if (pImpl_->source.is_open())
+      pImpl_->source.close();
+   pImpl_->isOpen = false;
+}
+
+bool MappedFile::isOpen() const
+{
+   return pImpl_->isOpen;
+}
+
+const char* MappedFile::data() const
+{
+   if (pImpl_->source.is_open())
+      return pImpl_->source.data();
+   else
+      return NULL;
+}
+
+std::size_t MappedFile::size() const
+{
+   if (pImpl_->source.is_open())
+      return pImpl_->source.size();
+   else
+      return 0;
+}
+
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,92 @@
+/*
+ * MappedFileTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/MappedFile.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+context("MappedFile")
+{
+   test_that("file contents can be viewed")
+   {
+      FilePath filePath;
+      expect_false(FilePath::tempFilePath(&filePath));
+      expect_false(writeStringToFile(filePath, "hello\nworld"));
+
+      MappedFile file;
+      expect_false(file.isOpen());
+      expect_false(file.open(filePath));
+      expect_true(file.isOpen());
+      expect_true(std::string(file.begin(), file.end()) == "hello\nworld");
+
+      file.close();
+      expect_false(file.isOpen());
+      expect_true(file.empty());
+      expect_false(filePath.remove());
+   }
+
+   test_that("empty and missing files are handled")
+   {
+      FilePath filePath;
+      expect_false(FilePath::tempFilePath(&filePath));
+
+      MappedFile file;
+      expect_true(file.open(filePath));
+      expect_false(file.isOpen());
+
+      expect_false(filePath.ensureFile());
+      expect_false(file.open(filePath));
+      expect_true(file.isOpen());
+      expect_true(file.empty());
+      expect_false(filePath.remove());
+   }
+
+   test_that("large files are read with line endings converted")
+   {
+      std::string contents;
+      std::string expected;
+      for (int i = 0; i < 100000; i++)
+      {
+         contents += "line of text\r\n";
+         expected += "line of text\n";
+      }
+
+      FilePath filePath;
+      expect_false(FilePath::tempFilePath(&filePath));
+      expect_false(writeStringToFile(filePath, contents));
+
+      std::string posix;
+      expect_false(readStringFromFile(filePath,
+                                      &posix,
+                                      string_utils::LineEndingPosix));
+      expect_true(posix == expected);
+
+      std::string passthrough;
+      expect_false(readStringFromFile(filePath, &passthrough));
+      expect_true(passthrough == contents);
+
+      expect_false(filePath.remove());
+   }
+}
+
+} // end namespace tests
+} // end namespace core
+} // end namespace rstudio
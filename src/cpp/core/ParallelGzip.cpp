@@ -0,0 +1,623 @@
+/*
+ * ParallelGzip.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/ParallelGzip.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <zlib.h>
+
+#include <core/BoostThread.hpp>
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+
+namespace {
+
+// amount of input compressed into each gzip member
+const std::size_t kChunkSize = 4 * 1024 * 1024;
+
+// member header: the fixed gzip header (with FEXTRA set) followed by a
+// single extra subfield ('R', 'S') holding the total size of the member
+const std::size_t kHeaderSize = 20;
+const std::size_t kTrailerSize = 8;
+const std::size_t kMemberSizeOffset = 16;
+
+void writeUInt32(boost::uint32_t value, unsigned char* pOutput)
+{
+   pOutput[0] = static_cast<unsigned char>(value & 0xff);
+   pOutput[1] = static_cast<unsigned char>((value >> 8) & 0xff);
+   pOutput[2] = static_cast<unsigned char>((value >> 16) & 0xff);
+   pOutput[3] = static_cast<unsigned char>((value >> 24) & 0xff);
+}
+
+boost::uint32_t readUInt32(const unsigned char* pInput)
+{
+   return static_cast<boost::uint32_t>(pInput[0]) |
+          (static_cast<boost::uint32_t>(pInput[1]) << 8) |
+          (static_cast<boost::uint32_t>(pInput[2]) << 16) |
+          (static_cast<boost::uint32_t>(pInput[3]) << 24);
+}
+
+void writeHeader(unsigned char* pHeader)
+{
+   const unsigned char header[] = {
+      0x1f, 0x8b,             // magic
+      Z_DEFLATED,             // compression method
+      0x04,                   // flags (FEXTRA)
+      0, 0, 0, 0,             // mtime (none)
+      0,                      // extra flags
+      0xff,                   // os (unknown)
+      8, 0,                   // XLEN
+      'R', 'S', 4, 0,         // subfield id and length
+      0, 0, 0, 0              // member size (filled in after compression)
+   };
+   std::copy(header, header + kHeaderSize, pHeader);
+}
+
+// returns the total size of the member, or 0 if the header isn't one of ours
+std::size_t readHeader(const unsigned char* pHeader)
+{
+   if (pHeader[0] != 0x1f || pHeader[1] != 0x8b ||
+       pHeader[2] != Z_DEFLATED || pHeader[3] != 0x04 ||
+       pHeader[10] != 8 || pHeader[11] != 0 ||
+       pHeader[12] != 'R' || pHeader[13] != 'S' ||
+       pHeader[14] != 4 || pHeader[15] != 0)
+   {
+      return 0;
+   }
+
+   std::size_t memberSize = readUInt32(pHeader + kMemberSizeOffset);
+   if (memberSize < kHeaderSize + kTrailerSize)
+      return 0;
+
+   return memberSize;
+}
+
+Error dataError(const std::string& reason, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::illegal_byte_sequence,
+                             location);
+   error.addProperty("reason", reason);
+   return error;
+}
+
+struct Chunk
+{
+   Chunk() : done(false) {}
+
+   std::vector<unsigned char> input;
+   std::vector<unsigned char> output;
+   bool done;
+   std::string error;
+};
+
+typedef boost::shared_ptr<Chunk> ChunkPtr;
+
+void compressChunk(int level, Chunk* pChunk)
+{
+   z_stream stream;
+   stream.zalloc = Z_NULL;
+   stream.zfree = Z_NULL;
+   stream.opaque = Z_NULL;
+   if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK)
+   {
+      pChunk->error = "deflateInit2 failed";
+      return;
+   }
+
+   uLong inputSize = static_cast<uLong>(pChunk->input.size());
+   uLong bound = deflateBound(&stream, inputSize);
+   pChunk->output.resize(kHeaderSize + bound + kTrailerSize);
+   writeHeader(&pChunk->output[0]);
+
+   stream.next_in = pChunk->input.empty() ? Z_NULL : &pChunk->input[0];
+   stream.avail_in = static_cast<uInt>(inputSize);
+   stream.next_out = &pChunk->output[kHeaderSize];
+   stream.avail_out = static_cast<uInt>(bound);
+   int result = deflate(&stream, Z_FINISH);
+   std::size_t compressedSize = stream.total_out;
+   deflateEnd(&stream);
+   if (result != Z_STREAM_END)
+   {
+      pChunk->error = "deflate failed";
+      return;
+   }
+
+   uLong crc = crc32(0L, Z_NULL, 0);
+   if (!pChunk->input.empty())
+      crc = crc32(crc, &pChunk->input[0], static_cast<uInt>(inputSize));
+
+   std::size_t memberSize = kHeaderSize + compressedSize + kTrailerSize;
+   unsigned char* pTrailer = &pChunk->output[kHeaderSize + compressedSize];
+   writeUInt32(static_cast<boost::uint32_t>(crc), pTrailer);
+   writeUInt32(static_cast<boost::uint32_t>(inputSize), pTrailer + 4);
+   writeUInt32(static_cast<boost::uint32_t>(memberSize),
+               &pChunk->output[kMemberSizeOffset]);
+   pChunk->output.resize(memberSize);
+
+   // release the input now rather than when the chunk is written
+   std::vector<unsigned char>().swap(pChunk->input);
+}
+
+void decompressChunk(Chunk* pChunk)
+{
+   // the input is a whole member (header, deflate data, and trailer)
+   std::size_t memberSize = pChunk->input.size();
+   const unsigned char* pTrailer = &pChunk->input[memberSize - kTrailerSize];
+   boost::uint32_t expectedCrc = readUInt32(pTrailer);
+   boost::uint32_t outputSize = readUInt32(pTrailer + 4);
+
+   z_stream stream;
+   stream.zalloc = Z_NULL;
+   stream.zfree = Z_NULL;
+   stream.opaque = Z_NULL;
+   stream.next_in = Z_NULL;
+   stream.avail_in = 0;
+   if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+   {
+      pChunk->error = "inflateInit2 failed";
+      return;
+   }
+
+   // (an extra byte of output space lets us detect oversized data)
+   pChunk->output.resize(outputSize + 1);
+   stream.next_in = &pChunk->input[kHeaderSize];
+   stream.avail_in = static_cast<uInt>(memberSize - kHeaderSize - kTrailerSize);
+   stream.next_out = &pChunk->output[0];
+   stream.avail_out = static_cast<uInt>(pChunk->output.size());
+   int result = inflate(&stream, Z_FINISH);
+   std::size_t decompressedSize = stream.total_out;
+   inflateEnd(&stream);
+   if (result != Z_STREAM_END || decompressedSize != outputSize)
+   {
+      pChunk->error = "inflate failed";
+      return;
+   }
+   pChunk->output.resize(outputSize);
+
+   uLong crc = crc32(0L, Z_NULL, 0);
+   if (outputSize > 0)
+      crc = crc32(crc, &pChunk->output[0], static_cast<uInt>(outputSize));
+   if (static_cast<boost::uint32_t>(crc) != expectedCrc)
+   {
+      pChunk->error = "crc mismatch";
+      return;
+   }
+
+   std::vector<unsigned char>().swap(pChunk->input);
+}
+
+unsigned int workerThreads()
+{
+   unsigned int threads = boost::thread::hardware_concurrency();
+   return std::max(1u, std::min(threads, 8u));
+}
+
+// number of chunks to keep in flight (bounds memory use)
+std::size_t maxChunksInFlight()
+{
+   return 2 * workerThreads();
+}
+
+// fixed set of threads which process chunks in the order they're submitted
+// (these are only started once a file spans more than one chunk, so small
+// files are handled entirely on the calling thread)
+class ChunkWorkers : boost::noncopyable
+{
+public:
+   explicit ChunkWorkers(const boost::function<void(Chunk*)>& process)
+      : process_(process), stopping_(false)
+   {
+      unsigned int threads = workerThreads();
+      for (unsigned int i = 0; i < threads; i++)
+         threads_.create_thread(boost::bind(&ChunkWorkers::run, this));
+   }
+
+   virtual ~ChunkWorkers()
+   {
+      try
+      {
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            stopping_ = true;
+         }
+         queued_.notify_all();
+         threads_.join_all();
+      }
+      catch(...)
+      {
+      }
+   }
+
+   void submit(const ChunkPtr& pChunk)
+   {
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         queue_.push_back(pChunk);
+      }
+      queued_.notify_one();
+   }
+
+   void wait(const ChunkPtr& pChunk)
+   {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (!pChunk->done)
+         completed_.wait(lock);
+   }
+
+private:
+   void run()
+   {
+      while (true)
+      {
+         ChunkPtr pChunk;
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (queue_.empty() && !stopping_)
+               queued_.wait(lock);
+            if (queue_.empty())
+               return;
+            pChunk = queue_.front();
+            queue_.pop_front();
+         }
+
+         process_(pChunk.get());
+
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            pChunk->done = true;
+         }
+         completed_.notify_all();
+      }
+   }
+
+   boost::function<void(Chunk*)> process_;
+   boost::mutex mutex_;
+   boost::condition_variable queued_;
+   boost::condition_variable completed_;
+   std::deque<ChunkPtr> queue_;
+   bool stopping_;
+   boost::thread_group threads_;
+};
+
+} // anonymous namespace
+
+struct ParallelGzipWriter::Impl
+{
+   Impl() : level(1), wroteChunk(false) {}
+
+   boost::shared_ptr<std::ostream> pStream;
+   int level;
+   boost::scoped_ptr<ChunkWorkers> pWorkers;
+   ChunkPtr pCurrent;
+   std::deque<ChunkPtr> inFlight;
+   bool wroteChunk;
+   Error error;
+
+   // write the oldest in-flight chunk once it's been compressed
+   void writeNext()
+   {
+      ChunkPtr pChunk = inFlight.front();
+      inFlight.pop_front();
+      if (pWorkers)
+         pWorkers->wait(pChunk);
+      if (error)
+         return;
+
+      if (!pChunk->error.empty())
+      {
+         error = dataError(pChunk->error, ERROR_LOCATION);
+         return;
+      }
+
+      pStream->write(reinterpret_cast<const char*>(&pChunk->output[0]),
+                     pChunk->output.size());
+      if (pStream->fail())
+         error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+   }
+
+   void submitCurrent()
+   {
+      if (!pWorkers)
+      {
+         pWorkers.reset(new ChunkWorkers(boost::bind(compressChunk,
+                                                     level, _1)));
+      }
+
+      pWorkers->submit(pCurrent);
+      inFlight.push_back(pCurrent);
+      pCurrent.reset();
+      wroteChunk = true;
+
+      while (inFlight.size() > maxChunksInFlight())
+         writeNext();
+   }
+};
+
+ParallelGzipWriter::ParallelGzipWriter()
+   : pImpl_(new Impl())
+{
+}
+
+ParallelGzipWriter::~ParallelGzipWriter()
+{
+   try
+   {
+      // wait for (and discard) any outstanding chunks
+      pImpl_->pWorkers.reset();
+   }
+   catch(...)
+   {
+   }
+}
+
+Error ParallelGzipWriter::open(const FilePath& filePath, int level)
+{
+   pImpl_.reset(new Impl());
+   Error error = filePath.open_w(&pImpl_->pStream);
+   if (error)
+      return error;
+
+   pImpl_->level = std::max(0, std::min(level, 9));
+   return Success();
+}
+
+Error ParallelGzipWriter::write(const char* data, std::size_t size)
+{
+   if (pImpl_->error)
+      return pImpl_->error;
+
+   while (size > 0)
+   {
+      if (!pImpl_->pCurrent)
+      {
+         pImpl_->pCurrent.reset(new Chunk());
+         pImpl_->pCurrent->input.reserve(kChunkSize);
+      }
+
+      std::vector<unsigned char>& input = pImpl_->pCurrent->input;
+      std::size_t count = std::min(size, kChunkSize - input.size());
+      input.insert(input.end(),
+                   reinterpret_cast<const unsigned char*>(data),
+                   reinterpret_cast<const unsigned char*>(data) + count);
+      data += count;
+      size -= count;
+
+      if (input.size() == kChunkSize)
+      {
+         pImpl_->submitCurrent();
+         if (pImpl_->error)
+            return pImpl_->error;
+      }
+   }
+
+   return Success();
+}
+
+Error ParallelGzipWriter::close()
+{
+   if (!pImpl_->pStream)
+      return pImpl_->error;
+
+   // always write at least one member so the file is valid gzip
+   if (pImpl_->pCurrent || !pImpl_->wroteChunk)
+   {
+      if (!pImpl_->pCurrent)
+         pImpl_->pCurrent.reset(new Chunk());
+
+      if (pImpl_->pWorkers)
+      {
+         pImpl_->submitCurrent();
+      }
+      else
+      {
+         // single chunk file, compress it here
+         compressChunk(pImpl_->level, pImpl_->pCurrent.get());
+         pImpl_->inFlight.push_back(pImpl_->pCurrent);
+         pImpl_->pCurrent.reset();
+         pImpl_->wroteChunk = true;
+      }
+   }
+
+   while (!pImpl_->inFlight.empty())
+      pImpl_->writeNext();
+
+   pImpl_->pStream->flush();
+   if (pImpl_->pStream->fail() && !pImpl_->error)
+      pImpl_->error = systemError(boost::system::errc::io_error,
+                                  ERROR_LOCATION);
+
+   pImpl_->pStream.reset();
+   pImpl_->pWorkers.reset();
+   return pImpl_->error;
+}
+
+struct ParallelGzipReader::Impl
+{
+   Impl() : eof(false), offset(0) {}
+
+   boost::shared_ptr<std::istream> pStream;
+   boost::scoped_ptr<ChunkWorkers> pWorkers;
+   std::deque<ChunkPtr> inFlight;
+   bool eof;
+   ChunkPtr pCurrent;
+   std::size_t offset;
+   Error error;
+
+   // read the next member from the file and queue it for decompression
+   void readNext()
+   {
+      unsigned char header[kHeaderSize];
+      pStream->read(reinterpret_cast<char*>(header), kHeaderSize);
+      if (pStream->gcount() == 0 && pStream->eof())
+      {
+         eof = true;
+         return;
+      }
+
+      std::size_t memberSize = 0;
+      if (static_cast<std::size_t>(pStream->gcount()) == kHeaderSize)
+         memberSize = readHeader(header);
+      if (memberSize == 0)
+      {
+         error = dataError("invalid member header", ERROR_LOCATION);
+         return;
+      }
+
+      ChunkPtr pChunk(new Chunk());
+      pChunk->input.resize(memberSize);
+      std::copy(header, header + kHeaderSize, pChunk->input.begin());
+      pStream->read(reinterpret_cast<char*>(&pChunk->input[kHeaderSize]),
+                    memberSize - kHeaderSize);
+      if (static_cast<std::size_t>(pStream->gcount()) !=
+          memberSize - kHeaderSize)
+      {
+         error = dataError("truncated member", ERROR_LOCATION);
+         return;
+      }
+
+      // a file with a single member is decompressed on this thread
+      if (!pWorkers && inFlight.empty() &&
+          pStream->peek() == std::istream::traits_type::eof())
+      {
+         decompressChunk(pChunk.get());
+         eof = true;
+      }
+      else
+      {
+         if (!pWorkers)
+            pWorkers.reset(new ChunkWorkers(decompressChunk));
+         pWorkers->submit(pChunk);
+      }
+      inFlight.push_back(pChunk);
+   }
+
+   void fill()
+   {
+      while (!eof && !error && inFlight.size() < maxChunksInFlight())
+         readNext();
+   }
+};
+
+bool ParallelGzipReader::isParallelGzipFile(const FilePath& filePath)
+{
+   boost::shared_ptr<std::istream> pStream;
+   Error error = filePath.open_r(&pStream);
+   if (error)
+      return false;
+
+   unsigned char header[kHeaderSize];
+   pStream->read(reinterpret_cast<char*>(header), kHeaderSize);
+   if (static_cast<std::size_t>(pStream->gcount()) != kHeaderSize)
+      return false;
+
+   return readHeader(header) != 0;
+}
+
+ParallelGzipReader::ParallelGzipReader()
+   : pImpl_(new Impl())
+{
+}
+
+ParallelGzipReader::~ParallelGzipReader()
+{
+   try
+   {
+      close();
+   }
+   catch(...)
+   {
+   }
+}
+
+Error ParallelGzipReader::open(const FilePath& filePath)
+{
+   pImpl_.reset(new Impl());
+   Error error = filePath.open_r(&pImpl_->pStream);
+   if (error)
+      return error;
+
+   pImpl_->fill();
+   return pImpl_->error;
+}
+
+Error ParallelGzipReader::read(char* data, std::size_t size,
+                               std::size_t* pRead)
+{
+   *pRead = 0;
+   while (size > 0)
+   {
+      // move on to the next chunk once this one is consumed
+      if (!pImpl_->pCurrent ||
+          pImpl_->offset == pImpl_->pCurrent->output.size())
+      {
+         if (pImpl_->error)
+            return pImpl_->error;
+         if (pImpl_->inFlight.empty())
+            return Success();
+
+         pImpl_->pCurrent = pImpl_->inFlight.front();
+         pImpl_->inFlight.pop_front();
+         pImpl_->offset = 0;
+         if (pImpl_->pWorkers)
+            pImpl_->pWorkers->wait(pImpl_->pCurrent);
+         pImpl_->fill();
+
+         if (!pImpl_->pCurrent->error.empty())
+         {
+            pImpl_->error = dataError(pImpl_->pCurrent->error,
+                                      ERROR_LOCATION);
+            return pImpl_->error;
+         }
+         continue;
+      }
+
+      const std::vector<unsigned char>& output = pImpl_->pCurrent->output;
+      std::size_t count = std::min(size, output.size() - pImpl_->offset);
+      std::copy(output.begin() + pImpl_->offset,
+                output.begin() + pImpl_->offset + count,
+                data);
+      pImpl_->offset += count;
+      data += count;
+      size -= count;
+      *pRead += count;
+   }
+
+   return Success();
+}
+
+void ParallelGzipReader::close()
+{
+   pImpl_->pWorkers.reset();
+   pImpl_->pStream.reset();
+   pImpl_->inFlight.clear();
+   pImpl_->pCurrent.reset();
+}
+
+} // namespace core
+} // namespace rstudio
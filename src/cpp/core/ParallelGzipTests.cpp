@@ -0,0 +1,109 @@
+/*
+ * ParallelGzipTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/ParallelGzip.hpp>
+#include <core/SafeConvert.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+std::string readAll(const FilePath& filePath)
+{
+   ParallelGzipReader reader;
+   if (reader.open(filePath))
+      return std::string();
+
+   std::string contents;
+   char buffer[65536];
+   std::size_t read = 0;
+   do
+   {
+      if (reader.read(buffer, sizeof(buffer), &read))
+         return std::string();
+      contents.append(buffer, read);
+   } while (read == sizeof(buffer));
+
+   return contents;
+}
+
+} // anonymous namespace
+
+context("ParallelGzip")
+{
+   test_that("multiple chunks round trip")
+   {
+      std::string contents;
+      for (int i = 0; contents.size() < 10 * 1024 * 1024; i++)
+         contents += safe_convert::numberToString(i) + " lines of text\n";
+
+      FilePath filePath;
+      expect_false(FilePath::tempFilePath(&filePath));
+
+      ParallelGzipWriter writer;
+      expect_false(writer.open(filePath));
+      for (std::size_t i = 0; i < contents.size(); i += 100000)
+      {
+         std::size_t size = std::min<std::size_t>(100000, contents.size() - i);
+         expect_false(writer.write(contents.data() + i, size));
+      }
+      expect_false(writer.close());
+
+      expect_true(ParallelGzipReader::isParallelGzipFile(filePath));
+      expect_true(filePath.size() < static_cast<uintmax_t>(contents.size()));
+      expect_true(readAll(filePath) == contents);
+      expect_false(filePath.remove());
+   }
+
+   test_that("empty and uncompressed files round trip")
+   {
+      FilePath filePath;
+      expect_false(FilePath::tempFilePath(&filePath));
+
+      ParallelGzipWriter writer;
+      expect_false(writer.open(filePath, 0));
+      expect_false(writer.close());
+      expect_true(ParallelGzipReader::isParallelGzipFile(filePath));
+      expect_true(readAll(filePath).empty());
+
+      expect_false(writer.open(filePath, 0));
+      expect_false(writer.write("hello", 5));
+      expect_false(writer.close());
+      expect_true(readAll(filePath) == "hello");
+      expect_false(filePath.remove());
+   }
+
+   test_that("other files are not recognized")
+   {
+      FilePath filePath;
+      expect_false(FilePath::tempFilePath(&filePath));
+      expect_false(writeStringToFile(filePath, "not a gzip file at all"));
+      expect_false(ParallelGzipReader::isParallelGzipFile(filePath));
+
+      ParallelGzipReader reader;
+      expect_true(reader.open(filePath));
+      expect_false(filePath.remove());
+   }
+}
+
+} // end namespace tests
+} // end namespace core
+} // end namespace rstudio
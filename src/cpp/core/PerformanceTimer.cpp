@@ -18,6 +18,8 @@
 #include <iostream>
 #include <iomanip>
 
+#include <core/Trace.hpp>
+
 using namespace boost::posix_time;
 
 namespace rstudio {
@@ -92,7 +94,13 @@ bool PerformanceTimer::running() const
 void PerformanceTimer::recordPendingStep()
 {
    if (!steps_.empty())
-      steps_.back().second = now() - startTime_;
+   {
+      ptime endTime = now();
+      steps_.back().second = endTime - startTime_;
+
+      // steps also show up as spans when tracing is enabled
+      trace::recordSpan(steps_.back().first, startTime_, endTime);
+   }
 }
  
 boost::posix_time::ptime PerformanceTimer::now() const
@@ -0,0 +1,288 @@
+/*
+ * PngEncoder.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/PngEncoder.hpp>
+
+#include <algorithm>
+#include <ostream>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <zlib.h>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+namespace png {
+
+namespace {
+
+const unsigned char kPngSignature[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+// BMP compression types
+const boost::uint32_t kBmpRgb = 0;
+const boost::uint32_t kBmpBitfields = 3;
+
+// PNG row filter (each byte is stored as the difference from the byte
+// above it, which suits plots' long runs of identical rows well)
+const unsigned char kFilterUp = 2;
+
+Error formatError(const ErrorLocation& location)
+{
+   return systemError(boost::system::errc::illegal_byte_sequence, location);
+}
+
+boost::uint32_t readUInt32(const std::string& data, std::size_t offset)
+{
+   const unsigned char* p =
+         reinterpret_cast<const unsigned char*>(data.data()) + offset;
+   return static_cast<boost::uint32_t>(p[0]) |
+          (static_cast<boost::uint32_t>(p[1]) << 8) |
+          (static_cast<boost::uint32_t>(p[2]) << 16) |
+          (static_cast<boost::uint32_t>(p[3]) << 24);
+}
+
+boost::uint16_t readUInt16(const std::string& data, std::size_t offset)
+{
+   const unsigned char* p =
+         reinterpret_cast<const unsigned char*>(data.data()) + offset;
+   return static_cast<boost::uint16_t>(p[0] | (p[1] << 8));
+}
+
+// byte within a little-endian 32 bit pixel selected by a channel mask
+// (returns -1 for masks which don't select a whole byte)
+int maskByte(boost::uint32_t mask)
+{
+   for (int i = 0; i < 4; i++)
+   {
+      if (mask == (0xFFu << (i * 8)))
+         return i;
+   }
+   return -1;
+}
+
+void appendUInt32(boost::uint32_t value, std::string* pData)
+{
+   pData->push_back(static_cast<char>((value >> 24) & 0xFF));
+   pData->push_back(static_cast<char>((value >> 16) & 0xFF));
+   pData->push_back(static_cast<char>((value >> 8) & 0xFF));
+   pData->push_back(static_cast<char>(value & 0xFF));
+}
+
+void appendChunk(const char* type, const std::string& data, std::string* pPng)
+{
+   appendUInt32(static_cast<boost::uint32_t>(data.size()), pPng);
+   std::size_t typeOffset = pPng->size();
+   pPng->append(type, 4);
+   pPng->append(data);
+
+   uLong crc = ::crc32(0L, Z_NULL, 0);
+   crc = ::crc32(crc,
+                 reinterpret_cast<const Bytef*>(pPng->data() + typeOffset),
+                 static_cast<uInt>(data.size() + 4));
+   appendUInt32(static_cast<boost::uint32_t>(crc), pPng);
+}
+
+} // anonymous namespace
+
+Error decodeBmp(const std::string& data, Bitmap* pBitmap)
+{
+   // file header (14 bytes) and the BITMAPINFOHEADER fields we use
+   if (data.size() < 54 || data[0] != 'B' || data[1] != 'M')
+      return formatError(ERROR_LOCATION);
+
+   boost::uint32_t pixelOffset = readUInt32(data, 10);
+   boost::uint32_t headerSize = readUInt32(data, 14);
+   boost::int32_t width = static_cast<boost::int32_t>(readUInt32(data, 18));
+   boost::int32_t height = static_cast<boost::int32_t>(readUInt32(data, 22));
+   boost::uint16_t bitCount = readUInt16(data, 28);
+   boost::uint32_t compression = readUInt32(data, 30);
+
+   if (headerSize < 40 || width <= 0 || height == 0)
+      return formatError(ERROR_LOCATION);
+
+   // rows are stored bottom to top unless the height is negative
+   bool topDown = height < 0;
+   if (topDown)
+      height = -height;
+
+   // byte offsets of each channel within a pixel (BMP stores BGR(A))
+   int red = 2, green = 1, blue = 0, alpha = -1;
+   if (compression == kBmpBitfields && bitCount == 32)
+   {
+      // masks follow a BITMAPINFOHEADER or are part of a later header
+      if (data.size() < 14 + 40 + 12)
+         return formatError(ERROR_LOCATION);
+      red = maskByte(readUInt32(data, 54));
+      green = maskByte(readUInt32(data, 58));
+      blue = maskByte(readUInt32(data, 62));
+      if (headerSize >= 56 && data.size() >= 70 && readUInt32(data, 66) != 0)
+         alpha = maskByte(readUInt32(data, 66));
+      if (red < 0 || green < 0 || blue < 0)
+         return formatError(ERROR_LOCATION);
+   }
+   else if (compression != kBmpRgb || (bitCount != 24 && bitCount != 32))
+   {
+      return formatError(ERROR_LOCATION);
+   }
+
+   std::size_t bytesPerPixel = bitCount / 8;
+   std::size_t stride = ((bitCount * static_cast<std::size_t>(width) + 31) / 32) * 4;
+   if (pixelOffset > data.size() ||
+       (data.size() - pixelOffset) / stride < static_cast<std::size_t>(height))
+   {
+      return formatError(ERROR_LOCATION);
+   }
+
+   pBitmap->width = width;
+   pBitmap->height = height;
+   pBitmap->channels = (alpha >= 0) ? 4 : 3;
+   pBitmap->pixels.resize(static_cast<std::size_t>(width) * height *
+                          pBitmap->channels);
+
+   const unsigned char* pSrc =
+         reinterpret_cast<const unsigned char*>(data.data()) + pixelOffset;
+   unsigned char* pDest = &(pBitmap->pixels[0]);
+   for (int y = 0; y < height; y++)
+   {
+      const unsigned char* pRow = pSrc + stride * (topDown ? y : height - y - 1);
+      for (int x = 0; x < width; x++)
+      {
+         const unsigned char* pPixel = pRow + x * bytesPerPixel;
+         *pDest++ = pPixel[red];
+         *pDest++ = pPixel[green];
+         *pDest++ = pPixel[blue];
+         if (alpha >= 0)
+            *pDest++ = pPixel[alpha];
+      }
+   }
+
+   return Success();
+}
+
+Error encodePng(const Bitmap& bitmap, int level, std::string* pPng)
+{
+   if (bitmap.width <= 0 || bitmap.height <= 0 ||
+       (bitmap.channels != 3 && bitmap.channels != 4) ||
+       bitmap.pixels.size() != static_cast<std::size_t>(bitmap.width) *
+                               bitmap.height * bitmap.channels)
+   {
+      return systemError(boost::system::errc::invalid_argument,
+                         ERROR_LOCATION);
+   }
+
+   z_stream stream;
+   stream.zalloc = Z_NULL;
+   stream.zfree = Z_NULL;
+   stream.opaque = Z_NULL;
+   if (deflateInit(&stream, level) != Z_OK)
+      return systemError(boost::system::errc::not_enough_memory,
+                         ERROR_LOCATION);
+
+   // filter and compress a row at a time
+   std::size_t rowSize = static_cast<std::size_t>(bitmap.width) *
+                         bitmap.channels;
+   std::vector<unsigned char> filtered(rowSize + 1);
+   filtered[0] = kFilterUp;
+   std::vector<unsigned char> out(rowSize + 1024);
+   std::string idat;
+   int result = Z_OK;
+   for (int y = 0; y < bitmap.height && result == Z_OK; y++)
+   {
+      const unsigned char* pRow = &(bitmap.pixels[0]) + rowSize * y;
+      if (y == 0)
+      {
+         std::copy(pRow, pRow + rowSize, filtered.begin() + 1);
+      }
+      else
+      {
+         const unsigned char* pPrevious = pRow - rowSize;
+         for (std::size_t i = 0; i < rowSize; i++)
+            filtered[i + 1] = static_cast<unsigned char>(pRow[i] - pPrevious[i]);
+      }
+
+      bool lastRow = (y == bitmap.height - 1);
+      stream.next_in = &filtered[0];
+      stream.avail_in = static_cast<uInt>(filtered.size());
+      do
+      {
+         stream.next_out = &out[0];
+         stream.avail_out = static_cast<uInt>(out.size());
+         result = deflate(&stream, lastRow ? Z_FINISH : Z_NO_FLUSH);
+         if (result == Z_STREAM_ERROR)
+            break;
+         idat.append(reinterpret_cast<const char*>(&out[0]),
+                     out.size() - stream.avail_out);
+      } while (stream.avail_out == 0);
+
+      if (result == Z_STREAM_END)
+         break;
+   }
+   deflateEnd(&stream);
+
+   if (result != Z_STREAM_END)
+      return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+
+   // 8 bit truecolor (2) or truecolor with alpha (6), no interlacing
+   std::string ihdr;
+   appendUInt32(static_cast<boost::uint32_t>(bitmap.width), &ihdr);
+   appendUInt32(static_cast<boost::uint32_t>(bitmap.height), &ihdr);
+   ihdr.push_back(8);
+   ihdr.push_back(bitmap.channels == 4 ? 6 : 2);
+   ihdr.push_back(0);
+   ihdr.push_back(0);
+   ihdr.push_back(0);
+
+   pPng->clear();
+   pPng->reserve(sizeof(kPngSignature) + ihdr.size() + idat.size() + 64);
+   pPng->append(reinterpret_cast<const char*>(kPngSignature),
+                sizeof(kPngSignature));
+   appendChunk("IHDR", ihdr, pPng);
+   appendChunk("IDAT", idat, pPng);
+   appendChunk("IEND", std::string(), pPng);
+
+   return Success();
+}
+
+Error writePngFile(const Bitmap& bitmap, int level, const FilePath& filePath)
+{
+   std::string png;
+   Error error = encodePng(bitmap, level, &png);
+   if (error)
+      return error;
+
+   boost::shared_ptr<std::ostream> pOfs;
+   error = filePath.open_w(&pOfs);
+   if (error)
+      return error;
+
+   pOfs->write(png.data(), png.size());
+   pOfs->flush();
+   if (!pOfs->good())
+   {
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", filePath.absolutePath());
+      return error;
+   }
+
+   return Success();
+}
+
+} // namespace png
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,107 @@
+/*
+ * PngEncoderTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <core/PngEncoder.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+void appendLittleEndian(unsigned int value, int bytes, std::string* pData)
+{
+   for (int i = 0; i < bytes; i++)
+      pData->push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+// a bottom-up 24 bit BMP whose pixels are (x, y, x + y) in RGB
+std::string testBmp(int width, int height)
+{
+   int stride = ((24 * width + 31) / 32) * 4;
+
+   std::string bmp = "BM";
+   appendLittleEndian(54 + stride * height, 4, &bmp);
+   appendLittleEndian(0, 4, &bmp);
+   appendLittleEndian(54, 4, &bmp);
+   appendLittleEndian(40, 4, &bmp);
+   appendLittleEndian(width, 4, &bmp);
+   appendLittleEndian(height, 4, &bmp);
+   appendLittleEndian(1, 2, &bmp);
+   appendLittleEndian(24, 2, &bmp);
+   for (int i = 0; i < 6; i++)
+      appendLittleEndian(0, 4, &bmp);
+
+   for (int y = height - 1; y >= 0; y--)
+   {
+      std::string row;
+      for (int x = 0; x < width; x++)
+      {
+         row.push_back(static_cast<char>(x + y));
+         row.push_back(static_cast<char>(y));
+         row.push_back(static_cast<char>(x));
+      }
+      row.resize(stride, 0);
+      bmp.append(row);
+   }
+
+   return bmp;
+}
+
+} // anonymous namespace
+
+context("PngEncoder")
+{
+   test_that("BMP images are decoded top to bottom as RGB")
+   {
+      png::Bitmap bitmap;
+      expect_false(png::decodeBmp(testBmp(5, 3), &bitmap));
+      expect_true(bitmap.width == 5);
+      expect_true(bitmap.height == 3);
+      expect_true(bitmap.channels == 3);
+
+      // pixel (4, 2)
+      std::size_t offset = (2 * 5 + 4) * 3;
+      expect_true(bitmap.pixels[offset] == 4);
+      expect_true(bitmap.pixels[offset + 1] == 2);
+      expect_true(bitmap.pixels[offset + 2] == 6);
+   }
+
+   test_that("malformed BMP images are rejected")
+   {
+      png::Bitmap bitmap;
+      std::string bmp = testBmp(5, 3);
+      expect_true(png::decodeBmp(bmp.substr(0, bmp.size() - 8), &bitmap));
+      expect_true(png::decodeBmp("not a bitmap", &bitmap));
+   }
+
+   test_that("PNG output has a signature and header")
+   {
+      png::Bitmap bitmap;
+      expect_false(png::decodeBmp(testBmp(5, 3), &bitmap));
+
+      std::string png;
+      expect_false(png::encodePng(bitmap, 1, &png));
+      expect_true(png.substr(1, 3) == "PNG");
+      expect_true(png.substr(12, 4) == "IHDR");
+      expect_true(png.substr(png.size() - 8, 4) == "IEND");
+   }
+}
+
+} // end namespace tests
+} // end namespace core
+} // end namespace rstudio
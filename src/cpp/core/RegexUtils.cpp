@@ -15,9 +15,12 @@
 
 #include <core/RegexUtils.hpp>
 
+#include <list>
+#include <map>
 #include <vector>
 
 #include <boost/regex.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <boost/iostreams/copy.hpp>
@@ -25,11 +28,70 @@
 #include <boost/iostreams/filtering_stream.hpp>
 
 #include <core/StringUtils.hpp>
+#include <core/Thread.hpp>
 
 namespace rstudio {
 namespace core {
 namespace regex_utils {
 
+namespace {
+
+// compiled regexes, most recently used first. compiled regexes share
+// their state when copied so handing out copies is cheap
+typedef std::pair<std::string, boost::regex_constants::syntax_option_type>
+                                                               RegexKey;
+typedef std::list<std::pair<RegexKey, boost::regex> > RegexList;
+
+const std::size_t kMaxCachedRegexes = 256;
+
+// never freed (may be used during static destruction)
+boost::mutex* s_pRegexCacheMutex = new boost::mutex();
+RegexList* s_pRegexes = new RegexList();
+std::map<RegexKey, RegexList::iterator>* s_pRegexIndex =
+                  new std::map<RegexKey, RegexList::iterator>();
+
+} // anonymous namespace
+
+boost::regex compiledRegex(const std::string& pattern,
+                           boost::regex_constants::syntax_option_type flags)
+{
+   RegexKey key(pattern, flags);
+
+   LOCK_MUTEX(*s_pRegexCacheMutex)
+   {
+      std::map<RegexKey, RegexList::iterator>::iterator it =
+                                                   s_pRegexIndex->find(key);
+      if (it != s_pRegexIndex->end())
+      {
+         s_pRegexes->splice(s_pRegexes->begin(), *s_pRegexes, it->second);
+         return it->second->second;
+      }
+   }
+   END_LOCK_MUTEX
+
+   // compile outside the lock (this throws for invalid patterns, in which
+   // case nothing is cached)
+   boost::regex regex(pattern, flags);
+
+   LOCK_MUTEX(*s_pRegexCacheMutex)
+   {
+      if (s_pRegexIndex->find(key) == s_pRegexIndex->end())
+      {
+         s_pRegexes->push_front(std::make_pair(key, regex));
+         (*s_pRegexIndex)[key] = s_pRegexes->begin();
+
+         if (s_pRegexes->size() > kMaxCachedRegexes)
+         {
+            s_pRegexIndex->erase(s_pRegexes->back().first);
+            s_pRegexes->pop_back();
+         }
+      }
+   }
+   END_LOCK_MUTEX
+
+   return regex;
+}
+
 boost::regex wildcardPatternToRegex(const std::string& pattern)
 {
    // split into componenents
@@ -47,7 +109,7 @@ boost::regex wildcardPatternToRegex(const std::string& pattern)
       regex.append(components.at(i));
       regex.append("\\E");
    }
-   return boost::regex(regex);
+   return compiledRegex(regex);
 }
 
 boost::regex regexIfWildcardPattern(const std::string& term)
@@ -15,30 +15,62 @@
 
 #include <core/Settings.hpp>
 
+#include <set>
+
 #include <boost/lexical_cast.hpp>
 
 #include <core/Log.hpp>
 #include <core/FilePath.hpp>
 #include <core/SafeConvert.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Thread.hpp>
 
 namespace rstudio {
 namespace core {
 
+namespace {
+
+// pending changes are written after at most this many write-behind
+// delays (even if they continue to be made)
+const int kMaxWriteBehindDelays = 5;
+
+// settings in write-behind mode (never freed, see note on the sync objects
+// in Thread.hpp)
+boost::mutex* s_pWriteBehindMutex = new boost::mutex();
+std::set<Settings*>* s_pWriteBehindSettings = new std::set<Settings*>();
+
+} // anonymous namespace
+
 Settings::Settings()
    : updatePending_(false),
-     isDirty_(false)
+     isDirty_(false),
+     writeBehindDelay_(boost::posix_time::not_a_date_time)
 {
 }
 
 Settings::~Settings()
 {
+   try
+   {
+      if (!writeBehindDelay_.is_not_a_date_time())
+      {
+         LOCK_MUTEX(*s_pWriteBehindMutex)
+         {
+            s_pWriteBehindSettings->erase(this);
+         }
+         END_LOCK_MUTEX
+
+         flush();
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
 }
 
 Error Settings::initialize(const FilePath& filePath) 
 {
    settingsFile_ = filePath ;
    settingsMap_.clear() ;
+   jsonCache_.clear();
    Error error = core::readStringMapFromFile(settingsFile_, &settingsMap_) ;
    if (error)
    {
@@ -59,6 +91,18 @@ void Settings::set(const std::string& name, const std::string& value)
    if (value != settingsMap_[name])
    {
       settingsMap_[name] = value ;
+      jsonCache_.erase(name);
+
+      if (!writeBehindDelay_.is_not_a_date_time())
+      {
+         using namespace boost::posix_time;
+         lastChangeTime_ = microsec_clock::universal_time();
+         if (!isDirty_)
+            firstChangeTime_ = lastChangeTime_;
+         isDirty_ = true;
+         return;
+      }
+
       isDirty_ = true;
       
       if (!updatePending_)
@@ -125,6 +169,33 @@ bool Settings::getBool(const std::string& name, bool defaultValue) const
       return boost::lexical_cast<bool>(value);
 }   
    
+json::Value Settings::getJson(const std::string& name,
+                             const json::Value& defaultValue) const
+{
+   std::map<std::string,json::Value>::const_iterator cached =
+                                                   jsonCache_.find(name);
+   if (cached != jsonCache_.end())
+      return cached->second;
+
+   std::map<std::string,std::string>::const_iterator pos =
+                                                   settingsMap_.find(name);
+   if (pos == settingsMap_.end())
+      return defaultValue;
+
+   json::Value value;
+   if (!json::parse(pos->second, &value))
+      return defaultValue;
+
+   jsonCache_[name] = value;
+   return value;
+}
+
+void Settings::setJson(const std::string& name, const json::Value& value)
+{
+   set(name, json::writeFormatted(value));
+   jsonCache_[name] = value;
+}
+
 void Settings::forEach(const boost::function<void(const std::string&,
                                                   const std::string&)>& func)
                                                                          const
@@ -144,16 +215,76 @@ void Settings::beginUpdate()
 void Settings::endUpdate()
 {
    updatePending_ = false ;
-   if (isDirty_)
+   if (isDirty_ && writeBehindDelay_.is_not_a_date_time())
       writeSettings();
 }
 
+void Settings::setWriteBehind(const boost::posix_time::time_duration& delay)
+{
+   writeBehindDelay_ = delay;
+
+   LOCK_MUTEX(*s_pWriteBehindMutex)
+   {
+      s_pWriteBehindSettings->insert(this);
+   }
+   END_LOCK_MUTEX
+}
+
+void Settings::flush(bool dueOnly)
+{
+   if (!isDirty_ || updatePending_)
+      return;
+
+   if (dueOnly && !writeBehindDelay_.is_not_a_date_time())
+   {
+      using namespace boost::posix_time;
+      ptime now = microsec_clock::universal_time();
+      if (now - lastChangeTime_ < writeBehindDelay_ &&
+          now - firstChangeTime_ < writeBehindDelay_ * kMaxWriteBehindDelays)
+      {
+         return;
+      }
+   }
+
+   writeSettings();
+}
+
+void Settings::flushPendingWrites(bool dueOnly)
+{
+   std::set<Settings*> settings;
+   LOCK_MUTEX(*s_pWriteBehindMutex)
+   {
+      settings = *s_pWriteBehindSettings;
+   }
+   END_LOCK_MUTEX
+
+   for (std::set<Settings*>::const_iterator it = settings.begin();
+        it != settings.end(); ++it)
+   {
+      (*it)->flush(dueOnly);
+   }
+}
+
 void Settings::writeSettings() 
 {
    isDirty_ = false;
-   Error error = core::writeStringMapToFile(settingsFile_, settingsMap_) ; 
+
+   // write to a sibling file then rename it into place so readers (and
+   // an interrupted write) never see a partially written file
+   FilePath tempFile(settingsFile_.absolutePath() + ".tmp");
+   Error error = core::writeStringMapToFile(tempFile, settingsMap_) ;
+   if (!error)
+      error = tempFile.move(settingsFile_);
    if (error)
-     LOG_ERROR(error);
+   {
+      LOG_ERROR(error);
+
+      // fall back to writing in place (e.g. if the directory doesn't
+      // permit creating files)
+      error = core::writeStringMapToFile(settingsFile_, settingsMap_) ;
+      if (error)
+         LOG_ERROR(error);
+   }
 }
 
 
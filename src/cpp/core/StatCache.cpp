@@ -0,0 +1,183 @@
+/*
+ * StatCache.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/StatCache.hpp>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+#include <map>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Thread.hpp>
+
+namespace rstudio {
+namespace core {
+namespace stat_cache {
+
+namespace {
+
+// discard everything if the cache grows beyond this many entries
+const std::size_t kMaxEntries = 100000;
+
+struct CachedEntry
+{
+   Entry entry;
+   boost::posix_time::ptime expires;
+};
+
+// sorted so that paths beneath a directory can be found by prefix. the
+// mutex and map are never freed since they may be used by other threads
+// during static destruction
+boost::mutex* s_pMutex = new boost::mutex();
+std::map<std::string, CachedEntry>* s_pEntries =
+                                    new std::map<std::string, CachedEntry>();
+
+boost::posix_time::time_duration s_ttl;
+bool s_enabled = false;
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+#ifndef _WIN32
+
+// returns false for errors which FilePath reports (so that they continue
+// to be reported)
+bool statPath(const std::string& path, Entry* pEntry)
+{
+   struct stat st;
+   if (::stat(path.c_str(), &st) == -1)
+   {
+      if (errno == ENOENT || errno == ENOTDIR || errno == EACCES)
+      {
+         *pEntry = Entry();
+         return true;
+      }
+      return false;
+   }
+
+   pEntry->exists = true;
+   pEntry->isDirectory = S_ISDIR(st.st_mode);
+   pEntry->isRegularFile = S_ISREG(st.st_mode);
+   pEntry->size = pEntry->isRegularFile ? st.st_size : 0;
+   pEntry->lastWriteTime = st.st_mtime;
+   return true;
+}
+
+#endif
+
+} // anonymous namespace
+
+void setTimeToLive(const boost::posix_time::time_duration& ttl)
+{
+   LOCK_MUTEX(*s_pMutex)
+   {
+#ifndef _WIN32
+      s_ttl = ttl;
+      s_enabled = ttl > boost::posix_time::time_duration();
+#endif
+      s_pEntries->clear();
+   }
+   END_LOCK_MUTEX
+}
+
+bool enabled()
+{
+   return s_enabled;
+}
+
+bool lookup(const std::string& path, Entry* pEntry)
+{
+#ifndef _WIN32
+   if (!s_enabled || path.empty())
+      return false;
+
+   boost::posix_time::ptime time = now();
+   LOCK_MUTEX(*s_pMutex)
+   {
+      std::map<std::string, CachedEntry>::const_iterator it =
+                                                      s_pEntries->find(path);
+      if (it != s_pEntries->end() && time < it->second.expires)
+      {
+         *pEntry = it->second.entry;
+         return true;
+      }
+   }
+   END_LOCK_MUTEX
+
+   // stat outside of the lock (so that a slow file system doesn't block
+   // other threads' lookups)
+   if (!statPath(path, pEntry))
+      return false;
+
+   LOCK_MUTEX(*s_pMutex)
+   {
+      if (s_pEntries->size() >= kMaxEntries)
+         s_pEntries->clear();
+
+      CachedEntry& cached = (*s_pEntries)[path];
+      cached.entry = *pEntry;
+      cached.expires = time + s_ttl;
+   }
+   END_LOCK_MUTEX
+
+   return true;
+#else
+   return false;
+#endif
+}
+
+void invalidate(const std::string& path)
+{
+   if (!s_enabled)
+      return;
+
+   LOCK_MUTEX(*s_pMutex)
+   {
+      s_pEntries->erase(path);
+
+      std::string prefix = path + "/";
+      std::map<std::string, CachedEntry>::iterator it =
+                                             s_pEntries->lower_bound(prefix);
+      while (it != s_pEntries->end() &&
+             boost::algorithm::starts_with(it->first, prefix))
+      {
+         s_pEntries->erase(it++);
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+void invalidateAll()
+{
+   if (!s_enabled)
+      return;
+
+   LOCK_MUTEX(*s_pMutex)
+   {
+      s_pEntries->clear();
+   }
+   END_LOCK_MUTEX
+}
+
+} // namespace stat_cache
+} // namespace core
+} // namespace rstudio
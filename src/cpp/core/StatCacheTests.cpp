@@ -0,0 +1,117 @@
+/*
+ * StatCacheTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <fstream>
+
+#include <core/FilePath.hpp>
+#include <core/StatCache.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+void writeFile(const FilePath& filePath, const std::string& contents)
+{
+   // write without using FilePath (which would invalidate the cache)
+   std::ofstream ofs(filePath.absolutePath().c_str());
+   ofs << contents;
+}
+
+} // anonymous namespace
+
+context("StatCache")
+{
+   test_that("the cache is disabled by default")
+   {
+      stat_cache::Entry entry;
+      expect_false(stat_cache::enabled());
+      expect_false(stat_cache::lookup("/", &entry));
+   }
+
+   test_that("cached metadata is used until invalidated")
+   {
+      FilePath dir;
+      expect_false(FilePath::tempFilePath(&dir));
+      expect_false(dir.ensureDirectory());
+      FilePath file = dir.childPath("a.txt");
+
+      stat_cache::setTimeToLive(boost::posix_time::hours(1));
+      expect_true(dir.isDirectory());
+      expect_false(file.exists());
+
+      // changes made behind the cache's back aren't observed...
+      writeFile(file, "abc");
+      expect_false(file.exists());
+
+      // ...until the path (or one of its parents) is invalidated
+      stat_cache::invalidate(dir.absolutePath());
+      expect_true(file.exists());
+      expect_true(file.size() == 3);
+      expect_false(file.isDirectory());
+
+      writeFile(file, "abcdef");
+      expect_true(file.size() == 3);
+      stat_cache::invalidateAll();
+      expect_true(file.size() == 6);
+
+      // modifications made through FilePath invalidate the cache
+      boost::shared_ptr<std::ostream> pStream;
+      expect_false(file.open_w(&pStream));
+      *pStream << "a";
+      pStream.reset();
+      expect_true(file.size() == 1);
+
+      FilePath moved = dir.childPath("b.txt");
+      expect_false(moved.exists());
+      expect_false(file.move(moved));
+      expect_false(file.exists());
+      expect_true(moved.exists());
+
+      expect_false(dir.remove());
+      expect_false(moved.exists());
+      expect_false(dir.exists());
+
+      stat_cache::setTimeToLive(boost::posix_time::time_duration());
+      expect_false(stat_cache::enabled());
+   }
+
+   test_that("invalidating a path doesn't affect its siblings")
+   {
+      FilePath dir;
+      expect_false(FilePath::tempFilePath(&dir));
+      expect_false(dir.ensureDirectory());
+      FilePath ab = dir.childPath("ab");
+      FilePath a = dir.childPath("a");
+
+      stat_cache::setTimeToLive(boost::posix_time::hours(1));
+      expect_false(ab.exists());
+      writeFile(ab, "x");
+
+      stat_cache::invalidate(a.absolutePath());
+      expect_false(ab.exists());
+
+      stat_cache::setTimeToLive(boost::posix_time::time_duration());
+      expect_true(ab.exists());
+      expect_false(dir.remove());
+   }
+}
+
+} // end namespace tests
+} // end namespace core
+} // end namespace rstudio
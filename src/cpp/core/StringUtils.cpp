@@ -15,10 +15,12 @@
 
 #include <core/StringUtils.hpp>
 
+#include <cstring>
 #include <map>
 #include <ostream>
 
 #include <algorithm>
+#include <boost/cstdint.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
@@ -39,6 +41,17 @@ namespace rstudio {
 namespace core {
 namespace string_utils {
 
+namespace {
+
+// ascii-only lowercasing (matching boost::algorithm::to_lower_copy in the
+// classic locale) which doesn't require copying the string
+inline char toLowerAscii(char ch)
+{
+   return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+} // anonymous namespace
+
 bool isSubsequence(std::string const& self,
                    std::string const& other,
                    std::string::size_type other_n)
@@ -54,25 +67,18 @@ bool isSubsequence(std::string const& self,
    if (other_n > self_n)
       return false;
 
-   std::string::size_type self_idx = 0;
-   std::string::size_type other_idx = 0;
-
-   while (self_idx < self_n)
+   // find each character of other in turn (memchr is vectorized by the
+   // c library so this is much faster than comparing character-wise)
+   const char* pos = self.data();
+   const char* end = pos + self_n;
+   for (std::string::size_type i = 0; i < other_n; ++i)
    {
-      char selfChar = self[self_idx];
-      char otherChar = other[other_idx];
-
-      if (otherChar == selfChar)
-      {
-         ++other_idx;
-         if (other_idx == other_n)
-         {
-            return true;
-         }
-      }
-      ++self_idx;
+      pos = static_cast<const char*>(::memchr(pos, other[i], end - pos));
+      if (pos == NULL)
+         return false;
+      ++pos;
    }
-   return false;
+   return true;
 }
 
 
@@ -81,12 +87,29 @@ bool isSubsequence(std::string const& self,
                    std::string::size_type other_n,
                    bool caseInsensitive)
 {
-   return caseInsensitive ?
-            isSubsequence(boost::algorithm::to_lower_copy(self),
-                          boost::algorithm::to_lower_copy(other),
-                          other_n) :
-            isSubsequence(self, other, other_n)
-            ;
+   if (!caseInsensitive)
+      return isSubsequence(self, other, other_n);
+
+   std::string::size_type self_n = self.length();
+
+   if (other_n > other.length())
+      other_n = other.length();
+
+   if (other_n > self_n)
+      return false;
+
+   std::string::size_type self_idx = 0;
+   for (std::string::size_type i = 0; i < other_n; ++i)
+   {
+      char otherChar = toLowerAscii(other[i]);
+      while (self_idx < self_n && toLowerAscii(self[self_idx]) != otherChar)
+         ++self_idx;
+
+      if (self_idx == self_n)
+         return false;
+      ++self_idx;
+   }
+   return true;
 }
 
 bool isSubsequence(std::string const& self,
@@ -150,30 +173,83 @@ std::string getExtension(std::string const& x)
       return std::string();
 }
 
-void convertLineEndings(std::string* pStr, LineEnding type)
+namespace {
+
+bool lineEndingReplacement(LineEnding type, std::string* pReplacement)
 {
-   std::string replacement;
    switch (type)
    {
    case LineEndingWindows:
-      replacement = "\r\n";
-      break;
+      *pReplacement = "\r\n";
+      return true;
    case LineEndingPosix:
-      replacement = "\n";
-      break;
+      *pReplacement = "\n";
+      return true;
    case LineEndingNative:
 #if _WIN32
-      replacement = "\r\n";
+      *pReplacement = "\r\n";
 #else
-      replacement = "\n";
+      *pReplacement = "\n";
 #endif
-      break;
+      return true;
    case LineEndingPassthrough:
    default:
+      return false;
+   }
+}
+
+// posix line endings are already in place if there are no carriage returns
+// or unicode line/paragraph separators (the common case, which lets us
+// skip the regex)
+bool hasPosixLineEndings(const char* begin, const char* end)
+{
+   return std::find(begin, end, '\r') == end &&
+          std::find(begin, end, '\xE2') == end;
+}
+
+const boost::regex& lineEndingRegex()
+{
+   static const boost::regex re("\\r?\\n|\\r|\\xE2\\x80[\\xA8\\xA9]");
+   return re;
+}
+
+} // anonymous namespace
+
+void convertLineEndings(std::string* pStr, LineEnding type)
+{
+   std::string replacement;
+   if (!lineEndingReplacement(type, &replacement))
+      return;
+
+   if (replacement == "\n" &&
+       hasPosixLineEndings(pStr->data(), pStr->data() + pStr->size()))
+   {
+      return;
+   }
+
+   *pStr = boost::regex_replace(*pStr, lineEndingRegex(), replacement);
+}
+
+void convertLineEndings(const char* begin,
+                        const char* end,
+                        LineEnding type,
+                        std::string* pOutput)
+{
+   std::string replacement;
+   if (!lineEndingReplacement(type, &replacement) ||
+       (replacement == "\n" && hasPosixLineEndings(begin, end)))
+   {
+      pOutput->assign(begin, end);
       return;
    }
 
-   *pStr = boost::regex_replace(*pStr, boost::regex("\\r?\\n|\\r|\\xE2\\x80[\\xA8\\xA9]"), replacement);
+   pOutput->clear();
+   pOutput->reserve(end - begin);
+   boost::regex_replace(std::back_inserter(*pOutput),
+                        begin,
+                        end,
+                        lineEndingRegex(),
+                        replacement);
 }
 
 bool detectLineEndings(const FilePath& filePath, LineEnding* pType)
@@ -229,6 +305,87 @@ bool detectLineEndings(const FilePath& filePath, LineEnding* pType)
    return false;
 }
 
+namespace {
+
+// skip the leading ascii bytes of [begin, end) -- 16 bytes at a time while
+// none of them have the high bit set
+const char* skipAscii(const char* begin, const char* end)
+{
+   const boost::uint64_t kHighBits = 0x8080808080808080ULL;
+   while (end - begin >= 16)
+   {
+      boost::uint64_t words[2];
+      std::memcpy(words, begin, sizeof(words));
+      if ((words[0] | words[1]) & kHighBits)
+         break;
+      begin += 16;
+   }
+
+   while (begin != end && static_cast<unsigned char>(*begin) < 0x80)
+      ++begin;
+
+   return begin;
+}
+
+} // anonymous namespace
+
+bool isAscii(const char* begin, const char* end)
+{
+   return skipAscii(begin, end) == end;
+}
+
+bool isValidUtf8(const char* begin, const char* end)
+{
+   const unsigned char* it = reinterpret_cast<const unsigned char*>(begin);
+   const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+   while (true)
+   {
+      it = reinterpret_cast<const unsigned char*>(
+               skipAscii(reinterpret_cast<const char*>(it), end));
+      if (it == last)
+         return true;
+
+      // lead byte: the number of continuation bytes and the range allowed
+      // for the first of them (which excludes overlong forms, surrogates
+      // and values beyond U+10FFFF)
+      unsigned char lead = *it++;
+      int count;
+      unsigned char min = 0x80, max = 0xBF;
+      if (lead >= 0xC2 && lead <= 0xDF)
+         count = 1;
+      else if (lead >= 0xE0 && lead <= 0xEF)
+      {
+         count = 2;
+         if (lead == 0xE0)
+            min = 0xA0;
+         else if (lead == 0xED)
+            max = 0x9F;
+      }
+      else if (lead >= 0xF0 && lead <= 0xF4)
+      {
+         count = 3;
+         if (lead == 0xF0)
+            min = 0x90;
+         else if (lead == 0xF4)
+            max = 0x8F;
+      }
+      else
+         return false;
+
+      if (last - it < count)
+         return false;
+
+      if (*it < min || *it > max)
+         return false;
+      for (int i = 1; i < count; i++)
+      {
+         if ((it[i] & 0xC0) != 0x80)
+            return false;
+      }
+      it += count;
+   }
+}
+
 std::string utf8ToSystem(const std::string& str,
                          bool escapeInvalidChars)
 {
@@ -236,6 +393,10 @@ std::string utf8ToSystem(const std::string& str,
       return std::string();
 
 #ifdef _WIN32
+   // ascii is the same in utf-8 and all of the system code pages
+   if (isAscii(str))
+      return str;
+
    wchar_t wide[str.length() + 1];
    int chars = ::MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, wide, sizeof(wide));
    if (chars < 0)
@@ -273,6 +434,9 @@ std::string systemToUtf8(const std::string& str)
       return std::string();
 
 #ifdef _WIN32
+   if (isAscii(str))
+      return str;
+
    wchar_t wide[str.length() + 1];
    int chars = ::MultiByteToWideChar(CP_ACP, 0, str.c_str(), str.length(), wide, sizeof(wide));
    if (chars < 0)
@@ -30,6 +30,13 @@ context("isSubsequence")
       expect_false(isSubsequence("abcdef", "abdcef"));
       expect_true(isSubsequence("abcdef", "AeF", true));
       expect_true(isSubsequence("a1d2", "12"));
+      expect_false(isSubsequence("abc", "abcd"));
+      expect_false(isSubsequence("abcdef", "aff"));
+      expect_false(isSubsequence("abcdef", "xyzace", 3, false));
+      expect_true(isSubsequence("abcdef", "acexyz", 3, false));
+      expect_true(isSubsequence("ABCDEF", "bdf", true));
+      expect_false(isSubsequence("ABCDEF", "bdf", false));
+      expect_false(isSubsequence("ABCDEF", "fb", true));
    }
    
    test_that("strippedOfBackQuotes works")
@@ -57,6 +64,47 @@ context("isSubsequence")
    }
 }
 
+context("utf8 validation")
+{
+   test_that("ascii is detected across word boundaries")
+   {
+      std::string ascii(100, 'a');
+      expect_true(isAscii(ascii));
+      expect_true(isAscii(""));
+
+      for (std::size_t i = 0; i < ascii.size(); i++)
+      {
+         std::string text = ascii;
+         text[i] = '\xC3';
+         expect_false(isAscii(text));
+      }
+   }
+
+   test_that("well-formed utf-8 is accepted")
+   {
+      expect_true(isValidUtf8(""));
+      expect_true(isValidUtf8(std::string(40, 'x') + "caf\xC3\xA9"));
+      expect_true(isValidUtf8("\xE2\x82\xAC 100"));
+      expect_true(isValidUtf8("\xF0\x9F\x98\x80"));
+      expect_true(isValidUtf8("\xF4\x8F\xBF\xBF"));
+   }
+
+   test_that("malformed utf-8 is rejected")
+   {
+      // latin1, truncated and stray continuation bytes
+      expect_false(isValidUtf8("caf\xE9"));
+      expect_false(isValidUtf8("\xE2\x82"));
+      expect_false(isValidUtf8("\x80abc"));
+
+      // overlong forms, surrogates and code points beyond U+10FFFF
+      expect_false(isValidUtf8("\xC0\xAF"));
+      expect_false(isValidUtf8("\xE0\x80\xAF"));
+      expect_false(isValidUtf8("\xED\xA0\x80"));
+      expect_false(isValidUtf8("\xF4\x90\x80\x80"));
+      expect_false(isValidUtf8("\xF5\x80\x80\x80"));
+   }
+}
+
 } // end namespace string_utils
 } // end namespace core
 } // end namespace rstudio
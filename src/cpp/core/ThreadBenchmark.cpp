@@ -0,0 +1,217 @@
+/*
+ * ThreadBenchmark.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// compares the throughput of the thread-safe containers in core/Thread.hpp
+// under contention. usage: rstudio-core-thread-benchmark [threads]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::thread;
+
+namespace {
+
+const int kOperations = 1000000;
+const int kKeys = 1024;
+
+void report(const std::string& name,
+            int operations,
+            const boost::posix_time::ptime& startTime)
+{
+   using namespace boost::posix_time;
+   double seconds =
+      (microsec_clock::universal_time() - startTime).total_microseconds() / 1e6;
+   std::cout << name << ": "
+             << static_cast<long>(operations / seconds) << " ops/sec"
+             << std::endl;
+}
+
+// queues
+
+void produceThreadsafe(ThreadsafeQueue<int>* pQueue, int count)
+{
+   for (int i = 0; i < count; i++)
+      pQueue->enque(i);
+}
+
+void consumeThreadsafe(ThreadsafeQueue<int>* pQueue, int count, bool batch)
+{
+   int consumed = 0;
+   int val;
+   std::vector<int> vals;
+   while (consumed < count)
+   {
+      if (batch)
+      {
+         vals.clear();
+         if (pQueue->dequeAll(&vals))
+            consumed += vals.size();
+      }
+      else if (pQueue->deque(&val))
+      {
+         consumed++;
+      }
+   }
+}
+
+void produceBounded(BoundedQueue<int>* pQueue, int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      while (!pQueue->enque(i))
+         boost::this_thread::yield();
+   }
+}
+
+void consumeBounded(BoundedQueue<int>* pQueue, int count, bool batch)
+{
+   int consumed = 0;
+   int val;
+   std::vector<int> vals;
+   while (consumed < count)
+   {
+      if (batch)
+      {
+         vals.clear();
+         consumed += pQueue->dequeMany(&vals, 256);
+      }
+      else if (pQueue->deque(&val))
+      {
+         consumed++;
+      }
+   }
+}
+
+template <typename Queue>
+void benchmarkQueue(const std::string& name,
+                    Queue* pQueue,
+                    void (*produce)(Queue*, int),
+                    void (*consume)(Queue*, int, bool),
+                    int producers,
+                    int consumers,
+                    bool batch)
+{
+   int perProducer = kOperations / producers;
+   int total = perProducer * producers;
+
+   boost::posix_time::ptime startTime =
+                           boost::posix_time::microsec_clock::universal_time();
+   boost::thread_group threads;
+   for (int i = 0; i < producers; i++)
+      threads.create_thread(boost::bind(produce, pQueue, perProducer));
+   for (int i = 0; i < consumers; i++)
+   {
+      int count = total / consumers + (i == 0 ? total % consumers : 0);
+      threads.create_thread(boost::bind(consume, pQueue, count, batch));
+   }
+   threads.join_all();
+   report(name, total, startTime);
+}
+
+// maps
+
+template <typename Map>
+void exerciseMap(Map* pMap, int thread, int count)
+{
+   int value;
+   for (int i = 0; i < count; i++)
+   {
+      int key = (thread * 7919 + i) % kKeys;
+      if (i % 4 == 0)
+         pMap->set(key, i);
+      else
+         pMap->get(key, &value);
+   }
+}
+
+template <typename Map>
+void benchmarkMap(const std::string& name, Map* pMap, int threads)
+{
+   int perThread = kOperations / threads;
+   boost::posix_time::ptime startTime =
+                           boost::posix_time::microsec_clock::universal_time();
+   boost::thread_group group;
+   for (int i = 0; i < threads; i++)
+      group.create_thread(boost::bind(exerciseMap<Map>, pMap, i, perThread));
+   group.join_all();
+   report(name, perThread * threads, startTime);
+}
+
+} // anonymous namespace
+
+int main(int argc, char * const argv[])
+{
+   int threads = 4;
+   if (argc > 1)
+      threads = std::max(1, safe_convert::stringTo<int>(argv[1], threads));
+
+   std::cout << "threads: " << threads << std::endl << std::endl;
+
+   {
+      ThreadsafeQueue<int> queue(true);
+      benchmarkQueue("ThreadsafeQueue (mpsc)", &queue,
+                     produceThreadsafe, consumeThreadsafe, threads, 1, false);
+   }
+   {
+      ThreadsafeQueue<int> queue(true);
+      benchmarkQueue("ThreadsafeQueue (mpsc, dequeAll)", &queue,
+                     produceThreadsafe, consumeThreadsafe, threads, 1, true);
+   }
+   {
+      ThreadsafeQueue<int> queue(true);
+      benchmarkQueue("ThreadsafeQueue (mpmc)", &queue,
+                     produceThreadsafe, consumeThreadsafe,
+                     threads, threads, false);
+   }
+   {
+      BoundedQueue<int> queue(4096);
+      benchmarkQueue("BoundedQueue (mpsc)", &queue,
+                     produceBounded, consumeBounded, threads, 1, false);
+   }
+   {
+      BoundedQueue<int> queue(4096);
+      benchmarkQueue("BoundedQueue (mpsc, dequeMany)", &queue,
+                     produceBounded, consumeBounded, threads, 1, true);
+   }
+   {
+      BoundedQueue<int> queue(4096);
+      benchmarkQueue("BoundedQueue (mpmc)", &queue,
+                     produceBounded, consumeBounded, threads, threads, false);
+   }
+
+   std::cout << std::endl;
+
+   {
+      ThreadsafeMap<int, int> map;
+      benchmarkMap("ThreadsafeMap", &map, threads);
+   }
+   {
+      ShardedThreadsafeMap<int, int> map;
+      benchmarkMap("ShardedThreadsafeMap", &map, threads);
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,508 @@
+/*
+ * ThreadPool.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/ThreadPool.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+
+#ifndef _WIN32
+#include <core/system/PosixSched.hpp>
+#endif
+
+namespace rstudio {
+namespace core {
+namespace thread {
+
+namespace {
+
+const int kPriorities = TaskPriorityLow + 1;
+
+} // anonymous namespace
+
+struct TaskHandle::State
+{
+   State() : complete(false), cancelled(false) {}
+
+   boost::mutex mutex;
+   boost::condition condition;
+   bool complete;
+   bool cancelled;
+
+   // enqueue functions for continuations (run once complete)
+   std::vector<boost::function<void()> > continuations;
+};
+
+bool TaskHandle::isComplete() const
+{
+   if (!pState_)
+      return true;
+
+   LOCK_MUTEX(pState_->mutex)
+   {
+      return pState_->complete;
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+bool TaskHandle::wasCancelled() const
+{
+   if (!pState_)
+      return false;
+
+   LOCK_MUTEX(pState_->mutex)
+   {
+      return pState_->cancelled;
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+void TaskHandle::wait() const
+{
+   if (!pState_)
+      return;
+
+   try
+   {
+      boost::unique_lock<boost::mutex> lock(pState_->mutex);
+      while (!pState_->complete)
+         pState_->condition.wait(lock);
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+bool TaskHandle::wait(const boost::posix_time::time_duration& waitDuration) const
+{
+   if (!pState_)
+      return true;
+
+   try
+   {
+      boost::system_time timeoutTime = boost::get_system_time() + waitDuration;
+      boost::unique_lock<boost::mutex> lock(pState_->mutex);
+      while (!pState_->complete)
+      {
+         if (!pState_->condition.timed_wait(lock, timeoutTime))
+            return pState_->complete;
+      }
+      return true;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   return false;
+}
+
+struct ThreadPool::Impl
+{
+   struct Item
+   {
+      boost::function<void()> task;
+      TaskPriority priority;
+      CancellationToken token;
+      boost::shared_ptr<TaskHandle::State> pState;
+   };
+
+   struct Worker
+   {
+      boost::mutex mutex;
+      std::deque<Item> items;
+   };
+
+   explicit Impl(const std::string& name)
+      : name(name), pending(0), stopping(false)
+   {
+   }
+
+   static void enqueueContinuation(boost::weak_ptr<Impl> pWeakImpl,
+                                   const Item& item);
+   void enqueue(const Item& item);
+   void run(std::size_t index);
+   bool take(std::size_t index, Item* pItem);
+   bool takeFromWorker(std::size_t index, bool newest, Item* pItem);
+   void execute(const Item& item);
+   void complete(const Item& item, bool cancelled);
+   void stop();
+
+   const std::string name;
+
+   // shared queues (by priority) and the count of all queued items
+   // (including those in the workers' own queues)
+   boost::mutex mutex;
+   boost::condition workAvailable;
+   std::deque<Item> queues[kPriorities];
+   int pending;
+   bool stopping;
+
+   std::vector<boost::shared_ptr<Worker> > workers;
+   std::vector<boost::shared_ptr<boost::thread> > threads;
+};
+
+namespace {
+
+struct CurrentWorker
+{
+   CurrentWorker(const void* pPool, std::size_t index)
+      : pPool(pPool), index(index)
+   {
+   }
+   const void* pPool;
+   std::size_t index;
+};
+
+// the pool and worker index of the current thread (if it's a pool thread)
+boost::thread_specific_ptr<CurrentWorker> s_currentWorker;
+
+} // anonymous namespace
+
+void ThreadPool::Impl::enqueueContinuation(boost::weak_ptr<Impl> pWeakImpl,
+                                           const Item& item)
+{
+   // continuations of tasks outliving their pool are dropped
+   boost::shared_ptr<Impl> pImpl = pWeakImpl.lock();
+   if (pImpl)
+      pImpl->enqueue(item);
+}
+
+void ThreadPool::Impl::enqueue(const Item& item)
+{
+   // tasks submitted from one of our threads go to its own queue (except
+   // high priority tasks, which go straight to the shared queue)
+   CurrentWorker* pCurrent = s_currentWorker.get();
+   bool local = pCurrent != NULL &&
+                pCurrent->pPool == this &&
+                item.priority != TaskPriorityHigh;
+
+   bool stopped = false;
+   LOCK_MUTEX(mutex)
+   {
+      if (stopping)
+      {
+         stopped = true;
+      }
+      else
+      {
+         if (local)
+         {
+            Worker& worker = *workers[pCurrent->index];
+            LOCK_MUTEX(worker.mutex)
+            {
+               worker.items.push_back(item);
+            }
+            END_LOCK_MUTEX
+         }
+         else
+         {
+            queues[item.priority].push_back(item);
+         }
+         pending++;
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (stopped)
+      complete(item, true);
+   else
+      workAvailable.notify_one();
+}
+
+bool ThreadPool::Impl::takeFromWorker(std::size_t index,
+                                      bool newest,
+                                      Item* pItem)
+{
+   Worker& worker = *workers[index];
+   LOCK_MUTEX(worker.mutex)
+   {
+      if (worker.items.empty())
+         return false;
+
+      if (newest)
+      {
+         *pItem = worker.items.back();
+         worker.items.pop_back();
+      }
+      else
+      {
+         *pItem = worker.items.front();
+         worker.items.pop_front();
+      }
+      return true;
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+bool ThreadPool::Impl::take(std::size_t index, Item* pItem)
+{
+   using namespace boost;
+   try
+   {
+      unique_lock<boost::mutex> lock(mutex);
+      while (!stopping)
+      {
+         // our own queue first (newest first, its data is most likely to
+         // still be in cache) then the shared queues by priority
+         bool found = takeFromWorker(index, true, pItem);
+         for (int i = 0; !found && i < kPriorities; i++)
+         {
+            if (!queues[i].empty())
+            {
+               *pItem = queues[i].front();
+               queues[i].pop_front();
+               found = true;
+            }
+         }
+
+         // then steal from the others (oldest first)
+         for (std::size_t i = 1; !found && i < workers.size(); i++)
+            found = takeFromWorker((index + i) % workers.size(), false, pItem);
+
+         if (found)
+         {
+            pending--;
+            return true;
+         }
+
+         workAvailable.wait(lock);
+      }
+   }
+   catch(const thread_resource_error& e)
+   {
+      LOG_ERROR(Error(thread_error::ec_from_exception(e), ERROR_LOCATION));
+   }
+
+   return false;
+}
+
+void ThreadPool::Impl::execute(const Item& item)
+{
+   bool cancelled = item.token.isCancelled();
+   if (!cancelled)
+   {
+      try
+      {
+         item.task();
+      }
+      catch(const std::exception& e)
+      {
+         LOG_ERROR_MESSAGE("Unexpected exception in " + name +
+                           " thread pool task: " + e.what());
+      }
+      catch(...)
+      {
+         LOG_ERROR_MESSAGE("Unknown exception in " + name +
+                           " thread pool task");
+      }
+   }
+
+   complete(item, cancelled);
+}
+
+void ThreadPool::Impl::complete(const Item& item, bool cancelled)
+{
+   std::vector<boost::function<void()> > continuations;
+   LOCK_MUTEX(item.pState->mutex)
+   {
+      item.pState->complete = true;
+      item.pState->cancelled = cancelled;
+      continuations.swap(item.pState->continuations);
+   }
+   END_LOCK_MUTEX
+
+   item.pState->condition.notify_all();
+
+   for (std::size_t i = 0; i < continuations.size(); i++)
+      continuations[i]();
+}
+
+void ThreadPool::Impl::run(std::size_t index)
+{
+   s_currentWorker.reset(new CurrentWorker(this, index));
+
+   Item item;
+   while (take(index, &item))
+   {
+      execute(item);
+      item = Item();
+   }
+}
+
+void ThreadPool::Impl::stop()
+{
+   // collect the queued items
+   std::vector<Item> discarded;
+   LOCK_MUTEX(mutex)
+   {
+      if (stopping)
+         return;
+      stopping = true;
+
+      for (int i = 0; i < kPriorities; i++)
+      {
+         discarded.insert(discarded.end(), queues[i].begin(), queues[i].end());
+         queues[i].clear();
+      }
+
+      for (std::size_t i = 0; i < workers.size(); i++)
+      {
+         LOCK_MUTEX(workers[i]->mutex)
+         {
+            discarded.insert(discarded.end(),
+                             workers[i]->items.begin(),
+                             workers[i]->items.end());
+            workers[i]->items.clear();
+         }
+         END_LOCK_MUTEX
+      }
+      pending = 0;
+   }
+   END_LOCK_MUTEX
+
+   workAvailable.notify_all();
+
+   // wait for running tasks (a pool thread can't wait for itself)
+   for (std::size_t i = 0; i < threads.size(); i++)
+   {
+      try
+      {
+         if (threads[i]->get_id() != boost::this_thread::get_id())
+            threads[i]->join();
+         else
+            threads[i]->detach();
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   for (std::size_t i = 0; i < discarded.size(); i++)
+      complete(discarded[i], true);
+}
+
+ThreadPool::ThreadPool(const std::string& name, int threads)
+   : pImpl_(new Impl(name))
+{
+   if (threads <= 0)
+      threads = defaultThreadCount();
+
+   for (int i = 0; i < threads; i++)
+      pImpl_->workers.push_back(boost::make_shared<Impl::Worker>());
+
+   for (int i = 0; i < threads; i++)
+   {
+      boost::shared_ptr<boost::thread> pThread(new boost::thread());
+      safeLaunchThread(boost::bind(&Impl::run, pImpl_.get(), i),
+                       pThread.get());
+      pImpl_->threads.push_back(pThread);
+   }
+}
+
+ThreadPool::~ThreadPool()
+{
+   try
+   {
+      stop();
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+int ThreadPool::defaultThreadCount()
+{
+#ifndef _WIN32
+   return system::availableCpuCount();
+#else
+   return std::max(static_cast<int>(boost::thread::hardware_concurrency()), 1);
+#endif
+}
+
+int ThreadPool::threadCount() const
+{
+   return static_cast<int>(pImpl_->threads.size());
+}
+
+TaskHandle ThreadPool::submit(const boost::function<void()>& task,
+                              TaskPriority priority,
+                              const CancellationToken& token)
+{
+   Impl::Item item;
+   item.task = task;
+   item.priority = priority;
+   item.token = token;
+   item.pState.reset(new TaskHandle::State());
+
+   pImpl_->enqueue(item);
+   return TaskHandle(item.pState);
+}
+
+TaskHandle ThreadPool::continueWith(const TaskHandle& antecedent,
+                                    const boost::function<void()>& task,
+                                    TaskPriority priority,
+                                    const CancellationToken& token)
+{
+   Impl::Item item;
+   item.task = task;
+   item.priority = priority;
+   item.token = token;
+   item.pState.reset(new TaskHandle::State());
+
+   // queue the continuation with the antecedent unless it's complete
+   bool ready = true;
+   if (!antecedent.empty())
+   {
+      LOCK_MUTEX(antecedent.pState_->mutex)
+      {
+         if (!antecedent.pState_->complete)
+         {
+            boost::weak_ptr<Impl> pWeakImpl(pImpl_);
+            antecedent.pState_->continuations.push_back(
+                        boost::bind(Impl::enqueueContinuation,
+                                    pWeakImpl,
+                                    item));
+            ready = false;
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+   if (ready)
+      pImpl_->enqueue(item);
+
+   return TaskHandle(item.pState);
+}
+
+void ThreadPool::stop()
+{
+   pImpl_->stop();
+}
+
+ThreadPool& sharedThreadPool()
+{
+   static ThreadPool* pPool = new ThreadPool("shared");
+   return *pPool;
+}
+
+} // namespace thread
+} // namespace core
+} // namespace rstudio
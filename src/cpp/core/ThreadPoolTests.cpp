@@ -0,0 +1,211 @@
+/*
+ * ThreadPoolTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <core/ThreadPool.hpp>
+
+namespace rstudio {
+namespace core {
+namespace thread {
+
+namespace {
+
+const int kTasks = 1000;
+
+void record(boost::mutex* pMutex, std::vector<int>* pOrder, int value)
+{
+   boost::lock_guard<boost::mutex> lock(*pMutex);
+   pOrder->push_back(value);
+}
+
+// occupies a pool thread until released
+void block(int* pStarted, int* pRelease)
+{
+   __sync_fetch_and_add(pStarted, 1);
+   while (__sync_fetch_and_add(pRelease, 0) == 0)
+      boost::this_thread::yield();
+}
+
+void waitForStart(int* pStarted)
+{
+   while (__sync_fetch_and_add(pStarted, 0) == 0)
+      boost::this_thread::yield();
+}
+
+void releaseAfterDelay(int* pRelease)
+{
+   boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+   __sync_fetch_and_add(pRelease, 1);
+}
+
+void increment(int* pCount)
+{
+   __sync_fetch_and_add(pCount, 1);
+}
+
+// submits child tasks from within the pool (to the worker's own queue)
+void spawn(ThreadPool* pPool, int* pCount)
+{
+   for (int i = 0; i < kTasks; i++)
+      pPool->submit(boost::bind(increment, pCount));
+}
+
+int answer()
+{
+   return 42;
+}
+
+std::string greeting()
+{
+   return "hello";
+}
+
+} // anonymous namespace
+
+context("ThreadPool")
+{
+   test_that("queued tasks run in order of priority")
+   {
+      ThreadPool pool("test", 1);
+
+      // hold the only thread while the tasks are queued
+      int started = 0, release = 0;
+      pool.submit(boost::bind(block, &started, &release));
+      waitForStart(&started);
+
+      boost::mutex mutex;
+      std::vector<int> order;
+      TaskHandle low = pool.submit(
+               boost::bind(record, &mutex, &order, TaskPriorityLow),
+               TaskPriorityLow);
+      pool.submit(boost::bind(record, &mutex, &order, TaskPriorityNormal));
+      pool.submit(boost::bind(record, &mutex, &order, TaskPriorityHigh),
+                  TaskPriorityHigh);
+      __sync_fetch_and_add(&release, 1);
+
+      low.wait();
+      expect_true(order.size() == 3);
+      for (std::size_t i = 1; i < order.size(); i++)
+         expect_true(order[i - 1] <= order[i]);
+   }
+
+   test_that("cancelled tasks are skipped")
+   {
+      ThreadPool pool("test", 1);
+
+      int started = 0, release = 0;
+      pool.submit(boost::bind(block, &started, &release));
+      waitForStart(&started);
+
+      int count = 0;
+      CancellationToken token;
+      TaskHandle handle = pool.submit(boost::bind(increment, &count),
+                                      TaskPriorityNormal,
+                                      token);
+      token.cancel();
+      __sync_fetch_and_add(&release, 1);
+
+      handle.wait();
+      expect_true(handle.wasCancelled());
+      expect_true(count == 0);
+   }
+
+   test_that("stopping cancels queued tasks")
+   {
+      ThreadPool pool("test", 1);
+
+      int started = 0, release = 0;
+      pool.submit(boost::bind(block, &started, &release));
+      waitForStart(&started);
+
+      int count = 0;
+      TaskHandle handle = pool.submit(boost::bind(increment, &count));
+
+      // stopping discards the queued task then waits for the blocker
+      boost::thread releaser(boost::bind(releaseAfterDelay, &release));
+      pool.stop();
+      releaser.join();
+
+      expect_true(handle.wasCancelled());
+      expect_true(count == 0);
+
+      // tasks submitted after stopping are cancelled immediately
+      TaskHandle late = pool.submit(boost::bind(increment, &count));
+      expect_true(late.isComplete());
+      expect_true(late.wasCancelled());
+   }
+
+   test_that("computed values are returned")
+   {
+      ThreadPool pool("test", 2);
+      Future<int> number = pool.compute<int>(answer);
+      Future<std::string> text = pool.compute<std::string>(greeting);
+      expect_true(number.get() == 42);
+      expect_true(text.get() == "hello");
+   }
+
+   test_that("continuations run after their antecedent")
+   {
+      ThreadPool pool("test", 2);
+
+      boost::mutex mutex;
+      std::vector<int> order;
+      TaskHandle first = pool.submit(boost::bind(record, &mutex, &order, 1));
+      TaskHandle second = pool.continueWith(
+               first, boost::bind(record, &mutex, &order, 2));
+      TaskHandle third = pool.continueWith(
+               second, boost::bind(record, &mutex, &order, 3));
+
+      third.wait();
+      expect_true(order.size() == 3);
+      expect_true(order[0] == 1 && order[1] == 2 && order[2] == 3);
+
+      // continuing a completed task runs immediately
+      TaskHandle fourth = pool.continueWith(
+               third, boost::bind(record, &mutex, &order, 4));
+      fourth.wait();
+      expect_true(order.size() == 4);
+   }
+
+   test_that("tasks submitted within the pool all run")
+   {
+      int count = 0;
+      {
+         ThreadPool pool("test", 4);
+         TaskHandle parent = pool.submit(boost::bind(spawn, &pool, &count));
+         parent.wait();
+         while (__sync_fetch_and_add(&count, 0) < kTasks)
+            boost::this_thread::yield();
+      }
+      expect_true(count == kTasks);
+   }
+
+   test_that("the default thread count is positive")
+   {
+      expect_true(ThreadPool::defaultThreadCount() >= 1);
+      expect_true(sharedThreadPool().threadCount() >= 1);
+   }
+}
+
+} // namespace thread
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,170 @@
+/*
+ * ThreadTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <core/Thread.hpp>
+
+namespace rstudio {
+namespace core {
+namespace thread {
+
+namespace {
+
+const int kThreads = 4;
+const int kValuesPerThread = 10000;
+
+void produce(BoundedQueue<int>* pQueue, int producer)
+{
+   for (int i = 0; i < kValuesPerThread; i++)
+   {
+      while (!pQueue->enque(producer * kValuesPerThread + i))
+         boost::this_thread::yield();
+   }
+}
+
+void consume(BoundedQueue<int>* pQueue, std::vector<int>* pValues)
+{
+   int val;
+   while (pValues->size() < static_cast<std::size_t>(kValuesPerThread))
+   {
+      if (pQueue->deque(&val))
+         pValues->push_back(val);
+      else
+         boost::this_thread::yield();
+   }
+}
+
+} // anonymous namespace
+
+context("Thread")
+{
+   test_that("sharded maps behave like maps")
+   {
+      ShardedThreadsafeMap<std::string, int> map(4);
+      map.set("a", 1);
+      map.set("b", 2);
+      map.set("a", 3);
+      expect_true(map.size() == 2);
+      expect_true(map.contains("a"));
+      expect_true(map.get("a") == 3);
+      expect_true(map.get("c", -1) == -1);
+
+      int value = 0;
+      expect_false(map.get("c", &value));
+      expect_true(map.get("b", &value) && value == 2);
+
+      expect_true(map.collect("b") == 2);
+      expect_false(map.contains("b"));
+      map.remove("a");
+      expect_true(map.size() == 0);
+   }
+
+   test_that("threadsafe maps can collect and report missing keys")
+   {
+      ThreadsafeMap<int, std::string> map;
+      map.set(1, "one");
+      std::string value;
+      expect_false(map.get(2, &value));
+      expect_true(map.get(1, &value) && value == "one");
+      expect_true(map.collect(1) == "one");
+      expect_false(map.contains(1));
+   }
+
+   test_that("threadsafe queues can be drained at once")
+   {
+      ThreadsafeQueue<int> queue(true);
+      std::vector<int> values;
+      expect_false(queue.dequeAll(&values));
+      queue.enque(1);
+      queue.enque(2);
+      expect_true(queue.dequeAll(&values));
+      expect_true(values.size() == 2 && values[0] == 1 && values[1] == 2);
+      expect_true(queue.isEmpty());
+   }
+
+   test_that("bounded queues are fifo and report when full")
+   {
+      BoundedQueue<int> queue(3);
+      expect_true(queue.capacity() == 4);
+
+      int val;
+      expect_false(queue.deque(&val));
+      for (int i = 0; i < 4; i++)
+         expect_true(queue.enque(i));
+      expect_false(queue.enque(4));
+
+      expect_true(queue.deque(&val) && val == 0);
+      expect_true(queue.enque(4));
+
+      std::vector<int> values;
+      expect_true(queue.dequeMany(&values, 2) == 2);
+      expect_true(queue.dequeMany(&values, 10) == 2);
+      expect_true(values.size() == 4);
+      expect_true(values[0] == 1 && values[3] == 4);
+      expect_false(queue.deque(&val));
+   }
+
+   test_that("bounded queues don't lose or duplicate values across threads")
+   {
+      BoundedQueue<int> queue(64);
+      std::vector<std::vector<int> > consumed(kThreads);
+
+      boost::thread_group threads;
+      for (int i = 0; i < kThreads; i++)
+      {
+         threads.create_thread(boost::bind(produce, &queue, i));
+         threads.create_thread(boost::bind(consume, &queue, &consumed[i]));
+      }
+      threads.join_all();
+
+      // every value arrives exactly once, and each producer's values arrive
+      // in order at any given consumer
+      std::vector<int> counts(kThreads * kValuesPerThread, 0);
+      bool ordered = true;
+      for (int c = 0; c < kThreads; c++)
+      {
+         std::vector<int> last(kThreads, -1);
+         for (std::size_t i = 0; i < consumed[c].size(); i++)
+         {
+            int val = consumed[c][i];
+            counts[val]++;
+            int producer = val / kValuesPerThread;
+            if (val <= last[producer])
+               ordered = false;
+            last[producer] = val;
+         }
+      }
+
+      bool exactlyOnce = true;
+      for (std::size_t i = 0; i < counts.size(); i++)
+      {
+         if (counts[i] != 1)
+            exactlyOnce = false;
+      }
+      expect_true(exactlyOnce);
+      expect_true(ordered);
+   }
+}
+
+} // namespace thread
+} // namespace core
+} // namespace rstudio
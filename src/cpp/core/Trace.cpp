@@ -16,20 +16,126 @@
 
 #include <core/Trace.hpp>
 
-#include <map>
+#include <iostream>
+#include <vector>
 
-#include <boost/utility.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/date_time/gregorian/gregorian_types.hpp>
 
 #include <core/Thread.hpp>
+#include <core/json/Json.hpp>
+#include <core/system/System.hpp>
+
+using namespace boost::posix_time;
 
 namespace rstudio {
 namespace core {
 namespace trace {
 
+const char * const kRequestIdHeader = "X-RS-Request-Id";
+
 namespace {
 
 boost::mutex s_traceMutex ;
 
+// enabled flag and buffer capacity (read without locking on every span)
+volatile int s_enabled = 0;
+volatile std::size_t s_bufferCapacity = 8192;
+
+struct SpanRecord
+{
+   SpanRecord() : startMicros(0), durationMicros(0) {}
+   std::string name;
+   std::string requestId;
+   boost::int64_t startMicros;
+   boost::int64_t durationMicros;
+};
+
+// ring buffer of spans for a thread. the mutex is only ever contended
+// by a reader collecting the spans
+struct ThreadBuffer
+{
+   ThreadBuffer(int threadId, std::size_t capacity)
+      : threadId(threadId), capacity(capacity), next(0)
+   {
+   }
+
+   void add(const SpanRecord& span)
+   {
+      if (capacity == 0)
+         return;
+
+      if (spans.size() < capacity)
+      {
+         spans.push_back(span);
+      }
+      else
+      {
+         spans[next] = span;
+         next = (next + 1) % capacity;
+      }
+   }
+
+   boost::mutex mutex;
+   int threadId;
+   std::string threadName;
+   std::size_t capacity;
+   std::size_t next;
+   std::vector<SpanRecord> spans;
+};
+
+// all thread buffers (kept for the life of the process so that spans
+// survive the exit of the thread which recorded them)
+boost::mutex s_registryMutex;
+std::vector<boost::shared_ptr<ThreadBuffer> > s_threadBuffers;
+
+// the tss pointer doesn't own the buffer (the registry does)
+void noCleanup(ThreadBuffer*)
+{
+}
+boost::thread_specific_ptr<ThreadBuffer> s_pCurrentThreadBuffer(noCleanup);
+
+boost::thread_specific_ptr<std::string> s_pCurrentRequestId;
+
+ThreadBuffer& currentThreadBuffer()
+{
+   ThreadBuffer* pBuffer = s_pCurrentThreadBuffer.get();
+   if (pBuffer == NULL)
+   {
+      LOCK_MUTEX(s_registryMutex)
+      {
+         boost::shared_ptr<ThreadBuffer> pNewBuffer(
+               new ThreadBuffer(s_threadBuffers.size() + 1, s_bufferCapacity));
+         s_threadBuffers.push_back(pNewBuffer);
+         pBuffer = pNewBuffer.get();
+      }
+      END_LOCK_MUTEX
+
+      s_pCurrentThreadBuffer.reset(pBuffer);
+   }
+   return *pBuffer;
+}
+
+std::vector<boost::shared_ptr<ThreadBuffer> > allThreadBuffers()
+{
+   LOCK_MUTEX(s_registryMutex)
+   {
+      return s_threadBuffers;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return std::vector<boost::shared_ptr<ThreadBuffer> >();
+}
+
+boost::int64_t microsSinceEpoch(const ptime& time)
+{
+   static const ptime epoch(boost::gregorian::date(1970, 1, 1));
+   return (time - epoch).total_microseconds();
+}
+
 } // anonymous namespace
 
 
@@ -42,6 +148,201 @@ void add(void* key, const std::string& functionName)
    END_LOCK_MUTEX
 }
 
+void setEnabled(bool enabled)
+{
+   s_enabled = enabled ? 1 : 0;
+   __sync_synchronize();
+}
+
+bool enabled()
+{
+   return s_enabled != 0;
+}
+
+void setBufferCapacity(std::size_t capacity)
+{
+   s_bufferCapacity = capacity;
+   __sync_synchronize();
+}
+
+void setThreadName(const std::string& name)
+{
+   ThreadBuffer& buffer = currentThreadBuffer();
+   LOCK_MUTEX(buffer.mutex)
+   {
+      buffer.threadName = name;
+   }
+   END_LOCK_MUTEX
+}
+
+std::string currentRequestId()
+{
+   std::string* pRequestId = s_pCurrentRequestId.get();
+   return pRequestId ? *pRequestId : std::string();
+}
+
+std::string newRequestId()
+{
+   return core::system::generateShortenedUuid();
+}
+
+void recordSpan(const std::string& name,
+                const ptime& startTime,
+                const ptime& endTime,
+                const std::string& requestId)
+{
+   if (!enabled())
+      return;
+
+   SpanRecord span;
+   span.name = name;
+   span.requestId = requestId;
+   span.startMicros = microsSinceEpoch(startTime);
+   span.durationMicros = std::max(static_cast<boost::int64_t>(0),
+                                  (endTime - startTime).total_microseconds());
+
+   ThreadBuffer& buffer = currentThreadBuffer();
+   LOCK_MUTEX(buffer.mutex)
+   {
+      buffer.add(span);
+   }
+   END_LOCK_MUTEX
+}
+
+namespace {
+
+json::Object chromeTraceJson()
+{
+   boost::int64_t pid = core::system::currentProcessId();
+
+   json::Array eventsJson;
+   BOOST_FOREACH(const boost::shared_ptr<ThreadBuffer>& pBuffer,
+                 allThreadBuffers())
+   {
+      LOCK_MUTEX(pBuffer->mutex)
+      {
+         if (!pBuffer->threadName.empty())
+         {
+            json::Object nameArgs;
+            nameArgs["name"] = pBuffer->threadName;
+            json::Object metadataJson;
+            metadataJson["name"] = "thread_name";
+            metadataJson["ph"] = "M";
+            metadataJson["pid"] = pid;
+            metadataJson["tid"] = pBuffer->threadId;
+            metadataJson["args"] = nameArgs;
+            eventsJson.push_back(metadataJson);
+         }
+
+         // oldest spans first
+         std::size_t count = pBuffer->spans.size();
+         for (std::size_t i = 0; i < count; i++)
+         {
+            const SpanRecord& span =
+                  pBuffer->spans[(pBuffer->next + i) % count];
+
+            json::Object eventJson;
+            eventJson["name"] = span.name;
+            eventJson["ph"] = "X";
+            eventJson["ts"] = span.startMicros;
+            eventJson["dur"] = span.durationMicros;
+            eventJson["pid"] = pid;
+            eventJson["tid"] = pBuffer->threadId;
+            if (!span.requestId.empty())
+            {
+               json::Object args;
+               args["request_id"] = span.requestId;
+               eventJson["args"] = args;
+            }
+            eventsJson.push_back(eventJson);
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+   json::Object traceJson;
+   traceJson["traceEvents"] = eventsJson;
+   traceJson["displayTimeUnit"] = "ms";
+   return traceJson;
+}
+
+} // anonymous namespace
+
+void writeChromeTrace(std::ostream& os)
+{
+   json::write(chromeTraceJson(), os);
+}
+
+void clear()
+{
+   BOOST_FOREACH(const boost::shared_ptr<ThreadBuffer>& pBuffer,
+                 allThreadBuffers())
+   {
+      LOCK_MUTEX(pBuffer->mutex)
+      {
+         pBuffer->spans.clear();
+         pBuffer->next = 0;
+      }
+      END_LOCK_MUTEX
+   }
+}
+
+Span::Span(const std::string& name)
+   : active_(enabled())
+{
+   if (active_)
+   {
+      name_ = name;
+      requestId_ = currentRequestId();
+      startTime_ = microsec_clock::universal_time();
+   }
+}
+
+Span::Span(const std::string& name, const std::string& requestId)
+   : active_(enabled())
+{
+   if (active_)
+   {
+      name_ = name;
+      requestId_ = requestId;
+      startTime_ = microsec_clock::universal_time();
+   }
+}
+
+Span::~Span()
+{
+   try
+   {
+      if (active_)
+      {
+         recordSpan(name_,
+                    startTime_,
+                    microsec_clock::universal_time(),
+                    requestId_);
+      }
+   }
+   catch(...)
+   {
+   }
+}
+
+RequestScope::RequestScope(const std::string& requestId)
+   : previousRequestId_(currentRequestId())
+{
+   s_pCurrentRequestId.reset(new std::string(requestId));
+}
+
+RequestScope::~RequestScope()
+{
+   try
+   {
+      s_pCurrentRequestId.reset(new std::string(previousRequestId_));
+   }
+   catch(...)
+   {
+   }
+}
+
 } // namespace trace
 } // namespace core
 } // namespace rstudio
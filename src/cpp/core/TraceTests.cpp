@@ -0,0 +1,153 @@
+/*
+ * TraceTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <core/Trace.hpp>
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+namespace trace {
+
+namespace {
+
+json::Array traceEvents()
+{
+   std::ostringstream ostr;
+   writeChromeTrace(ostr);
+
+   json::Value traceJson;
+   if (!json::parse(ostr.str(), &traceJson) ||
+       !json::isType<json::Object>(traceJson))
+   {
+      return json::Array();
+   }
+
+   return traceJson.get_obj()["traceEvents"].get_array();
+}
+
+int countSpans(const json::Array& events, const std::string& name)
+{
+   int count = 0;
+   for (std::size_t i = 0; i < events.size(); i++)
+   {
+      json::Object event = events[i].get_obj();
+      if (event["ph"].get_str() == "X" && event["name"].get_str() == name)
+         count++;
+   }
+   return count;
+}
+
+void recordNumberedSpans(int count)
+{
+   for (int i = 0; i < count; i++)
+      TRACE_SCOPE("span" + boost::lexical_cast<std::string>(i));
+}
+
+} // anonymous namespace
+
+context("Trace")
+{
+   test_that("spans are only recorded when tracing is enabled")
+   {
+      clear();
+      setEnabled(false);
+      {
+         TRACE_SCOPE("disabled");
+      }
+
+      setEnabled(true);
+      {
+         TRACE_SCOPE("enabled");
+      }
+      setEnabled(false);
+
+      json::Array events = traceEvents();
+      expect_true(countSpans(events, "disabled") == 0);
+      expect_true(countSpans(events, "enabled") == 1);
+   }
+
+   test_that("nested spans are contained by their parent")
+   {
+      clear();
+      setEnabled(true);
+      {
+         TRACE_SCOPE("outer");
+         {
+            TRACE_SCOPE("inner");
+         }
+      }
+      setEnabled(false);
+
+      json::Array events = traceEvents();
+      expect_true(events.size() == 2);
+
+      // inner completes first
+      json::Object inner = events[0].get_obj();
+      json::Object outer = events[1].get_obj();
+      expect_true(inner["name"].get_str() == "inner");
+      expect_true(outer["name"].get_str() == "outer");
+      expect_true(inner["ts"].get_int64() >= outer["ts"].get_int64());
+      expect_true(inner["ts"].get_int64() + inner["dur"].get_int64() <=
+                  outer["ts"].get_int64() + outer["dur"].get_int64());
+   }
+
+   test_that("spans carry the current request id")
+   {
+      clear();
+      setEnabled(true);
+      {
+         RequestScope scope("request-1");
+         expect_true(currentRequestId() == "request-1");
+         TRACE_SCOPE("request");
+      }
+      expect_true(currentRequestId().empty());
+      setEnabled(false);
+
+      json::Array events = traceEvents();
+      expect_true(events.size() == 1);
+      json::Object args = events[0].get_obj()["args"].get_obj();
+      expect_true(args["request_id"].get_str() == "request-1");
+   }
+
+   test_that("thread buffers retain only the most recent spans")
+   {
+      clear();
+      setEnabled(true);
+      setBufferCapacity(4);
+      boost::thread thread(boost::bind(recordNumberedSpans, 10));
+      thread.join();
+      setBufferCapacity(8192);
+      setEnabled(false);
+
+      json::Array events = traceEvents();
+      expect_true(events.size() == 4);
+      expect_true(countSpans(events, "span5") == 0);
+      expect_true(countSpans(events, "span6") == 1);
+      expect_true(events[0].get_obj()["name"].get_str() == "span6");
+      expect_true(events[3].get_obj()["name"].get_str() == "span9");
+   }
+}
+
+} // namespace trace
+} // namespace core
+} // namespace rstudio
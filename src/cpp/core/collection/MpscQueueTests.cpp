@@ -0,0 +1,91 @@
+/*
+ * MpscQueueTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <core/collection/MpscQueue.hpp>
+
+namespace rstudio {
+namespace core {
+namespace collection {
+
+namespace {
+
+const int kProducers = 4;
+const int kItemsPerProducer = 10000;
+
+void produce(MpscQueue<int>* pQueue, int producer)
+{
+   for (int i = 0; i < kItemsPerProducer; i++)
+      pQueue->push(producer * kItemsPerProducer + i);
+}
+
+} // anonymous namespace
+
+context("MpscQueue")
+{
+   test_that("items are removed in the order they were pushed")
+   {
+      MpscQueue<int> queue;
+      expect_true(queue.empty());
+
+      queue.push(1);
+      queue.push(2);
+      queue.push(3);
+      expect_false(queue.empty());
+
+      std::vector<int> items;
+      expect_true(queue.popAll(&items));
+      expect_true(items.size() == 3);
+      expect_true(items[0] == 1 && items[1] == 2 && items[2] == 3);
+      expect_true(queue.empty());
+      expect_false(queue.popAll(&items));
+   }
+
+   test_that("concurrent producers don't lose items")
+   {
+      MpscQueue<int> queue;
+      boost::thread_group producers;
+      for (int i = 0; i < kProducers; i++)
+         producers.create_thread(boost::bind(produce, &queue, i));
+
+      // consume while producing
+      std::vector<int> items;
+      while (items.size() < static_cast<std::size_t>(kProducers * kItemsPerProducer))
+         queue.popAll(&items);
+      producers.join_all();
+
+      // each producer's items arrive in order
+      std::vector<int> next(kProducers, 0);
+      bool ordered = true;
+      for (std::size_t i = 0; i < items.size(); i++)
+      {
+         int producer = items[i] / kItemsPerProducer;
+         if (items[i] % kItemsPerProducer != next[producer]++)
+            ordered = false;
+      }
+      expect_true(ordered);
+      expect_true(queue.empty());
+   }
+}
+
+} // namespace collection
+} // namespace core
+} // namespace rstudio
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <map>
 #include <set>
 #include <vector>
 
@@ -77,24 +78,70 @@ std::string proxyLockFileName()
          
 }
 
-bool isLockFileStale(const FilePath& lockFilePath)
+enum LockFileState
 {
-   return LinkBasedFileLock::isLockFileStale(lockFilePath);
+   LockFileMissing,
+   LockFileHeld,
+   LockFileStale
+};
+
+// determine whether the lock file exists and whether its lease (refreshed
+// by the holder every refresh interval) has expired with a single stat
+// (each of which is a round trip to the server on nfs)
+LockFileState lockFileState(const FilePath& lockFilePath)
+{
+   struct stat info;
+   if (::stat(lockFilePath.absolutePathNative().c_str(), &info) == -1)
+      return LockFileMissing;
+
+   double seconds = FileLock::getTimeoutInterval().total_seconds();
+   double diff = ::difftime(::time(NULL), info.st_mtime);
+   return diff >= seconds ? LockFileStale : LockFileHeld;
 }
 
 } // end anonymous namespace
 
 bool LinkBasedFileLock::isLockFileStale(const FilePath& lockFilePath)
 {
-   double seconds = s_timeoutInterval.total_seconds();
-   double diff = ::difftime(::time(NULL), lockFilePath.lastWriteTime());
-   return diff >= seconds;
+   return lockFileState(lockFilePath) != LockFileHeld;
 }
 
 namespace {
 
+bool isLockFileStale(const FilePath& lockFilePath)
+{
+   return LinkBasedFileLock::isLockFileStale(lockFilePath);
+}
+
+// returns true if the directory is due for a scan for stale lockfiles. lock
+// files only become stale when their lease expires, so scanning a directory
+// more often than the timeout interval can't find anything new (and every
+// scan lists and stats the whole directory, which is expensive on nfs)
+bool shouldCleanStaleLockfiles(const FilePath& dir)
+{
+   static boost::mutex s_mutex;
+   static std::map<std::string, std::time_t> s_lastCleaned;
+
+   std::time_t now = ::time(NULL);
+   double seconds = FileLock::getTimeoutInterval().total_seconds();
+   LOCK_MUTEX(s_mutex)
+   {
+      std::time_t& lastCleaned = s_lastCleaned[dir.absolutePath()];
+      if (lastCleaned != 0 && ::difftime(now, lastCleaned) < seconds)
+         return false;
+      lastCleaned = now;
+      return true;
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
 void cleanStaleLockfiles(const FilePath& dir)
 {
+   if (!shouldCleanStaleLockfiles(dir))
+      return;
+
    std::vector<FilePath> children;
    Error error = dir.children(&children);
    if (error)
@@ -136,14 +183,19 @@ public:
    
    void refreshLocks()
    {
+      // refresh outside of the mutex (so that slow writes on nfs don't
+      // hold up threads acquiring or releasing other locks)
+      std::set<FilePath> registration;
       LOCK_MUTEX(mutex_)
       {
-         BOOST_FOREACH(const FilePath& lockFilePath, registration_)
-         {
-            lockFilePath.setLastWriteTime();
-         }
+         registration = registration_;
       }
       END_LOCK_MUTEX
+
+      BOOST_FOREACH(const FilePath& lockFilePath, registration)
+      {
+         lockFilePath.setLastWriteTime();
+      }
    }
    
    void clearLocks()
@@ -254,20 +306,18 @@ FilePath LinkBasedFileLock::lockFilePath() const
 
 bool LinkBasedFileLock::isLocked(const FilePath& lockFilePath) const
 {
-   if (!lockFilePath.exists())
-      return false;
-   
-   return !isLockFileStale(lockFilePath);
+   return lockFileState(lockFilePath) == LockFileHeld;
 }
 
 Error LinkBasedFileLock::acquire(const FilePath& lockFilePath)
 {
    // if the lock file exists...
-   if (lockFilePath.exists())
+   LockFileState state = lockFileState(lockFilePath);
+   if (state != LockFileMissing)
    {
       // ... and it's stale, it's a leftover lock from a previously
       // (crashed?) process. remove it and acquire our own lock
-      if (isLockFileStale(lockFilePath))
+      if (state == LockFileStale)
       {
          // note that multiple processes may attempt to remove this
          // file at the same time, so errors shouldn't be fatal
@@ -15,14 +15,25 @@
 
 #include <core/gwt/GwtFileHandler.hpp>
 
+#include <map>
+
+#include <boost/foreach.hpp>
 #include <boost/regex.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <core/Error.hpp>
 #include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
 #include <core/text/TemplateFilter.hpp>
 #include <core/system/System.hpp>
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
+#include <core/http/ResponseCompression.hpp>
+#include <core/http/Util.hpp>
 
 
 namespace rstudio {
@@ -30,7 +41,154 @@ namespace core {
 namespace gwt {   
    
 namespace {
-   
+
+// files larger than this aren't preloaded (nor are any files once the total
+// preloaded reaches the limit)
+const uintmax_t kMaxPreloadedFileSize = 64 * 1024 * 1024;
+const uintmax_t kMaxPreloadedTotalSize = 512 * 1024 * 1024;
+
+struct StaticAsset
+{
+   std::time_t lastWriteTime;
+   std::string contentType;
+   std::string contents;
+   std::string eTag;
+
+   // empty if compression doesn't make the file meaningfully smaller
+   std::string gzipContents;
+   std::string gzipETag;
+};
+
+typedef std::map<std::string, boost::shared_ptr<const StaticAsset> > StaticAssets;
+
+// preloaded assets keyed by absolute path (never freed as they may be
+// accessed by handlers on any thread during shutdown)
+boost::mutex& staticAssetsMutex()
+{
+   static boost::mutex* pMutex = new boost::mutex();
+   return *pMutex;
+}
+
+StaticAssets& staticAssets()
+{
+   static StaticAssets* pAssets = new StaticAssets();
+   return *pAssets;
+}
+
+Error loadStaticAsset(const FilePath& filePath,
+                      boost::shared_ptr<const StaticAsset>* ppAsset)
+{
+   boost::shared_ptr<StaticAsset> pAsset(new StaticAsset());
+   pAsset->lastWriteTime = filePath.lastWriteTime();
+   pAsset->contentType = filePath.mimeContentType();
+
+   Error error = core::readStringFromFile(filePath, &pAsset->contents);
+   if (error)
+      return error;
+   std::string contentHash = hash::xxHash64Hex(pAsset->contents);
+   pAsset->eTag = "\"" + contentHash + "\"";
+
+#ifndef _WIN32
+   // use a precompressed variant alongside the file if there is an up to
+   // date one, otherwise compress it ourselves
+   FilePath gzipPath(filePath.absolutePath() + ".gz");
+   if (gzipPath.exists() && gzipPath.lastWriteTime() >= pAsset->lastWriteTime)
+      error = core::readStringFromFile(gzipPath, &pAsset->gzipContents);
+   else
+      error = http::compress(pAsset->contents,
+                             http::kGzipEncoding,
+                             &pAsset->gzipContents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      pAsset->gzipContents.clear();
+   }
+
+   // not worth it (e.g. images)
+   if (pAsset->gzipContents.size() > pAsset->contents.size() * 0.9)
+      pAsset->gzipContents.clear();
+
+   // each encoding is a distinct representation so needs a distinct etag
+   if (!pAsset->gzipContents.empty())
+   {
+      pAsset->gzipETag = "\"" + contentHash + "-gzip\"";
+   }
+#endif
+
+   *ppAsset = pAsset;
+   return Success();
+}
+
+boost::shared_ptr<const StaticAsset> staticAsset(const FilePath& filePath)
+{
+   boost::shared_ptr<const StaticAsset> pAsset;
+   LOCK_MUTEX(staticAssetsMutex())
+   {
+      StaticAssets::iterator it = staticAssets().find(filePath.absolutePath());
+      if (it != staticAssets().end())
+         pAsset = it->second;
+   }
+   END_LOCK_MUTEX
+
+   // check that it hasn't changed on disk (if it has then forget it)
+   if (pAsset && pAsset->lastWriteTime != filePath.lastWriteTime())
+   {
+      LOCK_MUTEX(staticAssetsMutex())
+      {
+         staticAssets().erase(filePath.absolutePath());
+      }
+      END_LOCK_MUTEX
+      pAsset.reset();
+   }
+
+   return pAsset;
+}
+
+bool addStaticFile(const FilePath& filePath, std::vector<FilePath>* pFiles)
+{
+   if (!filePath.isDirectory())
+      pFiles->push_back(filePath);
+   return true;
+}
+
+// serve a preloaded file (returns false if the file isn't preloaded)
+bool setStaticAssetResponse(const FilePath& filePath,
+                            const http::Request& request,
+                            http::Response* pResponse)
+{
+   boost::shared_ptr<const StaticAsset> pAsset = staticAsset(filePath);
+   if (!pAsset)
+      return false;
+
+   bool gzip = !pAsset->gzipContents.empty() &&
+               request.acceptsEncoding(http::kGzipEncoding);
+   const std::string& eTag = gzip ? pAsset->gzipETag : pAsset->eTag;
+
+   pResponse->setContentType(pAsset->contentType);
+   pResponse->setHeader("ETag", eTag);
+   pResponse->setHeader("Last-Modified", http::util::httpDate(
+         boost::posix_time::from_time_t(pAsset->lastWriteTime)));
+   if (!pAsset->gzipContents.empty())
+      pResponse->setHeader("Vary", "Accept-Encoding");
+
+   if (boost::algorithm::contains(request.headerValue("If-None-Match"), eTag))
+   {
+      pResponse->removeHeader("Content-Type");
+      pResponse->setStatusCode(http::status::NotModified);
+      return true;
+   }
+
+   if (gzip)
+   {
+      pResponse->setBodyUnencoded(pAsset->gzipContents);
+      pResponse->setContentEncoding(http::kGzipEncoding);
+   }
+   else
+   {
+      pResponse->setBodyUnencoded(pAsset->contents);
+   }
+   return true;
+}
 
 void handleFileRequest(const std::string& wwwLocalPath,
                        const std::string& baseUri,
@@ -92,18 +250,27 @@ void handleFileRequest(const std::string& wwwLocalPath,
       return;
    }
    
-   // case: files designated to be cached "forever"
-   if (regex_match(uri, boost::regex(".*\\.cache\\..*")))
+   static const boost::regex reCacheFile(".*\\.cache\\..*");
+   static const boost::regex reNoCacheFile(".*\\.nocache\\..*");
+
+   // case: files designated to be cached "forever" (their names include a
+   // hash of their contents so they never change)
+   if (regex_match(uri, reCacheFile))
    {
       pResponse->setCacheForeverHeaders();
-      pResponse->setFile(filePath, request);
+      pResponse->setHeader("Cache-Control",
+                           pResponse->headerValue("Cache-Control") +
+                           ", immutable");
+      if (!setStaticAssetResponse(filePath, request, pResponse))
+         pResponse->setFile(filePath, request);
    }
    
    // case: files designated to never be cached 
-   else if (regex_match(uri, boost::regex(".*\\.nocache\\..*")))
+   else if (regex_match(uri, reNoCacheFile))
    {
       pResponse->setNoCacheHeaders();
-      pResponse->setFile(filePath, request);
+      if (!setStaticAssetResponse(filePath, request, pResponse))
+         pResponse->setFile(filePath, request);
    }
    // case: main page -- don't cache and dynamically set compiler stack mode
    else if (uri == mainPage)
@@ -133,12 +300,59 @@ void handleFileRequest(const std::string& wwwLocalPath,
    {
       // since these are application components we force revalidation
       pResponse->setCacheWithRevalidationHeaders();
-      pResponse->setCacheableFile(filePath, request);
+      if (!setStaticAssetResponse(filePath, request, pResponse))
+         pResponse->setCacheableFile(filePath, request);
    }
   
 }
    
 } // anonymous namespace
+
+Error preloadStaticAssets(const std::string& wwwLocalPath)
+{
+   std::vector<FilePath> files;
+   Error error = FilePath(wwwLocalPath).childrenRecursive(
+                           boost::bind(addStaticFile, _2, &files));
+   if (error)
+      return error;
+
+   uintmax_t totalSize = 0;
+   std::size_t count = 0;
+   BOOST_FOREACH(const FilePath& filePath, files)
+   {
+      if (filePath.extensionLowerCase() == ".gz")
+         continue;
+
+      uintmax_t size = filePath.size();
+      if (size > kMaxPreloadedFileSize ||
+          totalSize + size > kMaxPreloadedTotalSize)
+      {
+         continue;
+      }
+
+      boost::shared_ptr<const StaticAsset> pAsset;
+      error = loadStaticAsset(filePath, &pAsset);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      LOCK_MUTEX(staticAssetsMutex())
+      {
+         staticAssets()[filePath.absolutePath()] = pAsset;
+      }
+      END_LOCK_MUTEX
+
+      totalSize += size;
+      count++;
+   }
+
+   LOG_INFO_MESSAGE("Preloaded " + safe_convert::numberToString(count) +
+                    " static files (" +
+                    safe_convert::numberToString(totalSize / 1024) + " KB)");
+   return Success();
+}
    
 http::UriHandlerFunction fileHandlerFunction(
                                        const std::string& wwwLocalPath,
@@ -0,0 +1,275 @@
+/*
+ * FileResponseBody.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/FileResponseBody.hpp>
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <boost/iostreams/filter/gzip.hpp>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include <boost/iostreams/device/back_inserter.hpp>
+
+#include <core/http/Response.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// size of chunks read from the file when not using sendfile
+const std::size_t kChunkSize = 64 * 1024;
+
+// maximum size of an individual sendfile call
+const std::size_t kMaxSendFileSize = 0x7ffff000;
+
+} // anonymous namespace
+
+Error FileResponseBody::create(const Response& response,
+                               boost::shared_ptr<FileResponseBody>* pBody)
+{
+   boost::shared_ptr<FileResponseBody> pNewBody(
+            new FileResponseBody(response.fileBody(),
+                                 response.contentEncoding() == kGzipEncoding));
+   Error error = pNewBody->open();
+   if (error)
+      return error;
+
+   *pBody = pNewBody;
+   return Success();
+}
+
+FileResponseBody::FileResponseBody(const FilePath& filePath, bool gzip)
+   : filePath_(filePath),
+     gzip_(gzip),
+     complete_(false),
+     size_(0),
+     offset_(0),
+     fd_(-1)
+{
+}
+
+FileResponseBody::~FileResponseBody()
+{
+   try
+   {
+#ifndef _WIN32
+      if (fd_ != -1)
+         ::close(fd_);
+#endif
+   }
+   catch(...)
+   {
+   }
+}
+
+Error FileResponseBody::open()
+{
+   // note the size up front (this is what we told the client in the
+   // Content-Length header so we never write more than this)
+   size_ = filePath_.size();
+
+#ifndef _WIN32
+   if (canSendFile())
+   {
+      fd_ = ::open(filePath_.absolutePath().c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd_ == -1)
+      {
+         Error error = systemError(errno, ERROR_LOCATION);
+         error.addProperty("path", filePath_.absolutePath());
+         return error;
+      }
+      return Success();
+   }
+#endif
+
+   Error error = filePath_.open_r(&pIfs_);
+   if (error)
+      return error;
+
+   buffer_.resize(kChunkSize);
+
+#ifndef _WIN32
+   if (gzip_)
+   {
+      pCompressor_.reset(new boost::iostreams::filtering_ostream());
+      pCompressor_->push(boost::iostreams::gzip_compressor(), kChunkSize);
+      pCompressor_->push(boost::iostreams::back_inserter(compressed_));
+   }
+#endif
+
+   return Success();
+}
+
+bool FileResponseBody::canSendFile() const
+{
+#ifdef __linux__
+   return !gzip_;
+#else
+   return false;
+#endif
+}
+
+Error FileResponseBody::readChunk(std::string* pChunk)
+{
+   pChunk->clear();
+
+   try
+   {
+      // the compressor may not yield output for every block so keep
+      // reading until we have something to return
+      while (pChunk->empty() && !complete_)
+      {
+         pIfs_->read(&buffer_[0], buffer_.size());
+         if (pIfs_->bad())
+         {
+            Error error = systemError(boost::system::errc::io_error,
+                                      ERROR_LOCATION);
+            error.addProperty("path", filePath_.absolutePath());
+            return error;
+         }
+         std::size_t read = static_cast<std::size_t>(pIfs_->gcount());
+         bool eof = pIfs_->eof() || read == 0;
+
+         if (pCompressor_)
+         {
+            if (read > 0)
+               pCompressor_->write(&buffer_[0], read);
+
+            // closing the chain flushes the gzip trailer
+            if (eof)
+            {
+               pCompressor_->reset();
+               complete_ = true;
+            }
+
+            pChunk->swap(compressed_);
+            compressed_.clear();
+         }
+         else
+         {
+            read = static_cast<std::size_t>(
+                     std::min<uintmax_t>(read, size_ - offset_));
+            pChunk->assign(&buffer_[0], read);
+            offset_ += read;
+
+            if (offset_ >= size_)
+               complete_ = true;
+            else if (eof)
+               return truncatedError(ERROR_LOCATION);
+         }
+      }
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", filePath_.absolutePath());
+      return error;
+   }
+
+   return Success();
+}
+
+Error FileResponseBody::sendFile(int socketFd, bool* pWouldBlock)
+{
+   *pWouldBlock = false;
+
+#ifdef __linux__
+   while (offset_ < size_)
+   {
+      off_t offset = static_cast<off_t>(offset_);
+      std::size_t count = static_cast<std::size_t>(
+               std::min<uintmax_t>(size_ - offset_, kMaxSendFileSize));
+      ssize_t sent = ::sendfile(socketFd, fd_, &offset, count);
+      if (sent < 0)
+      {
+         if (errno == EINTR)
+            continue;
+
+         if (errno == EAGAIN || errno == EWOULDBLOCK)
+         {
+            *pWouldBlock = true;
+            return Success();
+         }
+
+         return systemError(errno, ERROR_LOCATION);
+      }
+      else if (sent == 0)
+      {
+         // the file was truncated after we sent Content-Length
+         return truncatedError(ERROR_LOCATION);
+      }
+
+      offset_ += sent;
+   }
+
+   complete_ = true;
+   return Success();
+#else
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+#endif
+}
+
+Error FileResponseBody::sendFileBlocking(int socketFd)
+{
+#ifndef _WIN32
+   while (!complete())
+   {
+      bool wouldBlock;
+      Error error = sendFile(socketFd, &wouldBlock);
+      if (error)
+         return error;
+
+      // the socket may be in non-blocking mode (e.g. if asio has used it
+      // for async operations) so wait for it to become writable
+      if (wouldBlock)
+      {
+         struct pollfd pfd;
+         pfd.fd = socketFd;
+         pfd.events = POLLOUT;
+         pfd.revents = 0;
+         if (::poll(&pfd, 1, -1) == -1 && errno != EINTR)
+            return systemError(errno, ERROR_LOCATION);
+      }
+   }
+   return Success();
+#else
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+#endif
+}
+
+Error FileResponseBody::truncatedError(const ErrorLocation& location) const
+{
+   Error error = systemError(boost::system::errc::io_error,
+                             "File was truncated while being sent",
+                             location);
+   error.addProperty("path", filePath_.absolutePath());
+   return error;
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
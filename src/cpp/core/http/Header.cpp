@@ -29,6 +29,20 @@ bool HeaderNamePredicate::operator()(const Header& header) const
    return boost::iequals(name_, header.name); 
 }
    
+std::size_t headerNameHash(const std::string& name)
+{
+   // FNV-1a over the lowercased name
+   std::size_t hash = 2166136261U;
+   for (std::string::const_iterator it = name.begin(); it != name.end(); ++it)
+   {
+      unsigned char ch = static_cast<unsigned char>(*it);
+      if (ch >= 'A' && ch <= 'Z')
+         ch = ch - 'A' + 'a';
+      hash = (hash ^ ch) * 16777619U;
+   }
+   return hash;
+}
+
 bool containsHeader(const Headers& headers, const std::string& name)
 {
    return findHeader(headers, name) != headers.end();
@@ -19,6 +19,7 @@
 
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/function.hpp>
 #include <boost/asio/buffer.hpp>
 
@@ -30,6 +31,7 @@ namespace http {
   
 // encodings
 const char * const kGzipEncoding = "gzip";     
+const char * const kDeflateEncoding = "deflate";
    
 void Message::setHttpVersion(int httpVersionMajor, int httpVersionMinor) 
 {
@@ -67,22 +69,30 @@ void Message::addHeader(const std::string& name, const std::string& value)
    
 void Message::addHeader(const Header& header)
 {
-   headers_.push_back(header);
+   indexHeaders();
+   mutableHeaders().push_back(header);
+   pHeaders_->nameHashes.push_back(headerNameHash(header.name));
 }
    
 void Message::addHeaders(const std::vector<Header>& headers)
 {
-   std::copy(headers.begin(), headers.end(), std::back_inserter(headers_));
+   std::for_each(headers.begin(),
+                 headers.end(),
+                 boost::bind(&Message::addHeader, this, _1));
 }
 
 std::string Message::headerValue(const std::string& name) const
 {
-   return http::headerValue(headers_, name);
+   std::size_t index = findHeaderIndex(name);
+   if (index != std::string::npos)
+      return pHeaders_->headers[index].value;
+   else
+      return std::string();
 }
 
 bool Message::containsHeader(const std::string& name) const
 {
-   return http::containsHeader(headers_, name);
+   return findHeaderIndex(name) != std::string::npos;
 }
    
 void Message::setHeaderLine(const std::string& line)
@@ -99,15 +109,13 @@ void Message::setHeader(const Header& header)
 
 void Message::setHeader(const std::string& name, const std::string& value) 
 {
-   Headers::iterator it = std::find_if(headers_.begin(), 
-                                       headers_.end(),
-                                       HeaderNamePredicate(name));
-   if ( it != headers_.end() )
+   std::size_t index = findHeaderIndex(name);
+   if (index != std::string::npos)
    {
       Header hdr ;
       hdr.name = name ;
       hdr.value = value ;
-      *it = hdr ;
+      mutableHeaders()[index] = hdr ;
    }
    else
    {
@@ -122,22 +130,99 @@ void Message::setHeader(const std::string& name, int value)
 
 void Message::replaceHeader(const std::string& name, const std::string& value) 
 {
-   Header hdr ;
-   hdr.name = name ;
-   hdr.value = value ; 
-   std::replace_if(headers_.begin(), 
-                   headers_.end(), 
-                   HeaderNamePredicate(name), 
-                   hdr) ;
+   if (!containsHeader(name))
+      return;
+
+   indexHeaders();
+   Headers& headers = mutableHeaders();
+   const std::vector<std::size_t>& hashes = pHeaders_->nameHashes;
+   std::size_t hash = headerNameHash(name);
+   for (std::size_t i = 0; i < headers.size(); ++i)
+   {
+      if (hashes[i] == hash && boost::algorithm::iequals(headers[i].name, name))
+      {
+         Header hdr ;
+         hdr.name = name ;
+         hdr.value = value ;
+         headers[i] = hdr ;
+      }
+   }
 }
 
 
 void Message::removeHeader(const std::string& name) 
 {
-   headers_.erase(std::remove_if(headers_.begin(), 
-                                 headers_.end(),
-                                 HeaderNamePredicate(name)), 
-                  headers_.end())  ;
+   if (!containsHeader(name))
+      return;
+
+   indexHeaders();
+   Headers& headers = mutableHeaders();
+   std::vector<std::size_t>& hashes = pHeaders_->nameHashes;
+   std::size_t hash = headerNameHash(name);
+
+   // compact the headers (and their hashes) we are keeping
+   std::size_t kept = 0;
+   for (std::size_t i = 0; i < headers.size(); ++i)
+   {
+      if (hashes[i] == hash && boost::algorithm::iequals(headers[i].name, name))
+         continue;
+
+      if (kept != i)
+      {
+         headers[kept] = headers[i];
+         hashes[kept] = hashes[i];
+      }
+      ++kept;
+   }
+   headers.resize(kept);
+   hashes.resize(kept);
+}
+
+Headers& Message::mutableHeaders()
+{
+   // copy on write
+   if (!pHeaders_.unique())
+      pHeaders_.reset(new HeaderStore(*pHeaders_));
+   return pHeaders_->headers;
+}
+
+void Message::indexHeaders()
+{
+   if (pHeaders_->nameHashes.size() == pHeaders_->headers.size())
+      return;
+
+   const Headers& headers = mutableHeaders();
+   std::vector<std::size_t>& hashes = pHeaders_->nameHashes;
+   while (hashes.size() < headers.size())
+      hashes.push_back(headerNameHash(headers[hashes.size()].name));
+}
+
+std::size_t Message::findHeaderIndex(const std::string& name) const
+{
+   const Headers& headers = pHeaders_->headers;
+   const std::vector<std::size_t>& hashes = pHeaders_->nameHashes;
+
+   if (!hashes.empty())
+   {
+      std::size_t hash = headerNameHash(name);
+      for (std::size_t i = 0; i < hashes.size(); ++i)
+      {
+         if (hashes[i] == hash &&
+             boost::algorithm::iequals(headers[i].name, name))
+         {
+            return i;
+         }
+      }
+   }
+
+   // headers which haven't been indexed yet
+   for (std::size_t i = hashes.size(); i < headers.size(); ++i)
+   {
+      if (boost::algorithm::iequals(headers[i].name, name))
+         return i;
+   }
+
+   return std::string::npos;
 }
  
    
@@ -145,7 +230,15 @@ void Message::reset()
 {
    setHttpVersion(1,1) ;
    httpVersion_.clear() ;
-   headers_.clear() ;
+   if (pHeaders_.unique())
+   {
+      pHeaders_->headers.clear();
+      pHeaders_->nameHashes.clear();
+   }
+   else
+   {
+      pHeaders_.reset(new HeaderStore());
+   }
    body_.clear() ;
    
    // allow additional reseting by subclasses
@@ -182,8 +275,9 @@ std::vector<boost::asio::const_buffer> Message::toBuffers(
    overrideHeader_ = overrideHeader;
    
    // headers
+   const Headers& headers = pHeaders_->headers;
    for (Headers::const_iterator 
-        it = headers_.begin(); it != headers_.end(); ++it)
+        it = headers.begin(); it != headers.end(); ++it)
    {
       // add the header if it isn't being overriden
       if (it->name != overrideHeader_.name)
@@ -0,0 +1,312 @@
+/*
+ * MultipartParser.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/MultipartParser.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include <boost/regex.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// part headers larger than this are rejected
+const std::size_t kMaxPartHeaderBytes = 64 * 1024;
+
+Error multipartError(const std::string& reason, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::protocol_error, location);
+   error.addProperty("reason", reason);
+   return error;
+}
+
+} // anonymous namespace
+
+MultipartParser::MultipartParser(const std::string& boundary)
+   : delimiter_("\r\n--" + boundary),
+     state_(Preamble),
+     matched_(2)
+{
+}
+
+std::string MultipartParser::boundary(const std::string& contentType)
+{
+   std::string boundaryPrefix("boundary=");
+   std::size_t prefixLoc = contentType.find(boundaryPrefix);
+   if (prefixLoc == std::string::npos)
+      return std::string();
+
+   std::string boundary = contentType.substr(prefixLoc + boundaryPrefix.size());
+   std::size_t endLoc = boundary.find(';');
+   if (endLoc != std::string::npos)
+      boundary.erase(endLoc);
+   boost::algorithm::trim(boundary);
+
+   // the boundary may be quoted
+   if (boundary.size() >= 2 &&
+       boundary[0] == '"' && boundary[boundary.size() - 1] == '"')
+   {
+      boundary = boundary.substr(1, boundary.size() - 2);
+   }
+
+   return boundary;
+}
+
+Error MultipartParser::parse(const char* data,
+                             std::size_t size,
+                             MultipartHandler* pHandler)
+{
+   const char* begin = data;
+   const char* end = data + size;
+   Error error;
+   while (begin != end && !error)
+   {
+      switch(state_)
+      {
+      case Preamble:
+      case PartBody:
+         begin = parseDelimited(begin, end, pHandler, &error);
+         break;
+      case DelimiterLine:
+         begin = parseDelimiterLine(begin, end, &error);
+         break;
+      case PartHeaders:
+         begin = parseHeaders(begin, end, pHandler, &error);
+         break;
+      case Complete:
+         // ignore the epilogue
+         return Success();
+      }
+   }
+
+   return error;
+}
+
+Error MultipartParser::onData(const char* data,
+                              std::size_t size,
+                              MultipartHandler* pHandler)
+{
+   // the preamble is discarded
+   if (state_ != PartBody || size == 0)
+      return Success();
+
+   return pHandler->onPartData(data, size);
+}
+
+const char* MultipartParser::parseDelimited(const char* begin,
+                                            const char* end,
+                                            MultipartHandler* pHandler,
+                                            Error* pError)
+{
+   const char* delimiter = delimiter_.data();
+   std::size_t delimiterSize = delimiter_.size();
+
+   // continue matching a delimiter begun at the end of the previous chunk
+   if (matched_ > 0)
+   {
+      const char* pos = begin;
+      std::size_t matched = matched_;
+      while (pos != end && matched < delimiterSize &&
+             *pos == delimiter[matched])
+      {
+         ++pos;
+         ++matched;
+      }
+
+      if (matched == delimiterSize)
+      {
+         matched_ = 0;
+         if (state_ == PartBody)
+            *pError = pHandler->onPartEnd();
+         state_ = DelimiterLine;
+         lineBuffer_.clear();
+         return pos;
+      }
+      else if (pos == end)
+      {
+         matched_ = matched;
+         return end;
+      }
+
+      // not a delimiter after all: the bytes matched are data. the
+      // delimiter's only CR is its first byte so no other delimiter can
+      // begin within them
+      matched_ = 0;
+      *pError = onData(delimiter, matched, pHandler);
+      if (*pError)
+         return end;
+      begin = pos;
+   }
+
+   // every delimiter begins with a CR so candidates are found with memchr
+   const char* pos = begin;
+   while (pos != end)
+   {
+      const char* cr = static_cast<const char*>(
+                                 std::memchr(pos, '\r', end - pos));
+      if (cr == NULL)
+         break;
+
+      std::size_t available = std::min<std::size_t>(end - cr, delimiterSize);
+      if (std::memcmp(cr, delimiter, available) == 0)
+      {
+         *pError = onData(begin, cr - begin, pHandler);
+         if (*pError)
+            return end;
+
+         // delimiter continues into the next chunk
+         if (available < delimiterSize)
+         {
+            matched_ = available;
+            return end;
+         }
+
+         if (state_ == PartBody)
+            *pError = pHandler->onPartEnd();
+         state_ = DelimiterLine;
+         lineBuffer_.clear();
+         return cr + delimiterSize;
+      }
+
+      pos = cr + 1;
+   }
+
+   *pError = onData(begin, end - begin, pHandler);
+   return end;
+}
+
+const char* MultipartParser::parseDelimiterLine(const char* begin,
+                                                const char* end,
+                                                Error* pError)
+{
+   // the delimiter is followed by "--" (the closing delimiter) or by
+   // optional whitespace and a CRLF
+   const char* pos = begin;
+   while (pos != end)
+   {
+      char ch = *pos++;
+      lineBuffer_.push_back(ch);
+
+      if (lineBuffer_ == "--")
+      {
+         state_ = Complete;
+         return end;
+      }
+      else if (ch == '\n')
+      {
+         state_ = PartHeaders;
+         headerBuffer_.clear();
+         return pos;
+      }
+      else if (ch != '\r' && ch != ' ' && ch != '\t' &&
+               !(ch == '-' && lineBuffer_.size() == 1))
+      {
+         *pError = multipartError("Invalid multipart boundary",
+                                  ERROR_LOCATION);
+         return end;
+      }
+   }
+
+   return end;
+}
+
+const char* MultipartParser::parseHeaders(const char* begin,
+                                          const char* end,
+                                          MultipartHandler* pHandler,
+                                          Error* pError)
+{
+   // headers end with an empty line
+   const char* pos = begin;
+   while (pos != end)
+   {
+      const char* lf = static_cast<const char*>(
+                                 std::memchr(pos, '\n', end - pos));
+      const char* next = (lf != NULL) ? lf + 1 : end;
+      headerBuffer_.append(pos, next);
+      pos = next;
+
+      if (headerBuffer_.size() > kMaxPartHeaderBytes)
+      {
+         *pError = multipartError("Multipart headers too large",
+                                  ERROR_LOCATION);
+         return end;
+      }
+
+      if (lf == NULL)
+         break;
+
+      std::size_t size = headerBuffer_.size();
+      bool emptyLine =
+            (size == 2 && headerBuffer_ == "\r\n") ||
+            (size >= 4 && headerBuffer_.compare(size - 4, 4, "\r\n\r\n") == 0);
+      if (emptyLine)
+      {
+         std::istringstream headerStream(headerBuffer_);
+         headerStream.unsetf(std::ios::skipws);
+         Headers headers;
+         http::parseHeaders(headerStream, &headers);
+
+         state_ = PartBody;
+         *pError = pHandler->onPartBegin(headers);
+         return pos;
+      }
+   }
+
+   return end;
+}
+
+bool formDataPartName(const Headers& headers,
+                      std::string* pName,
+                      std::string* pFilename,
+                      bool* pIsFile)
+{
+   std::string cDisp = http::headerValue(headers, "Content-Disposition");
+   if (cDisp.empty())
+      return false;
+
+   // parse values out of content disposition
+   std::string nameRegex("form-data; name=\"(.*)\"");
+   boost::smatch nameMatch;
+   if (!regex_match(cDisp, nameMatch, boost::regex(nameRegex)))
+      return false;
+
+   // check for filename
+   std::string filenameRegex(nameRegex + "; filename=\"(.*)\"");
+   boost::smatch fileMatch;
+   if (regex_match(cDisp, fileMatch, boost::regex(filenameRegex)))
+   {
+      *pName = fileMatch[1];
+      *pFilename = fileMatch[2];
+      *pIsFile = true;
+   }
+   else
+   {
+      *pName = nameMatch[1];
+      pFilename->clear();
+      *pIsFile = false;
+   }
+
+   return true;
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,145 @@
+/*
+ * MultipartParserTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+#include <vector>
+
+#include <core/http/MultipartParser.hpp>
+#include <core/http/Util.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+const char * const kContentType =
+      "multipart/form-data; boundary=----XYZ";
+
+const char * const kBody =
+      "preamble\r\n"
+      "------XYZ\r\n"
+      "Content-Disposition: form-data; name=\"targetDirectory\"\r\n"
+      "\r\n"
+      "~/data\r\n"
+      "------XYZ\r\n"
+      "Content-Disposition: form-data; name=\"file\"; filename=\"a.csv\"\r\n"
+      "Content-Type: text/csv\r\n"
+      "\r\n"
+      "x,y\r\n1,2\r\n\r\n----XY\r\n"
+      "------XYZ--\r\n"
+      "epilogue";
+
+class RecordingHandler : public MultipartHandler
+{
+public:
+   virtual Error onPartBegin(const Headers& headers)
+   {
+      names.push_back(headerValue(headers, "Content-Disposition"));
+      values.push_back(std::string());
+      return Success();
+   }
+
+   virtual Error onPartData(const char* data, std::size_t size)
+   {
+      values.back().append(data, size);
+      return Success();
+   }
+
+   virtual Error onPartEnd()
+   {
+      ended++;
+      return Success();
+   }
+
+   RecordingHandler() : ended(0) {}
+
+   std::vector<std::string> names;
+   std::vector<std::string> values;
+   int ended;
+};
+
+} // anonymous namespace
+
+context("MultipartParser")
+{
+   test_that("Boundaries are extracted from content types")
+   {
+      expect_true(MultipartParser::boundary(kContentType) == "----XYZ");
+      expect_true(MultipartParser::boundary(
+                     "multipart/related; boundary=\"a b\"; type=x") == "a b");
+      expect_true(MultipartParser::boundary("text/plain").empty());
+   }
+
+   test_that("Bodies split across chunks are parsed")
+   {
+      std::string body(kBody);
+      for (std::size_t split = 0; split <= body.size(); ++split)
+      {
+         MultipartParser parser(MultipartParser::boundary(kContentType));
+         RecordingHandler handler;
+         Error error = parser.parse(body.data(), split, &handler);
+         expect_true(!error);
+         error = parser.parse(body.data() + split, body.size() - split,
+                              &handler);
+         expect_true(!error);
+
+         expect_true(parser.complete());
+         expect_true(handler.ended == 2);
+         expect_true(handler.values.size() == 2);
+         if (handler.values.size() == 2)
+         {
+            expect_true(handler.values[0] == "~/data");
+            expect_true(handler.values[1] == "x,y\r\n1,2\r\n\r\n----XY");
+         }
+      }
+   }
+
+   test_that("Bodies fed a byte at a time are parsed")
+   {
+      std::string body(kBody);
+      MultipartParser parser(MultipartParser::boundary(kContentType));
+      RecordingHandler handler;
+      for (std::size_t i = 0; i < body.size(); ++i)
+      {
+         Error error = parser.parse(body.data() + i, 1, &handler);
+         expect_true(!error);
+      }
+      expect_true(parser.complete());
+      expect_true(handler.values.size() == 2);
+      if (handler.values.size() == 2)
+         expect_true(handler.values[1] == "x,y\r\n1,2\r\n\r\n----XY");
+   }
+
+   test_that("Multipart forms are parsed into fields and files")
+   {
+      Fields fields;
+      Files files;
+      util::parseMultipartForm(kContentType, kBody, &fields, &files);
+
+      expect_true(util::fieldValue(fields, "targetDirectory") == "~/data");
+      expect_true(files.size() == 1);
+      const File& file = files["file"];
+      expect_true(file.name == "a.csv");
+      expect_true(file.contentType == "text/csv");
+      expect_true(file.contents == "x,y\r\n1,2\r\n\r\n----XY");
+   }
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
@@ -15,8 +15,6 @@
 
 #include <core/http/MultipartRelated.hpp>
 
-#include <iostream>
-
 #define kBoundary             "END_OF_PART";
 #define kSectionBoundary      "--END_OF_PART"
 #define kTerminatingBoundary  "--END_OF_PART--"
@@ -29,14 +27,20 @@ namespace http {
 void MultipartRelated::addPart(const std::string& contentType,
                                const std::string& body)
 {
-   bodyStream_ << kSectionBoundary << std::endl;
-   bodyStream_ << "Content-Type: " << contentType << std::endl << std::endl;
-   bodyStream_ << body << std::endl;
+   // parts are appended in place (reserving for the whole part up front)
+   // rather than formatted through a stream and copied out of it
+   body_.reserve(body_.size() + body.size() + contentType.size() + 64);
+   body_.append(kSectionBoundary "\n");
+   body_.append("Content-Type: ");
+   body_.append(contentType);
+   body_.append("\n\n");
+   body_.append(body);
+   body_.push_back('\n');
 }
 
 void MultipartRelated::terminate()
 {
-   bodyStream_ << kTerminatingBoundary;
+   body_.append(kTerminatingBoundary);
 }
 
 std::string MultipartRelated::contentType() const
@@ -44,9 +48,9 @@ std::string MultipartRelated::contentType() const
    return kContentType;
 }
 
-std::string MultipartRelated::body() const
+const std::string& MultipartRelated::body() const
 {
-   return bodyStream_.str();
+   return body_;
 }
 
 } // namespace http
@@ -214,7 +214,7 @@ RequestParser::status RequestParser::consume(Request& req, char input)
       state_ = expecting_newline_3;
       return incomplete;
     }
-    else if (!req.headers_.empty() && (input == ' ' || input == '\t'))
+    else if (!req.headers().empty() && (input == ' ' || input == '\t'))
     {
       state_ = header_lws;
       return incomplete;
@@ -225,8 +225,8 @@ RequestParser::status RequestParser::consume(Request& req, char input)
     }
     else
     {
-      req.headers_.push_back(Header());
-      req.headers_.back().name.push_back(input);
+      req.mutableHeaders().push_back(Header());
+      req.mutableHeaders().back().name.push_back(input);
       state_ = header_name;
       return incomplete;
     }
@@ -247,7 +247,7 @@ RequestParser::status RequestParser::consume(Request& req, char input)
     else
     {
       state_ = header_value;
-      req.headers_.back().value.push_back(input);
+      req.mutableHeaders().back().value.push_back(input);
       return incomplete;
     }
   case header_name:
@@ -256,7 +256,7 @@ RequestParser::status RequestParser::consume(Request& req, char input)
       state_ = space_before_header_value;
       
       // look for special content-length state
-      if ( !req.headers_.back().name.compare("Content-Length") )
+      if ( !req.headers().back().name.compare("Content-Length") )
          parsing_content_length_ = true ;
 
       return incomplete;
@@ -267,7 +267,7 @@ RequestParser::status RequestParser::consume(Request& req, char input)
     }
     else
     {
-      req.headers_.back().name.push_back(input);
+      req.mutableHeaders().back().name.push_back(input);
       return incomplete;
     }
   case space_before_header_value:
@@ -288,7 +288,7 @@ RequestParser::status RequestParser::consume(Request& req, char input)
       // if this header was Content-Length then save it
       if (parsing_content_length_)
       {
-         content_length_ = boost::lexical_cast<int>(req.headers_.back().value);
+         content_length_ = boost::lexical_cast<int>(req.headers().back().value);
          parsing_content_length_ = false ;
       }
 
@@ -300,7 +300,7 @@ RequestParser::status RequestParser::consume(Request& req, char input)
     }
     else
     {
-      req.headers_.back().value.push_back(input);
+      req.mutableHeaders().back().value.push_back(input);
       return incomplete;
     }
   case expecting_newline_2:
@@ -0,0 +1,93 @@
+/*
+ * RequestParserTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+
+#include <core/http/Request.hpp>
+#include <core/http/RequestParser.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+const char * const kRequest =
+      "POST /upload HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Content-Length: 11\r\n"
+      "\r\n"
+      "hello world";
+
+} // anonymous namespace
+
+context("RequestParser")
+{
+   test_that("Requests split across chunks are parsed")
+   {
+      std::string request(kRequest);
+      for (std::size_t split = 1; split < request.size(); ++split)
+      {
+         RequestParser parser;
+         Request parsed;
+         const char* begin = request.data();
+         RequestParser::status status =
+               parser.parse(parsed, begin, begin + split);
+         expect_true(status == RequestParser::incomplete);
+         status = parser.parse(parsed, begin + split, begin + request.size());
+         expect_true(status == RequestParser::complete);
+         expect_true(parsed.uri() == "/upload");
+         expect_true(parsed.body() == "hello world");
+      }
+   }
+
+   test_that("Headers can be parsed independently of the body")
+   {
+      std::string request(kRequest);
+      RequestParser parser;
+      Request parsed;
+      const char* begin = request.data();
+      const char* end = begin + request.size();
+      const char* next = NULL;
+      RequestParser::status status =
+            parser.parseHeaders(parsed, begin, end, &next);
+      expect_true(status == RequestParser::complete);
+      expect_true(parser.contentLength() == 11);
+      expect_true(std::string(next, end) == "hello world");
+      expect_true(parsed.body().empty());
+
+      status = parser.parseBody(parsed, next, next + 5);
+      expect_true(status == RequestParser::incomplete);
+      status = parser.parseBody(parsed, next + 5, end);
+      expect_true(status == RequestParser::complete);
+      expect_true(parsed.body() == "hello world");
+   }
+
+   test_that("Malformed requests are rejected")
+   {
+      std::string request("GET / HTTP/X.1\r\n\r\n");
+      RequestParser parser;
+      Request parsed;
+      RequestParser::status status = parser.parse(
+               parsed, request.data(), request.data() + request.size());
+      expect_true(status == RequestParser::error);
+   }
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
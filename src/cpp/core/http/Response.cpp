@@ -27,6 +27,7 @@
 #include <core/http/URL.hpp>
 #include <core/http/Util.hpp>
 #include <core/http/Cookie.hpp>
+#include <core/http/ResponseCompression.hpp>
 #include <core/Hash.hpp>
 
 #include <core/FileSerializer.hpp>
@@ -124,6 +125,16 @@ void Response::addCookie(const Cookie& cookie)
    
 Error Response::setBody(const std::string& content)
 {
+   // content which needn't be compressed is assigned directly (rather than
+   // being copied through a filtering stream)
+   if (contentEncoding() != kGzipEncoding)
+   {
+      body_ = content;
+      fileBody_ = FilePath();
+      setContentLength(body_.length());
+      return Success();
+   }
+
    std::istringstream is(content);
    return setBody(is);
 }
@@ -226,9 +237,49 @@ void Response::setRangeableFile(const std::string& contents,
    }
 }
    
+void Response::setFileBody(const FilePath& filePath, const Request& request)
+{
+   body_.clear();
+   fileBody_ = filePath;
+
+   // gzip if possible (the compressed length isn't known up front so we
+   // write until the connection closes rather than sending Content-Length)
+#ifndef _WIN32
+   if (request.acceptsEncoding(kGzipEncoding))
+   {
+      setContentEncoding(kGzipEncoding);
+      removeHeader("Content-Length");
+      return;
+   }
+#endif
+
+   removeHeader("Content-Encoding");
+   setHeader("Content-Length", safe_convert::numberToString(filePath.size()));
+}
+
+Error Response::setCompressedFileBody(const FilePath& filePath,
+                                      const std::string& encoding)
+{
+#ifndef _WIN32
+   std::string contents;
+   Error error = readCompressedFile(filePath, encoding, &contents);
+   if (error)
+      return error;
+
+   setBodyUnencoded(contents);
+   setContentEncoding(encoding);
+   return Success();
+#else
+   // never compress on win32
+   removeHeader("Content-Encoding");
+   return setBody(filePath);
+#endif
+}
+
 void Response::setBodyUnencoded(const std::string& body)
 {
    removeHeader("Content-Encoding");
+   fileBody_ = FilePath();
    body_ = body;
    setContentLength(body_.length());
 }
@@ -290,6 +341,7 @@ void Response::resetMembers()
 	statusCode_ = status::Ok ;
 	statusCodeStr_.clear() ;
 	statusMessage_.clear() ;
+	fileBody_ = FilePath();
 }
    
 void Response::removeCachingHeaders()
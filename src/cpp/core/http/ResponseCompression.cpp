@@ -0,0 +1,342 @@
+/*
+ * ResponseCompression.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/ResponseCompression.hpp>
+
+#include <list>
+#include <map>
+#include <ctime>
+
+#include <boost/tokenizer.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+#ifndef _WIN32
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#endif
+
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+#include <core/FilePath.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/FileSerializer.hpp>
+
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// compressed file cache limits (files larger than the maximum size are
+// compressed on each request rather than being cached)
+const std::size_t kMaxCachedFiles = 64;
+const std::size_t kMaxCachedFileSize = 256 * 1024;
+
+struct CachedFile
+{
+   std::string key;
+   std::time_t lastWriteTime;
+   std::string contents;
+};
+
+typedef std::list<CachedFile> CachedFiles;
+
+// most recently used entries are at the front of the list
+class CompressedFileCache : boost::noncopyable
+{
+public:
+   bool lookup(const std::string& key,
+               std::time_t lastWriteTime,
+               std::string* pContents)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         std::map<std::string, CachedFiles::iterator>::iterator it =
+                                                            index_.find(key);
+         if (it == index_.end())
+            return false;
+
+         // stale entry
+         if (it->second->lastWriteTime != lastWriteTime)
+         {
+            files_.erase(it->second);
+            index_.erase(it);
+            return false;
+         }
+
+         files_.splice(files_.begin(), files_, it->second);
+         *pContents = it->second->contents;
+         return true;
+      }
+      END_LOCK_MUTEX
+
+      return false;
+   }
+
+   void insert(const std::string& key,
+               std::time_t lastWriteTime,
+               const std::string& contents)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         std::map<std::string, CachedFiles::iterator>::iterator it =
+                                                            index_.find(key);
+         if (it != index_.end())
+         {
+            files_.erase(it->second);
+            index_.erase(it);
+         }
+
+         CachedFile file;
+         file.key = key;
+         file.lastWriteTime = lastWriteTime;
+         file.contents = contents;
+         files_.push_front(file);
+         index_[key] = files_.begin();
+
+         // evict least recently used
+         while (files_.size() > kMaxCachedFiles)
+         {
+            index_.erase(files_.back().key);
+            files_.pop_back();
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+private:
+   boost::mutex mutex_;
+   CachedFiles files_;
+   std::map<std::string, CachedFiles::iterator> index_;
+};
+
+CompressedFileCache& compressedFileCache()
+{
+   static CompressedFileCache instance;
+   return instance;
+}
+
+bool isCompressibleType(const std::string& contentType,
+                        const std::vector<std::string>& compressibleTypes)
+{
+   // ignore parameters (e.g. charset)
+   std::string type = contentType.substr(0, contentType.find(';'));
+   boost::algorithm::trim(type);
+   boost::algorithm::to_lower(type);
+   if (type.empty())
+      return false;
+
+   for (std::vector<std::string>::const_iterator it =
+         compressibleTypes.begin(); it != compressibleTypes.end(); ++it)
+   {
+      if (boost::algorithm::ends_with(*it, "/"))
+      {
+         if (boost::algorithm::starts_with(type, *it))
+            return true;
+      }
+      else if (type == *it)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+} // anonymous namespace
+
+CompressionOptions::CompressionOptions()
+   : minimumSize(1024)
+{
+   contentTypes.push_back("text/");
+   contentTypes.push_back("application/json");
+   contentTypes.push_back("application/javascript");
+   contentTypes.push_back("application/x-javascript");
+   contentTypes.push_back("application/xml");
+   contentTypes.push_back("image/svg+xml");
+}
+
+std::string negotiateEncoding(const Request& request)
+{
+#ifndef _WIN32
+   // parse q-values for the encodings we support (-1 means not specified)
+   double gzipQ = -1, deflateQ = -1, anyQ = -1;
+
+   using namespace boost;
+   char_separator<char> comma(",");
+   std::string acceptEncoding = request.acceptEncoding();
+   tokenizer<char_separator<char> > tokens(acceptEncoding, comma);
+   for (tokenizer<char_separator<char> >::iterator it = tokens.begin();
+        it != tokens.end(); ++it)
+   {
+      std::string token = *it;
+      double q = 1;
+      std::string::size_type paramPos = token.find(';');
+      if (paramPos != std::string::npos)
+      {
+         std::string param = token.substr(paramPos + 1);
+         boost::algorithm::trim(param);
+         if (boost::algorithm::istarts_with(param, "q="))
+            q = safe_convert::stringTo<double>(param.substr(2), 1);
+         token = token.substr(0, paramPos);
+      }
+      boost::algorithm::trim(token);
+      boost::algorithm::to_lower(token);
+
+      if (token == kGzipEncoding)
+         gzipQ = q;
+      else if (token == kDeflateEncoding)
+         deflateQ = q;
+      else if (token == "*")
+         anyQ = q;
+   }
+
+   // a wildcard applies to encodings not explicitly listed
+   if (gzipQ < 0)
+      gzipQ = anyQ;
+   if (deflateQ < 0)
+      deflateQ = anyQ;
+
+   // prefer gzip when equally acceptable
+   if (gzipQ > 0 && gzipQ >= deflateQ)
+      return kGzipEncoding;
+   else if (deflateQ > 0)
+      return kDeflateEncoding;
+#endif
+
+   return std::string();
+}
+
+Error compress(const std::string& input,
+               const std::string& encoding,
+               std::string* pOutput)
+{
+   pOutput->clear();
+
+#ifndef _WIN32
+   try
+   {
+      boost::iostreams::filtering_ostream out;
+      if (encoding == kGzipEncoding)
+         out.push(boost::iostreams::gzip_compressor());
+      else if (encoding == kDeflateEncoding)
+         out.push(boost::iostreams::zlib_compressor());
+      else
+         return systemError(boost::system::errc::not_supported,
+                            ERROR_LOCATION);
+      out.push(boost::iostreams::back_inserter(*pOutput));
+
+      out.write(input.data(), input.size());
+
+      // closing the chain flushes the compressor
+      out.reset();
+      return Success();
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      return error;
+   }
+#else
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+#endif
+}
+
+void compressResponse(const Request& request,
+                      const CompressionOptions& options,
+                      Response* pResponse)
+{
+   // only compress complete, unencoded, in-memory bodies
+   if (pResponse->hasFileBody() ||
+       !pResponse->contentEncoding().empty() ||
+       pResponse->containsHeader("Content-Range") ||
+       pResponse->statusCode() < status::Ok ||
+       pResponse->statusCode() == status::PartialContent ||
+       pResponse->statusCode() == status::NotModified ||
+       request.method() == "HEAD")
+   {
+      return;
+   }
+
+   const std::string& body = pResponse->body();
+   if (body.size() < options.minimumSize)
+      return;
+
+   if (!isCompressibleType(pResponse->contentType(), options.contentTypes))
+      return;
+
+   std::string encoding = negotiateEncoding(request);
+   if (encoding.empty())
+      return;
+
+   std::string compressed;
+   Error error = compress(body, encoding, &compressed);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // not worth it
+   if (compressed.size() >= body.size())
+      return;
+
+   // caches need to distinguish the encoded and unencoded variants
+   std::string vary = pResponse->headerValue("Vary");
+   if (vary.empty())
+      pResponse->setHeader("Vary", "Accept-Encoding");
+   else if (!boost::algorithm::icontains(vary, "Accept-Encoding"))
+      pResponse->setHeader("Vary", vary + ", Accept-Encoding");
+
+   pResponse->setBodyUnencoded(compressed);
+   pResponse->setContentEncoding(encoding);
+}
+
+Error readCompressedFile(const FilePath& filePath,
+                         const std::string& encoding,
+                         std::string* pContents)
+{
+   std::string key = encoding + ":" + filePath.absolutePath();
+   std::time_t lastWriteTime = filePath.lastWriteTime();
+   if (compressedFileCache().lookup(key, lastWriteTime, pContents))
+      return Success();
+
+   std::string contents;
+   Error error = core::readStringFromFile(filePath, &contents);
+   if (error)
+      return error;
+
+   error = compress(contents, encoding, pContents);
+   if (error)
+      return error;
+
+   if (contents.size() <= kMaxCachedFileSize)
+      compressedFileCache().insert(key, lastWriteTime, *pContents);
+
+   return Success();
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
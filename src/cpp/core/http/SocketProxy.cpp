@@ -24,8 +24,20 @@
 
 #include <core/http/SocketProxy.hpp>
 
+#include <algorithm>
 #include <iostream>
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
 #include <boost/bind.hpp>
 
 #include <boost/asio/placeholders.hpp>
@@ -41,6 +53,60 @@ namespace rstudio {
 namespace core {
 namespace http {
 
+SocketProxy::~SocketProxy()
+{
+   try
+   {
+      // report what was relayed (this is the only point at which we know
+      // that both directions have finished)
+      if (statsHandler_)
+      {
+         stats_.duration = boost::posix_time::microsec_clock::universal_time() -
+                           startTime_;
+         statsHandler_(stats_);
+      }
+
+#ifdef __linux__
+      SplicePipe* pipes[] = { &clientPipe_, &serverPipe_ };
+      for (std::size_t i = 0; i < sizeof(pipes)/sizeof(pipes[0]); i++)
+      {
+         if (pipes[i]->readFd != -1)
+            ::close(pipes[i]->readFd);
+         if (pipes[i]->writeFd != -1)
+            ::close(pipes[i]->writeFd);
+      }
+#endif
+   }
+   catch(...)
+   {
+   }
+}
+
+void SocketProxy::setNoDelay()
+{
+#ifndef _WIN32
+   // errors are expected (and ignored) for sockets which aren't tcp
+   int fds[] = { ptrClient_->nativeHandle(), ptrServer_->nativeHandle() };
+   for (std::size_t i = 0; i < sizeof(fds)/sizeof(fds[0]); i++)
+   {
+      if (fds[i] == -1)
+         continue;
+      int noDelay = 1;
+      ::setsockopt(fds[i], IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+   }
+#endif
+}
+
+void SocketProxy::recordRead(bool fromClient, std::size_t bytes)
+{
+   // each direction is only updated by its own (serialized) chain of
+   // read and write handlers
+   DirectionStats& stats = fromClient ? stats_.fromClient : stats_.fromServer;
+   stats.reads++;
+   stats.bytes += bytes;
+   stats.maxQueuedBytes = std::max(stats.maxQueuedBytes, bytes);
+}
+
 void SocketProxy::readClient()
 {
    ptrClient_->asyncReadSome(
@@ -74,6 +140,7 @@ void SocketProxy::handleClientRead(const boost::system::error_code& e,
    {
       if (!e)
       {
+         recordRead(true, bytesTransferred);
          std::vector<boost::asio::const_buffer> buffers;
          buffers.push_back(boost::asio::buffer(clientBuffer_.data(),
                                                bytesTransferred));
@@ -99,6 +166,7 @@ void SocketProxy::handleServerRead(const boost::system::error_code& e,
    {
       if (!e)
       {
+         recordRead(false, bytesTransferred);
          std::vector<boost::asio::const_buffer> buffers;
          buffers.push_back(boost::asio::buffer(serverBuffer_.data(),
                                                bytesTransferred));
@@ -143,6 +211,200 @@ void SocketProxy::handleServerWrite(const boost::system::error_code& e,
    }
 }
 
+#ifdef __linux__
+
+namespace {
+
+// maximum number of bytes moved by a single call to splice (matches the
+// default pipe capacity on linux)
+const std::size_t kSpliceChunkSize = 65536;
+
+Error openPipe(int* pReadFd, int* pWriteFd)
+{
+   int fds[2];
+   if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1)
+      return systemError(errno, ERROR_LOCATION);
+
+   *pReadFd = fds[0];
+   *pWriteFd = fds[1];
+   return Success();
+}
+
+} // anonymous namespace
+
+bool SocketProxy::initSplice()
+{
+   // both sides need a plain descriptor (ssl streams fall back to the
+   // buffered implementation)
+   if (ptrClient_->nativeHandle() == -1 || ptrServer_->nativeHandle() == -1)
+      return false;
+
+   Error error = openPipe(&clientPipe_.readFd, &clientPipe_.writeFd);
+   if (!error)
+      error = openPipe(&serverPipe_.readFd, &serverPipe_.writeFd);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   return true;
+}
+
+void SocketProxy::waitReadable(bool fromClient)
+{
+   boost::shared_ptr<Socket> ptrSource = fromClient ? ptrClient_ : ptrServer_;
+   ptrSource->asyncWaitReadable(
+         boost::bind(
+            &SocketProxy::handleReadable,
+            SocketProxy::shared_from_this(),
+            fromClient,
+            boost::asio::placeholders::error));
+}
+
+void SocketProxy::handleReadable(bool fromClient,
+                                 const boost::system::error_code& e)
+{
+   LOCK_MUTEX(socketMutex_)
+   {
+      if (!e)
+         spliceToPipe(fromClient);
+      else
+         handleError(e, ERROR_LOCATION);
+   }
+   END_LOCK_MUTEX
+}
+
+void SocketProxy::handleWritable(bool fromClient,
+                                 const boost::system::error_code& e)
+{
+   LOCK_MUTEX(socketMutex_)
+   {
+      if (!e)
+         spliceFromPipe(fromClient);
+      else
+         handleError(e, ERROR_LOCATION);
+   }
+   END_LOCK_MUTEX
+}
+
+void SocketProxy::spliceToPipe(bool fromClient)
+{
+   int sourceFd = fromClient ? ptrClient_->nativeHandle() :
+                               ptrServer_->nativeHandle();
+   SplicePipe& pipe = fromClient ? clientPipe_ : serverPipe_;
+
+   ssize_t bytes;
+   do
+   {
+      bytes = ::splice(sourceFd, NULL, pipe.writeFd, NULL, kSpliceChunkSize,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+   }
+   while (bytes == -1 && errno == EINTR);
+
+   if (bytes > 0)
+   {
+      pipe.pending = bytes;
+      recordRead(fromClient, bytes);
+      spliceFromPipe(fromClient);
+   }
+   else if (bytes == 0)
+   {
+      // orderly shutdown by the peer
+      handleError(boost::asio::error::eof, ERROR_LOCATION);
+   }
+   else if (errno == EAGAIN)
+   {
+      // spurious readiness notification, wait again
+      waitReadable(fromClient);
+   }
+   else
+   {
+      handleError(boost::system::error_code(errno,
+                                            boost::system::system_category()),
+                  ERROR_LOCATION);
+   }
+}
+
+void SocketProxy::spliceFromPipe(bool fromClient)
+{
+   boost::shared_ptr<Socket> ptrDest = fromClient ? ptrServer_ : ptrClient_;
+   SplicePipe& pipe = fromClient ? clientPipe_ : serverPipe_;
+
+   while (pipe.pending > 0)
+   {
+      ssize_t bytes = ::splice(pipe.readFd, NULL,
+                               ptrDest->nativeHandle(), NULL,
+                               pipe.pending,
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (bytes > 0)
+      {
+         pipe.pending -= bytes;
+      }
+      else if (bytes == -1 && errno == EINTR)
+      {
+         continue;
+      }
+      else if (bytes == -1 && errno == EAGAIN)
+      {
+         // destination is full, resume once it becomes writable
+         DirectionStats& stats = fromClient ? stats_.fromClient
+                                            : stats_.fromServer;
+         stats.stalls++;
+         ptrDest->asyncWaitWritable(
+               boost::bind(
+                  &SocketProxy::handleWritable,
+                  SocketProxy::shared_from_this(),
+                  fromClient,
+                  boost::asio::placeholders::error));
+         return;
+      }
+      else
+      {
+         boost::system::error_code ec = bytes == 0 ?
+                  boost::asio::error::broken_pipe :
+                  boost::system::error_code(errno,
+                                            boost::system::system_category());
+         handleError(ec, ERROR_LOCATION);
+         return;
+      }
+   }
+
+   // pipe drained, wait for more data from the source
+   waitReadable(fromClient);
+}
+
+#else
+
+bool SocketProxy::initSplice()
+{
+   return false;
+}
+
+void SocketProxy::waitReadable(bool fromClient)
+{
+}
+
+void SocketProxy::handleReadable(bool fromClient,
+                                 const boost::system::error_code& e)
+{
+}
+
+void SocketProxy::handleWritable(bool fromClient,
+                                 const boost::system::error_code& e)
+{
+}
+
+void SocketProxy::spliceToPipe(bool fromClient)
+{
+}
+
+void SocketProxy::spliceFromPipe(bool fromClient)
+{
+}
+
+#endif
+
 namespace {
 
 #ifndef _WIN32
@@ -0,0 +1,177 @@
+/*
+ * SpooledRequestBody.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/SpooledRequestBody.hpp>
+
+#include <ostream>
+
+#include <boost/bind.hpp>
+
+#include <core/Log.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/system/System.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+boost::shared_ptr<AsyncRequestBodyHandler> createSpooledRequestBody(
+               std::size_t maxInMemory,
+               const SpooledRequestBody::CompletionHandler& onCompleted,
+               const FilePath& spoolDir,
+               boost::shared_ptr<AsyncConnection> pConnection)
+{
+   return boost::shared_ptr<AsyncRequestBodyHandler>(
+            new SpooledRequestBody(maxInMemory, onCompleted, spoolDir));
+}
+
+} // anonymous namespace
+
+SpooledRequestBody::~SpooledRequestBody()
+{
+   try
+   {
+      pSpoolStream_.reset();
+      if (!spoolFile_.empty())
+      {
+         Error error = spoolFile_.removeIfExists();
+         if (error)
+            LOG_ERROR(error);
+      }
+   }
+   catch(...)
+   {
+   }
+}
+
+Error SpooledRequestBody::onBodyChunk(const char* data, std::size_t size)
+{
+   // spill to disk if this chunk takes us over the in-memory limit
+   if (!pSpoolStream_ && (size_ + size) > maxInMemory_)
+   {
+      Error error = spill();
+      if (error)
+         return error;
+   }
+
+   if (pSpoolStream_)
+   {
+      pSpoolStream_->write(data, size);
+      if (pSpoolStream_->fail())
+      {
+         Error error = systemError(boost::system::errc::io_error,
+                                   ERROR_LOCATION);
+         error.addProperty("path", spoolFile_);
+         return error;
+      }
+   }
+   else
+   {
+      inMemoryBody_.append(data, size);
+   }
+
+   size_ += size;
+   return Success();
+}
+
+void SpooledRequestBody::onBodyComplete(
+                           boost::shared_ptr<AsyncConnection> pConnection)
+{
+   // close the spool file so it's fully flushed
+   if (pSpoolStream_)
+   {
+      pSpoolStream_->flush();
+      pSpoolStream_.reset();
+   }
+
+   if (onCompleted_)
+      onCompleted_(pConnection, shared_from_this());
+}
+
+Error SpooledRequestBody::spill()
+{
+   // determine the spool file path
+   if (spoolDir_.empty())
+   {
+      Error error = FilePath::tempFilePath(&spoolFile_);
+      if (error)
+         return error;
+   }
+   else
+   {
+      spoolFile_ = spoolDir_.complete(
+                     "request-body-" + core::system::generateShortenedUuid());
+   }
+
+   // open it and write what we've accumulated so far
+   Error error = spoolFile_.open_w(&pSpoolStream_);
+   if (error)
+      return error;
+
+   pSpoolStream_->write(inMemoryBody_.data(), inMemoryBody_.size());
+   if (pSpoolStream_->fail())
+   {
+      Error error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", spoolFile_);
+      return error;
+   }
+
+   // release the memory
+   std::string().swap(inMemoryBody_);
+
+   return Success();
+}
+
+Error SpooledRequestBody::readBody(std::string* pBody) const
+{
+   if (isSpooled())
+      return readStringFromFile(spoolFile_, pBody);
+
+   *pBody = inMemoryBody_;
+   return Success();
+}
+
+Error SpooledRequestBody::moveTo(const FilePath& targetPath)
+{
+   if (isSpooled())
+   {
+      Error error = spoolFile_.move(targetPath);
+      if (error)
+         return error;
+
+      // the spool file now belongs to the target
+      spoolFile_ = FilePath();
+      return Success();
+   }
+   else
+   {
+      return writeStringToFile(targetPath, inMemoryBody_);
+   }
+}
+
+AsyncStreamingUriHandlerFunction spooledBodyHandler(
+               std::size_t maxInMemory,
+               const SpooledRequestBody::CompletionHandler& onCompleted,
+               const FilePath& spoolDir)
+{
+   return boost::bind(createSpooledRequestBody,
+                      maxInMemory, onCompleted, spoolDir, _1);
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
@@ -15,8 +15,6 @@
 
 #include <core/http/UriHandler.hpp>
 
-#include <algorithm>
-
 #include <boost/bind.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -75,18 +73,16 @@ void UriHandler::operator()(const Request& request,
    
 void UriHandlers::add(const UriHandler& handler) 
 {
+   prefixes_.add(handler.prefix(), uriHandlers_.size());
    uriHandlers_.push_back(handler);
 }
 
 UriAsyncHandlerFunction UriHandlers::handlerFor(const std::string& uri) const
 {
-   std::vector<UriHandler>::const_iterator handler = std::find_if(
-                              uriHandlers_.begin(), 
-                              uriHandlers_.end(), 
-                              boost::bind(&UriHandler::matches, _1, uri));
-   if ( handler != uriHandlers_.end() )
+   std::size_t index;
+   if (prefixes_.find(uri, &index))
    {
-      return handler->function();
+      return uriHandlers_[index].function();
    }
    else
    {
@@ -0,0 +1,139 @@
+/*
+ * UriPrefixTrie.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/UriPrefixTrie.hpp>
+
+#include <algorithm>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+bool compareChild(const std::pair<char, std::size_t>& child, char ch)
+{
+   return child.first < ch;
+}
+
+} // anonymous namespace
+
+const std::size_t UriPrefixTrie::kNone = static_cast<std::size_t>(-1);
+
+UriPrefixTrie::UriPrefixTrie()
+   : nodes_(1)
+{
+}
+
+void UriPrefixTrie::add(const std::string& prefix, std::size_t value)
+{
+   // walk (and extend) the path for the prefix
+   std::size_t node = 0;
+   for (std::string::const_iterator it = prefix.begin();
+        it != prefix.end(); ++it)
+   {
+      std::vector<std::pair<char, std::size_t> >& children =
+                                                      nodes_[node].children;
+      std::vector<std::pair<char, std::size_t> >::iterator pos =
+            std::lower_bound(children.begin(), children.end(), *it,
+                             compareChild);
+      if (pos != children.end() && pos->first == *it)
+      {
+         node = pos->second;
+      }
+      else
+      {
+         // inherit the value for prefixes above this one
+         std::size_t next = nodes_.size();
+         Node newNode;
+         newNode.value = nodes_[node].value;
+         children.insert(pos, std::make_pair(*it, next));
+         nodes_.push_back(newNode);
+         node = next;
+      }
+   }
+
+   // values are added in increasing order so an earlier prefix ending at
+   // or above this node always takes precedence
+   if (nodes_[node].value == kNone)
+      propagate(node, value);
+
+   exactMatches_[prefix] = nodes_[node].value;
+}
+
+void UriPrefixTrie::propagate(std::size_t node, std::size_t value)
+{
+   // set the value for this node and all descendants which don't already
+   // have one (those that do were set by an earlier prefix -- note this
+   // includes the nodes of all existing prefixes so exactMatches_ is
+   // unaffected)
+   std::vector<std::size_t> pending(1, node);
+   while (!pending.empty())
+   {
+      std::size_t current = pending.back();
+      pending.pop_back();
+      if (nodes_[current].value != kNone)
+         continue;
+
+      nodes_[current].value = value;
+      for (std::size_t i = 0; i < nodes_[current].children.size(); ++i)
+         pending.push_back(nodes_[current].children[i].second);
+   }
+}
+
+std::size_t UriPrefixTrie::child(std::size_t node, char ch) const
+{
+   const std::vector<std::pair<char, std::size_t> >& children =
+                                                      nodes_[node].children;
+   std::vector<std::pair<char, std::size_t> >::const_iterator pos =
+         std::lower_bound(children.begin(), children.end(), ch, compareChild);
+   if (pos != children.end() && pos->first == ch)
+      return pos->second;
+   else
+      return kNone;
+}
+
+bool UriPrefixTrie::find(const std::string& uri, std::size_t* pValue) const
+{
+   // fast path for a uri which is exactly a prefix
+   boost::unordered_map<std::string, std::size_t>::const_iterator exact =
+                                                   exactMatches_.find(uri);
+   if (exact != exactMatches_.end())
+   {
+      *pValue = exact->second;
+      return true;
+   }
+
+   // walk the trie as far as the uri takes us -- since values are
+   // inherited downwards the deepest node reached holds the answer
+   std::size_t node = 0;
+   for (std::string::const_iterator it = uri.begin(); it != uri.end(); ++it)
+   {
+      std::size_t next = child(node, *it);
+      if (next == kNone)
+         break;
+      node = next;
+   }
+
+   if (nodes_[node].value == kNone)
+      return false;
+
+   *pValue = nodes_[node].value;
+   return true;
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
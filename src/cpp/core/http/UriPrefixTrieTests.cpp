@@ -0,0 +1,105 @@
+/*
+ * UriPrefixTrieTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/http/UriPrefixTrie.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// reference implementation: first matching prefix in registration order
+bool linearFind(const std::vector<std::string>& prefixes,
+                const std::string& uri,
+                std::size_t* pValue)
+{
+   for (std::size_t i = 0; i < prefixes.size(); ++i)
+   {
+      if (boost::algorithm::starts_with(uri, prefixes[i]))
+      {
+         *pValue = i;
+         return true;
+      }
+   }
+   return false;
+}
+
+} // anonymous namespace
+
+context("UriPrefixTrie")
+{
+   test_that("Earliest matching prefix wins")
+   {
+      std::vector<std::string> prefixes;
+      prefixes.push_back("/rpc/");
+      prefixes.push_back("/graphics");
+      prefixes.push_back("/help/");
+      prefixes.push_back("/rpc/get_events");
+      prefixes.push_back("/help");
+      prefixes.push_back("/");
+      prefixes.push_back("/grid_data");
+
+      UriPrefixTrie trie;
+      for (std::size_t i = 0; i < prefixes.size(); ++i)
+         trie.add(prefixes[i], i);
+
+      std::vector<std::string> uris;
+      uris.push_back("/rpc/get_events");
+      uris.push_back("/rpc/console_input");
+      uris.push_back("/graphics/plot.png");
+      uris.push_back("/help");
+      uris.push_back("/help/doc/index.html");
+      uris.push_back("/grid_data?x=1");
+      uris.push_back("/");
+      uris.push_back("rpc");
+      uris.push_back("");
+
+      for (std::size_t i = 0; i < uris.size(); ++i)
+      {
+         std::size_t expected = 0, actual = 0;
+         bool expectedFound = linearFind(prefixes, uris[i], &expected);
+         bool actualFound = trie.find(uris[i], &actual);
+         expect_true(expectedFound == actualFound);
+         if (expectedFound && actualFound)
+            expect_true(expected == actual);
+      }
+   }
+
+   test_that("Unmatched uris are not found")
+   {
+      UriPrefixTrie trie;
+      expect_true(trie.empty());
+
+      std::size_t value;
+      expect_false(trie.find("/rpc", &value));
+
+      trie.add("/rpc/", 0);
+      expect_false(trie.find("/rpc", &value));
+      expect_false(trie.find("/events", &value));
+      expect_true(trie.find("/rpc/init", &value));
+   }
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
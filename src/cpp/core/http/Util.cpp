@@ -26,6 +26,7 @@
 #include <boost/date_time/gregorian/gregorian.hpp>
 
 #include <core/http/Header.hpp>
+#include <core/http/MultipartParser.hpp>
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
 #include <core/Log.hpp>
@@ -129,89 +130,93 @@ void parseQueryString(const std::string& queryString, Fields* pFields)
    return parseFields(queryString, "&", "=", pFields, FieldDecodeQueryString);
 }
       
-void parseMultipartForm(const std::string& contentType,
-                        const std::string& body, 
-                        Fields* pFields,
-                        Files* pFiles)
+namespace {
+
+// collects the fields and files of a multipart/form-data body
+class FormDataHandler : public MultipartHandler
 {
-   // get the boundary token
-   std::string boundaryPrefix("boundary=");
-   std::string boundary;
-   size_t prefixLoc = contentType.find(boundaryPrefix);
-   if (prefixLoc != std::string::npos)
+public:
+   FormDataHandler(Fields* pFields, Files* pFiles)
+      : pFields_(pFields), pFiles_(pFiles), inPart_(false), isFile_(false)
    {
-      boundary = contentType.substr(prefixLoc+boundaryPrefix.size(),
-                                    std::string::npos);
-      boundary = "--" + boundary;
-      boost::algorithm::trim(boundary);
    }
-   
-   // extract the fields
-   size_t beginBoundaryLoc = body.find(boundary);
-   size_t endBoundaryLoc = body.find("\r\n" + boundary,
-                                     beginBoundaryLoc+boundary.size());
-   while (endBoundaryLoc != std::string::npos)
+
+   virtual Error onPartBegin(const Headers& headers)
    {
-      // extract the part into a string stream
-      size_t beginPart = beginBoundaryLoc + boundary.size();
-      size_t partLength = endBoundaryLoc - beginPart;
-      std::istringstream partStream(body.substr(beginPart, partLength)); 
-      partStream.unsetf(std::ios::skipws);
-    
-      // read the headers
-      Headers headers ;
-      http::parseHeaders(partStream, &headers);
-      
-      // check for content-disposition
-      std::string cDisp = http::headerValue(headers,"Content-Disposition");
-      if (!cDisp.empty())
+      inPart_ = formDataPartName(headers, &name_, &file_.name, &isFile_);
+      value_.clear();
+      if (inPart_ && isFile_)
+      {
+         file_.contentType = http::headerValue(headers, "Content-Type");
+         if (file_.contentType.empty())
+            file_.contentType = "application/octet-stream";
+      }
+      return Success();
+   }
+
+   virtual Error onPartData(const char* data, std::size_t size)
+   {
+      if (inPart_)
+         value_.append(data, size);
+      return Success();
+   }
+
+   virtual Error onPartEnd()
+   {
+      if (!inPart_)
+         return Success();
+
+      if (isFile_)
       {
-         // parse values out of content disposition
-         std::string nameRegex("form-data; name=\"(.*)\"");
-         boost::smatch nameMatch;
-         if (regex_match(cDisp, nameMatch, boost::regex(nameRegex)))
+         if (pFiles_->find(name_) == pFiles_->end())
          {
-            // read the rest of the stream
-            std::ostringstream valueStream ;
-            std::copy(std::istream_iterator<char>(partStream),
-                      std::istream_iterator<char>(),
-                      std::ostream_iterator<char>(valueStream));
-                       
-            // check for filename
-            std::string filenameRegex(nameRegex + "; filename=\"(.*)\"");
-            boost::smatch fileMatch;
-            if (regex_match(cDisp, fileMatch, boost::regex(filenameRegex)))
-            {
-               std::string name(fileMatch[1]);
-               
-               File uploadedFile;
-               uploadedFile.name = fileMatch[2];
-               uploadedFile.contentType = http::headerValue(headers, 
-                                                            "Content-Type");
-               if (uploadedFile.contentType.empty())
-                  uploadedFile.contentType = "application/octet-stream";
-               
-               uploadedFile.contents = valueStream.str();
-               pFiles->insert(std::make_pair(name, uploadedFile));
-            }
-            // else process regular form field
-            else
-            {
-               std::string name(nameMatch[1]);
-               std::string value = valueStream.str();
-               boost::algorithm::trim(value);
-               pFields->push_back(std::make_pair(name, value));
-            }
+            File& file = (*pFiles_)[name_];
+            file.name = file_.name;
+            file.contentType = file_.contentType;
+            file.contents.swap(value_);
          }
-         
       }
-                
-      // next boundary
-      beginBoundaryLoc = endBoundaryLoc;
-      endBoundaryLoc = body.find("\r\n" + boundary,
-                                 beginBoundaryLoc+boundary.size());
+      // else process regular form field
+      else
+      {
+         boost::algorithm::trim(value_);
+         pFields_->push_back(std::make_pair(name_, value_));
+      }
+
+      inPart_ = false;
+      return Success();
    }
-}   
+
+private:
+   Fields* pFields_;
+   Files* pFiles_;
+   bool inPart_;
+   bool isFile_;
+   std::string name_;
+   File file_;
+   std::string value_;
+};
+
+} // anonymous namespace
+
+void parseMultipartForm(const std::string& contentType,
+                        const std::string& body, 
+                        Fields* pFields,
+                        Files* pFiles)
+{
+   // get the boundary token
+   std::string boundary = MultipartParser::boundary(contentType);
+   if (boundary.empty())
+      return;
+
+   // extract the fields (parts are appended directly to their values rather
+   // than being copied out of the body first)
+   MultipartParser parser(boundary);
+   FormDataHandler handler(pFields, pFiles);
+   Error error = parser.parse(body.data(), body.size(), &handler);
+   if (error)
+      LOG_ERROR(error);
+}
    
 
 std::string urlEncode(const std::string& in, bool queryStringSpaces)
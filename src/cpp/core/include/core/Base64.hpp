@@ -16,6 +16,8 @@
 #ifndef CORE_SYSTEM_BASE64_HPP
 #define CORE_SYSTEM_BASE64_HPP
 
+#include <cstddef>
+#include <iosfwd>
 #include <string>
 
 namespace rstudio {
@@ -26,10 +28,19 @@ class FilePath;
 
 namespace base64 {
       
+// size of the encoding of size bytes (including padding)
+std::size_t encodedSize(std::size_t size);
 
 Error encode(const std::string& input, std::string* pOutput);
 Error encode(const FilePath& inputFile, std::string* pOutput);
 
+// encode the stream in chunks, writing the output as it's produced (so
+// neither the input nor the output need be held in memory)
+Error encode(std::istream& is, std::ostream& os);
+
+// decode (ignoring whitespace); invalid input is an error
+Error decode(const std::string& input, std::string* pOutput);
+
          
 } // namespace base64
 } // namespace core
@@ -23,6 +23,8 @@
 #include <string>
 #include <iosfwd>
 
+#include <boost/shared_ptr.hpp>
+
 #include <core/FilePath.hpp>
 
 // TODO: satisfy outselves that it is safe to query for symlink status
@@ -31,14 +33,18 @@
 namespace rstudio {
 namespace core {
 
+// NOTE: FileInfo is stored for every file in monitored directory trees so
+// it is kept compact: rather than storing the full path it stores the file
+// name along with a reference to its parent directory path, which is
+// interned (shared by all FileInfo objects with the same parent)
 class FileInfo
 {
 public:
    FileInfo()
-      : absolutePath_(), 
-        isDirectory_(false), 
-        size_(0), 
-        lastWriteTime_(0)
+      : size_(0),
+        lastWriteTime_(0),
+        isDirectory_(false),
+        isSymlink_(false)
    {
    }
    
@@ -64,23 +70,19 @@ public:
             std::time_t lastWriteTime,
             bool isSymlink = false);
    
-   virtual ~FileInfo()
-   {
-   }
-
    // COPYING: via compliler (copyable members)
 
 public:
-   bool empty() const { return absolutePath_.empty(); }
-   
+   bool empty() const { return !pParentPath_ && name_.empty(); }
+
    // NOTE: because symlink status is optional, it is NOT taken
    // into account for equality tests
    bool operator==(const FileInfo& other) const
    {
-      return absolutePath_ == other.absolutePath_ &&
-             isDirectory_ == other.isDirectory_ &&
+      return isDirectory_ == other.isDirectory_ &&
              size_ == other.size_ &&
-             lastWriteTime_ == other.lastWriteTime_;
+             lastWriteTime_ == other.lastWriteTime_ &&
+             hasSamePath(other);
    }
    
    bool operator!=(const FileInfo& other) const
@@ -89,23 +91,34 @@ public:
    }
    
 public:
-   std::string absolutePath() const { return absolutePath_.c_str(); }
+   // NOTE: returns a new string (never shares a buffer with our members)
+   std::string absolutePath() const;
    bool isDirectory() const { return isDirectory_; }
    uintmax_t size() const { return size_; }
    std::time_t lastWriteTime() const { return lastWriteTime_; }
    bool isSymlink() const { return isSymlink_; }
-   
+
+   // path comparisons which avoid constructing the absolute path
+   bool hasPath(const std::string& absolutePath) const;
+   bool hasSamePath(const FileInfo& other) const;
+   int comparePath(const FileInfo& other) const;
+
 private:
-   std::string absolutePath_;
-   bool isDirectory_;
+   void setAbsolutePath(const std::string& absolutePath);
+
+private:
+   // interned parent directory path (NULL if the path has no parent)
+   boost::shared_ptr<const std::string> pParentPath_;
+   std::string name_;
    uintmax_t size_;
    std::time_t lastWriteTime_;
+   bool isDirectory_;
    bool isSymlink_;
 };
    
 inline int fileInfoPathCompare(const FileInfo& a, const FileInfo& b)
 {
-   int result = ::strcmp(a.absolutePath().c_str(), b.absolutePath().c_str());
+   int result = a.comparePath(b);
 
    if (result != 0)
       return result;
@@ -124,7 +137,7 @@ inline bool fileInfoPathLessThan(const FileInfo& a, const FileInfo& b)
 
 inline bool fileInfoHasPath(const FileInfo& fileInfo, const std::string& path)
 {
-   return fileInfo.absolutePath() == path;
+   return fileInfo.hasPath(path);
 }
 
 inline FilePath toFilePath(const FileInfo& fileInfo)
@@ -16,12 +16,24 @@
 #ifndef FILE_LOG_WRITER_HPP
 #define FILE_LOG_WRITER_HPP
 
+#include <string>
+
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #include <core/FilePath.hpp>
 #include <core/LogWriter.hpp>
+#include <core/collection/MpscQueue.hpp>
 
 namespace rstudio {
 namespace core {
 
+// LogWriter which appends to a log file in the background. log() only
+// queues the entry (without taking a lock) so callers never block on
+// file i/o; a writer thread appends queued entries in batches, rotates the
+// file, and periodically syncs it to disk. if the queue is full entries
+// are dropped (and the number dropped is noted in the log) rather than
+// blocking the caller.
 class FileLogWriter : public LogWriter
 {
 public:
@@ -36,17 +48,44 @@ public:
                      core::system::LogLevel level,
                      const std::string& message);
 
+    // synchronously write all queued entries (called automatically at exit)
+    void flush();
+
+    // total number of entries dropped because the queue was full
+    long droppedCount() const;
 
 private:
+    void ensureWriterThread();
+    bool isForkedChild() const;
+    void discardQueuedEntries();
+    void writerThreadMain();
+    bool writeQueuedEntries();
+    void writeEntries(const std::string& entries);
     bool rotateLogFile();
 
     std::string programIdentity_;
     int logLevel_;
     FilePath logFile_;
     FilePath rotatedLogFile_;
+
+    // queued entries
+    collection::MpscQueue<std::string> queue_;
+    volatile long queuedCount_;
+    volatile long droppedCount_;
+    long reportedDroppedCount_;
+
+    // only one consumer may write at a time (the writer thread or flush)
+    volatile int writing_;
+
+    // pid of the process which started the writer thread (so that we can
+    // restart it in a forked child)
+    volatile long writerPid_;
+    boost::thread* pWriterThread_;
+    boost::posix_time::ptime lastSyncTime_;
 };
 
 } // namespace core
 } // namespace rstudio
 
 #endif // FILE_LOG_WRITER_HPP
+
@@ -37,6 +37,10 @@ namespace core {
 
 class Error ;
 
+namespace stat_cache {
+struct Entry;
+} // namespace stat_cache
+
 class FilePath
 {
 public:
@@ -138,6 +142,10 @@ public:
    // copy to path
    Error copy(const FilePath& targetPath) const;
 
+   // create a hard link to this file at path (fails if the file system
+   // doesn't support hard links or the paths are on different volumes)
+   Error link(const FilePath& targetPath) const;
+
    // is this a hidden file?
    bool isHidden() const ;
 
@@ -194,6 +202,10 @@ public:
 private:
    friend class RecursiveDirectoryIterator;
 
+   // metadata from the stat cache (if it's enabled)
+   bool cachedStat(stat_cache::Entry* pEntry) const;
+   void invalidateStatCache() const;
+
 private:
    struct Impl ;
    boost::shared_ptr<const Impl> pImpl_ ;
@@ -16,16 +16,67 @@
 #ifndef CORE_HASH_HPP
 #define CORE_HASH_HPP
 
+#include <cstddef>
 #include <string>
 
+#include <boost/cstdint.hpp>
+
 namespace rstudio {
 namespace core {
+
+class Error;
+class FilePath;
+
 namespace hash {
    
 std::string crc32Hash(const std::string& content);
 
 std::string crc32HexHash(const std::string& content);
 
+// CRC-32C (Castagnoli) of the given data, using the CPU's crc32 instruction
+// where available (SSE 4.2 or ARMv8). Pass the result of a previous call as
+// crc to continue a checksum across several buffers.
+boost::uint32_t crc32c(const void* pData,
+                       std::size_t size,
+                       boost::uint32_t crc = 0);
+
+// xxHash64 of the given data. Much faster than crc32Hash for content of any
+// size, so it suits cache keys and change detection (note however that its
+// values differ from crc32Hash so it can't replace hashes which have been
+// persisted)
+boost::uint64_t xxHash64(const void* pData,
+                         std::size_t size,
+                         boost::uint64_t seed = 0);
+
+std::string xxHash64Hex(const std::string& content);
+
+// Computes the xxHash64 of content which is supplied in chunks (the result
+// is the same as hashing the concatenated content with xxHash64)
+class Hasher
+{
+public:
+   explicit Hasher(boost::uint64_t seed = 0);
+
+   // COPYING: via compiler
+
+   void update(const void* pData, std::size_t size);
+   void update(const std::string& content);
+
+   boost::uint64_t digest() const;
+   std::string hexDigest() const;
+
+private:
+   boost::uint64_t seed_;
+   boost::uint64_t totalSize_;
+   boost::uint64_t acc_[4];
+   unsigned char buffer_[32];
+   std::size_t bufferSize_;
+};
+
+// xxHash64 (in hex) of a file's contents (the file is memory mapped rather
+// than read into memory)
+Error fileHash(const FilePath& filePath, std::string* pHash);
+
 } // namespace hash
 } // namespace core 
 } // namespace rstudio
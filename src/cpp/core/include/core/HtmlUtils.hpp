@@ -19,6 +19,8 @@
 #include <string>
 
 #include <boost/regex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/iostreams/filter/aggregate.hpp>
 #include <boost/iostreams/filter/regex.hpp>
 
 #include <core/FilePath.hpp>
@@ -43,30 +45,36 @@ public:
 
 std::string defaultTitle(const std::string& htmlContent);
 
-// convert images to base64
-class Base64ImageFilter : public boost::iostreams::regex_filter
+class InlineAssets;
+
+// convert images to base64. the html is scanned in a single pass and each
+// distinct image is read and encoded only once (copies of the filter share
+// the images they have encoded)
+class Base64ImageFilter : public boost::iostreams::aggregate_filter<char>
 {
 public:
    explicit Base64ImageFilter(const FilePath& basePath);
 
 private:
-   std::string toBase64Image(const boost::cmatch& match);
+   virtual void do_filter(const vector_type& src, vector_type& dest);
 
 private:
    FilePath basePath_;
+   boost::shared_ptr<InlineAssets> pAssets_;
 };
 
-// convert fonts to base64
-class CssUrlFilter : public boost::iostreams::regex_filter
+// convert fonts to base64 (as above)
+class CssUrlFilter : public boost::iostreams::aggregate_filter<char>
 {
 public:
    explicit CssUrlFilter(const FilePath& basePath);
 
 private:
-   std::string toBase64Url(const boost::cmatch& match);
+   virtual void do_filter(const vector_type& src, vector_type& dest);
 
 private:
    FilePath basePath_;
+   boost::shared_ptr<InlineAssets> pAssets_;
 };
 
 struct ExcludePattern
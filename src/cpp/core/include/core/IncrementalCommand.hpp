@@ -29,7 +29,9 @@ public:
    IncrementalCommand(
          const boost::posix_time::time_duration& incrementalDuration,
          const boost::function<bool()>& execute)
-      : ScheduledCommand(execute), incrementalDuration_(incrementalDuration)
+      : ScheduledCommand(execute),
+        incrementalDuration_(incrementalDuration),
+        lastExecutionTime_(now())
    {
    }
 
@@ -37,7 +39,9 @@ public:
          const boost::posix_time::time_duration& initialDuration,
          const boost::posix_time::time_duration& incrementalDuration,
          const boost::function<bool()>& execute)
-      : ScheduledCommand(execute), incrementalDuration_(incrementalDuration)
+      : ScheduledCommand(execute),
+        incrementalDuration_(incrementalDuration),
+        lastExecutionTime_(now())
    {
       executeUntil(now() + initialDuration);
    }
@@ -52,15 +56,23 @@ public:
       executeUntil(now() + incrementalDuration_);
    }
 
+   // always ready, but ordered by when it last had a turn
+   virtual boost::posix_time::ptime nextExecutionTime() const
+   {
+      return lastExecutionTime_;
+   }
+
 private:
    void executeUntil(const boost::posix_time::ptime& time)
    {
       while (!finished_ && (now() < time))
          finished_ = !execute_();
+      lastExecutionTime_ = now();
    }
 
 private:
    const boost::posix_time::time_duration incrementalDuration_;
+   boost::posix_time::ptime lastExecutionTime_;
 };
 
 
@@ -0,0 +1,60 @@
+/*
+ * MappedFile.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_MAPPED_FILE_HPP
+#define CORE_MAPPED_FILE_HPP
+
+#include <cstddef>
+
+#include <boost/utility.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+class FilePath;
+
+// Read-only view of a file's contents which is backed by a memory mapping
+// (so reading large files doesn't require a copy of their contents). The
+// data isn't null terminated and is only valid while the MappedFile is open.
+class MappedFile : boost::noncopyable
+{
+public:
+   MappedFile();
+   virtual ~MappedFile();
+
+   // COPYING: boost::noncopyable
+
+   Error open(const FilePath& filePath);
+   void close();
+   bool isOpen() const;
+
+   const char* data() const;
+   std::size_t size() const;
+   bool empty() const { return size() == 0; }
+
+   const char* begin() const { return data(); }
+   const char* end() const { return data() + size(); }
+
+private:
+   struct Impl;
+   boost::scoped_ptr<Impl> pImpl_;
+};
+
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_MAPPED_FILE_HPP
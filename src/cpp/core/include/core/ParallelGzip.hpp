@@ -0,0 +1,89 @@
+/*
+ * ParallelGzip.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_PARALLEL_GZIP_HPP
+#define CORE_PARALLEL_GZIP_HPP
+
+#include <cstddef>
+
+#include <boost/utility.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+class FilePath;
+
+// Gzip files written as a sequence of independently compressed members, each
+// holding a fixed size chunk of the input. Chunks are compressed (and on
+// read, decompressed) on background threads while the caller streams data
+// in (or out), and the size of each member is recorded in its header so a
+// reader can find the next member without inflating the current one.
+//
+// These are ordinary (multi-member) gzip files, so any gzip reader (e.g.
+// R's gzfile connections) can read them sequentially.
+
+class ParallelGzipWriter : boost::noncopyable
+{
+public:
+   ParallelGzipWriter();
+   virtual ~ParallelGzipWriter();
+
+   // COPYING: boost::noncopyable
+
+   // level is a zlib compression level (0 stores chunks uncompressed)
+   Error open(const FilePath& filePath, int level = 1);
+
+   // buffer data, handing each complete chunk to the compression threads
+   Error write(const char* data, std::size_t size);
+
+   // compress and write any remaining data and close the file (an error
+   // returned by a previous write is returned again)
+   Error close();
+
+private:
+   struct Impl;
+   boost::scoped_ptr<Impl> pImpl_;
+};
+
+class ParallelGzipReader : boost::noncopyable
+{
+public:
+   // is the file a gzip file written by ParallelGzipWriter?
+   static bool isParallelGzipFile(const FilePath& filePath);
+
+   ParallelGzipReader();
+   virtual ~ParallelGzipReader();
+
+   // COPYING: boost::noncopyable
+
+   Error open(const FilePath& filePath);
+
+   // read up to size bytes; fewer than size bytes are read only at the
+   // end of the file
+   Error read(char* data, std::size_t size, std::size_t* pRead);
+
+   void close();
+
+private:
+   struct Impl;
+   boost::scoped_ptr<Impl> pImpl_;
+};
+
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_PARALLEL_GZIP_HPP
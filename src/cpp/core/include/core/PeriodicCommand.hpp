@@ -63,6 +63,11 @@ public:
       return period_;
    }
 
+   virtual boost::posix_time::ptime nextExecutionTime() const
+   {
+      return nextExecutionTime_;
+   }
+
 private:
    const boost::posix_time::time_duration period_;
    boost::posix_time::ptime nextExecutionTime_;
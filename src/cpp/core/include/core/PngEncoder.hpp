@@ -0,0 +1,55 @@
+/*
+ * PngEncoder.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_PNG_ENCODER_HPP
+#define CORE_PNG_ENCODER_HPP
+
+#include <string>
+#include <vector>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+class FilePath;
+
+namespace png {
+
+// an 8-bit RGB or RGBA raster (rows stored top to bottom)
+struct Bitmap
+{
+   Bitmap() : width(0), height(0), channels(0) {}
+
+   int width;
+   int height;
+   int channels;
+   std::vector<unsigned char> pixels;
+};
+
+// decode an uncompressed (24 or 32 bit) BMP image, as written by the R
+// bmp() devices
+Error decodeBmp(const std::string& data, Bitmap* pBitmap);
+
+// encode a bitmap as PNG. level is a zlib compression level: low levels
+// encode much faster (suiting images shown once) at the cost of larger files
+Error encodePng(const Bitmap& bitmap, int level, std::string* pPng);
+
+Error writePngFile(const Bitmap& bitmap, int level, const FilePath& filePath);
+
+} // namespace png
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_PNG_ENCODER_HPP
@@ -30,6 +30,15 @@ class FilePath;
 
 namespace regex_utils {
    
+// returns the compiled regex for the pattern, compiling it only if it isn't
+// among the most recently used (so that patterns built at runtime, e.g.
+// from search terms typed by the user, aren't recompiled on every use).
+// throws boost::regex_error for invalid patterns as boost::regex does
+boost::regex compiledRegex(
+         const std::string& pattern,
+         boost::regex_constants::syntax_option_type flags =
+                                             boost::regex_constants::normal);
+
 // convert a pattern which includes wildcard (i.e. '*') characters
 // into a regulard expression
 boost::regex wildcardPatternToRegex(const std::string& pattern);
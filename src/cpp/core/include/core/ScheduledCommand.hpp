@@ -45,6 +45,13 @@ public:
 
    bool finished() const { return finished_; }
 
+   // the time at which the command became (or will become) ready to
+   // execute. schedulers run ready commands which have waited longest first
+   virtual boost::posix_time::ptime nextExecutionTime() const
+   {
+      return now();
+   }
+
 protected:
    boost::function<bool()> execute_;
    bool finished_;
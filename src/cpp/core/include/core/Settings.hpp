@@ -21,8 +21,10 @@
 
 #include <boost/utility.hpp>
 #include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/FilePath.hpp>
+#include <core/json/Json.hpp>
 
 namespace rstudio {
 namespace core {
@@ -51,20 +53,46 @@ public:
    double getDouble(const std::string& name, double defaultValue = 0) const;
    bool getBool(const std::string& name, bool defaultValue = false) const;
 
+   // json values are stored as text and parsed on first access (the parsed
+   // value is cached until the setting changes or is re-read)
+   json::Value getJson(const std::string& name,
+                       const json::Value& defaultValue = json::Value()) const;
+   void setJson(const std::string& name, const json::Value& value);
+
    void forEach(const boost::function<void(const std::string&,
                                            const std::string&)>& func) const;
 
    void beginUpdate();
    void endUpdate();
 
+   // write-behind mode: rather than writing on each change, changes are
+   // coalesced and written once none have been made for the delay (or
+   // once the oldest has been pending for kMaxWriteBehindDelays delays).
+   // writes happen within flushPendingWrites, which the owner of the
+   // settings must call periodically and before exiting
+   void setWriteBehind(const boost::posix_time::time_duration& delay);
+   bool writePending() const { return isDirty_; }
+
+   // write the settings if they have unwritten changes (if dueOnly then
+   // only if the write-behind delay has elapsed)
+   void flush(bool dueOnly = false);
+
+   // flush all settings in write-behind mode (they are not synchronized
+   // so this must be called from the thread which modifies them)
+   static void flushPendingWrites(bool dueOnly = false);
+
 private:
    void writeSettings() ;
 
 private:
    FilePath settingsFile_ ;
    std::map<std::string, std::string> settingsMap_ ;
+   mutable std::map<std::string, json::Value> jsonCache_;
    bool updatePending_ ;
    bool isDirty_;
+   boost::posix_time::time_duration writeBehindDelay_;
+   boost::posix_time::ptime firstChangeTime_;
+   boost::posix_time::ptime lastChangeTime_;
 };
 
 }
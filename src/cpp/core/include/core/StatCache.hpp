@@ -0,0 +1,79 @@
+/*
+ * StatCache.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_STAT_CACHE_HPP
+#define CORE_STAT_CACHE_HPP
+
+#include <ctime>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace rstudio {
+namespace core {
+namespace stat_cache {
+
+// Cache of file metadata used by FilePath::exists, isDirectory, size, and
+// lastWriteTime (which are otherwise each a separate stat, and on network
+// filesystems each stat is a round trip). Entries expire after a time to
+// live and are also invalidated when the file monitor reports changes and
+// when FilePath is used to modify the file system. The cache is disabled
+// by default (and is not supported on Windows).
+//
+// Note that paths within monitored directories still use the time to live
+// since file monitors don't report changes for paths excluded by their
+// filter (e.g. hidden directories).
+
+struct Entry
+{
+   Entry()
+      : exists(false),
+        isDirectory(false),
+        isRegularFile(false),
+        size(0),
+        lastWriteTime(0)
+   {
+   }
+
+   bool exists;
+   bool isDirectory;
+   bool isRegularFile;
+   uintmax_t size;
+   std::time_t lastWriteTime;
+};
+
+// enable the cache with the specified time to live (passing a zero
+// duration disables the cache and discards all entries)
+void setTimeToLive(const boost::posix_time::time_duration& ttl);
+
+bool enabled();
+
+// get the metadata for the path (returns false if the cache is disabled
+// or the path couldn't be examined, in which case the caller should query
+// the file system directly)
+bool lookup(const std::string& path, Entry* pEntry);
+
+// invalidate the path (along with any paths beneath it)
+void invalidate(const std::string& path);
+
+// invalidate all entries
+void invalidateAll();
+
+} // namespace stat_cache
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_STAT_CACHE_HPP
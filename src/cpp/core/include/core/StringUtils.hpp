@@ -60,6 +60,22 @@ std::string utf8ToSystem(const std::string& str,
                          bool escapeInvalidChars=false);
 std::string systemToUtf8(const std::string& str);
 
+// check text without decoding it (a word at a time through ascii runs) so
+// that callers can skip conversions which wouldn't change it
+bool isAscii(const char* begin, const char* end);
+inline bool isAscii(const std::string& str)
+{
+   return isAscii(str.data(), str.data() + str.size());
+}
+
+// well-formed utf-8 (rejects overlong forms, surrogates and code points
+// beyond U+10FFFF)
+bool isValidUtf8(const char* begin, const char* end);
+inline bool isValidUtf8(const std::string& str)
+{
+   return isValidUtf8(str.data(), str.data() + str.size());
+}
+
 std::string toLower(const std::string& str);
 std::string textToHtml(const std::string& str);
 
@@ -71,6 +87,13 @@ std::string singleQuotedStrEscape(const std::string& str);
 
 void convertLineEndings(std::string* str, LineEnding type);
 
+// convert the line endings of [begin, end) into pOutput (avoids an extra
+// copy when the input isn't already in a std::string)
+void convertLineEndings(const char* begin,
+                        const char* end,
+                        LineEnding type,
+                        std::string* pOutput);
+
 bool detectLineEndings(const FilePath& filePath, LineEnding* pType);
 
 std::string filterControlChars(const std::string& str);
@@ -16,10 +16,15 @@
 #ifndef CORE_THREAD_HPP
 #define CORE_THREAD_HPP
 
+#include <map>
 #include <queue>
+#include <vector>
 
 #include <boost/utility.hpp>
 #include <boost/function.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
 
 #include <core/BoostErrors.hpp>
 #include <core/BoostThread.hpp>
@@ -115,15 +120,33 @@ public:
       return defaultValue;
    }
 
-   V collect(const K& key)
+   // assign the value to *pValue if the key is present (avoids copying a
+   // default value and lets callers distinguish a missing key)
+   bool get(const K& key, V* pValue)
    {
       LOCK_MUTEX(mutex_)
       {
          typename std::map<K,V>::const_iterator it = map_.find(key);
          if (it != map_.end())
          {
-            std::string val = it->second;
-            map_.erase(key);
+            *pValue = it->second;
+            return true;
+         }
+      }
+      END_LOCK_MUTEX
+
+      return false;
+   }
+
+   V collect(const K& key)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         typename std::map<K,V>::iterator it = map_.find(key);
+         if (it != map_.end())
+         {
+            V val = it->second;
+            map_.erase(it);
             return val;
          }
       }
@@ -155,6 +178,130 @@ private:
    std::map<K,V> map_;
 };
 
+// map partitioned by key hash into shards which each have their own mutex,
+// so that threads working with different keys rarely contend
+template <typename K, typename V, typename Hash = boost::hash<K> >
+class ShardedThreadsafeMap : boost::noncopyable
+{
+public:
+   explicit ShardedThreadsafeMap(std::size_t shards = 16)
+      : shards_(new Shard[shards]), shardCount_(shards)
+   {
+   }
+   virtual ~ShardedThreadsafeMap() {}
+
+   bool contains(const K& key)
+   {
+      Shard& shard = shardFor(key);
+      LOCK_MUTEX(shard.mutex)
+      {
+         return shard.map.find(key) != shard.map.end();
+      }
+      END_LOCK_MUTEX
+
+      // keep compiler happy
+      return false;
+   }
+
+   V get(const K& key, const V& defaultValue = V())
+   {
+      V value;
+      if (get(key, &value))
+         return value;
+      else
+         return defaultValue;
+   }
+
+   bool get(const K& key, V* pValue)
+   {
+      Shard& shard = shardFor(key);
+      LOCK_MUTEX(shard.mutex)
+      {
+         typename Map::const_iterator it = shard.map.find(key);
+         if (it != shard.map.end())
+         {
+            *pValue = it->second;
+            return true;
+         }
+      }
+      END_LOCK_MUTEX
+
+      return false;
+   }
+
+   V collect(const K& key)
+   {
+      Shard& shard = shardFor(key);
+      LOCK_MUTEX(shard.mutex)
+      {
+         typename Map::iterator it = shard.map.find(key);
+         if (it != shard.map.end())
+         {
+            V val = it->second;
+            shard.map.erase(it);
+            return val;
+         }
+      }
+      END_LOCK_MUTEX
+
+      return V();
+   }
+
+   void set(const K& key, const V& val)
+   {
+      Shard& shard = shardFor(key);
+      LOCK_MUTEX(shard.mutex)
+      {
+         shard.map[key] = val;
+      }
+      END_LOCK_MUTEX
+   }
+
+   void remove(const K& key)
+   {
+      Shard& shard = shardFor(key);
+      LOCK_MUTEX(shard.mutex)
+      {
+         shard.map.erase(key);
+      }
+      END_LOCK_MUTEX
+   }
+
+   // (locks each shard in turn, so concurrent changes may or may not
+   // be reflected)
+   std::size_t size()
+   {
+      std::size_t size = 0;
+      for (std::size_t i = 0; i < shardCount_; i++)
+      {
+         LOCK_MUTEX(shards_[i].mutex)
+         {
+            size += shards_[i].map.size();
+         }
+         END_LOCK_MUTEX
+      }
+      return size;
+   }
+
+private:
+   typedef boost::unordered_map<K,V,Hash> Map;
+
+   struct Shard
+   {
+      boost::mutex mutex;
+      Map map;
+   };
+
+   Shard& shardFor(const K& key)
+   {
+      return shards_[hash_(key) % shardCount_];
+   }
+
+   boost::scoped_array<Shard> shards_;
+   const std::size_t shardCount_;
+   Hash hash_;
+};
+
 
 template <typename T>
 class ThreadsafeQueue : boost::noncopyable
@@ -222,6 +369,28 @@ public:
       return false;
    }
 
+   // remove all queued values at once (appending them to pVals in order).
+   // returns true if any values were removed
+   bool dequeAll(std::vector<T>* pVals)
+   {
+      LOCK_MUTEX(*pMutex_)
+      {
+         if (queue_.empty())
+            return false;
+
+         while (!queue_.empty())
+         {
+            pVals->push_back(queue_.front());
+            queue_.pop();
+         }
+         return true;
+      }
+      END_LOCK_MUTEX
+
+      // keep compiler happy
+      return false;
+   }
+
    bool isEmpty()
    {
       LOCK_MUTEX(*pMutex_)
@@ -287,6 +456,150 @@ private:
    std::queue<T> queue_;
 };
 
+// bounded multiple producer / multiple consumer queue which doesn't take
+// locks. values are stored in a ring of cells each carrying a sequence
+// number which says whether the cell is ready to be written or read at a
+// given position, so producers and consumers only contend (via compare and
+// swap) on their own position counter. enque fails rather than blocking
+// when the queue is full and deque fails when it is empty; waiting (if
+// needed) is left to the caller. with a single consumer this serves as a
+// bounded mpsc queue (see also collection::MpscQueue for an unbounded one)
+//
+// NOTE: uses the gcc __sync builtins (available on all of our toolchains)
+template <typename T>
+class BoundedQueue : boost::noncopyable
+{
+public:
+   // capacity is rounded up to a power of two
+   explicit BoundedQueue(std::size_t capacity)
+      : enquePos_(0), dequePos_(0)
+   {
+      std::size_t size = 2;
+      while (size < capacity)
+         size <<= 1;
+
+      mask_ = size - 1;
+      cells_.reset(new Cell[size]);
+      for (std::size_t i = 0; i < size; i++)
+         cells_[i].sequence = i;
+   }
+
+   // COPYING: boost::noncopyable
+
+   std::size_t capacity() const { return mask_ + 1; }
+
+   // returns false if the queue is full
+   bool enque(const T& val)
+   {
+      Cell* pCell;
+      std::size_t pos = load(&enquePos_);
+      for (;;)
+      {
+         pCell = &cells_[pos & mask_];
+         std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(
+                                    load(&pCell->sequence) - pos);
+         if (diff == 0)
+         {
+            // the cell is free at our position, try to claim it
+            if (__sync_bool_compare_and_swap(&enquePos_, pos, pos + 1))
+               break;
+            pos = load(&enquePos_);
+         }
+         else if (diff < 0)
+         {
+            // the cell still holds the value from one lap ago (full)
+            return false;
+         }
+         else
+         {
+            // another producer claimed this position
+            pos = load(&enquePos_);
+         }
+      }
+
+      pCell->value = val;
+      store(&pCell->sequence, pos + 1);
+      return true;
+   }
+
+   // returns false if the queue is empty
+   bool deque(T* pVal)
+   {
+      Cell* pCell;
+      std::size_t pos = load(&dequePos_);
+      for (;;)
+      {
+         pCell = &cells_[pos & mask_];
+         std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(
+                                    load(&pCell->sequence) - (pos + 1));
+         if (diff == 0)
+         {
+            if (__sync_bool_compare_and_swap(&dequePos_, pos, pos + 1))
+               break;
+            pos = load(&dequePos_);
+         }
+         else if (diff < 0)
+         {
+            return false;
+         }
+         else
+         {
+            pos = load(&dequePos_);
+         }
+      }
+
+      *pVal = pCell->value;
+      pCell->value = T(); // don't hold on to resources owned by the value
+      store(&pCell->sequence, pos + mask_ + 1);
+      return true;
+   }
+
+   // remove up to maxVals values (appending them to pVals). returns the
+   // number of values removed
+   std::size_t dequeMany(std::vector<T>* pVals, std::size_t maxVals)
+   {
+      std::size_t count = 0;
+      T val;
+      while (count < maxVals && deque(&val))
+      {
+         pVals->push_back(val);
+         count++;
+      }
+      return count;
+   }
+
+private:
+   static std::size_t load(volatile std::size_t* pValue)
+   {
+      std::size_t value = *pValue;
+      __sync_synchronize();
+      return value;
+   }
+
+   static void store(volatile std::size_t* pValue, std::size_t value)
+   {
+      __sync_synchronize();
+      *pValue = value;
+   }
+
+   struct Cell
+   {
+      volatile std::size_t sequence;
+      T value;
+   };
+
+   boost::scoped_array<Cell> cells_;
+   std::size_t mask_;
+
+   // kept on separate cache lines so producers and consumers don't
+   // invalidate each other's position
+   char pad0_[64];
+   volatile std::size_t enquePos_;
+   char pad1_[64];
+   volatile std::size_t dequePos_;
+   char pad2_[64];
+};
+
 void safeLaunchThread(boost::function<void()> threadMain,
                       boost::thread* pThread = NULL);
       
@@ -0,0 +1,177 @@
+/*
+ * ThreadPool.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_THREAD_POOL_HPP
+#define CORE_THREAD_POOL_HPP
+
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace rstudio {
+namespace core {
+namespace thread {
+
+enum TaskPriority
+{
+   TaskPriorityHigh,
+   TaskPriorityNormal,
+   TaskPriorityLow
+};
+
+// cancellation is cooperative: tasks whose token is cancelled before they
+// start are skipped, and running tasks may poll isCancelled. copies of a
+// token share its state
+//
+// NOTE: uses the gcc __sync builtins (available on all of our toolchains)
+class CancellationToken
+{
+public:
+   CancellationToken() : pCancelled_(new int(0)) {}
+
+   void cancel() { __sync_lock_test_and_set(pCancelled_.get(), 1); }
+   bool isCancelled() const
+   {
+      return __sync_fetch_and_add(pCancelled_.get(), 0) != 0;
+   }
+
+private:
+   boost::shared_ptr<int> pCancelled_;
+};
+
+// handle to a submitted task (copies refer to the same task)
+class TaskHandle
+{
+public:
+   TaskHandle() {}
+
+   bool empty() const { return !pState_; }
+
+   // has the task run (or been skipped because it was cancelled)
+   bool isComplete() const;
+
+   // was the task skipped because it was cancelled
+   bool wasCancelled() const;
+
+   void wait() const;
+   bool wait(const boost::posix_time::time_duration& waitDuration) const;
+
+private:
+   friend class ThreadPool;
+   struct State;
+   explicit TaskHandle(boost::shared_ptr<State> pState) : pState_(pState) {}
+   boost::shared_ptr<State> pState_;
+};
+
+// the result of a task submitted with ThreadPool::compute
+template <typename T>
+class Future
+{
+public:
+   Future() {}
+
+   const TaskHandle& handle() const { return handle_; }
+   bool isComplete() const { return handle_.isComplete(); }
+
+   // wait for and return the result (a default constructed value if the
+   // task was cancelled or threw an exception)
+   T get() const
+   {
+      handle_.wait();
+      return *pResult_;
+   }
+
+private:
+   friend class ThreadPool;
+   Future(const TaskHandle& handle, boost::shared_ptr<T> pResult)
+      : handle_(handle), pResult_(pResult)
+   {
+   }
+
+   TaskHandle handle_;
+   boost::shared_ptr<T> pResult_;
+};
+
+// pool of threads which execute tasks in order of priority. each thread
+// also has its own queue: tasks submitted from within a pool task go there
+// (favoring the cache locality of related work) and threads without work
+// steal the oldest tasks from the queues of the others. tasks run with all
+// signals blocked and exceptions which escape them are logged
+class ThreadPool : boost::noncopyable
+{
+public:
+   // threads <= 0 means defaultThreadCount()
+   explicit ThreadPool(const std::string& name, int threads = 0);
+   virtual ~ThreadPool();
+
+   // the number of cpus available to the process (see
+   // system::availableCpuCount, which accounts for cgroup limits)
+   static int defaultThreadCount();
+
+   int threadCount() const;
+
+   TaskHandle submit(const boost::function<void()>& task,
+                     TaskPriority priority = TaskPriorityNormal,
+                     const CancellationToken& token = CancellationToken());
+
+   // run the task once the antecedent has completed (whether or not it
+   // was cancelled)
+   TaskHandle continueWith(const TaskHandle& antecedent,
+                           const boost::function<void()>& task,
+                           TaskPriority priority = TaskPriorityNormal,
+                           const CancellationToken& token = CancellationToken());
+
+   // submit a task which returns a value
+   template <typename T>
+   Future<T> compute(const boost::function<T()>& task,
+                     TaskPriority priority = TaskPriorityNormal,
+                     const CancellationToken& token = CancellationToken())
+   {
+      boost::shared_ptr<T> pResult(new T());
+      TaskHandle handle = submit(boost::bind(assignResult<T>, task, pResult),
+                                 priority,
+                                 token);
+      return Future<T>(handle, pResult);
+   }
+
+   // discard queued tasks (completing their handles as cancelled) and
+   // wait for running tasks to finish. called by the destructor
+   void stop();
+
+private:
+   template <typename T>
+   static void assignResult(const boost::function<T()>& task,
+                            boost::shared_ptr<T> pResult)
+   {
+      *pResult = task();
+   }
+
+   struct Impl;
+   boost::shared_ptr<Impl> pImpl_;
+};
+
+// pool shared by the process for general purpose background work (created
+// with the default number of threads on first use, never destroyed)
+ThreadPool& sharedThreadPool();
+
+} // namespace thread
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_THREAD_POOL_HPP
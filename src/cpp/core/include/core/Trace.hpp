@@ -19,14 +19,83 @@
 #include <iosfwd>
 #include <string>
 
+#include <boost/utility.hpp>
 #include <boost/current_function.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 namespace rstudio {
-namespace core { 
+namespace core {
+
 namespace trace {
 
 void add(void* key, const std::string& functionName);
 
+// Span tracing. When tracing is enabled completed spans are recorded into
+// a fixed size ring buffer for the recording thread (so recording never
+// contends with other threads and memory is bounded). The collected spans
+// can then be written in Chrome trace_event format (load them into
+// chrome://tracing or Perfetto). When tracing is disabled spans cost a
+// single flag check.
+
+// http header used to propagate a request id across processes
+extern const char * const kRequestIdHeader;
+
+void setEnabled(bool enabled);
+bool enabled();
+
+// number of spans retained per thread (applies to threads which record
+// their first span after the call)
+void setBufferCapacity(std::size_t capacity);
+
+// name the current thread (written as thread_name metadata)
+void setThreadName(const std::string& name);
+
+// request id associated with spans recorded on the current thread
+std::string currentRequestId();
+
+// generate a new request id
+std::string newRequestId();
+
+// record a completed span
+void recordSpan(const std::string& name,
+                const boost::posix_time::ptime& startTime,
+                const boost::posix_time::ptime& endTime,
+                const std::string& requestId = currentRequestId());
+
+// write all retained spans in Chrome trace_event (json) format
+void writeChromeTrace(std::ostream& os);
+
+// discard all retained spans
+void clear();
+
+// RAII scope which records a span from construction to destruction
+class Span : boost::noncopyable
+{
+public:
+   explicit Span(const std::string& name);
+   Span(const std::string& name, const std::string& requestId);
+   ~Span();
+
+private:
+   bool active_;
+   std::string name_;
+   std::string requestId_;
+   boost::posix_time::ptime startTime_;
+};
+
+// RAII scope which sets the request id for the current thread (restoring
+// the previous request id on destruction)
+class RequestScope : boost::noncopyable
+{
+public:
+   explicit RequestScope(const std::string& requestId);
+   ~RequestScope();
+
+private:
+   std::string previousRequestId_;
+};
+
 } // namespace trace
 } // namespace core 
 } // namespace rstudio
@@ -34,5 +103,10 @@ void add(void* key, const std::string& functionName);
 #define TRACE_CURRENT_METHOD \
    core::trace::add(this, BOOST_CURRENT_FUNCTION);
 
-#endif // CORE_PERFORMANCE_TIMER_HPP
+#define TRACE_SCOPE(name) \
+   ::rstudio::core::trace::Span BOOST_PP_CAT(traceSpan, __LINE__)(name);
+
+#define TRACE_FUNCTION TRACE_SCOPE(BOOST_CURRENT_FUNCTION)
+
+#endif // CORE_TRACE_HPP
 
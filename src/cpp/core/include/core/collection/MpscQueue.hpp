@@ -0,0 +1,127 @@
+/*
+ * MpscQueue.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_COLLECTION_MPSC_QUEUE_HPP
+#define CORE_COLLECTION_MPSC_QUEUE_HPP
+
+#include <vector>
+
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace core {
+namespace collection {
+
+// multiple producer / single consumer queue. producers push without taking
+// a lock (each push is a compare and swap onto a linked stack) and the
+// consumer removes all available items at once, restoring the order in
+// which they were pushed. since items are only ever removed all at once
+// the stack is not subject to the ABA problem.
+//
+// NOTE: uses the gcc __sync builtins (available on all of our toolchains)
+template <typename T>
+class MpscQueue : boost::noncopyable
+{
+public:
+   MpscQueue() : pHead_(NULL) {}
+
+   ~MpscQueue()
+   {
+      deleteNodes(takeAll());
+   }
+
+   // COPYING: boost::noncopyable
+
+   void push(const T& value)
+   {
+      Node* pNode = new Node(value);
+      Node* pHead;
+      do
+      {
+         pHead = pHead_;
+         pNode->pNext = pHead;
+      }
+      while (!__sync_bool_compare_and_swap(&pHead_, pHead, pNode));
+   }
+
+   bool empty()
+   {
+      return __sync_val_compare_and_swap(&pHead_, NULL, NULL) == NULL;
+   }
+
+   // remove all items (appending them to pItems in the order they were
+   // pushed). returns true if any items were removed
+   bool popAll(std::vector<T>* pItems)
+   {
+      // reverse the stack into fifo order
+      Node* pNode = takeAll();
+      Node* pReversed = NULL;
+      while (pNode != NULL)
+      {
+         Node* pNext = pNode->pNext;
+         pNode->pNext = pReversed;
+         pReversed = pNode;
+         pNode = pNext;
+      }
+
+      bool removed = pReversed != NULL;
+      while (pReversed != NULL)
+      {
+         pItems->push_back(pReversed->value);
+         Node* pNext = pReversed->pNext;
+         delete pReversed;
+         pReversed = pNext;
+      }
+      return removed;
+   }
+
+private:
+   struct Node
+   {
+      explicit Node(const T& value) : value(value), pNext(NULL) {}
+      T value;
+      Node* pNext;
+   };
+
+   Node* takeAll()
+   {
+      Node* pHead;
+      do
+      {
+         pHead = pHead_;
+      }
+      while (!__sync_bool_compare_and_swap(&pHead_, pHead, NULL));
+      return pHead;
+   }
+
+   static void deleteNodes(Node* pNode)
+   {
+      while (pNode != NULL)
+      {
+         Node* pNext = pNode->pNext;
+         delete pNode;
+         pNode = pNext;
+      }
+   }
+
+private:
+   Node* volatile pHead_;
+};
+
+} // namespace collection
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_COLLECTION_MPSC_QUEUE_HPP
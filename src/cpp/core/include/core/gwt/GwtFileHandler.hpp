@@ -20,7 +20,16 @@
 
 namespace rstudio {
 namespace core {
+
+class Error;
+
 namespace gwt {
+
+// load the static files beneath wwwLocalPath into memory along with their
+// gzip encodings and etags, so that file handlers for the path serve them
+// without reading or compressing them per request (files which change on
+// disk are served from disk again)
+Error preloadStaticAssets(const std::string& wwwLocalPath);
       
 http::UriHandlerFunction fileHandlerFunction(
       const std::string& wwwLocalPath,
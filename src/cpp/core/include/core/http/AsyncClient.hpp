@@ -73,7 +73,10 @@ public:
                bool logToStderr = false)
       : ioService_(ioService),
         connectionRetryContext_(ioService),
-        logToStderr_(logToStderr)
+        logToStderr_(logToStderr),
+        keepAlive_(false),
+        connectionReusable_(false),
+        reusingConnection_(false)
    {
    }
 
@@ -92,6 +95,23 @@ public:
       connectionRetryContext_.profile = connectionRetryProfile;
    }
 
+   // request that the connection be kept open after the response is
+   // received so that it can be used for subsequent requests (the
+   // server must honor keep-alive and specify a Content-Length for
+   // the connection to actually be reusable). must do this prior to
+   // calling execute
+   void setKeepAlive(bool keepAlive)
+   {
+      keepAlive_ = keepAlive;
+   }
+
+   // is the connection still open and available for another request (only
+   // ever true for keep-alive clients which received a complete response)
+   bool isReusable()
+   {
+      return connectionReusable_ && socket().lowest_layer().is_open();
+   }
+
    // execute the async client
    void execute(const ResponseHandler& responseHandler,
                 const ErrorHandler& errorHandler)
@@ -100,8 +120,23 @@ public:
       responseHandler_ = responseHandler;
       errorHandler_ = errorHandler;
 
+      // if we are re-using a kept-alive connection then clear the state
+      // from the previous request and write the new request directly
+      if (isReusable())
+      {
+         connectionReusable_ = false;
+         reusingConnection_ = true;
+         response_.reset();
+         connectionRetryContext_.stopTryingTime =
+                                    boost::posix_time::not_a_date_time;
+         writeRequest();
+         return;
+      }
+
       // connect and write request (implmented in a protocol
       // specific manner by subclassees)
+      connectionReusable_ = false;
+      reusingConnection_ = false;
       connectAndWriteRequest();
    }
 
@@ -143,10 +178,10 @@ public:
          logError(error);
    }
 
-protected:
-
    boost::asio::io_service& ioService() { return ioService_; }
 
+protected:
+
    virtual SocketService& socket() = 0;
 
    void handleConnectionError(const Error& connectionError)
@@ -174,7 +209,8 @@ protected:
       if (!boost::algorithm::iequals(request_.headerValue("Connection"),
                                      "Upgrade"))
       {
-         overrideHeader = Header::connectionClose();
+         overrideHeader = keepAlive_ ? Header::connectionKeepAlive() :
+                                       Header::connectionClose();
       }
 
       // write
@@ -193,6 +229,18 @@ protected:
       // close the socket
       close();
 
+      // the server may have closed a kept-alive connection while it was
+      // idle. if that happened before any of the response was received
+      // then transparently retry the request on a fresh connection
+      if (reusingConnection_ && http::isConnectionTerminatedError(error))
+      {
+         reusingConnection_ = false;
+         responseBuffer_.consume(responseBuffer_.size());
+         response_.reset();
+         connectAndWriteRequest();
+         return;
+      }
+
       if (errorHandler_)
          errorHandler_(error);
    }
@@ -339,6 +387,10 @@ private:
       {
          if (!ec)
          {
+            // we've started receiving a response so this request can no
+            // longer be retried on a fresh connection
+            reusingConnection_ = false;
+
             // parase status line
             Error error = ResponseParser::parseStatusLine(&responseBuffer_,
                                                           &response_);
@@ -381,6 +433,20 @@ private:
          return;
       }
 
+      // for keep-alive connections we stop reading as soon as we have
+      // the entire body (provided the server told us how long it is and
+      // didn't indicate that it's going to close the connection)
+      if (keepAlive_ &&
+          response_.containsHeader("Content-Length") &&
+          response_.body().length() >= response_.contentLength() &&
+          !boost::algorithm::iequals(response_.headerValue("Connection"),
+                                     "close"))
+      {
+         connectionReusable_ = true;
+         closeAndRespond();
+         return;
+      }
+
       boost::asio::async_read(
          socket(),
          responseBuffer_,
@@ -456,11 +522,14 @@ private:
 
    void closeAndRespond()
    {
-      if (!keepConnectionAlive())
+      if (!keepConnectionAlive() && !connectionReusable_)
          close();
 
-      if (responseHandler_)
-         responseHandler_(response_);
+      // invoke a copy of the handler (a kept-alive connection may be
+      // re-executed with a new handler from within the handler)
+      ResponseHandler responseHandler = responseHandler_;
+      if (responseHandler)
+         responseHandler(response_);
    }
 
    void logError(const Error& error) const
@@ -497,6 +566,9 @@ private:
    boost::asio::io_service& ioService_;
    ConnectionRetryContext connectionRetryContext_;
    bool logToStderr_;
+   bool keepAlive_;
+   bool connectionReusable_;
+   bool reusingConnection_;
    ResponseHandler responseHandler_;
    ErrorHandler errorHandler_;
    http::Request request_;
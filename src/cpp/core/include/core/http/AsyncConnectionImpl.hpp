@@ -16,14 +16,19 @@
 #ifndef CORE_HTTP_ASYNC_CONNECTION_IMPL_HPP
 #define CORE_HTTP_ASYNC_CONNECTION_IMPL_HPP
 
+#include <algorithm>
+
 #include <boost/array.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
+#include <boost/algorithm/string/predicate.hpp>
+
 #include <boost/asio/write.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/placeholders.hpp>
+#include <boost/asio/deadline_timer.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
@@ -32,7 +37,10 @@
 #include <core/http/Response.hpp>
 #include <core/http/SocketUtils.hpp>
 #include <core/http/RequestParser.hpp>
+#include <core/http/FileResponseBody.hpp>
+#include <core/http/ResponseCompression.hpp>
 #include <core/http/AsyncConnection.hpp>
+#include <core/http/AsyncUriHandler.hpp>
 
 namespace rstudio {
 namespace core {
@@ -49,16 +57,35 @@ public:
          boost::shared_ptr<AsyncConnectionImpl<ProtocolType> >,
          http::Request*)> Handler;
 
+   // lookup a streaming handler for a uri (returns an empty function if
+   // the request should be handled normally)
+   typedef boost::function<AsyncStreamingUriHandlerFunction(
+                                    const std::string&)> StreamingHandlerLookup;
+
 public:
    AsyncConnectionImpl(boost::asio::io_service& ioService,
                        const Handler& handler,
                        const RequestFilter& requestFilter = RequestFilter(),
-                       const ResponseFilter& responseFilter = ResponseFilter())
+                       const ResponseFilter& responseFilter = ResponseFilter(),
+                       const StreamingHandlerLookup& streamingHandlerLookup =
+                                                      StreamingHandlerLookup(),
+                       const boost::shared_ptr<const CompressionOptions>&
+                          pCompressionOptions =
+                             boost::shared_ptr<const CompressionOptions>(),
+                       bool keepAlive = false)
       : ioService_(ioService),
         socket_(ioService),
         handler_(handler),
         requestFilter_(requestFilter),
-        responseFilter_(responseFilter)
+        responseFilter_(responseFilter),
+        streamingHandlerLookup_(streamingHandlerLookup),
+        pCompressionOptions_(pCompressionOptions),
+        keepAlive_(keepAlive),
+        idleTimer_(ioService),
+        headersParsed_(false),
+        bodyBytesRemaining_(0),
+        requestRead_(false),
+        keepAliveResponse_(false)
         
    {
    }
@@ -92,13 +119,34 @@ public:
    {
       // add extra response headers
       response_.setHeader("Date", util::httpDate());
-      if (close)
-         response_.setHeader("Connection", "close");
 
       // call the response filter if we have one
       if (responseFilter_)
          responseFilter_(originalUri_, &response_);
 
+      // compress the body if appropriate
+      if (pCompressionOptions_)
+         compressResponse(request_, *pCompressionOptions_, &response_);
+
+      // rather than closing the connection we may be able to keep it open
+      // for the client's next request
+      keepAliveResponse_ = close && canKeepAlive();
+      if (keepAliveResponse_)
+         response_.setHeader("Connection", "keep-alive");
+      else if (close)
+         response_.setHeader("Connection", "close");
+
+      // open file-backed body (written once the headers are sent)
+      if (response_.hasFileBody())
+      {
+         Error error = FileResponseBody::create(response_, &pFileBody_);
+         if (error)
+         {
+            LOG_ERROR(error);
+            response_.setError(error);
+         }
+      }
+
       // write
       boost::asio::async_write(
           socket_,
@@ -141,6 +189,23 @@ public:
       boost::asio::async_write(socket(), buffers, handler);
    }
 
+#ifndef _WIN32
+   virtual int nativeHandle()
+   {
+      return socket().native_handle();
+   }
+
+   virtual void asyncWaitReadable(Socket::Handler handler)
+   {
+      socket().async_read_some(boost::asio::null_buffers(), handler);
+   }
+
+   virtual void asyncWaitWritable(Socket::Handler handler)
+   {
+      socket().async_write_some(boost::asio::null_buffers(), handler);
+   }
+#endif
+
    virtual void close()
    {
       Error error = closeSocket(socket_);
@@ -155,13 +220,56 @@ private:
    {
       try
       {
+         // no longer idle (if we were waiting for a kept alive
+         // connection's next request)
+         idleTimer_.cancel();
+
          if (!e)
          {
+            const char* begin = buffer_.data();
+            const char* end = buffer_.data() + bytesTransferred;
+
+            // if we are streaming a request body then hand off the chunk
+            if (pBodyHandler_)
+            {
+               handleBodyChunk(begin, end);
+               return;
+            }
+
             // parse next chunk
-            RequestParser::status status = requestParser_.parse(
-                                             request_,
-                                             buffer_.data(), 
-                                             buffer_.data() + bytesTransferred);
+            RequestParser::status status;
+            if (!streamingHandlerLookup_)
+            {
+               status = requestParser_.parse(request_, begin, end);
+            }
+            else if (!headersParsed_)
+            {
+               // parse the headers alone so we can check whether the body
+               // should be streamed to a handler
+               status = requestParser_.parseHeaders(request_,
+                                                    begin,
+                                                    end,
+                                                    &begin);
+               if (status == RequestParser::complete)
+               {
+                  headersParsed_ = true;
+
+                  AsyncStreamingUriHandlerFunction streamingHandler =
+                                   streamingHandlerLookup_(request_.uri());
+                  if (streamingHandler)
+                  {
+                     beginStreaming(streamingHandler, begin, end);
+                     return;
+                  }
+
+                  if (requestParser_.contentLength() > 0)
+                     status = requestParser_.parseBody(request_, begin, end);
+               }
+            }
+            else
+            {
+               status = requestParser_.parseBody(request_, begin, end);
+            }
             
             // error - return bad request
             if (status == RequestParser::error)
@@ -179,6 +287,8 @@ private:
             // got valid request -- handle it 
             else
             {
+               requestRead_ = true;
+
                // record the original uri
                originalUri_ = request_.absoluteUri();
 
@@ -224,6 +334,99 @@ private:
       CATCH_UNEXPECTED_EXCEPTION
    }
    
+   void beginStreaming(const AsyncStreamingUriHandlerFunction& handler,
+                       const char* begin,
+                       const char* end)
+   {
+      // record the original uri
+      originalUri_ = request_.absoluteUri();
+
+      // hold on to the portion of the body read along with the headers
+      // and the handler we'll be streaming to
+      pendingBody_.assign(begin, end);
+      streamingHandler_ = handler;
+
+      // call the request filter if we have one (note that for streamed
+      // requests the filter only has access to the request headers)
+      if (requestFilter_)
+      {
+         requestFilter_(
+            ioService(),
+            &request_,
+            boost::bind(
+               &AsyncConnectionImpl<ProtocolType>::streamingFilterContinuation,
+               AsyncConnectionImpl<ProtocolType>::shared_from_this(),
+               _1
+            ));
+      }
+      else
+      {
+         startStreamingBody();
+      }
+   }
+
+   void streamingFilterContinuation(boost::shared_ptr<http::Response> response)
+   {
+      if (response)
+      {
+         response_.assign(*response);
+         writeResponse();
+      }
+      else
+      {
+         startStreamingBody();
+      }
+   }
+
+   void startStreamingBody()
+   {
+      // get the body handler (a null handler indicates that the handler
+      // has already dealt with the request, e.g. by rejecting it)
+      pBodyHandler_ = streamingHandler_(
+                        AsyncConnectionImpl<ProtocolType>::shared_from_this());
+      streamingHandler_ = AsyncStreamingUriHandlerFunction();
+      if (!pBodyHandler_)
+         return;
+
+      // start with the body bytes we've already read
+      bodyBytesRemaining_ = requestParser_.contentLength();
+      std::string pendingBody;
+      pendingBody.swap(pendingBody_);
+      handleBodyChunk(pendingBody.data(),
+                      pendingBody.data() + pendingBody.size());
+   }
+
+   void handleBodyChunk(const char* begin, const char* end)
+   {
+      std::size_t size = std::min(static_cast<std::size_t>(end - begin),
+                                  bodyBytesRemaining_);
+      if (size > 0)
+      {
+         Error error = pBodyHandler_->onBodyChunk(begin, size);
+         if (error)
+         {
+            pBodyHandler_.reset();
+            writeError(error);
+            return;
+         }
+         bodyBytesRemaining_ -= size;
+      }
+
+      if (bodyBytesRemaining_ == 0)
+      {
+         requestRead_ = true;
+         boost::shared_ptr<AsyncRequestBodyHandler> pBodyHandler =
+                                                            pBodyHandler_;
+         pBodyHandler_.reset();
+         pBodyHandler->onBodyComplete(
+                        AsyncConnectionImpl<ProtocolType>::shared_from_this());
+      }
+      else
+      {
+         readSome();
+      }
+   }
+
    void requestFilterContinuation(boost::shared_ptr<http::Response> response)
    {
       if (response)
@@ -254,7 +457,20 @@ private:
             if (!http::isConnectionTerminatedError(error))
                LOG_ERROR(error);
          }
+         else if (pFileBody_ && !pFileBody_->complete())
+         {
+            // continue with the file-backed body
+            writeFileBody(close);
+            return;
+         }
          
+         // wait for the next request on a kept alive connection
+         if (close && !e && keepAliveResponse_)
+         {
+            readNextRequest();
+            return;
+         }
+
          // close the socket
          if (close)
          {
@@ -271,6 +487,123 @@ private:
       CATCH_UNEXPECTED_EXCEPTION
    }
    
+   void writeFileBody(bool close)
+   {
+      Error error;
+
+#ifndef _WIN32
+      if (pFileBody_->canSendFile())
+      {
+         bool wouldBlock;
+         error = pFileBody_->sendFile(nativeHandle(), &wouldBlock);
+         if (!error)
+         {
+            // wait for the socket to become writable if necessary,
+            // otherwise we are done
+            if (wouldBlock)
+            {
+               socket_.async_write_some(
+                  boost::asio::null_buffers(),
+                  boost::bind(
+                     &AsyncConnectionImpl<ProtocolType>::handleWrite,
+                     AsyncConnectionImpl<ProtocolType>::shared_from_this(),
+                     boost::asio::placeholders::error,
+                     close));
+            }
+            else
+            {
+               handleWrite(boost::system::error_code(), close);
+            }
+            return;
+         }
+      }
+      else
+#endif
+      {
+         error = pFileBody_->readChunk(&fileBodyChunk_);
+         if (!error)
+         {
+            boost::asio::async_write(
+               socket_,
+               boost::asio::buffer(fileBodyChunk_),
+               boost::bind(
+                  &AsyncConnectionImpl<ProtocolType>::handleWrite,
+                  AsyncConnectionImpl<ProtocolType>::shared_from_this(),
+                  boost::asio::placeholders::error,
+                  close));
+            return;
+         }
+      }
+
+      // the headers have already gone out so all we can do on error
+      // is log and close the connection
+      if (!http::isConnectionTerminatedError(error))
+         LOG_ERROR(error);
+      error = closeSocket(socket_);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   // the connection can be kept open after the response if the client
+   // supports it, the request has been read in full and the response's
+   // end can be determined without closing the connection
+   bool canKeepAlive() const
+   {
+      if (!keepAlive_ || !requestRead_)
+         return false;
+
+      std::string connection = request_.headerValue("Connection");
+      if (request_.isHttp10() ?
+             !boost::algorithm::icontains(connection, "keep-alive") :
+             boost::algorithm::icontains(connection, "close"))
+      {
+         return false;
+      }
+
+      // responses which never have a body
+      int status = response_.statusCode();
+      if (status == http::status::NotModified || status == 204)
+         return true;
+
+      return !response_.headerValue("Content-Length").empty() &&
+             response_.headerValue("Transfer-Encoding").empty();
+   }
+
+   void readNextRequest()
+   {
+      // reset request state
+      requestParser_.reset();
+      request_.reset();
+      response_.reset();
+      headersParsed_ = false;
+      pendingBody_.clear();
+      bodyBytesRemaining_ = 0;
+      requestRead_ = false;
+      keepAliveResponse_ = false;
+      originalUri_.clear();
+      pFileBody_.reset();
+      fileBodyChunk_.clear();
+
+      // close the connection if the client leaves it idle
+      idleTimer_.expires_from_now(
+                           boost::posix_time::seconds(kKeepAliveTimeoutSeconds));
+      idleTimer_.async_wait(boost::bind(
+               &AsyncConnectionImpl<ProtocolType>::handleIdleTimeout,
+               AsyncConnectionImpl<ProtocolType>::shared_from_this(),
+               boost::asio::placeholders::error));
+
+      readSome();
+   }
+
+   void handleIdleTimeout(const boost::system::error_code& e)
+   {
+      if (e == boost::asio::error::operation_aborted)
+         return;
+
+      // closing the socket completes the pending read (with an error)
+      close();
+   }
+
    void readSome()
    {
       socket_.async_read_some(
@@ -284,16 +617,31 @@ private:
    }
 
 private:
+   static const int kKeepAliveTimeoutSeconds = 60;
+
    boost::asio::io_service& ioService_;
    typename ProtocolType::socket socket_;
    Handler handler_;
    RequestFilter requestFilter_;
    ResponseFilter responseFilter_;
+   StreamingHandlerLookup streamingHandlerLookup_;
+   boost::shared_ptr<const CompressionOptions> pCompressionOptions_;
+   bool keepAlive_;
+   boost::asio::deadline_timer idleTimer_;
+   bool headersParsed_;
+   std::string pendingBody_;
+   AsyncStreamingUriHandlerFunction streamingHandler_;
+   boost::shared_ptr<AsyncRequestBodyHandler> pBodyHandler_;
+   std::size_t bodyBytesRemaining_;
+   bool requestRead_;
+   bool keepAliveResponse_;
    boost::array<char, 8192> buffer_ ;
    RequestParser requestParser_ ;
    std::string originalUri_;
    http::Request request_;
    http::Response response_;
+   boost::shared_ptr<FileResponseBody> pFileBody_;
+   std::string fileBodyChunk_;
 };
    
 
@@ -26,6 +26,7 @@
 
 #include <core/http/UriHandler.hpp>
 #include <core/http/AsyncUriHandler.hpp>
+#include <core/http/ResponseCompression.hpp>
 
 namespace rstudio {
 namespace core {
@@ -49,6 +50,12 @@ public:
    virtual void addBlockingHandler(const std::string& prefix,
                                    const UriHandlerFunction& handler) = 0;
 
+   // add a handler which receives the request body in chunks as it
+   // arrives (used for large uploads which shouldn't be held in memory)
+   virtual void addStreamingHandler(
+                     const std::string& prefix,
+                     const AsyncStreamingUriHandlerFunction& handler) = 0;
+
 
    virtual void setDefaultHandler(const AsyncUriHandlerFunction& handler) = 0;
 
@@ -62,6 +69,20 @@ public:
    virtual void setRequestFilter(RequestFilter requestFilter) = 0;
    virtual void setResponseFilter(ResponseFilter responseFilter) = 0;
 
+   // compress eligible responses based on the request's Accept-Encoding
+   // (responses are not compressed unless this is called)
+   virtual void setCompressionOptions(const CompressionOptions& options) = 0;
+
+   // give each thread of the pool its own io_service (with accepted
+   // connections distributed across them round-robin) rather than having
+   // all threads share one. optionally pin each thread to a cpu
+   virtual void setIoServicePerThread(bool ioServicePerThread,
+                                      bool cpuAffinity = false) = 0;
+
+   // keep connections open between requests (http/1.1 persistent
+   // connections) rather than closing them after each response
+   virtual void setKeepAlive(bool keepAlive) = 0;
+
    virtual Error runSingleThreaded() = 0;
 
    virtual Error run(std::size_t threadPoolSize = 1) = 0;
@@ -35,6 +35,10 @@
 #include <core/ScheduledCommand.hpp>
 #include <core/system/System.hpp>
 
+#ifndef _WIN32
+#include <core/system/PosixSched.hpp>
+#endif
+
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
 #include <core/http/AsyncServer.hpp>
@@ -62,6 +66,10 @@ public:
         acceptorService_(),
         scheduledCommandInterval_(boost::posix_time::seconds(3)),
         scheduledCommandTimer_(acceptorService_.ioService()),
+        ioServicePerThread_(false),
+        cpuAffinity_(false),
+        keepAlive_(false),
+        nextIoService_(0),
         running_(false)
    {
    }
@@ -96,6 +104,14 @@ public:
                  boost::bind(handleAsyncConnectionSynchronously, handler, _1));
    }
 
+   virtual void addStreamingHandler(
+                        const std::string& prefix,
+                        const AsyncStreamingUriHandlerFunction& handler)
+   {
+      BOOST_ASSERT(!running_);
+      uriHandlers_.addStreaming(baseUri_ + prefix, handler);
+   }
+
    virtual void setDefaultHandler(const AsyncUriHandlerFunction& handler)
    {
       BOOST_ASSERT(!running_);
@@ -135,6 +151,26 @@ public:
       responseFilter_ = responseFilter;
    }
 
+   virtual void setCompressionOptions(const CompressionOptions& options)
+   {
+      BOOST_ASSERT(!running_);
+      pCompressionOptions_.reset(new CompressionOptions(options));
+   }
+
+   virtual void setIoServicePerThread(bool ioServicePerThread,
+                                      bool cpuAffinity)
+   {
+      BOOST_ASSERT(!running_);
+      ioServicePerThread_ = ioServicePerThread;
+      cpuAffinity_ = cpuAffinity;
+   }
+
+   virtual void setKeepAlive(bool keepAlive)
+   {
+      BOOST_ASSERT(!running_);
+      keepAlive_ = keepAlive;
+   }
+
    virtual Error runSingleThreaded()
    {
 
@@ -162,6 +198,22 @@ public:
          // update state
          running_ = true;
 
+         // create an io_service for each additional thread (the first
+         // thread runs the acceptor's io_service). work objects keep them
+         // running while they have no connections
+         if (ioServicePerThread_)
+         {
+            for (std::size_t i=1; i < threadPoolSize; ++i)
+            {
+               boost::shared_ptr<boost::asio::io_service> pIoService(
+                                             new boost::asio::io_service());
+               connectionIoServices_.push_back(pIoService);
+               connectionIoServiceWork_.push_back(
+                  boost::shared_ptr<boost::asio::io_service::work>(
+                     new boost::asio::io_service::work(*pIoService)));
+            }
+         }
+
          // get ready for next connection
          acceptNextConnection();
 
@@ -179,9 +231,20 @@ public:
          for (std::size_t i=0; i < threadPoolSize; ++i)
          {
             // run the thread
-            boost::shared_ptr<boost::thread> pThread(new boost::thread(
-                              &AsyncServerImpl<ProtocolType>::runServiceThread,
-                              this));
+            boost::shared_ptr<boost::thread> pThread;
+            if (ioServicePerThread_)
+            {
+               pThread.reset(new boost::thread(
+                     &AsyncServerImpl<ProtocolType>::runIoServiceThread,
+                     this,
+                     i));
+            }
+            else
+            {
+               pThread.reset(new boost::thread(
+                     &AsyncServerImpl<ProtocolType>::runServiceThread,
+                     this));
+            }
             
             // add to list of threads
             threads_.push_back(pThread);            
@@ -206,6 +269,12 @@ public:
       
       // stop the server 
       acceptorService_.ioService().stop();
+      connectionIoServiceWork_.clear();
+      BOOST_FOREACH(boost::shared_ptr<boost::asio::io_service> pIoService,
+                    connectionIoServices_)
+      {
+         pIoService->stop();
+      }
 
       // update state
       running_ = false;
@@ -237,13 +306,72 @@ private:
       CATCH_UNEXPECTED_EXCEPTION
    }
 
+   // run the io_service for the index-th thread of the pool (used when
+   // each thread has its own io_service)
+   void runIoServiceThread(std::size_t index)
+   {
+#ifndef _WIN32
+      if (cpuAffinity_)
+      {
+         // affinity applies to the calling thread only
+         core::system::CpuAffinity cpus = core::system::emptyCpuAffinity();
+         if (!cpus.empty())
+         {
+            cpus[index % cpus.size()] = true;
+            Error error = core::system::setCpuAffinity(cpus);
+            if (error)
+               LOG_ERROR(error);
+         }
+      }
+#endif
+
+      if (index == 0)
+      {
+         runServiceThread();
+         return;
+      }
+
+      try
+      {
+         boost::system::error_code ec;
+         connectionIoServices_[index - 1]->run(ec);
+         if (ec)
+            LOG_ERROR(Error(ec, ERROR_LOCATION));
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   // io_service for the next accepted connection (round-robin across the
+   // per-thread io_services if we have them)
+   boost::asio::io_service& nextConnectionIoService()
+   {
+      if (connectionIoServices_.empty())
+         return acceptorService_.ioService();
+
+      std::size_t index = nextIoService_++ % (connectionIoServices_.size() + 1);
+      if (index == 0)
+         return acceptorService_.ioService();
+      else
+         return *connectionIoServices_[index - 1];
+   }
+
    void acceptNextConnection()
    {
+      // only look for streaming handlers if some have been registered
+      typename AsyncConnectionImpl<ProtocolType>::StreamingHandlerLookup
+                                                         streamingLookup;
+      if (uriHandlers_.hasStreamingHandlers())
+      {
+         streamingLookup = boost::bind(&AsyncUriHandlers::streamingHandlerFor,
+                                       &uriHandlers_,
+                                       _1);
+      }
+
       // create a new connection 
       ptrNextConnection_.reset(new AsyncConnectionImpl<ProtocolType>(
                                                                  
          // controlling io_service
-         acceptorService_.ioService(),
+         nextConnectionIoService(),
 
          // connection handler
          boost::bind(&AsyncServerImpl<ProtocolType>::handleConnection,
@@ -255,7 +383,16 @@ private:
 
          // response filter
          boost::bind(&AsyncServerImpl<ProtocolType>::connectionResponseFilter,
-                     this, _1, _2)
+                     this, _1, _2),
+
+         // streaming handler lookup
+         streamingLookup,
+
+         // response compression
+         pCompressionOptions_,
+
+         // keep-alive
+         keepAlive_
       ));
       
       // wait for next connection
@@ -498,6 +635,15 @@ private:
    std::vector<boost::shared_ptr<ScheduledCommand> > scheduledCommands_;
    RequestFilter requestFilter_;
    ResponseFilter responseFilter_;
+   boost::shared_ptr<const CompressionOptions> pCompressionOptions_;
+   bool ioServicePerThread_;
+   bool cpuAffinity_;
+   bool keepAlive_;
+   std::vector<boost::shared_ptr<boost::asio::io_service> >
+                                                   connectionIoServices_;
+   std::vector<boost::shared_ptr<boost::asio::io_service::work> >
+                                                   connectionIoServiceWork_;
+   std::size_t nextIoService_;
    bool running_;
 };
 
@@ -25,7 +25,10 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <core/Error.hpp>
+
 #include <core/http/UriHandler.hpp>
+#include <core/http/UriPrefixTrie.hpp>
 #include <core/http/AsyncConnection.hpp>
 
 
@@ -37,6 +40,29 @@ namespace http {
 typedef boost::function<void(
             boost::shared_ptr<AsyncConnection>)> AsyncUriHandlerFunction;
 
+// receives the body of a streamed request in chunks as they are read from
+// the connection (rather than having it accumulated into Request::body)
+class AsyncRequestBodyHandler
+{
+public:
+   virtual ~AsyncRequestBodyHandler() {}
+
+   // called with each chunk of the body in the order it arrives. returning
+   // an error aborts the request (an error response is written)
+   virtual Error onBodyChunk(const char* data, std::size_t size) = 0;
+
+   // called once the entire body has been received. the handler is then
+   // responsible for writing a response to the connection
+   virtual void onBodyComplete(
+                     boost::shared_ptr<AsyncConnection> pConnection) = 0;
+};
+
+// AsyncStreamingUriHandlerFunction concept (called as soon as the request
+// headers are available, returns the handler for the request's body)
+typedef boost::function<boost::shared_ptr<AsyncRequestBodyHandler>(
+            boost::shared_ptr<AsyncConnection>)>
+                                          AsyncStreamingUriHandlerFunction;
+
 class AsyncUriHandler
 {
 public:
@@ -55,6 +81,11 @@ public:
       return boost::algorithm::starts_with(uri, prefix_);
    }
 
+   const std::string& prefix() const
+   {
+      return prefix_;
+   }
+
    AsyncUriHandlerFunction function() const
    {
       return function_;
@@ -80,19 +111,38 @@ class AsyncUriHandlers
 public:
    void add(AsyncUriHandler handler)
    {
+      prefixes_.add(handler.prefix(), uriHandlers_.size());
       uriHandlers_.push_back(handler);
    }
 
+   void addStreaming(const std::string& prefix,
+                     AsyncStreamingUriHandlerFunction function)
+   {
+      streamingPrefixes_.add(prefix, streamingUriHandlers_.size());
+      streamingUriHandlers_.push_back(std::make_pair(prefix, function));
+   }
+
+   AsyncStreamingUriHandlerFunction streamingHandlerFor(
+                                             const std::string& uri) const
+   {
+      std::size_t index;
+      if (streamingPrefixes_.find(uri, &index))
+         return streamingUriHandlers_[index].second;
+      else
+         return AsyncStreamingUriHandlerFunction();
+   }
+
+   bool hasStreamingHandlers() const
+   {
+      return !streamingUriHandlers_.empty();
+   }
+
    AsyncUriHandlerFunction handlerFor(const std::string& uri) const
    {
-      std::vector<AsyncUriHandler>::const_iterator handler =
-            std::find_if(
-              uriHandlers_.begin(),
-              uriHandlers_.end(),
-              boost::bind(&AsyncUriHandler::matches, _1, uri));
-      if ( handler != uriHandlers_.end() )
+      std::size_t index;
+      if (prefixes_.find(uri, &index))
       {
-         return handler->function();
+         return uriHandlers_[index].function();
       }
       else
       {
@@ -102,6 +152,12 @@ public:
 
 private:
    std::vector<AsyncUriHandler> uriHandlers_;
+   UriPrefixTrie prefixes_;
+
+   typedef std::pair<std::string, AsyncStreamingUriHandlerFunction>
+                                                         StreamingHandler;
+   std::vector<StreamingHandler> streamingUriHandlers_;
+   UriPrefixTrie streamingPrefixes_;
 };
 
 } // namespace http
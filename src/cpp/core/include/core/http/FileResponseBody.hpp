@@ -0,0 +1,117 @@
+/*
+ * FileResponseBody.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_FILE_RESPONSE_BODY_HPP
+#define CORE_HTTP_FILE_RESPONSE_BODY_HPP
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+class Response;
+
+// writer for responses with a file-backed body (see Response::setFileBody).
+// the file is sent with sendfile where the platform and encoding permit
+// and otherwise read (and optionally gzip compressed) in fixed size chunks
+// so that memory usage doesn't grow with the size of the file
+class FileResponseBody : boost::noncopyable
+{
+public:
+   static Error create(const Response& response,
+                       boost::shared_ptr<FileResponseBody>* pBody);
+
+   virtual ~FileResponseBody();
+
+   // COPYING: boost::noncopyable
+
+   // can the body be written using sendFile (otherwise use readChunk)
+   bool canSendFile() const;
+
+   // has the entire body been written/read
+   bool complete() const { return complete_; }
+
+   // read the next chunk of the body. the chunk is only ever empty
+   // once the body is complete
+   Error readChunk(std::string* pChunk);
+
+   // write as much of the body to the socket as it will currently accept.
+   // pWouldBlock is set to true if the socket needs to become writable
+   // before more of the body can be sent
+   Error sendFile(int socketFd, bool* pWouldBlock);
+
+   // write the entire body to a synchronous stream (socketFd is the
+   // native handle of the stream, used for sendfile if it is not -1)
+   template <typename SyncWriteStream>
+   Error write(SyncWriteStream& stream, int socketFd = -1)
+   {
+      if (canSendFile() && socketFd != -1)
+         return sendFileBlocking(socketFd);
+
+      try
+      {
+         std::string chunk;
+         while (!complete())
+         {
+            Error error = readChunk(&chunk);
+            if (error)
+               return error;
+
+            boost::asio::write(stream, boost::asio::buffer(chunk));
+         }
+         return Success();
+      }
+      catch(const boost::system::system_error& e)
+      {
+         return Error(e.code(), ERROR_LOCATION);
+      }
+   }
+
+private:
+   FileResponseBody(const FilePath& filePath, bool gzip);
+   Error open();
+   Error sendFileBlocking(int socketFd);
+   Error truncatedError(const ErrorLocation& location) const;
+
+private:
+   FilePath filePath_;
+   bool gzip_;
+   bool complete_;
+   uintmax_t size_;
+   uintmax_t offset_;
+   int fd_;
+   boost::shared_ptr<std::istream> pIfs_;
+   std::vector<char> buffer_;
+   std::string compressed_;
+   boost::shared_ptr<boost::iostreams::filtering_ostream> pCompressor_;
+};
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_FILE_RESPONSE_BODY_HPP
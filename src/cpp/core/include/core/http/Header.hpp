@@ -36,6 +36,10 @@ struct Header
    bool empty() const { return name.empty(); }
    
    static Header connectionClose() { return Header("Connection", "close"); }
+   static Header connectionKeepAlive()
+   {
+      return Header("Connection", "keep-alive");
+   }
 };
    
 typedef std::vector<Header> Headers ;
@@ -52,6 +56,9 @@ private:
    std::string name_ ;
 };
    
+// case-insensitive hash of a header name
+std::size_t headerNameHash(const std::string& name);
+
 bool containsHeader(const Headers& headers, const std::string& name);
    
 Headers::const_iterator findHeader(const Headers& headers, 
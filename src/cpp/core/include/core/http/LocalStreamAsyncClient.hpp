@@ -47,6 +47,23 @@ public:
       setConnectionRetryProfile(retryProfile);
    }
 
+   // expose the plain socket descriptor so the connection can participate
+   // in zero-copy forwarding once it has been upgraded (see SocketProxy)
+   virtual int nativeHandle()
+   {
+      return socket_.native_handle();
+   }
+
+   virtual void asyncWaitReadable(Handler handler)
+   {
+      socket_.async_read_some(boost::asio::null_buffers(), handler);
+   }
+
+   virtual void asyncWaitWritable(Handler handler)
+   {
+      socket_.async_write_some(boost::asio::null_buffers(), handler);
+   }
+
 protected:
 
    virtual boost::asio::local::stream_protocol::socket& socket()
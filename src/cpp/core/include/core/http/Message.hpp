@@ -22,6 +22,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace boost {
 namespace asio {
@@ -41,13 +42,19 @@ namespace http {
 
 // encodings
 extern const char * const kGzipEncoding;         
+extern const char * const kDeflateEncoding;
    
 class Response;
    
 class Message : boost::noncopyable
 {
 public:
-   Message() : httpVersionMajor_(1), httpVersionMinor_(1) {}
+   Message()
+      : httpVersionMajor_(1),
+        httpVersionMinor_(1),
+        pHeaders_(new HeaderStore())
+   {
+   }
    virtual ~Message() {}
    // COPYING: boost::noncopyable
 
@@ -86,7 +93,7 @@ public:
 
    void removeHeader(const std::string& name) ;
 
-   const Headers& headers() const  { return headers_; }
+   const Headers& headers() const  { return pHeaders_->headers; }
    
    const std::string& body() const { return body_; }
    
@@ -112,7 +119,7 @@ protected:
       body_ = message.body_;
       httpVersionMajor_ = message.httpVersionMajor_;
       httpVersionMinor_ = message.httpVersionMinor_;
-      headers_ = message.headers_;
+      pHeaders_ = message.pHeaders_;
       overrideHeader_ = message.overrideHeader_;
       httpVersion_ = message.httpVersion_;
 
@@ -131,6 +138,15 @@ private:
    {
       setHeader(header);
    }
+
+   // headers for direct modification (by parsers)
+   Headers& mutableHeaders();
+
+   // hash the names of any headers appended via mutableHeaders
+   void indexHeaders();
+
+   // index of the first header with the given name (or npos)
+   std::size_t findHeaderIndex(const std::string& name) const;
    
 private:
 
@@ -140,7 +156,17 @@ private:
 
    int httpVersionMajor_;
    int httpVersionMinor_;
-   std::vector<Header> headers_;
+
+   // headers are shared between copies of a message (see assign) and
+   // copied on write. nameHashes holds the headerNameHash of each header
+   // so that lookups compare integers rather than strings (headers added
+   // directly by a parser aren't hashed until it calls indexHeaders)
+   struct HeaderStore
+   {
+      Headers headers;
+      std::vector<std::size_t> nameHashes;
+   };
+   boost::shared_ptr<HeaderStore> pHeaders_;
    
    // storage for override header (used by toBuffers to override a header
    // when asking for the message bytes)
@@ -0,0 +1,115 @@
+/*
+ * MultipartParser.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_MULTIPART_PARSER_HPP
+#define CORE_HTTP_MULTIPART_PARSER_HPP
+
+#include <cstddef>
+#include <string>
+
+#include <boost/utility.hpp>
+
+#include <core/Error.hpp>
+
+#include <core/http/Header.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+// receives the parts of a multipart body as they are parsed. part data is
+// passed in place (pointing into the buffer given to parse) so it can be
+// written to its destination without being accumulated. returning an error
+// from any of these aborts parsing
+class MultipartHandler
+{
+public:
+   virtual ~MultipartHandler() {}
+
+   virtual Error onPartBegin(const Headers& headers) = 0;
+   virtual Error onPartData(const char* data, std::size_t size) = 0;
+   virtual Error onPartEnd() = 0;
+};
+
+// Incremental parser for multipart (RFC 2046) bodies: the body may be fed
+// in chunks of any size (e.g. as they are read from a connection) and only
+// part headers and a partially matched boundary are ever buffered.
+class MultipartParser : boost::noncopyable
+{
+public:
+   // boundary as given in the content type (without the leading "--")
+   explicit MultipartParser(const std::string& boundary);
+
+   // COPYING: boost::noncopyable
+
+   // extract the boundary parameter from a multipart content type (empty
+   // if there is none)
+   static std::string boundary(const std::string& contentType);
+
+   // parse the next chunk of the body
+   Error parse(const char* data, std::size_t size, MultipartHandler* pHandler);
+
+   // has the closing boundary been seen?
+   bool complete() const { return state_ == Complete; }
+
+private:
+   const char* parseDelimited(const char* begin,
+                              const char* end,
+                              MultipartHandler* pHandler,
+                              Error* pError);
+   const char* parseDelimiterLine(const char* begin,
+                                  const char* end,
+                                  Error* pError);
+   const char* parseHeaders(const char* begin,
+                            const char* end,
+                            MultipartHandler* pHandler,
+                            Error* pError);
+
+   Error onData(const char* data, std::size_t size, MultipartHandler* pHandler);
+
+private:
+   enum State
+   {
+      Preamble,
+      DelimiterLine,
+      PartHeaders,
+      PartBody,
+      Complete
+   };
+
+   // "\r\n--" + boundary (the preamble is parsed as if it were preceded
+   // by a CRLF so the first boundary needn't be special cased)
+   std::string delimiter_;
+   State state_;
+
+   // number of delimiter bytes matched at the end of the previous chunk
+   std::size_t matched_;
+
+   std::string lineBuffer_;
+   std::string headerBuffer_;
+};
+
+// read the name (and filename, for file uploads) from the headers of a
+// multipart/form-data part. returns false if the part isn't form data
+bool formDataPartName(const Headers& headers,
+                      std::string* pName,
+                      std::string* pFilename,
+                      bool* pIsFile);
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_MULTIPART_PARSER_HPP
@@ -17,7 +17,6 @@
 #define CORE_HTTP_MULTIPART_RELATED_HPP
 
 #include <string>
-#include <sstream>
 
 #include <boost/utility.hpp>
 
@@ -38,10 +37,10 @@ public:
    void terminate();
 
    std::string contentType() const ;
-   std::string body() const;
+   const std::string& body() const;
 
 private:
-   std::ostringstream bodyStream_;
+   std::string body_;
 };
 
 } // namespace http
@@ -17,6 +17,8 @@
 #ifndef CORE_HTTP_REQUEST_PARSER_HPP
 #define CORE_HTTP_REQUEST_PARSER_HPP
 
+#include <iterator>
+
 #include <core/http/Request.hpp>
 
 namespace rstudio {
@@ -43,42 +45,75 @@ public:
 
   template <typename InputIterator>
   status parse(Request& req, InputIterator begin, InputIterator end)
+  {
+    // header parsing
+    if (!parsing_body_)
+    {
+       status st = parseHeaders(req, begin, end, &begin);
+       if (st != complete)
+          return st;
+
+       // if we don't have a body then we are done
+       if (content_length_ == 0)
+          return complete;
+
+       // otherwise continue parsing the body
+       parsing_body_ = true;
+    }
+
+    // body parsing
+    return parseBody(req, begin, end);
+  }
+
+  // parse only the request line and headers. once the headers are complete
+  // pNext is set to the first byte of the body and the caller can choose to
+  // either consume the body itself (e.g. to stream it somewhere other than
+  // Request::body) or to continue by calling parseBody
+  template <typename InputIterator>
+  status parseHeaders(Request& req,
+                      InputIterator begin,
+                      InputIterator end,
+                      InputIterator* pNext)
   {
     while (begin != end)
     {
-       // header parsing
-      if (!parsing_body_)
-      {
-         status st = consume(req, *begin++);
-         if ( st == error )
-         {
-            return st ;
-         }
-         else if ( st == complete  )
-         {
-            // if we have a body then continue parsing it
-            if (content_length_ > 0)
-            {
-               parsing_body_ = true ;
-               continue ;
-            }
-            else
-            {
-               return st ;
-            }
-         }
-      }
-      // body parsing
-      else
-      {
-         req.body_.push_back(*begin++) ;
-         if (req.body_.size() == content_length_)
-            return complete ;
-      }
+       status st = consume(req, *begin++);
+       if (st != incomplete)
+       {
+          if (st == complete)
+             req.indexHeaders();
+
+          *pNext = begin;
+          return st;
+       }
+    }
+
+    *pNext = end;
+    return incomplete;
+  }
+
+  // append body bytes to the request (up to the content length)
+  template <typename InputIterator>
+  status parseBody(Request& req, InputIterator begin, InputIterator end)
+  {
+    std::size_t remaining = content_length_ - req.body_.size();
+    std::size_t available = std::distance(begin, end);
+    if (available >= remaining)
+    {
+       std::advance(end, -static_cast<std::ptrdiff_t>(available - remaining));
+       req.body_.append(begin, end);
+       return complete;
+    }
+    else
+    {
+       req.body_.append(begin, end);
+       return incomplete;
     }
-    return incomplete ;
   }
 
+  // content length declared by the request (valid once headers are parsed)
+  std::size_t contentLength() const { return content_length_; }
+
 private:
   /// Handle the next character of input.
   status consume(Request& req, char input);
@@ -81,6 +81,9 @@ public:
    }   
 };     
    
+// files at least this large are served via setFileBody
+const uintmax_t kFileBodyThreshold = 256 * 1024;
+
 class Response : public Message
 {
 public:
@@ -96,6 +99,7 @@ public:
       statusCode_ = response.statusCode_;
       statusCodeStr_ = response.statusCodeStr_;
       statusMessage_ = response.statusMessage_;
+      fileBody_ = response.fileBody_;
    }
 
 public:   
@@ -200,6 +204,7 @@ public:
          
          // set body 
          body_ = bodyStream.str();
+         fileBody_ = FilePath();
          setContentLength(body_.length());
          
          // return success
@@ -268,10 +273,30 @@ public:
       
       // set content type
       setContentType(filePath.mimeContentType());
+
+      // large unfiltered files are written from disk by the connection
+      // rather than being read into memory here
+      if (boost::is_same<Filter, NullOutputFilter>::value &&
+          filePath.size() >= kFileBodyThreshold)
+      {
+         setFileBody(filePath, request);
+         return;
+      }
       
-      // gzip if possible
+      // gzip if possible (unfiltered files are served from a cache of
+      // compressed file contents)
       if (request.acceptsEncoding(kGzipEncoding))
+      {
+         if (boost::is_same<Filter, NullOutputFilter>::value)
+         {
+            Error error = setCompressedFileBody(filePath, kGzipEncoding);
+            if (error)
+               setError(status::InternalServerError, error.code().message());
+            return;
+         }
+
          setContentEncoding(kGzipEncoding);
+      }
       
       // set body from file
       Error error = setBody(filePath, filter);
@@ -320,6 +345,12 @@ public:
                          const std::string& mimeType,
                          const Request& request);
 
+   // file-backed body: the connection writes the file directly from disk
+   // (using sendfile where possible) when the response is sent
+   void setFileBody(const FilePath& filePath, const Request& request);
+   bool hasFileBody() const { return !fileBody_.empty(); }
+   const FilePath& fileBody() const { return fileBody_; }
+
    // these calls do no stream io or encoding so don't return errors
    void setBodyUnencoded(const std::string& body);
    void setError(int statusCode, const std::string& message);
@@ -337,6 +368,8 @@ private:
    virtual void resetMembers();
       
 private:
+   Error setCompressedFileBody(const FilePath& filePath,
+                               const std::string& encoding);
    void ensureStatusMessage() const ;
    void removeCachingHeaders();
    void setCacheForeverHeaders(bool publicAccessiblity);
@@ -353,6 +386,9 @@ private:
 
    // string storage for integer members (need for toBuffers)
    mutable std::string statusCodeStr_ ;
+
+   // file to write as the body (empty if the body is in body_)
+   FilePath fileBody_;
 };
 
 std::ostream& operator << (std::ostream& stream, const Response& r) ;
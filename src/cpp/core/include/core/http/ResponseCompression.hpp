@@ -0,0 +1,74 @@
+/*
+ * ResponseCompression.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_RESPONSE_COMPRESSION_HPP
+#define CORE_HTTP_RESPONSE_COMPRESSION_HPP
+
+#include <string>
+#include <vector>
+
+#include <core/Error.hpp>
+
+namespace rstudio {
+namespace core {
+
+class FilePath;
+
+namespace http {
+
+class Request;
+class Response;
+
+// options controlling transparent compression of responses
+struct CompressionOptions
+{
+   CompressionOptions();
+
+   // bodies smaller than this aren't worth compressing
+   std::size_t minimumSize;
+
+   // content types eligible for compression (an entry ending in '/'
+   // matches all subtypes, e.g. "text/")
+   std::vector<std::string> contentTypes;
+};
+
+// choose the best encoding we support from the request's Accept-Encoding
+// header (returns an empty string if the body should not be encoded)
+std::string negotiateEncoding(const Request& request);
+
+// compress a string using the given encoding (gzip or deflate)
+Error compress(const std::string& input,
+               const std::string& encoding,
+               std::string* pOutput);
+
+// compress the response body in place if the request accepts a supported
+// encoding and the response is eligible under the options (it isn't
+// already encoded, is large enough, and has a compressible content type)
+void compressResponse(const Request& request,
+                      const CompressionOptions& options,
+                      Response* pResponse);
+
+// read the contents of a file compressed with the given encoding. results
+// are held in a small LRU cache keyed by path and modification time so
+// repeated requests for static resources don't recompress them
+Error readCompressedFile(const FilePath& filePath,
+                         const std::string& encoding,
+                         std::string* pContents);
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_RESPONSE_COMPRESSION_HPP
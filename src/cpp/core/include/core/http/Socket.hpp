@@ -42,6 +42,14 @@ public:
                      Handler Handler) = 0;
 
    virtual void close() = 0;
+
+   // optional readiness-based access to the underlying descriptor (used by
+   // SocketProxy to splice data between sockets without copying it through
+   // user space). sockets which can't expose a plain descriptor (e.g. ssl
+   // streams) return -1 and will never be asked to wait for readiness
+   virtual int nativeHandle() { return -1; }
+   virtual void asyncWaitReadable(Handler handler) {}
+   virtual void asyncWaitWritable(Handler handler) {}
 };
 
 } // namespace http
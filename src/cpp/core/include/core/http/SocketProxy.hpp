@@ -19,8 +19,11 @@
 #include <string>
 
 #include <boost/array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/Thread.hpp>
 #include <core/Error.hpp>
@@ -33,25 +36,87 @@ namespace http {
 class SocketProxy : public boost::enable_shared_from_this<SocketProxy>
 {
 public:
+   // traffic relayed by the proxy in one direction
+   struct DirectionStats
+   {
+      DirectionStats() : reads(0), bytes(0), maxQueuedBytes(0), stalls(0) {}
+
+      // reads from the source (each forwarded as-is to the destination)
+      boost::uint64_t reads;
+      boost::uint64_t bytes;
+
+      // most bytes read from the source and not yet accepted by the
+      // destination at any one time
+      std::size_t maxQueuedBytes;
+
+      // times the destination couldn't accept data without waiting (only
+      // observable when splicing)
+      boost::uint64_t stalls;
+   };
+
+   struct Stats
+   {
+      DirectionStats fromClient;
+      DirectionStats fromServer;
+      boost::posix_time::time_duration duration;
+   };
+
+   // called once the proxy has closed (and all its operations completed)
+   typedef boost::function<void(const Stats&)> StatsHandler;
+
+   // create a proxy which forwards traffic between the client and server
+   // sockets. if zeroCopy is requested and both sockets expose a plain
+   // descriptor then data is moved using splice (linux only), otherwise
+   // it's copied through user-space buffers. tcp sockets have nagle's
+   // algorithm disabled so small messages are relayed without delay
    static void create(boost::shared_ptr<core::http::Socket> ptrClient,
-                      boost::shared_ptr<core::http::Socket> ptrServer)
+                      boost::shared_ptr<core::http::Socket> ptrServer,
+                      bool zeroCopy = false,
+                      const StatsHandler& statsHandler = StatsHandler())
    {
       boost::shared_ptr<SocketProxy> pProxy(new SocketProxy(ptrClient,
-                                                            ptrServer));
-      pProxy->readClient();
-      pProxy->readServer();
+                                                            ptrServer,
+                                                            statsHandler));
+      pProxy->setNoDelay();
+      if (zeroCopy && pProxy->initSplice())
+      {
+         pProxy->waitReadable(true);
+         pProxy->waitReadable(false);
+      }
+      else
+      {
+         pProxy->readClient();
+         pProxy->readServer();
+      }
    }
 
+   virtual ~SocketProxy();
+
 private:
    SocketProxy(boost::shared_ptr<core::http::Socket> ptrClient,
-               boost::shared_ptr<core::http::Socket> ptrServer)
-      : ptrClient_(ptrClient), ptrServer_(ptrServer)
+               boost::shared_ptr<core::http::Socket> ptrServer,
+               const StatsHandler& statsHandler)
+      : ptrClient_(ptrClient), ptrServer_(ptrServer),
+        statsHandler_(statsHandler),
+        startTime_(boost::posix_time::microsec_clock::universal_time())
    {
    }
 
+   void setNoDelay();
+   void recordRead(bool fromClient, std::size_t bytes);
+
    void readClient();
    void readServer();
 
+   // splice based forwarding (data flows from the source socket into a
+   // pipe and from the pipe into the destination socket)
+   bool initSplice();
+   void waitReadable(bool fromClient);
+   void handleReadable(bool fromClient, const boost::system::error_code& e);
+   void handleWritable(bool fromClient, const boost::system::error_code& e);
+   void spliceToPipe(bool fromClient);
+   void spliceFromPipe(bool fromClient);
+
    void handleClientRead(const boost::system::error_code& e,
                          std::size_t bytesTransferred);
    void handleServerRead(const boost::system::error_code& e,
@@ -70,6 +135,21 @@ private:
    boost::shared_ptr<core::http::Socket> ptrServer_;
    boost::array<char, 8192> clientBuffer_;
    boost::array<char, 8192> serverBuffer_;
+
+   struct SplicePipe
+   {
+      SplicePipe() : readFd(-1), writeFd(-1), pending(0) {}
+      int readFd;
+      int writeFd;
+      std::size_t pending;
+   };
+   SplicePipe clientPipe_;
+   SplicePipe serverPipe_;
+
+   StatsHandler statsHandler_;
+   Stats stats_;
+   boost::posix_time::ptime startTime_;
+
    boost::mutex socketMutex_;
 };
 
@@ -0,0 +1,108 @@
+/*
+ * SpooledRequestBody.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_SPOOLED_REQUEST_BODY_HPP
+#define CORE_HTTP_SPOOLED_REQUEST_BODY_HPP
+
+#include <string>
+#include <iosfwd>
+
+#include <boost/utility.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+
+#include <core/http/AsyncUriHandler.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+// AsyncRequestBodyHandler which holds the request body in memory up to
+// a maximum size and spills it to a temporary file beyond that. this keeps
+// memory usage bounded for large uploads. the spool file (if any) is
+// removed when the SpooledRequestBody is destroyed.
+class SpooledRequestBody
+   : public AsyncRequestBodyHandler,
+     public boost::enable_shared_from_this<SpooledRequestBody>,
+     boost::noncopyable
+{
+public:
+   typedef boost::function<void(boost::shared_ptr<AsyncConnection>,
+                                boost::shared_ptr<SpooledRequestBody>)>
+                                                         CompletionHandler;
+
+   // spoolDir defaults to the system temporary directory
+   SpooledRequestBody(std::size_t maxInMemory,
+                      const CompletionHandler& onCompleted,
+                      const FilePath& spoolDir = FilePath())
+      : maxInMemory_(maxInMemory),
+        onCompleted_(onCompleted),
+        spoolDir_(spoolDir),
+        size_(0)
+   {
+   }
+
+   virtual ~SpooledRequestBody();
+
+   // COPYING: boost::noncopyable
+
+   // AsyncRequestBodyHandler
+   virtual Error onBodyChunk(const char* data, std::size_t size);
+   virtual void onBodyComplete(boost::shared_ptr<AsyncConnection> pConnection);
+
+   // total size of the body
+   std::size_t size() const { return size_; }
+
+   // was the body spilled to disk? if so it is found in spoolFile,
+   // otherwise it is found in inMemoryBody
+   bool isSpooled() const { return !spoolFile_.empty(); }
+   const std::string& inMemoryBody() const { return inMemoryBody_; }
+   const FilePath& spoolFile() const { return spoolFile_; }
+
+   // read the entire body (regardless of where it's stored)
+   Error readBody(std::string* pBody) const;
+
+   // write the body to the target path (moves the spool file if possible)
+   Error moveTo(const FilePath& targetPath);
+
+private:
+   Error spill();
+
+private:
+   std::size_t maxInMemory_;
+   CompletionHandler onCompleted_;
+   FilePath spoolDir_;
+   std::size_t size_;
+   std::string inMemoryBody_;
+   FilePath spoolFile_;
+   boost::shared_ptr<std::ostream> pSpoolStream_;
+};
+
+// create a streaming uri handler which spools each request body and then
+// calls onCompleted once the entire body has been received
+AsyncStreamingUriHandlerFunction spooledBodyHandler(
+               std::size_t maxInMemory,
+               const SpooledRequestBody::CompletionHandler& onCompleted,
+               const FilePath& spoolDir = FilePath());
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_SPOOLED_REQUEST_BODY_HPP
@@ -45,6 +45,25 @@ public:
    {
    }
 
+   // expose the plain socket descriptor so the connection can participate
+   // in zero-copy forwarding once it has been upgraded (see SocketProxy)
+#ifndef _WIN32
+   virtual int nativeHandle()
+   {
+      return socket_.native_handle();
+   }
+
+   virtual void asyncWaitReadable(Handler handler)
+   {
+      socket_.async_read_some(boost::asio::null_buffers(), handler);
+   }
+
+   virtual void asyncWaitWritable(Handler handler)
+   {
+      socket_.async_write_some(boost::asio::null_buffers(), handler);
+   }
+#endif
+
 protected:
 
    virtual boost::asio::ip::tcp::socket& socket()
@@ -20,12 +20,18 @@
 #error TcpIpAsyncClientSsl is not supported on Windows
 #endif
 
+#include <map>
+#include <string>
+
 #include <boost/scoped_ptr.hpp>
+#include <boost/utility.hpp>
 
 #include <boost/asio/ip/tcp.hpp>
 
 #include "BoostAsioSsl.hpp"
 
+#include <core/Thread.hpp>
+
 #include <core/http/AsyncClient.hpp>
 #include <core/http/TcpIpAsyncConnector.hpp>
 
@@ -33,6 +39,102 @@ namespace rstudio {
 namespace core {
 namespace http {  
 
+// ssl client state shared by all connections: the contexts (configuring
+// one reads the system's certificate store) and the most recent session
+// established with each server, so that subsequent connections resume it
+// rather than performing a full handshake
+class SslClientCache : boost::noncopyable
+{
+public:
+   static SslClientCache& instance()
+   {
+      // never freed (connections may outlive static destruction)
+      static SslClientCache* pInstance = new SslClientCache();
+      return *pInstance;
+   }
+
+   boost::asio::ssl::context& context(bool verify)
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+
+      boost::scoped_ptr<boost::asio::ssl::context>& pContext =
+                              verify ? pVerifyContext_ : pNoVerifyContext_;
+      if (!pContext)
+      {
+         pContext.reset(new boost::asio::ssl::context(
+                                 boost::asio::ssl::context::sslv23_client));
+         if (verify)
+         {
+            pContext->set_default_verify_paths();
+            pContext->set_verify_mode(boost::asio::ssl::context::verify_peer);
+         }
+         else
+         {
+            pContext->set_verify_mode(boost::asio::ssl::context::verify_none);
+         }
+
+         // keep the sessions ourselves (by server), recording them as
+         // they're established (tls 1.3 servers send them after the
+         // handshake)
+         SSL_CTX* pCtx = pContext->native_handle();
+         ::SSL_CTX_set_session_cache_mode(
+                  pCtx,
+                  SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+         ::SSL_CTX_sess_set_new_cb(pCtx, &SslClientCache::onNewSession);
+      }
+      return *pContext;
+   }
+
+   // set up the connection to resume the server's session (if we have
+   // one) and record new sessions under the given key
+   void prepare(SSL* pSsl, const std::string* pKey)
+   {
+      ::SSL_set_ex_data(pSsl, keyIndex_, const_cast<std::string*>(pKey));
+
+      LOCK_MUTEX(mutex_)
+      {
+         std::map<std::string, SSL_SESSION*>::const_iterator it =
+                                                      sessions_.find(*pKey);
+         if (it != sessions_.end())
+            ::SSL_set_session(pSsl, it->second);
+      }
+      END_LOCK_MUTEX
+   }
+
+private:
+   SslClientCache()
+      : keyIndex_(::SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL))
+   {
+   }
+
+   static int onNewSession(SSL* pSsl, SSL_SESSION* pSession)
+   {
+      SslClientCache& cache = instance();
+      std::string* pKey =
+            static_cast<std::string*>(::SSL_get_ex_data(pSsl, cache.keyIndex_));
+      if (pKey == NULL)
+         return 0;
+
+      LOCK_MUTEX(cache.mutex_)
+      {
+         SSL_SESSION*& pCached = cache.sessions_[*pKey];
+         if (pCached != NULL)
+            ::SSL_SESSION_free(pCached);
+         pCached = pSession;
+      }
+      END_LOCK_MUTEX
+
+      // we've taken ownership of the session
+      return 1;
+   }
+
+   boost::mutex mutex_;
+   int keyIndex_;
+   boost::scoped_ptr<boost::asio::ssl::context> pVerifyContext_;
+   boost::scoped_ptr<boost::asio::ssl::context> pNoVerifyContext_;
+   std::map<std::string, SSL_SESSION*> sessions_;
+};
+
 class TcpIpAsyncClientSsl
    : public AsyncClient<boost::asio::ssl::stream<boost::asio::ip::tcp::socket> >
 {
@@ -42,24 +144,14 @@ public:
                        const std::string& port,
                        bool verify)
      : AsyncClient<boost::asio::ssl::stream<boost::asio::ip::tcp::socket> >(ioService),
-       sslContext_(ioService, boost::asio::ssl::context::sslv23_client),
        address_(address),
        port_(port),
-       verify_(verify)
+       verify_(verify),
+       sessionKey_(address + ":" + port + (verify ? "" : ":noverify"))
    {
-      if (verify_)
-      {
-         sslContext_.set_default_verify_paths();
-         sslContext_.set_verify_mode(boost::asio::ssl::context::verify_peer);
-      }
-      else
-      {
-         sslContext_.set_verify_mode(boost::asio::ssl::context::verify_none);
-      }
-
-      // use scoped ptr so we can call the constructor after we've configured
-      // the ssl::context (immediately above)
-      ptrSslStream_.reset(new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(ioService, sslContext_));
+      // use the shared (already configured) context
+      ptrSslStream_.reset(new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(
+                             ioService, SslClientCache::instance().context(verify_)));
    }
 
 
@@ -96,6 +188,11 @@ private:
          ptrSslStream_->set_verify_callback(
                             boost::asio::ssl::rfc2818_verification(address_));
       }
+
+      // resume our previous session with the server (if any)
+      SslClientCache::instance().prepare(ptrSslStream_->native_handle(),
+                                         &sessionKey_);
+
       ptrSslStream_->async_handshake(
             boost::asio::ssl::stream_base::client,
             boost::bind(&TcpIpAsyncClientSsl::handleHandshake,
@@ -143,11 +240,11 @@ private:
    }
 
 private:
-   boost::asio::ssl::context sslContext_;
    boost::scoped_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket> > ptrSslStream_;
    std::string address_;
    std::string port_;
    bool verify_;
+   std::string sessionKey_;
 };
    
 
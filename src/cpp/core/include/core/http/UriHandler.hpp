@@ -22,6 +22,7 @@
 #include <boost/function.hpp>
 
 #include <core/http/Response.hpp>
+#include <core/http/UriPrefixTrie.hpp>
 
 namespace rstudio {
 namespace core {
@@ -51,6 +52,8 @@ public:
    // COPYING: via compiler
    
    bool matches(const std::string& uri) const;
+
+   const std::string& prefix() const { return prefix_; }
    
    UriAsyncHandlerFunction function() const;
   
@@ -76,6 +79,7 @@ public:
    
 private:
    std::vector<UriHandler> uriHandlers_;
+   UriPrefixTrie prefixes_;
 };
 
 inline void notFoundHandler(const Request& request, Response* pResponse)
@@ -0,0 +1,76 @@
+/*
+ * UriPrefixTrie.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_URI_PREFIX_TRIE_HPP
+#define CORE_HTTP_URI_PREFIX_TRIE_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+// index of uri prefixes used to dispatch requests to handlers. lookup
+// returns the earliest added prefix which matches the uri (the same
+// result as a linear scan in registration order) in time proportional to
+// the length of the uri rather than the number of prefixes
+class UriPrefixTrie
+{
+public:
+   UriPrefixTrie();
+
+   // COPYING: via compiler
+
+   // add a prefix (values are expected to be added in increasing order,
+   // e.g. as the position of the handler in a vector)
+   void add(const std::string& prefix, std::size_t value);
+
+   // find the value for the first added prefix which matches the uri
+   bool find(const std::string& uri, std::size_t* pValue) const;
+
+   bool empty() const { return exactMatches_.empty(); }
+
+private:
+   static const std::size_t kNone;
+
+   struct Node
+   {
+      Node() : value(kNone) {}
+
+      // value of the earliest added prefix ending at or above this node
+      std::size_t value;
+
+      // children (sorted by character) as indexes into nodes_
+      std::vector<std::pair<char, std::size_t> > children;
+   };
+
+   std::size_t child(std::size_t node, char ch) const;
+   void propagate(std::size_t node, std::size_t value);
+
+private:
+   std::vector<Node> nodes_;
+
+   // uri exactly equal to a prefix (fast path lookup)
+   boost::unordered_map<std::string, std::size_t> exactMatches_;
+};
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_URI_PREFIX_TRIE_HPP
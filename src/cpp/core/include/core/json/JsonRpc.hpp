@@ -79,6 +79,7 @@ struct is_error_code_enum<rstudio::core::json::errc::errc_t>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
 #include <core/Error.hpp>
@@ -157,6 +158,11 @@ struct JsonRpcRequest
 //
 Error parseJsonRpcRequest(const std::string& input, JsonRpcRequest* pRequest) ;
 
+// parse a request which has already been parsed into a json object (e.g. an
+// element of a batched request)
+Error parseJsonRpcRequest(const json::Object& requestObject,
+                          JsonRpcRequest* pRequest);
+
 bool parseJsonRpcRequestForMethod(const std::string& input, 
                                   const std::string& method,
                                   JsonRpcRequest* pRequest,
@@ -1019,10 +1025,12 @@ public:
       setField(kRpcResult, result);
    }
 
-   json::Value& result()
-   {
-      return response_[kRpcResult];
-   }
+   json::Value& result();
+
+   // set the result from json text which has already been serialized
+   // (e.g. by a json::Writer) -- this avoids building a json::Value tree
+   // for large results
+   void setRawResult(const std::string& resultJson);
    
    void setError(const core::Error& error);
 
@@ -1035,6 +1043,8 @@ public:
 
    void setField(const std::string& name, const json::Value& value) 
    { 
+      if (name == kRpcResult)
+         pRawResult_.reset();
       response_[name] = value;
    }             
                 
@@ -1047,6 +1057,7 @@ public:
    // low level hook to set the full response
    void setResponse(const json::Object& response)
    {
+      pRawResult_.reset();
       response_ = response;
    }
    
@@ -1064,9 +1075,13 @@ public:
    json::Object getRawResponse();
    
    void write(std::ostream& os) const;
+
+   // append the serialized response to a string
+   void write(std::string* pOutput) const;
    
 private:
    json::Object response_;
+   boost::shared_ptr<const std::string> pRawResult_;
    boost::function<void()> afterResponse_ ;
    bool suppressDetectChanges_;
 };
@@ -0,0 +1,122 @@
+/*
+ * JsonWriter.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_JSON_WRITER_HPP
+#define CORE_JSON_WRITER_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/cstdint.hpp>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+// streaming json writer which emits json text directly into a buffer rather
+// than building an intermediate json::Value tree. output is formatted in the
+// same way as json::write (with the exception that non-finite reals are
+// written as null). usage:
+//
+//    json::Writer writer;
+//    writer.startObject();
+//    writer.member("name", name);
+//    writer.key("values");
+//    writer.startArray();
+//    for (...)
+//       writer.value(values[i]);
+//    writer.endArray();
+//    writer.endObject();
+//    pResponse->setRawResult(writer.str());
+//
+class Writer : boost::noncopyable
+{
+public:
+   // write into an internal buffer
+   Writer();
+
+   // append to an external buffer
+   explicit Writer(std::string* pOutput);
+
+   // COPYING: boost::noncopyable
+
+public:
+   void startObject();
+   void endObject();
+
+   void startArray();
+   void endArray();
+
+   // name of the next object member (must be followed by a value)
+   void key(const std::string& name);
+
+   void value(const std::string& value);
+   void value(const char* value);
+   void value(bool value);
+   void value(int value);
+   void value(unsigned int value);
+   void value(long value);
+   void value(unsigned long value);
+   void value(boost::long_long_type value);
+   void value(boost::ulong_long_type value);
+   void value(double value);
+   void value(const json::Value& value);
+   void nullValue();
+
+   // value which has already been serialized as json text
+   void rawValue(const std::string& json);
+
+   template <typename T>
+   void member(const std::string& name, const T& value)
+   {
+      key(name);
+      this->value(value);
+   }
+
+   template <typename T>
+   void array(const std::vector<T>& values)
+   {
+      startArray();
+      for (typename std::vector<T>::const_iterator it = values.begin();
+           it != values.end();
+           ++it)
+      {
+         value(*it);
+      }
+      endArray();
+   }
+
+   // the json text written so far
+   const std::string& str() const { return *pOutput_; }
+
+private:
+   void beginValue();
+   void writeString(const char* value, std::size_t length);
+
+private:
+   std::string buffer_;
+   std::string* pOutput_;
+   std::vector<bool> levels_;
+   bool expectingValue_;
+};
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_JSON_WRITER_HPP
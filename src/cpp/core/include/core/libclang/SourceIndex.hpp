@@ -62,6 +62,15 @@ public:
 
    int verbose() const { return verbose_; }
 
+   // memory budget for translation units (in bytes, 0 for no limit). when
+   // it's exceeded the least recently used translation units are removed
+   // (except for those primed for editing, which are kept until removed)
+   std::size_t memoryLimit() const { return memoryLimit_; }
+   void setMemoryLimit(std::size_t bytes);
+
+   // bytes used by the translation units (as reported by libclang)
+   std::size_t memoryUsage() const { return memoryUsage_; }
+
    // functions used to keep the index "hot" based on recent user edits
    void primeEditorTranslationUnit(const std::string& filename);
    void reprimeEditorTranslationUnit(const std::string& filename);
@@ -88,20 +97,38 @@ private:
 
    struct StoredTranslationUnit
    {
-      StoredTranslationUnit() : lastWriteTime(0), tu(NULL) {}
+      StoredTranslationUnit()
+         : lastWriteTime(0), tu(NULL), memoryUsage(0), lastUsed(0),
+           pinned(false)
+      {
+      }
       StoredTranslationUnit(const std::vector<std::string>& compileArgs,
                             std::time_t lastWriteTime,
                             CXTranslationUnit tu)
-         : compileArgs(compileArgs), lastWriteTime(lastWriteTime), tu(tu)
+         : compileArgs(compileArgs), lastWriteTime(lastWriteTime), tu(tu),
+           memoryUsage(0), lastUsed(0), pinned(false)
       {
       }
       std::vector<std::string> compileArgs;
       std::time_t lastWriteTime;
       CXTranslationUnit tu;
+      std::size_t memoryUsage;
+      unsigned long lastUsed;
+      bool pinned;
    };
    typedef std::map<std::string,StoredTranslationUnit> TranslationUnits;
    TranslationUnits translationUnits_;
 
+   // update the memory usage of a (re-)parsed translation unit and then
+   // evict others as required to stay within the memory limit
+   void updateMemoryUsage(StoredTranslationUnit* pStored);
+   void enforceMemoryLimit(const std::string& excludeFilename);
+   void pinTranslationUnit(const std::string& filename);
+
+   std::size_t memoryLimit_;
+   std::size_t memoryUsage_;
+   unsigned long useCounter_;
+
    CompilationDatabase compilationDB_;
 
    int verbose_;
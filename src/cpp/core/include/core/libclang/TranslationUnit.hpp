@@ -16,6 +16,7 @@
 #ifndef CORE_LIBCLANG_TRANSLATION_UNIT_HPP
 #define CORE_LIBCLANG_TRANSLATION_UNIT_HPP
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 
@@ -82,6 +83,9 @@ public:
                                       unsigned line,
                                       unsigned column) const;
 
+   // total memory used by the translation unit (in bytes)
+   std::size_t memoryUsage() const;
+
    void printResourceUsage(std::ostream& ostr, bool detailed = false) const;
 
 private:
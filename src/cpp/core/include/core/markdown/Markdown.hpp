@@ -101,6 +101,14 @@ Error markdownToHTML(const std::string& markdownInput,
                      const HTMLOptions& htmlOptions,
                      std::string* pHTMLOutput);
 
+// render markdown to HTML and determine whether the result requires
+// mathjax (without a separate search of the output)
+Error markdownToHTML(const std::string& markdownInput,
+                     const Extensions& extensions,
+                     const HTMLOptions& htmlOptions,
+                     std::string* pHTMLOutput,
+                     bool* pRequiresMathJax);
+
 
 bool isMathJaxRequired(const std::string& htmlOutput);
 
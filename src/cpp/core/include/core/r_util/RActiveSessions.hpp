@@ -17,6 +17,8 @@
 #ifndef CORE_R_UTIL_ACTIVE_SESSIONS_HPP
 #define CORE_R_UTIL_ACTIVE_SESSIONS_HPP
 
+#include <map>
+
 #include <boost/noncopyable.hpp>
 
 #include <core/Error.hpp>
@@ -37,9 +39,9 @@ class ActiveSession : boost::noncopyable
 {
 private:
    friend class ActiveSessions;
-   ActiveSession() {}
+   ActiveSession() : propertiesLoaded_(false) {}
    explicit ActiveSession(const std::string& id, const FilePath& scratchPath)
-      : id_(id), scratchPath_(scratchPath)
+      : id_(id), scratchPath_(scratchPath), propertiesLoaded_(false)
    {
       core::Error error = scratchPath_.ensureDirectory();
       if (error)
@@ -273,10 +275,16 @@ private:
    void writeProperty(const std::string& name, const std::string& value) const;
    std::string readProperty(const std::string& name) const;
 
+   // read all of the properties at once (from the property index) and
+   // serve subsequent reads from memory
+   void loadProperties() const;
+
 private:
    std::string id_;
    FilePath scratchPath_;
    FilePath propertiesPath_;
+   mutable bool propertiesLoaded_;
+   mutable std::map<std::string, std::string> properties_;
 };
 
 
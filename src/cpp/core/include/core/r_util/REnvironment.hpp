@@ -39,6 +39,34 @@ bool detectREnvironment(const FilePath& whichRScript,
                         EnvironmentVars* pVars,
                         std::string* pErrMsg);
 
+// detectREnvironment runs R (and the ld paths script) to discover the
+// environment, which takes long enough to be noticeable at startup. this
+// variant serves the results from cacheFile when they're still valid:
+// entries are keyed by the arguments and are invalidated when the R script
+// (or the R on the path, absent an override), the ld paths script, or R's
+// etc/ldpaths change. changes outside of those files are only picked up by
+// refreshREnvironmentCache, which long running callers that used the
+// cache (pFromCache) can call in the background
+bool detectREnvironmentCached(const FilePath& cacheFile,
+                              const FilePath& whichRScript,
+                              const FilePath& ldPathsScript,
+                              const std::string& ldLibraryPath,
+                              std::string* pRScriptPath,
+                              std::string* pVersion,
+                              EnvironmentVars* pVars,
+                              std::string* pErrMsg,
+                              bool* pFromCache = NULL);
+
+// detect the R environment without consulting the cache, then update it
+bool refreshREnvironmentCache(const FilePath& cacheFile,
+                              const FilePath& whichRScript,
+                              const FilePath& ldPathsScript,
+                              const std::string& ldLibraryPath,
+                              std::string* pRScriptPath,
+                              std::string* pVersion,
+                              EnvironmentVars* pVars,
+                              std::string* pErrMsg);
+
 void setREnvironmentVars(const EnvironmentVars& vars);
 void setREnvironmentVars(const EnvironmentVars& vars,
                          core::system::Options* pEnv);
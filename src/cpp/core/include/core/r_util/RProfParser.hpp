@@ -0,0 +1,107 @@
+/*
+ * RProfParser.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_R_UTIL_R_PROF_PARSER_HPP
+#define CORE_R_UTIL_R_PROF_PARSER_HPP
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+namespace r_util {
+
+// a line of a profiled source file (file is an index into files())
+typedef std::pair<int, int> RProfLine;
+
+// node of the call tree (the root has an empty name and its children are
+// the outermost calls). total counts the samples in which the call was on
+// the stack and self those in which it was the innermost call
+struct RProfNode
+{
+   RProfNode() : total(0), self(0) {}
+
+   std::string name;
+   std::size_t total;
+   std::size_t self;
+
+   // samples by the line executing within the call (when the profile
+   // includes line profiling and the function has srcrefs)
+   std::map<RProfLine, std::size_t> lines;
+
+   std::map<std::string, boost::shared_ptr<RProfNode> > children;
+};
+
+// incremental parser of Rprof output: feed it the file in chunks of any
+// size (e.g. as it's being written) and the samples read so far are
+// aggregated into a call tree and per line totals
+class RProfParser : boost::noncopyable
+{
+public:
+   RProfParser();
+
+   // parse the next chunk of the file (a trailing partial line is kept
+   // until the rest of it arrives)
+   void parse(const char* begin, const char* end);
+   void parse(const std::string& chunk)
+   {
+      parse(chunk.data(), chunk.data() + chunk.size());
+   }
+
+   // sample interval in microseconds (as given by the header)
+   int intervalMicros() const { return intervalMicros_; }
+   bool lineProfiling() const { return lineProfiling_; }
+   std::size_t sampleCount() const { return root_.total; }
+
+   // files referred to by line attributions (from the #File lines)
+   const std::vector<std::string>& files() const { return files_; }
+
+   const RProfNode& root() const { return root_; }
+
+   // samples by line (counting each line once per sample)
+   const std::map<RProfLine, std::size_t>& lineSamples() const
+   {
+      return lineSamples_;
+   }
+
+   // the profile as json: the tree omits calls in fewer than minFraction
+   // of the samples (whose samples still count towards their parent's
+   // total) so that long profiles of deep code remain a manageable size
+   json::Object toJson(double minFraction = 0.001) const;
+
+private:
+   void parseLine(const std::string& line);
+   void parseSample(const std::string& line);
+
+   std::string partialLine_;
+   int intervalMicros_;
+   bool lineProfiling_;
+   std::vector<std::string> files_;
+   RProfNode root_;
+   std::map<RProfLine, std::size_t> lineSamples_;
+};
+
+} // namespace r_util
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_R_UTIL_R_PROF_PARSER_HPP
@@ -193,8 +193,19 @@ public:
    //   - Must be UTF-8 encoded
    //   - Must use \n only for linebreaks
    //
+   // Indexes which are built on a background thread should pass false
+   // for publishInferredPackages, and then call publishInferredPackages()
+   // on the main thread (the set of all inferred packages isn't
+   // thread-safe)
    RSourceIndex(const std::string& context,
-                const std::string& code);
+                const std::string& code,
+                bool publishInferredPackages = true);
+
+   // Create an index from previously indexed items (e.g. those which were
+   // saved in a cache)
+   RSourceIndex(const std::string& context,
+                const std::vector<RSourceItem>& items,
+                const std::vector<std::string>& inferredPackages);
 
    const std::string& context() const { return context_; }
 
@@ -249,12 +260,14 @@ public:
       }
       else
       {
-         if (prefixOnly)
-            predicate = boost::bind(&RSourceItem::nameStartsWith,
-                                       _1, term, caseSensitive);
-         else
-            predicate = boost::bind(&RSourceItem::nameIsSubsequence,
-                                       _1, term, caseSensitive);
+         // scan the packed names, materializing only the matching items
+         std::vector<std::size_t> matches;
+         searchNames(term, prefixOnly, caseSensitive, &matches);
+         BOOST_FOREACH(std::size_t i, matches)
+         {
+            *out++ = items_[i].withContext(newContext);
+         }
+         return out;
       }
 
       return search(newContext, predicate, out);
@@ -291,7 +304,7 @@ public:
       return s_allInferredPkgNames_;
    }
 
-   const std::vector<std::string>& getInferredPackages()
+   const std::vector<std::string>& getInferredPackages() const
    {
       return inferredPkgNames_;
    }
@@ -370,7 +383,15 @@ public:
    void addInferredPackage(const std::string& packageName)
    {
       inferredPkgNames_.push_back(packageName);
-      s_allInferredPkgNames_.insert(packageName);
+      if (publishInferredPackages_)
+         s_allInferredPkgNames_.insert(packageName);
+   }
+
+   void publishInferredPackages()
+   {
+      s_allInferredPkgNames_.insert(inferredPkgNames_.begin(),
+                                    inferredPkgNames_.end());
+      publishInferredPackages_ = true;
    }
    
    static void addGloballyInferredPackage(const std::string& pkgName)
@@ -409,6 +430,7 @@ public:
    void addSourceItem(const RSourceItem& item)
    {
       items_.push_back(item);
+      addName(item.name());
    }
    
    const std::vector<RSourceItem>& items() const
@@ -416,15 +438,31 @@ public:
       return items_;
    }
 
+   // approximate bytes held by the index
+   std::size_t memoryUsage() const;
+
 private:
+   void addName(const std::string& name);
+   void searchNames(const std::string& term,
+                    bool prefixOnly,
+                    bool caseSensitive,
+                    std::vector<std::size_t>* pMatches) const;
+
    std::string context_;
    std::vector<RSourceItem> items_;
+
+   // the item names, lower cased and packed contiguously so that term
+   // searches scan them without visiting each item (the name of item i
+   // spans [nameOffsets_[i], nameOffsets_[i + 1]) of lowerNames_)
+   std::string lowerNames_;
+   std::vector<std::size_t> nameOffsets_;
    
    // private fields related to the current set of library completions
    // NOTE: each index tracks the 'library' calls encountered within,
    // but we share that state in a static variable (so that we can
    // cache and share across all indexes)
    std::vector<std::string> inferredPkgNames_;
+   bool publishInferredPackages_;
    static std::set<std::string> s_importedPackages_;
    static ImportFromMap s_importFromDirectives_;
    static std::set<std::string> s_allInferredPkgNames_;
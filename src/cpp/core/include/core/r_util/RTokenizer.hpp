@@ -107,7 +107,7 @@ public:
    // accessors
    TokenType type() const { return type_; }
    std::wstring content() const { return std::wstring(begin_, end_); }
-   const std::string& contentAsUtf8() const;
+   std::string contentAsUtf8() const;
    std::size_t offset() const { return offset_; }
    std::size_t length() const { return end_ - begin_; }
    std::size_t row() const { return row_; }
@@ -234,8 +234,6 @@ private:
    wchar_t peek();
    wchar_t peek(std::size_t lookahead);
    wchar_t eat();
-   std::size_t tokenLength(const boost::wregex& regex);
-   void eatUntil(const boost::wregex& regex);
    RToken consumeToken(RToken::TokenType tokenType, std::size_t length);
    
 private:
@@ -582,10 +580,23 @@ inline bool canFollowBinaryOperator(const RToken& rToken)
    return false;
 }
 
+// equivalent to matching the regex ^%[^>]*>+[^>]*%$
 inline bool isPipeOperator(const RToken& rToken)
 {
-   static const boost::wregex rePipe(L"^%[^>]*>+[^>]*%$");
-   return boost::regex_match(rToken.begin(), rToken.end(), rePipe);
+   std::wstring::const_iterator begin = rToken.begin();
+   std::wstring::const_iterator end = rToken.end();
+   if (end - begin < 3 || *begin != L'%' || *(end - 1) != L'%')
+      return false;
+
+   std::wstring::const_iterator last = end - 1;
+   std::wstring::const_iterator pos = std::find(begin + 1, last, L'>');
+   if (pos == last)
+      return false;
+
+   while (pos != last && *pos == L'>')
+      ++pos;
+
+   return std::find(pos, last, L'>') == last;
 }
 
 namespace {
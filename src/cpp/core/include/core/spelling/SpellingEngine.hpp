@@ -35,9 +35,16 @@ public:
 
    virtual void useDictionary(const std::string& langId) = 0;
 
+   // free the loaded dictionaries (they are loaded again when next needed)
+   virtual void releaseDictionaries() = 0;
+
    virtual Error checkSpelling(const std::string& word,
                                bool *pCorrect) = 0;
 
+   // check a batch of words (pCorrect receives a result for each word)
+   virtual Error checkSpelling(const std::vector<std::string>& words,
+                               std::vector<bool>* pCorrect) = 0;
+
    virtual Error suggestionList(const std::string& word,
                                 std::vector<std::string>* pSugs) = 0;
 
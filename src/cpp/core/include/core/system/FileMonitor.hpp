@@ -48,6 +48,27 @@ void initialize();
 // active file monitoring handles)
 void stop();
 
+// monitoring backends. on linux the fanotify backend marks the entire
+// filesystem containing each monitored directory rather than adding an
+// inotify watch for every directory (so large trees aren't limited by
+// max_user_watches). it requires a kernel which supports reporting
+// directory entry events by file handle (5.9 or later) as well as
+// CAP_SYS_ADMIN -- when it isn't available registration falls back to
+// inotify. other platforms ignore the backend
+enum Backend
+{
+   DefaultBackend,
+   FanotifyBackend
+};
+
+// set the backend used for new registrations (call prior to initialize)
+void setBackend(Backend backend);
+
+// set how long changes are coalesced before they are delivered (call prior
+// to initialize). only used on osx, where a burst of changes arriving
+// within the latency is delivered in a single batch
+void setLatency(const boost::posix_time::time_duration& latency);
+
 
 // opaque handle to a registration (used to unregister). the id field
 // is included so that handles have additional uniqueness beyond the
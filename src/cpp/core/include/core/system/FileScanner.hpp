@@ -39,12 +39,19 @@ namespace system {
 struct FileScannerOptions
 {
    FileScannerOptions()
-      : recursive(false), yield(false)
+      : recursive(false), yield(false), threads(1)
    {
    }
 
    bool recursive;
    bool yield;
+
+   // number of threads used to read directories for recursive scans
+   // (directory listings are read ahead by background threads however
+   // filter and onBeforeScanDir are always called on the scanning thread
+   // and the resulting tree is the same as that of a serial scan)
+   int threads;
+
    boost::function<bool(const FileInfo&)> filter;
    boost::function<Error(const FileInfo&)> onBeforeScanDir;
 };
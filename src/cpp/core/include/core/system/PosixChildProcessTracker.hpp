@@ -32,12 +32,19 @@ class FilePath;
 
 namespace system {
 
+// tracks child processes for reaping when SIGCHLD is received. on linux
+// (5.3 or later) each process is watched through a pidfd in an epoll set so
+// that only the processes which have actually exited are waited on; other
+// processes (or all of them without pidfd support) are polled with waitpid
 class ChildProcessTracker : boost::noncopyable
 {
 public:
 
   typedef boost::function<void(PidType,int)> ExitHandler;
 
+  ChildProcessTracker();
+  virtual ~ChildProcessTracker();
+
   void addProcess(PidType pid, ExitHandler exitHandler = ExitHandler());
 
   void notifySIGCHILD();
@@ -46,10 +53,16 @@ private:
   void attemptToReapProcess(const std::pair<PidType,ExitHandler>& process);
   void removeProcess(PidType pid);
   std::map<PidType,ExitHandler> activeProcesses();
+  std::map<PidType,ExitHandler> exitedProcesses();
+  bool watchProcess(PidType pid);
 
 private:
    boost::mutex mutex_;
    std::map<PidType,ExitHandler> processes_;
+
+   // pidfds of watched processes (processes without one are polled)
+   int epollFd_;
+   std::map<PidType,int> pidFds_;
 };
 
 
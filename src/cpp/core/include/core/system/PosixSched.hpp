@@ -16,6 +16,7 @@
 #ifndef CORE_SYSTEM_POSIX_SCHED_HPP
 #define CORE_SYSTEM_POSIX_SCHED_HPP
 
+#include <string>
 #include <vector>
 
 namespace rstudio {
@@ -28,11 +29,25 @@ namespace system {
 typedef std::vector<bool> CpuAffinity;
 
 int cpuCount();
+
+// the number of cpus the process can actually make use of: the cpus in
+// its affinity mask, further limited by any cgroup cpu quota (e.g. in a
+// container). always at least 1
+int availableCpuCount();
 CpuAffinity emptyCpuAffinity();
 bool isCpuAffinityEmpty(const CpuAffinity& cpus);
 Error getCpuAffinity(CpuAffinity* pCpus);
 Error setCpuAffinity(const CpuAffinity& cpus);
 
+// 1 minute load average divided by the number of cpus
+Error getLoadPerCpu(double* pLoad);
+
+// move the calling process into the cgroup (v2) at the passed path, creating
+// it if necessary, and set the cgroup's cpu weight (1-10000, 100 being the
+// default) if one is passed. the parent cgroup must have the cpu controller
+// enabled for its children (e.g. a cgroup delegated for this purpose)
+Error moveToCpuCgroup(const std::string& cgroupPath, int cpuWeight);
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
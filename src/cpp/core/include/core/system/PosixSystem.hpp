@@ -134,7 +134,8 @@ struct ProcessLimits
        userProcessesLimit(0),
        cpuLimit(0),
        niceLimit(0),
-       filesLimit(0)
+       filesLimit(0),
+       cpuWeight(0)
    {
    }
 
@@ -146,6 +147,11 @@ struct ProcessLimits
    RLimitType cpuLimit;
    RLimitType niceLimit;
    RLimitType filesLimit;
+
+   // cgroup (v2) to place the process in and the cpu weight for it
+   // (0 to leave the cgroup's weight as it is)
+   std::string cpuCgroup;
+   int cpuWeight;
 };
 
 void setProcessLimits(ProcessLimits limits);
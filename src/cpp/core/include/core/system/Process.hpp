@@ -308,6 +308,12 @@ public:
    // are still children being supervised after the poll
    bool poll();
 
+   // Have onActivity called (from a background thread) when a child has
+   // output to collect or has exited, so the owner can arrange for poll to
+   // be called promptly rather than at its next polling interval. Only
+   // supported on linux (elsewhere children are only seen by polling)
+   void setActivityHandler(const boost::function<void()>& onActivity);
+
    // Terminate all running children
    void terminateAll();
 
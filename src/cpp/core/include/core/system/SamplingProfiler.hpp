@@ -0,0 +1,57 @@
+/*
+ * SamplingProfiler.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_SYSTEM_SAMPLING_PROFILER_HPP
+#define CORE_SYSTEM_SAMPLING_PROFILER_HPP
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace rstudio {
+namespace core {
+
+class Error;
+
+namespace system {
+namespace sampling_profiler {
+
+// sampling profiler for the process's native code. a process cpu time
+// timer signals the process every interval of cpu consumed and the stack
+// of the interrupted thread is recorded. threads which block all signals
+// (e.g. those launched with thread::safeLaunchThread) are never sampled,
+// so in practice this profiles the main thread. the signal used is a
+// realtime signal rather than SIGPROF so that R's own profiler (Rprof) is
+// unaffected. samples are kept in a fixed size buffer; once it is full
+// further samples are dropped. not supported on Windows or OS X
+Error start(int intervalMs = 10);
+void stop();
+bool isRunning();
+
+// samples recorded (and dropped) since the profiler was last started
+std::size_t sampleCount();
+std::size_t droppedSampleCount();
+
+// write the samples as folded stacks (one "root;...;leaf count" line per
+// distinct stack) as consumed by flamegraph.pl and similar tools. frames
+// are named by their symbol when it can be resolved and otherwise by
+// module+offset (which addr2line can resolve offline)
+void writeFolded(std::ostream& os);
+
+} // namespace sampling_profiler
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_SYSTEM_SAMPLING_PROFILER_HPP
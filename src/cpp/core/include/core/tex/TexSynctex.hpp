@@ -127,6 +127,9 @@ public:
 
 private:
    std::string synctexNameForInputFile(const FilePath& inputFile);
+   std::string findSynctexNameForInputFile(const FilePath& inputFile);
+   FilePath filePathForTag(int tag);
+   PdfLocation findTopOfPageContent(int page);
 
 private:
    struct Impl;
@@ -18,6 +18,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include <boost/function.hpp>
 
@@ -54,6 +55,12 @@ Error parseDcfFile(const FilePath& dcfFilePath,
                    std::map<std::string,std::string>* pFields,
                    std::string* pUserErrMsg);
 
+// parse a file containing several records (e.g. a PACKAGES index), with the
+// fields of each record collected into a map
+Error parseDcfRecords(const std::string& dcfFileContents,
+                      bool preserveKeyCase,
+                      std::vector<std::map<std::string,std::string> >* pRecords,
+                      std::string* pUserErrMsg);
 
 std::string dcfMultilineAsFolded(const std::string& line);
 
@@ -0,0 +1,104 @@
+/*
+ * DelimitedPreview.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_TEXT_DELIMITED_PREVIEW_HPP
+#define CORE_TEXT_DELIMITED_PREVIEW_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+// the settings with which read.table would read a delimited file. a
+// separator of '\0' means fields are separated by whitespace, and a quote
+// or comment of '\0' means there is none
+struct DelimitedFormat
+{
+   DelimitedFormat()
+      : header(false), separator('\0'), decimal('.'), quote('"'),
+        comment('\0')
+   {
+   }
+
+   bool header;
+   char separator;
+   char decimal;
+   char quote;
+   char comment;
+};
+
+enum DelimitedColumnType
+{
+   DelimitedColumnLogical,
+   DelimitedColumnInteger,
+   DelimitedColumnNumeric,
+   DelimitedColumnCharacter
+};
+
+// the first rows of a delimited file as read.table would read them: names
+// are made syntactic (and unique) as by make.names, the values of logical
+// and numeric columns are normalized (TRUE/FALSE, '.' decimal points) and
+// missing values have isNA set
+struct DelimitedValue
+{
+   DelimitedValue() : isNA(true) {}
+   explicit DelimitedValue(const std::string& text)
+      : text(text), isNA(false)
+   {
+   }
+
+   std::string text;
+   bool isNA;
+};
+
+struct DelimitedPreview
+{
+   // "UTF-8" if the sample is valid (non-ASCII) UTF-8, "unknown" otherwise
+   std::string encoding;
+
+   // the first lines of the file (as they are)
+   std::vector<std::string> lines;
+
+   std::vector<std::string> names;
+   std::vector<DelimitedColumnType> types;
+   std::vector<std::vector<DelimitedValue> > rows;
+};
+
+// the portion of a file which is sniffed and previewed: large files are
+// never read beyond this
+#define kDelimitedPreviewMaxBytes (1024 * 1024)
+
+// guess the format of a delimited file from the beginning of its contents
+DelimitedFormat sniffDelimitedFormat(const char* begin,
+                                     const char* end,
+                                     std::size_t maxLines = 20);
+
+// read up to maxRows rows from the beginning of a delimited file. only the
+// first kDelimitedPreviewMaxBytes are looked at, so this is cheap however
+// large the file is
+void previewDelimited(const char* begin,
+                      const char* end,
+                      const DelimitedFormat& format,
+                      std::size_t maxRows,
+                      DelimitedPreview* pPreview);
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_TEXT_DELIMITED_PREVIEW_HPP
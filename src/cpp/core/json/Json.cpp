@@ -26,6 +26,7 @@
 #include <core/Thread.hpp>
 
 #include "spirit/json_spirit.h"
+#include "JsonParser.hpp"
 
 namespace rstudio {
 namespace core {
@@ -117,7 +118,11 @@ bool fillMap(const Object& object, std::map< std::string, std::vector<std::strin
 
 bool parse(const std::string& input, Value* pValue)
 {
-   // two threads simultaneously using the json parser has been observed
+   // the fast parser handles strict json (which is virtually all input)
+   if (fastParse(input, pValue))
+      return true;
+
+   // fall back to json_spirit for anything else. two threads simultaneously using the json parser has been observed
    // to crash the process. protect it globally with a mutex. note this was
    // probably a result of not defining BOOST_SPIRIT_THREADSAFE (which we
    // have subsequently defined) however since there isn't much documentation 
@@ -0,0 +1,534 @@
+/*
+ * JsonParser.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "JsonParser.hpp"
+
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+namespace {
+
+// maximum nesting depth (deeper documents are left to json_spirit)
+const std::size_t kMaxDepth = 512;
+
+bool isWhitespace(char ch)
+{
+   return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+bool isDigit(char ch)
+{
+   return ch >= '0' && ch <= '9';
+}
+
+int hexValue(char ch)
+{
+   if (ch >= '0' && ch <= '9') return ch - '0';
+   if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+   if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+   return -1;
+}
+
+void appendUtf8(boost::uint32_t codePoint, std::string* pOutput)
+{
+   if (codePoint < 0x80)
+   {
+      pOutput->push_back(static_cast<char>(codePoint));
+   }
+   else if (codePoint < 0x800)
+   {
+      pOutput->push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+      pOutput->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+   }
+   else if (codePoint < 0x10000)
+   {
+      pOutput->push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+      pOutput->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+      pOutput->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+   }
+   else
+   {
+      pOutput->push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+      pOutput->push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+      pOutput->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+      pOutput->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+   }
+}
+
+class Parser
+{
+public:
+   Parser(const char* begin, const char* end)
+      : begin_(begin), pos_(begin), end_(end), nextArray_(0)
+   {
+   }
+
+   bool parse(Value* pValue)
+   {
+      // size arrays up front so that elements are parsed in place rather
+      // than being (deep) copied as their vector grows
+      if (!countArrayElements())
+         return false;
+
+      skipWhitespace();
+      if (!parseValue(pValue, 0))
+         return false;
+
+      skipWhitespace();
+      return pos_ == end_;
+   }
+
+private:
+   // record the number of elements in each array (in document order)
+   bool countArrayElements()
+   {
+      std::vector<std::size_t> openArrays;   // indexes into arraySizes_
+      std::vector<bool> containers;          // true for arrays
+      std::vector<bool> empty;
+      for (const char* it = begin_; it != end_; ++it)
+      {
+         char ch = *it;
+         if (ch == '"')
+         {
+            // skip string (including escapes)
+            for (++it; it != end_ && *it != '"'; ++it)
+            {
+               if (*it == '\\' && ++it == end_)
+                  return false;
+            }
+            if (it == end_)
+               return false;
+         }
+         else if (ch == '[')
+         {
+            if (!containers.empty())
+               markNonEmpty(&containers, &empty, &openArrays);
+            openArrays.push_back(arraySizes_.size());
+            arraySizes_.push_back(0);
+            containers.push_back(true);
+            empty.push_back(true);
+            continue;
+         }
+         else if (ch == '{')
+         {
+            if (!containers.empty())
+               markNonEmpty(&containers, &empty, &openArrays);
+            containers.push_back(false);
+            empty.push_back(true);
+            continue;
+         }
+         else if (ch == ']' || ch == '}')
+         {
+            if (containers.empty() || containers.back() != (ch == ']'))
+               return false;
+            if (containers.back())
+               openArrays.pop_back();
+            containers.pop_back();
+            empty.pop_back();
+            continue;
+         }
+         else if (ch == ',')
+         {
+            if (!containers.empty() && containers.back())
+               arraySizes_[openArrays.back()]++;
+            continue;
+         }
+         else if (isWhitespace(ch) || ch == ':')
+         {
+            continue;
+         }
+
+         // start of some other value
+         if (!containers.empty())
+            markNonEmpty(&containers, &empty, &openArrays);
+      }
+
+      return containers.empty();
+   }
+
+   void markNonEmpty(std::vector<bool>* pContainers,
+                     std::vector<bool>* pEmpty,
+                     std::vector<std::size_t>* pOpenArrays)
+   {
+      // the first value within an array counts as an element (subsequent
+      // elements are counted by their separators)
+      if (pEmpty->back())
+      {
+         pEmpty->back() = false;
+         if (pContainers->back())
+            arraySizes_[pOpenArrays->back()]++;
+      }
+   }
+
+   void skipWhitespace()
+   {
+      while (pos_ != end_ && isWhitespace(*pos_))
+         ++pos_;
+   }
+
+   bool consume(char ch)
+   {
+      skipWhitespace();
+      if (pos_ != end_ && *pos_ == ch)
+      {
+         ++pos_;
+         return true;
+      }
+      return false;
+   }
+
+   bool consumeLiteral(const char* literal)
+   {
+      std::size_t length = std::strlen(literal);
+      if (static_cast<std::size_t>(end_ - pos_) < length ||
+          std::strncmp(pos_, literal, length) != 0)
+      {
+         return false;
+      }
+
+      pos_ += length;
+      return true;
+   }
+
+   bool parseValue(Value* pValue, std::size_t depth)
+   {
+      if (pos_ == end_ || depth > kMaxDepth)
+         return false;
+
+      switch (*pos_)
+      {
+         case '{':
+            return parseObject(pValue, depth);
+         case '[':
+            return parseArray(pValue, depth);
+         case '"':
+         {
+            if (!parseString(&string_))
+               return false;
+            *pValue = string_;
+            return true;
+         }
+         case 't':
+            *pValue = true;
+            return consumeLiteral("true");
+         case 'f':
+            *pValue = false;
+            return consumeLiteral("false");
+         case 'n':
+            *pValue = Value();
+            return consumeLiteral("null");
+         default:
+            return parseNumber(pValue);
+      }
+   }
+
+   bool parseObject(Value* pValue, std::size_t depth)
+   {
+      ++pos_; // '{'
+      *pValue = Object();
+      Object& object = pValue->get_obj();
+
+      if (consume('}'))
+         return true;
+
+      do
+      {
+         skipWhitespace();
+         if (pos_ == end_ || *pos_ != '"' || !parseString(&name_))
+            return false;
+
+         if (!consume(':'))
+            return false;
+
+         // parse directly into the member (duplicate names: last one wins,
+         // as with json_spirit). name_ may be reused by nested objects once
+         // the member has been inserted
+         skipWhitespace();
+         if (!parseValue(&object[name_], depth + 1))
+            return false;
+      }
+      while (consume(','));
+
+      return consume('}');
+   }
+
+   bool parseArray(Value* pValue, std::size_t depth)
+   {
+      ++pos_; // '['
+      *pValue = Array();
+      Array& array = pValue->get_array();
+
+      if (nextArray_ < arraySizes_.size())
+         array.reserve(arraySizes_[nextArray_]);
+      ++nextArray_;
+
+      if (consume(']'))
+         return true;
+
+      do
+      {
+         skipWhitespace();
+         array.push_back(Value());
+         if (!parseValue(&array.back(), depth + 1))
+            return false;
+      }
+      while (consume(','));
+
+      return consume(']');
+   }
+
+   bool parseHex4(boost::uint32_t* pValue)
+   {
+      if (end_ - pos_ < 4)
+         return false;
+
+      boost::uint32_t value = 0;
+      for (int i = 0; i < 4; i++)
+      {
+         int digit = hexValue(*pos_++);
+         if (digit < 0)
+            return false;
+         value = (value << 4) | digit;
+      }
+
+      *pValue = value;
+      return true;
+   }
+
+   bool parseString(std::string* pValue)
+   {
+      ++pos_; // '"'
+      pValue->clear();
+
+      // fast path for strings without escapes
+      const char* start = pos_;
+      while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\')
+         ++pos_;
+      if (pos_ == end_)
+         return false;
+      pValue->assign(start, pos_);
+
+      while (*pos_ != '"')
+      {
+         // escape sequence
+         if (++pos_ == end_)
+            return false;
+
+         char ch = *pos_++;
+         switch (ch)
+         {
+            case '"':  pValue->push_back('"');  break;
+            case '\\': pValue->push_back('\\'); break;
+            case '/':  pValue->push_back('/');  break;
+            case 'b':  pValue->push_back('\b'); break;
+            case 'f':  pValue->push_back('\f'); break;
+            case 'n':  pValue->push_back('\n'); break;
+            case 'r':  pValue->push_back('\r'); break;
+            case 't':  pValue->push_back('\t'); break;
+            case 'u':
+            {
+               boost::uint32_t codePoint;
+               if (!parseHex4(&codePoint))
+                  return false;
+
+               // surrogate pair
+               if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+               {
+                  boost::uint32_t low;
+                  if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u')
+                     return false;
+                  pos_ += 2;
+                  if (!parseHex4(&low) || low < 0xDC00 || low > 0xDFFF)
+                     return false;
+                  codePoint = 0x10000 + ((codePoint - 0xD800) << 10) +
+                              (low - 0xDC00);
+               }
+
+               appendUtf8(codePoint, pValue);
+               break;
+            }
+            default:
+               return false;
+         }
+
+         // run of unescaped characters
+         start = pos_;
+         while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\')
+            ++pos_;
+         if (pos_ == end_)
+            return false;
+         pValue->append(start, pos_);
+      }
+
+      ++pos_; // '"'
+      return true;
+   }
+
+   bool parseNumber(Value* pValue)
+   {
+      const char* start = pos_;
+      bool negative = false;
+      if (*pos_ == '-')
+      {
+         negative = true;
+         ++pos_;
+      }
+
+      // integer part
+      if (pos_ == end_ || !isDigit(*pos_))
+         return false;
+      if (*pos_ == '0')
+      {
+         ++pos_;
+      }
+      else
+      {
+         while (pos_ != end_ && isDigit(*pos_))
+            ++pos_;
+      }
+      const char* integerEnd = pos_;
+
+      // fraction and exponent
+      bool isReal = false;
+      if (pos_ != end_ && *pos_ == '.')
+      {
+         isReal = true;
+         ++pos_;
+         if (pos_ == end_ || !isDigit(*pos_))
+            return false;
+         while (pos_ != end_ && isDigit(*pos_))
+            ++pos_;
+      }
+      if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E'))
+      {
+         isReal = true;
+         ++pos_;
+         if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-'))
+            ++pos_;
+         if (pos_ == end_ || !isDigit(*pos_))
+            return false;
+         while (pos_ != end_ && isDigit(*pos_))
+            ++pos_;
+      }
+
+      if (!isReal)
+      {
+         // accumulate as unsigned then apply the sign
+         const char* digits = negative ? start + 1 : start;
+         boost::uint64_t value = 0;
+         bool overflow = false;
+         for (const char* it = digits; it != integerEnd; ++it)
+         {
+            boost::uint64_t digit = *it - '0';
+            if (value > (std::numeric_limits<boost::uint64_t>::max() - digit) / 10)
+            {
+               overflow = true;
+               break;
+            }
+            value = value * 10 + digit;
+         }
+
+         const boost::uint64_t maxInt64 =
+               static_cast<boost::uint64_t>(std::numeric_limits<boost::int64_t>::max());
+         if (!overflow && !negative && value <= maxInt64)
+         {
+            *pValue = static_cast<boost::int64_t>(value);
+            return true;
+         }
+         else if (!overflow && !negative)
+         {
+            *pValue = value;
+            return true;
+         }
+         else if (!overflow && value <= maxInt64 + 1)
+         {
+            *pValue = (value == maxInt64 + 1)
+                         ? std::numeric_limits<boost::int64_t>::min()
+                         : -static_cast<boost::int64_t>(value);
+            return true;
+         }
+
+         // out of range for an integer, read as a real
+      }
+
+      return parseReal(start, pos_, pValue);
+   }
+
+   bool parseReal(const char* begin, const char* end, Value* pValue)
+   {
+      std::string text(begin, end);
+
+      // strtod respects the current locale's decimal point so only use it
+      // when that is '.'
+      const char* decimalPoint = std::localeconv()->decimal_point;
+      if (decimalPoint && decimalPoint[0] == '.' && decimalPoint[1] == '\0')
+      {
+         char* parseEnd = NULL;
+         double value = std::strtod(text.c_str(), &parseEnd);
+         if (parseEnd != text.c_str() + text.size())
+            return false;
+         *pValue = value;
+         return true;
+      }
+      else
+      {
+         std::istringstream istr(text);
+         istr.imbue(std::locale::classic());
+         double value;
+         istr >> value;
+         if (istr.fail())
+            return false;
+         *pValue = value;
+         return true;
+      }
+   }
+
+private:
+   const char* begin_;
+   const char* pos_;
+   const char* end_;
+   std::vector<std::size_t> arraySizes_;
+   std::size_t nextArray_;
+
+   // scratch buffers for names and string values (reused for the whole
+   // document so that each string is only allocated where it's stored)
+   std::string name_;
+   std::string string_;
+};
+
+} // anonymous namespace
+
+bool fastParse(const std::string& input, Value* pValue)
+{
+   const char* begin = input.data();
+   Parser parser(begin, begin + input.size());
+
+   return parser.parse(pValue);
+}
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
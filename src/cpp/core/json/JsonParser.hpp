@@ -0,0 +1,37 @@
+/*
+ * JsonParser.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_JSON_JSON_PARSER_HPP
+#define CORE_JSON_JSON_PARSER_HPP
+
+#include <string>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+// hand written parser for strict json which builds a json::Value directly
+// (without the overhead of the spirit grammar). returns false for any input
+// it doesn't accept, in which case callers should fall back to json_spirit
+// (which is more lenient, e.g. it accepts trailing content)
+bool fastParse(const std::string& input, Value* pValue);
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_JSON_JSON_PARSER_HPP
@@ -0,0 +1,122 @@
+/*
+ * JsonParserTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+#include <vector>
+
+#include <core/json/Json.hpp>
+
+#include "JsonParser.hpp"
+#include "spirit/json_spirit_reader.h"
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+namespace {
+
+bool parsesLikeSpirit(const std::string& input)
+{
+   Value fastValue, spiritValue;
+   if (!fastParse(input, &fastValue))
+      return false;
+   if (!json_spirit::read(input, spiritValue))
+      return false;
+   return fastValue == spiritValue;
+}
+
+} // anonymous namespace
+
+context("JsonParser")
+{
+   test_that("documents are parsed the same as json_spirit")
+   {
+      std::vector<std::string> inputs;
+      inputs.push_back("{}");
+      inputs.push_back("[]");
+      inputs.push_back("  [ ]  ");
+      inputs.push_back("\"string\"");
+      inputs.push_back("true");
+      inputs.push_back("null");
+      inputs.push_back("0");
+      inputs.push_back("-12");
+      inputs.push_back("9223372036854775807");
+      inputs.push_back("18446744073709551615");
+      inputs.push_back("-9223372036854775808");
+      inputs.push_back("0.5");
+      inputs.push_back("-2.5e3");
+      inputs.push_back("{\"a\": [1, 2, {\"b\": null}], \"c\": \"d\\n\\\"e\\\"\"}");
+      inputs.push_back("[[], [[]], [1, [2, [3, []]]], {\"x\": [true, false]}]");
+      inputs.push_back("{\"dup\": 1, \"dup\": 2}");
+      inputs.push_back("{\"utf8\": \"caf\xc3\xa9\", \"slash\": \"a\\/b\"}");
+      inputs.push_back("[\"[not an array]\", \"{not an object}\", \"\\\"]\"]");
+
+      for (std::size_t i = 0; i < inputs.size(); i++)
+         expect_true(parsesLikeSpirit(inputs[i]));
+   }
+
+   test_that("unicode escapes are converted to utf8")
+   {
+      Value value;
+      expect_true(fastParse("\"\\u0041\\u00e9\\u20ac\\ud83d\\ude00\"", &value));
+      expect_true(value.get_str() == "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+   }
+
+   test_that("large integers are read as reals")
+   {
+      Value value;
+      expect_true(fastParse("123456789012345678901234567890", &value));
+      expect_true(value.type() == RealType);
+   }
+
+   test_that("invalid input is rejected")
+   {
+      std::vector<std::string> inputs;
+      inputs.push_back("");
+      inputs.push_back("{");
+      inputs.push_back("[1,]");
+      inputs.push_back("[1 2]");
+      inputs.push_back("{\"a\" 1}");
+      inputs.push_back("{1: 2}");
+      inputs.push_back("\"unterminated");
+      inputs.push_back("\"bad \\q escape\"");
+      inputs.push_back("01");
+      inputs.push_back("1.");
+      inputs.push_back("-");
+      inputs.push_back("tru");
+      inputs.push_back("[1] trailing");
+      inputs.push_back("[}");
+
+      for (std::size_t i = 0; i < inputs.size(); i++)
+      {
+         Value value;
+         expect_false(fastParse(inputs[i], &value));
+      }
+   }
+
+   test_that("json::parse falls back for lenient input")
+   {
+      // json_spirit accepts trailing content
+      Value value;
+      expect_true(json::parse("[1, 2] trailing", &value));
+      expect_true(value.get_array().size() == 2);
+   }
+}
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
@@ -17,8 +17,11 @@
 
 #include <sstream>
 
+#include <boost/thread/tss.hpp>
+
 #include <core/Log.hpp>
 #include <core/http/Response.hpp>
+#include <core/json/JsonWriter.hpp>
 
 
 namespace rstudio {
@@ -44,13 +47,27 @@ Error parseJsonRpcRequest(const std::string& input, JsonRpcRequest* pRequest)
          return Error(errc::InvalidRequest, ERROR_LOCATION) ;
       }
 
+      return parseJsonRpcRequest(var.get_obj(), pRequest);
+   }
+   catch(const std::exception& e)
+   {
+      Error error = Error(errc::ParseError, ERROR_LOCATION);
+      error.addProperty("exception", e.what()) ;
+      return error ;
+   }
+}
+
+Error parseJsonRpcRequest(const json::Object& requestObject,
+                          JsonRpcRequest* pRequest)
+{
+   try
+   {
       // extract the fields
-      json::Object& requestObject = var.get_obj();
       for (json::Object::const_iterator it = 
             requestObject.begin(); it != requestObject.end(); ++it)
       {
-         std::string fieldName = it->first ;
-         json::Value fieldValue = it->second ;
+         const std::string& fieldName = it->first ;
+         const json::Value& fieldValue = it->second ;
 
          if ( fieldName == "method" )
          {
@@ -149,6 +166,27 @@ bool parseJsonRpcRequestForMethod(const std::string& input,
 
 namespace  {
 
+// responses are serialized into a per-thread buffer which is reused rather
+// than grown from scratch for every request (the main thread and the worker
+// pool threads each have their own so there is no contention for it)
+std::string& rpcResponseBuffer()
+{
+   static boost::thread_specific_ptr<std::string> s_pBuffer;
+   if (s_pBuffer.get() == NULL)
+      s_pBuffer.reset(new std::string());
+   return *s_pBuffer;
+}
+
+void releaseRpcResponseBuffer(std::string* pBuffer)
+{
+   // don't hold on to the memory of unusually large responses
+   const std::size_t kMaxRetainedSize = 4 * 1024 * 1024;
+   if (pBuffer->capacity() > kMaxRetainedSize)
+      std::string().swap(*pBuffer);
+   else
+      pBuffer->clear();
+}
+
 void copyErrorCodeToJsonError(const boost::system::error_code& code,
                               json::Object* pError)
 {
@@ -176,14 +214,72 @@ void JsonRpcResponse::runAfterResponse()
       afterResponse_();
 }
    
+json::Value& JsonRpcResponse::result()
+{
+   // materialize a raw result so that it can be inspected/modified
+   if (pRawResult_)
+   {
+      json::Value resultValue;
+      if (!json::parse(*pRawResult_, &resultValue))
+         LOG_ERROR_MESSAGE("Invalid raw json-rpc result");
+      pRawResult_.reset();
+      response_[kRpcResult] = resultValue;
+   }
+
+   return response_[kRpcResult];
+}
+
+void JsonRpcResponse::setRawResult(const std::string& resultJson)
+{
+   response_.erase(kRpcError);
+   response_.erase(kRpcAsyncHandle);
+   response_[kRpcResult] = json::Value();
+   pRawResult_.reset(new std::string(resultJson));
+}
+
 json::Object JsonRpcResponse::getRawResponse()
 {
+   if (pRawResult_)
+      result();
+
    return response_;
 }
    
 void JsonRpcResponse::write(std::ostream& os) const
 {
-   json::write(response_, os);
+   if (!pRawResult_)
+   {
+      json::write(response_, os);
+      return;
+   }
+
+   std::string output;
+   write(&output);
+   os << output;
+}
+
+void JsonRpcResponse::write(std::string* pOutput) const
+{
+   if (!pRawResult_)
+   {
+      pOutput->append(json::write(response_));
+      return;
+   }
+
+   // splice the raw result into the response
+   json::Writer writer(pOutput);
+   writer.startObject();
+   for (json::Object::const_iterator it = response_.begin();
+        it != response_.end();
+        ++it)
+   {
+      writer.key(it->first);
+      if (it->first == kRpcResult)
+         writer.rawValue(*pRawResult_);
+      else
+         writer.value(it->second);
+   }
+   writer.endObject();
 }
    
 void JsonRpcResponse::setError(const Error& error, const json::Value& clientInfo)
@@ -191,6 +287,7 @@ void JsonRpcResponse::setError(const Error& error, const json::Value& clientInfo
    // remove result
    response_.erase(kRpcResult);
    response_.erase(kRpcAsyncHandle);
+   pRawResult_.reset();
 
    const boost::system::error_code& ec = error.code();
    
@@ -233,6 +330,7 @@ void JsonRpcResponse::setError(const boost::system::error_code& ec,
    // remove result
    response_.erase(kRpcResult);
    response_.erase(kRpcAsyncHandle);
+   pRawResult_.reset();
 
    // error from error code
    json::Object error ;
@@ -255,6 +353,7 @@ void JsonRpcResponse::setAsyncHandle(const std::string& handle)
 {
    response_.erase(kRpcResult);
    response_.erase(kRpcError);
+   pRawResult_.reset();
 
    setField(kRpcAsyncHandle, handle);
 }
@@ -272,10 +371,13 @@ void setJsonRpcResponse(const core::json::JsonRpcResponse& jsonRpcResponse,
    if (pResponse->contentType().empty())
        pResponse->setContentType(kJsonContentType) ; 
    
-   // set body 
-   std::stringstream responseStream ;
-   jsonRpcResponse.write(responseStream);
-   Error error = pResponse->setBody(responseStream);
+   // set body (serialized into this thread's response buffer, which keeps
+   // its capacity from one response to the next)
+   std::string& responseBuffer = rpcResponseBuffer();
+   responseBuffer.clear();
+   jsonRpcResponse.write(&responseBuffer);
+   Error error = pResponse->setBody(responseBuffer);
+   releaseRpcResponseBuffer(&responseBuffer);
    
    // report error to client if one occurred
    if (error)
@@ -0,0 +1,290 @@
+/*
+ * JsonWriter.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/json/JsonWriter.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+#include <boost/foreach.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+namespace {
+
+template <typename T>
+void appendInteger(T value, std::string* pOutput)
+{
+   // format digits from the right (negate each digit rather than the value
+   // so that the most negative value is handled correctly)
+   char buffer[32];
+   char* end = buffer + sizeof(buffer);
+   char* begin = end;
+   bool negative = value < 0;
+   do
+   {
+      int digit = static_cast<int>(value % 10);
+      *--begin = static_cast<char>('0' + (negative ? -digit : digit));
+      value /= 10;
+   } while (value != 0);
+
+   if (negative)
+      *--begin = '-';
+
+   pOutput->append(begin, end);
+}
+
+} // anonymous namespace
+
+Writer::Writer()
+   : pOutput_(&buffer_), expectingValue_(false)
+{
+}
+
+Writer::Writer(std::string* pOutput)
+   : pOutput_(pOutput), expectingValue_(false)
+{
+}
+
+void Writer::startObject()
+{
+   beginValue();
+   pOutput_->push_back('{');
+   levels_.push_back(false);
+}
+
+void Writer::endObject()
+{
+   BOOST_ASSERT(!levels_.empty() && !expectingValue_);
+   levels_.pop_back();
+   pOutput_->push_back('}');
+}
+
+void Writer::startArray()
+{
+   beginValue();
+   pOutput_->push_back('[');
+   levels_.push_back(false);
+}
+
+void Writer::endArray()
+{
+   BOOST_ASSERT(!levels_.empty() && !expectingValue_);
+   levels_.pop_back();
+   pOutput_->push_back(']');
+}
+
+void Writer::key(const std::string& name)
+{
+   BOOST_ASSERT(!levels_.empty() && !expectingValue_);
+   beginValue();
+   writeString(name.data(), name.size());
+   pOutput_->push_back(':');
+   expectingValue_ = true;
+}
+
+void Writer::value(const std::string& value)
+{
+   beginValue();
+   writeString(value.data(), value.size());
+}
+
+void Writer::value(const char* value)
+{
+   beginValue();
+   writeString(value, std::strlen(value));
+}
+
+void Writer::value(bool value)
+{
+   beginValue();
+   pOutput_->append(value ? "true" : "false");
+}
+
+void Writer::value(int value)
+{
+   beginValue();
+   appendInteger(value, pOutput_);
+}
+
+void Writer::value(unsigned int value)
+{
+   beginValue();
+   appendInteger(value, pOutput_);
+}
+
+void Writer::value(long value)
+{
+   beginValue();
+   appendInteger(value, pOutput_);
+}
+
+void Writer::value(unsigned long value)
+{
+   beginValue();
+   appendInteger(value, pOutput_);
+}
+
+void Writer::value(boost::long_long_type value)
+{
+   beginValue();
+   appendInteger(value, pOutput_);
+}
+
+void Writer::value(boost::ulong_long_type value)
+{
+   beginValue();
+   appendInteger(value, pOutput_);
+}
+
+void Writer::value(double value)
+{
+   beginValue();
+
+   // json has no representation for inf/nan
+   if (!(boost::math::isfinite)(value))
+      pOutput_->append("null");
+   else
+   {
+      // same format as json_spirit (showpoint, precision 16) without
+      // constructing a stream for every value
+      char buffer[32];
+      int length = std::snprintf(buffer, sizeof(buffer), "%#.16g", value);
+      pOutput_->append(buffer, length);
+   }
+}
+
+void Writer::value(const json::Value& value)
+{
+   switch (value.type())
+   {
+      case json_spirit::obj_type:
+      {
+         startObject();
+         BOOST_FOREACH(const json::Member& member, value.get_obj())
+         {
+            key(member.first);
+            this->value(member.second);
+         }
+         endObject();
+         break;
+      }
+
+      case json_spirit::array_type:
+      {
+         startArray();
+         BOOST_FOREACH(const json::Value& element, value.get_array())
+         {
+            this->value(element);
+         }
+         endArray();
+         break;
+      }
+
+      case json_spirit::str_type:
+         this->value(value.get_str());
+         break;
+
+      case json_spirit::bool_type:
+         this->value(value.get_bool());
+         break;
+
+      case json_spirit::int_type:
+         if (value.is_uint64())
+            this->value(static_cast<boost::ulong_long_type>(value.get_uint64()));
+         else
+            this->value(static_cast<boost::long_long_type>(value.get_int64()));
+         break;
+
+      case json_spirit::real_type:
+         this->value(value.get_real());
+         break;
+
+      case json_spirit::null_type:
+      default:
+         nullValue();
+         break;
+   }
+}
+
+void Writer::nullValue()
+{
+   beginValue();
+   pOutput_->append("null");
+}
+
+void Writer::rawValue(const std::string& json)
+{
+   beginValue();
+   pOutput_->append(json);
+}
+
+void Writer::beginValue()
+{
+   // value for a key which was just written
+   if (expectingValue_)
+   {
+      expectingValue_ = false;
+      return;
+   }
+
+   // separate from previous array elements / object members
+   if (!levels_.empty())
+   {
+      if (levels_.back())
+         pOutput_->push_back(',');
+      else
+         levels_.back() = true;
+   }
+}
+
+void Writer::writeString(const char* value, std::size_t length)
+{
+   // escape the same characters as json_spirit (other characters, including
+   // utf8 sequences, are written verbatim)
+   pOutput_->push_back('"');
+   const char* begin = value;
+   const char* end = value + length;
+   for (const char* it = begin; it != end; ++it)
+   {
+      const char* escaped = NULL;
+      switch (*it)
+      {
+         case '"':  escaped = "\\\""; break;
+         case '\\': escaped = "\\\\"; break;
+         case '\b': escaped = "\\b";  break;
+         case '\f': escaped = "\\f";  break;
+         case '\n': escaped = "\\n";  break;
+         case '\r': escaped = "\\r";  break;
+         case '\t': escaped = "\\t";  break;
+         default:
+            continue;
+      }
+
+      pOutput_->append(begin, it);
+      pOutput_->append(escaped);
+      begin = it + 1;
+   }
+   pOutput_->append(begin, end);
+   pOutput_->push_back('"');
+}
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
+
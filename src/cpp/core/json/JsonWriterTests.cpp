@@ -0,0 +1,144 @@
+/*
+ * JsonWriterTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+#include <vector>
+#include <limits>
+
+#include <core/json/JsonWriter.hpp>
+#include <core/json/JsonRpc.hpp>
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+namespace {
+
+json::Value sampleValue()
+{
+   json::Object object;
+   object["string"] = "a \"quoted\" \\ string\nwith\ttabs";
+   object["utf8"] = "caf\xc3\xa9";
+   object["int"] = -42;
+   object["uint"] = static_cast<boost::uint64_t>(18446744073709551615ULL);
+   object["real"] = 0.5;
+   object["true"] = true;
+   object["false"] = false;
+   object["null"] = json::Value();
+
+   json::Array array;
+   array.push_back(1);
+   array.push_back("two");
+   array.push_back(json::Object());
+   array.push_back(json::Array());
+   object["array"] = array;
+
+   return object;
+}
+
+} // anonymous namespace
+
+context("JsonWriter")
+{
+   test_that("json values are written the same as json::write")
+   {
+      json::Value value = sampleValue();
+      json::Writer writer;
+      writer.value(value);
+      expect_true(writer.str() == json::write(value));
+   }
+
+   test_that("streamed output round trips through the parser")
+   {
+      std::vector<std::string> names;
+      names.push_back("first");
+      names.push_back("se\"cond");
+
+      json::Writer writer;
+      writer.startObject();
+      writer.member("count", static_cast<int>(names.size()));
+      writer.member("min", std::numeric_limits<int>::min());
+      writer.member("max", std::numeric_limits<boost::int64_t>::max());
+      writer.member("name", "x");
+      writer.key("names");
+      writer.array(names);
+      writer.key("empty");
+      writer.startArray();
+      writer.endArray();
+      writer.key("nested");
+      writer.startArray();
+      writer.startObject();
+      writer.endObject();
+      writer.nullValue();
+      writer.rawValue("[1,2]");
+      writer.endArray();
+      writer.endObject();
+
+      json::Value parsed;
+      expect_true(json::parse(writer.str(), &parsed));
+      expect_true(isType<json::Object>(parsed));
+
+      json::Object& object = parsed.get_obj();
+      expect_true(object["count"].get_int() == 2);
+      expect_true(object["min"].get_int() == std::numeric_limits<int>::min());
+      expect_true(object["max"].get_int64() ==
+                  std::numeric_limits<boost::int64_t>::max());
+      expect_true(object["name"].get_str() == "x");
+      expect_true(object["names"].get_array().size() == 2);
+      expect_true(object["names"].get_array()[1].get_str() == "se\"cond");
+      expect_true(object["empty"].get_array().empty());
+      expect_true(object["nested"].get_array().size() == 3);
+      expect_true(object["nested"].get_array()[2].get_array().size() == 2);
+   }
+
+   test_that("non-finite reals are written as null")
+   {
+      json::Writer writer;
+      writer.startArray();
+      writer.value(std::numeric_limits<double>::infinity());
+      writer.value(1.5);
+      writer.endArray();
+      expect_true(writer.str() == "[null,1.500000000000000]");
+   }
+
+   test_that("raw json-rpc results are spliced into the response")
+   {
+      json::Writer writer;
+      writer.value(sampleValue());
+
+      JsonRpcResponse rawResponse;
+      rawResponse.setRawResult(writer.str());
+      rawResponse.setField("ep", "false");
+
+      JsonRpcResponse response;
+      response.setResult(sampleValue());
+      response.setField("ep", "false");
+
+      std::ostringstream rawOstr, ostr;
+      rawResponse.write(rawOstr);
+      response.write(ostr);
+      expect_true(rawOstr.str() == ostr.str());
+
+      // result is materialized on demand
+      expect_true(rawResponse.result() == sampleValue());
+      expect_true(json::write(rawResponse.getRawResponse()) == ostr.str());
+   }
+}
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
@@ -31,6 +31,9 @@ namespace libclang {
 
 namespace {
 
+// default memory budget for translation units
+const std::size_t kDefaultMemoryLimit = 1024 * 1024 * 1024;
+
 inline unsigned applyTranslationUnitOptions(unsigned defaultOptions)
 {
    // for now just reflect back the defaults
@@ -63,6 +66,7 @@ bool SourceIndex::isHeaderFile(const FilePath& filePath)
 }
 
 SourceIndex::SourceIndex(CompilationDatabase compilationDB, int verbose)
+   : memoryLimit_(kDefaultMemoryLimit), memoryUsage_(0), useCounter_(0)
 {
    verbose_ = verbose;
    index_ = clang().createIndex(0, (verbose_ > 0) ? 1 : 0);
@@ -103,6 +107,7 @@ void SourceIndex::removeTranslationUnit(const std::string& filename)
       if (verbose_ > 0)
          std::cerr << "CLANG REMOVE INDEX: " << it->first << std::endl;
       clang().disposeTranslationUnit(it->second.tu);
+      memoryUsage_ -= it->second.memoryUsage;
       translationUnits_.erase(it->first);
    }
 }
@@ -119,6 +124,57 @@ void SourceIndex::removeAllTranslationUnits()
    }
 
    translationUnits_.clear();
+   memoryUsage_ = 0;
+}
+
+void SourceIndex::setMemoryLimit(std::size_t bytes)
+{
+   memoryLimit_ = bytes;
+   enforceMemoryLimit(std::string());
+}
+
+void SourceIndex::updateMemoryUsage(StoredTranslationUnit* pStored)
+{
+   memoryUsage_ -= pStored->memoryUsage;
+   pStored->memoryUsage = TranslationUnit(std::string(),
+                                          pStored->tu,
+                                          &unsavedFiles_).memoryUsage();
+   memoryUsage_ += pStored->memoryUsage;
+}
+
+void SourceIndex::enforceMemoryLimit(const std::string& excludeFilename)
+{
+   while (memoryLimit_ > 0 && memoryUsage_ > memoryLimit_)
+   {
+      // find the least recently used translation unit we can evict
+      TranslationUnits::const_iterator lruIt = translationUnits_.end();
+      for (TranslationUnits::const_iterator it = translationUnits_.begin();
+           it != translationUnits_.end(); ++it)
+      {
+         if (it->second.pinned || it->first == excludeFilename)
+            continue;
+
+         if (lruIt == translationUnits_.end() ||
+             it->second.lastUsed < lruIt->second.lastUsed)
+         {
+            lruIt = it;
+         }
+      }
+
+      if (lruIt == translationUnits_.end())
+         break;
+
+      if (verbose_ > 0)
+         std::cerr << "CLANG EVICT INDEX: " << lruIt->first << std::endl;
+      removeTranslationUnit(lruIt->first);
+   }
+}
+
+void SourceIndex::pinTranslationUnit(const std::string& filename)
+{
+   TranslationUnits::iterator it = translationUnits_.find(filename);
+   if (it != translationUnits_.end())
+      it->second.pinned = true;
 }
 
 
@@ -127,13 +183,19 @@ void SourceIndex::primeEditorTranslationUnit(const std::string& filename)
    // if we have no record of this translation unit then do a first pass
    if (translationUnits_.find(filename) == translationUnits_.end())
       getTranslationUnit(filename);
+
+   // keep it while it's being edited
+   pinTranslationUnit(filename);
 }
 
 void SourceIndex::reprimeEditorTranslationUnit(const std::string& filename)
 {
    // if we have already indexed this translation unit then re-index it
    if (translationUnits_.find(filename) != translationUnits_.end())
+   {
       getTranslationUnit(filename);
+      pinTranslationUnit(filename);
+   }
 }
 
 
@@ -173,12 +235,15 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
 
    // look it up
    TranslationUnits::iterator it = translationUnits_.find(filename);
+   bool pinned = false;
 
    // check for various incremental processing scenarios
    if (it != translationUnits_.end())
    {
       // alias record
       StoredTranslationUnit& stored = it->second;
+      stored.lastUsed = ++useCounter_;
+      pinned = stored.pinned;
 
       // already up to date?
       if (!alwaysReparse &&
@@ -215,6 +280,10 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
             // update last write time
             stored.lastWriteTime = lastWriteTime;
 
+            // the reparse may have changed its memory usage
+            updateMemoryUsage(&stored);
+            enforceMemoryLimit(filename);
+
             // return it
             return TranslationUnit(filename, stored.tu, &unsavedFiles_);
          }
@@ -256,9 +325,14 @@ TranslationUnit SourceIndex::getTranslationUnit(const std::string& filename,
    // save and return it if we succeeded
    if (tu != NULL)
    {
-      translationUnits_[filename] = StoredTranslationUnit(args,
-                                                          lastWriteTime,
-                                                          tu);
+      StoredTranslationUnit& stored = translationUnits_[filename];
+      stored = StoredTranslationUnit(args, lastWriteTime, tu);
+      stored.lastUsed = ++useCounter_;
+      stored.pinned = pinned;
+
+      // account for its memory (evicting others if necessary)
+      updateMemoryUsage(&stored);
+      enforceMemoryLimit(filename);
 
       TranslationUnit unit(filename, tu, &unsavedFiles_);
       if (verbose_ > 0)
@@ -147,31 +147,41 @@ boost::shared_ptr<CodeCompleteResults> TranslationUnit::codeCompleteAt(
    }
 }
 
-void TranslationUnit::printResourceUsage(std::ostream& ostr, bool detailed) const
+std::size_t TranslationUnit::memoryUsage() const
 {
    CXTUResourceUsage usage = clang().getCXTUResourceUsage(tu_);
 
-   unsigned long totalBytes = 0;
+   std::size_t totalBytes = 0;
    for (unsigned i = 0; i < usage.numEntries; i++)
    {
       CXTUResourceUsageEntry entry = usage.entries[i];
-
-      if (detailed)
-      {
-         ostr << clang().getTUResourceUsageName(entry.kind) << ": "
-              << formatBytes(entry.amount) << std::endl;
-      }
-
       if (entry.kind >= CXTUResourceUsage_MEMORY_IN_BYTES_BEGIN &&
           entry.kind <= CXTUResourceUsage_MEMORY_IN_BYTES_END)
       {
          totalBytes += entry.amount;
       }
    }
-   ostr << "TOTAL MEMORY: " << formatBytes(totalBytes)
-        << " (" << FilePath(getSpelling()).filename() << ")" << std::endl;
 
    clang().disposeCXTUResourceUsage(usage);
+   return totalBytes;
+}
+
+void TranslationUnit::printResourceUsage(std::ostream& ostr, bool detailed) const
+{
+   if (detailed)
+   {
+      CXTUResourceUsage usage = clang().getCXTUResourceUsage(tu_);
+      for (unsigned i = 0; i < usage.numEntries; i++)
+      {
+         CXTUResourceUsageEntry entry = usage.entries[i];
+         ostr << clang().getTUResourceUsageName(entry.kind) << ": "
+              << formatBytes(entry.amount) << std::endl;
+      }
+      clang().disposeCXTUResourceUsage(usage);
+   }
+
+   ostr << "TOTAL MEMORY: " << formatBytes(memoryUsage())
+        << " (" << FilePath(getSpelling()).filename() << ")" << std::endl;
 }
 
 
@@ -16,9 +16,13 @@
 #include <core/markdown/Markdown.hpp>
 
 #include <iostream>
+#include <list>
+#include <map>
+#include <vector>
 
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/regex.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -26,6 +30,9 @@
 
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
+#include <core/Hash.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
 #include <core/StringUtils.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/HtmlUtils.hpp>
@@ -41,18 +48,65 @@ namespace markdown {
 
 namespace {
 
+// sundown buffers start small and are grown repeatedly while rendering, so
+// rather than releasing them we keep a few (per thread) for reuse
+class BufferPool : boost::noncopyable
+{
+public:
+   ~BufferPool()
+   {
+      BOOST_FOREACH(buf* pBuff, buffers_)
+      {
+         ::bufrelease(pBuff);
+      }
+   }
+
+   buf* acquire(std::size_t unit)
+   {
+      if (buffers_.empty())
+         return ::bufnew(unit);
+
+      buf* pBuff = buffers_.back();
+      buffers_.pop_back();
+      pBuff->size = 0;
+      return pBuff;
+   }
+
+   void release(buf* pBuff)
+   {
+      // don't hold on to the memory of unusually large documents
+      const std::size_t kMaxBuffers = 4;
+      const std::size_t kMaxBufferSize = 4 * 1024 * 1024;
+      if (buffers_.size() < kMaxBuffers && pBuff->asize <= kMaxBufferSize)
+         buffers_.push_back(pBuff);
+      else
+         ::bufrelease(pBuff);
+   }
+
+private:
+   std::vector<buf*> buffers_;
+};
+
+BufferPool& bufferPool()
+{
+   static boost::thread_specific_ptr<BufferPool> s_pInstance;
+   if (s_pInstance.get() == NULL)
+      s_pInstance.reset(new BufferPool());
+   return *s_pInstance;
+}
+
 class SundownBuffer : boost::noncopyable
 {
 public:
    explicit SundownBuffer(std::size_t unit = 128)
       : pBuff_(NULL)
    {
-      pBuff_ = ::bufnew(unit);
+      pBuff_ = bufferPool().acquire(unit);
    }
 
    explicit SundownBuffer(const std::string& str)
    {
-      pBuff_ = ::bufnew(str.length());
+      pBuff_ = bufferPool().acquire(str.length());
       if (pBuff_ != NULL)
       {
          if (grow(str.length()) == BUF_OK)
@@ -61,7 +115,7 @@ public:
          }
          else
          {
-            ::bufrelease(pBuff_);
+            bufferPool().release(pBuff_);
             pBuff_ = NULL;
          }
       }
@@ -70,7 +124,7 @@ public:
    ~SundownBuffer()
    {
       if (pBuff_)
-         ::bufrelease(pBuff_);
+         bufferPool().release(pBuff_);
    }
 
    // COPYING: prohibited (boost::noncopyable)
@@ -206,6 +260,106 @@ Error renderMarkdown(const SundownBuffer& inputBuffer,
 }
 
 
+struct RenderedMarkdown
+{
+   RenderedMarkdown() : requiresMathJax(false) {}
+   std::string html;
+   bool requiresMathJax;
+};
+
+// the same documents (e.g. slides and help pages) tend to be rendered over
+// and over, so we keep the most recently rendered ones (keyed by a hash of
+// their content and the rendering options)
+class RenderCache : boost::noncopyable
+{
+public:
+   RenderCache() : size_(0) {}
+
+   bool get(const std::string& key, RenderedMarkdown* pRendered)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         Entries::iterator it = entries_.find(key);
+         if (it == entries_.end())
+            return false;
+
+         // move to the front of the lru list
+         lru_.splice(lru_.begin(), lru_, it->second.second);
+         *pRendered = it->second.first;
+         return true;
+      }
+      END_LOCK_MUTEX
+
+      return false;
+   }
+
+   void put(const std::string& key, const RenderedMarkdown& rendered)
+   {
+      const std::size_t kMaxSize = 8 * 1024 * 1024;
+      if (rendered.html.size() > kMaxSize / 8)
+         return;
+
+      LOCK_MUTEX(mutex_)
+      {
+         if (entries_.find(key) != entries_.end())
+            return;
+
+         lru_.push_front(key);
+         entries_[key] = std::make_pair(rendered, lru_.begin());
+         size_ += rendered.html.size();
+
+         // evict the least recently used documents
+         while (size_ > kMaxSize)
+         {
+            Entries::iterator it = entries_.find(lru_.back());
+            size_ -= it->second.first.html.size();
+            entries_.erase(it);
+            lru_.pop_back();
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+private:
+   typedef std::map<std::string,
+                    std::pair<RenderedMarkdown,
+                              std::list<std::string>::iterator> > Entries;
+   boost::mutex mutex_;
+   Entries entries_;
+   std::list<std::string> lru_;
+   std::size_t size_;
+};
+
+RenderCache& renderCache()
+{
+   static RenderCache instance;
+   return instance;
+}
+
+std::string renderCacheKey(const std::string& markdownInput,
+                           const Extensions& extensions,
+                           const HTMLOptions& options)
+{
+   bool flags[] = { extensions.noIntraEmphasis, extensions.tables,
+                    extensions.fencedCode, extensions.autolink,
+                    extensions.laxSpacing, extensions.spaceHeaders,
+                    extensions.strikethrough, extensions.superscript,
+                    extensions.ignoreMath, extensions.stripMetadata,
+                    extensions.htmlPreserve,
+                    options.useXHTML, options.hardWrap, options.smartypants,
+                    options.safelink, options.toc, options.skipHTML,
+                    options.skipStyle, options.skipImages, options.skipLinks,
+                    options.escape };
+
+   std::string key = hash::xxHash64Hex(markdownInput) + ":" +
+                     safe_convert::numberToString(markdownInput.size()) + ":";
+   BOOST_FOREACH(bool flag, flags)
+   {
+      key.push_back(flag ? '1' : '0');
+   }
+   return key;
+}
+
 void stripMetadata(std::string* pInput)
 {
    // split into lines
@@ -344,12 +498,13 @@ Error markdownToHTML(const FilePath& markdownFile,
    return markdownToHTML(markdownInput, extensions, options, pHTMLOutput);
 }
 
-// render markdown to HTML -- assumes UTF-8 encoding
-Error markdownToHTML(const std::string& markdownInput,
-                     const Extensions& extensions,
-                     const HTMLOptions& options,
-                     std::string* pHTMLOutput)
+namespace {
 
+Error renderMarkdownToHTML(const std::string& markdownInput,
+                           const Extensions& extensions,
+                           const HTMLOptions& options,
+                           std::string* pHTMLOutput,
+                           bool* pHasMath)
 {
    // exclude fenced code blocks
    using namespace rstudio::core::html_utils;
@@ -382,6 +537,10 @@ Error markdownToHTML(const std::string& markdownInput,
    if (extensions.stripMetadata)
       stripMetadata(&input);
 
+   // note whether there's math before it's restored (at which point
+   // we'll know if mathjax is required without searching the output)
+   *pHasMath = pMathFilter && pMathFilter->hasMath();
+
    // special case of empty input after stripping metadata
    if (input.empty())
    {
@@ -461,6 +620,56 @@ Error markdownToHTML(const std::string& markdownInput,
    return Success();
 }
 
+} // anonymous namespace
+
+// render markdown to HTML -- assumes UTF-8 encoding
+Error markdownToHTML(const std::string& markdownInput,
+                     const Extensions& extensions,
+                     const HTMLOptions& options,
+                     std::string* pHTMLOutput)
+{
+   return markdownToHTML(markdownInput,
+                         extensions,
+                         options,
+                         pHTMLOutput,
+                         NULL);
+}
+
+// render markdown to HTML -- assumes UTF-8 encoding
+Error markdownToHTML(const std::string& markdownInput,
+                     const Extensions& extensions,
+                     const HTMLOptions& options,
+                     std::string* pHTMLOutput,
+                     bool* pRequiresMathJax)
+{
+   std::string key = renderCacheKey(markdownInput, extensions, options);
+
+   RenderedMarkdown rendered;
+   if (!renderCache().get(key, &rendered))
+   {
+      bool hasMath = false;
+      Error error = renderMarkdownToHTML(markdownInput,
+                                         extensions,
+                                         options,
+                                         &rendered.html,
+                                         &hasMath);
+      if (error)
+         return error;
+
+      // math found while rendering implies mathjax (otherwise we still need
+      // to check for math within e.g. raw html)
+      rendered.requiresMathJax = hasMath || isMathJaxRequired(rendered.html);
+
+      renderCache().put(key, rendered);
+   }
+
+   pHTMLOutput->append(rendered.html);
+   if (pRequiresMathJax)
+      *pRequiresMathJax = rendered.requiresMathJax;
+
+   return Success();
+}
+
 bool isMathJaxRequired(const std::string& htmlOutput)
 {
    return requiresMathjax(htmlOutput);
@@ -0,0 +1,79 @@
+/*
+ * MarkdownTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+
+#include <core/Error.hpp>
+#include <core/markdown/Markdown.hpp>
+
+namespace rstudio {
+namespace core {
+namespace markdown {
+
+context("Markdown")
+{
+   test_that("repeated renders give the same output")
+   {
+      std::string first, second;
+      expect_false(markdownToHTML("# Title\n\nSome *text*.\n",
+                                  Extensions(),
+                                  HTMLOptions(),
+                                  &first));
+      expect_false(markdownToHTML("# Title\n\nSome *text*.\n",
+                                  Extensions(),
+                                  HTMLOptions(),
+                                  &second));
+      expect_true(first == second);
+      expect_true(first.find("<em>text</em>") != std::string::npos);
+
+      // different options aren't served from the cache
+      HTMLOptions options;
+      options.toc = true;
+      std::string withToc;
+      expect_false(markdownToHTML("# Title\n\nSome *text*.\n",
+                                  Extensions(),
+                                  options,
+                                  &withToc));
+      expect_true(withToc.find("id=\"toc_0\"") != std::string::npos);
+   }
+
+   test_that("math is detected while rendering")
+   {
+      std::string html;
+      bool requiresMathJax = false;
+      expect_false(markdownToHTML("Inline $x^2$ math.\n",
+                                  Extensions(),
+                                  HTMLOptions(),
+                                  &html,
+                                  &requiresMathJax));
+      expect_true(requiresMathJax);
+      expect_true(isMathJaxRequired(html));
+
+      html.clear();
+      expect_false(markdownToHTML("No math here.\n",
+                                  Extensions(),
+                                  HTMLOptions(),
+                                  &html,
+                                  &requiresMathJax));
+      expect_false(requiresMathJax);
+      expect_false(isMathJaxRequired(html));
+   }
+}
+
+} // namespace markdown
+} // namespace core
+} // namespace rstudio
@@ -225,6 +225,15 @@ void MathJaxFilter::restore(
 
 bool requiresMathjax(const std::string& htmlOutput)
 {
+   // check for the delimiters before running any regexes (most documents
+   // don't contain any math at all)
+   if (htmlOutput.find("\\(") == std::string::npos &&
+       htmlOutput.find("\\[") == std::string::npos &&
+       htmlOutput.find("<math") == std::string::npos)
+   {
+      return false;
+   }
+
    boost::regex inlineMathRegex("\\\\\\(([\\s\\S]+?)\\\\\\)");
    if (boost::regex_search(htmlOutput, inlineMathRegex))
       return true;
@@ -47,6 +47,12 @@ public:
                  std::string* pHTMLOutput);
    ~MathJaxFilter();
 
+   // was any math found in the input?
+   bool hasMath() const
+   {
+      return !displayMathBlocks_.empty() || !inlineMathBlocks_.empty();
+   }
+
 private:
    void filter(const boost::regex& re,
                std::string* pInput,
@@ -22,6 +22,8 @@
 #include <core/StringUtils.hpp>
 #include <core/FileSerializer.hpp>
 
+#include <core/json/Json.hpp>
+
 #include <core/system/System.hpp>
 #include <core/system/FileMonitor.hpp>
 
@@ -35,6 +37,95 @@ namespace r_util {
 
 namespace {
 
+// all of a session's properties are also kept in a single index file so
+// that listing sessions reads one file per session rather than one per
+// property (which adds up on network file systems). the individual
+// property files remain the reference for readers of a single property
+const char* const kPropertyIndex = ".index";
+
+bool readPropertyIndex(const FilePath& propertiesPath,
+                       std::map<std::string, std::string>* pProperties)
+{
+   FilePath indexPath = propertiesPath.childPath(kPropertyIndex);
+   if (!indexPath.exists())
+      return false;
+
+   std::string contents;
+   Error error = core::readStringFromFile(indexPath, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   json::Value value;
+   if (!json::parse(contents, &value) || !json::isType<json::Object>(value))
+      return false;
+
+   const json::Object& index = value.get_obj();
+   for (json::Object::const_iterator it = index.begin();
+        it != index.end(); ++it)
+   {
+      if (json::isType<std::string>(it->second))
+         (*pProperties)[it->first] = it->second.get_str();
+   }
+   return true;
+}
+
+// read the individual property files (for sessions created before the
+// index was introduced or whose index is damaged)
+void readPropertyFiles(const FilePath& propertiesPath,
+                       std::map<std::string, std::string>* pProperties)
+{
+   std::vector<FilePath> children;
+   Error error = propertiesPath.children(&children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   BOOST_FOREACH(const FilePath& child, children)
+   {
+      // skip the index and its temporary files
+      if (boost::algorithm::starts_with(child.filename(), "."))
+         continue;
+
+      std::string value;
+      error = core::readStringFromFile(child, &value);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+      (*pProperties)[child.filename()] = boost::algorithm::trim_copy(value);
+   }
+}
+
+void writePropertyIndex(const FilePath& propertiesPath,
+                        const std::map<std::string, std::string>& properties)
+{
+   json::Object index;
+   for (std::map<std::string, std::string>::const_iterator it =
+           properties.begin(); it != properties.end(); ++it)
+   {
+      index[it->first] = it->second;
+   }
+
+   // write to a temporary file and move it into place so that readers
+   // never see a partially written index
+   FilePath tempPath = propertiesPath.childPath(
+            std::string(kPropertyIndex) + "." +
+            core::system::generateShortenedUuid());
+   Error error = core::writeStringToFile(tempPath, json::write(index));
+   if (!error)
+      error = tempPath.move(propertiesPath.childPath(kPropertyIndex));
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempPath.removeIfExists();
+   }
+}
 
 } // anonymous namespace
 
@@ -46,11 +137,31 @@ void ActiveSession::writeProperty(const std::string& name,
    Error error = core::writeStringToFile(propertyFile, value);
    if (error)
       LOG_ERROR(error);
+
+   std::string trimmedValue = boost::algorithm::trim_copy(value);
+   if (propertiesLoaded_)
+      properties_[name] = trimmedValue;
+
+   // update the index (re-reading it first so that we don't revert
+   // properties written by other processes since we last read it)
+   std::map<std::string, std::string> properties;
+   if (!readPropertyIndex(propertiesPath_, &properties))
+      readPropertyFiles(propertiesPath_, &properties);
+   properties[name] = trimmedValue;
+   writePropertyIndex(propertiesPath_, properties);
 }
 
 std::string ActiveSession::readProperty(const std::string& name) const
 {
    using namespace rstudio::core;
+
+   if (propertiesLoaded_)
+   {
+      std::map<std::string, std::string>::const_iterator it =
+                                                   properties_.find(name);
+      return it != properties_.end() ? it->second : std::string();
+   }
+
    FilePath readPath = propertiesPath_.childPath(name);
    if (readPath.exists())
    {
@@ -69,6 +180,22 @@ std::string ActiveSession::readProperty(const std::string& name) const
    }
 }
 
+void ActiveSession::loadProperties() const
+{
+   if (propertiesLoaded_ || empty())
+      return;
+
+   if (!readPropertyIndex(propertiesPath_, &properties_))
+   {
+      properties_.clear();
+      readPropertyFiles(propertiesPath_, &properties_);
+      if (!properties_.empty())
+         writePropertyIndex(propertiesPath_, properties_);
+   }
+
+   propertiesLoaded_ = true;
+}
+
 Error ActiveSessions::create(const std::string& project,
                              const std::string& workingDir,
                              std::string* pId) const
@@ -156,6 +283,10 @@ std::vector<boost::shared_ptr<ActiveSession> > ActiveSessions::list(
          boost::shared_ptr<ActiveSession> pSession = get(id);
          if (!pSession->empty())
          {
+            // validation and sorting read several properties of each
+            // session so read them all at once
+            pSession->loadProperties();
+
             if (pSession->validate(userHomePath, projectSharingEnabled))
             {
                sessions.push_back(pSession);
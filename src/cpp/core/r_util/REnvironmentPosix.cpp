@@ -28,6 +28,8 @@
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
 #include <core/ConfigUtils.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/json/JsonRpc.hpp>
 #include <core/system/System.hpp>
 #include <core/system/Process.hpp>
 #include <core/system/Environment.hpp>
@@ -684,6 +686,255 @@ bool detectREnvironment(const FilePath& whichRScript,
 }
 
 
+namespace {
+
+// files whose modification invalidates a cached R environment
+std::vector<FilePath> rEnvironmentStampFiles(const std::string& rScriptPath,
+                                             const FilePath& ldPathsScript,
+                                             const EnvironmentVars& vars)
+{
+   std::vector<FilePath> files;
+   files.push_back(FilePath(rScriptPath));
+   files.push_back(ldPathsScript);
+   for (EnvironmentVars::const_iterator it = vars.begin();
+        it != vars.end();
+        ++it)
+   {
+      if (it->first == "R_HOME")
+         files.push_back(FilePath(it->second).complete("etc/ldpaths"));
+   }
+   return files;
+}
+
+boost::int64_t stampOf(const FilePath& file)
+{
+   return (!file.empty() && file.exists()) ? file.lastWriteTime() : 0;
+}
+
+std::string rEnvironmentCacheKey(const FilePath& whichRScript,
+                                 const FilePath& ldPathsScript,
+                                 const std::string& ldLibraryPath)
+{
+   return whichRScript.absolutePath() + "\n" +
+          ldPathsScript.absolutePath() + "\n" +
+          ldLibraryPath;
+}
+
+json::Object readREnvironmentCache(const FilePath& cacheFile)
+{
+   if (!cacheFile.exists())
+      return json::Object();
+
+   std::string contents;
+   Error error = readStringFromFile(cacheFile, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return json::Object();
+   }
+
+   // an unreadable cache is simply discarded
+   json::Value value;
+   if (!json::parse(contents, &value) || !json::isType<json::Object>(value))
+      return json::Object();
+
+   return value.get_obj();
+}
+
+bool readCachedREnvironment(const json::Object& cache,
+                            const std::string& key,
+                            const FilePath& ldPathsScript,
+                            std::string* pRScriptPath,
+                            std::string* pVersion,
+                            EnvironmentVars* pVars)
+{
+   json::Object::const_iterator it = cache.find(key);
+   if (it == cache.end() || !json::isType<json::Object>(it->second))
+      return false;
+   const json::Object& entry = it->second.get_obj();
+
+   std::string rScriptPath, version;
+   json::Array varsJson, stamps;
+   Error error = json::readObject(entry,
+                                  "r_script", &rScriptPath,
+                                  "version", &version,
+                                  "vars", &varsJson,
+                                  "stamps", &stamps);
+   if (error)
+      return false;
+
+   // malformed entries are ignored
+   EnvironmentVars vars;
+   for (json::Array::const_iterator var = varsJson.begin();
+        var != varsJson.end();
+        ++var)
+   {
+      if (!json::isType<json::Array>(*var))
+         return false;
+      const json::Array& pair = var->get_array();
+      if (pair.size() != 2 ||
+          !json::isType<std::string>(pair[0]) ||
+          !json::isType<std::string>(pair[1]))
+      {
+         return false;
+      }
+      vars.push_back(std::make_pair(pair[0].get_str(), pair[1].get_str()));
+   }
+
+   // the entry is stale if any of the files it was derived from have been
+   // modified since
+   std::vector<FilePath> files =
+            rEnvironmentStampFiles(rScriptPath, ldPathsScript, vars);
+   if (stamps.size() != files.size())
+      return false;
+   for (std::size_t i = 0; i < files.size(); i++)
+   {
+      if (!json::isType<int>(stamps[i]) ||
+          stamps[i].get_int64() != stampOf(files[i]))
+      {
+         return false;
+      }
+   }
+
+   *pRScriptPath = rScriptPath;
+   *pVersion = version;
+   *pVars = vars;
+   return true;
+}
+
+void writeCachedREnvironment(const FilePath& cacheFile,
+                             const std::string& key,
+                             const FilePath& ldPathsScript,
+                             const std::string& rScriptPath,
+                             const std::string& version,
+                             const EnvironmentVars& vars)
+{
+   json::Array varsJson;
+   for (EnvironmentVars::const_iterator it = vars.begin();
+        it != vars.end();
+        ++it)
+   {
+      json::Array pair;
+      pair.push_back(it->first);
+      pair.push_back(it->second);
+      varsJson.push_back(pair);
+   }
+
+   json::Array stamps;
+   std::vector<FilePath> files =
+            rEnvironmentStampFiles(rScriptPath, ldPathsScript, vars);
+   for (std::size_t i = 0; i < files.size(); i++)
+      stamps.push_back(stampOf(files[i]));
+
+   json::Object entry;
+   entry["r_script"] = rScriptPath;
+   entry["version"] = version;
+   entry["vars"] = varsJson;
+   entry["stamps"] = stamps;
+
+   // nothing to do if the cache is already current (as it is when
+   // revalidating an environment that hasn't changed)
+   json::Object cache = readREnvironmentCache(cacheFile);
+   json::Object::const_iterator it = cache.find(key);
+   if (it != cache.end() && it->second == json::Value(entry))
+      return;
+   cache[key] = entry;
+
+   // write to a temporary file and move it into place so that readers
+   // never see a partially written cache
+   Error error = cacheFile.parent().ensureDirectory();
+   if (!error)
+   {
+      FilePath tempFile(cacheFile.absolutePath() + ".tmp");
+      error = writeStringToFile(tempFile, json::write(cache));
+      if (!error)
+         error = tempFile.move(cacheFile);
+   }
+   if (error)
+      LOG_ERROR(error);
+}
+
+} // anonymous namespace
+
+bool detectREnvironmentCached(const FilePath& cacheFile,
+                              const FilePath& whichRScript,
+                              const FilePath& ldPathsScript,
+                              const std::string& ldLibraryPath,
+                              std::string* pRScriptPath,
+                              std::string* pVersion,
+                              EnvironmentVars* pVars,
+                              std::string* pErrMsg,
+                              bool* pFromCache)
+{
+   std::string key = rEnvironmentCacheKey(whichRScript,
+                                          ldPathsScript,
+                                          ldLibraryPath);
+
+   // without an override, the cached environment is only valid if it's
+   // for the R currently on the path (asking which is cheap next to
+   // running R)
+   std::string errMsg;
+   FilePath expectedRScript = !whichRScript.empty() ?
+                                 whichRScript : systemDefaultRScript(&errMsg);
+
+   if (!expectedRScript.empty() &&
+       readCachedREnvironment(readREnvironmentCache(cacheFile),
+                              key,
+                              ldPathsScript,
+                              pRScriptPath,
+                              pVersion,
+                              pVars) &&
+       *pRScriptPath == expectedRScript.absolutePath())
+   {
+      if (pFromCache)
+         *pFromCache = true;
+      return true;
+   }
+
+   if (pFromCache)
+      *pFromCache = false;
+   return refreshREnvironmentCache(cacheFile,
+                                   whichRScript,
+                                   ldPathsScript,
+                                   ldLibraryPath,
+                                   pRScriptPath,
+                                   pVersion,
+                                   pVars,
+                                   pErrMsg);
+}
+
+bool refreshREnvironmentCache(const FilePath& cacheFile,
+                              const FilePath& whichRScript,
+                              const FilePath& ldPathsScript,
+                              const std::string& ldLibraryPath,
+                              std::string* pRScriptPath,
+                              std::string* pVersion,
+                              EnvironmentVars* pVars,
+                              std::string* pErrMsg)
+{
+   if (!detectREnvironment(whichRScript,
+                           ldPathsScript,
+                           ldLibraryPath,
+                           pRScriptPath,
+                           pVersion,
+                           pVars,
+                           pErrMsg))
+   {
+      return false;
+   }
+
+   writeCachedREnvironment(cacheFile,
+                           rEnvironmentCacheKey(whichRScript,
+                                                ldPathsScript,
+                                                ldLibraryPath),
+                           ldPathsScript,
+                           *pRScriptPath,
+                           *pVersion,
+                           *pVars);
+   return true;
+}
+
+
 void setREnvironmentVars(const EnvironmentVars& vars)
 {
    for (EnvironmentVars::const_iterator it = vars.begin();
@@ -0,0 +1,304 @@
+/*
+ * RProfParser.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/r_util/RProfParser.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/SafeConvert.hpp>
+
+// Rprof output consists of a header line, e.g.
+//
+//    line profiling: sample.interval=20000
+//
+// followed by a line per sample listing the calls on the stack from the
+// innermost outwards. with line profiling, "#File n: path" lines name the
+// files and a file#line token preceding a call gives the line executing
+// within it. with memory profiling each sample is prefixed by
+// :a:b:c:d: memory fields
+//
+//    #File 1: analysis.R
+//    1#4 "mean" 1#12 "summarize" "lapply"
+
+namespace rstudio {
+namespace core {
+namespace r_util {
+
+namespace {
+
+struct Frame
+{
+   Frame() : line(-1, -1) {}
+   std::string name;
+   RProfLine line;
+};
+
+bool isDigit(char ch)
+{
+   return ch >= '0' && ch <= '9';
+}
+
+// parse a file#line token at pos (advancing pos past it)
+bool parseLineToken(const std::string& text,
+                    std::string::size_type* pPos,
+                    RProfLine* pLine)
+{
+   std::string::size_type pos = *pPos;
+   std::string::size_type hash = text.find('#', pos);
+   if (hash == std::string::npos)
+      return false;
+
+   std::string::size_type end = text.find(' ', hash);
+   if (end == std::string::npos)
+      end = text.size();
+
+   int file = safe_convert::stringTo<int>(text.substr(pos, hash - pos), -1);
+   int line = safe_convert::stringTo<int>(
+                              text.substr(hash + 1, end - hash - 1), -1);
+   *pPos = end;
+   if (file < 1 || line < 1)
+      return false;
+
+   // files are numbered from 1
+   *pLine = RProfLine(file - 1, line);
+   return true;
+}
+
+json::Object nodeAsJson(const RProfNode& node,
+                        const std::vector<std::string>& files,
+                        std::size_t minSamples)
+{
+   json::Object object;
+   object["name"] = node.name;
+   object["total"] = static_cast<int>(node.total);
+   object["self"] = static_cast<int>(node.self);
+
+   if (!node.lines.empty())
+   {
+      json::Array lines;
+      for (std::map<RProfLine, std::size_t>::const_iterator it =
+              node.lines.begin(); it != node.lines.end(); ++it)
+      {
+         json::Object line;
+         line["file"] = it->first.first;
+         line["line"] = it->first.second;
+         line["samples"] = static_cast<int>(it->second);
+         lines.push_back(line);
+      }
+      object["lines"] = lines;
+   }
+
+   json::Array children;
+   for (std::map<std::string, boost::shared_ptr<RProfNode> >::const_iterator
+           it = node.children.begin(); it != node.children.end(); ++it)
+   {
+      if (it->second->total >= minSamples)
+         children.push_back(nodeAsJson(*it->second, files, minSamples));
+   }
+   object["children"] = children;
+
+   return object;
+}
+
+} // anonymous namespace
+
+RProfParser::RProfParser()
+   : intervalMicros_(20000), lineProfiling_(false)
+{
+}
+
+void RProfParser::parse(const char* begin, const char* end)
+{
+   const char* pos = begin;
+   while (pos < end)
+   {
+      const char* newline = std::find(pos, end, '\n');
+      if (newline == end)
+      {
+         partialLine_.append(pos, end);
+         break;
+      }
+
+      if (partialLine_.empty())
+      {
+         parseLine(std::string(pos, newline));
+      }
+      else
+      {
+         partialLine_.append(pos, newline);
+         parseLine(partialLine_);
+         partialLine_.clear();
+      }
+
+      pos = newline + 1;
+   }
+}
+
+void RProfParser::parseLine(const std::string& line)
+{
+   if (line.empty())
+      return;
+
+   // file names
+   if (boost::algorithm::starts_with(line, "#File "))
+   {
+      std::string::size_type colon = line.find(": ");
+      if (colon == std::string::npos)
+         return;
+
+      int index = safe_convert::stringTo<int>(line.substr(6, colon - 6), 0);
+      if (index < 1)
+         return;
+      if (files_.size() < static_cast<std::size_t>(index))
+         files_.resize(index);
+      files_[index - 1] = line.substr(colon + 2);
+      return;
+   }
+
+   // header
+   std::string::size_type interval = line.find("sample.interval=");
+   if (interval != std::string::npos)
+   {
+      intervalMicros_ = safe_convert::stringTo<int>(
+                  line.substr(interval + std::strlen("sample.interval=")),
+                  intervalMicros_);
+      lineProfiling_ = line.find("line profiling") != std::string::npos;
+      return;
+   }
+
+   parseSample(line);
+}
+
+void RProfParser::parseSample(const std::string& line)
+{
+   std::string::size_type pos = 0;
+
+   // skip memory profiling fields
+   if (line[0] == ':')
+   {
+      for (int i = 0; i < 5 && pos != std::string::npos; i++)
+         pos = line.find(':', i == 0 ? 0 : pos + 1);
+      if (pos == std::string::npos)
+         return;
+      pos++;
+   }
+
+   // read the frames (innermost first); a line token applies to the call
+   // which follows it
+   std::vector<Frame> frames;
+   RProfLine pendingLine(-1, -1);
+   while (pos < line.size())
+   {
+      char ch = line[pos];
+      if (ch == ' ')
+      {
+         pos++;
+      }
+      else if (ch == '"')
+      {
+         std::string::size_type close = line.find('"', pos + 1);
+         if (close == std::string::npos)
+            close = line.size();
+
+         Frame frame;
+         frame.name = line.substr(pos + 1, close - pos - 1);
+         frame.line = pendingLine;
+         frames.push_back(frame);
+         pendingLine = RProfLine(-1, -1);
+         pos = close + 1;
+      }
+      else if (isDigit(ch))
+      {
+         RProfLine parsed;
+         if (parseLineToken(line, &pos, &parsed))
+            pendingLine = parsed;
+      }
+      else
+      {
+         // unexpected token (skip it)
+         pos = line.find(' ', pos);
+      }
+   }
+
+   // add to the tree (outermost first)
+   root_.total++;
+   RProfNode* pNode = &root_;
+   std::set<RProfLine> sampleLines;
+   for (std::vector<Frame>::const_reverse_iterator it = frames.rbegin();
+        it != frames.rend(); ++it)
+   {
+      boost::shared_ptr<RProfNode>& pChild = pNode->children[it->name];
+      if (!pChild)
+      {
+         pChild.reset(new RProfNode());
+         pChild->name = it->name;
+      }
+      pNode = pChild.get();
+      pNode->total++;
+
+      if (it->line.first >= 0)
+      {
+         pNode->lines[it->line]++;
+         sampleLines.insert(it->line);
+      }
+   }
+   pNode->self++;
+
+   // a line may appear several times in a sample (e.g. recursion)
+   for (std::set<RProfLine>::const_iterator it = sampleLines.begin();
+        it != sampleLines.end(); ++it)
+   {
+      lineSamples_[*it]++;
+   }
+}
+
+json::Object RProfParser::toJson(double minFraction) const
+{
+   json::Object result;
+   result["interval_us"] = intervalMicros_;
+   result["samples"] = static_cast<int>(sampleCount());
+   result["line_profiling"] = lineProfiling_;
+
+   json::Array files;
+   for (std::size_t i = 0; i < files_.size(); i++)
+      files.push_back(files_[i]);
+   result["files"] = files;
+
+   json::Array lines;
+   for (std::map<RProfLine, std::size_t>::const_iterator it =
+           lineSamples_.begin(); it != lineSamples_.end(); ++it)
+   {
+      json::Object line;
+      line["file"] = it->first.first;
+      line["line"] = it->first.second;
+      line["samples"] = static_cast<int>(it->second);
+      lines.push_back(line);
+   }
+   result["lines"] = lines;
+
+   std::size_t minSamples = std::max<std::size_t>(
+            1, static_cast<std::size_t>(minFraction * sampleCount()));
+   result["tree"] = nodeAsJson(root_, files_, minSamples);
+
+   return result;
+}
+
+} // namespace r_util
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,135 @@
+/*
+ * RProfParserTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/r_util/RProfParser.hpp>
+
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace r_util {
+
+namespace {
+
+const char* const kLineProfile =
+      "line profiling: sample.interval=10000\n"
+      "#File 1: analysis.R\n"
+      "1#4 \"mean\" 1#12 \"summarize\" \"lapply\"\n"
+      "1#4 \"mean\" 1#12 \"summarize\" \"lapply\"\n"
+      "1#13 \"summarize\" \"lapply\"\n"
+      "\"lapply\"\n";
+
+const RProfNode* child(const RProfNode& node, const std::string& name)
+{
+   std::map<std::string, boost::shared_ptr<RProfNode> >::const_iterator it =
+         node.children.find(name);
+   return it != node.children.end() ? it->second.get() : NULL;
+}
+
+} // anonymous namespace
+
+context("RProfParser")
+{
+   test_that("Samples are aggregated into a call tree")
+   {
+      RProfParser parser;
+      parser.parse(kLineProfile);
+
+      expect_true(parser.intervalMicros() == 10000);
+      expect_true(parser.lineProfiling());
+      expect_true(parser.sampleCount() == 4);
+      expect_true(parser.files().size() == 1);
+      expect_true(parser.files()[0] == "analysis.R");
+
+      const RProfNode* pLapply = child(parser.root(), "lapply");
+      expect_true(pLapply != NULL);
+      expect_true(pLapply->total == 4);
+      expect_true(pLapply->self == 1);
+
+      const RProfNode* pSummarize = child(*pLapply, "summarize");
+      expect_true(pSummarize != NULL);
+      expect_true(pSummarize->total == 3);
+      expect_true(pSummarize->self == 1);
+      expect_true(pSummarize->lines.size() == 2);
+      expect_true(pSummarize->lines.find(RProfLine(0, 12))->second == 2);
+      expect_true(pSummarize->lines.find(RProfLine(0, 13))->second == 1);
+
+      const RProfNode* pMean = child(*pSummarize, "mean");
+      expect_true(pMean != NULL);
+      expect_true(pMean->total == 2);
+      expect_true(pMean->self == 2);
+   }
+
+   test_that("Lines are counted once per sample")
+   {
+      RProfParser parser;
+      parser.parse("line profiling: sample.interval=10000\n"
+                   "#File 1: fib.R\n"
+                   "1#2 \"fib\" 1#2 \"fib\"\n");
+
+      expect_true(parser.lineSamples().size() == 1);
+      expect_true(parser.lineSamples().find(RProfLine(0, 2))->second == 1);
+   }
+
+   test_that("Input may be split at any point")
+   {
+      std::string profile(kLineProfile);
+      for (std::size_t split = 0; split <= profile.size(); split++)
+      {
+         RProfParser parser;
+         parser.parse(profile.substr(0, split));
+         parser.parse(profile.substr(split));
+         expect_true(parser.sampleCount() == 4);
+         expect_true(parser.lineSamples().size() == 3);
+      }
+   }
+
+   test_that("Memory profiling fields are skipped")
+   {
+      RProfParser parser;
+      parser.parse("memory profiling: sample.interval=20000\n"
+                   ":123:456:789:0:\"f\" \"g\"\n");
+
+      expect_true(parser.intervalMicros() == 20000);
+      expect_false(parser.lineProfiling());
+      const RProfNode* pG = child(parser.root(), "g");
+      expect_true(pG != NULL);
+      expect_true(child(*pG, "f") != NULL);
+   }
+
+   test_that("Small calls are pruned from the json tree")
+   {
+      RProfParser parser;
+      parser.parse(kLineProfile);
+
+      json::Object profile = parser.toJson(0.5);
+      expect_true(profile["samples"].get_int() == 4);
+
+      json::Object lapply =
+            profile["tree"].get_obj()["children"].get_array()[0].get_obj();
+      json::Object summarize = lapply["children"].get_array()[0].get_obj();
+      expect_true(summarize["name"].get_str() == "summarize");
+      expect_true(summarize["children"].get_array().size() == 1);
+
+      profile = parser.toJson(0.75);
+      lapply = profile["tree"].get_obj()["children"].get_array()[0].get_obj();
+      summarize = lapply["children"].get_array()[0].get_obj();
+      expect_true(summarize["children"].get_array().empty());
+   }
+}
+
+} // namespace r_util
+} // namespace core
+} // namespace rstudio
@@ -104,6 +104,8 @@ json::Object sessionLaunchProfileToJson(const SessionLaunchProfile& profile)
    configJson["niceLimit"] = toJson(profile.config.limits.niceLimit);
    configJson["filesLimit"] = toJson(profile.config.limits.filesLimit);
    configJson["cpuAffinity"] = json::toJsonArray(profile.config.limits.cpuAffinity);
+   configJson["cpuCgroup"] = profile.config.limits.cpuCgroup;
+   configJson["cpuWeight"] = profile.config.limits.cpuWeight;
    profileJson["config"] = configJson;
    return profileJson;
 }
@@ -165,6 +167,18 @@ SessionLaunchProfile sessionLaunchProfileFromJson(
       LOG_ERROR(error);
    }
 
+   // read cpu cgroup (not present in profiles from earlier versions)
+   std::string cpuCgroup;
+   int cpuWeight = 0;
+   if (configJson.find("cpuCgroup") != configJson.end())
+   {
+      error = json::readObject(configJson,
+                               "cpuCgroup", &cpuCgroup,
+                               "cpuWeight", &cpuWeight);
+      if (error)
+         LOG_ERROR(error);
+   }
+
    // populate config
    profile.config.args = json::optionsFromJson(argsJson);
    profile.config.environment = json::optionsFromJson(envJson);
@@ -179,6 +193,8 @@ SessionLaunchProfile sessionLaunchProfileFromJson(
    profile.config.limits.niceLimit = niceLimit;
    profile.config.limits.filesLimit = filesLimit;
    profile.config.limits.cpuAffinity = cpuAffinity;
+   profile.config.limits.cpuCgroup = cpuCgroup;
+   profile.config.limits.cpuWeight = cpuWeight;
 
    // return profile
    return profile;
@@ -16,6 +16,7 @@
 #define RSTUDIO_DEBUG_LABEL "source_index"
 // #define RSTUDIO_ENABLE_DEBUG_MACROS
 
+#include <cstring>
 #include <iostream>
 
 #include <core/StringUtils.hpp>
@@ -446,8 +447,12 @@ std::vector<Indexer> makeIndexers()
 
 }  // anonymous namespace
 
-RSourceIndex::RSourceIndex(const std::string& context, const std::string& code)
-   : context_(context)
+RSourceIndex::RSourceIndex(const std::string& context,
+                           const std::string& code,
+                           bool publishInferredPackages)
+   : context_(context),
+     nameOffsets_(1, 0),
+     publishInferredPackages_(publishInferredPackages)
 {
    static std::vector<Indexer> indexers = makeIndexers();
    
@@ -476,6 +481,117 @@ RSourceIndex::RSourceIndex(const std::string& context, const std::string& code)
    
 }
 
+RSourceIndex::RSourceIndex(const std::string& context,
+                           const std::vector<RSourceItem>& items,
+                           const std::vector<std::string>& inferredPackages)
+   : context_(context),
+     items_(items),
+     nameOffsets_(1, 0),
+     publishInferredPackages_(true)
+{
+   BOOST_FOREACH(const RSourceItem& item, items_)
+   {
+      addName(item.name());
+   }
+
+   BOOST_FOREACH(const std::string& package, inferredPackages)
+   {
+      addInferredPackage(package);
+   }
+}
+
+namespace {
+
+inline char toLowerAscii(char ch)
+{
+   return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+bool startsWith(const char* name, std::size_t nameLength,
+                const std::string& term)
+{
+   return nameLength >= term.length() &&
+          std::memcmp(name, term.data(), term.length()) == 0;
+}
+
+bool isSubsequence(const char* name, std::size_t nameLength,
+                   const std::string& term)
+{
+   std::size_t nameIdx = 0;
+   for (std::size_t i = 0; i < term.length(); ++i)
+   {
+      const void* pFound = std::memchr(name + nameIdx,
+                                       term[i],
+                                       nameLength - nameIdx);
+      if (pFound == NULL)
+         return false;
+      nameIdx = static_cast<const char*>(pFound) - name + 1;
+   }
+   return true;
+}
+
+} // anonymous namespace
+
+std::size_t RSourceIndex::memoryUsage() const
+{
+   std::size_t bytes = sizeof(*this) +
+                       context_.capacity() +
+                       items_.capacity() * sizeof(RSourceItem) +
+                       lowerNames_.capacity() +
+                       nameOffsets_.capacity() * sizeof(std::size_t);
+   BOOST_FOREACH(const RSourceItem& item, items_)
+   {
+      bytes += item.context().capacity() + item.name().capacity();
+      BOOST_FOREACH(const RS4MethodParam& param, item.signature())
+      {
+         bytes += sizeof(RS4MethodParam) +
+                  param.name().capacity() +
+                  param.type().capacity();
+      }
+   }
+   return bytes;
+}
+
+void RSourceIndex::addName(const std::string& name)
+{
+   for (std::string::const_iterator it = name.begin(); it != name.end(); ++it)
+      lowerNames_.push_back(toLowerAscii(*it));
+   nameOffsets_.push_back(lowerNames_.size());
+}
+
+void RSourceIndex::searchNames(const std::string& term,
+                               bool prefixOnly,
+                               bool caseSensitive,
+                               std::vector<std::size_t>* pMatches) const
+{
+   std::string lowerTerm;
+   lowerTerm.reserve(term.length());
+   for (std::string::const_iterator it = term.begin(); it != term.end(); ++it)
+      lowerTerm.push_back(toLowerAscii(*it));
+
+   const char* names = lowerNames_.data();
+   for (std::size_t i = 0, n = items_.size(); i < n; ++i)
+   {
+      const char* name = names + nameOffsets_[i];
+      std::size_t nameLength = nameOffsets_[i + 1] - nameOffsets_[i];
+
+      // the lower cased names give the case insensitive answer, which
+      // case sensitive searches then confirm against the item
+      bool matches = prefixOnly ?
+               startsWith(name, nameLength, lowerTerm) :
+               isSubsequence(name, nameLength, lowerTerm);
+      if (matches && caseSensitive)
+      {
+         matches = prefixOnly ?
+                  items_[i].nameStartsWith(term, true) :
+                  items_[i].nameIsSubsequence(term, true);
+      }
+
+      if (matches)
+         pMatches->push_back(i);
+   }
+}
+
 } // namespace r_util
 } // namespace core 
 } // namespace rstudio
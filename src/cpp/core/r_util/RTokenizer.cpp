@@ -13,24 +13,9 @@
  *
  */
 
-// A very low level assertion (line 595 of cpp_regex_traits.hpp) is firing
-// on WindowsXP when we create a boost::wregex within R session. This code
-// is part of boost attempting to detect the sort syntax, and the assertion
-// is that there are no nulls in a buffer after a call to locale->transform.
-// Within the same method there are workarounds for both borland c++ and
-// dinkumware c++ std library to strip embedded nulls, so it seems as if
-// there is some variation in whether nulls come out of the call to transforn.
-// Note also that boost has a macro titled BOOST_REGEX_NO_WIN32 which we are
-// not using, which means that boost regex does call into native windows APIs
-// for locale oriented functions (thus explaining a difference in runtime
-// behavior across platforms). Tokenization appears to continue to work
-// correctly in the presence of the assertion (with the annoying side effect
-// of logging an assertion every time the product starts up)
-
 #include <core/r_util/RTokenizer.hpp>
 
-#include <boost/regex.hpp>
-
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -45,35 +30,121 @@ namespace r_util {
 
 namespace {
 
-class TokenPatterns
+typedef std::wstring::const_iterator const_iterator;
+
+// The scanners below each return the length of the token starting at pos
+// (or 0 if there is no such token). They are hand-written equivalents of
+// the regular expressions noted alongside them (which we previously
+// matched with boost::wregex for each token).
+
+inline bool isDigit(wchar_t ch)
+{
+   return ch >= L'0' && ch <= L'9';
+}
+
+inline bool isHexDigit(wchar_t ch)
+{
+   return isDigit(ch) ||
+          (ch >= L'a' && ch <= L'f') ||
+          (ch >= L'A' && ch <= L'F');
+}
+
+inline bool isWhitespace(wchar_t ch)
 {
-private:
-   friend TokenPatterns& tokenPatterns();
-   TokenPatterns()
-      : NUMBER(L"[0-9]*(\\.[0-9]*)?([eE][+-]?[0-9]*)?[Li]?"),
-        HEX_NUMBER(L"0x[0-9a-fA-F]*L?"),
-        USER_OPERATOR(L"%[^%]*%"),
-        QUOTED_IDENTIFIER(L"`[^`]*`"),
-        UNTIL_END_QUOTE(L"[\\\\\'\"]"),
-        WHITESPACE(L"[\\s\x00A0\x3000]+"),
-        COMMENT(L"#[^\\n]*$")
+   switch (ch)
    {
+   case L' ': case L'\t': case L'\n': case L'\v': case L'\f': case L'\r':
+   case L'\x00A0': case L'\x3000':
+      return true;
+   default:
+      return false;
    }
+}
 
-public:
-   const boost::wregex NUMBER;
-   const boost::wregex HEX_NUMBER;
-   const boost::wregex USER_OPERATOR;
-   const boost::wregex QUOTED_IDENTIFIER;
-   const boost::wregex UNTIL_END_QUOTE;
-   const boost::wregex WHITESPACE;
-   const boost::wregex COMMENT;
-};
-
-TokenPatterns& tokenPatterns()
+inline const_iterator skipDigits(const_iterator pos, const_iterator end)
 {
-   static TokenPatterns instance;
-   return instance;
+   while (pos != end && isDigit(*pos))
+      ++pos;
+   return pos;
+}
+
+// [0-9]*(\.[0-9]*)?([eE][+-]?[0-9]*)?[Li]?
+std::size_t numberLength(const_iterator begin, const_iterator end)
+{
+   const_iterator pos = skipDigits(begin, end);
+
+   if (pos != end && *pos == L'.')
+      pos = skipDigits(pos + 1, end);
+
+   if (pos != end && (*pos == L'e' || *pos == L'E'))
+   {
+      ++pos;
+      if (pos != end && (*pos == L'+' || *pos == L'-'))
+         ++pos;
+      pos = skipDigits(pos, end);
+   }
+
+   if (pos != end && (*pos == L'L' || *pos == L'i'))
+      ++pos;
+
+   return pos - begin;
+}
+
+// 0x[0-9a-fA-F]*L?
+std::size_t hexNumberLength(const_iterator begin, const_iterator end)
+{
+   if (end - begin < 2 || *begin != L'0' || *(begin + 1) != L'x')
+      return 0;
+
+   const_iterator pos = begin + 2;
+   while (pos != end && isHexDigit(*pos))
+      ++pos;
+
+   if (pos != end && *pos == L'L')
+      ++pos;
+
+   return pos - begin;
+}
+
+// %[^%]*% and `[^`]*` (the delimiter is the character at begin)
+std::size_t delimitedLength(const_iterator begin, const_iterator end)
+{
+   const_iterator pos = std::find(begin + 1, end, *begin);
+   if (pos == end)
+      return 0;
+
+   return pos + 1 - begin;
+}
+
+// [\s\x00A0\x3000]+
+std::size_t whitespaceLength(const_iterator begin, const_iterator end)
+{
+   const_iterator pos = begin;
+   while (pos != end && isWhitespace(*pos))
+      ++pos;
+   return pos - begin;
+}
+
+// #[^\n]*$ (where $ doesn't match between \r and \n, so a trailing \r
+// isn't part of the comment)
+std::size_t commentLength(const_iterator begin, const_iterator end)
+{
+   const_iterator pos = std::find(begin, end, L'\n');
+   if (pos != end && pos - begin > 1 && *(pos - 1) == L'\r')
+      --pos;
+   return pos - begin;
+}
+
+// [\\'"]
+const_iterator findQuoteOrEscape(const_iterator begin, const_iterator end)
+{
+   for (const_iterator pos = begin; pos != end; ++pos)
+   {
+      wchar_t ch = *pos;
+      if (ch == L'\\' || ch == L'\'' || ch == L'"')
+         return pos;
+   }
+   return end;
 }
 
 void updatePosition(std::wstring::const_iterator pos,
@@ -214,7 +285,7 @@ RToken RTokenizer::nextToken()
 
 RToken RTokenizer::matchWhitespace()
 {
-   return consumeToken(RToken::WHITESPACE, tokenLength(tokenPatterns().WHITESPACE));
+   return consumeToken(RToken::WHITESPACE, whitespaceLength(pos_, data_.end()));
 }
 
 RToken RTokenizer::matchStringLiteral()
@@ -224,7 +295,7 @@ RToken RTokenizer::matchStringLiteral()
 
    while (!eol())
    {
-      eatUntil(tokenPatterns().UNTIL_END_QUOTE);
+      pos_ = findQuoteOrEscape(pos_, data_.end());
 
       if (eol())
          break ;
@@ -268,9 +339,9 @@ RToken RTokenizer::matchStringLiteral()
 
 RToken RTokenizer::matchNumber()
 {
-   std::size_t length = tokenLength(tokenPatterns().HEX_NUMBER);
+   std::size_t length = hexNumberLength(pos_, data_.end());
    if (length == 0)
-      length = tokenLength(tokenPatterns().NUMBER);
+      length = numberLength(pos_, data_.end());
 
    return consumeToken(RToken::NUMBER, length);
 }
@@ -296,7 +367,7 @@ RToken RTokenizer::matchIdentifier()
 
 RToken RTokenizer::matchQuotedIdentifier()
 {
-   std::size_t length = tokenLength(tokenPatterns().QUOTED_IDENTIFIER);
+   std::size_t length = delimitedLength(pos_, data_.end());
    if (length == 0)
       return consumeToken(RToken::ERR, 1);
    else
@@ -305,12 +376,12 @@ RToken RTokenizer::matchQuotedIdentifier()
 
 RToken RTokenizer::matchComment()
 {
-   return consumeToken(RToken::COMMENT, tokenLength(tokenPatterns().COMMENT));
+   return consumeToken(RToken::COMMENT, commentLength(pos_, data_.end()));
 }
 
 RToken RTokenizer::matchUserOperator()
 {
-   std::size_t length = tokenLength(tokenPatterns().USER_OPERATOR);
+   std::size_t length = delimitedLength(pos_, data_.end());
    if (length == 0)
       return consumeToken(RToken::ERR, 1);
    else
@@ -402,33 +473,6 @@ wchar_t RTokenizer::eat()
    return result ;
 }
 
-std::size_t RTokenizer::tokenLength(const boost::wregex& regex)
-{
-   boost::wsmatch match;
-   std::wstring::const_iterator end = data_.end();
-   boost::match_flag_type flg = boost::match_default | boost::match_continuous;
-   if (boost::regex_search(pos_, end, match, regex, flg))
-      return match.length();
-   else
-      return 0;
-}
-
-void RTokenizer::eatUntil(const boost::wregex& regex)
-{
-   boost::wsmatch match;
-   std::wstring::const_iterator end = data_.end();
-   if (boost::regex_search(pos_, end, match, regex))
-   {
-      pos_ = match[0].first;
-   }
-   else
-   {
-      // eat all on failure to match
-      pos_ = data_.end();
-   }
-}
-
-
 RToken RTokenizer::consumeToken(RToken::TokenType tokenType,
                                 std::size_t length)
 {
@@ -460,47 +504,20 @@ RToken RTokenizer::consumeToken(RToken::TokenType tokenType,
                  column);
 }
 
-class ConversionCache
+std::string RToken::contentAsUtf8() const
 {
-public:
-   
-   typedef std::wstring key_type;
-   typedef std::string mapped_type;
-   
-   bool contains(const RToken& token) const
-   {
-      return database_.count(token.content());
-   }
-   
-   std::string& get(const RToken& token)
-   {
-      return database_[token.content()];
-   }
-   
-   void put(const RToken& token, const mapped_type& value)
+   // most tokens are plain ascii, which can be narrowed directly (rather
+   // than converted and cached, which kept a copy of every distinct token
+   // seen for the lifetime of the process)
+   std::string result;
+   result.reserve(end_ - begin_);
+   for (std::wstring::const_iterator it = begin_; it != end_; ++it)
    {
-      database_[token.content()] = value;
+      if (static_cast<unsigned int>(*it) > 0x7F)
+         return string_utils::wideToUtf8(content());
+      result.push_back(static_cast<char>(*it));
    }
-   
-private:
-   std::map<key_type, mapped_type> database_;
-};
-
-ConversionCache& conversionCache()
-{
-   static ConversionCache instance;
-   return instance;
-}
-
-const std::string& RToken::contentAsUtf8() const
-{
-   ConversionCache& cache = conversionCache();
-   if (cache.contains(*this))
-      return cache.get(*this);
-   
-   std::string result = string_utils::wideToUtf8(content());
-   cache.put(*this, result);
-   return cache.get(*this);
+   return result;
 }
 
 std::string RToken::asString() const
@@ -20,6 +20,7 @@
 #include <iostream>
 
 #include <boost/foreach.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <tests/TestThat.hpp>
 
@@ -265,6 +266,59 @@ context("RTokenizer")
       expect_true(rTokens.at(2).isType(RToken::OPER));
       expect_true(rTokens.at(2).contentEquals(L"**"));
    }
+   
+   test_that("Large inputs are tokenized quickly and losslessly")
+   {
+      std::wstring snippet =
+            L"# compute summary statistics\n"
+            L"summarize <- function(data, cols = c(\"a\", 'b'), ...) {\n"
+            L"   result <- data[[cols[1]]] %>% filter(x >= 1.5e-3L) %in% y\n"
+            L"   `odd name` <- 0x1FL + .5 * 10i; if (!is.null(z)) z$value\n"
+            L"}\n";
+      
+      std::wstring code;
+      for (int i = 0; i < 10000; i++)
+         code.append(snippet);
+      
+      boost::posix_time::ptime start =
+            boost::posix_time::microsec_clock::universal_time();
+      
+      RTokenizer tokenizer(code);
+      std::size_t count = 0;
+      std::size_t length = 0;
+      RToken token;
+      while ((token = tokenizer.nextToken()))
+      {
+         expect_true(token.offset() == length);
+         length += token.length();
+         ++count;
+      }
+      
+      boost::posix_time::time_duration elapsed =
+            boost::posix_time::microsec_clock::universal_time() - start;
+      
+      expect_true(length == code.size());
+      expect_true(count > 0 && count % 10000 == 0);
+      
+      double seconds = std::max(
+               static_cast<double>(elapsed.total_microseconds()) / 1.0e6,
+               1.0e-6);
+      std::cerr << "RTokenizer: " << count << " tokens ("
+                << code.size() << " characters) in " << seconds << "s, "
+                << static_cast<long>(code.size() / seconds)
+                << " characters/s" << std::endl;
+   }
+   
+   test_that("Token content is converted to UTF-8")
+   {
+      RTokenizer tokenizer(L"abc <- '\u00e9t\u00e9'");
+      expect_true(tokenizer.nextToken().contentAsUtf8() == "abc");
+      tokenizer.nextToken();
+      expect_true(tokenizer.nextToken().contentAsUtf8() == "<-");
+      tokenizer.nextToken();
+      expect_true(tokenizer.nextToken().contentAsUtf8() ==
+                  "'\xc3\xa9t\xc3\xa9'");
+   }
 }
 
 } // namespace r_util
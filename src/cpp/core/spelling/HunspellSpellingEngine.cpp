@@ -15,7 +15,10 @@
 
 #include <core/spelling/HunspellSpellingEngine.hpp>
 
+#include <list>
+
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <core/Error.hpp>
@@ -40,6 +43,19 @@ namespace spelling {
 
 namespace {
 
+// maximum number of check results remembered for the current dictionaries
+const std::size_t kMaxCachedWords = 20000;
+
+bool isAscii(const std::string& word)
+{
+   for (std::string::const_iterator it = word.begin(); it != word.end(); ++it)
+   {
+      if (static_cast<unsigned char>(*it) > 0x7F)
+         return false;
+   }
+   return true;
+}
+
 // remove morphological description from text
 void removeMorphologicalDescription(std::string* pText)
 {
@@ -270,6 +286,14 @@ private:
 public:
    Error checkSpelling(const std::string& word, bool *pCorrect)
    {
+      // dictionary encodings are all supersets of ASCII, so ASCII words
+      // (the vast majority) don't need to be converted
+      if (isAscii(word))
+      {
+         *pCorrect = pHunspell_->spell(word.c_str());
+         return Success();
+      }
+
       std::string encoded;
       Error error = iconvstrFunc_(word,"UTF-8",encoding_,false,&encoded);
       if (error)
@@ -385,8 +409,19 @@ struct HunspellSpellingEngine::Impl
 
    void useDictionary(const std::string& langId)
    {
+      // switch dictionaries (the new ones are loaded when first needed)
       if (dictionaryContextChanged(langId))
-         resetDictionaries(langId);
+      {
+         currentLangId_ = langId;
+         releaseDictionaries();
+      }
+   }
+
+   void releaseDictionaries()
+   {
+      pSpellChecker_.reset();
+      wordResults_.clear();
+      recentWords_.clear();
    }
 
    SpellChecker& spellChecker()
@@ -397,15 +432,54 @@ struct HunspellSpellingEngine::Impl
       return *pSpellChecker_;
    }
 
+   Error checkSpelling(const std::string& word, bool* pCorrect)
+   {
+      SpellChecker& checker = spellChecker();
+
+      // use the previous result for this word if we have one
+      WordResults::iterator it = wordResults_.find(word);
+      if (it != wordResults_.end())
+      {
+         recentWords_.splice(recentWords_.begin(),
+                             recentWords_,
+                             it->second.second);
+         *pCorrect = it->second.first;
+         return Success();
+      }
+
+      Error error = checker.checkSpelling(word, pCorrect);
+      if (error)
+         return error;
+
+      // remember the result (evicting the least recently checked word)
+      recentWords_.push_front(word);
+      wordResults_[word] = std::make_pair(*pCorrect, recentWords_.begin());
+      if (wordResults_.size() > kMaxCachedWords)
+      {
+         wordResults_.erase(recentWords_.back());
+         recentWords_.pop_back();
+      }
+
+      return Success();
+   }
+
 private:
    bool dictionaryContextChanged(const std::string& langId)
    {
+      // (no loaded dictionaries means there's nothing to change)
+      if (!pSpellChecker_)
+         return langId != currentLangId_;
+
       return(langId != currentLangId_ ||
              dictManager_.custom().dictionaries() != currentCustomDicts_);
    }
 
    void resetDictionaries(const std::string& langId)
    {
+      // previous results don't apply to the new dictionaries
+      wordResults_.clear();
+      recentWords_.clear();
+
       HunspellDictionary dict = dictManager_.dictionaryForLanguageId(langId);
       if (!dict.empty())
       {
@@ -449,6 +523,12 @@ private:
    HunspellDictionaryManager dictManager_;
    IconvstrFunction iconvstrFunction_;
    boost::shared_ptr<SpellChecker> pSpellChecker_;
+
+   typedef boost::unordered_map<std::string,
+                  std::pair<bool, std::list<std::string>::iterator> >
+                                                               WordResults;
+   WordResults wordResults_;
+   std::list<std::string> recentWords_;
 };
 
 
@@ -466,10 +546,30 @@ void HunspellSpellingEngine::useDictionary(const std::string& langId)
    pImpl_->useDictionary(langId);
 }
 
+void HunspellSpellingEngine::releaseDictionaries()
+{
+   pImpl_->releaseDictionaries();
+}
+
 Error HunspellSpellingEngine::checkSpelling(const std::string& word,
                                             bool *pCorrect)
 {
-   return pImpl_->spellChecker().checkSpelling(word, pCorrect);
+   return pImpl_->checkSpelling(word, pCorrect);
+}
+
+Error HunspellSpellingEngine::checkSpelling(const std::vector<std::string>& words,
+                                            std::vector<bool>* pCorrect)
+{
+   pCorrect->reserve(pCorrect->size() + words.size());
+   BOOST_FOREACH(const std::string& word, words)
+   {
+      bool isCorrect = true;
+      Error error = pImpl_->checkSpelling(word, &isCorrect);
+      if (error)
+         return error;
+      pCorrect->push_back(isCorrect);
+   }
+   return Success();
 }
 
 Error HunspellSpellingEngine::suggestionList(const std::string& word,
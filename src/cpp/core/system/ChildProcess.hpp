@@ -198,6 +198,18 @@ public:
    // has it exited?
    bool exited();
 
+#ifndef _WIN32
+   // descriptors which become readable when poll has something to collect
+   // (output pipes which haven't reached eof and, where supported, a pidfd
+   // which becomes readable when the process exits)
+   void watchHandles(std::vector<int>* pHandles);
+#else
+   // duplicates of the handles which are signaled when poll has something
+   // to collect (the events of pending output reads and the process). the
+   // caller is responsible for closing them
+   void watchHandles(std::vector<void*>* pHandles);
+#endif
+
    // override of terminate (allow special handling for unix pty termination)
    virtual Error terminate();
 
@@ -235,6 +247,25 @@ private:
    boost::scoped_ptr<AsyncImpl> pAsyncImpl_;
 };
 
+// Watches the output and exit of async children on a background thread and
+// calls onActivity (on that thread) when one of them has something for poll
+// to collect. Each child is watched until the next call to watch, so
+// onActivity is called at most once between re-arms (i.e. once per poll).
+// Only implemented on linux and windows (elsewhere onActivity is never called)
+class ChildActivityWatcher : boost::noncopyable
+{
+public:
+   explicit ChildActivityWatcher(const boost::function<void()>& onActivity);
+   ~ChildActivityWatcher();
+
+   // (re-)arm the watch for the given children
+   void watch(const std::vector<boost::shared_ptr<AsyncChildProcess> >& children);
+
+private:
+   struct Impl;
+   boost::scoped_ptr<Impl> pImpl_;
+};
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
@@ -17,6 +17,7 @@
 
 #include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 
 #ifdef __APPLE__
@@ -31,8 +32,17 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+
 #include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/thread.hpp>
 
+#include <core/BoostErrors.hpp>
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/system/System.hpp>
@@ -43,6 +53,16 @@
 
 #include "ChildProcess.hpp"
 
+// posix_spawn can only replace our fork path if it can close the parent's
+// descriptors and change the working directory (glibc 2.34 and later)
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 34)
+#define RSTUDIO_POSIX_SPAWN_CHILD_PROCESS
+#endif
+#endif
+
+extern char** environ;
+
 namespace rstudio {
 namespace core {
 namespace system {
@@ -78,6 +98,140 @@ void closePipe(int* pipeDescriptors, const ErrorLocation& location)
    closePipe(pipeDescriptors[WRITE], location);
 }
 
+// children which need no custom setup within the forked process (i.e. not
+// pseudoterminals, onAfterFork hooks or new sessions) are launched using
+// posix_spawn. glibc implements it with a vfork-style clone, which avoids
+// copying the parent's page tables (expensive for a large R process) and
+// the hazards of running code in a forked copy of a multithreaded process
+bool canSpawnChild(const ProcessOptions& options)
+{
+#ifdef RSTUDIO_POSIX_SPAWN_CHILD_PROCESS
+   return !options.pseudoterminal &&
+          !options.onAfterFork &&
+          !options.detachSession;
+#else
+   return false;
+#endif
+}
+
+#ifdef RSTUDIO_POSIX_SPAWN_CHILD_PROCESS
+
+Error spawnChild(const std::string& exe,
+                 const std::vector<std::string>& args,
+                 const ProcessOptions& options,
+                 int* fdInput,
+                 int* fdOutput,
+                 int* fdError,
+                 pid_t* pPid)
+{
+   posix_spawn_file_actions_t actions;
+   int result = ::posix_spawn_file_actions_init(&actions);
+   if (result != 0)
+      return systemError(result, ERROR_LOCATION);
+
+   posix_spawnattr_t attr;
+   result = ::posix_spawnattr_init(&attr);
+   if (result != 0)
+   {
+      ::posix_spawn_file_actions_destroy(&actions);
+      return systemError(result, ERROR_LOCATION);
+   }
+
+   // wire standard streams then close everything else (equivalent to the
+   // dup2 and closeNonStdFileDescriptors calls made after a fork)
+   int fdStdErr = options.redirectStdErrToStdOut ? fdOutput[WRITE]
+                                                 : fdError[WRITE];
+   if (result == 0)
+      result = ::posix_spawn_file_actions_adddup2(&actions,
+                                                  fdInput[READ],
+                                                  STDIN_FILENO);
+   if (result == 0)
+      result = ::posix_spawn_file_actions_adddup2(&actions,
+                                                  fdOutput[WRITE],
+                                                  STDOUT_FILENO);
+   if (result == 0)
+      result = ::posix_spawn_file_actions_adddup2(&actions,
+                                                  fdStdErr,
+                                                  STDERR_FILENO);
+   if (result == 0)
+      result = ::posix_spawn_file_actions_addclosefrom_np(&actions,
+                                                          STDERR_FILENO + 1);
+
+   std::string workingDir = options.workingDir.absolutePath();
+   if (result == 0 && !options.workingDir.empty())
+      result = ::posix_spawn_file_actions_addchdir_np(&actions,
+                                                      workingDir.c_str());
+
+   // clear the signal mask and (for terminateChildren) start a new process
+   // group so that terminate can signal the child and its descendants
+   short flags = POSIX_SPAWN_SETSIGMASK;
+   sigset_t emptyMask;
+   sigemptyset(&emptyMask);
+   if (result == 0)
+      result = ::posix_spawnattr_setsigmask(&attr, &emptyMask);
+   if (result == 0 && options.terminateChildren)
+   {
+      flags |= POSIX_SPAWN_SETPGROUP;
+      result = ::posix_spawnattr_setpgroup(&attr, 0);
+   }
+   if (result == 0)
+      result = ::posix_spawnattr_setflags(&attr, flags);
+
+   if (result == 0)
+   {
+      std::vector<std::string> argv;
+      argv.push_back(exe);
+      argv.insert(argv.end(), args.begin(), args.end());
+      ProcessArgs processArgs(argv);
+
+      std::vector<std::string> env;
+      if (options.environment)
+      {
+         const Options& environment = options.environment.get();
+         for (Options::const_iterator
+                  it = environment.begin(); it != environment.end(); ++it)
+         {
+            env.push_back(it->first + "=" + it->second);
+         }
+      }
+      ProcessArgs processEnv(env);
+
+      result = ::posix_spawn(pPid,
+                             exe.c_str(),
+                             &actions,
+                             &attr,
+                             processArgs.args(),
+                             options.environment ? processEnv.args() : environ);
+   }
+
+   ::posix_spawnattr_destroy(&attr);
+   ::posix_spawn_file_actions_destroy(&actions);
+
+   if (result != 0)
+   {
+      Error error = systemError(result, ERROR_LOCATION);
+      error.addProperty("exe", exe);
+      return error;
+   }
+
+   return Success();
+}
+
+#else
+
+Error spawnChild(const std::string& exe,
+                 const std::vector<std::string>& args,
+                 const ProcessOptions& options,
+                 int* fdInput,
+                 int* fdOutput,
+                 int* fdError,
+                 pid_t* pPid)
+{
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+}
+
+#endif
+
 Error readPipe(int pipeFd, std::string* pOutput, bool *pEOF = NULL)
 {
    // default to not eof
@@ -409,8 +563,17 @@ Error ChildProcess::run()
          return error;
       }
 
-      // fork
-      error = posixCall<pid_t>(::fork, ERROR_LOCATION, &pid);
+      // spawn if we can, otherwise fork
+      if (canSpawnChild(options_))
+      {
+         error = spawnChild(exe_, args_, options_,
+                            fdInput, fdOutput, fdError,
+                            &pid);
+      }
+      else
+      {
+         error = posixCall<pid_t>(::fork, ERROR_LOCATION, &pid);
+      }
       if (error)
       {
          closePipe(fdInput, ERROR_LOCATION);
@@ -653,14 +816,24 @@ struct AsyncChildProcess::AsyncImpl
       : calledOnStarted_(false),
         finishedStdout_(false),
         finishedStderr_(false),
-        exited_(false)
+        exited_(false),
+        pidFd_(-1)
+   {
+   }
+
+   ~AsyncImpl()
    {
+      if (pidFd_ != -1)
+         ::close(pidFd_);
    }
 
    bool calledOnStarted_;
    bool finishedStdout_;
    bool finishedStderr_;
    bool exited_;
+
+   // readable once the process exits (opened on demand by watchHandles)
+   int pidFd_;
 };
 
 AsyncChildProcess::AsyncChildProcess(const std::string& exe,
@@ -821,6 +994,174 @@ bool AsyncChildProcess::exited()
    return pAsyncImpl_->exited_;
 }
 
+void AsyncChildProcess::watchHandles(std::vector<int>* pHandles)
+{
+   if (pAsyncImpl_->exited_ || pImpl_->pid == -1)
+      return;
+
+   if (!pAsyncImpl_->finishedStdout_ && pImpl_->fdStdout != -1)
+      pHandles->push_back(pImpl_->fdStdout);
+   if (!pAsyncImpl_->finishedStderr_ && pImpl_->fdStderr != -1)
+      pHandles->push_back(pImpl_->fdStderr);
+
+#if defined(__linux__) && defined(SYS_pidfd_open)
+   // pidfds need linux 5.3 (without one, exits are still noticed when the
+   // output pipes close or by the next periodic poll)
+   if (pAsyncImpl_->pidFd_ == -1)
+      pAsyncImpl_->pidFd_ = ::syscall(SYS_pidfd_open, pImpl_->pid, 0);
+   if (pAsyncImpl_->pidFd_ != -1)
+      pHandles->push_back(pAsyncImpl_->pidFd_);
+#endif
+}
+
+#ifdef __linux__
+
+struct ChildActivityWatcher::Impl
+{
+   Impl() : epollFd(-1), stopFd(-1) {}
+
+   void run()
+   {
+      struct epoll_event events[16];
+      while (true)
+      {
+         int count = ::epoll_wait(epollFd, events, 16, -1);
+         if (count == -1)
+         {
+            if (errno == EINTR)
+               continue;
+            LOG_ERROR(systemError(errno, ERROR_LOCATION));
+            return;
+         }
+
+         bool activity = false;
+         for (int i = 0; i < count; i++)
+         {
+            if (events[i].data.fd == stopFd)
+               return;
+            activity = true;
+         }
+
+         if (activity && onActivity)
+            onActivity();
+      }
+   }
+
+   int epollFd;
+   int stopFd;
+   boost::function<void()> onActivity;
+   boost::thread thread;
+};
+
+ChildActivityWatcher::ChildActivityWatcher(
+                              const boost::function<void()>& onActivity)
+   : pImpl_(new Impl())
+{
+   pImpl_->onActivity = onActivity;
+
+   pImpl_->epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+   pImpl_->stopFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (pImpl_->epollFd == -1 || pImpl_->stopFd == -1)
+   {
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      return;
+   }
+
+   struct epoll_event event;
+   event.events = EPOLLIN;
+   event.data.fd = pImpl_->stopFd;
+   if (::epoll_ctl(pImpl_->epollFd, EPOLL_CTL_ADD, pImpl_->stopFd, &event) == -1)
+   {
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      return;
+   }
+
+   try
+   {
+      pImpl_->thread = boost::thread(&Impl::run, pImpl_.get());
+   }
+   catch(const boost::thread_resource_error& e)
+   {
+      LOG_ERROR(Error(boost::thread_error::ec_from_exception(e),
+                      ERROR_LOCATION));
+   }
+}
+
+ChildActivityWatcher::~ChildActivityWatcher()
+{
+   try
+   {
+      if (pImpl_->thread.joinable())
+      {
+         boost::uint64_t stop = 1;
+         if (::write(pImpl_->stopFd, &stop, sizeof(stop)) == sizeof(stop))
+            pImpl_->thread.join();
+         else
+            pImpl_->thread.detach();
+      }
+
+      if (pImpl_->epollFd != -1)
+         ::close(pImpl_->epollFd);
+      if (pImpl_->stopFd != -1)
+         ::close(pImpl_->stopFd);
+   }
+   catch(...)
+   {
+   }
+}
+
+void ChildActivityWatcher::watch(
+         const std::vector<boost::shared_ptr<AsyncChildProcess> >& children)
+{
+   if (!pImpl_->thread.joinable())
+      return;
+
+   // handles are one-shot so a pipe with unread output (or an exited
+   // process which hasn't been reaped) reports once per poll rather than
+   // continuously. closed handles are removed from the epoll set by the
+   // kernel, and a reused descriptor number at worst causes an extra poll
+   std::vector<int> handles;
+   BOOST_FOREACH(const boost::shared_ptr<AsyncChildProcess>& pChild, children)
+      pChild->watchHandles(&handles);
+
+   BOOST_FOREACH(int handle, handles)
+   {
+      struct epoll_event event;
+      event.events = EPOLLIN | EPOLLONESHOT;
+      event.data.fd = handle;
+      if (::epoll_ctl(pImpl_->epollFd, EPOLL_CTL_MOD, handle, &event) == -1)
+      {
+         if (errno != ENOENT ||
+             ::epoll_ctl(pImpl_->epollFd, EPOLL_CTL_ADD, handle, &event) == -1)
+         {
+            LOG_ERROR(systemError(errno, ERROR_LOCATION));
+         }
+      }
+   }
+}
+
+#else
+
+struct ChildActivityWatcher::Impl
+{
+};
+
+ChildActivityWatcher::ChildActivityWatcher(
+                              const boost::function<void()>& onActivity)
+{
+}
+
+ChildActivityWatcher::~ChildActivityWatcher()
+{
+}
+
+void ChildActivityWatcher::watch(
+         const std::vector<boost::shared_ptr<AsyncChildProcess> >& children)
+{
+}
+
+#endif
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
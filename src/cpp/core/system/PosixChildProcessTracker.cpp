@@ -15,8 +15,17 @@
 
 #include <core/system/PosixChildProcessTracker.hpp>
 
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
 #include <sys/wait.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#endif
+
 #include <boost/format.hpp>
 
 namespace rstudio {
@@ -37,24 +46,102 @@ int waitPid(PidType pid, int* pStatus)
    }
 }
 
+int safeClose(int fd)
+{
+   for (;;)
+   {
+      int result = ::close(fd);
+      if (result == -1 && errno == EINTR)
+         continue;
+      return result;
+   }
+}
+
 } // anonymous namespace
 
+ChildProcessTracker::ChildProcessTracker()
+   : epollFd_(-1)
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+   epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+   if (epollFd_ == -1)
+      LOG_ERROR(systemError(errno, ERROR_LOCATION));
+#endif
+}
+
+ChildProcessTracker::~ChildProcessTracker()
+{
+   try
+   {
+      for (std::map<PidType,int>::const_iterator it = pidFds_.begin();
+           it != pidFds_.end();
+           ++it)
+      {
+         safeClose(it->second);
+      }
+
+      if (epollFd_ != -1)
+         safeClose(epollFd_);
+   }
+   catch(...)
+   {
+   }
+}
 
 void ChildProcessTracker::addProcess(PidType pid, ExitHandler exitHandler)
 {
    LOCK_MUTEX(mutex_)
    {
       processes_.insert(std::make_pair(pid, exitHandler));
+      watchProcess(pid);
    }
    END_LOCK_MUTEX
 }
 
+// watch the process through a pidfd (if we can). must be called with
+// mutex_ held
+bool ChildProcessTracker::watchProcess(PidType pid)
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+   if (epollFd_ == -1)
+      return false;
+
+   // older kernels (< 5.3) don't support pidfds, in which case we'll
+   // just poll this process when we receive SIGCHLD
+   int pidFd = ::syscall(SYS_pidfd_open, pid, 0);
+   if (pidFd == -1)
+      return false;
+
+   // the pidfd becomes readable (and stays so until it's reaped) once the
+   // process exits. it's closed (and so removed from the epoll set) when
+   // the process is removed
+   struct epoll_event event;
+   std::memset(&event, 0, sizeof(event));
+   event.events = EPOLLIN;
+   event.data.u64 = static_cast<uint64_t>(pid);
+   if (::epoll_ctl(epollFd_, EPOLL_CTL_ADD, pidFd, &event) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("pid", pid);
+      LOG_ERROR(error);
+      safeClose(pidFd);
+      return false;
+   }
+
+   pidFds_[pid] = pidFd;
+   return true;
+#else
+   return false;
+#endif
+}
+
 void ChildProcessTracker::notifySIGCHILD()
 {
    // We make a copy of hte active pids so that we can do the reaping
    // outside of the pidsMutex_. This is an extra conservative precaution
-   // in case there is ever an issue with waitpid blocking.
-   std::map<PidType,ExitHandler> processes = activeProcesses();
+   // in case there is ever an issue with waitpid blocking. Where processes
+   // are watched by pidfd only those which have exited are included.
+   std::map<PidType,ExitHandler> processes = exitedProcesses();
 
    // attempt to reap each process
    std::for_each(processes.begin(),
@@ -119,6 +206,13 @@ void ChildProcessTracker::removeProcess(PidType pid)
    LOCK_MUTEX(mutex_)
    {
       processes_.erase(pid);
+
+      std::map<PidType,int>::iterator it = pidFds_.find(pid);
+      if (it != pidFds_.end())
+      {
+         safeClose(it->second);
+         pidFds_.erase(it);
+      }
    }
    END_LOCK_MUTEX
 }
@@ -136,6 +230,68 @@ std::map<PidType,ChildProcessTracker::ExitHandler>
    return std::map<PidType,ExitHandler>();
 }
 
+std::map<PidType,ChildProcessTracker::ExitHandler>
+                            ChildProcessTracker::exitedProcesses()
+{
+   if (epollFd_ == -1)
+      return activeProcesses();
+
+   std::vector<PidType> exitedPids;
+#ifdef __linux__
+   // collect the pids whose pidfds are readable (level triggered, so any
+   // exits coalesced into a single SIGCHLD are all reported)
+   const int kMaxEvents = 64;
+   struct epoll_event events[kMaxEvents];
+   for (;;)
+   {
+      int count = ::epoll_wait(epollFd_, events, kMaxEvents, 0);
+      if (count == -1)
+      {
+         if (errno == EINTR)
+            continue;
+
+         // fall back to polling all processes
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+         return activeProcesses();
+      }
+
+      for (int i = 0; i < count; i++)
+         exitedPids.push_back(static_cast<PidType>(events[i].data.u64));
+
+      if (count < kMaxEvents)
+         break;
+   }
+#endif
+
+   std::map<PidType,ExitHandler> processes;
+   LOCK_MUTEX(mutex_)
+   {
+      for (std::vector<PidType>::const_iterator it = exitedPids.begin();
+           it != exitedPids.end();
+           ++it)
+      {
+         std::map<PidType,ExitHandler>::const_iterator process =
+                                                      processes_.find(*it);
+         if (process != processes_.end())
+            processes.insert(*process);
+      }
+
+      // processes without a pidfd still need to be polled
+      if (pidFds_.size() < processes_.size())
+      {
+         for (std::map<PidType,ExitHandler>::const_iterator it =
+                 processes_.begin(); it != processes_.end(); ++it)
+         {
+            if (pidFds_.find(it->first) == pidFds_.end())
+               processes.insert(*it);
+         }
+      }
+   }
+   END_LOCK_MUTEX
+
+   return processes;
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
@@ -18,11 +18,18 @@
 #include <dirent.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <deque>
+#include <map>
+
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/FilePath.hpp>
+#include <core/Thread.hpp>
 #include <core/BoostThread.hpp>
 
 #include "config.h"
@@ -33,106 +40,92 @@ namespace system {
 
 namespace {
 
-#if defined(__APPLE__) && !defined(HAVE_SCANDIR_POSIX)
-int entryFilter(struct dirent *entry)
-#else
-int entryFilter(const struct dirent *entry)
-#endif
+struct DirEntry
 {
-   if (::strcmp(entry->d_name, ".") == 0 || ::strcmp(entry->d_name, "..") == 0)
-      return 0;
-   else
-      return 1;
-}
+   DirEntry(const std::string& name, unsigned char type)
+      : name(name), type(type)
+   {
+   }
 
-// note: because R may change LC_COLLATE, we cannot
-// use strcoll (otherwise we run into race issues where
-// the file monitor attempts to access LC_COLLATE just as
-// R is replacing it). to avoid this, we use strcmp and
-// don't sort according to locale.
-#if !defined(HAVE_SCANDIR_POSIX)
-int alphasort(const void* voidlhs, const void* voidrhs)
-{
-   const dirent** lhs = (const dirent**)voidlhs;
-   const dirent** rhs = (const dirent**)voidrhs;
-#else
-int alphasort(const dirent** lhs, const dirent** rhs)
-{
-#endif
-   return strcmp((*lhs)->d_name, (*rhs)->d_name);
-}
+   // note: because R may change LC_COLLATE, we cannot
+   // use strcoll (otherwise we run into race issues where
+   // the file monitor attempts to access LC_COLLATE just as
+   // R is replacing it). to avoid this, we use strcmp and
+   // don't sort according to locale.
+   bool operator < (const DirEntry& other) const
+   {
+      return ::strcmp(name.c_str(), other.name.c_str()) < 0;
+   }
 
-// wrapper for scandir api
-Error scanDir(const std::string& dirPath, std::vector<std::string>* pNames)
+   std::string name;
+   unsigned char type;
+};
+
+// read the entries of a directory (sorted by name)
+Error readDirEntries(const std::string& dirPath, std::vector<DirEntry>* pEntries)
 {
-   // read directory contents into namelist
-   struct dirent **namelist;
-   int entries = ::scandir(dirPath.c_str(),
-                           &namelist,
-                           entryFilter,
-                           alphasort);
-   if (entries == -1)
+   DIR* pDir = ::opendir(dirPath.c_str());
+   if (pDir == NULL)
    {
       Error error = systemError(errno, ERROR_LOCATION);
       error.addProperty("path", dirPath);
       return error;
    }
 
-   // extract the namelist then free it
-   for(int i=0; i<entries; i++)
+   struct dirent* pEntry;
+   while (true)
    {
-      // get the name (then free it)
-      std::string name(namelist[i]->d_name,
-#ifdef __APPLE__
-                       namelist[i]->d_namlen);
+      errno = 0;
+      pEntry = ::readdir(pDir);
+      if (pEntry == NULL)
+         break;
+
+      if (::strcmp(pEntry->d_name, ".") == 0 ||
+          ::strcmp(pEntry->d_name, "..") == 0)
+         continue;
+
+#ifdef _DIRENT_HAVE_D_TYPE
+      unsigned char type = pEntry->d_type;
 #else
-                       namelist[i]->d_reclen);
+      unsigned char type = DT_UNKNOWN;
 #endif
-      ::free(namelist[i]);
+      pEntries->push_back(DirEntry(pEntry->d_name, type));
+   }
 
-      // add to the vector
-      pNames->push_back(name);
+   int readErrno = errno;
+   ::closedir(pDir);
+   if (readErrno != 0)
+   {
+      Error error = systemError(readErrno, ERROR_LOCATION);
+      error.addProperty("path", dirPath);
+      return error;
    }
-   ::free(namelist);
 
+   std::sort(pEntries->begin(), pEntries->end());
    return Success();
 }
 
-} // anonymous namespace
-
-Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
-                const FileScannerOptions& options,
-                tree<FileInfo>* pTree)
+// read the contents of a directory as FileInfo (sorted by name). entries
+// which the directory reports as directories don't require a stat (we
+// don't record any other attributes for directories)
+Error readDirectory(const std::string& dirPath, std::vector<FileInfo>* pFiles)
 {
-   // clear all existing
-   pTree->erase_children(fromNode);
-
-   // create FilePath for root
-   FilePath rootPath(fromNode->absolutePath());
-
-   // yield if requested (only applies to recursive scans)
-   if (options.recursive && options.yield)
-      boost::this_thread::yield();
-
-   // call onBeforeScanDir hook
-   if (options.onBeforeScanDir)
-   {
-      Error error = options.onBeforeScanDir(*fromNode);
-      if (error)
-         return error;
-   }
-
-   // read directory contents
-   std::vector<std::string> names;
-   Error error = scanDir(fromNode->absolutePath(), &names);
+   std::vector<DirEntry> entries;
+   Error error = readDirEntries(dirPath, &entries);
    if (error)
       return error;
 
-   // iterate over the names
-   BOOST_FOREACH(const std::string& name, names)
+   FilePath rootPath(dirPath);
+   BOOST_FOREACH(const DirEntry& entry, entries)
    {
       // compute the path
-      std::string path = rootPath.childPath(name).absolutePath();
+      std::string path = rootPath.childPath(entry.name).absolutePath();
+
+      if (entry.type == DT_DIR)
+      {
+         pFiles->push_back(FileInfo(path, true, false));
+         continue;
+      }
 
       // get the attributes
       struct stat st;
@@ -149,58 +142,284 @@ Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
       }
 
       // create the FileInfo
-      FileInfo fileInfo;
       bool isSymlink = S_ISLNK(st.st_mode);
       if (S_ISDIR(st.st_mode))
       {
-         fileInfo = FileInfo(path, true, isSymlink);
+         pFiles->push_back(FileInfo(path, true, isSymlink));
       }
       else
       {
-         fileInfo = FileInfo(path,
-                             false,
-                             st.st_size,
+         pFiles->push_back(FileInfo(path,
+                                    false,
+                                    st.st_size,
 #ifdef __APPLE__
-                             st.st_mtimespec.tv_sec,
+                                    st.st_mtimespec.tv_sec,
 #else
-                             st.st_mtime,
+                                    st.st_mtime,
 #endif
-                             isSymlink);
+                                    isSymlink));
       }
+   }
+
+   return Success();
+}
+
+// reads directories ahead of a scan on background threads. directories are
+// read in the order they will be needed by the (depth first) scan: each
+// batch of subdirectories is put at the front of the queue. if the scan
+// needs a directory which no thread has started reading it reads it itself
+class DirectoryReader : boost::noncopyable
+{
+public:
+   explicit DirectoryReader(int threads)
+      : stopping_(false)
+   {
+      for (int i = 0; i < threads; i++)
+         threads_.create_thread(boost::bind(&DirectoryReader::readerThreadMain,
+                                            this));
+   }
 
-      // apply the filter (if any)
-      if (!options.filter || options.filter(fileInfo))
+   ~DirectoryReader()
+   {
+      try
       {
-         // add the correct type of FileEntry
-         if (fileInfo.isDirectory())
+         LOCK_MUTEX(mutex_)
+         {
+            stopping_ = true;
+         }
+         END_LOCK_MUTEX
+         queuedCondition_.notify_all();
+         threads_.join_all();
+      }
+      catch(...)
+      {
+      }
+   }
+
+   // queue directories to be read (in the order they will be needed)
+   void readAhead(const std::vector<std::string>& dirPaths)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         for (std::vector<std::string>::const_reverse_iterator it =
+                  dirPaths.rbegin(); it != dirPaths.rend(); ++it)
+         {
+            if (listings_.find(*it) != listings_.end())
+               continue;
+
+            listings_[*it] = boost::shared_ptr<Listing>(new Listing());
+            queue_.push_front(*it);
+         }
+      }
+      END_LOCK_MUTEX
+
+      queuedCondition_.notify_all();
+   }
+
+   Error read(const std::string& dirPath, std::vector<FileInfo>* pFiles)
+   {
+      boost::shared_ptr<Listing> pListing;
+      bool readHere = false;
+
+      // NOTE: unique_lock rather than LOCK_MUTEX since we may need to wait
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         std::map<std::string, boost::shared_ptr<Listing> >::iterator it =
+                                                   listings_.find(dirPath);
+         if (it == listings_.end())
+         {
+            readHere = true;
+         }
+         else
          {
-            tree<FileInfo>::iterator_base child = pTree->append_child(fromNode,
-                                                                      fileInfo);
-            // recurse if requested and this isn't a link
-            if (options.recursive && !fileInfo.isSymlink())
+            pListing = it->second;
+            listings_.erase(it);
+
+            // if no thread has started reading it then read it ourselves
+            if (pListing->state == Queued)
+            {
+               queue_.erase(std::find(queue_.begin(), queue_.end(), dirPath));
+               readHere = true;
+            }
+            else
             {
-               // try to scan the files in the subdirectory -- if we fail
-               // we continue because we don't want one "bad" directory
-               // to cause us to abort the entire scan. yes the tree
-               // will be incomplete however it will be even more incompete
-               // if we fail entirely
-               Error error = scanFiles(child, options, pTree);
-               if (error)
-                  LOG_ERROR(error);
+               while (pListing->state != Done)
+                  readCondition_.wait(lock);
             }
          }
-         else
+      }
+
+      if (readHere)
+         return readDirectory(dirPath, pFiles);
+
+      pFiles->swap(pListing->files);
+      return pListing->error;
+   }
+
+private:
+   enum ListingState { Queued, Reading, Done };
+
+   struct Listing
+   {
+      Listing() : state(Queued) {}
+      ListingState state;
+      Error error;
+      std::vector<FileInfo> files;
+   };
+
+   void readerThreadMain()
+   {
+      try
+      {
+         while (true)
          {
-            pTree->append_child(fromNode, fileInfo);
+            std::string dirPath;
+            boost::shared_ptr<Listing> pListing;
+
+            {
+               boost::unique_lock<boost::mutex> lock(mutex_);
+               while (queue_.empty() && !stopping_)
+                  queuedCondition_.wait(lock);
+
+               if (stopping_)
+                  return;
+
+               dirPath = queue_.front();
+               queue_.pop_front();
+               pListing = listings_[dirPath];
+               pListing->state = Reading;
+            }
+
+            Error error = readDirectory(dirPath, &pListing->files);
+
+            LOCK_MUTEX(mutex_)
+            {
+               pListing->error = error;
+               pListing->state = Done;
+            }
+            END_LOCK_MUTEX
+
+            readCondition_.notify_all();
          }
       }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+private:
+   boost::mutex mutex_;
+   boost::condition queuedCondition_;
+   boost::condition readCondition_;
+   bool stopping_;
+   std::deque<std::string> queue_;
+   std::map<std::string, boost::shared_ptr<Listing> > listings_;
+   boost::thread_group threads_;
+};
+
+Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
+                const FileScannerOptions& options,
+                DirectoryReader* pReader,
+                tree<FileInfo>* pTree)
+{
+   // clear all existing
+   pTree->erase_children(fromNode);
+
+   // yield if requested (only applies to recursive scans)
+   if (options.recursive && options.yield)
+      boost::this_thread::yield();
+
+   // read directory contents
+   std::vector<FileInfo> files;
+   Error error = pReader ? pReader->read(fromNode->absolutePath(), &files) :
+                           readDirectory(fromNode->absolutePath(), &files);
+   if (error)
+      return error;
+
+   // apply the filter (if any) and determine which subdirectories we'll
+   // scan. we call onBeforeScanDir for each of them now (so that it
+   // always occurs prior to the directory being read)
+   std::vector<FileInfo> included;
+   std::vector<bool> scanSubdir;
+   std::vector<std::string> subdirPaths;
+   BOOST_FOREACH(const FileInfo& fileInfo, files)
+   {
+      if (options.filter && !options.filter(fileInfo))
+         continue;
+
+      included.push_back(fileInfo);
+
+      // recurse if requested and this isn't a link
+      bool scan = options.recursive &&
+                  fileInfo.isDirectory() &&
+                  !fileInfo.isSymlink();
+      if (scan && options.onBeforeScanDir)
+      {
+         Error error = options.onBeforeScanDir(fileInfo);
+         if (error)
+         {
+            // we don't want one "bad" directory to cause us to abort
+            // the entire scan
+            LOG_ERROR(error);
+            scan = false;
+         }
+      }
+
+      scanSubdir.push_back(scan);
+      if (scan)
+         subdirPaths.push_back(fileInfo.absolutePath());
+   }
+
+   if (pReader && !subdirPaths.empty())
+      pReader->readAhead(subdirPaths);
+
+   // add the files to the tree (recursing into subdirectories)
+   for (std::size_t i = 0; i < included.size(); i++)
+   {
+      tree<FileInfo>::iterator_base child = pTree->append_child(fromNode,
+                                                                included[i]);
+      if (scanSubdir[i])
+      {
+         // try to scan the files in the subdirectory -- if we fail
+         // we continue because we don't want one "bad" directory
+         // to cause us to abort the entire scan. yes the tree
+         // will be incomplete however it will be even more incompete
+         // if we fail entirely
+         Error error = scanFiles(child, options, pReader, pTree);
+         if (error)
+            LOG_ERROR(error);
+      }
    }
 
    // return success
    return Success();
 }
 
+} // anonymous namespace
+
+Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
+                const FileScannerOptions& options,
+                tree<FileInfo>* pTree)
+{
+   // call onBeforeScanDir hook (for subdirectories it is called as they
+   // are discovered)
+   if (options.onBeforeScanDir)
+   {
+      Error error = options.onBeforeScanDir(*fromNode);
+      if (error)
+         return error;
+   }
+
+   // read directories on background threads if requested (the scanning
+   // thread also reads so it counts as one of the threads)
+   boost::scoped_ptr<DirectoryReader> pReader;
+   if (options.recursive && options.threads > 1)
+      pReader.reset(new DirectoryReader(options.threads - 1));
+
+   return scanFiles(fromNode, options, pReader.get(), pTree);
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
 
+
+
@@ -19,8 +19,11 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <algorithm>
 #include <iostream>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 #include <core/Log.hpp>
 #include <core/Error.hpp>
 #include <core/BoostThread.hpp>
@@ -34,26 +37,91 @@ namespace system {
 
 namespace {
 
-void readFromPipe(
-      int pipeFd,
-      const boost::function<void(const std::string&)>& outputFunction)
+// output is read directly into a batch which is handed to the handler once
+// it's large enough or has been pending for long enough (so a tight loop of
+// tiny writes, e.g. printing from compiled code, doesn't turn into a
+// callback per write). reads start small and grow while they fill their
+// buffer so bulk output is read with few system calls
+const std::size_t kMinReadSize = 4096;
+const std::size_t kMaxReadSize = 65536;
+const std::size_t kMaxBatchSize = 262144;
+const int kMaxBatchDelayMs = 20;
+
+class OutputStream
 {
-   const int kBufferSize = 512;
-   char buffer[kBufferSize];
-   int bytesRead = 0;
-   while ( (bytesRead = ::read(pipeFd, buffer, kBufferSize)) > 0 )
+public:
+   OutputStream(int fd,
+                const boost::function<void(const std::string&)>& handler)
+      : fd_(fd), handler_(handler), readSize_(kMinReadSize)
    {
-      std::string output(buffer, bytesRead);
-      outputFunction(output);
    }
 
-   // log unexpected errors
-   if (bytesRead == -1)
+   int fd() const { return fd_; }
+
+   bool hasPending() const { return !batch_.empty(); }
+
+   bool batchFull() const { return batch_.size() >= kMaxBatchSize; }
+
+   // milliseconds until the pending batch is due (0 if it's due now)
+   int msUntilDue() const
    {
-      if (errno != EAGAIN && errno != EINTR)
-         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+      boost::posix_time::time_duration elapsed =
+            boost::posix_time::microsec_clock::universal_time() - batchStarted_;
+      long remaining = kMaxBatchDelayMs - elapsed.total_milliseconds();
+      return remaining > 0 ? static_cast<int>(remaining) : 0;
    }
-}
+
+   // read everything available from the pipe into the batch (flushing it
+   // whenever it fills)
+   void read()
+   {
+      for (;;)
+      {
+         std::size_t size = batch_.size();
+         batch_.resize(size + readSize_);
+         ssize_t bytesRead = ::read(fd_, &batch_[size], readSize_);
+         batch_.resize(size + (bytesRead > 0 ? bytesRead : 0));
+
+         if (bytesRead > 0)
+         {
+            if (size == 0)
+               batchStarted_ = boost::posix_time::microsec_clock::universal_time();
+
+            // adapt the read size to the volume of output
+            if (static_cast<std::size_t>(bytesRead) == readSize_)
+               readSize_ = std::min(readSize_ * 2, kMaxReadSize);
+            else if (static_cast<std::size_t>(bytesRead) < readSize_ / 4)
+               readSize_ = std::max(readSize_ / 2, kMinReadSize);
+
+            if (batchFull())
+               flush();
+         }
+         else
+         {
+            // log unexpected errors
+            if (bytesRead == -1 && errno != EAGAIN && errno != EINTR)
+               LOG_ERROR(systemError(errno, ERROR_LOCATION));
+            return;
+         }
+      }
+   }
+
+   void flush()
+   {
+      if (batch_.empty())
+         return;
+
+      handler_(batch_);
+      batch_.clear();
+   }
+
+private:
+   int fd_;
+   boost::function<void(const std::string&)> handler_;
+   std::size_t readSize_;
+   std::string batch_;
+   boost::posix_time::ptime batchStarted_;
+};
 
 void standardStreamCaptureThread(
        int stdoutFd,
@@ -63,6 +131,9 @@ void standardStreamCaptureThread(
 {
    try
    {
+      OutputStream stdoutStream(stdoutFd, stdoutHandler);
+      OutputStream stderrStream(stderrFd, stderrHandler);
+
       while(true)
       {
          // create fd set
@@ -72,24 +143,52 @@ void standardStreamCaptureThread(
          if (stderrFd != -1)
             FD_SET(stderrFd, &fds);
 
-         // wait
+         // wait (only until the next pending batch is due)
+         struct timeval timeout;
+         struct timeval* pTimeout = NULL;
+         if (stdoutStream.hasPending() || stderrStream.hasPending())
+         {
+            int ms = kMaxBatchDelayMs;
+            if (stdoutStream.hasPending())
+               ms = std::min(ms, stdoutStream.msUntilDue());
+            if (stderrStream.hasPending())
+               ms = std::min(ms, stderrStream.msUntilDue());
+            timeout.tv_sec = 0;
+            timeout.tv_usec = ms * 1000;
+            pTimeout = &timeout;
+         }
+
          int highFd = std::max(stdoutFd, stderrFd);
-         int result = ::select(highFd+1, &fds, NULL, NULL, NULL);
-         if (result != -1)
+         int result = ::select(highFd+1, &fds, NULL, NULL, pTimeout);
+         if (result > 0)
          {
+            // output on one stream flushes the other's pending batch so
+            // that the ordering of stdout and stderr is preserved
             if (FD_ISSET(stdoutFd, &fds))
-               readFromPipe(stdoutFd, stdoutHandler);
+            {
+               stderrStream.flush();
+               stdoutStream.read();
+            }
 
             if (stderrFd != -1)
             {
                if (FD_ISSET(stderrFd, &fds))
-                  readFromPipe(stderrFd, stderrHandler);
+               {
+                  stdoutStream.flush();
+                  stderrStream.read();
+               }
             }
          }
-         else if (errno != EINTR)
+         else if (result == -1 && errno != EINTR)
          {
             LOG_ERROR(systemError(errno, ERROR_LOCATION));
          }
+
+         // deliver batches which are due
+         if (stdoutStream.hasPending() && stdoutStream.msUntilDue() == 0)
+            stdoutStream.flush();
+         if (stderrStream.hasPending() && stderrStream.msUntilDue() == 0)
+            stderrStream.flush();
       }
    }
    CATCH_UNEXPECTED_EXCEPTION
@@ -0,0 +1,268 @@
+/*
+ * PosixSamplingProfiler.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/system/SamplingProfiler.hpp>
+
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <core/Backtrace.hpp>
+#include <core/Error.hpp>
+
+#ifndef __APPLE__
+# include <dlfcn.h>
+# include <execinfo.h>
+#endif
+
+namespace rstudio {
+namespace core {
+namespace system {
+namespace sampling_profiler {
+
+#ifndef __APPLE__
+
+namespace {
+
+const int kMaxSamples = 20000;
+const int kMaxFrames = 64;
+
+// frames belonging to the signal handler and the kernel's trampoline
+const int kHandlerFrames = 2;
+
+struct Sample
+{
+   volatile int depth;
+   void* frames[kMaxFrames];
+};
+
+// allocated on first start and never freed (the handler may still be
+// running on another thread when the profiler is stopped)
+Sample* s_pSamples = NULL;
+volatile int s_nextSample = 0;
+volatile int s_dropped = 0;
+
+bool s_running = false;
+timer_t s_timer;
+
+int profileSignal()
+{
+   return SIGRTMIN + 4;
+}
+
+void onProfileSignal(int)
+{
+   int savedErrno = errno;
+
+   int index = __sync_fetch_and_add(&s_nextSample, 1);
+   if (index < kMaxSamples)
+   {
+      Sample& sample = s_pSamples[index];
+      int depth = ::backtrace(sample.frames, kMaxFrames);
+      __sync_synchronize();
+      sample.depth = depth;
+   }
+   else
+   {
+      __sync_fetch_and_add(&s_dropped, 1);
+   }
+
+   errno = savedErrno;
+}
+
+std::string frameName(void* address)
+{
+   Dl_info info;
+   if (::dladdr(address, &info) == 0)
+      return boost::str(boost::format("%p") % address);
+
+   if (info.dli_sname != NULL)
+      return backtrace::demangle(info.dli_sname);
+
+   std::string module = info.dli_fname != NULL ? info.dli_fname : "?";
+   std::string::size_type pos = module.find_last_of('/');
+   if (pos != std::string::npos)
+      module = module.substr(pos + 1);
+
+   std::size_t offset = static_cast<char*>(address) -
+                        static_cast<char*>(info.dli_fbase);
+   return boost::str(boost::format("%1%+0x%2$x") % module % offset);
+}
+
+} // anonymous namespace
+
+Error start(int intervalMs)
+{
+   if (s_running)
+      return systemError(EALREADY, ERROR_LOCATION);
+
+   if (s_pSamples == NULL)
+   {
+      s_pSamples = new Sample[kMaxSamples];
+
+      // the first call to backtrace loads libgcc, which must not happen
+      // within the signal handler
+      void* frames[1];
+      ::backtrace(frames, 1);
+   }
+
+   for (int i = 0; i < kMaxSamples; i++)
+      s_pSamples[i].depth = 0;
+   s_nextSample = 0;
+   s_dropped = 0;
+
+   struct sigaction sa;
+   ::memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = onProfileSignal;
+   sa.sa_flags = SA_RESTART;
+   ::sigemptyset(&sa.sa_mask);
+   if (::sigaction(profileSignal(), &sa, NULL) == -1)
+      return systemError(errno, ERROR_LOCATION);
+
+   struct sigevent sev;
+   ::memset(&sev, 0, sizeof(sev));
+   sev.sigev_notify = SIGEV_SIGNAL;
+   sev.sigev_signo = profileSignal();
+   if (::timer_create(CLOCK_PROCESS_CPUTIME_ID, &sev, &s_timer) == -1)
+      return systemError(errno, ERROR_LOCATION);
+
+   struct itimerspec spec;
+   spec.it_interval.tv_sec = intervalMs / 1000;
+   spec.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+   spec.it_value = spec.it_interval;
+   if (::timer_settime(s_timer, 0, &spec, NULL) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      ::timer_delete(s_timer);
+      return error;
+   }
+
+   s_running = true;
+   return Success();
+}
+
+void stop()
+{
+   if (!s_running)
+      return;
+
+   ::timer_delete(s_timer);
+   s_running = false;
+
+   // leave the handler installed: a signal may still be pending
+}
+
+bool isRunning()
+{
+   return s_running;
+}
+
+std::size_t sampleCount()
+{
+   return std::min(__sync_fetch_and_add(&s_nextSample, 0), kMaxSamples);
+}
+
+std::size_t droppedSampleCount()
+{
+   return __sync_fetch_and_add(&s_dropped, 0);
+}
+
+void writeFolded(std::ostream& os)
+{
+   if (s_pSamples == NULL)
+      return;
+
+   // count the distinct stacks (by name, since samples within the same
+   // function have different addresses), naming each address once
+   std::map<void*, std::string> names;
+   std::map<std::string, int> stacks;
+   std::size_t count = sampleCount();
+   for (std::size_t i = 0; i < count; i++)
+   {
+      const Sample& sample = s_pSamples[i];
+      int depth = sample.depth;
+      __sync_synchronize();
+      if (depth <= kHandlerFrames)
+         continue;
+
+      // root frame first
+      std::string folded;
+      for (int j = depth - 1; j >= kHandlerFrames; j--)
+      {
+         void* address = sample.frames[j];
+         std::map<void*, std::string>::iterator name = names.find(address);
+         if (name == names.end())
+            name = names.insert(std::make_pair(address,
+                                               frameName(address))).first;
+
+         if (!folded.empty())
+            folded += ';';
+         folded += name->second;
+      }
+      stacks[folded]++;
+   }
+
+   for (std::map<std::string, int>::const_iterator it = stacks.begin();
+        it != stacks.end(); ++it)
+   {
+      os << it->first << ' ' << it->second << '\n';
+   }
+}
+
+#else
+
+Error start(int intervalMs)
+{
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+}
+
+void stop()
+{
+}
+
+bool isRunning()
+{
+   return false;
+}
+
+std::size_t sampleCount()
+{
+   return 0;
+}
+
+std::size_t droppedSampleCount()
+{
+   return 0;
+}
+
+void writeFolded(std::ostream& os)
+{
+}
+
+#endif
+
+} // namespace sampling_profiler
+} // namespace system
+} // namespace core
+} // namespace rstudio
@@ -15,9 +15,18 @@
 
 #include <core/system/PosixSched.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
 #include <sched.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 
 #include <core/Error.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/StringUtils.hpp>
 
 namespace rstudio {
 namespace core {
@@ -28,6 +37,91 @@ int cpuCount()
    return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+namespace {
+
+#ifdef __linux__
+
+// the cpu quota (in cpus) imposed on our cgroup, or 0 for none
+double cgroupCpuQuota()
+{
+   std::string cgroups;
+   Error error = readStringFromFile(FilePath("/proc/self/cgroup"), &cgroups);
+   if (error)
+      return 0;
+
+   std::istringstream istr(cgroups);
+   std::string line;
+   while (std::getline(istr, line))
+   {
+      // hierarchy-id:controllers:path
+      std::string::size_type first = line.find(':');
+      std::string::size_type second = line.find(':', first + 1);
+      if (first == std::string::npos || second == std::string::npos)
+         continue;
+      std::string controllers = line.substr(first + 1, second - first - 1);
+      std::string path = line.substr(second + 1);
+
+      std::string quota, period;
+      if (line.compare(0, 3, "0::") == 0)
+      {
+         // cgroup v2: cpu.max contains "<quota|max> <period>"
+         std::string cpuMax;
+         if (readStringFromFile(FilePath("/sys/fs/cgroup" + path + "/cpu.max"),
+                                &cpuMax))
+         {
+            continue;
+         }
+         std::istringstream maxStr(cpuMax);
+         maxStr >> quota >> period;
+      }
+      else if (("," + controllers + ",").find(",cpu,") != std::string::npos)
+      {
+         // cgroup v1 (the path isn't visible within a container's
+         // namespace, in which case the root of the hierarchy is ours)
+         FilePath cpuDir("/sys/fs/cgroup/cpu" + path);
+         if (!cpuDir.exists())
+            cpuDir = FilePath("/sys/fs/cgroup/cpu");
+         readStringFromFile(cpuDir.childPath("cpu.cfs_quota_us"), &quota);
+         readStringFromFile(cpuDir.childPath("cpu.cfs_period_us"), &period);
+      }
+      else
+      {
+         continue;
+      }
+
+      double quotaUs = safe_convert::stringTo<double>(
+                                 string_utils::trimWhitespace(quota), -1);
+      double periodUs = safe_convert::stringTo<double>(
+                                 string_utils::trimWhitespace(period), 0);
+      if (quotaUs > 0 && periodUs > 0)
+         return quotaUs / periodUs;
+   }
+
+   return 0;
+}
+
+#endif
+
+} // anonymous namespace
+
+int availableCpuCount()
+{
+   int cpus = cpuCount();
+
+#ifdef __linux__
+   cpu_set_t cs;
+   CPU_ZERO(&cs);
+   if (::sched_getaffinity(0, sizeof(cs), &cs) == 0)
+      cpus = std::min(cpus, CPU_COUNT(&cs));
+
+   double quota = cgroupCpuQuota();
+   if (quota > 0)
+      cpus = std::min(cpus, static_cast<int>(std::ceil(quota)));
+#endif
+
+   return std::max(cpus, 1);
+}
+
 CpuAffinity emptyCpuAffinity()
 {
    return std::vector<bool>(cpuCount(), false);
@@ -86,6 +180,42 @@ Error setCpuAffinity(const CpuAffinity& cpus)
 #endif
 }
 
+Error getLoadPerCpu(double* pLoad)
+{
+   double load = 0;
+   if (::getloadavg(&load, 1) != 1)
+      return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+
+   *pLoad = load / std::max(cpuCount(), 1);
+   return Success();
+}
+
+Error moveToCpuCgroup(const std::string& cgroupPath, int cpuWeight)
+{
+#ifdef __linux__
+   if (::mkdir(cgroupPath.c_str(), 0755) == -1 && errno != EEXIST)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", cgroupPath);
+      return error;
+   }
+
+   FilePath cgroupDir(cgroupPath);
+   if (cpuWeight > 0)
+   {
+      Error error = writeStringToFile(cgroupDir.childPath("cpu.weight"),
+                                      safe_convert::numberToString(cpuWeight));
+      if (error)
+         return error;
+   }
+
+   // writing 0 moves the writing process
+   return writeStringToFile(cgroupDir.childPath("cgroup.procs"), "0");
+#else
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+#endif
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
@@ -46,6 +46,7 @@
 #ifndef __APPLE__
 #include <sys/prctl.h>
 #include <sys/sysinfo.h>
+#include <sys/syscall.h>
 #include <linux/kernel.h>
 #include <dirent.h>
 #endif
@@ -495,6 +496,70 @@ namespace {
 // constructs with Win32 no-ops to creep in (since this is used on
 // Posix for forking and has no purpose on Win32)
 
+#ifndef __APPLE__
+
+// close descriptors >= fdStart using the close_range system call (linux 5.9
+// and later). returns false if the call isn't available
+bool closeRange(int fdStart)
+{
+#ifdef SYS_close_range
+   return ::syscall(SYS_close_range, fdStart, ~0U, 0) == 0;
+#else
+   return false;
+#endif
+}
+
+// close descriptors >= fdStart by enumerating /proc/self/fd. this is called
+// in forked children so it reads the directory using a stack buffer rather
+// than opendir (which could deadlock on a malloc lock held by another of the
+// parent's threads). returns false if /proc isn't available
+bool closeProcSelfFds(int fdStart)
+{
+   int dirFd = ::open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (dirFd == -1)
+      return false;
+
+   struct LinuxDirent64
+   {
+      unsigned long long d_ino;
+      long long d_off;
+      unsigned short d_reclen;
+      unsigned char d_type;
+      char d_name[1];
+   };
+
+   char buffer[4096];
+   for (;;)
+   {
+      long bytes = ::syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+      if (bytes <= 0)
+         break;
+
+      for (long offset = 0; offset < bytes; )
+      {
+         LinuxDirent64* pEntry =
+                  reinterpret_cast<LinuxDirent64*>(buffer + offset);
+         offset += pEntry->d_reclen;
+
+         // entries are the descriptor numbers (skipping . and ..)
+         int fd = 0;
+         const char* pName = pEntry->d_name;
+         if (*pName < '0' || *pName > '9')
+            continue;
+         for (; *pName >= '0' && *pName <= '9'; ++pName)
+            fd = (fd * 10) + (*pName - '0');
+
+         if (fd >= fdStart && fd != dirFd)
+            ::close(fd);
+      }
+   }
+
+   ::close(dirFd);
+   return true;
+}
+
+#endif
+
 Error closeFileDescriptorsFrom(int fdStart)
 {
    // There is no fully reliable and cross-platform way to do this, see:
@@ -502,6 +567,7 @@ Error closeFileDescriptorsFrom(int fdStart)
    // Various potential mechanisms include:
    //
    //  - closefrom
+   //  - close_range
    //  - fcntl(0, F_MAXFD)
    //  - sysconf(_SC_OPEN_MAX)
    //  - getrlimit(RLIMIT_NOFILE, &rl)
@@ -511,6 +577,15 @@ Error closeFileDescriptorsFrom(int fdStart)
    // Note that the above functions may return either -1 or MAX_INT, in
    // which case substituting/truncating to an appropriate number (1024?)
    // is still required
+   //
+   // On linux we use close_range or /proc/self/fd where available since
+   // the descriptor limit can be very large (e.g. 1M) and looping over it
+   // makes launching a child process take hundreds of milliseconds
+
+#ifndef __APPLE__
+   if (closeRange(fdStart) || closeProcSelfFds(fdStart))
+      return Success();
+#endif
 
    // get limit
    struct rlimit rl;
@@ -1185,6 +1260,16 @@ void setProcessLimits(ProcessLimits limits)
          LOG_ERROR(error);
    }
 
+   // cpu cgroup
+#ifndef __APPLE__
+   if (!limits.cpuCgroup.empty())
+   {
+      Error error = moveToCpuCgroup(limits.cpuCgroup, limits.cpuWeight);
+      if (error)
+         LOG_ERROR(error);
+   }
+#endif
+
    // priority
    if (limits.priority != 0)
    {
@@ -64,8 +64,17 @@ Error runCommand(const std::string& command,
 struct ProcessSupervisor::Impl
 {
    Impl() : isPolling(false) {}
+
+   // re-arm the activity watch (if any) for the current children
+   void watchChildren()
+   {
+      if (pWatcher)
+         pWatcher->watch(children);
+   }
+
    bool isPolling;
    std::vector<boost::shared_ptr<AsyncChildProcess> > children;
+   boost::scoped_ptr<ChildActivityWatcher> pWatcher;
 };
 
 ProcessSupervisor::ProcessSupervisor()
@@ -109,7 +118,10 @@ Error ProcessSupervisor::runProgram(const std::string& executable,
                                                        options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), callbacks);
+   Error error = runChild(pChild, &(pImpl_->children), callbacks);
+   if (!error)
+      pImpl_->watchChildren();
+   return error;
 }
 
 Error ProcessSupervisor::runCommand(const std::string& command,
@@ -121,7 +133,10 @@ Error ProcessSupervisor::runCommand(const std::string& command,
                                  new AsyncChildProcess(command, options));
 
    // run the child
-   return runChild(pChild, &(pImpl_->children), callbacks);
+   Error error = runChild(pChild, &(pImpl_->children), callbacks);
+   if (!error)
+      pImpl_->watchChildren();
+   return error;
 }
 
 namespace {
@@ -301,10 +316,20 @@ bool ProcessSupervisor::poll()
                              boost::bind(&AsyncChildProcess::exited, _1)),
                           pImpl_->children.end());
 
+   // watch the remaining children for further activity
+   pImpl_->watchChildren();
+
    // return status
    return hasRunningChildren();
 }
 
+void ProcessSupervisor::setActivityHandler(
+                              const boost::function<void()>& onActivity)
+{
+   pImpl_->pWatcher.reset(new ChildActivityWatcher(onActivity));
+   pImpl_->watchChildren();
+}
+
 void ProcessSupervisor::terminateAll()
 {
    // call terminate on all of our children
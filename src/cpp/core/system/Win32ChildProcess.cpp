@@ -15,6 +15,7 @@
 
 #include "ChildProcess.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 #include <windows.h>
@@ -22,12 +23,16 @@
 
 
 #include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <core/BoostErrors.hpp>
 #include <core/system/System.hpp>
 #include <core/system/ShellUtils.hpp>
 #include <core/FilePath.hpp>
 #include <core/StringUtils.hpp>
+#include <core/Thread.hpp>
 
 #include "CriticalSection.hpp"
 
@@ -102,32 +107,188 @@ void resolveCommand(std::string* pExecutable, std::vector<std::string>* pArgs)
 }
 
 
-Error readPipeAvailableBytes(HANDLE hPipe, std::string* pOutput)
+// size of the reads of async child output (and of the pipe buffer)
+const DWORD kOverlappedBufferSize = 65536;
+
+// create a pipe whose read end supports overlapped i/o (anonymous pipes
+// don't, so this is a uniquely named pipe which only allows one instance)
+Error createOverlappedPipe(HANDLE* phRead, HANDLE* phWrite)
 {
-   // check for available bytes
-   DWORD dwAvail = 0;
-   if (!::PeekNamedPipe(hPipe, NULL, 0, NULL, &dwAvail, NULL))
+   static volatile LONG s_pipeSerial = 0;
+   std::string name = boost::str(
+            boost::format("\\\\.\\pipe\\rstudio-child-%1%-%2%")
+               % ::GetCurrentProcessId()
+               % ::InterlockedIncrement(&s_pipeSerial));
+
+   *phRead = ::CreateNamedPipe(name.c_str(),
+                               PIPE_ACCESS_INBOUND |
+                               FILE_FLAG_OVERLAPPED |
+                               FILE_FLAG_FIRST_PIPE_INSTANCE,
+                               PIPE_TYPE_BYTE | PIPE_WAIT |
+                               PIPE_REJECT_REMOTE_CLIENTS,
+                               1,
+                               0,
+                               kOverlappedBufferSize,
+                               0,
+                               NULL);
+   if (*phRead == INVALID_HANDLE_VALUE)
    {
-      if (::GetLastError() == ERROR_BROKEN_PIPE)
-         return Success();
-      else
+      *phRead = NULL;
+      return systemError(::GetLastError(), ERROR_LOCATION);
+   }
+
+   *phWrite = ::CreateFile(name.c_str(),
+                           GENERIC_WRITE,
+                           0,
+                           NULL,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL,
+                           NULL);
+   if (*phWrite == INVALID_HANDLE_VALUE)
+   {
+      Error error = systemError(::GetLastError(), ERROR_LOCATION);
+      *phWrite = NULL;
+      Error closeError = closeHandle(phRead, ERROR_LOCATION);
+      if (closeError)
+         LOG_ERROR(closeError);
+      return error;
+   }
+
+   return Success();
+}
+
+// reads an async child's output pipe with overlapped i/o. a read is kept
+// pending so that its event is signaled as soon as output arrives (which
+// ChildActivityWatcher waits on) and poll collects whatever has completed
+// without blocking
+class OverlappedReader : boost::noncopyable
+{
+public:
+   OverlappedReader()
+      : hPipe_(NULL), pending_(false), finished_(false)
+   {
+      ::ZeroMemory(&overlapped_, sizeof(OVERLAPPED));
+   }
+
+   ~OverlappedReader()
+   {
+      try
+      {
+         // the system may still write into the buffer until the pending
+         // read has been cancelled
+         if (pending_)
+         {
+            DWORD nBytesRead;
+            ::CancelIo(hPipe_);
+            ::GetOverlappedResult(hPipe_, &overlapped_, &nBytesRead, TRUE);
+         }
+         Error error = closeHandle(&overlapped_.hEvent, ERROR_LOCATION);
+         if (error)
+            LOG_ERROR(error);
+      }
+      catch(...)
+      {
+      }
+   }
+
+   Error start(HANDLE hPipe)
+   {
+      hPipe_ = hPipe;
+      buffer_.resize(kOverlappedBufferSize);
+      overlapped_.hEvent = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+      if (overlapped_.hEvent == NULL)
+      {
+         finished_ = true;
          return systemError(::GetLastError(), ERROR_LOCATION);
+      }
+
+      return Success();
+   }
+
+   bool started() const { return hPipe_ != NULL; }
+
+   // event signaled when the pending read completes (NULL if none)
+   HANDLE pendingEvent() const
+   {
+      return (pending_ && !finished_) ? overlapped_.hEvent : NULL;
    }
 
-   // no data available
-   if (dwAvail == 0)
+   // collect completed reads (issuing new reads until one is left pending)
+   Error read(std::string* pOutput)
+   {
+      while (!finished_)
+      {
+         DWORD nBytesRead = 0;
+         if (pending_)
+         {
+            if (!::GetOverlappedResult(hPipe_, &overlapped_, &nBytesRead, FALSE))
+            {
+               DWORD lastError = ::GetLastError();
+               if (lastError == ERROR_IO_INCOMPLETE)
+                  return Success();
+
+               pending_ = false;
+               finished_ = true;
+               if (lastError == ERROR_BROKEN_PIPE)
+                  return Success();
+               else
+                  return systemError(lastError, ERROR_LOCATION);
+            }
+
+            pending_ = false;
+            pOutput->append(&(buffer_[0]), nBytesRead);
+         }
+
+         // issue the next read (if it completes immediately its result is
+         // collected by GetOverlappedResult on the next iteration)
+         ::ResetEvent(overlapped_.hEvent);
+         if (!::ReadFile(hPipe_,
+                         &(buffer_[0]),
+                         static_cast<DWORD>(buffer_.size()),
+                         NULL,
+                         &overlapped_))
+         {
+            DWORD lastError = ::GetLastError();
+            if (lastError == ERROR_IO_PENDING)
+            {
+               pending_ = true;
+               return Success();
+            }
+
+            finished_ = true;
+            if (lastError == ERROR_BROKEN_PIPE)
+               return Success();
+            else
+               return systemError(lastError, ERROR_LOCATION);
+         }
+         pending_ = true;
+      }
+
       return Success();
+   }
 
-   // read data which is available
-   DWORD nBytesRead;
-   std::vector<CHAR> buffer(dwAvail, 0);
-   if (!::ReadFile(hPipe, &(buffer[0]), dwAvail, &nBytesRead, NULL))
-      return systemError(::GetLastError(), ERROR_LOCATION);
+private:
+   HANDLE hPipe_;
+   OVERLAPPED overlapped_;
+   std::vector<CHAR> buffer_;
+   bool pending_;
+   bool finished_;
+};
 
-   // append to output
-   pOutput->append(&(buffer[0]), nBytesRead);
+Error duplicateHandle(HANDLE hSource, HANDLE* phTarget)
+{
+   if (!::DuplicateHandle(::GetCurrentProcess(),
+                          hSource,
+                          ::GetCurrentProcess(),
+                          phTarget,
+                          SYNCHRONIZE,
+                          FALSE,
+                          0))
+   {
+      *phTarget = NULL;
+      return systemError(::GetLastError(), ERROR_LOCATION);
+   }
 
-   // success
    return Success();
 }
 
@@ -170,10 +331,13 @@ struct ChildProcess::Impl
         hStdOutRead(NULL),
         hStdErrRead(NULL),
         hProcess(NULL),
+        hJob(NULL),
+        overlappedOutput(false),
         closeStdIn_(&hStdInWrite, ERROR_LOCATION),
         closeStdOut_(&hStdOutRead, ERROR_LOCATION),
         closeStdErr_(&hStdErrRead, ERROR_LOCATION),
-        closeProcess_(&hProcess, ERROR_LOCATION)
+        closeProcess_(&hProcess, ERROR_LOCATION),
+        closeJob_(&hJob, ERROR_LOCATION)
    {
    }
 
@@ -182,11 +346,19 @@ struct ChildProcess::Impl
    HANDLE hStdErrRead;
    HANDLE hProcess;
 
+   // job containing the process and its descendants (NULL if the process
+   // couldn't be assigned to one)
+   HANDLE hJob;
+
+   // create the output pipes for overlapped reads (async children)
+   bool overlappedOutput;
+
 private:
    CloseHandleOnExitScope closeStdIn_;
    CloseHandleOnExitScope closeStdOut_;
    CloseHandleOnExitScope closeStdErr_;
    CloseHandleOnExitScope closeProcess_;
+   CloseHandleOnExitScope closeJob_;
 };
 
 
@@ -261,7 +433,16 @@ Error ChildProcess::ptyInterrupt()
 
 Error ChildProcess::terminate()
 {
-   // terminate with exit code 15 (15 is SIGTERM on posix)
+   // terminate with exit code 15 (15 is SIGTERM on posix). when the
+   // process is in a job then terminate the job so that any processes
+   // it started are terminated along with it
+   if (pImpl_->hJob != NULL)
+   {
+      if (::TerminateJobObject(pImpl_->hJob, 15))
+         return Success();
+      LOG_ERROR(systemError(::GetLastError(), ERROR_LOCATION));
+   }
+
    if (!::TerminateProcess(pImpl_->hProcess, 15))
       return systemError(::GetLastError(), ERROR_LOCATION);
    else
@@ -324,9 +505,17 @@ Error ChildProcess::run()
       return systemError(::GetLastError(), ERROR_LOCATION);
 
    // Standard output pipe
-   HANDLE hStdOutWrite;
-   if (!::CreatePipe(&pImpl_->hStdOutRead, &hStdOutWrite, NULL, 0))
+   HANDLE hStdOutWrite = NULL;
+   if (pImpl_->overlappedOutput)
+   {
+      error = createOverlappedPipe(&pImpl_->hStdOutRead, &hStdOutWrite);
+      if (error)
+         return error;
+   }
+   else if (!::CreatePipe(&pImpl_->hStdOutRead, &hStdOutWrite, NULL, 0))
+   {
       return systemError(::GetLastError(), ERROR_LOCATION);
+   }
    CloseHandleOnExitScope closeStdOut(&hStdOutWrite, ERROR_LOCATION);
    if (!::SetHandleInformation(hStdOutWrite,
                                HANDLE_FLAG_INHERIT,
@@ -334,9 +523,17 @@ Error ChildProcess::run()
       return systemError(::GetLastError(), ERROR_LOCATION);
 
    // Standard error pipe
-   HANDLE hStdErrWrite;
-   if (!::CreatePipe(&pImpl_->hStdErrRead, &hStdErrWrite, NULL, 0))
+   HANDLE hStdErrWrite = NULL;
+   if (pImpl_->overlappedOutput)
+   {
+      error = createOverlappedPipe(&pImpl_->hStdErrRead, &hStdErrWrite);
+      if (error)
+         return error;
+   }
+   else if (!::CreatePipe(&pImpl_->hStdErrRead, &hStdErrWrite, NULL, 0))
+   {
       return systemError(::GetLastError(), ERROR_LOCATION);
+   }
    CloseHandleOnExitScope closeStdErr(&hStdErrWrite, ERROR_LOCATION);
    if (!::SetHandleInformation(hStdErrWrite,
                                HANDLE_FLAG_INHERIT,
@@ -437,6 +634,13 @@ Error ChildProcess::run()
    if (options_.breakawayFromJob)
       dwFlags |= CREATE_BREAKAWAY_FROM_JOB;
 
+   // processes are placed in a job (so that terminate can end the processes
+   // they start as well) unless they're meant to outlive us. they start
+   // suspended so they can't start any processes before they're assigned
+   bool useJob = !options_.breakawayFromJob && !options_.detachProcess;
+   if (useJob)
+      dwFlags |= CREATE_SUSPENDED;
+
    std::string workingDir;
    if (!options_.workingDir.empty())
    {
@@ -469,6 +673,28 @@ Error ChildProcess::run()
    // save handle to process
    pImpl_->hProcess = pi.hProcess;
 
+   if (useJob)
+   {
+      // assignment fails if we're in a job which doesn't allow nested jobs
+      // or breakaway (prior to windows 8), in which case terminate falls
+      // back to terminating just the process
+      pImpl_->hJob = ::CreateJobObject(NULL, NULL);
+      if (pImpl_->hJob != NULL &&
+          !::AssignProcessToJobObject(pImpl_->hJob, pi.hProcess))
+      {
+         Error error = closeHandle(&pImpl_->hJob, ERROR_LOCATION);
+         if (error)
+            LOG_ERROR(error);
+      }
+
+      if (::ResumeThread(pi.hThread) == (DWORD)-1)
+      {
+         Error error = systemError(::GetLastError(), ERROR_LOCATION);
+         ::TerminateProcess(pi.hProcess, 15);
+         return error;
+      }
+   }
+
    // success
    return Success();
 }
@@ -524,6 +750,8 @@ struct AsyncChildProcess::AsyncImpl
    }
 
    bool calledOnStarted_;
+   OverlappedReader stdOutReader_;
+   OverlappedReader stdErrReader_;
 };
 
 AsyncChildProcess::AsyncChildProcess(const std::string& exe,
@@ -532,6 +760,7 @@ AsyncChildProcess::AsyncChildProcess(const std::string& exe,
    : ChildProcess(), pAsyncImpl_(new AsyncImpl())
 {
    init(exe, args, options);
+   pImpl_->overlappedOutput = true;
 }
 
 AsyncChildProcess::AsyncChildProcess(const std::string& command,
@@ -539,6 +768,7 @@ AsyncChildProcess::AsyncChildProcess(const std::string& command,
    : ChildProcess(), pAsyncImpl_(new AsyncImpl())
 {
    init(command, options);
+   pImpl_->overlappedOutput = true;
 }
 
 AsyncChildProcess::~AsyncChildProcess()
@@ -574,9 +804,24 @@ void AsyncChildProcess::poll()
       }
    }
 
+   // check for process exit (before reading output so that everything the
+   // process wrote before exiting is collected prior to calling onExit)
+   DWORD result = ::WaitForSingleObject(pImpl_->hProcess, 0);
+
+   // start reading output on the first poll
+   if (!pAsyncImpl_->stdOutReader_.started())
+   {
+      Error error = pAsyncImpl_->stdOutReader_.start(pImpl_->hStdOutRead);
+      if (error)
+         reportError(error);
+      error = pAsyncImpl_->stdErrReader_.start(pImpl_->hStdErrRead);
+      if (error)
+         reportError(error);
+   }
+
    // check stdout
    std::string stdOut;
-   Error error = readPipeAvailableBytes(pImpl_->hStdOutRead, &stdOut);
+   Error error = pAsyncImpl_->stdOutReader_.read(&stdOut);
    if (error)
       reportError(error);
    if (!stdOut.empty() && callbacks_.onStdout)
@@ -584,15 +829,12 @@ void AsyncChildProcess::poll()
 
    // check stderr
    std::string stdErr;
-   error = readPipeAvailableBytes(pImpl_->hStdErrRead, &stdErr);
+   error = pAsyncImpl_->stdErrReader_.read(&stdErr);
    if (error)
       reportError(error);
    if (!stdErr.empty() && callbacks_.onStderr)
       callbacks_.onStderr(*this, stdErr);
 
-   // check for process exit
-   DWORD result = ::WaitForSingleObject(pImpl_->hProcess, 0);
-
    // check for process exit (or error waiting)
    if (result != WAIT_TIMEOUT)
    {
@@ -642,6 +884,180 @@ bool AsyncChildProcess::exited()
    return pImpl_->hProcess == NULL;
 }
 
+void AsyncChildProcess::watchHandles(std::vector<void*>* pHandles)
+{
+   if (pImpl_->hProcess == NULL)
+      return;
+
+   HANDLE handles[] = { pAsyncImpl_->stdOutReader_.pendingEvent(),
+                        pAsyncImpl_->stdErrReader_.pendingEvent(),
+                        pImpl_->hProcess };
+   BOOST_FOREACH(HANDLE handle, handles)
+   {
+      if (handle == NULL)
+         continue;
+
+      HANDLE hDuplicate;
+      Error error = duplicateHandle(handle, &hDuplicate);
+      if (error)
+         LOG_ERROR(error);
+      else
+         pHandles->push_back(hDuplicate);
+   }
+}
+
+namespace {
+
+void closeHandles(std::vector<HANDLE>* pHandles)
+{
+   BOOST_FOREACH(HANDLE handle, *pHandles)
+   {
+      Error error = closeHandle(&handle, ERROR_LOCATION);
+      if (error)
+         LOG_ERROR(error);
+   }
+   pHandles->clear();
+}
+
+} // anonymous namespace
+
+struct ChildActivityWatcher::Impl
+{
+   Impl() : hStop(NULL), hRearm(NULL) {}
+
+   void run()
+   {
+      // handles we're currently watching (we own duplicates of them so
+      // they can't be closed out from under the wait)
+      std::vector<HANDLE> watching;
+      while (true)
+      {
+         std::vector<HANDLE> waitHandles;
+         waitHandles.push_back(hStop);
+         waitHandles.push_back(hRearm);
+
+         // any beyond the wait limit are left to the periodic poll
+         std::size_t count = std::min<std::size_t>(
+                        watching.size(),
+                        MAXIMUM_WAIT_OBJECTS - waitHandles.size());
+         waitHandles.insert(waitHandles.end(),
+                            watching.begin(),
+                            watching.begin() + count);
+
+         DWORD result = ::WaitForMultipleObjects(
+                              static_cast<DWORD>(waitHandles.size()),
+                              &(waitHandles[0]),
+                              FALSE,
+                              INFINITE);
+         if (result == WAIT_OBJECT_0)
+         {
+            break;
+         }
+         else if (result == WAIT_OBJECT_0 + 1)
+         {
+            closeHandles(&watching);
+            LOCK_MUTEX(mutex)
+            {
+               watching.swap(armed);
+            }
+            END_LOCK_MUTEX
+         }
+         else if (result > WAIT_OBJECT_0 + 1 &&
+                  result < WAIT_OBJECT_0 + waitHandles.size())
+         {
+            // stop watching until re-armed (so that we call onActivity
+            // at most once per poll)
+            closeHandles(&watching);
+            if (onActivity)
+               onActivity();
+         }
+         else
+         {
+            LOG_ERROR(systemError(::GetLastError(), ERROR_LOCATION));
+            break;
+         }
+      }
+
+      closeHandles(&watching);
+   }
+
+   HANDLE hStop;
+   HANDLE hRearm;
+   boost::mutex mutex;
+   std::vector<HANDLE> armed;
+   boost::function<void()> onActivity;
+   boost::thread thread;
+};
+
+ChildActivityWatcher::ChildActivityWatcher(
+                              const boost::function<void()>& onActivity)
+   : pImpl_(new Impl())
+{
+   pImpl_->onActivity = onActivity;
+
+   pImpl_->hStop = ::CreateEvent(NULL, TRUE, FALSE, NULL);
+   pImpl_->hRearm = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+   if (pImpl_->hStop == NULL || pImpl_->hRearm == NULL)
+   {
+      LOG_ERROR(systemError(::GetLastError(), ERROR_LOCATION));
+      return;
+   }
+
+   try
+   {
+      pImpl_->thread = boost::thread(&Impl::run, pImpl_.get());
+   }
+   catch(const boost::thread_resource_error& e)
+   {
+      LOG_ERROR(Error(boost::thread_error::ec_from_exception(e),
+                      ERROR_LOCATION));
+   }
+}
+
+ChildActivityWatcher::~ChildActivityWatcher()
+{
+   try
+   {
+      if (pImpl_->thread.joinable())
+      {
+         if (::SetEvent(pImpl_->hStop))
+            pImpl_->thread.join();
+         else
+            pImpl_->thread.detach();
+      }
+
+      closeHandles(&pImpl_->armed);
+      closeHandle(&pImpl_->hStop, ERROR_LOCATION);
+      closeHandle(&pImpl_->hRearm, ERROR_LOCATION);
+   }
+   catch(...)
+   {
+   }
+}
+
+void ChildActivityWatcher::watch(
+         const std::vector<boost::shared_ptr<AsyncChildProcess> >& children)
+{
+   if (!pImpl_->thread.joinable())
+      return;
+
+   std::vector<void*> handles;
+   BOOST_FOREACH(const boost::shared_ptr<AsyncChildProcess>& pChild, children)
+      pChild->watchHandles(&handles);
+
+   // hand the handles to the watcher thread (closing any it hasn't
+   // picked up since the last call)
+   LOCK_MUTEX(pImpl_->mutex)
+   {
+      closeHandles(&pImpl_->armed);
+      pImpl_->armed.assign(handles.begin(), handles.end());
+   }
+   END_LOCK_MUTEX
+
+   if (!::SetEvent(pImpl_->hRearm))
+      LOG_ERROR(systemError(::GetLastError(), ERROR_LOCATION));
+}
+
 } // namespace system
 } // namespace core
 } // namespace rstudio
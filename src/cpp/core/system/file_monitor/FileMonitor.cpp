@@ -25,6 +25,8 @@
 #include <core/Log.hpp>
 #include <core/Error.hpp>
 #include <core/Thread.hpp>
+#include <core/Trace.hpp>
+#include <core/StatCache.hpp>
 #include <core/PeriodicCommand.hpp>
 
 #include <core/system/System.hpp>
@@ -52,6 +54,13 @@ namespace {
 // we don't want it to ever be destructed)
 std::list<Handle>* s_pActiveHandles;
 
+// backend for new registrations (set prior to starting the monitor thread)
+Backend s_backend = DefaultBackend;
+
+// coalescing latency for new registrations
+boost::posix_time::time_duration s_latency =
+                                    boost::posix_time::milliseconds(500);
+
 void addEvent(FileChangeEvent::Type type,
               const FileInfo& fileInfo,
               std::vector<FileChangeEvent>* pEvents)
@@ -292,6 +301,7 @@ Error discoverAndProcessFileChanges(
    FileScannerOptions options;
    options.recursive = recursive;
    options.yield = true;
+   options.threads = kTreeScanThreads;
    options.filter = filter;
    options.onBeforeScanDir = onBeforeScanDir;
    Error error = scanFiles(fileInfo, options, &subdirTree);
@@ -383,6 +393,15 @@ std::list<void*> activeEventContexts()
   return contexts;
 }
 
+Backend backend()
+{
+   return s_backend;
+}
+
+boost::posix_time::time_duration latency()
+{
+   return s_latency;
+}
 
 } // namespace impl
 
@@ -499,6 +518,8 @@ void checkForInput()
       {
       case RegistrationCommand::Register:
       {
+         // registration scans the monitored tree so can be expensive
+         TRACE_SCOPE("file_monitor.register " + command.filePath().absolutePath());
          Handle handle = detail::registerMonitor(command.filePath(),
                                                  command.recursive(),
                                                  command.filter(),
@@ -536,6 +557,8 @@ void fileMonitorThreadMain()
    bool running = false;
    try
    {
+      core::trace::setThreadName("file_monitor");
+
       // first wait until there is at least one command to process
       // (makes us immediately responsive to the first request)
       if (registrationCommandQueue().isEmpty())
@@ -601,6 +624,16 @@ void enqueOnMonitoringError(const Callbacks& callbacks, const Error& error)
 void enqueOnFilesChanged(const Callbacks& callbacks,
                          const std::vector<FileChangeEvent>& fileChanges)
 {
+   // invalidate cached metadata right away (rather than when the callback
+   // is dequeued) so that stale entries aren't observed in the meantime
+   if (stat_cache::enabled())
+   {
+      BOOST_FOREACH(const FileChangeEvent& event, fileChanges)
+      {
+         stat_cache::invalidate(event.fileInfo().absolutePath());
+      }
+   }
+
    if (callbacks.onFilesChanged)
    {
       callbackQueue().enque(boost::bind(callbacks.onFilesChanged, fileChanges));
@@ -620,6 +653,16 @@ boost::thread s_fileMonitorThread;
 } // anonymous namespace
 
 
+void setBackend(Backend backend)
+{
+   s_backend = backend;
+}
+
+void setLatency(const boost::posix_time::time_duration& latency)
+{
+   s_latency = latency;
+}
+
 void initialize()
 {
    s_pActiveHandles = new std::list<Handle>();
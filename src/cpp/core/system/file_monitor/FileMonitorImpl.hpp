@@ -35,6 +35,11 @@ namespace system {
 namespace file_monitor {
 namespace impl {
 
+// threads used to read directories when scanning an entire monitored tree
+// (registration can otherwise take a very long time for large trees on
+// network storage)
+const int kTreeScanThreads = 4;
+
 Error processFileAdded(
                tree<FileInfo>::iterator parentIt,
                const FileChangeEvent& fileChange,
@@ -114,6 +119,12 @@ Iterator findFile(Iterator begin, Iterator end, const FileInfo& fileInfo)
 
 std::list<void*> activeEventContexts();
 
+// backend selected via setBackend
+Backend backend();
+
+// coalescing latency selected via setLatency
+boost::posix_time::time_duration latency();
+
 
 } // namespace impl
 } // namespace file_monitor
@@ -22,6 +22,7 @@
 #include <sys/inotify.h>
 
 #include <set>
+#include <map>
 
 #include <boost/utility.hpp>
 #include <boost/foreach.hpp>
@@ -31,6 +32,8 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 #include <core/Log.hpp>
 #include <core/Error.hpp>
 #include <core/FileInfo.hpp>
@@ -42,6 +45,10 @@
 
 #include "config.h"
 
+#ifdef HAVE_FANOTIFY_DFID_NAME
+#include <sys/fanotify.h>
+#endif
+
 namespace rstudio {
 namespace core {
 namespace system {
@@ -49,6 +56,11 @@ namespace file_monitor {
 
 namespace {
 
+// events are coalesced until there have been no new events for
+// kCoalesceQuietMs (or kCoalesceMaxMs have passed since the first)
+const int kCoalesceQuietMs = 100;
+const int kCoalesceMaxMs = 1000;
+
 struct Watch
 {
    Watch()
@@ -61,11 +73,19 @@ struct Watch
    {
    }
 
+   Watch(int wd, const std::string& path, const std::string& fileHandle)
+      : wd(wd), path(path), fileHandle(fileHandle)
+   {
+   }
+
    bool empty() const { return path.empty(); }
 
    int wd;
    std::string path;
 
+   // file handle of the directory (fanotify only)
+   std::string fileHandle;
+
    bool operator < (const Watch& other) const
    {
       return this->wd < other.wd;
@@ -159,12 +179,33 @@ private:
 };
 
 
+// inotify events for a path which have been queued for coalescing. we
+// track the first event type and whether the path was removed at any
+// point -- combined with whether the path exists when the events are
+// processed that is enough to determine the net change
+struct PendingEvent
+{
+   PendingEvent(int wd, const std::string& name, FileChangeEvent::Type type)
+      : wd(wd), name(name), isDirectory(false), firstType(type), removed(false)
+   {
+   }
+
+   int wd;
+   std::string name;
+   bool isDirectory;
+   FileChangeEvent::Type firstType;
+   bool removed;
+};
+
 class FileEventContext : boost::noncopyable
 {
 public:
    FileEventContext()
       : fd(-1),
-        recursive(false)
+        fanotify(false),
+        nextFanotifyWd(1),
+        recursive(false),
+        rescanPending(false)
    {
       handle = Handle((void*)this);
    }
@@ -172,11 +213,27 @@ public:
    Handle handle;
    int fd;
    Watches watches;
+
+   // fanotify reports directories by file handle rather than by watch
+   // descriptor, so each directory is assigned a synthetic descriptor
+   bool fanotify;
+   std::map<std::string, int> fanotifyWatches;
+   int nextFanotifyWd;
+
    FilePath rootPath;
    bool recursive;
    boost::function<bool(const FileInfo&)> filter;
    tree<FileInfo> fileTree;
    Callbacks callbacks;
+
+   // events awaiting coalescing (in the order they were first seen)
+   std::vector<PendingEvent> pendingEvents;
+   std::map<std::pair<int,std::string>, std::size_t> pendingEventIndex;
+   boost::posix_time::ptime firstEventTime;
+   boost::posix_time::ptime lastEventTime;
+
+   // the inotify queue overflowed so a rescan is required
+   bool rescanPending;
 };
 
 void terminateWithMonitoringError(FileEventContext* pContext,
@@ -189,12 +246,61 @@ void terminateWithMonitoringError(FileEventContext* pContext,
    file_monitor::unregisterMonitor(pContext->handle);
 }
 
+#ifdef HAVE_FANOTIFY_DFID_NAME
+
+std::string fileHandleKey(const struct file_handle* pHandle)
+{
+   std::string key(reinterpret_cast<const char*>(&pHandle->handle_type),
+                   sizeof(pHandle->handle_type));
+   key.append(reinterpret_cast<const char*>(pHandle->f_handle),
+              pHandle->handle_bytes);
+   return key;
+}
+
+Error addFanotifyWatch(const FileInfo& fileInfo, FileEventContext* pContext)
+{
+   // NOTE: there's no kernel watch to add (the whole filesystem is marked)
+   // we just need the directory's file handle so that we can recognize
+   // events which occur within it
+   std::vector<unsigned long> buffer(
+       (sizeof(struct file_handle) + MAX_HANDLE_SZ) / sizeof(unsigned long) + 1);
+   struct file_handle* pHandle = (struct file_handle*)&buffer[0];
+   pHandle->handle_bytes = MAX_HANDLE_SZ;
+   int mountId;
+   if (::name_to_handle_at(AT_FDCWD,
+                           fileInfo.absolutePath().c_str(),
+                           pHandle,
+                           &mountId,
+                           0) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", fileInfo.absolutePath());
+      return error;
+   }
+
+   std::string key = fileHandleKey(pHandle);
+   if (pContext->fanotifyWatches.find(key) != pContext->fanotifyWatches.end())
+      return Success();
+
+   int wd = pContext->nextFanotifyWd++;
+   pContext->fanotifyWatches[key] = wd;
+   pContext->watches.insert(Watch(wd, fileInfo.absolutePath(), key));
+   return Success();
+}
+
+#endif
+
 Error addWatch(const FileInfo& fileInfo,
-               const FilePath& rootPath,
                bool allowRootSymlink,
-               int fd,
-               Watches* pWatches)
+               FileEventContext* pContext)
 {
+#ifdef HAVE_FANOTIFY_DFID_NAME
+   if (pContext->fanotify)
+      return addFanotifyWatch(fileInfo, pContext);
+#endif
+
+   const FilePath& rootPath = pContext->rootPath;
+
    // NOTE: both inotify_add_watch and std::set::insert gracefully
    // handle duplicate additions, inotify_add_watch by modifying the
    // existing watch and returning the same watch descriptor, and
@@ -220,7 +326,9 @@ Error addWatch(const FileInfo& fileInfo,
    }
 
    // initialize watch
-   int wd = ::inotify_add_watch(fd, fileInfo.absolutePath().c_str(), mask);
+   int wd = ::inotify_add_watch(pContext->fd,
+                                fileInfo.absolutePath().c_str(),
+                                mask);
    if (wd < 0)
    {
       Error error = systemError(errno, ERROR_LOCATION);
@@ -229,7 +337,7 @@ Error addWatch(const FileInfo& fileInfo,
    }
 
    // record it
-   pWatches->insert(Watch(wd, fileInfo.absolutePath()));
+   pContext->watches.insert(Watch(wd, fileInfo.absolutePath()));
 
    // return success
    return Success();
@@ -239,18 +347,19 @@ boost::function<Error(const FileInfo&)> addWatchFunction(
                                            FileEventContext* pContext,
                                            bool allowRootSymlink = false)
 {
-   return boost::bind(addWatch,
-                        _1,
-                        pContext->rootPath,
-                        allowRootSymlink,
-                        pContext->fd,
-                        &pContext->watches);
+   return boost::bind(addWatch, _1, allowRootSymlink, pContext);
 }
 
-void removeWatch(int fd, const Watch& watch)
+void removeWatch(FileEventContext* pContext, const Watch& watch)
 {
+   if (pContext->fanotify)
+   {
+      pContext->fanotifyWatches.erase(watch.fileHandle);
+      return;
+   }
+
    // remove the watch
-   int result = ::inotify_rm_watch(fd, watch.wd);
+   int result = ::inotify_rm_watch(pContext->fd, watch.wd);
 
    // log error if it isn't EINVAL (which is expected if e.g. the
    // filesystem has been unmounted or the root directory has been deleted)
@@ -264,9 +373,7 @@ void removeWatch(int fd, const Watch& watch)
 
 void removeAllWatches(FileEventContext* pContext)
 {
-   pContext->watches.forEach(boost::bind(removeWatch,
-                                          pContext->fd,
-                                          _1));
+   pContext->watches.forEach(boost::bind(removeWatch, pContext, _1));
    pContext->watches.clear();
 }
 
@@ -286,29 +393,35 @@ void closeContext(FileEventContext* pContext)
    }
 }
 
+FileChangeEvent::Type eventTypeForMask(uint32_t mask)
+{
+   if (mask & IN_CREATE)
+      return FileChangeEvent::FileAdded;
+   else if (mask & IN_DELETE)
+      return FileChangeEvent::FileRemoved;
+   else if (mask & IN_MODIFY)
+      return FileChangeEvent::FileModified;
+   else if (mask & IN_MOVED_TO)
+      return FileChangeEvent::FileAdded;
+   else if (mask & IN_MOVED_FROM)
+      return FileChangeEvent::FileRemoved;
+   else
+      return FileChangeEvent::None;
+}
+
 Error processEvent(FileEventContext* pContext,
-                   struct inotify_event* pEvent,
+                   int wd,
+                   const std::string& name,
+                   bool isDirectory,
+                   FileChangeEvent::Type eventType,
                    std::vector<FileChangeEvent>* pFileChanges)
 {
-   // determine event type
-   FileChangeEvent::Type eventType = FileChangeEvent::None;
-   if (pEvent->mask & IN_CREATE)
-      eventType = FileChangeEvent::FileAdded;
-   else if (pEvent->mask & IN_DELETE)
-      eventType = FileChangeEvent::FileRemoved;
-   else if (pEvent->mask & IN_MODIFY)
-      eventType = FileChangeEvent::FileModified;
-   else if (pEvent->mask & IN_MOVED_TO)
-      eventType = FileChangeEvent::FileAdded;
-   else if (pEvent->mask & IN_MOVED_FROM)
-      eventType = FileChangeEvent::FileRemoved;
-
    // return event if we got a valid event type and the event applies to a
-   // child of the monitored directory (len == 0 occurs for root element)
-   if ((eventType != FileChangeEvent::None) && (pEvent->len > 0))
+   // child of the monitored directory (empty name occurs for root element)
+   if ((eventType != FileChangeEvent::None) && !name.empty())
    {
       // find the FileInfo for this wd (ignore if we can't find one)
-      Watch watch = pContext->watches.find(pEvent->wd);
+      Watch watch = pContext->watches.find(wd);
       if (watch.empty())
          return Success();
 
@@ -324,8 +437,7 @@ Error processEvent(FileEventContext* pContext,
          return Success();
 
       // get file info
-      FilePath filePath = FilePath(parentIt->absolutePath()).complete(
-                                                                 pEvent->name);
+      FilePath filePath = FilePath(parentIt->absolutePath()).complete(name);
 
 
       // if the file exists then collect as many extended attributes
@@ -337,7 +449,7 @@ Error processEvent(FileEventContext* pContext,
       }
       else
       {
-         fileInfo = FileInfo(filePath.absolutePath(), pEvent->mask & IN_ISDIR);
+         fileInfo = FileInfo(filePath.absolutePath(), isDirectory);
       }
 
       // if this doesn't meet the filter then ignore
@@ -367,7 +479,7 @@ Error processEvent(FileEventContext* pContext,
                                              event.fileInfo().absolutePath());
                   if (!watch.empty())
                   {
-                     removeWatch(pContext->fd, watch);
+                     removeWatch(pContext, watch);
                      pContext->watches.erase(watch);
                   }
                }
@@ -420,6 +532,250 @@ Error processEvent(FileEventContext* pContext,
 }
 
 
+void coalesceEvent(FileEventContext* pContext,
+                   int wd,
+                   const std::string& name,
+                   bool isDirectory,
+                   FileChangeEvent::Type eventType)
+{
+   std::pair<int,std::string> key(wd, name);
+   std::map<std::pair<int,std::string>, std::size_t>::const_iterator it =
+                                       pContext->pendingEventIndex.find(key);
+   if (it == pContext->pendingEventIndex.end())
+   {
+      pContext->pendingEventIndex[key] = pContext->pendingEvents.size();
+      pContext->pendingEvents.push_back(
+                              PendingEvent(key.first, key.second, eventType));
+      it = pContext->pendingEventIndex.find(key);
+   }
+
+   PendingEvent& pending = pContext->pendingEvents[it->second];
+   if (isDirectory)
+      pending.isDirectory = true;
+   if (eventType == FileChangeEvent::FileRemoved)
+      pending.removed = true;
+}
+
+void coalesceEvent(FileEventContext* pContext, struct inotify_event* pEvent)
+{
+   // ignore events we don't handle and events for the root element
+   // (len == 0)
+   FileChangeEvent::Type eventType = eventTypeForMask(pEvent->mask);
+   if (eventType == FileChangeEvent::None || pEvent->len == 0)
+      return;
+
+   coalesceEvent(pContext,
+                 pEvent->wd,
+                 std::string(pEvent->name),
+                 pEvent->mask & IN_ISDIR,
+                 eventType);
+}
+
+void clearPendingEvents(FileEventContext* pContext)
+{
+   pContext->pendingEvents.clear();
+   pContext->pendingEventIndex.clear();
+}
+
+#ifdef HAVE_FANOTIFY_DFID_NAME
+
+// fanotify merges events for the same file so a single event may carry
+// several types (we queue each of them for coalescing)
+void coalesceFanotifyEvent(FileEventContext* pContext,
+                           uint64_t mask,
+                           const struct fanotify_event_info_fid* pFid)
+{
+   const struct file_handle* pHandle =
+                        reinterpret_cast<const struct file_handle*>(pFid->handle);
+   std::map<std::string, int>::const_iterator it =
+                     pContext->fanotifyWatches.find(fileHandleKey(pHandle));
+
+   // ignore events outside of the monitored tree (the mark covers the
+   // entire filesystem)
+   if (it == pContext->fanotifyWatches.end())
+      return;
+
+   // the name follows the handle
+   std::string name(reinterpret_cast<const char*>(pHandle->f_handle +
+                                                  pHandle->handle_bytes));
+   if (name.empty() || name == ".")
+      return;
+
+   bool isDirectory = mask & FAN_ONDIR;
+   if (mask & (FAN_CREATE | FAN_MOVED_TO))
+      coalesceEvent(pContext, it->second, name, isDirectory,
+                    FileChangeEvent::FileAdded);
+   if (mask & (FAN_DELETE | FAN_MOVED_FROM))
+      coalesceEvent(pContext, it->second, name, isDirectory,
+                    FileChangeEvent::FileRemoved);
+   if (mask & FAN_MODIFY)
+      coalesceEvent(pContext, it->second, name, isDirectory,
+                    FileChangeEvent::FileModified);
+}
+
+void readFanotifyEvents(FileEventContext* pContext, char* buffer, int len)
+{
+   struct fanotify_event_metadata* pMetadata =
+                              reinterpret_cast<fanotify_event_metadata*>(buffer);
+   while (FAN_EVENT_OK(pMetadata, len))
+   {
+      // overflow is handled as for inotify (see below)
+      if (pMetadata->mask & FAN_Q_OVERFLOW)
+      {
+         pContext->rescanPending = true;
+         clearPendingEvents(pContext);
+      }
+      else if (!pContext->rescanPending &&
+               pMetadata->vers == FANOTIFY_METADATA_VERSION)
+      {
+         // find the directory and name info record
+         char* pInfo = reinterpret_cast<char*>(pMetadata) +
+                                                      pMetadata->metadata_len;
+         char* pEnd = reinterpret_cast<char*>(pMetadata) +
+                                                      pMetadata->event_len;
+         while (pInfo + sizeof(struct fanotify_event_info_header) <= pEnd)
+         {
+            const struct fanotify_event_info_fid* pFid =
+               reinterpret_cast<const struct fanotify_event_info_fid*>(pInfo);
+            if (pFid->hdr.len == 0)
+               break;
+
+            if (pFid->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME)
+               coalesceFanotifyEvent(pContext, pMetadata->mask, pFid);
+
+            pInfo += pFid->hdr.len;
+         }
+      }
+
+      // events reported by file handle have no descriptor but be defensive
+      if (pMetadata->fd >= 0)
+         ::close(pMetadata->fd);
+
+      pMetadata = FAN_EVENT_NEXT(pMetadata, len);
+   }
+}
+
+// initialize a fanotify descriptor which reports directory entry changes
+// throughout the filesystem containing the root path
+Error initFanotify(FileEventContext* pContext)
+{
+   int fd = ::fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK |
+                            FAN_REPORT_DFID_NAME,
+                            O_RDONLY | O_LARGEFILE);
+   if (fd < 0)
+      return systemError(errno, ERROR_LOCATION);
+
+   uint64_t mask = FAN_CREATE | FAN_DELETE | FAN_MODIFY |
+                   FAN_MOVED_FROM | FAN_MOVED_TO | FAN_ONDIR;
+   if (::fanotify_mark(fd,
+                       FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                       mask,
+                       AT_FDCWD,
+                       pContext->rootPath.absolutePath().c_str()) == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", pContext->rootPath);
+      ::close(fd);
+      return error;
+   }
+
+   pContext->fd = fd;
+   pContext->fanotify = true;
+   return Success();
+}
+
+#endif
+
+bool pendingEventsReady(FileEventContext* pContext,
+                        const boost::posix_time::ptime& now)
+{
+   using namespace boost::posix_time;
+
+   if (pContext->pendingEvents.empty() && !pContext->rescanPending)
+      return false;
+
+   return (now - pContext->lastEventTime) >= milliseconds(kCoalesceQuietMs) ||
+          (now - pContext->firstEventTime) >= milliseconds(kCoalesceMaxMs);
+}
+
+// process the net change for each path with pending events
+Error processPendingEvents(FileEventContext* pContext,
+                           std::vector<FileChangeEvent>* pFileChanges)
+{
+   std::vector<PendingEvent> pendingEvents;
+   pendingEvents.swap(pContext->pendingEvents);
+   pContext->pendingEventIndex.clear();
+
+   BOOST_FOREACH(const PendingEvent& pending, pendingEvents)
+   {
+      Watch watch = pContext->watches.find(pending.wd);
+      if (watch.empty())
+         continue;
+
+      bool exists = FilePath(watch.path).complete(pending.name).exists();
+      bool added = pending.firstType == FileChangeEvent::FileAdded;
+
+      std::vector<FileChangeEvent::Type> eventTypes;
+      if (exists)
+      {
+         // created during the window, replaced, or modified
+         if (added)
+         {
+            eventTypes.push_back(FileChangeEvent::FileAdded);
+         }
+         else if (pending.removed)
+         {
+            eventTypes.push_back(FileChangeEvent::FileRemoved);
+            eventTypes.push_back(FileChangeEvent::FileAdded);
+         }
+         else
+         {
+            eventTypes.push_back(FileChangeEvent::FileModified);
+         }
+      }
+      else if (!added)
+      {
+         // removed (paths created and removed within the window are
+         // ignored entirely)
+         eventTypes.push_back(FileChangeEvent::FileRemoved);
+      }
+
+      BOOST_FOREACH(FileChangeEvent::Type eventType, eventTypes)
+      {
+         Error error = processEvent(pContext,
+                                    pending.wd,
+                                    pending.name,
+                                    pending.isDirectory,
+                                    eventType,
+                                    pFileChanges);
+         if (error)
+            return error;
+      }
+   }
+
+   return Success();
+}
+
+// rescan the monitored tree after an inotify queue overflow (we don't know
+// which events were lost so the whole tree is compared against the listing)
+Error rescanAfterOverflow(FileEventContext* pContext)
+{
+   pContext->rescanPending = false;
+   clearPendingEvents(pContext);
+
+   // remove all watches
+   removeAllWatches(pContext);
+
+   // generate events based on scanning
+   return impl::discoverAndProcessFileChanges(
+         FileInfo(pContext->rootPath),
+         pContext->recursive,
+         pContext->filter,
+         addWatchFunction(pContext, true),
+         &pContext->fileTree,
+         pContext->callbacks.onFilesChanged);
+}
+
 Handle registrationFailure(int errorNumber,
                            FileEventContext* pContext,
                            const Callbacks& callbacks,
@@ -449,36 +805,59 @@ Handle registerMonitor(const core::FilePath& filePath,
    pContext->filter = filter;
    std::auto_ptr<FileEventContext> autoPtrContext(pContext);
 
-   // init file descriptor
+   // use fanotify if requested (falling back to inotify if it isn't
+   // supported or we lack the privilege to mark the filesystem)
+#ifdef HAVE_FANOTIFY_DFID_NAME
+   if (impl::backend() == FanotifyBackend)
+   {
+      Error error = initFanotify(pContext);
+      if (error)
+         LOG_WARNING_MESSAGE("Unable to use fanotify for file monitoring, "
+                             "using inotify instead (" + error.summary() + ")");
+   }
+#endif
+
+   // otherwise use inotify
+   if (!pContext->fanotify)
+   {
+      // init file descriptor
 #ifdef HAVE_INOTIFY_INIT1
-   pContext->fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
-   if (pContext->fd < 0)
-      return registrationFailure(errno, pContext, callbacks, ERROR_LOCATION);
+      pContext->fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (pContext->fd < 0)
+         return registrationFailure(errno, pContext, callbacks,
+                                    ERROR_LOCATION);
 #else
-   // init file descriptor
-   pContext->fd = ::inotify_init();
-   if (pContext->fd < 0)
-      return registrationFailure(errno, pContext, callbacks, ERROR_LOCATION);
-
-   // set non-blocking
-   int flags = ::fcntl(pContext->fd, F_GETFL);
-   if (flags == -1)
-      return registrationFailure(errno, pContext, callbacks, ERROR_LOCATION);
-   if (::fcntl(pContext->fd, F_SETFL, flags | O_NONBLOCK) == -1)
-      return registrationFailure(errno, pContext, callbacks, ERROR_LOCATION);
-
-   // set close on exec
-   int fdFlags = ::fcntl(pContext->fd, F_GETFD);
-   if (fdFlags == -1)
-      return registrationFailure(errno, pContext, callbacks, ERROR_LOCATION);
-   if (::fcntl(pContext->fd, F_SETFD, fdFlags | FD_CLOEXEC) == -1)
-      return registrationFailure(errno, pContext, callbacks, ERROR_LOCATION);
+      // init file descriptor
+      pContext->fd = ::inotify_init();
+      if (pContext->fd < 0)
+         return registrationFailure(errno, pContext, callbacks,
+                                    ERROR_LOCATION);
+
+      // set non-blocking
+      int flags = ::fcntl(pContext->fd, F_GETFL);
+      if (flags == -1)
+         return registrationFailure(errno, pContext, callbacks,
+                                    ERROR_LOCATION);
+      if (::fcntl(pContext->fd, F_SETFL, flags | O_NONBLOCK) == -1)
+         return registrationFailure(errno, pContext, callbacks,
+                                    ERROR_LOCATION);
+
+      // set close on exec
+      int fdFlags = ::fcntl(pContext->fd, F_GETFD);
+      if (fdFlags == -1)
+         return registrationFailure(errno, pContext, callbacks,
+                                    ERROR_LOCATION);
+      if (::fcntl(pContext->fd, F_SETFD, fdFlags | FD_CLOEXEC) == -1)
+         return registrationFailure(errno, pContext, callbacks,
+                                    ERROR_LOCATION);
 #endif
+   }
 
    // scan the files (use callback to setup watches)
    FileScannerOptions options;
    options.recursive = recursive;
    options.yield = true;
+   options.threads = impl::kTreeScanThreads;
    options.filter = filter;
    options.onBeforeScanDir = addWatchFunction(pContext, true);
    Error error = scanFiles(FileInfo(filePath), options, &pContext->fileTree);
@@ -556,7 +935,7 @@ void run(const boost::function<void()>& checkForInput)
          }
 
          // loop reading from this context's fd until EAGAIN or EWOULDBLOCK
-         std::vector<FileChangeEvent> fileChanges;
+         bool terminated = false;
          while (true)
          {
             // read
@@ -574,10 +953,28 @@ void run(const boost::function<void()>& checkForInput)
                // out of the read loop for this context)
                terminateWithMonitoringError(pContext,
                                             systemError(errno, ERROR_LOCATION));
+               terminated = true;
                break;
             }
 
+            // note the time of the events
+            boost::posix_time::ptime now =
+                           boost::posix_time::microsec_clock::universal_time();
+            if (len > 0)
+            {
+               if (pContext->pendingEvents.empty() && !pContext->rescanPending)
+                  pContext->firstEventTime = now;
+               pContext->lastEventTime = now;
+            }
+
             // iterate through the events
+#ifdef HAVE_FANOTIFY_DFID_NAME
+            if (pContext->fanotify)
+            {
+               readFanotifyEvents(pContext, eventBuffer, len);
+               continue;
+            }
+#endif
             int i = 0;
             while (i < len)
             {
@@ -585,36 +982,19 @@ void run(const boost::function<void()>& checkForInput)
                typedef struct inotify_event* EventPtr;
                EventPtr pEvent = (EventPtr)&eventBuffer[i];
 
-               // buffer overflow is handled specially -- basically
-               // we start over because we missed events
+               // buffer overflow is handled specially -- we missed events
+               // so we need to rescan. the rescan is deferred until the
+               // burst of events has settled (so that a long burst results
+               // in a single rescan); until then events are discarded since
+               // the rescan supersedes them
                if (pEvent->mask & IN_Q_OVERFLOW)
                {
-                  // remove all watches
-                  removeAllWatches(pContext);
-
-                  // generate events based on scanning
-                  Error error =impl::discoverAndProcessFileChanges(
-                        FileInfo(pContext->rootPath),
-                        pContext->recursive,
-                        pContext->filter,
-                        addWatchFunction(pContext, true),
-                        &pContext->fileTree,
-                        pContext->callbacks.onFilesChanged);
-                  if (error)
-                     terminateWithMonitoringError(pContext, error);
-
-                  // always break here -- we've generated events based on
-                  // a fresh scan so any other events in the queue would
-                  // be duplicates
-                  break;
+                  pContext->rescanPending = true;
+                  clearPendingEvents(pContext);
                }
-
-               // process the event
-               Error error = processEvent(pContext, pEvent, &fileChanges);
-               if (error)
+               else if (!pContext->rescanPending)
                {
-                  terminateWithMonitoringError(pContext, error);
-                  break;
+                  coalesceEvent(pContext, pEvent);
                }
 
                // advance to next event
@@ -622,9 +1002,42 @@ void run(const boost::function<void()>& checkForInput)
             }
          }
 
-         // fire any events we got
-         if (!fileChanges.empty())
-            pContext->callbacks.onFilesChanged(fileChanges);
+         if (terminated)
+            continue;
+
+         // process coalesced events once they have settled
+         boost::posix_time::ptime now =
+                           boost::posix_time::microsec_clock::universal_time();
+         if (!pendingEventsReady(pContext, now))
+            continue;
+
+         if (pContext->rescanPending)
+         {
+            Error error = rescanAfterOverflow(pContext);
+            if (error)
+            {
+               // terminate only if the monitored directory is gone (otherwise
+               // keep monitoring with the tree as far as the rescan got)
+               if (!pContext->rootPath.exists())
+                  terminateWithMonitoringError(pContext, error);
+               else
+                  LOG_ERROR(error);
+            }
+         }
+         else
+         {
+            std::vector<FileChangeEvent> fileChanges;
+            Error error = processPendingEvents(pContext, &fileChanges);
+            if (error)
+            {
+               terminateWithMonitoringError(pContext, error);
+               continue;
+            }
+
+            // fire any events we got
+            if (!fileChanges.empty())
+               pContext->callbacks.onFilesChanged(fileChanges);
+         }
       }
 
       // check for input (register/unregister of monitors)
@@ -56,6 +56,77 @@ public:
    Callbacks callbacks;
 };
 
+// flags which indicate that the event names a single file or directory
+// (with kFSEventStreamCreateFlagFileEvents) rather than a directory which
+// needs to be scanned
+const FSEventStreamEventFlags kItemEventFlags =
+      kFSEventStreamEventFlagItemCreated |
+      kFSEventStreamEventFlagItemRemoved |
+      kFSEventStreamEventFlagItemRenamed |
+      kFSEventStreamEventFlagItemModified |
+      kFSEventStreamEventFlagItemInodeMetaMod |
+      kFSEventStreamEventFlagItemIsFile |
+      kFSEventStreamEventFlagItemIsDir |
+      kFSEventStreamEventFlagItemIsSymlink;
+
+// apply a per-file event directly to the tree (avoids scanning the
+// directory which contains the file)
+void processFileEvent(FileEventContext* pContext,
+                      const std::string& path,
+                      FSEventStreamEventFlags flags,
+                      std::vector<FileChangeEvent>* pFileChanges)
+{
+   // find the parent directory (ignore the event if it isn't in the tree,
+   // as would be the case if the directory was excluded by the filter)
+   FilePath filePath(path);
+   std::string parentPath = filePath.parent().absolutePath();
+   if (!pContext->recursive && (parentPath != pContext->rootPath.absolutePath()))
+      return;
+   tree<FileInfo>::iterator parentIt = impl::findFile(
+                                                pContext->fileTree.begin(),
+                                                pContext->fileTree.end(),
+                                                parentPath);
+   if (parentIt == pContext->fileTree.end())
+      return;
+
+   // the flags of a coalesced event accumulate everything which happened
+   // to the path, so check what's there now to decide what to report
+   bool exists = filePath.exists();
+   FileInfo fileInfo = exists ?
+            FileInfo(filePath, filePath.isSymlink()) :
+            FileInfo(path, (flags & kFSEventStreamEventFlagItemIsDir) != 0);
+
+   if (pContext->filter && !pContext->filter(fileInfo))
+      return;
+
+   if (exists)
+   {
+      // processFileAdded reports a modification if the file is already
+      // in the tree (and nothing if it hasn't changed)
+      FileChangeEvent event(FileChangeEvent::FileAdded, fileInfo);
+      Error error = impl::processFileAdded(parentIt,
+                                           event,
+                                           pContext->recursive,
+                                           pContext->filter,
+                                           &(pContext->fileTree),
+                                           pFileChanges);
+      if (error &&
+         (error.code() != boost::system::errc::no_such_file_or_directory))
+      {
+         LOG_ERROR(error);
+      }
+   }
+   else
+   {
+      FileChangeEvent event(FileChangeEvent::FileRemoved, fileInfo);
+      impl::processFileRemoved(parentIt,
+                               event,
+                               pContext->recursive,
+                               &(pContext->fileTree),
+                               pFileChanges);
+   }
+}
+
 void fileEventCallback(ConstFSEventStreamRef streamRef,
                        void *pCallbackInfo,
                        size_t numEvents,
@@ -72,6 +143,10 @@ void fileEventCallback(ConstFSEventStreamRef streamRef,
    if (!pContext->callbacks.onFilesChanged)
       return;
 
+   // changes from per-file events are accumulated and delivered together
+   // (so a burst of changes results in a single notification)
+   std::vector<FileChangeEvent> fileChanges;
+
    char **paths = (char**)eventPaths;
    for (std::size_t i=0; i<numEvents; i++)
    {
@@ -94,6 +169,15 @@ void fileEventCallback(ConstFSEventStreamRef streamRef,
       std::string path(paths[i]);
       boost::algorithm::trim_right_if(path, boost::algorithm::is_any_of("/"));
 
+      // per-file events are applied directly (unless the system dropped
+      // events, in which case it asks us to scan instead)
+      if ((eventFlags[i] & kItemEventFlags) &&
+          !(eventFlags[i] & kFSEventStreamEventFlagMustScanSubDirs))
+      {
+         processFileEvent(pContext, path, eventFlags[i], &fileChanges);
+         continue;
+      }
+
       // if we aren't in recursive mode then ignore this if it isn't for
       // the root directory
       if (!pContext->recursive && (path != pContext->rootPath.absolutePath()))
@@ -123,6 +207,9 @@ void fileEventCallback(ConstFSEventStreamRef streamRef,
          }
       }
    }
+
+   if (!fileChanges.empty())
+      pContext->callbacks.onFilesChanged(fileChanges);
 }
 
 class CFRefScope : boost::noncopyable
@@ -218,9 +305,9 @@ Handle registerMonitor(const FilePath& filePath,
                   &context,
                   pathsArrayRef,
                   kFSEventStreamEventIdSinceNow,
-                  1,
-                  kFSEventStreamCreateFlagNoDefer |
-                  kFSEventStreamCreateFlagWatchRoot);
+                  impl::latency().total_milliseconds() / 1000.0,
+                  kFSEventStreamCreateFlagWatchRoot |
+                  kFSEventStreamCreateFlagFileEvents);
    if (pContext->streamRef == NULL)
    {
       callbacks.onRegistrationError(systemError(
@@ -17,6 +17,7 @@
 
 #include <windows.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <boost/algorithm/string/trim.hpp>
@@ -37,8 +38,11 @@ namespace file_monitor {
 
 namespace {
 
-// buffer size for notifications (cannot be > 64kb for network drives)
+// initial buffer size for notifications. the buffers are doubled each time
+// they overflow up to kMaxBuffSize (but cannot be > 64kb for network drives)
 const std::size_t kBuffSize = 32768;
+const std::size_t kMaxBuffSize = 1024 * 1024;
+const std::size_t kMaxNetworkBuffSize = 65536;
 
 class FileEventContext : boost::noncopyable
 {
@@ -228,6 +232,7 @@ void processFileChanges(FileEventContext* pContext,
    std::vector<FileChangeEvent> fileChanges;
 
    // cycle through the entries in the buffer
+   bool overflowed = false;
    char* pBuffer = (char*)&pContext->handlingBuffer[0];
    while(true)
    {
@@ -236,8 +241,7 @@ void processFileChanges(FileEventContext* pContext,
       if( (DWORD)((BYTE*)pBuffer - &(pContext->handlingBuffer[0])) >
           dwNumberOfBytesTransfered )
       {
-         Error error = systemError(ERROR_BUFFER_OVERFLOW, ERROR_LOCATION);
-         LOG_ERROR(error);
+         overflowed = true;
          break;
       }
 
@@ -278,6 +282,20 @@ void processFileChanges(FileEventContext* pContext,
 
    // notify client of file changes
    pContext->callbacks.onFilesChanged(fileChanges);
+
+   // if we couldn't read all of the notifications then some changes may
+   // have been lost, so rescan to bring the tree back in sync
+   if (overflowed)
+   {
+      Error error = impl::discoverAndProcessFileChanges(
+                                       *(pContext->fileTree.begin()),
+                                       pContext->recursive,
+                                       pContext->filter,
+                                       &(pContext->fileTree),
+                                       pContext->callbacks.onFilesChanged);
+      if (error)
+         LOG_ERROR(error);
+   }
 }
 
 void terminateWithMonitoringError(FileEventContext* pContext,
@@ -291,6 +309,19 @@ void terminateWithMonitoringError(FileEventContext* pContext,
 }
 
 
+// grow the notification buffers after an overflow (only called when there
+// is no read pending, since the system may write into receiveBuffer)
+void growBuffers(FileEventContext* pContext)
+{
+   std::size_t size = pContext->receiveBuffer.size();
+   if (size >= kMaxBuffSize)
+      return;
+
+   size = (std::min)(size * 2, kMaxBuffSize);
+   pContext->receiveBuffer.resize(size);
+   pContext->handlingBuffer.resize(size);
+}
+
 bool isRecoverableByRestart(const Error& error)
 {
    return
@@ -435,11 +466,13 @@ VOID CALLBACK FileChangeCompletionRoutine(DWORD dwErrorCode,									// completi
    }
 
    // check for buffer overflow. this means there are too many file changes
-   // for the systme to keep up with -- in this case try to restart monitoring
-   // (after a 1 second delay) and repeat the restart up to 10 times
+   // for the system to keep up with -- in this case grow the buffers (so
+   // that the next burst is more likely to fit) and restart monitoring
+   // after a 1 second delay (the restart rescans the tree to pick up the
+   // changes that were dropped)
    if(dwNumberOfBytesTransfered == 0)
    {
-      // attempt to restart monitoring
+      growBuffers(pContext);
       enqueRestartMonitoring(pContext);
       return;
    }
@@ -479,7 +512,18 @@ Error readDirectoryChanges(FileEventContext* pContext)
                                &(pContext->overlapped),
                                &FileChangeCompletionRoutine))
    {
-      return systemError(::GetLastError(), ERROR_LOCATION);
+      // network drives reject buffers larger than 64kb, so if we grew past
+      // that then drop back to the largest size they accept and try again
+      DWORD lastError = ::GetLastError();
+      if (lastError == ERROR_INVALID_PARAMETER &&
+          pContext->receiveBuffer.size() > kMaxNetworkBuffSize)
+      {
+         pContext->receiveBuffer.resize(kMaxNetworkBuffSize);
+         pContext->handlingBuffer.resize(kMaxNetworkBuffSize);
+         return readDirectoryChanges(pContext);
+      }
+
+      return systemError(lastError, ERROR_LOCATION);
    }
    else
    {
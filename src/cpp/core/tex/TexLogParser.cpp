@@ -15,6 +15,10 @@
 
 #include <core/tex/TexLogParser.hpp>
 
+#include <cctype>
+#include <cstring>
+#include <map>
+
 #include <boost/foreach.hpp>
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
@@ -23,6 +27,7 @@
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/MappedFile.hpp>
 #include <core/SafeConvert.hpp>
 #include <core/system/System.hpp>
 
@@ -138,73 +143,141 @@ FilePath resolveFilename(const FilePath& rootDir,
       return FilePath();
 }
 
-// TeX wraps lines hard at 79 characters. We use heuristics as described in
-// Sublime Text's TeX plugin to determine where these breaks are.
-void unwrapLines(std::vector<std::string>* pLines,
-                 std::vector<size_t>* pLinesUnwrapped=NULL)
+// Returns true if the line begins with l.<digits> followed by whitespace
+// (the line number of an error)
+bool parseLnn(const std::string& line, int* pLineNum)
 {
-   static boost::regex regexLine("^l\\.(\\d+)\\s");
-   static boost::regex regexAssignment("^\\\\.*?=");
-
-   std::vector<std::string>::iterator pos = pLines->begin();
+   if (!boost::algorithm::starts_with(line, "l."))
+      return false;
 
-   for ( ; pos != pLines->end(); pos++)
+   std::size_t end = 2;
+   while (end < line.size() && std::isdigit(static_cast<unsigned char>(line[end])))
+      end++;
+   if (end == 2 || end == line.size() ||
+       !std::isspace(static_cast<unsigned char>(line[end])))
    {
-      // The first line is always long, and not artificially wrapped
-      if (pos == pLines->begin())
-         continue;
+      return false;
+   }
 
-      if (pos->length() != 79)
-         continue;
+   if (pLineNum)
+      *pLineNum = safe_convert::stringTo<int>(line.substr(2, end - 2), -1);
+   return true;
+}
 
-      // The **<filename> line may be long, but we don't care about it
-      if (beginsWith(*pos, "**"))
-         continue;
+// Returns true if the line could be the continuation of a line which TeX
+// wrapped at 79 characters (using heuristics as described in Sublime Text's
+// TeX plugin)
+bool isWrappedLineContinuation(const std::string& line)
+{
+   if (line.empty())
+      return false;
 
-      while (true)
-      {
-         std::vector<std::string>::iterator nextPos = pos + 1;
-         // No more lines to add
-         if (nextPos == pLines->end())
-            break;
+   // Underfull/Overfull terminator
+   if (line == " []")
+      return false;
 
-         if (nextPos->empty())
-            break;
+   // Common prefixes
+   if (beginsWith(line, "File:", "Package:", "Document Class:"))
+      return false;
 
-         // Underfull/Overfull terminator
-         if (*nextPos == " []")
-            break;
+   // More prefixes
+   if (beginsWith(line, "LaTeX Warning:", "LaTeX Info:", "LaTeX2e <"))
+      return false;
 
-         // Common prefixes
-         if (beginsWith(*nextPos, "File:", "Package:", "Document Class:"))
-            break;
+   // Assignments (\foo=...)
+   if (line[0] == '\\' && line.find('=', 1) != std::string::npos)
+      return false;
 
-         // More prefixes
-         if (beginsWith(*nextPos, "LaTeX Warning:", "LaTeX Info:", "LaTeX2e <"))
-            break;
+   if (parseLnn(line, NULL))
+      return false;
 
-         if (boost::regex_search(*nextPos, regexAssignment))
-            break;
+   return true;
+}
 
-         if (boost::regex_search(*nextPos, regexLine))
-            break;
+// Reads the lines of a log file one at a time, directly from the mapped
+// file, rejoining the lines which TeX hard wrapped at 79 characters.
+class LogLineReader : boost::noncopyable
+{
+public:
+   LogLineReader()
+      : pos_(NULL), end_(NULL), nextLineNum_(0), hasNext_(false),
+        first_(true)
+   {
+   }
+
+   Error open(const FilePath& logFilePath)
+   {
+      Error error = file_.open(logFilePath);
+      if (error)
+         return error;
 
-         bool breakAfterAppend = nextPos->length() != 79;
+      pos_ = file_.begin();
+      end_ = file_.end();
+      return Success();
+   }
+
+   // Reads the next (unwrapped) line, providing the line number in the log
+   // at which it begins. Returns false at the end of the log.
+   bool readLine(std::string* pLine, int* pLogLineNum)
+   {
+      if (!hasNext_ && !readNext())
+         return false;
+
+      pLine->swap(next_);
+      *pLogLineNum = nextLineNum_;
+      hasNext_ = false;
+
+      // The first line is always long, and not artificially wrapped
+      bool first = first_;
+      first_ = false;
+      if (first || pLine->length() != 79)
+         return true;
+
+      // The **<filename> line may be long, but we don't care about it
+      if (beginsWith(*pLine, "**"))
+         return true;
+
+      while (readNext())
+      {
+         if (!isWrappedLineContinuation(next_))
+            break;
 
-         pos->append(*nextPos);
-         // NOTE: Erase is a simple but inefficient way of handling this. Would
-         //    be way faster to maintain an output iterator that points to the
-         //    correct point in pLines, and when finished, truncate whatever
-         //    elements come after the final position of the output iterator.
-         pLines->erase(nextPos, nextPos+1);
-         if (pLinesUnwrapped)
-            pLinesUnwrapped->push_back(1 + (pos - pLines->begin()));
+         bool breakAfterAppend = next_.length() != 79;
+         pLine->append(next_);
+         hasNext_ = false;
 
          if (breakAfterAppend)
             break;
       }
+
+      return true;
    }
-}
+
+private:
+   bool readNext()
+   {
+      // (as with std::getline, a final line without a newline is ignored)
+      const char* pNewline = static_cast<const char*>(
+                                       std::memchr(pos_, '\n', end_ - pos_));
+      if (pNewline == NULL)
+         return false;
+
+      next_.assign(pos_, pNewline);
+      pos_ = pNewline + 1;
+      nextLineNum_++;
+      hasNext_ = true;
+      return true;
+   }
+
+private:
+   MappedFile file_;
+   const char* pos_;
+   const char* end_;
+   std::string next_;
+   int nextLineNum_;
+   bool hasNext_;
+   bool first_;
+};
 
 class FileStack : public boost::noncopyable
 {
@@ -253,7 +326,7 @@ public:
                   *(itParen+1);
 
             std::string filename = std::string(it+1, itFilenameEnd);
-            fileStack_.push_back(resolveFilename(rootDir_, filename));
+            fileStack_.push_back(resolveFilenameCached(filename));
 
             updateCurrentFile();
          }
@@ -264,6 +337,20 @@ public:
 
 private:
 
+   // the same few files are opened over and over (and most parens aren't
+   // files at all) so remember the results rather than hitting the disk
+   FilePath resolveFilenameCached(const std::string& filename)
+   {
+      std::map<std::string,FilePath>::const_iterator it =
+                                             resolvedFilenames_.find(filename);
+      if (it != resolvedFilenames_.end())
+         return it->second;
+
+      FilePath filePath = resolveFilename(rootDir_, filename);
+      resolvedFilenames_[filename] = filePath;
+      return filePath;
+   }
+
    void updateCurrentFile()
    {
       for (std::vector<FilePath>::reverse_iterator it = fileStack_.rbegin();
@@ -282,6 +369,7 @@ private:
    FilePath rootDir_;
    FilePath currentFile_;
    std::vector<FilePath> fileStack_;
+   std::map<std::string,FilePath> resolvedFilenames_;
 };
 
 FilePath texFilePath(const std::string& logPath, const FilePath& compileDir)
@@ -310,20 +398,18 @@ FilePath texFilePath(const std::string& logPath, const FilePath& compileDir)
    }
 }
 
-size_t calculateWrappedLine(const std::vector<size_t>& unwrappedLines,
-                               size_t unwrappedLineNum)
+// Cheap check for a ':' followed by a digit, which any C style error line
+// must contain (so we don't need to run the regex on every line)
+bool hasLineNumberSeparator(const std::string& line)
 {
-   for (std::vector<size_t>::const_iterator it = unwrappedLines.begin();
-        it != unwrappedLines.end();
-        it++)
+   for (std::string::size_type pos = line.find(':');
+        pos != std::string::npos && pos + 1 < line.size();
+        pos = line.find(':', pos + 1))
    {
-      if (*it >= unwrappedLineNum)
-      {
-         return unwrappedLineNum + (it - unwrappedLines.begin());
-      }
+      if (std::isdigit(static_cast<unsigned char>(line[pos + 1])))
+         return true;
    }
-
-   return unwrappedLineNum + unwrappedLines.size();
+   return false;
 }
 
 } // anonymous namespace
@@ -333,27 +419,22 @@ Error parseLatexLog(const FilePath& logFilePath, LogEntries* pLogEntries)
    static boost::regex regexOverUnderfullLines(" at lines (\\d+)--(\\d+)\\s*(?:\\[])?$");
    static boost::regex regexWarning("^(?:.*?) Warning: (.+)");
    static boost::regex regexWarningEnd(" input line (\\d+)\\.$");
-   static boost::regex regexLnn("^l\\.(\\d+)\\s");
    static boost::regex regexCStyleError("^(.+):(\\d+):\\s(.+)$");
 
-   std::vector<std::string> lines;
-   Error error = readStringVectorFromFile(logFilePath, &lines, false);
+   // read the log in a single pass (logs from large documents can be tens
+   // of megabytes so we don't want to hold all of their lines in memory)
+   LogLineReader reader;
+   Error error = reader.open(logFilePath);
    if (error)
       return error;
 
-   std::vector<size_t> linesUnwrapped;
-   unwrapLines(&lines, &linesUnwrapped);
-
    FilePath rootDir = logFilePath.parent();
    FileStack fileStack(rootDir);
 
-   for (std::vector<std::string>::const_iterator it = lines.begin();
-        it != lines.end();
-        it++)
+   std::string line;
+   int logLineNum;
+   while (reader.readLine(&line, &logLineNum))
    {
-      const std::string& line = *it;
-      int logLineNum = (it - lines.begin()) + 1;
-
       // We slurp overfull/underfull messages with no further processing
       // (i.e. not manipulating the file stack)
 
@@ -382,8 +463,7 @@ Error parseLatexLog(const FilePath& logFilePath, LogEntries* pLogEntries)
          }
 
          pLogEntries->push_back(LogEntry(logFilePath,
-                                         calculateWrappedLine(linesUnwrapped,
-                                                              logLineNum),
+                                         logLineNum,
                                          LogEntry::Box,
                                          fileStack.currentFile(),
                                          lineNum,
@@ -392,21 +472,17 @@ Error parseLatexLog(const FilePath& logFilePath, LogEntries* pLogEntries)
          if (singleLine)
             continue;
 
-         for (; it != lines.end(); it++)
+         // For multi-line case, we're looking for " []" on a line by itself
+         // (if we don't find it the log file is malformed, and we're done)
+         std::string boxLine;
+         int boxLogLineNum;
+         while (reader.readLine(&boxLine, &boxLogLineNum))
          {
-            // For multi-line case, we're looking for " []" on a line by itself
-            if (*it == " []")
+            if (boxLine == " []")
                break;
          }
 
-         // The iterator would be incremented by the outer for loop, must not
-         // let it go past the end! (If we did get to the end, it would
-         // mean the log file was malformed, but we still can't crash in this
-         // situation.)
-         if (it == lines.end())
-            break;
-         else
-            continue;
+         continue;
       }
 
       fileStack.processLine(line);
@@ -418,84 +494,72 @@ Error parseLatexLog(const FilePath& logFilePath, LogEntries* pLogEntries)
          std::string errorMsg = line.substr(2);
          int lineNum = -1;
 
-         boost::smatch match;
-         for (it++; it != lines.end(); it++)
+         std::string errorLine;
+         int errorLogLineNum;
+         while (reader.readLine(&errorLine, &errorLogLineNum))
          {
-            if (boost::regex_search(*it, match, regexLnn))
-            {
-               lineNum = safe_convert::stringTo<int>(match[1], -1);
+            if (parseLnn(errorLine, &lineNum))
                break;
-            }
          }
 
          pLogEntries->push_back(LogEntry(logFilePath,
-                                         calculateWrappedLine(linesUnwrapped,
-                                                              logLineNum),
+                                         logLineNum,
                                          LogEntry::Error,
                                          fileStack.currentFile(),
                                          lineNum,
                                          errorMsg));
-
-         // The iterator would be incremented by the outer for loop, must not
-         // let it go past the end! (If we did get to the end, it would
-         // mean the log file was malformed, but we still can't crash in this
-         // situation.)
-         if (it == lines.end())
-            break;
-         else
-            continue;
+         continue;
       }
 
       boost::smatch warningMatch;
-      if (boost::regex_search(line, warningMatch, regexWarning))
+      if (boost::algorithm::contains(line, " Warning: ") &&
+          boost::regex_search(line, warningMatch, regexWarning))
       {
          std::string warningMsg = warningMatch[1];
          int lineNum = -1;
+
+         // the message continues until a line ending in '.' (which may
+         // contain the input line number)
+         std::string warningLine = line;
+         int warningLogLineNum;
          while (true)
          {
             if (boost::algorithm::ends_with(warningMsg, "."))
             {
                boost::smatch warningEndMatch;
-               if (boost::regex_search(*it, warningEndMatch, regexWarningEnd))
+               if (boost::regex_search(warningLine,
+                                       warningEndMatch,
+                                       regexWarningEnd))
                {
                   lineNum = safe_convert::stringTo<int>(warningEndMatch[1], -1);
                }
                break;
             }
 
-            if (++it == lines.end())
+            if (!reader.readLine(&warningLine, &warningLogLineNum))
                break;
-            warningMsg.append(*it);
+            warningMsg.append(warningLine);
          }
 
          pLogEntries->push_back(LogEntry(logFilePath,
-                                         calculateWrappedLine(linesUnwrapped,
-                                                              logLineNum),
+                                         logLineNum,
                                          LogEntry::Warning,
                                          fileStack.currentFile(),
                                          lineNum,
                                          warningMsg));
-
-         // The iterator would be incremented by the outer for loop, must not
-         // let it go past the end! (If we did get to the end, it would
-         // mean the log file was malformed, but we still can't crash in this
-         // situation.)
-         if (it == lines.end())
-            break;
-         else
-            continue;
+         continue;
       }
 
       boost::smatch cStyleErrorMatch;
-      if (boost::regex_search(line, cStyleErrorMatch, regexCStyleError))
+      if (hasLineNumberSeparator(line) &&
+          boost::regex_search(line, cStyleErrorMatch, regexCStyleError))
       {
          FilePath cstyleFile = resolveFilename(rootDir, cStyleErrorMatch[1]);
          if (cstyleFile.exists())
          {
             int lineNum = safe_convert::stringTo<int>(cStyleErrorMatch[2], -1);
             pLogEntries->push_back(LogEntry(logFilePath,
-                                            calculateWrappedLine(linesUnwrapped,
-                                                                 logLineNum),
+                                            logLineNum,
                                             LogEntry::Error,
                                             cstyleFile,
                                             lineNum,
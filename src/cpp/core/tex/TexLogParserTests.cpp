@@ -0,0 +1,101 @@
+/*
+ * TexLogParserTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/tex/TexLogParser.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tex {
+
+namespace {
+
+LogEntries parseLog(const std::string& contents)
+{
+   LogEntries entries;
+
+   FilePath logFilePath;
+   if (FilePath::tempFilePath(&logFilePath))
+      return entries;
+   if (writeStringToFile(logFilePath, contents))
+      return entries;
+
+   parseLatexLog(logFilePath, &entries);
+   logFilePath.remove();
+   return entries;
+}
+
+} // anonymous namespace
+
+context("TexLogParser")
+{
+   test_that("errors and warnings are parsed")
+   {
+      LogEntries entries = parseLog(
+            "This is pdfTeX, Version 3.14159265\n"
+            "! Undefined control sequence.\n"
+            "<recently read> \\foo\n"
+            "l.42 \\foo\n"
+            "LaTeX Warning: Reference `x' on page 1 undefined on input line 7.\n"
+            "Overfull \\hbox (1.0pt too wide) in paragraph at lines 10--12 []\n");
+
+      expect_true(entries.size() == 3);
+
+      expect_true(entries[0].type() == LogEntry::Error);
+      expect_true(entries[0].message() == "Undefined control sequence.");
+      expect_true(entries[0].line() == 42);
+      expect_true(entries[0].logLine() == 2);
+
+      expect_true(entries[1].type() == LogEntry::Warning);
+      expect_true(entries[1].line() == 7);
+      expect_true(entries[1].logLine() == 5);
+
+      expect_true(entries[2].type() == LogEntry::Box);
+      expect_true(entries[2].line() == 10);
+      expect_true(entries[2].logLine() == 6);
+   }
+
+   test_that("wrapped lines are rejoined")
+   {
+      std::string wrapped = "LaTeX Font Warning: Font shape `OT1/cmr/bx/sc' undefined using `OT1";
+      wrapped.append(79 - wrapped.size(), 'x');
+
+      LogEntries entries = parseLog(
+            "This is pdfTeX, Version 3.14159265\n" +
+            wrapped + "\n"
+            "/cmr/bx/n' instead on input line 3.\n"
+            "! Emergency stop.\n"
+            "l.5\n");
+
+      expect_true(entries.size() == 2);
+      expect_true(entries[0].type() == LogEntry::Warning);
+      expect_true(entries[0].line() == 3);
+      expect_true(entries[0].logLine() == 2);
+
+      // log lines refer to the lines in the file (not the rejoined lines)
+      expect_true(entries[1].type() == LogEntry::Error);
+      expect_true(entries[1].logLine() == 4);
+   }
+}
+
+} // namespace tex
+} // namespace core
+} // namespace rstudio
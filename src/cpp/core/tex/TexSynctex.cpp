@@ -16,6 +16,7 @@
 #include <core/tex/TexSynctex.hpp>
 
 #include <iostream>
+#include <map>
 
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -73,6 +74,13 @@ struct Synctex::Impl
 
    FilePath pdfPath;
    synctex_scanner_t scanner;
+
+   // the scanner is kept for repeated searches so we also remember the
+   // results of the lookups which have to walk the input files or pages
+   // (or hit the disk) each time
+   std::map<std::string,std::string> inputFileNames;
+   std::map<int,FilePath> tagFilePaths;
+   std::map<int,PdfLocation> pageContentTops;
 };
 
 
@@ -148,23 +156,8 @@ SourceLocation Synctex::inverseSearch(const PdfLocation& location)
       synctex_node_t node = synctex_next_result(pImpl_->scanner);
       if (node != NULL)
       {
-         // get the filename then normalize it
-         std::string name = ::synctex_scanner_get_name(
-                                                   pImpl_->scanner,
-                                                   ::synctex_node_tag(node));
-         std::string adjustedName = normalizeSynctexName(name);
-
-         // might be relative or might be absolute, complete it against the
-         // pdf's parent directory to cover both cases
-         FilePath filePath = pImpl_->pdfPath.parent().complete(adjustedName);
-
-         // fully normalize
-         Error error = core::system::realPath(filePath, &filePath);
-         if (error)
-            LOG_ERROR(error);
-
          // return source location
-         sourceLocation = SourceLocation(filePath,
+         sourceLocation = SourceLocation(filePathForTag(::synctex_node_tag(node)),
                                          ::synctex_node_line(node),
                                          ::synctex_node_column(node));
       }
@@ -175,6 +168,18 @@ SourceLocation Synctex::inverseSearch(const PdfLocation& location)
 
 
 PdfLocation Synctex::topOfPageContent(int page)
+{
+   std::map<int,PdfLocation>::const_iterator it =
+                                          pImpl_->pageContentTops.find(page);
+   if (it != pImpl_->pageContentTops.end())
+      return it->second;
+
+   PdfLocation location = findTopOfPageContent(page);
+   pImpl_->pageContentTops[page] = location;
+   return location;
+}
+
+PdfLocation Synctex::findTopOfPageContent(int page)
 {
    // get the sheet contents
    synctex_node_t sheetNode = ::synctex_sheet_content(pImpl_->scanner, page);
@@ -196,6 +201,18 @@ PdfLocation Synctex::topOfPageContent(int page)
 }
 
 std::string Synctex::synctexNameForInputFile(const FilePath& inputFile)
+{
+   std::map<std::string,std::string>::const_iterator it =
+                     pImpl_->inputFileNames.find(inputFile.absolutePath());
+   if (it != pImpl_->inputFileNames.end())
+      return it->second;
+
+   std::string name = findSynctexNameForInputFile(inputFile);
+   pImpl_->inputFileNames[inputFile.absolutePath()] = name;
+   return name;
+}
+
+std::string Synctex::findSynctexNameForInputFile(const FilePath& inputFile)
 {
    // get the base directory for the input file
    FilePath parentPath = inputFile.parent();
@@ -223,6 +240,29 @@ std::string Synctex::synctexNameForInputFile(const FilePath& inputFile)
    return std::string();
 }
 
+FilePath Synctex::filePathForTag(int tag)
+{
+   std::map<int,FilePath>::const_iterator it = pImpl_->tagFilePaths.find(tag);
+   if (it != pImpl_->tagFilePaths.end())
+      return it->second;
+
+   // get the filename then normalize it
+   std::string name = ::synctex_scanner_get_name(pImpl_->scanner, tag);
+   std::string adjustedName = normalizeSynctexName(name);
+
+   // might be relative or might be absolute, complete it against the
+   // pdf's parent directory to cover both cases
+   FilePath filePath = pImpl_->pdfPath.parent().complete(adjustedName);
+
+   // fully normalize
+   Error error = core::system::realPath(filePath, &filePath);
+   if (error)
+      LOG_ERROR(error);
+
+   pImpl_->tagFilePaths[tag] = filePath;
+   return filePath;
+}
+
 std::string normalizeSynctexName(const std::string& name)
 {
    // trim it (on windows if it's the last available name it can include
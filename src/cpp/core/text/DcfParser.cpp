@@ -20,14 +20,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 #include <boost/format.hpp>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/algorithm/string/split.hpp>
-
-#include <boost/regex.hpp>
 
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
@@ -40,29 +38,81 @@ namespace text {
 
 const char * const kDcfFieldRegex = "([^\\s]+?)\\s*\\:\\s*(.*)$";
 
+namespace {
+
+// lines are matched by hand rather than with regexes (they're the bulk of
+// the work when parsing large files such as PACKAGES indexes); whitespace is
+// the same set of characters as \\s
+
+inline bool isDcfSpace(char ch)
+{
+   return ch == ' ' || ch == '\t' || ch == '\n' ||
+          ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+bool isBlankLine(const char* begin, const char* end)
+{
+   for (; begin != end; ++begin)
+   {
+      if (!isDcfSpace(*begin))
+         return false;
+   }
+   return true;
+}
+
+// matches a key-value line (equivalent to matching kDcfFieldRegex), returning
+// the end of the key and the start of the value
+bool matchFieldLine(const char* begin,
+                    const char* end,
+                    const char** pKeyEnd,
+                    const char** pValueBegin)
+{
+   // the key is at least one non-space character
+   if (begin == end || isDcfSpace(*begin))
+      return false;
+
+   const char* it = begin + 1;
+   while (it != end && *it != ':' && !isDcfSpace(*it))
+      ++it;
+   const char* keyEnd = it;
+
+   // it's followed by optional whitespace and a colon
+   while (it != end && isDcfSpace(*it))
+      ++it;
+   if (it == end || *it != ':')
+      return false;
+
+   // then optional whitespace and the value
+   ++it;
+   while (it != end && isDcfSpace(*it))
+      ++it;
+
+   *pKeyEnd = keyEnd;
+   *pValueBegin = it;
+   return true;
+}
+
+} // anonymous namespace
+
 Error parseDcfFile(const std::string& dcfFileContents,
                    bool preserveKeyCase,
                    DcfFieldRecorder recordField,
                    std::string* pUserErrMsg)
 {
-   // split into lines
-   std::vector<std::string> dcfLines;
-   boost::algorithm::split(dcfLines,
-                           dcfFileContents,
-                           boost::algorithm::is_any_of("\n"));
-
    // iterate over lines
    int lineNumber = 0;
    std::string currentKey;
    std::string currentValue;
-   for(std::vector<std::string>::const_iterator it = dcfLines.begin();
-       it != dcfLines.end();
-       ++it)
+   const char* pContents = dcfFileContents.data();
+   const char* pContentsEnd = pContents + dcfFileContents.size();
+   for (const char* lineBegin = pContents; ; )
    {
+      const char* lineEnd = std::find(lineBegin, pContentsEnd, '\n');
+
       lineNumber++;
 
       // report blank lines (so clients can see record delimiters)
-      if (it->empty() || boost::algorithm::trim_copy(*it).empty())
+      if (isBlankLine(lineBegin, lineEnd))
       {
          // if we have a pending key & value then resolve it
          if (!currentKey.empty())
@@ -76,58 +126,60 @@ Error parseDcfFile(const std::string& dcfFileContents,
 
          if (!recordField(std::make_pair(std::string(), std::string())))
             return Success();
-
-         continue;
       }
 
       // skip comment lines
-      if (it->at(0) == '#')
-         continue;
-
-      // define regexes
-      boost::regex keyValueRegx(kDcfFieldRegex);
-      boost::regex continuationRegex("[\t\\s](.*)");
+      else if (*lineBegin == '#')
+      {
+      }
 
-       // look for a key-value pair line
-      boost::smatch keyValueMatch, continuationMatch;
-      if (regex_match(*it, keyValueMatch, keyValueRegx))
+      // look for a key-value pair line
+      else
       {
-         // if we have a pending key & value then resolve it
-         if (!currentKey.empty())
+         const char* keyEnd = NULL;
+         const char* valueBegin = NULL;
+         if (matchFieldLine(lineBegin, lineEnd, &keyEnd, &valueBegin))
          {
-            if (!recordField(std::make_pair(currentKey,currentValue)))
-               return Success();
-
-            currentKey.clear();
-            currentValue.clear();
+            // if we have a pending key & value then resolve it
+            if (!currentKey.empty())
+            {
+               if (!recordField(std::make_pair(currentKey,currentValue)))
+                  return Success();
+
+               currentKey.clear();
+               currentValue.clear();
+            }
+
+            // update the current key and value
+            currentKey.assign(lineBegin, keyEnd);
+            if (!preserveKeyCase)
+               currentKey = string_utils::toLower(currentKey);
+            currentValue.assign(valueBegin, lineEnd);
          }
 
-         // update the current key and value
-         currentKey = preserveKeyCase ?
-                                 keyValueMatch[1] :
-                                 string_utils::toLower(keyValueMatch[1]);
-         currentValue = keyValueMatch[2];
-      }
+         // look for a continuation
+         else if (!currentKey.empty() && isDcfSpace(*lineBegin))
+         {
+            currentValue.append("\n");
+            currentValue.append(lineBegin + 1, lineEnd);
+         }
 
-      // look for a continuation
-      else if (!currentKey.empty() &&
-               regex_match(*it, continuationMatch, continuationRegex))
-      {
-         currentValue.append("\n");
-         currentValue.append(continuationMatch[1]);
+         // invalid line
+         else
+         {
+            Error error = systemError(boost::system::errc::protocol_error,
+                                      ERROR_LOCATION);
+            boost::format fmt("file line number %1% is invalid");
+            *pUserErrMsg = boost::str(fmt % lineNumber);
+            error.addProperty("parse-error", *pUserErrMsg);
+            error.addProperty("line-contents", std::string(lineBegin, lineEnd));
+            return error;
+         }
       }
 
-      // invalid line
-      else
-      {
-         Error error = systemError(boost::system::errc::protocol_error,
-                                   ERROR_LOCATION);
-         boost::format fmt("file line number %1% is invalid");
-         *pUserErrMsg = boost::str(fmt % lineNumber);
-         error.addProperty("parse-error", *pUserErrMsg);
-         error.addProperty("line-contents", *it);
-         return error;
-      }
+      if (lineEnd == pContentsEnd)
+         break;
+      lineBegin = lineEnd + 1;
    }
 
    // resolve any pending key and value
@@ -205,10 +257,69 @@ Error parseDcfFile(const std::string& dcfFileContents,
                        pUserErrMsg);
 }
 
+namespace {
+
+bool recordInsert(std::vector<std::map<std::string,std::string> >* pRecords,
+                  bool* pInRecord,
+                  const std::pair<std::string,std::string>& field)
+{
+   // blank lines end the current record
+   if (field.first.empty())
+   {
+      *pInRecord = false;
+      return true;
+   }
+
+   if (!*pInRecord)
+   {
+      pRecords->push_back(std::map<std::string,std::string>());
+      *pInRecord = true;
+   }
+
+   pRecords->back().insert(field);
+   return true;
+}
+
+} // anonymous namespace
+
+Error parseDcfRecords(const std::string& dcfFileContents,
+                      bool preserveKeyCase,
+                      std::vector<std::map<std::string,std::string> >* pRecords,
+                      std::string* pUserErrMsg)
+{
+   bool inRecord = false;
+   return parseDcfFile(dcfFileContents,
+                       preserveKeyCase,
+                       boost::bind(recordInsert, pRecords, &inRecord, _1),
+                       pUserErrMsg);
+}
+
 std::string dcfMultilineAsFolded(const std::string& line)
 {
-   return boost::algorithm::trim_copy(
-       boost::regex_replace(line, boost::regex("\\s*\r?\n\\s*"), " "));
+   // replace each run of whitespace which spans lines with a single space
+   std::string folded;
+   folded.reserve(line.size());
+   for (std::string::const_iterator it = line.begin(); it != line.end(); )
+   {
+      if (!isDcfSpace(*it))
+      {
+         folded.push_back(*it++);
+         continue;
+      }
+
+      std::string::const_iterator runEnd = it;
+      bool hasNewline = false;
+      for (; runEnd != line.end() && isDcfSpace(*runEnd); ++runEnd)
+         hasNewline = hasNewline || (*runEnd == '\n');
+
+      if (hasNewline)
+         folded.push_back(' ');
+      else
+         folded.append(it, runEnd);
+      it = runEnd;
+   }
+
+   return boost::algorithm::trim_copy(folded);
 }
 
 
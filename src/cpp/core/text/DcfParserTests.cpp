@@ -0,0 +1,99 @@
+/*
+ * DcfParserTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <core/Error.hpp>
+#include <core/text/DcfParser.hpp>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+typedef std::map<std::string,std::string> Fields;
+
+context("DcfParser")
+{
+   test_that("fields and continuations are parsed")
+   {
+      Fields fields;
+      std::string errMsg;
+      Error error = parseDcfFile("# comment\n"
+                                 "Package: foo\n"
+                                 "Title : A \tfoo\n"
+                                 "Depends:\n"
+                                 "    R (>= 3.0.0),\n"
+                                 "\tutils\n",
+                                 false,
+                                 &fields,
+                                 &errMsg);
+      expect_false(error);
+      expect_true(fields.size() == 3);
+      expect_true(fields["package"] == "foo");
+      expect_true(fields["title"] == "A \tfoo");
+      expect_true(fields["depends"] == "\n   R (>= 3.0.0),\nutils");
+   }
+
+   test_that("key case is preserved on request")
+   {
+      Fields fields;
+      std::string errMsg;
+      expect_false(parseDcfFile("Package: foo", true, &fields, &errMsg));
+      expect_true(fields["Package"] == "foo");
+   }
+
+   test_that("invalid lines are reported")
+   {
+      Fields fields;
+      std::string errMsg;
+      Error error = parseDcfFile("Package: foo\nnot a field\n",
+                                 false,
+                                 &fields,
+                                 &errMsg);
+      expect_true(error);
+      expect_true(errMsg == "file line number 2 is invalid");
+
+      expect_true(parseDcfFile("  leading: space", false, &fields, &errMsg));
+      expect_true(parseDcfFile("Key value: x", false, &fields, &errMsg));
+   }
+
+   test_that("records are separated by blank lines")
+   {
+      std::vector<Fields> records;
+      std::string errMsg;
+      Error error = parseDcfRecords("Package: a\nVersion: 1.0\n\n \t\n"
+                                    "Package: b\nVersion: 2.0\n\n",
+                                    false,
+                                    &records,
+                                    &errMsg);
+      expect_false(error);
+      expect_true(records.size() == 2);
+      expect_true(records[0]["package"] == "a");
+      expect_true(records[1]["version"] == "2.0");
+   }
+
+   test_that("multiline values can be folded")
+   {
+      expect_true(dcfMultilineAsFolded(" a\n   b \r\n c\td ") == "a b c\td");
+   }
+}
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,637 @@
+/*
+ * DelimitedPreview.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/text/DelimitedPreview.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <set>
+
+#include <boost/lexical_cast.hpp>
+
+#include <core/StringUtils.hpp>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+namespace {
+
+// the part of the contents which is looked at (less any byte order mark),
+// and whether records may have been cut off at its end
+struct Sample
+{
+   Sample(const char* begin, const char* end)
+   {
+      if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+         begin += 3;
+
+      truncated = (end - begin) > kDelimitedPreviewMaxBytes;
+      if (truncated)
+         end = begin + kDelimitedPreviewMaxBytes;
+
+      this->begin = begin;
+      this->end = end;
+   }
+
+   const char* begin;
+   const char* end;
+   bool truncated;
+};
+
+bool isBlank(char ch)
+{
+   return ch == ' ' || ch == '\t';
+}
+
+bool isDigit(char ch)
+{
+   return ch >= '0' && ch <= '9';
+}
+
+// reads records (skipping blank and comment lines) as scan does. quotes
+// are recognized at the start of a field and may span lines
+class RecordReader
+{
+public:
+   RecordReader(const Sample& sample, const DelimitedFormat& format)
+      : pos_(sample.begin), end_(sample.end),
+        truncated_(sample.truncated), format_(format)
+   {
+   }
+
+   bool next(std::vector<std::string>* pFields)
+   {
+      while (pos_ < end_)
+      {
+         pFields->clear();
+         if (readRecord(pFields) && !pFields->empty())
+            return true;
+      }
+      return false;
+   }
+
+private:
+   bool atSeparator() const
+   {
+      return format_.separator == '\0' ? isBlank(*pos_)
+                                       : *pos_ == format_.separator;
+   }
+
+   bool atLineEnd() const
+   {
+      return *pos_ == '\n' || *pos_ == '\r' ||
+             (format_.comment != '\0' && *pos_ == format_.comment);
+   }
+
+   void skipLineEnd()
+   {
+      while (pos_ < end_ && *pos_ != '\n')
+         ++pos_;
+      if (pos_ < end_)
+         ++pos_;
+   }
+
+   // returns false if the record was cut off by the end of the sample
+   bool readRecord(std::vector<std::string>* pFields)
+   {
+      bool whitespace = format_.separator == '\0';
+      if (whitespace)
+      {
+         while (pos_ < end_ && isBlank(*pos_))
+            ++pos_;
+      }
+
+      while (pos_ < end_ && !atLineEnd())
+      {
+         std::string field;
+         if (format_.quote != '\0' && *pos_ == format_.quote)
+         {
+            ++pos_;
+            bool closed = false;
+            while (pos_ < end_)
+            {
+               char ch = *pos_++;
+               if (ch == format_.quote)
+               {
+                  if (pos_ < end_ && *pos_ == format_.quote)
+                  {
+                     field.push_back(ch);
+                     ++pos_;
+                     continue;
+                  }
+                  closed = true;
+                  break;
+               }
+               field.push_back(ch);
+            }
+
+            if (!closed && truncated_)
+               return false;
+         }
+
+         while (pos_ < end_ && !atSeparator() && !atLineEnd())
+            field.push_back(*pos_++);
+         pFields->push_back(field);
+
+         if (pos_ >= end_ || atLineEnd())
+            break;
+
+         // consume the separator (a run of them when splitting on
+         // whitespace, where a trailing run doesn't start a field)
+         if (whitespace)
+         {
+            while (pos_ < end_ && isBlank(*pos_))
+               ++pos_;
+         }
+         else
+         {
+            ++pos_;
+            if (pos_ >= end_ || atLineEnd())
+               pFields->push_back(std::string());
+         }
+      }
+
+      if (pos_ >= end_ && truncated_)
+      {
+         pFields->clear();
+         return false;
+      }
+
+      skipLineEnd();
+      return true;
+   }
+
+   const char* pos_;
+   const char* end_;
+   bool truncated_;
+   const DelimitedFormat& format_;
+};
+
+std::vector<std::string> readLines(const Sample& sample, std::size_t maxLines)
+{
+   std::vector<std::string> lines;
+   const char* pos = sample.begin;
+   while (pos < sample.end && lines.size() < maxLines)
+   {
+      const char* eol = std::find(pos, sample.end, '\n');
+      if (eol == sample.end && sample.truncated)
+         break;
+
+      const char* lineEnd = eol;
+      if (lineEnd > pos && *(lineEnd - 1) == '\r')
+         --lineEnd;
+      lines.push_back(std::string(pos, lineEnd));
+
+      pos = eol < sample.end ? eol + 1 : eol;
+   }
+   return lines;
+}
+
+std::vector<std::vector<std::string> > readRecords(const Sample& sample,
+                                                   const DelimitedFormat& format,
+                                                   std::size_t maxRecords)
+{
+   std::vector<std::vector<std::string> > records;
+   RecordReader reader(sample, format);
+   std::vector<std::string> fields;
+   while (records.size() < maxRecords && reader.next(&fields))
+      records.push_back(fields);
+   return records;
+}
+
+bool isNA(const std::string& value)
+{
+   return value == "NA";
+}
+
+bool isLogical(const std::string& value)
+{
+   return value == "T" || value == "F" ||
+          value == "TRUE" || value == "FALSE" ||
+          value == "true" || value == "false" ||
+          value == "True" || value == "False";
+}
+
+bool isInteger(const std::string& value)
+{
+   std::size_t i = 0;
+   if (i < value.size() && (value[i] == '-' || value[i] == '+'))
+      i++;
+   if (i == value.size() || value.size() - i > 10)
+      return false;
+
+   long long number = 0;
+   for (; i < value.size(); i++)
+   {
+      if (!isDigit(value[i]))
+         return false;
+      number = number * 10 + (value[i] - '0');
+   }
+
+   // NA_integer_ is the most negative int, so the range is symmetric
+   return number <= 2147483647LL;
+}
+
+bool isNumeric(const std::string& value, char decimal)
+{
+   std::size_t i = 0;
+   if (i < value.size() && (value[i] == '-' || value[i] == '+'))
+      i++;
+
+   std::string rest = value.substr(i);
+   if (rest == "Inf" || rest == "inf" || rest == "NaN")
+      return true;
+
+   std::size_t digits = 0;
+   while (i < value.size() && isDigit(value[i]))
+   {
+      i++;
+      digits++;
+   }
+   if (i < value.size() && value[i] == decimal)
+   {
+      i++;
+      while (i < value.size() && isDigit(value[i]))
+      {
+         i++;
+         digits++;
+      }
+   }
+   if (digits == 0)
+      return false;
+
+   if (i < value.size() && (value[i] == 'e' || value[i] == 'E'))
+   {
+      i++;
+      if (i < value.size() && (value[i] == '-' || value[i] == '+'))
+         i++;
+      if (i == value.size() || !isDigit(value[i]))
+         return false;
+      while (i < value.size() && isDigit(value[i]))
+         i++;
+   }
+
+   return i == value.size();
+}
+
+bool fitsType(const std::string& value, DelimitedColumnType type, char decimal)
+{
+   switch (type)
+   {
+   case DelimitedColumnLogical:
+      return isLogical(value);
+   case DelimitedColumnInteger:
+      return isInteger(value);
+   case DelimitedColumnNumeric:
+      return isNumeric(value, decimal);
+   default:
+      return true;
+   }
+}
+
+// the narrowest type holding all of the values (an all NA column is
+// logical, as in R)
+DelimitedColumnType inferColumnType(
+                     const std::vector<std::vector<std::string> >& records,
+                     std::size_t firstRecord,
+                     std::size_t column,
+                     char decimal)
+{
+   int type = DelimitedColumnLogical;
+   for (std::size_t i = firstRecord; i < records.size(); i++)
+   {
+      if (column >= records[i].size())
+         continue;
+
+      const std::string& value = records[i][column];
+      if (value.empty() || isNA(value))
+         continue;
+
+      while (type != DelimitedColumnCharacter &&
+             !fitsType(value, static_cast<DelimitedColumnType>(type), decimal))
+      {
+         type++;
+      }
+   }
+   return static_cast<DelimitedColumnType>(type);
+}
+
+DelimitedValue normalizeValue(const std::string& value,
+                              DelimitedColumnType type,
+                              char decimal)
+{
+   if (isNA(value))
+      return DelimitedValue();
+
+   switch (type)
+   {
+   case DelimitedColumnLogical:
+      if (value.empty())
+         return DelimitedValue();
+      return DelimitedValue(value[0] == 'T' || value[0] == 't' ? "TRUE"
+                                                               : "FALSE");
+
+   case DelimitedColumnInteger:
+      if (value.empty())
+         return DelimitedValue();
+      return DelimitedValue(value);
+
+   case DelimitedColumnNumeric:
+   {
+      if (value.empty())
+         return DelimitedValue();
+      std::string normalized(value);
+      if (decimal != '.')
+         std::replace(normalized.begin(), normalized.end(), decimal, '.');
+      return DelimitedValue(normalized);
+   }
+
+   default:
+      return DelimitedValue(value);
+   }
+}
+
+bool isReservedWord(const std::string& name)
+{
+   static const char* const kReserved[] = {
+      "if", "else", "repeat", "while", "function", "for", "next", "break",
+      "TRUE", "FALSE", "NULL", "Inf", "NaN", "NA", "NA_integer_", "NA_real_",
+      "NA_character_", "in"
+   };
+   for (std::size_t i = 0; i < sizeof(kReserved) / sizeof(kReserved[0]); i++)
+   {
+      if (name == kReserved[i])
+         return true;
+   }
+   return false;
+}
+
+// as make.names (non-ASCII characters are assumed to be letters)
+std::string makeName(const std::string& value)
+{
+   std::string name;
+   for (std::size_t i = 0; i < value.size(); i++)
+   {
+      unsigned char ch = value[i];
+      bool valid = std::isalnum(ch) || ch == '.' || ch == '_' || ch >= 0x80;
+      name.push_back(valid ? value[i] : '.');
+   }
+
+   if (name.empty() ||
+       isDigit(name[0]) || name[0] == '_' ||
+       (name[0] == '.' && name.size() > 1 && isDigit(name[1])))
+   {
+      name = "X" + name;
+   }
+
+   if (isReservedWord(name))
+      name += ".";
+
+   return name;
+}
+
+// as make.unique
+void makeUnique(std::vector<std::string>* pNames)
+{
+   std::set<std::string> used(pNames->begin(), pNames->end());
+   std::set<std::string> seen;
+   std::map<std::string, int> suffixes;
+   for (std::size_t i = 0; i < pNames->size(); i++)
+   {
+      std::string& name = (*pNames)[i];
+      if (seen.insert(name).second)
+         continue;
+
+      int& suffix = suffixes[name];
+      std::string unique;
+      do
+      {
+         unique = name + "." + boost::lexical_cast<std::string>(++suffix);
+      }
+      while (used.count(unique));
+
+      used.insert(unique);
+      seen.insert(unique);
+      name = unique;
+   }
+}
+
+std::size_t numericFieldCount(const std::vector<std::string>& record,
+                              char decimal)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < record.size(); i++)
+   {
+      if (isNumeric(record[i], decimal))
+         count++;
+   }
+   return count;
+}
+
+} // anonymous namespace
+
+DelimitedFormat sniffDelimitedFormat(const char* begin,
+                                     const char* end,
+                                     std::size_t maxLines)
+{
+   Sample sample(begin, end);
+   std::vector<std::string> lines = readLines(sample, maxLines);
+
+   DelimitedFormat format;
+
+   // presume # to be the comment character if any lines start with it
+   for (std::size_t i = 0; i < lines.size(); i++)
+   {
+      if (!lines[i].empty() && lines[i][0] == '#')
+      {
+         format.comment = '#';
+         break;
+      }
+   }
+
+   // fields quoted with ' (and none with ")
+   bool singleQuoted = false;
+   bool doubleQuoted = false;
+   for (std::size_t i = 0; i < lines.size(); i++)
+   {
+      const std::string& line = lines[i];
+      for (std::size_t j = 0; j < line.size(); j++)
+      {
+         bool fieldStart = j == 0 || std::strchr("\t;, ", line[j - 1]);
+         if (line[j] == '"')
+            doubleQuoted = true;
+         else if (line[j] == '\'' && fieldStart)
+            singleQuoted = true;
+      }
+   }
+   if (singleQuoted && !doubleQuoted)
+      format.quote = '\'';
+
+   // prefer a separator which splits every record into the same number
+   // (more than one) of fields, and otherwise one which splits the first
+   const char kSeparators[] = { '\t', ';', ',' };
+   char firstSplitting = '\0';
+   bool consistent = false;
+   for (std::size_t i = 0; i < sizeof(kSeparators) && !consistent; i++)
+   {
+      DelimitedFormat candidate = format;
+      candidate.separator = kSeparators[i];
+      std::vector<std::vector<std::string> > records =
+                                    readRecords(sample, candidate, maxLines);
+      if (records.empty() || records[0].size() < 2)
+         continue;
+
+      if (firstSplitting == '\0')
+         firstSplitting = kSeparators[i];
+
+      consistent = true;
+      for (std::size_t j = 1; j < records.size(); j++)
+      {
+         if (records[j].size() != records[0].size())
+            consistent = false;
+      }
+      if (consistent)
+         format.separator = kSeparators[i];
+   }
+   if (!consistent)
+      format.separator = firstSplitting;
+
+   std::vector<std::vector<std::string> > records =
+                                    readRecords(sample, format, maxLines);
+
+   // a comma decimal point (if data has numbers with commas but none
+   // with periods)
+   if (format.separator != ',')
+   {
+      std::size_t commaNumbers = 0, periodNumbers = 0;
+      for (std::size_t i = 1; i < records.size(); i++)
+      {
+         for (std::size_t j = 0; j < records[i].size(); j++)
+         {
+            const std::string& value = records[i][j];
+            if (value.find('.') != std::string::npos && isNumeric(value, '.'))
+               periodNumbers++;
+            else if (value.find(',') != std::string::npos &&
+                     isNumeric(value, ','))
+               commaNumbers++;
+         }
+      }
+      if (commaNumbers > 0 && periodNumbers == 0)
+         format.decimal = ',';
+   }
+
+   // a header has no numbers, and either no digits at all or is followed
+   // by a record with numbers
+   if (!records.empty() && numericFieldCount(records[0], format.decimal) == 0)
+   {
+      bool hasDigits = false;
+      for (std::size_t i = 0; i < records[0].size() && !hasDigits; i++)
+      {
+         const std::string& value = records[0][i];
+         hasDigits = std::find_if(value.begin(), value.end(), isDigit) !=
+                     value.end();
+      }
+
+      format.header = !hasDigits ||
+                      (records.size() > 1 &&
+                       numericFieldCount(records[1], format.decimal) > 0);
+   }
+
+   return format;
+}
+
+void previewDelimited(const char* begin,
+                      const char* end,
+                      const DelimitedFormat& format,
+                      std::size_t maxRows,
+                      DelimitedPreview* pPreview)
+{
+   Sample sample(begin, end);
+
+   // check the encoding of whole lines (a truncated sample may end within
+   // a character)
+   const char* lastLine = sample.end;
+   if (sample.truncated)
+   {
+      while (lastLine > sample.begin && *(lastLine - 1) != '\n')
+         --lastLine;
+   }
+   if (!string_utils::isAscii(sample.begin, lastLine) &&
+       string_utils::isValidUtf8(sample.begin, lastLine))
+   {
+      pPreview->encoding = "UTF-8";
+   }
+   else
+   {
+      pPreview->encoding = "unknown";
+   }
+
+   pPreview->lines = readLines(sample, maxRows);
+
+   std::size_t firstRow = format.header ? 1 : 0;
+   std::vector<std::vector<std::string> > records =
+                           readRecords(sample, format, maxRows + firstRow);
+
+   std::size_t columns = 0;
+   for (std::size_t i = 0; i < records.size(); i++)
+      columns = std::max(columns, records[i].size());
+
+   // names
+   pPreview->names.clear();
+   for (std::size_t i = 0; i < columns; i++)
+   {
+      if (format.header && !records.empty() && i < records[0].size())
+         pPreview->names.push_back(makeName(records[0][i]));
+      else
+         pPreview->names.push_back("V" + boost::lexical_cast<std::string>(i + 1));
+   }
+   makeUnique(&pPreview->names);
+
+   // types
+   pPreview->types.clear();
+   for (std::size_t i = 0; i < columns; i++)
+   {
+      pPreview->types.push_back(
+               inferColumnType(records, firstRow, i, format.decimal));
+   }
+
+   // values (short records are filled with NA)
+   pPreview->rows.clear();
+   for (std::size_t i = firstRow; i < records.size(); i++)
+   {
+      std::vector<DelimitedValue> row;
+      for (std::size_t j = 0; j < columns; j++)
+      {
+         if (j < records[i].size())
+         {
+            row.push_back(normalizeValue(records[i][j],
+                                         pPreview->types[j],
+                                         format.decimal));
+         }
+         else
+         {
+            row.push_back(DelimitedValue());
+         }
+      }
+      pPreview->rows.push_back(row);
+   }
+}
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,150 @@
+/*
+ * DelimitedPreviewTests.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <string>
+
+#include <core/text/DelimitedPreview.hpp>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+namespace {
+
+DelimitedFormat sniff(const std::string& text)
+{
+   return sniffDelimitedFormat(text.data(), text.data() + text.size());
+}
+
+void preview(const std::string& text,
+             const DelimitedFormat& format,
+             DelimitedPreview* pPreview)
+{
+   previewDelimited(text.data(), text.data() + text.size(), format, 20,
+                    pPreview);
+}
+
+} // anonymous namespace
+
+context("DelimitedPreview")
+{
+   test_that("Formats are sniffed")
+   {
+      DelimitedFormat format = sniff("name,score\n\"Smith, J\",1.5\n");
+      expect_true(format.separator == ',');
+      expect_true(format.header);
+      expect_true(format.decimal == '.');
+      expect_true(format.quote == '"');
+      expect_true(format.comment == '\0');
+
+      format = sniff("# scores\nname;score\nab;1,5\ncd;2,25\n");
+      expect_true(format.separator == ';');
+      expect_true(format.decimal == ',');
+      expect_true(format.comment == '#');
+      expect_true(format.header);
+
+      format = sniff("1 2 3\n4 5 6\n");
+      expect_true(format.separator == '\0');
+      expect_false(format.header);
+
+      format = sniff("a\tb,c\n1\t2,3\n");
+      expect_true(format.separator == '\t');
+   }
+
+   test_that("Column types are inferred")
+   {
+      DelimitedFormat format = sniff("a,b,c,d,e\n1,1.5,T,x,NA\n2,,FALSE,,\n");
+      DelimitedPreview result;
+      preview("a,b,c,d,e\n1,1.5,T,x,NA\n2,,FALSE,,\n", format, &result);
+
+      expect_true(result.names.size() == 5);
+      expect_true(result.types[0] == DelimitedColumnInteger);
+      expect_true(result.types[1] == DelimitedColumnNumeric);
+      expect_true(result.types[2] == DelimitedColumnLogical);
+      expect_true(result.types[3] == DelimitedColumnCharacter);
+      expect_true(result.types[4] == DelimitedColumnLogical);
+
+      expect_true(result.rows.size() == 2);
+      expect_true(result.rows[0][2].text == "TRUE");
+      expect_true(result.rows[1][1].isNA);
+      expect_false(result.rows[1][3].isNA);
+      expect_true(result.rows[1][3].text.empty());
+   }
+
+   test_that("Names are made syntactic and unique")
+   {
+      DelimitedFormat format;
+      format.separator = ',';
+      format.header = true;
+      DelimitedPreview result;
+      preview("first name,1st,x,x,if\n", format, &result);
+
+      expect_true(result.names.size() == 5);
+      expect_true(result.names[0] == "first.name");
+      expect_true(result.names[1] == "X1st");
+      expect_true(result.names[2] == "x");
+      expect_true(result.names[3] == "x.1");
+      expect_true(result.names[4] == "if.");
+   }
+
+   test_that("Quoted fields may span lines")
+   {
+      DelimitedFormat format;
+      format.separator = ',';
+      DelimitedPreview result;
+      preview("\"a\nb\",\"say \"\"hi\"\"\"\r\nc,d\r\n", format, &result);
+
+      expect_true(result.rows.size() == 2);
+      expect_true(result.rows[0][0].text == "a\nb");
+      expect_true(result.rows[0][1].text == "say \"hi\"");
+      expect_true(result.rows[1][1].text == "d");
+      expect_true(result.lines.size() == 3);
+      expect_true(result.lines[1] == "b\",\"say \"\"hi\"\"\"");
+   }
+
+   test_that("Comma decimals are normalized")
+   {
+      DelimitedFormat format;
+      format.separator = ';';
+      format.decimal = ',';
+      DelimitedPreview result;
+      preview("1,5;2\n", format, &result);
+
+      expect_true(result.types[0] == DelimitedColumnNumeric);
+      expect_true(result.rows[0][0].text == "1.5");
+      expect_true(result.types[1] == DelimitedColumnInteger);
+   }
+
+   test_that("Large files are previewed from their beginning")
+   {
+      std::string text("x,y\n");
+      while (text.size() < 2 * kDelimitedPreviewMaxBytes)
+         text += "1,abcdefghijklmnopqrstuvwxyz\n";
+
+      DelimitedFormat format = sniff(text);
+      expect_true(format.header);
+
+      DelimitedPreview result;
+      preview(text, format, &result);
+      expect_true(result.rows.size() == 20);
+      expect_true(result.encoding == "unknown");
+   }
+}
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
@@ -41,6 +41,7 @@
 #include "DesktopUtils.hpp"
 #include "DesktopSessionLauncher.hpp"
 #include "DesktopProgressActivator.hpp"
+#include "DesktopNetworkIOService.hpp"
 
 QProcess* pRSessionProcess;
 QString sharedSecret;
@@ -352,6 +353,8 @@ int main(int argc, char* argv[])
 
          int result = pApp->exec();
 
+         desktop::stopIOServiceThread();
+
          sessionLauncher.cleanupAtExit();
 
          options.cleanUpScratchTempDir();
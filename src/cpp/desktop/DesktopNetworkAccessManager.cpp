@@ -17,8 +17,6 @@
 
 #include <core/FilePath.hpp>
 
-#include <QTimer>
-
 #include "DesktopNetworkReply.hpp"
 #include "DesktopNetworkIOService.hpp"
 #include "DesktopOptions.hpp"
@@ -31,9 +29,7 @@ NetworkAccessManager::NetworkAccessManager(QString secret, QObject *parent) :
 {
    setProxy(QNetworkProxy::NoProxy);
 
-   QTimer* pTimer = new QTimer(this);
-   connect(pTimer, SIGNAL(timeout()), SLOT(pollForIO()));
-   pTimer->start(25);
+   startIOServiceThread();
 }
 
 QNetworkReply* NetworkAccessManager::createRequest(
@@ -60,8 +56,3 @@ QNetworkReply* NetworkAccessManager::createRequest(
    }
 }
 
-
-void NetworkAccessManager::pollForIO()
-{
-   ioServicePoll();
-}
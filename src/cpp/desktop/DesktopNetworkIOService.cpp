@@ -13,28 +13,121 @@
 
 #include "DesktopNetworkIOService.hpp"
 
+#include <QCoreApplication>
+#include <QEvent>
+
 #include <core/Log.hpp>
 #include <core/Error.hpp>
+#include <core/Thread.hpp>
 
 using namespace rstudio::core;
 
 namespace rstudio {
 namespace desktop {
 
+namespace {
+
+class FunctionEvent : public QEvent
+{
+public:
+   explicit FunctionEvent(const boost::function<void()>& function)
+      : QEvent(eventType()), function_(function)
+   {
+   }
+
+   static QEvent::Type eventType()
+   {
+      static int type = QEvent::registerEventType();
+      return static_cast<QEvent::Type>(type);
+   }
+
+   void invoke() { function_(); }
+
+private:
+   boost::function<void()> function_;
+};
+
+// lives on the ui thread (and for the life of the process) so that
+// functions can be posted to it from the io service thread
+class UiThreadDispatcher : public QObject
+{
+protected:
+   void customEvent(QEvent* pEvent)
+   {
+      if (pEvent->type() == FunctionEvent::eventType())
+      {
+         try
+         {
+            static_cast<FunctionEvent*>(pEvent)->invoke();
+         }
+         CATCH_UNEXPECTED_EXCEPTION
+      }
+   }
+};
+
+UiThreadDispatcher* s_pDispatcher = NULL;
+
+boost::thread s_ioServiceThread;
+volatile bool s_stopping = false;
+
+void ioServiceThreadMain()
+{
+   // keep running when there are no requests outstanding
+   boost::asio::io_service::work work(ioService());
+
+   while (!s_stopping)
+   {
+      try
+      {
+         boost::system::error_code ec;
+         ioService().run(ec);
+         if (ec)
+            LOG_ERROR(Error(ec, ERROR_LOCATION));
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+
+      // run only returns when stopped or when a handler throws (after
+      // which it must be reset before it can run again)
+      if (!s_stopping)
+         ioService().reset();
+   }
+}
+
+} // anonymous namespace
+
 boost::asio::io_service& ioService()
 {
-   static boost::asio::io_service instance;
-   return instance;
+   // never destroyed (the io service thread runs for the life of
+   // the process)
+   static boost::asio::io_service* pInstance = new boost::asio::io_service();
+   return *pInstance;
+}
+
+void startIOServiceThread()
+{
+   if (s_pDispatcher != NULL)
+      return;
+
+   s_pDispatcher = new UiThreadDispatcher();
+   core::thread::safeLaunchThread(ioServiceThreadMain, &s_ioServiceThread);
 }
 
-void ioServicePoll()
+void stopIOServiceThread()
 {
-   boost::system::error_code ec;
-   ioService().poll(ec);
-   if (ec)
-      LOG_ERROR(Error(ec, ERROR_LOCATION));
+   if (s_pDispatcher == NULL)
+      return;
+
+   s_stopping = true;
+   ioService().stop();
 
-   ioService().reset();
+   // don't hold up exit for a handler that's stuck
+   if (!s_ioServiceThread.timed_join(boost::posix_time::seconds(1)))
+      LOG_WARNING_MESSAGE("Timed out waiting for network io thread to exit");
+}
+
+void invokeOnUiThread(const boost::function<void()>& function)
+{
+   QCoreApplication::postEvent(s_pDispatcher, new FunctionEvent(function));
 }
 
 
@@ -14,6 +14,7 @@
 #ifndef DESKTOP_NETWORK_IO_SERVICE_HPP
 #define DESKTOP_NETWORK_IO_SERVICE_HPP
 
+#include <boost/function.hpp>
 #include <boost/asio/io_service.hpp>
 
 namespace rstudio {
@@ -21,7 +22,19 @@ namespace desktop {
 
 boost::asio::io_service& ioService();
 
-void ioServicePoll();
+// run the io service on its own thread so that responses from the session
+// are handled as they arrive (rather than polling for them from the ui
+// thread). must be called from the ui thread
+void startIOServiceThread();
+
+// stop the io service thread (at exit, so that handlers don't run while
+// the application is being torn down)
+void stopIOServiceThread();
+
+// invoke a function on the ui thread (e.g. from an io service handler).
+// the function is invoked from the ui thread's event loop, so any object
+// it refers to may have been deleted in the meantime
+void invokeOnUiThread(const boost::function<void()>& function);
 
 } // namespace desktop
 } // namespace rstudio
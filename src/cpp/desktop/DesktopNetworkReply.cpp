@@ -29,6 +29,7 @@
 #include <core/http/LocalStreamAsyncClient.hpp>
 #endif
 
+#include <QPointer>
 #include <QTimer>
 #include <QUrl>
 
@@ -39,6 +40,26 @@ using namespace rstudio::core;
 namespace rstudio {
 namespace desktop {
 
+// the parts of a response used by the reply, extracted on the io service
+// thread (so that large bodies are copied off the ui thread)
+struct NetworkReply::ResponseData
+{
+   explicit ResponseData(const http::Response& response)
+      : statusCode(response.statusCode()),
+        statusMessage(response.statusMessage()),
+        location(response.headerValue("Location")),
+        headers(response.headers()),
+        body(response.body().data(), response.body().length())
+   {
+   }
+
+   int statusCode;
+   std::string statusMessage;
+   std::string location;
+   std::vector<http::Header> headers;
+   QByteArray body;
+};
+
 struct NetworkReply::Impl
 {
    Impl(const std::string& localPeer)
@@ -56,13 +77,20 @@ struct NetworkReply::Impl
    {
    }
  #ifdef _WIN32
-    boost::shared_ptr<http::NamedPipeAsyncClient> pClient;
+   typedef http::NamedPipeAsyncClient Client;
+   typedef boost::asio::windows::stream_handle Socket;
  #else
-    boost::shared_ptr<http::LocalStreamAsyncClient> pClient;
+   typedef http::LocalStreamAsyncClient Client;
+   typedef boost::asio::local::stream_protocol::socket Socket;
  #endif
+   boost::shared_ptr<Client> pClient;
    QByteArray replyData;
    qint64 replyReadOffset;
 
+   // guards the reply against handlers which complete after its deletion
+   // (it's only dereferenced on the ui thread)
+   boost::shared_ptr<QPointer<NetworkReply> > pSelf;
+
 private:
    static http::ConnectionRetryProfile retryProfile()
    {
@@ -152,29 +180,80 @@ NetworkReply::NetworkReply(const std::string& localPeer,
    }
 
    // execute
+   pImpl_->pSelf.reset(new QPointer<NetworkReply>(this));
    executeRequest(request);
 }
 
+namespace {
+
+template <typename Client>
+void closeClient(boost::shared_ptr<Client> pClient)
+{
+   try
+   {
+      pClient->disableHandlers();
+      pClient->close();
+   }
+   catch(...)
+   {
+   }
+}
+
+} // anonymous namespace
+
 void NetworkReply::executeRequest(const http::Request& request)
 {
    // set the request
    pImpl_->pClient->request().assign(request);
 
-   // execute and bind to response handlers
-   pImpl_->pClient->execute(boost::bind(&NetworkReply::onResponse, this, _1),
-                            boost::bind(&NetworkReply::onError, this, _1));
+   // execute on the io service thread (which owns the client from here on)
+   // and bind to response handlers
+   ioService().post(boost::bind(
+      &http::AsyncClient<Impl::Socket>::execute,
+      pImpl_->pClient,
+      http::ResponseHandler(boost::bind(&NetworkReply::handleResponse,
+                                        pImpl_->pSelf, _1)),
+      http::ErrorHandler(boost::bind(&NetworkReply::handleError,
+                                     pImpl_->pSelf, _1))));
+}
+
+void NetworkReply::handleResponse(
+                     boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                     const http::Response& response)
+{
+   boost::shared_ptr<ResponseData> pData(new ResponseData(response));
+   invokeOnUiThread(boost::bind(&NetworkReply::deliverResponse,
+                                pSelf, pData));
+}
+
+void NetworkReply::handleError(
+                     boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                     const Error& error)
+{
+   invokeOnUiThread(boost::bind(&NetworkReply::deliverError, pSelf, error));
+}
+
+void NetworkReply::deliverResponse(
+                     boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                     boost::shared_ptr<ResponseData> pData)
+{
+   if (*pSelf)
+      (*pSelf)->onResponse(*pData);
+}
+
+void NetworkReply::deliverError(
+                     boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                     const Error& error)
+{
+   if (*pSelf)
+      (*pSelf)->onError(error);
 }
 
 NetworkReply::~NetworkReply()
 {
-   try
-   {
-      pImpl_->pClient->disableHandlers();
-      pImpl_->pClient->close();
-   }
-   catch(...)
-   {
-   }
+   // the client may only be used from the io service thread
+   ioService().post(boost::bind(closeClient<Impl::Client>,
+                                pImpl_->pClient));
 }
 
 
@@ -228,45 +307,46 @@ qint64 NetworkReply::readData(char *data, qint64 maxSize)
 }
 
 
-void NetworkReply::onResponse(const http::Response& response)
+void NetworkReply::onResponse(const ResponseData& response)
 {
    // call open on the QIODevice
    open(ReadOnly | Unbuffered);
 
    // set http status and reason codes
    setAttribute(QNetworkRequest::HttpStatusCodeAttribute,
-                response.statusCode());
+                response.statusCode);
    setAttribute(QNetworkRequest::HttpReasonPhraseAttribute,
-                QString::fromStdString(response.statusMessage()));
+                QString::fromStdString(response.statusMessage));
 
    // check for a redirect
-   if (response.statusCode() == http::status::MovedTemporarily ||
-       response.statusCode() == http::status::MovedPermanently)
+   if (response.statusCode == http::status::MovedTemporarily ||
+       response.statusCode == http::status::MovedPermanently)
    {
-      std::string location = response.headerValue("Location");
-      if (!location.empty())
+      if (!response.location.empty())
       {
          QUrl redirectUrl = request().url().resolved(
-                                       QString::fromStdString(location));
+                                 QString::fromStdString(response.location));
          setAttribute(QNetworkRequest::RedirectionTargetAttribute,
                       redirectUrl);
       }
    }
 
    // set headers
-   BOOST_FOREACH(const http::Header& header, response.headers())
+   BOOST_FOREACH(const http::Header& header, response.headers)
    {
       QByteArray name = QByteArray(header.name.c_str());
       QByteArray value = QByteArray(header.value.c_str());
       setRawHeader(name, value);
    }
 
-   // set body / content-length
-   const std::string& body = response.body();
-   if (!body.empty())
+   // set body / content-length (the body was copied when the response
+   // was received, and QByteArray is implicitly shared so this doesn't
+   // copy it again)
+   if (!response.body.isEmpty())
    {
-      setHeader(QNetworkRequest::ContentLengthHeader, (uint)body.length());
-      pImpl_->replyData.append(body.data(), body.length());
+      setHeader(QNetworkRequest::ContentLengthHeader,
+                (uint)response.body.size());
+      pImpl_->replyData = response.body;
       pImpl_->replyReadOffset = 0;
    }
 
@@ -15,10 +15,12 @@
 #define DESKTOPNETWORKREPLY_HPP
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <core/FilePath.hpp>
 
 #include <QNetworkReply>
+#include <QPointer>
 
 namespace rstudio {
 namespace core {
@@ -60,7 +62,21 @@ protected:
    qint64 readData(char *data, qint64 maxSize);
 
 private:
-   void onResponse(const core::http::Response& response);
+   struct ResponseData;
+
+   // response handlers, called on the io service thread, which forward to
+   // the reply on the ui thread (if it still exists by then)
+   static void handleResponse(boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                              const core::http::Response& response);
+   static void handleError(boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                           const core::Error& error);
+   static void deliverResponse(
+                     boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                     boost::shared_ptr<ResponseData> pData);
+   static void deliverError(boost::shared_ptr<QPointer<NetworkReply> > pSelf,
+                            const core::Error& error);
+
+   void onResponse(const ResponseData& response);
    void onError(const core::Error& error);
 
    void executeRequest(const core::http::Request& request);
@@ -63,16 +63,23 @@ bool prepareEnvironment(Options& options)
    if (!rLdScriptPath.exists())
       rLdScriptPath = supportingFilePath.complete("session/r-ldpath");
 
-   // attempt to detect R environment
+   // attempt to detect R environment (cached across launches since this
+   // means running R). note that the cache isn't refreshed in the
+   // background as detection clears R_HOME in our environment, which the
+   // session we're about to launch inherits
+   FilePath cachePath = core::system::userSettingsPath(
+         core::system::userHomePath("R_USER|HOME"),
+         "RStudio-Desktop").childPath("r-environment.json");
    std::string rScriptPath, rVersion, errMsg;
    r_util::EnvironmentVars rEnvVars;
-   bool success = r_util::detectREnvironment(rWhichRPath,
-                                             rLdScriptPath,
-                                             std::string(),
-                                             &rScriptPath,
-                                             &rVersion,
-                                             &rEnvVars,
-                                             &errMsg);
+   bool success = r_util::detectREnvironmentCached(cachePath,
+                                                   rWhichRPath,
+                                                   rLdScriptPath,
+                                                   std::string(),
+                                                   &rScriptPath,
+                                                   &rVersion,
+                                                   &rEnvVars,
+                                                   &errMsg);
    if (!success)
    {
       showRNotFoundError(errMsg);
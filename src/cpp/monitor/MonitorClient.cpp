@@ -13,8 +13,14 @@
  *
  */
 
+#include <boost/bind.hpp>
 #include <boost/asio/io_service.hpp>
 
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+#include <core/Thread.hpp>
+#include <core/SafeConvert.hpp>
+
 #include <monitor/MonitorClient.hpp>
 
 #include "MonitorClientImpl.hpp"
@@ -52,8 +58,199 @@ private:
 // and never free it so that there are no order of destruction surprises)
 Client* s_pClient = NULL;
 
+void metricsFlushThreadMain(Client* pClient,
+                            boost::posix_time::time_duration interval)
+{
+   try
+   {
+      while (true)
+      {
+         boost::this_thread::sleep(interval);
+         pClient->flushMetrics();
+      }
+   }
+   catch(const boost::thread_interrupted&)
+   {
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+void consoleActionFlushThreadMain(Client* pClient,
+                                  audit::ConsoleActionWriter* pWriter)
+{
+   try
+   {
+      while (true)
+      {
+         pWriter->waitForBatch();
+         pClient->flushConsoleActions();
+      }
+   }
+   catch(const boost::thread_interrupted&)
+   {
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
 } // anonymous namespace
 
+void Client::recordMetric(const metrics::Metric& metric)
+{
+   aggregator_.add(metric);
+}
+
+void Client::recordMetric(const metrics::MultiMetric& metric)
+{
+   aggregator_.add(metric);
+}
+
+void Client::recordMetric(const metrics::HistogramMetric& metric)
+{
+   aggregator_.add(metric);
+}
+
+void Client::recordHistogramSample(const std::string& scope,
+                                   int intervalSeconds,
+                                   const std::string& name,
+                                   boost::uint64_t value,
+                                   const std::string& unit)
+{
+   aggregator_.addHistogramSample(scope, intervalSeconds, name, value, unit);
+}
+
+void Client::flushMetrics()
+{
+   std::size_t dropped = aggregator_.collectDroppedSamples();
+   if (dropped > 0)
+   {
+      LOG_WARNING_MESSAGE("Dropped " + core::safe_convert::numberToString(dropped) +
+                          " metric samples (too many metric series)");
+   }
+
+   std::vector<metrics::MultiMetric> metrics;
+   aggregator_.flush(&metrics);
+   if (!metrics.empty())
+      sendMultiMetrics(metrics);
+
+   std::vector<metrics::HistogramMetric> histograms;
+   aggregator_.flushHistograms(&histograms);
+   if (!histograms.empty())
+      sendHistogramMetrics(histograms);
+
+   if (metricsFlushHandler_ && (!metrics.empty() || !histograms.empty()))
+      metricsFlushHandler_(metrics, histograms);
+}
+
+// sync clients flush from a background thread so that callers never
+// block on the monitor socket
+void SyncClient::startMetricsFlush(
+                     const boost::posix_time::time_duration& interval)
+{
+   core::thread::safeLaunchThread(boost::bind(metricsFlushThreadMain,
+                                              this,
+                                              interval));
+}
+
+void AsyncClient::startMetricsFlush(
+                     const boost::posix_time::time_duration& interval)
+{
+   flushInterval_ = interval;
+   pFlushTimer_.reset(new boost::asio::deadline_timer(ioService()));
+   scheduleMetricsFlush();
+}
+
+void AsyncClient::scheduleMetricsFlush()
+{
+   pFlushTimer_->expires_from_now(flushInterval_);
+   pFlushTimer_->async_wait(boost::bind(&AsyncClient::onMetricsFlushTimer,
+                                        this,
+                                        _1));
+}
+
+void AsyncClient::onMetricsFlushTimer(const boost::system::error_code& ec)
+{
+   if (ec)
+   {
+      if (ec != boost::asio::error::operation_aborted)
+         LOG_ERROR(core::Error(ec, ERROR_LOCATION));
+      return;
+   }
+
+   try
+   {
+      flushMetrics();
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   scheduleMetricsFlush();
+}
+
+void Client::recordConsoleAction(const audit::ConsoleAction& action)
+{
+   if (pConsoleActionWriter_)
+      pConsoleActionWriter_->add(action);
+   else
+      logConsoleAction(action);
+}
+
+void Client::flushConsoleActions()
+{
+   if (pConsoleActionWriter_)
+      pConsoleActionWriter_->flush();
+}
+
+void SyncClient::startConsoleActionFlush(
+                  const audit::ConsoleActionWriterOptions& options)
+{
+   BOOST_ASSERT(!pConsoleActionWriter_);
+   pConsoleActionWriter_.reset(new audit::ConsoleActionWriter(
+            options,
+            boost::bind(&SyncClient::sendConsoleActions, this, _1)));
+   core::thread::safeLaunchThread(boost::bind(consoleActionFlushThreadMain,
+                                              this,
+                                              pConsoleActionWriter_.get()));
+}
+
+// async clients flush on a timer (the size thresholds only apply to sync
+// clients, whose flush thread waits on the batch)
+void AsyncClient::startConsoleActionFlush(
+                  const audit::ConsoleActionWriterOptions& options)
+{
+   BOOST_ASSERT(!pConsoleActionWriter_);
+   pConsoleActionWriter_.reset(new audit::ConsoleActionWriter(
+            options,
+            boost::bind(&AsyncClient::sendConsoleActions, this, _1)));
+   pConsoleActionTimer_.reset(new boost::asio::deadline_timer(ioService()));
+   scheduleConsoleActionFlush();
+}
+
+void AsyncClient::scheduleConsoleActionFlush()
+{
+   pConsoleActionTimer_->expires_from_now(
+                  pConsoleActionWriter_->options().flushInterval);
+   pConsoleActionTimer_->async_wait(
+            boost::bind(&AsyncClient::onConsoleActionFlushTimer, this, _1));
+}
+
+void AsyncClient::onConsoleActionFlushTimer(
+                                    const boost::system::error_code& ec)
+{
+   if (ec)
+   {
+      if (ec != boost::asio::error::operation_aborted)
+         LOG_ERROR(core::Error(ec, ERROR_LOCATION));
+      return;
+   }
+
+   try
+   {
+      flushConsoleActions();
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   scheduleConsoleActionFlush();
+}
+
 boost::shared_ptr<core::LogWriter> Client::createLogWriter(
                                     const std::string& programIdentity)
 {
@@ -16,6 +16,9 @@
 #ifndef MONITOR_MONITOR_CLIENT_IMPL_HPP
 #define MONITOR_MONITOR_CLIENT_IMPL_HPP
 
+#include <boost/shared_ptr.hpp>
+#include <boost/asio/deadline_timer.hpp>
+
 #include <monitor/MonitorClient.hpp>
 
 namespace rstudio {
@@ -38,9 +41,19 @@ public:
 
    void sendMultiMetrics(const std::vector<metrics::MultiMetric>& metrics);
 
+   void sendHistogramMetrics(
+                  const std::vector<metrics::HistogramMetric>& metrics);
+
    void logEvent(const Event& event);
 
    void logConsoleAction(const audit::ConsoleAction& action);
+
+   void sendConsoleActions(const std::vector<audit::ConsoleAction>& actions);
+
+   void startMetricsFlush(const boost::posix_time::time_duration& interval);
+
+   void startConsoleActionFlush(
+                  const audit::ConsoleActionWriterOptions& options);
 };
 
 class AsyncClient : public Client
@@ -62,15 +75,34 @@ public:
 
    void sendMultiMetrics(const std::vector<metrics::MultiMetric>& metrics);
 
+   void sendHistogramMetrics(
+                  const std::vector<metrics::HistogramMetric>& metrics);
+
    void logEvent(const Event& event);
 
    void logConsoleAction(const audit::ConsoleAction& action);
 
+   void sendConsoleActions(const std::vector<audit::ConsoleAction>& actions);
+
+   void startMetricsFlush(const boost::posix_time::time_duration& interval);
+
+   void startConsoleActionFlush(
+                  const audit::ConsoleActionWriterOptions& options);
+
 protected:
    boost::asio::io_service& ioService() { return ioService_; }
 
+private:
+   void scheduleMetricsFlush();
+   void onMetricsFlushTimer(const boost::system::error_code& ec);
+   void scheduleConsoleActionFlush();
+   void onConsoleActionFlushTimer(const boost::system::error_code& ec);
+
 private:
    boost::asio::io_service& ioService_;
+   boost::posix_time::time_duration flushInterval_;
+   boost::shared_ptr<boost::asio::deadline_timer> pFlushTimer_;
+   boost::shared_ptr<boost::asio::deadline_timer> pConsoleActionTimer_;
 };
 
 } // namespace monitor
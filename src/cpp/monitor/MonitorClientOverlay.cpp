@@ -34,6 +34,11 @@ void SyncClient::sendMultiMetrics(
 {
 }
 
+void SyncClient::sendHistogramMetrics(
+                  const std::vector<metrics::HistogramMetric>& metrics)
+{
+}
+
 void AsyncClient::logMessage(const std::string& programIdentity,
                              core::system::LogLevel level,
                              const std::string& message)
@@ -49,6 +54,11 @@ void AsyncClient::sendMultiMetrics(
 {
 }
 
+void AsyncClient::sendHistogramMetrics(
+                  const std::vector<metrics::HistogramMetric>& metrics)
+{
+}
+
 void SyncClient::logEvent(const Event& event)
 {
 }
@@ -65,6 +75,16 @@ void AsyncClient::logConsoleAction(const audit::ConsoleAction& action)
 {
 }
 
+void SyncClient::sendConsoleActions(
+                  const std::vector<audit::ConsoleAction>& actions)
+{
+}
+
+void AsyncClient::sendConsoleActions(
+                  const std::vector<audit::ConsoleAction>& actions)
+{
+}
+
 } // namespace monitor
 } // namespace rstudio
 
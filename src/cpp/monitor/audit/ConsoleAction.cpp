@@ -15,6 +15,14 @@
 
 #include <monitor/audit/ConsoleAction.hpp>
 
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <core/Base64.hpp>
+#include <core/Log.hpp>
 #include <core/SafeConvert.hpp>
 
 #include <core/json/JsonRpc.hpp>
@@ -25,6 +33,71 @@ namespace rstudio {
 namespace monitor {
 namespace audit {
 
+namespace {
+
+const char * const kGzipEncoding = "gzip";
+
+bool gzip(const std::string& data, std::string* pCompressed)
+{
+   try
+   {
+      boost::iostreams::filtering_ostream out;
+      out.push(boost::iostreams::gzip_compressor());
+      out.push(boost::iostreams::back_inserter(*pCompressed));
+      out.write(data.data(), data.size());
+      boost::iostreams::close(out);
+      return true;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   return false;
+}
+
+bool gunzip(const std::string& compressed, std::string* pData)
+{
+   try
+   {
+      boost::iostreams::filtering_istream in;
+      in.push(boost::iostreams::gzip_decompressor());
+      in.push(boost::iostreams::array_source(compressed.data(),
+                                             compressed.size()));
+      boost::iostreams::copy(in, boost::iostreams::back_inserter(*pData));
+      return true;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   return false;
+}
+
+json::Object actionToJson(const ConsoleAction& action, bool compress)
+{
+   json::Object actionJson;
+   actionJson["session_id"] = action.sessionId;
+   actionJson["project"] = action.project;
+   actionJson["pid"] = action.pid;
+   actionJson["username"] = action.username;
+   actionJson["timestamp"] = action.timestamp;
+   actionJson["type"] = action.type;
+
+   // large output (e.g. printing a data frame) compresses well
+   std::string compressed, encoded;
+   if (compress &&
+       action.data.size() > kConsoleActionCompressBytes &&
+       gzip(action.data, &compressed) &&
+       !base64::encode(compressed, &encoded))
+   {
+      actionJson["data"] = encoded;
+      actionJson["encoding"] = kGzipEncoding;
+   }
+   else
+   {
+      actionJson["data"] = action.data;
+   }
+   return actionJson;
+}
+
+} // anonymous namespace
+
 std::string consoleActionTypeToString(int type)
 {
     switch(type)
@@ -44,20 +117,12 @@ std::string consoleActionTypeToString(int type)
 
 json::Object consoleActionToJson(const ConsoleAction& action)
 {
-   json::Object actionJson;
-   actionJson["session_id"] = action.sessionId;
-   actionJson["project"] = action.project;
-   actionJson["pid"] = action.pid;
-   actionJson["username"] = action.username;
-   actionJson["timestamp"] = action.timestamp;
-   actionJson["type"] = action.type;
-   actionJson["data"] = action.data;
-   return actionJson;
+   return actionToJson(action, true);
 }
 
 json::Object consoleActionToJsonLogEntry(const ConsoleAction& action)
 {
-   json::Object actionJson = consoleActionToJson(action);
+   json::Object actionJson = actionToJson(action, false);
    actionJson["pid"] = static_cast<boost::int64_t>(action.pid);
    actionJson["timestamp"] = static_cast<boost::int64_t>(action.timestamp);
    actionJson["type"] = audit::consoleActionTypeToString(action.type);
@@ -76,14 +141,26 @@ ConsoleAction consoleActionFromJson(const json::Object& actionJson)
                                   "type", &action.type,
                                   "data", &action.data);
    if (error)
+   {
       LOG_ERROR(error);
+      return action;
+   }
+
+   json::Object::const_iterator it = actionJson.find("encoding");
+   if (it != actionJson.end() && it->second.type() == json::StringType &&
+       it->second.get_str() == kGzipEncoding)
+   {
+      std::string compressed, data;
+      error = base64::decode(action.data, &compressed);
+      if (error)
+         LOG_ERROR(error);
+      else if (gunzip(compressed, &data))
+         action.data.swap(data);
+   }
 
    return action;
 }
 
-
-
-
 } // namespace audit
 } // namespace monitor
 } // namespace rstudio
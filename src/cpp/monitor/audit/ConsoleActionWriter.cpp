@@ -0,0 +1,214 @@
+/*
+ * ConsoleActionWriter.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <monitor/audit/ConsoleActionWriter.hpp>
+
+#include <algorithm>
+#include <ostream>
+
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+#include <core/SafeConvert.hpp>
+
+#include <core/json/Json.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace monitor {
+namespace audit {
+
+namespace {
+
+bool isOutput(int type)
+{
+   return type == kConsoleActionOutput || type == kConsoleActionOutputError;
+}
+
+} // anonymous namespace
+
+ConsoleActionWriter::ConsoleActionWriter(
+                              const ConsoleActionWriterOptions& options,
+                              const SendFunction& sendFunction)
+   : options_(options),
+     sendFunction_(sendFunction),
+     pendingBytes_(0),
+     droppedActions_(0)
+{
+}
+
+void ConsoleActionWriter::add(const ConsoleAction& action)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      if (pendingBytes_ + action.data.size() > options_.maxPendingBytes)
+      {
+         droppedActions_++;
+         return;
+      }
+
+      // output is often written a line (or less) at a time: append it to
+      // the previous action when that was output of the same kind
+      if (!pending_.empty() &&
+          isOutput(action.type) &&
+          pending_.back().type == action.type &&
+          pending_.back().sessionId == action.sessionId &&
+          pending_.back().data.size() + action.data.size() <=
+                                                   options_.maxBatchBytes)
+      {
+         pending_.back().data.append(action.data);
+      }
+      else
+      {
+         pending_.push_back(action);
+      }
+      pendingBytes_ += action.data.size();
+
+      if (pending_.size() >= options_.maxBatchActions ||
+          pendingBytes_ >= options_.maxBatchBytes)
+      {
+         batchReady_.notify_one();
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+void ConsoleActionWriter::waitForBatch()
+{
+   boost::unique_lock<boost::mutex> lock(mutex_);
+   if (pending_.size() < options_.maxBatchActions &&
+       pendingBytes_ < options_.maxBatchBytes)
+   {
+      batchReady_.timed_wait(lock, options_.flushInterval);
+   }
+}
+
+void ConsoleActionWriter::flush()
+{
+   std::vector<ConsoleAction> actions;
+   std::size_t dropped = 0;
+   LOCK_MUTEX(mutex_)
+   {
+      actions.swap(pending_);
+      pendingBytes_ = 0;
+      dropped = droppedActions_;
+      droppedActions_ = 0;
+   }
+   END_LOCK_MUTEX
+
+   if (dropped > 0)
+   {
+      LOG_WARNING_MESSAGE("Dropped " + safe_convert::numberToString(dropped) +
+                          " console actions (audit backlog is full)");
+   }
+
+   if (actions.size() <= options_.maxBatchActions)
+   {
+      if (!actions.empty())
+         write(actions);
+      return;
+   }
+
+   // the flush fell behind: send the backlog in batches
+   for (std::size_t begin = 0; begin < actions.size();
+        begin += options_.maxBatchActions)
+   {
+      std::size_t end = std::min(begin + options_.maxBatchActions,
+                                 actions.size());
+      write(std::vector<ConsoleAction>(actions.begin() + begin,
+                                       actions.begin() + end));
+   }
+}
+
+void ConsoleActionWriter::write(const std::vector<ConsoleAction>& actions)
+{
+   using namespace boost::posix_time;
+
+   bool journal = !options_.journalPath.empty();
+   ptime now = microsec_clock::universal_time();
+   if (journal && !journalUntil_.is_not_a_date_time() && now < journalUntil_)
+   {
+      appendToJournal(actions);
+      return;
+   }
+
+   sendFunction_(actions);
+
+   time_duration elapsed = microsec_clock::universal_time() - now;
+   if (journal && elapsed > options_.slowSend)
+   {
+      LOG_WARNING_MESSAGE("Monitor is slow to accept console actions "
+                          "(journaling them to " +
+                          options_.journalPath.absolutePath() + ")");
+      journalUntil_ = now + elapsed + options_.slowSendBackoff;
+   }
+}
+
+void ConsoleActionWriter::appendToJournal(
+                              const std::vector<ConsoleAction>& actions)
+{
+   FilePath journalPath = options_.journalPath;
+
+   // rotate the journal when it gets too large (keeping one prior file)
+   if (journalPath.exists() &&
+       static_cast<std::size_t>(journalPath.size()) > options_.journalMaxBytes)
+   {
+      FilePath rotatedPath = journalPath.parent().childPath(
+               journalPath.stem() + ".rotated" + journalPath.extension());
+      rotatedPath.removeIfExists();
+      Error error = journalPath.move(rotatedPath);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   Error error = journalPath.parent().ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   std::string lines;
+   BOOST_FOREACH(const ConsoleAction& action, actions)
+   {
+      lines.append(json::write(consoleActionToJson(action)));
+      lines.push_back('\n');
+   }
+
+   boost::shared_ptr<std::ostream> pStream;
+   error = journalPath.open_w(&pStream, false);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   pStream->write(lines.data(), lines.size());
+   pStream->flush();
+   if (pStream->fail())
+   {
+      error = systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      error.addProperty("path", journalPath);
+      LOG_ERROR(error);
+   }
+}
+
+} // namespace audit
+} // namespace monitor
+} // namespace rstudio
@@ -18,12 +18,16 @@
 
 #include <string>
 
+#include <boost/scoped_ptr.hpp>
+
 #include <core/system/System.hpp>
 #include <core/LogWriter.hpp>
 
 #include <monitor/audit/ConsoleAction.hpp>
+#include <monitor/audit/ConsoleActionWriter.hpp>
 #include <monitor/events/Event.hpp>
 #include <monitor/metrics/Metric.hpp>
+#include <monitor/metrics/MetricAggregator.hpp>
 
 #include "MonitorConstants.hpp"
 
@@ -63,10 +67,60 @@ public:
    virtual void sendMultiMetrics(
                         const std::vector<metrics::MultiMetric>& metrics) = 0;
 
+   virtual void sendHistogramMetrics(
+                  const std::vector<metrics::HistogramMetric>& metrics) = 0;
+
+   // record metrics for batched delivery: samples are merged by the
+   // aggregator and sent in a single message per flush interval (requires
+   // a prior call to startMetricsFlush)
+   void recordMetric(const metrics::Metric& metric);
+   void recordMetric(const metrics::MultiMetric& metric);
+   void recordMetric(const metrics::HistogramMetric& metric);
+
+   // record a single value (e.g. a latency) into a histogram series
+   void recordHistogramSample(const std::string& scope,
+                              int intervalSeconds,
+                              const std::string& name,
+                              boost::uint64_t value,
+                              const std::string& unit = std::string());
+
+   // start periodically flushing recorded metrics
+   virtual void startMetricsFlush(
+                  const boost::posix_time::time_duration& interval) = 0;
+
+   // send all recorded metrics now
+   void flushMetrics();
+
+   // additionally deliver flushed metrics to a handler (e.g. so that they
+   // can be aggregated by the server). set before starting the flush
+   typedef boost::function<void(const std::vector<metrics::MultiMetric>&,
+                                const std::vector<metrics::HistogramMetric>&)>
+                                                         MetricsFlushHandler;
+   void setMetricsFlushHandler(const MetricsFlushHandler& handler)
+   {
+      metricsFlushHandler_ = handler;
+   }
+
    virtual void logEvent(const Event& event) = 0;
 
    virtual void logConsoleAction(const audit::ConsoleAction& action) = 0;
 
+   virtual void sendConsoleActions(
+                  const std::vector<audit::ConsoleAction>& actions) = 0;
+
+   // record a console action for batched delivery: this never waits on
+   // the monitor (batches are sent by sendConsoleActions from a background
+   // flush). without a prior call to startConsoleActionFlush the action
+   // is logged immediately
+   void recordConsoleAction(const audit::ConsoleAction& action);
+
+   // start flushing recorded console actions
+   virtual void startConsoleActionFlush(
+                  const audit::ConsoleActionWriterOptions& options) = 0;
+
+   // send all recorded console actions now
+   void flushConsoleActions();
+
 protected:
    const std::string& metricsSocket() const { return metricsSocket_; }
    const std::string& sharedSecret() const { return sharedSecret_; }
@@ -74,6 +128,11 @@ protected:
 private:
    std::string metricsSocket_;
    std::string sharedSecret_;
+   metrics::MetricAggregator aggregator_;
+   MetricsFlushHandler metricsFlushHandler_;
+
+protected:
+   boost::scoped_ptr<audit::ConsoleActionWriter> pConsoleActionWriter_;
 };
 
 void initializeMonitorClient(const std::string& metricsSocket,
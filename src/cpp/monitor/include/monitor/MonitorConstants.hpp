@@ -20,5 +20,9 @@
 #define kMonitorSharedSecretEnvVar "RS_MONITOR_SHARED_SECRET"
 #define kMonitorIntervalSeconds    "monitor-interval-seconds"
 
+// sessions report their metrics to the server (for its metrics endpoint)
+#define kMonitorReportMetrics      "monitor-report-metrics"
+#define kMonitorMetricsSocketPath  "/tmp/rstudio-rserver/rserver-metrics.socket"
+
 #endif // MONITOR_CONSTANTS_HPP
 
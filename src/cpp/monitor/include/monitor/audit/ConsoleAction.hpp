@@ -61,6 +61,10 @@ struct ConsoleAction
    std::string data;
 };
 
+// data larger than this is gzipped (and base64 encoded) in the json
+// representation, which is then marked with "encoding": "gzip"
+#define kConsoleActionCompressBytes (64 * 1024)
+
 std::string consoleActionTypeToString(int type);
 core::json::Object consoleActionToJson(const ConsoleAction& action);
 ConsoleAction consoleActionFromJson(const core::json::Object& actionJson);
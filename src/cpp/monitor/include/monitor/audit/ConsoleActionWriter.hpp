@@ -0,0 +1,119 @@
+/*
+ * ConsoleActionWriter.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef MONITOR_AUDIT_CONSOLE_ACTION_WRITER_HPP
+#define MONITOR_AUDIT_CONSOLE_ACTION_WRITER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/FilePath.hpp>
+
+#include <monitor/audit/ConsoleAction.hpp>
+
+namespace rstudio {
+namespace monitor {
+namespace audit {
+
+struct ConsoleActionWriterOptions
+{
+   ConsoleActionWriterOptions()
+      : flushInterval(boost::posix_time::seconds(1)),
+        maxBatchActions(256),
+        maxBatchBytes(256 * 1024),
+        maxPendingBytes(16 * 1024 * 1024),
+        slowSend(boost::posix_time::milliseconds(500)),
+        slowSendBackoff(boost::posix_time::seconds(30)),
+        journalMaxBytes(8 * 1024 * 1024)
+   {
+   }
+
+   // a batch is sent when it's this old, holds this many actions or holds
+   // this many bytes of data (whichever comes first)
+   boost::posix_time::time_duration flushInterval;
+   std::size_t maxBatchActions;
+   std::size_t maxBatchBytes;
+
+   // actions recorded while this much data is waiting to be sent are
+   // dropped (and counted) rather than buffered
+   std::size_t maxPendingBytes;
+
+   // a send taking longer than slowSend means the monitor is falling
+   // behind: batches are appended to the journal instead of being sent
+   // until slowSendBackoff has elapsed
+   boost::posix_time::time_duration slowSend;
+   boost::posix_time::time_duration slowSendBackoff;
+
+   // json lines journal (rotated when it exceeds journalMaxBytes); if
+   // empty batches are always sent
+   core::FilePath journalPath;
+   std::size_t journalMaxBytes;
+};
+
+// Buffers console actions so that recording one never waits on the
+// monitor: add only appends to an in-memory batch (coalescing runs of
+// output) and batches are sent (or journaled) by flush, which is called
+// from a background thread.
+class ConsoleActionWriter : boost::noncopyable
+{
+public:
+   typedef boost::function<void(const std::vector<ConsoleAction>&)>
+                                                            SendFunction;
+
+   ConsoleActionWriter(const ConsoleActionWriterOptions& options,
+                       const SendFunction& sendFunction);
+
+   // COPYING: boost::noncopyable
+
+   const ConsoleActionWriterOptions& options() const { return options_; }
+
+   // thread safe (and cheap): may be called from the R thread
+   void add(const ConsoleAction& action);
+
+   // wait until a batch is full or the flush interval has elapsed
+   void waitForBatch();
+
+   // send (or journal) everything recorded so far
+   void flush();
+
+private:
+   void write(const std::vector<ConsoleAction>& actions);
+   void appendToJournal(const std::vector<ConsoleAction>& actions);
+
+private:
+   ConsoleActionWriterOptions options_;
+   SendFunction sendFunction_;
+
+   boost::mutex mutex_;
+   boost::condition_variable batchReady_;
+   std::vector<ConsoleAction> pending_;
+   std::size_t pendingBytes_;
+   std::size_t droppedActions_;
+
+   // only used by flush
+   boost::posix_time::ptime journalUntil_;
+};
+
+} // namespace audit
+} // namespace monitor
+} // namespace rstudio
+
+#endif // MONITOR_AUDIT_CONSOLE_ACTION_WRITER_HPP
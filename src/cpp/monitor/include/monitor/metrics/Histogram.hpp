@@ -0,0 +1,89 @@
+/*
+ * Histogram.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef MONITOR_METRIC_HISTOGRAM_HPP
+#define MONITOR_METRIC_HISTOGRAM_HPP
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace monitor {
+namespace metrics {
+
+// Log-bucketed (HDR-style) histogram of non-negative integer values (e.g.
+// latencies in microseconds). Each power of two is divided into 16 linear
+// sub-buckets so recorded values are accurate to within ~6%. Recording is
+// a couple of shifts and an increment, and histograms with the same
+// layout can be merged exactly (e.g. across sessions).
+class Histogram
+{
+public:
+   Histogram() : count_(0), min_(0), max_(0), sum_(0) {}
+
+   // COPYING: via compiler (copyable members)
+
+   void record(boost::uint64_t value, boost::uint64_t count = 1);
+   void merge(const Histogram& other);
+   void clear();
+
+   bool empty() const { return count_ == 0; }
+   boost::uint64_t count() const { return count_; }
+   boost::uint64_t min() const { return min_; }
+   boost::uint64_t max() const { return max_; }
+   double sum() const { return sum_; }
+   double mean() const;
+
+   // value at the given percentile (0-100) -- this is the highest value
+   // equivalent to the bucket the percentile falls in (clamped to max)
+   boost::uint64_t valueAtPercentile(double percentile) const;
+
+   // number of values recorded at or below the given value (values in the
+   // same bucket as it are included, so this is accurate to within the
+   // bucket resolution)
+   boost::uint64_t countAtOrBelow(boost::uint64_t value) const;
+
+private:
+   friend core::json::Object histogramToJson(const Histogram& histogram);
+   friend core::Error histogramFromJson(const core::json::Object& json,
+                                        Histogram* pHistogram);
+
+   std::vector<boost::uint64_t> counts_;
+   boost::uint64_t count_;
+   boost::uint64_t min_;
+   boost::uint64_t max_;
+   double sum_;
+};
+
+// json serialization (buckets are written sparsely along with summary
+// fields including the common percentiles)
+core::json::Object histogramToJson(const Histogram& histogram);
+core::Error histogramFromJson(const core::json::Object& json,
+                              Histogram* pHistogram);
+
+} // namespace metrics
+} // namespace monitor
+} // namespace rstudio
+
+#endif // MONITOR_METRIC_HISTOGRAM_HPP
@@ -24,6 +24,8 @@
 
 #include <core/json/Json.hpp>
 
+#include <monitor/metrics/Histogram.hpp>
+
 namespace rstudio {
 namespace core {
    class Error;
@@ -144,9 +146,37 @@ private:
    std::vector<MetricData> data_;
 };
 
+class HistogramMetric : public MetricBase
+{
+public:
+   HistogramMetric() : MetricBase() {}
+
+   HistogramMetric(const std::string& scope,
+                   int intervalSeconds,
+                   const std::string& name,
+                   const Histogram& histogram,
+                   const std::string& unit = std::string(),
+                   boost::posix_time::ptime timestamp =
+                           boost::posix_time::microsec_clock::universal_time())
+      : MetricBase(scope, intervalSeconds, "histogram", unit, timestamp),
+        name_(name),
+        histogram_(histogram)
+   {
+   }
+
+public:
+   const std::string& name() const { return name_; }
+   const Histogram& histogram() const { return histogram_; }
+
+private:
+   std::string name_;
+   Histogram histogram_;
+};
+
 // metric handlers
 typedef boost::function<void(const Metric&)> MetricHandler;
 typedef boost::function<void(const MultiMetric&)> MultiMetricHandler;
+typedef boost::function<void(const HistogramMetric&)> HistogramMetricHandler;
 
 // json serialization
 core::json::Object metricToJson(const Metric& metric);
@@ -157,6 +187,10 @@ core::json::Object metricToJson(const MultiMetric& multiMetric);
 core::Error metricFromJson(const core::json::Object& multiMetricJson,
                            MultiMetric* pMultiMetric);
 
+core::json::Object metricToJson(const HistogramMetric& histogramMetric);
+core::Error metricFromJson(const core::json::Object& histogramMetricJson,
+                           HistogramMetric* pHistogramMetric);
+
 
 } // namespace metrics
 } // namespace monitor
@@ -0,0 +1,121 @@
+/*
+ * MetricAggregator.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef MONITOR_METRIC_METRIC_AGGREGATOR_HPP
+#define MONITOR_METRIC_METRIC_AGGREGATOR_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <core/BoostThread.hpp>
+
+#include <monitor/metrics/Metric.hpp>
+
+namespace rstudio {
+namespace monitor {
+namespace metrics {
+
+// metric types understood by the aggregator (anything else is
+// treated as a gauge)
+extern const char * const kCounterType;
+extern const char * const kGaugeType;
+extern const char * const kHistogramType;
+
+// Accumulates metric samples so they can be sent in a single message per
+// flush interval. Samples are merged per series (scope, interval, type,
+// unit and name): counters are summed, gauges keep their latest value and
+// histograms keep the count, sum, min and max of their samples (sent as
+// <name>.count, <name>.sum, etc.). Full histograms (HistogramMetric) are
+// merged bucket by bucket and flushed separately. The number of series is
+// bounded; samples for new series beyond the bound are dropped (and counted).
+class MetricAggregator : boost::noncopyable
+{
+public:
+   explicit MetricAggregator(std::size_t maxSeries = 4096)
+      : maxSeries_(maxSeries), droppedSamples_(0)
+   {
+   }
+
+   // COPYING: boost::noncopyable
+
+   void add(const Metric& metric);
+   void add(const MultiMetric& metric);
+   void add(const HistogramMetric& metric);
+
+   // record a single value into a histogram series (cheaper than
+   // constructing a HistogramMetric for each sample)
+   void addHistogramSample(const std::string& scope,
+                           int intervalSeconds,
+                           const std::string& name,
+                           boost::uint64_t value,
+                           const std::string& unit = std::string());
+
+   // collect the aggregated metrics (one MultiMetric per scope, interval,
+   // type and unit) and reset the aggregator
+   void flush(std::vector<MultiMetric>* pMetrics);
+
+   // collect the aggregated histograms and reset them
+   void flushHistograms(std::vector<HistogramMetric>* pMetrics);
+
+   // samples dropped because the series bound was reached (since the
+   // previous call)
+   std::size_t collectDroppedSamples();
+
+private:
+   struct SeriesKey
+   {
+      std::string scope;
+      int intervalSeconds;
+      std::string type;
+      std::string unit;
+      std::string name;
+
+      bool operator<(const SeriesKey& other) const;
+      bool sameGroup(const SeriesKey& other) const;
+   };
+
+   struct Series
+   {
+      Series() : count(0), sum(0), min(0), max(0), last(0) {}
+      std::size_t count;
+      double sum;
+      double min;
+      double max;
+      double last;
+      boost::posix_time::ptime timestamp;
+   };
+
+   void addSample(const MetricBase& metric, const MetricData& data);
+   Histogram* histogramSeries(const std::string& scope,
+                              int intervalSeconds,
+                              const std::string& name,
+                              const std::string& unit);
+
+private:
+   boost::mutex mutex_;
+   std::size_t maxSeries_;
+   std::size_t droppedSamples_;
+   std::map<SeriesKey, Series> series_;
+   std::map<SeriesKey, Histogram> histograms_;
+};
+
+} // namespace metrics
+} // namespace monitor
+} // namespace rstudio
+
+#endif // MONITOR_METRIC_METRIC_AGGREGATOR_HPP
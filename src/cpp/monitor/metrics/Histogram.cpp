@@ -0,0 +1,249 @@
+/*
+ * Histogram.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <monitor/metrics/Histogram.hpp>
+
+#include <algorithm>
+
+#include <core/Error.hpp>
+
+#include <core/json/JsonRpc.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace monitor {
+namespace metrics {
+
+namespace {
+
+const int kSubBucketBits = 4;
+const int kSubBucketCount = 1 << kSubBucketBits;
+
+int highestBit(boost::uint64_t value)
+{
+   int bit = 0;
+   if (value >= (static_cast<boost::uint64_t>(1) << 32)) { value >>= 32; bit += 32; }
+   if (value >= (static_cast<boost::uint64_t>(1) << 16)) { value >>= 16; bit += 16; }
+   if (value >= (static_cast<boost::uint64_t>(1) << 8))  { value >>= 8;  bit += 8;  }
+   if (value >= (static_cast<boost::uint64_t>(1) << 4))  { value >>= 4;  bit += 4;  }
+   if (value >= (static_cast<boost::uint64_t>(1) << 2))  { value >>= 2;  bit += 2;  }
+   if (value >= (static_cast<boost::uint64_t>(1) << 1))  { bit += 1; }
+   return bit;
+}
+
+std::size_t bucketIndex(boost::uint64_t value)
+{
+   if (value < static_cast<boost::uint64_t>(kSubBucketCount))
+      return static_cast<std::size_t>(value);
+
+   int shift = highestBit(value) - kSubBucketBits;
+   return kSubBucketCount + (shift * kSubBucketCount) +
+          static_cast<std::size_t>((value >> shift) - kSubBucketCount);
+}
+
+boost::uint64_t bucketHighestValue(std::size_t index)
+{
+   if (index < static_cast<std::size_t>(kSubBucketCount))
+      return index;
+
+   std::size_t offset = index - kSubBucketCount;
+   int shift = static_cast<int>(offset / kSubBucketCount);
+   boost::uint64_t subBucket = offset % kSubBucketCount;
+   boost::uint64_t lowest = (kSubBucketCount + subBucket) << shift;
+   return lowest + ((static_cast<boost::uint64_t>(1) << shift) - 1);
+}
+
+json::Value asInt64(boost::uint64_t value)
+{
+   return json::Value(static_cast<boost::int64_t>(value));
+}
+
+} // anonymous namespace
+
+void Histogram::record(boost::uint64_t value, boost::uint64_t count)
+{
+   if (count == 0)
+      return;
+
+   std::size_t index = bucketIndex(value);
+   if (index >= counts_.size())
+      counts_.resize(index + 1, 0);
+   counts_[index] += count;
+
+   if (count_ == 0)
+   {
+      min_ = value;
+      max_ = value;
+   }
+   else
+   {
+      min_ = std::min(min_, value);
+      max_ = std::max(max_, value);
+   }
+   count_ += count;
+   sum_ += static_cast<double>(value) * static_cast<double>(count);
+}
+
+void Histogram::merge(const Histogram& other)
+{
+   if (other.empty())
+      return;
+
+   if (other.counts_.size() > counts_.size())
+      counts_.resize(other.counts_.size(), 0);
+   for (std::size_t i = 0; i < other.counts_.size(); i++)
+      counts_[i] += other.counts_[i];
+
+   if (count_ == 0)
+   {
+      min_ = other.min_;
+      max_ = other.max_;
+   }
+   else
+   {
+      min_ = std::min(min_, other.min_);
+      max_ = std::max(max_, other.max_);
+   }
+   count_ += other.count_;
+   sum_ += other.sum_;
+}
+
+void Histogram::clear()
+{
+   counts_.clear();
+   count_ = 0;
+   min_ = 0;
+   max_ = 0;
+   sum_ = 0;
+}
+
+double Histogram::mean() const
+{
+   if (count_ == 0)
+      return 0;
+   else
+      return sum_ / static_cast<double>(count_);
+}
+
+boost::uint64_t Histogram::valueAtPercentile(double percentile) const
+{
+   if (count_ == 0)
+      return 0;
+
+   percentile = std::max(0.0, std::min(100.0, percentile));
+   boost::uint64_t target = static_cast<boost::uint64_t>(
+               (percentile / 100.0) * static_cast<double>(count_) + 0.5);
+   target = std::max(target, static_cast<boost::uint64_t>(1));
+
+   boost::uint64_t seen = 0;
+   for (std::size_t i = 0; i < counts_.size(); i++)
+   {
+      seen += counts_[i];
+      if (seen >= target)
+         return std::max(min_, std::min(bucketHighestValue(i), max_));
+   }
+
+   return max_;
+}
+
+boost::uint64_t Histogram::countAtOrBelow(boost::uint64_t value) const
+{
+   if (value >= max_)
+      return count_;
+
+   boost::uint64_t count = 0;
+   std::size_t last = std::min(bucketIndex(value) + 1, counts_.size());
+   for (std::size_t i = 0; i < last; i++)
+      count += counts_[i];
+   return count;
+}
+
+json::Object histogramToJson(const Histogram& histogram)
+{
+   json::Object histogramJson;
+   histogramJson["count"] = asInt64(histogram.count());
+   histogramJson["sum"] = histogram.sum();
+   histogramJson["min"] = asInt64(histogram.min());
+   histogramJson["max"] = asInt64(histogram.max());
+   histogramJson["p50"] = asInt64(histogram.valueAtPercentile(50));
+   histogramJson["p90"] = asInt64(histogram.valueAtPercentile(90));
+   histogramJson["p99"] = asInt64(histogram.valueAtPercentile(99));
+
+   // buckets as [index, count] pairs (omitting empty buckets)
+   json::Array bucketsJson;
+   for (std::size_t i = 0; i < histogram.counts_.size(); i++)
+   {
+      if (histogram.counts_[i] == 0)
+         continue;
+
+      json::Array bucketJson;
+      bucketJson.push_back(static_cast<int>(i));
+      bucketJson.push_back(asInt64(histogram.counts_[i]));
+      bucketsJson.push_back(bucketJson);
+   }
+   histogramJson["buckets"] = bucketsJson;
+
+   return histogramJson;
+}
+
+Error histogramFromJson(const json::Object& histogramJson,
+                        Histogram* pHistogram)
+{
+   double count, sum, min, max;
+   json::Array bucketsJson;
+   Error error = json::readObject(histogramJson,
+                                  "count", &count,
+                                  "sum", &sum,
+                                  "min", &min,
+                                  "max", &max,
+                                  "buckets", &bucketsJson);
+   if (error)
+      return error;
+
+   Histogram histogram;
+   for (std::size_t i = 0; i < bucketsJson.size(); i++)
+   {
+      if (!json::isType<json::Array>(bucketsJson[i]))
+         return Error(json::errc::ParamTypeMismatch, ERROR_LOCATION);
+
+      const json::Array& bucketJson = bucketsJson[i].get_array();
+      if (bucketJson.size() != 2 ||
+          !json::isType<int>(bucketJson[0]) ||
+          !json::isType<double>(bucketJson[1]) ||
+          bucketJson[0].get_int() < 0)
+      {
+         return Error(json::errc::ParamTypeMismatch, ERROR_LOCATION);
+      }
+
+      std::size_t index = bucketJson[0].get_int();
+      if (index >= histogram.counts_.size())
+         histogram.counts_.resize(index + 1, 0);
+      histogram.counts_[index] +=
+               static_cast<boost::uint64_t>(bucketJson[1].get_real());
+   }
+
+   histogram.count_ = static_cast<boost::uint64_t>(count);
+   histogram.sum_ = sum;
+   histogram.min_ = static_cast<boost::uint64_t>(min);
+   histogram.max_ = static_cast<boost::uint64_t>(max);
+
+   *pHistogram = histogram;
+   return Success();
+}
+
+} // namespace metrics
+} // namespace monitor
+} // namespace rstudio
@@ -172,6 +172,53 @@ Error metricFromJson(const json::Object& multiMetricJson,
    return Success();
 }
 
+json::Object metricToJson(const HistogramMetric& histogramMetric)
+{
+   json::Object histogramMetricJson = metricBaseToJson(histogramMetric);
+   histogramMetricJson["name"] = histogramMetric.name();
+   histogramMetricJson["histogram"] =
+                           histogramToJson(histogramMetric.histogram());
+   return histogramMetricJson;
+}
+
+Error metricFromJson(const json::Object& histogramMetricJson,
+                     HistogramMetric* pHistogramMetric)
+{
+   // read the fields
+   std::string scope, type, unit, name;
+   double ts;
+   int intervalSeconds;
+   Error error = metricBaseFromJson(histogramMetricJson,
+                                    &scope,
+                                    &intervalSeconds,
+                                    &type,
+                                    &unit,
+                                    &ts);
+   if (error)
+      return error;
+
+   json::Object histogramJson;
+   error = json::readObject(histogramMetricJson,
+                            "name", &name,
+                            "histogram", &histogramJson);
+   if (error)
+      return error;
+
+   Histogram histogram;
+   error = histogramFromJson(histogramJson, &histogram);
+   if (error)
+      return error;
+
+   *pHistogramMetric = HistogramMetric(scope,
+                                       intervalSeconds,
+                                       name,
+                                       histogram,
+                                       unit,
+                                       date_time::timeFromSecondsSinceEpoch(ts));
+
+   return Success();
+}
+
 
 } // namespace metrics
 } // namespace monitor
@@ -0,0 +1,273 @@
+/*
+ * MetricAggregator.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <monitor/metrics/MetricAggregator.hpp>
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+
+#include <core/Thread.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace monitor {
+namespace metrics {
+
+const char * const kCounterType = "counter";
+const char * const kGaugeType = "gauge";
+const char * const kHistogramType = "histogram";
+
+bool MetricAggregator::SeriesKey::operator<(const SeriesKey& other) const
+{
+   if (scope != other.scope)
+      return scope < other.scope;
+   if (intervalSeconds != other.intervalSeconds)
+      return intervalSeconds < other.intervalSeconds;
+   if (type != other.type)
+      return type < other.type;
+   if (unit != other.unit)
+      return unit < other.unit;
+   return name < other.name;
+}
+
+bool MetricAggregator::SeriesKey::sameGroup(const SeriesKey& other) const
+{
+   return scope == other.scope &&
+          intervalSeconds == other.intervalSeconds &&
+          type == other.type &&
+          unit == other.unit;
+}
+
+void MetricAggregator::add(const Metric& metric)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      addSample(metric, metric.data());
+   }
+   END_LOCK_MUTEX
+}
+
+void MetricAggregator::add(const MultiMetric& metric)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      BOOST_FOREACH(const MetricData& data, metric.data())
+      {
+         addSample(metric, data);
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+void MetricAggregator::add(const HistogramMetric& metric)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      Histogram* pHistogram = histogramSeries(metric.scope(),
+                                              metric.intervalSeconds(),
+                                              metric.name(),
+                                              metric.unit());
+      if (pHistogram != NULL)
+         pHistogram->merge(metric.histogram());
+   }
+   END_LOCK_MUTEX
+}
+
+void MetricAggregator::addHistogramSample(const std::string& scope,
+                                          int intervalSeconds,
+                                          const std::string& name,
+                                          boost::uint64_t value,
+                                          const std::string& unit)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      Histogram* pHistogram = histogramSeries(scope,
+                                              intervalSeconds,
+                                              name,
+                                              unit);
+      if (pHistogram != NULL)
+         pHistogram->record(value);
+   }
+   END_LOCK_MUTEX
+}
+
+// NOTE: must be called with the mutex held
+Histogram* MetricAggregator::histogramSeries(const std::string& scope,
+                                             int intervalSeconds,
+                                             const std::string& name,
+                                             const std::string& unit)
+{
+   SeriesKey key;
+   key.scope = scope;
+   key.intervalSeconds = intervalSeconds;
+   key.type = kHistogramType;
+   key.unit = unit;
+   key.name = name;
+
+   std::map<SeriesKey, Histogram>::iterator it = histograms_.find(key);
+   if (it == histograms_.end())
+   {
+      if ((series_.size() + histograms_.size()) >= maxSeries_)
+      {
+         droppedSamples_++;
+         return NULL;
+      }
+      it = histograms_.insert(std::make_pair(key, Histogram())).first;
+   }
+
+   return &(it->second);
+}
+
+// NOTE: must be called with the mutex held
+void MetricAggregator::addSample(const MetricBase& metric,
+                                 const MetricData& data)
+{
+   SeriesKey key;
+   key.scope = metric.scope();
+   key.intervalSeconds = metric.intervalSeconds();
+   key.type = metric.type();
+   key.unit = metric.unit();
+   key.name = data.name;
+
+   std::map<SeriesKey, Series>::iterator it = series_.find(key);
+   if (it == series_.end())
+   {
+      if ((series_.size() + histograms_.size()) >= maxSeries_)
+      {
+         droppedSamples_++;
+         return;
+      }
+      it = series_.insert(std::make_pair(key, Series())).first;
+   }
+
+   Series& series = it->second;
+   if (series.count == 0)
+   {
+      series.min = data.value;
+      series.max = data.value;
+   }
+   else
+   {
+      series.min = std::min(series.min, data.value);
+      series.max = std::max(series.max, data.value);
+   }
+   series.count++;
+   series.sum += data.value;
+   series.last = data.value;
+   if (series.timestamp.is_not_a_date_time() ||
+       metric.timestamp() > series.timestamp)
+   {
+      series.timestamp = metric.timestamp();
+   }
+}
+
+void MetricAggregator::flush(std::vector<MultiMetric>* pMetrics)
+{
+   // swap out the series (so we don't hold the lock while building output)
+   std::map<SeriesKey, Series> series;
+   LOCK_MUTEX(mutex_)
+   {
+      series.swap(series_);
+   }
+   END_LOCK_MUTEX
+
+   // series are ordered by group so we can emit each group as it ends
+   std::vector<MetricData> data;
+   boost::posix_time::ptime timestamp;
+   typedef std::map<SeriesKey, Series>::const_iterator iterator;
+   for (iterator it = series.begin(); it != series.end(); ++it)
+   {
+      const SeriesKey& key = it->first;
+      const Series& value = it->second;
+
+      if (key.type == kCounterType)
+      {
+         data.push_back(MetricData(key.name, value.sum));
+      }
+      else if (key.type == kHistogramType)
+      {
+         data.push_back(MetricData(key.name + ".count",
+                                   static_cast<double>(value.count)));
+         data.push_back(MetricData(key.name + ".sum", value.sum));
+         data.push_back(MetricData(key.name + ".min", value.min));
+         data.push_back(MetricData(key.name + ".max", value.max));
+      }
+      else
+      {
+         data.push_back(MetricData(key.name, value.last));
+      }
+
+      if (timestamp.is_not_a_date_time() || value.timestamp > timestamp)
+         timestamp = value.timestamp;
+
+      iterator next = it;
+      ++next;
+      if (next == series.end() || !next->first.sameGroup(key))
+      {
+         pMetrics->push_back(MultiMetric(key.scope,
+                                         key.intervalSeconds,
+                                         data,
+                                         key.type,
+                                         key.unit,
+                                         timestamp));
+         data.clear();
+         timestamp = boost::posix_time::ptime();
+      }
+   }
+}
+
+void MetricAggregator::flushHistograms(std::vector<HistogramMetric>* pMetrics)
+{
+   std::map<SeriesKey, Histogram> histograms;
+   LOCK_MUTEX(mutex_)
+   {
+      histograms.swap(histograms_);
+   }
+   END_LOCK_MUTEX
+
+   boost::posix_time::ptime now =
+                     boost::posix_time::microsec_clock::universal_time();
+   typedef std::map<SeriesKey, Histogram>::const_iterator iterator;
+   for (iterator it = histograms.begin(); it != histograms.end(); ++it)
+   {
+      const SeriesKey& key = it->first;
+      pMetrics->push_back(HistogramMetric(key.scope,
+                                          key.intervalSeconds,
+                                          key.name,
+                                          it->second,
+                                          key.unit,
+                                          now));
+   }
+}
+
+std::size_t MetricAggregator::collectDroppedSamples()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      std::size_t dropped = droppedSamples_;
+      droppedSamples_ = 0;
+      return dropped;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return 0;
+}
+
+} // namespace metrics
+} // namespace monitor
+} // namespace rstudio
@@ -26,6 +26,8 @@
 
 #include <R_ext/Parse.h>
 
+#include <cstring>
+
 #include <R_ext/libextern.h> 
 LibExtern Rboolean R_interrupts_suspended;
 LibExtern int R_interrupts_pending;
@@ -345,6 +347,24 @@ Error RFunction::call(SEXP evalNS, SEXP* pResultSEXP, sexp::Protect* pProtect)
 
 Error RFunction::call(SEXP evalNS, bool safely, SEXP* pResultSEXP,
                       sexp::Protect* pProtect)
+{
+   SEXP callSEXP ;
+   Error error = createCall(&callSEXP, pProtect);
+   if (error)
+      return error;
+   
+   // call the function
+   error = safely ?
+            evaluateExpressions(callSEXP, evalNS, pResultSEXP, pProtect) :
+            evaluateExpressionsUnsafe(callSEXP, evalNS, pResultSEXP, pProtect);
+   if (error)
+      return error;
+   
+   // return success
+   return Success();
+}
+
+Error RFunction::createCall(SEXP* pCallSEXP, sexp::Protect* pProtect)
 {
    // verify the function
    if (functionSEXP_ == R_UnboundValue)
@@ -376,14 +396,72 @@ Error RFunction::call(SEXP evalNS, bool safely, SEXP* pResultSEXP,
       nextSlotSEXP = CDR(nextSlotSEXP);
    }
    
-   // call the function
-   Error error = safely ?
-            evaluateExpressions(callSEXP, evalNS, pResultSEXP, pProtect) :
-            evaluateExpressionsUnsafe(callSEXP, evalNS, pResultSEXP, pProtect);
+   *pCallSEXP = callSEXP;
+   return Success();
+}
+
+Error RFunctionBatch::execute(SEXP evalNS)
+{
+   std::size_t n = functions_.size();
+   results_.assign(n, R_NilValue);
+   errors_.assign(n, Success());
+   if (n == 0)
+      return Success();
+
+   // create the calls (a call whose function couldn't be found is left as
+   // NULL and keeps its error)
+   SEXP callsSEXP ;
+   rProtect_.add(callsSEXP = Rf_allocVector(VECSXP, n));
+   for (std::size_t i = 0; i < n; i++)
+   {
+      SEXP callSEXP ;
+      errors_[i] = functions_[i]->createCall(&callSEXP, &rProtect_);
+      if (!errors_[i])
+         SET_VECTOR_ELT(callsSEXP, i, callSEXP);
+   }
+
+   // evaluate them all in one go
+   SEXP evaluatedSEXP ;
+   RFunction evaluateCalls(".rs.evaluateCalls", callsSEXP, evalNS);
+   Error error = evaluateCalls.call(&evaluatedSEXP, &rProtect_);
    if (error)
       return error;
-   
-   // return success
+
+   if (TYPEOF(evaluatedSEXP) != VECSXP ||
+       static_cast<std::size_t>(Rf_length(evaluatedSEXP)) != n)
+   {
+      return Error(errc::UnexpectedDataTypeError, ERROR_LOCATION);
+   }
+
+   // each element is either list(value = ...) or list(error = "...")
+   for (std::size_t i = 0; i < n; i++)
+   {
+      if (errors_[i])
+         continue;
+
+      SEXP evaluatedCallSEXP = VECTOR_ELT(evaluatedSEXP, i);
+      SEXP namesSEXP = Rf_getAttrib(evaluatedCallSEXP, R_NamesSymbol);
+      if (TYPEOF(evaluatedCallSEXP) != VECSXP ||
+          Rf_length(evaluatedCallSEXP) != 1 ||
+          TYPEOF(namesSEXP) != STRSXP)
+      {
+         errors_[i] = Error(errc::UnexpectedDataTypeError, ERROR_LOCATION);
+         continue;
+      }
+
+      SEXP valueSEXP = VECTOR_ELT(evaluatedCallSEXP, 0);
+      if (std::strcmp(CHAR(STRING_ELT(namesSEXP, 0)), "error") == 0)
+      {
+         errors_[i] = rCodeExecutionError(sexp::asString(valueSEXP),
+                                          ERROR_LOCATION);
+         errors_[i].addProperty("symbol", functions_[i]->functionName_);
+      }
+      else
+      {
+         results_[i] = valueSEXP;
+      }
+   }
+
    return Success();
 }
 
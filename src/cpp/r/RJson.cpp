@@ -53,6 +53,7 @@
 
 #include <core/Error.hpp>
 #include <core/StringUtils.hpp>
+#include <core/json/JsonWriter.hpp>
 
 #include <r/RSexp.hpp>
 #include <r/RErrorCategory.hpp>
@@ -154,6 +155,81 @@ Error jsonValueFromVectorElement(SEXP vectorSEXP,
 }  
 
 
+// convert a whole vector with a loop per type (rather than switching on the
+// type for every element)
+Error jsonArrayFromVector(SEXP vectorSEXP, core::json::Array* pArray)
+{
+   int vectorLength = Rf_length(vectorSEXP);
+   pArray->reserve(pArray->size() + vectorLength);
+
+   switch(TYPEOF(vectorSEXP))
+   {
+      case STRSXP:
+      {
+         for (int i=0; i<vectorLength; i++)
+         {
+            SEXP stringSEXP = STRING_ELT(vectorSEXP, i);
+            if (stringSEXP != NA_STRING)
+               pArray->push_back(std::string(Rf_translateCharUTF8(stringSEXP)));
+            else
+               pArray->push_back(core::json::Value());
+         }
+         break;
+      }
+      case INTSXP:
+      {
+         const int* pData = INTEGER(vectorSEXP);
+         for (int i=0; i<vectorLength; i++)
+         {
+            if (pData[i] != NA_INTEGER)
+               pArray->push_back(pData[i]);
+            else
+               pArray->push_back(core::json::Value());
+         }
+         break;
+      }
+      case REALSXP:
+      {
+         const double* pData = REAL(vectorSEXP);
+         for (int i=0; i<vectorLength; i++)
+         {
+            if (!ISNAN(pData[i]))
+               pArray->push_back(pData[i]);
+            else
+               pArray->push_back(core::json::Value());
+         }
+         break;
+      }
+      case LGLSXP:
+      {
+         const int* pData = LOGICAL(vectorSEXP);
+         for (int i=0; i<vectorLength; i++)
+         {
+            if (pData[i] != NA_LOGICAL)
+               pArray->push_back(pData[i] == TRUE);
+            else
+               pArray->push_back(core::json::Value());
+         }
+         break;
+      }
+      default:
+      {
+         for (int i=0; i<vectorLength; i++)
+         {
+            core::json::Value elementValue ;
+            Error error = jsonValueFromVectorElement(vectorSEXP, i, &elementValue);
+            if (error)
+               return error;
+
+            pArray->push_back(elementValue);
+         }
+         break;
+      }
+   }
+
+   return Success();
+}
+
 Error jsonValueArrayFromList(SEXP listSEXP, core::json::Value* pValue)
 {
    // value array to return
@@ -206,55 +282,6 @@ bool isNamedList(SEXP listSEXP)
    return true;
 }
    
-Error jsonObjectFromListElement(SEXP listSEXP, 
-                                const std::vector<std::string>& fieldNames,
-                                int index,
-                                core::json::Value* pValue)
-{
-   // note list length
-   int listLength = Rf_length(listSEXP);
-   
-   // compose an object by iterating through the fields
-   core::json::Object jsonObject ;
-   for (int f=0; f<listLength; f++)
-   {
-      // get the field
-      SEXP fieldSEXP = VECTOR_ELT(listSEXP, f);
-      
-      // extract the value
-      core::json::Value fieldValue ;
-      switch(TYPEOF(fieldSEXP))
-      {
-         case VECSXP:
-         {
-            SEXP valueSEXP = VECTOR_ELT(fieldSEXP, index);
-            Error error = jsonValueFromObject(valueSEXP, &fieldValue);
-            if (error)
-               return error;
-            
-            break;
-         }
-         default:
-         {
-            Error error = jsonValueFromVectorElement(fieldSEXP, 
-                                                     index,
-                                                     &fieldValue);
-            if (error)
-               return error;
-            
-            break;
-         }
-      }
-      
-      // add it to the json object
-      jsonObject[fieldNames[f]] = fieldValue;
-   }
-   
-   // set value and return success
-   *pValue = jsonObject;
-   return Success();
-}
-
 //   
 // NOTE: this function assumes that isNamedList has been called
 // and returned true for this list (validates a name for each element)
@@ -299,19 +326,41 @@ Error jsonObjectArrayFromDataFrame(SEXP listSEXP, core::json::Value* pValue)
    if (error)
       return error;
    
-   // object array to return
-   core::json::Array jsonObjectArray ;
-   
-   // iterate through the values
+   // object array to return (one object per row)
    int values = Rf_length(VECTOR_ELT(listSEXP, 0));
-   for (int v=0; v<values; v++)
+   core::json::Array jsonObjectArray(values, core::json::Object());
+   
+   // fill in the rows a column at a time, so that each column is converted
+   // with a single typed loop
+   int fields = Rf_length(listSEXP);
+   core::json::Array columnValues;
+   for (int f=0; f<fields; f++)
    {
-      core::json::Value objectValue ;
-      error = jsonObjectFromListElement(listSEXP, fieldNames, v, &objectValue);
-      if (error)
-         return error ;
-      
-      jsonObjectArray.push_back(objectValue);
+      SEXP fieldSEXP = VECTOR_ELT(listSEXP, f);
+
+      columnValues.clear();
+      if (TYPEOF(fieldSEXP) == VECSXP)
+      {
+         for (int v=0; v<values; v++)
+         {
+            core::json::Value fieldValue ;
+            error = jsonValueFromObject(VECTOR_ELT(fieldSEXP, v), &fieldValue);
+            if (error)
+               return error;
+            columnValues.push_back(fieldValue);
+         }
+      }
+      else
+      {
+         error = jsonArrayFromVector(fieldSEXP, &columnValues);
+         if (error)
+            return error;
+      }
+
+      for (int v=0; v<values; v++)
+      {
+         jsonObjectArray[v].get_obj()[fieldNames[f]] = columnValues[v];
+      }
    }
    
    // return array and success
@@ -319,6 +368,248 @@ Error jsonObjectArrayFromDataFrame(SEXP listSEXP, core::json::Value* pValue)
    return Success();
 }
 
+// streaming equivalents of the above; these write json text directly rather
+// than building json values. note that non-finite reals are written as null.
+
+Error writeVectorElement(SEXP vectorSEXP, int i, core::json::Writer* pWriter)
+{
+   switch(TYPEOF(vectorSEXP))
+   {
+      case NILSXP:
+      {
+         pWriter->nullValue();
+         break;
+      }
+      case STRSXP:
+      {
+         SEXP stringSEXP = STRING_ELT(vectorSEXP, i);
+         if (stringSEXP != NA_STRING)
+            pWriter->value(Rf_translateCharUTF8(stringSEXP));
+         else
+            pWriter->nullValue();
+         break;
+      }
+      case INTSXP:
+      {
+         int value = INTEGER(vectorSEXP)[i];
+         if (value != NA_INTEGER)
+            pWriter->value(value);
+         else
+            pWriter->nullValue();
+         break;
+      }
+      case REALSXP:
+      {
+         double value = REAL(vectorSEXP)[i];
+         if (!ISNAN(value))
+            pWriter->value(value);
+         else
+            pWriter->nullValue();
+         break;
+      }
+      case LGLSXP:
+      {
+         int value = LOGICAL(vectorSEXP)[i];
+         if (value != NA_LOGICAL)
+            pWriter->value(value == TRUE);
+         else
+            pWriter->nullValue();
+         break;
+      }
+      case CPLXSXP:
+      {
+         double real = COMPLEX(vectorSEXP)[i].r;
+         double imaginary = COMPLEX(vectorSEXP)[i].i;
+         if (!ISNAN(real) && !ISNAN(imaginary))
+         {
+            pWriter->startObject();
+            pWriter->member("i", imaginary);
+            pWriter->member("r", real);
+            pWriter->endObject();
+         }
+         else
+         {
+            pWriter->nullValue();
+         }
+         break;
+      }
+      case ENVSXP:
+      {
+         pWriter->value("<environment>");
+         break;
+      }
+      default:
+      {
+         return Error(errc::UnexpectedDataTypeError, ERROR_LOCATION);
+      }
+   }
+
+   return Success();
+}
+
+Error writeVectorElements(SEXP vectorSEXP, core::json::Writer* pWriter)
+{
+   int vectorLength = Rf_length(vectorSEXP);
+   switch(TYPEOF(vectorSEXP))
+   {
+      case STRSXP:
+      {
+         for (int i=0; i<vectorLength; i++)
+         {
+            SEXP stringSEXP = STRING_ELT(vectorSEXP, i);
+            if (stringSEXP != NA_STRING)
+               pWriter->value(Rf_translateCharUTF8(stringSEXP));
+            else
+               pWriter->nullValue();
+         }
+         break;
+      }
+      case INTSXP:
+      {
+         const int* pData = INTEGER(vectorSEXP);
+         for (int i=0; i<vectorLength; i++)
+         {
+            if (pData[i] != NA_INTEGER)
+               pWriter->value(pData[i]);
+            else
+               pWriter->nullValue();
+         }
+         break;
+      }
+      case REALSXP:
+      {
+         const double* pData = REAL(vectorSEXP);
+         for (int i=0; i<vectorLength; i++)
+         {
+            if (!ISNAN(pData[i]))
+               pWriter->value(pData[i]);
+            else
+               pWriter->nullValue();
+         }
+         break;
+      }
+      case LGLSXP:
+      {
+         const int* pData = LOGICAL(vectorSEXP);
+         for (int i=0; i<vectorLength; i++)
+         {
+            if (pData[i] != NA_LOGICAL)
+               pWriter->value(pData[i] == TRUE);
+            else
+               pWriter->nullValue();
+         }
+         break;
+      }
+      default:
+      {
+         for (int i=0; i<vectorLength; i++)
+         {
+            Error error = writeVectorElement(vectorSEXP, i, pWriter);
+            if (error)
+               return error;
+         }
+         break;
+      }
+   }
+
+   return Success();
+}
+
+Error writeVector(SEXP vectorSEXP, core::json::Writer* pWriter)
+{
+   if (Rf_inherits(vectorSEXP, "rs.scalar"))
+   {
+      if (Rf_length(vectorSEXP) > 0)
+         return writeVectorElement(vectorSEXP, 0, pWriter);
+
+      pWriter->nullValue();
+      return Success();
+   }
+
+   pWriter->startArray();
+   Error error = writeVectorElements(vectorSEXP, pWriter);
+   if (error)
+      return error;
+   pWriter->endArray();
+   return Success();
+}
+
+//
+// NOTE: this function assumes that isNamedList has been called
+// and returned true for this list (validates a name for each element)
+//
+Error writeDataFrame(SEXP listSEXP, core::json::Writer* pWriter)
+{
+   std::vector<std::string> fieldNames ;
+   Error error = sexp::getNames(listSEXP, &fieldNames);
+   if (error)
+      return error;
+
+   // rows are written one at a time, so only the column SEXPs are needed
+   int fields = Rf_length(listSEXP);
+   std::vector<SEXP> columns;
+   columns.reserve(fields);
+   for (int f=0; f<fields; f++)
+      columns.push_back(VECTOR_ELT(listSEXP, f));
+
+   int values = Rf_length(VECTOR_ELT(listSEXP, 0));
+   pWriter->startArray();
+   for (int v=0; v<values; v++)
+   {
+      pWriter->startObject();
+      for (int f=0; f<fields; f++)
+      {
+         pWriter->key(fieldNames[f]);
+         if (TYPEOF(columns[f]) == VECSXP)
+            error = writeJsonFromObject(VECTOR_ELT(columns[f], v), pWriter);
+         else
+            error = writeVectorElement(columns[f], v, pWriter);
+         if (error)
+            return error;
+      }
+      pWriter->endObject();
+   }
+   pWriter->endArray();
+   return Success();
+}
+
+Error writeList(SEXP listSEXP, core::json::Writer* pWriter)
+{
+   int listLength = Rf_length(listSEXP);
+
+   if (!isNamedList(listSEXP))
+   {
+      pWriter->startArray();
+      for (int i=0; i<listLength; i++)
+      {
+         Error error = writeJsonFromObject(VECTOR_ELT(listSEXP, i), pWriter);
+         if (error)
+            return error;
+      }
+      pWriter->endArray();
+      return Success();
+   }
+
+   if (Rf_inherits(listSEXP, "data.frame"))
+      return writeDataFrame(listSEXP, pWriter);
+
+   std::vector<std::string> fieldNames ;
+   Error error = sexp::getNames(listSEXP, &fieldNames);
+   if (error)
+      return error;
+
+   pWriter->startObject();
+   for (int i=0; i<listLength; i++)
+   {
+      pWriter->key(fieldNames[i]);
+      error = writeJsonFromObject(VECTOR_ELT(listSEXP, i), pWriter);
+      if (error)
+         return error;
+   }
+   pWriter->endObject();
+   return Success();
+}
+
 } // anonymous namespace
 
 Error jsonValueFromScalar(SEXP scalarSEXP, core::json::Value* pValue)
@@ -349,15 +640,9 @@ Error jsonValueFromVector(SEXP vectorSEXP, core::json::Value* pValue)
    }
 
    core::json::Array vectorValues ;
-   for (int i=0; i<vectorLength; i++)
-   {
-      core::json::Value elementValue ;
-      Error error = jsonValueFromVectorElement(vectorSEXP, i, &elementValue);
-      if (error)
-         return error;
-      
-      vectorValues.push_back(elementValue);
-   }
+   Error error = jsonArrayFromVector(vectorSEXP, &vectorValues);
+   if (error)
+      return error;
    
    *pValue = vectorValues;
    return Success();
@@ -412,6 +697,32 @@ Error jsonValueFromObject(SEXP objectSEXP, core::json::Value* pValue)
       }
    }
 } 
+
+Error writeJsonFromObject(SEXP objectSEXP, core::json::Writer* pWriter)
+{
+   switch(TYPEOF(objectSEXP))
+   {
+      case NILSXP:
+      {
+         pWriter->nullValue();
+         return Success();
+      }
+      case VECSXP:
+      {
+         return writeList(objectSEXP, pWriter);
+      }
+      case SYMSXP:
+      case LANGSXP:
+      {
+         pWriter->value(sexp::asString(objectSEXP));
+         return Success();
+      }
+      default:
+      {
+         return writeVector(objectSEXP, pWriter);
+      }
+   }
+}
    
 } // namespace json
 } // namesapce r
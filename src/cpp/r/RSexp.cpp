@@ -20,13 +20,18 @@
 #include <r/RSexp.hpp>
 #include <r/RInternal.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 #include <core/Algorithm.hpp>
 
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/optional.hpp>
+#include <boost/unordered_set.hpp>
 
 #include <core/Macros.hpp>
 #include <core/Log.hpp>
@@ -118,6 +123,106 @@ FunctionSymbolUsageCache& functionSymbolUsageCache()
    return instance;
 }
 
+// singleton: cache the results of findVar / findFunction by (name, ns)
+// while a LookupCacheScope is active
+class LookupCache : boost::noncopyable
+{
+   typedef std::pair<std::string, std::string> NameNamespacePair;
+   typedef std::map<NameNamespacePair, SEXP> Lookups;
+
+public:
+
+   LookupCache()
+      : depth_(0), searchPathHash_(0)
+   {
+   }
+
+   void enter()
+   {
+      if (depth_++ == 0)
+         clear();
+   }
+
+   void leave()
+   {
+      if (--depth_ == 0)
+         clear();
+   }
+
+   bool get(bool function,
+            const std::string& name,
+            const std::string& ns,
+            SEXP* pValue)
+   {
+      if (depth_ == 0)
+         return false;
+
+      // attaching or detaching a package changes what unqualified names
+      // resolve to
+      std::size_t hash = searchPathHash();
+      if (hash != searchPathHash_)
+      {
+         clear();
+         return false;
+      }
+
+      const Lookups& lookups = function ? functions_ : vars_;
+      Lookups::const_iterator it = lookups.find(std::make_pair(name, ns));
+      if (it == lookups.end())
+         return false;
+
+      *pValue = it->second;
+      return true;
+   }
+
+   void put(bool function,
+            const std::string& name,
+            const std::string& ns,
+            SEXP value)
+   {
+      if (depth_ == 0)
+         return;
+
+      // keep cached values alive even if their binding is removed while the
+      // cache is active (e.g. by remove_objects)
+      if (value != R_UnboundValue && value != R_NilValue)
+         protected_.set(Rf_cons(value, protected_.get()));
+
+      Lookups& lookups = function ? functions_ : vars_;
+      lookups[std::make_pair(name, ns)] = value;
+   }
+
+   void clear()
+   {
+      vars_.clear();
+      functions_.clear();
+      protected_.releaseNow();
+      searchPathHash_ = searchPathHash();
+   }
+
+private:
+
+   static std::size_t searchPathHash()
+   {
+      std::size_t hash = 0;
+      for (SEXP env = R_GlobalEnv; env != R_EmptyEnv; env = ENCLOS(env))
+         boost::hash_combine(hash, static_cast<void*>(env));
+      return hash;
+   }
+
+   int depth_;
+   std::size_t searchPathHash_;
+   Lookups vars_;
+   Lookups functions_;
+   PreservedSEXP protected_;
+};
+
+LookupCache& lookupCache()
+{
+   static LookupCache instance;
+   return instance;
+}
+
 } // anonymous namespace
    
 std::string asString(SEXP object) 
@@ -204,6 +309,9 @@ bool ensureNamespaceLoaded(const std::string& ns)
    SEXP nsSEXP = findNamespace(ns);
    if (nsSEXP == R_UnboundValue)
    {
+      // loading a namespace can attach or replace others
+      lookupCache().clear();
+
       r::exec::RFunction requireNamespace("base:::requireNamespace");
       requireNamespace.addParam("package", ns);
       requireNamespace.addParam("quietly", true);
@@ -334,11 +442,10 @@ SEXP findVar(const std::string &name, const SEXP env)
    return Rf_findVar(Rf_install(name.c_str()), env);
 }
 
-SEXP findVar(const std::string& name, const std::string& ns)
+namespace {
+
+SEXP findVarUncached(const std::string& name, const std::string& ns)
 {
-   if (name.empty())
-      return R_UnboundValue;
-   
    if (!ns.empty())
       if (!ensureNamespaceLoaded(ns))
          return R_UnboundValue;
@@ -348,12 +455,9 @@ SEXP findVar(const std::string& name, const std::string& ns)
    return findVar(name, env);
 }
 
-
-SEXP findFunction(const std::string& name, const std::string& ns) 
+SEXP findFunctionUncached(const std::string& name, const std::string& ns)
 {
    r::sexp::Protect protect;
-   if (name.empty())
-      return R_UnboundValue;
    
    if (!ns.empty())
       if (!ensureNamespaceLoaded(ns))
@@ -407,7 +511,53 @@ SEXP findFunction(const std::string& name, const std::string& ns)
    }
    
    return R_UnboundValue;
-}   
+}
+
+} // anonymous namespace
+
+SEXP findVar(const std::string& name, const std::string& ns)
+{
+   if (name.empty())
+      return R_UnboundValue;
+
+   SEXP resultSEXP;
+   if (lookupCache().get(false, name, ns, &resultSEXP))
+      return resultSEXP;
+
+   resultSEXP = findVarUncached(name, ns);
+   lookupCache().put(false, name, ns, resultSEXP);
+   return resultSEXP;
+}
+
+SEXP findFunction(const std::string& name, const std::string& ns) 
+{
+   if (name.empty())
+      return R_UnboundValue;
+
+   SEXP resultSEXP;
+   if (lookupCache().get(true, name, ns, &resultSEXP))
+      return resultSEXP;
+
+   resultSEXP = findFunctionUncached(name, ns);
+   lookupCache().put(true, name, ns, resultSEXP);
+   return resultSEXP;
+}
+
+LookupCacheScope::LookupCacheScope()
+{
+   lookupCache().enter();
+}
+
+LookupCacheScope::~LookupCacheScope()
+{
+   try
+   {
+      lookupCache().leave();
+   }
+   catch(...)
+   {
+   }
+}
    
 std::string typeAsString(SEXP object)
 {
@@ -1498,6 +1648,198 @@ std::string environmentName(SEXP envSEXP)
       return addressAsString((void*) envSEXP);
 }
 
+namespace {
+
+// node sizes as reported by utils::object.size (a cons cell, and the header
+// of a vector)
+const double kNodeSize = 8 + 6 * sizeof(void*);
+const double kVectorHeaderSize = 8 + 3 * sizeof(void*) + 2 * sizeof(R_xlen_t);
+
+// nesting beyond this depth is estimated rather than walked (so that
+// pathological objects can't overflow the stack)
+const int kMaxObjectSizeDepth = 1000;
+
+class ObjectSizeWalker : boost::noncopyable
+{
+public:
+   explicit ObjectSizeWalker(const boost::posix_time::time_duration& budget)
+      : deadline_(boost::posix_time::microsec_clock::universal_time() +
+                  budget),
+        nodes_(0),
+        expired_(false),
+        approximate_(false)
+   {
+   }
+
+   double walk(SEXP object, int depth = 0)
+   {
+      if (object == R_NilValue || !visited_.insert(object).second)
+         return 0;
+
+      double size = 0;
+      if (expired() || depth > kMaxObjectSizeDepth)
+      {
+         approximate_ = true;
+         return nodeSize(object);
+      }
+
+      size += nodeSize(object);
+
+      switch (TYPEOF(object))
+      {
+      case STRSXP:
+      {
+         R_xlen_t n = Rf_xlength(object);
+         for (R_xlen_t i = 0; i < n; i++)
+            size += walk(STRING_ELT(object, i), depth + 1);
+         break;
+      }
+
+      case VECSXP:
+      case EXPRSXP:
+      {
+         // extrapolate from the elements visited if we run out of time
+         R_xlen_t n = Rf_xlength(object);
+         double elementsSize = 0;
+         for (R_xlen_t i = 0; i < n; i++)
+         {
+            if (expired())
+            {
+               approximate_ = true;
+               elementsSize += (elementsSize / std::max<R_xlen_t>(i, 1)) *
+                               (n - i);
+               break;
+            }
+            elementsSize += walk(VECTOR_ELT(object, i), depth + 1);
+         }
+         size += elementsSize;
+         break;
+      }
+
+      case LISTSXP:
+      case LANGSXP:
+      case DOTSXP:
+      {
+         // walk the chain iteratively (pairlists can be very long)
+         size += walk(TAG(object), depth + 1) + walk(CAR(object), depth + 1);
+         for (SEXP node = CDR(object);
+              node != R_NilValue && !expired();
+              node = CDR(node))
+         {
+            if (!visited_.insert(node).second)
+               break;
+            size += kNodeSize;
+            size += walk(ATTRIB(node), depth + 1);
+            size += walk(TAG(node), depth + 1);
+            size += walk(CAR(node), depth + 1);
+         }
+         break;
+      }
+
+      case CLOSXP:
+         size += walk(FORMALS(object), depth + 1);
+         size += walk(BODY(object), depth + 1);
+         break;
+
+      case PROMSXP:
+         size += walk(PRVALUE(object), depth + 1);
+         size += walk(PRCODE(object), depth + 1);
+         break;
+
+      default:
+         break;
+      }
+
+      // attributes (not for CHARSXPs, whose attributes are internal)
+      if (TYPEOF(object) != CHARSXP)
+         size += walk(ATTRIB(object), depth + 1);
+
+      return size;
+   }
+
+   bool approximate() const { return approximate_; }
+
+private:
+   double nodeSize(SEXP object)
+   {
+      double bytes;
+      switch (TYPEOF(object))
+      {
+      case CHARSXP:
+         bytes = Rf_xlength(object) + 1;
+         break;
+      case LGLSXP:
+      case INTSXP:
+         bytes = Rf_xlength(object) * sizeof(int);
+         break;
+      case REALSXP:
+         bytes = Rf_xlength(object) * sizeof(double);
+         break;
+      case CPLXSXP:
+         bytes = Rf_xlength(object) * sizeof(Rcomplex);
+         break;
+      case RAWSXP:
+         bytes = Rf_xlength(object);
+         break;
+      case STRSXP:
+      case VECSXP:
+      case EXPRSXP:
+         bytes = Rf_xlength(object) * sizeof(SEXP);
+         break;
+      default:
+         return kNodeSize;
+      }
+
+      return kVectorHeaderSize + allocationSize(bytes);
+   }
+
+   // R allocates small vectors from pools of a few fixed sizes
+   static double allocationSize(double bytes)
+   {
+      if (bytes == 0)
+         return 0;
+
+      const double kSmallSizes[] = { 8, 16, 32, 48, 64, 128 };
+      for (std::size_t i = 0; i < sizeof(kSmallSizes) / sizeof(double); i++)
+      {
+         if (bytes <= kSmallSizes[i])
+            return kSmallSizes[i];
+      }
+      return std::ceil(bytes / 8) * 8;
+   }
+
+   // check the clock every so many nodes (checking it costs more than
+   // visiting a node)
+   bool expired()
+   {
+      if (!expired_ && (++nodes_ % 1024) == 0)
+      {
+         expired_ = boost::posix_time::microsec_clock::universal_time() >
+                    deadline_;
+      }
+      return expired_;
+   }
+
+   boost::posix_time::ptime deadline_;
+   std::size_t nodes_;
+   bool expired_;
+   bool approximate_;
+   boost::unordered_set<SEXP> visited_;
+};
+
+} // anonymous namespace
+
+double objectSize(SEXP object,
+                  const boost::posix_time::time_duration& budget,
+                  bool* pApproximate)
+{
+   ObjectSizeWalker walker(budget);
+   double size = walker.walk(object);
+   if (pApproximate)
+      *pApproximate = walker.approximate();
+   return size;
+}
+
 } // namespace sexp   
 } // namespace r
 } // namespace rstudio
@@ -16,6 +16,9 @@
 
 #include <r/RUtil.hpp>
 
+#include <cctype>
+
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/regex.hpp>
 
@@ -93,6 +96,38 @@ std::string rconsole2utf8(const std::string& encoded)
    return output;
 }
 
+namespace {
+
+// upper case without punctuation (so that e.g. utf8 and UTF-8 are equal)
+std::string normalizeEncoding(const std::string& encoding)
+{
+   std::string normalized;
+   for (std::string::const_iterator it = encoding.begin();
+        it != encoding.end(); ++it)
+   {
+      if (std::isalnum(static_cast<unsigned char>(*it)))
+         normalized.push_back(std::toupper(static_cast<unsigned char>(*it)));
+   }
+   return normalized;
+}
+
+// encodings in which ascii text is represented as itself (the empty
+// encoding is the native one, which is always a superset of ascii)
+bool isAsciiCompatible(const std::string& normalized)
+{
+   using namespace boost::algorithm;
+   return normalized.empty() ||
+          normalized == "UTF8" ||
+          normalized == "ASCII" ||
+          normalized == "USASCII" ||
+          starts_with(normalized, "LATIN") ||
+          starts_with(normalized, "ISO8859") ||
+          starts_with(normalized, "WINDOWS125") ||
+          starts_with(normalized, "CP125");
+}
+
+} // anonymous namespace
+
 core::Error iconvstr(const std::string& value,
                      const std::string& from,
                      const std::string& to,
@@ -112,6 +147,19 @@ core::Error iconvstr(const std::string& value,
       return Success();
    }
 
+   // skip iconv when the conversion wouldn't change anything (as is the case
+   // for most text, which is ascii)
+   std::string normalizedFrom = normalizeEncoding(from);
+   std::string normalizedTo = normalizeEncoding(to);
+   if ((!normalizedFrom.empty() && normalizedFrom == normalizedTo) ||
+       (isAsciiCompatible(normalizedFrom) &&
+        isAsciiCompatible(normalizedTo) &&
+        string_utils::isAscii(value)))
+   {
+      *pResult = value;
+      return Success();
+   }
+
    std::vector<char> output;
    output.reserve(value.length());
 
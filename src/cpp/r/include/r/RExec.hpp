@@ -23,6 +23,7 @@
 #include <boost/utility.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <core/Error.hpp>
 #include <core/system/System.hpp>
@@ -90,6 +91,8 @@ core::Error evaluateString(const std::string& str, T* pValue)
    return sexp::extract(valueSEXP, pValue);
 }
    
+class RFunctionBatch;
+
 // call R functions
 class RFunction : boost::noncopyable
 {
@@ -206,7 +209,12 @@ public:
    }
    
 private:
+   friend class RFunctionBatch;
+
    void commonInit(const std::string& functionName);
+
+   // create the call object (LANGSXP) for the function and its params
+   core::Error createCall(SEXP* pCallSEXP, sexp::Protect* pProtect);
    
 private:
    // protect included SEXPs
@@ -231,6 +239,90 @@ private:
    std::vector<Param> params_ ;
 };
 
+// evaluate a batch of function calls with a single transition into R (one
+// error handler scope and top-level context for the whole batch rather than
+// one per call) while still collecting each call's result or error
+//
+//    RFunctionBatch batch;
+//    batch.add(".rs.formatRowNames", dataSEXP, start, length);
+//    RFunction& format = batch.add(".rs.formatDataColumn");
+//    format.addParam(columnSEXP);
+//    Error error = batch.execute();
+//    ...
+//    if (!batch.error(1))
+//       SEXP resultSEXP = batch.result(1);
+//
+class RFunctionBatch : boost::noncopyable
+{
+public:
+   RFunctionBatch() {}
+
+   // add a call to the batch (parameters may be added to the returned
+   // function until the batch is executed)
+   RFunction& add(const std::string& name)
+   {
+      return add(boost::shared_ptr<RFunction>(new RFunction(name)));
+   }
+
+   template <typename ParamType>
+   RFunction& add(const std::string& name, const ParamType& param)
+   {
+      return add(boost::shared_ptr<RFunction>(new RFunction(name, param)));
+   }
+
+   template <typename Param1Type, typename Param2Type>
+   RFunction& add(const std::string& name,
+                  const Param1Type& param1,
+                  const Param2Type& param2)
+   {
+      return add(boost::shared_ptr<RFunction>(
+                    new RFunction(name, param1, param2)));
+   }
+
+   template <typename Param1Type, typename Param2Type, typename Param3Type>
+   RFunction& add(const std::string& name,
+                  const Param1Type& param1,
+                  const Param2Type& param2,
+                  const Param3Type& param3)
+   {
+      return add(boost::shared_ptr<RFunction>(
+                    new RFunction(name, param1, param2, param3)));
+   }
+
+   // evaluate all calls in the batch. an error is returned only if the
+   // batch as a whole couldn't be evaluated; errors raised by individual
+   // calls are available from error(i)
+   core::Error execute(SEXP evalNS = R_GlobalEnv);
+
+   std::size_t size() const { return functions_.size(); }
+
+   // result of the i'th call (protected for the lifetime of the batch, and
+   // R_NilValue if the call failed)
+   SEXP result(std::size_t i) const { return results_.at(i); }
+   const core::Error& error(std::size_t i) const { return errors_.at(i); }
+
+   template <typename T>
+   core::Error result(std::size_t i, T* pValue) const
+   {
+      if (error(i))
+         return error(i);
+      return sexp::extract(result(i), pValue);
+   }
+
+private:
+   RFunction& add(boost::shared_ptr<RFunction> pFunction)
+   {
+      functions_.push_back(pFunction);
+      return *pFunction;
+   }
+
+private:
+   std::vector<boost::shared_ptr<RFunction> > functions_;
+   std::vector<SEXP> results_;
+   std::vector<core::Error> errors_;
+   sexp::Protect rProtect_;
+};
+
 void warning(const std::string& warning);
    
 void message(const std::string& message);
@@ -24,6 +24,9 @@ namespace rstudio {
 namespace core {
    class Error;
    class FilePath;
+   namespace json {
+      class Writer;
+   }
 }
 }
 
@@ -38,6 +41,11 @@ core::Error jsonValueFromScalar(SEXP scalarSEXP, core::json::Value* pValue);
 core::Error jsonValueFromVector(SEXP vectorSEXP, core::json::Value* pValue);
 core::Error jsonValueFromList(SEXP listSEXP, core::json::Value* pValue);
 core::Error jsonValueFromObject(SEXP objectSEXP, core::json::Value* pValue);
+
+// write the same json as jsonValueFromObject directly to a json::Writer
+// (faster for large vectors and data frames). non-finite reals are written
+// as null. if an error is returned the writer's output is incomplete.
+core::Error writeJsonFromObject(SEXP objectSEXP, core::json::Writer* pWriter);
    
 } // namespace json
 } // namesapce r
@@ -299,6 +299,19 @@ private:
    SEXP sexp_;
 };
 
+// while a LookupCacheScope is active, the results of findVar(name, ns) and
+// findFunction(name, ns) are cached by (name, ns). the session holds one
+// while waiting at the console prompt (when no user code runs) so that the
+// many lookups made by completions and diagnostics resolve each symbol
+// only once. the cache is cleared when the scope ends, when the search path
+// changes, and when a lookup loads a namespace.
+class LookupCacheScope : boost::noncopyable
+{
+public:
+   LookupCacheScope();
+   virtual ~LookupCacheScope();
+};
+
 class ListBuilder : boost::noncopyable
 {
 public:
@@ -352,6 +365,15 @@ core::Error getNamespaceExports(SEXP ns,
 
 const std::set<std::string>& nsePrimitives();
 
+// estimate the memory used by an object (as utils::object.size does, so
+// environments and external pointer targets aren't included). nodes shared
+// between parts of the object are only counted once. if the walk takes
+// longer than the budget then the sizes of the elements which haven't been
+// visited are extrapolated from those which have and pApproximate is set
+double objectSize(SEXP object,
+                  const boost::posix_time::time_duration& budget,
+                  bool* pApproximate);
+
 // NOTE: Primarily to be used with boost::bind, to add functions that are then
 // called on each node within the call. Functions can return true to signal the
 // recursion should end.
@@ -57,6 +57,9 @@ public:
    
    std::vector<std::string> pendingInput() const { return pendingInput_; }
 
+   // approximate bytes held by the actions
+   std::size_t memoryUsage() const;
+
    // reset to all but the last prompt
    void reset();
    
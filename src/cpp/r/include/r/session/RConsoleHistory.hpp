@@ -92,9 +92,6 @@ public:
       return onAdd_.connect(slot);
    }
 
-private:
-   void safeRemove(int index);
-   
 private:   
    bool removeDuplicates_;
    boost::circular_buffer<std::string> historyBuffer_ ;
@@ -149,6 +149,10 @@ public:
    // clear the display (closes the device)
    virtual void clear() = 0;
 
+   // release memory held for rendering (e.g. cached images) which can be
+   // recreated when needed
+   virtual void releaseCachedMemory() = 0;
+
    // subscribe to showManipulator event
    virtual boost::signal<void ()>& onShowManipulator() = 0;
 
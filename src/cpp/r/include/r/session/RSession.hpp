@@ -62,7 +62,8 @@ struct ROptions
          autoReloadSource(false),
          restoreWorkspace(true),
          saveWorkspace(SA_SAVEASK),
-         rProfileOnResume(false)
+         rProfileOnResume(false),
+         lazyResume(false)
    {
    }
    core::FilePath userHomePath;
@@ -85,6 +86,7 @@ struct ROptions
    bool restoreWorkspace;
    SA_TYPE saveWorkspace;
    bool rProfileOnResume;
+   bool lazyResume;
    core::r_util::SessionScope sessionScope;
 };
       
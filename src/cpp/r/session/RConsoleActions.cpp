@@ -61,6 +61,26 @@ int ConsoleActions::capacity() const
    return 0;
 }
 
+std::size_t ConsoleActions::memoryUsage() const
+{
+   LOCK_MUTEX(mutex_)
+   {
+      std::size_t bytes = (actionsType_.capacity() + actionsData_.capacity()) *
+                          sizeof(json::Value);
+      for (boost::circular_buffer<json::Value>::const_iterator it =
+              actionsData_.begin(); it != actionsData_.end(); ++it)
+      {
+         if (it->type() == json::StringType)
+            bytes += it->get_str().capacity();
+      }
+      return bytes;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return 0;
+}
+
 void ConsoleActions::setCapacity(int capacity)
 {
    LOCK_MUTEX(mutex_)
@@ -15,6 +15,8 @@
 
 #include <r/session/RConsoleHistory.hpp>
 
+#include <algorithm>
+
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/tokenizer.hpp>
@@ -105,17 +107,36 @@ void ConsoleHistory::clear()
 
 void ConsoleHistory::remove(const std::vector<int>& indexes)
 {
-   // make a copy and sort descending
+   // make a sorted copy of the valid indexes (without duplicates)
+   int historySize = size();
    std::vector<int> sortedIndexes;
-   std::copy(indexes.begin(),
-             indexes.end(),
-             std::back_inserter(sortedIndexes));
-   std::sort(sortedIndexes.begin(), sortedIndexes.end(),std::greater<int>());
-
-   // remove them all
-   std::for_each(sortedIndexes.begin(),
-                 sortedIndexes.end(),
-                 boost::bind(&ConsoleHistory::safeRemove, this, _1));
+   for (std::vector<int>::const_iterator it = indexes.begin();
+        it != indexes.end();
+        ++it)
+   {
+      if (*it >= 0 && *it < historySize)
+         sortedIndexes.push_back(*it);
+   }
+   std::sort(sortedIndexes.begin(), sortedIndexes.end());
+   sortedIndexes.erase(std::unique(sortedIndexes.begin(), sortedIndexes.end()),
+                       sortedIndexes.end());
+   if (sortedIndexes.empty())
+      return;
+
+   // compact the remaining entries in a single pass (erasing each index in
+   // turn would shift all of the entries after it every time)
+   int target = sortedIndexes.front();
+   std::vector<int>::const_iterator removeIt = sortedIndexes.begin();
+   for (int i = target; i < historySize; i++)
+   {
+      if (removeIt != sortedIndexes.end() && *removeIt == i)
+      {
+         ++removeIt;
+         continue;
+      }
+      historyBuffer_[target++].swap(historyBuffer_[i]);
+   }
+   historyBuffer_.erase_end(historySize - target);
 }
    
 void ConsoleHistory::subset(int beginIndex, // inclusive
@@ -179,12 +200,6 @@ Error ConsoleHistory::saveToFile(const FilePath& filePath) const
                                                       core::stringifyString);
 }
 
-void ConsoleHistory::safeRemove(int index)
-{
-   if (index >= 0 && index < (int)historyBuffer_.size())
-      historyBuffer_.erase(historyBuffer_.begin() + index);
-}
-
 } // namespace session
 } // namespace r
 } // namespace rstudio
@@ -0,0 +1,607 @@
+/*
+ * RObjectStore.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RObjectStore.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/format.hpp>
+#include <boost/utility.hpp>
+
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/ParallelGzip.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RExec.hpp>
+#include <r/RRoutines.hpp>
+#include <r/RSexp.hpp>
+
+using namespace rstudio::core ;
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace object_store {
+
+namespace {
+
+const char * const kIndexFile = "index";
+const char * const kObjectsDir = "objects";
+
+// serialization callbacks. note that R_Serialize and R_Unserialize may
+// longjmp, so these are always invoked via executeSafely and the frames
+// between there and R must not hold C++ objects with destructors
+
+struct HashContext
+{
+   boost::uint64_t hash;
+   boost::uint64_t size;
+};
+
+void hashBytes(R_outpstream_t stream, void* buffer, int length)
+{
+   // 64-bit FNV-1a
+   HashContext* pContext = static_cast<HashContext*>(stream->data);
+   const unsigned char* pBytes = static_cast<const unsigned char*>(buffer);
+   boost::uint64_t hash = pContext->hash;
+   for (int i = 0; i < length; i++)
+   {
+      hash ^= pBytes[i];
+      hash *= 1099511628211ULL;
+   }
+   pContext->hash = hash;
+   pContext->size += length;
+}
+
+void hashChar(R_outpstream_t stream, int c)
+{
+   unsigned char ch = static_cast<unsigned char>(c);
+   hashBytes(stream, &ch, 1);
+}
+
+struct OutputContext
+{
+   ParallelGzipWriter* pWriter;
+   Error error;
+};
+
+void outBytes(R_outpstream_t stream, void* buffer, int length)
+{
+   // record the first error and ignore subsequent writes
+   OutputContext* pContext = static_cast<OutputContext*>(stream->data);
+   if (!pContext->error)
+   {
+      pContext->error = pContext->pWriter->write(
+                                 static_cast<const char*>(buffer), length);
+   }
+}
+
+void outChar(R_outpstream_t stream, int c)
+{
+   char ch = static_cast<char>(c);
+   outBytes(stream, &ch, 1);
+}
+
+struct InputContext
+{
+   ParallelGzipReader* pReader;
+};
+
+bool readBytes(InputContext* pContext, void* buffer, int length)
+{
+   std::size_t read = 0;
+   Error error = pContext->pReader->read(static_cast<char*>(buffer),
+                                         length,
+                                         &read);
+   if (error)
+      LOG_ERROR(error);
+
+   return !error && read == static_cast<std::size_t>(length);
+}
+
+void inBytes(R_inpstream_t stream, void* buffer, int length)
+{
+   // NOTE: no C++ objects may be live in this frame when Rf_error jumps
+   InputContext* pContext = static_cast<InputContext*>(stream->data);
+   if (!readBytes(pContext, buffer, length))
+      Rf_error("Unexpected end of saved object data");
+}
+
+int inChar(R_inpstream_t stream)
+{
+   unsigned char ch;
+   inBytes(stream, &ch, 1);
+   return ch;
+}
+
+void serialize(SEXP objectSEXP, OutputContext* pContext)
+{
+   R_outpstream_st stream;
+   R_InitOutPStream(&stream,
+                    static_cast<R_pstream_data_t>(pContext),
+                    R_pstream_xdr_format,
+                    2,
+                    outChar,
+                    outBytes,
+                    NULL,
+                    R_NilValue);
+   R_Serialize(objectSEXP, &stream);
+}
+
+SEXP unserialize(InputContext* pContext)
+{
+   R_inpstream_st stream;
+   R_InitInPStream(&stream,
+                   static_cast<R_pstream_data_t>(pContext),
+                   R_pstream_any_format,
+                   inChar,
+                   inBytes,
+                   NULL,
+                   R_NilValue);
+   return R_Unserialize(&stream);
+}
+
+Error writeObject(SEXP objectSEXP, const FilePath& filePath, bool compress)
+{
+   ParallelGzipWriter writer;
+   Error error = writer.open(filePath, compress ? 1 : 0);
+   if (error)
+      return error;
+
+   OutputContext context;
+   context.pWriter = &writer;
+   error = exec::executeSafely(boost::bind(serialize, objectSEXP, &context));
+   if (error)
+      return error;
+   if (context.error)
+      return context.error;
+
+   return writer.close();
+}
+
+Error readObject(const FilePath& filePath,
+                 SEXP* pObjectSEXP,
+                 sexp::Protect* pProtect)
+{
+   ParallelGzipReader reader;
+   Error error = reader.open(filePath);
+   if (error)
+      return error;
+
+   InputContext context;
+   context.pReader = &reader;
+   error = exec::executeSafely<SEXP>(boost::bind(unserialize, &context),
+                                     pObjectSEXP);
+   if (error)
+      return error;
+
+   pProtect->add(*pObjectSEXP);
+   return Success();
+}
+
+struct Binding
+{
+   SEXP nameSEXP;
+   SEXP valueSEXP;
+   HashContext hash;
+};
+
+void lookupBinding(SEXP envSEXP, Binding* pBinding)
+{
+   // (evaluates active bindings, which is what save() does as well)
+   SEXP symSEXP = Rf_install(CHAR(pBinding->nameSEXP));
+   SEXP valueSEXP = Rf_findVarInFrame(envSEXP, symSEXP);
+   if (valueSEXP == R_UnboundValue)
+      valueSEXP = R_NilValue;
+   pBinding->valueSEXP = valueSEXP;
+}
+
+void forceBinding(SEXP envSEXP, Binding* pBinding)
+{
+   pBinding->valueSEXP = Rf_eval(pBinding->valueSEXP, envSEXP);
+}
+
+void hashBinding(Binding* pBinding)
+{
+   R_outpstream_st stream;
+   R_InitOutPStream(&stream,
+                    static_cast<R_pstream_data_t>(&pBinding->hash),
+                    R_pstream_xdr_format,
+                    2,
+                    hashChar,
+                    hashBytes,
+                    NULL,
+                    R_NilValue);
+   R_Serialize(pBinding->valueSEXP, &stream);
+}
+
+std::string objectName(const HashContext& hash)
+{
+   return boost::str(boost::format("%016x-%x") % hash.hash % hash.size);
+}
+
+// bindings restored lazily, as promises which read their object from the
+// store when forced. we hold on to the promises so that we can tell which
+// bindings still refer to an unread object (these must not be removed
+// from the store, and need not be serialized again to save them there)
+class LazyBindings : boost::noncopyable
+{
+public:
+   LazyBindings()
+      : envSEXP_(R_NilValue), promisesSEXP_(R_NilValue)
+   {
+   }
+
+   void set(const FilePath& storePath,
+            SEXP envSEXP,
+            SEXP promisesSEXP,
+            const std::vector<std::string>& names,
+            const std::vector<std::string>& objects)
+   {
+      clear();
+      R_PreserveObject(promisesSEXP);
+      storePath_ = storePath;
+      envSEXP_ = envSEXP;
+      promisesSEXP_ = promisesSEXP;
+      objects_ = objects;
+      for (std::size_t i = 0; i < names.size(); i++)
+         indexes_[names[i]] = i;
+   }
+
+   void clear()
+   {
+      if (promisesSEXP_ != R_NilValue)
+         R_ReleaseObject(promisesSEXP_);
+      storePath_ = FilePath();
+      envSEXP_ = R_NilValue;
+      promisesSEXP_ = R_NilValue;
+      objects_.clear();
+      indexes_.clear();
+   }
+
+   const FilePath& storePath() const { return storePath_; }
+   SEXP envSEXP() const { return envSEXP_; }
+
+   std::vector<std::string> names() const
+   {
+      std::vector<std::string> names;
+      for (std::map<std::string,std::size_t>::const_iterator it =
+              indexes_.begin(); it != indexes_.end(); ++it)
+      {
+         names.push_back(it->first);
+      }
+      return names;
+   }
+
+   // is this value the (still unforced) promise created for the binding?
+   bool isPending(const std::string& name,
+                  SEXP valueSEXP,
+                  std::string* pObject) const
+   {
+      std::map<std::string,std::size_t>::const_iterator it =
+                                                   indexes_.find(name);
+      if (it == indexes_.end())
+         return false;
+
+      SEXP promiseSEXP = VECTOR_ELT(promisesSEXP_, it->second);
+      if (promiseSEXP != valueSEXP || PRVALUE(promiseSEXP) != R_UnboundValue)
+         return false;
+
+      if (pObject)
+         *pObject = objects_[it->second];
+      return true;
+   }
+
+private:
+   FilePath storePath_;
+   SEXP envSEXP_;
+   SEXP promisesSEXP_;
+   std::vector<std::string> objects_;
+   std::map<std::string,std::size_t> indexes_;
+};
+
+LazyBindings& lazyBindings()
+{
+   static LazyBindings instance;
+   return instance;
+}
+
+SEXP rs_readStoredObject(SEXP objectPathSEXP)
+{
+   SEXP objectSEXP = R_NilValue;
+   bool read = false;
+   {
+      FilePath objectPath(r::sexp::safeAsString(objectPathSEXP));
+      sexp::Protect rProtect;
+      Error error = readObject(objectPath, &objectSEXP, &rProtect);
+      if (error)
+         LOG_ERROR(error);
+      else
+         read = true;
+   }
+
+   // (raise the error only once the C++ objects above are destroyed)
+   if (!read)
+      Rf_error("Unable to read saved object");
+
+   return objectSEXP;
+}
+
+Error restoreEnvironmentLazily(const FilePath& objectsPath,
+                               SEXP objectsSEXP,
+                               SEXP envSEXP)
+{
+   SEXP namesSEXP = Rf_getAttrib(objectsSEXP, R_NamesSymbol);
+   int n = Rf_length(objectsSEXP);
+
+   std::vector<std::string> names, objects, objectPaths;
+   for (int i = 0; i < n; i++)
+   {
+      names.push_back(CHAR(STRING_ELT(namesSEXP, i)));
+      objects.push_back(CHAR(STRING_ELT(objectsSEXP, i)));
+      objectPaths.push_back(objectsPath.complete(objects.back())
+                                                         .absolutePath());
+   }
+
+   // bind each name to a promise which reads its object
+   Error error = exec::RFunction(".rs.delayedAssignStoredObjects",
+                                 namesSEXP,
+                                 objectPaths,
+                                 envSEXP).call();
+   if (error)
+      return error;
+
+   sexp::Protect rProtect;
+   SEXP promisesSEXP = Rf_allocVector(VECSXP, n);
+   rProtect.add(promisesSEXP);
+   for (int i = 0; i < n; i++)
+   {
+      SEXP symSEXP = Rf_install(names[i].c_str());
+      SET_VECTOR_ELT(promisesSEXP, i, Rf_findVarInFrame(envSEXP, symSEXP));
+   }
+
+   lazyBindings().set(objectsPath.parent(),
+                      envSEXP,
+                      promisesSEXP,
+                      names,
+                      objects);
+   return Success();
+}
+
+} // anonymous namespace
+
+void initialize()
+{
+   r::routines::registerCallMethod(
+            "rs_readStoredObject",
+            (DL_FUNC) rs_readStoredObject,
+            1);
+}
+
+bool hasEnvironment(const FilePath& storePath)
+{
+   return storePath.complete(kIndexFile).exists();
+}
+
+Error saveEnvironment(SEXP envSEXP, const FilePath& storePath, bool compress)
+{
+   FilePath objectsPath = storePath.complete(kObjectsDir);
+   Error error = objectsPath.ensureDirectory();
+   if (error)
+      return error;
+
+   sexp::Protect rProtect;
+   SEXP namesSEXP;
+   error = exec::executeSafely<SEXP>(
+                     boost::bind(R_lsInternal, envSEXP, TRUE), &namesSEXP);
+   if (error)
+      return error;
+   rProtect.add(namesSEXP);
+
+   int n = Rf_length(namesSEXP);
+   SEXP objectsSEXP = Rf_allocVector(STRSXP, n);
+   rProtect.add(objectsSEXP);
+   Rf_setAttrib(objectsSEXP, R_NamesSymbol, namesSEXP);
+
+   const LazyBindings& lazy = lazyBindings();
+   bool sameStore = lazy.envSEXP() == envSEXP &&
+                    lazy.storePath().absolutePath() == storePath.absolutePath();
+
+   std::set<std::string> objects;
+   for (int i = 0; i < n; i++)
+   {
+      Binding binding;
+      binding.nameSEXP = STRING_ELT(namesSEXP, i);
+      binding.valueSEXP = R_NilValue;
+      binding.hash.hash = 14695981039346656037ULL;
+      binding.hash.size = 0;
+      error = exec::executeSafely(boost::bind(lookupBinding,
+                                              envSEXP, &binding));
+      if (error)
+         return error;
+      sexp::Protect valueProtect(binding.valueSEXP);
+
+      // bindings which were lazily restored from this store and haven't
+      // been read yet are already saved (if saving elsewhere, read them)
+      std::string name;
+      bool pending = lazy.envSEXP() == envSEXP &&
+                     lazy.isPending(CHAR(binding.nameSEXP),
+                                    binding.valueSEXP,
+                                    &name);
+      if (pending && sameStore)
+      {
+         SET_STRING_ELT(objectsSEXP, i, Rf_mkChar(name.c_str()));
+         objects.insert(name);
+         continue;
+      }
+      else if (pending)
+      {
+         error = exec::executeSafely(boost::bind(forceBinding,
+                                                 envSEXP, &binding));
+         if (error)
+            return error;
+         valueProtect.add(binding.valueSEXP);
+      }
+
+      // hash the serialized binding without keeping the serialization
+      error = exec::executeSafely(boost::bind(hashBinding, &binding));
+      if (error)
+         return error;
+
+      // only write objects which aren't already in the store
+      name = objectName(binding.hash);
+      FilePath objectPath = objectsPath.complete(name);
+      if (!objectPath.exists())
+      {
+         FilePath tempPath = objectsPath.complete(name + ".tmp");
+         error = writeObject(binding.valueSEXP, tempPath, compress);
+         if (!error)
+            error = tempPath.move(objectPath);
+         if (error)
+         {
+            Error removeError = tempPath.removeIfExists();
+            if (removeError)
+               LOG_ERROR(removeError);
+            return error;
+         }
+      }
+
+      SET_STRING_ELT(objectsSEXP, i, Rf_mkChar(name.c_str()));
+      objects.insert(name);
+   }
+
+   // replace the index (only after all of the objects it names are written)
+   FilePath indexPath = storePath.complete(kIndexFile);
+   FilePath tempIndexPath = storePath.complete(std::string(kIndexFile) +
+                                               ".tmp");
+   error = writeObject(objectsSEXP, tempIndexPath, compress);
+   if (error)
+      return error;
+   error = tempIndexPath.move(indexPath);
+   if (error)
+      return error;
+
+   // remove objects which are no longer referenced
+   std::vector<FilePath> children;
+   error = objectsPath.children(&children);
+   if (error)
+      LOG_ERROR(error);
+   for (std::vector<FilePath>::const_iterator it = children.begin();
+        it != children.end();
+        ++it)
+   {
+      if (objects.find(it->filename()) == objects.end())
+      {
+         Error removeError = it->remove();
+         if (removeError)
+            LOG_ERROR(removeError);
+      }
+   }
+
+   return Success();
+}
+
+Error restoreEnvironment(const FilePath& storePath, SEXP envSEXP, bool lazy)
+{
+   sexp::Protect rProtect;
+   SEXP objectsSEXP;
+   Error error = readObject(storePath.complete(kIndexFile),
+                            &objectsSEXP,
+                            &rProtect);
+   if (error)
+      return error;
+
+   SEXP namesSEXP = Rf_getAttrib(objectsSEXP, R_NamesSymbol);
+   if (TYPEOF(objectsSEXP) != STRSXP || TYPEOF(namesSEXP) != STRSXP)
+   {
+      error = systemError(boost::system::errc::illegal_byte_sequence,
+                          ERROR_LOCATION);
+      error.addProperty("file", storePath.complete(kIndexFile));
+      return error;
+   }
+
+   FilePath objectsPath = storePath.complete(kObjectsDir);
+   if (lazy)
+      return restoreEnvironmentLazily(objectsPath, objectsSEXP, envSEXP);
+
+   // restore as many bindings as we can, returning the first error
+   Error restoreError;
+   for (int i = 0; i < Rf_length(objectsSEXP); i++)
+   {
+      std::string name = CHAR(STRING_ELT(objectsSEXP, i));
+      sexp::Protect valueProtect;
+      SEXP valueSEXP;
+      error = readObject(objectsPath.complete(name),
+                         &valueSEXP,
+                         &valueProtect);
+      if (error)
+      {
+         error.addProperty("binding", CHAR(STRING_ELT(namesSEXP, i)));
+         LOG_ERROR(error);
+         if (!restoreError)
+            restoreError = error;
+         continue;
+      }
+
+      SEXP symSEXP = Rf_install(CHAR(STRING_ELT(namesSEXP, i)));
+      Rf_defineVar(symSEXP, valueSEXP, envSEXP);
+   }
+
+   return restoreError;
+}
+
+void forceLazyBindings()
+{
+   LazyBindings& lazy = lazyBindings();
+   if (lazy.envSEXP() == R_NilValue)
+      return;
+
+   std::vector<std::string> names = lazy.names();
+   for (std::vector<std::string>::const_iterator it = names.begin();
+        it != names.end();
+        ++it)
+   {
+      Binding binding;
+      binding.nameSEXP = Rf_mkChar(it->c_str());
+      sexp::Protect nameProtect(binding.nameSEXP);
+      binding.valueSEXP = R_NilValue;
+      Error error = exec::executeSafely(boost::bind(lookupBinding,
+                                                    lazy.envSEXP(),
+                                                    &binding));
+      if (!error && lazy.isPending(*it, binding.valueSEXP, NULL))
+      {
+         error = exec::executeSafely(boost::bind(forceBinding,
+                                                 lazy.envSEXP(),
+                                                 &binding));
+      }
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   lazy.clear();
+}
+
+} // namespace object_store
+} // namespace session
+} // namespace r
+} // namespace rstudio
@@ -0,0 +1,67 @@
+/*
+ * RObjectStore.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_SESSION_OBJECT_STORE_HPP
+#define R_SESSION_OBJECT_STORE_HPP
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FilePath;
+}
+}
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace object_store {
+
+// Content addressed store for the bindings of an environment. Each binding
+// is serialized to its own file, named by a hash of its serialization, and
+// an index maps binding names to those files. Saving into an existing store
+// only writes objects which are new or have changed, and objects no longer
+// referenced by the index are removed.
+//
+// NOTE: since bindings are serialized separately, objects shared between
+// bindings (e.g. an environment referenced by two bindings) are restored
+// as distinct copies.
+
+void initialize();
+
+bool hasEnvironment(const core::FilePath& storePath);
+
+core::Error saveEnvironment(SEXP envSEXP,
+                            const core::FilePath& storePath,
+                            bool compress);
+
+// when lazy is true, each binding is restored as a promise which reads its
+// object from the store the first time it's accessed
+core::Error restoreEnvironment(const core::FilePath& storePath,
+                               SEXP envSEXP,
+                               bool lazy = false);
+
+// read any lazily restored bindings which haven't been accessed yet (this
+// must be done before the store is removed or the environment is saved by
+// anything other than saveEnvironment)
+void forceLazyBindings();
+
+} // namespace object_store
+} // namespace session
+} // namespace r
+} // namespace rstudio
+
+#endif // R_SESSION_OBJECT_STORE_HPP
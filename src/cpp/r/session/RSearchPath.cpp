@@ -20,6 +20,7 @@
 //
 
 #include "RSearchPath.hpp"
+#include "RObjectStore.hpp"
 
 #include <string>
 #include <vector>
@@ -55,6 +56,7 @@ namespace search_path {
 namespace {   
 
 const char * const kEnvironmentFile = "environment";
+const char * const kEnvironmentStoreDir = "environment_store";
 const char * const kSearchPathDir = "search_path";
    
 const char * const kSearchPathElementsDir = "search_path_elements";
@@ -80,16 +82,28 @@ void reportRestoreError(const std::string& context,
    REprintf(report.c_str());
 }   
    
-Error saveGlobalEnvironmentToFile(const FilePath& environmentFile)
+Error saveGlobalEnvironmentToStore(const FilePath& statePath, bool compress)
 {
-   std::string envPath =
-            string_utils::utf8ToSystem(environmentFile.absolutePath());
-   return executeSafely(boost::bind(R_SaveGlobalEnvToFile, envPath.c_str()));
+   // only objects which changed since the last save are written
+   Error error = object_store::saveEnvironment(
+                                    R_GlobalEnv,
+                                    statePath.complete(kEnvironmentStoreDir),
+                                    compress);
+   if (error)
+      return error;
+
+   // remove any environment file written by a previous version
+   return statePath.complete(kEnvironmentFile).removeIfExists();
 }
    
-Error restoreGlobalEnvironment(const core::FilePath& environmentFile)
+Error restoreGlobalEnvironment(const core::FilePath& statePath, bool lazy)
 {
+   FilePath storePath = statePath.complete(kEnvironmentStoreDir);
+   if (object_store::hasEnvironment(storePath))
+      return object_store::restoreEnvironment(storePath, R_GlobalEnv, lazy);
+
    // tolerate no environment saved
+   FilePath environmentFile = statePath.complete(kEnvironmentFile);
    if (!environmentFile.exists())
       return Success();
    
@@ -226,11 +240,10 @@ void attachEnvironmentData(const FilePath& dataFilePath,
 } // anonymous namespace
    
 
-Error save(const FilePath& statePath)
+Error save(const FilePath& statePath, bool compress)
 {
    // save the global environment
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   Error error = saveGlobalEnvironmentToFile(environmentFile);
+   Error error = saveGlobalEnvironmentToStore(statePath, compress);
    if (error)
       return error;
    
@@ -320,17 +333,15 @@ Error save(const FilePath& statePath)
 }
 
 
-Error saveGlobalEnvironment(const FilePath& statePath)
+Error saveGlobalEnvironment(const FilePath& statePath, bool compress)
 {
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   return saveGlobalEnvironmentToFile(environmentFile);
+   return saveGlobalEnvironmentToStore(statePath, compress);
 }
 
-Error restore(const FilePath& statePath)
+Error restore(const FilePath& statePath, bool lazy)
 {
    // restore global environment
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   Error error = restoreGlobalEnvironment(environmentFile);
+   Error error = restoreGlobalEnvironment(statePath, lazy);
    if (error)
       return error;
    
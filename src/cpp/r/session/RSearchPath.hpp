@@ -28,9 +28,14 @@ namespace r {
 namespace session {
 namespace search_path {
 
-core::Error save(const core::FilePath& statePath);
-core::Error saveGlobalEnvironment(const core::FilePath& statePath);
-core::Error restore(const core::FilePath& statePath);
+// the global environment is written to an incremental object store (pass
+// compress = false to store objects uncompressed)
+core::Error save(const core::FilePath& statePath, bool compress = true);
+core::Error saveGlobalEnvironment(const core::FilePath& statePath,
+                                  bool compress = true);
+// pass lazy = true to read global environment objects on first access
+// (the state must then be kept until object_store::forceLazyBindings)
+core::Error restore(const core::FilePath& statePath, bool lazy = false);
    
 } // namespace search_path
 } // namespace session
@@ -33,6 +33,7 @@
 #include <core/FileUtils.hpp>
 #include <core/http/Util.hpp>
 
+#include <r/RSexp.hpp>
 #include <r/RExec.hpp>
 #include <r/RUtil.hpp>
 #include <r/RErrorCategory.hpp>
@@ -49,6 +50,7 @@
 
 #include "RClientMetrics.hpp"
 #include "RSessionState.hpp"
+#include "RObjectStore.hpp"
 #include "RRestartContext.hpp"
 #include "REmbedded.hpp"
 
@@ -253,6 +255,9 @@ Error saveDefaultGlobalEnvironment()
    // suppress interrupts which occur during saving
    r::exec::IgnoreInterruptsScope ignoreInterrupts;
          
+   // read any objects not yet restored from the suspended session
+   object_store::forceLazyBindings();
+
    // save global environment
    std::string path = string_utils::utf8ToSystem(globalEnvPath.absolutePath());
    Error error = r::exec::executeSafely(
@@ -345,6 +350,7 @@ const int kSerializationActionResumeSession = 4;
 const int kSerializationActionCompleted = 5;
 
 void restoreSession(const FilePath& suspendedSessionPath,
+                    bool lazyGlobalEnvironment,
                     std::string* pErrorMessages)
 {
    // don't show output during deserialization (packages loaded
@@ -359,6 +365,7 @@ void restoreSession(const FilePath& suspendedSessionPath,
    boost::function<Error()> deferredRestoreAction;
    r::session::state::restore(suspendedSessionPath,
                               s_options.serverMode,
+                              lazyGlobalEnvironment,
                               &deferredRestoreAction,
                               pErrorMessages);
 
@@ -446,7 +453,10 @@ Error initialize()
    {
       // restore session
       std::string errorMessages ;
-      restoreSession(restartContext().sessionStatePath(), &errorMessages);
+      // (the restart state is removed once restored, so no lazy restore)
+      restoreSession(restartContext().sessionStatePath(),
+                     false,
+                     &errorMessages);
 
       // show any error messages
       if (!errorMessages.empty())
@@ -459,7 +469,9 @@ Error initialize()
    {  
       // restore session
       std::string errorMessages ;
-      restoreSession(s_suspendedSessionPath, &errorMessages);
+      restoreSession(s_suspendedSessionPath,
+                     s_options.lazyResume,
+                     &errorMessages);
       
       // show any error messages
       if (!errorMessages.empty())
@@ -709,10 +721,16 @@ int RReadConsole (const char *pmt,
       std::string promptString(prompt);
       promptString = util::rconsole2utf8(promptString);
 
-      // get the next input
+      // get the next input. no user code runs while we wait, so the lookups
+      // made by completions, diagnostics etc. can share a lookup cache
       bool addToHistory = (hist == 1);
       RConsoleInput consoleInput;
-      if ( s_callbacks.consoleRead(promptString, addToHistory, &consoleInput) )
+      bool read;
+      {
+         r::sexp::LookupCacheScope lookupCacheScope;
+         read = s_callbacks.consoleRead(promptString, addToHistory, &consoleInput);
+      }
+      if (read)
       {
          // add prompt to console actions (we do this after consoleRead
          // completes so that we don't send both a console prompt event
@@ -1250,6 +1268,7 @@ void RCleanUp(SA_TYPE saveact, int status, int runLast)
          // data loss when the previous session is read rather than the
          // contents of .RData. therefore, we refuse to quit if we can't
          // successfully destroy the suspended session
+         object_store::forceLazyBindings();
          if (!r::session::state::destroy(s_suspendedSessionPath))
          {
             // this will cause us to jump back to the REPL loop
@@ -1400,6 +1419,9 @@ Error run(const ROptions& options, const RCallbacks& callbacks)
    restartContext().initialize(s_options.scopedScratchPath,
                                s_options.sessionPort);
 
+   // register object store methods
+   object_store::initialize();
+
    // register browseURL method
    R_CallMethodDef browseURLMethod ;
    browseURLMethod.name = "rs_browseURL";
@@ -366,7 +366,7 @@ bool save(const FilePath& statePath,
 
    if (!excludePackages)
    {
-      error = search_path::save(statePath);
+      error = search_path::save(statePath, !disableSaveCompression);
       if (error)
       {
          reportError(kSaving, kSearchPath, error, ERROR_LOCATION);
@@ -375,7 +375,8 @@ bool save(const FilePath& statePath,
    }
    else
    {
-      error = search_path::saveGlobalEnvironment(statePath);
+      error = search_path::saveGlobalEnvironment(statePath,
+                                                 !disableSaveCompression);
       if (error)
       {
          reportError(kSaving, kGlobalEnvironment, error, ERROR_LOCATION);
@@ -416,7 +417,7 @@ bool saveMinimal(const core::FilePath& statePath,
       if (error)
          LOG_ERROR(error);
 
-      error = search_path::saveGlobalEnvironment(statePath);
+      error = search_path::saveGlobalEnvironment(statePath, false);
       if (error)
       {
          reportError(kSaving, kGlobalEnvironment, error, ERROR_LOCATION);
@@ -459,10 +460,12 @@ bool packratModeEnabled(const core::FilePath& statePath)
    return getBoolSetting(statePath, kPackratModeOn, false);
 }
 
-Error deferredRestore(const FilePath& statePath, bool serverMode)
+Error deferredRestore(const FilePath& statePath,
+                      bool serverMode,
+                      bool lazyGlobalEnvironment)
 {
    // search path
-   Error error = search_path::restore(statePath);
+   Error error = search_path::restore(statePath, lazyGlobalEnvironment);
    if (error)
       return error;
 
@@ -484,6 +487,7 @@ Error deferredRestore(const FilePath& statePath, bool serverMode)
    
 bool restore(const FilePath& statePath,
              bool serverMode,
+             bool lazyGlobalEnvironment,
              boost::function<Error()>* pDeferredRestoreAction,
              std::string* pErrorMessages)
 {
@@ -554,7 +558,9 @@ bool restore(const FilePath& statePath,
    // to bring their UI up and then receive an event indicating that the
    // latent deserialization actions are taking place
    *pDeferredRestoreAction = boost::bind(deferredRestore,
-                                             statePath, serverMode);
+                                             statePath,
+                                             serverMode,
+                                             lazyGlobalEnvironment);
    
    // return true if there were no error messages
    return pErrorMessages->empty();
@@ -46,8 +46,11 @@ bool rProfileOnRestore(const core::FilePath& statePath);
 
 bool packratModeEnabled(const core::FilePath& statePath);
 
+// lazyGlobalEnvironment restores global environment objects on first
+// access (see search_path::restore)
 bool restore(const core::FilePath& statePath, 
              bool serverMode,
+             bool lazyGlobalEnvironment,
              boost::function<core::Error()>* pDeferredRestoreAction,
              std::string* pErrorMessages); 
    
@@ -14,6 +14,9 @@
  */
 
 #include "RGraphicsPlot.hpp"
+#include "RGraphicsDevice.hpp"
+#include "RGraphicsPlotImageCache.hpp"
+#include "RGraphicsSnapshotStore.hpp"
 
 #include <iostream>
 
@@ -21,6 +24,7 @@
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
+#include <core/FilePath.hpp>
 
 #include <core/system/System.hpp>
 #include <core/StringUtils.hpp>
@@ -41,6 +45,8 @@ Plot::Plot(const GraphicsDeviceFunctions& graphicsDevice,
    : graphicsDevice_(graphicsDevice), 
      baseDirPath_(baseDirPath),
      needsUpdate_(false),
+     contentChanged_(true),
+     lastUsed_(boost::posix_time::not_a_date_time),
      manipulator_(manipulatorSEXP)
 {
 }
@@ -54,12 +60,15 @@ Plot::Plot(const GraphicsDeviceFunctions& graphicsDevice,
      storageUuid_(storageUuid),
      renderedSize_(renderedSize),
      needsUpdate_(false),
+     contentId_(storageUuid),
+     contentChanged_(false),
+     lastUsed_(boost::posix_time::not_a_date_time),
      manipulator_()
 {
    // invalidate if the image file doesn't exist (allows the server
    // to migrate between different image backends e.g. png, jpeg, etc)
    if (!imageFilePath(storageUuid_).exists())
-      invalidate();
+      invalidate(false);
 } 
    
 std::string Plot::storageUuid() const
@@ -72,9 +81,16 @@ bool Plot::hasValidStorage() const
    return hasStorage() && snapshotFilePath().exists();
 }
 
-void Plot::invalidate()
+std::string Plot::contentId() const
+{
+   return contentChanged_ ? std::string() : contentId_;
+}
+
+void Plot::invalidate(bool contentChanged)
 {
    needsUpdate_ = true;
+   if (contentChanged)
+      contentChanged_ = true;
 }
 
 bool Plot::hasManipulator() const
@@ -121,6 +137,8 @@ void Plot::saveManipulator() const
    
 Error Plot::renderFromDisplay()
 {
+   lastUsed_ = boost::posix_time::microsec_clock::universal_time();
+
    // we can use our cached representation if we don't need an update and our 
    // rendered size is the same as the current graphics device size
    if ( !needsUpdate_ &&
@@ -131,15 +149,54 @@ Error Plot::renderFromDisplay()
     
    // generate a new storage uuid
    std::string storageUuid = core::system::generateUuid();
-   
+
+   // if only the size has changed we may have rendered the same content at
+   // this size before, in which case we can reuse that image (and our
+   // existing snapshot) rather than replaying the display list
+   DisplaySize displaySize = graphicsDevice_.displaySize();
+   PlotImageKey imageKey(contentId_,
+                         "display." + graphicsDevice_.imageFileExtension(),
+                         displaySize.width,
+                         displaySize.height,
+                         static_cast<int>(device::devicePixelRatio() * 100));
+   bool cached = !contentChanged_ &&
+                 hasValidStorage() &&
+                 plotImageCache().get(imageKey, imageFilePath(storageUuid));
+   if (cached)
+   {
+      Error error = linkOrCopyFile(snapshotFilePath(),
+                                   snapshotFilePath(storageUuid));
+      if (error)
+      {
+         LOG_ERROR(error);
+         cached = false;
+      }
+   }
+
    // generate snapshot and image files
-   Error error = graphicsDevice_.saveSnapshot(snapshotFilePath(storageUuid),
-                                              imageFilePath(storageUuid));
-   if (error)
-      return Error(errc::PlotRenderingError, error, ERROR_LOCATION);
-   
+   if (!cached)
+   {
+      Error error = graphicsDevice_.saveSnapshot(snapshotFilePath(storageUuid),
+                                                 imageFilePath(storageUuid));
+      if (error)
+         return Error(errc::PlotRenderingError, error, ERROR_LOCATION);
+
+      // share storage with any identical snapshot
+      snapshotStore().add(snapshotFilePath(storageUuid));
+
+      // new content gets a new id
+      if (contentChanged_)
+      {
+         contentId_ = storageUuid;
+         contentChanged_ = false;
+         imageKey.contentId = contentId_;
+      }
+
+      plotImageCache().put(imageKey, imageFilePath(storageUuid));
+   }
+
    // save rendered size
-   renderedSize_ = graphicsDevice_.displaySize();
+   renderedSize_ = displaySize;
    
    // save manipulator (if any)
    saveManipulator(storageUuid);
@@ -165,14 +222,8 @@ Error Plot::renderFromDisplaySnapshot(SEXP snapshot)
 
    // generate a new storage uuid
    std::string storageUuid = core::system::generateUuid();
- 
-   // generate snapshot file
-   FilePath snapshotFile = snapshotFilePath(storageUuid);
-   Error error = r::exec::RFunction(".rs.saveGraphicsSnapshot",
-                                    snapshot,
-                                    string_utils::utf8ToSystem(snapshotFile.absolutePath())).call();
-   if (error)
-      return error ;
+
+   lastUsed_ = boost::posix_time::microsec_clock::universal_time();
 
    //
    // we can't generate an image file at this point in the processing
@@ -184,6 +235,10 @@ Error Plot::renderFromDisplaySnapshot(SEXP snapshot)
    // save rendered size
    renderedSize_ = graphicsDevice_.displaySize();
 
+   // the snapshot is now our content
+   contentId_ = storageUuid;
+   contentChanged_ = false;
+
    // save manipulator (if any)
    saveManipulator(storageUuid);
 
@@ -193,10 +248,34 @@ Error Plot::renderFromDisplaySnapshot(SEXP snapshot)
    // update state
    storageUuid_ = storageUuid;
    needsUpdate_ = true;
+
+   // hold on to the snapshot rather than writing it now: loops which draw
+   // many pages would otherwise spend much of their time serializing
+   // snapshots, most of which are dropped from the history unseen
+   pendingSnapshot_.set(snapshot);
    
    // return error status
    return removeError;
 }
+
+Error Plot::savePendingSnapshot()
+{
+   if (!hasPendingSnapshot())
+      return Success();
+
+   // write the snapshot (releasing it even if this fails, since an
+   // unwritable snapshot won't become writable later)
+   FilePath snapshotFile = snapshotFilePath();
+   Error error = r::exec::RFunction(".rs.saveGraphicsSnapshot",
+                                    pendingSnapshot_.get(),
+                                    string_utils::utf8ToSystem(snapshotFile.absolutePath())).call();
+   pendingSnapshot_.releaseNow();
+   if (error)
+      return error;
+
+   snapshotStore().add(snapshotFile);
+   return Success();
+}
    
 
 std::string Plot::imageFilename() const
@@ -206,7 +285,11 @@ std::string Plot::imageFilename() const
 
 Error Plot::renderToDisplay()
 {
-   Error error = graphicsDevice_.restoreSnapshot(snapshotFilePath());
+   lastUsed_ = boost::posix_time::microsec_clock::universal_time();
+
+   Error error = savePendingSnapshot();
+   if (!error)
+      error = graphicsDevice_.restoreSnapshot(snapshotFilePath());
    if (error)
    {
       Error graphicsError(errc::PlotRenderingError, error, ERROR_LOCATION);
@@ -221,6 +304,9 @@ Error Plot::renderToDisplay()
    
 Error Plot::removeFiles()
 {
+   // an unwritten snapshot is simply dropped
+   pendingSnapshot_.releaseNow();
+
    // bail if we don't have any storage
    if (storageUuid_.empty())
       return Success();
@@ -239,6 +325,23 @@ Error Plot::removeFiles()
       return Success();
 }
 
+boost::uintmax_t Plot::storageSize() const
+{
+   if (!hasStorage())
+      return 0;
+
+   boost::uintmax_t size = 0;
+   FilePath files[] = { snapshotFilePath(storageUuid_),
+                        imageFilePath(storageUuid_),
+                        manipulatorFilePath(storageUuid_) };
+   for (std::size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i)
+   {
+      if (files[i].exists())
+         size += files[i].size();
+   }
+   return size;
+}
+
 void Plot::purgeInMemoryResources()
 {
    manipulator_.clear();
@@ -18,7 +18,9 @@
 
 #include <string>
 
+#include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/FilePath.hpp>
 
@@ -58,15 +60,35 @@ public:
    bool hasValidStorage() const;
    const DisplaySize& renderedSize() const { return renderedSize_; }
 
+   // when the plot was last rendered (not_a_date_time if it hasn't been
+   // rendered since it was restored)
+   const boost::posix_time::ptime& lastUsed() const { return lastUsed_; }
+
+   // bytes used by the plot's files (snapshots shared with other plots
+   // are counted by each of them)
+   boost::uintmax_t storageSize() const;
+
+   // identifies the display list last rendered (unchanged by resizing, so
+   // it can key cached renderings). empty if the content has changed since
+   std::string contentId() const;
+
    bool hasManipulator() const;
    SEXP manipulatorSEXP() const;
    void manipulatorAsJson(core::json::Value* pValue) const;
    void saveManipulator() const;
    
-   void invalidate();
+   // contentChanged is false if only the display size changed
+   void invalidate(bool contentChanged = true);
    
    core::Error renderFromDisplay();
    core::Error renderFromDisplaySnapshot(SEXP snapshot);
+
+   // snapshots taken when the device moves on to a new page are held in
+   // memory until the plot is displayed or persisted (so that pages which
+   // are superseded and dropped from the history are never written)
+   bool hasPendingSnapshot() const { return !pendingSnapshot_.isNil(); }
+   core::Error savePendingSnapshot();
+
    std::string imageFilename() const;
    
    core::Error renderToDisplay();
@@ -93,6 +115,10 @@ private:
    std::string storageUuid_ ;
    DisplaySize renderedSize_ ;
    bool needsUpdate_;
+   std::string contentId_;
+   bool contentChanged_;
+   boost::posix_time::ptime lastUsed_;
+   r::sexp::PreservedSEXP pendingSnapshot_;
 
    // manipulator and protection scope for it
    mutable PlotManipulator manipulator_;
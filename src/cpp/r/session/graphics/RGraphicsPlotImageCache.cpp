@@ -0,0 +1,205 @@
+/*
+ * RGraphicsPlotImageCache.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RGraphicsPlotImageCache.hpp"
+
+#include <boost/format.hpp>
+
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/system/System.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace graphics {
+
+namespace {
+
+// images on disk
+const boost::uintmax_t kDiskBudget = 128 * 1024 * 1024;
+
+// images in memory (and the largest image we'll hold in memory)
+const boost::uintmax_t kMemoryBudget = 32 * 1024 * 1024;
+const boost::uintmax_t kMaxMemoryImageSize = 8 * 1024 * 1024;
+
+std::string keyString(const PlotImageKey& key)
+{
+   return boost::str(boost::format("%1%:%2%:%3%x%4%:%5%") %
+                     key.contentId % key.format %
+                     key.width % key.height % key.res);
+}
+
+} // anonymous namespace
+
+PlotImageCache& plotImageCache()
+{
+   static PlotImageCache instance;
+   return instance;
+}
+
+PlotImageCache::PlotImageCache()
+   : memoryUsed_(0), diskUsed_(0)
+{
+}
+
+void PlotImageCache::initialize(const FilePath& cachePath)
+{
+   clear();
+   cachePath_ = cachePath;
+
+   // remove images left by a previous session
+   Error error = cachePath_.removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+}
+
+bool PlotImageCache::get(const PlotImageKey& key, const FilePath& targetPath)
+{
+   boost::unordered_map<std::string, Entries::iterator>::iterator it =
+                                                index_.find(keyString(key));
+   if (it == index_.end())
+      return false;
+
+   // move to the front of the lru list
+   Entries::iterator entryIt = it->second;
+   entries_.splice(entries_.begin(), entries_, entryIt);
+
+   Error error;
+   if (!entryIt->contents.empty())
+   {
+      error = writeStringToFile(targetPath, entryIt->contents);
+   }
+   else
+   {
+      Error removeError = targetPath.removeIfExists();
+      if (removeError)
+         LOG_ERROR(removeError);
+      error = entryIt->filePath.copy(targetPath);
+   }
+
+   // (the cache directory may have been removed underneath us)
+   if (error)
+   {
+      if (!isPathNotFoundError(error))
+         LOG_ERROR(error);
+      remove(entryIt);
+      return false;
+   }
+
+   return true;
+}
+
+void PlotImageCache::put(const PlotImageKey& key, const FilePath& imagePath)
+{
+   if (cachePath_.empty())
+      return;
+
+   boost::uintmax_t size = imagePath.size();
+   if (size == 0 || size > kDiskBudget / 4)
+      return;
+
+   // replace any existing entry
+   std::string keyStr = keyString(key);
+   boost::unordered_map<std::string, Entries::iterator>::iterator it =
+                                                         index_.find(keyStr);
+   if (it != index_.end())
+      remove(it->second);
+
+   Error error = cachePath_.ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   Entry entry;
+   entry.key = keyStr;
+   entry.filePath = cachePath_.complete(core::system::generateUuid() +
+                                        imagePath.extension());
+   entry.size = size;
+   error = imagePath.copy(entry.filePath);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   if (size <= kMaxMemoryImageSize)
+   {
+      error = readStringFromFile(imagePath, &entry.contents);
+      if (error)
+      {
+         LOG_ERROR(error);
+         entry.contents.clear();
+      }
+   }
+
+   entries_.push_front(entry);
+   index_[keyStr] = entries_.begin();
+   diskUsed_ += entry.size;
+   memoryUsed_ += entry.contents.size();
+
+   enforceBudgets();
+}
+
+void PlotImageCache::clear()
+{
+   while (!entries_.empty())
+      remove(entries_.begin());
+}
+
+void PlotImageCache::releaseMemory()
+{
+   for (Entries::iterator it = entries_.begin(); it != entries_.end(); ++it)
+      std::string().swap(it->contents);
+   memoryUsed_ = 0;
+}
+
+void PlotImageCache::remove(Entries::iterator it)
+{
+   Error error = it->filePath.removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+
+   diskUsed_ -= it->size;
+   memoryUsed_ -= it->contents.size();
+   index_.erase(it->key);
+   entries_.erase(it);
+}
+
+void PlotImageCache::enforceBudgets()
+{
+   // drop the in-memory copies of the least recently used images
+   for (Entries::reverse_iterator it = entries_.rbegin();
+        it != entries_.rend() && memoryUsed_ > kMemoryBudget;
+        ++it)
+   {
+      memoryUsed_ -= it->contents.size();
+      std::string().swap(it->contents);
+   }
+
+   // remove the least recently used images
+   while (diskUsed_ > kDiskBudget && !entries_.empty())
+      remove(--entries_.end());
+}
+
+} // namespace graphics
+} // namespace session
+} // namespace r
+} // namespace rstudio
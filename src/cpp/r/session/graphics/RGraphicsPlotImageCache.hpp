@@ -0,0 +1,111 @@
+/*
+ * RGraphicsPlotImageCache.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_SESSION_GRAPHICS_PLOT_IMAGE_CACHE_HPP
+#define R_SESSION_GRAPHICS_PLOT_IMAGE_CACHE_HPP
+
+#include <list>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility.hpp>
+
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace graphics {
+
+// identifies a rendering of a plot: the content id names the display list
+// the image was rendered from (see Plot::contentId) and the remaining
+// fields describe how it was rendered
+struct PlotImageKey
+{
+   PlotImageKey(const std::string& contentId,
+                const std::string& format,
+                int width,
+                int height,
+                int res)
+      : contentId(contentId), format(format),
+        width(width), height(height), res(res)
+   {
+   }
+
+   std::string contentId;
+   std::string format;
+   int width;
+   int height;
+   int res;
+};
+
+// singleton
+class PlotImageCache;
+PlotImageCache& plotImageCache();
+
+// LRU cache of rendered plot images, so that re-rendering a plot at a size
+// (and in a format) it has already been rendered at doesn't require the
+// display list to be replayed. images are kept on disk within a disk
+// budget, and the most recently used are also kept in memory
+class PlotImageCache : boost::noncopyable
+{
+private:
+   PlotImageCache();
+   friend PlotImageCache& plotImageCache();
+
+public:
+   // COPYING: boost::noncopyable
+
+   void initialize(const core::FilePath& cachePath);
+
+   // write the cached image to targetPath (returns false if not cached)
+   bool get(const PlotImageKey& key, const core::FilePath& targetPath);
+
+   // add a copy of the image at imagePath to the cache
+   void put(const PlotImageKey& key, const core::FilePath& imagePath);
+
+   void clear();
+
+   // drop the in-memory copies of images (they remain on disk)
+   void releaseMemory();
+
+private:
+   struct Entry
+   {
+      std::string key;
+      core::FilePath filePath;
+      boost::uintmax_t size;
+      std::string contents;
+   };
+
+   typedef std::list<Entry> Entries;
+
+   void remove(Entries::iterator it);
+   void enforceBudgets();
+
+   core::FilePath cachePath_;
+   Entries entries_;
+   boost::unordered_map<std::string, Entries::iterator> index_;
+   boost::uintmax_t memoryUsed_;
+   boost::uintmax_t diskUsed_;
+};
+
+} // namespace graphics
+} // namespace session
+} // namespace r
+} // namespace rstudio
+
+#endif // R_SESSION_GRAPHICS_PLOT_IMAGE_CACHE_HPP
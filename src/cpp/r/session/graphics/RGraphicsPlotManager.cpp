@@ -36,6 +36,8 @@
 #include "RGraphicsUtils.hpp"
 #include "RGraphicsDevice.hpp"
 #include "RGraphicsPlotManipulatorManager.hpp"
+#include "RGraphicsPlotImageCache.hpp"
+#include "RGraphicsSnapshotStore.hpp"
 
 using namespace rstudio::core;
 
@@ -51,6 +53,14 @@ double pixelsToInches(int pixels)
    return (double)pixels / 96.0;
 }
 
+// default limit (in megabytes) on the storage used by the plot history,
+// which can be overridden with options(rstudio.plotStorageLimit = )
+const double kDefaultStorageLimitMb = 256;
+
+// default limit on the number of snapshots held in memory awaiting writing,
+// which can be overridden with options(rstudio.plotPendingSnapshotLimit = )
+const int kDefaultPendingSnapshotLimit = 10;
+
 } // anonymous namespace
 
 const char * const kPngFormat = "png";
@@ -100,6 +110,11 @@ Error PlotManager::initialize(const FilePath& graphicsPath,
 
    // save reference to plots state file
    plotsStateFile_ = graphicsPath_.complete("INDEX");
+
+   // rendered images are cached alongside (not within) the graphics path
+   // so they aren't included when the plots are serialized
+   plotImageCache().initialize(graphicsPath_.parent().complete(
+                                       graphicsPath_.filename() + "-cache"));
    
    // save reference to graphics device functions
    graphicsDevice_ = graphicsDevice;
@@ -313,6 +328,19 @@ Error PlotManager::savePlotAsBitmapFile(const FilePath& targetPath,
    // add extra bitmap params
    extraParams += r::session::graphics::extraBitmapParams();
 
+   // use a cached rendering of the active plot if we have one (only
+   // possible if nothing has been drawn since the plot was last rendered)
+   std::string contentId;
+   if (hasPlot() && !hasChanges())
+      contentId = activePlot().contentId();
+   PlotImageKey imageKey(contentId,
+                         bitmapFileType + extraParams,
+                         width,
+                         height,
+                         res);
+   if (!contentId.empty() && plotImageCache().get(imageKey, targetPath))
+      return Success();
+
    // generate code for creating bitmap file device
    boost::format fmt(
       "{ require(grDevices, quietly=TRUE); "
@@ -325,7 +353,14 @@ Error PlotManager::savePlotAsBitmapFile(const FilePath& targetPath,
                                                      extraParams);
 
    // save the file
-   return savePlotAsFile(deviceCreationCode);
+   Error error = savePlotAsFile(deviceCreationCode);
+   if (error)
+      return error;
+
+   if (!contentId.empty())
+      plotImageCache().put(imageKey, targetPath);
+
+   return Success();
 }
 
 Error PlotManager::savePlotAsPdf(const FilePath& filePath, 
@@ -529,6 +564,11 @@ void PlotManager::clear()
    graphicsDevice_.close();
 }
 
+void PlotManager::releaseCachedMemory()
+{
+   plotImageCache().releaseMemory();
+}
+
 
 
 boost::signal<void ()>& PlotManager::onShowManipulator()
@@ -560,6 +600,16 @@ Error PlotManager::savePlotsState()
    if (!graphicsPath_.exists())
       return Success() ;
 
+   // write any snapshots still held in memory
+   for (boost::circular_buffer<PtrPlot>::const_iterator it = plots_.begin();
+        it != plots_.end();
+        ++it)
+   {
+      Error error = (*it)->savePendingSnapshot();
+      if (error)
+         LOG_ERROR(error);
+   }
+
    // list to write
    std::vector<std::string> plots ;
    
@@ -665,7 +715,13 @@ Error PlotManager::restorePlotsState()
 
 namespace {
 
-Error copyDirectory(const FilePath& srcDir, const FilePath& targetDir)
+// snapshots and images are never modified once written (re-rendering a
+// plot writes new files), so the plots directory can be saved and restored
+// by linking them rather than copying them. the plots state file and
+// manipulator files can be rewritten in place so they are always copied
+Error linkDirectory(const FilePath& srcDir,
+                    const FilePath& targetDir,
+                    const FilePath& stateFile)
 {
    Error error = targetDir.removeIfExists();
    if (error)
@@ -682,7 +738,10 @@ Error copyDirectory(const FilePath& srcDir, const FilePath& targetDir)
    BOOST_FOREACH(const FilePath& srcFile, srcFiles)
    {
       FilePath targetFile = targetDir.complete(srcFile.filename());
-      Error error = srcFile.copy(targetFile);
+      bool copy = (srcFile.filename() == stateFile.filename()) ||
+                  (srcFile.extensionLowerCase() == ".manip");
+      Error error = copy ? srcFile.copy(targetFile) :
+                           linkOrCopyFile(srcFile, targetFile);
       if (error)
          return error;
    }
@@ -699,14 +758,15 @@ Error PlotManager::serialize(const FilePath& saveToPath)
    if (error)
       return error;
 
-   // copy the plots dir to the save to path
-   return copyDirectory(graphicsPath_, saveToPath);
+   // link the plots dir to the save to path
+   return linkDirectory(graphicsPath_, saveToPath, plotsStateFile_);
 }
 
 Error PlotManager::deserialize(const FilePath& restoreFromPath)
 {
-   // copy the restoreFromPath to the graphics path
-   Error error = copyDirectory(restoreFromPath, graphicsPath_);
+   // link the restoreFromPath to the graphics path
+   snapshotStore().clear();
+   Error error = linkDirectory(restoreFromPath, graphicsPath_, plotsStateFile_);
    if (error)
       return error;
 
@@ -730,6 +790,8 @@ void PlotManager::onDeviceNewPage(SEXP previousPageSnapshot)
                                                          previousPageSnapshot);
          if (error)
             logAndReportError(error, ERROR_LOCATION);
+
+         enforcePendingSnapshotLimit();
       }
       else
       {
@@ -774,6 +836,9 @@ void PlotManager::onDeviceNewPage(SEXP previousPageSnapshot)
       // add the plot
       plots_.push_back(ptrPlot);
       activePlot_ = plots_.size() - 1  ;
+
+      // make room for it
+      enforceStorageLimit();
    }
 
    // once we render the new plot we always reset pending manipulator state
@@ -796,7 +861,7 @@ void PlotManager::onDeviceResized()
    if (suppressDeviceEvents_)
       return;
    
-   invalidateActivePlot();
+   invalidateActivePlot(false);
 }
 
 void PlotManager::onDeviceClosed()
@@ -819,6 +884,9 @@ void PlotManager::onDeviceClosed()
    error = graphicsPath_.removeIfExists();
    if (error)
       LOG_ERROR(error);
+
+   plotImageCache().clear();
+   snapshotStore().clear();
 }   
       
 Plot& PlotManager::activePlot() const
@@ -847,12 +915,12 @@ void PlotManager::setDisplayHasChanges(bool hasChanges)
 }
 
    
-void PlotManager::invalidateActivePlot()
+void PlotManager::invalidateActivePlot(bool contentChanged)
 {
    setDisplayHasChanges(true);
    
    if (hasPlot())
-      activePlot().invalidate();
+      activePlot().invalidate(contentChanged);
 }
    
 // render active plot to display (used in setActivePlot and onSessionResume)
@@ -870,6 +938,92 @@ void PlotManager::renderActivePlotToDisplay()
 }
    
       
+void PlotManager::enforceStorageLimit()
+{
+   double limitMb = r::options::getOption<double>("rstudio.plotStorageLimit",
+                                                  kDefaultStorageLimitMb,
+                                                  false);
+   if (limitMb <= 0)
+      return;
+   boost::uintmax_t limit = static_cast<boost::uintmax_t>(limitMb * 1024 * 1024);
+
+   boost::uintmax_t size = 0;
+   for (boost::circular_buffer<PtrPlot>::const_iterator it = plots_.begin();
+        it != plots_.end();
+        ++it)
+   {
+      size += (*it)->storageSize();
+   }
+
+   // never remove the active plot
+   while (size > limit && plots_.size() > 1)
+   {
+      // find the least recently used plot (plots which haven't been used
+      // since they were restored are the oldest, in history order)
+      int lruIndex = -1;
+      for (int i = 0; i < static_cast<int>(plots_.size()); ++i)
+      {
+         if (i == activePlot_)
+            continue;
+
+         if (lruIndex == -1)
+         {
+            lruIndex = i;
+            continue;
+         }
+
+         const boost::posix_time::ptime& lastUsed = plots_[i]->lastUsed();
+         const boost::posix_time::ptime& lruLastUsed =
+                                             plots_[lruIndex]->lastUsed();
+         if (lruLastUsed.is_not_a_date_time())
+            continue;
+         if (lastUsed.is_not_a_date_time() || lastUsed < lruLastUsed)
+            lruIndex = i;
+      }
+
+      boost::uintmax_t plotSize = plots_[lruIndex]->storageSize();
+      Error error = removePlot(lruIndex);
+      if (error)
+      {
+         LOG_ERROR(error);
+         break;
+      }
+      size -= std::min(size, plotSize);
+   }
+}
+
+void PlotManager::enforcePendingSnapshotLimit()
+{
+   double limitOption = r::options::getOption<double>(
+                                       "rstudio.plotPendingSnapshotLimit",
+                                       kDefaultPendingSnapshotLimit,
+                                       false);
+   int limit = std::max(0, static_cast<int>(limitOption));
+
+   // write the oldest pending snapshots until no more than limit remain
+   int pending = 0;
+   for (boost::circular_buffer<PtrPlot>::const_iterator it = plots_.begin();
+        it != plots_.end();
+        ++it)
+   {
+      if ((*it)->hasPendingSnapshot())
+         pending++;
+   }
+
+   for (boost::circular_buffer<PtrPlot>::const_iterator it = plots_.begin();
+        it != plots_.end() && pending > limit;
+        ++it)
+   {
+      if (!(*it)->hasPendingSnapshot())
+         continue;
+
+      Error error = (*it)->savePendingSnapshot();
+      if (error)
+         LOG_ERROR(error);
+      pending--;
+   }
+}
+
 Error PlotManager::plotIndexError(int index, const ErrorLocation& location)
                                                                         const
 {
@@ -104,6 +104,8 @@ public:
    
    virtual void clear();
 
+   virtual void releaseCachedMemory();
+
    virtual boost::signal<void ()>& onShowManipulator() ;
    virtual void setPlotManipulatorValues(const core::json::Object& values);
    virtual void manipulatorPlotClicked(int x, int y);
@@ -141,10 +143,18 @@ private:
    void setDisplayHasChanges(bool hasChanges);
 
    // invalidate the active plot
-   void invalidateActivePlot();
+   void invalidateActivePlot(bool contentChanged = true);
 
    // render active plot to display (used in setActivePlot and onSessionResume)
    void renderActivePlotToDisplay();
+
+   // remove the least recently used plots until the plot history fits
+   // within its storage limit
+   void enforceStorageLimit();
+
+   // write the oldest snapshots held in memory until no more than the
+   // pending snapshot limit remain
+   void enforcePendingSnapshotLimit();
    
    // render active plot file file
    core::Error savePlotAsFile(const boost::function<core::Error()>&
@@ -0,0 +1,121 @@
+/*
+ * RGraphicsSnapshotStore.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RGraphicsSnapshotStore.hpp"
+
+#include <boost/lexical_cast.hpp>
+
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+#include <core/Hash.hpp>
+#include <core/FileSerializer.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace graphics {
+
+Error linkOrCopyFile(const FilePath& srcPath, const FilePath& targetPath)
+{
+   Error error = srcPath.link(targetPath);
+   if (error)
+      error = srcPath.copy(targetPath);
+   return error;
+}
+
+SnapshotStore& snapshotStore()
+{
+   static SnapshotStore instance;
+   return instance;
+}
+
+void SnapshotStore::add(const FilePath& snapshotPath)
+{
+   std::string contents;
+   Error error = readStringFromFile(snapshotPath, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   std::string hash = hash::crc32HexHash(contents) + "-" +
+                      boost::lexical_cast<std::string>(contents.size());
+   std::vector<FilePath>& snapshots = snapshots_[hash];
+
+   // look for a stored snapshot with the same contents (dropping those
+   // which have since been removed)
+   std::vector<FilePath>::iterator it = snapshots.begin();
+   while (it != snapshots.end())
+   {
+      if (!it->exists())
+      {
+         it = snapshots.erase(it);
+         continue;
+      }
+
+      std::string existingContents;
+      error = readStringFromFile(*it, &existingContents);
+      if (!error && existingContents == contents)
+      {
+         // replace the new snapshot with a link to the existing one (linking
+         // to a temporary name first so the snapshot is never missing)
+         FilePath linkPath(snapshotPath.absolutePath() + ".link");
+         error = it->link(linkPath);
+         if (!error)
+         {
+            error = snapshotPath.remove();
+            if (!error)
+               error = linkPath.move(snapshotPath);
+         }
+         if (error)
+         {
+            LOG_ERROR(error);
+            Error removeError = linkPath.removeIfExists();
+            if (removeError)
+               LOG_ERROR(removeError);
+
+            // if the snapshot was removed but the link couldn't be moved
+            // into its place then fall back to a copy
+            if (!snapshotPath.exists())
+            {
+               error = it->copy(snapshotPath);
+               if (error)
+                  LOG_ERROR(error);
+            }
+         }
+
+         // remember this name too, since it may outlive the others
+         snapshots.push_back(snapshotPath);
+         return;
+      }
+
+      ++it;
+   }
+
+   snapshots.push_back(snapshotPath);
+}
+
+void SnapshotStore::clear()
+{
+   snapshots_.clear();
+}
+
+} // namespace graphics
+} // namespace session
+} // namespace r
+} // namespace rstudio
@@ -0,0 +1,80 @@
+/*
+ * RGraphicsSnapshotStore.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_SESSION_GRAPHICS_SNAPSHOT_STORE_HPP
+#define R_SESSION_GRAPHICS_SNAPSHOT_STORE_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/utility.hpp>
+
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace graphics {
+
+// create targetPath as a hard link to srcPath, falling back to a copy if
+// the file system doesn't support hard links. only appropriate for files
+// which are replaced rather than modified in place
+core::Error linkOrCopyFile(const core::FilePath& srcPath,
+                           const core::FilePath& targetPath);
+
+// singleton
+class SnapshotStore;
+SnapshotStore& snapshotStore();
+
+// deduplicates plot snapshots by content: a snapshot with the same contents
+// as one already stored is replaced with a hard link to it, so a history
+// which draws the same plot many times holds only one copy. plots continue
+// to address their snapshots by their own file names, and the shared
+// storage is released when the last plot referring to it removes its file
+class SnapshotStore : boost::noncopyable
+{
+private:
+   SnapshotStore() {}
+   friend SnapshotStore& snapshotStore();
+
+public:
+   // COPYING: boost::noncopyable
+
+   // add a newly written snapshot to the store
+   void add(const core::FilePath& snapshotPath);
+
+   // forget all stored snapshots (e.g. when the graphics path is removed)
+   void clear();
+
+private:
+   // content hash (crc32 and size) => snapshots with that hash
+   typedef boost::unordered_map<std::string, std::vector<core::FilePath> >
+                                                               SnapshotMap;
+   SnapshotMap snapshots_;
+};
+
+} // namespace graphics
+} // namespace session
+} // namespace r
+} // namespace rstudio
+
+#endif // R_SESSION_GRAPHICS_SNAPSHOT_STORE_HPP
@@ -13,15 +13,20 @@
  *
  */
 
+#include <algorithm>
 #include <iostream>
 
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
 
 #include <core/system/System.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/PngEncoder.hpp>
 #include <core/StringUtils.hpp>
+#include <core/Thread.hpp>
 
 #include <r/RExec.hpp>
+#include <r/ROptions.hpp>
 #include <r/session/RSessionUtils.hpp>
 
 #undef TRUE
@@ -67,12 +72,50 @@ private:
    pGEDevDesc previousDevice_;
 };
 
+// zlib compression level used when encoding PNGs for display (the R png
+// device always uses full compression, which is a large share of the time
+// taken to render large plots). can be overridden with
+// options(rstudio.displayPngCompression = ), where a negative level means
+// the R png device should encode the images itself
+const double kDefaultPngCompression = 1;
+
+int displayPngCompression()
+{
+#ifdef __APPLE__
+   // quartz writes bitmaps in its own formats so always let it encode PNGs
+   return -1;
+#else
+   double level = r::options::getOption<double>(
+                                       "rstudio.displayPngCompression",
+                                       kDefaultPngCompression,
+                                       false);
+   return std::min(static_cast<int>(level), 9);
+#endif
+}
+
 struct ShadowDeviceData
 {
-   ShadowDeviceData() : pShadowPngDevice(NULL) {}
+   ShadowDeviceData() : pShadowPngDevice(NULL), pngCompression(-1) {}
    pDevDesc pShadowPngDevice;
+
+   // if non-negative the shadow device writes an uncompressed bitmap
+   // which we encode as PNG at this compression level
+   int pngCompression;
 };
 
+// decode the bitmap written by the shadow device and write it to targetPath
+// as a PNG (called on a background thread)
+void encodeBitmap(const std::string& bmp,
+                  int level,
+                  const FilePath& targetPath,
+                  Error* pError)
+{
+   png::Bitmap bitmap;
+   *pError = png::decodeBmp(bmp, &bitmap);
+   if (!*pError)
+      *pError = png::writePngFile(bitmap, level, targetPath);
+}
+
 void shadowDevOff(DeviceContext* pDC)
 {
    ShadowDeviceData* pDevData = (ShadowDeviceData*)pDC->pDeviceSpecific;
@@ -112,9 +155,11 @@ Error shadowDevDesc(DeviceContext* pDC, pDevDesc* pDev)
       int height = pDC->height * pDC->devicePixelRatio;
       int res = 96 * pDC->devicePixelRatio;
 
-      // create PNG device (completely bail on error)
-      boost::format fmt("grDevices:::png(\"%1%\", %2%, %3%, res = %4% %5%)");
+      // create PNG (or bitmap) device (completely bail on error)
+      bool bitmap = pDevData->pngCompression >= 0;
+      boost::format fmt("grDevices:::%1%(\"%2%\", %3%, %4%, res = %5% %6%)");
       std::string code = boost::str(fmt %
+                                    (bitmap ? "bmp" : "png") %
                                     string_utils::utf8ToSystem(pDC->targetPath.absolutePath()) %
                                     width %
                                     height %
@@ -206,7 +251,10 @@ void shadowDevSync(DeviceContext* pDC)
 
 bool initialize(int width, int height, double devicePixelRatio, DeviceContext* pDC)
 {
-   pDC->targetPath = tempFile("png");
+   ShadowDeviceData* pDevData = (ShadowDeviceData*)pDC->pDeviceSpecific;
+   pDevData->pngCompression = displayPngCompression();
+
+   pDC->targetPath = tempFile(pDevData->pngCompression >= 0 ? "bmp" : "png");
    pDC->width = width;
    pDC->height = height;
    pDC->devicePixelRatio = devicePixelRatio;
@@ -302,8 +350,13 @@ Error writeToPNG(const FilePath& targetPath, DeviceContext* pDC)
    // turn the shadow device off to write the file
    shadowDevOff(pDC);
 
-   // if the targetPath != the bitmap path then copy it
+   // if the targetPath != the bitmap path then copy it (or if the device
+   // wrote a bitmap, encode it on a background thread while we regenerate
+   // the shadow device)
    Error error;
+   std::string bmp;
+   boost::thread encodeThread;
+   int pngCompression = ((ShadowDeviceData*)pDC->pDeviceSpecific)->pngCompression;
    if (targetPath != pDC->targetPath)
    {
       // the target path would not exist if R failed to write the PNG
@@ -312,6 +365,28 @@ Error writeToPNG(const FilePath& targetPath, DeviceContext* pDC)
       {
          error = pathNotFoundError(ERROR_LOCATION);
       }
+      else if (pngCompression >= 0)
+      {
+         error = readStringFromFile(pDC->targetPath, &bmp);
+         if (!error)
+         {
+            core::thread::safeLaunchThread(
+                      boost::bind(encodeBitmap,
+                                  boost::cref(bmp),
+                                  pngCompression,
+                                  targetPath,
+                                  &error),
+                      &encodeThread);
+
+            // encode inline if we couldn't launch the thread
+            if (!encodeThread.joinable())
+               encodeBitmap(bmp, pngCompression, targetPath, &error);
+         }
+
+         Error deleteError = pDC->targetPath.remove();
+         if (deleteError)
+            LOG_ERROR(deleteError);
+      }
       else
       {
          error = pDC->targetPath.copy(targetPath);
@@ -333,7 +408,11 @@ Error writeToPNG(const FilePath& targetPath, DeviceContext* pDC)
 
    // re-create with the correct size
    if (!handler::initialize(width, height, devicePixelRatio, pDC))
+   {
+      if (encodeThread.joinable())
+         encodeThread.join();
       return systemError(boost::system::errc::not_connected, ERROR_LOCATION);
+   }
 
    // now update the device structure
    handler::setSize(dev);
@@ -341,6 +420,10 @@ Error writeToPNG(const FilePath& targetPath, DeviceContext* pDC)
    // replay the rstudio graphics device context onto the png
    shadowDevSync(pDC);
 
+   // wait for the image to be encoded
+   if (encodeThread.joinable())
+      encodeThread.join();
+
    // return status
    return error;
 }
@@ -17,10 +17,13 @@
 #include <pthread.h>
 #include <signal.h>
 
+#include <sstream>
+
 #include <core/Error.hpp>
 #include <core/LogWriter.hpp>
 #include <core/ProgramStatus.hpp>
 #include <core/ProgramOptions.hpp>
+#include <core/Trace.hpp>
 
 #include <core/text/TemplateFilter.hpp>
 
@@ -60,6 +63,8 @@
 #include "ServerOffline.hpp"
 #include "ServerPAMAuth.hpp"
 #include "ServerREnvironment.hpp"
+#include "ServerSharedFileMonitor.hpp"
+#include "ServerMetrics.hpp"
 
 using namespace rstudio;
 using namespace rstudio::core;
@@ -147,10 +152,38 @@ Error httpServerInit()
    s_pHttpServer->setScheduledCommandInterval(
                                     boost::posix_time::milliseconds(500));
 
+   // event loop per thread
+   s_pHttpServer->setIoServicePerThread(
+                                 server::options().wwwIoServicePerThread(),
+                                 server::options().wwwThreadCpuAffinity());
+
+   // compress responses for clients that accept it
+   if (server::options().wwwCompressResponses())
+   {
+      http::CompressionOptions compression;
+      compression.minimumSize = server::options().wwwCompressMinSize();
+      s_pHttpServer->setCompressionOptions(compression);
+   }
+
+   // persistent connections
+   s_pHttpServer->setKeepAlive(server::options().wwwKeepAlive());
+
    // initialize
    return server::httpServerInit(s_pHttpServer.get());
 }
 
+void handleTraceRequest(const std::string& username,
+                        const http::Request& request,
+                        http::Response* pResponse)
+{
+   std::ostringstream ostr;
+   core::trace::writeChromeTrace(ostr);
+
+   pResponse->setNoCacheHeaders();
+   pResponse->setContentType("application/json");
+   pResponse->setBody(ostr.str());
+}
+
 void httpServerAddHandlers()
 {
    // establish json-rpc handlers
@@ -188,6 +221,22 @@ void httpServerAddHandlers()
    if (server::options().wwwProxyLocalhost())
       uri_handlers::add("/p/", secureAsyncHttpHandler(proxyLocalhostRequest, true));
 
+   // establish trace handlers (server spans are served directly, session
+   // spans are served by the session)
+   if (server::options().serverTrace())
+   {
+      uri_handlers::addBlocking("/server_trace",
+                                secureHttpHandler(handleTraceRequest));
+      uri_handlers::add("/trace", secureAsyncHttpHandler(proxyContentRequest));
+   }
+
+   // establish metrics endpoint (for scraping, so not authenticated)
+   if (server::options().monitorMetricsEndpoint())
+   {
+      uri_handlers::addBlocking("/metrics",
+                                metrics_endpoint::handleMetricsRequest);
+   }
+
    // establish logging handler
    uri_handlers::addBlocking("/log", secureJsonRpcHandler(gwt::handleLogRequest));
 
@@ -414,6 +463,9 @@ int main(int argc, char * const argv[])
             return core::system::exitFailure(error, ERROR_LOCATION);
       }
 
+      // enable tracing if requested
+      core::trace::setEnabled(options.serverTrace());
+
       // set working directory
       Error error = FilePath(options.serverWorkingDir()).makeCurrentPath();
       if (error)
@@ -443,6 +495,18 @@ int main(int argc, char * const argv[])
       if (error)
          return core::system::exitFailure(error, ERROR_LOCATION);
 
+      // initialize pooled session connections (also needs to happen post
+      // http server init for access to the scheduled command list)
+      error = session_proxy::initializeConnectionPool();
+      if (error)
+         return core::system::exitFailure(error, ERROR_LOCATION);
+
+      // initialize the session manager (also needs to happen post http
+      // server init for access to the scheduled command list)
+      error = sessionManager().initialize();
+      if (error)
+         return core::system::exitFailure(error, ERROR_LOCATION);
+
       // initialize monitor (needs to happen post http server init for access
       // to the server's io service)
       monitor::initializeMonitorClient(kMonitorSocketPath,
@@ -453,6 +517,13 @@ int main(int argc, char * const argv[])
       core::system::addLogWriter(
                 monitor::client().createLogWriter(kProgramIdentity));
 
+      // periodically send recorded metrics (e.g. proxied websocket traffic)
+      if (server::options().monitorIntervalSeconds() > 0)
+      {
+         monitor::client().startMetricsFlush(
+            boost::posix_time::seconds(server::options().monitorIntervalSeconds()));
+      }
+
       // call overlay initialize
       error = overlay::initialize();
       if (error)
@@ -478,6 +549,12 @@ int main(int argc, char * const argv[])
          // add handlers
          httpServerAddHandlers();
 
+         // load the client's static files into memory (every user's
+         // browser requests them on each sign in)
+         error = gwt::preloadStaticAssets(options.wwwLocalPath());
+         if (error)
+            LOG_ERROR(error);
+
          // initialize addins
          error = addins::initialize();
          if (error)
@@ -526,6 +603,24 @@ int main(int argc, char * const argv[])
          return EXIT_SUCCESS;
       }
 
+      // start the shared file monitor if requested (failure to do this is
+      // logged but not fatal, sessions simply monitor files themselves)
+      if (options.serverSharedFileMonitor())
+      {
+         error = shared_file_monitor::initialize();
+         if (error)
+            LOG_ERROR(error);
+      }
+
+      // start collecting metrics for the metrics endpoint (failure to do
+      // this is logged but not fatal, sessions simply won't be included)
+      if (options.monitorMetricsEndpoint())
+      {
+         error = metrics_endpoint::initialize();
+         if (error)
+            LOG_ERROR(error);
+      }
+
       // call overlay startup
       error = overlay::startup();
       if (error)
@@ -536,6 +631,16 @@ int main(int argc, char * const argv[])
       if (error)
          return core::system::exitFailure(error, ERROR_LOCATION);
 
+      // launch sessions for users who should have warm sessions waiting
+      // for them (failure to do this is logged but not fatal)
+      std::string prelaunchUsers = options.rsessionPrelaunchUsers();
+      if (!prelaunchUsers.empty())
+      {
+         error = sessionManager().prelaunchSessions(FilePath(prelaunchUsers));
+         if (error)
+            LOG_ERROR(error);
+      }
+
       // wait for signals
       error = waitForSignals();
       if (error)
@@ -0,0 +1,418 @@
+/*
+ * ServerMetrics.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ServerMetrics.hpp"
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/FilePath.hpp>
+#include <core/Thread.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/PeriodicCommand.hpp>
+
+#include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
+
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+#include <core/http/LocalStreamAsyncServer.hpp>
+
+#include <monitor/MonitorClient.hpp>
+#include <monitor/metrics/Histogram.hpp>
+
+#include <server/ServerOptions.hpp>
+#include <server/ServerScheduler.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace server {
+namespace metrics_endpoint {
+
+namespace {
+
+using monitor::metrics::MetricData;
+using monitor::metrics::MultiMetric;
+using monitor::metrics::HistogramMetric;
+using monitor::metrics::Histogram;
+
+// bounds on the state held on behalf of (potentially misbehaving) sessions
+const std::size_t kMaxReporters = 10000;
+const std::size_t kMaxSeries = 1000;
+
+// reporters are dropped after missing this many reports
+const int kMissedReports = 3;
+
+// upper bounds of the histogram buckets which are exported (in the unit of
+// the histogram, e.g. 1us to 50s for latencies recorded in microseconds)
+const boost::uint64_t kBucketBounds[] = {
+   1, 2, 5,
+   10, 20, 50,
+   100, 200, 500,
+   1000, 2000, 5000,
+   10000, 20000, 50000,
+   100000, 200000, 500000,
+   1000000, 2000000, 5000000,
+   10000000, 20000000, 50000000
+};
+
+typedef boost::shared_ptr<http::AsyncConnection> Connection;
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+struct Series
+{
+   Series() : value(0) {}
+
+   std::string name;       // exported name
+   std::string type;       // prometheus type (counter, gauge or histogram)
+   double value;           // counters and gauges
+   Histogram histogram;    // histograms
+};
+
+// the latest gauges of a session (or of the server)
+struct Reporter
+{
+   Reporter() : intervalSeconds(0) {}
+
+   int intervalSeconds;
+   boost::posix_time::ptime lastReport;
+   std::map<std::string, Series> gauges;
+};
+
+// all state is protected by a single mutex: reports arrive on the local
+// stream server's threads, the server's own metrics on the io service and
+// scrapes on the http server's blocking handler threads
+boost::mutex s_mutex;
+std::map<std::string, Reporter> s_sessions;
+Reporter s_server;
+std::map<std::string, Series> s_accumulated;   // counters and histograms
+
+boost::shared_ptr<http::LocalStreamAsyncServer> s_pServer;
+
+// e.g. rstudio_session_rpc_latency_us
+std::string exportedName(const std::string& scope,
+                         const std::string& name,
+                         const std::string& unit)
+{
+   std::string exported = "rstudio_" + scope + "_" + name;
+   if (!unit.empty() && !boost::algorithm::ends_with(name, unit))
+      exported += "_" + unit;
+
+   for (std::size_t i = 0; i < exported.size(); i++)
+   {
+      char ch = exported[i];
+      if (!((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+            (ch >= '0' && ch <= '9') || ch == '_'))
+      {
+         exported[i] = '_';
+      }
+   }
+   return exported;
+}
+
+// add a series to a map (unless the bound on series has been reached)
+Series* findSeries(std::map<std::string, Series>* pSeries,
+                   const std::string& name,
+                   const std::string& type)
+{
+   std::map<std::string, Series>::iterator it = pSeries->find(name);
+   if (it != pSeries->end())
+      return it->second.type == type ? &it->second : NULL;
+
+   if (pSeries->size() >= kMaxSeries)
+      return NULL;
+
+   Series& series = (*pSeries)[name];
+   series.name = name;
+   series.type = type;
+   return &series;
+}
+
+void addMetrics(const std::vector<MultiMetric>& metrics,
+                const std::vector<HistogramMetric>& histograms,
+                Reporter* pReporter)
+{
+   // NOTE: call with s_mutex held
+
+   BOOST_FOREACH(const MultiMetric& metric, metrics)
+   {
+      bool counter = metric.type() == monitor::metrics::kCounterType;
+      BOOST_FOREACH(const MetricData& data, metric.data())
+      {
+         std::string name = exportedName(metric.scope(),
+                                         data.name,
+                                         metric.unit());
+         if (counter)
+         {
+            Series* pSeries = findSeries(&s_accumulated,
+                                         name + "_total",
+                                         "counter");
+            if (pSeries != NULL)
+               pSeries->value += data.value;
+         }
+         else
+         {
+            Series* pSeries = findSeries(&pReporter->gauges, name, "gauge");
+            if (pSeries != NULL)
+               pSeries->value = data.value;
+         }
+      }
+   }
+
+   BOOST_FOREACH(const HistogramMetric& metric, histograms)
+   {
+      std::string name = exportedName(metric.scope(),
+                                      metric.name(),
+                                      metric.unit());
+      Series* pSeries = findSeries(&s_accumulated, name, "histogram");
+      if (pSeries != NULL)
+         pSeries->histogram.merge(metric.histogram());
+   }
+
+   pReporter->lastReport = now();
+}
+
+void onServerMetricsFlushed(const std::vector<MultiMetric>& metrics,
+                            const std::vector<HistogramMetric>& histograms)
+{
+   LOCK_MUTEX(s_mutex)
+   {
+      addMetrics(metrics, histograms, &s_server);
+   }
+   END_LOCK_MUTEX
+}
+
+void writeError(Connection pConnection, int status, const std::string& message)
+{
+   pConnection->response().setError(status, message);
+   pConnection->writeResponse();
+}
+
+void handleReport(Connection pConnection)
+{
+   json::Value value;
+   if (!json::parse(pConnection->request().body(), &value) ||
+       !json::isType<json::Object>(value))
+   {
+      writeError(pConnection, http::status::BadRequest, "Invalid request");
+      return;
+   }
+
+   std::string id;
+   int intervalSeconds = 0;
+   json::Array metricsJson, histogramsJson;
+   Error error = json::readObject(value.get_obj(),
+                                  "id", &id,
+                                  "interval", &intervalSeconds,
+                                  "metrics", &metricsJson,
+                                  "histograms", &histogramsJson);
+   if (error || id.empty())
+   {
+      writeError(pConnection, http::status::BadRequest, "Invalid report");
+      return;
+   }
+
+   std::vector<MultiMetric> metrics;
+   BOOST_FOREACH(const json::Value& metricJson, metricsJson)
+   {
+      MultiMetric metric;
+      if (json::isType<json::Object>(metricJson) &&
+          !monitor::metrics::metricFromJson(metricJson.get_obj(), &metric))
+      {
+         metrics.push_back(metric);
+      }
+   }
+
+   std::vector<HistogramMetric> histograms;
+   BOOST_FOREACH(const json::Value& histogramJson, histogramsJson)
+   {
+      HistogramMetric histogram;
+      if (json::isType<json::Object>(histogramJson) &&
+          !monitor::metrics::metricFromJson(histogramJson.get_obj(),
+                                            &histogram))
+      {
+         histograms.push_back(histogram);
+      }
+   }
+
+   // reports are keyed by the reporting user as well as the session's id
+   // (so one user's processes can't overwrite another's gauges)
+   std::string key = safe_convert::numberToString(
+                        pConnection->request().remoteUid()) + ":" + id;
+
+   bool accepted = false;
+   LOCK_MUTEX(s_mutex)
+   {
+      if (s_sessions.find(key) != s_sessions.end() ||
+          s_sessions.size() < kMaxReporters)
+      {
+         Reporter& reporter = s_sessions[key];
+         reporter.intervalSeconds = intervalSeconds;
+         addMetrics(metrics, histograms, &reporter);
+         accepted = true;
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (!accepted)
+   {
+      writeError(pConnection,
+                 http::status::ServiceUnavailable,
+                 "Too many sessions reporting metrics");
+      return;
+   }
+
+   pConnection->response().setStatusCode(http::status::Ok);
+   pConnection->response().setContentType(json::kJsonContentType);
+   pConnection->response().setBody(json::write(json::Object()));
+   pConnection->writeResponse();
+}
+
+bool expireReporters()
+{
+   LOCK_MUTEX(s_mutex)
+   {
+      boost::posix_time::ptime time = now();
+      for (std::map<std::string, Reporter>::iterator it = s_sessions.begin();
+           it != s_sessions.end(); )
+      {
+         int interval = std::max(it->second.intervalSeconds,
+                                 server::options().monitorIntervalSeconds());
+         if (time - it->second.lastReport >
+                     boost::posix_time::seconds(interval * kMissedReports))
+         {
+            s_sessions.erase(it++);
+         }
+         else
+         {
+            ++it;
+         }
+      }
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
+void writeSeries(const Series& series, std::ostream& os)
+{
+   os << "# TYPE " << series.name << " " << series.type << "\n";
+
+   if (series.type != "histogram")
+   {
+      os << series.name << " "
+         << safe_convert::numberToString(series.value) << "\n";
+      return;
+   }
+
+   const Histogram& histogram = series.histogram;
+   for (std::size_t i = 0;
+        i < sizeof(kBucketBounds) / sizeof(kBucketBounds[0]);
+        i++)
+   {
+      os << series.name << "_bucket{le=\"" << kBucketBounds[i] << "\"} "
+         << histogram.countAtOrBelow(kBucketBounds[i]) << "\n";
+   }
+   os << series.name << "_bucket{le=\"+Inf\"} " << histogram.count() << "\n";
+   os << series.name << "_sum "
+      << safe_convert::numberToString(histogram.sum()) << "\n";
+   os << series.name << "_count " << histogram.count() << "\n";
+}
+
+} // anonymous namespace
+
+Error initialize()
+{
+   // collect the server's own metrics as they're flushed
+   if (server::options().monitorIntervalSeconds() > 0)
+      monitor::client().setMetricsFlushHandler(onServerMetricsFlushed);
+
+   scheduler::addCommand(boost::shared_ptr<ScheduledCommand>(
+         new PeriodicCommand(boost::posix_time::seconds(60),
+                             expireReporters,
+                             false)));
+
+   // any user's session may report (reports are keyed by the connecting
+   // user so they can only affect their own series)
+   s_pServer.reset(new http::LocalStreamAsyncServer(
+                                       "Metrics",
+                                       std::string(),
+                                       core::system::EveryoneReadWriteMode));
+   Error error = s_pServer->init(FilePath(kMonitorMetricsSocketPath));
+   if (error)
+      return error;
+
+   s_pServer->addHandler("/report", handleReport);
+
+   return s_pServer->run(1);
+}
+
+void handleMetricsRequest(const http::Request& request,
+                          http::Response* pResponse)
+{
+   std::ostringstream os;
+   LOCK_MUTEX(s_mutex)
+   {
+      os << "# TYPE rstudio_active_sessions gauge\n"
+         << "rstudio_active_sessions " << s_sessions.size() << "\n";
+
+      // session gauges are summed across the active sessions
+      std::map<std::string, Series> gauges = s_server.gauges;
+      typedef std::map<std::string, Reporter>::value_type SessionReporter;
+      BOOST_FOREACH(const SessionReporter& session, s_sessions)
+      {
+         typedef std::map<std::string, Series>::value_type Gauge;
+         BOOST_FOREACH(const Gauge& gauge, session.second.gauges)
+         {
+            Series* pSeries = findSeries(&gauges, gauge.first, "gauge");
+            if (pSeries != NULL)
+               pSeries->value += gauge.second.value;
+         }
+      }
+
+      typedef std::map<std::string, Series>::value_type NamedSeries;
+      BOOST_FOREACH(const NamedSeries& series, gauges)
+      {
+         writeSeries(series.second, os);
+      }
+      BOOST_FOREACH(const NamedSeries& series, s_accumulated)
+      {
+         writeSeries(series.second, os);
+      }
+   }
+   END_LOCK_MUTEX
+
+   pResponse->setNoCacheHeaders();
+   pResponse->setContentType("text/plain; version=0.0.4");
+   pResponse->setBody(os.str());
+}
+
+} // namespace metrics_endpoint
+} // namespace server
+} // namespace rstudio
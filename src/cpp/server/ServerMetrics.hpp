@@ -0,0 +1,59 @@
+/*
+ * ServerMetrics.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SERVER_METRICS_HPP
+#define SERVER_METRICS_HPP
+
+namespace rstudio {
+namespace core {
+   class Error;
+   namespace http {
+      class Request;
+      class Response;
+   }
+}
+}
+
+namespace rstudio {
+namespace server {
+namespace metrics_endpoint {
+
+// Aggregates the metrics of the server and its sessions for the /metrics
+// endpoint (in the prometheus text format). Sessions post the metrics they
+// flush each monitor interval to a local stream service; the server's own
+// metrics are collected as they're flushed. Scrapes are served entirely
+// from the aggregated state (they never involve the sessions):
+//
+//  - histograms (e.g. rpc latencies) are merged across sessions and
+//    accumulated since the server started
+//  - counters are accumulated since the server started
+//  - gauges (e.g. memory, event queue depth) are the sum of the latest
+//    values reported by the active sessions
+//
+// Sessions which stop reporting are dropped after a few intervals.
+
+// start the service (call after dropping privilege and before the
+// http server is run, since this adds scheduled commands)
+core::Error initialize();
+
+// handler for /metrics
+void handleMetricsRequest(const core::http::Request& request,
+                          core::http::Response* pResponse);
+
+} // namespace metrics_endpoint
+} // namespace server
+} // namespace rstudio
+
+#endif // SERVER_METRICS_HPP
@@ -201,7 +201,14 @@ ProgramStatus Options::read(int argc,
          "is app armor enabled for this session")
       ("server-set-umask",
          value<bool>(&serverSetUmask_)->default_value(1),
-         "set the umask to 022 on startup");
+         "set the umask to 022 on startup")
+      ("server-trace",
+         value<bool>(&serverTrace_)->default_value(false),
+         "record trace spans for requests (also enables session tracing)")
+      ("server-shared-file-monitor",
+         value<bool>(&serverSharedFileMonitor_)->default_value(false),
+         "monitor project directories on behalf of sessions (so that sessions "
+         "opening the same project share a single file monitor)");
 
    // www - web server options
    options_description www("www") ;
@@ -225,12 +232,30 @@ ProgramStatus Options::read(int argc,
       ("www-thread-pool-size",
          value<int>(&wwwThreadPoolSize_)->default_value(2),
          "thread pool size")
+      ("www-io-service-per-thread",
+         value<bool>(&wwwIoServicePerThread_)->default_value(false),
+         "run a separate event loop on each thread of the pool")
+      ("www-thread-cpu-affinity",
+         value<bool>(&wwwThreadCpuAffinity_)->default_value(false),
+         "pin each event loop thread to a cpu (with www-io-service-per-thread)")
       ("www-proxy-localhost",
          value<bool>(&wwwProxyLocalhost_)->default_value(true),
          "proxy requests to localhost ports over main server port")
       ("www-verify-user-agent",
          value<bool>(&wwwVerifyUserAgent_)->default_value(true),
-         "verify that the user agent is compatible");
+         "verify that the user agent is compatible")
+      ("www-proxy-zero-copy",
+         value<bool>(&wwwProxyZeroCopy_)->default_value(true),
+         "use splice to forward proxied websocket traffic (linux only)")
+      ("www-compress-responses",
+         value<bool>(&wwwCompressResponses_)->default_value(true),
+         "compress responses for clients which accept gzip or deflate")
+      ("www-compress-min-size",
+         value<int>(&wwwCompressMinSize_)->default_value(1024),
+         "minimum size (in bytes) of response bodies to compress")
+      ("www-keep-alive",
+         value<bool>(&wwwKeepAlive_)->default_value(false),
+         "keep client connections open between requests");
 
    // rsession
    Deprecated dep;
@@ -251,6 +276,43 @@ ProgramStatus Options::read(int argc,
       ("rsession-config-file",
          value<std::string>(&rsessionConfigFile_)->default_value(""),
          "path to rsession config file")
+      ("rsession-connection-pool-size",
+         value<int>(&rsessionConnectionPoolSize_)->default_value(4),
+         "persistent connections kept open to each rsession (0 to disable)")
+      ("rsession-connection-idle-timeout",
+         value<int>(&rsessionConnectionIdleTimeoutSeconds_)->default_value(30),
+         "seconds before an idle rsession connection is closed")
+      ("rsession-max-in-flight-requests",
+         value<int>(&rsessionMaxInFlightRequests_)->default_value(32),
+         "requests in flight to an rsession beyond which content requests "
+         "are refused (0 for no limit)")
+      ("rsession-launch-concurrency",
+         value<int>(&rsessionLaunchConcurrency_)->default_value(0),
+         "maximum simultaneous rsession launches (0 for no limit)")
+      ("rsession-prelaunch-users",
+         value<std::string>(&rsessionPrelaunchUsers_)->default_value(""),
+         "file listing users whose sessions are launched at startup")
+      ("rsession-cpu-cgroup",
+         value<std::string>(&rsessionCpuCgroup_)->default_value(""),
+         "delegated cgroup (v2) under which rsessions get per-user cgroups")
+      ("rsession-cpu-weight",
+         value<int>(&rsessionCpuWeight_)->default_value(100),
+         "cgroup cpu weight for rsessions")
+      ("rsession-batch-group",
+         value<std::string>(&rsessionBatchGroup_)->default_value(""),
+         "group whose members' rsessions are scheduled as batch work")
+      ("rsession-batch-cpu-weight",
+         value<int>(&rsessionBatchCpuWeight_)->default_value(25),
+         "cgroup cpu weight for batch rsessions")
+      ("rsession-busy-load",
+         value<double>(&rsessionBusyLoad_)->default_value(1.0),
+         "load (per cpu) above which batch rsessions are launched at lower priority")
+      ("rsession-busy-batch-priority",
+         value<int>(&rsessionBusyBatchPriority_)->default_value(5),
+         "priority (niceness) of batch rsessions launched when the host is busy")
+      ("rsession-idle-priority",
+         value<int>(&rsessionIdlePriority_)->default_value(0),
+         "niceness rsessions add to their priority while idle (0 to disable)")
       ("rsession-memory-limit-mb",
          value<int>(&dep.memoryLimitMb)->default_value(dep.memoryLimitMb),
          "rsession memory limit (mb) - DEPRECATED")
@@ -288,6 +350,12 @@ ProgramStatus Options::read(int argc,
       ("auth-pam-helper-path",
         value<std::string>(&authPamHelperPath_)->default_value("rserver-pam"),
        "path to PAM helper binary")
+      ("auth-pam-workers",
+        value<int>(&authPamWorkers_)->default_value(4),
+        "number of sign-ins which may be authenticated concurrently")
+      ("auth-pam-max-pending",
+        value<int>(&authPamMaxPending_)->default_value(64),
+        "maximum number of sign-ins waiting to be authenticated")
       ("auth-pam-requires-priv",
         value<bool>(&dep.authPamRequiresPriv)->default_value(
                                                    dep.authPamRequiresPriv),
@@ -297,7 +365,11 @@ ProgramStatus Options::read(int argc,
    monitor.add_options()
       (kMonitorIntervalSeconds,
        value<int>(&monitorIntervalSeconds_)->default_value(300),
-       "monitoring interval");
+       "monitoring interval")
+      ("monitor-metrics-endpoint",
+       value<bool>(&monitorMetricsEndpoint_)->default_value(false),
+       "serve server and session metrics at /metrics (in the prometheus text "
+       "format). the endpoint is not authenticated");
 
    // define program options
    FilePath defaultConfigPath("/etc/rstudio/rserver.conf");
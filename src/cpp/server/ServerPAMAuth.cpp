@@ -14,9 +14,15 @@
  */
 #include "ServerPAMAuth.hpp"
 
+#include <map>
+
+#include <boost/thread/mutex.hpp>
 
 #include <core/Error.hpp>
 #include <core/PeriodicCommand.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
+#include <core/ThreadPool.hpp>
 #include <core/system/Process.hpp>
 #include <core/system/Crypto.hpp>
 #include <core/system/PosixSystem.hpp>
@@ -233,17 +239,131 @@ void setSignInCookies(const core::http::Request& request,
                             pResponse);
 }
 
-void doSignIn(const http::Request& request,
-              http::Response* pResponse)
+// sign-in attempts are authenticated on a pool of workers rather than on
+// the threads serving http requests, since a slow PAM stack (e.g. one
+// backed by a remote LDAP server) would otherwise stall unrelated requests.
+// attempts are rejected when too many are already waiting, and users who
+// repeatedly fail to sign in must wait between attempts
+
+// never freed (created at initialization)
+core::thread::ThreadPool* s_pPamWorkers = NULL;
+
+// consecutive failures a user may have before attempts are throttled,
+// and the longest they'll need to wait
+const int kFreeSignInFailures = 5;
+const int kMaxSignInDelaySeconds = 60;
+
+// at most this many attempts for one user are authenticated at a time
+const int kMaxPendingPerUser = 2;
+
+// failures are remembered for at most this many users
+const std::size_t kMaxSignInStates = 10000;
+
+struct SignInState
 {
-   std::string appUri = request.formFieldValue(kAppUri);
-   if (appUri.empty())
-      appUri = "/";
+   SignInState() : pending(0), failures(0) {}
+   int pending;
+   int failures;
+   boost::posix_time::ptime retryAfter;
+};
 
+boost::mutex s_signInMutex;
+std::map<std::string, SignInState> s_signInStates;
+int s_pendingSignIns = 0;
 
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+// forget users who are free to try again (called with the mutex held)
+void pruneSignInStates()
+{
+   boost::posix_time::ptime time = now();
+   std::map<std::string, SignInState>::iterator it = s_signInStates.begin();
+   while (it != s_signInStates.end())
+   {
+      const SignInState& state = it->second;
+      if (state.pending == 0 &&
+          (state.retryAfter.is_not_a_date_time() || state.retryAfter < time))
+         s_signInStates.erase(it++);
+      else
+         ++it;
+   }
+}
+
+// returns an error message if the attempt can't be made now
+std::string beginSignIn(const std::string& username)
+{
+   LOCK_MUTEX(s_signInMutex)
+   {
+      if (s_pendingSignIns >= server::options().authPamMaxPending())
+         return "The server is busy, please try again";
 
-   bool persist = false;
-   std::string username, password;
+      if (s_signInStates.size() >= kMaxSignInStates)
+         pruneSignInStates();
+
+      SignInState& state = s_signInStates[username];
+      if (!state.retryAfter.is_not_a_date_time() && now() < state.retryAfter)
+         return "Too many failed sign in attempts, please wait and try again";
+      if (state.pending >= kMaxPendingPerUser)
+         return "A sign in for this user is already in progress";
+
+      state.pending++;
+      s_pendingSignIns++;
+   }
+   END_LOCK_MUTEX
+
+   return std::string();
+}
+
+void endSignIn(const std::string& username, bool authenticated)
+{
+   LOCK_MUTEX(s_signInMutex)
+   {
+      s_pendingSignIns--;
+
+      SignInState& state = s_signInStates[username];
+      state.pending--;
+      if (authenticated)
+      {
+         state.failures = 0;
+         state.retryAfter = boost::posix_time::ptime();
+      }
+      else if (++state.failures > kFreeSignInFailures)
+      {
+         // wait doubles with each further failure
+         int exponent = std::min(state.failures - kFreeSignInFailures, 7);
+         int delaySeconds = std::min(1 << (exponent - 1),
+                                     kMaxSignInDelaySeconds);
+         state.retryAfter = now() + boost::posix_time::seconds(delaySeconds);
+      }
+
+      // forget users with nothing outstanding (so the map doesn't grow
+      // with every username ever tried)
+      if (state.pending == 0 && state.failures == 0)
+         s_signInStates.erase(username);
+   }
+   END_LOCK_MUTEX
+}
+
+struct SignInRequest
+{
+   SignInRequest() : persist(false) {}
+   std::string appUri;
+   std::string username;
+   std::string password;
+   bool persist;
+};
+
+bool readSignInRequest(const http::Request& request,
+                       SignInRequest* pSignIn,
+                       http::Response* pResponse)
+{
+   std::string appUri = request.formFieldValue(kAppUri);
+   if (appUri.empty())
+      appUri = "/";
+   pSignIn->appUri = appUri;
 
    if (server::options().authEncryptPassword())
    {
@@ -260,7 +380,7 @@ void doSignIn(const http::Request& request,
                                     appUri,
                                     "Temporary server error,"
                                     " please try again"));
-         return;
+         return false;
       }
 
       size_t splitAt = plainText.find('\n');
@@ -273,31 +393,39 @@ void doSignIn(const http::Request& request,
                                     appUri,
                                     "Temporary server error,"
                                     " please try again"));
-         return;
+         return false;
       }
 
-      persist = request.formFieldValue("persist") == "1";
-      username = plainText.substr(0, splitAt);
-      password = plainText.substr(splitAt + 1, plainText.size());
+      pSignIn->persist = request.formFieldValue("persist") == "1";
+      pSignIn->username = plainText.substr(0, splitAt);
+      pSignIn->password = plainText.substr(splitAt + 1, plainText.size());
    }
    else
    {
-      persist = request.formFieldValue("staySignedIn") == "1";
-      username = request.formFieldValue("username");
-      password = request.formFieldValue("password");
+      pSignIn->persist = request.formFieldValue("staySignedIn") == "1";
+      pSignIn->username = request.formFieldValue("username");
+      pSignIn->password = request.formFieldValue("password");
    }
 
    // tranform to local username
-   username = auth::handler::userIdentifierToLocalUsername(username);
+   pSignIn->username =
+         auth::handler::userIdentifierToLocalUsername(pSignIn->username);
 
-   onUserUnauthenticated(username);
+   return true;
+}
 
-   if ( pamLogin(username, password) && server::auth::validateUser(username))
+void completeSignIn(const http::Request& request,
+                    const SignInRequest& signIn,
+                    bool authenticated,
+                    http::Response* pResponse)
+{
+   if (authenticated)
    {
+      std::string appUri = signIn.appUri;
       if (appUri.size() > 0 && appUri[0] != '/')
          appUri = "/" + appUri;
 
-      setSignInCookies(request, username, persist, pResponse);
+      setSignInCookies(request, signIn.username, signIn.persist, pResponse);
       pResponse->setMovedTemporarily(request, appUri);
 
       // register login with monitor
@@ -305,20 +433,94 @@ void doSignIn(const http::Request& request,
       client().logEvent(Event(kAuthScope,
                               kAuthLoginEvent,
                               "",
-                              username));
+                              signIn.username));
 
-      onUserAuthenticated(username, password);
+      onUserAuthenticated(signIn.username, signIn.password);
    }
    else
    {
       pResponse->setMovedTemporarily(
             request,
             applicationSignInURL(request,
-                                 appUri,
+                                 signIn.appUri,
                                  "Incorrect or invalid username/password"));
    }
 }
 
+void onSignInAuthenticated(
+            boost::shared_ptr<core::http::AsyncConnection> pConnection,
+            boost::shared_ptr<SignInRequest> pSignIn,
+            bool authenticated)
+{
+   endSignIn(pSignIn->username, authenticated);
+   completeSignIn(pConnection->request(),
+                  *pSignIn,
+                  authenticated,
+                  &(pConnection->response()));
+   pConnection->writeResponse();
+}
+
+// runs on a pam worker
+void authenticateSignIn(
+            boost::shared_ptr<core::http::AsyncConnection> pConnection,
+            boost::shared_ptr<SignInRequest> pSignIn)
+{
+   boost::posix_time::ptime started = now();
+   bool authenticated = pamLogin(pSignIn->username, pSignIn->password) &&
+                        server::auth::validateUser(pSignIn->username);
+   boost::posix_time::time_duration elapsed = now() - started;
+
+   int intervalSeconds = server::options().monitorIntervalSeconds();
+   if (intervalSeconds > 0)
+   {
+      monitor::client().recordHistogramSample(
+               "server", intervalSeconds, "auth.pam_latency",
+               elapsed.total_milliseconds(), "ms");
+   }
+   if (elapsed > boost::posix_time::seconds(10))
+   {
+      LOG_WARNING_MESSAGE("Slow PAM authentication for " +
+                          pSignIn->username + " (" +
+                          safe_convert::numberToString(
+                                 elapsed.total_milliseconds()) + "ms)");
+   }
+
+   // respond on the connection's io service
+   pConnection->ioService().post(boost::bind(onSignInAuthenticated,
+                                             pConnection,
+                                             pSignIn,
+                                             authenticated));
+}
+
+void doSignIn(boost::shared_ptr<core::http::AsyncConnection> pConnection)
+{
+   const http::Request& request = pConnection->request();
+   http::Response* pResponse = &(pConnection->response());
+
+   boost::shared_ptr<SignInRequest> pSignIn(new SignInRequest());
+   if (!readSignInRequest(request, pSignIn.get(), pResponse))
+   {
+      pConnection->writeResponse();
+      return;
+   }
+
+   onUserUnauthenticated(pSignIn->username);
+
+   std::string errorMessage = beginSignIn(pSignIn->username);
+   if (!errorMessage.empty())
+   {
+      pResponse->setMovedTemporarily(
+            request,
+            applicationSignInURL(request, pSignIn->appUri, errorMessage));
+      pConnection->writeResponse();
+      return;
+   }
+
+   s_pPamWorkers->submit(boost::bind(authenticateSignIn,
+                                     pConnection,
+                                     pSignIn));
+}
+
 void signOut(const http::Request& request,
              http::Response* pResponse)
 {
@@ -401,9 +603,14 @@ Error initialize()
    auth::handler::registerHandler(pamHandler);
 
    // add pam-specific auth handlers
-   uri_handlers::addBlocking(kDoSignIn, doSignIn);
+   uri_handlers::add(kDoSignIn, doSignIn);
    uri_handlers::addBlocking(kPublicKey, publicKey);
 
+   // workers which authenticate sign-ins
+   s_pPamWorkers = new core::thread::ThreadPool(
+                              "pam auth",
+                              std::max(server::options().authPamWorkers(), 1));
+
    // initialize crypto
    return core::system::crypto::rsaInit();
 }
@@ -15,9 +15,12 @@
 
 #include "ServerREnvironment.hpp"
 
+#include <boost/bind.hpp>
+
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/Thread.hpp>
+#include <core/system/PosixSystem.hpp>
 #include <core/r_util/REnvironment.hpp>
 
 #include <server/ServerOptions.hpp>
@@ -41,6 +44,73 @@ core::r_util::RVersion s_fallbackVersion;
 // R version or the provided fallback)
 core::r_util::RVersion s_rVersion;
 
+// protects the above versions (which may be updated by the background
+// revalidation of a cached R environment)
+boost::mutex s_versionMutex;
+
+// detecting the R environment means running R, so results are cached on
+// disk across restarts (and revalidated in the background)
+FilePath rEnvironmentCachePath()
+{
+   if (core::system::effectiveUserIsRoot())
+      return FilePath("/var/lib/rstudio-server/r-environment.json");
+   else
+      return FilePath("/tmp/rstudio-server/r-environment.json");
+}
+
+FilePath whichRScriptPath()
+{
+   // check for which R override
+   FilePath rWhichRPath;
+   std::string whichROverride = server::options().rsessionWhichR();
+   if (!whichROverride.empty())
+      rWhichRPath = FilePath(whichROverride);
+
+   // if it's a directory then see if we can find the script
+   if (rWhichRPath.isDirectory())
+   {
+      FilePath rScriptPath = rWhichRPath.childPath("bin/R");
+      if (rScriptPath.exists())
+         rWhichRPath = rScriptPath;
+   }
+
+   return rWhichRPath;
+}
+
+void revalidateSystemRVersion(FilePath cachePath)
+{
+   try
+   {
+      std::string rScriptPath, rVersion, errMsg;
+      core::r_util::EnvironmentVars environment;
+      bool result = r_util::refreshREnvironmentCache(
+                                     cachePath,
+                                     whichRScriptPath(),
+                                     FilePath(server::options().rldpathPath()),
+                                     server::options().rsessionLdLibraryPath(),
+                                     &rScriptPath,
+                                     &rVersion,
+                                     &environment,
+                                     &errMsg);
+      if (!result)
+      {
+         // keep using what we have (the cached environment may still
+         // be usable even if R can't be run right now)
+         LOG_ERROR_MESSAGE("Unable to revalidate R environment: " + errMsg);
+         return;
+      }
+
+      core::r_util::RVersion version(rVersion, environment);
+      LOCK_MUTEX(s_versionMutex)
+      {
+         if (s_rVersion == s_systemVersion)
+            s_rVersion = version;
+         s_systemVersion = version;
+      }
+      END_LOCK_MUTEX
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
 
 }
 
@@ -62,11 +132,8 @@ bool initialize(std::string* pErrMsg)
 
 core::r_util::RVersion rVersion()
 {
-   // make a copy protected by a mutex just to be on the safest
-   // possible side (the copy is cheap and we're not sure what
-   // universal guarantees about multi-threaded read access to
-   // std::vector are)
-   static boost::mutex s_versionMutex ;
+   // make a copy protected by a mutex (the version may be updated
+   // by the background revalidation of a cached environment)
    LOCK_MUTEX(s_versionMutex)
    {
       return s_rVersion;
@@ -91,35 +158,50 @@ bool detectSystemRVersion(core::r_util::RVersion* pVersion,
                           std::string* pErrMsg)
 {
    // return cached version if we have it
-   if (!s_systemVersion.empty())
+   LOCK_MUTEX(s_versionMutex)
    {
-      *pVersion = s_systemVersion;
-      return true;
+      if (!s_systemVersion.empty())
+      {
+         *pVersion = s_systemVersion;
+         return true;
+      }
    }
+   END_LOCK_MUTEX
 
-   // check for which R override
-   FilePath rWhichRPath;
-   std::string whichROverride = server::options().rsessionWhichR();
-   if (!whichROverride.empty())
-      rWhichRPath = FilePath(whichROverride);
+   // attempt to detect R version (served from the on disk cache if we
+   // detected it previously, in which case we revalidate in the background
+   // so that the next launch sees any changes)
+   FilePath cachePath = rEnvironmentCachePath();
+   std::string rScriptPath, rVersion;
+   core::r_util::EnvironmentVars environment;
+   bool fromCache = false;
+   bool result = r_util::detectREnvironmentCached(
+                                     cachePath,
+                                     whichRScriptPath(),
+                                     FilePath(server::options().rldpathPath()),
+                                     server::options().rsessionLdLibraryPath(),
+                                     &rScriptPath,
+                                     &rVersion,
+                                     &environment,
+                                     pErrMsg,
+                                     &fromCache);
+   if (!result)
+      return false;
 
-   // if it's a directory then see if we can find the script
-   if (rWhichRPath.isDirectory())
+   *pVersion = core::r_util::RVersion(rVersion, environment);
+   LOCK_MUTEX(s_versionMutex)
    {
-      FilePath rScriptPath = rWhichRPath.childPath("bin/R");
-      if (rScriptPath.exists())
-         rWhichRPath = rScriptPath;
+      s_systemVersion = *pVersion;
    }
+   END_LOCK_MUTEX
 
-   // attempt to detect R version
-   bool result = detectRVersion(rWhichRPath, pVersion, pErrMsg);
-
-   // if we detected it then cache it
-   if (result)
-      s_systemVersion = *pVersion;
+   if (fromCache)
+   {
+      core::thread::safeLaunchThread(
+               boost::bind(revalidateSystemRVersion, cachePath));
+   }
 
-   // return result
-   return result;
+   return true;
 }
 
 bool detectRVersion(const core::FilePath& rScriptPath,
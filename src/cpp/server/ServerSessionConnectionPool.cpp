@@ -0,0 +1,198 @@
+/*
+ * ServerSessionConnectionPool.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ServerSessionConnectionPool.hpp"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+
+#include <map>
+#include <deque>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/Thread.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace server {
+namespace session_proxy {
+namespace connection_pool {
+
+namespace {
+
+struct PooledClient
+{
+   PooledClient(Client client)
+      : client(client),
+        lastUsed(boost::posix_time::microsec_clock::universal_time())
+   {
+   }
+
+   Client client;
+   boost::posix_time::ptime lastUsed;
+};
+
+typedef std::deque<PooledClient> Clients;
+
+boost::mutex s_mutex;
+std::map<std::string, Clients> s_pool;
+
+std::size_t s_maxConnectionsPerSession = 0;
+boost::posix_time::time_duration s_idleTimeout;
+
+bool isExpired(const PooledClient& pooled,
+               const boost::posix_time::ptime& now)
+{
+   return (now - pooled.lastUsed) > s_idleTimeout;
+}
+
+// check whether an idle connection is still usable. an idle connection
+// should have nothing to read; if the peer has closed it (eof) or sent
+// unexpected data then we don't want to use it
+bool isHealthy(Client client)
+{
+   if (!client->isReusable())
+      return false;
+
+   int fd = client->nativeHandle();
+   if (fd == -1)
+      return false;
+
+   char ch;
+   ssize_t result = ::recv(fd, &ch, 1, MSG_PEEK | MSG_DONTWAIT);
+   return result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+} // anonymous namespace
+
+void initialize(std::size_t maxConnectionsPerSession,
+                const boost::posix_time::time_duration& idleTimeout)
+{
+   s_maxConnectionsPerSession = maxConnectionsPerSession;
+   s_idleTimeout = idleTimeout;
+}
+
+bool enabled()
+{
+   return s_maxConnectionsPerSession > 0;
+}
+
+Client checkout(boost::asio::io_service& ioService,
+                const core::FilePath& streamPath)
+{
+   if (enabled())
+   {
+      boost::posix_time::ptime now =
+                           boost::posix_time::microsec_clock::universal_time();
+
+      LOCK_MUTEX(s_mutex)
+      {
+         std::map<std::string, Clients>::iterator it =
+                                 s_pool.find(streamPath.absolutePath());
+         if (it != s_pool.end())
+         {
+            // use the most recently returned clients first (they
+            // are the least likely to have been closed by the session).
+            // clients can only be used by connections running on the
+            // same io_service as the one that created them
+            Clients& clients = it->second;
+            Clients::iterator pooledIt = clients.end();
+            while (pooledIt != clients.begin())
+            {
+               --pooledIt;
+               if (&(pooledIt->client->ioService()) != &ioService)
+                  continue;
+
+               PooledClient pooled = *pooledIt;
+               pooledIt = clients.erase(pooledIt);
+
+               if (!isExpired(pooled, now) && isHealthy(pooled.client))
+                  return pooled.client;
+               else
+                  pooled.client->close();
+            }
+
+            if (clients.empty())
+               s_pool.erase(it);
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+   // no pooled client available, create a new one
+   Client client(new http::LocalStreamAsyncClient(ioService, streamPath));
+   client->setKeepAlive(enabled());
+   return client;
+}
+
+void checkin(const core::FilePath& streamPath, Client client)
+{
+   if (!enabled() || !client->isReusable())
+      return;
+
+   LOCK_MUTEX(s_mutex)
+   {
+      Clients& clients = s_pool[streamPath.absolutePath()];
+      if (clients.size() < s_maxConnectionsPerSession)
+      {
+         clients.push_back(PooledClient(client));
+         return;
+      }
+   }
+   END_LOCK_MUTEX
+
+   // pool is full
+   client->close();
+}
+
+void closeExpired()
+{
+   if (!enabled())
+      return;
+
+   boost::posix_time::ptime now =
+                           boost::posix_time::microsec_clock::universal_time();
+
+   LOCK_MUTEX(s_mutex)
+   {
+      std::map<std::string, Clients>::iterator it = s_pool.begin();
+      while (it != s_pool.end())
+      {
+         // clients are checked in at the back so the oldest are at the front
+         Clients& clients = it->second;
+         while (!clients.empty() && isExpired(clients.front(), now))
+         {
+            clients.front().client->close();
+            clients.pop_front();
+         }
+
+         if (clients.empty())
+            s_pool.erase(it++);
+         else
+            ++it;
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+} // namespace connection_pool
+} // namespace session_proxy
+} // namespace server
+} // namespace rstudio
@@ -0,0 +1,63 @@
+/*
+ * ServerSessionConnectionPool.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SERVER_SESSION_CONNECTION_POOL_HPP
+#define SERVER_SESSION_CONNECTION_POOL_HPP
+
+#include <boost/shared_ptr.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/date_time/posix_time/posix_time_duration.hpp>
+
+#include <core/http/LocalStreamAsyncClient.hpp>
+
+namespace rstudio {
+namespace core {
+   class FilePath;
+}
+}
+
+namespace rstudio {
+namespace server {
+namespace session_proxy {
+namespace connection_pool {
+
+typedef boost::shared_ptr<core::http::LocalStreamAsyncClient> Client;
+
+// configure the pool of persistent connections to each session. passing
+// a maxConnectionsPerSession of 0 disables pooling
+void initialize(std::size_t maxConnectionsPerSession,
+                const boost::posix_time::time_duration& idleTimeout);
+
+bool enabled();
+
+// get a client for the session listening at streamPath. returns a pooled
+// (already connected) client if a healthy one is available, otherwise a
+// new keep-alive client which will connect when executed
+Client checkout(boost::asio::io_service& ioService,
+                const core::FilePath& streamPath);
+
+// return a client to the pool once it has received its response (clients
+// which aren't reusable or which exceed the pool size are discarded)
+void checkin(const core::FilePath& streamPath, Client client);
+
+// close idle connections which have exceeded the idle timeout
+void closeExpired();
+
+} // namespace connection_pool
+} // namespace session_proxy
+} // namespace server
+} // namespace rstudio
+
+#endif // SERVER_SESSION_CONNECTION_POOL_HPP
@@ -22,7 +22,11 @@
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
 #include <core/SafeConvert.hpp>
+#include <core/PeriodicCommand.hpp>
+#include <core/system/PosixSched.hpp>
 #include <core/system/PosixSystem.hpp>
 #include <core/system/PosixUser.hpp>
 #include <core/system/Environment.hpp>
@@ -32,6 +36,7 @@
 #include <session/SessionConstants.hpp>
 
 #include <server/ServerOptions.hpp>
+#include <server/ServerScheduler.hpp>
 
 #include <server/ServerErrorCategory.hpp>
 
@@ -79,6 +84,23 @@ core::system::ProcessConfig sessionProcessConfig(
                                     context.scope.id()));
    }
 
+   // pass the monitor interval
+   args.push_back(std::make_pair("--" kMonitorIntervalSeconds,
+                                 safe_convert::numberToString(
+                                       options.monitorIntervalSeconds())));
+
+   // have the session report its metrics if we're serving them
+   if (options.monitorMetricsEndpoint())
+      args.push_back(std::make_pair("--" kMonitorReportMetrics, "1"));
+
+   // enable session tracing along with server tracing
+   if (options.serverTrace())
+      args.push_back(std::make_pair("--" kTraceSessionOption, "1"));
+
+   // have the session use the shared file monitor if we're running it
+   if (options.serverSharedFileMonitor())
+      args.push_back(std::make_pair("--" kSharedFileMonitorSessionOption, "1"));
+
    // allow session timeout to be overridden via environment variable
    std::string timeout = core::system::getenv("RSTUDIO_SESSION_TIMEOUT");
    if (!timeout.empty())
@@ -148,10 +170,78 @@ core::system::ProcessConfig sessionProcessConfig(
    return config;
 }
 
+// assign cpu scheduling for a session based on the class of its user and
+// the current load on the host. batch users' sessions get a lower cgroup
+// cpu weight (and, when the host is busy, a lower priority) so that they
+// don't starve interactive users. sessions may also lower their own
+// priority while idle, for which they need a nice limit which allows them
+// to return to their launch priority
+void applySessionScheduling(r_util::SessionLaunchProfile* pProfile)
+{
+   server::Options& options = server::options();
+   core::system::ProcessLimits& limits = pProfile->config.limits;
+
+   bool isBatch = false;
+   std::string batchGroup = options.rsessionBatchGroup();
+   if (!batchGroup.empty())
+   {
+      core::system::user::User user;
+      Error error = core::system::user::userFromUsername(
+                                       pProfile->context.username, &user);
+      if (!error)
+         error = core::system::userBelongsToGroup(user, batchGroup, &isBatch);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   std::string cgroup = options.rsessionCpuCgroup();
+   if (!cgroup.empty())
+   {
+      limits.cpuCgroup = FilePath(cgroup).childPath(
+                  "user-" + pProfile->context.username).absolutePath();
+      limits.cpuWeight = isBatch ? options.rsessionBatchCpuWeight() :
+                                   options.rsessionCpuWeight();
+   }
+
+   if (isBatch && limits.priority == 0)
+   {
+      double load = 0;
+      Error error = core::system::getLoadPerCpu(&load);
+      if (error)
+         LOG_ERROR(error);
+      else if (load > options.rsessionBusyLoad())
+         limits.priority = options.rsessionBusyBatchPriority();
+   }
+
+   int idlePriority = options.rsessionIdlePriority();
+   if (idlePriority > 0)
+   {
+      pProfile->config.args.push_back(std::make_pair(
+                        "--" kIdlePrioritySessionOption,
+                        safe_convert::numberToString(idlePriority)));
+
+      // RLIMIT_NICE allows raising priority (lowering niceness) back to
+      // 20 - limit
+      RLimitType niceLimit = 20 - limits.priority;
+      if (limits.niceLimit < niceLimit)
+         limits.niceLimit = niceLimit;
+   }
+}
+
 void onProcessExit(const std::string& username, PidType pid)
 {
 }
 
+// a launch holds its concurrency slot until the session is first connected
+// to or (for sessions no one is waiting on) until this much time elapses
+const int kLaunchSlotSeconds = 10;
+
+bool processQueuedLaunchesCommand()
+{
+   sessionManager().processQueuedLaunches();
+   return true;
+}
+
 } // anonymous namespace
 
 SessionManager& sessionManager()
@@ -167,11 +257,30 @@ SessionManager::SessionManager()
                                            this, _1);
 }
 
+Error SessionManager::initialize()
+{
+   // periodically start queued launches as slots free up
+   if (server::options().rsessionLaunchConcurrency() > 0)
+   {
+      scheduler::addCommand(
+         boost::shared_ptr<ScheduledCommand>(new PeriodicCommand(
+            boost::posix_time::seconds(1), processQueuedLaunchesCommand, false))
+      );
+   }
+
+   return Success();
+}
+
 Error SessionManager::launchSession(const r_util::SessionContext& context)
 {
    using namespace boost::posix_time;
    LOCK_MUTEX(launchesMutex_)
    {
+      // queued launches are already pending (but may be older than
+      // the pending launch timeout below)
+      if (isQueuedLaunch(context))
+         return Success();
+
       // check whether we already have a launch pending
       LaunchMap::const_iterator pos = pendingLaunches_.find(context);
       if (pos != pendingLaunches_.end())
@@ -204,24 +313,130 @@ Error SessionManager::launchSession(const r_util::SessionContext& context)
    profile.context = context;
    profile.executablePath = server::options().rsessionPath();
    profile.config = sessionProcessConfig(context);
+   applySessionScheduling(&profile);
 
-   // pass the profile to any filters we have
+   // pass the profile to any filters we have (which may override the
+   // scheduling assigned above)
    BOOST_FOREACH(SessionLaunchProfileFilter f, sessionLaunchProfileFilters_)
    {
       f(&profile);
    }
 
    // launch the session
+   return startLaunch(profile);
+}
+
+Error SessionManager::startLaunch(const r_util::SessionLaunchProfile& profile)
+{
+   using namespace boost::posix_time;
+   int limit = server::options().rsessionLaunchConcurrency();
+   LOCK_MUTEX(launchesMutex_)
+   {
+      if (limit > 0)
+      {
+         ptime now = microsec_clock::universal_time();
+         expireActiveLaunches(now);
+         if (activeLaunches_.size() >= static_cast<std::size_t>(limit))
+         {
+            queuedLaunches_.push_back(profile);
+            return Success();
+         }
+         activeLaunches_[profile.context] = now;
+      }
+   }
+   END_LOCK_MUTEX
+
    Error error = sessionLaunchFunction_(profile);
    if (error)
    {
-      removePendingLaunch(context);
+      removePendingLaunch(profile.context);
       return error;
    }
 
    return Success();
 }
 
+bool SessionManager::processQueuedLaunches()
+{
+   using namespace boost::posix_time;
+   int limit = server::options().rsessionLaunchConcurrency();
+   std::vector<r_util::SessionLaunchProfile> launches;
+   LOCK_MUTEX(launchesMutex_)
+   {
+      ptime now = microsec_clock::universal_time();
+      expireActiveLaunches(now);
+      while (!queuedLaunches_.empty() &&
+             (limit <= 0 ||
+              activeLaunches_.size() < static_cast<std::size_t>(limit)))
+      {
+         const r_util::SessionLaunchProfile& profile = queuedLaunches_.front();
+         activeLaunches_[profile.context] = now;
+         launches.push_back(profile);
+         queuedLaunches_.pop_front();
+      }
+   }
+   END_LOCK_MUTEX
+
+   BOOST_FOREACH(const r_util::SessionLaunchProfile& profile, launches)
+   {
+      Error error = sessionLaunchFunction_(profile);
+      if (error)
+      {
+         LOG_ERROR(error);
+         removePendingLaunch(profile.context);
+      }
+   }
+
+   return !launches.empty();
+}
+
+bool SessionManager::isQueuedLaunch(const r_util::SessionContext& context)
+{
+   BOOST_FOREACH(const r_util::SessionLaunchProfile& profile, queuedLaunches_)
+   {
+      if (profile.context == context)
+         return true;
+   }
+   return false;
+}
+
+void SessionManager::expireActiveLaunches(const boost::posix_time::ptime& now)
+{
+   boost::posix_time::time_duration slot =
+                           boost::posix_time::seconds(kLaunchSlotSeconds);
+   for (LaunchMap::iterator it = activeLaunches_.begin();
+        it != activeLaunches_.end(); )
+   {
+      if ((it->second + slot) < now)
+         activeLaunches_.erase(it++);
+      else
+         ++it;
+   }
+}
+
+Error SessionManager::prelaunchSessions(const FilePath& usersFile)
+{
+   std::vector<std::string> users;
+   Error error = readStringVectorFromFile(usersFile, &users);
+   if (error)
+      return error;
+
+   BOOST_FOREACH(const std::string& username, users)
+   {
+      // skip comments and users who aren't permitted to sign in
+      if (username[0] == '#')
+         continue;
+      if (!auth::validateUser(username))
+         continue;
+
+      error = launchSession(r_util::SessionContext(username));
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   return Success();
+}
+
 namespace {
 
 core::system::ProcessConfigFilter s_processConfigFilter;
@@ -276,11 +491,18 @@ void SessionManager::addSessionLaunchProfileFilter(
 
 void SessionManager::removePendingLaunch(const r_util::SessionContext& context)
 {
+   bool haveQueuedLaunches = false;
    LOCK_MUTEX(launchesMutex_)
    {
       pendingLaunches_.erase(context);
+      activeLaunches_.erase(context);
+      haveQueuedLaunches = !queuedLaunches_.empty();
    }
    END_LOCK_MUTEX
+
+   // a slot may have freed up
+   if (haveQueuedLaunches)
+      processQueuedLaunches();
 }
 
 void SessionManager::notifySIGCHLD()
@@ -16,6 +16,7 @@
 #include <server/ServerSessionProxy.hpp>
 
 #include <vector>
+#include <algorithm>
 #include <sstream>
 #include <map>
 
@@ -34,6 +35,8 @@
 #include <core/Log.hpp>
 #include <core/Thread.hpp>
 #include <core/WaitUtils.hpp>
+#include <core/PeriodicCommand.hpp>
+#include <core/Trace.hpp>
 
 #include <core/http/SocketUtils.hpp>
 #include <core/http/SocketProxy.hpp>
@@ -49,6 +52,8 @@
 
 #include <core/json/JsonRpc.hpp>
 
+#include <monitor/MonitorClient.hpp>
+
 #include <session/SessionConstants.hpp>
 #include <session/SessionLocalStreams.hpp>
 #include <session/SessionInvalidScope.hpp>
@@ -59,9 +64,12 @@
 #include <server/ServerOptions.hpp>
 #include <server/ServerErrorCategory.hpp>
 #include <server/ServerSessionManager.hpp>
+#include <server/ServerScheduler.hpp>
 
 #include <server/ServerConstants.hpp>
 
+#include "ServerSessionConnectionPool.hpp"
+
 using namespace rstudio::core ;
 
 namespace rstudio {
@@ -144,16 +152,87 @@ bool sessionContextForRequest(
    }
 }
 
+// record the span for a proxied request (no-op if tracing is disabled)
+void recordProxySpan(const http::Request& request,
+                     const std::string& requestId,
+                     const boost::posix_time::ptime& startTime)
+{
+   if (core::trace::enabled() && !startTime.is_not_a_date_time())
+   {
+      core::trace::recordSpan("proxy " + request.path(),
+                              startTime,
+                              boost::posix_time::microsec_clock::universal_time(),
+                              requestId);
+   }
+}
+
+// requests in flight to each session (by stream path), so that requests
+// to a session which isn't keeping up can be turned away rather than left
+// to pile up (each holding a client connection) behind the others
+boost::mutex s_inFlightMutex;
+std::map<std::string, int> s_inFlightRequests;
+
+// returns false (and doesn't count the request) if the session already
+// has maxInFlight requests in flight (0 for no limit)
+bool beginProxiedRequest(const FilePath& streamPath, int maxInFlight)
+{
+   LOCK_MUTEX(s_inFlightMutex)
+   {
+      int& inFlight = s_inFlightRequests[streamPath.absolutePath()];
+      if (maxInFlight > 0 && inFlight >= maxInFlight)
+         return false;
+      ++inFlight;
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
+void endProxiedRequest(const FilePath& streamPath)
+{
+   LOCK_MUTEX(s_inFlightMutex)
+   {
+      std::map<std::string, int>::iterator it =
+                           s_inFlightRequests.find(streamPath.absolutePath());
+      if (it != s_inFlightRequests.end() && --(it->second) <= 0)
+         s_inFlightRequests.erase(it);
+   }
+   END_LOCK_MUTEX
+}
+
+void handleProxyError(
+      boost::shared_ptr<core::http::AsyncConnection> ptrConnection,
+      const FilePath& streamPath,
+      const std::string& requestId,
+      const boost::posix_time::ptime& startTime,
+      const http::ErrorHandler& errorHandler,
+      const Error& error)
+{
+   endProxiedRequest(streamPath);
+   recordProxySpan(ptrConnection->request(), requestId, startTime);
+   errorHandler(error);
+}
+
 void handleProxyResponse(
       boost::shared_ptr<core::http::AsyncConnection> ptrConnection,
       const r_util::SessionContext& context,
+      const FilePath& streamPath,
+      connection_pool::Client pClient,
+      const std::string& requestId,
+      const boost::posix_time::ptime& startTime,
       const http::Response& response)
 {
+   endProxiedRequest(streamPath);
+   recordProxySpan(ptrConnection->request(), requestId, startTime);
+
    // if there was a launch pending then remove it
    sessionManager().removePendingLaunch(context);
 
    // write the response
    ptrConnection->writeResponse(response);
+
+   // return the connection to the pool for use by subsequent requests
+   connection_pool::checkin(streamPath, pClient);
 }
 
 class LocalhostAsyncClient : public http::TcpIpAsyncClient
@@ -217,6 +296,36 @@ void rewriteLocalhostAddressHeader(const std::string& headerName,
    pResponse->replaceHeader(headerName, address);
 }
 
+// record the traffic relayed for a proxied websocket (e.g. a shiny app's)
+// so that message rates and relay backlogs can be monitored
+void recordWebsocketStats(const http::SocketProxy::Stats& stats)
+{
+   int intervalSeconds = server::options().monitorIntervalSeconds();
+   if (intervalSeconds <= 0)
+      return;
+
+   double minutes = std::max(stats.duration.total_milliseconds(),
+                             static_cast<boost::int64_t>(1)) / 60000.0;
+   const http::SocketProxy::DirectionStats* directions[] =
+                                       { &stats.fromClient, &stats.fromServer };
+   const char* names[] = { "websocket.from_client.", "websocket.from_server." };
+   for (std::size_t i = 0; i < 2; i++)
+   {
+      const http::SocketProxy::DirectionStats& direction = *directions[i];
+      std::string prefix(names[i]);
+      monitor::client().recordHistogramSample(
+               "server", intervalSeconds, prefix + "messages_per_min",
+               static_cast<boost::uint64_t>(direction.reads / minutes),
+               "messages");
+      monitor::client().recordHistogramSample(
+               "server", intervalSeconds, prefix + "max_queued_bytes",
+               direction.maxQueuedBytes, "bytes");
+      monitor::client().recordHistogramSample(
+               "server", intervalSeconds, prefix + "stalls",
+               direction.stalls);
+   }
+}
+
 void handleLocalhostResponse(
       boost::shared_ptr<core::http::AsyncConnection> ptrConnection,
       boost::shared_ptr<LocalhostAsyncClient> ptrLocalhost,
@@ -235,8 +344,14 @@ void handleLocalhostResponse(
       boost::shared_ptr<http::Socket> ptrServer =
          boost::static_pointer_cast<http::Socket>(ptrLocalhost);
 
-      // connect the sockets
-      http::SocketProxy::create(ptrClient, ptrServer);
+      // connect the sockets (zero-copy if supported by the platform and
+      // both ends are plain sockets). frames are relayed as-is, so any
+      // extensions negotiated by the upgrade (e.g. permessage-deflate)
+      // pass straight through
+      http::SocketProxy::create(ptrClient,
+                                ptrServer,
+                                server::options().wwwProxyZeroCopy(),
+                                recordWebsocketStats);
    }
    // normal response, write and close (handle redirects if necessary)
    else
@@ -471,21 +586,35 @@ void proxyRequest(
       const r_util::SessionContext& context,
       boost::shared_ptr<core::http::AsyncConnection> ptrConnection,
       const http::ErrorHandler& errorHandler,
-      const http::ConnectionRetryProfile& connectionRetryProfile)
+      const http::ConnectionRetryProfile& connectionRetryProfile,
+      int maxInFlight = 0)
 {
    // apply optional proxy filter
    if (applyProxyFilter(ptrConnection, context))
       return;
 
-   // create async client
+   // turn the request away if the session already has too many in flight
+   // (the client can retry once it has caught up)
    std::string streamFile = r_util::sessionContextFile(context);
    FilePath streamPath = session::local_streams::streamPath(streamFile);
-   boost::shared_ptr<http::LocalStreamAsyncClient> pClient(
-    new http::LocalStreamAsyncClient(ptrConnection->ioService(), streamPath));
+   if (!beginProxiedRequest(streamPath, maxInFlight))
+   {
+      http::Response& response = ptrConnection->response();
+      response.setStatusCode(http::status::ServiceUnavailable);
+      response.setHeader("Retry-After", "1");
+      ptrConnection->writeResponse();
+      return;
+   }
+
+   // get an async client (re-uses a pooled connection to the session
+   // if one is available)
+   connection_pool::Client pClient = connection_pool::checkout(
+                                          ptrConnection->ioService(),
+                                          streamPath);
 
-   // setup retry context
-   if (!connectionRetryProfile.empty())
-      pClient->setConnectionRetryProfile(connectionRetryProfile);
+   // setup retry context (always set since pooled clients may retain
+   // the profile from a previous request)
+   pClient->setConnectionRetryProfile(connectionRetryProfile);
 
    // assign request
    pClient->request().assign(ptrConnection->request());
@@ -494,10 +623,28 @@ void proxyRequest(
    if (s_proxyRequestFilter)
       s_proxyRequestFilter(&(pClient->request()));
 
+   // when tracing propagate a request id to the session (so that its spans
+   // can be correlated with ours)
+   std::string requestId;
+   boost::posix_time::ptime startTime;
+   if (core::trace::enabled())
+   {
+      requestId = ptrConnection->request().headerValue(
+                                             core::trace::kRequestIdHeader);
+      if (requestId.empty())
+         requestId = core::trace::newRequestId();
+      pClient->request().setHeader(core::trace::kRequestIdHeader, requestId);
+      startTime = boost::posix_time::microsec_clock::universal_time();
+   }
+
    // execute
    pClient->execute(
-         boost::bind(handleProxyResponse, ptrConnection, context, _1),
-         errorHandler);
+         boost::bind(handleProxyResponse,
+                     ptrConnection, context, streamPath, pClient,
+                     requestId, startTime, _1),
+         boost::bind(handleProxyError,
+                     ptrConnection, streamPath, requestId, startTime,
+                     errorHandler, _1));
 }
 
 // function used to periodically validate that the user is valid (has an
@@ -513,6 +660,12 @@ void proxyRequest(
 // if they fail before during session launch since there isn't adequate
 // http connection context at that level of the system to return
 // json::errc::Unauthorized)
+bool closeExpiredConnections()
+{
+   connection_pool::closeExpired();
+   return true;
+}
+
 bool validateUser(boost::shared_ptr<http::AsyncConnection> ptrConnection,
                   const std::string& username)
 {
@@ -534,9 +687,28 @@ bool validateUser(boost::shared_ptr<http::AsyncConnection> ptrConnection,
 
 Error initialize()
 { 
+   connection_pool::initialize(
+      std::max(0, server::options().rsessionConnectionPoolSize()),
+      boost::posix_time::seconds(
+         server::options().rsessionConnectionIdleTimeoutSeconds()));
+
    return session::local_streams::ensureStreamsDir();
 }
 
+Error initializeConnectionPool()
+{
+   // periodically close idle connections to sessions
+   if (connection_pool::enabled())
+   {
+      scheduler::addCommand(
+         boost::shared_ptr<ScheduledCommand>(new PeriodicCommand(
+            boost::posix_time::seconds(5), closeExpiredConnections, false))
+      );
+   }
+
+   return Success();
+}
+
 Error runVerifyInstallationSession()
 {
    // get current user
@@ -568,10 +740,16 @@ void proxyContentRequest(
    if (!sessionContextForRequest(ptrConnection, username, &context))
       return;
 
+   // only idempotent requests can be turned away when the session is busy
+   const std::string& method = ptrConnection->request().method();
+   int maxInFlight = (method == "GET" || method == "HEAD") ?
+                        server::options().rsessionMaxInFlightRequests() : 0;
+
    proxyRequest(context,
                 ptrConnection,
                 boost::bind(handleContentError, ptrConnection, context, _1),
-                sessionRetryProfile(context));
+                sessionRetryProfile(context),
+                maxInFlight);
 }
 
 void proxyRpcRequest(
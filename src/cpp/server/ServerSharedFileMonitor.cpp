@@ -0,0 +1,823 @@
+/*
+ * ServerSharedFileMonitor.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "ServerSharedFileMonitor.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <grp.h>
+
+#include <map>
+#include <algorithm>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileInfo.hpp>
+#include <core/Thread.hpp>
+#include <core/PeriodicCommand.hpp>
+#include <core/collection/Tree.hpp>
+
+#include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
+
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+#include <core/http/LocalStreamAsyncServer.hpp>
+
+#include <core/system/System.hpp>
+#include <core/system/PosixUser.hpp>
+#include <core/system/FileMonitor.hpp>
+#include <core/system/FileChangeEvent.hpp>
+
+#include <session/SessionConstants.hpp>
+
+#include <server/ServerScheduler.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::system;
+
+namespace rstudio {
+namespace server {
+namespace shared_file_monitor {
+
+namespace {
+
+// how long an events request waits for changes before returning empty
+const int kEventsPollSeconds = 30;
+
+// subscribers which haven't polled for events in this long are assumed
+// to belong to sessions which have gone away
+const int kSubscriberTimeoutSeconds = 120;
+
+typedef boost::shared_ptr<http::AsyncConnection> Connection;
+
+boost::posix_time::ptime now()
+{
+   return boost::posix_time::microsec_clock::universal_time();
+}
+
+struct Subscriber
+{
+   Subscriber()
+      : uid(-1)
+   {
+   }
+
+   std::string id;
+   int uid;
+   std::string path;
+
+   // changes not yet delivered, coalesced by path (so the backlog of an
+   // inactive subscriber is bounded by the number of files in the tree)
+   std::map<std::string, FileChangeEvent> pending;
+
+   // outstanding events request (if any)
+   Connection pollConnection;
+   boost::posix_time::ptime pollExpires;
+
+   boost::posix_time::ptime lastActivity;
+
+   // set if monitoring of the directory fails
+   std::string error;
+};
+
+struct SharedMonitor
+{
+   SharedMonitor()
+      : registered(false)
+   {
+   }
+
+   bool registered;
+   file_monitor::Handle handle;
+
+   // current contents of the directory (keyed by absolute path, which
+   // orders parent directories ahead of their children)
+   std::map<std::string, FileInfo> files;
+
+   std::vector<std::string> subscriberIds;
+
+   // subscribe requests awaiting registration
+   std::vector<std::pair<std::string, Connection> > waiting;
+};
+
+typedef boost::shared_ptr<Subscriber> SubscriberPtr;
+typedef boost::shared_ptr<SharedMonitor> SharedMonitorPtr;
+
+// all state is protected by a single mutex: requests arrive on the local
+// stream server's threads while file monitor callbacks and periodic
+// maintenance occur on the http server's scheduled command thread
+boost::mutex s_mutex;
+std::map<std::string, SharedMonitorPtr> s_monitors;
+std::map<std::string, SubscriberPtr> s_subscribers;
+
+boost::shared_ptr<http::LocalStreamAsyncServer> s_pServer;
+
+// a response to be written once the mutex has been released
+typedef std::vector<std::pair<Connection, boost::shared_ptr<http::Response> > >
+                                                                  Responses;
+
+void addJsonResponse(Connection pConnection,
+                     const json::Value& value,
+                     Responses* pResponses)
+{
+   boost::shared_ptr<http::Response> pResponse(new http::Response());
+   pResponse->setNoCacheHeaders();
+   pResponse->setContentType(json::kJsonContentType);
+   pResponse->setBody(json::write(value));
+   pResponses->push_back(std::make_pair(pConnection, pResponse));
+}
+
+void addErrorResponse(Connection pConnection,
+                      int status,
+                      const std::string& message,
+                      Responses* pResponses)
+{
+   boost::shared_ptr<http::Response> pResponse(new http::Response());
+   pResponse->setError(status, message);
+   pResponses->push_back(std::make_pair(pConnection, pResponse));
+}
+
+void writeResponses(const Responses& responses)
+{
+   for (Responses::const_iterator it = responses.begin();
+        it != responses.end();
+        ++it)
+   {
+      it->first->writeResponse(*(it->second));
+   }
+}
+
+json::Array fileInfoAsJson(const FileInfo& fileInfo)
+{
+   json::Array fileJson;
+   fileJson.push_back(fileInfo.absolutePath());
+   fileJson.push_back(fileInfo.isDirectory());
+   fileJson.push_back(static_cast<boost::uint64_t>(fileInfo.size()));
+   fileJson.push_back(static_cast<boost::int64_t>(fileInfo.lastWriteTime()));
+   return fileJson;
+}
+
+json::Object listingAsJson(const std::string& id,
+                           const SharedMonitor& monitor)
+{
+   json::Array filesJson;
+   for (std::map<std::string, FileInfo>::const_iterator it =
+         monitor.files.begin(); it != monitor.files.end(); ++it)
+   {
+      filesJson.push_back(fileInfoAsJson(it->second));
+   }
+
+   json::Object resultJson;
+   resultJson["id"] = id;
+   resultJson["files"] = filesJson;
+   return resultJson;
+}
+
+// exclude hidden directories (e.g. .git) from the shared tree. sessions
+// don't show these (and hidden files are filtered by each session based
+// on its own whitelist and settings)
+bool sharedFilter(const FileInfo& fileInfo)
+{
+   return !fileInfo.isDirectory() ||
+          !FilePath(fileInfo.absolutePath()).isHidden();
+}
+
+// does the specified user have permission to list the directory? (i.e.
+// search permission on each ancestor and read permission on the directory)
+bool userCanReadDirectory(int uid, const std::string& path)
+{
+   if (uid < 0)
+      return false;
+   if (uid == 0)
+      return true;
+
+   user::User user;
+   Error error = user::userFromId(uid, &user);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   // get the user's group memberships
+   int groupCount = 64;
+   std::vector<gid_t> groups(groupCount);
+   if (::getgrouplist(user.username.c_str(), user.groupId,
+                      &groups[0], &groupCount) == -1)
+   {
+      groups.resize(groupCount);
+      if (::getgrouplist(user.username.c_str(), user.groupId,
+                         &groups[0], &groupCount) == -1)
+      {
+         return false;
+      }
+   }
+   groups.resize(groupCount);
+
+   std::string::size_type pos = 0;
+   while (pos != std::string::npos)
+   {
+      pos = path.find('/', pos + 1);
+      bool isTarget = (pos == std::string::npos);
+      std::string component = isTarget ? path : path.substr(0, pos);
+
+      struct stat st;
+      if (::stat(component.c_str(), &st) == -1)
+         return false;
+
+      mode_t searchBit, readBit;
+      if (st.st_uid == static_cast<uid_t>(uid))
+      {
+         searchBit = S_IXUSR;
+         readBit = S_IRUSR;
+      }
+      else if (std::find(groups.begin(), groups.end(), st.st_gid) !=
+               groups.end())
+      {
+         searchBit = S_IXGRP;
+         readBit = S_IRGRP;
+      }
+      else
+      {
+         searchBit = S_IXOTH;
+         readBit = S_IROTH;
+      }
+
+      if (!(st.st_mode & searchBit))
+         return false;
+      if (isTarget && !(st.st_mode & readBit))
+         return false;
+   }
+
+   return true;
+}
+
+// coalesce a change into a subscriber's pending changes
+void addPendingChange(const FileChangeEvent& event, Subscriber* pSubscriber)
+{
+   std::string path = event.fileInfo().absolutePath();
+   std::map<std::string, FileChangeEvent>::iterator it =
+                                             pSubscriber->pending.find(path);
+   if (it == pSubscriber->pending.end())
+   {
+      pSubscriber->pending.insert(std::make_pair(path, event));
+      return;
+   }
+
+   FileChangeEvent::Type prevType = it->second.type();
+   FileChangeEvent::Type type = event.type();
+   if (prevType == FileChangeEvent::FileAdded &&
+       type == FileChangeEvent::FileRemoved)
+   {
+      // never seen by the subscriber
+      pSubscriber->pending.erase(it);
+   }
+   else if (prevType == FileChangeEvent::FileAdded)
+   {
+      // still an addition (with the latest file info)
+      it->second = FileChangeEvent(FileChangeEvent::FileAdded,
+                                   event.fileInfo());
+   }
+   else if (prevType == FileChangeEvent::FileRemoved &&
+            type == FileChangeEvent::FileAdded)
+   {
+      it->second = FileChangeEvent(FileChangeEvent::FileModified,
+                                   event.fileInfo());
+   }
+   else
+   {
+      it->second = event;
+   }
+}
+
+json::Object takePendingChanges(Subscriber* pSubscriber)
+{
+   json::Array eventsJson;
+   for (std::map<std::string, FileChangeEvent>::const_iterator it =
+         pSubscriber->pending.begin(); it != pSubscriber->pending.end(); ++it)
+   {
+      json::Array eventJson = fileInfoAsJson(it->second.fileInfo());
+      eventJson.insert(eventJson.begin(),
+                       static_cast<int>(it->second.type()));
+      eventsJson.push_back(eventJson);
+   }
+   pSubscriber->pending.clear();
+
+   json::Object resultJson;
+   resultJson["events"] = eventsJson;
+   return resultJson;
+}
+
+json::Object errorAsJson(const std::string& message)
+{
+   json::Object resultJson;
+   resultJson["error"] = message;
+   return resultJson;
+}
+
+// complete the subscriber's outstanding events request (if any)
+void completePoll(Subscriber* pSubscriber, Responses* pResponses)
+{
+   if (!pSubscriber->pollConnection)
+      return;
+
+   if (!pSubscriber->error.empty())
+   {
+      addJsonResponse(pSubscriber->pollConnection,
+                      errorAsJson(pSubscriber->error),
+                      pResponses);
+   }
+   else
+   {
+      addJsonResponse(pSubscriber->pollConnection,
+                      takePendingChanges(pSubscriber),
+                      pResponses);
+   }
+   pSubscriber->pollConnection.reset();
+}
+
+// remove the subscriber (and the monitor once it has no subscribers).
+// must be called with the mutex held
+void removeSubscriber(const std::string& id, Responses* pResponses)
+{
+   std::map<std::string, SubscriberPtr>::iterator it = s_subscribers.find(id);
+   if (it == s_subscribers.end())
+      return;
+   SubscriberPtr pSubscriber = it->second;
+   s_subscribers.erase(it);
+
+   completePoll(pSubscriber.get(), pResponses);
+
+   std::map<std::string, SharedMonitorPtr>::iterator monitorIt =
+                                       s_monitors.find(pSubscriber->path);
+   if (monitorIt == s_monitors.end())
+      return;
+   SharedMonitorPtr pMonitor = monitorIt->second;
+
+   std::vector<std::string>& ids = pMonitor->subscriberIds;
+   ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+
+   // unregister monitors which are no longer needed (monitors which are
+   // pending registration are unregistered once registered)
+   if (ids.empty() && pMonitor->registered)
+   {
+      file_monitor::unregisterMonitor(pMonitor->handle);
+      s_monitors.erase(monitorIt);
+   }
+}
+
+// terminate monitoring of a directory, notifying its subscribers. must be
+// called with the mutex held
+void terminateMonitor(const std::string& path,
+                      const std::string& message,
+                      Responses* pResponses)
+{
+   std::map<std::string, SharedMonitorPtr>::iterator it =
+                                                   s_monitors.find(path);
+   if (it == s_monitors.end())
+      return;
+   SharedMonitorPtr pMonitor = it->second;
+   s_monitors.erase(it);
+
+   // fail pending subscriptions
+   for (std::size_t i = 0; i < pMonitor->waiting.size(); i++)
+   {
+      s_subscribers.erase(pMonitor->waiting[i].first);
+      addErrorResponse(pMonitor->waiting[i].second,
+                       http::status::InternalServerError,
+                       message,
+                       pResponses);
+   }
+
+   // existing subscribers receive the error with their next poll (after
+   // which they are removed)
+   BOOST_FOREACH(const std::string& id, pMonitor->subscriberIds)
+   {
+      std::map<std::string, SubscriberPtr>::iterator subIt =
+                                                      s_subscribers.find(id);
+      if (subIt == s_subscribers.end())
+         continue;
+
+      subIt->second->error = message;
+      subIt->second->pending.clear();
+      if (subIt->second->pollConnection)
+      {
+         completePoll(subIt->second.get(), pResponses);
+         s_subscribers.erase(subIt);
+      }
+   }
+}
+
+void onRegistered(const std::string& path,
+                  file_monitor::Handle handle,
+                  const tree<FileInfo>& files)
+{
+   Responses responses;
+
+   LOCK_MUTEX(s_mutex)
+   {
+      std::map<std::string, SharedMonitorPtr>::iterator it =
+                                                      s_monitors.find(path);
+      if (it == s_monitors.end())
+      {
+         file_monitor::unregisterMonitor(handle);
+         return;
+      }
+      SharedMonitorPtr pMonitor = it->second;
+
+      pMonitor->registered = true;
+      pMonitor->handle = handle;
+
+      // record the listing (the root is the first node)
+      tree<FileInfo>::iterator fileIt = files.begin();
+      if (fileIt != files.end())
+         ++fileIt;
+      for (; fileIt != files.end(); ++fileIt)
+         pMonitor->files.insert(std::make_pair(fileIt->absolutePath(),
+                                               *fileIt));
+
+      // complete pending subscriptions
+      for (std::size_t i = 0; i < pMonitor->waiting.size(); i++)
+      {
+         const std::string& id = pMonitor->waiting[i].first;
+         if (s_subscribers.find(id) == s_subscribers.end())
+            continue;
+         pMonitor->subscriberIds.push_back(id);
+         addJsonResponse(pMonitor->waiting[i].second,
+                         listingAsJson(id, *pMonitor),
+                         &responses);
+      }
+      pMonitor->waiting.clear();
+
+      // everyone left before we were registered
+      if (pMonitor->subscriberIds.empty())
+      {
+         file_monitor::unregisterMonitor(handle);
+         s_monitors.erase(it);
+      }
+   }
+   END_LOCK_MUTEX
+
+   writeResponses(responses);
+}
+
+void onFilesChanged(const std::string& path,
+                    const std::vector<FileChangeEvent>& events)
+{
+   Responses responses;
+
+   LOCK_MUTEX(s_mutex)
+   {
+      std::map<std::string, SharedMonitorPtr>::iterator it =
+                                                      s_monitors.find(path);
+      if (it == s_monitors.end())
+         return;
+      SharedMonitorPtr pMonitor = it->second;
+
+      // update the listing
+      BOOST_FOREACH(const FileChangeEvent& event, events)
+      {
+         const FileInfo& fileInfo = event.fileInfo();
+         std::string filePath = fileInfo.absolutePath();
+         if (event.type() == FileChangeEvent::FileRemoved)
+         {
+            pMonitor->files.erase(filePath);
+            if (fileInfo.isDirectory())
+            {
+               std::string prefix = filePath + "/";
+               std::map<std::string, FileInfo>::iterator childIt =
+                                       pMonitor->files.lower_bound(prefix);
+               while (childIt != pMonitor->files.end() &&
+                      boost::algorithm::starts_with(childIt->first, prefix))
+               {
+                  pMonitor->files.erase(childIt++);
+               }
+            }
+         }
+         else
+         {
+            pMonitor->files[filePath] = fileInfo;
+         }
+      }
+
+      // queue for subscribers
+      BOOST_FOREACH(const std::string& id, pMonitor->subscriberIds)
+      {
+         std::map<std::string, SubscriberPtr>::iterator subIt =
+                                                      s_subscribers.find(id);
+         if (subIt == s_subscribers.end())
+            continue;
+
+         BOOST_FOREACH(const FileChangeEvent& event, events)
+         {
+            addPendingChange(event, subIt->second.get());
+         }
+         completePoll(subIt->second.get(), &responses);
+      }
+   }
+   END_LOCK_MUTEX
+
+   writeResponses(responses);
+}
+
+void onMonitorError(const std::string& path, const Error& error)
+{
+   LOG_ERROR(error);
+
+   Responses responses;
+   LOCK_MUTEX(s_mutex)
+   {
+      terminateMonitor(path, error.summary(), &responses);
+   }
+   END_LOCK_MUTEX
+   writeResponses(responses);
+}
+
+void onUnregistered(const std::string& path, file_monitor::Handle handle)
+{
+   // monitors we unregister are removed beforehand, so this indicates
+   // monitoring was stopped out from under us
+   Responses responses;
+   LOCK_MUTEX(s_mutex)
+   {
+      std::map<std::string, SharedMonitorPtr>::iterator it =
+                                                      s_monitors.find(path);
+      if (it != s_monitors.end() && it->second->handle == handle)
+         terminateMonitor(path, "File monitor unregistered", &responses);
+   }
+   END_LOCK_MUTEX
+   writeResponses(responses);
+}
+
+bool readRequestObject(Connection pConnection, json::Object* pObject)
+{
+   json::Value value;
+   if (!json::parse(pConnection->request().body(), &value) ||
+       !json::isType<json::Object>(value))
+   {
+      pConnection->response().setError(http::status::BadRequest,
+                                        "Invalid request");
+      pConnection->writeResponse();
+      return false;
+   }
+
+   *pObject = value.get_obj();
+   return true;
+}
+
+void handleSubscribe(Connection pConnection)
+{
+   json::Object requestJson;
+   if (!readRequestObject(pConnection, &requestJson))
+      return;
+
+   std::string path;
+   Error error = json::readObject(requestJson, "path", &path);
+   if (error || path.empty() || path[0] != '/')
+   {
+      pConnection->response().setError(http::status::BadRequest,
+                                        "Invalid path");
+      pConnection->writeResponse();
+      return;
+   }
+   path = FilePath(path).absolutePath();
+
+   int uid = pConnection->request().remoteUid();
+   if (!userCanReadDirectory(uid, path))
+   {
+      pConnection->response().setError(http::status::Forbidden,
+                                        "Access denied");
+      pConnection->writeResponse();
+      return;
+   }
+
+   SubscriberPtr pSubscriber(new Subscriber());
+   pSubscriber->id = core::system::generateShortenedUuid();
+   pSubscriber->uid = uid;
+   pSubscriber->path = path;
+   pSubscriber->lastActivity = now();
+
+   Responses responses;
+   bool needsRegistration = false;
+   LOCK_MUTEX(s_mutex)
+   {
+      s_subscribers[pSubscriber->id] = pSubscriber;
+
+      SharedMonitorPtr& pMonitor = s_monitors[path];
+      if (!pMonitor)
+      {
+         pMonitor.reset(new SharedMonitor());
+         needsRegistration = true;
+      }
+
+      if (pMonitor->registered)
+      {
+         pMonitor->subscriberIds.push_back(pSubscriber->id);
+         addJsonResponse(pConnection,
+                         listingAsJson(pSubscriber->id, *pMonitor),
+                         &responses);
+      }
+      else
+      {
+         pMonitor->waiting.push_back(std::make_pair(pSubscriber->id,
+                                                    pConnection));
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (needsRegistration)
+   {
+      file_monitor::Callbacks cb;
+      cb.onRegistered = boost::bind(onRegistered, path, _1, _2);
+      cb.onRegistrationError = boost::bind(onMonitorError, path, _1);
+      cb.onMonitoringError = boost::bind(onMonitorError, path, _1);
+      cb.onFilesChanged = boost::bind(onFilesChanged, path, _1);
+      cb.onUnregistered = boost::bind(onUnregistered, path, _1);
+      file_monitor::registerMonitor(FilePath(path),
+                                    true,
+                                    sharedFilter,
+                                    cb);
+   }
+
+   writeResponses(responses);
+}
+
+// find the requesting subscriber, writing an error response if there
+// isn't one. must be called with the mutex held
+SubscriberPtr requestSubscriber(Connection pConnection,
+                                const json::Object& requestJson,
+                                Responses* pResponses)
+{
+   std::string id;
+   Error error = json::readObject(requestJson, "id", &id);
+   std::map<std::string, SubscriberPtr>::iterator it = s_subscribers.find(id);
+   if (error ||
+       it == s_subscribers.end() ||
+       it->second->uid != pConnection->request().remoteUid())
+   {
+      addErrorResponse(pConnection,
+                       http::status::NotFound,
+                       "Subscription not found",
+                       pResponses);
+      return SubscriberPtr();
+   }
+   return it->second;
+}
+
+void handleEvents(Connection pConnection)
+{
+   json::Object requestJson;
+   if (!readRequestObject(pConnection, &requestJson))
+      return;
+
+   Responses responses;
+   LOCK_MUTEX(s_mutex)
+   {
+      SubscriberPtr pSubscriber = requestSubscriber(pConnection,
+                                                    requestJson,
+                                                    &responses);
+      if (pSubscriber)
+      {
+         pSubscriber->lastActivity = now();
+
+         // only one outstanding poll per subscriber
+         completePoll(pSubscriber.get(), &responses);
+
+         pSubscriber->pollConnection = pConnection;
+         pSubscriber->pollExpires =
+               now() + boost::posix_time::seconds(kEventsPollSeconds);
+
+         if (!pSubscriber->error.empty())
+         {
+            completePoll(pSubscriber.get(), &responses);
+            s_subscribers.erase(pSubscriber->id);
+         }
+         else if (!pSubscriber->pending.empty())
+         {
+            completePoll(pSubscriber.get(), &responses);
+         }
+      }
+   }
+   END_LOCK_MUTEX
+
+   writeResponses(responses);
+}
+
+void handleUnsubscribe(Connection pConnection)
+{
+   json::Object requestJson;
+   if (!readRequestObject(pConnection, &requestJson))
+      return;
+
+   Responses responses;
+   LOCK_MUTEX(s_mutex)
+   {
+      SubscriberPtr pSubscriber = requestSubscriber(pConnection,
+                                                    requestJson,
+                                                    &responses);
+      if (pSubscriber)
+      {
+         removeSubscriber(pSubscriber->id, &responses);
+         addJsonResponse(pConnection, json::Object(), &responses);
+      }
+   }
+   END_LOCK_MUTEX
+
+   writeResponses(responses);
+}
+
+bool expireSubscribers()
+{
+   Responses responses;
+   LOCK_MUTEX(s_mutex)
+   {
+      boost::posix_time::ptime time = now();
+      boost::posix_time::ptime timeout =
+            time - boost::posix_time::seconds(kSubscriberTimeoutSeconds);
+
+      std::vector<std::string> expired;
+      for (std::map<std::string, SubscriberPtr>::iterator it =
+            s_subscribers.begin(); it != s_subscribers.end(); ++it)
+      {
+         Subscriber* pSubscriber = it->second.get();
+         if (pSubscriber->pollConnection)
+         {
+            // return empty results for polls which have waited long enough
+            if (time >= pSubscriber->pollExpires)
+            {
+               completePoll(pSubscriber, &responses);
+               pSubscriber->lastActivity = time;
+            }
+         }
+         else if (pSubscriber->lastActivity < timeout)
+         {
+            expired.push_back(it->first);
+         }
+      }
+
+      BOOST_FOREACH(const std::string& id, expired)
+      {
+         removeSubscriber(id, &responses);
+      }
+   }
+   END_LOCK_MUTEX
+
+   writeResponses(responses);
+   return true;
+}
+
+} // anonymous namespace
+
+Error initialize()
+{
+   // start file monitoring (changes are checked for periodically on the
+   // scheduled command thread)
+   file_monitor::initialize();
+   scheduler::addCommand(file_monitor::checkForChangesCommand(
+                                    boost::posix_time::milliseconds(500)));
+   scheduler::addCommand(boost::shared_ptr<ScheduledCommand>(
+         new PeriodicCommand(boost::posix_time::seconds(1),
+                             expireSubscribers,
+                             false)));
+
+   // any user may connect (subscriptions are authorized per directory
+   // based on the identity of the connecting process)
+   s_pServer.reset(new http::LocalStreamAsyncServer(
+                                       "Shared File Monitor",
+                                       std::string(),
+                                       core::system::EveryoneReadWriteMode));
+   Error error = s_pServer->init(FilePath(kSharedFileMonitorSocketPath));
+   if (error)
+      return error;
+
+   s_pServer->addHandler("/subscribe", handleSubscribe);
+   s_pServer->addHandler("/events", handleEvents);
+   s_pServer->addHandler("/unsubscribe", handleUnsubscribe);
+
+   return s_pServer->run(2);
+}
+
+} // namespace shared_file_monitor
+} // namespace server
+} // namespace rstudio
@@ -0,0 +1,48 @@
+/*
+ * ServerSharedFileMonitor.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SERVER_SHARED_FILE_MONITOR_HPP
+#define SERVER_SHARED_FILE_MONITOR_HPP
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace server {
+namespace shared_file_monitor {
+
+// The shared file monitor maintains a single recursive file monitor for
+// each directory which sessions subscribe to (over a local stream) rather
+// than having every session which opens the same (typically shared)
+// project register its own inotify watches and build its own tree. Each
+// session applies its own file listing filter to the events it receives.
+//
+// Subscribers are only accepted for directories which the connecting user
+// could read themselves. Since the monitor runs as the server user it can
+// only watch directories which that user can also read -- sessions fall
+// back to monitoring locally when a subscription is refused.
+
+// start the service (call after dropping privilege and before the
+// http server is run, since this adds scheduled commands)
+core::Error initialize();
+
+} // namespace shared_file_monitor
+} // namespace server
+} // namespace rstudio
+
+#endif // SERVER_SHARED_FILE_MONITOR_HPP
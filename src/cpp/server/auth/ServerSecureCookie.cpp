@@ -17,13 +17,18 @@
 
 #include <sys/stat.h>
 
+#include <map>
+
+#include <boost/utility.hpp>
 #include <boost/optional.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
 
 #include <core/Log.hpp>
+#include <core/Thread.hpp>
 #include <core/FileSerializer.hpp>
 
 #include <core/http/URL.hpp>
@@ -54,6 +59,122 @@ const char * const kDelim = "|";
 // secure cookie key
 std::string s_secureCookieKey ;
 
+// Cache of cookies which have already been verified (signed cookie value
+// to value and expiration) so we don't need to recompute the hmac for
+// every request. It is sharded to limit lock contention between the http
+// server threads and each shard is bounded (expired entries are purged
+// when a shard fills and if that doesn't help the shard is cleared). The
+// generation is bumped whenever the cache is cleared (e.g. on key change)
+// so that verifications which raced with the clear aren't inserted.
+class VerifiedCookieCache : boost::noncopyable
+{
+public:
+   VerifiedCookieCache() : generation_(0) {}
+
+   long generation() { return __sync_fetch_and_add(&generation_, 0); }
+
+   bool find(const std::string& signedValue,
+             const boost::posix_time::ptime& now,
+             std::string* pValue)
+   {
+      Shard& shard = shardFor(signedValue);
+      LOCK_MUTEX(shard.mutex)
+      {
+         Entries::iterator it = shard.entries.find(signedValue);
+         if (it == shard.entries.end())
+            return false;
+
+         if (it->second.expires <= now)
+         {
+            shard.entries.erase(it);
+            return false;
+         }
+
+         *pValue = it->second.value;
+         return true;
+      }
+      END_LOCK_MUTEX
+
+      // keep compiler happy
+      return false;
+   }
+
+   void insert(const std::string& signedValue,
+               const std::string& value,
+               const boost::posix_time::ptime& expires,
+               const boost::posix_time::ptime& now,
+               long generation)
+   {
+      Shard& shard = shardFor(signedValue);
+      LOCK_MUTEX(shard.mutex)
+      {
+         if (generation != this->generation())
+            return;
+
+         if (shard.entries.size() >= kMaxShardEntries)
+         {
+            for (Entries::iterator it = shard.entries.begin();
+                 it != shard.entries.end(); )
+            {
+               if (it->second.expires <= now)
+                  shard.entries.erase(it++);
+               else
+                  ++it;
+            }
+
+            if (shard.entries.size() >= kMaxShardEntries)
+               shard.entries.clear();
+         }
+
+         Entry& entry = shard.entries[signedValue];
+         entry.value = value;
+         entry.expires = expires;
+      }
+      END_LOCK_MUTEX
+   }
+
+   void clear()
+   {
+      __sync_fetch_and_add(&generation_, 1);
+      for (std::size_t i = 0; i < kShards; i++)
+      {
+         LOCK_MUTEX(shards_[i].mutex)
+         {
+            shards_[i].entries.clear();
+         }
+         END_LOCK_MUTEX
+      }
+   }
+
+private:
+   static const std::size_t kShards = 16;
+   static const std::size_t kMaxShardEntries = 256;
+
+   struct Entry
+   {
+      std::string value;
+      boost::posix_time::ptime expires;
+   };
+   typedef std::map<std::string,Entry> Entries;
+
+   struct Shard
+   {
+      boost::mutex mutex;
+      Entries entries;
+   };
+
+   Shard& shardFor(const std::string& signedValue)
+   {
+      return shards_[boost::hash<std::string>()(signedValue) % kShards];
+   }
+
+private:
+   volatile long generation_;
+   Shard shards_[kShards];
+};
+
+VerifiedCookieCache s_verifiedCookies;
+
 
 Error base64HMAC(const std::string& value,
                  const std::string& expires,
@@ -130,6 +251,14 @@ std::string readSecureCookie(const core::http::Request& request,
    if (signedCookieValue.empty())
       return std::string();
 
+   // check for a previously verified cookie
+   using namespace boost::posix_time;
+   ptime now = second_clock::universal_time();
+   std::string cachedValue;
+   if (s_verifiedCookies.find(signedCookieValue, now, &cachedValue))
+      return cachedValue;
+   long cacheGeneration = s_verifiedCookies.generation();
+
    // split it into its parts (url decode them as well)
    std::string value, expires, hmac;
    using namespace boost;
@@ -173,14 +302,18 @@ std::string readSecureCookie(const core::http::Request& request,
    }
 
    // check the expiration
-   using namespace boost::posix_time;
    ptime expiresTime = http::util::parseHttpDate(expires);
    if (expiresTime.is_not_a_date_time())
       return std::string();
-   else if (expiresTime <= second_clock::universal_time())
+   else if (expiresTime <= now)
       return std::string();
 
-   // ok to return the value
+   // cache and return the value
+   s_verifiedCookies.insert(signedCookieValue,
+                            value,
+                            expiresTime,
+                            now,
+                            cacheGeneration);
    return value;
 }
 
@@ -240,7 +373,13 @@ void remove(const http::Request& request,
 
 Error initialize()
 {
-   return key_file::readSecureKeyFile("secure-cookie-key", &s_secureCookieKey);
+   Error error = key_file::readSecureKeyFile("secure-cookie-key",
+                                             &s_secureCookieKey);
+
+   // cookies verified against a previous key are no longer valid
+   s_verifiedCookies.clear();
+
+   return error;
 }
 
 
@@ -78,6 +78,10 @@ public:
 
    bool serverSetUmask() const { return serverSetUmask_; }
 
+   bool serverTrace() const { return serverTrace_; }
+
+   bool serverSharedFileMonitor() const { return serverSharedFileMonitor_; }
+
    // www 
    std::string wwwAddress() const
    { 
@@ -119,6 +123,16 @@ public:
       return wwwThreadPoolSize_;
    }
 
+   bool wwwIoServicePerThread() const
+   {
+      return wwwIoServicePerThread_;
+   }
+
+   bool wwwThreadCpuAffinity() const
+   {
+      return wwwThreadCpuAffinity_;
+   }
+
    bool wwwProxyLocalhost() const
    {
       return wwwProxyLocalhost_;
@@ -129,6 +143,26 @@ public:
       return wwwVerifyUserAgent_;
    }
 
+   bool wwwProxyZeroCopy() const
+   {
+      return wwwProxyZeroCopy_;
+   }
+
+   bool wwwCompressResponses() const
+   {
+      return wwwCompressResponses_;
+   }
+
+   int wwwCompressMinSize() const
+   {
+      return wwwCompressMinSize_;
+   }
+
+   bool wwwKeepAlive() const
+   {
+      return wwwKeepAlive_;
+   }
+
    // auth
    bool authNone()
    {
@@ -165,6 +199,16 @@ public:
       return std::string(authPamHelperPath_.c_str());
    }
 
+   int authPamWorkers() const
+   {
+      return authPamWorkers_;
+   }
+
+   int authPamMaxPending() const
+   {
+      return authPamMaxPending_;
+   }
+
    // rsession
    std::string rsessionWhichR() const
    {
@@ -191,6 +235,66 @@ public:
       return std::string(rsessionConfigFile_.c_str()); 
    }
 
+   int rsessionConnectionPoolSize() const
+   {
+      return rsessionConnectionPoolSize_;
+   }
+
+   int rsessionConnectionIdleTimeoutSeconds() const
+   {
+      return rsessionConnectionIdleTimeoutSeconds_;
+   }
+
+   int rsessionMaxInFlightRequests() const
+   {
+      return rsessionMaxInFlightRequests_;
+   }
+
+   int rsessionLaunchConcurrency() const
+   {
+      return rsessionLaunchConcurrency_;
+   }
+
+   std::string rsessionPrelaunchUsers() const
+   {
+      return std::string(rsessionPrelaunchUsers_.c_str());
+   }
+
+   std::string rsessionCpuCgroup() const
+   {
+      return std::string(rsessionCpuCgroup_.c_str());
+   }
+
+   int rsessionCpuWeight() const
+   {
+      return rsessionCpuWeight_;
+   }
+
+   std::string rsessionBatchGroup() const
+   {
+      return std::string(rsessionBatchGroup_.c_str());
+   }
+
+   int rsessionBatchCpuWeight() const
+   {
+      return rsessionBatchCpuWeight_;
+   }
+
+   double rsessionBusyLoad() const
+   {
+      return rsessionBusyLoad_;
+   }
+
+   int rsessionBusyBatchPriority() const
+   {
+      return rsessionBusyBatchPriority_;
+   }
+
+   int rsessionIdlePriority() const
+   {
+      return rsessionIdlePriority_;
+   }
+
    std::string monitorSharedSecret() const
    {
       return std::string(monitorSharedSecret_.c_str());
@@ -201,6 +305,11 @@ public:
       return monitorIntervalSeconds_;
    }
 
+   bool monitorMetricsEndpoint() const
+   {
+      return monitorMetricsEndpoint_;
+   }
+
    std::string gwtPrefix() const;
    
    std::string getOverlayOption(const std::string& name)
@@ -247,6 +356,8 @@ private:
    bool serverDaemonize_;
    bool serverAppArmorEnabled_;
    bool serverSetUmask_;
+   bool serverTrace_;
+   bool serverSharedFileMonitor_;
    bool serverOffline_;
    std::string wwwAddress_ ;
    std::string wwwPort_ ;
@@ -254,8 +365,14 @@ private:
    std::string wwwSymbolMapsPath_;
    bool wwwUseEmulatedStack_;
    int wwwThreadPoolSize_;
+   bool wwwIoServicePerThread_;
+   bool wwwThreadCpuAffinity_;
    bool wwwProxyLocalhost_;
    bool wwwVerifyUserAgent_;
+   bool wwwProxyZeroCopy_;
+   bool wwwCompressResponses_;
+   int wwwCompressMinSize_;
+   bool wwwKeepAlive_;
    bool authNone_;
    bool authValidateUsers_;
    int authStaySignedInDays_;
@@ -263,13 +380,28 @@ private:
    std::string authRequiredUserGroup_;
    unsigned int authMinimumUserId_;
    std::string authPamHelperPath_;
+   int authPamWorkers_;
+   int authPamMaxPending_;
    std::string rsessionWhichR_;
    std::string rsessionPath_;
    std::string rldpathPath_;
    std::string rsessionConfigFile_;
    std::string rsessionLdLibraryPath_;
+   int rsessionConnectionPoolSize_;
+   int rsessionConnectionIdleTimeoutSeconds_;
+   int rsessionMaxInFlightRequests_;
+   int rsessionLaunchConcurrency_;
+   std::string rsessionPrelaunchUsers_;
+   std::string rsessionCpuCgroup_;
+   int rsessionCpuWeight_;
+   std::string rsessionBatchGroup_;
+   int rsessionBatchCpuWeight_;
+   double rsessionBusyLoad_;
+   int rsessionBusyBatchPriority_;
+   int rsessionIdlePriority_;
    std::string monitorSharedSecret_;
    int monitorIntervalSeconds_;
+   bool monitorMetricsEndpoint_;
    std::map<std::string,std::string> overlayOptions_;
 };
       
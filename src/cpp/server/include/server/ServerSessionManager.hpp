@@ -19,6 +19,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
 
 #include <boost/signals.hpp>
 
@@ -33,6 +34,7 @@
 namespace rstudio {
 namespace core {
    class Error;
+   class FilePath;
 }
 }
 
@@ -47,7 +49,10 @@ SessionManager& sessionManager();
 // Session manager for launching managed sessions. This includes
 // automatically waiting for other pending launches (rather than
 // attempting to launch the same session twice) as well as reaping
-// of session child processes
+// of session child processes. If a launch concurrency limit is
+// configured then launches beyond the limit are queued and started as
+// earlier launches complete (this keeps a login storm from saturating
+// the machine with simultaneous R initializations)
 class SessionManager
 {
 private:
@@ -56,10 +61,21 @@ private:
    friend SessionManager& sessionManager();
 
 public:
+   // initialization (must be called after the http server is initialized)
+   core::Error initialize();
+
    // launching
    core::Error launchSession(const core::r_util::SessionContext& context);
    void removePendingLaunch(const core::r_util::SessionContext& context);
 
+   // launch sessions for the users listed in the passed file (one per line)
+   // so that they are already warm when the users first connect
+   core::Error prelaunchSessions(const core::FilePath& usersFile);
+
+   // start queued launches for which a slot has become available
+   // (returns true if any launches were started)
+   bool processQueuedLaunches();
+
    // set a custom session launcher
    typedef boost::function<core::Error(
                            const core::r_util::SessionLaunchProfile&)>
@@ -81,6 +97,13 @@ private:
    core::Error launchAndTrackSession(
                         const core::r_util::SessionLaunchProfile& profile);
 
+   // start or queue a launch (depending on the concurrency limit)
+   core::Error startLaunch(const core::r_util::SessionLaunchProfile& profile);
+
+   // NOTE: these must be called with launchesMutex_ held
+   bool isQueuedLaunch(const core::r_util::SessionContext& context);
+   void expireActiveLaunches(const boost::posix_time::ptime& now);
+
 private:
    // pending launches
    boost::mutex launchesMutex_;
@@ -88,6 +111,11 @@ private:
                     boost::posix_time::ptime> LaunchMap;
    LaunchMap pendingLaunches_;
 
+   // launches which count against the concurrency limit (started but not
+   // yet connected to) and launches waiting for a slot
+   LaunchMap activeLaunches_;
+   std::deque<core::r_util::SessionLaunchProfile> queuedLaunches_;
+
    // session launch function
    SessionLaunchFunction sessionLaunchFunction_;
 
@@ -36,6 +36,10 @@ namespace session_proxy {
 
 core::Error initialize();
 
+// schedule maintenance of pooled session connections (must be called
+// after the http server is initialized)
+core::Error initializeConnectionPool();
+
 core::Error runVerifyInstallationSession();
    
 void proxyContentRequest(
@@ -0,0 +1,526 @@
+/*
+ * LoadTestMain.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// load generator which simulates concurrent clients of a running rserver.
+// each client signs in, calls client_init, long-polls get_events and then
+// (until the test ends) repeatedly sends console input, lists files and
+// requests a page of grid data, pausing for the think time between each.
+// latency percentiles are reported per request type.
+//
+// each user has a single session, so concurrent clients should sign in as
+// different users (a %d in --user is replaced by the client number). with
+// --user omitted no sign in is attempted (for servers run with
+// --auth-none=1, e.g. rserver-test, in which case only one client can be
+// active at a time). the server must be run with --auth-encrypt-password=0
+// so that passwords can be posted to the sign in form directly
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Error.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+#include <core/http/TcpIpBlockingClient.hpp>
+#include <core/http/Util.hpp>
+#include <core/json/Json.hpp>
+
+using namespace rstudio::core;
+
+namespace {
+
+struct Options
+{
+   Options()
+      : host("127.0.0.1"),
+        port("4011"),
+        clients(10),
+        durationSeconds(60),
+        thinkMs(1000),
+        consoleInput("x <- rnorm(1e5); invisible(summary(x))"),
+        listPath("~"),
+        gridObject("mtcars"),
+        jsonOutput(false)
+   {
+   }
+
+   std::string host;
+   std::string port;
+   int clients;
+   int durationSeconds;
+   int thinkMs;
+   std::string user;
+   std::string password;
+   std::string consoleInput;
+   std::string listPath;
+   std::string gridObject;
+   bool jsonOutput;
+};
+
+Options s_options;
+
+// latencies (in milliseconds) and error counts by request type
+class Stats
+{
+public:
+   void record(const std::string& name, double ms, bool error)
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      latencies_[name].push_back(ms);
+      if (error)
+         errors_[name]++;
+   }
+
+   void report(std::ostream& os, bool jsonOutput)
+   {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+
+      if (!jsonOutput)
+      {
+         os << boost::format("%-20s %8s %7s %9s %9s %9s %9s\n")
+               % "request" % "count" % "errors"
+               % "p50 ms" % "p90 ms" % "p99 ms" % "max ms";
+      }
+
+      for (std::map<std::string, std::vector<double> >::iterator it =
+              latencies_.begin(); it != latencies_.end(); ++it)
+      {
+         std::vector<double>& values = it->second;
+         std::sort(values.begin(), values.end());
+         int errors = errors_[it->first];
+
+         if (jsonOutput)
+         {
+            json::Object result;
+            result["request"] = it->first;
+            result["count"] = static_cast<int>(values.size());
+            result["errors"] = errors;
+            result["p50_ms"] = percentile(values, 0.50);
+            result["p90_ms"] = percentile(values, 0.90);
+            result["p99_ms"] = percentile(values, 0.99);
+            result["max_ms"] = values.back();
+            json::write(result, os);
+            os << std::endl;
+         }
+         else
+         {
+            os << boost::format("%-20s %8d %7d %9.1f %9.1f %9.1f %9.1f\n")
+                  % it->first % values.size() % errors
+                  % percentile(values, 0.50) % percentile(values, 0.90)
+                  % percentile(values, 0.99) % values.back();
+         }
+      }
+   }
+
+private:
+   static double percentile(const std::vector<double>& sorted, double p)
+   {
+      std::size_t index = static_cast<std::size_t>(p * (sorted.size() - 1));
+      return sorted[index];
+   }
+
+   boost::mutex mutex_;
+   std::map<std::string, std::vector<double> > latencies_;
+   std::map<std::string, int> errors_;
+};
+
+Stats s_stats;
+
+std::string formBody(const http::Fields& fields)
+{
+   std::string body;
+   http::util::buildQueryString(fields, &body);
+   return body;
+}
+
+class Client
+{
+public:
+   Client(int number, const boost::posix_time::ptime& endTime)
+      : number_(number), endTime_(endTime), lastEventId_(-1), seed_(number)
+   {
+   }
+
+   void run()
+   {
+      if (!s_options.user.empty() && !signIn())
+         return;
+
+      if (!clientInit())
+         return;
+
+      // long-poll for events until the test ends
+      boost::thread eventsThread(boost::bind(&Client::pollEvents, this));
+
+      for (int i = 0; !done(); i++)
+      {
+         switch (i % 3)
+         {
+         case 0:
+            rpc("console_input", json::toJsonArray(
+                   std::vector<std::string>(1, s_options.consoleInput)));
+            break;
+         case 1:
+         {
+            json::Array params;
+            params.push_back(s_options.listPath);
+            params.push_back(false);
+            rpc("list_files", params);
+            break;
+         }
+         case 2:
+            gridData();
+            break;
+         }
+
+         think();
+      }
+
+      eventsThread.join();
+   }
+
+private:
+   bool done() const
+   {
+      return boost::posix_time::microsec_clock::universal_time() >= endTime_;
+   }
+
+   // sleep for the think time (+/- 50% so clients don't move in lockstep)
+   void think()
+   {
+      if (s_options.thinkMs <= 0)
+         return;
+
+      seed_ = seed_ * 1103515245 + 12345;
+      int jitter = static_cast<int>((seed_ >> 16) % s_options.thinkMs);
+      boost::this_thread::sleep(boost::posix_time::milliseconds(
+                                   s_options.thinkMs / 2 + jitter));
+   }
+
+   // send a request, timing it as the named request type
+   bool send(const std::string& name,
+             http::Request* pRequest,
+             http::Response* pResponse)
+   {
+      using namespace boost::posix_time;
+
+      pRequest->setHost(s_options.host + ":" + s_options.port);
+      std::string cookies = cookieHeader();
+      if (!cookies.empty())
+         pRequest->setHeader("Cookie", cookies);
+
+      ptime startTime = microsec_clock::universal_time();
+      Error error = http::sendRequest(s_options.host,
+                                      s_options.port,
+                                      *pRequest,
+                                      pResponse);
+      double ms = (microsec_clock::universal_time() - startTime)
+                                             .total_microseconds() / 1000.0;
+
+      bool failed = error || pResponse->statusCode() >= 400;
+      s_stats.record(name, ms, failed);
+      if (error)
+         std::cerr << "client " << number_ << ": " << name << ": "
+                   << error.summary() << std::endl;
+      return !failed;
+   }
+
+   bool rpc(const std::string& method,
+            const json::Array& params,
+            json::Value* pResult = NULL,
+            const std::string& uri = std::string())
+   {
+      json::Object body;
+      body["method"] = method;
+      body["params"] = params;
+      body["clientId"] = clientId_;
+      body["clientVersion"] = std::string();
+      std::ostringstream ostr;
+      json::write(body, ostr);
+
+      http::Request request;
+      request.setMethod("POST");
+      request.setUri(uri.empty() ? "/rpc/" + method : uri);
+      request.setHeader("Content-Type", "application/json");
+      request.setBody(ostr.str());
+
+      http::Response response;
+      if (!send(method, &request, &response))
+         return false;
+
+      json::Value responseValue;
+      if (!json::parse(response.body(), &responseValue) ||
+          !json::isType<json::Object>(responseValue))
+      {
+         s_stats.record(method + " (bad)", 0, true);
+         return false;
+      }
+
+      const json::Object& responseObject = responseValue.get_obj();
+      json::Object::const_iterator it = responseObject.find("error");
+      if (it != responseObject.end())
+      {
+         s_stats.record(method + " (error)", 0, true);
+         return false;
+      }
+
+      it = responseObject.find("result");
+      if (pResult && it != responseObject.end())
+         *pResult = it->second;
+      return true;
+   }
+
+   bool signIn()
+   {
+      std::string user = boost::algorithm::replace_all_copy(
+                     s_options.user, "%d", safe_convert::numberToString(number_));
+
+      http::Fields fields;
+      fields.push_back(std::make_pair("username", user));
+      fields.push_back(std::make_pair("password", s_options.password));
+      fields.push_back(std::make_pair("staySignedIn", "0"));
+      fields.push_back(std::make_pair("appUri", ""));
+
+      http::Request request;
+      request.setMethod("POST");
+      request.setUri("/auth-do-sign-in");
+      request.setHeader("Content-Type", "application/x-www-form-urlencoded");
+      request.setBody(formBody(fields));
+
+      http::Response response;
+      if (!send("sign_in", &request, &response))
+         return false;
+
+      readCookies(response);
+      if (cookies_.empty())
+      {
+         std::cerr << "client " << number_ << ": sign in failed for "
+                   << user << std::endl;
+         return false;
+      }
+      return true;
+   }
+
+   bool clientInit()
+   {
+      json::Value result;
+      if (!rpc("client_init", json::Array(), &result))
+         return false;
+
+      if (json::isType<json::Object>(result))
+      {
+         const json::Object& info = result.get_obj();
+         json::Object::const_iterator it = info.find("clientId");
+         if (it != info.end() && json::isType<std::string>(it->second))
+            clientId_ = it->second.get_str();
+      }
+
+      return !clientId_.empty();
+   }
+
+   void pollEvents()
+   {
+      while (!done())
+      {
+         json::Array params;
+         params.push_back(lastEventId_);
+         json::Value result;
+         if (!rpc("get_events", params, &result, "/events/get_events"))
+         {
+            boost::this_thread::sleep(boost::posix_time::seconds(1));
+            continue;
+         }
+
+         if (json::isType<json::Array>(result))
+         {
+            const json::Array& events = result.get_array();
+            for (std::size_t i = 0; i < events.size(); i++)
+            {
+               if (!json::isType<json::Object>(events[i]))
+                  continue;
+               const json::Object& event = events[i].get_obj();
+               json::Object::const_iterator it = event.find("id");
+               if (it != event.end() && json::isType<int>(it->second))
+                  lastEventId_ = std::max(lastEventId_, it->second.get_int());
+            }
+         }
+      }
+   }
+
+   void gridData()
+   {
+      http::Fields fields;
+      fields.push_back(std::make_pair("show", "data"));
+      fields.push_back(std::make_pair("env", ""));
+      fields.push_back(std::make_pair("obj", s_options.gridObject));
+      fields.push_back(std::make_pair("cache_key", "loadtest"));
+      fields.push_back(std::make_pair("draw", "1"));
+      fields.push_back(std::make_pair("start", "0"));
+      fields.push_back(std::make_pair("length", "100"));
+
+      http::Request request;
+      request.setMethod("POST");
+      request.setUri("/grid_data");
+      request.setHeader("Content-Type", "application/x-www-form-urlencoded");
+      request.setBody(formBody(fields));
+
+      http::Response response;
+      send("grid_data", &request, &response);
+   }
+
+   void readCookies(const http::Response& response)
+   {
+      const http::Headers& headers = response.headers();
+      for (http::Headers::const_iterator it = headers.begin();
+           it != headers.end(); ++it)
+      {
+         if (it->name != "Set-Cookie")
+            continue;
+
+         std::string cookie = it->value.substr(0, it->value.find(';'));
+         std::string::size_type pos = cookie.find('=');
+         if (pos != std::string::npos)
+            cookies_[cookie.substr(0, pos)] = cookie.substr(pos + 1);
+      }
+   }
+
+   std::string cookieHeader() const
+   {
+      std::string header;
+      for (std::map<std::string,std::string>::const_iterator it =
+              cookies_.begin(); it != cookies_.end(); ++it)
+      {
+         if (!header.empty())
+            header += "; ";
+         header += it->first + "=" + it->second;
+      }
+      return header;
+   }
+
+   const int number_;
+   const boost::posix_time::ptime endTime_;
+   std::map<std::string,std::string> cookies_;
+   std::string clientId_;
+   int lastEventId_;
+   unsigned int seed_;
+};
+
+void runClient(int number, boost::posix_time::ptime endTime)
+{
+   try
+   {
+      Client client(number, endTime);
+      client.run();
+   }
+   catch(const std::exception& e)
+   {
+      std::cerr << "client " << number << ": " << e.what() << std::endl;
+   }
+}
+
+void usage()
+{
+   std::cerr <<
+      "usage: rserver-loadtest [options]\n"
+      "  --host <host>            server address (127.0.0.1)\n"
+      "  --port <port>            server port (4011)\n"
+      "  --clients <n>            concurrent clients (10)\n"
+      "  --duration <seconds>     length of the test (60)\n"
+      "  --think-ms <ms>          mean pause between requests (1000)\n"
+      "  --user <name>            user to sign in as (%d is replaced by\n"
+      "                           the client number)\n"
+      "  --password <password>    password for the users\n"
+      "  --console-input <code>   R code sent as console input\n"
+      "  --list-path <path>       directory listed by list_files (~)\n"
+      "  --grid-object <name>     object whose grid data is requested\n"
+      "  --json                   report results as json (one per line)\n";
+}
+
+bool readOptions(int argc, char * const argv[])
+{
+   for (int i = 1; i < argc; i++)
+   {
+      std::string arg(argv[i]);
+      if (arg == "--json")
+      {
+         s_options.jsonOutput = true;
+         continue;
+      }
+
+      if (i + 1 >= argc)
+         return false;
+      std::string value(argv[++i]);
+
+      if (arg == "--host")
+         s_options.host = value;
+      else if (arg == "--port")
+         s_options.port = value;
+      else if (arg == "--clients")
+         s_options.clients = safe_convert::stringTo<int>(value, 10);
+      else if (arg == "--duration")
+         s_options.durationSeconds = safe_convert::stringTo<int>(value, 60);
+      else if (arg == "--think-ms")
+         s_options.thinkMs = safe_convert::stringTo<int>(value, 1000);
+      else if (arg == "--user")
+         s_options.user = value;
+      else if (arg == "--password")
+         s_options.password = value;
+      else if (arg == "--console-input")
+         s_options.consoleInput = value;
+      else if (arg == "--list-path")
+         s_options.listPath = value;
+      else if (arg == "--grid-object")
+         s_options.gridObject = value;
+      else
+         return false;
+   }
+
+   return s_options.clients > 0;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * const argv[])
+{
+   if (!readOptions(argc, argv))
+   {
+      usage();
+      return EXIT_FAILURE;
+   }
+
+   using namespace boost::posix_time;
+   ptime endTime = microsec_clock::universal_time() +
+                   seconds(s_options.durationSeconds);
+
+   boost::thread_group clients;
+   for (int i = 0; i < s_options.clients; i++)
+      clients.create_thread(boost::bind(runClient, i + 1, endTime));
+   clients.join_all();
+
+   s_stats.report(std::cout, s_options.jsonOutput);
+   return EXIT_SUCCESS;
+}
@@ -13,7 +13,15 @@
  *
  */
 
+#include <algorithm>
+#include <deque>
+
 #include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+#include <core/SafeConvert.hpp>
+#include <core/StringUtils.hpp>
 
 #include <session/SessionUserSettings.hpp>
 #include <session/SessionConsoleProcess.hpp>
@@ -26,52 +34,18 @@
 
 #include <session/SessionAsyncRProcess.hpp>
 
+using namespace boost::posix_time;
+
 namespace rstudio {
 namespace session {
 namespace async_r {
 
-AsyncRProcess::AsyncRProcess():
-   isRunning_(false),
-   terminationRequested_(false)
-{
-}
+namespace {
 
-void AsyncRProcess::start(const char* rCommand,
-                          core::system::Options environment,
-                          const core::FilePath& workingDir,
-                          AsyncRProcessOptions rOptions,
-                          std::vector<core::FilePath> rSourceFiles)
+// command line arguments for running the passed R command
+std::vector<std::string> rArgs(const std::string& rCommand,
+                               AsyncRProcessOptions rOptions)
 {
-   // R binary
-   core::FilePath rProgramPath;
-   core::Error error = module_context::rScriptPath(&rProgramPath);
-   if (error)
-   {
-      LOG_ERROR(error);
-      onCompleted(EXIT_FAILURE);
-      return;
-   }
-   
-   // core R files for augmented async processes
-   if (rOptions & R_PROCESS_AUGMENTED)
-   {
-      // R files we wish to source to provide functionality to async process
-      const core::FilePath modulesPath =
-            session::options().modulesRSourcePath();
-      
-      const core::FilePath rPath =
-            session::options().coreRSourcePath();
-      
-      const core::FilePath rTools =  rPath.childPath("Tools.R");
-      const core::FilePath sessionCodeTools = modulesPath.childPath("SessionCodeTools.R");
-      const core::FilePath sessionRCompletions = modulesPath.childPath("SessionRCompletions.R");
-      
-      rSourceFiles.push_back(rTools);
-      rSourceFiles.push_back(sessionCodeTools);
-      rSourceFiles.push_back(sessionRCompletions);
-   }
-
-   // args
    std::vector<std::string> args;
    args.push_back("--slave");
    if (rOptions & R_PROCESS_VANILLA)
@@ -99,13 +73,499 @@ void AsyncRProcess::start(const char* rCommand,
    // than multiple arguments) to '-e'.
 
 #ifdef _WIN32
-   needsQuote = strlen(rCommand) > 0 && rCommand[0] != '"';
+   needsQuote = !rCommand.empty() && rCommand[0] != '"';
 #endif
 
-   std::stringstream command;
    if (needsQuote)
-      command << "\"";
+      args.push_back("\"" + rCommand + "\"");
+   else
+      args.push_back(rCommand);
+
+   return args;
+}
+
+// environment for R child processes (the session's environment plus
+// the passed variables)
+core::system::Options childEnvironment(
+                           const core::system::Options& environment)
+{
+   // forward R_LIBS so the child process has access to the same libraries
+   // we do
+   core::system::Options childEnv;
+   core::system::environment(&childEnv);
+   std::string libPaths = module_context::libPathsString();
+   if (!libPaths.empty())
+   {
+      core::system::setenv(&childEnv, "R_LIBS", libPaths);
+   }
+   // forward passed environment variables
+   BOOST_FOREACH(const core::system::Option& var, environment)
+   {
+      core::system::setenv(&childEnv, var.first, var.second);
+   }
+   return childEnv;
+}
+
+// pooled workers are idle R processes which evaluate tasks read from their
+// standard input. each task is a 10 digit byte count followed by the code;
+// once it's evaluated the worker's state (globals, options, library paths,
+// search path, working directory) is restored and a marker line carrying
+// the status is written to both stdout and stderr so we know when all of
+// its output has been received.
+// the script is a single line of single quoted R so that it can be passed
+// with -e on all platforms
+const char * const kTaskCompleteMarker = "__rs_async_r_task_complete__";
+
+std::string workerScript()
+{
+   boost::format fmt(
+      "local({ "
+         "con <- file('stdin', 'rb'); "
+         "options(warn = 1L); "
+         "wd <- getwd(); "
+         "opts <- options(); "
+         "libs <- .libPaths(); "
+         "attached <- search(); "
+         "marker <- '%1%'; "
+         "repeat { "
+            "header <- readChar(con, 10L, useBytes = TRUE); "
+            "if (!length(header) || !nzchar(header)) break; "
+            "code <- readChar(con, as.integer(header), useBytes = TRUE); "
+            "status <- tryCatch({ "
+               "envir <- new.env(parent = globalenv()); "
+               "for (expr in parse(text = code)) { "
+                  "result <- withVisible(eval(expr, envir)); "
+                  "if (result$visible) print(result$value) "
+               "}; "
+               "0L "
+            "}, error = function(e) { "
+               "cat('Error: ', conditionMessage(e), '\\n', "
+                   "sep = '', file = stderr()); "
+               "1L "
+            "}); "
+            "for (name in setdiff(search(), attached)) "
+               "try(detach(name, character.only = TRUE), silent = TRUE); "
+            "rm(list = ls(globalenv(), all.names = TRUE), envir = globalenv()); "
+            "options(opts); "
+            ".libPaths(libs); "
+            "setwd(wd); "
+            "cat('\\n', marker, ' ', status, '\\n', sep = ''); "
+            "cat('\\n', marker, ' ', status, '\\n', sep = '', file = stderr()); "
+            "flush(stdout()); "
+            "flush(stderr()) "
+         "} "
+      "})");
+   return boost::str(fmt % kTaskCompleteMarker);
+}
+
+// limits for the pool (workers are recycled after running a number of tasks
+// so that state leaked by tasks, e.g. loaded namespaces, doesn't accumulate)
+const std::size_t kMaxWorkers = 2;
+const std::size_t kMaxTasksPerWorker = 25;
+const time_duration kWorkerIdleTimeout = minutes(5);
+const time_duration kTaskTimeout = minutes(5);
+
+// output of a task read from one of the worker's streams
+class TaskOutput
+{
+public:
+   TaskOutput() : complete_(false), status_(EXIT_FAILURE) {}
+
+   void reset()
+   {
+      buffer_.clear();
+      complete_ = false;
+      status_ = EXIT_FAILURE;
+   }
+
+   // append output from the worker, returning the portion which can be
+   // forwarded to the task (everything up to any possible marker)
+   std::string append(const std::string& output)
+   {
+      std::string forward;
+      if (complete_)
+         return forward;
+
+      buffer_.append(output);
+      std::string marker = std::string("\n") + kTaskCompleteMarker + " ";
+      std::size_t pos = buffer_.find(marker);
+      if (pos == std::string::npos)
+      {
+         // hold back anything which could be the start of the marker
+         std::size_t hold = std::min(buffer_.size(), marker.size());
+         forward = buffer_.substr(0, buffer_.size() - hold);
+         buffer_.erase(0, buffer_.size() - hold);
+         return forward;
+      }
+
+      // wait for the rest of the marker line
+      std::size_t statusPos = pos + marker.size();
+      std::size_t endPos = buffer_.find('\n', statusPos);
+      if (endPos == std::string::npos)
+      {
+         forward = buffer_.substr(0, pos);
+         buffer_.erase(0, pos);
+         return forward;
+      }
+
+      forward = buffer_.substr(0, pos);
+      status_ = core::safe_convert::stringTo<int>(
+                  buffer_.substr(statusPos, endPos - statusPos), EXIT_FAILURE);
+      complete_ = true;
+      buffer_.clear();
+      return forward;
+   }
+
+   // output held back when the worker exits before completing the task
+   std::string remaining()
+   {
+      std::string remaining;
+      remaining.swap(buffer_);
+      return remaining;
+   }
+
+   bool complete() const { return complete_; }
+   int status() const { return status_; }
+
+private:
+   std::string buffer_;
+   bool complete_;
+   int status_;
+};
+
+} // anonymous namespace
+
+struct AsyncRTask
+{
+   boost::shared_ptr<AsyncRProcess> pProcess;
+   std::string code;
+   AsyncRProcessOptions rOptions;
+};
+
+// a pooled R process (friend of AsyncRProcess so that it can deliver a
+// task's output and completion)
+class AsyncRWorker : boost::noncopyable,
+                     public boost::enable_shared_from_this<AsyncRWorker>
+{
+public:
+   static void runTask(boost::shared_ptr<AsyncRTask> pTask);
+
+private:
+   explicit AsyncRWorker(AsyncRProcessOptions rOptions)
+      : rOptions_(rOptions),
+        libPaths_(module_context::libPathsString()),
+        tasksRun_(0),
+        retired_(false),
+        idleSince_(microsec_clock::universal_time())
+   {
+   }
+
+   static core::Error startWorker(AsyncRProcessOptions rOptions,
+                                  boost::shared_ptr<AsyncRWorker>* ppWorker);
+
+   static void dispatchTasks();
+   static void recycleWorkers();
+
+   bool isIdle() const { return !pTask_ && !retired_; }
+   bool canRun(const AsyncRTask& task) const
+   {
+      return workerOptions(task.rOptions) == rOptions_ &&
+             module_context::libPathsString() == libPaths_;
+   }
+
+   static AsyncRProcessOptions workerOptions(AsyncRProcessOptions rOptions)
+   {
+      // sourced files and stderr redirection are handled per task
+      return static_cast<AsyncRProcessOptions>(
+            rOptions & (R_PROCESS_VANILLA | R_PROCESS_NO_RDATA));
+   }
+
+   void assignTask(boost::shared_ptr<AsyncRTask> pTask);
+   void completeTask(int exitStatus);
+
+   bool onContinue(core::system::ProcessOperations& ops);
+   void onStdout(const std::string& output);
+   void onStderr(const std::string& output);
+   void onExit(int exitStatus);
+
+private:
+   AsyncRProcessOptions rOptions_;
+   std::string libPaths_;
+   std::size_t tasksRun_;
+   bool retired_;
+   ptime idleSince_;
+   boost::shared_ptr<AsyncRTask> pTask_;
+   ptime taskStarted_;
+   std::string pendingInput_;
+   TaskOutput stdout_;
+   TaskOutput stderr_;
+
+   static std::vector<boost::shared_ptr<AsyncRWorker> > s_workers_;
+   static std::deque<boost::shared_ptr<AsyncRTask> > s_pendingTasks_;
+};
+
+std::vector<boost::shared_ptr<AsyncRWorker> > AsyncRWorker::s_workers_;
+std::deque<boost::shared_ptr<AsyncRTask> > AsyncRWorker::s_pendingTasks_;
+
+void AsyncRWorker::runTask(boost::shared_ptr<AsyncRTask> pTask)
+{
+   // workers load packages so retire them when the library changes
+   static bool s_connected = false;
+   if (!s_connected)
+   {
+      module_context::events().onPackageLibraryMutated.connect(
+                                                      recycleWorkers);
+      s_connected = true;
+   }
+
+   s_pendingTasks_.push_back(pTask);
+   dispatchTasks();
+}
+
+core::Error AsyncRWorker::startWorker(AsyncRProcessOptions rOptions,
+                                      boost::shared_ptr<AsyncRWorker>* ppWorker)
+{
+   core::FilePath rProgramPath;
+   core::Error error = module_context::rScriptPath(&rProgramPath);
+   if (error)
+      return error;
+
+   core::system::ProcessOptions options;
+   options.terminateChildren = true;
+   options.environment = childEnvironment(core::system::Options());
+
+   boost::shared_ptr<AsyncRWorker> pWorker(new AsyncRWorker(rOptions));
+   core::system::ProcessCallbacks cb;
+   cb.onContinue = boost::bind(&AsyncRWorker::onContinue, pWorker, _1);
+   cb.onStdout = boost::bind(&AsyncRWorker::onStdout, pWorker, _2);
+   cb.onStderr = boost::bind(&AsyncRWorker::onStderr, pWorker, _2);
+   cb.onExit = boost::bind(&AsyncRWorker::onExit, pWorker, _1);
+   error = module_context::processSupervisor().runProgram(
+            rProgramPath.absolutePath(),
+            rArgs(workerScript(), rOptions),
+            options,
+            cb);
+   if (error)
+      return error;
+
+   s_workers_.push_back(pWorker);
+   *ppWorker = pWorker;
+   return core::Success();
+}
+
+void AsyncRWorker::dispatchTasks()
+{
+   while (!s_pendingTasks_.empty())
+   {
+      boost::shared_ptr<AsyncRTask> pTask = s_pendingTasks_.front();
+
+      // look for an idle worker which can run the task
+      boost::shared_ptr<AsyncRWorker> pWorker;
+      BOOST_FOREACH(boost::shared_ptr<AsyncRWorker> pCandidate, s_workers_)
+      {
+         if (pCandidate->isIdle() && pCandidate->canRun(*pTask))
+         {
+            pWorker = pCandidate;
+            break;
+         }
+      }
+
+      if (!pWorker)
+      {
+         // retire an idle worker which can't run it to make room (the task
+         // will be dispatched once it has exited)
+         if (s_workers_.size() >= kMaxWorkers)
+         {
+            BOOST_FOREACH(boost::shared_ptr<AsyncRWorker> pCandidate,
+                          s_workers_)
+            {
+               if (pCandidate->isIdle())
+               {
+                  pCandidate->retired_ = true;
+                  break;
+               }
+            }
+            return;
+         }
+
+         core::Error error = startWorker(workerOptions(pTask->rOptions),
+                                         &pWorker);
+         if (error)
+         {
+            LOG_ERROR(error);
+            s_pendingTasks_.pop_front();
+            pTask->pProcess->onProcessCompleted(EXIT_FAILURE);
+            continue;
+         }
+      }
+
+      s_pendingTasks_.pop_front();
+      pWorker->assignTask(pTask);
+   }
+}
+
+void AsyncRWorker::recycleWorkers()
+{
+   // busy workers are retired once their task completes
+   BOOST_FOREACH(boost::shared_ptr<AsyncRWorker> pWorker, s_workers_)
+   {
+      if (!pWorker->pTask_)
+         pWorker->retired_ = true;
+      else
+         pWorker->tasksRun_ = kMaxTasksPerWorker;
+   }
+}
+
+void AsyncRWorker::assignTask(boost::shared_ptr<AsyncRTask> pTask)
+{
+   pTask_ = pTask;
+   taskStarted_ = microsec_clock::universal_time();
+   stdout_.reset();
+   stderr_.reset();
+
+   boost::format fmt("%|010|");
+   pendingInput_.append(boost::str(fmt % pTask->code.size()));
+   pendingInput_.append(pTask->code);
+}
+
+void AsyncRWorker::completeTask(int exitStatus)
+{
+   boost::shared_ptr<AsyncRTask> pTask = pTask_;
+   pTask_.reset();
+   idleSince_ = microsec_clock::universal_time();
+   if (++tasksRun_ >= kMaxTasksPerWorker)
+      retired_ = true;
+
+   pTask->pProcess->onProcessCompleted(exitStatus);
+
+   // run the next task waiting (if any)
+   dispatchTasks();
+}
+
+bool AsyncRWorker::onContinue(core::system::ProcessOperations& ops)
+{
+   if (!pendingInput_.empty())
+   {
+      core::Error error = ops.writeToStdin(pendingInput_, false);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return false;
+      }
+      pendingInput_.clear();
+   }
+
+   if (pTask_)
+   {
+      // the task can't be interrupted so we terminate the worker if it's
+      // cancelled or runs for too long
+      if (!pTask_->pProcess->onContinue())
+         return false;
+      if (microsec_clock::universal_time() - taskStarted_ > kTaskTimeout)
+      {
+         LOG_WARNING_MESSAGE("Terminating R worker after task timeout");
+         return false;
+      }
+      return true;
+   }
+
+   return !retired_ &&
+          (microsec_clock::universal_time() - idleSince_ < kWorkerIdleTimeout);
+}
+
+void AsyncRWorker::onStdout(const std::string& output)
+{
+   if (!pTask_)
+      return;
+
+   std::string forward = stdout_.append(output);
+   if (!forward.empty())
+      pTask_->pProcess->onStdout(forward);
+
+   if (stdout_.complete() && stderr_.complete())
+      completeTask(stdout_.status());
+}
+
+void AsyncRWorker::onStderr(const std::string& output)
+{
+   if (!pTask_)
+      return;
+
+   std::string forward = stderr_.append(output);
+   if (!forward.empty())
+   {
+      if (pTask_->rOptions & R_PROCESS_REDIRECTSTDERR)
+         pTask_->pProcess->onStdout(forward);
+      else
+         pTask_->pProcess->onStderr(forward);
+   }
+
+   if (stdout_.complete() && stderr_.complete())
+      completeTask(stdout_.status());
+}
+
+void AsyncRWorker::onExit(int exitStatus)
+{
+   s_workers_.erase(std::remove(s_workers_.begin(),
+                                s_workers_.end(),
+                                shared_from_this()),
+                    s_workers_.end());
+
+   // the worker exited (or was terminated) during a task (e.g. the task
+   // called quit) so forward its remaining output and exit status
+   if (pTask_)
+   {
+      std::string out = stdout_.remaining();
+      if (!out.empty())
+         pTask_->pProcess->onStdout(out);
+      std::string err = stderr_.remaining();
+      if (!err.empty())
+      {
+         if (pTask_->rOptions & R_PROCESS_REDIRECTSTDERR)
+            pTask_->pProcess->onStdout(err);
+         else
+            pTask_->pProcess->onStderr(err);
+      }
+      completeTask(exitStatus);
+   }
+
+   // start a replacement if there are still tasks waiting
+   dispatchTasks();
+}
+
+AsyncRProcess::AsyncRProcess():
+   isRunning_(false),
+   terminationRequested_(false),
+   pendingEof_(false)
+{
+}
 
+void AsyncRProcess::start(const char* rCommand,
+                          core::system::Options environment,
+                          const core::FilePath& workingDir,
+                          AsyncRProcessOptions rOptions,
+                          std::vector<core::FilePath> rSourceFiles)
+{
+   // core R files for augmented async processes
+   if (rOptions & R_PROCESS_AUGMENTED)
+   {
+      // R files we wish to source to provide functionality to async process
+      const core::FilePath modulesPath =
+            session::options().modulesRSourcePath();
+      
+      const core::FilePath rPath =
+            session::options().coreRSourcePath();
+      
+      const core::FilePath rTools =  rPath.childPath("Tools.R");
+      const core::FilePath sessionCodeTools = modulesPath.childPath("SessionCodeTools.R");
+      const core::FilePath sessionRCompletions = modulesPath.childPath("SessionRCompletions.R");
+      
+      rSourceFiles.push_back(rTools);
+      rSourceFiles.push_back(sessionCodeTools);
+      rSourceFiles.push_back(sessionRCompletions);
+   }
+
+   std::stringstream command;
    if (rSourceFiles.size())
    {
       // add in the r source files requested
@@ -123,10 +583,35 @@ void AsyncRProcess::start(const char* rCommand,
       command << rCommand;
    }
 
-   if (needsQuote)
-      command << "\"";
+   // run on a pooled worker if requested (tasks with their own environment
+   // need a process of their own)
+   if ((rOptions & R_PROCESS_POOLED) && environment.empty())
+   {
+      boost::shared_ptr<AsyncRTask> pTask(new AsyncRTask());
+      pTask->pProcess = shared_from_this();
+      pTask->rOptions = rOptions;
+      if (!workingDir.empty())
+      {
+         pTask->code = "setwd('" +
+               core::string_utils::singleQuotedStrEscape(
+                                       workingDir.absolutePath()) + "');";
+      }
+      pTask->code.append(command.str());
+
+      isRunning_ = true;
+      AsyncRWorker::runTask(pTask);
+      return;
+   }
 
-   args.push_back(command.str());
+   // R binary
+   core::FilePath rProgramPath;
+   core::Error error = module_context::rScriptPath(&rProgramPath);
+   if (error)
+   {
+      LOG_ERROR(error);
+      onCompleted(EXIT_FAILURE);
+      return;
+   }
 
    // options
    core::system::ProcessOptions options;
@@ -140,26 +625,13 @@ void AsyncRProcess::start(const char* rCommand,
       options.workingDir = workingDir;
    }
 
-   // forward R_LIBS so the child process has access to the same libraries
-   // we do
-   core::system::Options childEnv;
-   core::system::environment(&childEnv);
-   std::string libPaths = module_context::libPathsString();
-   if (!libPaths.empty())
-   {
-      core::system::setenv(&childEnv, "R_LIBS", libPaths);
-   }
-   // forward passed environment variables
-   BOOST_FOREACH(const core::system::Option& var, environment)
-   {
-      core::system::setenv(&childEnv, var.first, var.second);
-   }
-   options.environment = childEnv;
+   options.environment = childEnvironment(environment);
 
    core::system::ProcessCallbacks cb;
    using namespace module_context;
-   cb.onContinue = boost::bind(&AsyncRProcess::onContinue,
-                               AsyncRProcess::shared_from_this());
+   cb.onContinue = boost::bind(&AsyncRProcess::onProcessContinue,
+                               AsyncRProcess::shared_from_this(),
+                               _1);
    cb.onStdout = boost::bind(&AsyncRProcess::onStdout,
                              AsyncRProcess::shared_from_this(),
                              _2);
@@ -171,7 +643,7 @@ void AsyncRProcess::start(const char* rCommand,
                              _1);
    error = module_context::processSupervisor().runProgram(
             rProgramPath.absolutePath(),
-            args,
+            rArgs(command.str(), rOptions),
             options,
             cb);
    if (error)
@@ -200,6 +672,20 @@ bool AsyncRProcess::onContinue()
    return !terminationRequested_;
 }
 
+bool AsyncRProcess::onProcessContinue(core::system::ProcessOperations& ops)
+{
+   if (!pendingInput_.empty() || pendingEof_)
+   {
+      core::Error error = ops.writeToStdin(pendingInput_, pendingEof_);
+      if (error)
+         LOG_ERROR(error);
+      pendingInput_.clear();
+      pendingEof_ = false;
+   }
+
+   return onContinue();
+}
+
 void AsyncRProcess::onProcessCompleted(int exitStatus)
 {
    markCompleted();
@@ -221,6 +707,12 @@ void AsyncRProcess::markCompleted()
    isRunning_ = false;
 }
 
+void AsyncRProcess::writeInput(const std::string& input, bool eof)
+{
+   pendingInput_.append(input);
+   pendingEof_ = pendingEof_ || eof;
+}
+
 AsyncRProcess::~AsyncRProcess()
 {
 }
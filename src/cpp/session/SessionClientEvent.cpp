@@ -16,6 +16,7 @@
 #include <session/SessionClientEvent.hpp>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
@@ -145,6 +146,7 @@ const int kUserFollowEnded = 121;
 const int kProjectAccessRevoked = 122;
 const int kCollabEditSaved = 123;
 const int kAddinRegistryUpdated = 124;
+const int kSessionInfoDeferred = 125;
 }
 
 void ClientEvent::init(int type, const json::Value& data)
@@ -152,6 +154,7 @@ void ClientEvent::init(int type, const json::Value& data)
    type_ = type;
    data_ = data;
    id_ = core::system::generateUuid();
+   createdTime_ = boost::posix_time::microsec_clock::universal_time();
 }
    
 void ClientEvent::asJsonObject(int id, json::Object* pObject) const
@@ -394,6 +397,8 @@ std::string ClientEvent::typeName() const
          return "collab_edit_saved";
       case client_events::kAddinRegistryUpdated:
          return "addin_registry_updated";
+      case client_events::kSessionInfoDeferred:
+         return "session_info_deferred";
       default:
          LOG_WARNING_MESSAGE("unexpected event type: " + 
                              safe_convert::numberToString(type_));
@@ -15,13 +15,15 @@
 
 #include "SessionClientEventQueue.hpp"
 
+#include <algorithm>
+
 #include <boost/foreach.hpp>
+#include <boost/format.hpp>
 
 
 #include <core/BoostThread.hpp>
 #include <core/Thread.hpp>
 #include <core/json/Json.hpp>
-#include <core/StringUtils.hpp>
 
 #include <r/session/RConsoleActions.hpp>
 
@@ -32,8 +34,110 @@ namespace session {
  
 namespace {
 ClientEventQueue* s_pClientEventQueue = NULL;
+
+boost::int64_t toMicroseconds(const boost::posix_time::ptime& time)
+{
+   using namespace boost::posix_time;
+   static const ptime epoch(boost::gregorian::date(1970, 1, 1));
+   return (time - epoch).total_microseconds();
 }
 
+template <typename T>
+T atomicRead(volatile T* pValue)
+{
+   return __sync_fetch_and_add(pValue, 0);
+}
+
+// keeps the count of threads waiting for events up to date (including
+// when the wait is interrupted)
+class WaiterScope : boost::noncopyable
+{
+public:
+   explicit WaiterScope(volatile long* pWaiters)
+      : pWaiters_(pWaiters)
+   {
+      __sync_fetch_and_add(pWaiters_, 1);
+   }
+
+   ~WaiterScope()
+   {
+      __sync_fetch_and_sub(pWaiters_, 1);
+   }
+
+private:
+   volatile long* pWaiters_;
+};
+
+// events which describe the current state of something (rather than an
+// incremental change to it) supersede undelivered events with the same
+// key. returns an empty string for events which are never coalesced
+std::string coalescingKey(const ClientEvent& event)
+{
+   int type = event.type();
+   if (type == client_events::kEnvironmentRefresh ||
+       type == client_events::kPlotsStateChanged ||
+       type == client_events::kPackageStateChanged)
+   {
+      return event.typeName();
+   }
+   else if (type == client_events::kFileChanged)
+   {
+      // the latest change for a given file
+      if (!json::isType<json::Object>(event.data()))
+         return std::string();
+      const json::Object& fileChange = event.data().get_obj();
+      json::Object::const_iterator it = fileChange.find("file");
+      if (it == fileChange.end() || !json::isType<json::Object>(it->second))
+         return std::string();
+      const json::Object& file = it->second.get_obj();
+      json::Object::const_iterator pathIt = file.find("path");
+      if (pathIt == file.end() || !json::isType<std::string>(pathIt->second))
+         return std::string();
+      return event.typeName() + ":" + pathIt->second.get_str();
+   }
+   else
+   {
+      return std::string();
+   }
+}
+
+// limits on console output delivered to the client. output beyond these is
+// collapsed (replaced by a notice) so that printing something enormous by
+// mistake doesn't overwhelm the client (the most recent output is always
+// delivered). collapsed output is retained for retrieval up to a limit
+const std::size_t kMaxConsoleOutputBytesPerSecond = 512 * 1024;
+const std::size_t kMinConsoleOutputBytes = 8 * 1024;
+const std::size_t kMaxPendingConsoleOutputBytes = 2 * 1024 * 1024;
+const std::size_t kMaxCollapsedConsoleOutputBytes = 4 * 1024 * 1024;
+
+// offset of the start of the line containing (or beginning just after) pos
+std::size_t lineStartAfter(const std::string& output, std::size_t pos)
+{
+   if (pos == 0 || pos >= output.size())
+      return pos;
+   std::size_t newlinePos = output.find('\n', pos - 1);
+   return newlinePos == std::string::npos ? pos : newlinePos + 1;
+}
+
+// offset of the start of the last maxLines lines of output
+std::size_t lastLinesStart(const std::string& output, int maxLines)
+{
+   std::size_t pos = output.size();
+   if (pos > 0 && output[pos - 1] == '\n')
+      pos--;
+   for (int i = 0; i < maxLines; i++)
+   {
+      if (pos == 0)
+         return 0;
+      pos = output.rfind('\n', pos - 1);
+      if (pos == std::string::npos)
+         return 0;
+   }
+   return pos + 1;
+}
+
+} // anonymous namespace
+
 void initializeClientEventQueue()
 {
    BOOST_ASSERT(s_pClientEventQueue == NULL);
@@ -48,43 +152,57 @@ ClientEventQueue& clientEventQueue()
 ClientEventQueue::ClientEventQueue()
    :  pMutex_(new boost::mutex()),
       pWaitForEventCondition_(new boost::condition()),
-      lastEventAddTime_(boost::posix_time::not_a_date_time)
+      pIncomingEvents_(new core::collection::MpscQueue<ClientEvent>()),
+      eventsAdded_(0),
+      waiters_(0),
+      lastEventAddTime_(-1),
+      outputWindowBytes_(0),
+      pendingCollapsedLines_(0)
 {
 }
 
 void ClientEventQueue::add(const ClientEvent& event)
 { 
-   LOCK_MUTEX(*pMutex_)
+   // queue the event (consolidation of console output and coalescing of
+   // superseded events happens on the consumer side)
+   pIncomingEvents_->push(event);
+
+   // record the add time (never moving it backwards)
+   boost::int64_t now = toMicroseconds(
+                        boost::posix_time::microsec_clock::universal_time());
+   boost::int64_t last;
+   do
    {
-      // console output is batched up for compactness/efficiency.
-      if (event.type() == client_events::kConsoleWriteOutput)
-      {
-         if (event.data().type() == json::StringType)
-            pendingConsoleOutput_ += event.data().get_str();
-      }
-      else
+      last = lastEventAddTime_;
+      if (last >= now)
+         break;
+   }
+   while (!__sync_bool_compare_and_swap(&lastEventAddTime_, last, now));
+
+   __sync_fetch_and_add(&eventsAdded_, 1);
+
+   // notify listeners that an event has been added. acquire the mutex so
+   // the notification can't race with a waiter that is about to wait (we
+   // only do this when there is a waiter to avoid contention between
+   // producers)
+   if (atomicRead(&waiters_) > 0)
+   {
+      LOCK_MUTEX(*pMutex_)
       {
-         // flush existing console output prior to adding an 
-         // action of another type
-         flushPendingConsoleOutput() ;
-         
-         // add event to queue
-         pendingEvents_.push_back(event) ;
       }
-      
-      lastEventAddTime_ = boost::posix_time::microsec_clock::universal_time();
+      END_LOCK_MUTEX
+
+      pWaitForEventCondition_->notify_all();
    }
-   END_LOCK_MUTEX
-   
-   // notify listeners that an event has been added
-   pWaitForEventCondition_->notify_all();
 }
    
 bool ClientEventQueue::hasEvents() 
 {
    LOCK_MUTEX(*pMutex_)
    {
-      return pendingEvents_.size() > 0 || pendingConsoleOutput_.length() > 0;
+      return !pIncomingEvents_->empty() ||
+             pendingEvents_.size() > 0 ||
+             pendingConsoleOutput_.length() > 0;
    }
    END_LOCK_MUTEX
    
@@ -92,20 +210,60 @@ bool ClientEventQueue::hasEvents()
    return false ;
 }
   
+std::size_t ClientEventQueue::memoryUsage()
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      return pendingConsoleOutput_.capacity() +
+             collapsedOutput_.capacity() +
+             pendingEvents_.capacity() * sizeof(ClientEvent) +
+             supersededEvents_.capacity() / 8 +
+             coalescedEventIndexes_.size() *
+                  (sizeof(std::string) + sizeof(std::size_t));
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return 0;
+}
+
+std::size_t ClientEventQueue::pendingEventCount()
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      // (pending console output is delivered as a single event)
+      collectEvents();
+      std::size_t count = std::count(supersededEvents_.begin(),
+                                     supersededEvents_.end(),
+                                     false);
+      return pendingConsoleOutput_.empty() ? count : count + 1;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return 0;
+}
+
 void ClientEventQueue::remove(std::vector<ClientEvent>* pEvents)
 {
    LOCK_MUTEX(*pMutex_)
    {
-      // flush any pending output
+      // consolidate incoming events and flush any pending output
+      collectEvents();
       flushPendingConsoleOutput();
       
-      // copy the events to the caller
-      pEvents->insert(pEvents->begin(), 
-                      pendingEvents_.begin(), 
-                      pendingEvents_.end());
+      // copy the (non-superseded) events to the caller
+      std::vector<ClientEvent> events;
+      events.reserve(pendingEvents_.size());
+      for (std::size_t i = 0; i < pendingEvents_.size(); i++)
+      {
+         if (!supersededEvents_[i])
+            events.push_back(pendingEvents_[i]);
+      }
+      pEvents->insert(pEvents->begin(), events.begin(), events.end());
    
       // clear pending events
-      pendingEvents_.clear();
+      clearPendingEvents();
    } 
    END_LOCK_MUTEX
 }
@@ -114,8 +272,11 @@ void ClientEventQueue::clear()
 {
    LOCK_MUTEX(*pMutex_)
    {
+      std::vector<ClientEvent> incomingEvents;
+      pIncomingEvents_->popAll(&incomingEvents);
       pendingConsoleOutput_.clear();
-      pendingEvents_.clear();
+      pendingCollapsedLines_ = 0;
+      clearPendingEvents();
    }
    END_LOCK_MUTEX
 }
@@ -128,8 +289,17 @@ bool ClientEventQueue::waitForEvent(
    try
    {
       unique_lock<mutex> lock(*pMutex_);
+      WaiterScope waiterScope(&waiters_);
+
+      // wait for an event to be added after we started waiting
+      long eventsAdded = atomicRead(&eventsAdded_);
       system_time timeoutTime = get_system_time() + waitDuration;
-      return pWaitForEventCondition_->timed_wait(lock, timeoutTime);
+      while (atomicRead(&eventsAdded_) == eventsAdded)
+      {
+         if (!pWaitForEventCondition_->timed_wait(lock, timeoutTime))
+            return atomicRead(&eventsAdded_) != eventsAdded;
+      }
+      return true;
    }
    catch(const thread_resource_error& e) 
    { 
@@ -143,19 +313,90 @@ bool ClientEventQueue::waitForEvent(
 
 bool ClientEventQueue::eventAddedSince(const boost::posix_time::ptime& time)
 {
-   LOCK_MUTEX(*pMutex_)
+   boost::int64_t lastEventAddTime = atomicRead(&lastEventAddTime_);
+   if (lastEventAddTime < 0)
+      return false;
+   else
+      return lastEventAddTime >= toMicroseconds(time);
+}
+   
+
+void ClientEventQueue::collectEvents()
+{
+   // NOTE: private helper so no lock required (mutex is not recursive) 
+
+   std::vector<ClientEvent> incomingEvents;
+   if (pIncomingEvents_->popAll(&incomingEvents))
+   {
+      BOOST_FOREACH(const ClientEvent& event, incomingEvents)
+      {
+         addPendingEvent(event);
+      }
+   }
+}
+
+void ClientEventQueue::addPendingEvent(const ClientEvent& event)
+{
+   // NOTE: private helper so no lock required (mutex is not recursive) 
+
+   // console output is batched up for compactness/efficiency.
+   if (event.type() == client_events::kConsoleWriteOutput)
    {
-      if (lastEventAddTime_.is_not_a_date_time())
-         return false;
+      if (event.data().type() == json::StringType)
+         pendingConsoleOutput_ += event.data().get_str();
+
+      // bound the output held between deliveries (keeping the most recent)
+      if (pendingConsoleOutput_.size() > kMaxPendingConsoleOutputBytes)
+      {
+         collapseConsoleOutput(lineStartAfter(
+                  pendingConsoleOutput_,
+                  pendingConsoleOutput_.size() - kMinConsoleOutputBytes));
+      }
+   }
+   else
+   {
+      // flush existing console output prior to adding an 
+      // action of another type
+      flushPendingConsoleOutput() ;
+
+      // add event to queue
+      pushPendingEvent(event);
+   }
+}
+
+void ClientEventQueue::pushPendingEvent(const ClientEvent& event)
+{
+   // NOTE: private helper so no lock required (mutex is not recursive) 
+
+   // supersede any undelivered event with the same coalescing key
+   std::string key = coalescingKey(event);
+   if (!key.empty())
+   {
+      boost::unordered_map<std::string, std::size_t>::iterator it =
+                                          coalescedEventIndexes_.find(key);
+      if (it != coalescedEventIndexes_.end())
+      {
+         supersededEvents_[it->second] = true;
+         it->second = pendingEvents_.size();
+      }
       else
-         return lastEventAddTime_ >= time;
+      {
+         coalescedEventIndexes_[key] = pendingEvents_.size();
+      }
    }
-   END_LOCK_MUTEX
-   
-   // keep compiler happy
-   return false;
+
+   pendingEvents_.push_back(event);
+   supersededEvents_.push_back(false);
+}
+
+void ClientEventQueue::clearPendingEvents()
+{
+   // NOTE: private helper so no lock required (mutex is not recursive) 
+
+   pendingEvents_.clear();
+   supersededEvents_.clear();
+   coalescedEventIndexes_.clear();
 }
-   
 
 void ClientEventQueue::flushPendingConsoleOutput()
 {
@@ -167,13 +408,92 @@ void ClientEventQueue::flushPendingConsoleOutput()
       // truncate it to the amount that the client can show. Too much output
       // can overwhelm the client, causing it to become unresponsive.
       int limit = r::session::consoleActions().capacity() + 1;
-      string_utils::trimLeadingLines(limit, &pendingConsoleOutput_);
+      collapseConsoleOutput(lastLinesStart(pendingConsoleOutput_, limit));
+
+      // limit the rate of delivery (always delivering the most recent
+      // output, up to kMinConsoleOutputBytes, even when over the limit)
+      using namespace boost::posix_time;
+      ptime now = microsec_clock::universal_time();
+      if (outputWindowStart_.is_not_a_date_time() ||
+          now - outputWindowStart_ >= seconds(1))
+      {
+         outputWindowStart_ = now;
+         outputWindowBytes_ = 0;
+      }
+      std::size_t budget = kMinConsoleOutputBytes;
+      if (outputWindowBytes_ + budget < kMaxConsoleOutputBytesPerSecond)
+         budget = kMaxConsoleOutputBytesPerSecond - outputWindowBytes_;
+      if (pendingConsoleOutput_.size() > budget)
+      {
+         collapseConsoleOutput(lineStartAfter(
+                  pendingConsoleOutput_,
+                  pendingConsoleOutput_.size() - budget));
+      }
+      outputWindowBytes_ += pendingConsoleOutput_.size();
 
-      pendingEvents_.push_back(ClientEvent(client_events::kConsoleWriteOutput, 
-                                           pendingConsoleOutput_)); 
+      // note output which was collapsed
+      if (pendingCollapsedLines_ > 0)
+      {
+         boost::format fmt("[ output limit reached -- omitted %1% lines ]\n");
+         pendingConsoleOutput_.insert(0, boost::str(fmt %
+                                                    pendingCollapsedLines_));
+         pendingCollapsedLines_ = 0;
+      }
+
+      pushPendingEvent(ClientEvent(client_events::kConsoleWriteOutput, 
+                                   pendingConsoleOutput_)); 
       pendingConsoleOutput_.clear() ;
    }
 }
 
+void ClientEventQueue::collapseConsoleOutput(std::size_t length)
+{
+   // NOTE: private helper so no lock required (mutex is not recursive) 
+
+   // move the leading output into the collapsed output (retaining only the
+   // most recent up to the limit)
+   if (length == 0)
+      return;
+   length = std::min(length, pendingConsoleOutput_.size());
+
+   pendingCollapsedLines_ += std::count(pendingConsoleOutput_.begin(),
+                                        pendingConsoleOutput_.begin() + length,
+                                        '\n');
+   collapsedOutput_.append(pendingConsoleOutput_, 0, length);
+   pendingConsoleOutput_.erase(0, length);
+
+   if (collapsedOutput_.size() > kMaxCollapsedConsoleOutputBytes)
+   {
+      collapsedOutput_.erase(0, lineStartAfter(
+            collapsedOutput_,
+            collapsedOutput_.size() - kMaxCollapsedConsoleOutputBytes));
+   }
+}
+
+std::size_t ClientEventQueue::collapsedConsoleOutput(
+                                          std::size_t offsetFromEnd,
+                                          std::size_t maxBytes,
+                                          std::string* pOutput)
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      std::size_t size = collapsedOutput_.size();
+      std::size_t end = size - std::min(offsetFromEnd, size);
+      std::size_t begin = end - std::min(maxBytes, end);
+
+      // begin at a line boundary unless that would return nothing
+      std::size_t lineStart = lineStartAfter(collapsedOutput_, begin);
+      if (lineStart < end)
+         begin = lineStart;
+
+      pOutput->assign(collapsedOutput_, begin, end - begin);
+      return begin;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return 0;
+}
+
 } // namespace session
 } // namespace rstudio
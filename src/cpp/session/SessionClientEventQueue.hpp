@@ -23,7 +23,11 @@
 #include <boost/utility.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
 #include <core/BoostThread.hpp>
+#include <core/collection/MpscQueue.hpp>
 
 #include <session/SessionClientEvent.hpp>
 
@@ -46,7 +50,8 @@ private:
 public:
    // COPYING: boost::noncopyable
      
-   // add an event
+   // add an event (never blocks -- events are pushed onto a lock-free
+   // queue and consolidated when they are removed)
    void add(const ClientEvent& event);
    
    // remove all available events
@@ -63,25 +68,64 @@ public:
    
    // has an event been added since the specified time
    bool eventAddedSince(const boost::posix_time::ptime& time);
+
+   // approximate bytes held by consolidated events and console output
+   // (the data of events is counted by size rather than content)
+   std::size_t memoryUsage();
+
+   // number of events waiting to be delivered
+   std::size_t pendingEventCount();
+
+   // console output which wasn't delivered because it exceeded the output
+   // limits (the most recent is retained up to a fixed size). reads up to
+   // maxBytes ending offsetFromEnd bytes before the most recent collapsed
+   // output (so successive calls page backwards), returning the number of
+   // bytes which remain before what was read
+   std::size_t collapsedConsoleOutput(std::size_t offsetFromEnd,
+                                      std::size_t maxBytes,
+                                      std::string* pOutput);
       
 private:   
+   void collectEvents();
+   void addPendingEvent(const ClientEvent& event);
+   void pushPendingEvent(const ClientEvent& event);
    void flushPendingConsoleOutput();
+   void collapseConsoleOutput(std::size_t length);
+   void clearPendingEvents();
  
 private:
    // synchronization objects. heap based so they are never destructed
    // we don't want them destructed because in desktop mode we don't
    // explicitly stop the queue and this sometimes results in mutex
    // destroy assertions if someone is waiting on the queue while
-   // it is being destroyed
+   // it is being destroyed. (the mutex protects the consumer side of the
+   // queue and waiting -- producers don't acquire it unless there is a
+   // waiter to notify)
    boost::mutex* pMutex_ ;
    boost::condition* pWaitForEventCondition_ ;
 
-   // instance data
+   // events added by producers (not yet consolidated)
+   core::collection::MpscQueue<ClientEvent>* pIncomingEvents_;
+
+   // counters updated atomically by producers
+   volatile long eventsAdded_;
+   volatile long waiters_;
+   volatile boost::int64_t lastEventAddTime_;
+
+   // consolidated events (protected by mutex). events which have been
+   // superseded by a later event of the same kind (see coalescingKey) are
+   // flagged and dropped when the events are removed
    std::string pendingConsoleOutput_ ;
    std::vector<ClientEvent> pendingEvents_ ; 
-   boost::posix_time::ptime lastEventAddTime_;
-   
+   std::vector<bool> supersededEvents_;
+   boost::unordered_map<std::string, std::size_t> coalescedEventIndexes_;
 
+   // console output governor state (protected by mutex). output beyond the
+   // per second delivery limit is collapsed into a bounded scrollback
+   boost::posix_time::ptime outputWindowStart_;
+   std::size_t outputWindowBytes_;
+   std::string collapsedOutput_;
+   std::size_t pendingCollapsedLines_;
 };
 
 } // namespace session
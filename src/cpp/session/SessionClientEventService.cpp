@@ -17,7 +17,9 @@
 
 #include <algorithm>
 
+#include <boost/foreach.hpp>
 #include <boost/function.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <core/BoostThread.hpp>
 #include <core/Log.hpp>
@@ -26,12 +28,16 @@
 #include <core/Thread.hpp>
 #include <core/system/System.hpp>
 #include <core/Macros.hpp>
+#include <core/SafeConvert.hpp>
+
+#include <core/json/JsonWriter.hpp>
 
 
 #include <core/http/Request.hpp>
 
 #include <session/SessionOptions.hpp>
 #include <session/SessionHttpConnectionListener.hpp>
+#include <session/SessionModuleContext.hpp>
 
 #include "SessionClientEventQueue.hpp"
 
@@ -50,7 +56,117 @@ bool hasEventIdLessThanOrEqualTo(const json::Value& event, int targetId)
    int eventId = eventJSON.find("id")->second.get_int();
    return eventId <= targetId;
 }
-         
+
+// compact framing for events (opt-in: clients which support it pass
+// kCompactEventFormat as the second parameter of get_events). event types
+// and object keys are replaced with indexes into string tables which are
+// sent along with the events:
+//
+//    { "format": "compact",
+//      "types": [<type name>...],
+//      "keys": [<key>...],
+//      "events": [[<id>, <type index>, <data>]...] }
+//
+// where the names of objects within <data> are the (string) indexes of
+// their keys. the response is gzipped (when accepted) as with other rpcs.
+const char * const kCompactEventFormat = "compact";
+
+class CompactEventWriter : boost::noncopyable
+{
+public:
+   explicit CompactEventWriter(json::Writer* pWriter)
+      : pWriter_(pWriter)
+   {
+   }
+
+   void write(const json::Array& events)
+   {
+      pWriter_->startObject();
+      pWriter_->member("format", kCompactEventFormat);
+
+      pWriter_->key("events");
+      pWriter_->startArray();
+      BOOST_FOREACH(const json::Value& eventValue, events)
+      {
+         const json::Object& event = eventValue.get_obj();
+         json::Object::const_iterator idIt = event.find("id");
+         json::Object::const_iterator typeIt = event.find("type");
+         json::Object::const_iterator dataIt = event.find("data");
+
+         pWriter_->startArray();
+         pWriter_->value(idIt != event.end() ? idIt->second : json::Value());
+         if (typeIt != event.end() && json::isType<std::string>(typeIt->second))
+            pWriter_->value(indexOf(typeIt->second.get_str(), &types_));
+         else
+            pWriter_->nullValue();
+         writeData(dataIt != event.end() ? dataIt->second : json::Value());
+         pWriter_->endArray();
+      }
+      pWriter_->endArray();
+
+      pWriter_->key("types");
+      pWriter_->array(types_.names);
+      pWriter_->key("keys");
+      pWriter_->array(keys_.names);
+
+      pWriter_->endObject();
+   }
+
+private:
+   struct StringTable
+   {
+      std::vector<std::string> names;
+      std::vector<std::string> indexNames;  // index as a string
+      boost::unordered_map<std::string, int> indexes;
+   };
+
+   int indexOf(const std::string& name, StringTable* pTable)
+   {
+      boost::unordered_map<std::string, int>::const_iterator it =
+                                                pTable->indexes.find(name);
+      if (it != pTable->indexes.end())
+         return it->second;
+
+      int index = static_cast<int>(pTable->names.size());
+      pTable->names.push_back(name);
+      pTable->indexNames.push_back(safe_convert::numberToString(index));
+      pTable->indexes[name] = index;
+      return index;
+   }
+
+   void writeData(const json::Value& value)
+   {
+      if (value.type() == json::ObjectType)
+      {
+         pWriter_->startObject();
+         BOOST_FOREACH(const json::Member& member, value.get_obj())
+         {
+            pWriter_->key(keys_.indexNames[indexOf(member.first, &keys_)]);
+            writeData(member.second);
+         }
+         pWriter_->endObject();
+      }
+      else if (value.type() == json::ArrayType)
+      {
+         pWriter_->startArray();
+         BOOST_FOREACH(const json::Value& element, value.get_array())
+         {
+            writeData(element);
+         }
+         pWriter_->endArray();
+      }
+      else
+      {
+         pWriter_->value(value);
+      }
+   }
+
+private:
+   json::Writer* pWriter_;
+   StringTable types_;
+   StringTable keys_;
+};
+
 } // anonymous namespace
 
 ClientEventService& clientEventService()
@@ -175,11 +291,21 @@ void ClientEventService::addClientEvent(const json::Object& eventObject)
 }
 
 void ClientEventService::setClientEventResult(
+                                       bool compact,
                                        core::json::JsonRpcResponse* pResponse)
 {
    LOCK_MUTEX(mutex_)
    {
-      pResponse->setResult(clientEvents_);
+      if (compact)
+      {
+         json::Writer writer;
+         CompactEventWriter(&writer).write(clientEvents_);
+         pResponse->setRawResult(writer.str());
+      }
+      else
+      {
+         pResponse->setResult(clientEvents_);
+      }
    }
    END_LOCK_MUTEX
 }
@@ -276,6 +402,15 @@ void ClientEventService::run()
             continue;
          }
            
+         // see whether the client supports the compact event format
+         std::string format;
+         if (request.params.size() > 1 &&
+             json::isType<std::string>(request.params[1]))
+         {
+            format = request.params[1].get_str();
+         }
+         bool compact = (format == kCompactEventFormat);
+
          // remove all events already seen by the client from our internal list
          erasePreviouslyDeliveredEvents(lastClientEventIdSeen);
 
@@ -338,9 +473,16 @@ void ClientEventService::run()
             // event service shouldn't interact with automatic event service
             // starting/re-starting)
             json::JsonRpcResponse response;
-            setClientEventResult(&response);
+            setClientEventResult(compact, &response);
             response.setField(kEventsPending, "false");
             ptrConnection->sendJsonRpcResponse(response);
+
+            // record delivery latency (from event creation to send)
+            BOOST_FOREACH(const ClientEvent& event, events)
+            {
+               module_context::recordLatency("get_events.delivery",
+                                             event.createdTime());
+            }
          }
          else
          {
@@ -61,7 +61,8 @@ private:
    void erasePreviouslyDeliveredEvents(int lastClientEventIdSeen);
    bool havePendingClientEvents();
    void addClientEvent(const core::json::Object& eventObject);
-   void setClientEventResult(core::json::JsonRpcResponse* pResponse);
+   void setClientEventResult(bool compact,
+                             core::json::JsonRpcResponse* pResponse);
 
   
 private:
@@ -0,0 +1,86 @@
+/*
+ * SessionConsoleAudit.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionConsoleAudit.hpp>
+
+#include <string>
+
+#include <boost/bind.hpp>
+
+#include <core/DateTime.hpp>
+
+#include <core/system/System.hpp>
+
+#include <monitor/MonitorClient.hpp>
+
+#include <session/SessionOptions.hpp>
+#include <session/SessionModuleContext.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace console_audit {
+
+namespace {
+
+// identifies this session's actions (fixed for its lifetime)
+monitor::audit::ConsoleAction s_actionTemplate;
+
+void recordAction(int type, const std::string& data)
+{
+   monitor::audit::ConsoleAction action(s_actionTemplate);
+   action.timestamp = date_time::millisecondsSinceEpoch();
+   action.type = type;
+   action.data = data;
+   monitor::client().recordConsoleAction(action);
+}
+
+void onConsoleOutput(module_context::ConsoleOutputType type,
+                     const std::string& output)
+{
+   recordAction(type == module_context::ConsoleOutputError ?
+                                       kConsoleActionOutputError :
+                                       kConsoleActionOutput,
+                output);
+}
+
+} // anonymous namespace
+
+void initialize()
+{
+   if (!options().auditConsole())
+      return;
+
+   s_actionTemplate.sessionId = options().sessionScope().id();
+   s_actionTemplate.project = options().sessionScope().project();
+   s_actionTemplate.pid = core::system::currentProcessId();
+   s_actionTemplate.username = options().userIdentity();
+
+   monitor::audit::ConsoleActionWriterOptions writerOptions;
+   writerOptions.journalPath =
+         options().userScratchPath().childPath("audit/console-actions.log");
+   monitor::client().startConsoleActionFlush(writerOptions);
+
+   module_context::events().onConsolePrompt.connect(
+                        boost::bind(recordAction, kConsoleActionPrompt, _1));
+   module_context::events().onConsoleInput.connect(
+                        boost::bind(recordAction, kConsoleActionInput, _1));
+   module_context::events().onConsoleOutput.connect(onConsoleOutput);
+}
+
+} // namespace console_audit
+} // namespace session
+} // namespace rstudio
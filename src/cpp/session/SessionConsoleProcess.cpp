@@ -15,6 +15,8 @@
 
 #include <session/SessionConsoleProcess.hpp>
 
+#include <cctype>
+
 #include <boost/regex.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -28,6 +30,8 @@
 
 #include <core/system/Environment.hpp>
 
+#include <r/ROptions.hpp>
+
 #include <session/SessionModuleContext.hpp>
 
 #include "session-config.h"
@@ -43,9 +47,44 @@ namespace session {
 namespace console_process {
 
 namespace {
-   const size_t OUTPUT_BUFFER_SIZE = 8192;
+   const int kDefaultOutputBufferSizeKb = 8;
+   const std::size_t kOutputChunkSize = 4096;
    typedef std::map<std::string, boost::shared_ptr<ConsoleProcess> > ProcTable;
    ProcTable s_procs;
+
+   std::size_t outputBufferSize()
+   {
+      int sizeKb = r::options::getOption<int>(
+                                    "rstudio.consoleProcessBufferSize",
+                                    kDefaultOutputBufferSizeKb,
+                                    false);
+      return std::max(sizeKb, 1) * 1024;
+   }
+
+   // equivalent to matching ^(.+)[\W_]( +)$ but only examines the end of
+   // the output (a prompt is some text followed by a non-word character
+   // and then at least one space)
+   bool isPrompt(const std::string& output)
+   {
+      // count the trailing spaces
+      std::size_t size = output.size();
+      std::size_t spaces = 0;
+      while (spaces < size && output[size - spaces - 1] == ' ')
+         ++spaces;
+      if (spaces == 0)
+         return false;
+
+      // with two or more trailing spaces the first of them can serve as
+      // the non-word character
+      if (spaces >= 2 && size >= 3)
+         return true;
+
+      // otherwise we need a non-word character (or underscore) before the
+      // spaces, with some text before it
+      std::size_t pos = size - spaces;
+      return pos >= 2 &&
+             !std::isalnum(static_cast<unsigned char>(output[pos - 1]));
+   }
 } // anonymous namespace
 
 const int kDefaultMaxOutputLines = 500;
@@ -53,13 +92,12 @@ const int kDefaultMaxOutputLines = 500;
 ConsoleProcess::ConsoleProcess()
    : dialog_(false), showOnOutput_(false), interactionMode_(InteractionNever),
      maxOutputLines_(kDefaultMaxOutputLines), started_(true),
-     interrupt_(false), outputBuffer_(OUTPUT_BUFFER_SIZE)
+     interrupt_(false), outputOffset_(0), outputSize_(0),
+     maxOutputBufferSize_(outputBufferSize())
 {
-   regexInit();
-
    // When we retrieve from outputBuffer, we only want complete lines. Add a
    // dummy \n so we can tell the first line is a complete line.
-   outputBuffer_.push_back('\n');
+   appendToOutputBuffer("\n");
 }
 
 ConsoleProcess::ConsoleProcess(const std::string& command,
@@ -72,7 +110,8 @@ ConsoleProcess::ConsoleProcess(const std::string& command,
      showOnOutput_(false),
      interactionMode_(interactionMode), maxOutputLines_(maxOutputLines),
      started_(false), interrupt_(false),
-     outputBuffer_(OUTPUT_BUFFER_SIZE)
+     outputOffset_(0), outputSize_(0),
+     maxOutputBufferSize_(outputBufferSize())
 {
    commonInit();
 }
@@ -88,21 +127,14 @@ ConsoleProcess::ConsoleProcess(const std::string& program,
      showOnOutput_(false),
      interactionMode_(interactionMode), maxOutputLines_(maxOutputLines),
      started_(false),  interrupt_(false),
-     outputBuffer_(OUTPUT_BUFFER_SIZE)
+     outputOffset_(0), outputSize_(0),
+     maxOutputBufferSize_(outputBufferSize())
 {
    commonInit();
 }
 
-void ConsoleProcess::regexInit()
-{
-   controlCharsPattern_ = boost::regex("[\\r\\b]");
-   promptPattern_ = boost::regex("^(.+)[\\W_]( +)$");
-}
-
 void ConsoleProcess::commonInit()
 {
-   regexInit();
-
    handle_ = core::system::generateUuid(false);
 
    // always redirect stderr to stdout so output is interleaved
@@ -153,18 +185,37 @@ void ConsoleProcess::commonInit()
 
    // When we retrieve from outputBuffer, we only want complete lines. Add a
    // dummy \n so we can tell the first line is a complete line.
-   outputBuffer_.push_back('\n');
+   appendToOutputBuffer("\n");
 }
 
 std::string ConsoleProcess::bufferedOutput() const
 {
-   boost::circular_buffer<char>::const_iterator pos =
-         std::find(outputBuffer_.begin(), outputBuffer_.end(), '\n');
-
    std::string result;
-   if (pos != outputBuffer_.end())
-      pos++;
-   std::copy(pos, outputBuffer_.end(), std::back_inserter(result));
+   result.reserve(outputSize_);
+
+   // skip to the end of the first (possibly partial) line
+   bool lineStart = false;
+   std::size_t offset = outputOffset_;
+   for (std::deque<std::string>::const_iterator it = outputChunks_.begin();
+        it != outputChunks_.end();
+        ++it)
+   {
+      if (!lineStart)
+      {
+         offset = it->find('\n', offset);
+         if (offset == std::string::npos)
+         {
+            offset = 0;
+            continue;
+         }
+         lineStart = true;
+         ++offset;
+      }
+
+      result.append(*it, offset, std::string::npos);
+      offset = 0;
+   }
+
    // Will be empty if the buffer was overflowed by a single line
    return result;
 }
@@ -254,7 +305,42 @@ bool ConsoleProcess::onContinue(core::system::ProcessOperations& ops)
 
 void ConsoleProcess::appendToOutputBuffer(const std::string &str)
 {
-   std::copy(str.begin(), str.end(), std::back_inserter(outputBuffer_));
+   if (str.empty())
+      return;
+
+   // add to the last chunk if it's small (e.g. echoed input) and start a
+   // new chunk otherwise (keeping no more of it than we'd retain)
+   if (!outputChunks_.empty() &&
+       outputChunks_.back().size() + str.size() <= kOutputChunkSize)
+   {
+      outputChunks_.back().append(str);
+      outputSize_ += str.size();
+   }
+   else
+   {
+      std::size_t start = str.size() > maxOutputBufferSize_ ?
+                                    str.size() - maxOutputBufferSize_ : 0;
+      outputChunks_.push_back(str.substr(start));
+      outputSize_ += str.size() - start;
+   }
+
+   // drop the oldest output beyond the limit
+   while (outputSize_ > maxOutputBufferSize_)
+   {
+      std::size_t excess = outputSize_ - maxOutputBufferSize_;
+      std::size_t firstChunkSize = outputChunks_.front().size() - outputOffset_;
+      if (excess >= firstChunkSize)
+      {
+         outputChunks_.pop_front();
+         outputOffset_ = 0;
+         outputSize_ -= firstChunkSize;
+      }
+      else
+      {
+         outputOffset_ += excess;
+         outputSize_ -= excess;
+      }
+   }
 }
 
 void ConsoleProcess::enqueOutputEvent(const std::string &output, bool error)
@@ -265,13 +351,19 @@ void ConsoleProcess::enqueOutputEvent(const std::string &output, bool error)
    // If there's more output than the client can even show, then
    // truncate it to the amount that the client can show. Too much
    // output can overwhelm the client, making it unresponsive.
-   std::string trimmedOutput = output;
-   string_utils::trimLeadingLines(maxOutputLines_, &trimmedOutput);
-
    json::Object data;
    data["handle"] = handle_;
    data["error"] = error;
-   data["output"] = trimmedOutput;
+   if (output.length() > static_cast<std::size_t>(maxOutputLines_ * 2))
+   {
+      std::string trimmedOutput = output;
+      string_utils::trimLeadingLines(maxOutputLines_, &trimmedOutput);
+      data["output"] = trimmedOutput;
+   }
+   else
+   {
+      data["output"] = output;
+   }
    module_context::enqueClientEvent(
          ClientEvent(client_events::kConsoleProcessOutput, data));
 }
@@ -309,14 +401,12 @@ void ConsoleProcess::onStdout(core::system::ProcessOperations& ops,
 void ConsoleProcess::maybeConsolePrompt(core::system::ProcessOperations& ops,
                                         const std::string& output)
 {
-   boost::smatch smatch;
-
    // treat special control characters as output rather than a prompt
-   if (boost::regex_search(output, smatch, controlCharsPattern_))
+   if (output.find_first_of("\r\b") != std::string::npos)
       enqueOutputEvent(output, false);
 
    // make sure the output matches our prompt pattern
-   if (!boost::regex_match(output, smatch, promptPattern_))
+   if (!isPrompt(output))
       enqueOutputEvent(output, false);
 
    // it is a prompt
@@ -414,9 +504,7 @@ boost::shared_ptr<ConsoleProcess> ConsoleProcess::fromJson(
    else
       pProc->maxOutputLines_ = kDefaultMaxOutputLines;
 
-   std::string bufferedOutput = obj["buffered_output"].get_str();
-   std::copy(bufferedOutput.begin(), bufferedOutput.end(),
-             std::back_inserter(pProc->outputBuffer_));
+   pProc->appendToOutputBuffer(obj["buffered_output"].get_str());
    json::Value exitCode = obj["exit_code"];
    if (exitCode.is_null())
       pProc->exitCode_.reset();
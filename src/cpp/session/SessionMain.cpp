@@ -27,6 +27,15 @@
 #include <cstdlib>
 #include <csignal>
 #include <limits>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
@@ -46,7 +55,9 @@
 #include <core/Exec.hpp>
 #include <core/Scope.hpp>
 #include <core/Settings.hpp>
+#include <core/StatCache.hpp>
 #include <core/Thread.hpp>
+#include <core/Trace.hpp>
 #include <core/Log.hpp>
 #include <core/LogWriter.hpp>
 #include <core/system/System.hpp>
@@ -165,6 +176,11 @@ extern "C" const char *locale2charset(const char *);
 #include "workers/SessionWebRequestWorker.hpp"
 
 #include <session/SessionHttpConnectionListener.hpp>
+#include <session/SessionWorkerPool.hpp>
+#include <session/SessionMemoryUsage.hpp>
+#include <session/SessionMetricsReport.hpp>
+#include <session/SessionConsoleAudit.hpp>
+#include <session/SessionRpcMetrics.hpp>
 
 #include "session-config.h"
 
@@ -229,6 +245,8 @@ volatile sig_atomic_t s_rProcessingInput = 0;
 // did we fail to coerce the charset to UTF-8
 bool s_printCharsetWarning = false;
 
+// console input waiting to be read by R (e.g. the remaining lines of a
+// multi-line submission). R reads these without prompting the client
 std::queue<rstudio::r::session::RConsoleInput> s_consoleInputBuffer;
 
 // json rpc methods we handle (the rest are delegated to the HttpServer)
@@ -243,6 +261,9 @@ const char * const kQuitSession = "quit_session" ;
 const char * const kSuspendSession = "suspend_session";
 const char * const kInterrupt = "interrupt";
 
+// batched json-rpc requests
+const char * const kRpcBatchUri = "/rpc/batch";
+
 // convenience function for disallowing suspend (note still doesn't override
 // the presence of s_forceSuspend = 1)
 bool disallowSuspend() { return false; }
@@ -302,6 +323,10 @@ inline std::string clientVersion()
 
 void detectChanges(module_context::ChangeSource source)
 {
+   // R code may have modified the file system in ways that the file
+   // monitor doesn't report (e.g. outside of monitored directories)
+   core::stat_cache::invalidateAll();
+
    module_context::events().onDetectChanges(source);
 }
  
@@ -395,7 +420,127 @@ FilePath getProjectUserDataDir(const ErrorLocation& location)
    return dataDir;
 }
 
+// sections of the session info which are comparatively expensive to compute
+// (they consult R, installed packages, the file system or external programs)
+// and which the client doesn't need in order to first paint the workbench
+void authoringSessionInfo(json::Object* pInfo)
+{
+   json::Object& sessionInfo = *pInfo;
+   sessionInfo["rnw_weave_types"] = modules::authoring::supportedRnwWeaveTypes();
+   sessionInfo["latex_program_types"] = modules::authoring::supportedLatexProgramTypes();
+   sessionInfo["tex_capabilities"] = modules::authoring::texCapabilitiesAsJson();
+   sessionInfo["compile_pdf_state"] = modules::authoring::compilePdfStateAsJson();
+   sessionInfo["html_capabilities"] = modules::html_preview::capabilitiesAsJson();
+}
 
+void vcsSessionInfo(json::Object* pInfo)
+{
+   json::Object& sessionInfo = *pInfo;
+   std::vector<std::string> vcsAvailable;
+   if (modules::source_control::isGitInstalled())
+      vcsAvailable.push_back(modules::git::kVcsId);
+   if (modules::source_control::isSvnInstalled())
+      vcsAvailable.push_back(modules::svn::kVcsId);
+   sessionInfo["vcs_available"] = boost::algorithm::join(vcsAvailable, ",");
+   sessionInfo["vcs"] = modules::source_control::activeVCSName();
+   sessionInfo["default_ssh_key_dir"] =module_context::createAliasedPath(
+                              modules::source_control::defaultSshKeyDir());
+   sessionInfo["is_github_repo"] = modules::git::isGithubRepository();
+}
+
+void workbenchStateSessionInfo(json::Object* pInfo)
+{
+   json::Object& sessionInfo = *pInfo;
+   sessionInfo["find_in_files_state"] = modules::find::findInFilesStateAsJson();
+   sessionInfo["markers_state"] = modules::markers::markersStateAsJson();
+   sessionInfo["lists"] = modules::lists::allListsAsJson();
+   sessionInfo["console_processes"] =
+         rsession::console_process::processesAsJson();
+   sessionInfo["build_state"] = modules::build::buildStateAsJson();
+}
+
+void packagesSessionInfo(json::Object* pInfo)
+{
+   json::Object& sessionInfo = *pInfo;
+   sessionInfo["devtools_installed"] = module_context::isMinimumDevtoolsInstalled();
+   sessionInfo["rmarkdown_available"] =
+         modules::rmarkdown::rmarkdownPackageAvailable();
+   sessionInfo["packrat_available"] =
+                     module_context::isRequiredPackratInstalled();
+   sessionInfo["knit_params_available"] =
+         modules::rmarkdown::knitParamsAvailable();
+   sessionInfo["r_addins"] = modules::r_addins::addinRegistryAsJson();
+}
+
+void environmentSessionInfo(json::Object* pInfo)
+{
+   json::Object& sessionInfo = *pInfo;
+   sessionInfo["environment_state"] = modules::environment::environmentStateAsJson();
+}
+
+void historySessionInfo(json::Object* pInfo)
+{
+   // console history -- this comes last because
+   // restoreBuildRestartContext may have reset it
+   json::Array historyArray;
+   rstudio::r::session::consoleHistory().asJson(&historyArray);
+   (*pInfo)["console_history"] = historyArray;
+}
+
+typedef boost::function<void(json::Object*)> SessionInfoSection;
+
+const std::vector<SessionInfoSection>& deferrableSessionInfo()
+{
+   static std::vector<SessionInfoSection> sections;
+   if (sections.empty())
+   {
+      sections.push_back(authoringSessionInfo);
+      sections.push_back(vcsSessionInfo);
+      sections.push_back(workbenchStateSessionInfo);
+      sections.push_back(packagesSessionInfo);
+      sections.push_back(environmentSessionInfo);
+      sections.push_back(historySessionInfo);
+   }
+   return sections;
+}
+
+// clients which can receive the deferrable sections after the client_init
+// response (as session_info_deferred events) say so with a keyword param
+bool clientAcceptsDeferredSessionInfo(
+                        boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   json::JsonRpcRequest request;
+   Error error = json::parseJsonRpcRequest(ptrConnection->request().body(),
+                                           &request);
+   if (error)
+      return false;
+
+   json::Object::const_iterator it = request.kwparams.find("defer_sections");
+   return it != request.kwparams.end() &&
+          json::isType<bool>(it->second) &&
+          it->second.get_bool();
+}
+
+bool sendDeferredSessionInfo(const std::string& clientId,
+                             boost::shared_ptr<std::size_t> pNext)
+{
+   // stop if another client has since initialized (it gets its own)
+   if (clientId != rsession::persistentState().activeClientId())
+      return false;
+
+   json::Object sections;
+   deferrableSessionInfo()[*pNext](&sections);
+   *pNext += 1;
+   bool complete = *pNext >= deferrableSessionInfo().size();
+
+   json::Object data;
+   data["sections"] = sections;
+   data["complete"] = complete;
+   module_context::enqueClientEvent(
+         ClientEvent(client_events::kSessionInfoDeferred, data));
+
+   return !complete;
+}
 
 void handleClientInit(const boost::function<void()>& initFunction,
                       boost::shared_ptr<HttpConnection> ptrConnection)
@@ -405,6 +550,7 @@ void handleClientInit(const boost::function<void()>& initFunction,
    
    // calculate initialization parameters
    std::string clientId = rsession::persistentState().newActiveClientId();
+   worker_pool::setClientIdentity(clientId, clientVersion());
    bool resumed = s_rSessionResumed || s_sessionInitialized;
 
    // if we are resuming then we don't need to worry about events queued up
@@ -488,17 +634,6 @@ void handleClientInit(const boost::function<void()>& initFunction,
       sessionInfo["console_actions"] = actionsObject;
    }
 
-   sessionInfo["rnw_weave_types"] = modules::authoring::supportedRnwWeaveTypes();
-   sessionInfo["latex_program_types"] = modules::authoring::supportedLatexProgramTypes();
-   sessionInfo["tex_capabilities"] = modules::authoring::texCapabilitiesAsJson();
-   sessionInfo["compile_pdf_state"] = modules::authoring::compilePdfStateAsJson();
-
-   sessionInfo["html_capabilities"] = modules::html_preview::capabilitiesAsJson();
-
-   sessionInfo["find_in_files_state"] = modules::find::findInFilesStateAsJson();
-
-   sessionInfo["markers_state"] = modules::markers::markersStateAsJson();
-
    sessionInfo["rstudio_version"] = std::string(RSTUDIO_VERSION);
 
    sessionInfo["ui_prefs"] = userSettings().uiPrefs();
@@ -538,23 +673,6 @@ void handleClientInit(const boost::function<void()>& initFunction,
 
    sessionInfo["system_encoding"] = std::string(::locale2charset(NULL));
 
-   std::vector<std::string> vcsAvailable;
-   if (modules::source_control::isGitInstalled())
-      vcsAvailable.push_back(modules::git::kVcsId);
-   if (modules::source_control::isSvnInstalled())
-      vcsAvailable.push_back(modules::svn::kVcsId);
-   sessionInfo["vcs_available"] = boost::algorithm::join(vcsAvailable, ",");
-   sessionInfo["vcs"] = modules::source_control::activeVCSName();
-   sessionInfo["default_ssh_key_dir"] =module_context::createAliasedPath(
-                              modules::source_control::defaultSshKeyDir());
-   sessionInfo["is_github_repo"] = modules::git::isGithubRepository();
-
-   // contents of all lists
-   sessionInfo["lists"] = modules::lists::allListsAsJson();
-
-   sessionInfo["console_processes"] =
-         rsession::console_process::processesAsJson();
-
    // send sumatra pdf exe path if we are on windows
 #ifdef _WIN32
    sessionInfo["sumatra_pdf_exe_path"] =
@@ -600,18 +718,11 @@ void handleClientInit(const boost::function<void()>& initFunction,
    sessionInfo["tutorial_api_available"] = false;
    sessionInfo["tutorial_api_client_origin"] = json::Value();
 
-   sessionInfo["build_state"] = modules::build::buildStateAsJson();
-   sessionInfo["devtools_installed"] = module_context::isMinimumDevtoolsInstalled();
    sessionInfo["have_cairo_pdf"] = modules::plots::haveCairoPdf();
 
    sessionInfo["have_srcref_attribute"] =
          modules::breakpoints::haveSrcrefAttribute();
 
-   // console history -- we do this at the end because
-   // restoreBuildRestartContext may have reset it
-   json::Array historyArray;
-   rstudio::r::session::consoleHistory().asJson(&historyArray);
-   sessionInfo["console_history"] = historyArray;
    sessionInfo["console_history_capacity"] =
                               rstudio::r::session::consoleHistory().capacity();
 
@@ -645,7 +756,6 @@ void handleClientInit(const boost::function<void()>& initFunction,
          core::system::getenv(kRStudioDisableProjectSharing).empty() &&
          !options.getOverlayOption(kSessionSharedStoragePath).empty();
 
-   sessionInfo["environment_state"] = modules::environment::environmentStateAsJson();
    sessionInfo["error_state"] = modules::errors::errorStateAsJson();
 
    // send whether we should show the user identity
@@ -653,16 +763,6 @@ void handleClientInit(const boost::function<void()>& initFunction,
            (options.programMode() == kSessionProgramModeServer) &&
            options.showUserIdentity();
 
-   sessionInfo["rmarkdown_available"] =
-         modules::rmarkdown::rmarkdownPackageAvailable();
-
-   sessionInfo["packrat_available"] =
-                     module_context::isRequiredPackratInstalled();
-
-
-   sessionInfo["knit_params_available"] =
-         modules::rmarkdown::knitParamsAvailable();
-
    sessionInfo["clang_available"] = modules::clang::isAvailable();
 
    // don't show help home until we figure out a sensible heuristic
@@ -679,7 +779,15 @@ void handleClientInit(const boost::function<void()>& initFunction,
    sessionInfo["show_user_home_page"] = options.showUserHomePage();
    sessionInfo["user_home_page_url"] = json::Value();
    
-   sessionInfo["r_addins"] = modules::r_addins::addinRegistryAsJson();
+   // sections which are expensive to compute are either included here or
+   // (for clients which support it) delivered after the response
+   bool deferSections = clientAcceptsDeferredSessionInfo(ptrConnection);
+   sessionInfo["deferred_sections"] = deferSections;
+   if (!deferSections)
+   {
+      for (std::size_t i = 0; i < deferrableSessionInfo().size(); i++)
+         deferrableSessionInfo()[i](&sessionInfo);
+   }
 
    module_context::events().onSessionInfo(&sessionInfo);
 
@@ -698,6 +806,18 @@ void handleClientInit(const boost::function<void()>& initFunction,
    
    // call the init function
    initFunction();
+
+   // deliver the deferred sections (one or more per background tick so
+   // that requests from the now painted client are interleaved)
+   if (deferSections)
+   {
+      boost::shared_ptr<std::size_t> pNext(new std::size_t(0));
+      module_context::scheduleIncrementalWork(
+            boost::posix_time::milliseconds(50),
+            boost::bind(sendDeferredSessionInfo, clientId, pNext),
+            false,
+            module_context::WorkPriorityHigh);
+   }
 }
 
 enum ConnectionType
@@ -706,11 +826,14 @@ enum ConnectionType
    BackgroundConnection
 };
 
-void endHandleRpcRequestDirect(boost::shared_ptr<HttpConnection> ptrConnection,
+void endHandleRpcRequestDirect(const std::string& method,
+                         boost::shared_ptr<HttpConnection> ptrConnection,
                          boost::posix_time::ptime executeStartTime,
                          const core::Error& executeError,
                          json::JsonRpcResponse* pJsonRpcResponse)
 {
+   using namespace boost::posix_time;
+
    // return error or result then continue waiting for requests
    if (executeError)
    {
@@ -731,7 +854,14 @@ void endHandleRpcRequestDirect(boost::shared_ptr<HttpConnection> ptrConnection,
       }
 
       // send the response
+      ptime serializeStartTime = microsec_clock::universal_time();
+      rpc_metrics::record(method,
+                          rpc_metrics::DispatchPhase,
+                          serializeStartTime - executeStartTime);
       ptrConnection->sendJsonRpcResponse(*pJsonRpcResponse);
+      rpc_metrics::record(method,
+                          rpc_metrics::SerializePhase,
+                          microsec_clock::universal_time() - serializeStartTime);
 
       // run after response if we have one (then detect changes again)
       if (pJsonRpcResponse->hasAfterResponse())
@@ -772,7 +902,10 @@ void handleRpcRequest(const core::json::JsonRpcRequest& request,
    // (so we can determine if any events were added during execution)
    using namespace boost::posix_time; 
    ptime executeStartTime = microsec_clock::universal_time();
-   
+   rpc_metrics::record(request.method,
+                       rpc_metrics::QueueWaitPhase,
+                       ptrConnection->queueWaitTime());
+
    // execute the method
    json::JsonRpcAsyncMethods::const_iterator it =
                                      s_jsonRpcMethods.find(request.method);
@@ -786,6 +919,7 @@ void handleRpcRequest(const core::json::JsonRpcRequest& request,
          // direct return
          handlerFunction(request,
                          boost::bind(endHandleRpcRequestDirect,
+                                     request.method,
                                      ptrConnection,
                                      executeStartTime,
                                      _1,
@@ -816,7 +950,11 @@ void handleRpcRequest(const core::json::JsonRpcRequest& request,
       // application states
       LOG_ERROR(executeError);
 
-      endHandleRpcRequestDirect(ptrConnection, executeStartTime, executeError, NULL);
+      endHandleRpcRequestDirect(request.method,
+                                ptrConnection,
+                                executeStartTime,
+                                executeError,
+                                NULL);
    }
 
 
@@ -850,6 +988,30 @@ bool isWaitForMethodUri(const std::string& uri)
    return false;
 }
 
+Error validateJsonRpcRequest(const json::JsonRpcRequest& jsonRpcRequest)
+{
+   // check for invalid client id
+   if (jsonRpcRequest.clientId != rsession::persistentState().activeClientId())
+      return Error(json::errc::InvalidClientId, ERROR_LOCATION);
+
+   // check for legacy client version (need to invalidate any client using
+   // the old version field)
+   if ( (jsonRpcRequest.version > 0) &&
+        (s_version > jsonRpcRequest.version) )
+   {
+      return Error(json::errc::InvalidClientVersion, ERROR_LOCATION);
+   }
+
+   // check for client version
+   if (!jsonRpcRequest.clientVersion.empty() &&
+       clientVersion() != jsonRpcRequest.clientVersion)
+   {
+      return Error(json::errc::InvalidClientVersion, ERROR_LOCATION);
+   }
+
+   return Success();
+}
+
 bool parseAndValidateJsonRpcConnection(
          boost::shared_ptr<HttpConnection> ptrConnection,
          json::JsonRpcRequest* pJsonRpcRequest)
@@ -863,35 +1025,211 @@ bool parseAndValidateJsonRpcConnection(
       return false;
    }
 
-   // check for invalid client id
-   if (pJsonRpcRequest->clientId != rsession::persistentState().activeClientId())
+   // validate client id and version
+   error = validateJsonRpcRequest(*pJsonRpcRequest);
+   if (error)
    {
-      Error error(json::errc::InvalidClientId, ERROR_LOCATION);
       ptrConnection->sendJsonRpcError(error);
       return false;
    }
 
-   // check for legacy client version (need to invalidate any client using
-   // the old version field)
-   if ( (pJsonRpcRequest->version > 0) &&
-        (s_version > pJsonRpcRequest->version) )
+   // got through all of the validation, return true
+   return true;
+}
+
+bool isJsonRpcBatchRequest(boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   return ptrConnection->request().uri() == kRpcBatchUri;
+}
+
+// state of a batched json-rpc request (the calls within the batch are
+// executed in order and their responses are collected into an array)
+struct JsonRpcBatch
+{
+   JsonRpcBatch()
+      : detectChanges(false),
+        executeStartTime(boost::posix_time::microsec_clock::universal_time())
    {
-      Error error(json::errc::InvalidClientVersion, ERROR_LOCATION);
-      ptrConnection->sendJsonRpcError(error);
-      return false;
    }
 
-   // check for client version
-   if (!pJsonRpcRequest->clientVersion.empty() &&
-       clientVersion() != pJsonRpcRequest->clientVersion)
+   json::Array requests;
+   json::Array responses;
+   std::vector<json::JsonRpcResponse> afterResponses;
+   bool detectChanges;
+   boost::posix_time::ptime executeStartTime;
+};
+
+void executeJsonRpcBatch(boost::shared_ptr<HttpConnection> ptrConnection,
+                         ConnectionType connectionType,
+                         boost::shared_ptr<JsonRpcBatch> pBatch);
+
+void endJsonRpcBatchRequest(boost::shared_ptr<HttpConnection> ptrConnection,
+                            ConnectionType connectionType,
+                            boost::shared_ptr<JsonRpcBatch> pBatch,
+                            const core::Error& executeError,
+                            json::JsonRpcResponse* pJsonRpcResponse)
+{
+   json::JsonRpcResponse response;
+   if (executeError)
    {
-      Error error(json::errc::InvalidClientVersion, ERROR_LOCATION);
-      ptrConnection->sendJsonRpcError(error);
-      return false;
+      response.setError(executeError);
+   }
+   else
+   {
+      response = *pJsonRpcResponse;
+      if (!pJsonRpcResponse->suppressDetectChanges())
+         pBatch->detectChanges = true;
+      if (pJsonRpcResponse->hasAfterResponse())
+         pBatch->afterResponses.push_back(*pJsonRpcResponse);
    }
+   pBatch->responses.push_back(response.getRawResponse());
 
-   // got through all of the validation, return true
-   return true;
+   // continue with the rest of the batch
+   executeJsonRpcBatch(ptrConnection, connectionType, pBatch);
+}
+
+void endJsonRpcBatch(boost::shared_ptr<HttpConnection> ptrConnection,
+                     boost::shared_ptr<JsonRpcBatch> pBatch)
+{
+   // allow modules to detect changes once for the entire batch
+   if (pBatch->detectChanges)
+      detectChanges(module_context::ChangeSourceRPC);
+
+   // are there (or will there likely be) events pending?
+   // (if not then notify the client)
+   if ( !clientEventQueue().eventAddedSince(pBatch->executeStartTime) &&
+        pBatch->afterResponses.empty() )
+   {
+      BOOST_FOREACH(json::Value& response, pBatch->responses)
+      {
+         if (json::isType<json::Object>(response))
+            response.get_obj()[kEventsPending] = "false";
+      }
+   }
+
+   // send the response
+   http::Response response;
+   if (ptrConnection->request().acceptsEncoding(http::kGzipEncoding))
+      response.setContentEncoding(http::kGzipEncoding);
+   response.setNoCacheHeaders();
+   response.setContentType(json::kJsonContentType);
+   response.setBody(json::write(pBatch->responses));
+   ptrConnection->sendResponse(response);
+
+   // run after responses (then detect changes again)
+   bool detectChangesAfterResponse = false;
+   BOOST_FOREACH(json::JsonRpcResponse& jsonRpcResponse, pBatch->afterResponses)
+   {
+      jsonRpcResponse.runAfterResponse();
+      if (!jsonRpcResponse.suppressDetectChanges())
+         detectChangesAfterResponse = true;
+   }
+   if (detectChangesAfterResponse)
+      detectChanges(module_context::ChangeSourceRPC);
+}
+
+void executeJsonRpcBatch(boost::shared_ptr<HttpConnection> ptrConnection,
+                         ConnectionType connectionType,
+                         boost::shared_ptr<JsonRpcBatch> pBatch)
+{
+   while (pBatch->responses.size() < pBatch->requests.size())
+   {
+      const json::Value& requestValue =
+                              pBatch->requests[pBatch->responses.size()];
+
+      // parse and validate (errors are reported for the individual call
+      // rather than failing the entire batch)
+      json::JsonRpcRequest request;
+      Error error;
+      if (json::isType<json::Object>(requestValue))
+         error = json::parseJsonRpcRequest(requestValue.get_obj(), &request);
+      else
+         error = Error(json::errc::InvalidRequest, ERROR_LOCATION);
+      if (!error)
+         error = validateJsonRpcRequest(request);
+
+      // methods which manipulate the session itself can't be batched
+      if (!error && (request.method == kQuitSession ||
+                     request.method == kSuspendSession ||
+                     request.method == kInterrupt))
+      {
+         error = Error(json::errc::MethodUnexpected, ERROR_LOCATION);
+         error.addProperty("method", request.method);
+      }
+
+      // lookup the method
+      json::JsonRpcAsyncMethods::const_iterator it = s_jsonRpcMethods.end();
+      if (!error)
+      {
+         it = s_jsonRpcMethods.find(request.method);
+         if (it == s_jsonRpcMethods.end())
+         {
+            error = Error(json::errc::MethodNotFound, ERROR_LOCATION);
+            error.addProperty("method", request.method);
+            LOG_ERROR(error);
+         }
+      }
+
+      if (error)
+      {
+         json::JsonRpcResponse response;
+         response.setError(error);
+         pBatch->responses.push_back(response.getRawResponse());
+         continue;
+      }
+
+      request.isBackgroundConnection = (connectionType == BackgroundConnection);
+      std::pair<bool, json::JsonRpcAsyncFunction> reg = it->second;
+      json::JsonRpcAsyncFunction handlerFunction = reg.second;
+
+      if (reg.first)
+      {
+         // direct return (the continuation resumes the batch)
+         handlerFunction(request,
+                         boost::bind(endJsonRpcBatchRequest,
+                                     ptrConnection,
+                                     connectionType,
+                                     pBatch,
+                                     _1,
+                                     _2));
+         return;
+      }
+      else
+      {
+         // indirect return (asyncHandle style)
+         std::string handle = core::system::generateUuid(true);
+         json::JsonRpcResponse response;
+         response.setAsyncHandle(handle);
+         pBatch->responses.push_back(response.getRawResponse());
+
+         handlerFunction(request,
+                         boost::bind(endHandleRpcRequestIndirect,
+                                     handle,
+                                     _1,
+                                     _2));
+      }
+   }
+
+   // all calls executed, send the response
+   endJsonRpcBatch(ptrConnection, pBatch);
+}
+
+void handleJsonRpcBatchRequest(boost::shared_ptr<HttpConnection> ptrConnection,
+                               ConnectionType connectionType)
+{
+   // the body is an array of standard json-rpc requests
+   json::Value batchValue;
+   if (!json::parse(ptrConnection->request().body(), &batchValue) ||
+       !json::isType<json::Array>(batchValue))
+   {
+      ptrConnection->sendJsonRpcError(
+                     Error(json::errc::InvalidRequest, ERROR_LOCATION));
+      return;
+   }
+
+   boost::shared_ptr<JsonRpcBatch> pBatch(new JsonRpcBatch());
+   pBatch->requests = batchValue.get_array();
+   executeJsonRpcBatch(ptrConnection, connectionType, pBatch);
 }
 
 void endHandleConnection(boost::shared_ptr<HttpConnection> ptrConnection,
@@ -909,6 +1247,11 @@ void handleConnection(boost::shared_ptr<HttpConnection> ptrConnection,
    // check for a uri handler registered by a module
    const http::Request& request = ptrConnection->request();
    std::string uri = request.uri();
+
+   // associate spans with the request id propagated by the server
+   core::trace::RequestScope requestScope(
+                     request.headerValue(core::trace::kRequestIdHeader));
+   TRACE_SCOPE("handle " + request.path());
    http::UriAsyncHandlerFunction uriHandler = s_uriHandlers.handlerFor(uri);
 
    if (uriHandler) // uri handler
@@ -921,6 +1264,13 @@ void handleConnection(boost::shared_ptr<HttpConnection> ptrConnection,
                                       connectionType,
                                       _1));
    }
+   else if (isJsonRpcBatchRequest(ptrConnection)) // check for batched json-rpc
+   {
+      // r code may execute - ensure session is initialized
+      ensureSessionInitialized();
+
+      handleJsonRpcBatchRequest(ptrConnection, connectionType);
+   }
    else if (isJsonRpcRequest(ptrConnection)) // check for json-rpc
    {
       // r code may execute - ensure session is initialized
@@ -1186,20 +1536,13 @@ void polledEventHandler()
    // (otherwise we'll handle them directly in waitForMethod)
    if (s_rProcessingInput)
    {
-      // check the uri of the next connection
-      std::string nextConnectionUri =
-       httpConnectionListener().mainConnectionQueue().peekNextConnectionUri();
-
-      // if the uri is empty or if it one of our special waitForMethod calls
-      // then bails so that the waitForMethod logic can handle it
-      if (nextConnectionUri.empty() || isWaitForMethodUri(nextConnectionUri))
-         return;
-
-      // attempt to deque a connection and handle it. for now we just handle
-      // a single connection at a time (we'll be called back again if processing
-      // continues)
+      // attempt to deque a connection and handle it. our special
+      // waitForMethod calls are skipped so that the waitForMethod logic can
+      // handle them. for now we just handle a single connection at a time
+      // (we'll be called back again if processing continues)
       boost::shared_ptr<HttpConnection> ptrConnection =
-            httpConnectionListener().mainConnectionQueue().dequeConnection();
+            httpConnectionListener().mainConnectionQueue().dequeConnection(
+                                          !boost::bind(isWaitForMethodUri, _1));
       if (ptrConnection)
       {
          if ( isMethod(ptrConnection, kClientInit) )
@@ -1285,6 +1628,89 @@ bool canSuspend(const std::string& prompt)
 }
 
 
+// lower our cpu priority (see --session-idle-priority) once we've been idle
+// for a while so busy sessions on the host get more of the cpu, restoring it
+// as soon as there's activity. the server launches us with a nice limit
+// which allows the priority to be restored. (on linux this applies to the
+// calling thread, i.e. the main thread which runs R)
+const int kIdlePriorityDelaySeconds = 60;
+bool s_idlePriorityLowered = false;
+
+void setIdlePriority(bool idle)
+{
+#ifndef _WIN32
+   static int s_activePriority = 0;
+
+   int increment = options().idlePriority();
+   if (increment <= 0 || idle == s_idlePriorityLowered)
+      return;
+
+   if (idle)
+   {
+      errno = 0;
+      int priority = ::getpriority(PRIO_PROCESS, 0);
+      if (priority == -1 && errno != 0)
+      {
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+         return;
+      }
+
+      s_activePriority = priority;
+      if (::setpriority(PRIO_PROCESS,
+                        0,
+                        std::min(priority + increment, 19)) == -1)
+      {
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+         return;
+      }
+   }
+   else
+   {
+      if (::setpriority(PRIO_PROCESS, 0, s_activePriority) == -1)
+         LOG_ERROR(systemError(errno, ERROR_LOCATION));
+   }
+
+   s_idlePriorityLowered = idle;
+#endif
+}
+
+// once we've been idle for a while (see --session-reclaim-idle-minutes)
+// release memory we can do without (caches which are rebuilt on demand, R's
+// free heap pages and free malloc arenas) short of suspending the session,
+// reporting the amount reclaimed to the monitor
+bool s_idleMemoryReclaimed = false;
+
+void reclaimIdleMemory()
+{
+   s_idleMemoryReclaimed = true;
+
+   boost::uint64_t residentBefore = memory_usage::residentBytes();
+
+   module_context::events().onReclaimMemory();
+   core::stat_cache::invalidateAll();
+
+   rstudio::r::exec::RFunction gc("gc");
+   gc.addParam("full", true);
+   Error error = gc.call();
+   if (error)
+      LOG_ERROR(error);
+
+#ifdef __GLIBC__
+   ::malloc_trim(0);
+#endif
+
+   boost::uint64_t residentAfter = memory_usage::residentBytes();
+   if (residentBefore > residentAfter)
+   {
+      monitor::client().recordHistogramSample(
+                        "session",
+                        options().monitorIntervalSeconds(),
+                        "idle_memory_reclaimed",
+                        residentBefore - residentAfter,
+                        "bytes");
+   }
+}
+
 bool isTimedOut(const boost::posix_time::ptime& timeoutTime)
 {
    using namespace boost::posix_time;
@@ -1365,6 +1791,8 @@ bool waitForMethod(const std::string& method,
    boost::posix_time::ptime timeoutTime = timeoutTimeFromNow();
    boost::posix_time::time_duration connectionQueueTimeout =
                                    boost::posix_time::milliseconds(50);
+   boost::posix_time::ptime lastActivityTime =
+                        boost::posix_time::microsec_clock::universal_time();
 
    // wait until we get the method we are looking for
    while(true)
@@ -1396,12 +1824,36 @@ bool waitForMethod(const std::string& method,
       // if we have at least one async process running then this counts
       // as "activity" and resets the timeout timer
       if(haveRunningChildren())
+      {
          timeoutTime = timeoutTimeFromNow();
+         lastActivityTime = boost::posix_time::microsec_clock::universal_time();
+      }
+
+      // lower our priority and release memory if we've been idle a while
+      boost::posix_time::time_duration idleTime =
+         boost::posix_time::microsec_clock::universal_time() - lastActivityTime;
+      if (!s_idlePriorityLowered &&
+          idleTime > boost::posix_time::seconds(kIdlePriorityDelaySeconds))
+      {
+         setIdlePriority(true);
+      }
+      int reclaimIdleMinutes = options().reclaimIdleMinutes();
+      if (!s_idleMemoryReclaimed && reclaimIdleMinutes > 0 &&
+          idleTime > boost::posix_time::minutes(reclaimIdleMinutes))
+      {
+         reclaimIdleMemory();
+      }
 
       // look for a connection (waiting for the specified interval)
       boost::shared_ptr<HttpConnection> ptrConnection =
           httpConnectionListener().mainConnectionQueue().dequeConnection(
                                             connectionQueueTimeout);
+      if (ptrConnection)
+      {
+         setIdlePriority(false);
+         s_idleMemoryReclaimed = false;
+         lastActivityTime = boost::posix_time::microsec_clock::universal_time();
+      }
 
 
       // perform background processing (true for isIdle)
@@ -1504,7 +1956,8 @@ void addToConsoleInputBuffer(const rstudio::r::session::RConsoleInput& consoleIn
    }
 }
 
-// extract console input -- can be either null (user hit escape) or a string
+// extract console input -- can be either null (user hit escape), a string
+// or an array of lines (which are all queued for R to read in turn)
 Error extractConsoleInput(const json::JsonRpcRequest& request)
 {
    if (request.params.size() == 1)
@@ -1523,6 +1976,22 @@ Error extractConsoleInput(const json::JsonRpcRequest& request)
          // return success
          return Success();
       }
+      else if (request.params[0].type() == json::ArrayType)
+      {
+         const json::Array& lines = request.params[0].get_array();
+         BOOST_FOREACH(const json::Value& line, lines)
+         {
+            if (line.type() != json::StringType)
+               return Error(json::errc::ParamTypeMismatch, ERROR_LOCATION);
+         }
+
+         BOOST_FOREACH(const json::Value& line, lines)
+         {
+            addToConsoleInputBuffer(
+                     rstudio::r::session::RConsoleInput(line.get_str()));
+         }
+         return Success();
+      }
       else
       {
          return Error(json::errc::ParamTypeMismatch, ERROR_LOCATION);
@@ -1575,10 +2044,103 @@ Error ping(const core::json::JsonRpcRequest& request,
    return Success();
 }
 
+void handleTraceRequest(const http::Request& request,
+                        http::Response* pResponse)
+{
+   std::ostringstream ostr;
+   core::trace::writeChromeTrace(ostr);
+
+   pResponse->setNoCacheHeaders();
+   pResponse->setContentType("application/json");
+   pResponse->setBody(ostr.str());
+}
+
+// NOTE: registered worker safe so that the counters can be read while
+// the main thread is busy (rpc_metrics is threadsafe)
+Error getRpcMetrics(const core::json::JsonRpcRequest& request,
+                    json::JsonRpcResponse* pResponse)
+{
+   bool reset = false;
+   Error error = json::readParams(request.params, &reset);
+   if (error)
+      return error;
+
+   pResponse->setResult(rpc_metrics::countersAsJson());
+   if (reset)
+      rpc_metrics::reset();
+
+   return Success();
+}
+
+// NOTE: not worker safe since the usage reporters read main thread state
+Error getMemoryUsage(const core::json::JsonRpcRequest& request,
+                     json::JsonRpcResponse* pResponse)
+{
+   pResponse->setResult(memory_usage::usageAsJson());
+   return Success();
+}
+
+bool recordSessionMetrics()
+{
+   memory_usage::recordMetrics();
+
+   monitor::client().recordMetric(monitor::metrics::Metric(
+         "session",
+         rsession::options().monitorIntervalSeconds(),
+         monitor::metrics::MetricData(
+               "events.queue_depth",
+               static_cast<double>(clientEventQueue().pendingEventCount())),
+         "gauge",
+         "events"));
+   return true;
+}
+
+std::size_t consoleActionsMemoryUsage()
+{
+   return rstudio::r::session::consoleActions().memoryUsage();
+}
+
+std::size_t clientEventQueueMemoryUsage()
+{
+   return clientEventQueue().memoryUsage();
+}
+
+
+// NOTE: called on the listener threads so must not touch any shared state
+ConnectionPriority connectionPriority(const std::string& uri)
+{
+   if (isMethod(uri, kInterrupt))
+      return InterruptPriority;
+   else if (isMethod(uri, kConsoleInput))
+      return ConsoleInputPriority;
+   else if (boost::algorithm::starts_with(uri, "/rpc/"))
+      return InteractivePriority;
+   else
+      return BulkPriority;
+}
 
 Error startHttpConnectionListener()
 {
    initializeHttpConnectionListener();
+   httpConnectionListener().mainConnectionQueue().setConnectionClassifier(
+                                                         connectionPriority);
+
+   // wake the main thread's wait for a connection when a child process has
+   // output or exits so it's handled without waiting out the poll interval
+   module_context::processSupervisor().setActivityHandler(
+         boost::bind(&HttpConnectionQueue::wakeWaiter,
+                     &(httpConnectionListener().mainConnectionQueue())));
+
+   // start the worker pool (worker-safe rpc methods are dispatched to it
+   // directly from the listener)
+   worker_pool::setClientIdentity(
+                           rsession::persistentState().activeClientId(),
+                           clientVersion());
+   Error error = worker_pool::initialize(
+                           rsession::options().workerThreads());
+   if (error)
+      return error;
+
    return httpConnectionListener().start();
 }
 
@@ -1707,6 +2269,9 @@ Error rInit(const rstudio::r::session::RInitInfo& rInitInfo)
       (bind(registerRpcMethod, kConsoleInput, bufferConsoleInput))
       (bind(registerRpcMethod, "suspend_for_restart", suspendForRestart))
       (bind(registerRpcMethod, "ping", ping))
+      (bind(registerWorkerSafeRpcMethod, "get_rpc_metrics", getRpcMetrics))
+      (bind(registerRpcMethod, "get_memory_usage", getMemoryUsage))
+      (bind(registerUriHandler, "/trace", handleTraceRequest))
 
       // signal handlers
       (registerSignalHandlers)
@@ -1802,6 +2367,25 @@ Error rInit(const rstudio::r::session::RInitInfo& rInitInfo)
    Error error = initialize.execute();
    if (error)
       return error;
+
+   // wait for the R-independent work modules scheduled on the worker pool
+   // (it has been running in parallel with the initialization above)
+   module_context::waitForStartupTasks();
+
+   // account for the memory held by the console and event queue, and
+   // periodically send the accounted memory to the monitor
+   memory_usage::registerReporter("console_actions", consoleActionsMemoryUsage);
+   memory_usage::registerReporter("client_event_queue",
+                                  clientEventQueueMemoryUsage);
+   if (rsession::options().monitorIntervalSeconds() > 0)
+   {
+      module_context::schedulePeriodicWork(
+            boost::posix_time::seconds(
+                     rsession::options().monitorIntervalSeconds()),
+            recordSessionMetrics,
+            false,
+            false);
+   }
    
    // if we are in verify installation mode then we should exit (successfully) now
    if (rsession::options().verifyInstallation())
@@ -1944,8 +2528,30 @@ void reissueLastConsolePrompt()
 
 void setExecuting(bool executing)
 {
+   // record R eval time (from console input to the next prompt)
+   static boost::posix_time::ptime s_executeStartTime;
+   if (executing)
+   {
+      s_executeStartTime = boost::posix_time::microsec_clock::universal_time();
+   }
+   else if (!s_executeStartTime.is_not_a_date_time())
+   {
+      module_context::recordLatency("r.eval", s_executeStartTime);
+      s_executeStartTime = boost::posix_time::ptime();
+   }
+
    s_rProcessingInput = executing;
-   module_context::activeSession().setExecuting(executing);
+
+   // the active session's executing state is a file in its scratch path so
+   // only write it when it changes. R stays busy between the lines of
+   // buffered input so it isn't cleared (and set again) for each of them
+   static int s_activeSessionExecuting = -1;
+   int busy = executing || !s_consoleInputBuffer.empty();
+   if (busy != s_activeSessionExecuting)
+   {
+      s_activeSessionExecuting = busy;
+      module_context::activeSession().setExecuting(busy);
+   }
 }
 
 bool rConsoleRead(const std::string& prompt,
@@ -2438,6 +3044,9 @@ void rCleanup(bool terminatedNormally)
       // fire shutdown event to modules
       module_context::events().onShutdown(terminatedNormally);
 
+      // write any settings changes still waiting on their write-behind delay
+      Settings::flushPendingWrites();
+
       // destroy session if requested
       if (s_destroySession)
       {
@@ -2817,6 +3426,24 @@ Error registerRpcMethod(const std::string& name,
    return Success();
 }
 
+Error registerWorkerSafeRpcMethod(const std::string& name,
+                                  const core::json::JsonRpcFunction& function)
+{
+   // also register for the main thread (used for batched requests and for
+   // requests received before the worker pool is running)
+   worker_pool::registerMethod(name, function);
+   return registerRpcMethod(name, function);
+}
+
+Error registerWorkerSafeUriHandler(
+      const std::string& name,
+      const boost::function<bool(const http::Request&,
+                                 http::Response*)>& handlerFunction)
+{
+   worker_pool::registerUriHandler(name, handlerFunction);
+   return Success();
+}
+
 UserPrompt::Response showUserPrompt(const UserPrompt& userPrompt)
 {
    // enque user prompt event
@@ -3059,6 +3686,10 @@ int main (int argc, char * const argv[])
       // reflect stderr logging
       core::system::setLogToStderr(options.logStderr());
 
+      // enable tracing if requested
+      core::trace::setEnabled(options.trace());
+      core::trace::setThreadName("main");
+
       // initialize monitor
       monitor::initializeMonitorClient(kMonitorSocketPath,
                                        options.monitorSharedSecret());
@@ -3070,6 +3701,18 @@ int main (int argc, char * const argv[])
                                                 options.programIdentity()));
       }
 
+      // periodically send recorded metrics to the monitor (and to the
+      // server if it asked for them)
+      metrics_report::initialize();
+      if (options.monitorIntervalSeconds() > 0)
+      {
+         monitor::client().startMetricsFlush(
+               boost::posix_time::seconds(options.monitorIntervalSeconds()));
+      }
+
+      // batch console actions for the monitor (if auditing)
+      console_audit::initialize();
+
       // initialize file lock config
       FileLock::initialize();
 
@@ -3152,8 +3795,23 @@ int main (int argc, char * const argv[])
 #endif
 
       // start the file monitor
+      if (options.fileMonitorBackend() == "fanotify")
+      {
+         core::system::file_monitor::setBackend(
+                              core::system::file_monitor::FanotifyBackend);
+      }
+      core::system::file_monitor::setLatency(
+            boost::posix_time::milliseconds(
+                     std::max(0, options.fileMonitorLatencyMs())));
       core::system::file_monitor::initialize();
 
+      // cache file metadata if requested
+      if (options.statCacheTtlMs() > 0)
+      {
+         core::stat_cache::setTimeToLive(
+               boost::posix_time::milliseconds(options.statCacheTtlMs()));
+      }
+
       // initialize client event queue. this must be done very early
       // in main so that any other code which needs to enque an event
       // has access to the queue
@@ -3261,6 +3919,7 @@ int main (int argc, char * const argv[])
       rOptions.saveWorkspace = saveWorkspaceOption();
       rOptions.rProfileOnResume = serverMode &&
                                   userSettings().rProfileOnResume();
+      rOptions.lazyResume = options.lazyResume();
       rOptions.sessionScope = options.sessionScope();
       
       // r callbacks
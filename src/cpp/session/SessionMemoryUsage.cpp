@@ -0,0 +1,192 @@
+/*
+ * SessionMemoryUsage.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionMemoryUsage.hpp>
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#endif
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+
+#include <monitor/MonitorClient.hpp>
+
+#include <session/SessionOptions.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace memory_usage {
+
+namespace {
+
+typedef std::map<std::string, UsageReporter> Reporters;
+Reporters s_reporters;
+
+std::map<std::string, std::size_t> subsystemUsage()
+{
+   std::map<std::string, std::size_t> usage;
+   BOOST_FOREACH(const Reporters::value_type& reporter, s_reporters)
+   {
+      try
+      {
+         usage[reporter.first] = reporter.second();
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+   return usage;
+}
+
+json::Value bytesAsJson(boost::uint64_t bytes)
+{
+   return static_cast<boost::int64_t>(bytes);
+}
+
+} // anonymous namespace
+
+void registerReporter(const std::string& name, const UsageReporter& reporter)
+{
+   s_reporters[name] = reporter;
+}
+
+AllocatorStats allocatorStats()
+{
+   AllocatorStats stats;
+
+#if defined(__GLIBC__)
+   // mallinfo's int fields wrap for heaps beyond 2GB (mallinfo2, which
+   // doesn't have this problem, is available from glibc 2.33)
+   stats.available = true;
+   stats.allocator = "glibc";
+# if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+   struct mallinfo2 info = ::mallinfo2();
+# else
+   struct mallinfo info = ::mallinfo();
+# endif
+   stats.inUseBytes = static_cast<boost::uint64_t>(info.uordblks) +
+                      static_cast<boost::uint64_t>(info.hblkhd);
+   stats.freeBytes = static_cast<boost::uint64_t>(info.fordblks);
+   stats.mappedBytes = static_cast<boost::uint64_t>(info.hblkhd);
+#elif defined(__APPLE__)
+   malloc_statistics_t info;
+   ::malloc_zone_statistics(NULL, &info);
+   stats.available = true;
+   stats.allocator = "darwin";
+   stats.inUseBytes = info.size_in_use;
+   stats.freeBytes = info.size_allocated > info.size_in_use ?
+                        info.size_allocated - info.size_in_use : 0;
+#endif
+
+   return stats;
+}
+
+boost::uint64_t residentBytes()
+{
+#ifdef __linux__
+   std::string statm;
+   Error error = readStringFromFile(FilePath("/proc/self/statm"), &statm);
+   if (error)
+      return 0;
+
+   std::istringstream istr(statm);
+   boost::uint64_t sizePages = 0, residentPages = 0;
+   istr >> sizePages >> residentPages;
+   return residentPages * ::sysconf(_SC_PAGESIZE);
+#else
+   return 0;
+#endif
+}
+
+json::Object usageAsJson()
+{
+   json::Object usageJson;
+   usageJson["resident"] = bytesAsJson(residentBytes());
+
+   AllocatorStats stats = allocatorStats();
+   if (stats.available)
+   {
+      json::Object allocatorJson;
+      allocatorJson["name"] = stats.allocator;
+      allocatorJson["in_use"] = bytesAsJson(stats.inUseBytes);
+      allocatorJson["free"] = bytesAsJson(stats.freeBytes);
+      allocatorJson["mapped"] = bytesAsJson(stats.mappedBytes);
+      usageJson["allocator"] = allocatorJson;
+   }
+
+   json::Object subsystemsJson;
+   boost::uint64_t accounted = 0;
+   typedef std::map<std::string, std::size_t>::value_type Usage;
+   BOOST_FOREACH(const Usage& usage, subsystemUsage())
+   {
+      subsystemsJson[usage.first] = bytesAsJson(usage.second);
+      accounted += usage.second;
+   }
+   usageJson["subsystems"] = subsystemsJson;
+   usageJson["accounted"] = bytesAsJson(accounted);
+
+   return usageJson;
+}
+
+void recordMetrics()
+{
+   std::vector<monitor::metrics::MetricData> data;
+   data.push_back(monitor::metrics::MetricData("memory.resident",
+                                               residentBytes()));
+
+   AllocatorStats stats = allocatorStats();
+   if (stats.available)
+   {
+      data.push_back(monitor::metrics::MetricData("memory.allocator.in_use",
+                                                  stats.inUseBytes));
+      data.push_back(monitor::metrics::MetricData("memory.allocator.free",
+                                                  stats.freeBytes));
+   }
+
+   typedef std::map<std::string, std::size_t>::value_type Usage;
+   BOOST_FOREACH(const Usage& usage, subsystemUsage())
+   {
+      data.push_back(monitor::metrics::MetricData("memory." + usage.first,
+                                                  usage.second));
+   }
+
+   monitor::client().recordMetric(monitor::metrics::MultiMetric(
+                              "session",
+                              session::options().monitorIntervalSeconds(),
+                              data,
+                              "gauge",
+                              "bytes"));
+}
+
+} // namespace memory_usage
+} // namespace session
+} // namespace rstudio
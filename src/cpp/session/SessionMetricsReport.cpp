@@ -0,0 +1,114 @@
+/*
+ * SessionMetricsReport.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionMetricsReport.hpp>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/FilePath.hpp>
+
+#include <core/json/Json.hpp>
+
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+#include <core/http/LocalStreamBlockingClient.hpp>
+
+#include <core/system/System.hpp>
+
+#include <monitor/MonitorClient.hpp>
+
+#include <session/SessionOptions.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace metrics_report {
+
+namespace {
+
+// identifies this session's reports to the server
+std::string s_reporterId;
+
+// only log the first of a run of failures (e.g. while the server restarts)
+bool s_reportFailed = false;
+
+void reportMetrics(const std::vector<monitor::metrics::MultiMetric>& metrics,
+                   const std::vector<monitor::metrics::HistogramMetric>& histograms)
+{
+   json::Array metricsJson;
+   BOOST_FOREACH(const monitor::metrics::MultiMetric& metric, metrics)
+   {
+      metricsJson.push_back(monitor::metrics::metricToJson(metric));
+   }
+
+   json::Array histogramsJson;
+   BOOST_FOREACH(const monitor::metrics::HistogramMetric& histogram, histograms)
+   {
+      histogramsJson.push_back(monitor::metrics::metricToJson(histogram));
+   }
+
+   json::Object reportJson;
+   reportJson["id"] = s_reporterId;
+   reportJson["interval"] = options().monitorIntervalSeconds();
+   reportJson["metrics"] = metricsJson;
+   reportJson["histograms"] = histogramsJson;
+
+   http::Request request;
+   request.setMethod("POST");
+   request.setUri("/report");
+   request.setHeader("Accept", "*/*");
+   request.setHeader("Connection", "close");
+   request.setBody(json::write(reportJson));
+
+   http::Response response;
+   Error error = http::sendRequest(FilePath(kMonitorMetricsSocketPath),
+                                   request,
+                                   &response);
+   if (!error && response.statusCode() != http::status::Ok)
+   {
+      error = systemError(boost::system::errc::protocol_error,
+                          ERROR_LOCATION);
+      error.addProperty("status", response.statusCode());
+      error.addProperty("message", response.body());
+   }
+
+   if (error && !s_reportFailed)
+      LOG_ERROR(error);
+   s_reportFailed = error;
+}
+
+} // anonymous namespace
+
+void initialize()
+{
+   if (!options().monitorReportMetrics() ||
+       options().monitorIntervalSeconds() <= 0)
+   {
+      return;
+   }
+
+   s_reporterId = core::system::generateShortenedUuid();
+   monitor::client().setMetricsFlushHandler(reportMetrics);
+}
+
+} // namespace metrics_report
+} // namespace session
+} // namespace rstudio
@@ -21,6 +21,7 @@
 #include <boost/utility.hpp>
 #include <boost/signal.hpp>
 #include <boost/format.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 
 #include <core/BoostThread.hpp>
@@ -28,6 +29,7 @@
 #include <core/FilePath.hpp>
 #include <core/FileInfo.hpp>
 #include <core/Log.hpp>
+#include <core/SafeConvert.hpp>
 #include <core/Hash.hpp>
 #include <core/Settings.hpp>
 #include <core/DateTime.hpp>
@@ -66,6 +68,9 @@
 
 #include <session/SessionConstants.hpp>
 #include <session/SessionContentUrls.hpp>
+#include <session/SessionWorkerPool.hpp>
+
+#include <monitor/MonitorClient.hpp>
 
 #include "modules/SessionBreakpoints.hpp"
 #include "modules/SessionVCS.hpp"
@@ -426,7 +431,9 @@ void onMonitoringError(const Error& error)
       module_context::schedulePeriodicWork(
          boost::posix_time::seconds(3),
          boost::bind(scanForMonitoredPathChanges, monitoredPathTree()),
-         true);
+         true,
+         true,
+         WorkPriorityLow);
    }
 }
 
@@ -526,9 +533,21 @@ void onSuspended(const r::session::RSuspendOptions& options,
    pPersistentState->beginUpdate();
    s_suspendHandlers.suspend(options, pPersistentState);
    pPersistentState->endUpdate();
-   
+
+   // write any settings changes still waiting on their write-behind delay
+   Settings::flushPendingWrites();
+}
+
+namespace {
+
+bool writeDueSettings()
+{
+   Settings::flushPendingWrites(true);
+   return true;
 }
 
+} // anonymous namespace
+
 void onResumed(const Settings& persistentState)
 {
    s_suspendHandlers.resume(persistentState);
@@ -538,41 +557,132 @@ void onResumed(const Settings& persistentState)
 
 namespace {
 
-typedef std::vector<boost::shared_ptr<ScheduledCommand> >
-                                                      ScheduledCommands;
+// once a tick's scheduled work has run for this long no further commands
+// are started (the rest run on subsequent ticks, having waited longer)
+const boost::posix_time::time_duration kScheduledWorkBudget =
+                                    boost::posix_time::milliseconds(100);
+
+// single executions longer than this are reported
+const boost::posix_time::time_duration kSlowScheduledWork =
+                                    boost::posix_time::milliseconds(250);
+
+struct ScheduledWork
+{
+   ScheduledWork(boost::shared_ptr<ScheduledCommand> pCommand,
+                 bool idleOnly,
+                 WorkPriority priority)
+      : pCommand(pCommand), idleOnly(idleOnly), priority(priority),
+        executions(0)
+   {
+   }
+
+   boost::shared_ptr<ScheduledCommand> pCommand;
+   bool idleOnly;
+   WorkPriority priority;
+
+   // instrumentation
+   int executions;
+   boost::posix_time::time_duration totalTime;
+   boost::posix_time::time_duration maxTime;
+};
+
+typedef std::vector<boost::shared_ptr<ScheduledWork> > ScheduledCommands;
 ScheduledCommands s_scheduledCommands;
-ScheduledCommands s_idleScheduledCommands;
 
 void addScheduledCommand(boost::shared_ptr<ScheduledCommand> pCommand,
-                         bool idleOnly)
+                         bool idleOnly,
+                         WorkPriority priority)
+{
+   s_scheduledCommands.push_back(boost::make_shared<ScheduledWork>(
+                                          pCommand, idleOnly, priority));
+}
+
+// ready work ordered by priority and then by how long it has been ready
+bool compareScheduledWork(const std::pair<boost::posix_time::ptime,
+                                          boost::shared_ptr<ScheduledWork> >& a,
+                          const std::pair<boost::posix_time::ptime,
+                                          boost::shared_ptr<ScheduledWork> >& b)
 {
-   if (idleOnly)
-      s_idleScheduledCommands.push_back(pCommand);
+   if (a.second->priority != b.second->priority)
+      return a.second->priority < b.second->priority;
    else
-      s_scheduledCommands.push_back(pCommand);
+      return a.first < b.first;
 }
 
-void executeScheduledCommands(ScheduledCommands* pCommands)
+void recordScheduledWork(ScheduledWork* pWork,
+                         const boost::posix_time::time_duration& elapsed)
 {
-   // make a copy of scheduled commands before executing them
-   // (this is because a scheduled command could result in
-   // R code executing which in turn could cause the list of
-   // scheduled commands to be mutated and these iterators
-   // invalidated)
-   ScheduledCommands commands = *pCommands;
+   pWork->executions++;
+   pWork->totalTime += elapsed;
+   if (elapsed > pWork->maxTime)
+   {
+      pWork->maxTime = elapsed;
+
+      // report when a command sets a new high above the slow threshold
+      if (elapsed > kSlowScheduledWork)
+      {
+         LOG_WARNING_MESSAGE(
+            "Scheduled work (priority " +
+            safe_convert::numberToString(pWork->priority) + ") took " +
+            safe_convert::numberToString(elapsed.total_milliseconds()) +
+            "ms (" + safe_convert::numberToString(pWork->executions) +
+            " executions, " +
+            safe_convert::numberToString(pWork->totalTime.total_milliseconds()) +
+            "ms total)");
+
+         monitor::client().recordHistogramSample(
+                              "session",
+                              session::options().monitorIntervalSeconds(),
+                              "slow_scheduled_work",
+                              elapsed.total_milliseconds(),
+                              "ms");
+      }
+   }
+}
+
+void executeScheduledCommands(bool isIdle)
+{
+   using namespace boost::posix_time;
+   ptime startTime = microsec_clock::universal_time();
+
+   // collect the ready commands. we hold references to them while they
+   // execute because a scheduled command could result in R code executing
+   // which in turn could cause the list of scheduled commands to be mutated
+   typedef std::pair<ptime, boost::shared_ptr<ScheduledWork> > ReadyWork;
+   std::vector<ReadyWork> ready;
+   for (ScheduledCommands::const_iterator it = s_scheduledCommands.begin();
+        it != s_scheduledCommands.end(); ++it)
+   {
+      if ((*it)->idleOnly && !isIdle)
+         continue;
+
+      ptime nextTime = (*it)->pCommand->nextExecutionTime();
+      if (nextTime <= startTime)
+         ready.push_back(std::make_pair(nextTime, *it));
+   }
+   std::sort(ready.begin(), ready.end(), compareScheduledWork);
+
+   // execute them until the budget is used (always executing at least one)
+   for (std::size_t i = 0; i < ready.size(); i++)
+   {
+      ptime now = microsec_clock::universal_time();
+      if (i > 0 && (now - startTime) > kScheduledWorkBudget)
+         break;
 
-   // execute all commands
-   std::for_each(commands.begin(),
-                 commands.end(),
-                 boost::bind(&ScheduledCommand::execute, _1));
+      ScheduledWork* pWork = ready[i].second.get();
+      pWork->pCommand->execute();
+      recordScheduledWork(pWork, microsec_clock::universal_time() - now);
+   }
 
    // remove any commands which are finished
-   pCommands->erase(
-                 std::remove_if(
-                    pCommands->begin(),
-                    pCommands->end(),
-                    boost::bind(&ScheduledCommand::finished, _1)),
-                 pCommands->end());
+   for (ScheduledCommands::iterator it = s_scheduledCommands.begin();
+        it != s_scheduledCommands.end(); )
+   {
+      if ((*it)->pCommand->finished())
+         it = s_scheduledCommands.erase(it);
+      else
+         ++it;
+   }
 }
 
 
@@ -581,36 +691,42 @@ void executeScheduledCommands(ScheduledCommands* pCommands)
 void scheduleIncrementalWork(
          const boost::posix_time::time_duration& incrementalDuration,
          const boost::function<bool()>& execute,
-         bool idleOnly)
+         bool idleOnly,
+         WorkPriority priority)
 {
    addScheduledCommand(boost::shared_ptr<ScheduledCommand>(
                            new IncrementalCommand(incrementalDuration,
                                                   execute)),
-                         idleOnly);
+                         idleOnly,
+                         priority);
 }
 
 void scheduleIncrementalWork(
          const boost::posix_time::time_duration& initialDuration,
          const boost::posix_time::time_duration& incrementalDuration,
          const boost::function<bool()>& execute,
-         bool idleOnly)
+         bool idleOnly,
+         WorkPriority priority)
 {
    addScheduledCommand(boost::shared_ptr<ScheduledCommand>(
                            new IncrementalCommand(initialDuration,
                                                   incrementalDuration,
                                                   execute)),
-                           idleOnly);
+                           idleOnly,
+                           priority);
 }
 
 
 void schedulePeriodicWork(const boost::posix_time::time_duration& period,
                           const boost::function<bool()> &execute,
                           bool idleOnly,
-                          bool immediate)
+                          bool immediate,
+                          WorkPriority priority)
 {
    addScheduledCommand(boost::shared_ptr<ScheduledCommand>(
                            new PeriodicCommand(period, execute, immediate)),
-                       idleOnly);
+                       idleOnly,
+                       priority);
 }
 
 
@@ -661,16 +777,80 @@ bool isPackagePosixMakefile(const FilePath& srcPath)
 
 void scheduleDelayedWork(const boost::posix_time::time_duration& period,
                          const boost::function<void()> &execute,
-                         bool idleOnly)
+                         bool idleOnly,
+                         WorkPriority priority)
 {
    boost::shared_ptr<bool> pExecuted(new bool(false));
 
    schedulePeriodicWork(period,
                         boost::bind(performDelayedWork, execute, pExecuted),
                         idleOnly,
-                        false);
+                        false,
+                        priority);
 }
 
+namespace {
+
+// synchronization objects (never freed, startup tasks may outlive main)
+boost::mutex* s_pStartupMutex = new boost::mutex();
+boost::condition* s_pStartupTasksChanged = new boost::condition();
+int s_pendingStartupTasks = 0;
+
+void runStartupTask(const std::string& name,
+                    const boost::function<Error()>& task)
+{
+   Error error = task();
+   if (error)
+   {
+      error.addProperty("startup-task", name);
+      LOG_ERROR(error);
+   }
+}
+
+void performStartupTask(const std::string& name,
+                        const boost::function<Error()>& task)
+{
+   try
+   {
+      runStartupTask(name, task);
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   LOCK_MUTEX(*s_pStartupMutex)
+   {
+      s_pendingStartupTasks--;
+   }
+   END_LOCK_MUTEX
+
+   s_pStartupTasksChanged->notify_all();
+}
+
+} // anonymous namespace
+
+void scheduleStartupTask(const std::string& name,
+                         const boost::function<Error()>& task)
+{
+   LOCK_MUTEX(*s_pStartupMutex)
+   {
+      s_pendingStartupTasks++;
+   }
+   END_LOCK_MUTEX
+
+   // run it here if the pool isn't available
+   if (!worker_pool::execute(boost::bind(performStartupTask, name, task)))
+      performStartupTask(name, task);
+}
+
+void waitForStartupTasks()
+{
+   try
+   {
+      boost::unique_lock<boost::mutex> lock(*s_pStartupMutex);
+      while (s_pendingStartupTasks > 0)
+         s_pStartupTasksChanged->wait(lock);
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
 
 void onBackgroundProcessing(bool isIdle)
 {
@@ -683,10 +863,8 @@ void onBackgroundProcessing(bool isIdle)
    // fire event
    events().onBackgroundProcessing(isIdle);
 
-   // execute incremental commands
-   executeScheduledCommands(&s_scheduledCommands);
-   if (isIdle)
-      executeScheduledCommands(&s_idleScheduledCommands);
+   // execute scheduled commands
+   executeScheduledCommands(isIdle);
 }
 
 core::string_utils::LineEnding lineEndings(const core::FilePath& srcFile)
@@ -1400,6 +1578,22 @@ void enqueClientEvent(const ClientEvent& event)
    session::clientEventQueue().add(event);
 }
 
+void recordLatency(const std::string& name,
+                   const boost::posix_time::ptime& startTime)
+{
+   using namespace boost::posix_time;
+   time_duration elapsed = microsec_clock::universal_time() - startTime;
+   if (elapsed.is_negative())
+      return;
+
+   monitor::client().recordHistogramSample(
+                     "session",
+                     session::options().monitorIntervalSeconds(),
+                     name,
+                     static_cast<boost::uint64_t>(elapsed.total_microseconds()),
+                     "us");
+}
+
 bool isDirectoryMonitored(const FilePath& directory)
 {
    return session::projects::projectContext().isMonitoringDirectory(directory) ||
@@ -1490,6 +1684,7 @@ void enqueFileChangedEvent(const core::system::FileChangeEvent &event)
    FilePath filePath = FilePath(event.fileInfo().absolutePath());
 
    using namespace session::modules::source_control;
+   invalidateStatusCache();
    boost::shared_ptr<FileDecorationContext> pCtx =
                                        fileDecorationContext(filePath);
 
@@ -1517,6 +1712,7 @@ void enqueFileChangedEvents(const core::FilePath& vcsStatusRoot,
    }
 
    using namespace session::modules::source_control;
+   invalidateStatusCache();
    boost::shared_ptr<FileDecorationContext> pCtx =
                                   fileDecorationContext(commonParentPath);
 
@@ -1570,6 +1766,15 @@ void consoleWriteError(const std::string& message)
                                     message);
 }
 
+std::size_t collapsedConsoleOutput(std::size_t offsetFromEnd,
+                                   std::size_t maxBytes,
+                                   std::string* pOutput)
+{
+   return session::clientEventQueue().collapsedConsoleOutput(offsetFromEnd,
+                                                             maxBytes,
+                                                             pOutput);
+}
+
 void showErrorMessage(const std::string& title, const std::string& message)
 {
    session::clientEventQueue().add(showErrorMessageEvent(title, message));
@@ -1799,10 +2004,12 @@ core::Error executeAsync(const json::JsonRpcFunction& function,
    // operation on a new thread.
 
    std::string handle = core::system::generateUuid(true);
-   core::thread::safeLaunchThread(bind(beginRpcHandler,
+   boost::function<void()> task = bind(beginRpcHandler,
                                        function,
                                        request,
-                                       handle));
+                                       handle);
+   if (!worker_pool::execute(task))
+      core::thread::safeLaunchThread(task);
    pResponse->setAsyncHandle(handle);
    return Success();
 }
@@ -2020,12 +2227,16 @@ json::Value sourceMarkerJson(const SourceMarker& sourceMarker)
 } // anonymous namespace
 
 json::Array sourceMarkersAsJson(const std::vector<SourceMarker>& markers)
+{
+   return sourceMarkersAsJson(markers.begin(), markers.end());
+}
+
+json::Array sourceMarkersAsJson(std::vector<SourceMarker>::const_iterator begin,
+                                std::vector<SourceMarker>::const_iterator end)
 {
    json::Array markersJson;
-   std::transform(markers.begin(),
-                  markers.end(),
-                  std::back_inserter(markersJson),
-                  sourceMarkerJson);
+   markersJson.reserve(std::distance(begin, end));
+   std::transform(begin, end, std::back_inserter(markersJson), sourceMarkerJson);
    return markersJson;
 }
 
@@ -2208,6 +2419,13 @@ Error initialize()
    // initialize monitored scratch dir
    initializeMonitoredUserScratchDir();
 
+   // write coalesced settings changes once they're due
+   schedulePeriodicWork(boost::posix_time::seconds(1),
+                        writeDueSettings,
+                        false,
+                        false,
+                        WorkPriorityLow);
+
    // source the ModuleTools.R file
    FilePath modulesPath = session::options().modulesRSourcePath();
    return r::sourceManager().sourceTools(modulesPath.complete("ModuleTools.R"));
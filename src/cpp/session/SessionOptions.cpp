@@ -160,6 +160,43 @@ core::ProgramStatus Options::read(int argc, char * const argv[])
       (kDisconnectedTimeoutSessionOption,
          value<int>(&disconnectedTimeoutMinutes_)->default_value(0),
          "session disconnected timeout (minutes)" )
+      ("session-worker-threads",
+         value<int>(&workerThreads_)->default_value(2),
+         "number of threads for worker-safe rpc methods (0 for one per "
+         "available cpu)")
+      (kTraceSessionOption,
+         value<bool>(&trace_)->default_value(false),
+         "record trace spans for requests")
+      (kSharedFileMonitorSessionOption,
+         value<bool>(&sharedFileMonitor_)->default_value(false),
+         "monitor projects using the server's shared file monitor")
+      ("session-file-monitor-backend",
+         value<std::string>(&fileMonitorBackend_)->default_value("inotify"),
+         "file monitoring backend on linux (inotify or fanotify)")
+      ("session-file-monitor-latency-ms",
+         value<int>(&fileMonitorLatencyMs_)->default_value(500),
+         "time file changes are coalesced before delivery on osx")
+      ("session-stat-cache-ttl-ms",
+         value<int>(&statCacheTtlMs_)->default_value(0),
+         "time to live for cached file metadata (0 to disable caching)")
+      ("session-find-index",
+         value<bool>(&findIndex_)->default_value(false),
+         "maintain a trigram index of project files for find in files")
+      (kMonitorIntervalSeconds,
+         value<int>(&monitorIntervalSeconds_)->default_value(300),
+         "monitor interval (seconds)")
+      (kMonitorReportMetrics,
+         value<bool>(&monitorReportMetrics_)->default_value(false),
+         "report metrics to the server (for its metrics endpoint)")
+      ("session-audit-console",
+         value<bool>(&auditConsole_)->default_value(false),
+         "send console input and output to the monitor")
+      ("session-reclaim-idle-minutes",
+         value<int>(&reclaimIdleMinutes_)->default_value(30),
+         "minutes idle after which caches are released (0 to disable)")
+      (kIdlePrioritySessionOption,
+         value<int>(&idlePriority_)->default_value(0),
+         "niceness to add to our priority while idle (0 to disable)")
       ("session-preflight-script",
          value<std::string>(&preflightScript_)->default_value(""),
          "session preflight script")
@@ -172,6 +209,9 @@ core::ProgramStatus Options::read(int argc, char * const argv[])
       ("session-rprofile-on-resume-default",
           value<bool>(&rProfileOnResumeDefault_)->default_value(false),
           "default user setting for running Rprofile on resume")
+      ("session-lazy-resume",
+          value<bool>(&lazyResume_)->default_value(false),
+          "restore workspace objects on first access when resuming")
       ("session-save-action-default",
        value<std::string>(&saveActionDefault)->default_value(""),
          "default save action (yes, no, or ask)")
@@ -56,6 +56,10 @@ Error PersistentState::initialize()
    if (error)
       return error;
 
+   // changed often by the ui (the session settings below, which include
+   // the abend flag, are still written immediately)
+   settings_.setWriteBehind(boost::posix_time::seconds(2));
+
    // session settings
    scratchPath = module_context::sessionScratchPath();
    statePath = scratchPath.complete("session-persistent-state");
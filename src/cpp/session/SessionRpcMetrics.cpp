@@ -0,0 +1,196 @@
+/*
+ * SessionRpcMetrics.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionRpcMetrics.hpp>
+
+#include <map>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/Thread.hpp>
+
+#include <monitor/MonitorClient.hpp>
+
+#include <session/SessionOptions.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace rpc_metrics {
+
+namespace {
+
+const char * const kPhaseNames[PhaseCount] = { "queue", "dispatch", "serialize" };
+
+struct PhaseCounter
+{
+   PhaseCounter() : count(0), totalMicros(0), maxMicros(0) {}
+
+   void add(const PhaseCounter& other)
+   {
+      count += other.count;
+      totalMicros += other.totalMicros;
+      maxMicros = std::max(maxMicros, other.maxMicros);
+   }
+
+   boost::uint64_t count;
+   boost::uint64_t totalMicros;
+   boost::uint64_t maxMicros;
+};
+
+struct MethodCounters
+{
+   PhaseCounter phases[PhaseCount];
+};
+
+typedef std::map<std::string, MethodCounters> MethodCountersMap;
+
+struct ThreadCounters
+{
+   boost::mutex mutex;
+   MethodCountersMap methods;
+};
+
+// all thread counter tables (kept for the life of the process so that
+// counters survive the exit of the thread which recorded them)
+boost::mutex s_registryMutex;
+std::vector<boost::shared_ptr<ThreadCounters> > s_threadCounters;
+
+// the tss pointer doesn't own the table (the registry does)
+void noCleanup(ThreadCounters*)
+{
+}
+boost::thread_specific_ptr<ThreadCounters> s_pCurrentThreadCounters(noCleanup);
+
+ThreadCounters& currentThreadCounters()
+{
+   ThreadCounters* pCounters = s_pCurrentThreadCounters.get();
+   if (pCounters == NULL)
+   {
+      boost::shared_ptr<ThreadCounters> pNewCounters(new ThreadCounters());
+      LOCK_MUTEX(s_registryMutex)
+      {
+         s_threadCounters.push_back(pNewCounters);
+      }
+      END_LOCK_MUTEX
+
+      pCounters = pNewCounters.get();
+      s_pCurrentThreadCounters.reset(pCounters);
+   }
+   return *pCounters;
+}
+
+std::vector<boost::shared_ptr<ThreadCounters> > allThreadCounters()
+{
+   LOCK_MUTEX(s_registryMutex)
+   {
+      return s_threadCounters;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return std::vector<boost::shared_ptr<ThreadCounters> >();
+}
+
+json::Object phaseCounterAsJson(const PhaseCounter& counter)
+{
+   json::Object counterJson;
+   counterJson["count"] = static_cast<boost::int64_t>(counter.count);
+   counterJson["total_us"] = static_cast<boost::int64_t>(counter.totalMicros);
+   counterJson["max_us"] = static_cast<boost::int64_t>(counter.maxMicros);
+   return counterJson;
+}
+
+} // anonymous namespace
+
+void record(const std::string& method,
+            Phase phase,
+            const boost::posix_time::time_duration& elapsed)
+{
+   if (elapsed.is_negative() || phase < 0 || phase >= PhaseCount)
+      return;
+
+   boost::uint64_t micros = elapsed.total_microseconds();
+   ThreadCounters& counters = currentThreadCounters();
+   LOCK_MUTEX(counters.mutex)
+   {
+      PhaseCounter& counter = counters.methods[method].phases[phase];
+      counter.count++;
+      counter.totalMicros += micros;
+      counter.maxMicros = std::max(counter.maxMicros, micros);
+   }
+   END_LOCK_MUTEX
+
+   monitor::client().recordHistogramSample(
+                  "session",
+                  session::options().monitorIntervalSeconds(),
+                  "rpc." + method + "." + kPhaseNames[phase],
+                  micros,
+                  "us");
+}
+
+json::Object countersAsJson()
+{
+   // sum the counters across threads
+   MethodCountersMap methods;
+   BOOST_FOREACH(const boost::shared_ptr<ThreadCounters>& pCounters,
+                 allThreadCounters())
+   {
+      LOCK_MUTEX(pCounters->mutex)
+      {
+         BOOST_FOREACH(const MethodCountersMap::value_type& method,
+                       pCounters->methods)
+         {
+            MethodCounters& target = methods[method.first];
+            for (int i = 0; i < PhaseCount; i++)
+               target.phases[i].add(method.second.phases[i]);
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+   json::Object countersJson;
+   BOOST_FOREACH(const MethodCountersMap::value_type& method, methods)
+   {
+      json::Object methodJson;
+      for (int i = 0; i < PhaseCount; i++)
+         methodJson[kPhaseNames[i]] = phaseCounterAsJson(method.second.phases[i]);
+      countersJson[method.first] = methodJson;
+   }
+   return countersJson;
+}
+
+void reset()
+{
+   BOOST_FOREACH(const boost::shared_ptr<ThreadCounters>& pCounters,
+                 allThreadCounters())
+   {
+      LOCK_MUTEX(pCounters->mutex)
+      {
+         pCounters->methods.clear();
+      }
+      END_LOCK_MUTEX
+   }
+}
+
+} // namespace rpc_metrics
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,501 @@
+/*
+ * SessionSharedFileMonitor.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionSharedFileMonitor.hpp>
+
+#include <map>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileInfo.hpp>
+#include <core/Thread.hpp>
+#include <core/collection/Tree.hpp>
+
+#include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
+
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+#include <core/http/LocalStreamBlockingClient.hpp>
+
+#include <core/system/FileChangeEvent.hpp>
+
+#include <session/SessionConstants.hpp>
+#include <session/SessionOptions.hpp>
+#include <session/SessionModuleContext.hpp>
+
+using namespace rstudio::core;
+using namespace rstudio::core::system;
+
+namespace rstudio {
+namespace session {
+namespace shared_file_monitor {
+
+namespace {
+
+typedef boost::function<void()> Task;
+
+// tasks posted from monitor threads for execution on the main thread
+// (never freed, see note on ThreadsafeQueue sync objects)
+thread::ThreadsafeQueue<Task>* s_pMainThreadTasks = NULL;
+
+void executeMainThreadTasks(bool)
+{
+   // take everything posted so far under a single lock
+   std::vector<Task> tasks;
+   if (!s_pMainThreadTasks->dequeAll(&tasks))
+      return;
+
+   for (std::size_t i = 0; i < tasks.size(); i++)
+   {
+      try
+      {
+         tasks[i]();
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+}
+
+void postToMainThread(const Task& task)
+{
+   s_pMainThreadTasks->enque(task);
+}
+
+Error sendRequest(const std::string& uri,
+                  const json::Object& body,
+                  json::Object* pResult)
+{
+   http::Request request;
+   request.setMethod("POST");
+   request.setUri(uri);
+   request.setHeader("Accept", "*/*");
+   request.setHeader("Connection", "close");
+   request.setBody(json::write(body));
+
+   http::Response response;
+   Error error = http::sendRequest(FilePath(kSharedFileMonitorSocketPath),
+                                   request,
+                                   &response);
+   if (error)
+      return error;
+
+   if (response.statusCode() != http::status::Ok)
+   {
+      Error error = systemError(boost::system::errc::protocol_error,
+                                ERROR_LOCATION);
+      error.addProperty("uri", uri);
+      error.addProperty("status", response.statusCode());
+      error.addProperty("message", response.body());
+      return error;
+   }
+
+   json::Value value;
+   if (!json::parse(response.body(), &value) ||
+       !json::isType<json::Object>(value))
+   {
+      Error error = systemError(boost::system::errc::bad_message,
+                                ERROR_LOCATION);
+      error.addProperty("uri", uri);
+      return error;
+   }
+
+   *pResult = value.get_obj();
+   return Success();
+}
+
+// files are sent as [path, isDirectory, size, lastWriteTime] (events
+// have the event type prepended)
+bool fileInfoFromJson(const json::Array& fileJson,
+                      std::size_t offset,
+                      FileInfo* pFileInfo)
+{
+   if (fileJson.size() < offset + 4 ||
+       !json::isType<std::string>(fileJson[offset]) ||
+       !json::isType<bool>(fileJson[offset + 1]) ||
+       !json::isType<int>(fileJson[offset + 2]) ||
+       !json::isType<int>(fileJson[offset + 3]))
+   {
+      return false;
+   }
+
+   *pFileInfo = FileInfo(fileJson[offset].get_str(),
+                         fileJson[offset + 1].get_bool(),
+                         fileJson[offset + 2].get_int64(),
+                         fileJson[offset + 3].get_int64());
+   return true;
+}
+
+class SharedMonitor
+   : boost::noncopyable,
+     public boost::enable_shared_from_this<SharedMonitor>
+{
+public:
+   SharedMonitor(const FilePath& filePath,
+                 const boost::function<bool(const FileInfo&)>& filter,
+                 const file_monitor::Callbacks& callbacks)
+      : filePath_(filePath),
+        filter_(filter),
+        callbacks_(callbacks),
+        handle_(this),
+        stopped_(false)
+   {
+   }
+
+   const file_monitor::Handle& handle() const { return handle_; }
+
+   void start()
+   {
+      thread::safeLaunchThread(
+                  boost::bind(&SharedMonitor::run, shared_from_this()));
+   }
+
+   // called on the main thread
+   void stop()
+   {
+      std::string id;
+      LOCK_MUTEX(mutex_)
+      {
+         stopped_ = true;
+         id = id_;
+      }
+      END_LOCK_MUTEX
+
+      // unsubscribing also completes the monitor thread's outstanding
+      // events request (so it will notice that we've been stopped)
+      if (!id.empty())
+      {
+         json::Object requestJson, resultJson;
+         requestJson["id"] = id;
+         Error error = sendRequest("/unsubscribe", requestJson, &resultJson);
+         if (error)
+            LOG_ERROR(error);
+      }
+
+      if (callbacks_.onUnregistered)
+         callbacks_.onUnregistered(handle_);
+   }
+
+private:
+   bool stopped()
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         return stopped_;
+      }
+      END_LOCK_MUTEX
+
+      return true;
+   }
+
+   bool passesFilter(const FileInfo& fileInfo) const
+   {
+      if (!filter_)
+         return true;
+
+      if (!filter_(fileInfo))
+         return false;
+
+      // children of filtered directories are also excluded
+      FilePath parentPath = FilePath(fileInfo.absolutePath()).parent();
+      while (parentPath.isWithin(filePath_) && parentPath != filePath_)
+      {
+         if (!filter_(FileInfo(parentPath.absolutePath(), true)))
+            return false;
+         parentPath = parentPath.parent();
+      }
+
+      return true;
+   }
+
+   // monitor thread
+   void run()
+   {
+      try
+      {
+         // subscribe (the response includes the initial listing)
+         json::Object requestJson, resultJson;
+         requestJson["path"] = filePath_.absolutePath();
+         Error error = sendRequest("/subscribe", requestJson, &resultJson);
+         if (error)
+         {
+            postToMainThread(boost::bind(&SharedMonitor::fallback,
+                                         shared_from_this(),
+                                         error));
+            return;
+         }
+
+         std::string id;
+         json::Array filesJson;
+         error = json::readObject(resultJson,
+                                  "id", &id,
+                                  "files", &filesJson);
+         if (error)
+         {
+            postToMainThread(boost::bind(&SharedMonitor::fallback,
+                                         shared_from_this(),
+                                         error));
+            return;
+         }
+
+         LOCK_MUTEX(mutex_)
+         {
+            id_ = id;
+         }
+         END_LOCK_MUTEX
+
+         // we may have been stopped while subscribing
+         if (stopped())
+         {
+            json::Object unsubscribeJson;
+            unsubscribeJson["id"] = id;
+            error = sendRequest("/unsubscribe", unsubscribeJson, &resultJson);
+            if (error)
+               LOG_ERROR(error);
+            return;
+         }
+
+         postToMainThread(boost::bind(&SharedMonitor::onRegistered,
+                                      shared_from_this(),
+                                      filesJson));
+
+         // poll for events until we are stopped or monitoring fails
+         requestJson.clear();
+         requestJson["id"] = id;
+         while (!stopped())
+         {
+            resultJson.clear();
+            error = sendRequest("/events", requestJson, &resultJson);
+            if (!error && resultJson.find("error") != resultJson.end())
+            {
+               std::string message;
+               json::readObject(resultJson, "error", &message);
+               error = systemError(boost::system::errc::io_error,
+                                   message,
+                                   ERROR_LOCATION);
+            }
+
+            if (error)
+            {
+               if (!stopped())
+               {
+                  postToMainThread(boost::bind(&SharedMonitor::onError,
+                                               shared_from_this(),
+                                               error));
+               }
+               return;
+            }
+
+            json::Array eventsJson;
+            error = json::readObject(resultJson, "events", &eventsJson);
+            if (!error && !eventsJson.empty())
+            {
+               postToMainThread(boost::bind(&SharedMonitor::onEvents,
+                                            shared_from_this(),
+                                            eventsJson));
+            }
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   // main thread handlers (posted from the monitor thread)
+
+   void fallback(const Error& error);
+
+   void onRegistered(const json::Array& filesJson)
+   {
+      if (stopped())
+         return;
+
+      tree<FileInfo> files;
+      tree<FileInfo>::iterator rootIt = files.set_head(FileInfo(filePath_));
+
+      // the listing is sorted by path so directories precede their
+      // children (children of filtered directories are skipped since
+      // their parent won't be found)
+      std::map<std::string, tree<FileInfo>::iterator> dirs;
+      dirs[filePath_.absolutePath()] = rootIt;
+      for (json::Array::const_iterator it = filesJson.begin();
+           it != filesJson.end();
+           ++it)
+      {
+         FileInfo fileInfo;
+         if (!json::isType<json::Array>(*it) ||
+             !fileInfoFromJson(it->get_array(), 0, &fileInfo))
+         {
+            continue;
+         }
+
+         if (filter_ && !filter_(fileInfo))
+            continue;
+
+         std::string path = fileInfo.absolutePath();
+         std::map<std::string, tree<FileInfo>::iterator>::iterator parentIt =
+                        dirs.find(FilePath(path).parent().absolutePath());
+         if (parentIt == dirs.end())
+            continue;
+
+         tree<FileInfo>::iterator fileIt =
+                              files.append_child(parentIt->second, fileInfo);
+         if (fileInfo.isDirectory())
+            dirs[path] = fileIt;
+      }
+
+      if (callbacks_.onRegistered)
+         callbacks_.onRegistered(handle_, files);
+   }
+
+   void onEvents(const json::Array& eventsJson)
+   {
+      if (stopped())
+         return;
+
+      std::vector<FileChangeEvent> events;
+      for (json::Array::const_iterator it = eventsJson.begin();
+           it != eventsJson.end();
+           ++it)
+      {
+         FileInfo fileInfo;
+         if (!json::isType<json::Array>(*it))
+            continue;
+         const json::Array& eventJson = it->get_array();
+         if (eventJson.empty() ||
+             !json::isType<int>(eventJson[0]) ||
+             !fileInfoFromJson(eventJson, 1, &fileInfo))
+         {
+            continue;
+         }
+
+         if (!passesFilter(fileInfo))
+            continue;
+
+         FileChangeEvent::Type type =
+               static_cast<FileChangeEvent::Type>(eventJson[0].get_int());
+         events.push_back(FileChangeEvent(type, fileInfo));
+      }
+
+      if (!events.empty() && callbacks_.onFilesChanged)
+         callbacks_.onFilesChanged(events);
+   }
+
+   void onError(const Error& error);
+
+private:
+   FilePath filePath_;
+   boost::function<bool(const FileInfo&)> filter_;
+   file_monitor::Callbacks callbacks_;
+   file_monitor::Handle handle_;
+
+   boost::mutex mutex_;
+   bool stopped_;
+   std::string id_;
+};
+
+// active shared monitors (main thread only)
+std::map<file_monitor::Handle, boost::shared_ptr<SharedMonitor> > s_monitors;
+
+boost::shared_ptr<SharedMonitor> removeMonitor(file_monitor::Handle handle)
+{
+   boost::shared_ptr<SharedMonitor> pMonitor;
+   std::map<file_monitor::Handle, boost::shared_ptr<SharedMonitor> >::iterator
+                                             it = s_monitors.find(handle);
+   if (it != s_monitors.end())
+   {
+      pMonitor = it->second;
+      s_monitors.erase(it);
+   }
+   return pMonitor;
+}
+
+void SharedMonitor::fallback(const Error& error)
+{
+   if (stopped())
+      return;
+
+   // this is expected if the server refused the subscription (e.g. because
+   // it can't read the directory) so just note it
+   LOG_WARNING_MESSAGE("Using local file monitor for " +
+                       filePath_.absolutePath() + " (" +
+                       error.summary() + ")");
+
+   removeMonitor(handle_);
+   file_monitor::registerMonitor(filePath_, true, filter_, callbacks_);
+}
+
+void SharedMonitor::onError(const Error& error)
+{
+   if (stopped())
+      return;
+
+   LOCK_MUTEX(mutex_)
+   {
+      stopped_ = true;
+   }
+   END_LOCK_MUTEX
+
+   // as with local monitors, monitoring errors result in unregistration
+   boost::shared_ptr<SharedMonitor> pThis = removeMonitor(handle_);
+   if (callbacks_.onMonitoringError)
+      callbacks_.onMonitoringError(error);
+   if (callbacks_.onUnregistered)
+      callbacks_.onUnregistered(handle_);
+}
+
+} // anonymous namespace
+
+void registerMonitor(const FilePath& filePath,
+                     bool recursive,
+                     const boost::function<bool(const FileInfo&)>& filter,
+                     const file_monitor::Callbacks& callbacks)
+{
+   // the shared monitor only supports recursive monitoring
+   if (!session::options().sharedFileMonitor() || !recursive)
+   {
+      file_monitor::registerMonitor(filePath, recursive, filter, callbacks);
+      return;
+   }
+
+   if (s_pMainThreadTasks == NULL)
+   {
+      s_pMainThreadTasks = new thread::ThreadsafeQueue<Task>();
+      module_context::events().onBackgroundProcessing.connect(
+                                                      executeMainThreadTasks);
+   }
+
+   boost::shared_ptr<SharedMonitor> pMonitor(
+                           new SharedMonitor(filePath, filter, callbacks));
+   s_monitors[pMonitor->handle()] = pMonitor;
+   pMonitor->start();
+}
+
+void unregisterMonitor(file_monitor::Handle handle)
+{
+   boost::shared_ptr<SharedMonitor> pMonitor = removeMonitor(handle);
+   if (pMonitor)
+      pMonitor->stop();
+   else
+      file_monitor::unregisterMonitor(handle);
+}
+
+} // namespace shared_file_monitor
+} // namespace session
+} // namespace rstudio
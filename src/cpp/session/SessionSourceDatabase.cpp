@@ -15,9 +15,16 @@
 
 #include <session/SessionSourceDatabase.hpp>
 
+#include <map>
+#include <deque>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -32,10 +39,13 @@
 #include <core/FileSerializer.hpp>
 #include <core/FileUtils.hpp>
 #include <core/DateTime.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
 
 #include <core/system/System.hpp>
 
 #include <core/http/Util.hpp>
+#include <core/json/JsonRpc.hpp>
 
 #include <r/RUtil.hpp>
 
@@ -207,6 +217,30 @@ std::string pathFromProjectPath(json::Value projPathJson)
       return std::string();
 }
 
+// identifies the state of a file on disk (so that we can tell whether it
+// has been changed since it was last read); empty if it can't be read
+std::string fileState(const FilePath& filePath)
+{
+#ifndef _WIN32
+   struct stat st;
+   if (::stat(filePath.absolutePath().c_str(), &st) == -1)
+      return std::string();
+
+   std::ostringstream ss;
+   ss << st.st_ino << ":" << st.st_size << ":" << st.st_mtime;
+#ifdef __linux__
+   ss << "." << st.st_mtim.tv_nsec;
+#endif
+   return ss.str();
+#else
+   if (!filePath.exists())
+      return std::string();
+
+   return safe_convert::numberToString(filePath.size()) + ":" +
+          safe_convert::numberToString(filePath.lastWriteTime());
+#endif
+}
+
 }  // anonymous namespace
 
 SourceDocument::SourceDocument(const std::string& type)
@@ -221,6 +255,7 @@ SourceDocument::SourceDocument(const std::string& type)
    sourceOnSave_ = false;
    relativeOrder_ = 0;
    lastContentUpdate_ = date_time::millisecondsSinceEpoch();
+   diskLength_ = 0;
 }
    
 
@@ -254,6 +289,15 @@ void SourceDocument::setContents(const std::string& contents)
    lastContentUpdate_ = date_time::millisecondsSinceEpoch();
 }
 
+// set contents from string (without copying it; pContents is left with
+// the previous contents)
+void SourceDocument::swapContents(std::string* pContents)
+{
+   contents_.swap(*pContents);
+   hash_ = hash::crc32Hash(contents_);
+   lastContentUpdate_ = date_time::millisecondsSinceEpoch();
+}
+
 // set contents from file
 Error SourceDocument::setPathAndContents(const std::string& path,
                                          bool allowSubstChars)
@@ -261,6 +305,10 @@ Error SourceDocument::setPathAndContents(const std::string& path,
    // resolve aliased path
    FilePath docPath = module_context::resolveAliasedPath(path);
 
+   // note the file's state before reading it (so a change made while
+   // reading is picked up by the next check)
+   std::string state = fileState(docPath);
+
    std::string contents;
    Error error = module_context::readAndDecodeFile(docPath,
                                                    encoding(),
@@ -274,6 +322,11 @@ Error SourceDocument::setPathAndContents(const std::string& path,
    setContents(contents);
    lastKnownWriteTime_ = docPath.lastWriteTime();
 
+   // the contents are now those on disk
+   diskState_ = state;
+   diskHash_ = hash_;
+   diskLength_ = contents_.length();
+
    // rewind the last content update to the file's write time
    lastContentUpdate_ = lastKnownWriteTime_;
 
@@ -301,17 +354,26 @@ Error SourceDocument::updateDirty()
       // and the UI logic is a little complicated.
 
       FilePath docPath = module_context::resolveAliasedPath(path());
-      if (docPath.exists() && docPath.size() <= (1024*1024))
+      if (docPath.exists())
       {
-         std::string contents;
-         Error error = module_context::readAndDecodeFile(docPath,
-                                                         encoding(),
-                                                         true,
-                                                         &contents);
-         if (error)
-            return error;
+         // only re-read the file if it has changed since we last did
+         std::string state = fileState(docPath);
+         if (state.empty() || state != diskState_)
+         {
+            std::string contents;
+            Error error = module_context::readAndDecodeFile(docPath,
+                                                            encoding(),
+                                                            true,
+                                                            &contents);
+            if (error)
+               return error;
+
+            diskState_ = state;
+            diskHash_ = hash::crc32Hash(contents);
+            diskLength_ = contents.length();
+         }
 
-         if (contents_.length() == contents.length() && hash_ == hash::crc32Hash(contents))
+         if (contents_.length() == diskLength_ && hash_ == diskHash_)
             dirty_ = false;
       }
    }
@@ -508,6 +570,364 @@ namespace {
 
 FilePath s_sourceDBPath;
 
+// documents are written in full (the "base") and then each subsequent put
+// appends the change to the document to a journal alongside it, so that
+// autosaving a small edit to a large document doesn't rewrite the whole
+// document. each journal record names the base it applies to, so records
+// left behind by an interrupted compaction are ignored on recovery (as is
+// a partially written final record)
+const char * const kJournalExtension = ".journal";
+const char * const kJournalBase = "journal_base";
+
+// the journal is compacted into the base once it is larger than this
+// (or than the base, whichever is greater)
+const boost::uintmax_t kJournalCompactionSize = 64 * 1024;
+
+struct JournalState
+{
+   JournalState() : baseSize(0), journalSize(0) {}
+   std::string base;
+   std::string contents;
+   boost::uintmax_t baseSize;
+   boost::uintmax_t journalSize;
+};
+
+// journal state of the documents we have read or written (documents which
+// aren't listed here are written in full on their next put)
+std::map<std::string, JournalState> s_journals;
+
+FilePath journalPath(const FilePath& docPath)
+{
+   return docPath.parent().complete(docPath.filename() + kJournalExtension);
+}
+
+std::string documentContents(const json::Object& docJson)
+{
+   json::Object::const_iterator it = docJson.find("contents");
+   if (it != docJson.end() && it->second.type() == json::StringType)
+      return it->second.get_str();
+   else
+      return std::string();
+}
+
+// a record of the change from the journaled contents to the document's
+// contents (as a single replaced range) along with the document's other
+// fields
+std::string journalRecord(const json::Object& docJson,
+                          const JournalState& state)
+{
+   const std::string& previous = state.contents;
+   std::string current = documentContents(docJson);
+
+   std::size_t length = std::min(previous.size(), current.size());
+   std::size_t prefix = 0;
+   while (prefix < length && previous[prefix] == current[prefix])
+      ++prefix;
+   std::size_t suffix = 0;
+   while (suffix < length - prefix &&
+          previous[previous.size() - suffix - 1] ==
+          current[current.size() - suffix - 1])
+   {
+      ++suffix;
+   }
+
+   json::Object fieldsJson = docJson;
+   fieldsJson.erase("contents");
+
+   json::Object recordJson;
+   recordJson["base"] = state.base;
+   recordJson["offset"] = static_cast<int>(prefix);
+   recordJson["remove"] = static_cast<int>(previous.size() - prefix - suffix);
+   recordJson["insert"] = current.substr(prefix,
+                                         current.size() - prefix - suffix);
+   recordJson["doc"] = fieldsJson;
+   return json::write(recordJson) + "\n";
+}
+
+// apply the journal's records for the given base to the document json,
+// returning the number of bytes of the journal which were applied
+boost::uintmax_t replayJournal(const FilePath& journalFilePath,
+                               const std::string& base,
+                               json::Object* pDocJson)
+{
+   std::string journal;
+   Error error = readStringFromFile(journalFilePath, &journal);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return 0;
+   }
+
+   json::Object::iterator contentsIt = pDocJson->find("contents");
+   if (contentsIt == pDocJson->end() ||
+       contentsIt->second.type() != json::StringType)
+   {
+      return 0;
+   }
+   std::string contents = contentsIt->second.get_str();
+
+   // apply complete records until we find one which doesn't belong
+   std::size_t pos = 0;
+   while (pos < journal.size())
+   {
+      std::size_t end = journal.find('\n', pos);
+      if (end == std::string::npos)
+         break;
+
+      json::Value recordValue;
+      if (!json::parse(journal.substr(pos, end - pos), &recordValue) ||
+          recordValue.type() != json::ObjectType)
+      {
+         break;
+      }
+
+      std::string recordBase, insert;
+      int offset, remove;
+      json::Object docJson;
+      error = json::readObject(recordValue.get_obj(),
+                               "base", &recordBase,
+                               "offset", &offset,
+                               "remove", &remove,
+                               "insert", &insert);
+      if (!error)
+         error = json::readObject(recordValue.get_obj(), "doc", &docJson);
+      if (error ||
+          recordBase != base ||
+          offset < 0 || remove < 0 ||
+          static_cast<std::size_t>(offset) + remove > contents.size())
+      {
+         break;
+      }
+
+      contents.replace(offset, remove, insert);
+      for (json::Object::const_iterator it = docJson.begin();
+           it != docJson.end();
+           ++it)
+      {
+         (*pDocJson)[it->first] = it->second;
+      }
+
+      pos = end + 1;
+   }
+
+   (*pDocJson)["contents"] = contents;
+   return pos;
+}
+
+// writes are performed on a background thread (so that autosaving large
+// documents doesn't hold up the main thread). put and remove queue the
+// latest state of the document, superseding any state already queued for
+// it, and get and list consult the queue before the database
+struct PendingWrite
+{
+   PendingWrite() : remove(false) {}
+   bool remove;
+   json::Object docJson;
+};
+typedef std::map<std::string, boost::shared_ptr<PendingWrite> > PendingWrites;
+
+// synchronization objects (never freed, see note on ThreadsafeQueue). these
+// also protect the journal state, which the writer thread updates
+boost::mutex* s_pMutex = new boost::mutex();
+boost::condition* s_pWritesChanged = new boost::condition();
+
+// the queue holds the id of each document with a pending write once (a
+// document remains pending until the write of its latest state completes)
+PendingWrites s_pendingWrites;
+std::deque<std::string> s_writeQueue;
+std::string s_writingId;
+
+boost::shared_ptr<PendingWrite> pendingWrite(const std::string& id)
+{
+   LOCK_MUTEX(*s_pMutex)
+   {
+      PendingWrites::const_iterator it = s_pendingWrites.find(id);
+      if (it != s_pendingWrites.end())
+         return it->second;
+   }
+   END_LOCK_MUTEX
+
+   return boost::shared_ptr<PendingWrite>();
+}
+
+void queueWrite(const std::string& id, boost::shared_ptr<PendingWrite> pWrite)
+{
+   LOCK_MUTEX(*s_pMutex)
+   {
+      s_pendingWrites[id] = pWrite;
+      if (std::find(s_writeQueue.begin(), s_writeQueue.end(), id) ==
+          s_writeQueue.end())
+      {
+         s_writeQueue.push_back(id);
+      }
+   }
+   END_LOCK_MUTEX
+
+   s_pWritesChanged->notify_all();
+}
+
+// wait for all pending writes to complete
+void flushWrites()
+{
+   try
+   {
+      boost::unique_lock<boost::mutex> lock(*s_pMutex);
+      while (!s_writeQueue.empty() || !s_writingId.empty())
+         s_pWritesChanged->wait(lock);
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+void setJournalState(const std::string& id, const JournalState& state)
+{
+   LOCK_MUTEX(*s_pMutex)
+   {
+      s_journals[id] = state;
+   }
+   END_LOCK_MUTEX
+}
+
+void eraseJournalState(const std::string& id)
+{
+   LOCK_MUTEX(*s_pMutex)
+   {
+      s_journals.erase(id);
+   }
+   END_LOCK_MUTEX
+}
+
+// write the document in full, with a new base id (discarding the journal)
+Error compactDocument(const json::Object& docJson,
+                      const FilePath& filePath,
+                      JournalState* pState)
+{
+   JournalState state;
+   state.base = core::system::generateUuid(false);
+
+   json::Object jsonDoc = docJson;
+   jsonDoc[kJournalBase] = state.base;
+   std::ostringstream ostr;
+   json::writeFormatted(jsonDoc, ostr);
+   std::string docContents = ostr.str();
+
+   Error error = writeStringToFile(filePath, docContents);
+   if (error)
+      return error;
+
+   // records in the journal are for the previous base so removing it
+   // is only for tidiness
+   error = journalPath(filePath).removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+
+   state.contents = documentContents(docJson);
+   state.baseSize = docContents.size();
+   *pState = state;
+   return Success();
+}
+
+// called on the writer thread
+Error writeDocument(const std::string& id, const json::Object& docJson)
+{
+   FilePath filePath = s_sourceDBPath.complete(id);
+
+   // only the writer thread changes the journal state of a pending document
+   // so we can work with a copy of it
+   bool journaled = false;
+   JournalState state;
+   LOCK_MUTEX(*s_pMutex)
+   {
+      std::map<std::string, JournalState>::const_iterator it =
+                                                      s_journals.find(id);
+      if (it != s_journals.end())
+      {
+         state = it->second;
+         journaled = true;
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (journaled && filePath.exists() &&
+       state.journalSize <= std::max(kJournalCompactionSize, state.baseSize))
+   {
+      std::string record = journalRecord(docJson, state);
+      Error error = appendToFile(journalPath(filePath), record);
+      if (!error)
+      {
+         state.contents = documentContents(docJson);
+         state.journalSize += record.size();
+         setJournalState(id, state);
+         return Success();
+      }
+
+      // fall back to writing the document in full
+      LOG_ERROR(error);
+   }
+
+   Error error = compactDocument(docJson, filePath, &state);
+   if (error)
+   {
+      eraseJournalState(id);
+      return error;
+   }
+
+   setJournalState(id, state);
+   return Success();
+}
+
+// called on the writer thread
+Error removeDocument(const std::string& id)
+{
+   eraseJournalState(id);
+   FilePath filePath = s_sourceDBPath.complete(id);
+   Error error = journalPath(filePath).removeIfExists();
+   if (error)
+      LOG_ERROR(error);
+   return filePath.removeIfExists();
+}
+
+void writerThreadMain()
+{
+   while (true)
+   {
+      // wait for the next document to write
+      std::string id;
+      boost::shared_ptr<PendingWrite> pWrite;
+      {
+         boost::unique_lock<boost::mutex> lock(*s_pMutex);
+         while (s_writeQueue.empty())
+            s_pWritesChanged->wait(lock);
+
+         id = s_writeQueue.front();
+         s_writeQueue.pop_front();
+         pWrite = s_pendingWrites[id];
+         s_writingId = id;
+      }
+
+      try
+      {
+         Error error = pWrite->remove ? removeDocument(id) :
+                                        writeDocument(id, pWrite->docJson);
+         if (error)
+            LOG_ERROR(error);
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+
+      // the document is no longer pending (unless it was queued again while
+      // we were writing it)
+      LOCK_MUTEX(*s_pMutex)
+      {
+         PendingWrites::iterator it = s_pendingWrites.find(id);
+         if (it != s_pendingWrites.end() && it->second == pWrite)
+            s_pendingWrites.erase(it);
+         s_writingId.clear();
+      }
+      END_LOCK_MUTEX
+
+      s_pWritesChanged->notify_all();
+   }
+}
+
 } // anonymous namespace
 
 FilePath path()
@@ -517,6 +937,20 @@ FilePath path()
    
 Error get(const std::string& id, boost::shared_ptr<SourceDocument> pDoc)
 {
+   // use the queued state of the document if it hasn't been written yet
+   boost::shared_ptr<PendingWrite> pWrite = pendingWrite(id);
+   if (pWrite)
+   {
+      if (pWrite->remove)
+      {
+         return systemError(boost::system::errc::no_such_file_or_directory,
+                            ERROR_LOCATION);
+      }
+
+      json::Object jsonDoc = pWrite->docJson;
+      return pDoc->readFromJson(&jsonDoc);
+   }
+
    FilePath filePath = source_database::path().complete(id);
    if (filePath.exists())
    {
@@ -535,9 +969,51 @@ Error get(const std::string& id, boost::shared_ptr<SourceDocument> pDoc)
                             ERROR_LOCATION);
       }
       
-      // initialize doc from json
+      // apply any changes recorded in the journal
       json::Object jsonDoc = value.get_obj();
-      return pDoc->readFromJson(&jsonDoc);
+      std::string base;
+      json::Object::const_iterator baseIt = jsonDoc.find(kJournalBase);
+      if (baseIt != jsonDoc.end() && baseIt->second.type() == json::StringType)
+         base = baseIt->second.get_str();
+      FilePath journalFilePath = journalPath(filePath);
+      boost::uintmax_t journalSize = 0;
+      bool journalIntact = true;
+      if (journalFilePath.exists())
+      {
+         journalSize = replayJournal(journalFilePath, base, &jsonDoc);
+         journalIntact = !base.empty() && (journalSize == journalFilePath.size());
+      }
+
+      // initialize doc from json
+      error = pDoc->readFromJson(&jsonDoc);
+      if (error)
+         return error;
+
+      // remember the journal state (unless it has records we didn't apply,
+      // in which case the next put will rewrite the document in full)
+      // (we don't touch the state if the document was queued meanwhile, as
+      // the writer thread owns it from then on)
+      LOCK_MUTEX(*s_pMutex)
+      {
+         if (s_pendingWrites.find(id) == s_pendingWrites.end())
+         {
+            if (!base.empty() && journalIntact)
+            {
+               JournalState& state = s_journals[id];
+               state.base = base;
+               state.contents = pDoc->contents();
+               state.baseSize = filePath.size();
+               state.journalSize = journalSize;
+            }
+            else
+            {
+               s_journals.erase(id);
+            }
+         }
+      }
+      END_LOCK_MUTEX
+
+      return Success();
    }
    else
    {
@@ -559,6 +1035,8 @@ bool isSourceDocument(const FilePath& filePath)
       return false;
    else if (filePath.filename() == "lock_file")
       return false;
+   else if (filePath.extension() == kJournalExtension)
+      return false;
    else
       return true;
 }
@@ -581,7 +1059,7 @@ bool hasNullByteSequence(const std::string& contents)
    return boost::algorithm::contains(contents, nullBytes);
 }
 
-bool isSafeSourceDocument(const FilePath& docDbPath,
+bool isSafeSourceDocument(boost::uintmax_t docSize,
                           boost::shared_ptr<SourceDocument> pDoc)
 {
    // get a filepath and use it for filtering if we can
@@ -597,7 +1075,7 @@ bool isSafeSourceDocument(const FilePath& docDbPath,
    }
 
    // get the size of the file in KB
-   uintmax_t docSizeKb = docDbPath.size() / 1024;
+   uintmax_t docSizeKb = docSize / 1024;
    std::string kbStr = safe_convert::numberToString(docSizeKb);
 
    // if it's larger than 5MB then always drop it (that's the limit
@@ -633,6 +1111,14 @@ bool isSafeSourceDocument(const FilePath& docDbPath,
 
 Error list(std::vector<boost::shared_ptr<SourceDocument> >* pDocs)
 {
+   // documents with pending writes are listed from the queue
+   PendingWrites pendingWrites;
+   LOCK_MUTEX(*s_pMutex)
+   {
+      pendingWrites = s_pendingWrites;
+   }
+   END_LOCK_MUTEX
+
    std::vector<FilePath> files ;
    Error error = source_database::path().children(&files);
    if (error)
@@ -640,7 +1126,8 @@ Error list(std::vector<boost::shared_ptr<SourceDocument> >* pDocs)
    
    BOOST_FOREACH( FilePath& filePath, files )
    {
-      if (isSourceDocument(filePath))
+      if (isSourceDocument(filePath) &&
+          pendingWrites.find(filePath.filename()) == pendingWrites.end())
       {
          // get the source doc
          boost::shared_ptr<SourceDocument> pDoc(new SourceDocument()) ;
@@ -648,29 +1135,49 @@ Error list(std::vector<boost::shared_ptr<SourceDocument> >* pDocs)
          if (!error)
          {
             // safety filter
-            if (isSafeSourceDocument(filePath, pDoc))
+            if (isSafeSourceDocument(filePath.size(), pDoc))
                pDocs->push_back(pDoc);
          }
          else
             LOG_ERROR(error);
       }
    }
+
+   for (PendingWrites::const_iterator it = pendingWrites.begin();
+        it != pendingWrites.end();
+        ++it)
+   {
+      if (it->second->remove)
+         continue;
+
+      json::Object docJson = it->second->docJson;
+      boost::shared_ptr<SourceDocument> pDoc(new SourceDocument());
+      Error error = pDoc->readFromJson(&docJson);
+      if (!error)
+      {
+         // safety filter
+         if (isSafeSourceDocument(pDoc->contents().size(), pDoc))
+            pDocs->push_back(pDoc);
+      }
+      else
+         LOG_ERROR(error);
+   }
    
    return Success();
 }
    
 Error put(boost::shared_ptr<SourceDocument> pDoc)
 {   
-   // write to file
-   FilePath filePath = source_database::path().complete(pDoc->id());
-   Error error = pDoc->writeToFile(filePath);
-   if (error)
-      return error ;
+   // queue the write (errors writing the document are logged by the
+   // writer thread)
+   boost::shared_ptr<PendingWrite> pWrite(new PendingWrite());
+   pDoc->writeToJson(&pWrite->docJson);
+   queueWrite(pDoc->id(), pWrite);
 
    // write properties to durable storage (if there is a path)
    if (!pDoc->path().empty())
    {
-      error = putProperties(pDoc->path(), pDoc->properties());
+      Error error = putProperties(pDoc->path(), pDoc->properties());
       if (error)
          LOG_ERROR(error);
    }
@@ -680,11 +1187,21 @@ Error put(boost::shared_ptr<SourceDocument> pDoc)
    
 Error remove(const std::string& id)
 {
-   return source_database::path().complete(id).removeIfExists();
+   boost::shared_ptr<PendingWrite> pWrite(new PendingWrite());
+   pWrite->remove = true;
+   queueWrite(id, pWrite);
+   return Success();
 }
    
 Error removeAll()
 {
+   flushWrites();
+   LOCK_MUTEX(*s_pMutex)
+   {
+      s_journals.clear();
+   }
+   END_LOCK_MUTEX
+
    std::vector<FilePath> files ;
    Error error = source_database::path().children(&files);
    if (error)
@@ -702,8 +1219,19 @@ Error removeAll()
 
 namespace {
 
+void onSuspend(const r::session::RSuspendOptions&, Settings*)
+{
+   flushWrites();
+}
+
+void onResume(const Settings&)
+{
+}
+
 void onQuit()
 {
+   flushWrites();
+
    Error error = supervisor::saveMostRecentDocuments();
    if (error)
       LOG_ERROR(error);
@@ -711,6 +1239,8 @@ void onQuit()
 
 void onShutdown(bool)
 {
+   flushWrites();
+
    Error error = supervisor::detachFromSourceDatabase();
    if (error)
       LOG_ERROR(error);
@@ -726,8 +1256,6 @@ Events& events()
 
 Error initialize()
 {
-   
-   
    // provision a source database directory
    Error error = supervisor::attachToSourceDatabase(&s_sourceDBPath);
    if (error)
@@ -737,6 +1265,13 @@ Error initialize()
    module_context::events().onQuit.connect(onQuit);
    module_context::events().onShutdown.connect(onShutdown);
 
+   // make sure pending writes complete before we suspend
+   module_context::addSuspendHandler(
+                     module_context::SuspendHandler(onSuspend, onResume));
+
+   // start the writer thread
+   core::thread::safeLaunchThread(writerThreadMain);
+
    return Success();
 }
 
@@ -212,6 +212,9 @@ Error UserSettings::initialize()
    if (error)
       return error;
 
+   // coalesce the frequent writes made as ui state changes
+   settings_.setWriteBehind(boost::posix_time::seconds(2));
+
    // register routines for reading/writing UI prefs from R code
    R_CallMethodDef readUiPrefMethodDef ;
    readUiPrefMethodDef.name = "rs_readUiPref";
@@ -242,6 +245,11 @@ void UserSettings::onSettingsFileChanged(
       return;
    }
 
+   // our own unwritten changes are newer (writing them will trigger
+   // another change event)
+   if (settings_.writePending())
+      return;
+
    // re-read the settings from disk
    Error error = settings_.initialize(settingsFilePath_);
    if (error)
@@ -308,10 +316,10 @@ void UserSettings::setAutoCreatedProfile(bool autoCreated)
 
 core::json::Object UserSettings::uiPrefs() const
 {
-   std::string value = settings_.get(kUiPrefs, "{}");
-   json::Value jsonValue;
-   bool success = core::json::parse(value, &jsonValue);
-   if (success)
+   // parsed once then cached by the settings (this is read on each
+   // rs_readUiPref and client init)
+   json::Value jsonValue = settings_.getJson(kUiPrefs);
+   if (jsonValue.type() == json::ObjectType)
       return jsonValue.get_obj();
    else
       return json::Object();
@@ -319,9 +327,7 @@ core::json::Object UserSettings::uiPrefs() const
 
 void UserSettings::setUiPrefs(const core::json::Object& prefsObject)
 {
-   std::ostringstream output;
-   json::writeFormatted(prefsObject, output);
-   settings_.set(kUiPrefs, output.str());
+   settings_.setJson(kUiPrefs, prefsObject);
 
    updatePrefsCache(prefsObject);
 }
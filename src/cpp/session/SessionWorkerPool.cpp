@@ -0,0 +1,175 @@
+/*
+ * SessionWorkerPool.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <session/SessionWorkerPool.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+#include <core/Thread.hpp>
+#include <core/ThreadPool.hpp>
+
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+
+#include <session/SessionHttpConnectionListener.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace worker_pool {
+
+namespace {
+
+typedef boost::function<void()> Task;
+
+// pool (never freed so tasks can't outlive it during shutdown)
+thread::ThreadPool* s_pPool = NULL;
+
+// worker-safe methods
+thread::ThreadsafeMap<std::string, json::JsonRpcFunction> s_methods;
+
+// worker-safe uri handlers (by path)
+thread::ThreadsafeMap<std::string, UriHandlerFunction> s_uriHandlers;
+
+// current client identity
+thread::ThreadsafeValue<std::string> s_clientId;
+thread::ThreadsafeValue<std::string> s_clientVersion;
+
+void executeRequest(const json::JsonRpcFunction& function,
+                    const json::JsonRpcRequest& request,
+                    boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   json::JsonRpcResponse response;
+   Error error = function(request, &response);
+   BOOST_ASSERT(!response.hasAfterResponse());
+   if (error)
+      ptrConnection->sendJsonRpcError(error);
+   else
+      ptrConnection->sendJsonRpcResponse(response);
+}
+
+void executeUriRequest(const UriHandlerFunction& handler,
+                       boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   http::Response response;
+   if (handler(ptrConnection->request(), &response))
+   {
+      ptrConnection->sendResponse(response);
+   }
+   else
+   {
+      // declined; let the main thread handle it
+      httpConnectionListener().mainConnectionQueue().enqueConnection(
+                                                            ptrConnection);
+   }
+}
+
+} // anonymous namespace
+
+Error initialize(int threads)
+{
+   if (s_pPool != NULL)
+      return Success();
+
+   s_pPool = new thread::ThreadPool("session worker", threads);
+
+   return Success();
+}
+
+void registerMethod(const std::string& name,
+                    const json::JsonRpcFunction& function)
+{
+   s_methods.set(name, function);
+}
+
+void registerUriHandler(const std::string& path,
+                        const UriHandlerFunction& handler)
+{
+   s_uriHandlers.set(path, handler);
+}
+
+void setClientIdentity(const std::string& clientId,
+                       const std::string& clientVersion)
+{
+   s_clientId.set(clientId);
+   s_clientVersion.set(clientVersion);
+}
+
+bool execute(const Task& task, thread::TaskPriority priority)
+{
+   if (s_pPool == NULL)
+      return false;
+
+   s_pPool->submit(task, priority);
+   return true;
+}
+
+bool dispatchConnection(boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   if (s_pPool == NULL)
+      return false;
+
+   // requests are answered ahead of background tasks (the client is
+   // waiting on them)
+
+   // check the method name (from the uri) before bothering to parse
+   const std::string& uri = ptrConnection->request().uri();
+   if (!boost::algorithm::starts_with(uri, "/rpc/"))
+   {
+      UriHandlerFunction handler =
+                     s_uriHandlers.get(ptrConnection->request().path());
+      if (!handler)
+         return false;
+
+      s_pPool->submit(boost::bind(executeUriRequest, handler, ptrConnection),
+                      thread::TaskPriorityHigh);
+      return true;
+   }
+   std::string method = uri.substr(uri.find_last_of('/') + 1);
+   json::JsonRpcFunction function = s_methods.get(method);
+   if (!function)
+      return false;
+
+   // parse and validate (anything unexpected is left for the main thread)
+   json::JsonRpcRequest request;
+   Error error = json::parseJsonRpcRequest(ptrConnection->request().body(),
+                                           &request);
+   if (error || request.method != method)
+      return false;
+   if (request.clientId != s_clientId.get())
+      return false;
+   if (request.version > 0)
+      return false;
+   if (!request.clientVersion.empty() &&
+       request.clientVersion != s_clientVersion.get())
+   {
+      return false;
+   }
+
+   s_pPool->submit(boost::bind(executeRequest,
+                               function,
+                               request,
+                               ptrConnection),
+                   thread::TaskPriorityHigh);
+   return true;
+}
+
+} // namespace worker_pool
+} // namespace session
+} // namespace rstudio
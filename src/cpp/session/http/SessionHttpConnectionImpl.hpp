@@ -24,6 +24,7 @@
 #include <boost/asio/write.hpp>
 #include <boost/asio/placeholders.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
@@ -33,6 +34,7 @@
 #include <core/http/Response.hpp>
 #include <core/http/RequestParser.hpp>
 #include <core/http/SocketUtils.hpp>
+#include <core/http/FileResponseBody.hpp>
 
 #include <core/json/JsonRpc.hpp>
 
@@ -80,12 +82,67 @@ public:
 
    virtual void sendResponse(const core::http::Response &response)
    {
+      // keep the connection open for another request if the client asked
+      // us to and it will be able to tell where the response ends
+      bool keepAlive = boost::algorithm::iequals(
+                                    request_.headerValue("Connection"),
+                                    "keep-alive") &&
+                       response.containsHeader("Content-Length");
+
+      // open a file-backed body before writing anything so that we can
+      // still return an error response if that fails
+      boost::shared_ptr<core::http::FileResponseBody> pFileBody;
+      if (response.hasFileBody())
+      {
+         core::Error error = core::http::FileResponseBody::create(response,
+                                                                  &pFileBody);
+         if (error)
+         {
+            LOG_ERROR(error);
+            core::http::Response errorResponse;
+            errorResponse.setError(error);
+            sendResponse(errorResponse);
+            return;
+         }
+      }
+
       try
       {
          // write the response
          boost::asio::write(socket_,
                             response.toBuffers(
+                               keepAlive ?
+                                  core::http::Header::connectionKeepAlive() :
                                   core::http::Header::connectionClose()));
+
+         // write the file-backed body
+         if (pFileBody)
+         {
+#ifndef _WIN32
+            core::Error error = pFileBody->write(socket_,
+                                                 socket_.native_handle());
+#else
+            core::Error error = pFileBody->write(socket_);
+#endif
+            if (error)
+            {
+               // the response is incomplete so the connection can't be reused
+               keepAlive = false;
+               error.addProperty("request-uri", request_.uri());
+               if (!core::http::isConnectionTerminatedError(error))
+                  LOG_ERROR(error);
+            }
+         }
+
+         // wait for the next request
+         if (keepAlive)
+         {
+            request_.reset();
+            requestParser_.reset();
+            requestId_.clear();
+            readSome();
+            return;
+         }
       }
       catch(const boost::system::system_error& e)
       {
@@ -44,6 +44,7 @@
 #include <session/SessionHttpConnection.hpp>
 #include <session/SessionHttpConnectionQueue.hpp>
 #include <session/SessionHttpConnectionListener.hpp>
+#include <session/SessionWorkerPool.hpp>
 
 #include "SessionHttpConnectionImpl.hpp"
 
@@ -271,6 +272,10 @@ private:
       if (connection::checkForSuspend(ptrHttpConnection))
          return;
 
+      // worker-safe rpc methods are executed directly by the worker pool
+      if (worker_pool::dispatchConnection(ptrHttpConnection))
+         return;
+
       // place the connection on the correct queue
       if (connection::isGetEvents(ptrHttpConnection))
          eventsConnectionQueue_.enqueConnection(ptrHttpConnection);
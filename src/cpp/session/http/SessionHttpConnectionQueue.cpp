@@ -26,36 +26,143 @@ using namespace rstudio::core ;
 namespace rstudio {
 namespace session {
 
+void HttpConnectionQueue::setConnectionClassifier(
+                              const ConnectionClassifier& classifier)
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      classifier_ = classifier;
+   }
+   END_LOCK_MUTEX
+}
+
+void HttpConnectionQueue::setStarvationThreshold(
+                        const boost::posix_time::time_duration& threshold)
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      starvationThreshold_ = threshold;
+   }
+   END_LOCK_MUTEX
+}
+
 void HttpConnectionQueue::enqueConnection(
                               boost::shared_ptr<HttpConnection> ptrConnection)
 {
+   // classify outside of the lock (classifiers are required to be thread-safe)
+   ConnectionClassifier classifier;
+   LOCK_MUTEX(*pMutex_)
+   {
+      classifier = classifier_;
+   }
+   END_LOCK_MUTEX
+
+   int lane = InteractivePriority;
+   if (classifier)
+   {
+      lane = classifier(ptrConnection->request().uri());
+      if (lane < 0 || lane >= ConnectionPriorityCount)
+         lane = InteractivePriority;
+   }
+
    LOCK_MUTEX(*pMutex_)
    {
       // enque
-      queue_.push(ptrConnection);
+      lanes_[lane].push_back(QueuedConnection(
+            ptrConnection,
+            boost::posix_time::microsec_clock::universal_time()));
+
+      // update metrics
+      LaneMetrics& metrics = metrics_[lane];
+      metrics.depth = lanes_[lane].size();
+      if (metrics.depth > metrics.maxDepth)
+         metrics.maxDepth = metrics.depth;
    }
    END_LOCK_MUTEX
 
    pWaitCondition_->notify_all();
 }
 
+// NOTE: must be called with the mutex held
+int HttpConnectionQueue::nextLane(const ConnectionUriFilter& filter,
+                                  const boost::posix_time::ptime& now,
+                                  bool* pStarved)
+{
+   *pStarved = false;
+
+   // find the highest priority eligible lane along with the starving
+   // lane whose connection has been waiting the longest
+   int highestLane = -1;
+   int starvedLane = -1;
+   for (int i = 0; i < ConnectionPriorityCount; i++)
+   {
+      if (lanes_[i].empty())
+         continue;
+
+      const QueuedConnection& front = lanes_[i].front();
+      if (filter && !filter(front.ptrConnection->request().uri()))
+         continue;
+
+      if (highestLane == -1)
+      {
+         highestLane = i;
+
+         // interrupts are never delayed
+         if (i == InterruptPriority)
+            return i;
+      }
+      else if ((now - front.enqueTime) > starvationThreshold_)
+      {
+         if (starvedLane == -1 ||
+             front.enqueTime < lanes_[starvedLane].front().enqueTime)
+         {
+            starvedLane = i;
+         }
+      }
+   }
+
+   if (starvedLane != -1)
+   {
+      *pStarved = true;
+      return starvedLane;
+   }
+   else
+   {
+      return highestLane;
+   }
+}
 
-boost::shared_ptr<HttpConnection> HttpConnectionQueue::doDequeConnection()
+boost::shared_ptr<HttpConnection> HttpConnectionQueue::doDequeConnection(
+                                             const ConnectionUriFilter& filter)
 {
    LOCK_MUTEX(*pMutex_)
    {
-      if (!queue_.empty())
+      using namespace boost::posix_time;
+      ptime now = microsec_clock::universal_time();
+      bool starved = false;
+      int lane = nextLane(filter, now, &starved);
+      if (lane != -1)
       {
          // remove it
-         boost::shared_ptr<HttpConnection> next = queue_.front();
-         queue_.pop();
+         QueuedConnection next = lanes_[lane].front();
+         lanes_[lane].pop_front();
+
+         // update metrics
+         LaneMetrics& metrics = metrics_[lane];
+         metrics.depth = lanes_[lane].size();
+         metrics.dequed++;
+         if (starved)
+            metrics.starvationDeques++;
+         time_duration waited = now - next.enqueTime;
+         if (waited > metrics.maxWait)
+            metrics.maxWait = waited;
+         next.ptrConnection->setQueueWaitTime(waited);
 
          // note last connection time
-         lastConnectionTime_ =
-                     boost::posix_time::second_clock::universal_time();
+         lastConnectionTime_ = second_clock::universal_time();
 
          // return it
-         return next;
+         return next.ptrConnection;
       }
       else
       {
@@ -71,12 +178,19 @@ boost::shared_ptr<HttpConnection> HttpConnectionQueue::doDequeConnection()
 boost::shared_ptr<HttpConnection> HttpConnectionQueue::dequeConnection()
 {
    // perform the deque
-   boost::shared_ptr<HttpConnection> connection = doDequeConnection();
+   boost::shared_ptr<HttpConnection> connection =
+                                 doDequeConnection(ConnectionUriFilter());
 
    // return the connection
    return connection;
 }
 
+boost::shared_ptr<HttpConnection> HttpConnectionQueue::dequeConnection(
+                                             const ConnectionUriFilter& filter)
+{
+   return doDequeConnection(filter);
+}
+
 boost::shared_ptr<HttpConnection> HttpConnectionQueue::dequeConnection(
             const boost::posix_time::time_duration& waitDuration)
 {
@@ -92,12 +206,27 @@ boost::shared_ptr<HttpConnection> HttpConnectionQueue::dequeConnection(
       return boost::shared_ptr<HttpConnection>();
 }
 
+void HttpConnectionQueue::wakeWaiter()
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      wakePending_ = true;
+   }
+   END_LOCK_MUTEX
+
+   pWaitCondition_->notify_all();
+}
+
 std::string HttpConnectionQueue::peekNextConnectionUri()
 {
    LOCK_MUTEX(*pMutex_)
    {
-      if (!queue_.empty())
-         return queue_.front()->request().uri();
+      bool starved = false;
+      int lane = nextLane(ConnectionUriFilter(),
+                          boost::posix_time::microsec_clock::universal_time(),
+                          &starved);
+      if (lane != -1)
+         return lanes_[lane].front().ptrConnection->request().uri();
       else
          return std::string();
    }
@@ -114,8 +243,18 @@ bool HttpConnectionQueue::waitForConnection(
    try
    {
       unique_lock<mutex> lock(*pMutex_);
+
+      // a wake which arrived while we weren't waiting ends this wait
+      if (wakePending_)
+      {
+         wakePending_ = false;
+         return true;
+      }
+
       system_time timeoutTime = get_system_time() + waitDuration;
-      return pWaitCondition_->timed_wait(lock, timeoutTime);
+      bool notified = pWaitCondition_->timed_wait(lock, timeoutTime);
+      wakePending_ = false;
+      return notified;
    }
    catch(const thread_resource_error& e)
    {
@@ -137,5 +276,17 @@ boost::posix_time::ptime HttpConnectionQueue::lastConnectionTime()
     return boost::posix_time::ptime();
 }
 
+std::vector<HttpConnectionQueue::LaneMetrics> HttpConnectionQueue::laneMetrics()
+{
+   LOCK_MUTEX(*pMutex_)
+   {
+      return metrics_;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return std::vector<LaneMetrics>();
+}
+
 } // namespace session
 } // namespace rstudio
@@ -49,6 +49,7 @@
 
 // Mingw doesn't have this declaration
 #include <session/SessionOptions.hpp>
+#include <session/SessionWorkerPool.hpp>
 
 #include "SessionHttpConnectionUtils.hpp"
 
@@ -365,6 +366,10 @@ private:
       if (connection::checkForSuspend(ptrHttpConnection))
          return;
 
+      // worker-safe rpc methods are executed directly by the worker pool
+      if (worker_pool::dispatchConnection(ptrHttpConnection))
+         return;
+
       // place the connection on the correct queue
       if (connection::isGetEvents(ptrHttpConnection))
          eventsConnectionQueue_.enqueConnection(ptrHttpConnection);
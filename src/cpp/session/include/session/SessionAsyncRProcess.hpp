@@ -17,6 +17,9 @@
 #ifndef SESSION_ASYNC_R_PROCESS_HPP
 #define SESSION_ASYNC_R_PROCESS_HPP
 
+#include <string>
+#include <vector>
+
 #include <boost/enable_shared_from_this.hpp>
 
 #include <core/system/Types.hpp>
@@ -26,6 +29,14 @@ namespace core
    class FilePath;
 }
 
+namespace rstudio {
+namespace core {
+namespace system {
+   class ProcessOperations;
+}
+}
+}
+
 namespace rstudio {
 namespace session {
 namespace async_r {
@@ -36,7 +47,13 @@ enum AsyncRProcessOptions
    R_PROCESS_REDIRECTSTDERR = 1 << 1,
    R_PROCESS_VANILLA        = 1 << 2,
    R_PROCESS_AUGMENTED      = 1 << 3,
-   R_PROCESS_NO_RDATA       = 1 << 4
+   R_PROCESS_NO_RDATA       = 1 << 4,
+
+   // run on an idle pooled R worker rather than starting a new process. for
+   // short tasks which neither read input nor rely on state which a previous
+   // task could have changed (tasks are evaluated in a fresh environment,
+   // but packages they load stay loaded until the worker is recycled)
+   R_PROCESS_POOLED         = 1 << 5
 };
 
 inline AsyncRProcessOptions operator | (AsyncRProcessOptions lhs,
@@ -46,6 +63,8 @@ inline AsyncRProcessOptions operator | (AsyncRProcessOptions lhs,
             static_cast<int>(lhs) | static_cast<int>(rhs));
 }
 
+class AsyncRWorker;
+
 class AsyncRProcess :
       boost::noncopyable,
       public boost::enable_shared_from_this<AsyncRProcess>
@@ -72,6 +91,10 @@ public:
    void terminate();
    void markCompleted();
 
+   // queue input for the process's standard input (written as soon as the
+   // process is next polled)
+   void writeInput(const std::string& input, bool eof);
+
 protected:
    virtual bool onContinue();
    virtual void onStdout(const std::string& output);
@@ -80,9 +103,13 @@ protected:
    virtual void onCompleted(int exitStatus) = 0;
 
 private:
+   friend class AsyncRWorker;
+   bool onProcessContinue(core::system::ProcessOperations& ops);
    void onProcessCompleted(int exitStatus);
    bool isRunning_;
    bool terminationRequested_;
+   std::string pendingInput_;
+   bool pendingEof_;
 };
 
 } // namespace async_r
@@ -0,0 +1,34 @@
+/*
+ * SessionConsoleAudit.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_CONSOLE_AUDIT_HPP
+#define SESSION_CONSOLE_AUDIT_HPP
+
+namespace rstudio {
+namespace session {
+namespace console_audit {
+
+// When console auditing is enabled the console's prompts, input and output
+// are recorded as monitor console actions. they're batched by the monitor
+// client and sent from its flush thread (or appended to a journal in the
+// user scratch path while the monitor is slow), so the R thread never
+// waits on the monitor.
+void initialize();
+
+} // namespace console_audit
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_CONSOLE_AUDIT_HPP
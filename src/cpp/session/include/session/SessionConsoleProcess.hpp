@@ -16,10 +16,10 @@
 #define SESSION_CONSOLE_PROCESS_HPP
 
 #include <queue>
+#include <deque>
 
 #include <boost/regex.hpp>
 #include <boost/signals.hpp>
-#include <boost/circular_buffer.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
 #include <core/system/Process.hpp>
@@ -71,7 +71,6 @@ private:
          InteractionMode mode,
          int maxOutputLines);
 
-   void regexInit();
    void commonInit();
 
 public:
@@ -178,18 +177,18 @@ private:
    std::queue<Input> inputQueue_;
 
    // Buffer output in case client disconnects/reconnects and needs
-   // to recover some history
-   boost::circular_buffer<char> outputBuffer_;
+   // to recover some history. Output is kept in chunks (the first
+   // outputOffset_ bytes of the first chunk have been dropped) and
+   // limited to maxOutputBufferSize_ bytes
+   std::deque<std::string> outputChunks_;
+   std::size_t outputOffset_;
+   std::size_t outputSize_;
+   std::size_t maxOutputBufferSize_;
 
    boost::optional<int> exitCode_;
 
    boost::function<bool(const std::string&, Input*)> onPrompt_;
    boost::signal<void(int)> onExit_;
-
-
-   // regex for prompt detection
-   boost::regex controlCharsPattern_;
-   boost::regex promptPattern_;
 };
 
 
@@ -57,6 +57,14 @@
 #define kTimeoutSessionOption             "session-timeout-minutes"
 #define kDisconnectedTimeoutSessionOption "session-disconnected-timeout-minutes"
 
+#define kTraceSessionOption               "session-trace"
+
+#define kIdlePrioritySessionOption        "session-idle-priority"
+
+#define kSharedFileMonitorSessionOption   "session-shared-file-monitor"
+#define kSharedFileMonitorSocketPath \
+                  "/tmp/rstudio-rserver/rserver-shared-file-monitor.socket"
+
 // NOTE: literal versions of these are depended upon by the desktop/rsinverse
 // project so they should be updated there as well if they are changed
 #define kLocalUriLocationPrefix           "/rsession-local/"
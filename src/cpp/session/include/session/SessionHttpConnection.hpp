@@ -20,6 +20,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 /*
  HttpConnection plays two related roles in the system:
@@ -74,6 +75,20 @@ public:
 
    // other useful introspection methods
    virtual std::string requestId() const = 0;
+
+   // time the connection spent waiting in the connection queue (set
+   // by HttpConnectionQueue when the connection is dequed)
+   const boost::posix_time::time_duration& queueWaitTime() const
+   {
+      return queueWaitTime_;
+   }
+   void setQueueWaitTime(const boost::posix_time::time_duration& waitTime)
+   {
+      queueWaitTime_ = waitTime;
+   }
+
+private:
+   boost::posix_time::time_duration queueWaitTime_;
 };
 
 
@@ -16,8 +16,10 @@
 #ifndef SESSION_HTTP_CONNECTION_QUEUE_HPP
 #define SESSION_HTTP_CONNECTION_QUEUE_HPP
 
-#include <queue>
+#include <deque>
+#include <vector>
 
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include <boost/utility.hpp>
@@ -35,28 +37,99 @@ namespace core {
 namespace rstudio {
 namespace session {
 
+// priority lanes for queued connections (lower values are served first)
+enum ConnectionPriority
+{
+   InterruptPriority = 0,
+   ConsoleInputPriority,
+   InteractivePriority,
+   BulkPriority,
+   ConnectionPriorityCount
+};
+
+// classifies a connection (by uri) into a priority lane. note that this is
+// called from the thread enqueing the connection so it must be thread-safe
+typedef boost::function<ConnectionPriority(const std::string&)>
+                                                      ConnectionClassifier;
+
+// filter used to restrict which connections are eligible for a deque
+typedef boost::function<bool(const std::string&)> ConnectionUriFilter;
+
+// connection queue with one FIFO lane per priority. higher priority lanes
+// are served first, however a lane whose oldest connection has waited
+// longer than the starvation threshold is served ahead of higher priority
+// lanes (the interrupt lane is always served first). without a classifier
+// all connections go into a single lane (i.e. plain FIFO behavior)
 class HttpConnectionQueue : boost::noncopyable
 {
+public:
+   struct LaneMetrics
+   {
+      LaneMetrics() : depth(0), maxDepth(0), dequed(0), starvationDeques(0) {}
+      std::size_t depth;
+      std::size_t maxDepth;
+      std::size_t dequed;
+      std::size_t starvationDeques;
+      boost::posix_time::time_duration maxWait;
+   };
+
 public:
    HttpConnectionQueue()
       : pMutex_(new boost::mutex()),
-        pWaitCondition_(new boost::condition())
+        pWaitCondition_(new boost::condition()),
+        wakePending_(false),
+        starvationThreshold_(boost::posix_time::milliseconds(500)),
+        lanes_(ConnectionPriorityCount),
+        metrics_(ConnectionPriorityCount)
    {
    }
 
+   // should be set prior to any connections being enqueued
+   void setConnectionClassifier(const ConnectionClassifier& classifier);
+   void setStarvationThreshold(
+               const boost::posix_time::time_duration& threshold);
+
    void enqueConnection(boost::shared_ptr<HttpConnection> ptrConnection);
 
    boost::shared_ptr<HttpConnection> dequeConnection();
 
+   // deque the next connection whose uri passes the filter (connections
+   // which don't pass block the remainder of their lane)
+   boost::shared_ptr<HttpConnection> dequeConnection(
+               const ConnectionUriFilter& filter);
+
    boost::shared_ptr<HttpConnection> dequeConnection(
                const boost::posix_time::time_duration& waitDuration);
 
+   // wake a thread waiting for a connection (or the next one to wait) so
+   // that it can attend to other work (e.g. output from a child process)
+   void wakeWaiter();
+
+   // uri of the connection which would be dequed next
    std::string peekNextConnectionUri();
 
    boost::posix_time::ptime lastConnectionTime();
 
+   std::vector<LaneMetrics> laneMetrics();
+
 private:
-   boost::shared_ptr<HttpConnection> doDequeConnection();
+   struct QueuedConnection
+   {
+      QueuedConnection(boost::shared_ptr<HttpConnection> ptrConnection,
+                       const boost::posix_time::ptime& enqueTime)
+         : ptrConnection(ptrConnection), enqueTime(enqueTime)
+      {
+      }
+      boost::shared_ptr<HttpConnection> ptrConnection;
+      boost::posix_time::ptime enqueTime;
+   };
+   typedef std::deque<QueuedConnection> Lane;
+
+   boost::shared_ptr<HttpConnection> doDequeConnection(
+               const ConnectionUriFilter& filter);
+   int nextLane(const ConnectionUriFilter& filter,
+                const boost::posix_time::ptime& now,
+                bool* pStarved);
    bool waitForConnection(const boost::posix_time::time_duration& waitDuration);
 
 private:
@@ -69,8 +142,12 @@ private:
    boost::condition* pWaitCondition_ ;
 
    // instance data
+   bool wakePending_;
    boost::posix_time::ptime lastConnectionTime_;
-   std::queue<boost::shared_ptr<HttpConnection> > queue_;
+   ConnectionClassifier classifier_;
+   boost::posix_time::time_duration starvationThreshold_;
+   std::vector<Lane> lanes_;
+   std::vector<LaneMetrics> metrics_;
 };
 
 } // namespace session
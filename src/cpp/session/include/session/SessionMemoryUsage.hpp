@@ -0,0 +1,80 @@
+/*
+ * SessionMemoryUsage.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_MEMORY_USAGE_HPP
+#define SESSION_MEMORY_USAGE_HPP
+
+#include <cstddef>
+#include <string>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace session {
+namespace memory_usage {
+
+// Accounting of the memory held by the session's subsystems (caches,
+// indexes, queues and buffers). Each subsystem registers a reporter which
+// returns the (approximate) bytes it holds; reporters are only called on
+// the main thread and should be cheap, since they're also sampled for the
+// monitor (as memory.<name> gauges) every monitor interval.
+
+typedef boost::function<std::size_t()> UsageReporter;
+
+void registerReporter(const std::string& name, const UsageReporter& reporter);
+
+// statistics from the allocator (where it provides them)
+struct AllocatorStats
+{
+   AllocatorStats()
+      : available(false), inUseBytes(0), freeBytes(0), mappedBytes(0)
+   {
+   }
+
+   bool available;
+   std::string allocator;
+
+   // bytes allocated and not yet freed
+   boost::uint64_t inUseBytes;
+
+   // bytes freed but retained by the allocator
+   boost::uint64_t freeBytes;
+
+   // bytes in blocks which were individually mapped (large allocations)
+   boost::uint64_t mappedBytes;
+};
+
+AllocatorStats allocatorStats();
+
+// resident set size of the process (0 if it can't be determined)
+boost::uint64_t residentBytes();
+
+// the reported usage of each subsystem along with the allocator and
+// process totals, in the form
+// { resident, allocator: { name, in_use, free, mapped },
+//   subsystems: { name: bytes, ... }, accounted }
+core::json::Object usageAsJson();
+
+// record the usage as monitor metrics
+void recordMetrics();
+
+} // namespace memory_usage
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_MEMORY_USAGE_HPP
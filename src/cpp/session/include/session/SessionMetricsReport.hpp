@@ -0,0 +1,34 @@
+/*
+ * SessionMetricsReport.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_METRICS_REPORT_HPP
+#define SESSION_METRICS_REPORT_HPP
+
+namespace rstudio {
+namespace session {
+namespace metrics_report {
+
+// When the server serves a metrics endpoint it asks sessions to report
+// their metrics to it: the metrics flushed to the monitor each interval
+// are also posted to the server's metrics socket, where they're aggregated
+// across sessions (so scraping the endpoint never involves the sessions).
+// reporting happens on the monitor client's flush thread.
+void initialize();
+
+} // namespace metrics_report
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_METRICS_REPORT_HPP
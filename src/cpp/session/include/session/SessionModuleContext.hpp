@@ -216,6 +216,22 @@ core::Error registerAsyncRpcMethod(
 core::Error registerRpcMethod(const std::string& name,
                               const core::json::JsonRpcFunction& function);
 
+// register an rpc method which never touches R or other main thread state.
+// these are dispatched to the worker pool as soon as they are received so
+// they are handled even while R is busy
+core::Error registerWorkerSafeRpcMethod(
+                              const std::string& name,
+                              const core::json::JsonRpcFunction& function);
+
+// register a uri handler which never touches R or other main thread state.
+// requests are offered to it on the worker pool as soon as they are
+// received; those it declines (by returning false) go to the handler
+// registered for the main thread with registerUriHandler
+core::Error registerWorkerSafeUriHandler(
+      const std::string& name,
+      const boost::function<bool(const core::http::Request&,
+                                 core::http::Response*)>& handlerFunction);
+
 
 core::Error executeAsync(const core::json::JsonRpcFunction& function,
                          const core::json::JsonRpcRequest& request,
@@ -329,6 +345,7 @@ struct Events : boost::noncopyable
    boost::signal<void (const DistributedEvent&)>
                                              onDistributedEvent;
    boost::signal<void (core::FilePath)>      onPermissionsChanged;
+   boost::signal<void ()>                    onReclaimMemory;
 
    // signal for detecting extended type of documents
    boost::signal<std::string(boost::shared_ptr<source_database::SourceDocument>),
@@ -340,6 +357,17 @@ Events& events();
 // ProcessSupervisor
 core::system::ProcessSupervisor& processSupervisor();
 
+// priority of scheduled work. each background processing tick runs the
+// ready work in order of priority (and then of how long it has waited)
+// until the tick's time budget is used, so that low priority work can't
+// hold up console input
+enum WorkPriority
+{
+   WorkPriorityHigh,
+   WorkPriorityNormal,
+   WorkPriorityLow
+};
+
 // schedule incremental work. execute will be called back periodically
 // (up to every 25ms if the process is completely idle). if execute
 // returns true then it will be called back again, if it returns false
@@ -354,7 +382,8 @@ core::system::ProcessSupervisor& processSupervisor();
 void scheduleIncrementalWork(
          const boost::posix_time::time_duration& incrementalDuration,
          const boost::function<bool()>& execute,
-         bool idleOnly = true);
+         bool idleOnly = true,
+         WorkPriority priority = WorkPriorityNormal);
 
 // variation of scheduleIncrementalWork which performs a configurable
 // amount of work immediately. this work occurs synchronously with the
@@ -364,7 +393,8 @@ void scheduleIncrementalWork(
          const boost::posix_time::time_duration& initialDuration,
          const boost::posix_time::time_duration& incrementalDuration,
          const boost::function<bool()>& execute,
-         bool idleOnly = true);
+         bool idleOnly = true,
+         WorkPriority priority = WorkPriorityNormal);
 
 
 // schedule work to done every time the specified period elapses.
@@ -374,13 +404,25 @@ void scheduleIncrementalWork(
 void schedulePeriodicWork(const boost::posix_time::time_duration& period,
                           const boost::function<bool()> &execute,
                           bool idleOnly = true,
-                          bool immediate = true);
+                          bool immediate = true,
+                          WorkPriority priority = WorkPriorityNormal);
 
 
 // schedule work to be done after a fixed delay
 void scheduleDelayedWork(const boost::posix_time::time_duration& period,
                          const boost::function<void()> &execute,
-                         bool idleOnly = true);
+                         bool idleOnly = true,
+                         WorkPriority priority = WorkPriorityNormal);
+
+// schedule R-independent initialization work (e.g. reading a cache or index
+// from disk) to run on the worker pool concurrently with the rest of module
+// initialization. tasks must not call R or touch state used by other tasks.
+// all of them have completed before the session begins handling requests
+void scheduleStartupTask(const std::string& name,
+                         const boost::function<core::Error()>& task);
+
+// wait for all scheduled startup tasks to complete
+void waitForStartupTasks();
 
 
 core::string_utils::LineEnding lineEndings(const core::FilePath& filePath);
@@ -404,6 +446,11 @@ core::Error sourceModuleRFileWithResult(const std::string& rSourceFile,
 // enque client events (note R methods can do this via .rs.enqueClientEvent)
 void enqueClientEvent(const ClientEvent& event);
 
+// record the time elapsed since startTime (in microseconds) into the named
+// latency histogram reported to the monitor
+void recordLatency(const std::string& name,
+                   const boost::posix_time::ptime& startTime);
+
 // check whether a directory is currently being monitored by one of our subsystems
 bool isDirectoryMonitored(const core::FilePath& directory);
 
@@ -431,6 +478,14 @@ void consoleWriteOutput(const std::string& output);
 // write an error to the console (convenience wrapper for enquing a 
 // kConsoleWriteOutput event)
 void consoleWriteError(const std::string& message);
+
+// console output which was collapsed rather than delivered to the client
+// because it exceeded the output limits (see ClientEventQueue). reads up to
+// maxBytes ending offsetFromEnd bytes before the end of the collapsed
+// output and returns the number of bytes which remain before it
+std::size_t collapsedConsoleOutput(std::size_t offsetFromEnd,
+                                   std::size_t maxBytes,
+                                   std::string* pOutput);
    
 // show an error dialog (convenience wrapper for enquing kShowErrorMessage)
 void showErrorMessage(const std::string& title, const std::string& message);
@@ -464,6 +519,9 @@ bool addRtoolsToPathIfNecessary(std::string* pPath,
                                 std::string* pWarningMessage);
 bool addRtoolsToPathIfNecessary(core::system::Options* pEnvironment,
                                 std::string* pWarningMessage);
+int buildParallelism();
+void addParallelBuildToEnvironment(const core::FilePath& sourcePath,
+                                   core::system::Options* pEnvironment);
 
 #ifdef __APPLE__
 bool isOSXMavericks();
@@ -778,6 +836,9 @@ struct SourceMarker
 SourceMarker::Type sourceMarkerTypeFromString(const std::string& type);
 
 core::json::Array sourceMarkersAsJson(const std::vector<SourceMarker>& markers);
+core::json::Array sourceMarkersAsJson(
+                     std::vector<SourceMarker>::const_iterator begin,
+                     std::vector<SourceMarker>::const_iterator end);
 
 struct SourceMarkerSet
 {  
@@ -816,6 +877,12 @@ enum MarkerAutoSelect
 void showSourceMarkers(const SourceMarkerSet& markerSet,
                        MarkerAutoSelect autoSelect);
 
+// add markers to the end of a set (creating it if necessary), e.g. as a
+// long running check produces them. only the new markers are sent to the
+// client
+void appendSourceMarkers(const SourceMarkerSet& markerSet,
+                         MarkerAutoSelect autoSelect);
+
 
 bool isLoadBalanced();
 
@@ -144,11 +144,29 @@ public:
 
    int disconnectedTimeoutMinutes() { return disconnectedTimeoutMinutes_; }
 
+   int workerThreads() const { return workerThreads_; }
+
+   bool trace() const { return trace_; }
+
+   bool sharedFileMonitor() const { return sharedFileMonitor_; }
+
+   std::string fileMonitorBackend() const
+   {
+      return std::string(fileMonitorBackend_.c_str());
+   }
+
+   int fileMonitorLatencyMs() const { return fileMonitorLatencyMs_; }
+
+   int statCacheTtlMs() const { return statCacheTtlMs_; }
+
+   bool findIndex() const { return findIndex_; }
+
    bool createProfile() const { return createProfile_; }
 
    bool createPublicFolder() const { return createPublicFolder_; }
 
    bool rProfileOnResumeDefault() const { return rProfileOnResumeDefault_; }
+   bool lazyResume() const { return lazyResume_; }
 
    int saveActionDefault() const { return saveActionDefault_; }
 
@@ -451,6 +469,31 @@ public:
       return monitorSharedSecret_.c_str();
    }
 
+   int monitorIntervalSeconds() const
+   {
+      return monitorIntervalSeconds_;
+   }
+
+   bool monitorReportMetrics() const
+   {
+      return monitorReportMetrics_;
+   }
+
+   bool auditConsole() const
+   {
+      return auditConsole_;
+   }
+
+   int idlePriority() const
+   {
+      return idlePriority_;
+   }
+
+   int reclaimIdleMinutes() const
+   {
+      return reclaimIdleMinutes_;
+   }
+
    bool standalone() const
    {
       return standalone_;
@@ -509,9 +552,17 @@ private:
    std::string preflightScript_;
    int timeoutMinutes_;
    int disconnectedTimeoutMinutes_;
+   int workerThreads_;
+   bool trace_;
+   bool sharedFileMonitor_;
+   std::string fileMonitorBackend_;
+   int fileMonitorLatencyMs_;
+   int statCacheTtlMs_;
+   bool findIndex_;
    bool createProfile_;
    bool createPublicFolder_;
    bool rProfileOnResumeDefault_;
+   bool lazyResume_;
    int saveActionDefault_;
    bool standalone_;
    std::string authRequiredUserGroup_;
@@ -588,6 +639,13 @@ private:
 
    // monitor
    std::string monitorSharedSecret_;
+   int monitorIntervalSeconds_;
+   bool monitorReportMetrics_;
+   bool auditConsole_;
+
+   // idle behavior
+   int idlePriority_;
+   int reclaimIdleMinutes_;
 
    // overlay options
    std::map<std::string,std::string> overlayOptions_;
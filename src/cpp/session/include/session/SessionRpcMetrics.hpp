@@ -0,0 +1,65 @@
+/*
+ * SessionRpcMetrics.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_RPC_METRICS_HPP
+#define SESSION_RPC_METRICS_HPP
+
+#include <string>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace session {
+namespace rpc_metrics {
+
+// Always-on timing counters for rpc methods. Each thread which handles
+// rpcs records into its own table so recording never contends with other
+// handler threads (the table's mutex is only ever contended by a reader
+// collecting the counters). Recorded times are also sent to the monitor
+// as latency histograms (rpc.<method>.<phase>).
+
+enum Phase
+{
+   // time the connection spent in the connection queue
+   QueueWaitPhase = 0,
+
+   // time from the start of execution until the response is ready
+   // (includes the handler itself and change detection)
+   DispatchPhase,
+
+   // time to serialize and write the response
+   SerializePhase,
+
+   PhaseCount
+};
+
+void record(const std::string& method,
+            Phase phase,
+            const boost::posix_time::time_duration& elapsed);
+
+// counters for all methods (summed across threads) in the form
+// { method: { queue: { count, total_us, max_us }, dispatch: ..., ... } }
+core::json::Object countersAsJson();
+
+// reset counters for all threads
+void reset();
+
+} // namespace rpc_metrics
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_RPC_METRICS_HPP
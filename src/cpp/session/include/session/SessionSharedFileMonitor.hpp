@@ -0,0 +1,52 @@
+/*
+ * SessionSharedFileMonitor.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SHARED_FILE_MONITOR_HPP
+#define SESSION_SHARED_FILE_MONITOR_HPP
+
+#include <boost/function.hpp>
+
+#include <core/system/FileMonitor.hpp>
+
+namespace rstudio {
+namespace core {
+   class FilePath;
+   class FileInfo;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace shared_file_monitor {
+
+// register a file monitor using the server's shared file monitor (if this
+// session was launched with it enabled). this has the same semantics as
+// file_monitor::registerMonitor: callbacks occur on the main thread and the
+// filter is applied to the listing and events received from the server.
+// if the shared monitor isn't enabled or refuses the subscription then a
+// local file monitor is registered instead
+void registerMonitor(const core::FilePath& filePath,
+                     bool recursive,
+                     const boost::function<bool(const core::FileInfo&)>& filter,
+                     const core::system::file_monitor::Callbacks& callbacks);
+
+// unregister a file monitor registered with the function above
+void unregisterMonitor(core::system::file_monitor::Handle handle);
+
+} // namespace shared_file_monitor
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SHARED_FILE_MONITOR_HPP
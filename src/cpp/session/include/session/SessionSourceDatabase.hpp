@@ -67,6 +67,7 @@ public:
 
    // set contents from string
    void setContents(const std::string& contents);
+   void swapContents(std::string* pContents);
 
    // set contents from file
    core::Error setPathAndContents(const std::string& path,
@@ -163,6 +164,13 @@ private:
    std::string collabServer_;
    std::string sourceWindow_;
    core::json::Object properties_;
+
+   // the file's contents when last read (and its state on disk at the
+   // time), so that checking whether the document is dirty only re-reads
+   // the file when it has changed
+   std::string diskState_;
+   std::string diskHash_;
+   std::size_t diskLength_;
    
 public:
    
@@ -0,0 +1,87 @@
+/*
+ * SessionWorkerPool.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_WORKER_POOL_HPP
+#define SESSION_WORKER_POOL_HPP
+
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <core/ThreadPool.hpp>
+#include <core/json/JsonRpc.hpp>
+
+#include <session/SessionHttpConnection.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+   namespace http {
+      class Request;
+      class Response;
+   }
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace worker_pool {
+
+// The worker pool executes rpc methods which don't need R (and which only
+// touch thread-safe state) on a fixed set of background threads. Requests
+// for these methods are dispatched directly from the connection listener
+// so they are serviced even while the main thread is busy running R code.
+// The threads are a core::thread::ThreadPool.
+
+// start the pool with the specified number of threads (0 for one per cpu
+// available to the process)
+core::Error initialize(int threads);
+
+// register a worker-safe rpc method
+void registerMethod(const std::string& name,
+                    const core::json::JsonRpcFunction& function);
+
+// a worker-safe uri handler. returns false to decline the request, in which
+// case it is queued for the main thread's handler as usual (e.g. when the
+// request needs R to be answered)
+typedef boost::function<bool(const core::http::Request&,
+                             core::http::Response*)> UriHandlerFunction;
+
+// register a worker-safe uri handler for the given path
+void registerUriHandler(const std::string& path,
+                        const UriHandlerFunction& handler);
+
+// set the client id and version which dispatched requests must match
+// (requests which don't match fall through to the main thread, which
+// reports the appropriate error to the client)
+void setClientIdentity(const std::string& clientId,
+                       const std::string& clientVersion);
+
+// execute a task on the pool (returns false if the pool isn't running).
+// dispatched requests run at high priority, ahead of any queued tasks
+bool execute(const boost::function<void()>& task,
+             core::thread::TaskPriority priority =
+                                    core::thread::TaskPriorityNormal);
+
+// called from listener threads -- returns true if the connection was
+// dispatched to the pool (in which case the pool sends the response)
+bool dispatchConnection(boost::shared_ptr<HttpConnection> ptrConnection);
+
+} // namespace worker_pool
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_WORKER_POOL_HPP
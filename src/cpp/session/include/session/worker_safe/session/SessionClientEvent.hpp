@@ -18,6 +18,8 @@
 
 #include <string>
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #include <core/json/Json.hpp>
 
 namespace rstudio {
@@ -146,6 +148,7 @@ extern const int kUserFollowEnded;
 extern const int kProjectAccessRevoked;
 extern const int kCollabEditSaved;
 extern const int kAddinRegistryUpdated;
+extern const int kSessionInfoDeferred;
 }
    
 class ClientEvent
@@ -185,6 +188,7 @@ public:
    std::string typeName() const;
    const core::json::Value& data() const { return data_; }
    const std::string& id() const { return id_; }
+   const boost::posix_time::ptime& createdTime() const { return createdTime_; }
    
    void asJsonObject(int id, core::json::Object* pObject) const;
      
@@ -195,6 +199,7 @@ private:
    int type_ ;
    core::json::Value data_ ;
    std::string id_;
+   boost::posix_time::ptime createdTime_;
 };
 
 ClientEvent showEditorEvent(const std::string& content,
@@ -18,15 +18,21 @@
 
 #include "SessionAsyncPackageInformation.hpp"
 
+#include <map>
 #include <string>
 #include <vector>
 #include <sstream>
 
 #include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
 #include <core/json/Json.hpp>
 #include <core/json/JsonRpc.hpp>
 #include <core/Error.hpp>
+#include <core/r_util/RPackageInfo.hpp>
+#include <core/system/System.hpp>
 
+#include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/algorithm/string.hpp>
 
@@ -142,6 +148,186 @@ bool fillFunctionInfo(const json::Object& functionObjectJson,
    
 }
 
+// Each line of output should be a JSON object with the format:
+//
+// {
+//    "package": <single package name>
+//    "exports": <array of object names in the namespace>,
+//    "types": <array of types (see .rs.acCompletionTypes)>,
+//    "function_info": {big ugly object with function info}
+// }
+bool parsePackageInformation(const std::string& line,
+                             core::r_util::PackageInformation* pPkgInfo)
+{
+   json::Array exportsJson;
+   json::Array typesJson;
+   json::Object functionInfoJson;
+
+   json::Value value;
+
+   if (!json::parse(line, &value))
+   {
+      std::string subset;
+      if (line.length() > 60)
+         subset = line.substr(0, 60) + "...";
+      else
+         subset = line;
+
+      LOG_ERROR_MESSAGE("Failed to parse JSON: '" + subset + "'");
+      return false;
+   }
+   
+   // Ensure that this parsed as an Object -- this might have parsed as
+   // something else if e.g. we got malformed output on load of a package
+   if (!json::isType<json::Object>(value))
+      return false;
+   
+   Error error = json::readObject(value.get_obj(),
+                                  "package", &pPkgInfo->package,
+                                  "exports", &exportsJson,
+                                  "types", &typesJson,
+                                  "function_info", &functionInfoJson);
+
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   if (!json::fillVectorString(exportsJson, &(pPkgInfo->exports)))
+      LOG_ERROR_MESSAGE("Failed to read JSON 'objects' array to vector");
+
+   if (!json::fillVectorInt(typesJson, &(pPkgInfo->types)))
+      LOG_ERROR_MESSAGE("Failed to read JSON 'types' array to vector");
+
+   if (!fillFunctionInfo(functionInfoJson, pPkgInfo->package, &(pPkgInfo->functionInfo)))
+      LOG_ERROR_MESSAGE("Failed to read JSON 'functions' object to map");
+
+   return true;
+}
+
+// package information (including which functions perform non-standard
+// evaluation, which takes inspecting every function) is cached for each
+// installed package version in the user scratch path, so that it's shared
+// by the user's sessions and only computed for new or updated packages.
+// each entry holds a key identifying the installed package followed by the
+// package's line of output from .rs.getPackageInformation
+
+// cache keys of the packages being updated
+std::map<std::string, std::string> s_pkgCacheKeys;
+
+FilePath packageInformationCachePath()
+{
+   return module_context::userScratchPath().childPath("package_information");
+}
+
+// identify the installed package which would be loaded (the first found
+// along the library paths) by its location, version and install time
+std::string packageCacheKey(const std::string& pkg,
+                            const std::vector<FilePath>& libPaths)
+{
+   BOOST_FOREACH(const FilePath& libPath, libPaths)
+   {
+      FilePath descriptionPath = libPath.childPath(pkg + "/DESCRIPTION");
+      if (!descriptionPath.exists())
+         continue;
+
+      core::r_util::RPackageInfo pkgInfo;
+      Error error = pkgInfo.read(descriptionPath.parent());
+      if (error)
+         return std::string();
+
+      return descriptionPath.absolutePath() + ":" + pkgInfo.version() + ":" +
+             safe_convert::numberToString(descriptionPath.lastWriteTime());
+   }
+
+   return std::string();
+}
+
+bool readCachedPackageInformation(const std::string& pkg,
+                                  const std::string& key,
+                                  core::r_util::PackageInformation* pPkgInfo)
+{
+   FilePath cacheFile = packageInformationCachePath().childPath(pkg);
+   if (!cacheFile.exists())
+      return false;
+
+   std::string contents;
+   Error error = core::readStringFromFile(cacheFile, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   std::string::size_type newline = contents.find('\n');
+   if (newline == std::string::npos || contents.substr(0, newline) != key)
+      return false;
+
+   return parsePackageInformation(contents.substr(newline + 1), pPkgInfo) &&
+          pPkgInfo->package == pkg;
+}
+
+void writeCachedPackageInformation(const std::string& pkg,
+                                   const std::string& key,
+                                   const std::string& line)
+{
+   FilePath cachePath = packageInformationCachePath();
+   Error error = cachePath.ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // write to a temporary file and move it into place so that other
+   // sessions never read a partially written entry
+   FilePath cacheFile = cachePath.childPath(pkg);
+   FilePath tempFile(cacheFile.absolutePath() + "." +
+                     core::system::generateShortenedUuid());
+   error = core::writeStringToFile(tempFile, key + "\n" + line);
+   if (!error)
+      error = tempFile.move(cacheFile);
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempFile.removeIfExists();
+   }
+}
+
+// add information for the packages which have an up to date cache entry
+// (removing them from the vector) and note the keys of the rest
+void addCachedPackageInformation(std::vector<std::string>* pPkgs)
+{
+   s_pkgCacheKeys.clear();
+
+   std::vector<FilePath> libPaths = module_context::getLibPaths();
+   std::vector<std::string> uncached;
+   BOOST_FOREACH(const std::string& pkg, *pPkgs)
+   {
+      std::string key = packageCacheKey(pkg, libPaths);
+      if (key.empty())
+      {
+         uncached.push_back(pkg);
+         continue;
+      }
+
+      core::r_util::PackageInformation pkgInfo;
+      if (readCachedPackageInformation(pkg, key, &pkgInfo))
+      {
+         DEBUG("Adding cached entry for package: '" << pkg << "'");
+         RSourceIndex::addPackageInformation(pkg, pkgInfo);
+      }
+      else
+      {
+         s_pkgCacheKeys[pkg] = key;
+         uncached.push_back(pkg);
+      }
+   }
+
+   pPkgs->swap(uncached);
+}
+
 } // anonymous namespace
 
 void AsyncPackageInformationProcess::onCompleted(int exitStatus)
@@ -167,69 +353,25 @@ void AsyncPackageInformationProcess::onCompleted(int exitStatus)
    std::size_t n = splat.size();
    DEBUG("- Received " << n << " lines of response");
 
-   // Each line should be a JSON object with the format:
-   //
-   // {
-   //    "package": <single package name>
-   //    "exports": <array of object names in the namespace>,
-   //    "types": <array of types (see .rs.acCompletionTypes)>,
-   //    "function_info": {big ugly object with function info}
-   // }
    for (std::size_t i = 0; i < n; ++i)
    {
-      json::Array exportsJson;
-      json::Array typesJson;
-      json::Object functionInfoJson;
-      
-      core::r_util::PackageInformation pkgInfo;
-
       if (splat[i].empty())
          continue;
 
-      json::Value value;
-
-      if (!json::parse(splat[i], &value))
-      {
-         std::string subset;
-         if (splat[i].length() > 60)
-            subset = splat[i].substr(0, 60) + "...";
-         else
-            subset = splat[i];
-
-         LOG_ERROR_MESSAGE("Failed to parse JSON: '" + subset + "'");
-         continue;
-      }
-      
-      // Ensure that this parsed as an Object -- this might have parsed as
-      // something else if e.g. we got malformed output on load of a package
-      if (!json::isType<json::Object>(value))
-         continue;
-      
-      Error error = json::readObject(value.get_obj(),
-                                     "package", &pkgInfo.package,
-                                     "exports", &exportsJson,
-                                     "types", &typesJson,
-                                     "function_info", &functionInfoJson);
-
-      if (error)
-      {
-         LOG_ERROR(error);
+      core::r_util::PackageInformation pkgInfo;
+      if (!parsePackageInformation(splat[i], &pkgInfo))
          continue;
-      }
 
       DEBUG("Adding entry for package: '" << pkgInfo.package << "'");
-
-      if (!json::fillVectorString(exportsJson, &(pkgInfo.exports)))
-         LOG_ERROR_MESSAGE("Failed to read JSON 'objects' array to vector");
-
-      if (!json::fillVectorInt(typesJson, &(pkgInfo.types)))
-         LOG_ERROR_MESSAGE("Failed to read JSON 'types' array to vector");
-
-      if (!fillFunctionInfo(functionInfoJson, pkgInfo.package, &(pkgInfo.functionInfo)))
-         LOG_ERROR_MESSAGE("Failed to read JSON 'functions' object to map");
       
       // Update the index
       core::r_util::RSourceIndex::addPackageInformation(pkgInfo.package, pkgInfo);
+
+      // and the cache
+      std::map<std::string, std::string>::const_iterator it =
+                                       s_pkgCacheKeys.find(pkgInfo.package);
+      if (it != s_pkgCacheKeys.end())
+         writeCachedPackageInformation(it->first, it->second, splat[i]);
    }
 
 }
@@ -247,6 +389,9 @@ void AsyncPackageInformationProcess::update()
    
    s_pkgsToUpdate_ =
       RSourceIndex::getAllUnindexedPackages();
+
+   // use cached information where we have it
+   addCachedPackageInformation(&s_pkgsToUpdate_);
    
    // alias for readability
    const std::vector<std::string>& pkgs = s_pkgsToUpdate_;
@@ -299,7 +444,8 @@ void AsyncPackageInformationProcess::update()
    pProcess->start(
             finalCmd.c_str(),
             core::FilePath(),
-            async_r::R_PROCESS_VANILLA | async_r::R_PROCESS_AUGMENTED);
+            async_r::R_PROCESS_VANILLA | async_r::R_PROCESS_AUGMENTED |
+            async_r::R_PROCESS_POOLED);
    
 }
 
@@ -16,6 +16,8 @@
 #include "environment/EnvironmentUtils.hpp"
 
 #include <algorithm>
+#include <map>
+#include <set>
 
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
@@ -54,6 +56,12 @@ namespace
 
 int s_maxShinyFunctionId = 0;
 
+// breakpoints and functions are matched by the absolute paths of their files
+std::string resolvedPath(const std::string& path)
+{
+   return module_context::resolveAliasedPath(path).absolutePath();
+}
+
 // Represents a currently running Shiny function.
 class ShinyFunction : boost::noncopyable
 {
@@ -81,17 +89,25 @@ public:
       if (srcfile != NULL && TYPEOF(srcfile) != NILSXP)
       {
          SEXP file = r::sexp::findVar("filename", srcfile);
-         r::sexp::extract(file, &srcfilename_);
+         std::string srcfilename;
+         r::sexp::extract(file, &srcfilename);
+         if (!srcfilename.empty())
+            filePath_ = resolvedPath(srcfilename);
       }
    }
 
-   bool contains(std::string filename, int line) const
+   // the (resolved) path of the file the function was defined in
+   const std::string& filePath() const
+   {
+      return filePath_;
+   }
+
+   bool contains(const std::string& filePath, int line) const
    {
       if (!(line >= firstLine_ && line <= lastLine_))
          return false;
 
-      return module_context::resolveAliasedPath(srcfilename_) ==
-             module_context::resolveAliasedPath(filename);
+      return !filePath_.empty() && filePath_ == filePath;
    }
 
    int getId()
@@ -119,13 +135,16 @@ private:
    int firstLine_;
    int lastLine_;
    std::string name_;
-   std::string srcfilename_;
+   std::string filePath_;
    SEXP where_;
 };
 
-// A list of the Shiny functions we know about (see notes in
-// rs_registerShinyFunction for an explanation of how this memory is managed)
-std::vector<boost::shared_ptr<ShinyFunction> > s_shinyFunctions;
+typedef std::vector<boost::shared_ptr<ShinyFunction> > ShinyFunctions;
+
+// The Shiny functions we know about, by the file they were defined in (see
+// notes in rs_registerShinyFunction for an explanation of how this memory
+// is managed)
+std::map<std::string, ShinyFunctions> s_shinyFunctions;
 
 // Breakpoint data known by the server (subset of fields known by the client)
 #define TYPE_FUNCTION 0
@@ -138,31 +157,85 @@ public:
    int lineNumber;
    int id;
    std::string path;
+   std::string filePath;
    Breakpoint(int typeIn, int lineNumberIn, int idIn, std::string pathIn):
       type(typeIn),
       lineNumber(lineNumberIn),
       id(idIn),
-      path(pathIn)
+      path(pathIn),
+      filePath(resolvedPath(pathIn))
    {}
 };
 
-// A list of the breakpoints we know about. Note that this is a slave list;
-// the client maintains the master copy and is responsible for synchronizing
-// with this list. This list is maintained so we can inject breakpoints
-// synchronously.
-std::vector<boost::shared_ptr<Breakpoint> > s_breakpoints;
+typedef std::vector<boost::shared_ptr<Breakpoint> > Breakpoints;
+
+// The breakpoints we know about, by ID and by (resolved) file path. Note
+// that this is a slave list; the client maintains the master copy and is
+// responsible for synchronizing with this list. This list is maintained so
+// we can inject breakpoints synchronously.
+std::map<int, boost::shared_ptr<Breakpoint> > s_breakpoints;
+std::map<std::string, Breakpoints> s_breakpointsByFile;
+
+void removeBreakpoint(int id)
+{
+   std::map<int, boost::shared_ptr<Breakpoint> >::iterator it =
+                                                      s_breakpoints.find(id);
+   if (it == s_breakpoints.end())
+      return;
+
+   std::map<std::string, Breakpoints>::iterator fileIt =
+                        s_breakpointsByFile.find(it->second->filePath);
+   if (fileIt != s_breakpointsByFile.end())
+   {
+      Breakpoints& breakpoints = fileIt->second;
+      breakpoints.erase(std::remove(breakpoints.begin(),
+                                    breakpoints.end(),
+                                    it->second),
+                        breakpoints.end());
+      if (breakpoints.empty())
+         s_breakpointsByFile.erase(fileIt);
+   }
+
+   s_breakpoints.erase(it);
+}
+
+void addBreakpoint(boost::shared_ptr<Breakpoint> pBreakpoint)
+{
+   removeBreakpoint(pBreakpoint->id);
+   s_breakpoints[pBreakpoint->id] = pBreakpoint;
+   s_breakpointsByFile[pBreakpoint->filePath].push_back(pBreakpoint);
+}
+
+void clearBreakpoints()
+{
+   s_breakpoints.clear();
+   s_breakpointsByFile.clear();
+}
+
+const Breakpoints& breakpointsInFile(const std::string& filePath)
+{
+   static const Breakpoints kNoBreakpoints;
+   std::map<std::string, Breakpoints>::const_iterator it =
+                                       s_breakpointsByFile.find(filePath);
+   return it != s_breakpointsByFile.end() ? it->second : kNoBreakpoints;
+}
 
 // Returns the Shiny function that contains the given line, if any.
 // Finds the smallest (innermost) function in the case where more than one
 // expression encloses the line.
-boost::shared_ptr<ShinyFunction> findShinyFunction(std::string filename,
+boost::shared_ptr<ShinyFunction> findShinyFunction(const std::string& filePath,
                                                    int line)
 {
    boost::shared_ptr<ShinyFunction> bestPsf;
+   std::map<std::string, ShinyFunctions>::const_iterator it =
+                                             s_shinyFunctions.find(filePath);
+   if (it == s_shinyFunctions.end())
+      return bestPsf;
+
    int bestSize = INT_MAX;
-   BOOST_FOREACH(boost::shared_ptr<ShinyFunction> psf, s_shinyFunctions)
+   BOOST_FOREACH(boost::shared_ptr<ShinyFunction> psf, it->second)
    {
-      if (psf->contains(filename, line) &&
+      if (psf->contains(filePath, line) &&
           psf->getSize() < bestSize)
       {
          bestSize = psf->getSize();
@@ -185,9 +258,10 @@ boost::shared_ptr<Breakpoint> breakpointFromJson(json::Object& obj)
 std::vector<int> getShinyBreakpointLines(const ShinyFunction& sf)
 {
    std::vector<int> lines;
-   BOOST_FOREACH(boost::shared_ptr<Breakpoint> pbp, s_breakpoints)
+   BOOST_FOREACH(boost::shared_ptr<Breakpoint> pbp,
+                 breakpointsInFile(sf.filePath()))
    {
-      if (sf.contains(pbp->path, pbp->lineNumber) &&
+      if (sf.contains(pbp->filePath, pbp->lineNumber) &&
           pbp->type == TYPE_TOPLEVEL)
          lines.push_back(pbp->lineNumber);
    }
@@ -342,19 +416,6 @@ Error setBreakpoints(const json::JsonRpcRequest& request,
    return Success();
 }
 
-std::vector<boost::shared_ptr<Breakpoint> >::iterator posOfBreakpointId(int id)
-{
-   std::vector<boost::shared_ptr<Breakpoint> >::iterator psbi;
-   for (psbi = s_breakpoints.begin();
-        psbi != s_breakpoints.end();
-        psbi++)
-   {
-      if ((*psbi)->id == id)
-         break;
-   }
-   return psbi;
-}
-
 // Called by the R garbage collector when a Shiny function is cleaned up;
 // we use this as a trigger to clean up our own references to the function.
 void unregisterShinyFunction(SEXP ptr)
@@ -365,18 +426,25 @@ void unregisterShinyFunction(SEXP ptr)
    if (psf == NULL)
       return;
 
-   // Look over each Shiny function we know about; if this was a function
-   // we were tracking, release it.
-   for (std::vector<boost::shared_ptr<ShinyFunction> >::iterator psfi =
-               s_shinyFunctions.begin();
-        psfi != s_shinyFunctions.end();
-        psfi++)
+   // Look over the Shiny functions we know about from its file; if this was
+   // a function we were tracking, release it.
+   std::map<std::string, ShinyFunctions>::iterator it =
+                                       s_shinyFunctions.find(psf->filePath());
+   if (it != s_shinyFunctions.end())
    {
-      if (psfi->get() == psf)
+      ShinyFunctions& functions = it->second;
+      for (ShinyFunctions::iterator psfi = functions.begin();
+           psfi != functions.end();
+           psfi++)
       {
-         s_shinyFunctions.erase(psfi);
-         break;
+         if (psfi->get() == psf)
+         {
+            functions.erase(psfi);
+            break;
+         }
       }
+      if (functions.empty())
+         s_shinyFunctions.erase(it);
    }
    r::sexp::clearExternalPtr(ptr);
 }
@@ -420,7 +488,7 @@ void rs_registerShinyFunction(SEXP params)
       s_shinyFunctions.clear();
    }
 
-   s_shinyFunctions.push_back(psf);
+   s_shinyFunctions[psf->filePath()].push_back(psf);
 
    // Attach the information we just created to the Shiny function.
    SEXP sid = r::sexp::create(psf->getId(), &protect);
@@ -455,16 +523,12 @@ SEXP rs_debugSourceFile(SEXP filename, SEXP encoding, SEXP local)
       LOG_ERROR(error);
       return R_NilValue;
    }
-   FilePath filePath = module_context::resolveAliasedPath(path);
-
    // Find all the lines in the file that have breakpoints
    std::vector<int> lines;
-   BOOST_FOREACH(boost::shared_ptr<Breakpoint> pbp, s_breakpoints)
+   BOOST_FOREACH(boost::shared_ptr<Breakpoint> pbp,
+                 breakpointsInFile(resolvedPath(path)))
    {
-      if (module_context::resolveAliasedPath(pbp->path) == filePath)
-      {
-         lines.push_back(pbp->lineNumber);
-      }
+      lines.push_back(pbp->lineNumber);
    }
 
    // Execute the contents with breakpoints. Don't log errors here, since it's
@@ -531,12 +595,12 @@ Error initBreakpoints()
       else
       {
          json::Array breakpointArray = jsonBreakpointArray.get_array();
-         s_breakpoints.clear();
+         clearBreakpoints();
          BOOST_FOREACH(json::Value bp, breakpointArray)
          {
             if (json::isType<core::json::Object>(bp))
             {
-               s_breakpoints.push_back(breakpointFromJson(bp.get_obj()));
+               addBreakpoint(breakpointFromJson(bp.get_obj()));
             }
          }
       }
@@ -554,45 +618,52 @@ Error updateBreakpoints(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
+   // Shiny functions whose breakpoints changed (by ID, so that each is
+   // re-instrumented once however many of its breakpoints changed)
+   std::map<int, boost::shared_ptr<ShinyFunction> > changedFunctions;
+
    BOOST_FOREACH(json::Value bp, breakpointArr)
    {
       boost::shared_ptr<Breakpoint> breakpoint
             (breakpointFromJson(bp.get_obj()));
-      std::vector<boost::shared_ptr<Breakpoint> >::iterator psbi =
-            posOfBreakpointId(breakpoint->id);
 
-      // Erase anything we already know about this breakpoint
-      if (psbi != s_breakpoints.end())
-         s_breakpoints.erase(psbi);
-
-      // If setting or updating the brekapoint, reintroduce it
+      // Erase anything we already know about this breakpoint, and if
+      // setting or updating the breakpoint, reintroduce it
       if (set)
-         s_breakpoints.push_back(breakpoint);
+         addBreakpoint(breakpoint);
+      else
+         removeBreakpoint(breakpoint->id);
 
       // Is this breakpoint associated with a running Shiny function? If it is,
       // and the caller wants the changes armed immediately, reflect them
       if (arm && breakpoint->type == TYPE_TOPLEVEL) {
          boost::shared_ptr<ShinyFunction> psf =
-               findShinyFunction(breakpoint->path, breakpoint->lineNumber);
+               findShinyFunction(breakpoint->filePath, breakpoint->lineNumber);
          if (psf)
-         {
-            // Collect all the breakpoints associated with this function and
-            // update the function's state
-            std::vector<int> lines = getShinyBreakpointLines(*psf);
-            r::exec::RFunction(".rs.setShinyBreakpoints", psf->getName(),
-                                                          psf->getWhere(),
-                                                          lines).call();
-         }
+            changedFunctions[psf->getId()] = psf;
       }
    }
 
+   // Collect all the breakpoints associated with each function and update
+   // the function's state
+   typedef std::map<int, boost::shared_ptr<ShinyFunction> >::value_type
+                                                            ChangedFunction;
+   BOOST_FOREACH(const ChangedFunction& changed, changedFunctions)
+   {
+      boost::shared_ptr<ShinyFunction> psf = changed.second;
+      std::vector<int> lines = getShinyBreakpointLines(*psf);
+      r::exec::RFunction(".rs.setShinyBreakpoints", psf->getName(),
+                                                    psf->getWhere(),
+                                                    lines).call();
+   }
+
    return Success();
 }
 
 Error removeAllBreakpoints(const json::JsonRpcRequest&,
                            json::JsonRpcResponse*)
 {
-   s_breakpoints.clear();
+   clearBreakpoints();
    return Success();
 }
 
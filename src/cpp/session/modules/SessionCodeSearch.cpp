@@ -18,15 +18,18 @@
 
 #include "SessionCodeSearch.hpp"
 
+#include <cctype>
 #include <iostream>
 #include <vector>
 #include <set>
 
 #include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/regex.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
 
@@ -35,8 +38,11 @@
 #include <core/FilePath.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
 #include <core/collection/Tree.hpp>
 
+#include <core/json/JsonWriter.hpp>
+
 #include <core/r_util/RSourceIndex.hpp>
 
 #include <core/system/FileChangeEvent.hpp>
@@ -47,6 +53,8 @@
 #include <r/RRoutines.hpp>
 
 #include <session/SessionUserSettings.hpp>
+#include <session/SessionWorkerPool.hpp>
+#include <session/SessionMemoryUsage.hpp>
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionAsyncRProcess.hpp>
 #include <session/SessionRUtil.hpp>
@@ -56,6 +64,7 @@
 #include "SessionAsyncPackageInformation.hpp"
 
 #include "SessionSource.hpp"
+#include "SessionSourceIndexCache.hpp"
 #include "clang/DefinitionIndex.hpp"
 
 #include <core/Macros.hpp>
@@ -69,6 +78,10 @@ namespace code_search {
 
 namespace {
 
+// incremented whenever an index searched by searchSource changes (main
+// thread only)
+unsigned s_sourceIndexGeneration = 0;
+
 bool isInCmakeBuildDirectory(const FilePath& filePath)
 {
    FilePath parentPath = filePath.parent();
@@ -114,26 +127,60 @@ bool enforceMaxResults(std::size_t maxResults,
 }
 
 
+// mask of the (lowercased) characters which appear in the first n
+// characters of str. a term can only be a subsequence of a name if its
+// mask is contained in the name's mask, which lets searches reject most
+// names without doing a full subsequence match
+boost::uint64_t characterMask(const std::string& str,
+                              std::string::size_type n = std::string::npos)
+{
+   boost::uint64_t mask = 0;
+   n = std::min(n, str.length());
+   for (std::string::size_type i = 0; i < n; ++i)
+   {
+      unsigned char ch = std::tolower(static_cast<unsigned char>(str[i]));
+      mask |= static_cast<boost::uint64_t>(1) << (ch % 64);
+   }
+   return mask;
+}
+
 // index entries we are managing
 struct Entry
 {
    explicit Entry()
+      : nameMask(0), isSourceFile(false)
    {
    }
 
    explicit Entry(const FileInfo& fileInfo)
-      : fileInfo(fileInfo)
+      : fileInfo(fileInfo), nameMask(0), isSourceFile(false)
    {
    }
    
    Entry(const FileInfo& fileInfo,
          boost::shared_ptr<core::r_util::RSourceIndex> pIndex)
-      : fileInfo(fileInfo), pIndex(pIndex)
+      : fileInfo(fileInfo), pIndex(pIndex), nameMask(0), isSourceFile(false)
    {
    }
    
    FileInfo fileInfo;
    boost::shared_ptr<core::r_util::RSourceIndex> pIndex;
+
+   // file name information used by searchFiles (computed once when the
+   // entry is indexed rather than for every entry on every search)
+   std::string name;
+   std::string lowerName;
+   boost::uint64_t nameMask;
+   bool isSourceFile;
+
+   void setSearchInfo(bool sourceFile)
+   {
+      std::string path = fileInfo.absolutePath();
+      name = path.substr(path.rfind('/') + 1);
+      lowerName = boost::algorithm::to_lower_copy(name);
+      nameMask = characterMask(lowerName);
+      isSourceFile = sourceFile;
+   }
    
    bool hasIndex() const { return pIndex.get() != NULL; }
    
@@ -149,8 +196,7 @@ struct Entry
    
    friend bool isSamePath(const Entry& lhs, const Entry& rhs)
    {
-      return lhs.fileInfo.absolutePath() ==
-             rhs.fileInfo.absolutePath();
+      return lhs.fileInfo.hasSamePath(rhs.fileInfo);
    }
 };
 
@@ -405,11 +451,76 @@ private:
    
 };
 
+// R source files are read and indexed on the worker pool. results are
+// merged into the index on the main thread (which is the only thread that
+// touches the entry tree)
+struct IndexResult
+{
+   IndexResult() : generation(0) {}
+
+   FileInfo fileInfo;
+   std::string context;
+   std::string encoding;
+   unsigned generation;
+   boost::shared_ptr<r_util::RSourceIndex> pIndex;
+};
+
+typedef core::thread::ThreadsafeQueue<IndexResult> IndexResultQueue;
+
+// maximum number of files being indexed on the worker pool at once (so
+// the pool remains responsive to the rpc methods which also use it)
+const std::size_t kMaxPendingIndexTasks = 64;
+
+void indexSourceFile(IndexResult result,
+                     boost::shared_ptr<IndexResultQueue> pResults)
+{
+   try
+   {
+      // note that decoding doesn't call back into R (R's iconv wrapper
+      // is safe to use from a background thread)
+      FilePath filePath(result.fileInfo.absolutePath());
+      std::string code;
+      Error error = module_context::readAndDecodeFile(filePath,
+                                                      result.encoding,
+                                                      true,
+                                                      &code);
+      if (error)
+      {
+         // log if not path not found error (this can happen if the
+         // file was removed after entering the indexing queue)
+         if (!core::isPathNotFoundError(error))
+         {
+            error.addProperty("src-file", filePath.absolutePath());
+            LOG_ERROR(error);
+         }
+      }
+      else
+      {
+         result.pIndex.reset(new r_util::RSourceIndex(result.context,
+                                                      code,
+                                                      false));
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   // always return the result (even if indexing failed) so that the
+   // main thread can account for the task
+   pResults->enque(result);
+}
+
 class SourceFileIndex : boost::noncopyable
 {
 public:
    SourceFileIndex()
-      : pEntries_(new EntryTree()), indexing_(false)
+      : pEntries_(new EntryTree()),
+        indexing_(false),
+        pIndexResults_(new IndexResultQueue()),
+        nextGeneration_(0),
+        pendingIndexCount_(0),
+        waitingForWorkers_(false),
+        mergingIndexResults_(false),
+        scanEnqueued_(false),
+        initialIndexingCompleted_(false)
    {
    }
 
@@ -442,7 +553,35 @@ public:
          FileChangeEvent addEvent(FileChangeEvent::FileAdded, *begin);
          indexingQueue_.push(addEvent);
       }
+      scanEnqueued_ = true;
+
+      scheduleIndexing();
+   }
 
+   // index the files indexed by the previous session (which are answered
+   // from the index cache) ahead of the file monitor's scan of the project,
+   // so that searches have results while a large project is still being
+   // scanned. the scan's entries for these files are then no-ops
+   void enqueCachedFiles()
+   {
+      using namespace rstudio::core::system;
+      std::vector<std::string> paths = indexCache_.cachedPaths();
+      BOOST_FOREACH(const std::string& path, paths)
+      {
+         FilePath filePath(path);
+         if (!filePath.exists())
+            continue;
+
+         FileChangeEvent addEvent(FileChangeEvent::FileAdded,
+                                  core::toFileInfo(filePath));
+         indexingQueue_.push(addEvent);
+      }
+
+      scheduleIndexing();
+   }
+
+   void scheduleIndexing()
+   {
       // schedule indexing if necessary. perform up to 200ms of work
       // immediately and then continue in periodic 20ms chunks until
       // we are completed.
@@ -563,6 +702,16 @@ public:
 
       // create wildcard pattern if the search has a '*'
       boost::regex pattern = regex_utils::regexIfWildcardPattern(term);
+
+      // We allow the user to submit queries of the form e.g.
+      // <query>:<row><column>; make sure we only take items
+      // on the query up to ':'
+      std::string::size_type queryEnd = term.find(":");
+      if (queryEnd == std::string::npos)
+         queryEnd = term.length();
+      std::string lowerTerm = boost::algorithm::to_lower_copy(
+                                                   term.substr(0, queryEnd));
+      boost::uint64_t termMask = characterMask(lowerTerm);
       
       // get the start and end iterators -- default to all leaves
       EntryTree::leaf_iterator it = pEntries_->begin_leaf();
@@ -593,18 +742,14 @@ public:
          DEBUG("Node: '" << (*it).fileInfo.absolutePath() << "'");
          
          // skip if it's not a source file
-         if (sourceFilesOnly && !isSourceFile(entry.fileInfo))
+         if (sourceFilesOnly && !entry.isSourceFile)
             continue;
-         
-         // get file and name
-         FilePath filePath(entry.fileInfo.absolutePath());
-         std::string name = filePath.filename();
 
          // compare for match (wildcard or standard)
          bool matches = false;
          if (!pattern.empty())
          {
-            matches = regex_utils::textMatches(name,
+            matches = regex_utils::textMatches(entry.name,
                                                pattern,
                                                prefixOnly,
                                                false);
@@ -612,20 +757,12 @@ public:
          else
          {
             if (prefixOnly)
-               matches = boost::algorithm::istarts_with(name, term);
+               matches = boost::algorithm::istarts_with(entry.name, term);
             else
             {
-               // We allow the user to submit queries of the form e.g.
-               // <query>:<row><column>; make sure we only take items
-               // on the query up to ':'
-               std::string::size_type queryEnd = term.find(":");
-               if (queryEnd == std::string::npos)
-                  queryEnd = term.length();
-
-               matches = string_utils::isSubsequence(name,
-                                                     term,
-                                                     queryEnd,
-                                                     true);
+               matches = (termMask & ~entry.nameMask) == 0 &&
+                         string_utils::isSubsequence(entry.lowerName,
+                                                     lowerTerm);
             }
          }
 
@@ -633,7 +770,8 @@ public:
          if (matches)
          {
             // name and aliased path
-            pNames->push_back(filePath.filename());
+            FilePath filePath(entry.fileInfo.absolutePath());
+            pNames->push_back(entry.name);
             pPaths->push_back(module_context::createAliasedPath(filePath));
 
             // return if we are past max results
@@ -738,6 +876,24 @@ public:
       }
    }
    
+   // list the files and folders beneath parentPath (depth first). returns
+   // false if the path isn't in the index or the initial indexing pass is
+   // still underway (when the tree may be incomplete)
+   bool listFilesAndFolders(const FilePath& parentPath,
+                            std::vector<std::string>* pPaths)
+   {
+      if (!initialIndexingCompleted_)
+         return false;
+
+      Entry parentEntry(core::toFileInfo(parentPath));
+      EntryTree::iterator parentItr = pEntries_->find(parentEntry);
+      if (parentItr == pEntries_->end())
+         return false;
+
+      appendDescendants(parentItr, pPaths);
+      return true;
+   }
+
    void walkFiles(const FilePath& parentPath,
                   boost::function<void(const Entry&)> operation,
                   boost::function<bool(const Entry&)> filter = NULL)
@@ -760,11 +916,48 @@ public:
       }
    }
    
+   void appendDescendants(const EntryTree::iterator_base& parentItr,
+                          std::vector<std::string>* pPaths)
+   {
+      EntryTree::sibling_iterator it = pEntries_->begin(parentItr);
+      EntryTree::sibling_iterator end = pEntries_->end(parentItr);
+      for (; it != end; ++it)
+      {
+         // Avoid dummy nodes
+         const FileInfo& fileInfo = (*it).fileInfo;
+         if (!fileInfo.empty())
+            pPaths->push_back(fileInfo.absolutePath());
+
+         appendDescendants(it, pPaths);
+      }
+   }
+
+   void setIndexCacheFile(const FilePath& cacheFile,
+                          const std::string& encoding)
+   {
+      indexCache_.setCacheFile(cacheFile, encoding);
+   }
+
+   void saveIndexCache()
+   {
+      Error error = indexCache_.save(false);
+      if (error)
+         LOG_ERROR(error);
+   }
+
    void clear()
    {
+      indexCache_.close();
+      scanEnqueued_ = false;
+      initialIndexingCompleted_ = false;
       indexing_ = false;
       indexingQueue_ = std::queue<core::system::FileChangeEvent>();
       pEntries_->clear();
+      ++s_sourceIndexGeneration;
+
+      // discard the results of any files currently being indexed
+      indexGenerations_.clear();
+      waitingForWorkers_ = false;
    }
 
 private:
@@ -775,6 +968,15 @@ private:
 
       if (!indexingQueue_.empty())
       {
+         // if the worker pool has its fill of files to index then stop
+         // for now (we'll be rescheduled when results come back)
+         if (pendingIndexCount_ >= kMaxPendingIndexTasks)
+         {
+            waitingForWorkers_ = true;
+            indexing_ = false;
+            return false;
+         }
+
          // remove the event from the queue
          FileChangeEvent event = indexingQueue_.front();
          indexingQueue_.pop();
@@ -803,9 +1005,25 @@ private:
 
       // return status
       indexing_ = !indexingQueue_.empty();
+      if (!indexing_ && !waitingForWorkers_ && pendingIndexCount_ == 0)
+         onIndexingCompleted();
       return indexing_;
    }
 
+   void onIndexingCompleted()
+   {
+      // save the cache once the initial indexing pass is complete (every
+      // file has been visited at that point, so entries for files which no
+      // longer exist can be dropped). later changes are saved at shutdown
+      if (!initialIndexingCompleted_ && scanEnqueued_)
+      {
+         initialIndexingCompleted_ = true;
+         Error error = indexCache_.save(true);
+         if (error)
+            LOG_ERROR(error);
+      }
+   }
+
    void updateIndexEntry(const FileInfo& fileInfo)
    {
       // index the source if necessary
@@ -815,15 +1033,58 @@ private:
       FilePath filePath(fileInfo.absolutePath());
 
       // filter certain directories (e.g. those that exist in build directories)
-      if (isInCmakeBuildDirectory(filePath))
+      if (isInCmakeBuildDirectory(filePath) ||
+          filePath.isWithin(projects::projectContext().directory().complete("packrat")))
+      {
          return;
+      }
 
       if (isIndexableSourceFile(fileInfo))
       {
+         // nothing to do if we've already indexed this version of the file
+         // (e.g. it was indexed from the cache ahead of the scan)
+         EntryTree::iterator it = pEntries_->find(Entry(fileInfo));
+         if (pEntries_->is_valid(it) && it != pEntries_->end() &&
+             it->pIndex &&
+             it->fileInfo.lastWriteTime() != 0 &&
+             it->fileInfo.lastWriteTime() == fileInfo.lastWriteTime() &&
+             it->fileInfo.size() == fileInfo.size())
+         {
+            return;
+         }
+
+         // use the index from the previous session if the file hasn't
+         // changed since then
+         std::string context = module_context::createAliasedPath(filePath);
+         pIndex = indexCache_.lookup(fileInfo, context);
+         if (pIndex)
+         {
+            insertIndexEntry(Entry(fileInfo, pIndex));
+            return;
+         }
+
+         // index on the worker pool if we can (the entry is inserted once
+         // the index is merged)
+         IndexResult request;
+         request.fileInfo = fileInfo;
+         request.context = context;
+         request.encoding = projects::projectContext().defaultEncoding();
+         request.generation = ++nextGeneration_;
+         if (worker_pool::execute(boost::bind(indexSourceFile,
+                                              request,
+                                              pIndexResults_),
+                                  core::thread::TaskPriorityLow))
+         {
+            indexGenerations_[fileInfo.absolutePath()] = request.generation;
+            ++pendingIndexCount_;
+            scheduleMergeIndexResults();
+            return;
+         }
+
          std::string code;
          Error error = module_context::readAndDecodeFile(
                                  filePath,
-                                 projects::projectContext().defaultEncoding(),
+                                 request.encoding,
                                  true,
                                  &code);
          if (error)
@@ -839,32 +1100,99 @@ private:
          }
 
          // add index entry
-         std::string context = module_context::createAliasedPath(filePath);
-         pIndex.reset(new r_util::RSourceIndex(context, code));
+         pIndex.reset(new r_util::RSourceIndex(request.context, code));
+         indexCache_.update(fileInfo, *pIndex);
       }
 
+      insertIndexEntry(Entry(fileInfo, pIndex));
+   }
+
+   void insertIndexEntry(Entry entry)
+   {
       // attempt to add the entry
-      Entry entry(fileInfo, pIndex);
+      entry.setSearchInfo(isSourceFile(entry.fileInfo));
+      pEntries_->insertEntry(entry);
+      ++s_sourceIndexGeneration;
+
+      // kick off an update
+      r_packages::AsyncPackageInformationProcess::update();
+   }
 
-      if (!filePath.isWithin(projects::projectContext().directory().complete("packrat")) &&
-          !isInCmakeBuildDirectory(filePath))
+   void scheduleMergeIndexResults()
+   {
+      if (!mergingIndexResults_)
       {
-         pEntries_->insertEntry(entry);
+         mergingIndexResults_ = true;
+         module_context::schedulePeriodicWork(
+                  boost::posix_time::milliseconds(50),
+                  boost::bind(&SourceFileIndex::mergeIndexResults, this),
+                  false /* merge even when non-idle */,
+                  false /* not immediate */,
+                  module_context::WorkPriorityLow);
+      }
+   }
 
-         // kick off an update
-         r_packages::AsyncPackageInformationProcess::update();
+   bool mergeIndexResults()
+   {
+      IndexResult result;
+      while (pIndexResults_->deque(&result))
+      {
+         --pendingIndexCount_;
+
+         // skip results which were superseded by a later change to the
+         // file (or its removal) while it was being indexed
+         std::map<std::string, unsigned>::iterator it =
+               indexGenerations_.find(result.fileInfo.absolutePath());
+         if (it == indexGenerations_.end() ||
+             it->second != result.generation)
+         {
+            continue;
+         }
+         indexGenerations_.erase(it);
+
+         if (!result.pIndex)
+            continue;
+
+         result.pIndex->publishInferredPackages();
+         indexCache_.update(result.fileInfo, *result.pIndex);
+         insertIndexEntry(Entry(result.fileInfo, result.pIndex));
+      }
+
+      // resume indexing if we stopped to wait for the workers
+      if (waitingForWorkers_ && pendingIndexCount_ < kMaxPendingIndexTasks)
+      {
+         waitingForWorkers_ = false;
+         if (!indexing_ && !indexingQueue_.empty())
+         {
+            indexing_ = true;
+            module_context::scheduleIncrementalWork(
+                           boost::posix_time::milliseconds(20),
+                           boost::bind(&SourceFileIndex::dequeAndIndex, this),
+                           false /* allow indexing even when non-idle */);
+         }
       }
 
+      mergingIndexResults_ = pendingIndexCount_ > 0;
+      if (!mergingIndexResults_ && !indexing_)
+         onIndexingCompleted();
+      return mergingIndexResults_;
    }
 
    void removeIndexEntry(const FileInfo& fileInfo)
    {
+      // discard the results of indexing the file if it's in progress
+      indexGenerations_.erase(fileInfo.absolutePath());
+      indexCache_.remove(fileInfo);
+
       // create a fake entry with a null source index to pass to find
       Entry entry(fileInfo, boost::shared_ptr<r_util::RSourceIndex>());
 
       EntryTree::iterator it = pEntries_->find(entry);
       if (it != pEntries_->end())
+      {
          pEntries_->erase(it);
+         ++s_sourceIndexGeneration;
+      }
       else
       {
          DEBUG("Failed to remove index entry for file: '" << fileInfo.absolutePath() << "'");
@@ -921,6 +1249,25 @@ public:
    
    boost::shared_ptr<EntryTree> entries() const { return pEntries_; }
 
+   // approximate bytes held by the entries and their indexes
+   std::size_t memoryUsage() const
+   {
+      std::size_t bytes = 0;
+      for (EntryTree::iterator it = pEntries_->begin();
+           it != pEntries_->end();
+           ++it)
+      {
+         const Entry& entry = *it;
+         bytes += sizeof(Entry) +
+                  entry.fileInfo.absolutePath().capacity() +
+                  entry.name.capacity() +
+                  entry.lowerName.capacity();
+         if (entry.pIndex)
+            bytes += entry.pIndex->memoryUsage();
+      }
+      return bytes;
+   }
+
 private:
    // index entries
    boost::shared_ptr<EntryTree> pEntries_;
@@ -928,6 +1275,20 @@ private:
    // indexing queue
    bool indexing_;
    std::queue<core::system::FileChangeEvent> indexingQueue_;
+
+   // files being indexed on the worker pool (the generation identifies
+   // the most recent request for each path)
+   boost::shared_ptr<IndexResultQueue> pIndexResults_;
+   std::map<std::string, unsigned> indexGenerations_;
+   unsigned nextGeneration_;
+   std::size_t pendingIndexCount_;
+   bool waitingForWorkers_;
+   bool mergingIndexResults_;
+
+   // indexes saved by previous sessions
+   SourceIndexCache indexCache_;
+   bool scanEnqueued_;
+   bool initialIndexingCompleted_;
 };
 
 } // anonymous namespace
@@ -972,6 +1333,7 @@ void RSourceIndexes::update(const boost::shared_ptr<SourceDocument>& pDoc)
    
    // insert it
    idMap_[pDoc->id()] = pIndex;
+   ++s_sourceIndexGeneration;
    
    // create aliases
    filePathMap_[filePath.absolutePath()] = pIndex;
@@ -988,6 +1350,7 @@ void RSourceIndexes::remove(const std::string& id)
    idMap_.erase(id);
    filePathMap_.erase(filePath.absolutePath());
    idToFilePathMap_.erase(id);
+   ++s_sourceIndexGeneration;
 }
 
 void RSourceIndexes::removeAll()
@@ -995,6 +1358,7 @@ void RSourceIndexes::removeAll()
    idMap_.clear();
    filePathMap_.clear();
    idToFilePathMap_.clear();
+   ++s_sourceIndexGeneration;
 }
 
 RSourceIndexes& rSourceIndex()
@@ -1103,6 +1467,20 @@ boost::shared_ptr<r_util::RSourceIndex> getIndexedProjectFile(
    return s_projectIndex.get(filePath);
 }
 
+bool listIndexedFilesAndFolders(const FilePath& parentPath,
+                                std::vector<std::string>* pPaths)
+{
+   if (!projects::projectContext().isMonitoringDirectory(parentPath))
+      return false;
+
+   return s_projectIndex.listFilesAndFolders(parentPath, pPaths);
+}
+
+unsigned sourceIndexGeneration()
+{
+   return s_sourceIndexGeneration;
+}
+
 void searchSource(const std::string& term,
                   std::size_t maxResults,
                   bool prefixOnly,
@@ -1247,12 +1625,17 @@ void searchFiles(const std::string& term,
    }
 }
 
-// NOTE: When modifying this code, you should ensure that corresponding
-// changes are made to the client side scoreMatch function as well
-// (See: CodeSearchOracle.java)
+namespace {
+
+// scores a suggestion against a query which has already been lowercased
+// (pMatches and pLowerSuggestion are scratch buffers, so that scoring many
+// suggestions doesn't allocate for each one)
 int scoreMatch(std::string const& suggestion,
                std::string const& query,
-               bool isFile)
+               std::string const& lowerQuery,
+               bool isFile,
+               std::string* pLowerSuggestion,
+               std::vector<int>* pMatches)
 {
    // No penalty for perfect matches
    if (suggestion == query)
@@ -1262,15 +1645,28 @@ int scoreMatch(std::string const& suggestion,
 
    // Call a version of subsequence indices that returns false if the query is not
    // actually a subsequence
-   std::vector<int> matches;
-   bool success = string_utils::subsequenceIndices(
-            boost::algorithm::to_lower_copy(suggestion),
-            boost::algorithm::to_lower_copy(query),
-            &matches);
+   pLowerSuggestion->assign(suggestion);
+   boost::algorithm::to_lower(*pLowerSuggestion);
+   bool success = string_utils::subsequenceIndices(*pLowerSuggestion,
+                                                   lowerQuery,
+                                                   pMatches);
    
    if (!success)
       return -1;
 
+   const std::vector<int>& matches = *pMatches;
+
+   // More penalty (for each matched character) for 'uninteresting' files
+   // and extensions (e.g. .Rd)
+   int uninterestingPenalty = 0;
+   if (suggestion == "RcppExports.R" ||
+       suggestion == "RcppExports.cpp")
+      uninterestingPenalty += 6;
+   
+   std::string extension = string_utils::getExtension(suggestion);
+   if (boost::algorithm::to_lower_copy(extension) == ".rd")
+      uninterestingPenalty += 6;
+
    int totalPenalty = 0;
 
    // Loop over the matches and assign a score
@@ -1292,15 +1688,7 @@ int scoreMatch(std::string const& suggestion,
       // Less penalty for perfect match (ie, reward case-sensitive match)
       penalty -= suggestion[matchPos] == query[j];
       
-      // More penalty for 'uninteresting' files
-      if (suggestion == "RcppExports.R" ||
-          suggestion == "RcppExports.cpp")
-         penalty += 6;
-      
-      // More penalty for 'uninteresting' extensions (e.g. .Rd)
-      std::string extension = string_utils::getExtension(suggestion);
-      if (boost::algorithm::to_lower_copy(extension) == ".rd")
-         penalty += 6;
+      penalty += uninterestingPenalty;
 
       totalPenalty += penalty;
    }
@@ -1312,6 +1700,47 @@ int scoreMatch(std::string const& suggestion,
    return totalPenalty;
 }
 
+} // anonymous namespace
+
+// NOTE: When modifying this code, you should ensure that corresponding
+// changes are made to the client side scoreMatch function as well
+// (See: CodeSearchOracle.java)
+int scoreMatch(std::string const& suggestion,
+               std::string const& query,
+               bool isFile)
+{
+   std::string lowerSuggestion;
+   std::vector<int> matches;
+   return scoreMatch(suggestion,
+                     query,
+                     boost::algorithm::to_lower_copy(query),
+                     isFile,
+                     &lowerSuggestion,
+                     &matches);
+}
+
+// score a batch of suggestions against the same query
+void scoreMatches(std::vector<std::string> const& suggestions,
+                  std::string const& query,
+                  bool isFile,
+                  std::vector<int>* pScores)
+{
+   std::string lowerQuery = boost::algorithm::to_lower_copy(query);
+   std::string lowerSuggestion;
+   std::vector<int> matches;
+
+   pScores->reserve(pScores->size() + suggestions.size());
+   BOOST_FOREACH(const std::string& suggestion, suggestions)
+   {
+      pScores->push_back(scoreMatch(suggestion,
+                                    query,
+                                    lowerQuery,
+                                    isFile,
+                                    &lowerSuggestion,
+                                    &matches));
+   }
+}
+
 struct ScorePairComparator
 {
    inline bool operator()(const std::pair<int, int> lhs,
@@ -1516,22 +1945,24 @@ SourceItem fromCppDefinition(const clang::CppDefinition& cppDefinition)
       safe_convert::numberTo<int>(cppDefinition.location.column, 1));
 }
 
-template <typename TValue, typename TFunc>
-json::Array toJsonArray(
-      const std::vector<SourceItem> &items,
-      TFunc memberFunc)
-{
-   json::Array col;
-   std::transform(items.begin(),
-                  items.end(),
-                  std::back_inserter(col),
-                  boost::bind(json::toJsonValue<TValue>,
-                                 boost::bind(memberFunc, _1)));
-   return col;
+template <typename TValue>
+void writeColumn(json::Writer* pWriter,
+                 const std::string& name,
+                 const std::vector<SourceItem>& items,
+                 TValue (SourceItem::*memberFunc)() const)
+{
+   pWriter->key(name);
+   pWriter->startArray();
+   for (std::vector<SourceItem>::const_iterator it = items.begin();
+        it != items.end();
+        ++it)
+   {
+      pWriter->value(((*it).*memberFunc)());
+   }
+   pWriter->endArray();
 }
 
 
-
 Error searchCode(const json::JsonRpcRequest& request,
                  json::JsonRpcResponse* pResponse)
 {
@@ -1544,9 +1975,6 @@ Error searchCode(const json::JsonRpcRequest& request,
    std::size_t maxResults = safe_convert::numberTo<std::size_t>(maxResultsInt,
                                                                 20);
 
-   // object to return
-   json::Object result;
-
    // search files
    std::vector<std::string> names;
    std::vector<std::string> paths;
@@ -1579,10 +2007,12 @@ Error searchCode(const json::JsonRpcRequest& request,
    typedef std::pair<int, int> PairIntInt;
 
    // score matches -- returned as a pair, mapping index to score
+   std::vector<int> scores;
+   scoreMatches(names, term, true, &scores);
    std::vector<PairIntInt> fileScores;
    for (std::size_t i = 0; i < paths.size(); ++i)
    {
-      fileScores.push_back(std::make_pair(i, scoreMatch(names[i], term, true)));
+      fileScores.push_back(std::make_pair(i, scores[i]));
    }
 
    // sort by score (lower is better)
@@ -1629,28 +2059,36 @@ Error searchCode(const json::JsonRpcRequest& request,
       srcItemsFiltered.push_back(srcItems[pair.first]);
    }
 
-   // fill result
-   json::Object files;
-   files["filename"] = json::toJsonArray(namesFiltered);
-   files["path"] = json::toJsonArray(pathsFiltered);
-   result["file_items"] = files;
+   // stream result (avoids building a json::Value for each item)
+   json::Writer writer;
+   writer.startObject();
+
+   writer.key("file_items");
+   writer.startObject();
+   writer.key("filename");
+   writer.array(namesFiltered);
+   writer.key("path");
+   writer.array(pathsFiltered);
+   writer.endObject();
 
    // return rpc array list (wire efficiency)
-   json::Object src;
-   src["type"] = toJsonArray<int>(srcItemsFiltered, &SourceItem::type);
-   src["name"] = toJsonArray<std::string>(srcItemsFiltered, &SourceItem::name);
-   src["parent_name"] = toJsonArray<std::string>(srcItemsFiltered, &SourceItem::parentName);
-   src["extra_info"] = toJsonArray<std::string>(srcItemsFiltered, &SourceItem::extraInfo);
-   src["context"] = toJsonArray<std::string>(srcItemsFiltered, &SourceItem::context);
-   src["line"] = toJsonArray<int>(srcItemsFiltered, &SourceItem::line);
-   src["column"] = toJsonArray<int>(srcItemsFiltered, &SourceItem::column);
-   result["source_items"] = src;
+   writer.key("source_items");
+   writer.startObject();
+   writeColumn(&writer, "type", srcItemsFiltered, &SourceItem::type);
+   writeColumn(&writer, "name", srcItemsFiltered, &SourceItem::name);
+   writeColumn(&writer, "parent_name", srcItemsFiltered, &SourceItem::parentName);
+   writeColumn(&writer, "extra_info", srcItemsFiltered, &SourceItem::extraInfo);
+   writeColumn(&writer, "context", srcItemsFiltered, &SourceItem::context);
+   writeColumn(&writer, "line", srcItemsFiltered, &SourceItem::line);
+   writeColumn(&writer, "column", srcItemsFiltered, &SourceItem::column);
+   writer.endObject();
 
    // set more available bit
-   result["more_available"] =
-         moreFilesAvailable || moreSourceItemsAvailable;
+   writer.member("more_available",
+                 moreFilesAvailable || moreSourceItemsAvailable);
 
-   pResponse->setResult(result);
+   writer.endObject();
+   pResponse->setRawResult(writer.str());
 
    return Success();
 }
@@ -1770,7 +2208,7 @@ public:
    explicit FunctionInfo(const std::string& name)
       : name_(name)
    {
-      boost::regex pattern("^([^{]+)\\{([^}]+)\\}$");
+      static const boost::regex pattern("^([^{]+)\\{([^}]+)\\}$");
       boost::smatch match;
       if (boost::regex_search(name_, match, pattern))
       {
@@ -2077,7 +2515,7 @@ Error guessFunctionToken(const std::string& line,
       return error;
 
    // see if it has a namespace qualifier
-   boost::regex pattern("^([^:]+):{2,3}([^:]+)$");
+   static const boost::regex pattern("^([^:]+):{2,3}([^:]+)$");
    boost::smatch match;
    if (boost::regex_search(token, match, pattern))
    {
@@ -2246,8 +2684,24 @@ Error findFunctionInSearchPath(const json::JsonRpcRequest& request,
    return Success();
 }
 
+void setProjectIndexCacheFile()
+{
+   s_projectIndex.setIndexCacheFile(
+         projects::projectContext().scratchPath().complete("source-index-cache"),
+         projects::projectContext().defaultEncoding());
+}
+
+void onDeferredInit(bool newSession)
+{
+   // start with the files indexed by the previous session (the file
+   // monitor is scanning the project in the meantime)
+   setProjectIndexCacheFile();
+   s_projectIndex.enqueCachedFiles();
+}
+
 void onFileMonitorEnabled(const tree<core::FileInfo>& files)
 {
+   setProjectIndexCacheFile();
    s_projectIndex.enqueFiles(files.begin_leaf(), files.end_leaf());
 }
 
@@ -2259,6 +2713,11 @@ void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
          boost::bind(&SourceFileIndex::enqueFileChange, &s_projectIndex, _1));
 }
 
+void onShutdown(bool terminatedNormally)
+{
+   s_projectIndex.saveIndexCache();
+}
+
 void onFileMonitorDisabled()
 {
    // clear the index so we don't ever get stale results
@@ -2273,12 +2732,8 @@ SEXP rs_scoreMatches(SEXP suggestionsSEXP,
    if (!r::sexp::fillVectorString(suggestionsSEXP, &suggestions))
       return R_NilValue;
    
-   int n = suggestions.size();
    std::vector<int> scores;
-   scores.reserve(n);
-   
-   for (int i = 0; i < n; i++)
-      scores.push_back(scoreMatch(suggestions[i], query, false));
+   scoreMatches(suggestions, query, false, &scores);
    
    r::sexp::Protect protect;
    return r::sexp::create(scores, &protect);
@@ -2389,6 +2844,11 @@ SEXP rs_viewFunction(SEXP functionSEXP, SEXP nameSEXP, SEXP namespaceSEXP)
    return R_NilValue;
 }
 
+std::size_t projectIndexMemoryUsage()
+{
+   return s_projectIndex.memoryUsage();
+}
+
 } // anonymous namespace
    
 Error initialize()
@@ -2401,6 +2861,14 @@ Error initialize()
    cb.onMonitoringDisabled = onFileMonitorDisabled;
    projects::projectContext().subscribeToFileMonitor("R source file indexing",
                                                      cb);
+   if (projects::projectContext().hasProject() &&
+       projects::projectContext().config().enableCodeIndexing)
+   {
+      module_context::events().onDeferredInit.connect(onDeferredInit);
+   }
+   module_context::events().onShutdown.connect(onShutdown);
+   memory_usage::registerReporter("code_search_index",
+                                  projectIndexMemoryUsage);
    
    // register viewFunction method
    R_CallMethodDef methodDef ;
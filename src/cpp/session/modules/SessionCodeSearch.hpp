@@ -104,6 +104,16 @@ RSourceIndexes& rSourceIndex();
 boost::shared_ptr<core::r_util::RSourceIndex> getIndexedProjectFile(
       const core::FilePath& filePath);
 
+// list the files and folders beneath a directory within the project from the
+// project's file index (returns false if the directory isn't monitored or the
+// index isn't yet complete)
+bool listIndexedFilesAndFolders(const core::FilePath& parentPath,
+                                std::vector<std::string>* pPaths);
+
+// changes whenever the indexes searched by searchSource change (so that
+// callers can reuse search results until then)
+unsigned sourceIndexGeneration();
+
 void searchSource(const std::string& term,
                   std::size_t maxResults,
                   bool prefixOnly,
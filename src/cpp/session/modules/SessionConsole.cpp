@@ -16,6 +16,8 @@
 
 #include "SessionConsole.hpp"
 
+#include <algorithm>
+
 #include <boost/algorithm/string/predicate.hpp>
 
 #include <core/Error.hpp>
@@ -133,6 +135,32 @@ Error resetConsoleActions(const json::JsonRpcRequest& request,
    return Success();
 }
 
+// page backwards through output which was collapsed because it exceeded the
+// console output limits ("load more"). offset is the number of bytes of the
+// most recent collapsed output which have already been loaded
+Error getCollapsedConsoleOutput(const json::JsonRpcRequest& request,
+                                json::JsonRpcResponse* pResponse)
+{
+   int offset, maxBytes;
+   Error error = json::readParams(request.params, &offset, &maxBytes);
+   if (error)
+      return error;
+
+   std::string output;
+   std::size_t remaining = module_context::collapsedConsoleOutput(
+                                    std::max(offset, 0),
+                                    std::max(maxBytes, 0),
+                                    &output);
+
+   json::Object resultJson;
+   resultJson["output"] = output;
+   resultJson["offset"] = static_cast<int>(std::max(offset, 0) + output.size());
+   resultJson["remaining"] = static_cast<int>(remaining);
+   pResponse->setResult(resultJson);
+
+   return Success();
+}
+
 SEXP rs_getPendingInput()
 {
    r::sexp::Protect rProtect;
@@ -172,7 +200,9 @@ Error initialize()
    ExecBlock initBlock ;
    initBlock.addFunctions()
       (bind(sourceModuleRFile, "SessionConsole.R"))
-      (bind(registerRpcMethod, "reset_console_actions", resetConsoleActions));
+      (bind(registerRpcMethod, "reset_console_actions", resetConsoleActions))
+      (bind(registerRpcMethod, "get_collapsed_console_output",
+                               getCollapsedConsoleOutput));
 
    return initBlock.execute();
 }
@@ -22,6 +22,7 @@
 
 #include "SessionCodeSearch.hpp"
 #include "SessionAsyncPackageInformation.hpp"
+#include "SessionPackageSymbolCache.hpp"
 #include "SessionRParser.hpp"
 
 #include <set>
@@ -30,11 +31,14 @@
 #include <core/Exec.hpp>
 #include <core/Error.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/Thread.hpp>
 
 #include <session/SessionRUtil.hpp>
 #include <session/SessionUserSettings.hpp>
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionSourceDatabase.hpp>
+#include <session/SessionWorkerPool.hpp>
 #include <session/projects/SessionProjects.hpp>
 
 #include "shiny/SessionShiny.hpp"
@@ -234,20 +238,34 @@ public:
    {
       if (!registry_.count(pkgName))
       {
-         SEXP envSEXP = r::sexp::asNamespace(pkgName);
-         if (envSEXP == R_EmptyEnv)
-            return;
-
-         if (exportsOnly)
-         {
-            Error error = r::sexp::getNamespaceExports(envSEXP, &registry_[pkgName]);
-            if (error) LOG_ERROR(error);
-         }
-         else
+         // use the symbols cached by an earlier session if the namespace
+         // isn't loaded, so that we don't need to load it
+         bool isLoaded = r::sexp::findNamespace(pkgName) != R_UnboundValue;
+         std::vector<std::string> symbols;
+         if (isLoaded ||
+             !package_symbol_cache::lookup(pkgName, exportsOnly, &symbols))
          {
-            Error error = r::sexp::objects(envSEXP, true, &registry_[pkgName]);
-            if (error) LOG_ERROR(error);
+            SEXP envSEXP = r::sexp::asNamespace(pkgName);
+            if (envSEXP == R_EmptyEnv)
+               return;
+
+            Error error = exportsOnly ?
+                     r::sexp::getNamespaceExports(envSEXP, &symbols) :
+                     r::sexp::objects(envSEXP, true, &symbols);
+            if (error)
+            {
+               LOG_ERROR(error);
+            }
+            else if (!isLoaded)
+            {
+               // only cache namespaces we loaded ourselves (an already
+               // loaded namespace may not be the installed package, e.g.
+               // if it was loaded with devtools::load_all())
+               package_symbol_cache::update(pkgName, exportsOnly, symbols);
+            }
          }
+         
+         registry_[pkgName].swap(symbols);
       }
       
       const std::vector<std::string>& symbols = registry_[pkgName];
@@ -325,9 +343,10 @@ void addRcppExportedSymbols(const FilePath& filePath,
 //
 // We don't want to search for symbols on the search path here,
 // since they would not get properly resolved at runtime.
-Error getAvailableSymbolsForPackage(const FilePath& filePath,
-                                    const std::string& documentId,
-                                    std::set<std::string>* pSymbols)
+//
+// Symbols specific to a particular file (e.g. those made available by
+// `library()` calls within it) are added by 'addFileAvailableRSymbols()'.
+Error getAvailableSymbolsForPackage(std::set<std::string>* pSymbols)
 {
    // Add project symbols (ie, top-level symbols within an R package)
    code_search::addAllProjectSymbols(pSymbols);
@@ -335,13 +354,6 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
    // Symbols inferred from the NAMESPACE (importFrom, import)
    addNamespaceSymbols(pSymbols);
    
-   // Add symbols made available by explicit `library()` calls
-   // within this document.
-   addInferredSymbols(filePath, documentId, pSymbols);
-   
-   // Add in symbols that would be made available by `// [[Rcpp::export]]`
-   addRcppExportedSymbols(filePath, documentId, pSymbols);
-   
    // Symbols that are 'automatically' made available to packages. In other
    // words, symbols that packages can use without explicitly importing them.
    // In other words, symbols that `R CMD check` will silently resolve to one
@@ -358,23 +370,10 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
 // For a generic R project, we are less strict on where we attempt
 // to discover objects -- we simply consider all symbols available on
 // the current search path.
-Error getAvailableSymbolsForProject(const FilePath& filePath,
-                                    const std::string& documentId,
-                                    std::set<std::string>* pSymbols)
+Error getAvailableSymbolsForProject(std::set<std::string>* pSymbols)
 {
    // Get all available symbols on the search path.
-   Error error = r::exec::RFunction(".rs.availableRSymbols").call(pSymbols);
-   if (error)
-      return error;
-   
-   // Add in symbols that would be made available by `// [[Rcpp::export]]`
-   addRcppExportedSymbols(filePath, documentId, pSymbols);
-   
-   // Get all of the symbols made available by `library()` calls
-   // within this document.
-   addInferredSymbols(filePath, documentId, pSymbols);
-   
-   return Success();
+   return r::exec::RFunction(".rs.availableRSymbols").call(pSymbols);
 }
 
 void addTestPackageSymbols(std::set<std::string>* pSymbols)
@@ -401,44 +400,60 @@ void addTestPackageSymbols(std::set<std::string>* pSymbols)
       registry.fillNamespaceSymbols("assertthat", pSymbols, false);
 }
 
-Error getAllAvailableRSymbols(const FilePath& filePath,
-                              const std::string& documentId,
-                              const ParseResults& results,
-                              std::set<std::string>* pSymbols)
+bool isPackageSourceFile(const FilePath& filePath)
+{
+   return projects::projectContext().isPackageProject() &&
+          filePath.isWithin(projects::projectContext().directory());
+}
+
+// The symbols available to every file of a particular kind -- that is,
+// source files within the current package, or other R files. These are
+// the expensive symbols to find, since we look them up from R.
+Error getSharedAvailableRSymbols(bool isPackageFile,
+                                 std::set<std::string>* pSymbols)
 {
    // If this file lies within the current project, then
    // we want to pull symbols from specific places -- specifically,
    // _not_ the current search path. We want to infer whether the
    // functions in the package would work at runtime.
-   //
-   // For R package development, when linting a 'test' file, we can
-   // safely assume that the package itself will be loaded.
-   FilePath projDir = projects::projectContext().directory();
-   Error error;
-   
-   if (projects::projectContext().isPackageProject() && filePath.isWithin(projDir))
+   if (isPackageFile)
    {
-      DEBUG("- Package file: '" << filePath.absolutePath() << "'");
-      error = getAvailableSymbolsForPackage(filePath, documentId, pSymbols);
+      DEBUG("- Package file");
+      return getAvailableSymbolsForPackage(pSymbols);
    }
    else
    {
-      DEBUG("- Project file: '" << filePath.absolutePath() << "'");
-      error = getAvailableSymbolsForProject(filePath, documentId, pSymbols);
+      DEBUG("- Project file");
+      return getAvailableSymbolsForProject(pSymbols);
    }
+}
+
+void addFileAvailableRSymbols(const FilePath& filePath,
+                              const std::string& documentId,
+                              const ParseResults& results,
+                              std::set<std::string>* pSymbols)
+{
+   // Add in symbols that would be made available by `// [[Rcpp::export]]`
+   addRcppExportedSymbols(filePath, documentId, pSymbols);
    
-   if (error) LOG_ERROR(error);
+   // Add symbols made available by explicit `library()` calls
+   // within this document.
+   addInferredSymbols(filePath, documentId, pSymbols);
    
+   // For R package development, when linting a 'test' file, we can
+   // safely assume that the package itself will be loaded.
+   //
    // Add common 'testing' packages, based on the DESCRIPTION's
    // 'Imports' and 'Suggests' fields, and use that if we're within a
    // common 'test'ing directory.
+   FilePath projDir = projects::projectContext().directory();
    if (filePath.isWithin(projDir.childPath("inst")) ||
        filePath.isWithin(projDir.childPath("tests")))
    {
       addTestPackageSymbols(pSymbols);
    }
    
-   if (filePath.isWithin(projects::projectContext().directory().childPath("tests/testthat")))
+   if (filePath.isWithin(projDir.childPath("tests/testthat")))
    {
       PackageSymbolRegistry& registry = packageSymbolRegistry();
       registry.fillNamespaceSymbols("testthat", pSymbols, false);
@@ -458,14 +473,38 @@ Error getAllAvailableRSymbols(const FilePath& filePath,
    }
    
    pSymbols->insert(results.globals().begin(), results.globals().end());
+}
+
+// The shared available symbols, looked up once for a batch of files (as
+// when linting a directory) rather than once for each file.
+class SharedRSymbols : boost::noncopyable
+{
+public:
    
-   return error;
+   Error get(const FilePath& filePath,
+             const std::set<std::string>** ppSymbols)
+   {
+      bool isPackageFile = isPackageSourceFile(filePath);
+      if (!symbols_.count(isPackageFile))
+      {
+         errors_[isPackageFile] = getSharedAvailableRSymbols(
+                  isPackageFile,
+                  &symbols_[isPackageFile]);
+      }
       
-}
+      *ppSymbols = &symbols_[isPackageFile];
+      return errors_[isPackageFile];
+   }
+   
+private:
+   std::map<bool, std::set<std::string> > symbols_;
+   std::map<bool, Error> errors_;
+};
 
 void checkNoDefinitionInScope(const FilePath& origin,
                               const std::string& documentId,
-                              ParseResults& results)
+                              ParseResults& results,
+                              SharedRSymbols* pSharedSymbols = NULL)
 {
    ParseNode* pRoot = results.parseTree();
    
@@ -475,21 +514,30 @@ void checkNoDefinitionInScope(const FilePath& origin,
    // Now, find all available R symbols -- that is, objects on the search path,
    // or symbols that would otherwise be made available at runtime (e.g.
    // package imports)
-   std::set<std::string> objects;
-   Error error = getAllAvailableRSymbols(origin, documentId, results, &objects);
+   SharedRSymbols sharedSymbols;
+   if (!pSharedSymbols)
+      pSharedSymbols = &sharedSymbols;
+   
+   const std::set<std::string>* pShared = NULL;
+   Error error = pSharedSymbols->get(origin, &pShared);
    if (error)
    {
       LOG_ERROR(error);
       return;
    }
    
+   std::set<std::string> objects;
+   addFileAvailableRSymbols(origin, documentId, results, &objects);
+   
    // For each unresolved symbol, add it to the lint if it's not on the search
    // path.
    BOOST_FOREACH(const ParseItem& item, unresolvedItems)
    {
+      std::string symbol = string_utils::strippedOfBackQuotes(item.symbol);
       if (!r::util::isRKeyword(item.symbol) &&
           !r::util::isWindowsOnlyFunction(item.symbol) &&
-          objects.count(string_utils::strippedOfBackQuotes(item.symbol)) == 0)
+          pShared->count(symbol) == 0 &&
+          objects.count(symbol) == 0)
       {
          addUnreferencedSymbol(item, results.lint());
       }
@@ -542,7 +590,7 @@ void parseLintOption(const std::string& text, FileLocalLintOptions* pOptions)
 {
    using namespace core::text;
    
-   boost::regex reGlobals("^\\s*suppress\\s*=");
+   static const boost::regex reGlobals("^\\s*suppress\\s*=");
    if (boost::regex_search(text, reGlobals))
       return parseLintOptionGlobals(text, pOptions);
    
@@ -604,7 +652,7 @@ void setFileLocalParseOptions(const std::wstring& rCode,
    using namespace string_utils;
    
    // Extract all of the lint commands.
-   boost::regex reLintComments(kLintComment);
+   static const boost::regex reLintComments(kLintComment);
    std::vector<std::string> lintCommands;
    boost::wsmatch match;
    
@@ -630,15 +678,26 @@ void setFileLocalParseOptions(const std::wstring& rCode,
    applyOptions(options, pOptions);
 }
 
-} // end anonymous namespace
+// The state of the last parse of each open source document, used to
+// re-parse only the parts of a document that change as it is edited
+std::map<std::string, IncrementalParseState> s_parseStates;
 
-ParseResults parse(const std::wstring& rCode,
-                   const FilePath& origin,
-                   const std::string& documentId = std::string(),
-                   bool isExplicit = false)
+void onDocRemoved(const std::string& documentId)
 {
-   ParseResults results;
-   ParseOptions options;
+   s_parseStates.erase(documentId);
+}
+
+void onRemoveAll()
+{
+   s_parseStates.clear();
+}
+
+// returns false if the code asks not to be linted
+bool getParseOptions(const std::wstring& rCode,
+                     bool isExplicit,
+                     ParseOptions* pOptions)
+{
+   ParseOptions& options = *pOptions;
    
    options.setLintRFunctions(
             userSettings().lintRFunctionCalls());
@@ -657,10 +716,38 @@ ParseResults parse(const std::wstring& rCode,
    
    bool noLint = false;
    setFileLocalParseOptions(rCode, &options, &noLint);
-   if (noLint)
+   return !noLint;
+}
+
+void addDiagnostics(const FilePath& origin,
+                    const std::string& documentId,
+                    const ParseOptions& options,
+                    ParseResults& results,
+                    SharedRSymbols* pSharedSymbols = NULL)
+{
+   if (options.warnIfNoSuchVariableInScope())
+      checkNoDefinitionInScope(origin, documentId, results, pSharedSymbols);
+   
+   if (options.warnIfVariableIsDefinedButNotUsed())
+      checkDefinedButNotUsed(results);
+}
+
+} // end anonymous namespace
+
+ParseResults parse(const std::wstring& rCode,
+                   const FilePath& origin,
+                   const std::string& documentId = std::string(),
+                   bool isExplicit = false)
+{
+   ParseResults results;
+   ParseOptions options;
+   if (!getParseOptions(rCode, isExplicit, &options))
       return ParseResults();
    
-   results = rparser::parse(origin, rCode, options);
+   if (documentId.empty())
+      results = rparser::parse(origin, rCode, options);
+   else
+      results = rparser::parse(origin, rCode, options, &s_parseStates[documentId]);
    
    ParseNode* pRoot = results.parseTree();
    if (!pRoot)
@@ -679,12 +766,7 @@ ParseResults parse(const std::wstring& rCode,
       return ParseResults();
    }
    
-   if (options.warnIfNoSuchVariableInScope())
-      checkNoDefinitionInScope(origin, documentId, results);
-   
-   if (options.warnIfVariableIsDefinedButNotUsed())
-      checkDefinedButNotUsed(results);
-   
+   addDiagnostics(origin, documentId, options, results);
    return results;
 }
 
@@ -964,28 +1046,108 @@ void afterSessionInitHook(bool newSession)
    }
 }
 
-bool collectLint(int depth,
-                 const FilePath& path,
-                 std::map<FilePath, LintItems>* pLint)
+// When linting a directory, files are read (and hashed) on the worker
+// pool while the main thread lints the files read so far. Parsing itself
+// stays on the main thread since the parser consults R (e.g. to find out
+// whether a function performs non-standard evaluation).
+struct LintFile
 {
-   if (path.extensionLowerCase() != ".r")
-      return true;
+   LintFile() : read(false) {}
    
+   FilePath path;
    std::string contents;
-   Error error = core::readStringFromFile(path, &contents);
-   if (error)
+   std::string hash;
+   bool read;
+};
+
+typedef core::thread::ThreadsafeQueue<LintFile> LintFileQueue;
+
+// maximum number of files being read on the worker pool at once (so
+// the pool remains responsive to the rpc methods which also use it)
+const std::size_t kMaxPendingLintReads = 64;
+
+void readLintFile(LintFile file, boost::shared_ptr<LintFileQueue> pFiles)
+{
+   try
    {
-      LOG_ERROR(error);
-      return true;
+      Error error = core::readStringFromFile(file.path, &file.contents);
+      if (error)
+      {
+         LOG_ERROR(error);
+      }
+      else
+      {
+         file.hash = hash::crc32Hash(file.contents);
+         file.read = true;
+      }
    }
+   CATCH_UNEXPECTED_EXCEPTION
    
-   ParseResults results = diagnostics::parse(
-            string_utils::utf8ToWide(contents),
-            path,
-            std::string(),
-            true);
+   // always return the file (even if reading failed) so that the
+   // main thread can account for the task
+   pFiles->enque(file);
+}
+
+// The parse results for files linted by 'rs_lintDirectory()', keyed by path,
+// so that files which haven't changed since they were last linted needn't be
+// parsed again. The diagnostics which depend on the symbols currently
+// available are re-computed each time.
+struct CachedLintParse
+{
+   CachedLintParse() : size(0) {}
+   
+   std::string hash;
+   std::size_t size;
+   ParseOptions options;
+   ParseResults results;
+};
+
+std::map<std::string, CachedLintParse> s_lintParseCache;
+
+// the parser consults R when checking for non-standard evaluation, so
+// cached parses are discarded when the packages available change
+void clearLintParseCache()
+{
+   s_lintParseCache.clear();
+}
+
+void onPackageLoaded(const std::string&)
+{
+   clearLintParseCache();
+}
+
+LintItems lintFile(const LintFile& file, SharedRSymbols* pSharedSymbols)
+{
+   std::wstring rCode = string_utils::utf8ToWide(file.contents);
+   
+   ParseOptions options;
+   if (!getParseOptions(rCode, true, &options))
+      return LintItems();
+   
+   CachedLintParse& cached = s_lintParseCache[file.path.absolutePath()];
+   if (cached.hash != file.hash ||
+       cached.size != file.contents.size() ||
+       !(cached.options == options))
+   {
+      cached.hash = file.hash;
+      cached.size = file.contents.size();
+      cached.options = options;
+      cached.results = rparser::parse(file.path, rCode, options);
+   }
+   
+   // add the diagnostics to a copy, leaving the cached lint as parsed
+   ParseResults results = cached.results;
+   addDiagnostics(file.path, std::string(), options, results, pSharedSymbols);
+   return results.lint();
+}
+
+bool collectLintFile(int depth,
+                     const FilePath& path,
+                     std::vector<FilePath>* pPaths)
+{
+   if (path.extensionLowerCase() == ".r")
+      pPaths->push_back(path);
    
-   (*pLint)[path] = results.lint();
    return true;
 }
 
@@ -996,15 +1158,45 @@ SEXP rs_lintDirectory(SEXP directorySEXP)
    if (!dirPath.exists())
       return R_NilValue;
    
-   std::map<FilePath, LintItems> lint;
+   std::vector<FilePath> paths;
    Error error = dirPath.childrenRecursive(
-            boost::bind(collectLint, _1, _2, &lint));
+            boost::bind(collectLintFile, _1, _2, &paths));
    if (error)
    {
       LOG_ERROR(error);
       return R_NilValue;
    }
    
+   // look up the symbols available from R once for all of the files
+   SharedRSymbols sharedSymbols;
+   
+   boost::shared_ptr<LintFileQueue> pFiles(new LintFileQueue(true));
+   std::size_t nextPath = 0;
+   std::size_t pendingCount = 0;
+   
+   std::map<FilePath, LintItems> lint;
+   while (nextPath < paths.size() || pendingCount > 0)
+   {
+      // keep the worker pool supplied with files to read (reading
+      // them here if the pool isn't running)
+      while (nextPath < paths.size() && pendingCount < kMaxPendingLintReads)
+      {
+         LintFile file;
+         file.path = paths[nextPath++];
+         if (!worker_pool::execute(boost::bind(readLintFile, file, pFiles)))
+            readLintFile(file, pFiles);
+         ++pendingCount;
+      }
+      
+      LintFile file;
+      if (!pFiles->deque(&file, boost::posix_time::milliseconds(50)))
+         continue;
+      
+      --pendingCount;
+      if (file.read)
+         lint[file.path] = lintFile(file, &sharedSymbols);
+   }
+   
    using namespace module_context;
    SourceMarkerSet markers = asSourceMarkerSet(lint);
    showSourceMarkers(markers, MarkerAutoSelectNone);
@@ -1025,6 +1217,12 @@ core::Error initialize()
    cb.onFilesChanged = onFilesChanged;
    projects::projectContext().subscribeToFileMonitor("Diagnostics", cb);
    
+   source_database::events().onDocRemoved.connect(onDocRemoved);
+   source_database::events().onRemoveAll.connect(onRemoveAll);
+   
+   module_context::events().onPackageLoaded.connect(onPackageLoaded);
+   module_context::events().onPackageLibraryMutated.connect(clearLintParseCache);
+   
    RS_REGISTER_CALL_METHOD(rs_lintRFile, 1);
    RS_REGISTER_CALL_METHOD(rs_lintDirectory, 1);
    
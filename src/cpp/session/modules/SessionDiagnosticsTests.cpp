@@ -120,6 +120,42 @@ void lintRStudioRFiles()
    lintRFilesInSubdirectory(options().modulesRSourcePath());
 }
 
+bool lintEquals(const LintItems& lhs, const LintItems& rhs)
+{
+   if (lhs.get().size() != rhs.get().size())
+      return false;
+   
+   for (std::size_t i = 0; i < lhs.get().size(); ++i)
+   {
+      const LintItem& left = lhs.get()[i];
+      const LintItem& right = rhs.get()[i];
+      if (left.startRow != right.startRow ||
+          left.startColumn != right.startColumn ||
+          left.endRow != right.endRow ||
+          left.endColumn != right.endColumn ||
+          left.type != right.type ||
+          left.message != right.message)
+      {
+         return false;
+      }
+   }
+   
+   return true;
+}
+
+// Parse each version of a document in turn, re-using the previous
+// parse, and check that we get the same lint as a fresh parse would.
+void expectIncrementalParseMatches(const std::vector<std::wstring>& versions)
+{
+   IncrementalParseState state;
+   BOOST_FOREACH(const std::wstring& code, versions)
+   {
+      ParseResults incremental = parse(FilePath(), code, s_parseOptions, &state);
+      ParseResults full = parse(code, s_parseOptions);
+      expect_true(lintEquals(incremental.lint(), full.lint()));
+   }
+}
+
 context("Diagnostics")
 {
    test_that("valid expressions generate no lint")
@@ -265,6 +301,20 @@ context("Diagnostics")
       EXPECT_NO_ERRORS("y ~ (1)");
    }
    
+   test_that("incremental parses match full parses")
+   {
+      std::vector<std::wstring> versions;
+      versions.push_back(L"x <- 1\nf <- function(a) {\n  a + x\n}\nprint(f(1))\n");
+      versions.push_back(L"x <- 1\nf <- function(a) {\n  a + x +\n}\nprint(f(1))\n");
+      versions.push_back(L"x <- 1\nf <- function(a) {\n  a + y\n}\nprint(f(1))\n");
+      versions.push_back(L"f <- function(a) {\n  a + y\n}\nprint(f(1))\n");
+      versions.push_back(L"f <- function(a) {\n  a + y\n\nprint(f(1))\n");
+      versions.push_back(L"y <- 2\nf <- function(a) {\n  a + y\n}\nprint(f(1)\n");
+      versions.push_back(L"y <- 2\nf <- function(a) {\n  a + y\n}\nprint(f(1))\ny\n <- 3\n");
+      versions.push_back(L"y <- 2\nf <- function(a) {\n  a + y\n}\n");
+      expectIncrementalParseMatches(versions);
+   }
+   
    lintRStudioRFiles();
 }
 
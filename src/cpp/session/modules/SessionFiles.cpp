@@ -26,6 +26,8 @@
 
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
@@ -38,11 +40,13 @@
 #include <core/DateTime.hpp>
 
 #include <core/http/Util.hpp>
+#include <core/http/MultipartParser.hpp>
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
 
 #include <core/json/Json.hpp>
 
+#include <core/system/System.hpp>
 #include <core/system/ShellUtils.hpp>
 #include <core/system/Process.hpp>
 #include <core/system/RecycleBin.hpp>
@@ -80,6 +84,25 @@ FilesListingMonitor s_filesListingMonitor;
 // make sure that monitoring persists accross suspended sessions
 const char * const kFilesMonitoredPath = "files.monitored-path";
 
+// sorted listing of a directory which is being returned in pages
+struct ListingCursor
+{
+   ListingCursor()
+      : position(0)
+   {
+   }
+
+   FilePath path;
+   std::vector<FilePath> files;
+   std::size_t position;
+};
+
+// listings in progress (we keep only a few since clients page through
+// a listing immediately after requesting it)
+const std::size_t kMaxListingCursors = 4;
+std::vector<std::pair<std::string, boost::shared_ptr<ListingCursor> > >
+                                                         s_listingCursors;
+
 void onSuspend(Settings* pSettings)
 {
    // get monitored path and alias it
@@ -191,6 +214,20 @@ core::Error getFileContents(const json::JsonRpcRequest& request,
    return Success();
 }
    
+bool isParentBrowseable(const FilePath& targetPath)
+{
+   bool browseable = true;
+
+#ifndef _WIN32
+   // on *nix systems, see if browsing above this path is possible
+   Error error = core::system::isFileReadable(targetPath.parent(), &browseable);
+   if (error && !core::isPathNotFoundError(error))
+      LOG_ERROR(error);
+#endif
+
+   return browseable;
+}
+
 Error listFiles(const json::JsonRpcRequest& request, json::JsonRpcResponse* pResponse)
 {
    // get args
@@ -232,17 +269,113 @@ Error listFiles(const json::JsonRpcRequest& request, json::JsonRpcResponse* pRes
    }
 
    result["files"] = jsonFiles;
+   result["is_parent_browseable"] = isParentBrowseable(targetPath);
 
-   bool browseable = true;
+   pResponse->setResult(result);
+   return Success();
+}
 
-#ifndef _WIN32
-   // on *nix systems, see if browsing above this path is possible
-   error = core::system::isFileReadable(targetPath.parent(), &browseable);
-   if (error && !core::isPathNotFoundError(error))
-      LOG_ERROR(error);
-#endif
+// paged version of listFiles for large directories. the first request
+// (with an empty cursor) lists and sorts the directory and returns the
+// first page along with a cursor for requesting subsequent pages. json is
+// only produced for the files in each page. if monitoring is requested it
+// begins with the first page, and any changes which occur while paging are
+// delivered as file changed events
+Error listFilesPage(const json::JsonRpcRequest& request,
+                    json::JsonRpcResponse* pResponse)
+{
+   // get args
+   std::string path, cursorId;
+   bool monitor;
+   int pageSize;
+   Error error = json::readParams(request.params,
+                                  &path,
+                                  &monitor,
+                                  &cursorId,
+                                  &pageSize);
+   if (error)
+      return error;
+   if (pageSize <= 0)
+      return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+
+   boost::shared_ptr<ListingCursor> pCursor;
+   if (cursorId.empty())
+   {
+      // new listing
+      pCursor.reset(new ListingCursor());
+      pCursor->path = module_context::resolveAliasedPath(path);
+      error = FilesListingMonitor::listFiles(pCursor->path, &pCursor->files);
+      if (error)
+         return error;
+
+      if (monitor)
+      {
+         // always stop existing if we have one
+         s_filesListingMonitor.stop();
 
-   result["is_parent_browseable"] = browseable;
+         // install a monitor only if we aren't already covered by the
+         // project monitor
+         if (!session::projects::projectContext().isMonitoringDirectory(
+                                                               pCursor->path))
+         {
+            s_filesListingMonitor.start(pCursor->path, pCursor->files);
+         }
+      }
+
+      cursorId = core::system::generateShortenedUuid();
+      s_listingCursors.push_back(std::make_pair(cursorId, pCursor));
+      if (s_listingCursors.size() > kMaxListingCursors)
+         s_listingCursors.erase(s_listingCursors.begin());
+   }
+   else
+   {
+      for (std::size_t i = 0; i < s_listingCursors.size(); i++)
+      {
+         if (s_listingCursors[i].first == cursorId)
+         {
+            pCursor = s_listingCursors[i].second;
+            break;
+         }
+      }
+
+      if (!pCursor)
+         return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+   }
+
+   // produce the page
+   std::vector<FilePath>::const_iterator begin =
+                                 pCursor->files.begin() + pCursor->position;
+   std::size_t count = std::min(static_cast<std::size_t>(pageSize),
+                                pCursor->files.size() - pCursor->position);
+   json::Array jsonFiles;
+   FilesListingMonitor::filesAsJson(pCursor->path,
+                                    begin,
+                                    begin + count,
+                                    &jsonFiles);
+   pCursor->position += count;
+
+   json::Object result;
+   result["files"] = jsonFiles;
+   result["total"] = static_cast<int>(pCursor->files.size());
+   result["is_parent_browseable"] = isParentBrowseable(pCursor->path);
+
+   // return the cursor if there are more files (otherwise discard it)
+   if (pCursor->position < pCursor->files.size())
+   {
+      result["cursor"] = cursorId;
+   }
+   else
+   {
+      result["cursor"] = std::string();
+      for (std::size_t i = 0; i < s_listingCursors.size(); i++)
+      {
+         if (s_listingCursors[i].first == cursorId)
+         {
+            s_listingCursors.erase(s_listingCursors.begin() + i);
+            break;
+         }
+      }
+   }
 
    pResponse->setResult(result);
    return Success();
@@ -605,32 +738,118 @@ Error detectZipFileOverwrites(const FilePath& uploadedZipFile,
    return Success();
 }
    
-bool validateUploadedFile(const http::File& file, http::Response* pResponse)
+// writes the file part of an upload directly to a temporary file as the
+// body is parsed (rather than copying it out of the body and then writing
+// it) and enforces the upload size limit as it goes
+class UploadHandler : public http::MultipartHandler
 {
-   // get limit
-   size_t mbLimit = session::options().limitFileUploadSizeMb();
+public:
+   explicit UploadHandler(std::size_t byteLimit)
+      : byteLimit_(byteLimit), inFile_(false), inField_(false), size_(0)
+   {
+   }
 
-   // don't enforce if no limit specified
-   if (mbLimit <= 0)
-      return true;
+   virtual Error onPartBegin(const http::Headers& headers)
+   {
+      std::string name, filename;
+      bool isFile;
+      if (!http::formDataPartName(headers, &name, &filename, &isFile))
+         return Success();
 
-   // convert limit to bytes
-   size_t byteLimit = mbLimit * 1024 * 1024;
-   
-   // compare to file size
-   if (file.contents.size() > byteLimit)
+      if (isFile && name == "file" && tempFilePath_.empty())
+      {
+         // establish whether this is a zip file and create appropriate
+         // temp file path
+         filename_ = filename;
+         bool isZip = FilePath(filename).extensionLowerCase() == ".zip";
+         tempFilePath_ = module_context::tempFile("upload",
+                                                  isZip ? "zip" : "bin");
+         Error error = tempFilePath_.open_w(&pStream_);
+         if (error)
+            return error;
+         inFile_ = true;
+      }
+      else if (!isFile && name == "targetDirectory")
+      {
+         targetDirectory_.clear();
+         inField_ = true;
+      }
+
+      return Success();
+   }
+
+   virtual Error onPartData(const char* data, std::size_t size)
    {
-      Error fileTooLargeError = systemError(boost::system::errc::file_too_large,
-                                            ERROR_LOCATION);
-   
-      json::setJsonRpcError(fileTooLargeError, pResponse);
-   
-      return false;
+      if (inFile_)
+      {
+         size_ += size;
+         if (byteLimit_ > 0 && size_ > byteLimit_)
+            return systemError(boost::system::errc::file_too_large,
+                               ERROR_LOCATION);
+
+         pStream_->write(data, size);
+         if (pStream_->fail())
+            return writeError(ERROR_LOCATION);
+      }
+      else if (inField_)
+      {
+         targetDirectory_.append(data, size);
+      }
+
+      return Success();
    }
-   else
+
+   virtual Error onPartEnd()
+   {
+      if (inFile_)
+      {
+         inFile_ = false;
+         pStream_->flush();
+         bool failed = pStream_->fail();
+         pStream_.reset();
+         if (failed)
+            return writeError(ERROR_LOCATION);
+      }
+      else if (inField_)
+      {
+         inField_ = false;
+         boost::algorithm::trim(targetDirectory_);
+      }
+
+      return Success();
+   }
+
+   const std::string& filename() const { return filename_; }
+   const FilePath& tempFilePath() const { return tempFilePath_; }
+   const std::string& targetDirectory() const { return targetDirectory_; }
+
+private:
+   Error writeError(const ErrorLocation& location)
    {
-      return true;
+      Error error = systemError(boost::system::errc::io_error, location);
+      error.addProperty("path", tempFilePath_);
+      return error;
    }
+
+private:
+   std::size_t byteLimit_;
+   bool inFile_;
+   bool inField_;
+   std::size_t size_;
+   std::string filename_;
+   FilePath tempFilePath_;
+   boost::shared_ptr<std::ostream> pStream_;
+   std::string targetDirectory_;
+};
+
+void removeUploadTempFile(const FilePath& tempFilePath)
+{
+   if (tempFilePath.empty())
+      return;
+
+   Error error = tempFilePath.removeIfExists();
+   if (error)
+      LOG_ERROR(error);
 }
    
 void handleFileUploadRequest(const http::Request& request, 
@@ -639,39 +858,46 @@ void handleFileUploadRequest(const http::Request& request,
    // response content type must always be text/html to be handled
    // properly by the browser/gwt on the client side
    pResponse->setContentType("text/html");
+
+   // get limit (not enforced if none is specified)
+   std::size_t byteLimit = 0;
+   int mbLimit = session::options().limitFileUploadSizeMb();
+   if (mbLimit > 0)
+      byteLimit = static_cast<std::size_t>(mbLimit) * 1024 * 1024;
    
-   // get fields
-   const http::File& file = request.uploadedFile("file");
-   std::string targetDirectory = request.formFieldValue("targetDirectory");
-   
-   // first validate that we got the required fields
-   if (file.name.empty() || targetDirectory.empty())
+   // parse the form, writing the file as we go
+   std::string boundary = http::MultipartParser::boundary(request.contentType());
+   UploadHandler upload(byteLimit);
+   if (!boundary.empty())
    {
+      http::MultipartParser parser(boundary);
+      Error error = parser.parse(request.body().data(),
+                                 request.body().size(),
+                                 &upload);
+      if (error)
+      {
+         removeUploadTempFile(upload.tempFilePath());
+         if (error.code() != boost::system::errc::file_too_large)
+            LOG_ERROR(error);
+         json::setJsonRpcError(error, pResponse);
+         return;
+      }
+   }
+
+   // validate that we got the required fields
+   if (upload.filename().empty() || upload.targetDirectory().empty())
+   {
+      removeUploadTempFile(upload.tempFilePath());
       json::setJsonRpcError(json::errc::ParamInvalid, pResponse);
       return;
    }
    
-   // now validate the file
-   if ( !validateUploadedFile(file, pResponse) )
-      return ;
-   
    // form destination path
-   FilePath destDir = module_context::resolveAliasedPath(targetDirectory);
-   FilePath destPath = destDir.childPath(file.name);
-   
-   // establish whether this is a zip file and create appropriate temp file path
+   FilePath destDir = module_context::resolveAliasedPath(
+                                                   upload.targetDirectory());
+   FilePath destPath = destDir.childPath(upload.filename());
    bool isZip = destPath.extensionLowerCase() == ".zip";
-   FilePath tempFilePath = module_context::tempFile("upload", 
-                                                    isZip ? "zip" : "bin");
-   
-   // attempt to write the temp file
-   Error saveError = core::writeStringToFile(tempFilePath, file.contents);
-   if (saveError)
-   {
-      LOG_ERROR(saveError);
-      json::setJsonRpcError(saveError, pResponse);
-      return;
-   }
+   FilePath tempFilePath = upload.tempFilePath();
    
    // detect any potential overwrites 
    json::Array overwritesJson;
@@ -695,7 +921,7 @@ void handleFileUploadRequest(const http::Request& request,
    
    // set the upload information as the result
    json::Object uploadTokenJson;
-   uploadTokenJson[kUploadFilename] = file.name;
+   uploadTokenJson[kUploadFilename] = upload.filename();
    uploadTokenJson[kUploadedTempFile] = tempFilePath.absolutePath();
    uploadTokenJson[kUploadTargetDirectory] = destDir.absolutePath();
    json::Object uploadJson;
@@ -985,10 +1211,11 @@ Error initialize()
    using boost::bind;
    ExecBlock initBlock ;
    initBlock.addFunctions()
-      (bind(registerRpcMethod, "stat", stat))
-      (bind(registerRpcMethod, "is_text_file", isTextFile))
+      (bind(registerWorkerSafeRpcMethod, "stat", stat))
+      (bind(registerWorkerSafeRpcMethod, "is_text_file", isTextFile))
       (bind(registerRpcMethod, "get_file_contents", getFileContents))
       (bind(registerRpcMethod, "list_files", listFiles))
+      (bind(registerRpcMethod, "list_files_page", listFilesPage))
       (bind(registerRpcMethod, "create_folder", createFolder))
       (bind(registerRpcMethod, "delete_files", deleteFiles))
       (bind(registerRpcMethod, "copy_file", copyFile))
@@ -52,6 +52,16 @@ Error FilesListingMonitor::start(const FilePath& filePath, json::Array* pJsonFil
    if (error)
       return error;
 
+   start(filePath, files);
+   return Success();
+}
+
+void FilesListingMonitor::start(const FilePath& filePath,
+                                const std::vector<FilePath>& files)
+{
+   // always stop existing
+   stop();
+
    // copy the file listing into a vector of FileInfo which we will order so that it can
    // be compared with the initial scan of the file montor for changes
    std::vector<FileInfo> prevFiles;
@@ -72,8 +82,6 @@ Error FilesListingMonitor::start(const FilePath& filePath, json::Array* pJsonFil
                                                false,
                                                module_context::fileListingFilter,
                                                cb);
-
-   return Success();
 }
 
 void FilesListingMonitor::stop()
@@ -172,6 +180,17 @@ void FilesListingMonitor::onUnregistered(core::system::file_monitor::Handle hand
 Error FilesListingMonitor::listFiles(const FilePath& rootPath,
                                      std::vector<FilePath>* pFiles,
                                      json::Array* pJsonFiles)
+{
+   Error error = listFiles(rootPath, pFiles);
+   if (error)
+      return error;
+
+   filesAsJson(rootPath, pFiles->begin(), pFiles->end(), pJsonFiles);
+   return Success();
+}
+
+Error FilesListingMonitor::listFiles(const FilePath& rootPath,
+                                     std::vector<FilePath>* pFiles)
 {
    // enumerate the files
    pFiles->clear();
@@ -179,18 +198,28 @@ Error FilesListingMonitor::listFiles(const FilePath& rootPath,
    if (error)
       return error;
 
+   // sort the files by name
+   std::sort(pFiles->begin(), pFiles->end(), core::compareAbsolutePathNoCase);
+
+   return Success();
+}
+
+void FilesListingMonitor::filesAsJson(
+                           const FilePath& rootPath,
+                           std::vector<FilePath>::const_iterator begin,
+                           std::vector<FilePath>::const_iterator end,
+                           json::Array* pJsonFiles)
+{
    using namespace source_control;
    boost::shared_ptr<FileDecorationContext> pCtx =
                   source_control::fileDecorationContext(rootPath);
 
-   // sort the files by name
-   std::sort(pFiles->begin(), pFiles->end(), core::compareAbsolutePathNoCase);
-
    // produce json listing
-   BOOST_FOREACH( core::FilePath& filePath, *pFiles)
+   for (std::vector<FilePath>::const_iterator it = begin; it != end; ++it)
    {
       // files which may have been deleted after the listing or which
       // are not end-user visible
+      const FilePath& filePath = *it;
       if (filePath.exists() && module_context::fileListingFilter(core::FileInfo(filePath)))
       {
          core::json::Object fileObject = module_context::createFileSystemItem(filePath);
@@ -198,8 +227,6 @@ Error FilesListingMonitor::listFiles(const FilePath& rootPath,
          pJsonFiles->push_back(fileObject) ;
       }
    }
-
-   return Success();
 }
 
 
@@ -53,6 +53,11 @@ public:
    // kickoff monitoring
    core::Error start(const core::FilePath& filePath, core::json::Array* pJsonFiles);
 
+   // kickoff monitoring given a listing already produced by listFiles (any
+   // changes since the listing are reported as file changed events)
+   void start(const core::FilePath& filePath,
+              const std::vector<core::FilePath>& files);
+
    void stop();
 
    // what path are we currently monitoring?
@@ -67,6 +72,17 @@ public:
       return listFiles(rootPath, &files, pJsonFiles);
    }
 
+   // list the files in a directory (sorted by name) without producing json.
+   // this is used to page through large directories (see filesAsJson)
+   static core::Error listFiles(const core::FilePath& rootPath,
+                                std::vector<core::FilePath>* pFiles);
+
+   // produce json for a range of files returned by listFiles
+   static void filesAsJson(const core::FilePath& rootPath,
+                           std::vector<core::FilePath>::const_iterator begin,
+                           std::vector<core::FilePath>::const_iterator end,
+                           core::json::Array* pJsonFiles);
+
 private:
    // stateful handlers for registration and unregistration
    void onRegistered(core::system::file_monitor::Handle handle,
@@ -25,6 +25,7 @@
 #include <core/Error.hpp>
 #include <core/BoostErrors.hpp>
 #include <core/Log.hpp>
+#include <core/Thread.hpp>
 
 #include <core/system/Process.hpp>
 
@@ -44,6 +45,18 @@ namespace {
 
 // does the system have quotas?
 bool s_systemHasQuotas = false;   
+
+// quota status is read by a background thread and cached (so that checking
+// it never waits on a slow quota daemon). the cache is refreshed after file
+// operations (which report the cached status in the meantime) and
+// periodically in the background
+const boost::posix_time::time_duration kQuotaRefreshInterval =
+                                             boost::posix_time::minutes(5);
+
+// cached status older than this isn't reported (e.g. if the quota command
+// is hanging)
+const boost::posix_time::time_duration kQuotaMaxAge =
+                                             boost::posix_time::minutes(15);
    
 struct QuotaInfo
 {
@@ -58,7 +71,22 @@ struct QuotaInfo
    size_type used;
    size_type quota;
    size_type limit;
+
+   bool operator==(const QuotaInfo& other) const
+   {
+      return hasQuota == other.hasQuota &&
+             used == other.used &&
+             quota == other.quota &&
+             limit == other.limit;
+   }
 };
+
+// cached quota status (guarded by s_quotaMutex)
+boost::mutex s_quotaMutex;
+QuotaInfo s_quotaInfo;
+boost::posix_time::ptime s_quotaInfoTime;
+bool s_refreshing = false;
+bool s_refreshPending = false;
     
 void quotaInfoToJson(const QuotaInfo& quotaInfo,
                      json::Object* pQuotaInfoJson)
@@ -158,40 +186,116 @@ Error parseQuotaInfo(const std::string& quotaInfo, QuotaInfo* pInfo)
    }
 }
 
-void checkQuotaThread()
+void enqueQuotaStatusEvent(const QuotaInfo& quotaInfo)
+{
+   // send event only if there are quotas established
+   if (quotaInfo.hasQuota)
+   {
+      json::Object quotaInfoJson;
+      quotaInfoToJson(quotaInfo, &quotaInfoJson);
+      ClientEvent event(client_events::kQuotaStatus, quotaInfoJson);
+      module_context::enqueClientEvent(event);
+   }
+}
+
+bool readQuotaInfo(QuotaInfo* pQuotaInfo)
+{
+   // run the command
+   core::system::ProcessResult result;
+   Error error = runCommand("xfs_quota -c 'quota -N'",
+                            core::system::ProcessOptions(),
+                            &result);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   // parse output
+   error = parseQuotaInfo(result.stdOut, pQuotaInfo);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   return true;
+}
+
+void refreshQuotaThread()
 {
    try
    {
-      // run the command
-      core::system::ProcessResult result;
-      Error error = runCommand("xfs_quota -c 'quota -N'",
-                               core::system::ProcessOptions(),
-                               &result);
-      if (error)
+      bool refresh = true;
+      while (refresh)
       {
-         LOG_ERROR(error);
-         return;
+         QuotaInfo quotaInfo;
+         bool success = readQuotaInfo(&quotaInfo);
+
+         // update the cache, noting whether the status changed and whether
+         // another refresh was requested while we were reading it
+         bool changed = false;
+         LOCK_MUTEX(s_quotaMutex)
+         {
+            if (success)
+            {
+               changed = s_quotaInfoTime.is_not_a_date_time() ||
+                         !(quotaInfo == s_quotaInfo);
+               s_quotaInfo = quotaInfo;
+               s_quotaInfoTime = boost::posix_time::second_clock::universal_time();
+            }
+
+            refresh = s_refreshPending;
+            s_refreshPending = false;
+            s_refreshing = refresh;
+         }
+         END_LOCK_MUTEX
+
+         if (changed)
+            enqueQuotaStatusEvent(quotaInfo);
       }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
 
-      // parse output
-      QuotaInfo quotaInfo;
-      error = parseQuotaInfo(result.stdOut, &quotaInfo);
-      if (error)
+// refresh the cached status on a background thread (if a refresh is
+// already underway then another is done once it completes)
+void refreshQuotaStatus()
+{
+   bool launch = false;
+   LOCK_MUTEX(s_quotaMutex)
+   {
+      if (s_refreshing)
       {
-         LOG_ERROR(error);
-         return;
+         s_refreshPending = true;
       }
-      
-      // send event only if there are quotas established
-      if (quotaInfo.hasQuota)
+      else
       {
-         json::Object quotaInfoJson;
-         quotaInfoToJson(quotaInfo, &quotaInfoJson);
-         ClientEvent event(client_events::kQuotaStatus, quotaInfoJson);
-         module_context::enqueClientEvent(event);
+         s_refreshing = true;
+         launch = true;
+      }
+   }
+   END_LOCK_MUTEX
+
+   if (launch)
+   {
+      boost::thread thread;
+      core::thread::safeLaunchThread(refreshQuotaThread, &thread);
+      if (!thread.joinable())
+      {
+         LOCK_MUTEX(s_quotaMutex)
+         {
+            s_refreshing = false;
+         }
+         END_LOCK_MUTEX
       }
    }
-   CATCH_UNEXPECTED_EXCEPTION
+}
+
+bool periodicQuotaRefresh()
+{
+   refreshQuotaStatus();
+   return true;
 }
 
 } // anonymous namespace
@@ -211,31 +315,40 @@ Error initialize()
       s_systemHasQuotas = false;
    }
 
+   // keep the cached status current
+   if (s_systemHasQuotas)
+   {
+      module_context::schedulePeriodicWork(kQuotaRefreshInterval,
+                                           periodicQuotaRefresh,
+                                           true /* idle only */,
+                                           false /* not immediate */);
+   }
+
    return Success();
 }
    
 
 void checkQuotaStatus()
 {
-   if (s_systemHasQuotas)
+   if (!s_systemHasQuotas)
+      return;
+
+   // report the cached status (if it's recent enough)
+   QuotaInfo quotaInfo;
+   LOCK_MUTEX(s_quotaMutex)
    {
-      try
+      if (!s_quotaInfoTime.is_not_a_date_time() &&
+          boost::posix_time::second_clock::universal_time() - s_quotaInfoTime
+                                                               < kQuotaMaxAge)
       {
-         // block all signals for launch of background thread (will cause it
-         // to never receive signals)
-         core::system::SignalBlocker signalBlocker;
-         Error error = signalBlocker.blockAll();
-         if (error)
-            LOG_ERROR(error);
-         
-         boost::thread t(checkQuotaThread);
-      }
-      catch(const boost::thread_resource_error& e)
-      {
-         LOG_ERROR(Error(boost::thread_error::ec_from_exception(e),
-                         ERROR_LOCATION));
+         quotaInfo = s_quotaInfo;
       }
    }
+   END_LOCK_MUTEX
+   enqueQuotaStatusEvent(quotaInfo);
+
+   // refresh it (an event is sent if it changed)
+   refreshQuotaStatus();
 }
 
 } // namespace quotas
@@ -33,6 +33,9 @@
 #include <session/SessionUserSettings.hpp>
 #include <session/projects/SessionProjects.hpp>
 
+#include "SessionFindEngine.hpp"
+#include "SessionFindIndex.hpp"
+
 using namespace rstudio::core;
 
 namespace rstudio {
@@ -193,6 +196,236 @@ FindInFilesState& findResults()
    return *s_pFindResults;
 }
 
+// Converts file contents from the project encoding to UTF-8
+class ContentsDecoder
+{
+public:
+   explicit ContentsDecoder(const std::string& encoding)
+      : firstDecodeError_(true), encoding_(encoding)
+   {
+   }
+
+   std::string decode(const std::string& encoded)
+   {
+      if (encoded.empty())
+         return encoded;
+
+      std::string decoded;
+      Error error = r::util::iconvstr(encoded, encoding_, "UTF-8", true,
+                                      &decoded);
+
+      // Log error, but only once per find operation
+      if (error && firstDecodeError_)
+      {
+         firstDecodeError_ = false;
+         LOG_ERROR(error);
+      }
+
+      return decoded;
+   }
+
+private:
+   bool firstDecodeError_;
+   std::string encoding_;
+};
+
+bool isExcludedPath(const std::string& file)
+{
+   return file.find("/.Rproj.user/") != std::string::npos ||
+          file.find("/.git/") != std::string::npos ||
+          file.find("/.svn/") != std::string::npos ||
+          file.find("/packrat/lib/") != std::string::npos ||
+          file.find("/packrat/src/") != std::string::npos;
+}
+
+void truncateContents(std::string* pContents)
+{
+   if (pContents->size() > 300)
+   {
+      pContents->erase(300);
+      pContents->append("...");
+   }
+}
+
+void enqueFindResults(const std::string& handle,
+                      const json::Array& files,
+                      const json::Array& lineNums,
+                      const json::Array& contents,
+                      const json::Array& matchOns,
+                      const json::Array& matchOffs)
+{
+   json::Object result;
+   result["handle"] = handle;
+   json::Object results;
+   results["file"] = files;
+   results["line"] = lineNums;
+   results["lineValue"] = contents;
+   results["matchOn"] = matchOns;
+   results["matchOff"] = matchOffs;
+   result["results"] = results;
+
+   findResults().addResult(handle,
+                           files,
+                           lineNums,
+                           contents,
+                           matchOns,
+                           matchOffs);
+
+   module_context::enqueClientEvent(
+            ClientEvent(client_events::kFindResult, result));
+}
+
+void enqueFindEnded(const std::string& handle)
+{
+   findResults().onFindEnd(handle);
+   module_context::enqueClientEvent(
+         ClientEvent(client_events::kFindOperationEnded, handle));
+}
+
+// Searches files using the in-process FindEngine, polling it for matches
+// on the main thread
+class EngineOperation : public boost::enable_shared_from_this<EngineOperation>
+{
+public:
+   static boost::shared_ptr<EngineOperation> create(
+                                 const std::string& encoding,
+                                 boost::shared_ptr<FindEngine> pEngine)
+   {
+      return boost::shared_ptr<EngineOperation>(new EngineOperation(encoding,
+                                                                    pEngine));
+   }
+
+private:
+   EngineOperation(const std::string& encoding,
+                   boost::shared_ptr<FindEngine> pEngine)
+      : decoder_(encoding), pEngine_(pEngine)
+   {
+      handle_ = core::system::generateUuid(false);
+   }
+
+public:
+   std::string handle() const
+   {
+      return handle_;
+   }
+
+   void start()
+   {
+      pEngine_->start();
+      module_context::schedulePeriodicWork(
+               boost::posix_time::milliseconds(100),
+               boost::bind(&EngineOperation::poll, shared_from_this()),
+               false,
+               false,
+               module_context::WorkPriorityHigh);
+   }
+
+private:
+   bool poll()
+   {
+      if (!findResults().isRunning() || findResults().handle() != handle())
+      {
+         pEngine_->stop();
+         enqueFindEnded(handle());
+         return false;
+      }
+
+      std::vector<FindMatch> matches;
+      bool running = pEngine_->takeMatches(&matches);
+
+      json::Array files;
+      json::Array lineNums;
+      json::Array contents;
+      json::Array matchOns;
+      json::Array matchOffs;
+
+      int recordsToProcess = MAX_COUNT + 1 - findResults().resultCount();
+      if (recordsToProcess < 0)
+         recordsToProcess = 0;
+
+      for (std::vector<FindMatch>::const_iterator it = matches.begin();
+           recordsToProcess > 0 && it != matches.end();
+           ++it)
+      {
+         std::string file = module_context::createAliasedPath(
+               FilePath(string_utils::systemToUtf8(it->absolutePath)));
+
+         json::Array matchOn, matchOff;
+         std::string lineContents = decodeContents(*it, &matchOn, &matchOff);
+
+         files.push_back(file);
+         lineNums.push_back(it->line);
+         contents.push_back(lineContents);
+         matchOns.push_back(matchOn);
+         matchOffs.push_back(matchOff);
+
+         recordsToProcess--;
+      }
+
+      if (files.size() > 0)
+      {
+         enqueFindResults(handle(),
+                          files,
+                          lineNums,
+                          contents,
+                          matchOns,
+                          matchOffs);
+      }
+
+      if (!running || recordsToProcess <= 0)
+      {
+         pEngine_->stop();
+         enqueFindEnded(handle());
+         return false;
+      }
+
+      return true;
+   }
+
+   // decode the contents of the match and convert the byte offsets of its
+   // matches into character offsets within the decoded contents
+   std::string decodeContents(const FindMatch& match,
+                              json::Array* pMatchOn,
+                              json::Array* pMatchOff)
+   {
+      std::string decodedLine;
+      std::size_t pos = 0;
+      typedef std::pair<std::size_t, std::size_t> Range;
+      BOOST_FOREACH(const Range& range, match.matches)
+      {
+         decodedLine.append(decoder_.decode(
+               match.contents.substr(pos, range.first - pos)));
+         pMatchOn->push_back(static_cast<int>(charCount(decodedLine)));
+
+         decodedLine.append(decoder_.decode(
+               match.contents.substr(range.first, range.second - range.first)));
+         pMatchOff->push_back(static_cast<int>(charCount(decodedLine)));
+
+         pos = range.second;
+      }
+      if (pos < match.contents.size())
+         decodedLine.append(decoder_.decode(match.contents.substr(pos)));
+
+      truncateContents(&decodedLine);
+      return decodedLine;
+   }
+
+   static std::size_t charCount(const std::string& decoded)
+   {
+      std::size_t charSize;
+      Error error = string_utils::utf8Distance(decoded.begin(),
+                                               decoded.end(),
+                                               &charSize);
+      if (error)
+         charSize = decoded.size();
+      return charSize;
+   }
+
+   ContentsDecoder decoder_;
+   boost::shared_ptr<FindEngine> pEngine_;
+   std::string handle_;
+};
+
 class GrepOperation : public boost::enable_shared_from_this<GrepOperation>
 {
 public:
@@ -206,7 +439,7 @@ public:
 private:
    GrepOperation(const std::string& encoding,
                  const FilePath& tempFile)
-      : firstDecodeError_(true), encoding_(encoding), tempFile_(tempFile)
+      : decoder_(encoding), tempFile_(tempFile)
    {
       handle_ = core::system::generateUuid(false);
    }
@@ -241,25 +474,6 @@ private:
       return findResults().isRunning() && findResults().handle() == handle();
    }
 
-   std::string decode(const std::string& encoded)
-   {
-      if (encoded.empty())
-         return encoded;
-
-      std::string decoded;
-      Error error = r::util::iconvstr(encoded, encoding_, "UTF-8", true,
-                                      &decoded);
-
-      // Log error, but only once per grep operation
-      if (error && firstDecodeError_)
-      {
-         firstDecodeError_ = false;
-         LOG_ERROR(error);
-      }
-
-      return decoded;
-   }
-
    void processContents(std::string* pContent,
                         json::Array* pMatchOn,
                         json::Array* pMatchOff)
@@ -270,13 +484,14 @@ private:
 
       std::string::iterator inputPos = pContent->begin();
 
+      static const regex reColor("\x1B\\[(\\d\\d)?m(\x1B\\[K)?");
       smatch match;
       while (regex_search(std::string(inputPos, pContent->end()), match,
-                          regex("\x1B\\[(\\d\\d)?m(\x1B\\[K)?")))
+                          reColor))
       {
          std::string match1 = match[1];
 
-         decodedLine.append(decode(
+         decodedLine.append(decoder_.decode(
                std::string(inputPos, inputPos + match.position())));
 
          inputPos += match.position() + match.length();
@@ -294,13 +509,10 @@ private:
             pMatchOff->push_back(static_cast<int>(charSize));
       }
       if (inputPos != pContent->end())
-         decodedLine.append(decode(std::string(inputPos, pContent->end())));
+         decodedLine.append(decoder_.decode(
+               std::string(inputPos, pContent->end())));
 
-      if (decodedLine.size() > 300)
-      {
-         decodedLine = decodedLine.erase(300);
-         decodedLine.append("...");
-      }
+      truncateContents(&decodedLine);
 
       *pContent = decodedLine;
    }
@@ -326,21 +538,15 @@ private:
          std::string line = stdOutBuf_.substr(nextLineStart, pos - nextLineStart);
          nextLineStart = pos + 1;
 
+         static const boost::regex reGrepLine(
+                                    "^((?:[a-zA-Z]:)?[^:]+):(\\d+):(.*)");
          boost::smatch match;
-         if (boost::regex_match(line, match, boost::regex("^((?:[a-zA-Z]:)?[^:]+):(\\d+):(.*)")))
+         if (boost::regex_match(line, match, reGrepLine))
          {
             std::string file = module_context::createAliasedPath(
                   FilePath(string_utils::systemToUtf8(match[1])));
 
-            if (file.find("/.Rproj.user/") != std::string::npos)
-               continue;
-            if (file.find("/.git/") != std::string::npos)
-               continue;
-            if (file.find("/.svn/") != std::string::npos)
-               continue;
-            if (file.find("/packrat/lib/") != std::string::npos)
-               continue;
-            if (file.find("/packrat/src/") != std::string::npos)
+            if (isExcludedPath(file))
                continue;
 
             int lineNum = safe_convert::stringTo<int>(std::string(match[2]), -1);
@@ -366,25 +572,12 @@ private:
 
       if (files.size() > 0)
       {
-         json::Object result;
-         result["handle"] = handle();
-         json::Object results;
-         results["file"] = files;
-         results["line"] = lineNums;
-         results["lineValue"] = contents;
-         results["matchOn"] = matchOns;
-         results["matchOff"] = matchOffs;
-         result["results"] = results;
-
-         findResults().addResult(handle(),
-                                 files,
-                                 lineNums,
-                                 contents,
-                                 matchOns,
-                                 matchOffs);
-
-         module_context::enqueClientEvent(
-                  ClientEvent(client_events::kFindResult, result));
+         enqueFindResults(handle(),
+                          files,
+                          lineNums,
+                          contents,
+                          matchOns,
+                          matchOffs);
       }
 
       if (recordsToProcess <= 0)
@@ -398,15 +591,12 @@ private:
 
    void onExit(int exitCode)
    {
-      findResults().onFindEnd(handle());
-      module_context::enqueClientEvent(
-            ClientEvent(client_events::kFindOperationEnded, handle()));
+      enqueFindEnded(handle());
       if (!tempFile_.empty())
          tempFile_.removeIfExists();
    }
 
-   bool firstDecodeError_;
-   std::string encoding_;
+   ContentsDecoder decoder_;
    FilePath tempFile_;
    std::string stdOutBuf_;
    std::string handle_;
@@ -431,6 +621,62 @@ core::Error beginFind(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
+   std::string encoding = projects::projectContext().hasProject() ?
+                          projects::projectContext().defaultEncoding() :
+                          userSettings().defaultEncoding();
+   std::string encodedString;
+   error = r::util::iconvstr(searchString,
+                             "UTF-8",
+                             encoding,
+                             false,
+                             &encodedString);
+   if (error)
+   {
+      LOG_ERROR(error);
+      encodedString = searchString;
+   }
+
+   // search in process unless the engine can't handle the pattern (e.g.
+   // a regex using syntax which boost doesn't support), in which case we
+   // fall back to grep
+   FindOptions findOptions;
+   findOptions.pattern = encodedString;
+   findOptions.asRegex = asRegex;
+   findOptions.ignoreCase = ignoreCase;
+   findOptions.directory = module_context::resolveAliasedPath(directory);
+   BOOST_FOREACH(json::Value filePattern, filePatterns)
+   {
+      findOptions.filePatterns.push_back(filePattern.get_str());
+   }
+   findOptions.excludeDirectories.push_back(".Rproj.user");
+   findOptions.excludeDirectories.push_back(".git");
+   findOptions.excludeDirectories.push_back(".svn");
+   findOptions.excludeDirectories.push_back("packrat/lib");
+   findOptions.excludeDirectories.push_back("packrat/src");
+   findOptions.maxResults = MAX_COUNT + 1;
+   findOptions.pSkipFiles = trigram_index::nonMatchingFiles(encodedString,
+                                                            asRegex,
+                                                            ignoreCase);
+
+   boost::shared_ptr<FindEngine> pEngine;
+   if (!FindEngine::create(findOptions, &pEngine))
+   {
+      boost::shared_ptr<EngineOperation> ptrEngineOp =
+                                 EngineOperation::create(encoding, pEngine);
+
+      // Clear existing results
+      findResults().clear();
+
+      findResults().onFindBegin(ptrEngineOp->handle(),
+                                searchString,
+                                directory,
+                                asRegex);
+      ptrEngineOp->start();
+      pResponse->setResult(ptrEngineOp->handle());
+
+      return Success();
+   }
+
    core::system::ProcessOptions options;
 
    core::system::Options childEnv;
@@ -451,21 +697,6 @@ core::Error beginFind(const json::JsonRpcRequest& request,
    error = tempFile.open_w(&pStream);
    if (error)
       return error;
-   std::string encoding = projects::projectContext().hasProject() ?
-                          projects::projectContext().defaultEncoding() :
-                          userSettings().defaultEncoding();
-   std::string encodedString;
-   error = r::util::iconvstr(searchString,
-                             "UTF-8",
-                             encoding,
-                             false,
-                             &encodedString);
-   if (error)
-   {
-      LOG_ERROR(error);
-      encodedString = searchString;
-   }
-
    *pStream << encodedString << std::endl;
    pStream.reset(); // release file handle
 
@@ -583,7 +814,8 @@ core::Error initialize()
    initBlock.addFunctions()
       (bind(registerRpcMethod, "begin_find", beginFind))
       (bind(registerRpcMethod, "stop_find", stopFind))
-      (bind(registerRpcMethod, "clear_find_results", clearFindResults));
+      (bind(registerRpcMethod, "clear_find_results", clearFindResults))
+      (trigram_index::initialize);
    return initBlock.execute();
 }
 
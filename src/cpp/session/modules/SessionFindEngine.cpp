@@ -0,0 +1,482 @@
+/*
+ * SessionFindEngine.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFindEngine.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/MappedFile.hpp>
+#include <core/Thread.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+
+namespace {
+
+// maximum number of threads used to search files
+const std::size_t kMaxSearchThreads = 8;
+
+// lines longer than this are truncated (the client only displays the
+// first 300 characters anyway)
+const std::size_t kMaxContentsSize = 4096;
+
+inline char toLowerAscii(char ch)
+{
+   return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+inline bool equalsIgnoreCase(char lhs, char rhs)
+{
+   return toLowerAscii(lhs) == toLowerAscii(rhs);
+}
+
+inline bool isSpace(char ch)
+{
+   return std::isspace(static_cast<unsigned char>(ch)) != 0;
+}
+
+// convert a grep --include style wildcard pattern to a regex
+boost::regex filePatternToRegex(const std::string& pattern)
+{
+   std::string regex;
+   BOOST_FOREACH(char ch, pattern)
+   {
+      if (ch == '*')
+         regex.append(".*");
+      else if (ch == '?')
+         regex.push_back('.');
+      else if (std::strchr("\\^$.|+()[]{}", ch) != NULL)
+      {
+         regex.push_back('\\');
+         regex.push_back(ch);
+      }
+      else
+         regex.push_back(ch);
+   }
+   return boost::regex(regex);
+}
+
+} // anonymous namespace
+
+Error FindEngine::create(const FindOptions& options,
+                         boost::shared_ptr<FindEngine>* pEngine)
+{
+   boost::shared_ptr<FindEngine> pNewEngine(new FindEngine(options));
+   try
+   {
+      if (options.asRegex)
+      {
+         boost::regex::flag_type flags = boost::regex::grep;
+         if (options.ignoreCase)
+            flags |= boost::regex::icase;
+         pNewEngine->regex_ = boost::regex(options.pattern, flags);
+      }
+
+      BOOST_FOREACH(const std::string& filePattern, options.filePatterns)
+      {
+         pNewEngine->filePatterns_.push_back(filePatternToRegex(filePattern));
+      }
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::invalid_argument,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      return error;
+   }
+
+   *pEngine = pNewEngine;
+   return Success();
+}
+
+FindEngine::FindEngine(const FindOptions& options)
+   : options_(options),
+     walking_(true),
+     stopped_(false),
+     runningThreads_(0),
+     matchCount_(0)
+{
+   threads_ = std::min(std::max(boost::thread::hardware_concurrency(), 1U),
+                       static_cast<unsigned>(kMaxSearchThreads));
+}
+
+void FindEngine::start()
+{
+   // one thread walks the directory tree and the rest search files
+   runningThreads_ = threads_ + 1;
+   boost::shared_ptr<FindEngine> pThis = shared_from_this();
+   core::thread::safeLaunchThread(boost::bind(&FindEngine::walk, pThis));
+   for (std::size_t i = 0; i < threads_; i++)
+      core::thread::safeLaunchThread(boost::bind(&FindEngine::searchFiles, pThis));
+}
+
+void FindEngine::stop()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      stopped_ = true;
+      files_.clear();
+   }
+   END_LOCK_MUTEX
+
+   filesAvailable_.notify_all();
+}
+
+bool FindEngine::takeMatches(std::vector<FindMatch>* pMatches)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      pMatches->insert(pMatches->end(), matches_.begin(), matches_.end());
+      matches_.clear();
+      return runningThreads_ > 0;
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+bool FindEngine::stopped()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return stopped_;
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
+void FindEngine::onThreadExit()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      --runningThreads_;
+   }
+   END_LOCK_MUTEX
+}
+
+void FindEngine::walk()
+{
+   try
+   {
+      walkDirectory(options_.directory);
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   LOCK_MUTEX(mutex_)
+   {
+      walking_ = false;
+   }
+   END_LOCK_MUTEX
+
+   filesAvailable_.notify_all();
+   onThreadExit();
+}
+
+void FindEngine::walkDirectory(const FilePath& directory)
+{
+   if (stopped())
+      return;
+
+   // unreadable directories are skipped (as they are by grep)
+   std::vector<FilePath> children;
+   Error error = directory.children(&children);
+   if (error)
+      return;
+
+   std::vector<std::string> files;
+   BOOST_FOREACH(const FilePath& child, children)
+   {
+      // symlinks within the tree are not followed
+      if (child.isSymlink())
+         continue;
+
+      if (child.isDirectory())
+      {
+         std::string path = child.absolutePath();
+         bool excluded = false;
+         BOOST_FOREACH(const std::string& exclude, options_.excludeDirectories)
+         {
+            if (boost::algorithm::ends_with(path, "/" + exclude))
+            {
+               excluded = true;
+               break;
+            }
+         }
+
+         if (!excluded)
+            walkDirectory(child);
+      }
+      else if (includeFile(child.filename()))
+      {
+         std::string path = child.absolutePath();
+         if (!options_.pSkipFiles || options_.pSkipFiles->count(path) == 0)
+            files.push_back(path);
+      }
+   }
+
+   if (files.empty())
+      return;
+
+   LOCK_MUTEX(mutex_)
+   {
+      if (!stopped_)
+         files_.insert(files_.end(), files.begin(), files.end());
+   }
+   END_LOCK_MUTEX
+
+   filesAvailable_.notify_all();
+}
+
+bool FindEngine::includeFile(const std::string& name) const
+{
+   if (filePatterns_.empty())
+      return true;
+
+   BOOST_FOREACH(const boost::regex& pattern, filePatterns_)
+   {
+      if (boost::regex_match(name, pattern))
+         return true;
+   }
+   return false;
+}
+
+void FindEngine::searchFiles()
+{
+   try
+   {
+      while (true)
+      {
+         std::string path;
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (files_.empty() && walking_ && !stopped_)
+               filesAvailable_.wait(lock);
+
+            if (stopped_ || files_.empty())
+               break;
+
+            path = files_.front();
+            files_.pop_front();
+         }
+
+         searchFile(path);
+      }
+   }
+   catch(const boost::thread_resource_error& e)
+   {
+      Error error(boost::thread_error::ec_from_exception(e), ERROR_LOCATION);
+      LOG_ERROR(error);
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   onThreadExit();
+}
+
+bool FindEngine::findNext(const char* begin,
+                          const char* end,
+                          const char* bufferBegin,
+                          const char** pMatchBegin,
+                          const char** pMatchEnd) const
+{
+   if (options_.asRegex)
+   {
+      boost::match_flag_type flags = boost::match_default |
+                                     boost::match_not_dot_newline;
+      if (begin != bufferBegin)
+         flags |= boost::match_prev_avail;
+
+      boost::cmatch match;
+      if (!boost::regex_search(begin, end, match, regex_, flags))
+         return false;
+
+      *pMatchBegin = match[0].first;
+      *pMatchEnd = match[0].second;
+      return true;
+   }
+
+   const std::string& pattern = options_.pattern;
+   if (pattern.empty())
+   {
+      *pMatchBegin = *pMatchEnd = begin;
+      return true;
+   }
+
+   const char* found = end;
+   if (options_.ignoreCase)
+   {
+      found = std::search(begin, end,
+                          pattern.begin(), pattern.end(),
+                          equalsIgnoreCase);
+   }
+   else
+   {
+      // find candidates for the first character with memchr (which is
+      // vectorized by the c library) and then compare the remainder
+      const char* pos = begin;
+      std::size_t size = pattern.size();
+      while (static_cast<std::size_t>(end - pos) >= size)
+      {
+         pos = static_cast<const char*>(
+                  ::memchr(pos, pattern[0], end - pos - size + 1));
+         if (pos == NULL)
+            break;
+
+         if (::memcmp(pos, pattern.data(), size) == 0)
+         {
+            found = pos;
+            break;
+         }
+         ++pos;
+      }
+   }
+
+   if (found == end)
+      return false;
+
+   *pMatchBegin = found;
+   *pMatchEnd = found + pattern.size();
+   return true;
+}
+
+void FindEngine::searchFile(const std::string& path)
+{
+   // unreadable files are skipped (as they are by grep)
+   MappedFile file;
+   Error error = file.open(FilePath(path));
+   if (error || file.empty())
+      return;
+
+   const char* begin = file.begin();
+   const char* end = file.end();
+
+   // skip binary files
+   if (::memchr(begin, '\0', file.size()) != NULL)
+      return;
+
+   std::vector<FindMatch> matches;
+   const char* pos = begin;
+   const char* counted = begin;
+   int line = 1;
+   while (pos < end)
+   {
+      const char* matchBegin;
+      const char* matchEnd;
+      if (!findNext(pos, end, begin, &matchBegin, &matchEnd))
+         break;
+
+      // find the line containing the start of the match (pos is always
+      // the beginning of a line)
+      const char* lineBegin = matchBegin;
+      while (lineBegin > pos && *(lineBegin - 1) != '\n')
+         --lineBegin;
+      const char* lineEnd = static_cast<const char*>(
+                              ::memchr(matchBegin, '\n', end - matchBegin));
+      if (lineEnd == NULL)
+         lineEnd = end;
+
+      // collect the matches within the line (note that regular expressions
+      // are searched for again within just the line, since grep matches
+      // lines individually)
+      FindMatch match;
+      bool found = false;
+      const char* contentsBegin = lineBegin;
+      const char* contentsEnd = lineEnd;
+      while (contentsBegin < contentsEnd && isSpace(*contentsBegin))
+         ++contentsBegin;
+      while (contentsEnd > contentsBegin && isSpace(*(contentsEnd - 1)))
+         --contentsEnd;
+      contentsEnd = std::min(contentsEnd, contentsBegin + kMaxContentsSize);
+
+      const char* linePos = lineBegin;
+      while (linePos <= lineEnd &&
+             findNext(linePos, lineEnd, begin, &matchBegin, &matchEnd))
+      {
+         found = true;
+         if (matchEnd > matchBegin)
+         {
+            const char* first = std::max(matchBegin, contentsBegin);
+            const char* last = std::min(matchEnd, contentsEnd);
+            if (first < last)
+            {
+               match.matches.push_back(std::make_pair(
+                                          first - contentsBegin,
+                                          last - contentsBegin));
+            }
+            linePos = matchEnd;
+         }
+         else
+         {
+            linePos = matchBegin + 1;
+         }
+      }
+
+      if (found)
+      {
+         line += std::count(counted, lineBegin, '\n');
+         counted = lineBegin;
+
+         match.absolutePath = path;
+         match.line = line;
+         match.contents.assign(contentsBegin, contentsEnd);
+         matches.push_back(match);
+
+         if (matches.size() >= options_.maxResults)
+            break;
+      }
+
+      pos = lineEnd + 1;
+   }
+
+   if (!matches.empty())
+      addMatches(matches);
+}
+
+void FindEngine::addMatches(const std::vector<FindMatch>& matches)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      if (stopped_)
+         return;
+
+      matches_.insert(matches_.end(), matches.begin(), matches.end());
+      matchCount_ += matches.size();
+      if (matchCount_ >= options_.maxResults)
+      {
+         stopped_ = true;
+         files_.clear();
+      }
+   }
+   END_LOCK_MUTEX
+
+   filesAvailable_.notify_all();
+}
+
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,145 @@
+/*
+ * SessionFindEngine.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_FIND_ENGINE_HPP
+#define SESSION_FIND_ENGINE_HPP
+
+#include <deque>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/regex.hpp>
+
+#include <core/BoostThread.hpp>
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+
+// a matching line (its contents are in the files' encoding, with leading
+// and trailing whitespace trimmed)
+struct FindMatch
+{
+   FindMatch() : line(0) {}
+
+   std::string absolutePath;
+   int line;
+   std::string contents;
+
+   // byte offsets of the [begin, end) of each match within contents
+   std::vector<std::pair<std::size_t, std::size_t> > matches;
+};
+
+struct FindOptions
+{
+   FindOptions()
+      : asRegex(false), ignoreCase(false), maxResults(0)
+   {
+   }
+
+   // the pattern in the files' encoding (regular expressions use grep's
+   // basic syntax)
+   std::string pattern;
+   bool asRegex;
+   bool ignoreCase;
+   core::FilePath directory;
+
+   // wildcard patterns for the names of files to search (all files are
+   // searched if there are none)
+   std::vector<std::string> filePatterns;
+
+   // names of directories which are never searched
+   std::vector<std::string> excludeDirectories;
+
+   // absolute paths of files which are known not to match (optional)
+   boost::shared_ptr<const std::set<std::string> > pSkipFiles;
+
+   // the search ends once this many matches have been found
+   std::size_t maxResults;
+};
+
+// Searches the files within a directory on background threads (one walks
+// the directory tree, the others search the files it finds), mirroring the
+// behavior of grep -rn --binary-files=without-match: symlinks within the
+// tree are skipped, as are files which contain null bytes
+class FindEngine : boost::noncopyable,
+                   public boost::enable_shared_from_this<FindEngine>
+{
+public:
+   // returns an error if the pattern isn't a valid regular expression
+   static core::Error create(const FindOptions& options,
+                             boost::shared_ptr<FindEngine>* pEngine);
+
+private:
+   explicit FindEngine(const FindOptions& options);
+
+public:
+   void start();
+   void stop();
+
+   // take the matches found since the last call (returns false once the
+   // search has completed and all of its matches have been taken)
+   bool takeMatches(std::vector<FindMatch>* pMatches);
+
+private:
+   void walk();
+   void walkDirectory(const core::FilePath& directory);
+   void searchFiles();
+   void searchFile(const std::string& path);
+   bool includeFile(const std::string& name) const;
+   bool findNext(const char* begin,
+                 const char* end,
+                 const char* bufferBegin,
+                 const char** pMatchBegin,
+                 const char** pMatchEnd) const;
+   void addMatches(const std::vector<FindMatch>& matches);
+   bool stopped();
+   void onThreadExit();
+
+private:
+   FindOptions options_;
+   boost::regex regex_;
+   std::vector<boost::regex> filePatterns_;
+   std::size_t threads_;
+
+   boost::mutex mutex_;
+   boost::condition_variable filesAvailable_;
+   std::deque<std::string> files_;
+   bool walking_;
+   bool stopped_;
+   std::size_t runningThreads_;
+   std::size_t matchCount_;
+   std::vector<FindMatch> matches_;
+};
+
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_FIND_ENGINE_HPP
@@ -0,0 +1,718 @@
+/*
+ * SessionFindIndex.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionFindIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/utility.hpp>
+
+#include <core/Error.hpp>
+#include <core/FileInfo.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/MappedFile.hpp>
+#include <core/Thread.hpp>
+#include <core/system/FileChangeEvent.hpp>
+
+#include <session/SessionModuleContext.hpp>
+#include <session/SessionOptions.hpp>
+#include <session/SessionWorkerPool.hpp>
+#include <session/projects/SessionProjects.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+namespace trigram_index {
+
+namespace {
+
+typedef boost::uint32_t Trigram;
+
+// larger files aren't indexed (and so are always searched)
+const boost::uint64_t kMaxIndexedFileSize = 4 * 1024 * 1024;
+
+// maximum number of files being indexed on the worker pool at once (so
+// the pool remains responsive to the rpc methods which also use it)
+const std::size_t kMaxPendingIndexTasks = 16;
+
+const char * const kIndexFileMagic = "RSTI";
+const boost::uint32_t kIndexFileVersion = 1;
+
+inline unsigned char foldAscii(unsigned char ch)
+{
+   return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+inline Trigram makeTrigram(const char* pos)
+{
+   return (static_cast<Trigram>(foldAscii(pos[0])) << 16) |
+          (static_cast<Trigram>(foldAscii(pos[1])) << 8) |
+          static_cast<Trigram>(foldAscii(pos[2]));
+}
+
+inline bool isAsciiTrigram(Trigram trigram)
+{
+   return (trigram & 0x808080) == 0;
+}
+
+void appendTrigrams(const char* begin,
+                    const char* end,
+                    std::vector<Trigram>* pTrigrams)
+{
+   for (const char* pos = begin; end - pos >= 3; ++pos)
+      pTrigrams->push_back(makeTrigram(pos));
+}
+
+void sortUnique(std::vector<Trigram>* pTrigrams)
+{
+   std::sort(pTrigrams->begin(), pTrigrams->end());
+   pTrigrams->erase(std::unique(pTrigrams->begin(), pTrigrams->end()),
+                    pTrigrams->end());
+}
+
+// extract the runs of literal characters which every match of the pattern
+// must contain. this is deliberately conservative: anything we don't
+// understand ends the current run, and patterns with alternation or groups
+// (which may be optional) yield no runs at all
+bool requiredLiterals(const std::string& pattern,
+                      bool asRegex,
+                      std::vector<std::string>* pLiterals)
+{
+   if (!asRegex)
+   {
+      pLiterals->push_back(pattern);
+      return true;
+   }
+
+   // grep syntax uses newlines for alternation
+   if (pattern.find('\n') != std::string::npos ||
+       pattern.find("\\|") != std::string::npos ||
+       pattern.find("\\(") != std::string::npos)
+   {
+      return false;
+   }
+
+   std::string run;
+   std::size_t i = 0;
+   while (i < pattern.size())
+   {
+      char ch = pattern[i];
+      if (ch == '\\' && i + 1 < pattern.size())
+      {
+         char next = pattern[i + 1];
+         i += 2;
+         if (std::strchr("{?+", next) != NULL)
+         {
+            // a quantifier makes the previous character optional
+            if (!run.empty())
+               run.erase(run.size() - 1);
+            pLiterals->push_back(run);
+            run.clear();
+
+            // skip the bounds of an interval
+            if (next == '{')
+            {
+               std::size_t end = pattern.find("\\}", i);
+               if (end == std::string::npos)
+                  return false;
+               i = end + 2;
+            }
+         }
+         else if (std::isalnum(static_cast<unsigned char>(next)) ||
+                  std::strchr("<>`'}", next) != NULL)
+         {
+            // character classes, anchors and back references
+            pLiterals->push_back(run);
+            run.clear();
+         }
+         else
+         {
+            run.push_back(next);
+         }
+      }
+      else if (ch == '[')
+      {
+         // skip the bracket expression (a leading ] is part of the set)
+         std::size_t end = i + 1;
+         if (end < pattern.size() && pattern[end] == '^')
+            ++end;
+         if (end < pattern.size() && pattern[end] == ']')
+            ++end;
+         end = pattern.find(']', end);
+         if (end == std::string::npos)
+            return false;
+         i = end + 1;
+         pLiterals->push_back(run);
+         run.clear();
+      }
+      else if (ch == '*')
+      {
+         if (!run.empty())
+            run.erase(run.size() - 1);
+         pLiterals->push_back(run);
+         run.clear();
+         ++i;
+      }
+      else if (ch == '.' || ch == '^' || ch == '$' || ch == '\\')
+      {
+         pLiterals->push_back(run);
+         run.clear();
+         ++i;
+      }
+      else
+      {
+         run.push_back(ch);
+         ++i;
+      }
+   }
+   pLiterals->push_back(run);
+   return true;
+}
+
+struct Entry
+{
+   Entry() : lastWriteTime(0), size(0) {}
+
+   std::time_t lastWriteTime;
+   boost::uint64_t size;
+
+   // sorted distinct trigrams within the file
+   std::vector<Trigram> trigrams;
+};
+
+typedef std::map<std::string, Entry> Entries;
+
+template <typename T>
+void appendValue(T value, std::string* pBuffer)
+{
+   pBuffer->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(const char** pPos, const char* end, T* pValue)
+{
+   if (static_cast<std::size_t>(end - *pPos) < sizeof(T))
+      return false;
+   std::memcpy(pValue, *pPos, sizeof(T));
+   *pPos += sizeof(T);
+   return true;
+}
+
+class TrigramIndex : boost::noncopyable
+{
+public:
+   TrigramIndex()
+      : enabled_(false),
+        dirty_(false),
+        nextSequence_(0),
+        pendingIndexCount_(0),
+        dispatching_(false),
+        initialIndexingCompleted_(false)
+   {
+   }
+
+   void setIndexFile(const FilePath& indexFile)
+   {
+      indexFile_ = indexFile;
+
+      Entries entries;
+      if (indexFile_.exists())
+      {
+         Error error = readIndexFile(&entries);
+         if (error)
+            LOG_ERROR(error);
+      }
+
+      LOCK_MUTEX(mutex_)
+      {
+         entries_.swap(entries);
+         enabled_ = true;
+      }
+      END_LOCK_MUTEX
+   }
+
+   // called with the contents of the project once monitoring begins:
+   // entries which are still current are kept and everything else is
+   // (re-)indexed
+   template <typename ForwardIterator>
+   void enqueFiles(ForwardIterator begin, ForwardIterator end)
+   {
+      std::vector<FileInfo> files;
+      LOCK_MUTEX(mutex_)
+      {
+         Entries current;
+         for (ForwardIterator it = begin; it != end; ++it)
+         {
+            if (it->isDirectory())
+               continue;
+
+            Entries::iterator entryIt = entries_.find(it->absolutePath());
+            if (entryIt != entries_.end() &&
+                entryIt->second.lastWriteTime == it->lastWriteTime() &&
+                entryIt->second.size == it->size())
+            {
+               Entry& entry = current[entryIt->first];
+               entry.lastWriteTime = entryIt->second.lastWriteTime;
+               entry.size = entryIt->second.size;
+               entry.trigrams.swap(entryIt->second.trigrams);
+            }
+            else
+            {
+               files.push_back(*it);
+            }
+         }
+         dirty_ = dirty_ || current.size() != entries_.size();
+         entries_.swap(current);
+      }
+      END_LOCK_MUTEX
+
+      std::for_each(files.begin(),
+                    files.end(),
+                    boost::bind(&TrigramIndex::enqueFile, this, _1));
+      scheduleDispatch();
+   }
+
+   void enqueFileChange(const core::system::FileChangeEvent& event)
+   {
+      const FileInfo& fileInfo = event.fileInfo();
+      std::string path = fileInfo.absolutePath();
+
+      // drop the entry right away so the file is searched until it has
+      // been re-indexed
+      LOCK_MUTEX(mutex_)
+      {
+         if (fileInfo.isDirectory())
+         {
+            std::string prefix = path + "/";
+            Entries::iterator it = entries_.lower_bound(prefix);
+            while (it != entries_.end() &&
+                   it->first.compare(0, prefix.size(), prefix) == 0)
+            {
+               entries_.erase(it++);
+            }
+         }
+         entries_.erase(path);
+         queued_.erase(path);
+         dirty_ = true;
+      }
+      END_LOCK_MUTEX
+
+      if (!fileInfo.isDirectory() &&
+          event.type() != core::system::FileChangeEvent::FileRemoved)
+      {
+         enqueFile(fileInfo);
+         scheduleDispatch();
+      }
+   }
+
+   void clear()
+   {
+      pending_.clear();
+      LOCK_MUTEX(mutex_)
+      {
+         entries_.clear();
+         queued_.clear();
+         enabled_ = false;
+         dirty_ = false;
+      }
+      END_LOCK_MUTEX
+      indexFile_ = FilePath();
+      initialIndexingCompleted_ = false;
+   }
+
+   void save()
+   {
+      if (indexFile_.empty())
+         return;
+
+      std::string buffer;
+      LOCK_MUTEX(mutex_)
+      {
+         if (!dirty_)
+            return;
+
+         buffer.append(kIndexFileMagic, 4);
+         appendValue(kIndexFileVersion, &buffer);
+         appendValue(static_cast<boost::uint32_t>(entries_.size()), &buffer);
+         BOOST_FOREACH(const Entries::value_type& entry, entries_)
+         {
+            appendValue(static_cast<boost::uint32_t>(entry.first.size()),
+                        &buffer);
+            buffer.append(entry.first);
+            appendValue(static_cast<boost::int64_t>(entry.second.lastWriteTime),
+                        &buffer);
+            appendValue(entry.second.size, &buffer);
+            const std::vector<Trigram>& trigrams = entry.second.trigrams;
+            appendValue(static_cast<boost::uint32_t>(trigrams.size()), &buffer);
+            if (!trigrams.empty())
+            {
+               buffer.append(reinterpret_cast<const char*>(&trigrams[0]),
+                             trigrams.size() * sizeof(Trigram));
+            }
+         }
+         dirty_ = false;
+      }
+      END_LOCK_MUTEX
+
+      Error error = writeStringToFile(indexFile_, buffer);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   boost::shared_ptr<const std::set<std::string> > nonMatchingFiles(
+                                                const std::string& pattern,
+                                                bool asRegex,
+                                                bool ignoreCase)
+   {
+      boost::shared_ptr<const std::set<std::string> > pResult;
+
+      std::vector<std::string> literals;
+      if (!requiredLiterals(pattern, asRegex, &literals))
+         return pResult;
+
+      std::vector<Trigram> query;
+      BOOST_FOREACH(const std::string& literal, literals)
+      {
+         appendTrigrams(literal.data(), literal.data() + literal.size(), &query);
+      }
+
+      // regular expressions may fold non-ascii characters when ignoring
+      // case (the index only folds ascii characters)
+      if (asRegex && ignoreCase)
+      {
+         query.erase(std::remove_if(query.begin(),
+                                    query.end(),
+                                    !boost::bind(isAsciiTrigram, _1)),
+                     query.end());
+      }
+
+      sortUnique(&query);
+      if (query.empty())
+         return pResult;
+
+      boost::shared_ptr<std::set<std::string> > pFiles(
+                                              new std::set<std::string>());
+      LOCK_MUTEX(mutex_)
+      {
+         if (!enabled_)
+            return pResult;
+
+         BOOST_FOREACH(const Entries::value_type& entry, entries_)
+         {
+            const std::vector<Trigram>& trigrams = entry.second.trigrams;
+            BOOST_FOREACH(Trigram trigram, query)
+            {
+               if (!std::binary_search(trigrams.begin(),
+                                       trigrams.end(),
+                                       trigram))
+               {
+                  pFiles->insert(pFiles->end(), entry.first);
+                  break;
+               }
+            }
+         }
+      }
+      END_LOCK_MUTEX
+
+      pResult = pFiles;
+      return pResult;
+   }
+
+private:
+   struct IndexRequest
+   {
+      FileInfo fileInfo;
+      unsigned sequence;
+   };
+
+   void enqueFile(const FileInfo& fileInfo)
+   {
+      if (fileInfo.size() > kMaxIndexedFileSize)
+         return;
+
+      IndexRequest request;
+      request.fileInfo = fileInfo;
+      LOCK_MUTEX(mutex_)
+      {
+         request.sequence = ++nextSequence_;
+         queued_[fileInfo.absolutePath()] = request.sequence;
+      }
+      END_LOCK_MUTEX
+      pending_.push_back(request);
+   }
+
+   void scheduleDispatch()
+   {
+      if (dispatching_)
+         return;
+
+      dispatching_ = true;
+      module_context::schedulePeriodicWork(
+               boost::posix_time::milliseconds(50),
+               boost::bind(&TrigramIndex::dispatch, this),
+               false);
+   }
+
+   // runs on the main thread: hand pending files to the worker pool
+   bool dispatch()
+   {
+      std::size_t pendingIndexCount = 0;
+      LOCK_MUTEX(mutex_)
+      {
+         pendingIndexCount = pendingIndexCount_;
+      }
+      END_LOCK_MUTEX
+
+      while (!pending_.empty() && pendingIndexCount < kMaxPendingIndexTasks)
+      {
+         IndexRequest request = pending_.front();
+         pending_.pop_front();
+
+         // (if the pool isn't running the file simply isn't indexed)
+         LOCK_MUTEX(mutex_)
+         {
+            ++pendingIndexCount_;
+         }
+         END_LOCK_MUTEX
+         if (worker_pool::execute(boost::bind(&TrigramIndex::indexFile,
+                                              this,
+                                              request),
+                                  core::thread::TaskPriorityLow))
+         {
+            ++pendingIndexCount;
+         }
+         else
+         {
+            LOCK_MUTEX(mutex_)
+            {
+               --pendingIndexCount_;
+               queued_.erase(request.fileInfo.absolutePath());
+            }
+            END_LOCK_MUTEX
+         }
+      }
+
+      if (pending_.empty() && pendingIndexCount == 0)
+      {
+         // persist the index once the initial indexing completes (after
+         // that it is saved at shutdown)
+         if (!initialIndexingCompleted_)
+         {
+            initialIndexingCompleted_ = true;
+            save();
+         }
+
+         dispatching_ = false;
+         return false;
+      }
+
+      return true;
+   }
+
+   // runs on the worker pool
+   void indexFile(const IndexRequest& request)
+   {
+      Entry entry;
+      bool indexed = false;
+      try
+      {
+         FilePath filePath(request.fileInfo.absolutePath());
+         entry.lastWriteTime = request.fileInfo.lastWriteTime();
+         entry.size = request.fileInfo.size();
+
+         MappedFile file;
+         Error error = file.open(filePath);
+         if (!error)
+         {
+            // binary files are never searched so they have no trigrams
+            if (::memchr(file.begin(), '\0', file.size()) == NULL)
+            {
+               appendTrigrams(file.begin(), file.end(), &entry.trigrams);
+               sortUnique(&entry.trigrams);
+            }
+            indexed = true;
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+
+      LOCK_MUTEX(mutex_)
+      {
+         --pendingIndexCount_;
+
+         // only keep the result if the file hasn't changed (or been
+         // removed) since it was queued
+         std::string path = request.fileInfo.absolutePath();
+         std::map<std::string, unsigned>::iterator it = queued_.find(path);
+         if (it != queued_.end() && it->second == request.sequence)
+         {
+            queued_.erase(it);
+            if (indexed && enabled_)
+            {
+               entries_[path] = entry;
+               dirty_ = true;
+            }
+         }
+      }
+      END_LOCK_MUTEX
+   }
+
+   Error readIndexFile(Entries* pEntries)
+   {
+      std::string buffer;
+      Error error = readStringFromFile(indexFile_, &buffer);
+      if (error)
+         return error;
+
+      const char* pos = buffer.data();
+      const char* end = buffer.data() + buffer.size();
+      boost::uint32_t version, count;
+      if (buffer.compare(0, 4, kIndexFileMagic) != 0)
+         return Success();
+      pos += 4;
+      if (!readValue(&pos, end, &version) || version != kIndexFileVersion)
+         return Success();
+      if (!readValue(&pos, end, &count))
+         return Success();
+
+      for (boost::uint32_t i = 0; i < count; i++)
+      {
+         boost::uint32_t pathSize, trigramCount;
+         boost::int64_t lastWriteTime;
+         Entry entry;
+         if (!readValue(&pos, end, &pathSize) ||
+             static_cast<std::size_t>(end - pos) < pathSize)
+         {
+            break;
+         }
+         std::string path(pos, pathSize);
+         pos += pathSize;
+
+         if (!readValue(&pos, end, &lastWriteTime) ||
+             !readValue(&pos, end, &entry.size) ||
+             !readValue(&pos, end, &trigramCount) ||
+             static_cast<std::size_t>(end - pos) / sizeof(Trigram) < trigramCount)
+         {
+            break;
+         }
+         entry.lastWriteTime = static_cast<std::time_t>(lastWriteTime);
+         entry.trigrams.resize(trigramCount);
+         if (trigramCount > 0)
+         {
+            std::memcpy(&entry.trigrams[0], pos, trigramCount * sizeof(Trigram));
+            pos += trigramCount * sizeof(Trigram);
+         }
+
+         (*pEntries)[path] = entry;
+      }
+
+      return Success();
+   }
+
+private:
+   // guards the members which are shared with the worker pool
+   boost::mutex mutex_;
+   Entries entries_;
+   std::map<std::string, unsigned> queued_;
+   bool enabled_;
+   bool dirty_;
+   unsigned nextSequence_;
+   std::size_t pendingIndexCount_;
+
+   // main thread only
+   FilePath indexFile_;
+   std::deque<IndexRequest> pending_;
+   bool dispatching_;
+   bool initialIndexingCompleted_;
+};
+
+TrigramIndex& trigramIndex()
+{
+   static TrigramIndex* s_pIndex = NULL;
+   if (s_pIndex == NULL)
+      s_pIndex = new TrigramIndex();
+   return *s_pIndex;
+}
+
+void onFileMonitorEnabled(const tree<core::FileInfo>& files)
+{
+   trigramIndex().setIndexFile(
+         projects::projectContext().scratchPath().complete("find-index"));
+   trigramIndex().enqueFiles(files.begin_leaf(), files.end_leaf());
+}
+
+void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+{
+   std::for_each(
+         events.begin(),
+         events.end(),
+         boost::bind(&TrigramIndex::enqueFileChange, &trigramIndex(), _1));
+}
+
+void onFileMonitorDisabled()
+{
+   // clear the index so it never excludes files which have changed
+   trigramIndex().clear();
+}
+
+void onShutdown(bool terminatedNormally)
+{
+   trigramIndex().save();
+}
+
+} // anonymous namespace
+
+boost::shared_ptr<const std::set<std::string> > nonMatchingFiles(
+                                                const std::string& pattern,
+                                                bool asRegex,
+                                                bool ignoreCase)
+{
+   return trigramIndex().nonMatchingFiles(pattern, asRegex, ignoreCase);
+}
+
+Error initialize()
+{
+   if (!session::options().findIndex())
+      return Success();
+
+   // (note that if there is no project this will no-op)
+   session::projects::FileMonitorCallbacks cb;
+   cb.onMonitoringEnabled = onFileMonitorEnabled;
+   cb.onFilesChanged = onFilesChanged;
+   cb.onMonitoringDisabled = onFileMonitorDisabled;
+   projects::projectContext().subscribeToFileMonitor("Find in files indexing",
+                                                     cb);
+   module_context::events().onShutdown.connect(onShutdown);
+
+   return Success();
+}
+
+} // namespace trigram_index
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
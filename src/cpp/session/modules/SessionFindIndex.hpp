@@ -0,0 +1,58 @@
+/*
+ * SessionFindIndex.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_FIND_INDEX_HPP
+#define SESSION_FIND_INDEX_HPP
+
+#include <set>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace find {
+namespace trigram_index {
+
+// The trigram index records the (ASCII case folded) three byte sequences
+// contained in each project text file. It is maintained from file monitor
+// events and persisted within the project scratch path, and lets find in
+// files skip indexed files which can't possibly contain a match.
+
+// returns the indexed files which can't match the (encoded) pattern. the
+// result is NULL if the index isn't available or can't narrow the search
+// (e.g. patterns with fewer than three literal characters); files which
+// aren't indexed are never included
+boost::shared_ptr<const std::set<std::string> > nonMatchingFiles(
+                                                const std::string& pattern,
+                                                bool asRegex,
+                                                bool ignoreCase);
+
+core::Error initialize();
+
+} // namespace trigram_index
+} // namespace find
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_FIND_INDEX_HPP
@@ -35,6 +35,7 @@
 #include <core/BoostLamda.hpp>
 
 #include <core/json/JsonRpc.hpp>
+#include <core/json/JsonWriter.hpp>
 #include <core/system/Crypto.hpp>
 #include <core/system/ShellUtils.hpp>
 #include <core/system/System.hpp>
@@ -174,6 +175,39 @@ struct RemoteBranchInfo
    }
 };
 
+// parsed history, cached so that paging through, searching and filtering
+// the history of large repositories doesn't read and parse it from git
+// again for each request. the cache is for a single history, identified
+// by the commit its revision resolved to and its file filter
+struct HistoryCache
+{
+   HistoryCache() : length(-1), haveCommits(false), graphComplete(false) {}
+
+   FilePath root;
+   std::string head;
+   FilePath fileFilter;
+
+   // number of commits (-1 if not yet known)
+   int length;
+
+   // all of the commits (read for searches and filtered histories)
+   bool haveCommits;
+   std::vector<CommitInfo> commits;
+
+   // graph lines for the start of the unfiltered history, along with the
+   // graph state for continuing it
+   std::vector<std::string> graphLines;
+   boost::shared_ptr<gitgraph::GitGraph> pGraph;
+   bool graphComplete;
+};
+
+HistoryCache s_historyCache;
+
+void resetHistoryCache()
+{
+   s_historyCache = HistoryCache();
+}
+
 class Git;
 
 std::vector<PidType> s_pidsToTerminate_;
@@ -202,10 +236,33 @@ std::string gitBin()
 }
 #endif
 
+// the status of the whole repository is cached briefly and shared by
+// status queries for any directory within it (so that e.g. listing a
+// directory and decorating its files doesn't run git status repeatedly).
+// the cache is discarded whenever git runs, files change, or R code runs
+// and isn't used if the index has been written since it was filled
+const int kStatusCacheMs = 3000;
+
+struct StatusCache
+{
+   StatusCache() : valid(false), generation(0), indexWriteTime(0) {}
+   bool valid;
+   int generation;
+   FilePath root;
+   std::time_t indexWriteTime;
+   boost::posix_time::ptime updated;
+   StatusResult result;
+};
+
+StatusCache s_statusCache;
+
 Error gitExec(const ShellArgs& args,
               const core::FilePath& workingDir,
               core::system::ProcessResult* pResult)
 {
+   // git may be about to change the status
+   invalidateStatusCache();
+
    core::system::ProcessOptions options = procOptions();
    options.workingDir = workingDir;
    // Important to ensure SSH_ASKPASS works
@@ -227,6 +284,27 @@ Error gitExec(const ShellArgs& args,
 #endif
 }
 
+// runs git via the process supervisor (only used for read-only commands so
+// unlike gitExec doesn't invalidate the status cache)
+Error gitExecAsync(const ShellArgs& args,
+                   const core::FilePath& workingDir,
+                   const core::system::ProcessCallbacks& callbacks)
+{
+   core::system::ProcessOptions options = procOptions();
+   options.workingDir = workingDir;
+#ifdef _WIN32
+   options.detachProcess = true;
+   return module_context::processSupervisor().runProgram(gitBin(),
+                                                         args.args(),
+                                                         options,
+                                                         callbacks);
+#else
+   return module_context::processSupervisor().runCommand(git() << args.args(),
+                                                         options,
+                                                         callbacks);
+#endif
+}
+
 bool commitIsMatch(const std::vector<std::string>& patterns,
                    const CommitInfo& commit)
 {
@@ -328,6 +406,8 @@ protected:
                                      console_process::kDefaultMaxOutputLines);
 #endif
 
+      (*ppCP)->onExit().connect(boost::bind(&invalidateStatusCache));
+      (*ppCP)->onExit().connect(boost::bind(&resetHistoryCache));
       (*ppCP)->onExit().connect(boost::bind(&enqueueRefreshEvent));
 
       return Success();
@@ -386,20 +466,53 @@ public:
       root_ = path;
    }
 
-   core::Error status(const FilePath& dir,
-                      StatusResult* pStatusResult)
+   std::time_t indexWriteTime() const
    {
-      using namespace boost;
+      return root_.childPath(".git/index").lastWriteTime();
+   }
+
+   bool cachedStatus(StatusResult* pStatusResult) const
+   {
+      using namespace boost::posix_time;
+
+      if (!s_statusCache.valid ||
+          s_statusCache.root != root_ ||
+          (microsec_clock::universal_time() - s_statusCache.updated) >
+                                          milliseconds(kStatusCacheMs) ||
+          s_statusCache.indexWriteTime != indexWriteTime())
+      {
+         return false;
+      }
+
+      *pStatusResult = s_statusCache.result;
+      return true;
+   }
+
+   void cacheStatus(int generation,
+                    std::time_t indexTime,
+                    const StatusResult& statusResult)
+   {
+      // don't cache results which may have been invalidated while git ran
+      if (generation != s_statusCache.generation)
+         return;
+
+      s_statusCache.valid = true;
+      s_statusCache.root = root_;
+      s_statusCache.indexWriteTime = indexTime;
+      s_statusCache.updated = boost::posix_time::microsec_clock::universal_time();
+      s_statusCache.result = statusResult;
+   }
+
+   ShellArgs statusArgs(const FilePath& dir)
+   {
+      return ShellArgs() << "status" << "--porcelain" << "--" << dir;
+   }
 
+   StatusResult parseStatus(const std::string& output)
+   {
       std::vector<FileWithStatus> files;
 
-      std::vector<std::string> lines;
-      std::string output;
-      Error error = runGit(ShellArgs() << "status" << "--porcelain" << "--" << dir,
-                           &output);
-      if (error)
-         return error;
-      lines = split(output);
+      std::vector<std::string> lines = split(output);
 
       for (std::vector<std::string>::iterator it = lines.begin();
            it != lines.end();
@@ -420,7 +533,29 @@ public:
          files.push_back(file);
       }
 
-      *pStatusResult = StatusResult(files);
+      return StatusResult(files);
+   }
+
+   core::Error status(const FilePath& dir,
+                      StatusResult* pStatusResult)
+   {
+      // the status of the whole repository serves any directory within it
+      // (results are looked up by path so the extra entries are harmless)
+      bool cacheable = (dir == root_) || dir.isWithin(root_);
+      if (cacheable && cachedStatus(pStatusResult))
+         return Success();
+
+      std::time_t indexTime = indexWriteTime();
+
+      std::string output;
+      Error error = runGit(statusArgs(cacheable ? root_ : dir), &output);
+      if (error)
+         return error;
+
+      *pStatusResult = parseStatus(output);
+
+      if (cacheable)
+         cacheStatus(s_statusCache.generation, indexTime, *pStatusResult);
 
       return Success();
    }
@@ -545,16 +680,16 @@ public:
       }
    }
 
-   core::Error listBranches(std::vector<std::string>* pBranches,
-                            boost::optional<size_t>* pActiveBranchIndex)
+   ShellArgs listBranchesArgs()
    {
-      std::vector<std::string> lines;
+      return ShellArgs() << "branch" << "-a";
+   }
 
-      std::string output;
-      Error error = runGit(ShellArgs() << "branch" << "-a", &output);
-      if (error)
-         return error;
-      lines = split(output);
+   void parseBranches(const std::string& output,
+                      std::vector<std::string>* pBranches,
+                      boost::optional<size_t>* pActiveBranchIndex)
+   {
+      std::vector<std::string> lines = split(output);
 
       for (size_t i = 0; i < lines.size(); i++)
       {
@@ -566,6 +701,17 @@ public:
             *pActiveBranchIndex = i;
          pBranches->push_back(line.substr(2));
       }
+   }
+
+   core::Error listBranches(std::vector<std::string>* pBranches,
+                            boost::optional<size_t>* pActiveBranchIndex)
+   {
+      std::string output;
+      Error error = runGit(listBranchesArgs(), &output);
+      if (error)
+         return error;
+
+      parseBranches(output, pBranches, pActiveBranchIndex);
 
       return Success();
    }
@@ -753,11 +899,10 @@ public:
                                "Git Pull", true, ppCP);
    }
 
-   core::Error doDiffFile(const FilePath& filePath,
+   ShellArgs diffFileArgs(const FilePath& filePath,
                           const FilePath* pCompareTo,
                           PatchMode mode,
-                          int contextLines,
-                          std::string* pOutput)
+                          int contextLines)
    {
       ShellArgs args = ShellArgs() << "diff";
       args << "-U" + safe_convert::numberToString(contextLines);
@@ -767,24 +912,31 @@ public:
       if (pCompareTo)
          args << *pCompareTo;
       args << filePath;
-
-      return runGit(args, pOutput, NULL, NULL);
+      return args;
    }
 
-   core::Error diffFile(const FilePath& filePath,
-                        PatchMode mode,
-                        int contextLines,
-                        std::string* pOutput)
+   core::Error doDiffFile(const FilePath& filePath,
+                          const FilePath* pCompareTo,
+                          PatchMode mode,
+                          int contextLines,
+                          std::string* pOutput)
    {
-      Error error = doDiffFile(filePath, NULL, mode, contextLines, pOutput);
-      if (error)
-         return error;
+      return runGit(diffFileArgs(filePath, pCompareTo, mode, contextLines),
+                    pOutput, NULL, NULL);
+   }
 
+   // an empty diff may be for an untracked file, in which case we diff
+   // against /dev/null to show it as added
+   core::Error diffUntrackedFile(const FilePath& filePath,
+                                 PatchMode mode,
+                                 int contextLines,
+                                 std::string* pOutput)
+   {
       if (pOutput->empty())
       {
          // detect add case
          VCSStatus status;
-         error = git::fileStatus(filePath, &status);
+         Error error = git::fileStatus(filePath, &status);
          if (error)
             return error;
          if (status.status() == "??" && mode == PatchModeWorking)
@@ -871,141 +1023,97 @@ public:
       }
    }
 
-   core::Error logLength(const std::string &rev,
-                         const FilePath& fileFilter,
-                         const std::string &searchText,
-                         int *pLength)
+   // resolve the revision and reset the history cache if it was for a
+   // different history. returns false if the history can't be cached (in
+   // which case it's read from git on each request)
+   bool useHistoryCache(const std::string& rev, const FilePath& fileFilter)
    {
-      if (searchText.empty())
+      std::string head;
+      int exitCode = EXIT_FAILURE;
+      Error error = runGit(ShellArgs() << "rev-parse" << "--verify" << "-q" <<
+                                          (rev.empty() ? "HEAD" : rev),
+                           &head, NULL, &exitCode);
+      if (error || exitCode != EXIT_SUCCESS)
       {
-         ShellArgs args = ShellArgs() << "log";
-         args << "--pretty=oneline";
-         if (!rev.empty())
-            args << rev;
-
-         if (!fileFilter.empty())
-            args << "--" << fileFilter;
-
-         std::string output;
-         Error error = runGit(args, &output);
-         if (error)
-            return error;
-
-         *pLength = static_cast<int>(std::count(output.begin(), output.end(), '\n'));
-         return Success();
+         resetHistoryCache();
+         return false;
       }
-      else
+      boost::algorithm::trim(head);
+
+      if (s_historyCache.root != root_ ||
+          s_historyCache.head != head ||
+          s_historyCache.fileFilter != fileFilter)
       {
-         std::vector<CommitInfo> output;
-         Error error = log(rev, fileFilter, 0, -1, searchText, &output);
-         if (error)
-            return error;
-         *pLength = output.size();
-         return Success();
+         resetHistoryCache();
+         s_historyCache.root = root_;
+         s_historyCache.head = head;
+         s_historyCache.fileFilter = fileFilter;
       }
+
+      return true;
    }
 
-   core::Error log(const std::string& rev,
-                   const FilePath& fileFilter,
-                   int skip,
-                   int maxentries,
-                   const std::string& searchText,
-                   std::vector<CommitInfo>* pOutput)
+   // extend the graph of the (unfiltered) history to cover at least the
+   // given number of commits, continuing from where it left off
+   core::Error extendGraph(HistoryCache* pCache, std::size_t count)
    {
-      ShellArgs args = ShellArgs() << "log" << "--encoding=UTF-8"
-                       << "--pretty=raw" << "--decorate=full"
-                       << "--date-order";
+      if (pCache->graphComplete || pCache->graphLines.size() >= count)
+         return Success();
 
-      ShellArgs revListArgs = ShellArgs() << "rev-list" << "--date-order" << "--parents";
-      int revListSkip = skip;
+      std::size_t needed = count - pCache->graphLines.size();
+      ShellArgs revListArgs = ShellArgs() << "rev-list" << "--date-order"
+                              << "--parents"
+                              << "--skip=" + safe_convert::numberToString(
+                                                   pCache->graphLines.size())
+                              << "--max-count=" + safe_convert::numberToString(
+                                                   needed)
+                              << pCache->head;
+
+      std::string revOutput;
+      Error error = runGit(revListArgs, &revOutput);
+      if (error)
+         return error;
+      std::vector<std::string> revOutLines = split(revOutput);
+      revOutput.clear();
 
-      if (!fileFilter.empty())
-      {
-         args << "--" << fileFilter;
-         revListArgs << "--" << fileFilter;
-      }
+      if (!pCache->pGraph)
+         pCache->pGraph.reset(new gitgraph::GitGraph());
 
-      if (searchText.empty() && fileFilter.empty())
+      std::size_t added = 0;
+      for (size_t i = 0; i < revOutLines.size(); i++)
       {
-         // This is a way more efficient way to implement skip and maxentries
-         // if we know that all commits are included.
-         if (skip > 0)
-         {
-            args << "--skip=" + safe_convert::numberToString(skip);
-            skip = 0;
-         }
-         if (maxentries >= 0)
-         {
-            args << "--max-count=" + safe_convert::numberToString(maxentries);
-            maxentries = -1;
+         typedef std::vector<std::string> find_vector_type;
+         find_vector_type parents;
+         boost::algorithm::split(parents, revOutLines[i],
+                                 boost::algorithm::is_any_of(" "));
+         if (parents.size() < 1 || parents.front().empty())
+            break;
 
-            revListArgs << "--max-count=" + safe_convert::numberToString(
-                  (skip < 0 ? 0 : skip) + maxentries);
-         }
-      }
+         std::string commit = parents.front();
+         parents.erase(parents.begin());
 
-      if (!rev.empty())
-      {
-         args << rev;
-         revListArgs << rev;
-      }
-      else
-      {
-         revListArgs << "HEAD";
+         gitgraph::Line line = pCache->pGraph->addCommit(commit, parents);
+         pCache->graphLines.push_back(line.string());
+         added++;
       }
 
-      if (maxentries < 0)
-         maxentries = std::numeric_limits<int>::max();
-
-      std::vector<std::string> outLines;
-      std::string output;
-      Error error = runGit(args, &output);
-      if (error)
-         return error;
-      outLines = split(output);
-      output.clear();
-
-      std::vector<std::string> graphLines;
-      if (searchText.empty() && fileFilter.empty())
-      {
-         std::vector<std::string> revOutLines;
-         std::string revOutput;
-         error = runGit(revListArgs, &revOutput);
-         if (error)
-            return error;
-         revOutLines = split(revOutput);
-         revOutput.clear();
+      if (added < needed)
+         pCache->graphComplete = true;
 
-         gitgraph::GitGraph graph;
-         for (size_t i = 0; i < revOutLines.size(); i++)
-         {
-            typedef std::vector<std::string> find_vector_type;
-            find_vector_type parents;
-            boost::algorithm::split(parents, revOutLines[i],
-                                    boost::algorithm::is_any_of(" "));
-            if (parents.size() < 1)
-               break;
-
-            std::string commit = parents.front();
-            parents.erase(parents.begin());
-
-            gitgraph::Line line = graph.addCommit(commit, parents);
-            if (revListSkip <= 0 || static_cast<int>(i) >= revListSkip)
-               graphLines.push_back(line.string());
-         }
-      }
+      return Success();
+   }
 
-      boost::function<bool(CommitInfo)> filter = createSearchTextPredicate(searchText);
+   void parseLog(const std::string& output, std::vector<CommitInfo>* pCommits)
+   {
+      std::vector<std::string> outLines = split(output);
 
       boost::regex kvregex("^(\\w+) (.*)$");
       boost::regex authTimeRegex("^(.*?) (\\d+) ([+\\-]?\\d+)$");
 
-      size_t graphLineIndex = 0;
-      int skipped = 0;
       CommitInfo currentCommit;
 
       for (std::vector<std::string>::const_iterator it = outLines.begin();
-           it != outLines.end() && pOutput->size() < static_cast<size_t>(maxentries);
+           it != outLines.end();
            it++)
       {
          boost::smatch smatch;
@@ -1015,19 +1123,8 @@ public:
             std::string value = smatch[2];
             if (key == "commit")
             {
-               if (!currentCommit.id.empty() && filter(currentCommit))
-               {
-                  if (skipped < skip)
-                     skipped++;
-                  else
-                  {
-                     if (graphLineIndex < graphLines.size())
-                        currentCommit.graph = graphLines[graphLineIndex];
-                     pOutput->push_back(currentCommit);
-                  }
-
-                  graphLineIndex++;
-               }
+               if (!currentCommit.id.empty())
+                  pCommits->push_back(currentCommit);
 
                currentCommit = CommitInfo();
                parseCommitValue(value, &currentCommit);
@@ -1072,44 +1169,205 @@ public:
          }
       }
 
-      if (pOutput->size() < static_cast<size_t>(maxentries)
-          && !currentCommit.id.empty()
-          && filter(currentCommit))
+      if (!currentCommit.id.empty())
+         pCommits->push_back(currentCommit);
+   }
+
+   core::Error logLength(const std::string &rev,
+                         const FilePath& fileFilter,
+                         const std::string &searchText,
+                         int *pLength)
+   {
+      if (searchText.empty())
       {
+         bool cached = useHistoryCache(rev, fileFilter);
+         if (cached && s_historyCache.length >= 0)
+         {
+            *pLength = s_historyCache.length;
+            return Success();
+         }
+
+         ShellArgs args = ShellArgs() << "log";
+         args << "--pretty=oneline";
+         if (cached)
+            args << s_historyCache.head;
+         else if (!rev.empty())
+            args << rev;
+
+         if (!fileFilter.empty())
+            args << "--" << fileFilter;
+
+         std::string output;
+         Error error = runGit(args, &output);
+         if (error)
+            return error;
+
+         *pLength = static_cast<int>(std::count(output.begin(), output.end(), '\n'));
+         if (cached)
+            s_historyCache.length = *pLength;
+         return Success();
+      }
+      else
+      {
+         std::vector<CommitInfo> output;
+         Error error = log(rev, fileFilter, 0, -1, searchText, &output);
+         if (error)
+            return error;
+         *pLength = output.size();
+         return Success();
+      }
+   }
+
+   core::Error log(const std::string& rev,
+                   const FilePath& fileFilter,
+                   int skip,
+                   int maxentries,
+                   const std::string& searchText,
+                   std::vector<CommitInfo>* pOutput)
+   {
+      if (skip < 0)
+         skip = 0;
+      if (maxentries < 0)
+         maxentries = std::numeric_limits<int>::max();
+
+      bool cached = useHistoryCache(rev, fileFilter);
+
+      ShellArgs args = ShellArgs() << "log" << "--encoding=UTF-8"
+                       << "--pretty=raw" << "--decorate=full"
+                       << "--date-order";
+
+      if (searchText.empty() && fileFilter.empty())
+      {
+         // This is a way more efficient way to implement skip and maxentries
+         // if we know that all commits are included.
+         if (skip > 0)
+            args << "--skip=" + safe_convert::numberToString(skip);
+         if (maxentries < std::numeric_limits<int>::max())
+            args << "--max-count=" + safe_convert::numberToString(maxentries);
+         if (cached)
+            args << s_historyCache.head;
+         else if (!rev.empty())
+            args << rev;
+
+         std::string output;
+         Error error = runGit(args, &output);
+         if (error)
+            return error;
+         std::vector<CommitInfo> commits;
+         parseLog(output, &commits);
+         output.clear();
+
+         // the graph is built from the start of the history, so it's
+         // cached along with the state needed to continue it for the
+         // following pages
+         HistoryCache uncachedHistory;
+         uncachedHistory.head = rev.empty() ? "HEAD" : rev;
+         HistoryCache* pHistory = cached ? &s_historyCache : &uncachedHistory;
+         error = extendGraph(pHistory, skip + commits.size());
+         if (error)
+            return error;
+
+         for (std::size_t i = 0; i < commits.size(); i++)
+         {
+            if (skip + i < pHistory->graphLines.size())
+               commits[i].graph = pHistory->graphLines[skip + i];
+            pOutput->push_back(commits[i]);
+         }
+
+         return Success();
+      }
+
+      // searches and filtered histories need all of the commits (which
+      // we cache so that refining a search or paging through the results
+      // doesn't read and parse the whole history again)
+      std::vector<CommitInfo> uncachedCommits;
+      std::vector<CommitInfo>* pCommits = &uncachedCommits;
+      if (cached)
+         pCommits = &s_historyCache.commits;
+
+      if (!cached || !s_historyCache.haveCommits)
+      {
+         if (cached)
+            args << s_historyCache.head;
+         else if (!rev.empty())
+            args << rev;
+         if (!fileFilter.empty())
+            args << "--" << fileFilter;
+
+         std::string output;
+         Error error = runGit(args, &output);
+         if (error)
+            return error;
+         pCommits->clear();
+         parseLog(output, pCommits);
+         if (cached)
+         {
+            s_historyCache.haveCommits = true;
+            if (searchText.empty())
+               s_historyCache.length = static_cast<int>(pCommits->size());
+         }
+      }
+
+      boost::function<bool(CommitInfo)> filter = createSearchTextPredicate(searchText);
+
+      int skipped = 0;
+      for (std::vector<CommitInfo>::const_iterator it = pCommits->begin();
+           it != pCommits->end() &&
+              pOutput->size() < static_cast<size_t>(maxentries);
+           ++it)
+      {
+         if (!filter(*it))
+            continue;
+
          if (skipped < skip)
             skipped++;
          else
-         {
-            if (graphLineIndex < graphLines.size())
-               currentCommit.graph = graphLines[graphLineIndex];
-            pOutput->push_back(currentCommit);
-         }
-         graphLineIndex++;
+            pOutput->push_back(*it);
       }
 
       return Success();
    }
 
-   virtual core::Error show(const std::string& rev,
-                            std::string* pOutput)
+   ShellArgs showArgs(const std::string& rev)
    {
       ShellArgs args = ShellArgs() << "show" << "--pretty=oneline" << "-M";
       if (s_gitVersion >= GIT_1_7_2)
          args << "-c";
       args << rev;
+      return args;
+   }
+
+   virtual core::Error show(const std::string& rev,
+                            std::string* pOutput)
+   {
+      return runGit(showArgs(rev), pOutput);
+   }
 
-      return runGit(args, pOutput);
+   ShellArgs showFileArgs(const std::string& rev, const std::string& filename)
+   {
+      boost::format fmt("%1%:%2%");
+      return ShellArgs() << "show" << boost::str(fmt % rev % filename);
    }
 
    virtual core::Error showFile(const std::string& rev,
                                 const std::string& filename,
                                 std::string* pOutput)
    {
-      boost::format fmt("%1%:%2%");
-      ShellArgs args =
-            ShellArgs() << "show" << boost::str(fmt % rev % filename);
+      return runGit(showFileArgs(rev, filename), pOutput);
+   }
 
-      return runGit(args, pOutput);
+   // run git via the process supervisor (see vcs_utils::runAsync)
+   void runGitAsync(const std::string& channel,
+                    const std::string& params,
+                    const ShellArgs& args,
+                    const ProcResultCallback& onCompleted,
+                    std::size_t maxOutput = 0)
+   {
+      runAsync(channel,
+               params,
+               boost::bind(gitExecAsync, args, root_, _1),
+               onCompleted,
+               maxOutput);
    }
 
    virtual core::Error remoteBranchInfo(RemoteBranchInfo* pRemoteBranchInfo)
@@ -1283,6 +1541,12 @@ core::Error status(const FilePath& dir, StatusResult* pStatusResult)
    return s_git_.status(dir, pStatusResult);
 }
 
+void invalidateStatusCache()
+{
+   s_statusCache.valid = false;
+   s_statusCache.generation++;
+}
+
 Error fileStatus(const FilePath& filePath, VCSStatus* pStatus)
 {
    StatusResult statusResult;
@@ -1382,15 +1646,9 @@ Error vcsUnstage(const json::JsonRpcRequest& request,
    return s_git_.unstage(resolveAliasedPaths(paths, true, true));
 }
 
-Error vcsListBranches(const json::JsonRpcRequest& request,
-                      json::JsonRpcResponse* pResponse)
+json::Object branchesToJson(const std::vector<std::string>& branches,
+                            const boost::optional<size_t>& activeIndex)
 {
-   std::vector<std::string> branches;
-   boost::optional<size_t> activeIndex;
-   Error error = s_git_.listBranches(&branches, &activeIndex);
-   if (error)
-      return error;
-
    json::Array jsonBranches;
    std::transform(branches.begin(), branches.end(),
                   std::back_inserter(jsonBranches),
@@ -1402,10 +1660,36 @@ Error vcsListBranches(const json::JsonRpcRequest& request,
          activeIndex
             ? json::Value(static_cast<boost::uint64_t>(activeIndex.get()))
             : json::Value();
+   return result;
+}
 
-   pResponse->setResult(result);
+void vcsListBranchesEnd(const json::JsonRpcFunctionContinuation& cont,
+                        Error error,
+                        const core::system::ProcessResult& result)
+{
+   json::JsonRpcResponse response;
 
-   return Success();
+   if (error)
+   {
+      cont(error, &response);
+      return;
+   }
+
+   std::vector<std::string> branches;
+   boost::optional<size_t> activeIndex;
+   s_git_.parseBranches(result.stdOut, &branches, &activeIndex);
+   response.setResult(branchesToJson(branches, activeIndex));
+
+   cont(Success(), &response);
+}
+
+void vcsListBranches(const json::JsonRpcRequest&,
+                     const json::JsonRpcFunctionContinuation& cont)
+{
+   s_git_.runGitAsync("git_list_branches",
+                      "",
+                      s_git_.listBranchesArgs(),
+                      boost::bind(vcsListBranchesEnd, cont, _1, _2));
 }
 
 Error vcsCheckout(const json::JsonRpcRequest& request,
@@ -1428,57 +1712,115 @@ Error vcsCheckout(const json::JsonRpcRequest& request,
    return Success();
 }
 
-Error vcsFullStatus(const json::JsonRpcRequest&,
-                    json::JsonRpcResponse* pResponse)
+void writeStatusJson(const FilePath& path,
+                     const VCSStatus& status,
+                     json::Writer* pWriter)
 {
-   StatusResult statusResult;
-   Error error = s_git_.status(s_git_.root(), &statusResult);
-   if (error)
-      return error;
+   // NOTE: same fields as statusToJson
+   std::string statusCode = status.status();
+   pWriter->startObject();
+   pWriter->member("status", statusCode);
+   pWriter->member("path", path.relativePath(s_git_.root()));
+   pWriter->member("raw_path", module_context::createAliasedPath(path));
+   pWriter->member("discardable", statusCode[1] != ' ' && statusCode[1] != '?');
+   pWriter->member("is_directory", path.isDirectory());
+   pWriter->endObject();
+}
 
+void writeFullStatus(const StatusResult& statusResult, json::Writer* pWriter)
+{
+   // stream the status (avoids building a json::Value for each file, which
+   // is significant for large working trees)
    std::vector<FileWithStatus> files = statusResult.files();
-   json::Array result;
+   pWriter->startArray();
    for (std::vector<FileWithStatus>::const_iterator it = files.begin();
         it != files.end();
         it++)
    {
-      VCSStatus status = it->status;
-      FilePath path = it->path;
-      json::Object obj;
-      error = statusToJson(path, status, &obj);
-      if (error)
-         return error;
-      result.push_back(obj);
+      writeStatusJson(it->path, it->status, pWriter);
    }
+   pWriter->endArray();
+}
 
-   pResponse->setResult(result);
+void vcsFullStatusEnd(int generation,
+                      std::time_t indexTime,
+                      const json::JsonRpcFunctionContinuation& cont,
+                      Error error,
+                      const core::system::ProcessResult& result)
+{
+   json::JsonRpcResponse response;
 
-   return Success();
+   if (error)
+   {
+      cont(error, &response);
+      return;
+   }
+
+   StatusResult statusResult = s_git_.parseStatus(result.stdOut);
+   s_git_.cacheStatus(generation, indexTime, statusResult);
+
+   json::Writer writer;
+   writeFullStatus(statusResult, &writer);
+   response.setRawResult(writer.str());
+
+   cont(Success(), &response);
+}
+
+void vcsFullStatus(const json::JsonRpcRequest&,
+                   const json::JsonRpcFunctionContinuation& cont)
+{
+   // a recent status can be returned right away
+   StatusResult statusResult;
+   if (s_git_.cachedStatus(&statusResult))
+   {
+      json::Writer writer;
+      writeFullStatus(statusResult, &writer);
+
+      json::JsonRpcResponse response;
+      response.setRawResult(writer.str());
+      cont(Success(), &response);
+      return;
+   }
+
+   s_git_.runGitAsync("git_full_status",
+                      "",
+                      s_git_.statusArgs(s_git_.root()),
+                      boost::bind(vcsFullStatusEnd,
+                                  s_statusCache.generation,
+                                  s_git_.indexWriteTime(),
+                                  cont,
+                                  _1,
+                                  _2));
 }
 
 Error vcsAllStatus(const json::JsonRpcRequest& request,
                    json::JsonRpcResponse* pResponse)
 {
-   json::Object result;
-   json::JsonRpcResponse tmp;
+   json::Writer writer;
+   writer.startObject();
 
-   Error error = vcsFullStatus(request, &tmp);
+   StatusResult statusResult;
+   Error error = s_git_.status(s_git_.root(), &statusResult);
    if (error)
       return error;
-   result["status"] = tmp.result();
+   writer.key("status");
+   writeFullStatus(statusResult, &writer);
 
-   error = vcsListBranches(request, &tmp);
+   std::vector<std::string> branches;
+   boost::optional<size_t> activeIndex;
+   error = s_git_.listBranches(&branches, &activeIndex);
    if (error)
       return error;
-   result["branches"] = tmp.result();
+   writer.member("branches", branchesToJson(branches, activeIndex));
 
    RemoteBranchInfo remoteBranchInfo;
    error = s_git_.remoteBranchInfo(&remoteBranchInfo);
    if (error)
       return error;
-   result["remote_branch_info"] = remoteBranchInfo.toJson();
+   writer.member("remote_branch_info", remoteBranchInfo.toJson());
 
-   pResponse->setResult(result);
+   writer.endObject();
+   pResponse->setRawResult(writer.str());
 
    return Success();
 }
@@ -1542,33 +1884,29 @@ Error vcsPull(const json::JsonRpcRequest& request,
    return Success();
 }
 
-Error vcsDiffFile(const json::JsonRpcRequest& request,
-                  json::JsonRpcResponse* pResponse)
+void vcsDiffFileEnd(const FilePath& filePath,
+                    PatchMode mode,
+                    int contextLines,
+                    bool noSizeWarning,
+                    const json::JsonRpcFunctionContinuation& cont,
+                    Error error,
+                    const core::system::ProcessResult& result)
 {
-   std::string path;
-   int mode;
-   int contextLines;
-   bool noSizeWarning;
-   Error error = json::readParams(request.params,
-                                  &path,
-                                  &mode,
-                                  &contextLines,
-                                  &noSizeWarning);
    if (error)
-      return error;
+   {
+      continueWithError(cont, error);
+      return;
+   }
 
-   if (contextLines < 0)
-      contextLines = 999999999;
+   json::JsonRpcResponse response;
 
-   splitRename(path, NULL, &path);
-
-   std::string output;
-   error = s_git_.diffFile(resolveAliasedPath(path),
-                                 static_cast<PatchMode>(mode),
-                                 contextLines,
-                                 &output);
+   std::string output = result.stdOut;
+   error = s_git_.diffUntrackedFile(filePath, mode, contextLines, &output);
    if (error)
-      return error;
+   {
+      cont(error, &response);
+      return;
+   }
 
    std::string sourceEncoding = projects::projectContext().defaultEncoding();
    bool usedSourceEncoding;
@@ -1581,17 +1919,61 @@ Error vcsDiffFile(const json::JsonRpcRequest& request,
    {
       error = systemError(boost::system::errc::file_too_large,
                           ERROR_LOCATION);
-      pResponse->setError(error,
-                          json::Value(static_cast<boost::uint64_t>(output.size())));
+      response.setError(error,
+                        json::Value(static_cast<boost::uint64_t>(output.size())));
    }
    else
    {
-      json::Object result;
-      result["source_encoding"] = sourceEncoding;
-      result["decoded_value"] = output;
-      pResponse->setResult(result);
+      json::Object resultObj;
+      resultObj["source_encoding"] = sourceEncoding;
+      resultObj["decoded_value"] = output;
+      response.setResult(resultObj);
    }
-   return Success();
+
+   cont(Success(), &response);
+}
+
+void vcsDiffFile(const json::JsonRpcRequest& request,
+                 const json::JsonRpcFunctionContinuation& cont)
+{
+   std::string path;
+   int mode;
+   int contextLines;
+   bool noSizeWarning;
+   Error error = json::readParams(request.params,
+                                  &path,
+                                  &mode,
+                                  &contextLines,
+                                  &noSizeWarning);
+   if (error)
+   {
+      json::JsonRpcResponse response;
+      cont(error, &response);
+      return;
+   }
+
+   if (contextLines < 0)
+      contextLines = 999999999;
+
+   splitRename(path, NULL, &path);
+
+   FilePath filePath = resolveAliasedPath(path);
+   PatchMode patchMode = static_cast<PatchMode>(mode);
+   s_git_.runGitAsync("git_diff_file",
+                      json::write(request.params),
+                      s_git_.diffFileArgs(filePath,
+                                          NULL,
+                                          patchMode,
+                                          contextLines),
+                      boost::bind(vcsDiffFileEnd,
+                                  filePath,
+                                  patchMode,
+                                  contextLines,
+                                  noSizeWarning,
+                                  cont,
+                                  _1,
+                                  _2),
+                      noSizeWarning ? 0 : source_control::WARN_SIZE);
 }
 
 Error vcsApplyPatch(const json::JsonRpcRequest& request,
@@ -1922,57 +2304,100 @@ Error vcsHistory(const json::JsonRpcRequest& request,
    return Success();
 }
 
-Error vcsShow(const json::JsonRpcRequest& request,
-              json::JsonRpcResponse* pResponse)
+void vcsShowEnd(bool noSizeWarning,
+                const json::JsonRpcFunctionContinuation& cont,
+                Error error,
+                const core::system::ProcessResult& result)
 {
-   std::string rev;
-   bool noSizeWarning;
-   Error error = json::readParams(request.params, &rev, &noSizeWarning);
    if (error)
-      return error;
+   {
+      continueWithError(cont, error);
+      return;
+   }
 
-   std::string output;
-   s_git_.show(rev, &output);
-   output = convertDiff(output, projects::projectContext().defaultEncoding(),
-                        "UTF-8", true);
+   json::JsonRpcResponse response;
+
+   std::string output = convertDiff(result.stdOut,
+                                    projects::projectContext().defaultEncoding(),
+                                    "UTF-8", true);
    output = string_utils::filterControlChars(output);
 
    if (!noSizeWarning && output.size() > source_control::WARN_SIZE)
    {
       error = systemError(boost::system::errc::file_too_large,
                           ERROR_LOCATION);
-      pResponse->setError(error,
-                          json::Value(static_cast<boost::uint64_t>(output.size())));
+      response.setError(error,
+                        json::Value(static_cast<boost::uint64_t>(output.size())));
    }
    else
    {
-      pResponse->setResult(output);
+      response.setResult(output);
    }
-   return Success();
-}
 
+   cont(Success(), &response);
+}
 
-Error vcsShowFile(const json::JsonRpcRequest& request,
-                  json::JsonRpcResponse* pResponse)
+void vcsShow(const json::JsonRpcRequest& request,
+             const json::JsonRpcFunctionContinuation& cont)
 {
-   std::string rev,filename;
-   Error error = json::readParams(request.params, &rev, &filename);
+   std::string rev;
+   bool noSizeWarning;
+   Error error = json::readParams(request.params, &rev, &noSizeWarning);
    if (error)
-      return error;
+   {
+      json::JsonRpcResponse response;
+      cont(error, &response);
+      return;
+   }
+
+   s_git_.runGitAsync("git_show",
+                      json::write(request.params),
+                      s_git_.showArgs(rev),
+                      boost::bind(vcsShowEnd, noSizeWarning, cont, _1, _2),
+                      noSizeWarning ? 0 : source_control::WARN_SIZE);
+}
+
+void vcsShowFileEnd(const json::JsonRpcFunctionContinuation& cont,
+                    Error error,
+                    const core::system::ProcessResult& result)
+{
+   json::JsonRpcResponse response;
 
-   std::string output;
-   error = s_git_.showFile(rev, filename, &output);
    if (error)
-      return error;
+   {
+      cont(error, &response);
+      return;
+   }
 
    // convert to utf8
-   output = convertToUtf8(output, false);
+   std::string output = convertToUtf8(result.stdOut, false);
 
    output = string_utils::filterControlChars(output);
 
-   pResponse->setResult(output);
+   response.setResult(output);
 
-   return Success();
+   cont(Success(), &response);
+}
+
+void vcsShowFile(const json::JsonRpcRequest& request,
+                 const json::JsonRpcFunctionContinuation& cont)
+{
+   std::string rev,filename;
+   Error error = json::readParams(request.params, &rev, &filename);
+   if (error)
+   {
+      json::JsonRpcResponse response;
+      cont(error, &response);
+      return;
+   }
+
+   // each file gets its own channel (viewing one file doesn't supersede
+   // viewing another)
+   std::string params = json::write(request.params);
+   s_git_.runGitAsync("git_show_file" + params,
+                      params,
+                      s_git_.showFileArgs(rev, filename),
+                      boost::bind(vcsShowFileEnd, cont, _1, _2));
 }
 
 
@@ -2727,6 +3152,13 @@ Error statusToJson(const core::FilePath &path,
    return Success();
 }
 
+void onDetectChanges(module_context::ChangeSource source)
+{
+   // R code may have changed files or run git itself
+   if (source == module_context::ChangeSourceREPL)
+      invalidateStatusCache();
+}
+
 void onSuspend(core::Settings*)
 {
 }
@@ -2856,6 +3288,7 @@ core::Error initialize()
    Error error;
 
    module_context::events().onShutdown.connect(onShutdown);
+   module_context::events().onDetectChanges.connect(onDetectChanges);
 
    initGitBin();
 
@@ -2910,19 +3343,19 @@ core::Error initialize()
       (bind(registerRpcMethod, "git_revert", vcsRevert))
       (bind(registerRpcMethod, "git_stage", vcsStage))
       (bind(registerRpcMethod, "git_unstage", vcsUnstage))
-      (bind(registerRpcMethod, "git_list_branches", vcsListBranches))
+      (bind(registerAsyncRpcMethod, "git_list_branches", vcsListBranches))
       (bind(registerRpcMethod, "git_checkout", vcsCheckout))
-      (bind(registerRpcMethod, "git_full_status", vcsFullStatus))
+      (bind(registerAsyncRpcMethod, "git_full_status", vcsFullStatus))
       (bind(registerRpcMethod, "git_all_status", vcsAllStatus))
       (bind(registerRpcMethod, "git_commit", vcsCommit))
       (bind(registerRpcMethod, "git_push", vcsPush))
       (bind(registerRpcMethod, "git_pull", vcsPull))
-      (bind(registerRpcMethod, "git_diff_file", vcsDiffFile))
+      (bind(registerAsyncRpcMethod, "git_diff_file", vcsDiffFile))
       (bind(registerRpcMethod, "git_apply_patch", vcsApplyPatch))
       (bind(registerRpcMethod, "git_history_count", vcsHistoryCount))
       (bind(registerRpcMethod, "git_history", vcsHistory))
-      (bind(registerRpcMethod, "git_show", vcsShow))
-      (bind(registerRpcMethod, "git_show_file", vcsShowFile))
+      (bind(registerAsyncRpcMethod, "git_show", vcsShow))
+      (bind(registerAsyncRpcMethod, "git_show_file", vcsShowFile))
       (bind(registerRpcMethod, "git_export_file", vcsExportFile))
       (bind(registerRpcMethod, "git_ssh_public_key", vcsSshPublicKey))
       (bind(registerRpcMethod, "git_has_repo", vcsHasRepo))
@@ -71,6 +71,7 @@ core::Error status(const core::FilePath& dir,
                    source_control::StatusResult* pStatusResult);
 core::Error fileStatus(const core::FilePath& filePath,
                        source_control::VCSStatus* pStatus);
+void invalidateStatusCache();
 core::Error statusToJson(const core::FilePath& path,
                          const source_control::VCSStatus& status,
                          core::json::Object* pObject);
@@ -31,6 +31,7 @@
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
 #include <core/HtmlUtils.hpp>
 #include <core/http/Util.hpp>
 #include <core/PerformanceTimer.hpp>
@@ -82,6 +83,7 @@ private:
       : targetFile_(targetFile),
         isMarkdown_(false),
         isInternalMarkdown_(false),
+        requiresMathJax_(false),
         isNotebook_(false),
         requiresKnit_(false)
    {
@@ -125,6 +127,9 @@ public:
 
    bool isInternalMarkdown() { return isInternalMarkdown_; }
 
+   // (determined while rendering internal markdown)
+   bool requiresMathJax() { return requiresMathJax_; }
+
    bool isNotebook() { return isNotebook_; }
 
    bool requiresKnit() { return requiresKnit_; }
@@ -196,9 +201,11 @@ private:
          boost::format fmt;
 
          fmt = boost::format("require(knitr); "
+                              "%3%"
                               "knit('%2%', encoding='%1%');");
 
-         cmd = boost::str(fmt % encoding % targetFile_.filename());
+         cmd = boost::str(fmt % encoding % targetFile_.filename() %
+                          knitrCacheSetup());
       }
       else
       {
@@ -206,10 +213,11 @@ private:
                                            outputFileTempFile.absolutePath());
          boost::format fmt;
          fmt = boost::format("require(knitr); "
+                             "%4%"
                              "knit('%2%', encoding='%1%'); "
                              "cat(o, file='%3%');");
          cmd = boost::str(fmt % encoding % targetFile_.filename() % 
-                          tempFilePath);
+                          tempFilePath % knitrCacheSetup());
       }
 
       outputPathTempFile_ = outputFileTempFile;
@@ -219,6 +227,46 @@ private:
                                     async_r::R_PROCESS_REDIRECTSTDERR);
    }
 
+   // R code which has knitr cache chunk output between previews. Chunks
+   // are made to depend on all of the chunks before them, so a chunk is
+   // only re-run when its own code or any upstream code has changed
+   std::string knitrCacheSetup()
+   {
+      // notebooks remove their figures once rendered, so cached chunks
+      // would refer to missing files
+      if (isNotebook())
+         return std::string();
+
+      if (!r::options::getOption<bool>("rstudio.htmlPreview.cacheChunks",
+                                       true))
+      {
+         return std::string();
+      }
+
+      // keep the cache out of the user's directory (one per target file)
+      FilePath cachePath = module_context::scopedScratchPath()
+            .childPath("html_preview_cache")
+            .childPath(hash::xxHash64Hex(targetFile_.absolutePath()));
+      Error error = cachePath.ensureDirectory();
+      if (error)
+      {
+         LOG_ERROR(error);
+         return std::string();
+      }
+
+      // (option hooks require knitr 1.10 or later)
+      boost::format fmt("if (exists('opts_hooks', "
+                                    "envir = asNamespace('knitr'))) { "
+                           "opts_chunk$set(cache = TRUE, "
+                                          "cache.path = '%1%/'); "
+                           "opts_hooks$set(cache = function(options) { "
+                              "dep_prev(); options "
+                           "}) "
+                        "}; ");
+      return boost::str(fmt % string_utils::singleQuotedStrEscape(
+                   string_utils::utf8ToSystem(cachePath.absolutePath())));
+   }
+
    bool targetIsRMarkdown()
    {
       std::string ext = targetFile_.extensionLowerCase();
@@ -346,7 +394,8 @@ private:
                                             content,
                                             markdown::Extensions(),
                                             markdown::HTMLOptions(),
-                                            &htmlContent);
+                                            &htmlContent,
+                                            &requiresMathJax_);
             if (error)
             {
                terminateWithError(error);
@@ -447,6 +496,7 @@ private:
    FilePath outputPathTempFile_;
    bool isMarkdown_;
    bool isInternalMarkdown_;
+   bool requiresMathJax_;
    bool isNotebook_;
    bool requiresKnit_;
    std::string encoding_;
@@ -832,7 +882,7 @@ void handleInternalMarkdownPreviewRequest(
          setVarFromHtmlResourceFile("r_highlight", &vars);
       else
          vars["r_highlight"]  = "";
-      if (markdown::isMathJaxRequired(htmlOutput))
+      if (s_pCurrentPreview_->requiresMathJax())
          setVarFromHtmlResourceFile("mathjax", &vars);
       else
          vars["mathjax"] = "";
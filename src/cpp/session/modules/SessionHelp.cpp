@@ -16,8 +16,10 @@
 #include "SessionHelp.hpp"
 
 #include <algorithm>
+#include <deque>
 
 #include <boost/regex.hpp>
+#include <boost/foreach.hpp>
 #include <boost/function.hpp>
 #include <boost/format.hpp>
 #include <boost/range/iterator_range.hpp>
@@ -27,6 +29,7 @@
 
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
+#include <core/Hash.hpp>
 #include <core/Log.hpp>
 
 #include <core/http/Request.hpp>
@@ -52,6 +55,9 @@
 #include "presentation/SlideRequestHandler.hpp"
 
 #include "SessionHelpHome.hpp"
+#include "SessionHelpIndex.hpp"
+
+#include "viewer/ViewerHistory.hpp"
 
 // protect R against windows TRUE/FALSE defines
 #undef TRUE
@@ -671,12 +677,16 @@ void handleRdPreviewRequest(const http::Request& request,
    }
 }
 
+typedef boost::function<void(SEXP)> HttpdResultHandler;
+
 template <typename Filter>
 void handleHttpdRequest(const std::string& location,
                         const HandlerSource& handlerSource,
                         const http::Request& request, 
                         const Filter& filter,
-                        http::Response* pResponse)
+                        http::Response* pResponse,
+                        const HttpdResultHandler& onHttpdResult =
+                                                      HttpdResultHandler())
 {
    // get the requested path
    std::string path = http::util::pathAfterPrefix(request, location);
@@ -763,6 +773,9 @@ void handleHttpdRequest(const std::string& location,
    // content returned from httpd
    else if (TYPEOF(httpdSEXP) == VECSXP && LENGTH(httpdSEXP) > 0)
    {
+      if (onHttpdResult)
+         onHttpdResult(httpdSEXP);
+
       handleHttpdResult(httpdSEXP, request, filter, pResponse);
    }
    
@@ -847,8 +860,13 @@ void handleSessionRequest(const http::Request& request, http::Response* pRespons
    // form a path to the temporary file
    FilePath tempFilePath = r::session::utils::tempDir().childPath(uri);
 
-   // return the file
-   pResponse->setCacheWithRevalidationHeaders();
+   // return the file (viewer widget dependencies are named by their content
+   // so they can be cached indefinitely)
+   std::string assetsPrefix = std::string(viewer::kViewerAssetsDir) + "/";
+   if (boost::algorithm::starts_with(uri, assetsPrefix))
+      pResponse->setPrivateCacheForeverHeaders();
+   else
+      pResponse->setCacheWithRevalidationHeaders();
    if (tempFilePath.mimeContentType() == "text/html")
    {
       pResponse->setCacheableFile(tempFilePath, request);
@@ -859,16 +877,446 @@ void handleSessionRequest(const http::Request& request, http::Response* pRespons
    }
 }
 
+// Help pages for installed packages (and the redirects to them) only change
+// when packages are installed or removed, so we keep what R's httpd returns
+// for them in the user scratch dir where all of the user's sessions can share
+// it. There is a cache per set of library paths, which is cleared whenever
+// one of the libraries is modified.
+
+// maximum number of linked topics to prefetch for a page
+const std::size_t kMaxPrefetchLinks = 10;
+
+struct CachedHelpPage
+{
+   CachedHelpPage() : code(http::status::Ok) {}
+   int code;
+   std::string location;
+   std::string html;
+};
+
+FilePath helpCacheDir()
+{
+   static std::string rVersion = module_context::rVersion();
+
+   std::string libPaths = rVersion;
+   std::string stamp;
+   BOOST_FOREACH(const FilePath& libPath, module_context::getLibPaths())
+   {
+      if (libPath.empty())
+         continue;
+      libPaths.append("\n" + libPath.absolutePath());
+      stamp.append(libPath.absolutePath() + ":" +
+                   safe_convert::numberToString(libPath.lastWriteTime()) +
+                   "\n");
+   }
+
+   FilePath cacheDir = module_context::userScratchPath()
+         .childPath("help_cache")
+         .childPath(hash::xxHash64Hex(libPaths));
+
+   // start over if the libraries have changed
+   FilePath stampFile = cacheDir.childPath("STAMP");
+   std::string previousStamp;
+   if (stampFile.exists())
+   {
+      Error error = readStringFromFile(stampFile, &previousStamp);
+      if (error)
+         LOG_ERROR(error);
+   }
+   if (previousStamp != stamp)
+   {
+      Error error = cacheDir.removeIfExists();
+      if (!error)
+         error = cacheDir.ensureDirectory();
+      if (!error)
+         error = writeStringToFile(stampFile, stamp);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return FilePath();
+      }
+   }
+
+   return cacheDir;
+}
+
+// cache file for a help path (empty if the path isn't cacheable)
+FilePath helpCacheFile(const std::string& path, const http::Request& request)
+{
+   static const boost::regex reHelpPage("^/library/([^/]+)/(?:html|help)/[^/]+$");
+   boost::smatch match;
+   if (!request.queryParams().empty() || !boost::regex_match(path, match, reHelpPage))
+      return FilePath();
+
+   // only packages installed in a library (not e.g. source packages
+   // loaded for development)
+   std::string packagePath;
+   r::exec::RFunction findPackage("find.package", match[1].str());
+   findPackage.addParam("quiet", true);
+   Error error = findPackage.call(&packagePath);
+   if (error || packagePath.empty())
+      return FilePath();
+   FilePath libPath = FilePath(packagePath).parent();
+   bool inLibrary = false;
+   BOOST_FOREACH(const FilePath& path, module_context::getLibPaths())
+   {
+      if (path == libPath)
+      {
+         inLibrary = true;
+         break;
+      }
+   }
+   if (!inLibrary)
+      return FilePath();
+
+   FilePath cacheDir = helpCacheDir();
+   if (cacheDir.empty())
+      return FilePath();
+
+   return cacheDir.childPath(hash::xxHash64Hex(path));
+}
+
+// extract the html (or redirect) from an httpd result if it's cacheable
+bool httpdResultAsCachedPage(SEXP httpdSEXP, CachedHelpPage* pPage)
+{
+   // must be html (if content type is present)
+   if (LENGTH(httpdSEXP) > 1)
+   {
+      SEXP ctSEXP = VECTOR_ELT(httpdSEXP, 1);
+      if (TYPEOF(ctSEXP) == STRSXP && LENGTH(ctSEXP) > 0 &&
+          std::strcmp(CHAR(STRING_ELT(ctSEXP, 0)), "text/html") != 0)
+      {
+         return false;
+      }
+   }
+
+   // must be ok or a redirect
+   if (LENGTH(httpdSEXP) > 3)
+      pPage->code = r::sexp::asInteger(VECTOR_ELT(httpdSEXP, 3));
+   if (pPage->code != http::status::Ok &&
+       pPage->code != http::status::MovedTemporarily)
+   {
+      return false;
+   }
+
+   // the only header we keep is the redirect location
+   if (LENGTH(httpdSEXP) > 2)
+   {
+      std::vector<std::string> headers;
+      SEXP headersSEXP = VECTOR_ELT(httpdSEXP, 2);
+      if (TYPEOF(headersSEXP) == STRSXP)
+         r::sexp::extract(headersSEXP, &headers);
+      BOOST_FOREACH(const std::string& header, headers)
+      {
+         if (!boost::algorithm::istarts_with(header, "Location:"))
+            return false;
+         pPage->location = boost::algorithm::trim_copy(header.substr(9));
+      }
+   }
+   if ((pPage->code == http::status::MovedTemporarily) !=
+       !pPage->location.empty())
+   {
+      return false;
+   }
+
+   // read the content (possibly from a file)
+   SEXP payloadSEXP = VECTOR_ELT(httpdSEXP, 0);
+   if ((TYPEOF(payloadSEXP) != STRSXP && TYPEOF(payloadSEXP) != VECSXP) ||
+       LENGTH(payloadSEXP) == 0)
+   {
+      return false;
+   }
+
+   std::string content;
+   if (TYPEOF(payloadSEXP) == STRSXP)
+      content = r::sexp::asString(STRING_ELT(payloadSEXP, 0));
+   else
+      content = r::sexp::asString(VECTOR_ELT(payloadSEXP, 0));
+
+   SEXP namesSEXP = r::sexp::getNames(httpdSEXP);
+   if (TYPEOF(namesSEXP) == STRSXP && LENGTH(namesSEXP) > 0 &&
+       !std::strcmp(CHAR(STRING_ELT(namesSEXP, 0)), "file"))
+   {
+      Error error = readStringFromFile(FilePath(content), &pPage->html);
+      if (error)
+         return false;
+   }
+   else if (LENGTH(payloadSEXP) > 1 && content == "*FILE*")
+   {
+      return false;
+   }
+   else
+   {
+      pPage->html = content;
+   }
+
+   return true;
+}
+
+bool readCachedHelpPage(const FilePath& cacheFile, CachedHelpPage* pPage)
+{
+   if (!cacheFile.exists())
+      return false;
+
+   // status code and location on the first two lines, then the html
+   std::string contents;
+   Error error = readStringFromFile(cacheFile, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   std::size_t codeEnd = contents.find('\n');
+   std::size_t locationEnd = contents.find('\n', codeEnd + 1);
+   if (codeEnd == std::string::npos || locationEnd == std::string::npos)
+      return false;
+
+   pPage->code = safe_convert::stringTo<int>(contents.substr(0, codeEnd), 0);
+   pPage->location = contents.substr(codeEnd + 1, locationEnd - codeEnd - 1);
+   pPage->html = contents.substr(locationEnd + 1);
+   return pPage->code != 0;
+}
+
+void writeCachedHelpPage(const FilePath& cacheFile, const CachedHelpPage& page)
+{
+   std::string contents = safe_convert::numberToString(page.code) + "\n" +
+                          page.location + "\n" +
+                          page.html;
+
+   // write to a temporary file then move it into place, so other sessions
+   // never see a partially written page
+   FilePath tempFile = cacheFile.parent().childPath(
+                                       cacheFile.filename() + "-" +
+                                       core::system::generateShortenedUuid());
+   Error error = writeStringToFile(tempFile, contents);
+   if (!error)
+      error = tempFile.move(cacheFile);
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempFile.removeIfExists();
+   }
+}
+
+void onHelpHttpdResult(const FilePath& cacheFile, SEXP httpdSEXP)
+{
+   CachedHelpPage page;
+   if (httpdResultAsCachedPage(httpdSEXP, &page))
+      writeCachedHelpPage(cacheFile, page);
+}
+
+void setCachedHelpPageResponse(const CachedHelpPage& page,
+                               const http::Request& request,
+                               const HelpContentsFilter& filter,
+                               http::Response* pResponse)
+{
+   pResponse->setStatusCode(page.code);
+   pResponse->setContentType("text/html");
+   if (page.code == http::status::Ok)
+   {
+      setDynamicContentResponse(page.html, request, filter, pResponse);
+   }
+   else
+   {
+      pResponse->setHeaderLine("Location: " + page.location);
+      pResponse->setBodyUnencoded(page.html);
+   }
+}
+
+// resolve a link relative to the help path it appears in
+std::string resolveHelpLink(const std::string& path, const std::string& link)
+{
+   std::vector<std::string> components;
+   boost::algorithm::split(components, path, boost::algorithm::is_any_of("/"));
+   components.pop_back();
+
+   std::vector<std::string> linkComponents;
+   boost::algorithm::split(linkComponents, link,
+                           boost::algorithm::is_any_of("/"));
+   BOOST_FOREACH(const std::string& component, linkComponents)
+   {
+      if (component == "..")
+      {
+         if (components.size() > 1)
+            components.pop_back();
+      }
+      else if (component != ".")
+      {
+         components.push_back(component);
+      }
+   }
+
+   return boost::algorithm::join(components, "/");
+}
+
+// help paths waiting to be prefetched
+std::deque<std::string> s_prefetchPaths;
+
+bool prefetchNextHelpPage()
+{
+   if (s_prefetchPaths.empty())
+      return false;
+
+   std::string path = s_prefetchPaths.front();
+   s_prefetchPaths.pop_front();
+
+   http::Request request;
+   FilePath cacheFile = helpCacheFile(path, request);
+   if (cacheFile.empty() || cacheFile.exists())
+      return !s_prefetchPaths.empty();
+
+   HandlerSource handlerSource = boost::bind(r::sexp::findFunction,
+                                             "httpd",
+                                             "tools");
+   r::sexp::Protect rp;
+   SEXP httpdSEXP;
+   Error error = r::exec::executeSafely<SEXP>(
+         boost::bind(callHandler,
+                     path,
+                     boost::cref(request),
+                     handlerSource,
+                     &rp),
+         &httpdSEXP);
+
+   CachedHelpPage page;
+   if (!error && TYPEOF(httpdSEXP) == VECSXP && LENGTH(httpdSEXP) > 0 &&
+       httpdResultAsCachedPage(httpdSEXP, &page))
+   {
+      writeCachedHelpPage(cacheFile, page);
+
+      // follow redirects to the page itself
+      if (page.code == http::status::MovedTemporarily &&
+          !boost::algorithm::contains(page.location, "://"))
+      {
+         std::string location = boost::algorithm::starts_with(page.location, "/")
+                                 ? page.location
+                                 : resolveHelpLink(path, page.location);
+         s_prefetchPaths.push_front(location);
+      }
+   }
+
+   return !s_prefetchPaths.empty();
+}
+
+void prefetchLinkedHelpPages(const std::string& path, const std::string& html)
+{
+   static const boost::regex reLink("href=\"([^\"#?:]+)\"");
+
+   bool schedule = s_prefetchPaths.empty();
+
+   // links on the current page replace any still waiting to be prefetched
+   s_prefetchPaths.clear();
+   boost::sregex_iterator it(html.begin(), html.end(), reLink);
+   boost::sregex_iterator end;
+   for (; it != end && s_prefetchPaths.size() < kMaxPrefetchLinks; ++it)
+   {
+      std::string link = (*it)[1].str();
+      if (boost::algorithm::starts_with(link, "/"))
+         continue;
+      std::string linkPath = resolveHelpLink(path, link);
+      if (boost::algorithm::starts_with(linkPath, "/library/") &&
+          std::find(s_prefetchPaths.begin(), s_prefetchPaths.end(), linkPath) ==
+                                                         s_prefetchPaths.end())
+      {
+         s_prefetchPaths.push_back(linkPath);
+      }
+   }
+
+   if (schedule && !s_prefetchPaths.empty())
+   {
+      module_context::scheduleIncrementalWork(
+                           boost::posix_time::milliseconds(300),
+                           prefetchNextHelpPage,
+                           true,
+                           module_context::WorkPriorityLow);
+   }
+}
+
+void rebuildHelpIndex()
+{
+   // an incremental task is already draining the packages of any rebuild
+   // in progress, so only schedule one if we're starting afresh
+   bool schedule = !helpIndex().isRebuilding();
+   helpIndex().beginRebuild(module_context::getLibPaths());
+   if (schedule)
+   {
+      module_context::scheduleIncrementalWork(
+                     boost::posix_time::milliseconds(100),
+                     boost::bind(&HelpIndex::indexNextPackage, &helpIndex()),
+                     true,
+                     module_context::WorkPriorityLow);
+   }
+}
+
+Error searchHelpIndex(const json::JsonRpcRequest& request,
+                      json::JsonRpcResponse* pResponse)
+{
+   std::string query;
+   int maxResults;
+   Error error = json::readParams(request.params, &query, &maxResults);
+   if (error)
+      return error;
+
+   // until the first build completes the client falls back to help.search
+   if (!helpIndex().isAvailable())
+   {
+      pResponse->setResult(json::Value());
+      return Success();
+   }
+
+   std::vector<HelpSearchResult> results;
+   helpIndex().search(query, std::max(maxResults, 0), &results);
+
+   json::Array resultsJson;
+   BOOST_FOREACH(const HelpSearchResult& result, results)
+   {
+      json::Object resultJson;
+      resultJson["package"] = result.package;
+      resultJson["topic"] = result.topic;
+      resultJson["title"] = result.title;
+      resultJson["url"] = result.url;
+      resultJson["score"] = result.score;
+      resultsJson.push_back(resultJson);
+   }
+   pResponse->setResult(resultsJson);
+
+   return Success();
+}
+
 // the ShowHelp event will result in the Help pane requesting the specified
 // help url. we handle this request directly by calling the R httpd function
 // to dynamically form the correct http response
 void handleHelpRequest(const http::Request& request, http::Response* pResponse)
 {
-   handleHttpdRequest(kHelpLocation,
-                      boost::bind(r::sexp::findFunction, "httpd", "tools"),
-                      request,
-                      HelpContentsFilter(request),
-                      pResponse);
+   HelpContentsFilter filter(request);
+
+   // serve from the cache if we can (otherwise cache what httpd returns)
+   std::string path = http::util::pathAfterPrefix(request, kHelpLocation);
+   FilePath cacheFile = helpCacheFile(path, request);
+   CachedHelpPage page;
+   if (!cacheFile.empty() && readCachedHelpPage(cacheFile, &page))
+   {
+      setCachedHelpPageResponse(page, request, filter, pResponse);
+   }
+   else
+   {
+      handleHttpdRequest(kHelpLocation,
+                         boost::bind(r::sexp::findFunction, "httpd", "tools"),
+                         request,
+                         filter,
+                         pResponse,
+                         cacheFile.empty() ? HttpdResultHandler() :
+                              HttpdResultHandler(boost::bind(onHelpHttpdResult,
+                                                             cacheFile,
+                                                             _1)));
+      if (!cacheFile.empty())
+         readCachedHelpPage(cacheFile, &page);
+   }
+
+   // prefetch the topics this page links to
+   if (page.code == http::status::Ok && !page.html.empty())
+      prefetchLinkedHelpPages(path, page.html);
 }
 
 SEXP rs_previewRd(SEXP rdFileSEXP)
@@ -906,6 +1354,7 @@ Error initialize()
       (bind(registerRBrowseUrlHandler, handleLocalHttpUrl))
       (bind(registerRBrowseFileHandler, handleRShowDocFile))
       (bind(registerUriHandler, kHelpLocation, handleHelpRequest))
+      (bind(registerRpcMethod, "search_help_index", searchHelpIndex))
       (bind(sourceModuleRFile, "SessionHelp.R"));
    Error error = initBlock.execute();
    if (error)
@@ -919,6 +1368,11 @@ Error initialize()
    if (error)
       LOG_ERROR(error);
 
+   // index the installed packages' help in the background (and again
+   // whenever packages are installed or removed)
+   rebuildHelpIndex();
+   module_context::events().onPackageLibraryMutated.connect(rebuildHelpIndex);
+
    // handle /custom and /session urls internally if necessary (always in
    // server mode, in desktop mode if the internal http server can't
    // bind to a port)
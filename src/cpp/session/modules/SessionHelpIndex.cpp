@@ -0,0 +1,448 @@
+/*
+ * SessionHelpIndex.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionHelpIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+
+#include <boost/foreach.hpp>
+#include <boost/regex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <core/Error.hpp>
+#include <core/Log.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/text/DcfParser.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace help {
+
+namespace {
+
+// weights of the fields a term can occur within
+const int kAliasWeight = 8;
+const int kTitleWeight = 4;
+const int kDescriptionWeight = 1;
+
+// scores of matches against an entire alias
+const int kExactAliasScore = 1000;
+const int kAliasPrefixScore = 200;
+
+// terms shorter than this only match themselves (rather than every
+// term they are a prefix of)
+const std::size_t kMinPrefixLength = 2;
+
+std::string toLower(const std::string& str)
+{
+   std::string lower(str);
+   for (std::string::iterator it = lower.begin(); it != lower.end(); ++it)
+      *it = static_cast<char>(std::tolower(static_cast<unsigned char>(*it)));
+   return lower;
+}
+
+// lowercase alphanumeric runs (non-ascii bytes are retained so that
+// translated titles are still searchable)
+void tokenize(const std::string& text, std::vector<std::string>* pTokens)
+{
+   std::string token;
+   for (std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+   {
+      unsigned char ch = static_cast<unsigned char>(*it);
+      if (std::isalnum(ch) || ch >= 0x80)
+      {
+         token.push_back(static_cast<char>(std::tolower(ch)));
+      }
+      else if (!token.empty())
+      {
+         pTokens->push_back(token);
+         token.clear();
+      }
+   }
+   if (!token.empty())
+      pTokens->push_back(token);
+}
+
+std::string htmlText(const std::string& html)
+{
+   static const boost::regex reTag("<[^>]*>");
+   std::string text = boost::regex_replace(html, reTag, "");
+   boost::algorithm::replace_all(text, "&lt;", "<");
+   boost::algorithm::replace_all(text, "&gt;", ">");
+   boost::algorithm::replace_all(text, "&quot;", "\"");
+   boost::algorithm::replace_all(text, "&#39;", "'");
+   boost::algorithm::replace_all(text, "&amp;", "&");
+   boost::algorithm::trim(text);
+   return text;
+}
+
+// topic file => title, from the rows of the package's html index
+void readTopicTitles(const FilePath& indexPath,
+                     std::map<std::string, std::string>* pTitles)
+{
+   if (!indexPath.exists())
+      return;
+
+   std::string html;
+   Error error = readStringFromFile(indexPath, &html);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   static const boost::regex reRow(
+      "<td[^>]*><a href=\"([^\"/]+)\\.html\">[^<]*</a></td>\\s*<td>(.*?)</td>");
+   boost::sregex_iterator it(html.begin(), html.end(), reRow);
+   boost::sregex_iterator end;
+   for (; it != end; ++it)
+   {
+      std::string file = (*it)[1];
+      if (pTitles->find(file) == pTitles->end())
+         (*pTitles)[file] = htmlText((*it)[2]);
+   }
+}
+
+// (alias, topic file) pairs from the package's alias index
+void readTopicAliases(
+            const FilePath& anIndexPath,
+            std::vector<std::pair<std::string, std::string> >* pAliases)
+{
+   if (!anIndexPath.exists())
+      return;
+
+   std::vector<std::string> lines;
+   Error error = readStringVectorFromFile(anIndexPath, &lines);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   BOOST_FOREACH(const std::string& line, lines)
+   {
+      std::string::size_type tabPos = line.find('\t');
+      if (tabPos == std::string::npos || tabPos == 0)
+         continue;
+      std::string file = boost::algorithm::trim_copy(line.substr(tabPos + 1));
+      if (!file.empty())
+         pAliases->push_back(std::make_pair(line.substr(0, tabPos), file));
+   }
+}
+
+} // anonymous namespace
+
+HelpIndex& helpIndex()
+{
+   static HelpIndex instance;
+   return instance;
+}
+
+struct HelpIndex::Index
+{
+   struct Topic
+   {
+      std::string package;
+      std::string name;
+      std::string title;
+      std::string url;
+   };
+
+   struct Posting
+   {
+      Posting(int topic, int weight) : topic(topic), weight(weight) {}
+      int topic;
+      int weight;
+   };
+
+   int addTopic(const std::string& package,
+                const std::string& name,
+                const std::string& title,
+                const std::string& url)
+   {
+      Topic topic;
+      topic.package = package;
+      topic.name = name;
+      topic.title = title;
+      topic.url = url;
+      topics.push_back(topic);
+      return static_cast<int>(topics.size() - 1);
+   }
+
+   // a term occurring several times within a topic keeps its best weight
+   // (aliases of a topic needn't be contiguous so this is only a
+   // compaction -- searches combine postings by topic)
+   void addText(int topic, const std::string& text, int weight)
+   {
+      std::vector<std::string> tokens;
+      tokenize(text, &tokens);
+      BOOST_FOREACH(const std::string& token, tokens)
+      {
+         std::vector<Posting>& postings = terms[token];
+         if (!postings.empty() && postings.back().topic == topic)
+            postings.back().weight = std::max(postings.back().weight, weight);
+         else
+            postings.push_back(Posting(topic, weight));
+      }
+   }
+
+   void addAlias(int topic, const std::string& alias)
+   {
+      aliases.push_back(std::make_pair(toLower(alias), topic));
+      addText(topic, alias, kAliasWeight);
+   }
+
+   std::set<std::string> packages;
+   std::vector<Topic> topics;
+
+   // term => topics containing it
+   std::map<std::string, std::vector<Posting> > terms;
+
+   // lowercase alias => topic (sorted once the index is complete)
+   std::vector<std::pair<std::string, int> > aliases;
+};
+
+void HelpIndex::beginRebuild(const std::vector<FilePath>& libPaths)
+{
+   pBuilding_.reset(new Index());
+   pendingPackages_.clear();
+
+   BOOST_FOREACH(const FilePath& libPath, libPaths)
+   {
+      if (!libPath.isDirectory())
+         continue;
+
+      std::vector<FilePath> children;
+      Error error = libPath.children(&children);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      BOOST_FOREACH(const FilePath& child, children)
+      {
+         if (child.complete("DESCRIPTION").exists())
+            pendingPackages_.push_back(child);
+      }
+   }
+}
+
+bool HelpIndex::indexNextPackage()
+{
+   if (!pBuilding_)
+      return false;
+
+   if (pendingPackages_.empty())
+   {
+      std::sort(pBuilding_->aliases.begin(), pBuilding_->aliases.end());
+      pCurrent_ = pBuilding_;
+      pBuilding_.reset();
+      return false;
+   }
+
+   FilePath packagePath = pendingPackages_.front();
+   pendingPackages_.pop_front();
+
+   // packages earlier on the library path mask later ones
+   std::string package = packagePath.filename();
+   if (!pBuilding_->packages.insert(package).second)
+      return true;
+
+   Index& index = *pBuilding_;
+   std::string packageUrl = "help/library/" + package + "/html/";
+
+   // the package itself (title and description)
+   std::map<std::string, std::string> fields;
+   std::string errMsg;
+   Error error = text::parseDcfFile(packagePath.complete("DESCRIPTION"),
+                                    false,
+                                    &fields,
+                                    &errMsg);
+   if (error)
+      LOG_ERROR(error);
+   std::string title = text::dcfMultilineAsFolded(fields["title"]);
+   int packageTopic = index.addTopic(package,
+                                     package,
+                                     title,
+                                     packageUrl + "00Index.html");
+   index.addAlias(packageTopic, package);
+   index.addText(packageTopic, title, kTitleWeight);
+   index.addText(packageTopic,
+                 text::dcfMultilineAsFolded(fields["description"]),
+                 kDescriptionWeight);
+
+   // its help topics (one per help file, named by its first alias)
+   std::map<std::string, std::string> titles;
+   readTopicTitles(packagePath.complete("html/00Index.html"), &titles);
+
+   std::vector<std::pair<std::string, std::string> > aliases;
+   readTopicAliases(packagePath.complete("help/AnIndex"), &aliases);
+
+   boost::unordered_map<std::string, int> fileTopics;
+   typedef std::pair<std::string, std::string> AliasFile;
+   BOOST_FOREACH(const AliasFile& aliasFile, aliases)
+   {
+      int topic;
+      boost::unordered_map<std::string, int>::const_iterator it =
+                                          fileTopics.find(aliasFile.second);
+      if (it == fileTopics.end())
+      {
+         std::string topicTitle = titles[aliasFile.second];
+         topic = index.addTopic(package,
+                                aliasFile.first,
+                                topicTitle,
+                                packageUrl + aliasFile.second + ".html");
+         index.addText(topic, topicTitle, kTitleWeight);
+         fileTopics[aliasFile.second] = topic;
+      }
+      else
+      {
+         topic = it->second;
+      }
+
+      index.addAlias(topic, aliasFile.first);
+   }
+
+   return true;
+}
+
+void HelpIndex::search(const std::string& query,
+                       std::size_t maxResults,
+                       std::vector<HelpSearchResult>* pResults) const
+{
+   if (!pCurrent_)
+      return;
+   const Index& index = *pCurrent_;
+
+   std::string lowerQuery = toLower(boost::algorithm::trim_copy(query));
+   if (lowerQuery.empty())
+      return;
+
+   // topic => score
+   std::map<int, int> scores;
+
+   // topics whose alias is (or starts with) the query
+   typedef std::vector<std::pair<std::string, int> >::const_iterator
+                                                            AliasIterator;
+   for (AliasIterator it = std::lower_bound(index.aliases.begin(),
+                                            index.aliases.end(),
+                                            std::make_pair(lowerQuery, -1));
+        it != index.aliases.end() &&
+           boost::algorithm::starts_with(it->first, lowerQuery);
+        ++it)
+   {
+      int score = (it->first == lowerQuery) ? kExactAliasScore
+                                            : kAliasPrefixScore;
+      int& topicScore = scores[it->second];
+      topicScore = std::max(topicScore, score);
+   }
+
+   // topics containing every term (terms also match the longer terms
+   // they are a prefix of, at half weight)
+   std::vector<std::string> queryTerms;
+   tokenize(lowerQuery, &queryTerms);
+   std::map<int, int> termScores;
+   for (std::size_t i = 0; i < queryTerms.size(); i++)
+   {
+      const std::string& term = queryTerms[i];
+
+      std::map<int, int> matches;
+      typedef std::map<std::string, std::vector<Index::Posting> >
+                                                   ::const_iterator TermIterator;
+      for (TermIterator it = index.terms.lower_bound(term);
+           it != index.terms.end() &&
+              boost::algorithm::starts_with(it->first, term);
+           ++it)
+      {
+         bool exact = it->first == term;
+         if (!exact && term.size() < kMinPrefixLength)
+            break;
+
+         BOOST_FOREACH(const Index::Posting& posting, it->second)
+         {
+            int weight = exact ? posting.weight
+                               : std::max(posting.weight / 2, 1);
+            int& matchWeight = matches[posting.topic];
+            matchWeight = std::max(matchWeight, weight);
+         }
+      }
+
+      // intersect with the topics matching the previous terms
+      std::map<int, int> intersection;
+      for (std::map<int, int>::const_iterator it = matches.begin();
+           it != matches.end();
+           ++it)
+      {
+         if (i == 0)
+         {
+            intersection[it->first] = it->second;
+         }
+         else
+         {
+            std::map<int, int>::const_iterator prevIt =
+                                             termScores.find(it->first);
+            if (prevIt != termScores.end())
+               intersection[it->first] = prevIt->second + it->second;
+         }
+      }
+      termScores.swap(intersection);
+      if (termScores.empty())
+         break;
+   }
+
+   for (std::map<int, int>::const_iterator it = termScores.begin();
+        it != termScores.end();
+        ++it)
+   {
+      scores[it->first] += it->second * 10;
+   }
+
+   // order by score (ties in the order the topics were indexed)
+   std::vector<std::pair<int, int> > ranked;
+   for (std::map<int, int>::const_iterator it = scores.begin();
+        it != scores.end();
+        ++it)
+   {
+      ranked.push_back(std::make_pair(-it->second, it->first));
+   }
+   std::sort(ranked.begin(), ranked.end());
+
+   for (std::size_t i = 0; i < ranked.size() && i < maxResults; i++)
+   {
+      const Index::Topic& topic = index.topics[ranked[i].second];
+      HelpSearchResult result;
+      result.package = topic.package;
+      result.topic = topic.name;
+      result.title = topic.title;
+      result.url = topic.url;
+      result.score = -ranked[i].first;
+      pResults->push_back(result);
+   }
+}
+
+} // namespace help
+} // namespace modules
+} // namesapce session
+} // namespace rstudio
@@ -0,0 +1,87 @@
+/*
+ * SessionHelpIndex.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_HELP_INDEX_HPP
+#define SESSION_HELP_INDEX_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <core/FilePath.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace help {
+
+struct HelpSearchResult
+{
+   HelpSearchResult() : score(0) {}
+   std::string package;
+   std::string topic;
+   std::string title;
+   std::string url;
+   int score;
+};
+
+class HelpIndex;
+HelpIndex& helpIndex();
+
+// full-text index of the help topics of the installed packages. topics are
+// read from each package's alias index (help/AnIndex), html index (titles)
+// and DESCRIPTION so no R code is required to build it. rebuilding reads
+// one package per call to indexNextPackage (scheduled as incremental work)
+// into a new index which replaces the current one once it's complete
+class HelpIndex : boost::noncopyable
+{
+private:
+   HelpIndex() {}
+   friend HelpIndex& helpIndex();
+
+public:
+   // discard any rebuild in progress and begin a new one over the
+   // packages within the passed libraries
+   void beginRebuild(const std::vector<core::FilePath>& libPaths);
+
+   // index the next package of the rebuild (returns true if there are
+   // more packages remaining)
+   bool indexNextPackage();
+
+   bool isRebuilding() const { return pBuilding_.get() != NULL; }
+   bool isAvailable() const { return pCurrent_.get() != NULL; }
+
+   // topics matching all of the terms within the query (or whose alias
+   // starts with the query) ordered by descending score
+   void search(const std::string& query,
+               std::size_t maxResults,
+               std::vector<HelpSearchResult>* pResults) const;
+
+private:
+   struct Index;
+   boost::shared_ptr<Index> pCurrent_;
+   boost::shared_ptr<Index> pBuilding_;
+   std::deque<core::FilePath> pendingPackages_;
+};
+
+} // namespace help
+} // namespace modules
+} // namesapce session
+} // namespace rstudio
+
+#endif // SESSION_HELP_INDEX_HPP
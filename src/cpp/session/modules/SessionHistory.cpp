@@ -34,6 +34,7 @@
 #include <core/DateTime.hpp>
 
 #include <core/json/JsonRpc.hpp>
+#include <core/json/JsonWriter.hpp>
 
 #include <r/RSexp.hpp>
 #include <r/RRoutines.hpp>
@@ -74,15 +75,48 @@ void historyEntriesAsJson(const std::vector<HistoryEntry>& entries,
    pEntriesJson->operator[]("command") = commandArray;
 }
 
+void historyEntriesAsJson(const std::vector<HistoryEntry>& entries,
+                          json::Writer* pWriter)
+{
+   // stream the arrays directly (avoids building a json::Value for each
+   // entry when returning large portions of the history)
+   pWriter->startObject();
+
+   pWriter->key("index");
+   pWriter->startArray();
+   for (std::size_t i=0; i<entries.size(); i++)
+      pWriter->value(entries[i].index);
+   pWriter->endArray();
+
+   pWriter->key("timestamp");
+   pWriter->startArray();
+   for (std::size_t i=0; i<entries.size(); i++)
+      pWriter->value(entries[i].timestamp);
+   pWriter->endArray();
+
+   pWriter->key("command");
+   pWriter->startArray();
+   for (std::size_t i=0; i<entries.size(); i++)
+      pWriter->value(entries[i].command);
+   pWriter->endArray();
+
+   pWriter->endObject();
+}
+
+void setHistoryEntriesResult(const std::vector<HistoryEntry>& entries,
+                             json::JsonRpcResponse* pResponse)
+{
+   json::Writer writer;
+   historyEntriesAsJson(entries, &writer);
+   pResponse->setRawResult(writer.str());
+}
+
 Error setJsonResultFromHistory(int startIndex,
                                int endIndex,
                                json::JsonRpcResponse* pResponse)
 {
-   // get all entries
-   const std::vector<HistoryEntry>& allEntries = historyArchive().entries();
-
    // validate indexes
-   int historySize = allEntries.size();
+   int historySize = historyArchive().size();
    if ( (startIndex < 0)               ||
         (startIndex > historySize)     ||
         (endIndex < 0)                 ||
@@ -93,35 +127,14 @@ Error setJsonResultFromHistory(int startIndex,
    
    // return the entries
    std::vector<HistoryEntry> entries;
-   std::copy(allEntries.begin() + startIndex,
-             allEntries.begin() + endIndex,
-             std::back_inserter(entries));
-   json::Object entriesJson;
-   historyEntriesAsJson(entries, &entriesJson);
-   pResponse->setResult(entriesJson);
+   historyArchive().entries(startIndex, endIndex, &entries);
+   setHistoryEntriesResult(entries, pResponse);
    return Success();
 }
    
-bool matches(const HistoryEntry& entry,
-             const std::vector<std::string>& searchTerms)
-{   
-   // look for each search term in the input
-   for (std::vector<std::string>::const_iterator it = searchTerms.begin();
-        it != searchTerms.end();
-        ++it)
-   {
-      if (!boost::algorithm::contains(entry.command, *it))
-         return false;
-   }
-   
-   // had all of the search terms, return true
-   return true;
-}
-
-
-void historyRangeAsJson(int startIndex,
-                        int endIndex,
-                        json::Object* pHistoryJson)
+void setHistoryRangeResult(int startIndex,
+                           int endIndex,
+                           json::JsonRpcResponse* pResponse)
 {
    // get the subset of entries
    std::vector<HistoryEntry> historyEntries;
@@ -135,7 +148,7 @@ void historyRangeAsJson(int startIndex,
    }
 
    // convert to json
-   historyEntriesAsJson(historyEntries, pHistoryJson);
+   setHistoryEntriesResult(historyEntries, pResponse);
 }
 
 Error getRecentHistory(const json::JsonRpcRequest& request,
@@ -160,9 +173,7 @@ Error getRecentHistory(const json::JsonRpcRequest& request,
    int endIndex = consoleHistory.size();
 
    // get json and set it
-   json::Object historyJson;
-   historyRangeAsJson(startIndex, endIndex, &historyJson);
-   pResponse->setResult(historyJson);
+   setHistoryRangeResult(startIndex, endIndex, pResponse);
    return Success();
 }
 
@@ -177,9 +188,7 @@ Error getHistoryItems(const json::JsonRpcRequest& request,
       return error;
 
    // get the range and return it
-   json::Object historyJson;
-   historyRangeAsJson(startIndex, endIndex, &historyJson);
-   pResponse->setResult(historyJson);
+   setHistoryRangeResult(startIndex, endIndex, pResponse);
    return Success();
 }
 
@@ -247,7 +256,7 @@ Error getHistoryArchiveItems(const json::JsonRpcRequest& request,
       return error;
    
    // truncate indexes if necessary
-   int historySize = historyArchive().entries().size();
+   int historySize = historyArchive().size();
    startIndex = std::min(startIndex, historySize);
    endIndex = std::min(endIndex, historySize);
    
@@ -271,30 +280,14 @@ Error searchHistoryArchive(const json::JsonRpcRequest& request,
    boost::tokenizer<boost::char_separator<char> > tok(query, sep);
    std::copy(tok.begin(), tok.end(), std::back_inserter(searchTerms));
    
-   // examine the items in the history for matches
-   const std::vector<HistoryEntry>& allEntries =  historyArchive().entries();
+   // find the most recent matches
    std::vector<HistoryEntry> matchingEntries;
-   for (std::vector<HistoryEntry>::const_reverse_iterator 
-            it = allEntries.rbegin();
-            it != allEntries.rend();
-            ++it)
-   {
-      // check limit
-      if (matchingEntries.size() >= static_cast<std::size_t>(maxEntries))
-         break;
-
-      // look for match
-      if (matches(*it, searchTerms))
-      {
-         // add entry
-         matchingEntries.push_back(*it);
-      }
-   }
+   historyArchive().search(searchTerms,
+                           std::max(maxEntries, 0),
+                           &matchingEntries);
 
    // return json
-   json::Object entriesJson;
-   historyEntriesAsJson(matchingEntries, &entriesJson);
-   pResponse->setResult(entriesJson);
+   setHistoryEntriesResult(matchingEntries, pResponse);
    return Success();
 }
    
@@ -314,33 +307,29 @@ Error searchHistoryArchiveByPrefix(const json::JsonRpcRequest& request,
    boost::algorithm::trim(prefix);
    
    // examine the items in the history for matches
-   const std::vector<HistoryEntry>& allEntries = historyArchive().entries();
+   const HistoryArchive& archive = historyArchive();
    std::set<std::string> matchedCommands;
    std::vector<HistoryEntry> matchingEntries;
-   for (std::vector<HistoryEntry>::const_reverse_iterator 
-        it = allEntries.rbegin();
-        it != allEntries.rend();
-        ++it)
+   for (int i = archive.size() - 1; i >= 0; --i)
    {
       // check limit
       if (matchingEntries.size() >= static_cast<std::size_t>(maxEntries))
          break;
       
       // look for match 
-      if (boost::algorithm::starts_with(it->command, prefix))
+      HistoryEntry entry = archive.entry(i);
+      if (boost::algorithm::starts_with(entry.command, prefix))
       {
-         if (!uniqueOnly || (matchedCommands.count(it->command) == 0))
+         if (!uniqueOnly || (matchedCommands.count(entry.command) == 0))
          {
-            matchingEntries.push_back(*it);
-            matchedCommands.insert(it->command);
+            matchingEntries.push_back(entry);
+            matchedCommands.insert(entry.command);
          }
       }
    }
    
    // return json
-   json::Object entriesJson;
-   historyEntriesAsJson(matchingEntries, &entriesJson);
-   pResponse->setResult(entriesJson);
+   setHistoryEntriesResult(matchingEntries, pResponse);
    return Success();
 }
 
@@ -16,12 +16,18 @@
 #include "SessionHistoryArchive.hpp"
 
 #include <string>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/algorithm/string/predicate.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
 #include <core/FilePath.hpp>
 #include <core/DateTime.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/MappedFile.hpp>
+#include <core/SafeConvert.hpp>
 
 #include <r/session/RConsoleHistory.hpp>
 
@@ -91,32 +97,24 @@ void attemptRhistoryMigration()
       LOG_ERROR(error);
 }
 
-// simple reader for parsing lines of history file
-ReadCollectionAction readHistoryEntry(const std::string& line,
-                                      HistoryEntry* pEntry,
-                                      int* pNextIndex)
+boost::uint32_t trigram(const char* pData)
 {
-   // if the line doesn't have a ':' then ignore it
-   if (line.find(':') == std::string::npos)
-      return ReadCollectionIgnoreLine;
-
-   pEntry->index = (*pNextIndex)++;
-   std::istringstream istr(line);
-   istr >> pEntry->timestamp ;
-   istr.ignore(1, ':');
-   std::getline(istr, pEntry->command);
+   return (static_cast<boost::uint32_t>(static_cast<unsigned char>(pData[0])) << 16) |
+          (static_cast<boost::uint32_t>(static_cast<unsigned char>(pData[1])) << 8) |
+          static_cast<boost::uint32_t>(static_cast<unsigned char>(pData[2]));
+}
 
-   // if we had a read failure log it and return ignore state
-   if (!istr.fail())
-   {
-      return ReadCollectionAddLine;
-   }
-   else
+bool matches(const std::string& command,
+             const std::vector<std::string>& searchTerms)
+{
+   for (std::vector<std::string>::const_iterator it = searchTerms.begin();
+        it != searchTerms.end();
+        ++it)
    {
-      LOG_ERROR_MESSAGE("unexpected io error reading history line: " +
-                        line);
-      return ReadCollectionIgnoreLine;
+      if (!boost::algorithm::contains(command, *it))
+         return false;
    }
+   return true;
 }
 
 } // anonymous namespace
@@ -127,12 +125,22 @@ HistoryArchive& historyArchive()
    return instance;
 }
 
+struct HistoryArchive::Segment
+{
+   explicit Segment(const FilePath& path) : path(path), indexedSize(0) {}
+
+   FilePath path;
+   MappedFile file;
+
+   // bytes of complete lines which have been indexed
+   std::size_t indexedSize;
+};
+
 Error HistoryArchive::add(const std::string& command)
 {
-   // reset the cache (since this write will invalidate the current one,
-   // no sense in keeping our cache around in memory)
-   entries_.clear();
-   entryCacheLastWriteTime_ = -1;
+   // release our mappings so the database can be rotated and appended to
+   // (the index is retained and extended the next time it's accessed)
+   releaseSegments();
 
    // rotate if necessary
    rotateHistoryDatabase();
@@ -145,62 +153,235 @@ Error HistoryArchive::add(const std::string& command)
    return appendToFile(historyDatabaseFilePath(), ostrEntry.str());
 }
 
-const std::vector<HistoryEntry>& HistoryArchive::entries() const
+int HistoryArchive::size() const
 {
-   // calculate path to history db
-   FilePath historyDBPath = historyDatabaseFilePath();
+   update();
+   return static_cast<int>(locations_.size());
+}
 
-   // if the file doesn't exist then clear the collection
-   if (!historyDBPath.exists())
+HistoryEntry HistoryArchive::entry(int index) const
+{
+   const EntryLocation& location = locations_.at(index);
+
+   // read the line (timestamp:command)
+   std::string line = readLine(location);
+   std::string::size_type colonPos = line.find(':');
+   if (colonPos == std::string::npos)
+      return HistoryEntry(index, 0, std::string());
+
+   return HistoryEntry(
+         index,
+         safe_convert::stringTo<double>(line.substr(0, colonPos), 0),
+         line.substr(colonPos + 1));
+}
+
+void HistoryArchive::entries(int startIndex,
+                             int endIndex,
+                             std::vector<HistoryEntry>* pEntries) const
+{
+   update();
+   endIndex = std::min(endIndex, static_cast<int>(locations_.size()));
+   for (int i = std::max(startIndex, 0); i < endIndex; i++)
+      pEntries->push_back(entry(i));
+}
+
+void HistoryArchive::search(const std::vector<std::string>& searchTerms,
+                            std::size_t maxEntries,
+                            std::vector<HistoryEntry>* pEntries) const
+{
+   update();
+   updateTrigramIndex();
+
+   // collect the entry lists for each trigram within the search terms
+   // (short terms are only checked against the candidates)
+   std::vector<const std::vector<int>*> trigramEntries;
+   for (std::vector<std::string>::const_iterator it = searchTerms.begin();
+        it != searchTerms.end();
+        ++it)
    {
-      entries_.clear();
+      for (std::size_t i = 0; i + 3 <= it->size(); i++)
+      {
+         boost::unordered_map<boost::uint32_t, std::vector<int> >::const_iterator
+                           indexIt = trigramIndex_.find(trigram(it->data() + i));
+         if (indexIt == trigramIndex_.end())
+            return;
+         trigramEntries.push_back(&(indexIt->second));
+      }
    }
 
-   // otherwise check for divergent lastWriteTime and read the file
-   // if our internal list isn't up to date
-   else if (historyDBPath.lastWriteTime() != entryCacheLastWriteTime_)
+   // candidates are the entries in the shortest list (or if there are no
+   // trigrams to look for, all of the entries)
+   std::vector<int> allEntries;
+   const std::vector<int>* pCandidates = &allEntries;
+   if (trigramEntries.empty())
    {
-      entries_.clear();
+      allEntries.reserve(locations_.size());
+      for (std::size_t i = 0; i < locations_.size(); i++)
+         allEntries.push_back(static_cast<int>(i));
+   }
+   else
+   {
+      pCandidates = trigramEntries[0];
+      for (std::size_t i = 1; i < trigramEntries.size(); i++)
+      {
+         if (trigramEntries[i]->size() < pCandidates->size())
+            pCandidates = trigramEntries[i];
+      }
+   }
 
-      // establish a next index counter
-      int nextIndex = 0;
+   // examine candidates from the most recent
+   for (std::vector<int>::const_reverse_iterator it = pCandidates->rbegin();
+        it != pCandidates->rend();
+        ++it)
+   {
+      // check limit
+      if (pEntries->size() >= maxEntries)
+         break;
 
-      // first read from rotated file if it exists
-      FilePath rotatedHistoryDBPath = historyDatabaseRotatedFilePath();
-      if (rotatedHistoryDBPath.exists())
+      // candidates must appear in every trigram's list
+      bool candidate = true;
+      for (std::size_t i = 0; i < trigramEntries.size() && candidate; i++)
       {
-         Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           rotatedHistoryDBPath,
-                           &entries_,
-                           boost::bind(readHistoryEntry, _1, _2, &nextIndex));
-         if (error)
-            LOG_ERROR(error);
+         candidate = std::binary_search(trigramEntries[i]->begin(),
+                                        trigramEntries[i]->end(),
+                                        *it);
       }
+      if (!candidate)
+         continue;
 
+      // verify the match (the trigrams needn't be adjacent)
+      HistoryEntry historyEntry = entry(*it);
+      if (matches(historyEntry.command, searchTerms))
+         pEntries->push_back(historyEntry);
+   }
+}
 
-      // now read from main history db
-      std::vector<HistoryEntry> entries;
-      Error error = readCollectionFromFile<std::vector<HistoryEntry> >(
-                           historyDBPath,
-                           &entries,
-                           boost::bind(readHistoryEntry, _1, _2, &nextIndex));
-      if (error)
+void HistoryArchive::update() const
+{
+   FilePath segmentPaths[] = { historyDatabaseRotatedFilePath(),
+                               historyDatabaseFilePath() };
+   const std::size_t segmentCount = sizeof(segmentPaths) / sizeof(FilePath);
+
+   // segments are only ever appended to, so if the rotated segment has
+   // changed or the current one has shrunk then the database was rotated
+   // (possibly by another session) and we need to start over
+   bool reload = segments_.size() != segmentCount;
+   for (std::size_t i = 0; i < segments_.size() && !reload; i++)
+   {
+      const Segment& segment = *segments_[i];
+      boost::uintmax_t size = segment.path.exists() ? segment.path.size() : 0;
+      if ((size < segment.indexedSize) ||
+          ((i < segmentCount - 1) && (size != segment.indexedSize)))
       {
-         LOG_ERROR(error);
+         reload = true;
       }
-      else
-      {
-         std::copy(entries.begin(),
-                   entries.end(),
-                   std::back_inserter(entries_));
+   }
+
+   if (reload)
+   {
+      segments_.clear();
+      locations_.clear();
+      trigramIndex_.clear();
+      trigramIndexSize_ = 0;
+      for (std::size_t i = 0; i < segmentCount; i++)
+         segments_.push_back(boost::shared_ptr<Segment>(
+                                              new Segment(segmentPaths[i])));
+   }
+
+   // index new lines
+   for (std::size_t i = 0; i < segments_.size(); i++)
+      indexSegment(i);
+}
+
+void HistoryArchive::indexSegment(std::size_t segmentIndex) const
+{
+   Segment& segment = *segments_[segmentIndex];
+   if (!segment.path.exists() || (segment.path.size() <= segment.indexedSize))
+      return;
+
+   // map the segment again to see the appended lines
+   segment.file.close();
+   Error error = segment.file.open(segment.path);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // record the location of each complete line (ignoring lines without a
+   // ':', which aren't entries)
+   const char* pData = segment.file.data();
+   std::size_t size = segment.file.size();
+   std::size_t pos = segment.indexedSize;
+   while (pos < size)
+   {
+      const char* pEnd = static_cast<const char*>(
+                                    std::memchr(pData + pos, '\n', size - pos));
+      if (pEnd == NULL)
+         break;
+
+      std::size_t length = (pEnd - pData) - pos;
+      if (length > 0 && pData[pos + length - 1] == '\r')
+         --length;
+      if (std::memchr(pData + pos, ':', length) != NULL)
+         locations_.push_back(EntryLocation(segmentIndex, pos, length));
+
+      pos = (pEnd - pData) + 1;
+   }
+   segment.indexedSize = pos;
+}
 
-         entryCacheLastWriteTime_ = historyDBPath.lastWriteTime();
+void HistoryArchive::updateTrigramIndex() const
+{
+   std::vector<boost::uint32_t> trigrams;
+   for (; trigramIndexSize_ < locations_.size(); ++trigramIndexSize_)
+   {
+      std::string line = readLine(locations_[trigramIndexSize_]);
+      std::string::size_type colonPos = line.find(':');
+      if (colonPos == std::string::npos)
+         continue;
+
+      // index each distinct trigram in the command once
+      trigrams.clear();
+      for (std::size_t i = colonPos + 1; i + 3 <= line.size(); i++)
+         trigrams.push_back(trigram(line.data() + i));
+      std::sort(trigrams.begin(), trigrams.end());
+      trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                     trigrams.end());
+
+      for (std::vector<boost::uint32_t>::const_iterator it = trigrams.begin();
+           it != trigrams.end();
+           ++it)
+      {
+         trigramIndex_[*it].push_back(static_cast<int>(trigramIndexSize_));
       }
+   }
+}
 
+std::string HistoryArchive::readLine(const EntryLocation& location) const
+{
+   // re-map the segment if it was released
+   MappedFile& file = segments_[location.segment]->file;
+   if (!file.isOpen())
+   {
+      Error error = file.open(segments_[location.segment]->path);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return std::string();
+      }
    }
 
-   // return entries
-   return entries_;
+   if (location.offset + location.length > file.size())
+      return std::string();
+
+   return std::string(file.data() + location.offset, location.length);
+}
+
+void HistoryArchive::releaseSegments() const
+{
+   for (std::size_t i = 0; i < segments_.size(); i++)
+      segments_[i]->file.close();
 }
 
 void HistoryArchive::migrateRhistoryIfNecessary()
@@ -19,6 +19,9 @@
 #include <string>
 #include <vector>
 
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/utility.hpp>
 
 namespace rstudio {
@@ -48,10 +51,15 @@ struct HistoryEntry
 class HistoryArchive;
 HistoryArchive& historyArchive();
 
+// the archive is kept in append-only text segments (the history database
+// and its rotated predecessor). segments are memory mapped and indexed by
+// line offset when first accessed (and incrementally as they grow), so
+// entries are only decoded when they're requested. searches use an index
+// of the three byte sequences occurring in each entry to find candidates
 class HistoryArchive : boost::noncopyable
 {
 private:
-   HistoryArchive() : entryCacheLastWriteTime_(-1) {}
+   HistoryArchive() : trigramIndexSize_(0) {}
    friend HistoryArchive& historyArchive();
 
 public:
@@ -59,11 +67,47 @@ public:
 
 public:
    core::Error add(const std::string& command);
-   const std::vector<HistoryEntry>& entries() const;
+
+   int size() const;
+   HistoryEntry entry(int index) const;
+
+   // entries in [startIndex, endIndex)
+   void entries(int startIndex,
+                int endIndex,
+                std::vector<HistoryEntry>* pEntries) const;
+
+   // most recent entries (first) containing all of the search terms
+   void search(const std::vector<std::string>& searchTerms,
+               std::size_t maxEntries,
+               std::vector<HistoryEntry>* pEntries) const;
+
+private:
+   struct Segment;
+   struct EntryLocation
+   {
+      EntryLocation(std::size_t segment, std::size_t offset, std::size_t length)
+         : segment(segment), offset(offset), length(length)
+      {
+      }
+      std::size_t segment;
+      std::size_t offset;
+      std::size_t length;
+   };
+
+   void update() const;
+   void indexSegment(std::size_t segment) const;
+   void updateTrigramIndex() const;
+   std::string readLine(const EntryLocation& location) const;
+   void releaseSegments() const;
 
 private:
-   mutable time_t entryCacheLastWriteTime_;
-   mutable std::vector<HistoryEntry> entries_;
+   mutable std::vector<boost::shared_ptr<Segment> > segments_;
+   mutable std::vector<EntryLocation> locations_;
+
+   // trigram => indexes of the entries containing it (ascending)
+   mutable boost::unordered_map<boost::uint32_t, std::vector<int> >
+                                                             trigramIndex_;
+   mutable std::size_t trigramIndexSize_;
 };
                        
 } // namespace history
@@ -17,6 +17,7 @@
 #include "SessionLists.hpp"
 
 #include <map>
+#include <vector>
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -25,6 +26,8 @@
 
 #include <core/Exec.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/system/System.hpp>
 
 #include <session/SessionModuleContext.hpp>
 
@@ -48,6 +51,10 @@ const char * const kAddinsMru = "addins_mru";
 // path to lists dir
 FilePath s_listsPath;
 
+// list changes are written after this delay (coalescing those made in the
+// meantime) rather than as they are made
+const int kListsWriteDelayMs = 500;
+
 // registered lists
 typedef std::map<std::string, std::size_t> Lists;
 Lists s_lists;
@@ -101,13 +108,6 @@ Error readList(const std::string& name, T* pList)
 }
 
 
-template <typename T>
-Error writeList(const std::string& name, const T& list)
-{
-   return writeCollectionToFile<T>(listPath(name), list, stringifyString);
-}
-
-
 json::Array listToJson(const std::list<std::string>& list)
 {
    json::Array jsonArray;
@@ -118,6 +118,222 @@ json::Array listToJson(const std::list<std::string>& list)
    return jsonArray;
 }
 
+void enqueListChanged(const std::string& name,
+                      const std::list<std::string>& list)
+{
+   json::Object eventJson;
+   eventJson["name"] = name;
+   eventJson["list"] = listToJson(list);
+
+   ClientEvent event(client_events::kListChanged, eventJson);
+   module_context::enqueClientEvent(event);
+}
+
+std::string listVersion(const std::list<std::string>& list)
+{
+   std::string contents;
+   BOOST_FOREACH(const std::string& item, list)
+   {
+      contents.append(item);
+      contents.push_back('\n');
+   }
+   return hash::crc32HexHash(contents);
+}
+
+// a change made to a list. changes are recorded and replayed onto the
+// list as it is on disk when they are written, so that those made by
+// other sessions in the meantime aren't lost
+struct ListChange
+{
+   enum Type { Prepend, Append, Remove, Set };
+
+   ListChange(Type type, const std::string& value)
+      : type(type), value(value)
+   {
+   }
+
+   ListChange(const std::list<std::string>& contents)
+      : type(Set), contents(contents)
+   {
+   }
+
+   Type type;
+   std::string value;
+   std::list<std::string> contents;
+};
+
+void applyListChange(const ListChange& change,
+                     std::size_t maxSize,
+                     std::list<std::string>* pList)
+{
+   switch(change.type)
+   {
+   case ListChange::Prepend:
+   case ListChange::Append:
+   {
+      bool prepend = change.type == ListChange::Prepend;
+
+      // remove any existing item with this value
+      pList->remove(change.value);
+
+      // enforce size constraints
+      while (pList->size() >= maxSize)
+      {
+         if (prepend)
+            pList->pop_back();
+         else
+            pList->pop_front();
+      }
+
+      // do the insert
+      if (prepend)
+         pList->push_front(change.value);
+      else
+         pList->push_back(change.value);
+      break;
+   }
+   case ListChange::Remove:
+      pList->remove(change.value);
+      break;
+   case ListChange::Set:
+      *pList = change.contents;
+      break;
+   }
+}
+
+// lists as last read or written by this session. version is a hash of the
+// contents, used to recognize change notifications for contents the
+// session already has (e.g. its own writes)
+struct ListState
+{
+   std::list<std::string> list;
+   std::string version;
+   std::vector<ListChange> pendingChanges;
+};
+typedef std::map<std::string, ListState> ListStates;
+ListStates s_listStates;
+bool s_writeScheduled = false;
+
+Error getListState(const std::string& name, ListState** ppState)
+{
+   ListStates::iterator it = s_listStates.find(name);
+   if (it == s_listStates.end())
+   {
+      ListState state;
+      Error error = readList(name, &state.list);
+      if (error)
+         return error;
+      state.version = listVersion(state.list);
+      it = s_listStates.insert(std::make_pair(name, state)).first;
+   }
+
+   *ppState = &(it->second);
+   return Success();
+}
+
+template <typename T>
+Error writeList(const std::string& name, const T& list)
+{
+   // write to a temporary file alongside the lists dir (so it isn't seen by
+   // sessions monitoring the lists) and then move it into place, so that
+   // the list is never read partially written
+   FilePath listFilePath = listPath(name);
+   FilePath tempFilePath = s_listsPath.parent().complete(
+            name + "-" + core::system::generateUuid(false) + ".tmp");
+   Error error = writeCollectionToFile<T>(tempFilePath, list, stringifyString);
+   if (error)
+      return error;
+
+   error = tempFilePath.move(listFilePath);
+   if (error)
+   {
+      Error removeError = tempFilePath.removeIfExists();
+      if (removeError)
+         LOG_ERROR(removeError);
+      return error;
+   }
+
+   return Success();
+}
+
+void writePendingChanges()
+{
+   s_writeScheduled = false;
+
+   for (ListStates::iterator it = s_listStates.begin();
+        it != s_listStates.end();
+        ++it)
+   {
+      ListState& state = it->second;
+      if (state.pendingChanges.empty())
+         continue;
+
+      // merge: replay our changes onto the list as it is now on disk
+      std::list<std::string> list;
+      Error error = readList(it->first, &list);
+      if (error)
+      {
+         LOG_ERROR(error);
+         list = state.list;
+      }
+      else
+      {
+         std::size_t maxSize = listSize(it->first.c_str());
+         BOOST_FOREACH(const ListChange& change, state.pendingChanges)
+         {
+            applyListChange(change, maxSize, &list);
+         }
+      }
+      state.pendingChanges.clear();
+
+      std::string version = listVersion(list);
+      // another session changed the list: let the client know
+      if (list != state.list)
+         enqueListChanged(it->first, list);
+      state.list = list;
+      state.version = version;
+
+      error = writeList(it->first, list);
+      if (error)
+         LOG_ERROR(error);
+   }
+}
+
+void scheduleWrite()
+{
+   if (s_writeScheduled)
+      return;
+
+   s_writeScheduled = true;
+   module_context::scheduleDelayedWork(
+            boost::posix_time::milliseconds(kListsWriteDelayMs),
+            writePendingChanges,
+            false);
+}
+
+Error changeList(const std::string& name, const ListChange& change)
+{
+   ListState* pState;
+   Error error = getListState(name, &pState);
+   if (error)
+      return error;
+
+   applyListChange(change, listSize(name.c_str()), &pState->list);
+   pState->version = listVersion(pState->list);
+   pState->pendingChanges.push_back(change);
+   scheduleWrite();
+
+   enqueListChanged(name, pState->list);
+
+   return Success();
+}
+
+void onShutdown(bool)
+{
+   if (s_writeScheduled)
+      writePendingChanges();
+}
+
 void onListsFileChanged(const core::system::FileChangeEvent& fileChange)
 {
    // ignore if deleted
@@ -141,12 +357,27 @@ void onListsFileChanged(const core::system::FileChangeEvent& fileChange)
       return;
    }
 
-   json::Object eventJson;
-   eventJson["name"] = name;
-   eventJson["list"] = listToJson(list);
+   // ignore it if we already have these contents (e.g. we wrote them)
+   ListState* pState;
+   error = getListState(name, &pState);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+   std::string version = listVersion(list);
+   if (version == pState->version)
+      return;
 
-   ClientEvent event(client_events::kListChanged, eventJson);
-   module_context::enqueClientEvent(event);
+   // our own pending changes will be merged into these when written
+   pState->list = list;
+   BOOST_FOREACH(const ListChange& change, pState->pendingChanges)
+   {
+      applyListChange(change, listSize(name.c_str()), &pState->list);
+   }
+   pState->version = listVersion(pState->list);
+
+   enqueListChanged(name, pState->list);
 }
 
 bool isListNameValid(const std::string& name)
@@ -175,7 +406,13 @@ Error getListNameAndContents(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
-   return readList(*pName, pList);
+   ListState* pState;
+   error = getListState(*pName, &pState);
+   if (error)
+      return error;
+
+   *pList = pState->list;
+   return Success();
 }
 
 
@@ -202,6 +439,9 @@ Error listSetContents(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
+   if (!isListNameValid(name))
+      return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+
    std::list<std::string> list;
    BOOST_FOREACH(const json::Value& val, jsonList)
    {
@@ -214,45 +454,26 @@ Error listSetContents(const json::JsonRpcRequest& request,
       list.push_back(val.get_str());
    }
 
-   return writeList(name, list);
+   return changeList(name, ListChange(list));
 }
 
 Error listInsertItem(bool prepend,
                      const json::JsonRpcRequest& request,
                      json::JsonRpcResponse* pResponse)
 {
-   // get params and other context
+   // get params
    std::string name, value;
-   std::list<std::string> list;
-   std::size_t maxSize;
-   Error error = getListNameAndContents(request, &name, &list);
+   Error error = getListName(request, &name);
    if (error)
       return error;
    error = json::readParam(request.params, 1, &value);
    if (error)
       return error;
-   maxSize = listSize(name.c_str());
-
-   // remove any existing item with this value
-   list.remove(value);
-
-   // enforce size constraints
-   while (list.size() >= maxSize)
-   {
-      if (prepend)
-         list.pop_back();
-      else
-         list.pop_front();
-   }
 
    // do the insert
-   if (prepend)
-      list.push_front(value);
-   else
-      list.push_back(value);
-
-   // update the list
-   return writeList(name, list);
+   return changeList(name, ListChange(prepend ? ListChange::Prepend :
+                                                ListChange::Append,
+                                      value));
 }
 
 
@@ -273,22 +494,20 @@ Error listAppendItem(const json::JsonRpcRequest& request,
 Error listRemoveItem(const json::JsonRpcRequest& request,
                      json::JsonRpcResponse* pResponse)
 {
-   // get list name and contents
+   // get list name
    std::string name;
-   std::list<std::string> list;
-   Error error = getListNameAndContents(request, &name, &list);
+   Error error = getListName(request, &name);
    if (error)
       return error;
 
    // get value to remove
    std::string value;
    error = json::readParam(request.params, 1, &value);
+   if (error)
+      return error;
 
    // remove it
-   list.remove(value);
-
-   // update the list
-   return writeList(name, list);
+   return changeList(name, ListChange(ListChange::Remove, value));
 }
 
 Error listClear(const json::JsonRpcRequest& request,
@@ -300,8 +519,8 @@ Error listClear(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
-   // write empty list
-   return writeList(name, std::list<std::string>());
+   // empty the list
+   return changeList(name, ListChange(std::list<std::string>()));
 }
 
 } // anonymous namespace
@@ -312,12 +531,16 @@ json::Object allListsAsJson()
    json::Object allListsJson;
    for (Lists::const_iterator it = s_lists.begin(); it != s_lists.end(); ++it)
    {
-      std::list<std::string> list;
-      Error error = readList(it->first, &list);
+      ListState* pState;
+      Error error = getListState(it->first, &pState);
       if (error)
+      {
          LOG_ERROR(error);
+         allListsJson[it->first] = json::Array();
+         continue;
+      }
 
-      allListsJson[it->first] = listToJson(list);
+      allListsJson[it->first] = listToJson(pState->list);
    }
 
    return allListsJson;
@@ -338,6 +561,9 @@ Error initialize()
                                                       kListsPath,
                                                       onListsFileChanged);
 
+   // write any changes which are still pending
+   module_context::events().onShutdown.connect(onShutdown);
+
    using boost::bind;
    using namespace module_context;
    ExecBlock initBlock ;
@@ -15,6 +15,9 @@
 
 #include "SessionMarkers.hpp"
 
+#include <algorithm>
+#include <map>
+
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
@@ -36,26 +39,150 @@ namespace session {
 
 namespace {
 
-json::Object sourceMarkerSetAsJson(const module_context::SourceMarkerSet& set)
+// markers are sent to the client a page at a time (large sets, e.g. from
+// a package check, are then requested by the client a page at a time)
+const std::size_t kMarkersPageSize = 500;
+
+// version of the compact format markers are saved in
+const int kSavedMarkersVersion = 2;
+
+std::string markersBasePath(const module_context::SourceMarkerSet& set)
 {
-   using namespace module_context;
+   if (set.basePath.empty())
+      return std::string();
+
+   std::string basePath = module_context::createAliasedPath(set.basePath);
+   // ensure that the base_path ends with "/" so that markers don't
+   // display the path
+   if (!boost::algorithm::ends_with(basePath, "/"))
+      basePath.append("/");
+   return basePath;
+}
+
+// the markers of a set from offset (at most count of them)
+json::Object sourceMarkerSetAsJson(const module_context::SourceMarkerSet& set,
+                                   std::size_t offset,
+                                   std::size_t count)
+{
+   std::size_t total = set.markers.size();
+   std::size_t begin = std::min(offset, total);
+   std::size_t end = begin + std::min(count, total - begin);
+
    json::Object jsonSet;
    jsonSet["name"] = set.name;
-   if (set.basePath.empty())
+   jsonSet["base_path"] = markersBasePath(set);
+   jsonSet["markers"] = module_context::sourceMarkersAsJson(
+                                          set.markers.begin() + begin,
+                                          set.markers.begin() + end);
+   jsonSet["offset"] = static_cast<int>(begin);
+   jsonSet["total"] = static_cast<int>(total);
+   return jsonSet;
+}
+
+// saved sets list each path once and write markers as arrays of
+// [type, path index, line, column, message, show error list]
+json::Object savedMarkerSetAsJson(const module_context::SourceMarkerSet& set)
+{
+   json::Array pathsJson;
+   std::map<std::string, int> pathIndexes;
+   json::Array markersJson;
+   markersJson.reserve(set.markers.size());
+   BOOST_FOREACH(const module_context::SourceMarker& marker, set.markers)
+   {
+      std::string path = module_context::createAliasedPath(marker.path);
+      std::map<std::string, int>::iterator it = pathIndexes.find(path);
+      if (it == pathIndexes.end())
+      {
+         it = pathIndexes.insert(
+               std::make_pair(path, static_cast<int>(pathsJson.size()))).first;
+         pathsJson.push_back(path);
+      }
+
+      json::Array markerJson;
+      markerJson.push_back(static_cast<int>(marker.type));
+      markerJson.push_back(it->second);
+      markerJson.push_back(marker.line);
+      markerJson.push_back(marker.column);
+      markerJson.push_back(marker.message.text());
+      markerJson.push_back(marker.showErrorList);
+      markersJson.push_back(markerJson);
+   }
+
+   json::Object jsonSet;
+   jsonSet["name"] = set.name;
+   jsonSet["base_path"] = markersBasePath(set);
+   jsonSet["paths"] = pathsJson;
+   jsonSet["markers"] = markersJson;
+   return jsonSet;
+}
+
+bool readSavedMarker(const json::Value& markerJson,
+                     const std::vector<FilePath>& paths,
+                     std::vector<module_context::SourceMarker>* pMarkers)
+{
+   if (!json::isType<json::Array>(markerJson))
+      return false;
+
+   const json::Array& fields = markerJson.get_array();
+   if (fields.size() != 6 ||
+       fields[0].type() != json::IntegerType ||
+       fields[1].type() != json::IntegerType ||
+       fields[2].type() != json::IntegerType ||
+       fields[3].type() != json::IntegerType ||
+       fields[4].type() != json::StringType ||
+       fields[5].type() != json::BooleanType)
    {
-      jsonSet["base_path"] = std::string();
+      return false;
    }
-   else
+
+   int pathIndex = fields[1].get_int();
+   if (pathIndex < 0 || pathIndex >= static_cast<int>(paths.size()))
+      return false;
+
+   pMarkers->push_back(module_context::SourceMarker(
+             (module_context::SourceMarker::Type)fields[0].get_int(),
+             paths[pathIndex],
+             fields[2].get_int(),
+             fields[3].get_int(),
+             core::html_utils::HTML(fields[4].get_str(), true),
+             fields[5].get_bool()));
+   return true;
+}
+
+// markers saved by older versions (an object per marker)
+bool readLegacyMarker(const json::Value& markerJson,
+                      std::vector<module_context::SourceMarker>* pMarkers)
+{
+   if (!json::isType<json::Object>(markerJson))
+      return false;
+
+   int type;
+   std::string path;
+   int line, column;
+   std::string message;
+   bool showErrorList;
+   Error error = json::readObject(
+      markerJson.get_obj(),
+      "type", &type,
+      "path", &path,
+      "line", &line,
+      "column", &column,
+      "message", &message,
+      "show_error_list", &showErrorList);
+   if (error)
    {
-      std::string basePath = createAliasedPath(set.basePath);
-      // ensure that the base_path ends with "/" so that markers don't
-      // display the path
-      if (!boost::algorithm::ends_with(basePath, "/"))
-         basePath.append("/");
-      jsonSet["base_path"] = basePath;
+      LOG_ERROR(error);
+      return false;
    }
-   jsonSet["markers"] = sourceMarkersAsJson(set.markers);
-   return jsonSet;
+
+   pMarkers->push_back(module_context::SourceMarker(
+                           (module_context::SourceMarker::Type)type,
+                           module_context::resolveAliasedPath(path),
+                           line,
+                           column,
+                           core::html_utils::HTML(message, true),
+                           showErrorList));
+   return true;
 }
 
 bool isNamed(const module_context::SourceMarkerSet& set,
@@ -98,6 +225,44 @@ public:
          markerSets_.push_back(markerSet);
    }
 
+   // add markers to the end of a set (creating it if necessary) and make
+   // it the active set. returns the number of markers it held before
+   std::size_t appendMarkers(const module_context::SourceMarkerSet& markerSet)
+   {
+      activeSet_ = markerSet.name;
+
+      MarkerSets::iterator it = findSetByName(markerSet.name);
+      if (it == markerSets_.end())
+      {
+         markerSets_.push_back(markerSet);
+         return 0;
+      }
+
+      std::size_t previousCount = it->markers.size();
+      it->markers.insert(it->markers.end(),
+                         markerSet.markers.begin(),
+                         markerSet.markers.end());
+      return previousCount;
+   }
+
+   const std::string& activeSet() const
+   {
+      return activeSet_;
+   }
+
+   bool markersPage(const std::string& set,
+                    std::size_t offset,
+                    std::size_t count,
+                    json::Object* pPageJson) const
+   {
+      MarkerSets::const_iterator it = findSetByName(set);
+      if (it == markerSets_.end())
+         return false;
+
+      *pPageJson = sourceMarkerSetAsJson(*it, offset, count);
+      return true;
+   }
+
    void clearActiveMarkers()
    {
       // remove the active set
@@ -115,6 +280,7 @@ public:
 public:
    Error readFromJson(const json::Object& asJson)
    {
+      int version = 1;
       std::string activeSet;
       json::Array setsJson;
       Error error = json::readObject(asJson,
@@ -123,6 +289,13 @@ public:
       if (error)
          return error;
 
+      json::Object::const_iterator versionIt = asJson.find("version");
+      if (versionIt != asJson.end() &&
+          versionIt->second.type() == json::IntegerType)
+      {
+         version = versionIt->second.get_int();
+      }
+
       MarkerSets markerSets;
 
       BOOST_FOREACH(const json::Value& setJson, setsJson)
@@ -140,39 +313,39 @@ public:
                LOG_ERROR(error);
                continue;
             }
+
             std::vector<module_context::SourceMarker> markers;
-            BOOST_FOREACH(json::Value markerJson, markersJson)
+            markers.reserve(markersJson.size());
+            if (version >= kSavedMarkersVersion)
             {
-               if (json::isType<json::Object>(markerJson))
+               json::Array pathsJson;
+               error = json::readObject(setJson.get_obj(),
+                                        "paths", &pathsJson);
+               if (error)
                {
-                  int type;
-                  std::string path;
-                  int line, column;
-                  std::string message;
-                  bool showErrorList;
-                  Error error = json::readObject(
-                     markerJson.get_obj(),
-                     "type", &type,
-                     "path", &path,
-                     "line", &line,
-                     "column", &column,
-                     "message", &message,
-                     "show_error_list", &showErrorList);
-                  if (error)
-                  {
-                     LOG_ERROR(error);
-                     continue;
-                  }
-
-                  module_context::SourceMarker marker(
-                      (module_context::SourceMarker::Type)type,
-                      module_context::resolveAliasedPath(path),
-                      line,
-                      column,
-                      core::html_utils::HTML(message, true),
-                      showErrorList);
-
-                  markers.push_back(marker);
+                  LOG_ERROR(error);
+                  continue;
+               }
+
+               std::vector<FilePath> paths;
+               paths.reserve(pathsJson.size());
+               BOOST_FOREACH(const json::Value& pathJson, pathsJson)
+               {
+                  paths.push_back(json::isType<std::string>(pathJson) ?
+                        module_context::resolveAliasedPath(pathJson.get_str()) :
+                        FilePath());
+               }
+
+               BOOST_FOREACH(const json::Value& markerJson, markersJson)
+               {
+                  readSavedMarker(markerJson, paths, &markers);
+               }
+            }
+            else
+            {
+               BOOST_FOREACH(const json::Value& markerJson, markersJson)
+               {
+                  readLegacyMarker(markerJson, &markers);
                }
             }
 
@@ -194,18 +367,21 @@ public:
    json::Object asJson() const
    {
       json::Object obj;
+      obj["version"] = kSavedMarkersVersion;
       obj["active_set"] = activeSet_;
       json::Array setsJson;
       std::transform(markerSets_.begin(),
                      markerSets_.end(),
                      std::back_inserter(setsJson),
-                     sourceMarkerSetAsJson);
+                     savedMarkerSetAsJson);
       obj["sets"] = setsJson;
 
       return obj;
    }
 
-   json::Object stateAsJson() const
+   // the set names and the active set's markers from offset (a page of
+   // them: the client requests the rest)
+   json::Object stateAsJson(std::size_t offset = 0) const
    {
       // default to null members
       json::Object obj;
@@ -227,7 +403,9 @@ public:
          if (it != markerSets_.end())
          {
             obj["names"] = namesJson;
-            obj["markers"] = sourceMarkerSetAsJson(*it);
+            obj["markers"] = sourceMarkerSetAsJson(*it,
+                                                   offset,
+                                                   kMarkersPageSize);
          }
       }
 
@@ -262,10 +440,11 @@ SourceMarkers& sourceMarkers()
    return instance;
 }
 
-void fireMarkersChanged(module_context::MarkerAutoSelect autoSelect)
+void fireMarkersChanged(module_context::MarkerAutoSelect autoSelect,
+                        std::size_t offset = 0)
 {
    json::Object jsonData;
-   jsonData["markers_state"] = sourceMarkers().stateAsJson();
+   jsonData["markers_state"] = sourceMarkers().stateAsJson(offset);
    jsonData["auto_select"] = static_cast<int>(autoSelect);
 
    ClientEvent event(client_events::kMarkersChanged,jsonData);
@@ -284,6 +463,16 @@ void showSourceMarkers(const SourceMarkerSet& markerSet,
    fireMarkersChanged(autoSelect);
 }
 
+void appendSourceMarkers(const SourceMarkerSet& markerSet,
+                         MarkerAutoSelect autoSelect)
+{
+   // if the set was already showing then the client needs only the new
+   // markers (they follow the markers it already has)
+   bool wasActive = sourceMarkers().activeSet() == markerSet.name;
+   std::size_t offset = sourceMarkers().appendMarkers(markerSet);
+   fireMarkersChanged(autoSelect, wasActive ? offset : 0);
+}
+
 } // namespace module_context
 
 
@@ -328,10 +517,30 @@ Error clearActiveMarkerSet(const core::json::JsonRpcRequest& request,
 }
 
 
+Error getMarkerSetPage(const core::json::JsonRpcRequest& request,
+                        json::JsonRpcResponse* pResponse)
+{
+   std::string set;
+   int offset, count;
+   Error error = json::readParams(request.params, &set, &offset, &count);
+   if (error)
+      return error;
+
+   json::Object pageJson;
+   if (offset >= 0 && count >= 0 &&
+       sourceMarkers().markersPage(set, offset, count, &pageJson))
+   {
+      pResponse->setResult(pageJson);
+   }
+
+   return Success();
+}
+
 SEXP rs_sourceMarkers(SEXP nameSEXP,
                       SEXP markersSEXP,
                       SEXP basePathSEXP,
-                      SEXP autoSelectSEXP)
+                      SEXP autoSelectSEXP,
+                      SEXP appendSEXP)
 {
    try
    {
@@ -402,7 +611,10 @@ SEXP rs_sourceMarkers(SEXP nameSEXP,
          markerAutoSelect = MarkerAutoSelectFirstError;
 
 
-      showSourceMarkers(markerSet, markerAutoSelect);
+      if (r::sexp::asLogical(appendSEXP))
+         appendSourceMarkers(markerSet, markerAutoSelect);
+      else
+         showSourceMarkers(markerSet, markerAutoSelect);
    }
    catch(r::exec::RErrorException& e)
    {
@@ -418,30 +630,25 @@ FilePath sourceMarkersFilePath()
    return module_context::scopedScratchPath().childPath("saved_source_markers");
 }
 
-void readSourceMarkers()
+Error readSourceMarkers()
 {
    FilePath filePath = sourceMarkersFilePath();
    if (!filePath.exists())
-      return;
+      return Success();
 
    std::string contents;
    Error error = readStringFromFile(filePath, &contents);
    if (error)
-   {
-      LOG_ERROR(error);
-      return;
-   }
+      return error;
 
    json::Value stateJson;
    if (!json::parse(contents, &stateJson))
    {
       LOG_WARNING_MESSAGE("invalid session markers json");
-      return;
+      return Success();
    }
 
-   error = sourceMarkers().readFromJson(stateJson.get_obj());
-   if (error)
-      LOG_ERROR(error);
+   return sourceMarkers().readFromJson(stateJson.get_obj());
 }
 
 void writeSourceMarkers(bool terminatedNormally)
@@ -468,13 +675,14 @@ json::Value markersStateAsJson()
 
 Error initialize()
 {
-   // read source markers and arrange to write them at shutdown
+   // read source markers (on the worker pool as it needs no R) and
+   // arrange to write them at shutdown
    using namespace module_context;
-   readSourceMarkers();
+   scheduleStartupTask("read source markers", readSourceMarkers);
    events().onShutdown.connect(writeSourceMarkers);
 
    // register R api
-   RS_REGISTER_CALL_METHOD(rs_sourceMarkers, 4);
+   RS_REGISTER_CALL_METHOD(rs_sourceMarkers, 5);
 
    // complete initialization
    using boost::bind;
@@ -483,6 +691,7 @@ Error initialize()
       (bind(registerRpcMethod, "markers_tab_closed", markersTabClosed))
       (bind(registerRpcMethod, "update_active_marker_set", updateActiveMarkerSet))
       (bind(registerRpcMethod, "clear_active_marker_set", clearActiveMarkerSet))
+      (bind(registerRpcMethod, "get_marker_set_page", getMarkerSetPage))
       (bind(sourceModuleRFile, "SessionMarkers.R"));
    return initBlock.execute();
 
@@ -0,0 +1,235 @@
+/*
+ * SessionPackageSymbolCache.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionPackageSymbolCache.hpp"
+
+#include <ctime>
+#include <map>
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/Log.hpp>
+#include <core/json/Json.hpp>
+#include <core/system/System.hpp>
+#include <core/text/DcfParser.hpp>
+
+#include <r/RExec.hpp>
+
+#include <session/SessionModuleContext.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace diagnostics {
+namespace package_symbol_cache {
+
+namespace {
+
+// increment when the format changes
+const int kCacheVersion = 1;
+
+struct InstalledPackage
+{
+   InstalledPackage() : lastWriteTime(0), size(0) {}
+   std::string version;
+   FilePath path;
+
+   // of the package's DESCRIPTION file (which is re-written whenever the
+   // package is installed)
+   std::time_t lastWriteTime;
+   uintmax_t size;
+};
+
+// find the package that loadNamespace() would load (i.e. the first one
+// found on the library paths)
+bool findInstalledPackage(const std::string& package,
+                          InstalledPackage* pInstalled)
+{
+   std::vector<std::string> libPaths;
+   Error error = r::exec::RFunction("base:::.libPaths").call(&libPaths);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   BOOST_FOREACH(const std::string& libPath, libPaths)
+   {
+      FilePath packagePath = FilePath(libPath).childPath(package);
+      FilePath descriptionPath = packagePath.childPath("DESCRIPTION");
+      if (!descriptionPath.exists())
+         continue;
+
+      std::map<std::string, std::string> fields;
+      std::string errMsg;
+      error = text::parseDcfFile(descriptionPath, true, &fields, &errMsg);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return false;
+      }
+
+      pInstalled->version = fields["Version"];
+      pInstalled->path = packagePath;
+      pInstalled->lastWriteTime = descriptionPath.lastWriteTime();
+      pInstalled->size = descriptionPath.size();
+      return !pInstalled->version.empty() && pInstalled->lastWriteTime != 0;
+   }
+
+   return false;
+}
+
+FilePath cacheFilePath(const std::string& package,
+                       bool exportsOnly,
+                       const InstalledPackage& installed)
+{
+   // one file for each package and library (the version is recorded
+   // within the file, so installing a new version replaces the entry)
+   std::string name = package +
+         (exportsOnly ? "-exports-" : "-objects-") +
+         hash::crc32HexHash(installed.path.absolutePath()) +
+         ".json";
+
+   return module_context::userScratchPath()
+         .childPath("package-symbols")
+         .childPath(name);
+}
+
+} // anonymous namespace
+
+bool lookup(const std::string& package,
+            bool exportsOnly,
+            std::vector<std::string>* pSymbols)
+{
+   InstalledPackage installed;
+   if (!findInstalledPackage(package, &installed))
+      return false;
+
+   FilePath cacheFile = cacheFilePath(package, exportsOnly, installed);
+   if (!cacheFile.exists())
+      return false;
+
+   std::string contents;
+   Error error = readStringFromFile(cacheFile, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   // an entry we can't use is simply ignored (and replaced on update)
+   json::Value cacheJson;
+   if (!json::parse(contents, &cacheJson) ||
+       !json::isType<json::Object>(cacheJson))
+   {
+      return false;
+   }
+
+   const json::Object& cacheObject = cacheJson.get_obj();
+   json::Object::const_iterator version = cacheObject.find("version");
+   json::Object::const_iterator packageVersion = cacheObject.find("package_version");
+   json::Object::const_iterator path = cacheObject.find("path");
+   json::Object::const_iterator mtime = cacheObject.find("mtime");
+   json::Object::const_iterator size = cacheObject.find("size");
+   json::Object::const_iterator symbols = cacheObject.find("symbols");
+   if (version == cacheObject.end() ||
+       !json::isType<int>(version->second) ||
+       version->second.get_int() != kCacheVersion ||
+       packageVersion == cacheObject.end() ||
+       !json::isType<std::string>(packageVersion->second) ||
+       packageVersion->second.get_str() != installed.version ||
+       path == cacheObject.end() ||
+       !json::isType<std::string>(path->second) ||
+       path->second.get_str() != installed.path.absolutePath() ||
+       mtime == cacheObject.end() ||
+       !json::isType<int>(mtime->second) ||
+       mtime->second.get_int64() != static_cast<boost::int64_t>(installed.lastWriteTime) ||
+       size == cacheObject.end() ||
+       !json::isType<int>(size->second) ||
+       size->second.get_int64() != static_cast<boost::int64_t>(installed.size) ||
+       symbols == cacheObject.end() ||
+       !json::isType<json::Array>(symbols->second))
+   {
+      return false;
+   }
+
+   std::vector<std::string> cachedSymbols;
+   BOOST_FOREACH(const json::Value& symbolJson, symbols->second.get_array())
+   {
+      if (!json::isType<std::string>(symbolJson))
+         return false;
+      cachedSymbols.push_back(symbolJson.get_str());
+   }
+
+   pSymbols->swap(cachedSymbols);
+   return true;
+}
+
+void update(const std::string& package,
+            bool exportsOnly,
+            const std::vector<std::string>& symbols)
+{
+   InstalledPackage installed;
+   if (!findInstalledPackage(package, &installed))
+      return;
+
+   json::Array symbolsJson;
+   BOOST_FOREACH(const std::string& symbol, symbols)
+   {
+      symbolsJson.push_back(symbol);
+   }
+
+   json::Object cacheJson;
+   cacheJson["version"] = kCacheVersion;
+   cacheJson["package_version"] = installed.version;
+   cacheJson["path"] = installed.path.absolutePath();
+   cacheJson["mtime"] = static_cast<boost::int64_t>(installed.lastWriteTime);
+   cacheJson["size"] = static_cast<boost::int64_t>(installed.size);
+   cacheJson["symbols"] = symbolsJson;
+
+   FilePath cacheFile = cacheFilePath(package, exportsOnly, installed);
+   Error error = cacheFile.parent().ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // other sessions may be reading the cache, so write the entry to a
+   // temporary file and then move it into place
+   FilePath tempFile = cacheFile.parent().childPath(
+            cacheFile.filename() + "." + core::system::generateShortenedUuid());
+   error = writeStringToFile(tempFile, json::write(cacheJson));
+   if (!error)
+      error = tempFile.move(cacheFile);
+
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempFile.removeIfExists();
+   }
+}
+
+} // namespace package_symbol_cache
+} // namespace diagnostics
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,55 @@
+/*
+ * SessionPackageSymbolCache.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_PACKAGE_SYMBOL_CACHE_HPP
+#define SESSION_PACKAGE_SYMBOL_CACHE_HPP
+
+#include <string>
+#include <vector>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace diagnostics {
+namespace package_symbol_cache {
+
+// Cache of the symbols within package namespaces, saved in the user's
+// scratch directory (and so shared by all of their sessions), which lets
+// the linter find the symbols a package provides without loading its
+// namespace. An entry is keyed by package name, version and the library
+// the package is installed in, and is valid only while the installed
+// package's DESCRIPTION file is unchanged.
+
+// get the symbols (either the exports, or all objects) from the namespace
+// of the package which would be loaded from the current library paths.
+// returns false if there is no (valid) cache entry.
+bool lookup(const std::string& package,
+            bool exportsOnly,
+            std::vector<std::string>* pSymbols);
+
+// save the symbols from a namespace. this should only be called for
+// namespaces loaded from the current library paths (e.g. not for packages
+// loaded by devtools::load_all()).
+void update(const std::string& package,
+            bool exportsOnly,
+            const std::vector<std::string>& symbols);
+
+} // namespace package_symbol_cache
+} // namespace diagnostics
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_PACKAGE_SYMBOL_CACHE_HPP
@@ -20,12 +20,17 @@
 
 #include "SessionPackages.hpp"
 
+#include <ctime>
+
 #include <boost/bind.hpp>
 #include <boost/regex.hpp>
 #include <boost/format.hpp>
 
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/system/System.hpp>
 #include <core/http/URL.hpp>
 #include <core/http/TcpIpBlockingClient.hpp>
 
@@ -131,7 +136,9 @@ public:
       // kickoff the process
       boost::shared_ptr<CRANMirrorHttpsUpgrade> pUpgrade(
                                     new CRANMirrorHttpsUpgrade(mirror));
-      pUpgrade->start(cmd.c_str(), FilePath(), async_r::R_PROCESS_VANILLA);
+      pUpgrade->start(cmd.c_str(),
+                      FilePath(),
+                      async_r::R_PROCESS_VANILLA | async_r::R_PROCESS_POOLED);
    }
 
    virtual void onStdout(const std::string& output)
@@ -256,6 +263,9 @@ namespace packages {
 
 namespace {
 
+// how long lists of available packages written by other sessions are used
+const std::time_t kCachedPackagesMaxAge = 60 * 60;
+
 class AvailablePackagesCache : public boost::noncopyable
 {
 public:
@@ -307,13 +317,21 @@ public:
       if (cache_.find(contribUrl) != cache_.end())
          return;
 
+      // use the list downloaded by another of the user's sessions if it's
+      // recent enough
+      std::vector<std::string> packages;
+      if (readCachedPackages(contribUrl, &packages))
+      {
+         cache_[contribUrl] = packages;
+         return;
+      }
+
       // build code to execute
       boost::format fmt(
                "row.names(available.packages(contriburl = '%1%'))");
       std::string code = boost::str(fmt % contribUrl);
 
       // get the packages
-      std::vector<std::string> packages;
       Error error = r::exec::evaluateString(code, &packages);
       if (error)
       {
@@ -325,9 +343,79 @@ public:
 
       // put them in the cache
       cache_[contribUrl] = packages;
+      writeCachedPackages(contribUrl, packages);
    }
 
 private:
+
+   // package lists are also written to disk so that the user's other
+   // sessions needn't download them again (each file holds the contrib url
+   // followed by the package names, one per line)
+   static FilePath cachedPackagesPath(const std::string& contribUrl)
+   {
+      return module_context::userScratchPath()
+            .childPath("available-packages")
+            .childPath(hash::xxHash64Hex(contribUrl));
+   }
+
+   static bool readCachedPackages(const std::string& contribUrl,
+                                  std::vector<std::string>* pPackages)
+   {
+      FilePath cachePath = cachedPackagesPath(contribUrl);
+      if (!cachePath.exists() ||
+          std::time(NULL) - cachePath.lastWriteTime() > kCachedPackagesMaxAge)
+      {
+         return false;
+      }
+
+      std::vector<std::string> lines;
+      Error error = readStringVectorFromFile(cachePath, &lines);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return false;
+      }
+
+      if (lines.size() < 2 || lines[0] != contribUrl)
+         return false;
+
+      pPackages->assign(lines.begin() + 1, lines.end());
+      return true;
+   }
+
+   static void writeCachedPackages(const std::string& contribUrl,
+                                   const std::vector<std::string>& packages)
+   {
+      if (packages.empty())
+         return;
+
+      FilePath cachePath = cachedPackagesPath(contribUrl);
+      Error error = cachePath.parent().ensureDirectory();
+      if (error)
+      {
+         LOG_ERROR(error);
+         return;
+      }
+
+      std::vector<std::string> lines;
+      lines.reserve(packages.size() + 1);
+      lines.push_back(contribUrl);
+      lines.insert(lines.end(), packages.begin(), packages.end());
+
+      // write to a temporary file and then move it into place so that
+      // other sessions never see a partially written list
+      FilePath tempPath = cachePath.parent().childPath(
+               cachePath.filename() + "." + core::system::generateShortenedUuid());
+      error = writeStringVectorToFile(tempPath, lines);
+      if (!error)
+         error = tempPath.move(cachePath);
+      if (error)
+      {
+         LOG_ERROR(error);
+         tempPath.removeIfExists();
+      }
+   }
+
    std::map<std::string, std::vector<std::string> > cache_;
 };
 
@@ -15,6 +15,8 @@
 
 #include "SessionPackrat.hpp"
 
+#include <map>
+
 #include <core/Exec.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/Hash.hpp>
@@ -217,18 +219,50 @@ std::string updateHash(PackratHashType hashType, PackratHashState hashState,
    return newHash;
 }
 
+// the DESCRIPTION files read when the library was last hashed, keyed by path
+// (so that only the packages which have changed need to be read again)
+struct DescFile
+{
+   std::time_t lastWriteTime;
+   boost::uintmax_t size;
+   std::string content;
+};
+typedef std::map<std::string, DescFile> DescFiles;
+DescFiles s_descFiles;
+
 // adds content from the given file to the given file if it's a 
 // DESCRIPTION file (used to summarize library content for hashing)
-bool addDescContent(int level, const FilePath& path, std::string* pDescContent)
+bool addDescContent(int level, const FilePath& path, DescFiles* pDescFiles,
+                    std::string* pDescContent)
 {
-   std::string newDescContent;
    if (path.filename() == "DESCRIPTION") 
    {
-      Error error = readStringFromFile(path, &newDescContent);
+      std::string filePath = path.absolutePath();
+
+      DescFile descFile;
+      descFile.lastWriteTime = path.lastWriteTime();
+      descFile.size = path.size();
+
+      DescFiles::const_iterator it = s_descFiles.find(filePath);
+      if (it != s_descFiles.end() &&
+          it->second.lastWriteTime == descFile.lastWriteTime &&
+          it->second.size == descFile.size)
+      {
+         descFile.content = it->second.content;
+         (*pDescFiles)[filePath] = descFile;
+      }
+      else
+      {
+         // (files we can't read are tried again next time)
+         Error error = readStringFromFile(path, &descFile.content);
+         if (!error)
+            (*pDescFiles)[filePath] = descFile;
+      }
+
       // include the path of the file; on Windows the DESCRIPTION file moves
       // inside the library post-installation
-      pDescContent->append(path.absolutePath());
-      pDescContent->append(newDescContent);
+      pDescContent->append(filePath);
+      pDescContent->append(descFile.content);
    }
    return true;
 }
@@ -241,10 +275,14 @@ std::string computeLibraryHash()
       projects::projectContext().directory().complete(kPackratLibPath);
 
    // find all DESCRIPTION files in the library and concatenate them to form
-   // a hashable state
+   // a hashable state (re-reading only those which have changed)
+   DescFiles descFiles;
    std::string descFileContent;
    libraryPath.childrenRecursive(
-         boost::bind(addDescContent, _1, _2, &descFileContent));
+         boost::bind(addDescContent, _1, _2, &descFiles, &descFileContent));
+
+   // packages which are no longer present drop out of the table
+   s_descFiles.swap(descFiles);
 
    if (descFileContent.empty())
       return "";
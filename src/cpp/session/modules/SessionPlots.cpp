@@ -849,6 +849,9 @@ Error initialize()
    module_context::events().onDetectChanges.connect(bind(onDetectChanges, _1));
    module_context::events().onBeforeExecute.connect(bind(onBeforeExecute));
    module_context::events().onBackgroundProcessing.connect(onBackgroundProcessing);
+   module_context::events().onReclaimMemory.connect(
+         bind(&r::session::graphics::Display::releaseCachedMemory,
+              boost::ref(r::session::graphics::display())));
 
    // connect to onShowManipulator
    using namespace rstudio::r::session;
@@ -16,7 +16,19 @@
 
 #include "SessionProfiler.hpp"
 
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include <core/Exec.hpp>
+#include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
+#include <core/r_util/RProfParser.hpp>
+#include <core/system/SamplingProfiler.hpp>
 
 #include <session/SessionModuleContext.hpp>
 
@@ -28,18 +40,178 @@ namespace modules {
 namespace profiler {
 
 namespace {
-      
 
+// native (C++) sampling profiler, started on request. the folded stacks are
+// written to the session scratch dir when it's stopped (or the session
+// ends) for use with flamegraph.pl
 
+Error writeNativeProfile(FilePath* pProfilePath)
+{
+   using namespace core::system;
+
+   *pProfilePath = module_context::sessionScratchPath().complete(
+            "native-profile-" +
+            safe_convert::numberToString(static_cast<long>(std::time(NULL))) +
+            ".folded");
+
+   std::ofstream ofs(pProfilePath->absolutePath().c_str());
+   if (!ofs)
+      return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+   sampling_profiler::writeFolded(ofs);
+   return Success();
+}
+
+Error startNativeProfiler(const json::JsonRpcRequest& request,
+                          json::JsonRpcResponse* pResponse)
+{
+   // interval (optional, in milliseconds of cpu time)
+   int intervalMs = 10;
+   if (request.params.size() > 0)
+   {
+      Error error = json::readParam(request.params, 0, &intervalMs);
+      if (error)
+         return error;
+   }
+
+   return core::system::sampling_profiler::start(std::max(intervalMs, 1));
+}
+
+Error stopNativeProfiler(const json::JsonRpcRequest& request,
+                         json::JsonRpcResponse* pResponse)
+{
+   using namespace core::system;
+
+   sampling_profiler::stop();
+
+   FilePath profilePath;
+   Error error = writeNativeProfile(&profilePath);
+   if (error)
+      return error;
+
+   json::Object result;
+   result["samples"] = static_cast<int>(sampling_profiler::sampleCount());
+   result["dropped"] =
+            static_cast<int>(sampling_profiler::droppedSampleCount());
+   result["path"] = module_context::createAliasedPath(profilePath);
+   pResponse->setResult(result);
+   return Success();
+}
+
+// Rprof output is parsed incrementally: the parser for each profile is
+// kept along with how much of the file it has read so that while a
+// profile is being written (and once it's complete) each request reads
+// only what's new
+
+struct RProfState
+{
+   RProfState() : offset(0) {}
+   r_util::RProfParser parser;
+   std::streamoff offset;
+};
+
+boost::mutex s_rprofMutex;
+std::map<std::string, boost::shared_ptr<RProfState> > s_rprofStates;
+
+Error readRProf(const FilePath& profilePath, RProfState* pState)
+{
+   std::ifstream ifs(profilePath.absolutePath().c_str(), std::ios::binary);
+   if (!ifs)
+      return systemError(boost::system::errc::no_such_file_or_directory,
+                         ERROR_LOCATION);
+
+   ifs.seekg(pState->offset);
+   char buffer[65536];
+   while (ifs.read(buffer, sizeof(buffer)) || ifs.gcount() > 0)
+   {
+      std::streamsize count = ifs.gcount();
+      pState->parser.parse(buffer, buffer + count);
+      pState->offset += count;
+   }
+   return Success();
+}
+
+Error getRProfProfile(const json::JsonRpcRequest& request,
+                      json::JsonRpcResponse* pResponse)
+{
+   std::string path;
+   double minFraction = 0.001;
+   Error error = json::readParams(request.params, &path, &minFraction);
+   if (error)
+      return error;
+
+   FilePath profilePath = module_context::resolveAliasedPath(path);
+   if (!profilePath.exists())
+      return pathNotFoundError(profilePath.absolutePath(), ERROR_LOCATION);
+
+   LOCK_MUTEX(s_rprofMutex)
+   {
+      boost::shared_ptr<RProfState>& pState =
+            s_rprofStates[profilePath.absolutePath()];
+
+      // start over if the profile has been rewritten
+      if (!pState ||
+          profilePath.size() < static_cast<uintmax_t>(pState->offset))
+         pState.reset(new RProfState());
+
+      error = readRProf(profilePath, pState.get());
+      if (error)
+         return error;
+
+      pResponse->setResult(pState->parser.toJson(minFraction));
+   }
+   END_LOCK_MUTEX
+
+   return Success();
+}
+
+Error releaseRProfProfile(const json::JsonRpcRequest& request,
+                          json::JsonRpcResponse* pResponse)
+{
+   std::string path;
+   Error error = json::readParams(request.params, &path);
+   if (error)
+      return error;
+
+   FilePath profilePath = module_context::resolveAliasedPath(path);
+
+   LOCK_MUTEX(s_rprofMutex)
+   {
+      s_rprofStates.erase(profilePath.absolutePath());
+   }
+   END_LOCK_MUTEX
+
+   return Success();
+}
+
+void onShutdown(bool)
+{
+   using namespace core::system;
+   if (!sampling_profiler::isRunning())
+      return;
+
+   sampling_profiler::stop();
+   FilePath profilePath;
+   Error error = writeNativeProfile(&profilePath);
+   if (error)
+      LOG_ERROR(error);
+}
 
-   
 } // anonymous namespace
    
 Error initialize()
 {  
+   module_context::events().onShutdown.connect(onShutdown);
+
+   using boost::bind;
+   using namespace module_context;
    ExecBlock initBlock ;
    initBlock.addFunctions()
-      (boost::bind(module_context::sourceModuleRFile, "SessionProfiler.R"));
+      (bind(registerRpcMethod, "start_native_profiler", startNativeProfiler))
+      (bind(registerRpcMethod, "stop_native_profiler", stopNativeProfiler))
+      (bind(registerWorkerSafeRpcMethod, "get_rprof_profile", getRProfProfile))
+      (bind(registerWorkerSafeRpcMethod, "release_rprof_profile",
+                                                   releaseRProfProfile))
+      (bind(sourceModuleRFile, "SessionProfiler.R"));
    return initBlock.execute();
 
 }
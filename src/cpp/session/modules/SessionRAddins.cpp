@@ -20,6 +20,9 @@
 #include <core/Exec.hpp>
 #include <core/FilePath.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/Thread.hpp>
+#include <core/system/System.hpp>
 #include <core/text/DcfParser.hpp>
 
 #include <boost/regex.hpp>
@@ -32,6 +35,7 @@
 #include <r/RExec.hpp>
 
 #include <session/SessionModuleContext.hpp>
+#include <session/SessionWorkerPool.hpp>
 
 using namespace rstudio::core;
 
@@ -80,6 +84,33 @@ public:
       
       return object;
    }
+
+   static bool fromJson(const json::Object& object,
+                        AddinSpecification* pSpec)
+   {
+      bool interactive;
+      std::string name, package, title, description, binding;
+      Error error = json::readObject(object,
+                                     "name", &name,
+                                     "package", &package,
+                                     "title", &title,
+                                     "description", &description,
+                                     "interactive", &interactive,
+                                     "binding", &binding);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return false;
+      }
+
+      *pSpec = AddinSpecification(name,
+                                  package,
+                                  title,
+                                  description,
+                                  interactive,
+                                  binding);
+      return true;
+   }
    
 private:
    std::string name_;
@@ -133,29 +164,11 @@ public:
          BOOST_FOREACH(const std::string& key, addinsJson | boost::adaptors::map_keys)
          {
             json::Value valueJson = addinsJson.at(key);
-            if(json::isType<json::Object>(valueJson))
+            AddinSpecification spec;
+            if (json::isType<json::Object>(valueJson) &&
+                AddinSpecification::fromJson(valueJson.get_obj(), &spec))
             {
-               bool interactive;
-               std::string name, package, title, description, binding;
-               Error error = json::readObject(valueJson.get_obj(),
-                                              "name", &name,
-                                              "package", &package,
-                                              "title", &title,
-                                              "description", &description,
-                                              "interactive", &interactive,
-                                              "binding", &binding);
-               if (error)
-               {
-                  LOG_ERROR(error);
-                  continue;
-               }
-
-               addins_[key] = AddinSpecification(name,
-                                                 package,
-                                                 title,
-                                                 description,
-                                                 interactive,
-                                                 binding);
+               addins_[key] = spec;
             }
          }
 
@@ -168,24 +181,10 @@ public:
       addins_[constructKey(package, spec.getBinding())] = spec;
    }
 
-   void add(const std::string& pkgName,
-            std::map<std::string, std::string>& fields)
-   {
-      // if the 'interactive' field is not specified, default to 'true'
-      bool interactive = true;
-      if (fields.count("Interactive"))
-         interactive = isTruthy(fields["Interactive"]);
-      
-      add(pkgName, AddinSpecification(
-            fields["Name"],
-            pkgName,
-            fields["Title"],
-            fields["Description"],
-            interactive,
-            fields["Binding"]));
-   }
-
-   void add(const std::string& pkgName, const FilePath& addinPath)
+   // read the addins declared by a package's addins.dcf
+   static void readAddinsFile(const std::string& pkgName,
+                              const FilePath& addinPath,
+                              std::vector<AddinSpecification>* pAddins)
    {
       static const boost::regex reSeparator("\\n{2,}");
 
@@ -203,7 +202,7 @@ public:
       for (; it != end; ++it)
       {
          std::map<std::string, std::string> fields = parseAddinDcf(*it);
-         add(pkgName, fields);
+         pAddins->push_back(specFromFields(pkgName, fields));
       }
    }
    
@@ -232,6 +231,23 @@ public:
    std::size_t size() const { return addins_.size(); }
    
 private:
+
+   static AddinSpecification specFromFields(
+                           const std::string& pkgName,
+                           std::map<std::string, std::string>& fields)
+   {
+      // if the 'interactive' field is not specified, default to 'true'
+      bool interactive = true;
+      if (fields.count("Interactive"))
+         interactive = isTruthy(fields["Interactive"]);
+      
+      return AddinSpecification(fields["Name"],
+                                pkgName,
+                                fields["Title"],
+                                fields["Description"],
+                                interactive,
+                                fields["Binding"]);
+   }
    
    static std::map<std::string, std::string> parseAddinDcf(
                                           const std::string& contents)
@@ -286,9 +302,10 @@ void updateAddinRegistry(boost::shared_ptr<AddinRegistry> pRegistry)
    module_context::enqueClientEvent(event);
 }
 
-void loadAddinRegistry()
+Error loadAddinRegistry()
 {
    s_pCurrentRegistry->loadFromFile(addinRegistryPath());
+   return Success();
 }
 
 AddinRegistry& addinRegistry()
@@ -296,115 +313,329 @@ AddinRegistry& addinRegistry()
    return *s_pCurrentRegistry;
 }
 
-class AddinIndexer : public boost::noncopyable
+// the addins found in each library are cached (keyed by the library's path)
+// in the user scratch path so that later sessions can reuse them. a library
+// whose directory hasn't been modified since it was indexed (packages are
+// installed and removed by moving their directories in and out of it) is
+// taken from the cache as is; otherwise only the packages whose DESCRIPTION
+// has changed are re-read
+
+struct PackageAddins
 {
-public:
-   
-   AddinIndexer()
+   PackageAddins() : descriptionTime(0) {}
+   std::time_t descriptionTime;
+   std::vector<AddinSpecification> addins;
+};
+
+struct LibraryIndex
+{
+   LibraryIndex() : libraryTime(0) {}
+   std::time_t libraryTime;
+   std::map<std::string, PackageAddins> packages;
+};
+
+FilePath addinIndexCachePath()
+{
+   return module_context::userScratchPath().childPath("addin_index");
+}
+
+FilePath libraryIndexPath(const FilePath& cachePath, const FilePath& libPath)
+{
+   return cachePath.childPath(
+            core::hash::crc32HexHash(libPath.absolutePath()) + ".json");
+}
+
+void readLibraryIndex(const FilePath& indexPath,
+                      const FilePath& libPath,
+                      LibraryIndex* pIndex)
+{
+   if (!indexPath.exists())
+      return;
+
+   std::string contents;
+   Error error = core::readStringFromFile(indexPath, &contents);
+   if (error)
    {
-      clear();
+      LOG_ERROR(error);
+      return;
    }
 
-   void start(const std::vector<FilePath>& libPaths)
+   // check but don't log for unexpected input because we are the only ones
+   // that write this file
+   json::Value parsedJson;
+   if (!json::parse(contents, &parsedJson) ||
+       !json::isType<json::Object>(parsedJson))
    {
-      // reset instance data
-      clear();
+      return;
+   }
+
+   std::string library;
+   int libraryTime;
+   json::Object packagesJson;
+   error = json::readObject(parsedJson.get_obj(),
+                            "library", &library,
+                            "time", &libraryTime,
+                            "packages", &packagesJson);
+   if (error || library != libPath.absolutePath())
+      return;
+
+   BOOST_FOREACH(const std::string& pkgName,
+                 packagesJson | boost::adaptors::map_keys)
+   {
+      const json::Value& packageJson = packagesJson.at(pkgName);
+      if (!json::isType<json::Object>(packageJson))
+         continue;
+
+      int descriptionTime;
+      json::Array addinsJson;
+      error = json::readObject(packageJson.get_obj(),
+                               "time", &descriptionTime,
+                               "addins", &addinsJson);
+      if (error)
+         continue;
+
+      PackageAddins& package = pIndex->packages[pkgName];
+      package.descriptionTime = descriptionTime;
+      BOOST_FOREACH(const json::Value& addinJson, addinsJson)
+      {
+         AddinSpecification spec;
+         if (json::isType<json::Object>(addinJson) &&
+             AddinSpecification::fromJson(addinJson.get_obj(), &spec))
+         {
+            package.addins.push_back(spec);
+         }
+      }
+   }
+
+   pIndex->libraryTime = libraryTime;
+}
+
+void writeLibraryIndex(const FilePath& indexPath,
+                       const FilePath& libPath,
+                       const LibraryIndex& index)
+{
+   json::Object packagesJson;
+   for (std::map<std::string, PackageAddins>::const_iterator it =
+           index.packages.begin(); it != index.packages.end(); ++it)
+   {
+      json::Array addinsJson;
+      BOOST_FOREACH(const AddinSpecification& spec, it->second.addins)
+      {
+         addinsJson.push_back(spec.toJson());
+      }
+
+      json::Object packageJson;
+      packageJson["time"] = static_cast<int>(it->second.descriptionTime);
+      packageJson["addins"] = addinsJson;
+      packagesJson[it->first] = packageJson;
+   }
+
+   json::Object indexJson;
+   indexJson["library"] = libPath.absolutePath();
+   indexJson["time"] = static_cast<int>(index.libraryTime);
+   indexJson["packages"] = packagesJson;
+
+   Error error = indexPath.parent().ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // write to a temporary file and move it into place so that other sessions
+   // indexing the same library never read a partially written index
+   FilePath tempPath(indexPath.absolutePath() + "." +
+                     core::system::generateShortenedUuid());
+   error = core::writeStringToFile(tempPath, json::write(indexJson));
+   if (!error)
+      error = tempPath.move(indexPath);
+   if (error)
+   {
+      LOG_ERROR(error);
+      tempPath.removeIfExists();
+   }
+}
+
+void indexLibrary(const FilePath& libPath,
+                  const FilePath& cachePath,
+                  AddinRegistry* pRegistry)
+{
+   FilePath indexPath = libraryIndexPath(cachePath, libPath);
+
+   LibraryIndex cached;
+   readLibraryIndex(indexPath, libPath, &cached);
+
+   LibraryIndex index;
+   std::time_t libraryTime = libPath.lastWriteTime();
+   if (libraryTime != 0 && libraryTime == cached.libraryTime)
+   {
+      index = cached;
+   }
+   else
+   {
+      index.libraryTime = libraryTime;
 
-      // prime work list
       std::vector<FilePath> pkgPaths;
-      BOOST_FOREACH(const FilePath& libPath, libPaths)
+      Error error = libPath.children(&pkgPaths);
+      if (error)
+         LOG_ERROR(error);
+
+      BOOST_FOREACH(const FilePath& pkgPath, pkgPaths)
       {
-         if (!libPath.exists())
+         std::time_t descriptionTime =
+               pkgPath.childPath("DESCRIPTION").lastWriteTime();
+         if (descriptionTime == 0)
+            continue;
+
+         // reuse the addins of packages which haven't changed
+         std::string pkgName = pkgPath.filename();
+         std::map<std::string, PackageAddins>::const_iterator it =
+                                                cached.packages.find(pkgName);
+         if (it != cached.packages.end() &&
+             it->second.descriptionTime == descriptionTime)
+         {
+            index.packages[pkgName] = it->second;
             continue;
-         
-         pkgPaths.clear();
-         Error error = libPath.children(&pkgPaths);
-         if (error)
-            LOG_ERROR(error);
-         children_.insert(
-                  children_.end(),
-                  pkgPaths.begin(),
-                  pkgPaths.end());
+         }
+
+         PackageAddins& package = index.packages[pkgName];
+         package.descriptionTime = descriptionTime;
+         FilePath addinPath = pkgPath.childPath("rstudio/addins.dcf");
+         if (addinPath.exists())
+            AddinRegistry::readAddinsFile(pkgName, addinPath, &package.addins);
       }
-      
-      n_ = children_.size();
+
+      writeLibraryIndex(indexPath, libPath, index);
    }
 
-   void addContinuation(json::JsonRpcFunctionContinuation continuation)
+   for (std::map<std::string, PackageAddins>::const_iterator it =
+           index.packages.begin(); it != index.packages.end(); ++it)
    {
-      continuations_.push_back(continuation);
+      BOOST_FOREACH(const AddinSpecification& spec, it->second.addins)
+      {
+         pRegistry->add(it->first, spec);
+      }
    }
+}
 
-   bool running()
+// registry built by indexing on the worker pool (collected by the main
+// thread once it's done)
+struct IndexResult : boost::noncopyable
+{
+   IndexResult() : done(false) {}
+   boost::mutex mutex;
+   bool done;
+   boost::shared_ptr<AddinRegistry> pRegistry;
+};
+
+void indexLibraryPathsTask(const std::vector<FilePath>& libPaths,
+                           const FilePath& cachePath,
+                           boost::shared_ptr<IndexResult> pResult)
+{
+   boost::shared_ptr<AddinRegistry> pRegistry =
+                                 boost::make_shared<AddinRegistry>();
+   try
    {
-      return index_ != n_;
+      BOOST_FOREACH(const FilePath& libPath, libPaths)
+      {
+         if (libPath.exists())
+            indexLibrary(libPath, cachePath, pRegistry.get());
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   LOCK_MUTEX(pResult->mutex)
+   {
+      pResult->pRegistry = pRegistry;
+      pResult->done = true;
    }
+   END_LOCK_MUTEX
+}
+
+class AddinIndexer : public boost::noncopyable
+{
+public:
    
-   bool work()
+   AddinIndexer()
+      : running_(false)
    {
-      // std::cout << "Job " << index_ + 1 << " of " << n_ << "\n";
-      // ::usleep(10000);
-      
-      const FilePath& pkgPath = children_[index_];
-      FilePath addinPath = pkgPath.childPath("rstudio/addins.dcf");
-      if (!addinPath.exists())
+   }
+
+   void start(const std::vector<FilePath>& libPaths)
+   {
+      running_ = true;
+      pResult_ = boost::make_shared<IndexResult>();
+
+      // index on the worker pool (or inline if it isn't running) and
+      // check for the result from the main thread
+      boost::function<void()> task = boost::bind(indexLibraryPathsTask,
+                                                 libPaths,
+                                                 addinIndexCachePath(),
+                                                 pResult_);
+      if (worker_pool::execute(task, core::thread::TaskPriorityLow))
       {
-         ++index_;
-         return maybeFinishRunning();
+         module_context::schedulePeriodicWork(
+                  boost::posix_time::milliseconds(50),
+                  boost::bind(&AddinIndexer::checkFinished, this),
+                  false /* check even when non-idle */,
+                  false /* not immediate */);
+      }
+      else
+      {
+         task();
+         checkFinished();
       }
-      
-      std::string pkgName = pkgPath.filename();
-      pRegistry_->add(pkgName, addinPath);
-      
-      ++index_;
-      return maybeFinishRunning();
    }
 
-private:
+   void addContinuation(json::JsonRpcFunctionContinuation continuation)
+   {
+      continuations_.push_back(continuation);
+   }
 
-   // reset all instance data
-   void clear()
+   bool running()
    {
-      children_.clear();
-      n_ = 0;
-      index_ = 0;
-      pRegistry_ = boost::make_shared<AddinRegistry>();
-      continuations_.clear();
+      return running_;
    }
 
-   // check for still running, if we aren't still running then complete
-   // our work and return false, otherwise return true
-   bool maybeFinishRunning()
+private:
+
+   // if indexing is complete then update the registry and return false,
+   // otherwise return true (to be called again)
+   bool checkFinished()
    {
-      if (!running())
+      boost::shared_ptr<AddinRegistry> pRegistry;
+      LOCK_MUTEX(pResult_->mutex)
       {
-         // update the addin registry
-         updateAddinRegistry(pRegistry_);
+         if (pResult_->done)
+            pRegistry = pResult_->pRegistry;
+      }
+      END_LOCK_MUTEX
 
-         // handle pending continuations
-         json::Object registryJson = addinRegistry().toJson();
-         BOOST_FOREACH(json::JsonRpcFunctionContinuation continuation, continuations_)
-         {
-            json::JsonRpcResponse response;
-            response.setResult(registryJson);
-            continuation(Success(), &response);
-         }
+      if (!pRegistry)
+         return true;
 
-         // clear instance data and return false
-         clear();
-         return false;
-      }
-      else
+      // update the addin registry
+      updateAddinRegistry(pRegistry);
+
+      // handle pending continuations
+      json::Object registryJson = addinRegistry().toJson();
+      BOOST_FOREACH(json::JsonRpcFunctionContinuation continuation, continuations_)
       {
-         return true;
+         json::JsonRpcResponse response;
+         response.setResult(registryJson);
+         continuation(Success(), &response);
       }
+
+      // clear instance data
+      continuations_.clear();
+      pResult_.reset();
+      running_ = false;
+      return false;
    }
    
 private:
-   std::vector<FilePath> children_;
-   std::size_t n_;
-   std::size_t index_;
-   boost::shared_ptr<AddinRegistry> pRegistry_;
+   bool running_;
+   boost::shared_ptr<IndexResult> pResult_;
    std::vector<json::JsonRpcFunctionContinuation> continuations_;
 };
 
@@ -420,29 +651,14 @@ void indexLibraryPathsWithContinuation(
    // get the libpaths
    std::vector<FilePath> libPaths = module_context::getLibPaths();
 
-   // start if we arent' already running
+   // register continuation if provided (before starting, since indexing
+   // completes immediately if the worker pool isn't running)
+   if (continuation)
+      addinIndexer().addContinuation(continuation);
+
+   // start if we aren't already running
    if (!addinIndexer().running())
-   {
-      // start indexer
       addinIndexer().start(libPaths);
-
-      // register continuation if provided
-      if (continuation)
-         addinIndexer().addContinuation(continuation);
-
-      // schedule work
-      module_context::scheduleIncrementalWork(
-               boost::posix_time::milliseconds(300),
-               boost::posix_time::milliseconds(20),
-               boost::bind(&AddinIndexer::work, &addinIndexer()),
-               false);
-   }
-   else
-   {
-      // register continuation if provided
-      if (continuation)
-         addinIndexer().addContinuation(continuation);
-   }
 }
 
 void indexLibraryPaths()
@@ -590,8 +806,8 @@ Error initialize()
    using boost::bind;
    using namespace module_context;
    
-   // load cached registry
-   loadAddinRegistry();
+   // load cached registry (on the worker pool as it needs no R)
+   scheduleStartupTask("load addin registry", loadAddinRegistry);
 
    events().onDeferredInit.connect(onDeferredInit);
    events().onConsoleInput.connect(onConsoleInput);
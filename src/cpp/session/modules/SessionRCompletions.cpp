@@ -170,8 +170,57 @@ struct SourceIndexCompletions {
    bool moreAvailable;
 };
 
+// completion requests typically arrive as the user types each character of
+// a token, so the candidates gathered for one request are kept and the
+// next is answered by filtering them (when its token extends the cached
+// one and the cached candidates are still current)
+struct SourceIndexCompletionsCache
+{
+   SourceIndexCompletionsCache() : valid(false), generation(0) {}
+   bool valid;
+   unsigned generation;
+   std::string token;
+   SourceIndexCompletions completions;
+};
+
+SourceIndexCompletionsCache s_sourceIndexCompletionsCache;
+
+bool filterCachedSourceIndexCompletions(const std::string& token,
+                                        SourceIndexCompletions* pCompletions)
+{
+   const SourceIndexCompletionsCache& cache = s_sourceIndexCompletionsCache;
+
+   // the cache must be current and complete, and the token must be a plain
+   // prefix (searchSource treats '*' as a wildcard) extending the cached one
+   if (!cache.valid ||
+       cache.generation != modules::code_search::sourceIndexGeneration() ||
+       cache.completions.moreAvailable ||
+       token.find('*') != std::string::npos ||
+       !boost::algorithm::istarts_with(token, cache.token))
+   {
+      return false;
+   }
+
+   // filter with the same predicate searchSource applies
+   for (std::size_t i = 0; i < cache.completions.completions.size(); i++)
+   {
+      const std::string& completion = cache.completions.completions[i];
+      if (boost::algorithm::istarts_with(completion, token))
+      {
+         pCompletions->completions.push_back(completion);
+         pCompletions->isFunction.push_back(cache.completions.isFunction[i]);
+      }
+   }
+   pCompletions->moreAvailable = false;
+   return true;
+}
+
 SourceIndexCompletions getSourceIndexCompletions(const std::string& token)
 {
+   SourceIndexCompletions srcCompletions;
+   if (filterCachedSourceIndexCompletions(token, &srcCompletions))
+      return srcCompletions;
+
    // get functions from the source index
    std::vector<core::r_util::RSourceItem> items;
    bool moreAvailable = false;
@@ -183,7 +232,6 @@ SourceIndexCompletions getSourceIndexCompletions(const std::string& token)
                                       &items,
                                       &moreAvailable);
 
-   SourceIndexCompletions srcCompletions;
    BOOST_FOREACH(const core::r_util::RSourceItem& item, items)
    {
       if (item.braceLevel() == 0)
@@ -194,6 +242,17 @@ SourceIndexCompletions getSourceIndexCompletions(const std::string& token)
    }
 
    srcCompletions.moreAvailable = moreAvailable;
+
+   // cache for subsequent requests
+   if (token.find('*') == std::string::npos)
+   {
+      SourceIndexCompletionsCache& cache = s_sourceIndexCompletionsCache;
+      cache.valid = true;
+      cache.generation = modules::code_search::sourceIndexGeneration();
+      cache.token = token;
+      cache.completions = srcCompletions;
+   }
+
    return srcCompletions;
 }
 
@@ -216,6 +275,16 @@ SEXP rs_getSourceIndexCompletions(SEXP tokenSEXP)
    return resultSEXP;
 }
 
+bool pathMatches(const std::string& absolutePath,
+                 const std::string& pattern,
+                 int parentPathLength)
+{
+   return string_utils::isSubsequence(
+            absolutePath.substr(parentPathLength + 2),
+            pattern,
+            true);
+}
+
 bool subsequenceFilter(const FileInfo& fileInfo,
                        const std::string& pattern,
                        int parentPathLength,
@@ -230,12 +299,7 @@ bool subsequenceFilter(const FileInfo& fileInfo,
       return false;
    }
    
-   bool isSubsequence = string_utils::isSubsequence(
-            fileInfo.absolutePath().substr(parentPathLength + 2),
-            pattern,
-            true);
-   
-   if (isSubsequence)
+   if (pathMatches(fileInfo.absolutePath(), pattern, parentPathLength))
    {
       ++*pCount;
       pPaths->push_back(fileInfo.absolutePath());
@@ -250,39 +314,146 @@ bool subsequenceFilter(const FileInfo& fileInfo,
    return false;
 }
 
+// listing of the files beneath the directory most recently scanned (in scan
+// order), which subsequent scans of it filter for a short while rather than
+// reading the tree again. directories within the project are instead listed
+// from the project's file index (which the file monitor keeps current)
+const int kMaxCachedFileListing = 20000;
+
+struct FileListingCache
+{
+   FileListingCache() : valid(false) {}
+   bool valid;
+   std::string path;
+   boost::posix_time::ptime time;
+   std::vector<std::string> paths;
+};
+
+FileListingCache s_fileListingCache;
+
+bool listingFilter(const FileInfo& fileInfo,
+                   std::vector<std::string>* pPaths,
+                   bool* pComplete)
+{
+   if (pPaths->size() >= static_cast<std::size_t>(kMaxCachedFileListing))
+   {
+      *pComplete = false;
+      return false;
+   }
+
+   pPaths->push_back(fileInfo.absolutePath());
+   return fileInfo.isDirectory();
+}
+
+// returns NULL if the directory is too large to list (in which case the
+// caller scans it for matches directly)
+const std::vector<std::string>* fileListing(
+                                 const std::string& path,
+                                 std::vector<std::string>* pIndexedPaths)
+{
+   using namespace boost::posix_time;
+
+   if (modules::code_search::listIndexedFilesAndFolders(FilePath(path),
+                                                        pIndexedPaths))
+   {
+      return pIndexedPaths;
+   }
+
+   FileListingCache& cache = s_fileListingCache;
+   ptime now = microsec_clock::universal_time();
+   if (!cache.valid || cache.path != path || now - cache.time > seconds(5))
+   {
+      std::vector<std::string> paths;
+      bool complete = true;
+
+      core::system::FileScannerOptions options;
+      options.recursive = true;
+      options.yield = true;
+      options.filter = boost::bind(listingFilter, _1, &paths, &complete);
+
+      tree<FileInfo> tree;
+      Error error = scanFiles(FileInfo(FilePath(path)), options, &tree);
+      if (error || !complete)
+      {
+         cache.valid = false;
+         return NULL;
+      }
+
+      cache.valid = true;
+      cache.path = path;
+      cache.time = now;
+      cache.paths.swap(paths);
+   }
+
+   return &cache.paths;
+}
+
 SEXP rs_scanFiles(SEXP pathSEXP,
                   SEXP patternSEXP,
+                  SEXP asRelativePathSEXP,
                   SEXP maxCountSEXP)
 {
    std::string path = r::sexp::asString(pathSEXP);
    std::string pattern = r::sexp::asString(patternSEXP);
+   bool asRelativePath = r::sexp::asLogical(asRelativePathSEXP);
    int maxCount = r::sexp::asInteger(maxCountSEXP);
 
-   FilePath filePath(path);
-   FileInfo fileInfo(filePath);
-   tree<FileInfo> tree;
-
-   core::system::FileScannerOptions options;
-   options.recursive = true;
-   options.yield = true;
-
-   // Use a subsequence filter, and bail after too many files
    std::vector<std::string> paths;
-   
    int count = 0;
    bool moreAvailable = false;
-   options.filter = boost::bind(subsequenceFilter,
-                                _1,
-                                pattern,
-                                path.length(),
-                                maxCount,
-                                &paths,
-                                &count,
-                                &moreAvailable);
-
-   Error error = scanFiles(fileInfo, options, &tree);
-   if (error)
-      return R_NilValue;
+
+   std::vector<std::string> indexedPaths;
+   const std::vector<std::string>* pListing = fileListing(path, &indexedPaths);
+   if (pListing != NULL)
+   {
+      BOOST_FOREACH(const std::string& candidate, *pListing)
+      {
+         if (!pathMatches(candidate, pattern, path.length()))
+            continue;
+
+         if (count >= maxCount)
+         {
+            moreAvailable = true;
+            break;
+         }
+
+         ++count;
+         paths.push_back(candidate);
+      }
+   }
+   else
+   {
+      FilePath filePath(path);
+      FileInfo fileInfo(filePath);
+      tree<FileInfo> tree;
+
+      core::system::FileScannerOptions options;
+      options.recursive = true;
+      options.yield = true;
+
+      // Use a subsequence filter, and bail after too many files
+      options.filter = boost::bind(subsequenceFilter,
+                                   _1,
+                                   pattern,
+                                   path.length(),
+                                   maxCount,
+                                   &paths,
+                                   &count,
+                                   &moreAvailable);
+
+      Error error = scanFiles(fileInfo, options, &tree);
+      if (error)
+         return R_NilValue;
+   }
+
+   if (asRelativePath)
+   {
+      BOOST_FOREACH(std::string& match, paths)
+      {
+         if (match.length() > path.length() + 1)
+            match = match.substr(path.length() + 1);
+      }
+   }
 
    r::sexp::Protect protect;
    r::sexp::ListBuilder builder(&protect);
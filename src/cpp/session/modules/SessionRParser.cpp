@@ -1377,7 +1377,9 @@ ParseResults parse(const FilePath& filePath,
    RTokenCursor cursor(rTokens);
    ParseStatus status(filePath, parseOptions);
    
-   doParse(cursor, status);
+   // Only parse if the document isn't empty (only whitespace or comments)
+   if (!cursor.isAtEndOfDocument())
+      doParse(cursor, status);
    
    if (status.node()->getParent() != NULL)
    {
@@ -1423,6 +1425,277 @@ ParseResults parse(const FilePath &filePath, const ParseOptions &parseOptions)
             string_utils::utf8ToWide(contents),
             parseOptions);
 }
+
+namespace {
+
+bool compareCheckpointOffsets(const ParseCheckpoint& lhs,
+                              const ParseCheckpoint& rhs)
+{
+   return lhs.offset < rhs.offset;
+}
+
+bool compareTokenOffsets(const RToken& lhs, std::size_t offset)
+{
+   return lhs.offset() < offset;
+}
+
+// Records the checkpoints seen while re-parsing part of a document, and
+// decides where we can stop re-parsing and re-use the results of the
+// previous parse for the rest of the document.
+class IncrementalParser
+{
+public:
+   
+   IncrementalParser(const std::vector<ParseCheckpoint>& previousCheckpoints,
+                     std::size_t previousSize,
+                     std::size_t size,
+                     std::size_t unchangedSuffixSize,
+                     std::size_t startRow,
+                     ParseNode* pPreviousTail,
+                     ParseStatus* pStatus)
+      : previousCheckpoints_(previousCheckpoints),
+        previousSize_(previousSize),
+        size_(size),
+        unchangedSuffixSize_(unchangedSuffixSize),
+        startRow_(startRow),
+        pPreviousTail_(pPreviousTail),
+        pStatus_(pStatus),
+        pResumePoint_(NULL)
+   {
+   }
+   
+   bool onCheckpoint(const ParseCheckpoint& checkpoint)
+   {
+      checkpoints_.push_back(checkpoint);
+      
+      if (!pPreviousTail_)
+         return false;
+      
+      // We can only pick up the previous parse from a line which lies
+      // entirely after the edit (including the newline preceding it).
+      if (checkpoint.offset - checkpoint.column <= size_ - unchangedSuffixSize_)
+         return false;
+      
+      ParseCheckpoint previous(
+               checkpoint.offset + previousSize_ - size_, 0, 0);
+      std::vector<ParseCheckpoint>::const_iterator it = std::lower_bound(
+               previousCheckpoints_.begin(),
+               previousCheckpoints_.end(),
+               previous,
+               compareCheckpointOffsets);
+      
+      if (it == previousCheckpoints_.end() || it->offset != previous.offset)
+         return false;
+      
+      // The rest of the document parses as it did before, unless it
+      // uses something defined by the expressions we've just re-parsed
+      // (or by the expressions they replaced).
+      Position previousStart(it->row, 0);
+      std::set<std::string> names;
+      pPreviousTail_->collectDefinedNames(Position(startRow_, 0),
+                                          previousStart,
+                                          &names);
+      pStatus_->root()->collectDefinedNames(Position(startRow_, 0),
+                                            Position(checkpoint.row, 0),
+                                            &names);
+      
+      if (!names.empty() && pPreviousTail_->usesAnyOf(names, previousStart))
+         return false;
+      
+      checkpoints_.pop_back();
+      pResumePoint_ = &*it;
+      rowDelta_ = static_cast<int>(checkpoint.row) - static_cast<int>(it->row);
+      return true;
+   }
+   
+   // the checkpoint (from the previous parse) where we stopped parsing,
+   // or NULL if we parsed to the end of the document
+   const ParseCheckpoint* resumePoint() const { return pResumePoint_; }
+   int rowDelta() const { return rowDelta_; }
+   
+   const std::vector<ParseCheckpoint>& checkpoints() const
+   {
+      return checkpoints_;
+   }
+   
+private:
+   const std::vector<ParseCheckpoint>& previousCheckpoints_;
+   std::size_t previousSize_;
+   std::size_t size_;
+   std::size_t unchangedSuffixSize_;
+   std::size_t startRow_;
+   ParseNode* pPreviousTail_;
+   ParseStatus* pStatus_;
+   
+   std::vector<ParseCheckpoint> checkpoints_;
+   const ParseCheckpoint* pResumePoint_;
+   int rowDelta_;
+};
+
+} // anonymous namespace
+
+ParseResults parse(const FilePath& filePath,
+                   const std::wstring& rCode,
+                   const ParseOptions& parseOptions,
+                   IncrementalParseState* pState)
+{
+   if (rCode.empty() || rCode.find_first_not_of(L" \r\n\t\v") == std::string::npos)
+   {
+      pState->clear();
+      return ParseResults();
+   }
+   
+   if (pState->empty() ||
+       pState->filePath_ != filePath ||
+       !(pState->parseOptions_ == parseOptions))
+   {
+      pState->clear();
+   }
+   
+   const std::wstring& previousCode = pState->code_;
+   if (!pState->empty() && rCode == previousCode)
+      return ParseResults(pState->pRoot_, pState->lint_, parseOptions.globals());
+   
+   // Find the range of the document which changed.
+   std::size_t previousSize = previousCode.size();
+   std::size_t size = rCode.size();
+   std::size_t maxSize = std::min(previousSize, size);
+   
+   std::size_t prefixSize = 0;
+   while (prefixSize < maxSize && previousCode[prefixSize] == rCode[prefixSize])
+      ++prefixSize;
+   
+   std::size_t suffixSize = 0;
+   while (suffixSize < maxSize - prefixSize &&
+          previousCode[previousSize - suffixSize - 1] == rCode[size - suffixSize - 1])
+   {
+      ++suffixSize;
+   }
+   
+   // Resume parsing from the checkpoint prior to the expression containing
+   // the start of the edit, since the edit may change how that expression
+   // ends. Everything parsed before that checkpoint is unaffected.
+   std::vector<ParseCheckpoint> previousCheckpoints;
+   previousCheckpoints.swap(pState->checkpoints_);
+   
+   std::vector<ParseCheckpoint>::iterator it = std::upper_bound(
+            previousCheckpoints.begin(),
+            previousCheckpoints.end(),
+            ParseCheckpoint(prefixSize, 0, 0),
+            compareCheckpointOffsets);
+   
+   std::size_t resumeIndex = it - previousCheckpoints.begin();
+   resumeIndex = resumeIndex >= 2 ? resumeIndex - 2 : 0;
+   
+   boost::shared_ptr<ParseNode> pRoot;
+   boost::shared_ptr<ParseNode> pPreviousTail;
+   LintItems lint(parseOptions);
+   LintItems previousTailLint(parseOptions);
+   std::size_t startOffset = 0;
+   std::size_t startRow = 0;
+   
+   if (resumeIndex > 0)
+   {
+      const ParseCheckpoint& start = previousCheckpoints[resumeIndex];
+      startOffset = start.offset;
+      startRow = start.row;
+      
+      pRoot = pState->pRoot_;
+      pPreviousTail = pRoot->splitAt(Position(startRow, 0));
+      lint = pState->lint_;
+      previousTailLint = lint.splitAt(startRow);
+   }
+   else
+   {
+      pRoot = ParseNode::createRootNode();
+      pPreviousTail = pState->pRoot_;
+      previousTailLint = pState->lint_;
+   }
+   
+   RTokens rTokens(rCode, RTokens::StripComments);
+   if (rTokens.empty())
+   {
+      pState->clear();
+      return ParseResults();
+   }
+   
+   RTokens::const_iterator startToken = std::lower_bound(
+            rTokens.begin(),
+            rTokens.end(),
+            startOffset,
+            compareTokenOffsets);
+   
+   RTokenCursor cursor(rTokens, startToken - rTokens.begin());
+   ParseStatus status(filePath, parseOptions, pRoot, lint);
+   
+   IncrementalParser parser(previousCheckpoints,
+                            previousSize,
+                            size,
+                            suffixSize,
+                            startRow,
+                            pPreviousTail.get(),
+                            &status);
+   
+   status.setCheckpointHandler(
+            boost::bind(&IncrementalParser::onCheckpoint, &parser, _1));
+   
+   // When resuming from a checkpoint we're part way through the document,
+   // and so shouldn't check whether the (whole) document is empty
+   if (resumeIndex > 0 || !cursor.isAtEndOfDocument())
+      doParse(cursor, status);
+   
+   std::vector<ParseCheckpoint> checkpoints(
+            previousCheckpoints.begin(),
+            previousCheckpoints.begin() + resumeIndex);
+   checkpoints.insert(checkpoints.end(),
+                      parser.checkpoints().begin(),
+                      parser.checkpoints().end());
+   
+   const ParseCheckpoint* pResumePoint = parser.resumePoint();
+   if (pResumePoint)
+   {
+      // Splice in the results of the previous parse for the rest of
+      // the document, moving them to their new rows.
+      int rowDelta = parser.rowDelta();
+      
+      boost::shared_ptr<ParseNode> pUnchanged =
+            pPreviousTail->splitAt(Position(pResumePoint->row, 0));
+      pUnchanged->shiftRows(rowDelta);
+      status.root()->append(pUnchanged.get());
+      
+      LintItems unchangedLint = previousTailLint.splitAt(pResumePoint->row);
+      unchangedLint.shiftRows(rowDelta);
+      status.lint().append(unchangedLint);
+      
+      std::vector<ParseCheckpoint>::const_iterator it = previousCheckpoints.begin() +
+            (pResumePoint - &previousCheckpoints[0]);
+      for (; it != previousCheckpoints.end(); ++it)
+      {
+         checkpoints.push_back(ParseCheckpoint(it->offset + size - previousSize,
+                                               it->row + rowDelta,
+                                               it->column));
+      }
+   }
+   else
+   {
+      if (status.node()->getParent() != NULL)
+      {
+         DEBUG("** Parent is not null (not at top level): failed to close all scopes?");
+         status.lint().unexpectedEndOfDocument(cursor.currentToken());
+      }
+      
+      status.addLintIfBracketStackNotEmpty();
+   }
+   
+   pState->filePath_ = filePath;
+   pState->parseOptions_ = parseOptions;
+   pState->code_ = rCode;
+   pState->pRoot_ = status.root();
+   pState->lint_ = status.lint();
+   pState->checkpoints_.swap(checkpoints);
+   
+   return ParseResults(status.root(), status.lint(), parseOptions.globals());
+}
 namespace {
 
 bool closesArgumentList(const RTokenCursor& cursor,
@@ -1915,6 +2188,25 @@ bool makeSymbolsAvailableInCallFromObjectNames(RTokenCursor cursor,
    return false;
 }
 
+// Checkpoints are the first token of a top-level expression which starts
+// a line, and which does not continue the previous expression.
+bool isAtCheckpoint(const RTokenCursor& cursor, const ParseStatus& status)
+{
+   if (!status.isAtTopLevelScope())
+      return false;
+   
+   // an operator at the start of a line continues (or relates to)
+   // whatever came before it, so isn't a fresh expression
+   if (cursor.contentEquals(L"else") || isBinaryOp(cursor))
+      return false;
+   
+   RTokenCursor clone = cursor.clone();
+   if (!clone.moveToPreviousSignificantToken())
+      return true;
+   
+   return clone.row() < cursor.row() && !isBinaryOp(clone);
+}
+
 } // anonymous namespace
 
 #define GOTO_INVALID_TOKEN(__CURSOR__)                                         \
@@ -1927,10 +2219,6 @@ bool makeSymbolsAvailableInCallFromObjectNames(RTokenCursor cursor,
 void doParse(RTokenCursor& cursor, ParseStatus& status)
 {
    DEBUG("Beginning parse...");
-   // Return early if the document is empty (only whitespace or comments)
-   if (cursor.isAtEndOfDocument())
-      return;
-   
    cursor.fwdOverWhitespaceAndComments();
    bool startedWithUnaryOperator = false;
    
@@ -1943,6 +2231,14 @@ START:
       
       DEBUG("== Current state: " << status.currentStateAsString());
       
+      if (status.hasCheckpointHandler() && isAtCheckpoint(cursor, status))
+      {
+         const RToken& token = cursor.currentToken();
+         ParseCheckpoint checkpoint(token.offset(), token.row(), token.column());
+         if (status.onCheckpoint(checkpoint))
+            return;
+      }
+      
       checkIncorrectComparison(cursor, status);
       
       // We want to skip over formulas if necessary.
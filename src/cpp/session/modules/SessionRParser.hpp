@@ -41,6 +41,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/container/flat_set.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
@@ -147,6 +148,16 @@ public:
    std::set<std::string>& globals() { return globals_; }
    const std::set<std::string>& globals() const { return globals_; }
 
+   bool operator==(const ParseOptions& other) const
+   {
+      return lintRFunctions_ == other.lintRFunctions_ &&
+             checkArgumentsToRFunctionCalls_ == other.checkArgumentsToRFunctionCalls_ &&
+             warnIfNoSuchVariableInScope_ == other.warnIfNoSuchVariableInScope_ &&
+             warnIfVariableIsDefinedButNotUsed_ == other.warnIfVariableIsDefinedButNotUsed_ &&
+             recordStyleLint_ == other.recordStyleLint_ &&
+             globals_ == other.globals_;
+   }
+
 private:
    bool lintRFunctions_;
    bool checkArgumentsToRFunctionCalls_;
@@ -459,7 +470,48 @@ public:
       for (std::size_t i = 0, n = items.size(); i < n; ++i)
          lintItems_.push_back(items.get()[i]);
    }
-   
+
+   // Used for incremental parsing: remove the lint items starting at or
+   // after 'row', returning them as a separate collection.
+   LintItems splitAt(std::size_t row)
+   {
+      LintItems tail(parseOptions_);
+      std::vector<LintItem> head;
+      errorCount_ = 0;
+
+      BOOST_FOREACH(const LintItem& item, lintItems_)
+      {
+         if (static_cast<std::size_t>(item.startRow) < row)
+         {
+            head.push_back(item);
+            errorCount_ += item.type == LintTypeError;
+         }
+         else
+         {
+            tail.lintItems_.push_back(item);
+            tail.errorCount_ += item.type == LintTypeError;
+         }
+      }
+
+      lintItems_.swap(head);
+      return tail;
+   }
+
+   void shiftRows(int delta)
+   {
+      BOOST_FOREACH(LintItem& item, lintItems_)
+      {
+         item.startRow += delta;
+         item.endRow += delta;
+      }
+   }
+
+   void append(const LintItems& items)
+   {
+      lintItems_.insert(lintItems_.end(), items.begin(), items.end());
+      errorCount_ += items.errorCount_;
+   }
+
    typedef std::vector<LintItem>::iterator iterator;
    typedef std::vector<LintItem>::const_iterator const_iterator;
    
@@ -979,19 +1031,261 @@ private:
    PackageSymbols internalSymbols_; // <pkg>::<foo>
    PackageSymbols exportedSymbols_; // <pgk>:::<bar>
    
+   // symbols made available within particular ranges of the document;
+   // these are stored on the root node of each tree
    typedef std::map<Range, std::set<std::string> > SymbolRanges;
-   static SymbolRanges& symbolRanges()
+   SymbolRanges symbolRanges_;
+   
+   SymbolRanges& symbolRanges()
+   {
+      return getRoot()->symbolRanges_;
+   }
+   
+   const SymbolRanges& symbolRanges() const
+   {
+      return getRoot()->symbolRanges_;
+   }
+   
+   static Position shifted(const Position& position, int delta)
+   {
+      return Position(position.row + delta, position.column);
+   }
+   
+   static void splitSymbolPositions(SymbolPositions* pFrom,
+                                    SymbolPositions* pTo,
+                                    const Position& position)
+   {
+      SymbolPositions::iterator it = pFrom->begin();
+      while (it != pFrom->end())
+      {
+         Positions head;
+         BOOST_FOREACH(const Position& symbolPosition, it->second)
+         {
+            if (symbolPosition < position)
+               head.push_back(symbolPosition);
+            else
+               (*pTo)[it->first].push_back(symbolPosition);
+         }
+         
+         if (head.empty())
+         {
+            pFrom->erase(it++);
+         }
+         else
+         {
+            it->second.swap(head);
+            ++it;
+         }
+      }
+   }
+   
+   static void shiftSymbolPositions(SymbolPositions* pPositions, int delta)
+   {
+      for (SymbolPositions::iterator it = pPositions->begin();
+           it != pPositions->end();
+           ++it)
+      {
+         BOOST_FOREACH(Position& position, it->second)
+         {
+            position = shifted(position, delta);
+         }
+      }
+   }
+   
+   static void appendSymbolPositions(SymbolPositions* pTo,
+                                     const SymbolPositions& from)
+   {
+      for (SymbolPositions::const_iterator it = from.begin();
+           it != from.end();
+           ++it)
+      {
+         Positions& positions = (*pTo)[it->first];
+         positions.insert(positions.end(), it->second.begin(), it->second.end());
+      }
+   }
+   
+   static bool hasSymbolAtOrAfter(const SymbolPositions& symbols,
+                                  const std::string& name,
+                                  const Position& position)
+   {
+      SymbolPositions::const_iterator it = symbols.find(name);
+      if (it == symbols.end())
+         return false;
+      
+      BOOST_FOREACH(const Position& symbolPosition, it->second)
+      {
+         if (symbolPosition >= position)
+            return true;
+      }
+      
+      return false;
+   }
+   
+public:
+   
+   // Incremental parsing support. These operate on root nodes, where the
+   // top-level expressions of a document each contribute symbols and
+   // children starting at (or after) the position their expression starts.
+   
+   // Move everything recorded at or after 'position' into a new root node.
+   boost::shared_ptr<ParseNode> splitAt(const Position& position)
+   {
+      boost::shared_ptr<ParseNode> pTail = createRootNode();
+      
+      Children head;
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, children_)
+      {
+         if (pChild->position_ < position)
+         {
+            head.push_back(pChild);
+         }
+         else
+         {
+            pChild->pParent_ = pTail.get();
+            pTail->children_.push_back(pChild);
+         }
+      }
+      children_.swap(head);
+      
+      splitSymbolPositions(&definedSymbols_, &pTail->definedSymbols_, position);
+      splitSymbolPositions(&referencedSymbols_, &pTail->referencedSymbols_, position);
+      splitSymbolPositions(&nseReferencedSymbols_, &pTail->nseReferencedSymbols_, position);
+      
+      SymbolRanges::iterator it = symbolRanges_.begin();
+      while (it != symbolRanges_.end())
+      {
+         if (it->first.begin() >= position)
+         {
+            pTail->symbolRanges_.insert(*it);
+            symbolRanges_.erase(it++);
+         }
+         else
+         {
+            ++it;
+         }
+      }
+      
+      return pTail;
+   }
+   
+   // Move everything in this tree up or down by 'delta' rows.
+   void shiftRows(int delta)
    {
-      static SymbolRanges instance;
-      return instance;
+      if (pParent_)
+         position_ = shifted(position_, delta);
+      
+      shiftSymbolPositions(&definedSymbols_, delta);
+      shiftSymbolPositions(&referencedSymbols_, delta);
+      shiftSymbolPositions(&nseReferencedSymbols_, delta);
+      
+      SymbolRanges ranges;
+      for (SymbolRanges::const_iterator it = symbolRanges_.begin();
+           it != symbolRanges_.end();
+           ++it)
+      {
+         Range range(shifted(it->first.begin(), delta),
+                     shifted(it->first.end(), delta));
+         ranges[range] = it->second;
+      }
+      symbolRanges_.swap(ranges);
+      
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, children_)
+      {
+         pChild->shiftRows(delta);
+      }
+   }
+   
+   // Take ownership of the contents of another root node, which should
+   // describe a later part of the document than this node does.
+   void append(ParseNode* pOther)
+   {
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, pOther->children_)
+      {
+         pChild->pParent_ = this;
+         children_.push_back(pChild);
+      }
+      pOther->children_.clear();
+      
+      appendSymbolPositions(&definedSymbols_, pOther->definedSymbols_);
+      appendSymbolPositions(&referencedSymbols_, pOther->referencedSymbols_);
+      appendSymbolPositions(&nseReferencedSymbols_, pOther->nseReferencedSymbols_);
+      symbolRanges_.insert(pOther->symbolRanges_.begin(), pOther->symbolRanges_.end());
+   }
+   
+   // Collect the names of the symbols defined, and functions declared,
+   // in this scope within the range [begin, end).
+   void collectDefinedNames(const Position& begin,
+                            const Position& end,
+                            std::set<std::string>* pNames) const
+   {
+      for (SymbolPositions::const_iterator it = definedSymbols_.begin();
+           it != definedSymbols_.end();
+           ++it)
+      {
+         BOOST_FOREACH(const Position& position, it->second)
+         {
+            if (position >= begin && position < end)
+            {
+               pNames->insert(it->first);
+               break;
+            }
+         }
+      }
+      
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, children_)
+      {
+         if (pChild->position_ >= begin && pChild->position_ < end)
+            pNames->insert(pChild->name_);
+      }
+   }
+   
+   // Returns true if any of 'names' is defined or referenced at or after
+   // 'position', either in this scope or in any child scope.
+   bool usesAnyOf(const std::set<std::string>& names,
+                  const Position& position) const
+   {
+      BOOST_FOREACH(const std::string& name, names)
+      {
+         if (hasSymbolAtOrAfter(definedSymbols_, name, position) ||
+             hasSymbolAtOrAfter(referencedSymbols_, name, position) ||
+             hasSymbolAtOrAfter(nseReferencedSymbols_, name, position))
+         {
+            return true;
+         }
+      }
+      
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, children_)
+      {
+         if (pChild->position_ >= position &&
+             pChild->usesAnyOf(names, pChild->position_))
+            return true;
+      }
+      
+      return false;
    }
 };
 
+// A location where a top-level expression begins on a new line. At these
+// locations the parser holds no state other than the parse tree and lint
+// accumulated so far, and so parsing can be resumed from them.
+struct ParseCheckpoint
+{
+   ParseCheckpoint(std::size_t offset, std::size_t row, std::size_t column)
+      : offset(offset), row(row), column(column)
+   {}
+   
+   std::size_t offset;
+   std::size_t row;
+   std::size_t column;
+};
+
 class ParseStatus
 {
    
 public:
    
+   typedef boost::function<bool(const ParseCheckpoint&)> CheckpointHandler;
+   
    explicit ParseStatus(const FilePath& filePath, const ParseOptions& parseOptions)
       : pRoot_(ParseNode::createRootNode()),
         pNode_(pRoot_.get()),
@@ -1003,6 +1297,48 @@ public:
       functionNames_.push(std::wstring(L""));
    }
    
+   // resume parsing with the tree and lint produced for an earlier
+   // part of the document
+   ParseStatus(const FilePath& filePath,
+               const ParseOptions& parseOptions,
+               boost::shared_ptr<ParseNode> pRoot,
+               const LintItems& lint)
+      : pRoot_(pRoot),
+        pNode_(pRoot_.get()),
+        lint_(lint),
+        parseOptions_(parseOptions),
+        filePath_(filePath)
+   {
+      parseStateStack_.push(ParseStateTopLevel);
+      functionNames_.push(std::wstring(L""));
+   }
+   
+   // the handler is invoked at each checkpoint; parsing stops
+   // if it returns true
+   void setCheckpointHandler(const CheckpointHandler& handler)
+   {
+      checkpointHandler_ = handler;
+   }
+   
+   bool hasCheckpointHandler() const
+   {
+      return !checkpointHandler_.empty();
+   }
+   
+   bool onCheckpoint(const ParseCheckpoint& checkpoint)
+   {
+      return checkpointHandler_(checkpoint);
+   }
+   
+   bool isAtTopLevelScope() const
+   {
+      return parseStateStack_.size() == 1 &&
+             functionNames_.size() == 1 &&
+             nseCallStack_.empty() &&
+             bracketStack_.empty() &&
+             pNode_ == pRoot_.get();
+   }
+   
    ParseNode* node() { return pNode_; }
    LintItems& lint() { return lint_; }
    boost::shared_ptr<ParseNode> root() { return pRoot_; }
@@ -1391,6 +1727,8 @@ private:
    SymbolRanges symbolRanges_;
    
    FilePath filePath_;
+   
+   CheckpointHandler checkpointHandler_;
 };
 
 class ParseResults {
@@ -1449,6 +1787,51 @@ ParseResults parse(const std::string& rCode,
 ParseResults parse(const std::wstring& rCode,
                    const ParseOptions& parseOptions = ParseOptions());
 
+// Incremental parsing ----
+
+// The results of the last parse of a document, retained so that the
+// document can be re-parsed after an edit by visiting only the top-level
+// expressions affected by that edit.
+class IncrementalParseState
+{
+public:
+   
+   IncrementalParseState() {}
+   
+   // COPYING: copyable members
+   
+   bool empty() const { return !pRoot_; }
+   
+   void clear()
+   {
+      code_.clear();
+      pRoot_.reset();
+      lint_ = LintItems();
+      checkpoints_.clear();
+   }
+   
+private:
+   friend ParseResults parse(const core::FilePath&,
+                             const std::wstring&,
+                             const ParseOptions&,
+                             IncrementalParseState*);
+   
+   core::FilePath filePath_;
+   ParseOptions parseOptions_;
+   std::wstring code_;
+   boost::shared_ptr<ParseNode> pRoot_;
+   LintItems lint_;
+   std::vector<ParseCheckpoint> checkpoints_;
+};
+
+// Parse a document, re-using (and then updating) the results of its
+// previous parse. The returned parse tree is shared with 'pState', and
+// so is only valid until the document is next parsed.
+ParseResults parse(const core::FilePath& filePath,
+                   const std::wstring& rCode,
+                   const ParseOptions& parseOptions,
+                   IncrementalParseState* pState);
+
 } // namespace rparser
 } // namespace modules
 } // namespace session
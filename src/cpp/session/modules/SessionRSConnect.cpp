@@ -21,6 +21,7 @@
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/system/Environment.hpp>
 
 #include <r/RSexp.hpp>
 #include <r/RExec.hpp>
@@ -163,7 +164,25 @@ public:
                     ignoredFiles + "'") + 
              "))}";
 
-      pDeploy->start(cmd.c_str(), FilePath(), async_r::R_PROCESS_VANILLA);
+      // have rsconnect create the bundle with the system tar, which streams
+      // the files through gzip, rather than R's internal implementation
+      // (which reads each file into memory and is far slower for large
+      // applications); respect any implementation the user has chosen
+      core::system::Options environment;
+#ifndef _WIN32
+      if (core::system::getenv("RSCONNECT_TAR").empty())
+      {
+         FilePath tarPath = module_context::findProgram("tar");
+         if (!tarPath.empty())
+         {
+            environment.push_back(std::make_pair("RSCONNECT_TAR",
+                                                 tarPath.absolutePath()));
+         }
+      }
+#endif
+
+      pDeploy->start(cmd.c_str(), environment, FilePath(),
+                     async_r::R_PROCESS_VANILLA);
       *pDeployOut = pDeploy;
       return Success();
    }
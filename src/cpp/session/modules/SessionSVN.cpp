@@ -212,6 +212,19 @@ Error runSvn(const ShellArgs& args,
    return runSvn(args, workingDir, redirectStdErrToStdOut, pResult);
 }
 
+// runs svn via the process supervisor (for read-only commands which don't
+// require authentication, see runSvnAsync for those which may)
+Error svnExecAsync(const ShellArgs& args,
+                   const core::system::ProcessCallbacks& callbacks)
+{
+   core::system::ProcessOptions options = procOptions();
+   if (!s_workingDir.empty())
+      options.workingDir = s_workingDir;
+   return module_context::processSupervisor().runCommand(svn() << args.args(),
+                                                         options,
+                                                         callbacks);
+}
+
 Error runSvn(const ShellArgs& args,
              std::string* pStdOut=NULL,
              std::string* pStdErr=NULL,
@@ -299,10 +312,6 @@ core::Error createConsoleProc(const ShellArgs& args,
                             ppCP);
 }
 
-typedef boost::function<void(const core::Error&,
-                             const core::system::ProcessResult&)>
-                                                            ProcResultCallback;
-
 void onAsyncSvnExit(int exitCode,
                             const FilePath& outputFile,
                             ProcResultCallback completionCallback)
@@ -788,36 +797,30 @@ Error statusToJson(const core::FilePath &path,
    return Success();
 }
 
-Error status(const FilePath& filePath,
-             std::vector<source_control::FileWithStatus>* pFiles)
+ShellArgs statusArgs(const FilePath& filePath)
 {
-   using namespace source_control;
-
    ShellArgs args;
    args << "status" << globalArgs() << "--xml" << "--ignore-externals";
    if (!filePath.empty())
       args << "--" << filePath;
+   return args;
+}
 
-   std::string stdOut, stdErr;
-   int exitCode;
-   Error error = runSvn(
-         args,
-         &stdOut,
-         &stdErr,
-         &exitCode);
-   if (error)
-      return error;
+Error parseStatus(const core::system::ProcessResult& result,
+                  std::vector<source_control::FileWithStatus>* pFiles)
+{
+   using namespace source_control;
 
-   if (exitCode != EXIT_SUCCESS)
+   if (result.exitStatus != EXIT_SUCCESS)
    {
-      LOG_ERROR_MESSAGE(stdErr);
+      LOG_ERROR_MESSAGE(result.stdErr);
       return Success();
    }
 
    std::vector<char> xmlData;
    using namespace rapidxml;
    xml_document<> doc;
-   error = parseXml(stdOut, &xmlData, &doc);
+   Error error = parseXml(result.stdOut, &xmlData, &doc);
    if (error)
       return error;
 
@@ -892,17 +895,23 @@ Error status(const FilePath& filePath,
 }
 
 Error status(const FilePath& filePath,
-             json::Array* pResults)
+             std::vector<source_control::FileWithStatus>* pFiles)
 {
-   std::vector<source_control::FileWithStatus> files;
-   Error error = status(filePath, &files);
+   core::system::ProcessResult result;
+   Error error = runSvn(statusArgs(filePath), false, &result);
    if (error)
       return error;
 
+   return parseStatus(result, pFiles);
+}
+
+Error statusToJson(const std::vector<source_control::FileWithStatus>& files,
+                   json::Array* pResults)
+{
    BOOST_FOREACH(source_control::FileWithStatus file, files)
    {
       json::Object fileObj;
-      error = statusToJson(file.path, file.status, &fileObj);
+      Error error = statusToJson(file.path, file.status, &fileObj);
       if (error)
          return error;
       pResults->push_back(fileObj);
@@ -910,17 +919,46 @@ Error status(const FilePath& filePath,
    return Success();
 }
 
-Error svnStatus(const json::JsonRpcRequest& request,
-                json::JsonRpcResponse* pResponse)
+Error status(const FilePath& filePath,
+             json::Array* pResults)
 {
-   json::Array results;
-   Error error = status(FilePath(), &results);
+   std::vector<source_control::FileWithStatus> files;
+   Error error = status(filePath, &files);
    if (error)
       return error;
 
-   pResponse->setResult(results);
+   return statusToJson(files, pResults);
+}
 
-   return Success();
+void svnStatusEnd(const json::JsonRpcFunctionContinuation& cont,
+                  Error error,
+                  const core::system::ProcessResult& result)
+{
+   json::JsonRpcResponse response;
+
+   std::vector<source_control::FileWithStatus> files;
+   json::Array results;
+   if (!error)
+      error = parseStatus(result, &files);
+   if (!error)
+      error = statusToJson(files, &results);
+   if (error)
+   {
+      cont(error, &response);
+      return;
+   }
+
+   response.setResult(results);
+   cont(Success(), &response);
+}
+
+void svnStatus(const json::JsonRpcRequest& request,
+               const json::JsonRpcFunctionContinuation& cont)
+{
+   runAsync("svn_status",
+            "",
+            boost::bind(svnExecAsync, statusArgs(FilePath()), _1),
+            boost::bind(svnStatusEnd, cont, _1, _2));
 }
 
 Error svnUpdate(const json::JsonRpcRequest& request,
@@ -1015,42 +1053,25 @@ Error svnCommit(const json::JsonRpcRequest& request,
    return Success();
 }
 
-Error svnDiffFile(const json::JsonRpcRequest& request,
-                  json::JsonRpcResponse* pResponse)
+void svnDiffFileEnd(bool noSizeWarning,
+                    const json::JsonRpcFunctionContinuation& cont,
+                    Error error,
+                    const core::system::ProcessResult& result)
 {
-   std::string path;
-   int contextLines;
-   bool noSizeWarning;
-   Error error = json::readParams(request.params,
-                                  &path,
-                                  &contextLines,
-                                  &noSizeWarning);
    if (error)
-      return error;
-
-   FilePath filePath = resolveAliasedPath(path);
-
-   if (contextLines < 0)
-      contextLines = 999999999;
-
-   std::string extArgs = "-U " + safe_convert::numberToString(contextLines);
+   {
+      continueWithError(cont, error);
+      return;
+   }
 
-   std::string stdOut, stdErr;
-   int exitCode;
-   error = runSvn(ShellArgs() << "diff" <<
-                  "--depth" << "empty" <<
-                  "--diff-cmd" << "diff" <<
-                  "-x" << extArgs <<
-                  "--" << filePath,
-                  &stdOut, &stdErr, &exitCode);
-   if (error)
-      return error;
+   json::JsonRpcResponse response;
 
-   if (exitCode != EXIT_SUCCESS)
+   if (result.exitStatus != EXIT_SUCCESS)
    {
-      LOG_ERROR_MESSAGE(stdErr);
+      LOG_ERROR_MESSAGE(result.stdErr);
    }
 
+   std::string stdOut = result.stdOut;
    std::string sourceEncoding = projects::projectContext().defaultEncoding();
    bool usedSourceEncoding;
    stdOut = convertDiff(stdOut, sourceEncoding, "UTF-8", false,
@@ -1062,18 +1083,54 @@ Error svnDiffFile(const json::JsonRpcRequest& request,
    {
       error = systemError(boost::system::errc::file_too_large,
                           ERROR_LOCATION);
-      pResponse->setError(error,
-                          json::Value(static_cast<boost::uint64_t>(stdOut.size())));
+      response.setError(error,
+                        json::Value(static_cast<boost::uint64_t>(stdOut.size())));
    }
    else
    {
-      json::Object result;
-      result["source_encoding"] = sourceEncoding;
-      result["decoded_value"] = stdOut;
-      pResponse->setResult(result);
+      json::Object resultObj;
+      resultObj["source_encoding"] = sourceEncoding;
+      resultObj["decoded_value"] = stdOut;
+      response.setResult(resultObj);
    }
 
-   return Success();
+   cont(Success(), &response);
+}
+
+void svnDiffFile(const json::JsonRpcRequest& request,
+                 const json::JsonRpcFunctionContinuation& cont)
+{
+   std::string path;
+   int contextLines;
+   bool noSizeWarning;
+   Error error = json::readParams(request.params,
+                                  &path,
+                                  &contextLines,
+                                  &noSizeWarning);
+   if (error)
+   {
+      json::JsonRpcResponse response;
+      cont(error, &response);
+      return;
+   }
+
+   FilePath filePath = resolveAliasedPath(path);
+
+   if (contextLines < 0)
+      contextLines = 999999999;
+
+   std::string extArgs = "-U " + safe_convert::numberToString(contextLines);
+
+   ShellArgs args = ShellArgs() << "diff" <<
+                    "--depth" << "empty" <<
+                    "--diff-cmd" << "diff" <<
+                    "-x" << extArgs <<
+                    "--" << filePath;
+   runAsync("svn_diff_file",
+            json::write(request.params),
+            boost::bind(svnExecAsync, args, _1),
+            boost::bind(svnDiffFileEnd, noSizeWarning, cont, _1, _2),
+            noSizeWarning ? 0 : source_control::WARN_SIZE);
 }
 
 Error svnApplyPatch(const json::JsonRpcRequest& request,
@@ -1817,11 +1874,11 @@ Error initialize()
       (bind(registerRpcMethod, "svn_delete", svnDelete))
       (bind(registerRpcMethod, "svn_revert", svnRevert))
       (bind(registerRpcMethod, "svn_resolve", svnResolve))
-      (bind(registerRpcMethod, "svn_status", svnStatus))
+      (bind(registerAsyncRpcMethod, "svn_status", svnStatus))
       (bind(registerRpcMethod, "svn_update", svnUpdate))
       (bind(registerRpcMethod, "svn_cleanup", svnCleanup))
       (bind(registerRpcMethod, "svn_commit", svnCommit))
-      (bind(registerRpcMethod, "svn_diff_file", svnDiffFile))
+      (bind(registerAsyncRpcMethod, "svn_diff_file", svnDiffFile))
       (bind(registerRpcMethod, "svn_apply_patch", svnApplyPatch))
       (bind(registerAsyncRpcMethod, "svn_history_count", svnHistoryCount))
       (bind(registerAsyncRpcMethod, "svn_history", svnHistory))
@@ -18,6 +18,8 @@
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
+#include <core/SafeConvert.hpp>
 #include <core/json/Json.hpp>
 
 #include <boost/bind.hpp>
@@ -36,8 +38,29 @@ namespace {
 
 FilePath s_snippetsMonitoredDir;
 
+// the snippets as last read from the snippets dir. the files are only read
+// again when one of them has been added, removed or modified (per the
+// listing signature) and the version (a hash of the contents) is used to
+// avoid notifying the client of sets it already has
+struct SnippetsCache
+{
+   SnippetsCache() : valid(false) {}
+
+   bool valid;
+   std::string signature;
+   std::string version;
+   json::Array snippets;
+};
+SnippetsCache s_snippetsCache;
+
+// the version of the snippets last sent to the client
+std::string s_clientSnippetsVersion;
+
 void notifySnippetsChanged()
 {
+   // the files may have changed within the resolution of their timestamps
+   s_snippetsCache.valid = false;
+
    Error error = core::writeStringToFile(
           s_snippetsMonitoredDir.childPath("changed"),
           core::system::generateUuid());
@@ -106,26 +129,58 @@ bool isSnippetFilePath(const FilePath& filePath,
    return true;
 }
 
-Error getSnippetsAsJson(json::Array* pJsonData)
+Error listSnippetFiles(std::vector<FilePath>* pSnippetPaths,
+                       std::string* pSignature)
 {
    FilePath snippetsDir = getSnippetsDir();
    if (!snippetsDir.exists() || !snippetsDir.isDirectory())
       return Success();
-   
-   // Get the contents of each file here, and pass that info back up
-   // to the client
-   std::vector<FilePath> snippetPaths;
-   Error error = snippetsDir.children(&snippetPaths);
+
+   std::vector<FilePath> children;
+   Error error = snippetsDir.children(&children);
    if (error)
       return error;
-   
-   BOOST_FOREACH(const FilePath& filePath, snippetPaths)
+
+   BOOST_FOREACH(const FilePath& filePath, children)
    {
-      // bail if this doesn't appear to be a snippets file
+      // skip anything that doesn't appear to be a snippets file
       std::string mode;
       if (!isSnippetFilePath(filePath, &mode))
          continue;
-      
+
+      pSnippetPaths->push_back(filePath);
+      pSignature->append(filePath.filename() + ":" +
+                         safe_convert::numberToString(filePath.lastWriteTime()) +
+                         ":" +
+                         safe_convert::numberToString(filePath.size()) + "\n");
+   }
+   return Success();
+}
+
+Error getSnippetsAsJson(json::Array* pJsonData)
+{
+   std::vector<FilePath> snippetPaths;
+   std::string signature;
+   Error error = listSnippetFiles(&snippetPaths, &signature);
+   if (error)
+      return error;
+
+   // nothing has changed since the snippets were last read
+   if (s_snippetsCache.valid && s_snippetsCache.signature == signature)
+   {
+      *pJsonData = s_snippetsCache.snippets;
+      return Success();
+   }
+
+   // Get the contents of each file here, and pass that info back up
+   // to the client
+   json::Array snippetsJson;
+   std::string allContents;
+   BOOST_FOREACH(const FilePath& filePath, snippetPaths)
+   {
+      std::string mode;
+      isSnippetFilePath(filePath, &mode);
+
       std::string contents;
       error = readStringFromFile(filePath, &contents);
       if (error)
@@ -134,12 +189,21 @@ Error getSnippetsAsJson(json::Array* pJsonData)
       json::Object snippetJson;
       snippetJson["mode"] = mode;
       snippetJson["contents"] = contents;
-      pJsonData->push_back(snippetJson);
+      snippetsJson.push_back(snippetJson);
+
+      allContents.append(mode + "\n" + contents + "\n");
    }
+
+   s_snippetsCache.valid = true;
+   s_snippetsCache.signature = signature;
+   s_snippetsCache.version = hash::crc32HexHash(allContents);
+   s_snippetsCache.snippets = snippetsJson;
+
+   *pJsonData = snippetsJson;
    return Success();
 }
 
-void checkAndNotifyClientIfSnippetsAvailable()
+void checkAndNotifyClientIfSnippetsAvailable(bool onlyIfChanged)
 {
    json::Array jsonData;
 
@@ -150,13 +214,19 @@ void checkAndNotifyClientIfSnippetsAvailable()
       LOG_ERROR(error);
       return;
    }
+
+   // the client already has this version of the snippets
+   if (onlyIfChanged && s_snippetsCache.version == s_clientSnippetsVersion)
+      return;
    
-   // if we got some, send them to the client
-   if (!jsonData.empty())
+   // if we got some (or they were all removed), send them to the client
+   if (!jsonData.empty() || !s_clientSnippetsVersion.empty())
    {
       ClientEvent event(client_events::kSnippetsChanged, jsonData);
       module_context::enqueClientEvent(event);
    }
+   s_clientSnippetsVersion = jsonData.empty() ? std::string() :
+                                                s_snippetsCache.version;
 }
 
 void onDocUpdated(boost::shared_ptr<source_database::SourceDocument> pDoc)
@@ -178,12 +248,14 @@ void onDocUpdated(boost::shared_ptr<source_database::SourceDocument> pDoc)
 
 void onClientInit()
 {
-   checkAndNotifyClientIfSnippetsAvailable();
+   // a new client has none of the snippets
+   s_clientSnippetsVersion.clear();
+   checkAndNotifyClientIfSnippetsAvailable(false);
 }
 
 void onSnippetsChanged()
 {
-   checkAndNotifyClientIfSnippetsAvailable();
+   checkAndNotifyClientIfSnippetsAvailable(true);
 }
 
 void afterSessionInitHook(bool newSession)
@@ -227,13 +227,17 @@ Error openDocument(const json::JsonRpcRequest& request,
    return Success();
 } 
 
-Error saveDocumentCore(const std::string& contents,
+// NOTE: the contents are moved into the document (pContents is left with
+// the document's previous contents)
+Error saveDocumentCore(std::string* pContents,
                        const json::Value& jsonPath,
                        const json::Value& jsonType,
                        const json::Value& jsonEncoding,
                        const json::Value& jsonFoldSpec,
                        boost::shared_ptr<SourceDocument> pDoc)
 {
+   const std::string& contents = *pContents;
+
    // check whether we have a path and if we do get/resolve its value
    std::string path;
    FilePath fullDocPath;
@@ -328,7 +332,7 @@ Error saveDocumentCore(const std::string& contents,
    }
 
    // always update the contents so it holds the original UTF-8 data
-   pDoc->setContents(contents);
+   pDoc->swapContents(pContents);
 
    return Success();
 }
@@ -356,7 +360,7 @@ Error saveDocument(const json::JsonRpcRequest& request,
    if (error)
       return error ;
    
-   error = saveDocumentCore(contents, jsonPath, jsonType, jsonEncoding,
+   error = saveDocumentCore(&contents, jsonPath, jsonType, jsonEncoding,
                             jsonFoldSpec, pDoc);
    if (error)
       return error;
@@ -433,10 +437,11 @@ Error saveDocumentDiff(const json::JsonRpcRequest& request,
       if (error)
          return Success(); // UTF8 decoding failed. Abort differential save.
 
-      contents.erase(rangeBegin, rangeEnd);
-      contents.insert(rangeBegin, replacement.begin(), replacement.end());
+      // splice the replacement in place
+      contents.replace(rangeBegin, rangeEnd,
+                       replacement.begin(), replacement.end());
       
-      error = saveDocumentCore(contents, jsonPath, jsonType, jsonEncoding,
+      error = saveDocumentCore(&contents, jsonPath, jsonType, jsonEncoding,
                                jsonFoldSpec, pDoc);
       if (error)
          return error;
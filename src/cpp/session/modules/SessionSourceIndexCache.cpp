@@ -0,0 +1,345 @@
+/*
+ * SessionSourceIndexCache.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "SessionSourceIndexCache.hpp"
+
+#include <boost/foreach.hpp>
+
+#include <core/Error.hpp>
+#include <core/FileInfo.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/json/Json.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+namespace {
+
+// increment when the format (or the indexing rules) change
+const int kCacheVersion = 1;
+
+json::Array itemAsJson(const r_util::RSourceItem& item)
+{
+   json::Array signatureJson;
+   BOOST_FOREACH(const r_util::RS4MethodParam& param, item.signature())
+   {
+      json::Array paramJson;
+      paramJson.push_back(param.name());
+      paramJson.push_back(param.type());
+      signatureJson.push_back(paramJson);
+   }
+
+   json::Array itemJson;
+   itemJson.push_back(item.type());
+   itemJson.push_back(item.name());
+   itemJson.push_back(item.braceLevel());
+   itemJson.push_back(item.line());
+   itemJson.push_back(item.column());
+   itemJson.push_back(signatureJson);
+   return itemJson;
+}
+
+bool itemFromJson(const json::Value& value, r_util::RSourceItem* pItem)
+{
+   if (!json::isType<json::Array>(value))
+      return false;
+
+   const json::Array& itemJson = value.get_array();
+   if (itemJson.size() != 6 ||
+       !json::isType<int>(itemJson[0]) ||
+       !json::isType<std::string>(itemJson[1]) ||
+       !json::isType<int>(itemJson[2]) ||
+       !json::isType<int>(itemJson[3]) ||
+       !json::isType<int>(itemJson[4]) ||
+       !json::isType<json::Array>(itemJson[5]))
+   {
+      return false;
+   }
+
+   std::vector<r_util::RS4MethodParam> signature;
+   BOOST_FOREACH(const json::Value& paramJson, itemJson[5].get_array())
+   {
+      if (!json::isType<json::Array>(paramJson) ||
+          paramJson.get_array().size() != 2 ||
+          !json::isType<std::string>(paramJson.get_array()[0]) ||
+          !json::isType<std::string>(paramJson.get_array()[1]))
+      {
+         return false;
+      }
+      signature.push_back(r_util::RS4MethodParam(
+                                 paramJson.get_array()[0].get_str(),
+                                 paramJson.get_array()[1].get_str()));
+   }
+
+   *pItem = r_util::RSourceItem(itemJson[0].get_int(),
+                                itemJson[1].get_str(),
+                                signature,
+                                itemJson[2].get_int(),
+                                itemJson[3].get_int(),
+                                itemJson[4].get_int());
+   return true;
+}
+
+} // anonymous namespace
+
+void SourceIndexCache::setCacheFile(const FilePath& cacheFile,
+                                    const std::string& encoding)
+{
+   if (cacheFile == cacheFile_ && encoding == encoding_)
+      return;
+
+   close();
+   cacheFile_ = cacheFile;
+   encoding_ = encoding;
+}
+
+boost::shared_ptr<r_util::RSourceIndex> SourceIndexCache::lookup(
+                                             const FileInfo& fileInfo,
+                                             const std::string& context)
+{
+   if (!loaded_)
+      load();
+
+   std::map<std::string, CachedIndex>::iterator it =
+                                    entries_.find(fileInfo.absolutePath());
+   if (it == entries_.end() ||
+       fileInfo.lastWriteTime() == 0 ||
+       it->second.lastWriteTime != fileInfo.lastWriteTime() ||
+       it->second.size != fileInfo.size())
+   {
+      return boost::shared_ptr<r_util::RSourceIndex>();
+   }
+
+   it->second.used = true;
+   return boost::shared_ptr<r_util::RSourceIndex>(
+            new r_util::RSourceIndex(context,
+                                     it->second.items,
+                                     it->second.inferredPackages));
+}
+
+void SourceIndexCache::update(const FileInfo& fileInfo,
+                              const r_util::RSourceIndex& index)
+{
+   if (cacheFile_.empty() || fileInfo.lastWriteTime() == 0)
+      return;
+
+   if (!loaded_)
+      load();
+
+   CachedIndex& cached = entries_[fileInfo.absolutePath()];
+   cached.lastWriteTime = fileInfo.lastWriteTime();
+   cached.size = fileInfo.size();
+   cached.items = index.items();
+   cached.inferredPackages = index.getInferredPackages();
+   cached.used = true;
+   dirty_ = true;
+}
+
+void SourceIndexCache::remove(const FileInfo& fileInfo)
+{
+   if (entries_.erase(fileInfo.absolutePath()) > 0)
+      dirty_ = true;
+}
+
+std::vector<std::string> SourceIndexCache::cachedPaths()
+{
+   if (!loaded_)
+      load();
+
+   std::vector<std::string> paths;
+   paths.reserve(entries_.size());
+   typedef std::map<std::string, CachedIndex>::value_type Entry;
+   BOOST_FOREACH(const Entry& entry, entries_)
+   {
+      paths.push_back(entry.first);
+   }
+   return paths;
+}
+
+Error SourceIndexCache::save(bool prune)
+{
+   if (cacheFile_.empty() || !loaded_)
+      return Success();
+
+   if (prune)
+   {
+      std::map<std::string, CachedIndex>::iterator it = entries_.begin();
+      while (it != entries_.end())
+      {
+         if (!it->second.used)
+         {
+            entries_.erase(it++);
+            dirty_ = true;
+         }
+         else
+         {
+            ++it;
+         }
+      }
+   }
+
+   if (!dirty_)
+      return Success();
+
+   json::Object filesJson;
+   typedef std::map<std::string, CachedIndex>::value_type Entry;
+   BOOST_FOREACH(const Entry& entry, entries_)
+   {
+      json::Array itemsJson;
+      BOOST_FOREACH(const r_util::RSourceItem& item, entry.second.items)
+      {
+         itemsJson.push_back(itemAsJson(item));
+      }
+
+      json::Array packagesJson;
+      BOOST_FOREACH(const std::string& package, entry.second.inferredPackages)
+      {
+         packagesJson.push_back(package);
+      }
+
+      json::Object fileJson;
+      fileJson["mtime"] = static_cast<boost::int64_t>(entry.second.lastWriteTime);
+      fileJson["size"] = static_cast<boost::int64_t>(entry.second.size);
+      fileJson["items"] = itemsJson;
+      fileJson["packages"] = packagesJson;
+      filesJson[entry.first] = fileJson;
+   }
+
+   json::Object cacheJson;
+   cacheJson["version"] = kCacheVersion;
+   cacheJson["encoding"] = encoding_;
+   cacheJson["files"] = filesJson;
+
+   Error error = writeStringToFile(cacheFile_, json::write(cacheJson));
+   if (error)
+      return error;
+
+   dirty_ = false;
+   return Success();
+}
+
+void SourceIndexCache::close()
+{
+   Error error = save(false);
+   if (error)
+      LOG_ERROR(error);
+
+   entries_.clear();
+   loaded_ = false;
+   dirty_ = false;
+}
+
+void SourceIndexCache::load()
+{
+   loaded_ = true;
+   entries_.clear();
+
+   if (cacheFile_.empty() || !cacheFile_.exists())
+      return;
+
+   std::string contents;
+   Error error = readStringFromFile(cacheFile_, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // a cache we can't use is simply discarded (and replaced on save)
+   json::Value cacheJson;
+   if (!json::parse(contents, &cacheJson) ||
+       !json::isType<json::Object>(cacheJson))
+   {
+      return;
+   }
+
+   const json::Object& cacheObject = cacheJson.get_obj();
+   json::Object::const_iterator version = cacheObject.find("version");
+   json::Object::const_iterator encoding = cacheObject.find("encoding");
+   json::Object::const_iterator files = cacheObject.find("files");
+   if (version == cacheObject.end() ||
+       !json::isType<int>(version->second) ||
+       version->second.get_int() != kCacheVersion ||
+       encoding == cacheObject.end() ||
+       !json::isType<std::string>(encoding->second) ||
+       encoding->second.get_str() != encoding_ ||
+       files == cacheObject.end() ||
+       !json::isType<json::Object>(files->second))
+   {
+      return;
+   }
+
+   BOOST_FOREACH(const json::Member& member, files->second.get_obj())
+   {
+      if (!json::isType<json::Object>(member.second))
+         continue;
+
+      const json::Object& fileJson = member.second.get_obj();
+      json::Object::const_iterator mtime = fileJson.find("mtime");
+      json::Object::const_iterator size = fileJson.find("size");
+      json::Object::const_iterator items = fileJson.find("items");
+      json::Object::const_iterator packages = fileJson.find("packages");
+      if (mtime == fileJson.end() ||
+          !json::isType<int>(mtime->second) ||
+          size == fileJson.end() ||
+          !json::isType<int>(size->second) ||
+          items == fileJson.end() ||
+          !json::isType<json::Array>(items->second) ||
+          packages == fileJson.end() ||
+          !json::isType<json::Array>(packages->second))
+      {
+         continue;
+      }
+
+      CachedIndex cached;
+      cached.lastWriteTime = mtime->second.get_int64();
+      cached.size = size->second.get_int64();
+
+      bool valid = true;
+      BOOST_FOREACH(const json::Value& itemJson, items->second.get_array())
+      {
+         r_util::RSourceItem item;
+         if (!itemFromJson(itemJson, &item))
+         {
+            valid = false;
+            break;
+         }
+         cached.items.push_back(item);
+      }
+
+      BOOST_FOREACH(const json::Value& packageJson, packages->second.get_array())
+      {
+         if (!json::isType<std::string>(packageJson))
+         {
+            valid = false;
+            break;
+         }
+         cached.inferredPackages.push_back(packageJson.get_str());
+      }
+
+      if (valid)
+         entries_[member.first] = cached;
+   }
+}
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
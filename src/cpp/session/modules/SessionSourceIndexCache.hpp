@@ -0,0 +1,106 @@
+/*
+ * SessionSourceIndexCache.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_SOURCE_INDEX_CACHE_HPP
+#define SESSION_SOURCE_INDEX_CACHE_HPP
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/r_util/RSourceIndex.hpp>
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FileInfo;
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace code_search {
+
+// Cache of the source indexes for a project's files (saved in the
+// project's scratch directory) so that files which haven't changed since
+// the last session don't need to be tokenized again. Entries are keyed by
+// path and are valid only if the file's size and modification time match.
+class SourceIndexCache : boost::noncopyable
+{
+public:
+   SourceIndexCache() : loaded_(false), dirty_(false) {}
+
+   // COPYING: boost::noncopyable
+
+   // set the file the cache is stored in (the cache is loaded lazily on
+   // first lookup). encoding is the project's encoding (the cache is
+   // discarded if it was created with a different encoding)
+   void setCacheFile(const core::FilePath& cacheFile,
+                     const std::string& encoding);
+
+   // get the index for a file (returns a null pointer if there is no
+   // cached index or the file has changed)
+   boost::shared_ptr<core::r_util::RSourceIndex> lookup(
+                                       const core::FileInfo& fileInfo,
+                                       const std::string& context);
+
+   void update(const core::FileInfo& fileInfo,
+               const core::r_util::RSourceIndex& index);
+
+   void remove(const core::FileInfo& fileInfo);
+
+   // the paths of the files with cached indexes
+   std::vector<std::string> cachedPaths();
+
+   // save the cache if it has changed. when prune is true then entries
+   // which weren't used by this session (e.g. for files which have since
+   // been removed) are discarded
+   core::Error save(bool prune);
+
+   // save and then reset the cache
+   void close();
+
+private:
+   void load();
+
+   struct CachedIndex
+   {
+      CachedIndex() : lastWriteTime(0), size(0), used(false) {}
+      std::time_t lastWriteTime;
+      uintmax_t size;
+      std::vector<core::r_util::RSourceItem> items;
+      std::vector<std::string> inferredPackages;
+      bool used;
+   };
+
+   core::FilePath cacheFile_;
+   std::string encoding_;
+   bool loaded_;
+   bool dirty_;
+   std::map<std::string, CachedIndex> entries_;
+};
+
+} // namespace code_search
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_SOURCE_INDEX_CACHE_HPP
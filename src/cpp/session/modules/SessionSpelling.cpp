@@ -17,6 +17,7 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <core/DateTime.hpp>
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
 
@@ -42,19 +43,48 @@ namespace {
 // underlying spelling engine
 boost::scoped_ptr<core::spelling::SpellingEngine> s_pSpellingEngine;
 
-// R function for testing & debugging
-SEXP rs_checkSpelling(SEXP wordSEXP)
+// dictionaries are freed once spelling has gone unused for this long (they
+// are large, and most sessions only check spelling occasionally)
+const double kReleaseDictionariesMs = 15 * 60 * 1000;
+
+// time the spelling engine was last used (0 if it hasn't been used since
+// the dictionaries were last released)
+double s_lastSpellingUse = 0;
+
+core::spelling::SpellingEngine& spellingEngine()
+{
+   s_lastSpellingUse = date_time::millisecondsSinceEpoch();
+   return *s_pSpellingEngine;
+}
+
+bool releaseUnusedDictionaries()
 {
-   bool isCorrect;
-   std::string word = r::sexp::asString(wordSEXP);
+   if (s_lastSpellingUse > 0 &&
+       date_time::millisecondsSinceEpoch() - s_lastSpellingUse >
+                                                   kReleaseDictionariesMs)
+   {
+      s_pSpellingEngine->releaseDictionaries();
+      s_lastSpellingUse = 0;
+   }
 
-   Error error = s_pSpellingEngine->checkSpelling(word, &isCorrect);
+   // keep checking
+   return true;
+}
+
+// R function for testing & debugging (accepts a vector of words)
+SEXP rs_checkSpelling(SEXP wordsSEXP)
+{
+   std::vector<std::string> words;
+   r::sexp::fillVectorString(wordsSEXP, &words);
+
+   std::vector<bool> isCorrect;
+   Error error = spellingEngine().checkSpelling(words, &isCorrect);
 
    // We'll return true here so as not to tie up the front end.
    if (error)
    {
       LOG_ERROR(error);
-      isCorrect = true;
+      isCorrect.assign(words.size(), true);
    }
 
    r::sexp::Protect rProtect;
@@ -105,7 +135,11 @@ Error checkSpelling(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
-   json::Array misspelledIndexes;
+   // check the words as a batch (keeping track of their original indexes)
+   std::vector<std::string> wordsToCheck;
+   std::vector<int> wordIndexes;
+   wordsToCheck.reserve(words.size());
+   wordIndexes.reserve(words.size());
    for (std::size_t i=0; i<words.size(); i++)
    {
       if (!json::isType<std::string>(words[i]))
@@ -114,14 +148,20 @@ Error checkSpelling(const json::JsonRpcRequest& request,
          continue;
       }
 
-      std::string word = words[i].get_str();
-      bool isCorrect = true;
-      error = s_pSpellingEngine->checkSpelling(word, &isCorrect);
-      if (error)
-         return error;
+      wordsToCheck.push_back(words[i].get_str());
+      wordIndexes.push_back(static_cast<int>(i));
+   }
 
-      if (!isCorrect)
-         misspelledIndexes.push_back(static_cast<int>(i));
+   std::vector<bool> isCorrect;
+   error = spellingEngine().checkSpelling(wordsToCheck, &isCorrect);
+   if (error)
+      return error;
+
+   json::Array misspelledIndexes;
+   for (std::size_t i=0; i<isCorrect.size(); i++)
+   {
+      if (!isCorrect[i])
+         misspelledIndexes.push_back(wordIndexes[i]);
    }
 
    pResponse->setResult(misspelledIndexes);
@@ -138,7 +178,7 @@ Error suggestionList(const json::JsonRpcRequest& request,
       return error;
 
    std::vector<std::string> sugs;
-   error = s_pSpellingEngine->suggestionList(word, &sugs);
+   error = spellingEngine().suggestionList(word, &sugs);
    if (error)
       return error;
 
@@ -156,7 +196,7 @@ Error getWordChars(const json::JsonRpcRequest& request,
                    json::JsonRpcResponse* pResponse)
 {
    std::wstring wordChars;
-   Error error = s_pSpellingEngine->wordChars(&wordChars);
+   Error error = spellingEngine().wordChars(&wordChars);
    if (error)
       return error;
 
@@ -310,6 +350,13 @@ Error initialize()
    // connect to user settings changed
    userSettings().onChanged.connect(onUserSettingsChanged);
 
+   // free dictionaries which are no longer being used
+   module_context::schedulePeriodicWork(boost::posix_time::minutes(1),
+                                        releaseUnusedDictionaries,
+                                        true,
+                                        false,
+                                        module_context::WorkPriorityLow);
+
    // register rpc methods
    using boost::bind;
    using namespace module_context;
@@ -19,10 +19,15 @@
 
 #include "SessionUserCommands.hpp"
 
+#include <map>
+
 #include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
+#include <core/FilePath.hpp>
+#include <core/SafeConvert.hpp>
 
 #include <r/RExec.hpp>
 #include <r/RSexp.hpp>
@@ -39,6 +44,55 @@ using namespace rstudio::core;
 
 namespace {
 
+// the shortcuts of each registered user command. these are replayed to new
+// clients (the commands are only sourced at deferred init) and a command
+// re-registered with the same shortcuts isn't sent again
+std::map<std::string, std::vector<std::string> > s_userCommands;
+
+// signature of the user command files as they were last loaded (empty if
+// they haven't been loaded yet)
+std::string s_loadedSignature;
+
+FilePath userCommandsDir()
+{
+   return module_context::resolveAliasedPath("~/.R/keybindings/R");
+}
+
+std::string userCommandFilesSignature()
+{
+   FilePath commandsDir = userCommandsDir();
+   if (!commandsDir.exists() || !commandsDir.isDirectory())
+      return "none";
+
+   std::vector<FilePath> children;
+   Error error = commandsDir.children(&children);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return std::string();
+   }
+
+   std::string signature = "files";
+   BOOST_FOREACH(const FilePath& filePath, children)
+   {
+      signature.append("\n" + filePath.filename() + ":" +
+                       safe_convert::numberToString(filePath.lastWriteTime()) +
+                       ":" + safe_convert::numberToString(filePath.size()));
+   }
+   return signature;
+}
+
+void enqueRegisterUserCommand(const std::string& name,
+                              const std::vector<std::string>& shortcuts)
+{
+   json::Object jsonData;
+   jsonData["name"] = name;
+   jsonData["shortcuts"] = json::toJsonArray(shortcuts);
+   
+   ClientEvent event(client_events::kRegisterUserCommand, jsonData);
+   module_context::enqueClientEvent(event);
+}
+
 Error noSuchSymbol(const std::string symbol, const ErrorLocation& location)
 {
    Error error(r::errc::SymbolNotFoundError, location);
@@ -94,24 +148,50 @@ SEXP rs_registerUserCommand(SEXP nameSEXP, SEXP shortcutsSEXP)
    if (!r::sexp::fillVectorString(shortcutsSEXP, &shortcuts))
       return R_NilValue;
    
-   json::Object jsonData;
-   jsonData["name"] = name;
-   jsonData["shortcuts"] = json::toJsonArray(shortcuts);
-   
-   ClientEvent event(client_events::kRegisterUserCommand, jsonData);
-   module_context::enqueClientEvent(event);
+   std::map<std::string, std::vector<std::string> >::const_iterator it =
+                                                   s_userCommands.find(name);
+   if (it != s_userCommands.end() && it->second == shortcuts)
+      return R_NilValue;
+
+   s_userCommands[name] = shortcuts;
+   enqueRegisterUserCommand(name, shortcuts);
    
    return R_NilValue;
 }
 
-void onDeferredInit(bool newSession)
+void loadUserCommands()
 {
+   s_loadedSignature = userCommandFilesSignature();
+
    r::exec::RFunction loadUserCommands(".rs.loadUserCommands");
    Error error = loadUserCommands.call();
    if (error)
       LOG_ERROR(error);
 }
 
+void onDeferredInit(bool newSession)
+{
+   loadUserCommands();
+}
+
+void onClientInit()
+{
+   // commands haven't been loaded yet (they will be at deferred init)
+   if (s_loadedSignature.empty())
+      return;
+
+   // the new client has none of the commands
+   typedef std::pair<const std::string, std::vector<std::string> > Command;
+   BOOST_FOREACH(const Command& command, s_userCommands)
+   {
+      enqueRegisterUserCommand(command.first, command.second);
+   }
+
+   // pick up command files added or edited since they were loaded
+   if (userCommandFilesSignature() != s_loadedSignature)
+      loadUserCommands();
+}
+
 } // anonymous namespace
 
 Error initialize()
@@ -120,6 +200,7 @@ Error initialize()
    using namespace module_context;
    
    events().onDeferredInit.connect(onDeferredInit);
+   events().onClientInit.connect(onClientInit);
    
    RS_REGISTER_CALL_METHOD(rs_registerUserCommand, 2);
    
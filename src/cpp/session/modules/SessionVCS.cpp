@@ -200,6 +200,11 @@ void enqueueRefreshEvent()
    vcs_utils::enqueueRefreshEvent();
 }
 
+void invalidateStatusCache()
+{
+   git::invalidateStatusCache();
+}
+
 
 
 core::Error initialize()
@@ -53,6 +53,9 @@ core::FilePath defaultSshKeyDir();
 
 void enqueueRefreshEvent();
 
+// discard any cached status (e.g. because files have changed)
+void invalidateStatusCache();
+
 core::Error fileStatus(const core::FilePath& filePath,
                        source_control::VCSStatus* pStatus);
 
@@ -180,6 +180,30 @@ Error setClientState(const json::JsonRpcRequest& request,
 }
    
      
+// graphics size changes arrive in bursts while a pane is being resized and
+// each one replays the display list, so we coalesce them: only the latest
+// metrics are applied, once no newer ones have arrived for a short while
+// (the client keeps showing the previous plot image, scaled, meanwhile)
+const int kGraphicsResizeDelayMs = 250;
+r::session::RClientMetrics s_appliedMetrics;
+r::session::RClientMetrics s_pendingMetrics;
+int s_pendingMetricsGeneration = 0;
+
+void applyClientMetrics(const r::session::RClientMetrics& metrics)
+{
+   s_appliedMetrics = metrics;
+   r::session::setClientMetrics(metrics);
+}
+
+void applyPendingClientMetrics(int generation)
+{
+   // bail if these metrics have been superseded
+   if (generation != s_pendingMetricsGeneration)
+      return;
+
+   applyClientMetrics(s_pendingMetrics);
+}
+
 // IN: WorkbenchMetrics object
 // OUT: Void
 Error setWorkbenchMetrics(const json::JsonRpcRequest& request, 
@@ -195,8 +219,27 @@ Error setWorkbenchMetrics(const json::JsonRpcRequest& request,
    if (error)
       return error;
    
-   // set the metrics
-   r::session::setClientMetrics(metrics);
+   // any pending metrics are superseded by these
+   s_pendingMetricsGeneration++;
+
+   // apply the metrics (delayed if the graphics size changed)
+   bool graphicsChanged =
+         metrics.graphicsWidth != s_appliedMetrics.graphicsWidth ||
+         metrics.graphicsHeight != s_appliedMetrics.graphicsHeight ||
+         metrics.devicePixelRatio != s_appliedMetrics.devicePixelRatio;
+   if (graphicsChanged)
+   {
+      s_pendingMetrics = metrics;
+      module_context::scheduleDelayedWork(
+               boost::posix_time::milliseconds(kGraphicsResizeDelayMs),
+               boost::bind(applyPendingClientMetrics,
+                           s_pendingMetricsGeneration),
+               false);
+   }
+   else
+   {
+      applyClientMetrics(metrics);
+   }
    
    return Success();
 }
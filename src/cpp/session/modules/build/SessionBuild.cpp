@@ -16,6 +16,8 @@
 #include "SessionBuild.hpp"
 
 #include <vector>
+#include <deque>
+#include <algorithm>
 
 #include <boost/utility.hpp>
 #include <boost/shared_ptr.hpp>
@@ -26,6 +28,7 @@
 #include <boost/algorithm/string/join.hpp>
 
 #include <core/Exec.hpp>
+#include <core/DateTime.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/text/DcfParser.hpp>
 #include <core/system/Process.hpp>
@@ -181,8 +184,8 @@ public:
 
 private:
    Build()
-      : isRunning_(false), terminationRequested_(false), restartR_(false),
-        usedDevtools_(false)
+      : isRunning_(false), terminationRequested_(false),
+        errorsEnqueuedTime_(0), restartR_(false), usedDevtools_(false)
    {
    }
 
@@ -528,6 +531,9 @@ private:
       // add r tools to path if necessary
       module_context::addRtoolsToPathIfNecessary(&childEnv, &buildToolsWarning_);
 
+      // compile in parallel (and with ccache if it's available)
+      module_context::addParallelBuildToEnvironment(packagePath, &childEnv);
+
       pkgOptions.environment = childEnv;
 
       // get R bin directory
@@ -882,35 +888,135 @@ private:
          return;
       }
 
-      // navigate to the tests directory and source all R
-      // scripts within
+      // find the R scripts within the tests directory
       FilePath testsPath = packagePath.complete("tests");
+      std::vector<FilePath> children;
+      if (testsPath.exists())
+      {
+         error = testsPath.children(&children);
+         if (error)
+            LOG_ERROR(error);
+      }
 
-      // construct a shell command to execute
-      shell_utils::ShellCommand cmd(rScriptPath);
-      cmd << "--slave";
-      cmd << "--vanilla";
-      cmd << "-e";
-      std::vector<std::string> rSourceCommands;
-
-      boost::format fmt(
-         "setwd('%1%'); "
-         "invisible(lapply(list.files(pattern = '\\\\.[rR]$'), function(x) { "
-         "    system(paste(shQuote('%2%'), '--vanilla --slave -f', shQuote(x))) "
-         "}))"
-      );
-
-      cmd << boost::str(fmt %
-                        testsPath.absolutePath() %
-                        rScriptPath.absolutePath());
+      testShards_ = TestShards();
+      BOOST_FOREACH(const FilePath& child, children)
+      {
+         if (child.extensionLowerCase() == ".r")
+            testShards_.pending.push_back(child);
+      }
+      std::sort(testShards_.pending.begin(), testShards_.pending.end());
+      testShards_.total = static_cast<int>(testShards_.pending.size());
 
+      // source each script in its own R process, running as many of
+      // them in parallel as we have idle cores for
       pkgOptions.workingDir = testsPath;
-      enqueCommandString("Sourcing R files in 'tests' directory");
+      testShards_.rScriptPath = rScriptPath;
+      testShards_.options = pkgOptions;
+      testShards_.cb = cb;
+      testShards_.parallelism = std::min(module_context::buildParallelism(),
+                                         std::max(testShards_.total, 1));
+
+      boost::format fmt("Sourcing R files in 'tests' directory "
+                        "(%1% files, %2% at a time)");
+      enqueCommandString(boost::str(fmt % testShards_.total %
+                                          testShards_.parallelism));
       successMessage_ = "\nTests complete";
-      module_context::processSupervisor().runCommand(cmd,
-                                                     pkgOptions,
-                                                     cb);
 
+      if (testShards_.pending.empty())
+         cb.onExit(EXIT_SUCCESS);
+      else
+         runTestShards();
+   }
+
+   void runTestShards()
+   {
+      while (!testShards_.pending.empty() &&
+             testShards_.running < testShards_.parallelism)
+      {
+         FilePath testFile = testShards_.pending.front();
+         testShards_.pending.pop_front();
+
+         shell_utils::ShellCommand cmd(testShards_.rScriptPath);
+         cmd << "--vanilla";
+         cmd << "--slave";
+         cmd << "-f";
+         cmd << testFile;
+
+         // collect the output of each shard so it can be shown as a block
+         // once the shard completes (rather than interleaved with others)
+         boost::shared_ptr<std::string> pOutput(new std::string());
+         core::system::ProcessCallbacks cb;
+         cb.onContinue = testShards_.cb.onContinue;
+         cb.onStdout = boost::bind(appendTestShardOutput, pOutput, _2);
+         cb.onStderr = boost::bind(appendTestShardOutput, pOutput, _2);
+         cb.onExit = boost::bind(&Build::onTestShardCompleted,
+                                 Build::shared_from_this(),
+                                 testFile,
+                                 pOutput,
+                                 date_time::millisecondsSinceEpoch(),
+                                 _1);
+
+         testShards_.running++;
+         Error error = module_context::processSupervisor().runCommand(
+                                                        cmd,
+                                                        testShards_.options,
+                                                        cb);
+         if (error)
+         {
+            LOG_ERROR(error);
+            onTestShardCompleted(testFile,
+                                 pOutput,
+                                 date_time::millisecondsSinceEpoch(),
+                                 EXIT_FAILURE);
+         }
+      }
+   }
+
+   static void appendTestShardOutput(boost::shared_ptr<std::string> pOutput,
+                                     const std::string& output)
+   {
+      pOutput->append(output);
+   }
+
+   void onTestShardCompleted(const FilePath& testFile,
+                             boost::shared_ptr<std::string> pOutput,
+                             double startTime,
+                             int exitStatus)
+   {
+      using namespace module_context;
+
+      testShards_.running--;
+      testShards_.completed++;
+      if (exitStatus != EXIT_SUCCESS)
+         testShards_.failed++;
+
+      // report the shard's progress followed by its output
+      double seconds = (date_time::millisecondsSinceEpoch() - startTime) / 1000;
+      boost::format fmt("[%1%/%2%] %3% ... %4% (%5$.1fs)\n");
+      enqueBuildOutput(exitStatus == EXIT_SUCCESS ? kCompileOutputNormal :
+                                                    kCompileOutputError,
+                       boost::str(fmt % testShards_.completed
+                                      % testShards_.total
+                                      % testFile.filename()
+                                      % (exitStatus == EXIT_SUCCESS ?
+                                            "OK" : "FAILED")
+                                      % seconds));
+      if (!pOutput->empty())
+      {
+         if (!boost::algorithm::ends_with(*pOutput, "\n"))
+            pOutput->append("\n");
+         onStandardOutput(*pOutput);
+      }
+
+      // don't start any more shards if the build was terminated
+      if (terminationRequested_)
+         testShards_.pending.clear();
+
+      if (!testShards_.pending.empty())
+         runTestShards();
+      else if (testShards_.running == 0)
+         testShards_.cb.onExit(testShards_.failed > 0 ? EXIT_FAILURE :
+                                                        EXIT_SUCCESS);
    }
 
    void devtoolsBuildPackage(const FilePath& packagePath,
@@ -1026,7 +1132,9 @@ private:
       }
 
       // install the gcc error parser
-      initErrorParser(targetPath, gccErrorParser(targetPath));
+      CompileErrorParsers parsers;
+      parsers.add(gccErrorParser(targetPath));
+      initErrorParser(targetPath, parsers);
 
       std::string make = "make";
       if (!options_.makefileArgs.empty())
@@ -1111,16 +1219,6 @@ public:
       return outputJson;
    }
 
-   std::string outputAsText()
-   {
-      std::string output;
-      BOOST_FOREACH(const module_context::CompileOutput& compileOutput, output_)
-      {
-         output.append(compileOutput.output);
-      }
-      return output;
-   }
-
    void terminate()
    {
       enqueBuildOutput(module_context::kCompileOutputNormal, "\n");
@@ -1178,14 +1276,14 @@ private:
    {
       using namespace module_context;
 
-      // call the error parser if one has been specified
-      if (errorParser_)
+      // parse whatever output remains and send the final set of errors
+      if (!errorParsers_.empty())
       {
-         std::vector<SourceMarker> errors = errorParser_(outputAsText());
-         if (!errors.empty())
+         errorParsers_.flush(&errors_);
+         if (!errors_.empty())
          {
-            errorsJson_ = sourceMarkersAsJson(errors);
-            enqueBuildErrors(errorsJson_);
+            errorsJson_ = sourceMarkersAsJson(errors_);
+            enqueBuildErrors(errorsJson_, true);
          }
       }
 
@@ -1235,6 +1333,28 @@ private:
                         compileOutputAsJson(compileOutput));
 
       module_context::enqueClientEvent(event);
+
+      // parse errors as the output arrives
+      if (!errorParsers_.empty())
+      {
+         std::size_t previousErrors = errors_.size();
+         errorParsers_.parse(output, &errors_);
+         if (errors_.size() > previousErrors)
+            enqueBuildErrorsIfDue();
+      }
+   }
+
+   void enqueBuildErrorsIfDue()
+   {
+      // show errors while the build is in progress, but don't send the
+      // (growing) list more than once a second
+      double now = date_time::millisecondsSinceEpoch();
+      if (now - errorsEnqueuedTime_ < 1000)
+         return;
+
+      errorsEnqueuedTime_ = now;
+      errorsJson_ = module_context::sourceMarkersAsJson(errors_);
+      enqueBuildErrors(errorsJson_, false);
    }
 
    void enqueCommandString(const std::string& cmd)
@@ -1243,11 +1363,12 @@ private:
                        "==> " + cmd + "\n\n");
    }
 
-   void enqueBuildErrors(const json::Array& errors)
+   void enqueBuildErrors(const json::Array& errors, bool complete)
    {
       json::Object jsonData;
       jsonData["base_dir"] = errorsBaseDir_;
       jsonData["errors"] = errors;
+      jsonData["complete"] = complete;
 
       ClientEvent event(client_events::kBuildErrors, jsonData);
       module_context::enqueClientEvent(event);
@@ -1350,7 +1471,8 @@ private:
       return type + " package written to " + written;
    }
 
-   void initErrorParser(const FilePath& baseDir, CompileErrorParser parser)
+   void initErrorParser(const FilePath& baseDir,
+                        const CompileErrorParsers& parsers)
    {
       // set base dir -- make sure it ends with a / so the slash is
       // excluded from error display
@@ -1361,16 +1483,18 @@ private:
          errorsBaseDir_.append("/");
       }
 
-      errorParser_ = parser;
+      errorParsers_ = parsers;
    }
 
 private:
    bool isRunning_;
    bool terminationRequested_;
    std::vector<module_context::CompileOutput> output_;
-   CompileErrorParser errorParser_;
+   CompileErrorParsers errorParsers_;
+   std::vector<module_context::SourceMarker> errors_;
    std::string errorsBaseDir_;
    json::Array errorsJson_;
+   double errorsEnqueuedTime_;
    r_util::RPackageInfo pkgInfo_;
    projects::RProjectBuildOptions options_;
    std::string successMessage_;
@@ -1380,6 +1504,26 @@ private:
    boost::function<bool(const std::string&)> errorOutputFilterFunction_;
    bool restartR_;
    bool usedDevtools_;
+
+   // state of the test scripts being sourced in parallel
+   struct TestShards
+   {
+      TestShards()
+         : total(0), parallelism(1), running(0), completed(0), failed(0)
+      {
+      }
+
+      FilePath rScriptPath;
+      core::system::ProcessOptions options;
+      core::system::ProcessCallbacks cb;
+      std::deque<FilePath> pending;
+      int total;
+      int parallelism;
+      int running;
+      int completed;
+      int failed;
+   };
+   TestShards testShards_;
 };
 
 boost::shared_ptr<Build> s_pBuild;
@@ -15,13 +15,19 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
+
+#include <stdlib.h>
 
 #include <boost/regex.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/format.hpp>
 #include <boost/foreach.hpp>
 
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
+#include <core/SafeConvert.hpp>
 
 #include <core/FileSerializer.hpp>
 #include <core/system/System.hpp>
@@ -268,6 +274,48 @@ bool addRtoolsToPathIfNecessary(core::system::Options* pEnvironment,
 }
 #endif
 
+int buildParallelism()
+{
+   int cores = std::max(static_cast<int>(boost::thread::hardware_concurrency()), 1);
+
+   // leave cores which are already busy (e.g. with another build) alone
+   int jobs = cores;
+#ifndef _WIN32
+   double loadAverage = 0;
+   if (::getloadavg(&loadAverage, 1) == 1)
+      jobs -= static_cast<int>(loadAverage + 0.5);
+#endif
+
+   return std::max(jobs, 1);
+}
+
+void addParallelBuildToEnvironment(const FilePath& sourcePath,
+                                   core::system::Options* pEnvironment)
+{
+   // compile in parallel unless the user has already specified the
+   // number of jobs for make
+   std::string makeFlags = core::system::getenv(*pEnvironment, "MAKEFLAGS");
+   if (!boost::algorithm::contains(makeFlags, "-j"))
+   {
+      std::string jobsFlag = "-j" +
+                  safe_convert::numberToString(buildParallelism());
+      if (!makeFlags.empty())
+         jobsFlag.append(" " + makeFlags);
+      core::system::setenv(pEnvironment, "MAKEFLAGS", jobsFlag);
+   }
+
+   // if ccache is available then have it hash paths relative to the
+   // directory containing the package, so that cached objects can be
+   // shared by copies of the package beneath it (e.g. in .Rcheck)
+   if (core::system::getenv(*pEnvironment, "CCACHE_BASEDIR").empty() &&
+       !module_context::findProgram("ccache").empty())
+   {
+      core::system::setenv(pEnvironment,
+                           "CCACHE_BASEDIR",
+                           sourcePath.parent().absolutePath());
+   }
+}
+
 } // namespace module_context
 } // namespace session
 } // namespace rstudio
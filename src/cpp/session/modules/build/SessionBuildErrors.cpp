@@ -16,8 +16,11 @@
 #include "SessionBuildErrors.hpp"
 
 #include <algorithm>
+#include <map>
 
 #include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/regex.hpp>
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
@@ -60,147 +63,257 @@ bool isMatchingFile(const std::vector<std::string>& lines,
           boost::algorithm::starts_with(lines[diagLine], nextLineContents);
 }
 
-FilePath scanForRSourceFile(const FilePath& basePath,
-                            std::size_t diagLine,
-                            const std::string& lineContents,
-                            const std::string& nextLineContents)
+class RErrorParser : boost::noncopyable
 {
-   std::vector<FilePath> children;
-   Error error = basePath.children(&children);
-   if (error)
+public:
+   explicit RErrorParser(const FilePath& basePath)
+      : basePath_(basePath),
+        lineCount_(0),
+        sourceFilesRead_(false)
    {
-      LOG_ERROR(error);
-      return FilePath();
    }
 
-   BOOST_FOREACH(const FilePath& child, children)
+   // errors from parse take the form:
+   //
+   //    Error in parse(outFile) : <line>:<column>: <message>
+   //    <diagLine>: <lineContents>
+   //    <diagLine+1>: <nextLineContents>
+   //
+   // so we keep the two previous lines to match against
+   void parseLine(const std::string& line,
+                  std::vector<module_context::SourceMarker>* pMarkers)
    {
-      if (isRSourceFile(child))
+      if (lineCount_ == 2 && parseError(line, pMarkers))
       {
-         std::vector<std::string> lines;
-         Error error = core::readStringVectorFromFile(child, &lines, false);
-         if (error)
-         {
-            LOG_ERROR(error);
-            continue;
-         }
-
-         if (isMatchingFile(lines, diagLine, lineContents, nextLineContents))
-            return child;
+         // the lines of a matched error aren't part of any other error
+         lineCount_ = 0;
+         return;
       }
-   }
 
-   return FilePath();
-}
+      if (lineCount_ == 2)
+         lines_[0] = lines_[1];
+      else
+         lineCount_++;
+      lines_[lineCount_ - 1] = line;
+   }
 
-std::vector<module_context::SourceMarker> parseRErrors(
-                                       const FilePath& basePath,
-                                       const std::string& output)
-{
-   using namespace module_context;
-   std::vector<SourceMarker> errors;
-
-   boost::regex re("^Error in parse\\(outFile\\) : ([0-9]+?):([0-9]+?): (.+?)\\n"
-                   "([0-9]+?): (.*?)\\n([0-9]+?): (.+?)$");
-   boost::sregex_iterator iter(output.begin(), output.end(), re,
-                               boost::regex_constants::match_not_dot_newline);
-   boost::sregex_iterator end;
-   for (; iter != end; iter++)
+private:
+   bool parseError(const std::string& line,
+                   std::vector<module_context::SourceMarker>* pMarkers)
    {
-      boost::smatch match = *iter;
-      BOOST_ASSERT(match.size() == 8);
+      using namespace module_context;
+
+      // cheap check before running any regexes
+      if (!boost::algorithm::starts_with(lines_[0], "Error in parse(outFile)"))
+         return false;
 
-      // first part is straightforward
-      std::string line = match[1];
-      std::string column = match[2];
-      std::string message = match[3];
+      static const boost::regex reError(
+               "^Error in parse\\(outFile\\) : ([0-9]+):([0-9]+): (.+)$");
+      static const boost::regex reContents("^([0-9]+): (.*)$");
+      static const boost::regex reNextContents("^([0-9]+): (.+)$");
+
+      boost::smatch errorMatch, contentsMatch, nextContentsMatch;
+      if (!boost::regex_match(lines_[0], errorMatch, reError) ||
+          !boost::regex_match(lines_[1], contentsMatch, reContents) ||
+          !boost::regex_match(line, nextContentsMatch, reNextContents))
+      {
+         return false;
+      }
 
       // we need to guess the file based on the contextual information
       // provided in the error message
-      int diagLine = core::safe_convert::stringTo<int>(match[4], -1);
+      int diagLine = core::safe_convert::stringTo<int>(contentsMatch[1], -1);
       if (diagLine != -1)
       {
-         FilePath rSrcFile = scanForRSourceFile(basePath,
-                                                diagLine,
-                                                match[5],
-                                                match[7]);
+         FilePath rSrcFile = scanForRSourceFile(diagLine,
+                                                contentsMatch[2],
+                                                nextContentsMatch[2]);
          if (!rSrcFile.empty())
          {
             // create error and add it
             SourceMarker err(SourceMarker::Error,
                              rSrcFile,
-                             core::safe_convert::stringTo<int>(line, 1),
-                             core::safe_convert::stringTo<int>(column, 1),
-                             core::html_utils::HTML(message),
+                             core::safe_convert::stringTo<int>(errorMatch[1], 1),
+                             core::safe_convert::stringTo<int>(errorMatch[2], 1),
+                             core::html_utils::HTML(errorMatch[3]),
                              false);
-            errors.push_back(err);
+            pMarkers->push_back(err);
          }
       }
 
+      return true;
    }
 
-   return errors;
+   FilePath scanForRSourceFile(std::size_t diagLine,
+                               const std::string& lineContents,
+                               const std::string& nextLineContents)
+   {
+      // read the source files once per build (rather than once per error)
+      if (!sourceFilesRead_)
+      {
+         sourceFilesRead_ = true;
 
-}
+         std::vector<FilePath> children;
+         Error error = basePath_.children(&children);
+         if (error)
+            LOG_ERROR(error);
+
+         BOOST_FOREACH(const FilePath& child, children)
+         {
+            if (isRSourceFile(child))
+            {
+               std::vector<std::string> lines;
+               Error error = core::readStringVectorFromFile(child, &lines, false);
+               if (error)
+               {
+                  LOG_ERROR(error);
+                  continue;
+               }
+
+               sourceFiles_.push_back(std::make_pair(child, lines));
+            }
+         }
+      }
+
+      typedef std::pair<FilePath, std::vector<std::string> > SourceFile;
+      BOOST_FOREACH(const SourceFile& sourceFile, sourceFiles_)
+      {
+         if (isMatchingFile(sourceFile.second,
+                            diagLine,
+                            lineContents,
+                            nextLineContents))
+         {
+            return sourceFile.first;
+         }
+      }
+
+      return FilePath();
+   }
 
+private:
+   FilePath basePath_;
+   std::string lines_[2];
+   int lineCount_;
+   bool sourceFilesRead_;
+   std::vector<std::pair<FilePath, std::vector<std::string> > > sourceFiles_;
+};
 
-std::vector<module_context::SourceMarker> parseGccErrors(
-                                           const FilePath& basePath,
-                                           const std::string& output)
+class GccErrorParser : boost::noncopyable
 {
-   // check to see if we are in a package
-   std::string pkgInclude;
-   using namespace projects;
-   if (projectContext().hasProject() &&
-       (projectContext().config().buildType == r_util::kBuildTypePackage))
+public:
+   explicit GccErrorParser(const FilePath& basePath)
+      : basePath_(basePath),
+        previousLineMatched_(false)
    {
-      pkgInclude = "/" + projectContext().packageInfo().name() + "/include/";
+      // check to see if we are in a package
+      using namespace projects;
+      if (projectContext().hasProject() &&
+          (projectContext().config().buildType == r_util::kBuildTypePackage))
+      {
+         pkgInclude_ = "/" + projectContext().packageInfo().name() + "/include/";
+      }
    }
 
-   using namespace module_context;
-   std::vector<SourceMarker> errors;
-
    // parse standard gcc errors and warning lines but also pickup "from"
-   // prefixed errors and substitute the from file for the error/warning file
-   boost::regex re("(?:from (.+?):([0-9]+?).+?\\n)?"
-                   "^(.+?):([0-9]+?):(?:([0-9]+?):)? (error|warning): (.+)$");
-   boost::sregex_iterator iter(output.begin(), output.end(), re,
-                               boost::regex_constants::match_not_dot_newline);
-   boost::sregex_iterator end;
-   for (; iter != end; iter++)
+   // prefixed errors (on the previous line) and substitute the from file
+   // for the error/warning file
+   void parseLine(const std::string& line,
+                  std::vector<module_context::SourceMarker>* pMarkers)
    {
-      boost::smatch match = *iter;
-      BOOST_ASSERT(match.size() == 8);
+      bool matched = false;
 
-      std::string file, line, column, type, message;
-      std::string match1 = match[1];
-      if (!match1.empty() && FilePath::isRootPath(match[1]))
+      // cheap check before running the regex (the vast majority of build
+      // output is neither an error nor a warning)
+      if (line.find("error: ") != std::string::npos ||
+          line.find("warning: ") != std::string::npos)
       {
-         file = match[1];
-         line = match[2];
+         matched = parseError(line, pMarkers);
+      }
+
+      // a line which was itself an error can't be the "from" line of the next
+      previousLine_ = line;
+      previousLineMatched_ = matched;
+   }
+
+private:
+   bool parseError(const std::string& line,
+                   std::vector<module_context::SourceMarker>* pMarkers)
+   {
+      using namespace module_context;
+
+      static const boost::regex reError(
+               "^(.+?):([0-9]+?):(?:([0-9]+?):)? (error|warning): (.+)$");
+      static const boost::regex reFrom("from (.+?):([0-9]+).+$");
+
+      boost::smatch match;
+      if (!boost::regex_match(line, match, reError))
+         return false;
+
+      std::string file, lineNumber, column;
+      boost::smatch fromMatch;
+      if (!previousLineMatched_ &&
+          boost::regex_search(previousLine_, fromMatch, reFrom) &&
+          FilePath::isRootPath(fromMatch[1]))
+      {
+         file = fromMatch[1];
+         lineNumber = fromMatch[2];
          column = "1";
       }
       else
       {
-         file = match[3];
-         line = match[4];
-         column = match[5];
+         file = match[1];
+         lineNumber = match[2];
+         column = match[3];
          if (column.empty())
             column = "1";
       }
-      type = match[6];
-      message = match[7];
+      std::string type = match[4];
+      std::string message = match[5];
+
+      // resolve file path (skip if the file doesn't exist)
+      FilePath filePath = resolveFilePath(file);
+      if (filePath.empty())
+         return true;
+
+      // don't show warnings from Makeconf
+      if (filePath.filename() == "Makeconf")
+         return true;
 
-      // resolve file path
+      // create marker and add it
+      SourceMarker err(module_context::sourceMarkerTypeFromString(type),
+                       filePath,
+                       core::safe_convert::stringTo<int>(lineNumber, 1),
+                       core::safe_convert::stringTo<int>(column, 1),
+                       core::html_utils::HTML(message),
+                       true);
+      pMarkers->push_back(err);
+      return true;
+   }
+
+   FilePath resolveFilePath(const std::string& file)
+   {
+      // the same few files tend to be reported over and over (e.g. headers
+      // with template instantiation errors) so remember the results
+      std::map<std::string,FilePath>::const_iterator it =
+                                                   resolvedFilePaths_.find(file);
+      if (it != resolvedFilePaths_.end())
+         return it->second;
+
+      FilePath filePath = doResolveFilePath(file);
+      resolvedFilePaths_[file] = filePath;
+      return filePath;
+   }
+
+   FilePath doResolveFilePath(const std::string& file)
+   {
       FilePath filePath;
       if (FilePath::isRootPath(file))
          filePath = FilePath(file);
       else
-         filePath = basePath.childPath(file);
+         filePath = basePath_.childPath(file);
 
-      // skip if the file doesn't exist
       if (!filePath.exists())
-         continue;
+         return FilePath();
 
       FilePath realPath;
       Error error = core::system::realPath(filePath, &realPath);
@@ -213,17 +326,18 @@ std::vector<module_context::SourceMarker> parseGccErrors(
       // has /<package-name>/include/ in it then it might be a template
       // instantiation error. in that case re-map it to the appropriate
       // source file within the package
-      if (!pkgInclude.empty())
+      if (!pkgInclude_.empty())
       {
          std::string path = filePath.absolutePath();
-         size_t pos = path.find(pkgInclude);
+         size_t pos = path.find(pkgInclude_);
          if (pos != std::string::npos)
          {
             // advance to end and calculate relative path
-            pos += pkgInclude.length();
+            pos += pkgInclude_.length();
             std::string relativePath = path.substr(pos);
 
             // does this file exist? if so substitute it
+            using namespace projects;
             FilePath includePath = projectContext().buildTargetPath()
                              .childPath("inst/include/" + relativePath);
             if (includePath.exists())
@@ -231,33 +345,87 @@ std::vector<module_context::SourceMarker> parseGccErrors(
          }
       }
 
-      // don't show warnings from Makeconf
-      if (filePath.filename() == "Makeconf")
-         continue;
+      return filePath;
+   }
 
-      // create marker and add it
-      SourceMarker err(module_context::sourceMarkerTypeFromString(type),
-                       filePath,
-                       core::safe_convert::stringTo<int>(line, 1),
-                       core::safe_convert::stringTo<int>(column, 1),
-                       core::html_utils::HTML(message),
-                       true);
-      errors.push_back(err);
+private:
+   FilePath basePath_;
+   std::string pkgInclude_;
+   std::string previousLine_;
+   bool previousLineMatched_;
+   std::map<std::string,FilePath> resolvedFilePaths_;
+};
+
+} // anonymous namespace
+
+void CompileErrorParsers::parse(const std::string& output,
+                                std::vector<module_context::SourceMarker>* pMarkers)
+{
+   std::string::size_type pos = 0;
+   while (true)
+   {
+      std::string::size_type newlinePos = output.find('\n', pos);
+      if (newlinePos == std::string::npos)
+         break;
+
+      if (partialLine_.empty())
+      {
+         parseLine(output.substr(pos, newlinePos - pos), pMarkers);
+      }
+      else
+      {
+         partialLine_.append(output, pos, newlinePos - pos);
+         parseLine(partialLine_, pMarkers);
+         partialLine_.clear();
+      }
+
+      pos = newlinePos + 1;
    }
 
-   return errors;
+   partialLine_.append(output, pos, std::string::npos);
 }
 
-} // anonymous namespace
+void CompileErrorParsers::flush(std::vector<module_context::SourceMarker>* pMarkers)
+{
+   if (!partialLine_.empty())
+   {
+      parseLine(partialLine_, pMarkers);
+      partialLine_.clear();
+   }
+}
+
+void CompileErrorParsers::parseLine(
+                        const std::string& line,
+                        std::vector<module_context::SourceMarker>* pMarkers)
+{
+   // strip carriage returns from windows line endings
+   if (!line.empty() && line[line.size() - 1] == '\r')
+   {
+      std::string strippedLine = line.substr(0, line.size() - 1);
+      BOOST_FOREACH(const CompileErrorParser& parser, parsers_)
+      {
+         parser(strippedLine, pMarkers);
+      }
+   }
+   else
+   {
+      BOOST_FOREACH(const CompileErrorParser& parser, parsers_)
+      {
+         parser(line, pMarkers);
+      }
+   }
+}
 
 CompileErrorParser gccErrorParser(const FilePath& basePath)
 {
-   return boost::bind(parseGccErrors, basePath, _1);
+   boost::shared_ptr<GccErrorParser> pParser(new GccErrorParser(basePath));
+   return boost::bind(&GccErrorParser::parseLine, pParser, _1, _2);
 }
 
 CompileErrorParser rErrorParser(const FilePath& basePath)
 {
-   return boost::bind(parseRErrors, basePath, _1);
+   boost::shared_ptr<RErrorParser> pParser(new RErrorParser(basePath));
+   return boost::bind(&RErrorParser::parseLine, pParser, _1, _2);
 }
 
 
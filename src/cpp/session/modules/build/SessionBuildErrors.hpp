@@ -20,7 +20,6 @@
 #include <vector>
 
 #include <boost/function.hpp>
-#include <boost/foreach.hpp>
 
 #include <core/FilePath.hpp>
 #include <core/json/Json.hpp>
@@ -32,9 +31,16 @@ namespace session {
 namespace modules {
 namespace build {
 
-typedef boost::function<std::vector<module_context::SourceMarker>(const std::string&)>
+// parses a single line of build output (without its trailing newline),
+// appending any markers found to the vector. parsers are fed the lines in
+// order and may keep state from the lines which preceded this one
+typedef boost::function<void(const std::string&,
+                             std::vector<module_context::SourceMarker>*)>
                                                          CompileErrorParser;
 
+// feeds build output to a set of parsers incrementally as it arrives (so
+// errors can be reported during the build without re-scanning all of the
+// output which came before)
 class CompileErrorParsers
 {
 public:
@@ -47,22 +53,35 @@ public:
       parsers_.push_back(parser);
    }
 
+   bool empty() const
+   {
+      return parsers_.empty();
+   }
+
+   // parse the complete lines within the output (a trailing partial line
+   // is held until more output arrives or flush is called)
+   void parse(const std::string& output,
+              std::vector<module_context::SourceMarker>* pMarkers);
+
+   // parse any partial line remaining at the end of the output
+   void flush(std::vector<module_context::SourceMarker>* pMarkers);
+
 public:
    std::vector<module_context::SourceMarker> operator()(const std::string& output)
    {
-      using namespace module_context;
-      std::vector<SourceMarker> allErrors;
-      BOOST_FOREACH(const CompileErrorParser& parser, parsers_)
-      {
-         std::vector<SourceMarker> errors = parser(output);
-         std::copy(errors.begin(), errors.end(), std::back_inserter(allErrors));
-      }
-
-      return allErrors;
+      std::vector<module_context::SourceMarker> markers;
+      parse(output, &markers);
+      flush(&markers);
+      return markers;
    }
 
+private:
+   void parseLine(const std::string& line,
+                  std::vector<module_context::SourceMarker>* pMarkers);
+
 private:
    std::vector<CompileErrorParser> parsers_;
+   std::string partialLine_;
 };
 
 CompileErrorParser gccErrorParser(const core::FilePath& basePath);
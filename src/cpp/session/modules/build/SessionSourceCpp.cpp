@@ -91,7 +91,8 @@ void enqueSourceCppCompleted(const FilePath& sourceFile,
 
    // parse errors
    std::string allOutput = output + "\n" + errorOutput;
-   CompileErrorParser errorParser = gccErrorParser(sourceFile.parent());
+   CompileErrorParsers errorParser;
+   errorParser.add(gccErrorParser(sourceFile.parent()));
    std::vector<SourceMarker> errors = errorParser(allOutput);
    sourceCppState.errors = sourceMarkersAsJson(errors);
 
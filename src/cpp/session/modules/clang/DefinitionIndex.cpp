@@ -15,12 +15,17 @@
 
 #include "DefinitionIndex.hpp"
 
+#include <cstring>
 #include <deque>
 
+#include <boost/unordered_map.hpp>
+
 #include <core/FilePath.hpp>
 #include <core/DateTime.hpp>
 #include <core/PerformanceTimer.hpp>
+#include <core/Thread.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/MappedFile.hpp>
 #include <core/libclang/LibClang.hpp>
 #include <core/system/ProcessArgs.hpp>
 #include <session/IncrementalFileChangeHandler.hpp>
@@ -46,15 +51,333 @@ bool s_initialized = false;
 
 struct CppDefinitions
 {
+   CppDefinitions() : fileLastWrite(0), pSection(NULL), sectionSize(0) {}
+
    std::string file;
    std::time_t fileLastWrite;
    std::deque<CppDefinition> definitions;
+
+   // definitions read from the cache aren't decoded until they're first
+   // needed (this is their section within the mapped cache file)
+   const char* pSection;
+   std::size_t sectionSize;
 };
 
 // store definitions by file
 typedef std::map<std::string,CppDefinitions> DefinitionsByFile;
 DefinitionsByFile s_definitionsByFile;
 
+// the definition cache is a binary file: a header followed by a section
+// for each indexed file. sections are self-contained (each has its own
+// string table for USRs, names, and paths) so they can be decoded lazily
+// from a mapping of the cache, and written back out as-is if the file
+// wasn't re-indexed
+const char * const kDefinitionCacheMagic = "RSCD";
+const boost::uint32_t kDefinitionCacheVersion = 1;
+
+// mapping of the cache file read at startup
+MappedFile s_definitionCacheFile;
+
+template <typename T>
+void appendValue(T value, std::string* pBuffer)
+{
+   pBuffer->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(const char** pPos, const char* end, T* pValue)
+{
+   if (static_cast<std::size_t>(end - *pPos) < sizeof(T))
+      return false;
+   std::memcpy(pValue, *pPos, sizeof(T));
+   *pPos += sizeof(T);
+   return true;
+}
+
+void appendString(const std::string& value, std::string* pBuffer)
+{
+   appendValue(static_cast<boost::uint32_t>(value.size()), pBuffer);
+   pBuffer->append(value);
+}
+
+bool readString(const char** pPos, const char* end, std::string* pValue)
+{
+   boost::uint32_t size;
+   if (!readValue(pPos, end, &size) ||
+       static_cast<std::size_t>(end - *pPos) < size)
+   {
+      return false;
+   }
+   pValue->assign(*pPos, size);
+   *pPos += size;
+   return true;
+}
+
+boost::uint32_t stringId(const std::string& value,
+                         std::map<std::string, boost::uint32_t>* pIds,
+                         std::vector<const std::string*>* pStrings)
+{
+   std::map<std::string, boost::uint32_t>::iterator it = pIds->insert(
+      std::make_pair(value, static_cast<boost::uint32_t>(pIds->size()))).first;
+   if (it->second == pStrings->size())
+      pStrings->push_back(&(it->first));
+   return it->second;
+}
+
+void encodeSection(const CppDefinitions& definitions, std::string* pBuffer)
+{
+   // encode the definitions, collecting their strings
+   std::map<std::string, boost::uint32_t> ids;
+   std::vector<const std::string*> strings;
+   std::string definitionsBuffer;
+   BOOST_FOREACH(const CppDefinition& def, definitions.definitions)
+   {
+      appendValue(stringId(def.USR, &ids, &strings), &definitionsBuffer);
+      appendValue(static_cast<boost::uint32_t>(def.kind), &definitionsBuffer);
+      appendValue(stringId(def.parentName, &ids, &strings), &definitionsBuffer);
+      appendValue(stringId(def.name, &ids, &strings), &definitionsBuffer);
+      appendValue(stringId(def.location.filePath.absolutePath(), &ids, &strings),
+                  &definitionsBuffer);
+      appendValue(static_cast<boost::uint32_t>(def.location.line),
+                  &definitionsBuffer);
+      appendValue(static_cast<boost::uint32_t>(def.location.column),
+                  &definitionsBuffer);
+   }
+
+   std::string section;
+   appendString(definitions.file, &section);
+   appendValue(static_cast<boost::int64_t>(definitions.fileLastWrite), &section);
+   appendValue(static_cast<boost::uint32_t>(strings.size()), &section);
+   BOOST_FOREACH(const std::string* pString, strings)
+   {
+      appendString(*pString, &section);
+   }
+   appendValue(static_cast<boost::uint32_t>(definitions.definitions.size()),
+               &section);
+   section.append(definitionsBuffer);
+
+   appendValue(static_cast<boost::uint32_t>(section.size()), pBuffer);
+   pBuffer->append(section);
+}
+
+bool readSectionHeader(const char** pPos,
+                       const char* end,
+                       CppDefinitions* pDefinitions)
+{
+   boost::int64_t fileLastWrite;
+   if (!readString(pPos, end, &pDefinitions->file) ||
+       !readValue(pPos, end, &fileLastWrite))
+   {
+      return false;
+   }
+   pDefinitions->fileLastWrite = static_cast<std::time_t>(fileLastWrite);
+   return true;
+}
+
+bool decodeSection(const char* pos,
+                   const char* end,
+                   std::deque<CppDefinition>* pDefinitions)
+{
+   CppDefinitions header;
+   if (!readSectionHeader(&pos, end, &header))
+      return false;
+
+   boost::uint32_t stringCount;
+   if (!readValue(&pos, end, &stringCount))
+      return false;
+   std::vector<std::string> strings(stringCount);
+   for (boost::uint32_t i = 0; i < stringCount; i++)
+   {
+      if (!readString(&pos, end, &strings[i]))
+         return false;
+   }
+
+   boost::uint32_t count;
+   if (!readValue(&pos, end, &count))
+      return false;
+   for (boost::uint32_t i = 0; i < count; i++)
+   {
+      boost::uint32_t fields[7];
+      if (!readValue(&pos, end, &fields))
+         return false;
+      if (fields[0] >= stringCount || fields[2] >= stringCount ||
+          fields[3] >= stringCount || fields[4] >= stringCount)
+      {
+         return false;
+      }
+
+      pDefinitions->push_back(CppDefinition(
+            strings[fields[0]],
+            static_cast<CppDefinitionKind>(fields[1]),
+            strings[fields[2]],
+            strings[fields[3]],
+            FileLocation(FilePath(strings[fields[4]]), fields[5], fields[6])));
+   }
+
+   return true;
+}
+
+// decode definitions which were loaded from the cache
+CppDefinitions& decodedDefinitions(CppDefinitions& definitions)
+{
+   if (definitions.pSection != NULL)
+   {
+      if (!decodeSection(definitions.pSection,
+                         definitions.pSection + definitions.sectionSize,
+                         &definitions.definitions))
+      {
+         LOG_ERROR_MESSAGE("Invalid definition cache entry for " +
+                           definitions.file);
+         definitions.definitions.clear();
+      }
+      definitions.pSection = NULL;
+      definitions.sectionSize = 0;
+   }
+   return definitions;
+}
+
+// lookup indexes over the definitions in s_definitionsByFile: definitions
+// by USR, and the distinct definition names along with a mask of the
+// characters they contain (so names which can't match a fuzzy search are
+// skipped without comparing them). they're built on first use (which
+// decodes any cached definitions) and kept up to date as files are indexed
+struct IndexedDefinition
+{
+   IndexedDefinition(const std::string* pFile, const CppDefinition* pDefinition)
+      : pFile(pFile), pDefinition(pDefinition)
+   {
+   }
+
+   const std::string* pFile;
+   const CppDefinition* pDefinition;
+};
+
+struct IndexedName
+{
+   IndexedName() : mask(0) {}
+
+   boost::uint64_t mask;
+   std::vector<IndexedDefinition> definitions;
+};
+
+typedef boost::unordered_multimap<std::string, IndexedDefinition> UsrIndex;
+typedef boost::unordered_map<std::string, IndexedName> NameIndex;
+
+bool s_lookupIndexBuilt = false;
+UsrIndex s_usrIndex;
+NameIndex s_nameIndex;
+
+boost::uint64_t characterMask(const std::string& text)
+{
+   boost::uint64_t mask = 0;
+   for (std::string::const_iterator it = text.begin(); it != text.end(); ++it)
+   {
+      char ch = *it;
+      if (ch >= 'A' && ch <= 'Z')
+         ch += 'a' - 'A';
+      if (ch >= 'a' && ch <= 'z')
+         mask |= boost::uint64_t(1) << (ch - 'a');
+      else if (ch >= '0' && ch <= '9')
+         mask |= boost::uint64_t(1) << (26 + ch - '0');
+      else if (ch == '_')
+         mask |= boost::uint64_t(1) << 36;
+      else if (ch != '*')
+         mask |= boost::uint64_t(1) << 37;
+   }
+   return mask;
+}
+
+void indexDefinitions(const std::string& file,
+                      const CppDefinitions& definitions)
+{
+   BOOST_FOREACH(const CppDefinition& def, definitions.definitions)
+   {
+      IndexedDefinition indexed(&file, &def);
+      s_usrIndex.insert(std::make_pair(def.USR, indexed));
+
+      IndexedName& name = s_nameIndex[def.name];
+      if (name.definitions.empty())
+         name.mask = characterMask(def.name);
+      name.definitions.push_back(indexed);
+   }
+}
+
+void unindexDefinitions(const CppDefinitions& definitions)
+{
+   BOOST_FOREACH(const CppDefinition& def, definitions.definitions)
+   {
+      std::pair<UsrIndex::iterator, UsrIndex::iterator> range =
+                                             s_usrIndex.equal_range(def.USR);
+      for (UsrIndex::iterator it = range.first; it != range.second; ++it)
+      {
+         if (it->second.pDefinition == &def)
+         {
+            s_usrIndex.erase(it);
+            break;
+         }
+      }
+
+      NameIndex::iterator nameIt = s_nameIndex.find(def.name);
+      if (nameIt == s_nameIndex.end())
+         continue;
+      std::vector<IndexedDefinition>& named = nameIt->second.definitions;
+      for (std::size_t i = 0; i < named.size(); i++)
+      {
+         if (named[i].pDefinition == &def)
+         {
+            named.erase(named.begin() + i);
+            break;
+         }
+      }
+      if (named.empty())
+         s_nameIndex.erase(nameIt);
+   }
+}
+
+void ensureLookupIndex()
+{
+   if (s_lookupIndexBuilt)
+      return;
+
+   BOOST_FOREACH(DefinitionsByFile::value_type& defs, s_definitionsByFile)
+   {
+      indexDefinitions(defs.first, decodedDefinitions(defs.second));
+   }
+   s_lookupIndexBuilt = true;
+}
+
+// all changes to s_definitionsByFile go through these so that the lookup
+// indexes (which point into it) stay valid
+void setDefinitions(const CppDefinitions& definitions)
+{
+   DefinitionsByFile::iterator it = s_definitionsByFile.find(definitions.file);
+   if (it == s_definitionsByFile.end())
+   {
+      it = s_definitionsByFile.insert(
+                  std::make_pair(definitions.file, definitions)).first;
+   }
+   else
+   {
+      if (s_lookupIndexBuilt)
+         unindexDefinitions(it->second);
+      it->second = definitions;
+   }
+
+   if (s_lookupIndexBuilt)
+      indexDefinitions(it->first, decodedDefinitions(it->second));
+}
+
+void removeDefinitions(const std::string& file)
+{
+   DefinitionsByFile::iterator it = s_definitionsByFile.find(file);
+   if (it == s_definitionsByFile.end())
+      return;
+
+   if (s_lookupIndexBuilt)
+      unindexDefinitions(it->second);
+   s_definitionsByFile.erase(it);
+}
+
 // visitor used to populate deque
 bool insertDefinition(const CppDefinition& definition,
                       CppDefinitions* pDefinitions)
@@ -171,6 +494,207 @@ CXChildVisitResult cursorVisitor(CXCursor cxCursor,
    }
 }
 
+// translation units are parsed and indexed on a dedicated set of threads
+// (parsing can take seconds, so they don't share the session worker pool).
+// each thread uses its own CXIndex; results are merged into the index on
+// the main thread, which is the only thread that touches it
+struct IndexRequest
+{
+   IndexRequest() : fileLastWrite(0), generation(0) {}
+
+   std::string file;
+   std::time_t fileLastWrite;
+   std::vector<std::string> compileArgs;
+   unsigned generation;
+};
+
+struct IndexResult
+{
+   IndexResult() : generation(0) {}
+
+   CppDefinitions definitions;
+   unsigned generation;
+};
+
+// queues shared with the indexing threads (never freed, see note on
+// ThreadsafeQueue sync objects)
+thread::ThreadsafeQueue<IndexRequest>* s_pIndexRequests = NULL;
+thread::ThreadsafeQueue<IndexResult>* s_pIndexResults = NULL;
+thread::ThreadsafeValue<bool>* s_pIndexingCancelled = NULL;
+
+// files waiting to be indexed, and the generation of the most recent
+// change to each file being indexed (results for older generations are
+// discarded)
+std::deque<IndexRequest> s_indexQueue;
+std::map<std::string, unsigned> s_indexGenerations;
+unsigned s_nextGeneration = 0;
+
+// number of requests handed to the indexing threads which haven't yet
+// been merged (limited so that compilation arguments aren't computed far
+// ahead of the threads and repeated changes to a file coalesce)
+std::size_t s_pendingIndexCount = 0;
+std::size_t s_maxPendingIndexCount = 0;
+bool s_mergingIndexResults = false;
+
+void indexTranslationUnit(CXIndex index, const IndexRequest& request)
+{
+   IndexResult result;
+   result.generation = request.generation;
+   result.definitions.file = request.file;
+   result.definitions.fileLastWrite = request.fileLastWrite;
+
+   // skip the parse if indexing was cancelled while the request was queued
+   if (!s_pIndexingCancelled->get())
+   {
+      // get args in form clang expects
+      core::system::ProcessArgs argsArray(request.compileArgs);
+
+      // parse the translation unit
+      CXTranslationUnit tu = libclang::clang().parseTranslationUnit(
+                            index,
+                            request.file.c_str(),
+                            argsArray.args(),
+                            argsArray.argCount(),
+                            NULL, 0, // no unsaved files
+                            CXTranslationUnit_None |
+                            CXTranslationUnit_Incomplete);
+      if (tu != NULL)
+      {
+         // visit the cursors
+         DefinitionVisitor visitor =
+            boost::bind(insertDefinition, _1, &result.definitions);
+         libclang::clang().visitChildren(
+              libclang::clang().getTranslationUnitCursor(tu),
+              cursorVisitor,
+              (CXClientData)&visitor);
+
+         // dispose translation unit
+         libclang::clang().disposeTranslationUnit(tu);
+      }
+   }
+
+   // always return the result so that the main thread can account for it
+   s_pIndexResults->enque(result);
+}
+
+void indexThreadMain(int verbose)
+{
+   CXIndex index = libclang::clang().createIndex(1 /* Exclude PCH */, verbose);
+
+   while (true)
+   {
+      IndexRequest request;
+      while (!s_pIndexRequests->deque(&request))
+         s_pIndexRequests->wait();
+
+      try
+      {
+         indexTranslationUnit(index, request);
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+}
+
+void startIndexThreads()
+{
+   if (s_pIndexRequests != NULL)
+      return;
+
+   s_pIndexRequests = new thread::ThreadsafeQueue<IndexRequest>();
+   s_pIndexResults = new thread::ThreadsafeQueue<IndexResult>();
+   s_pIndexingCancelled = new thread::ThreadsafeValue<bool>(false);
+
+   // leave a core for the session (and the user's typing)
+   int threads = std::max(1,
+      std::min(4, static_cast<int>(boost::thread::hardware_concurrency()) - 1));
+   for (int i = 0; i < threads; i++)
+   {
+      thread::safeLaunchThread(boost::bind(indexThreadMain,
+                                           rSourceIndex().verbose() > 0));
+   }
+   s_maxPendingIndexCount = threads * 2;
+}
+
+bool mergeIndexResults();
+
+void dispatchIndexRequests()
+{
+   while (s_pendingIndexCount < s_maxPendingIndexCount &&
+          !s_indexQueue.empty())
+   {
+      IndexRequest request = s_indexQueue.front();
+      s_indexQueue.pop_front();
+
+      // skip requests superseded by a later change to the file
+      std::map<std::string, unsigned>::const_iterator it =
+                                    s_indexGenerations.find(request.file);
+      if (it == s_indexGenerations.end() || it->second != request.generation)
+         continue;
+
+      // get the compilation arguments for this file (the file can't be
+      // indexed without them)
+      request.compileArgs =
+         rCompilationDatabase().compileArgsForTranslationUnit(request.file,
+                                                              true);
+      if (request.compileArgs.empty())
+      {
+         s_indexGenerations.erase(request.file);
+         removeDefinitions(request.file);
+         continue;
+      }
+
+      s_pIndexRequests->enque(request);
+      ++s_pendingIndexCount;
+   }
+
+   if (s_pendingIndexCount > 0 && !s_mergingIndexResults)
+   {
+      s_mergingIndexResults = true;
+      module_context::schedulePeriodicWork(
+               boost::posix_time::milliseconds(100),
+               mergeIndexResults,
+               false /* merge even when non-idle */,
+               false /* not immediate */,
+               module_context::WorkPriorityLow);
+   }
+}
+
+bool mergeIndexResults()
+{
+   IndexResult result;
+   while (s_pIndexResults->deque(&result))
+   {
+      --s_pendingIndexCount;
+
+      // skip results which were superseded by a later change to the file
+      // (or its removal) while it was being indexed
+      const std::string& file = result.definitions.file;
+      std::map<std::string, unsigned>::iterator it =
+                                             s_indexGenerations.find(file);
+      if (it == s_indexGenerations.end() || it->second != result.generation)
+         continue;
+      s_indexGenerations.erase(it);
+
+      setDefinitions(result.definitions);
+   }
+
+   // hand the threads more work
+   dispatchIndexRequests();
+
+   s_mergingIndexResults = s_pendingIndexCount > 0;
+   return s_mergingIndexResults;
+}
+
+void cancelIndexing()
+{
+   // drop queued files and skip parsing those already handed to the threads
+   // (results still arriving are discarded)
+   s_indexQueue.clear();
+   s_indexGenerations.clear();
+   if (s_pIndexingCancelled != NULL)
+      s_pIndexingCancelled->set(true);
+}
+
 void fileChangeHandler(const core::system::FileChangeEvent& event)
 {
    // alias the filename
@@ -192,57 +716,26 @@ void fileChangeHandler(const core::system::FileChangeEvent& event)
       }
    }
 
-   // always remove existing definitions
-   s_definitionsByFile.erase(file);
-
-   // if this is an add or an update then re-index
+   // if this is an add or an update then re-index (the existing definitions
+   // are kept until the new ones are available)
    if (event.type() == core::system::FileChangeEvent::FileAdded ||
        event.type() == core::system::FileChangeEvent::FileModified)
-   {    
-      // get the compilation arguments for this file and use them to
-      // create a translation unit
-      std::vector<std::string> compileArgs =
-         rCompilationDatabase().compileArgsForTranslationUnit(file, true);
+   {
+      startIndexThreads();
 
-      if (!compileArgs.empty())
-      {
-         // create index
-         CXIndex index = libclang::clang().createIndex(
-                   1 /* Exclude PCH */,
-                   (rSourceIndex().verbose() > 0) ? 1 : 0);
-
-         // get args in form clang expects
-         core::system::ProcessArgs argsArray(compileArgs);
-
-         // parse the translation unit
-         CXTranslationUnit tu = libclang::clang().parseTranslationUnit(
-                               index,
-                               file.c_str(),
-                               argsArray.args(),
-                               argsArray.argCount(),
-                               NULL, 0, // no unsaved files
-                               CXTranslationUnit_None |
-                               CXTranslationUnit_Incomplete);
-
-
-         // create definitions and wire visitor to it
-         CppDefinitions definitions;
-         definitions.file = file;
-         definitions.fileLastWrite = event.fileInfo().lastWriteTime();
-         s_definitionsByFile[file] = definitions;
-         DefinitionVisitor visitor =
-            boost::bind(insertDefinition, _1, &s_definitionsByFile[file]);
+      IndexRequest request;
+      request.file = file;
+      request.fileLastWrite = event.fileInfo().lastWriteTime();
+      request.generation = ++s_nextGeneration;
+      s_indexGenerations[file] = request.generation;
+      s_indexQueue.push_back(request);
 
-         // visit the cursors
-         libclang::clang().visitChildren(
-              libclang::clang().getTranslationUnitCursor(tu),
-              cursorVisitor,
-              (CXClientData)&visitor);
-
-         // dispose translation unit and index
-         libclang::clang().disposeTranslationUnit(tu);
-         libclang::clang().disposeIndex(index);
-      }
+      dispatchIndexRequests();
+   }
+   else
+   {
+      s_indexGenerations.erase(file);
+      removeDefinitions(file);
    }
 }
 
@@ -358,15 +851,10 @@ FileLocation findDefinitionLocation(const FileLocation& location)
 
       // if we didn't find it there then look for it in our index
       // of all saved files
-      BOOST_FOREACH(const DefinitionsByFile::value_type& defs,
-                    s_definitionsByFile)
-      {
-         BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
-         {
-            if (def.USR == USR)
-               return def.location;
-         }
-      }
+      ensureLookupIndex();
+      UsrIndex::const_iterator it = s_usrIndex.find(USR);
+      if (it != s_usrIndex.end())
+         return it->second.pDefinition->location;
    }
 
    // see if we can resolve the cursor to a definition (if we can't
@@ -409,52 +897,6 @@ bool insertMatching(const std::string& term,
 }
 
 
-json::Object cppDefinitionToJson(const CppDefinition& definition)
-{
-   using namespace safe_convert;
-   json::Object definitionJson;
-   definitionJson["usr"] = definition.USR;
-   definitionJson["kind"] = numberTo<int>(definition.kind, 0);
-   definitionJson["parent_name"] = definition.parentName;
-   definitionJson["name"] = definition.name;
-   definitionJson["file"] = definition.location.filePath.absolutePath();
-   definitionJson["line"] = numberTo<int>(definition.location.line, 1);
-   definitionJson["column"] = numberTo<int>(definition.location.column, 1);
-   return definitionJson;
-}
-
-CppDefinition cppDefinitionFromJson(const json::Object& object)
-{
-   // read json
-   int kind;
-   int line, column;
-   std::string file;
-   CppDefinition definition;
-   Error error = json::readObject(object,
-                                  "usr", &definition.USR,
-                                  "kind", &kind,
-                                  "parent_name", &definition.parentName,
-                                  "name", &definition.name,
-                                  "file", &file,
-                                  "line", &line,
-                                  "column", &column);
-   if (error)
-   {
-      LOG_ERROR(error);
-      return CppDefinition();
-   }
-
-   // required data transforms
-   using namespace safe_convert;
-   definition.kind = static_cast<CppDefinitionKind>(kind);
-   definition.location.filePath = FilePath(file);
-   definition.location.line = numberTo<unsigned>(line, 1);
-   definition.location.column = numberTo<unsigned>(column, 1);
-
-   // return definition
-   return definition;
-}
-
 FilePath definitionIndexFilePath()
 {
    return module_context::scopedScratchPath().childPath("cpp-definition-cache");
@@ -462,104 +904,112 @@ FilePath definitionIndexFilePath()
 
 void loadDefinitionIndex()
 {
-   using namespace safe_convert;
-
    FilePath indexFilePath = definitionIndexFilePath();
    if (!indexFilePath.exists())
       return;
 
-   std::string contents;
-   Error error = readStringFromFile(indexFilePath, &contents);
+   Error error = s_definitionCacheFile.open(indexFilePath);
    if (error)
    {
       LOG_ERROR(error);
       return;
    }
 
-   json::Value indexValueJson;
-   if (!json::parse(contents, &indexValueJson) ||
-       !json::isType<json::Array>(indexValueJson))
+   // ignore caches in other formats (e.g. the JSON written by earlier
+   // versions); their files will simply be re-indexed
+   const char* pos = s_definitionCacheFile.begin();
+   const char* end = s_definitionCacheFile.end();
+   boost::uint32_t version, count;
+   if (s_definitionCacheFile.size() < 4 ||
+       std::memcmp(pos, kDefinitionCacheMagic, 4) != 0)
+   {
+      s_definitionCacheFile.close();
+      return;
+   }
+   pos += 4;
+   if (!readValue(&pos, end, &version) ||
+       version != kDefinitionCacheVersion ||
+       !readValue(&pos, end, &count))
    {
-      LOG_ERROR_MESSAGE("Error parsing definition index: " + contents);
+      s_definitionCacheFile.close();
       return;
    }
 
-   json::Array indexJson = indexValueJson.get_array();
-   BOOST_FOREACH(const json::Value& definitionsJson, indexJson)
+   // read just the header of each section (the definitions are decoded
+   // when they're first needed)
+   for (boost::uint32_t i = 0; i < count; i++)
    {
-      if (!json::isType<json::Object>(definitionsJson))
+      boost::uint32_t sectionSize;
+      if (!readValue(&pos, end, &sectionSize) ||
+          static_cast<std::size_t>(end - pos) < sectionSize)
       {
-         LOG_ERROR_MESSAGE("Unexpected non-object type in definition index");
-         continue;
+         LOG_ERROR_MESSAGE("Truncated definition cache");
+         break;
       }
 
-      json::Array defsArrayJson;
-      double fileLastWrite;
       CppDefinitions definitions;
-      Error error = json::readObject(definitionsJson.get_obj(),
-                                     "file", &definitions.file,
-                                     "file_last_write", &fileLastWrite,
-                                     "definitions", &defsArrayJson);
-      if (error)
-      {
-         LOG_ERROR(error);
+      definitions.pSection = pos;
+      definitions.sectionSize = sectionSize;
+      const char* sectionPos = pos;
+      pos += sectionSize;
+      if (!readSectionHeader(&sectionPos, pos, &definitions))
          continue;
-      }
-      definitions.fileLastWrite = numberTo<std::time_t>(fileLastWrite, 0);
 
       // if the file doesn't exist then bail
       if (!FilePath::exists(definitions.file))
          continue;
 
-      BOOST_FOREACH(const json::Value& defJson, defsArrayJson)
-      {
-         if (!json::isType<json::Object>(defJson))
-         {
-            LOG_ERROR_MESSAGE("Unexpected non-object type in definition index");
-            continue;
-         }
-
-         CppDefinition definition = cppDefinitionFromJson(defJson.get_obj());
-         if (!definition.empty())
-            definitions.definitions.push_back(definition);
-      }
-
-      s_definitionsByFile[definitions.file] = definitions;
+      setDefinitions(definitions);
    }
 }
 
 
 void saveDefinitionIndex()
 {
-   using namespace safe_convert;
-
-   json::Array indexJson;
+   std::string buffer;
+   buffer.append(kDefinitionCacheMagic, 4);
+   appendValue(kDefinitionCacheVersion, &buffer);
+   appendValue(static_cast<boost::uint32_t>(s_definitionsByFile.size()),
+               &buffer);
    BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
    {
+      // sections which were never decoded are copied as-is
       const CppDefinitions& definitions = defs.second;
-      json::Object definitionsJson;
-      definitionsJson["file"] = definitions.file;
-      definitionsJson["file_last_write"] = numberTo<double>(
-                                               definitions.fileLastWrite, 0);
-      json::Array defsArrayJson;
-      std::transform(definitions.definitions.begin(),
-                     definitions.definitions.end(),
-                     std::back_inserter(defsArrayJson),
-                     cppDefinitionToJson);
-      definitionsJson["definitions"] = defsArrayJson;
-
-      indexJson.push_back(definitionsJson);
-   }
-
-   std::ostringstream ostr;
-   json::writeFormatted(indexJson, ostr);
-   Error error = writeStringToFile(definitionIndexFilePath(), ostr.str());
+      if (definitions.pSection != NULL)
+      {
+         appendValue(static_cast<boost::uint32_t>(definitions.sectionSize),
+                     &buffer);
+         buffer.append(definitions.pSection, definitions.sectionSize);
+      }
+      else
+      {
+         encodeSection(definitions, &buffer);
+      }
+   }
+
+   // release the mapping before overwriting the file (definitions which
+   // were never decoded are no longer available)
+   s_definitionCacheFile.close();
+   DefinitionsByFile::iterator it = s_definitionsByFile.begin();
+   while (it != s_definitionsByFile.end())
+   {
+      if (it->second.pSection != NULL)
+         s_definitionsByFile.erase(it++);
+      else
+         ++it;
+   }
+
+   Error error = writeStringToFile(definitionIndexFilePath(), buffer);
    if (error)
       LOG_ERROR(error);
 }
 
 void onShutdown(bool terminatedNormally)
 {
+   // stop indexing (e.g. we're switching projects); files which weren't
+   // indexed will be picked up again by the next session
+   cancelIndexing();
+
    if (terminatedNormally)
       saveDefinitionIndex();
 }
@@ -598,16 +1048,25 @@ void searchDefinitions(const std::string& term,
    // for within the in-memory index)
    // if we didn't find it there then look for it in our index
    // of all saved files
-   BOOST_FOREACH(const DefinitionsByFile::value_type& defs, s_definitionsByFile)
+   ensureLookupIndex();
+   boost::uint64_t termMask = characterMask(term);
+   BOOST_FOREACH(const NameIndex::value_type& name, s_nameIndex)
    {
-      // skip files we've already searched
-      if (units.find(defs.first) != units.end())
+      // skip names which don't contain all of the term's characters
+      if ((name.second.mask & termMask) != termMask)
          continue;
 
-      BOOST_FOREACH(const CppDefinition& def, defs.second.definitions)
+      const std::vector<IndexedDefinition>& named = name.second.definitions;
+      if (!matches(term, pattern, *named.front().pDefinition))
+         continue;
+
+      BOOST_FOREACH(const IndexedDefinition& indexed, named)
       {
-         if (matches(term, pattern, def))
-            pDefinitions->push_back(def);
+         // skip files we've already searched
+         if (units.find(*indexed.pFile) != units.end())
+            continue;
+
+         pDefinitions->push_back(*indexed.pDefinition);
       }
    }
 }
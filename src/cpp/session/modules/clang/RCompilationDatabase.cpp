@@ -700,9 +700,22 @@ std::vector<std::string> RCompilationDatabase::compileArgsForTranslationUnit(
    // get a file path object
    FilePath filePath(filename);
 
+   // return the args we computed before if none of the files they were
+   // derived from have changed
+   bool isPackageFile = isProjectTranslationUnit(filePath.absolutePath());
+   std::string hash = isPackageFile ? packageBuildFileHash() :
+                                      buildFileHash(filePath);
+   ArgsCache::const_iterator cachedIt = argsCache_.find(filename);
+   if (cachedIt != argsCache_.end() &&
+       cachedIt->second.hash == hash &&
+       cachedIt->second.usePrecompiledHeaders == usePrecompiledHeaders)
+   {
+      return cachedIt->second.args;
+   }
+
    // if this is a package source file then return the package args
    CompilationConfig config;
-   if (isProjectTranslationUnit(filePath.absolutePath()))
+   if (isPackageFile)
    {
       // (re-)create on demand
       updateForCurrentPackage();
@@ -760,6 +773,16 @@ std::vector<std::string> RCompilationDatabase::compileArgsForTranslationUnit(
       args.push_back("c++");
    }
 
+   // remember the args (failures aren't remembered so that they're
+   // retried, e.g. once a missing package is installed)
+   if (!hash.empty() && !args.empty())
+   {
+      CachedArgs& cached = argsCache_[filename];
+      cached.hash = hash;
+      cached.usePrecompiledHeaders = usePrecompiledHeaders;
+      cached.args = args;
+   }
+
    // return args
    return args;
 }
@@ -939,6 +962,18 @@ std::vector<std::string> RCompilationDatabase::precompiledHeaderArgs(
    // args to return
    std::vector<std::string> args;
 
+   // use the args we computed for another translation unit if the package
+   // hasn't been re-installed and the precompiled header is still there
+   // (this avoids calling R for every translation unit)
+   std::string cacheKey = pkgName + stdArg;
+   PCHArgsCache::const_iterator cachedIt = pchArgsCache_.find(cacheKey);
+   if (cachedIt != pchArgsCache_.end() &&
+       buildFileHash(cachedIt->second.descriptionPath) == cachedIt->second.hash &&
+       FilePath(cachedIt->second.args.back()).exists())
+   {
+      return cachedIt->second.args;
+   }
+
    // precompiled header dir
    FilePath precompiledDir = precompiledHeaderDir(pkgName);
 
@@ -951,6 +986,7 @@ std::vector<std::string> RCompilationDatabase::precompiledHeaderArgs(
       LOG_ERROR(error);
       return std::vector<std::string>();
    }
+   FilePath descriptionPath = FilePath(pkgPath).childPath("DESCRIPTION");
    pkgPath = core::hash::crc32HexHash(pkgPath);
    precompiledDir = precompiledDir.childPath(pkgPath);
 
@@ -1072,6 +1108,13 @@ std::vector<std::string> RCompilationDatabase::precompiledHeaderArgs(
    // reutrn the pch header file args
    args.push_back("-include-pch");
    args.push_back(pchPath.absolutePath());
+
+   // remember them for the package's other translation units
+   CachedPCHArgs& cached = pchArgsCache_[cacheKey];
+   cached.descriptionPath = descriptionPath;
+   cached.hash = buildFileHash(descriptionPath);
+   cached.args = args;
+
    return args;
 }
 
@@ -112,6 +112,29 @@ private:
    std::string packageBuildFileHash_;
    CompilationConfig packageCompilationConfig_;
    bool usePrecompiledHeaders_;
+
+   // compile args by translation unit (valid while the hash of the files
+   // they were derived from is unchanged, so R isn't consulted again)
+   struct CachedArgs
+   {
+      std::string hash;
+      bool usePrecompiledHeaders;
+      std::vector<std::string> args;
+   };
+   typedef std::map<std::string,CachedArgs> ArgsCache;
+   ArgsCache argsCache_;
+
+   // precompiled header args by package and -std argument, shared by all
+   // translation units (valid while the package's installed DESCRIPTION
+   // and the precompiled header are unchanged)
+   struct CachedPCHArgs
+   {
+      core::FilePath descriptionPath;
+      std::string hash;
+      std::vector<std::string> args;
+   };
+   typedef std::map<std::string,CachedPCHArgs> PCHArgsCache;
+   PCHArgsCache pchArgsCache_;
    bool restoredCompilationConfig_;
 };
 
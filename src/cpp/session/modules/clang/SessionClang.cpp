@@ -26,6 +26,7 @@
 #include <r/RRoutines.hpp>
 #include <r/ROptions.hpp>
 
+#include <session/SessionMemoryUsage.hpp>
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionUserSettings.hpp>
 
@@ -171,6 +172,12 @@ void onAllSourceDocsRemoved(boost::shared_ptr<IdToFile> pIdToFile)
    pIdToFile->clear();
 }
 
+void onReclaimMemory()
+{
+   // translation units are re-parsed when next needed
+   rSourceIndex().removeAllTranslationUnits();
+}
+
 bool cppIndexingDisabled()
 {
    return ! r::options::getOption<bool>("rstudio.indexCpp", true, false);
@@ -214,6 +221,11 @@ SEXP rs_setClangDiagnostics(SEXP levelSEXP)
    return R_NilValue;
 }
 
+std::size_t translationUnitsMemoryUsage()
+{
+   return rSourceIndex().memoryUsage();
+}
+
 } // anonymous namespace
    
 bool isAvailable()
@@ -260,6 +272,14 @@ Error initialize()
    // enable crash recovery
    libclang::clang().toggleCrashRecovery(1);
 
+   // limit the memory used by translation units (0 for no limit)
+   double limitMb = r::options::getOption<double>(
+                        "rstudio.indexCppMemoryLimit",
+                        rSourceIndex().memoryLimit() / (1024.0 * 1024.0),
+                        false);
+   rSourceIndex().setMemoryLimit(
+         static_cast<std::size_t>(std::max(limitMb, 0.0) * 1024 * 1024));
+
    // initialize definition index
    error = initializeDefinitionIndex();
    if (error)
@@ -277,6 +297,11 @@ Error initialize()
    source_database::events().onRemoveAll.connect(
              boost::bind(onAllSourceDocsRemoved, pIdToFile));
 
+   // release translation units when the session is idle
+   module_context::events().onReclaimMemory.connect(onReclaimMemory);
+   memory_usage::registerReporter("clang_translation_units",
+                                  translationUnitsMemoryUsage);
+
    return Success();
 }
 
@@ -0,0 +1,238 @@
+/*
+ * DataImportPreview.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataImportPreview.hpp"
+
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <core/Exec.hpp>
+#include <core/MappedFile.hpp>
+#include <core/Thread.hpp>
+#include <core/text/DelimitedPreview.hpp>
+
+#include <r/ROptions.hpp>
+
+#include <session/SessionModuleContext.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace import_preview {
+
+namespace {
+
+const std::size_t kPreviewRows = 20;
+
+// default.stringsAsFactors() (read on the main thread, since previews are
+// computed on the worker pool)
+boost::mutex s_stringsAsFactorsMutex;
+bool s_defaultStringsAsFactors = true;
+
+void updateDefaultStringsAsFactors()
+{
+   bool stringsAsFactors = r::options::getOption<bool>("stringsAsFactors",
+                                                       true,
+                                                       false);
+   LOCK_MUTEX(s_stringsAsFactorsMutex)
+   {
+      s_defaultStringsAsFactors = stringsAsFactors;
+   }
+   END_LOCK_MUTEX
+}
+
+void onConsolePrompt(const std::string&)
+{
+   updateDefaultStringsAsFactors();
+}
+
+bool defaultStringsAsFactors()
+{
+   LOCK_MUTEX(s_stringsAsFactorsMutex)
+   {
+      return s_defaultStringsAsFactors;
+   }
+   END_LOCK_MUTEX
+
+   return true;
+}
+
+// the client reads results as they were marshalled from R, where
+// scalars are vectors of length one
+template <typename T>
+json::Array scalar(const T& value)
+{
+   json::Array array;
+   array.push_back(value);
+   return array;
+}
+
+std::string charAsString(char ch)
+{
+   return ch == '\0' ? std::string() : std::string(1, ch);
+}
+
+char stringAsChar(const std::string& str)
+{
+   return str.empty() ? '\0' : str[0];
+}
+
+Error readPreview(const std::string& path,
+                  const text::DelimitedFormat* pFormat,
+                  text::DelimitedFormat* pSniffedFormat,
+                  text::DelimitedPreview* pPreview)
+{
+   FilePath filePath = module_context::resolveAliasedPath(path);
+
+   // only the pages of the mapping holding the beginning of the file are
+   // ever read, so previews of large files are as quick as small ones
+   MappedFile file;
+   Error error = file.open(filePath);
+   if (error)
+      return error;
+
+   text::DelimitedFormat format = pFormat != NULL ?
+            *pFormat :
+            text::sniffDelimitedFormat(file.begin(), file.end(), kPreviewRows);
+   text::previewDelimited(file.begin(), file.end(), format, kPreviewRows,
+                          pPreview);
+
+   if (pSniffedFormat != NULL)
+      *pSniffedFormat = format;
+   return Success();
+}
+
+void setOutput(const text::DelimitedPreview& preview, json::Object* pResult)
+{
+   json::Array output;
+   for (std::size_t i = 0; i < preview.rows.size(); i++)
+   {
+      json::Object row;
+      for (std::size_t j = 0; j < preview.names.size(); j++)
+      {
+         const text::DelimitedValue& value = preview.rows[i][j];
+         row[preview.names[j]] = value.isNA ? json::Value()
+                                            : json::Value(value.text);
+      }
+      output.push_back(row);
+   }
+
+   json::Array names;
+   for (std::size_t i = 0; i < preview.names.size(); i++)
+      names.push_back(preview.names[i]);
+
+   (*pResult)["output"] = output;
+   (*pResult)["outputNames"] = names;
+   (*pResult)["defaultStringsAsFactors"] = scalar(defaultStringsAsFactors());
+}
+
+Error getDataPreview(const json::JsonRpcRequest& request,
+                     json::JsonRpcResponse* pResponse)
+{
+   std::string path;
+   Error error = json::readParams(request.params, &path);
+   if (error)
+      return error;
+
+   text::DelimitedFormat format;
+   text::DelimitedPreview preview;
+   error = readPreview(path, NULL, &format, &preview);
+   if (error)
+      return error;
+
+   json::Object result;
+   result["inputLines"] = scalar(boost::algorithm::join(preview.lines, "\n"));
+   setOutput(preview, &result);
+   result["encoding"] = scalar(preview.encoding);
+   result["header"] = scalar(format.header);
+   result["separator"] = scalar(charAsString(format.separator));
+   result["decimal"] = scalar(charAsString(format.decimal));
+   result["quote"] = scalar(charAsString(format.quote));
+   result["comment"] = scalar(charAsString(format.comment));
+   pResponse->setResult(result);
+
+   return Success();
+}
+
+Error getOutputPreview(const json::JsonRpcRequest& request,
+                       json::JsonRpcResponse* pResponse)
+{
+   std::string path, encoding, separator, decimal, quote, comment;
+   bool header = false;
+   Error error = json::readParams(request.params,
+                                  &path,
+                                  &encoding,
+                                  &header,
+                                  &separator,
+                                  &decimal,
+                                  &quote,
+                                  &comment);
+   if (error)
+      return error;
+
+   // (the encoding is only used to mark the strings read, so it doesn't
+   // affect the preview)
+   text::DelimitedFormat format;
+   format.header = header;
+   format.separator = stringAsChar(separator);
+   format.decimal = decimal.empty() ? '.' : decimal[0];
+   format.quote = stringAsChar(quote);
+   format.comment = stringAsChar(comment);
+
+   text::DelimitedPreview preview;
+   error = readPreview(path, &format, NULL, &preview);
+   if (error)
+      return error;
+
+   json::Object result;
+   setOutput(preview, &result);
+   result["header"] = scalar(header);
+   result["encoding"] = scalar(encoding);
+   result["separator"] = scalar(separator);
+   result["quote"] = scalar(quote);
+   result["comment"] = scalar(comment);
+   pResponse->setResult(result);
+
+   return Success();
+}
+
+} // anonymous namespace
+
+Error initialize()
+{
+   updateDefaultStringsAsFactors();
+   module_context::events().onConsolePrompt.connect(onConsolePrompt);
+
+   using boost::bind;
+   using namespace module_context;
+   ExecBlock initBlock;
+   initBlock.addFunctions()
+      (bind(registerWorkerSafeRpcMethod, "get_data_preview", getDataPreview))
+      (bind(registerWorkerSafeRpcMethod, "get_output_preview",
+                                                   getOutputPreview));
+   return initBlock.execute();
+}
+
+} // namespace import_preview
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -14,6 +14,10 @@
  */
 
 #include "DataViewer.hpp"
+#include "DataViewerCache.hpp"
+#include "DataViewerIndex.hpp"
+#include "DataViewerPages.hpp"
+#include "DataViewerSummary.hpp"
 
 #include <string>
 #include <vector>
@@ -21,6 +25,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include <core/Log.hpp>
@@ -31,6 +36,8 @@
 #include <core/StringUtils.hpp>
 #include <core/SafeConvert.hpp>
 
+#include <core/json/JsonWriter.hpp>
+
 #define R_INTERNAL_FUNCTIONS
 #include <r/RInternal.hpp>
 #include <r/RSexp.hpp>
@@ -40,6 +47,7 @@
 #include <r/RFunctionHook.hpp>
 #include <r/RRoutines.hpp>
 
+#include <session/SessionMemoryUsage.hpp>
 #include <session/SessionModuleContext.hpp>
 #include <session/SessionContentUrls.hpp>
 
@@ -52,9 +60,6 @@
 #define kGridResourceLocation "/" kGridResource "/"
 #define kNoBoundEnv "_rs_no_env"
 
-// separates filter type from contents (e.g. "numeric|12-25")
-#define kFilterSeparator "|"
-
 // the largest number of columns we're willing to display
 #define MAX_COLS 100  
 
@@ -101,8 +106,11 @@ namespace {
  *    objects have randomly generated cache keys. 
  *
  *    When the session suspends/resumes, the contents of the cache environment
- *    are written as individual .RData files to the user scratch folder. This
- *    allows us to reload the data for viewing afterwards.
+ *    are written as individual files to the user scratch folder (in a
+ *    columnar format when we can; see DataViewerCache.hpp). This allows us
+ *    to reload the data for viewing afterwards. Objects which are still
+ *    bound in the global environment aren't written when suspending, since
+ *    they're saved (and restored) along with it.
  *
  *    The client is responsible for letting the server know when the viewer has
  *    closed; when this happens, the server removes the in-memory and disk 
@@ -127,75 +135,22 @@ namespace {
  *    This allows us to efficiently perform operations on very large datasets
  *    once they've been winnowed down to smaller objects using searches and
  *    filters.
+ *
+ * INDEXED:
+ *    Most frames don't need a working copy at all: FrameIndex sorts, filters
+ *    and searches columns of simple types natively, producing the indices of
+ *    the rows to show rather than a transformed copy of the object. Only
+ *    the rows on the requested page are extracted (in R) for formatting.
+ *    The working copy is used for frames the index doesn't support.
+ *
+ * PAGES:
+ *    Finally, pages of frames with simple column types are formatted in C++
+ *    from a snapshot of the columns shown (see DataViewerPages.hpp) rather
+ *    than with format() in R. Once a view has a snapshot, further pages are
+ *    served from it on the worker pool, so the viewer can be scrolled while
+ *    R is busy.
  */    
 
-// indicates whether one filter string is a subset of another; e.g. if a column
-// is filtered for "abc" and then "abcd", the new state is a subset of the
-// previous state.
-bool isFilterSubset(const std::string& outer, const std::string& inner) 
-{
-   // shortcut for identical filters (the typical case)
-   if (inner == outer) 
-      return true;
-
-   // find filter separators; if we can't find them, presume no subset since we
-   // can't parse filters
-   size_t outerPipe = outer.find(kFilterSeparator);
-   if (outerPipe == std::string::npos) 
-      return false;
-   size_t innerPipe = inner.find(kFilterSeparator);
-   if (innerPipe == std::string::npos)
-      return false;
-
-   std::string outerType(outer.substr(0, outerPipe));
-   std::string innerType(inner.substr(0, innerPipe));
-   std::string outerValue(outer.substr(outerPipe + 1, 
-            outer.length() - outerPipe));
-   std::string innerValue(inner.substr(innerPipe + 1, 
-            inner.length() - innerPipe));
-   
-   // only identical types can be subsets
-   if (outerType != innerType) 
-      return false;
-
-   if (outerType == "numeric")
-   {
-      // matches a numeric filter (i.e. "2.71_3.14") -- in this case we need to
-      // check the components for range inclusion
-      boost::regex numFilter("(-?\\d+\\.?\\d*)_(-?\\d+\\.?\\d*)");
-      boost::smatch innerMatch, outerMatch;
-      if (boost::regex_search(innerValue, innerMatch, numFilter) &&
-          boost::regex_search(outerValue, outerMatch, numFilter))
-      {
-         // for numeric filters, the inner is a subset if its lower bound (1)
-         // is larger than the outer lower bound, and the upper bound (2) is
-         // smaller than the outer upper bound
-         return safe_convert::stringTo<double>(innerMatch[1], 0) >= 
-                safe_convert::stringTo<double>(outerMatch[1], 0) &&
-                safe_convert::stringTo<double>(innerMatch[2], 0) <= 
-                safe_convert::stringTo<double>(outerMatch[2], 0);
-      }
-
-      // if not identical and not a range, then not a subset
-      return false;
-   } 
-   else if (outerType == "factor" || outerType == "boolean")
-   {
-      // factors and boolean values have to be identical for subsetting, and we
-      // already checked above
-      return false;
-   }
-   else if (outerType == "character")
-   {
-      // characters are a subset if the outer string is within the inner one
-      // (i.e. a seach for "walnuts" (inner) is within "walnut" (outer))
-      return inner.find(outer) != std::string::npos;
-   }
-   
-   // unknown filter type
-   return false;
-}
-
 typedef enum 
 {
   DIM_ROWS,
@@ -296,6 +251,31 @@ struct CachedFrame
 // The set of active frames. Used primarily to check each for changes.
 std::map<std::string, CachedFrame> s_cachedFrames;
 
+// The native sort/filter indexes of the frames being viewed, by cache key.
+std::map<std::string, boost::shared_ptr<FrameIndex> > s_frameIndexes;
+
+std::size_t frameIndexesMemoryUsage()
+{
+   std::size_t bytes = 0;
+   for (std::map<std::string, boost::shared_ptr<FrameIndex> >::const_iterator
+           it = s_frameIndexes.begin(); it != s_frameIndexes.end(); ++it)
+   {
+      bytes += it->first.capacity() + it->second->memoryUsage();
+   }
+   return bytes;
+}
+
+boost::shared_ptr<FrameIndex> frameIndex(const std::string& cacheKey,
+                                         SEXP dataSEXP,
+                                         int nrow)
+{
+   // start a new index if the data has been replaced
+   boost::shared_ptr<FrameIndex>& pIndex = s_frameIndexes[cacheKey];
+   if (!pIndex || pIndex->frame() != dataSEXP)
+      pIndex.reset(new FrameIndex(dataSEXP, nrow));
+   return pIndex;
+}
+
 std::string viewerCacheDir() 
 {
    return module_context::scopedScratchPath().childPath(kViewerCacheDir)
@@ -430,13 +410,33 @@ void handleGridResReq(const http::Request& request,
    pResponse->setCacheableFile(gridResource, request);
 }
 
-json::Value getCols(SEXP dataSEXP)
+// summarizes a column for its filter (called from .rs.describeCols)
+SEXP rs_summarizeDataColumn(SEXP columnSEXP, SEXP cacheKeySEXP, 
+                            SEXP indexSEXP)
+{
+   r::sexp::Protect protect;
+   const ColumnSummary& summary = columnSummary(
+         r::sexp::safeAsString(cacheKeySEXP), r::sexp::asInteger(indexSEXP),
+         columnSEXP);
+
+   r::sexp::ListBuilder builder(&protect);
+   builder.add("supported", summary.supported);
+   builder.add("min", summary.min);
+   builder.add("max", summary.max);
+   builder.add("finite_count", summary.finiteCount);
+   builder.add("na_count", summary.naCount);
+   builder.add("distinct_count", summary.distinctCount);
+   builder.add("counts", summary.counts);
+   return r::sexp::create(builder, &protect);
+}
+
+json::Value getCols(SEXP dataSEXP, const std::string& cacheKey)
 {
    SEXP colsSEXP = R_NilValue;
    r::sexp::Protect protect;
    json::Value result;
    Error error = r::exec::RFunction(".rs.describeCols", dataSEXP, MAX_COLS, 
-         MAX_FACTORS)
+         MAX_FACTORS, cacheKey)
       .call(&colsSEXP, &protect);
    if (error || colsSEXP == R_NilValue) 
    {
@@ -454,9 +454,88 @@ json::Value getCols(SEXP dataSEXP)
    return result;
 }
 
+// reads the ordering, filters (for each of ncol columns) and search of a
+// request for grid data
+GridQuery readGridQuery(const http::Fields& fields, int ncol)
+{
+   GridQuery query;
+   query.orderCol = http::util::fieldValue<int>(fields, "order[0][column]", 
+         -1);
+   query.orderDir = http::util::fieldValue<std::string>(fields, 
+         "order[0][dir]", "asc");
+   query.search = http::util::urlDecode(
+         http::util::fieldValue<std::string>(fields, "search[value]", ""), 
+         true);
+   for (int i = 1; i <= ncol; i++) 
+   {
+      query.filters.push_back(http::util::urlDecode( 
+            http::util::fieldValue<std::string>(fields,
+                  "columns[" + boost::lexical_cast<std::string>(i) + "]" 
+                  "[search][value]", ""), true));
+   }
+   return query;
+}
+
+// writes a page of grid data in the form DataTables expects
+void writeGridPage(int draw,
+                   int nrow,
+                   int filteredNRow,
+                   const GridPage& page,
+                   json::Writer* pWriter)
+{
+   pWriter->startObject();
+   pWriter->member("draw", draw);
+   pWriter->member("recordsTotal", nrow);
+   pWriter->member("recordsFiltered", filteredNRow);
+   pWriter->key("data");
+   pWriter->startArray();
+   for (int row = 0; row < page.length; row++)
+   {
+      pWriter->startArray();
+      if (!page.rowNames[row].empty())
+         pWriter->value(page.rowNames[row]);
+      else
+         pWriter->value(page.rowNumbers[row]);
+
+      for (int col = 0; col < page.ncol; col++)
+      {
+         int cell = col * page.length + row;
+         if (page.na[cell])
+            pWriter->value(SPECIAL_CELL_NA);
+         else
+            pWriter->value(page.cells[cell]);
+      }
+      pWriter->endArray();
+   }
+   pWriter->endArray();
+   pWriter->endObject();
+}
+
+// There are some unprintable ASCII control characters that are written
+// verbatim by json::write, but that won't parse in most Javascript JSON
+// parsing implementations, even if contained in a string literal. Scan the
+// output data for these characters and replace them with spaces. Escaping
+// is another option here for some character ranges but since (a) these are
+// unprintable and (b) some characters are invalid *even if escaped* e.g.
+// \v, there's little to be gained here in trying to marshal them to the
+// viewer.
+void replaceControlChars(std::string* pOutput)
+{
+   std::string& output = *pOutput;
+   for (size_t i = 0; i < output.size(); i++) 
+   {
+      char c = output[i];
+      // These ranges for control character values come from empirical testing
+      if ((c >= 1 && c <= 7) || c == 11 || (c >= 14 && c <= 31))
+      {
+         output[i] = ' ';
+      }
+   }
+}
+
 // given an object from which to return data, and a description of the data to
 // return via URL-encoded paramters supplied by the DataTables API, returns the
-// data requested by the parameters. 
+// data requested by the parameters (written to pWriter). 
 //
 // the shape of the API is described here:
 // http://datatables.net/manual/server-side
@@ -464,7 +543,7 @@ json::Value getCols(SEXP dataSEXP)
 // NB: may throw exceptions! these are expected to be handled by the handlers
 // in getGridData, where they will be marshaled to JSON and displayed on the
 // client.
-json::Value getData(SEXP dataSEXP, const http::Fields& fields)
+void getData(SEXP dataSEXP, const http::Fields& fields, json::Writer* pWriter)
 {
    Error error;
    r::sexp::Protect protect;
@@ -473,13 +552,6 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    int draw = http::util::fieldValue<int>(fields, "draw", 0);
    int start = http::util::fieldValue<int>(fields, "start", 0);
    int length = http::util::fieldValue<int>(fields, "length", 0);
-   int ordercol = http::util::fieldValue<int>(fields, "order[0][column]", 
-         -1);
-   std::string orderdir = http::util::fieldValue<std::string>(fields, 
-         "order[0][dir]", "asc");
-   std::string search = http::util::urlDecode(
-         http::util::fieldValue<std::string>(fields, "search[value]", ""), 
-         true);
    std::string cacheKey = http::util::urlDecode(
          http::util::fieldValue<std::string>(fields, "cache_key", ""), 
          true);
@@ -489,25 +561,33 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    int filteredNRow = 0;
    ncol = std::min(ncol, MAX_COLS);
 
-   // extract filters
-   std::vector<std::string> filters;
+   // extract ordering, filters and search
+   GridQuery query = readGridQuery(fields, ncol);
+   int ordercol = query.orderCol;
+   const std::string& orderdir = query.orderDir;
+   const std::string& search = query.search;
+   const std::vector<std::string>& filters = query.filters;
    bool hasFilter = false;
-   for (int i = 1; i <= ncol; i++) 
+   for (std::size_t i = 0; i < filters.size(); i++) 
    {
-      std::string filterVal = http::util::urlDecode( 
-            http::util::fieldValue<std::string>(fields,
-                  "columns[" + boost::lexical_cast<std::string>(i) + "]" 
-                  "[search][value]", ""), true);
-      if (!filterVal.empty()) 
-      {
+      if (!filters[i].empty()) 
          hasFilter = true;
-      }
-      filters.push_back(filterVal);
    }
 
    bool needsTransform = ordercol > 0 || hasFilter || !search.empty();
    bool hasTransform = false;
 
+   // sort, filter and search natively if we can; this gives us the rows to
+   // show (in order) without making a transformed copy of the data
+   const std::vector<int>* pRows = NULL;
+   if (needsTransform)
+   {
+      pRows = frameIndex(cacheKey, dataSEXP, nrow)->rows(
+               filters, search, ordercol, orderdir);
+      if (pRows)
+         needsTransform = false;
+   }
+
    // check to see if we have an ordered/filtered view we can build from
    std::map<std::string, CachedFrame>::iterator cachedFrame = 
       s_cachedFrames.find(cacheKey);
@@ -579,19 +659,53 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    }
 
    // apply new row count if we've tansformed the data (or need to)
-   filteredNRow = needsTransform || hasTransform ?
-      safeDim(dataSEXP, DIM_ROWS) : 
-      nrow;
+   if (pRows)
+      filteredNRow = static_cast<int>(pRows->size());
+   else
+      filteredNRow = needsTransform || hasTransform ?
+         safeDim(dataSEXP, DIM_ROWS) : 
+         nrow;
+
+   // format the page natively if we can (this also lets the worker pool
+   // serve further pages of the view)
+   if (!cacheKey.empty())
+   {
+      updateGridSnapshot(cacheKey, query, dataSEXP, ncol, nrow, filteredNRow,
+                         pRows);
+
+      boost::shared_ptr<const GridPage> pPage;
+      int pageNRow, pageFilteredNRow;
+      if (readGridPage(cacheKey, query, start, length, &pPage, &pageNRow,
+                       &pageFilteredNRow))
+      {
+         writeGridPage(draw, pageNRow, pageFilteredNRow, *pPage, pWriter);
+         prefetchGridPages(cacheKey, query, pPage->start, pPage->length);
+         return;
+      }
+   }
 
    // return the lesser of the rows available and rows requested
    length = std::min(length, filteredNRow - start);
 
+   // when sorting/filtering natively, these are the (1-based) rows of the
+   // data on the requested page
+   SEXP rowsSEXP = R_NilValue;
+   if (pRows)
+   {
+      int pageLength = std::max(length, 0);
+      rowsSEXP = Rf_allocVector(INTSXP, pageLength);
+      protect.add(rowsSEXP);
+      for (int i = 0; i < pageLength; i++)
+         INTEGER(rowsSEXP)[i] = (*pRows)[start + i] + 1;
+   }
+
    // DataTables uses 0-based indexing, but R uses 1-based indexing
    start ++;
 
-   // extract the portion of the column vector requested by the client
-   SEXP formattedDataSEXP = Rf_allocVector(VECSXP, ncol);
-   protect.add(formattedDataSEXP);
+   // extract the portion of the column vector requested by the client. the
+   // columns and row names are formatted by one batch of R calls so that we
+   // only enter R once for the whole page.
+   r::exec::RFunctionBatch formatBatch;
    for (unsigned i = 0; i < static_cast<unsigned>(ncol); i++)
    {
       SEXP columnSEXP = VECTOR_ELT(dataSEXP, i);
@@ -601,27 +715,47 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
          throw r::exec::RErrorException("No data in column " + 
                boost::lexical_cast<std::string>(i));
       }
-      SEXP formattedColumnSEXP;
-      r::exec::RFunction formatFx(".rs.formatDataColumn");
-      formatFx.addParam(columnSEXP);
-      formatFx.addParam(static_cast<int>(start));
-      formatFx.addParam(static_cast<int>(length));
-      error = formatFx.call(&formattedColumnSEXP, &protect);
-      if (error)
-         throw r::exec::RErrorException(error.summary());
-      SET_VECTOR_ELT(formattedDataSEXP, i, formattedColumnSEXP);
-    }
+      if (pRows)
+         formatBatch.add(".rs.formatDataColumnAt", columnSEXP, rowsSEXP);
+      else
+         formatBatch.add(".rs.formatDataColumn", columnSEXP,
+                         static_cast<int>(start), static_cast<int>(length));
+   }
 
    // format the row names 
-   SEXP rownamesSEXP;
-   r::exec::RFunction(".rs.formatRowNames", dataSEXP, start, length)
-      .call(&rownamesSEXP, &protect);
+   if (pRows)
+      formatBatch.add(".rs.formatRowNamesAt", dataSEXP, rowsSEXP);
+   else
+      formatBatch.add(".rs.formatRowNames", dataSEXP, start, length);
+
+   error = formatBatch.execute();
+   if (error)
+      throw r::exec::RErrorException(error.summary());
+
+   SEXP formattedDataSEXP = Rf_allocVector(VECSXP, ncol);
+   protect.add(formattedDataSEXP);
+   for (unsigned i = 0; i < static_cast<unsigned>(ncol); i++)
+   {
+      if (formatBatch.error(i))
+         throw r::exec::RErrorException(formatBatch.error(i).summary());
+      SET_VECTOR_ELT(formattedDataSEXP, i, formatBatch.result(i));
+   }
+
+   // (errors formatting row names are ignored; rows are numbered instead)
+   SEXP rownamesSEXP = formatBatch.result(ncol);
    
-   // create the result grid as JSON
-   json::Array data;
+   // stream the result grid as JSON (avoids building a json::Value for
+   // every cell of the page)
+   pWriter->startObject();
+   pWriter->member("draw", draw);
+   pWriter->member("recordsTotal", nrow);
+   pWriter->member("recordsFiltered", filteredNRow);
+   pWriter->key("data");
+   pWriter->startArray();
    for (int row = 0; row < length; row++)
    {
-      json::Array rowData;
+      int rowNumber = pRows ? INTEGER(rowsSEXP)[row] : row + start;
+      pWriter->startArray();
       if (rownamesSEXP != NULL &&
           TYPEOF(rownamesSEXP) != NILSXP &&
           !Rf_isNull(rownamesSEXP) )
@@ -631,16 +765,16 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
              nameSEXP != NA_STRING &&
              r::sexp::length(nameSEXP) > 0)
          {
-            rowData.push_back(Rf_translateCharUTF8(nameSEXP));
+            pWriter->value(Rf_translateCharUTF8(nameSEXP));
          }
          else
          {
-            rowData.push_back(row + start);
+            pWriter->value(rowNumber);
          }
       }
       else
       {
-         rowData.push_back(row + start);
+         pWriter->value(rowNumber);
       }
 
       for (int col = 0; col<Rf_length(formattedDataSEXP); col++)
@@ -655,37 +789,33 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
                 stringSEXP != NA_STRING &&
                 r::sexp::length(stringSEXP) > 0)
             {
-               rowData.push_back(Rf_translateCharUTF8(stringSEXP));
+               pWriter->value(Rf_translateCharUTF8(stringSEXP));
             }
             else if (stringSEXP == NA_STRING) 
             {
-               rowData.push_back(SPECIAL_CELL_NA);
+               pWriter->value(SPECIAL_CELL_NA);
             }
             else
             {
-               rowData.push_back("");
+               pWriter->value("");
             }
          }
          else
          {
-            rowData.push_back("");
+            pWriter->value("");
          }
       }
-      data.push_back(rowData);
+      pWriter->endArray();
    }
-
-   json::Object result;
-   result["draw"] = draw;
-   result["recordsTotal"] = nrow;
-   result["recordsFiltered"] = filteredNRow;
-   result["data"] = data;
-   return result;
+   pWriter->endArray();
+   pWriter->endObject();
 }
 
 Error getGridData(const http::Request& request,
                   http::Response* pResponse)
 {
    json::Value result;
+   std::string output;
    http::status::Code status = http::status::Ok;
 
    try
@@ -749,11 +879,13 @@ Error getGridData(const http::Request& request,
       
          if (show == "cols")
          {
-            result = getCols(dataSEXP);
+            result = getCols(dataSEXP, cacheKey);
          }
          else if (show == "data")
          {
-            result = getData(dataSEXP, fields);
+            json::Writer writer;
+            getData(dataSEXP, fields, &writer);
+            output = writer.str();
          }
       }
 
@@ -769,27 +901,12 @@ Error getGridData(const http::Request& request,
    }
    CATCH_UNEXPECTED_EXCEPTION
 
-   std::ostringstream ostr;
-   json::write(result, ostr);
-
-   // There are some unprintable ASCII control characters that are written
-   // verbatim by json::write, but that won't parse in most Javascript JSON
-   // parsing implementations, even if contained in a string literal. Scan the
-   // output data for these characters and replace them with spaces. Escaping
-   // is another option here for some character ranges but since (a) these are
-   // unprintable and (b) some characters are invalid *even if escaped* e.g.
-   // \v, there's little to be gained here in trying to marshal them to the
-   // viewer.
-   std::string output = ostr.str();
-   for (size_t i = 0; i < output.size(); i++) 
-   {
-      char c = output[i];
-      // These ranges for control character values come from empirical testing
-      if ((c >= 1 && c <= 7) || c == 11 || (c >= 14 && c <= 31))
-      {
-         output[i] = ' ';
-      }
-   }
+   // (grid data is streamed directly into output, other results are
+   // written here)
+   if (output.empty())
+      output = json::write(result);
+
+   replaceControlChars(&output);
  
    pResponse->setNoCacheHeaders();    // don't cache data/grid shape
    pResponse->setStatusCode(status);
@@ -798,6 +915,51 @@ Error getGridData(const http::Request& request,
    return Success();
 }
 
+// serves pages of views which have a snapshot from the worker pool; other
+// requests are declined, and handled by getGridData on the main thread
+bool getGridDataFromSnapshot(const http::Request& request,
+                             http::Response* pResponse)
+{
+   http::Fields fields;
+   http::util::parseForm(request.body(), &fields);
+   std::string show = http::util::fieldValue<std::string>(
+         fields, "show", "data");
+   std::string cacheKey = http::util::urlDecode(
+         http::util::fieldValue<std::string>(fields, "cache_key", ""), 
+         true);
+   if (show != "data" || cacheKey.empty())
+      return false;
+
+   int ncol = gridSnapshotColumns(cacheKey);
+   if (ncol < 0)
+      return false;
+
+   GridQuery query = readGridQuery(fields, ncol);
+   int draw = http::util::fieldValue<int>(fields, "draw", 0);
+   int start = http::util::fieldValue<int>(fields, "start", 0);
+   int length = http::util::fieldValue<int>(fields, "length", 0);
+
+   boost::shared_ptr<const GridPage> pPage;
+   int nrow, filteredNRow;
+   if (!readGridPage(cacheKey, query, start, length, &pPage, &nrow,
+                     &filteredNRow))
+   {
+      return false;
+   }
+
+   json::Writer writer;
+   writeGridPage(draw, nrow, filteredNRow, *pPage, &writer);
+   std::string output = writer.str();
+   replaceControlChars(&output);
+
+   prefetchGridPages(cacheKey, query, pPage->start, pPage->length);
+
+   pResponse->setNoCacheHeaders();
+   pResponse->setStatusCode(http::status::Ok);
+   pResponse->setBody(output);
+   return true;
+}
+
 // called by the client to expire data cached by an associated viewer tab
 Error removeCachedData(const json::JsonRpcRequest& request,
                        json::JsonRpcResponse*)
@@ -812,6 +974,9 @@ Error removeCachedData(const json::JsonRpcRequest& request,
       s_cachedFrames.find(cacheKey);
    if (pos != s_cachedFrames.end())
       s_cachedFrames.erase(pos);
+   s_frameIndexes.erase(cacheKey);
+   removeGridSnapshot(cacheKey);
+   removeColumnSummaries(cacheKey);
    
    // remove cache env object and backing file
    error = r::exec::RFunction(".rs.removeCachedData", cacheKey, 
@@ -863,28 +1028,91 @@ Error duplicateDataView(const json::JsonRpcRequest& request,
    return Success();
 }
 
-void onShutdown(bool terminatedNormally)
+SEXP rs_writeCachedFrame(SEXP frameSEXP, SEXP pathSEXP)
 {
-   if (terminatedNormally) 
+   r::sexp::Protect protect;
+   bool written = false;
+   std::string path;
+   Error error = r::sexp::extract(pathSEXP, &path, true);
+   if (!error)
+      error = writeCachedFrame(frameSEXP, FilePath(path), &written);
+   if (error)
+      LOG_ERROR(error);
+   return r::sexp::create(written, &protect);
+}
+
+SEXP rs_readCachedFrame(SEXP pathSEXP)
+{
+   r::sexp::Protect protect;
+   std::string path;
+   Error error = r::sexp::extract(pathSEXP, &path, true);
+   SEXP frameSEXP = R_NilValue;
+   if (!error)
+      error = readCachedFrame(FilePath(path), &protect, &frameSEXP);
+   if (error)
    {
-      // when R suspends or shuts down, write out the contents of the cache
-      // environment to disk so we can load them again if we need to
-      Error error = r::exec::RFunction(".rs.saveCachedData", viewerCacheDir())
-         .call();
-      if (error)
-         LOG_ERROR(error);
+      LOG_ERROR(error);
+      return R_NilValue;
    }
+   return frameSEXP;
+}
+
+// write out the contents of the cache environment to disk so we can load
+// them again if we need to
+void saveCachedData(bool suspending)
+{
+   // when suspending, objects still bound in the global environment are
+   // saved along with it
+   std::vector<std::string> boundKeys;
+   if (suspending)
+   {
+      r::sexp::Protect protect;
+      for (std::map<std::string, CachedFrame>::iterator i =
+              s_cachedFrames.begin();
+           i != s_cachedFrames.end();
+           i++)
+      {
+         if (!i->second.envName.empty() && i->second.envName != "R_GlobalEnv")
+            continue;
+
+         SEXP objSEXP = findInNamedEnvir(i->second.envName,
+                                         i->second.objName);
+         SEXP cachedSEXP = R_NilValue;
+         r::exec::RFunction(".rs.findCachedData", i->first)
+               .call(&cachedSEXP, &protect);
+         if (objSEXP != NULL && objSEXP == cachedSEXP)
+            boundKeys.push_back(i->first);
+      }
+   }
+
+   Error error = r::exec::RFunction(".rs.saveCachedData", viewerCacheDir(),
+                                    boundKeys).call();
+   if (error)
+      LOG_ERROR(error);
+}
+
+void onShutdown(bool terminatedNormally)
+{
+   if (terminatedNormally) 
+      saveCachedData(false);
 }
 
 void onSuspend(const r::session::RSuspendOptions&, core::Settings*)
 {
-   onShutdown(true);
+   saveCachedData(true);
 }
 
 void onResume(const Settings&)
 {
 }
 
+void onReclaimMemory()
+{
+   // indexes and formatted pages are rebuilt when next needed
+   s_frameIndexes.clear();
+   evictGridPages();
+}
+
 void onDetectChanges(module_context::ChangeSource source)
 {
    DROP_RECURSIVE_CALLS;
@@ -906,6 +1134,9 @@ void onDetectChanges(module_context::ChangeSource source)
 
          // clear working data for the object
          r::exec::RFunction(".rs.removeWorkingData", i->first).call();
+         s_frameIndexes.erase(i->first);
+         removeGridSnapshot(i->first);
+         removeColumnSummaries(i->first);
 
          // replace cached copy (if we have something to replace it with)
          if (sexp != NULL)
@@ -971,9 +1202,30 @@ Error initialize()
    methodDef.numArgs = 5;
    r::routines::addCallMethod(methodDef);
 
+   R_CallMethodDef writeCachedFrameMethodDef ;
+   writeCachedFrameMethodDef.name = "rs_writeCachedFrame" ;
+   writeCachedFrameMethodDef.fun = (DL_FUNC) rs_writeCachedFrame ;
+   writeCachedFrameMethodDef.numArgs = 2;
+   r::routines::addCallMethod(writeCachedFrameMethodDef);
+
+   R_CallMethodDef readCachedFrameMethodDef ;
+   readCachedFrameMethodDef.name = "rs_readCachedFrame" ;
+   readCachedFrameMethodDef.fun = (DL_FUNC) rs_readCachedFrame ;
+   readCachedFrameMethodDef.numArgs = 1;
+   r::routines::addCallMethod(readCachedFrameMethodDef);
+
+   R_CallMethodDef summarizeMethodDef ;
+   summarizeMethodDef.name = "rs_summarizeDataColumn" ;
+   summarizeMethodDef.fun = (DL_FUNC) rs_summarizeDataColumn ;
+   summarizeMethodDef.numArgs = 3;
+   r::routines::addCallMethod(summarizeMethodDef);
+
    module_context::events().onShutdown.connect(onShutdown);
    module_context::events().onDetectChanges.connect(onDetectChanges);
    module_context::events().onClientInit.connect(onClientInit);
+   module_context::events().onReclaimMemory.connect(onReclaimMemory);
+   memory_usage::registerReporter("data_viewer_indexes",
+                                  frameIndexesMemoryUsage);
    addSuspendHandler(SuspendHandler(onSuspend, onResume));
 
    using boost::bind;
@@ -985,6 +1237,8 @@ Error initialize()
       (bind(registerRpcMethod, "remove_cached_data", removeCachedData))
       (bind(registerRpcMethod, "duplicate_data_view", duplicateDataView))
       (bind(registerUriHandler, "/grid_data", getGridData))
+      (bind(registerWorkerSafeUriHandler, "/grid_data", 
+            getGridDataFromSnapshot))
       (bind(registerUriHandler, kGridResourceLocation, handleGridResReq));
 
    Error error = initBlock.execute();
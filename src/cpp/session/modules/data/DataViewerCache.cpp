@@ -0,0 +1,459 @@
+/*
+ * DataViewerCache.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataViewerCache.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/MappedFile.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RSexp.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// File layout (all integers are native 32-bit ints; files are only read by
+// the machine which wrote them):
+//
+//    magic, version
+//    nrow, ncol
+//    frame class (strings)
+//    row names kind, row names (integers or strings, if not automatic)
+//    column names (strings)
+//    for each column:
+//       column type
+//       levels and class (strings, factors only)
+//       nrow values (strings are written individually, others as a block)
+//
+// Strings are written as their UTF-8 length and bytes; NA is length -1.
+
+const char kCacheMagic[] = "RSDVCOL1";
+const int kCacheVersion = 1;
+
+enum
+{
+   kColumnInteger = 1,
+   kColumnDouble = 2,
+   kColumnLogical = 3,
+   kColumnCharacter = 4,
+   kColumnFactor = 5
+};
+
+enum
+{
+   kRowNamesAutomatic = 0,
+   kRowNamesInteger = 1,
+   kRowNamesCharacter = 2
+};
+
+Error cacheFormatError(const FilePath& filePath, const ErrorLocation& location)
+{
+   Error error = systemError(boost::system::errc::illegal_byte_sequence,
+                             location);
+   error.addProperty("path", filePath.absolutePath());
+   return error;
+}
+
+// the column type to write, or 0 if the column can't be written
+int columnType(SEXP columnSEXP, int nrow)
+{
+   if (Rf_length(columnSEXP) != nrow)
+      return 0;
+
+   SEXP attribSEXP = ATTRIB(columnSEXP);
+   if (attribSEXP == R_NilValue)
+   {
+      switch (TYPEOF(columnSEXP))
+      {
+      case INTSXP:
+         return kColumnInteger;
+      case REALSXP:
+         return kColumnDouble;
+      case LGLSXP:
+         return kColumnLogical;
+      case STRSXP:
+         return kColumnCharacter;
+      default:
+         return 0;
+      }
+   }
+
+   // factors may have only levels and a class
+   if (TYPEOF(columnSEXP) != INTSXP || !Rf_inherits(columnSEXP, "factor"))
+      return 0;
+   for (SEXP attrSEXP = attribSEXP; attrSEXP != R_NilValue;
+        attrSEXP = CDR(attrSEXP))
+   {
+      if (TAG(attrSEXP) != R_LevelsSymbol && TAG(attrSEXP) != R_ClassSymbol)
+         return 0;
+      if (TYPEOF(CAR(attrSEXP)) != STRSXP)
+         return 0;
+   }
+   return kColumnFactor;
+}
+
+void writeInt(std::ostream& os, int value)
+{
+   os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeStrings(std::ostream& os, SEXP stringsSEXP)
+{
+   int n = Rf_length(stringsSEXP);
+   writeInt(os, n);
+   for (int i = 0; i < n; i++)
+   {
+      SEXP charSEXP = STRING_ELT(stringsSEXP, i);
+      if (charSEXP == NA_STRING)
+      {
+         writeInt(os, -1);
+      }
+      else
+      {
+         const char* value = Rf_translateCharUTF8(charSEXP);
+         int length = static_cast<int>(std::strlen(value));
+         writeInt(os, length);
+         os.write(value, length);
+      }
+   }
+}
+
+// reads values from the mapped file, checking that they lie within it
+class CacheReader
+{
+public:
+   explicit CacheReader(const MappedFile& file)
+      : pos_(file.begin()), end_(file.end())
+   {
+   }
+
+   bool read(void* pData, std::size_t size)
+   {
+      if (static_cast<std::size_t>(end_ - pos_) < size)
+         return false;
+      std::memcpy(pData, pos_, size);
+      pos_ += size;
+      return true;
+   }
+
+   bool readInt(int* pValue)
+   {
+      return read(pValue, sizeof(*pValue));
+   }
+
+   bool readStrings(r::sexp::Protect* pProtect, SEXP* pStringsSEXP)
+   {
+      int n;
+      if (!readInt(&n) || n < 0)
+         return false;
+
+      SEXP stringsSEXP = Rf_allocVector(STRSXP, n);
+      pProtect->add(stringsSEXP);
+      for (int i = 0; i < n; i++)
+      {
+         int length;
+         if (!readInt(&length))
+            return false;
+         if (length < 0)
+         {
+            SET_STRING_ELT(stringsSEXP, i, NA_STRING);
+            continue;
+         }
+         if (end_ - pos_ < length)
+            return false;
+         SET_STRING_ELT(stringsSEXP, i,
+                        Rf_mkCharLenCE(pos_, length, CE_UTF8));
+         pos_ += length;
+      }
+      *pStringsSEXP = stringsSEXP;
+      return true;
+   }
+
+private:
+   const char* pos_;
+   const char* end_;
+};
+
+} // anonymous namespace
+
+Error writeCachedFrame(SEXP frameSEXP,
+                       const FilePath& filePath,
+                       bool* pWritten)
+{
+   *pWritten = false;
+   if (TYPEOF(frameSEXP) != VECSXP)
+      return Success();
+
+   // the frame may have only names, row names and a class. (row names are
+   // read from the attribute directly, since automatic row names are stored
+   // compactly and getAttrib would expand them)
+   SEXP namesSEXP = R_NilValue;
+   SEXP rowNamesSEXP = R_NilValue;
+   SEXP classSEXP = R_NilValue;
+   for (SEXP attrSEXP = ATTRIB(frameSEXP); attrSEXP != R_NilValue;
+        attrSEXP = CDR(attrSEXP))
+   {
+      if (TAG(attrSEXP) == R_NamesSymbol)
+         namesSEXP = CAR(attrSEXP);
+      else if (TAG(attrSEXP) == R_RowNamesSymbol)
+         rowNamesSEXP = CAR(attrSEXP);
+      else if (TAG(attrSEXP) == R_ClassSymbol)
+         classSEXP = CAR(attrSEXP);
+      else
+         return Success();
+   }
+   if (TYPEOF(namesSEXP) != STRSXP || TYPEOF(classSEXP) != STRSXP)
+      return Success();
+
+   int ncol = Rf_length(frameSEXP);
+   int nrow;
+   int rowNamesKind;
+   if (TYPEOF(rowNamesSEXP) == INTSXP && Rf_length(rowNamesSEXP) == 2 &&
+       INTEGER(rowNamesSEXP)[0] == NA_INTEGER)
+   {
+      rowNamesKind = kRowNamesAutomatic;
+      nrow = std::abs(INTEGER(rowNamesSEXP)[1]);
+   }
+   else if (TYPEOF(rowNamesSEXP) == INTSXP)
+   {
+      rowNamesKind = kRowNamesInteger;
+      nrow = Rf_length(rowNamesSEXP);
+   }
+   else if (TYPEOF(rowNamesSEXP) == STRSXP)
+   {
+      rowNamesKind = kRowNamesCharacter;
+      nrow = Rf_length(rowNamesSEXP);
+   }
+   else
+   {
+      return Success();
+   }
+   if (Rf_length(namesSEXP) != ncol)
+      return Success();
+
+   std::vector<int> types;
+   for (int i = 0; i < ncol; i++)
+   {
+      int type = columnType(VECTOR_ELT(frameSEXP, i), nrow);
+      if (type == 0)
+         return Success();
+      types.push_back(type);
+   }
+
+   // write the frame
+   boost::shared_ptr<std::ostream> pStream;
+   Error error = filePath.open_w(&pStream);
+   if (error)
+      return error;
+   std::ostream& os = *pStream;
+
+   os.write(kCacheMagic, sizeof(kCacheMagic) - 1);
+   writeInt(os, kCacheVersion);
+   writeInt(os, nrow);
+   writeInt(os, ncol);
+   writeStrings(os, classSEXP);
+
+   writeInt(os, rowNamesKind);
+   if (rowNamesKind == kRowNamesInteger)
+      os.write(reinterpret_cast<const char*>(INTEGER(rowNamesSEXP)),
+               nrow * sizeof(int));
+   else if (rowNamesKind == kRowNamesCharacter)
+      writeStrings(os, rowNamesSEXP);
+
+   writeStrings(os, namesSEXP);
+
+   for (int i = 0; i < ncol && os; i++)
+   {
+      SEXP columnSEXP = VECTOR_ELT(frameSEXP, i);
+      writeInt(os, types[i]);
+      switch (types[i])
+      {
+      case kColumnFactor:
+         writeStrings(os, Rf_getAttrib(columnSEXP, R_LevelsSymbol));
+         writeStrings(os, Rf_getAttrib(columnSEXP, R_ClassSymbol));
+         // fall through (codes are written as integers)
+      case kColumnInteger:
+         os.write(reinterpret_cast<const char*>(INTEGER(columnSEXP)),
+                  nrow * sizeof(int));
+         break;
+      case kColumnLogical:
+         os.write(reinterpret_cast<const char*>(LOGICAL(columnSEXP)),
+                  nrow * sizeof(int));
+         break;
+      case kColumnDouble:
+         os.write(reinterpret_cast<const char*>(REAL(columnSEXP)),
+                  nrow * sizeof(double));
+         break;
+      case kColumnCharacter:
+         writeStrings(os, columnSEXP);
+         break;
+      }
+   }
+
+   os.flush();
+   if (!os)
+   {
+      pStream.reset();
+      filePath.removeIfExists();
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("path", filePath.absolutePath());
+      return error;
+   }
+
+   *pWritten = true;
+   return Success();
+}
+
+Error readCachedFrame(const FilePath& filePath,
+                      r::sexp::Protect* pProtect,
+                      SEXP* pFrameSEXP)
+{
+   MappedFile file;
+   Error error = file.open(filePath);
+   if (error)
+      return error;
+
+   CacheReader reader(file);
+   char magic[sizeof(kCacheMagic) - 1];
+   int version, nrow, ncol;
+   if (!reader.read(magic, sizeof(magic)) ||
+       std::memcmp(magic, kCacheMagic, sizeof(magic)) != 0 ||
+       !reader.readInt(&version) || version != kCacheVersion ||
+       !reader.readInt(&nrow) || nrow < 0 ||
+       !reader.readInt(&ncol) || ncol < 0)
+   {
+      return cacheFormatError(filePath, ERROR_LOCATION);
+   }
+
+   SEXP frameSEXP = Rf_allocVector(VECSXP, ncol);
+   pProtect->add(frameSEXP);
+
+   SEXP classSEXP;
+   if (!reader.readStrings(pProtect, &classSEXP))
+      return cacheFormatError(filePath, ERROR_LOCATION);
+
+   int rowNamesKind;
+   SEXP rowNamesSEXP = R_NilValue;
+   if (!reader.readInt(&rowNamesKind))
+      return cacheFormatError(filePath, ERROR_LOCATION);
+   if (rowNamesKind == kRowNamesAutomatic)
+   {
+      rowNamesSEXP = Rf_allocVector(INTSXP, 2);
+      pProtect->add(rowNamesSEXP);
+      INTEGER(rowNamesSEXP)[0] = NA_INTEGER;
+      INTEGER(rowNamesSEXP)[1] = -nrow;
+   }
+   else if (rowNamesKind == kRowNamesInteger)
+   {
+      rowNamesSEXP = Rf_allocVector(INTSXP, nrow);
+      pProtect->add(rowNamesSEXP);
+      if (!reader.read(INTEGER(rowNamesSEXP), nrow * sizeof(int)))
+         return cacheFormatError(filePath, ERROR_LOCATION);
+   }
+   else if (rowNamesKind != kRowNamesCharacter ||
+            !reader.readStrings(pProtect, &rowNamesSEXP) ||
+            Rf_length(rowNamesSEXP) != nrow)
+   {
+      return cacheFormatError(filePath, ERROR_LOCATION);
+   }
+
+   SEXP namesSEXP;
+   if (!reader.readStrings(pProtect, &namesSEXP) ||
+       Rf_length(namesSEXP) != ncol)
+   {
+      return cacheFormatError(filePath, ERROR_LOCATION);
+   }
+
+   for (int i = 0; i < ncol; i++)
+   {
+      int type;
+      if (!reader.readInt(&type))
+         return cacheFormatError(filePath, ERROR_LOCATION);
+
+      SEXP columnSEXP = R_NilValue;
+      bool ok = false;
+      switch (type)
+      {
+      case kColumnFactor:
+      {
+         SEXP levelsSEXP, factorClassSEXP;
+         if (!reader.readStrings(pProtect, &levelsSEXP) ||
+             !reader.readStrings(pProtect, &factorClassSEXP))
+         {
+            break;
+         }
+         columnSEXP = Rf_allocVector(INTSXP, nrow);
+         SET_VECTOR_ELT(frameSEXP, i, columnSEXP);
+         ok = reader.read(INTEGER(columnSEXP), nrow * sizeof(int));
+         Rf_setAttrib(columnSEXP, R_LevelsSymbol, levelsSEXP);
+         Rf_setAttrib(columnSEXP, R_ClassSymbol, factorClassSEXP);
+         break;
+      }
+      case kColumnInteger:
+         columnSEXP = Rf_allocVector(INTSXP, nrow);
+         SET_VECTOR_ELT(frameSEXP, i, columnSEXP);
+         ok = reader.read(INTEGER(columnSEXP), nrow * sizeof(int));
+         break;
+      case kColumnLogical:
+         columnSEXP = Rf_allocVector(LGLSXP, nrow);
+         SET_VECTOR_ELT(frameSEXP, i, columnSEXP);
+         ok = reader.read(LOGICAL(columnSEXP), nrow * sizeof(int));
+         break;
+      case kColumnDouble:
+         columnSEXP = Rf_allocVector(REALSXP, nrow);
+         SET_VECTOR_ELT(frameSEXP, i, columnSEXP);
+         ok = reader.read(REAL(columnSEXP), nrow * sizeof(double));
+         break;
+      case kColumnCharacter:
+         ok = reader.readStrings(pProtect, &columnSEXP) &&
+              Rf_length(columnSEXP) == nrow;
+         if (ok)
+            SET_VECTOR_ELT(frameSEXP, i, columnSEXP);
+         break;
+      }
+      if (!ok)
+         return cacheFormatError(filePath, ERROR_LOCATION);
+   }
+
+   Rf_setAttrib(frameSEXP, R_NamesSymbol, namesSEXP);
+   Rf_setAttrib(frameSEXP, R_RowNamesSymbol, rowNamesSEXP);
+   Rf_setAttrib(frameSEXP, R_ClassSymbol, classSEXP);
+
+   *pFrameSEXP = frameSEXP;
+   return Success();
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,63 @@
+/*
+ * DataViewerCache.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_CACHE_HPP
+#define SESSION_DATA_VIEWER_CACHE_HPP
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FilePath;
+}
+namespace r {
+namespace sexp {
+   class Protect;
+}
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// Cached frames are written to the viewer cache directory when the session
+// suspends. Frames whose columns are all integer, double, logical, character
+// or factor vectors are written column by column in a simple binary format,
+// and read back through a memory mapping with a single copy into each
+// column's vector (rather than unserializing the frame). Other frames are
+// written with save() (see .rs.saveCachedData).
+
+// write the frame to the file. if the frame has columns or attributes the
+// format doesn't represent, nothing is written and *pWritten is false.
+core::Error writeCachedFrame(SEXP frameSEXP,
+                             const core::FilePath& filePath,
+                             bool* pWritten);
+
+// read a frame written by writeCachedFrame
+core::Error readCachedFrame(const core::FilePath& filePath,
+                            r::sexp::Protect* pProtect,
+                            SEXP* pFrameSEXP);
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_CACHE_HPP
@@ -0,0 +1,742 @@
+/*
+ * DataViewerIndex.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataViewerIndex.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/foreach.hpp>
+#include <boost/regex.hpp>
+
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+#include <core/SafeConvert.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RSexp.hpp>
+#include <r/RExec.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+bool isFilterSubset(const std::string& outer, const std::string& inner) 
+{
+   // shortcut for identical filters (the typical case)
+   if (inner == outer) 
+      return true;
+
+   // find filter separators; if we can't find them, presume no subset since we
+   // can't parse filters
+   size_t outerPipe = outer.find(kFilterSeparator);
+   if (outerPipe == std::string::npos) 
+      return false;
+   size_t innerPipe = inner.find(kFilterSeparator);
+   if (innerPipe == std::string::npos)
+      return false;
+
+   std::string outerType(outer.substr(0, outerPipe));
+   std::string innerType(inner.substr(0, innerPipe));
+   std::string outerValue(outer.substr(outerPipe + 1, 
+            outer.length() - outerPipe));
+   std::string innerValue(inner.substr(innerPipe + 1, 
+            inner.length() - innerPipe));
+   
+   // only identical types can be subsets
+   if (outerType != innerType) 
+      return false;
+
+   if (outerType == "numeric")
+   {
+      // matches a numeric filter (i.e. "2.71_3.14") -- in this case we need to
+      // check the components for range inclusion
+      boost::regex numFilter("(-?\\d+\\.?\\d*)_(-?\\d+\\.?\\d*)");
+      boost::smatch innerMatch, outerMatch;
+      if (boost::regex_search(innerValue, innerMatch, numFilter) &&
+          boost::regex_search(outerValue, outerMatch, numFilter))
+      {
+         // for numeric filters, the inner is a subset if its lower bound (1)
+         // is larger than the outer lower bound, and the upper bound (2) is
+         // smaller than the outer upper bound
+         return safe_convert::stringTo<double>(innerMatch[1], 0) >= 
+                safe_convert::stringTo<double>(outerMatch[1], 0) &&
+                safe_convert::stringTo<double>(innerMatch[2], 0) <= 
+                safe_convert::stringTo<double>(outerMatch[2], 0);
+      }
+
+      // if not identical and not a range, then not a subset
+      return false;
+   } 
+   else if (outerType == "factor" || outerType == "boolean")
+   {
+      // factors and boolean values have to be identical for subsetting, and we
+      // already checked above
+      return false;
+   }
+   else if (outerType == "character")
+   {
+      // characters are a subset if the outer string is within the inner one
+      // (i.e. a seach for "walnuts" (inner) is within "walnut" (outer))
+      return inner.find(outer) != std::string::npos;
+   }
+   
+   // unknown filter type
+   return false;
+}
+
+namespace {
+
+typedef enum
+{
+   COLUMN_UNSUPPORTED,
+   COLUMN_INTEGER,
+   COLUMN_DOUBLE,
+   COLUMN_LOGICAL,
+   COLUMN_CHARACTER,
+   COLUMN_FACTOR
+} ColumnType;
+
+// the types of column we read directly; classed vectors (other than factors)
+// aren't included since R methods may change how they compare or print
+ColumnType columnType(SEXP columnSEXP, int nrow)
+{
+   if (Rf_length(columnSEXP) != nrow)
+      return COLUMN_UNSUPPORTED;
+
+   if (OBJECT(columnSEXP))
+   {
+      if (TYPEOF(columnSEXP) == INTSXP && Rf_inherits(columnSEXP, "factor"))
+         return COLUMN_FACTOR;
+      return COLUMN_UNSUPPORTED;
+   }
+
+   switch (TYPEOF(columnSEXP))
+   {
+   case INTSXP:
+      return COLUMN_INTEGER;
+   case REALSXP:
+      return COLUMN_DOUBLE;
+   case LGLSXP:
+      return COLUMN_LOGICAL;
+   case STRSXP:
+      return COLUMN_CHARACTER;
+   default:
+      return COLUMN_UNSUPPORTED;
+   }
+}
+
+// parses a number as R's as.numeric() would, returning false if it can't
+// (in which case R would produce NA)
+bool parseNumber(const std::string& text, double* pValue)
+{
+   if (text.empty())
+      return false;
+
+   const char* begin = text.c_str();
+   char* end = NULL;
+   *pValue = std::strtod(begin, &end);
+   return end == begin + text.length();
+}
+
+// case-insensitive substring matching, as grepl() performs for the data
+// viewer's searches (the pattern is quoted with \Q...\E and matched with
+// ignore.case = TRUE). only ASCII patterns are supported, since we'd
+// otherwise need to match PCRE's Unicode case folding
+class TextMatcher
+{
+public:
+   explicit TextMatcher(const std::string& pattern)
+      : pattern_(pattern)
+   {
+      std::transform(pattern_.begin(), pattern_.end(), pattern_.begin(),
+                     toLower);
+   }
+
+   static bool supports(const std::string& pattern)
+   {
+      // \E would end the quoting used by the R implementation
+      if (pattern.empty() || pattern.find("\\E") != std::string::npos)
+         return false;
+
+      BOOST_FOREACH(char ch, pattern)
+      {
+         if (static_cast<unsigned char>(ch) >= 0x80)
+            return false;
+      }
+      return true;
+   }
+
+   bool matches(const char* text) const
+   {
+      const char* end = text + std::strlen(text);
+      return std::search(text, end,
+                         pattern_.begin(), pattern_.end(),
+                         equalsIgnoringCase) != end;
+   }
+
+   bool matches(SEXP charSEXP) const
+   {
+      if (charSEXP == NA_STRING)
+         return false;
+      return matches(Rf_translateCharUTF8(charSEXP));
+   }
+
+private:
+   static char toLower(char ch)
+   {
+      return (ch >= 'A' && ch <= 'Z') ? ch - 'A' + 'a' : ch;
+   }
+
+   static bool equalsIgnoringCase(char text, char pattern)
+   {
+      return toLower(text) == pattern;
+   }
+
+   std::string pattern_;
+};
+
+// matches a column's values (as text, as though converted to character by
+// grepl) against a pattern
+class TextColumnMatcher
+{
+public:
+   TextColumnMatcher(SEXP columnSEXP, ColumnType type, const TextMatcher& matcher)
+      : columnSEXP_(columnSEXP), type_(type), matcher_(matcher)
+   {
+      // match each level of a factor just once
+      if (type_ == COLUMN_FACTOR)
+      {
+         SEXP levelsSEXP = Rf_getAttrib(columnSEXP, R_LevelsSymbol);
+         if (TYPEOF(levelsSEXP) == STRSXP)
+         {
+            for (int i = 0; i < Rf_length(levelsSEXP); i++)
+               levelMatches_.push_back(matcher_.matches(STRING_ELT(levelsSEXP, i)));
+         }
+      }
+   }
+
+   static bool supports(ColumnType type)
+   {
+      return type == COLUMN_INTEGER ||
+             type == COLUMN_LOGICAL ||
+             type == COLUMN_CHARACTER ||
+             type == COLUMN_FACTOR;
+   }
+
+   bool matches(int row) const
+   {
+      switch (type_)
+      {
+      case COLUMN_CHARACTER:
+         return matcher_.matches(STRING_ELT(columnSEXP_, row));
+      case COLUMN_FACTOR:
+      {
+         int level = INTEGER(columnSEXP_)[row];
+         return level != NA_INTEGER &&
+                level >= 1 &&
+                level <= static_cast<int>(levelMatches_.size()) &&
+                levelMatches_[level - 1];
+      }
+      case COLUMN_INTEGER:
+      {
+         int value = INTEGER(columnSEXP_)[row];
+         if (value == NA_INTEGER)
+            return false;
+         char buffer[16];
+         std::snprintf(buffer, sizeof(buffer), "%d", value);
+         return matcher_.matches(buffer);
+      }
+      case COLUMN_LOGICAL:
+      {
+         int value = LOGICAL(columnSEXP_)[row];
+         if (value == NA_LOGICAL)
+            return false;
+         return matcher_.matches(value ? "TRUE" : "FALSE");
+      }
+      default:
+         return false;
+      }
+   }
+
+private:
+   SEXP columnSEXP_;
+   ColumnType type_;
+   TextMatcher matcher_;
+   std::vector<bool> levelMatches_;
+};
+
+// a column filter, in the "type|value" form used by the client (see
+// .rs.applyTransform for the R equivalent)
+class ColumnFilter
+{
+public:
+   ColumnFilter()
+      : columnSEXP_(R_NilValue), type_(COLUMN_UNSUPPORTED), kind_(KindNone),
+        lower_(0), upper_(0),
+        matcher_(R_NilValue, COLUMN_UNSUPPORTED, TextMatcher(std::string()))
+   {
+   }
+
+   // returns false if the filter isn't supported for the column
+   bool parse(const std::string& filter, SEXP columnSEXP, int nrow)
+   {
+      kind_ = KindNone;
+
+      // split filter--string format is "type|value"; filters without a
+      // value don't apply
+      std::size_t pipe = filter.find(kFilterSeparator);
+      if (pipe == std::string::npos)
+         return true;
+      std::string filterType = filter.substr(0, pipe);
+      std::string filterValue = filter.substr(pipe + 1);
+      filterValue = filterValue.substr(0, filterValue.find(kFilterSeparator));
+      if (filterValue.empty())
+         return true;
+
+      columnSEXP_ = columnSEXP;
+      type_ = columnType(columnSEXP, nrow);
+      if (type_ == COLUMN_UNSUPPORTED)
+         return false;
+
+      if (filterType == "factor")
+      {
+         // compares the column's numeric values (e.g. factor codes)
+         kind_ = KindEquals;
+         return type_ != COLUMN_CHARACTER && parseNumber(filterValue, &lower_);
+      }
+      else if (filterType == "character")
+      {
+         kind_ = KindText;
+         if (!TextColumnMatcher::supports(type_) ||
+             !TextMatcher::supports(filterValue))
+         {
+            return false;
+         }
+         matcher_ = TextColumnMatcher(columnSEXP, type_, TextMatcher(filterValue));
+         return true;
+      }
+      else if (filterType == "numeric")
+      {
+         // range ("2_32") or equality ("15")
+         if (type_ == COLUMN_CHARACTER || type_ == COLUMN_FACTOR)
+            return false;
+
+         std::vector<std::string> bounds;
+         std::size_t begin = 0;
+         while (begin < filterValue.size())
+         {
+            std::size_t end = filterValue.find('_', begin);
+            if (end == std::string::npos)
+               end = filterValue.size();
+            bounds.push_back(filterValue.substr(begin, end - begin));
+            begin = end + 1;
+         }
+
+         if (bounds.size() > 1)
+         {
+            kind_ = KindRange;
+            return parseNumber(bounds[0], &lower_) &&
+                   parseNumber(bounds[1], &upper_);
+         }
+
+         kind_ = KindFiniteEquals;
+         return parseNumber(bounds[0], &lower_);
+      }
+      else if (filterType == "boolean")
+      {
+         kind_ = KindEquals;
+         lower_ = filterValue == "TRUE" ? 1 : 0;
+         return type_ != COLUMN_CHARACTER && type_ != COLUMN_FACTOR;
+      }
+
+      // unknown filter types don't apply
+      return true;
+   }
+
+   bool applies() const { return kind_ != KindNone; }
+
+   bool matches(int row) const
+   {
+      if (kind_ == KindText)
+         return matcher_.matches(row);
+
+      double value;
+      switch (type_)
+      {
+      case COLUMN_INTEGER:
+      case COLUMN_FACTOR:
+      {
+         int intValue = INTEGER(columnSEXP_)[row];
+         if (intValue == NA_INTEGER)
+            return false;
+         value = intValue;
+         break;
+      }
+      case COLUMN_LOGICAL:
+      {
+         int logicalValue = LOGICAL(columnSEXP_)[row];
+         if (logicalValue == NA_LOGICAL)
+            return false;
+         value = logicalValue;
+         break;
+      }
+      case COLUMN_DOUBLE:
+         value = REAL(columnSEXP_)[row];
+         break;
+      default:
+         return false;
+      }
+
+      switch (kind_)
+      {
+      case KindEquals:
+         return value == lower_;
+      case KindFiniteEquals:
+         return R_FINITE(value) && value == lower_;
+      case KindRange:
+         return R_FINITE(value) && value >= lower_ && value <= upper_;
+      default:
+         return true;
+      }
+   }
+
+private:
+   enum Kind
+   {
+      KindNone,
+      KindEquals,
+      KindFiniteEquals,
+      KindRange,
+      KindText
+   };
+
+   SEXP columnSEXP_;
+   ColumnType type_;
+   Kind kind_;
+   double lower_;
+   double upper_;
+   TextColumnMatcher matcher_;
+};
+
+// a filter or search narrows a previous one if it can only match rows that
+// the previous one matched
+bool isNarrowing(const std::string& previous, const std::string& current)
+{
+   return previous.empty() || isFilterSubset(previous, current);
+}
+
+// comparators for ordering rows by a column (as order(); missing values are
+// last, and ties keep their original order since these are used with
+// std::stable_sort)
+class IntegerOrder
+{
+public:
+   IntegerOrder(const int* pValues, bool decreasing)
+      : pValues_(pValues), decreasing_(decreasing)
+   {
+   }
+
+   bool operator()(int lhs, int rhs) const
+   {
+      int left = pValues_[lhs];
+      int right = pValues_[rhs];
+      if (left == NA_INTEGER || right == NA_INTEGER)
+         return right == NA_INTEGER && left != NA_INTEGER;
+      return decreasing_ ? left > right : left < right;
+   }
+
+private:
+   const int* pValues_;
+   bool decreasing_;
+};
+
+class DoubleOrder
+{
+public:
+   DoubleOrder(const double* pValues, bool decreasing)
+      : pValues_(pValues), decreasing_(decreasing)
+   {
+   }
+
+   bool operator()(int lhs, int rhs) const
+   {
+      double left = pValues_[lhs];
+      double right = pValues_[rhs];
+      if (ISNAN(left) || ISNAN(right))
+         return ISNAN(right) && !ISNAN(left);
+      return decreasing_ ? left > right : left < right;
+   }
+
+private:
+   const double* pValues_;
+   bool decreasing_;
+};
+
+} // anonymous namespace
+
+FrameIndex::FrameIndex(SEXP frameSEXP, int nrow)
+   : pFrame_(new r::sexp::PreservedSEXP(frameSEXP)),
+     nrow_(nrow),
+     hasMatches_(false),
+     permutationCol_(0),
+     permutationDecreasing_(false),
+     hasRows_(false),
+     rowsOrderCol_(0)
+{
+}
+
+FrameIndex::~FrameIndex()
+{
+}
+
+SEXP FrameIndex::frame() const
+{
+   return pFrame_->get();
+}
+
+std::size_t FrameIndex::memoryUsage() const
+{
+   return sizeof(*this) +
+          matches_.capacity() / 8 +
+          permutation_.capacity() * sizeof(int) +
+          rows_.capacity() * sizeof(int);
+}
+
+const std::vector<int>* FrameIndex::rows(
+                              const std::vector<std::string>& filters,
+                              const std::string& search,
+                              int orderCol,
+                              const std::string& orderDir)
+{
+   // the client typically asks for many pages of the same rows
+   if (hasRows_ &&
+       rowsFilters_ == filters &&
+       rowsSearch_ == search &&
+       rowsOrderCol_ == orderCol &&
+       rowsOrderDir_ == orderDir)
+   {
+      return &rows_;
+   }
+
+   bool filtered = false;
+   BOOST_FOREACH(const std::string& filter, filters)
+   {
+      if (!filter.empty())
+         filtered = true;
+   }
+   if (!search.empty())
+      filtered = true;
+
+   if (filtered && !updateMatches(filters, search))
+      return NULL;
+
+   if (orderCol > 0 && !updateOrder(orderCol, orderDir == "desc"))
+      return NULL;
+
+   rows_.clear();
+   for (int i = 0; i < nrow_; i++)
+   {
+      int row = orderCol > 0 ? permutation_[i] : i;
+      if (!filtered || matches_[row])
+         rows_.push_back(row);
+   }
+
+   hasRows_ = true;
+   rowsFilters_ = filters;
+   rowsSearch_ = search;
+   rowsOrderCol_ = orderCol;
+   rowsOrderDir_ = orderDir;
+   return &rows_;
+}
+
+bool FrameIndex::updateMatches(const std::vector<std::string>& filters,
+                               const std::string& search)
+{
+   if (hasMatches_ && matchFilters_ == filters && matchSearch_ == search)
+      return true;
+
+   SEXP frameSEXP = pFrame_->get();
+   int ncol = Rf_length(frameSEXP);
+
+   // parse the filters (before changing anything, so that if they aren't
+   // supported the current matches are kept)
+   std::vector<ColumnFilter> columnFilters;
+   for (std::size_t i = 0; i < filters.size(); i++)
+   {
+      if (filters[i].empty())
+         continue;
+      if (static_cast<int>(i) >= ncol)
+         return false;
+
+      ColumnFilter filter;
+      if (!filter.parse(filters[i], VECTOR_ELT(frameSEXP, i), nrow_))
+         return false;
+      if (filter.applies())
+         columnFilters.push_back(filter);
+   }
+
+   // the global search looks for the text in every column
+   std::vector<TextColumnMatcher> searchMatchers;
+   if (!search.empty())
+   {
+      // (R's search matches nothing in a frame without columns)
+      if (!TextMatcher::supports(search) || ncol == 0)
+         return false;
+
+      TextMatcher matcher(search);
+      for (int i = 0; i < ncol; i++)
+      {
+         SEXP columnSEXP = VECTOR_ELT(frameSEXP, i);
+         ColumnType type = columnType(columnSEXP, nrow_);
+         if (!TextColumnMatcher::supports(type))
+            return false;
+         searchMatchers.push_back(TextColumnMatcher(columnSEXP, type, matcher));
+      }
+   }
+
+   // if the new filters and search narrow the previous ones then we only
+   // need to test the rows which matched before
+   bool narrowing = hasMatches_ &&
+                    matchFilters_.size() == filters.size() &&
+                    isNarrowing(matchSearch_, search);
+   for (std::size_t i = 0; narrowing && i < filters.size(); i++)
+   {
+      narrowing = isNarrowing(matchFilters_[i], filters[i]);
+   }
+
+   if (!narrowing)
+      matches_.assign(nrow_, true);
+
+   for (int row = 0; row < nrow_; row++)
+   {
+      if (!matches_[row])
+         continue;
+
+      bool matches = true;
+      BOOST_FOREACH(const ColumnFilter& filter, columnFilters)
+      {
+         if (!filter.matches(row))
+         {
+            matches = false;
+            break;
+         }
+      }
+
+      if (matches && !searchMatchers.empty())
+      {
+         matches = false;
+         BOOST_FOREACH(const TextColumnMatcher& matcher, searchMatchers)
+         {
+            if (matcher.matches(row))
+            {
+               matches = true;
+               break;
+            }
+         }
+      }
+
+      matches_[row] = matches;
+   }
+
+   hasMatches_ = true;
+   matchFilters_ = filters;
+   matchSearch_ = search;
+   return true;
+}
+
+bool FrameIndex::updateOrder(int orderCol, bool decreasing)
+{
+   if (permutationCol_ == orderCol && permutationDecreasing_ == decreasing)
+      return true;
+
+   SEXP frameSEXP = pFrame_->get();
+   if (orderCol > Rf_length(frameSEXP))
+      return false;
+
+   SEXP columnSEXP = VECTOR_ELT(frameSEXP, orderCol - 1);
+   std::vector<int> permutation;
+
+   ColumnType type = columnType(columnSEXP, nrow_);
+   if (type == COLUMN_INTEGER || type == COLUMN_FACTOR || type == COLUMN_LOGICAL)
+   {
+      permutation.resize(nrow_);
+      for (int i = 0; i < nrow_; i++)
+         permutation[i] = i;
+
+      // factors order by their codes (as order() does); logical values are
+      // stored as integers
+      const int* pValues = type == COLUMN_LOGICAL ?
+               LOGICAL(columnSEXP) :
+               INTEGER(columnSEXP);
+      std::stable_sort(permutation.begin(), permutation.end(),
+                       IntegerOrder(pValues, decreasing));
+   }
+   else if (type == COLUMN_DOUBLE)
+   {
+      permutation.resize(nrow_);
+      for (int i = 0; i < nrow_; i++)
+         permutation[i] = i;
+
+      std::stable_sort(permutation.begin(), permutation.end(),
+                       DoubleOrder(REAL(columnSEXP), decreasing));
+   }
+   else
+   {
+      // character vectors (which are ordered by the collation of R's
+      // locale) and classed vectors are ordered by R. this still produces
+      // just the order of the column, rather than a sorted copy of the frame
+      if (Rf_length(columnSEXP) != nrow_ || TYPEOF(columnSEXP) == VECSXP)
+         return false;
+
+      r::sexp::Protect protect;
+      SEXP orderSEXP = R_NilValue;
+      r::exec::RFunction order("order");
+      order.addParam(columnSEXP);
+      order.addParam("decreasing", decreasing);
+      Error error = order.call(&orderSEXP, &protect);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return false;
+      }
+
+      if (TYPEOF(orderSEXP) != INTSXP || Rf_length(orderSEXP) != nrow_)
+         return false;
+
+      permutation.resize(nrow_);
+      const int* pOrder = INTEGER(orderSEXP);
+      for (int i = 0; i < nrow_; i++)
+         permutation[i] = pOrder[i] - 1;
+   }
+
+   permutation_.swap(permutation);
+   permutationCol_ = orderCol;
+   permutationDecreasing_ = decreasing;
+   return true;
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,120 @@
+/*
+ * DataViewerIndex.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_INDEX_HPP
+#define SESSION_DATA_VIEWER_INDEX_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/scoped_ptr.hpp>
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace r {
+namespace sexp {
+   class PreservedSEXP;
+}
+}
+}
+
+namespace rstudio {
+namespace session {
+namespace modules { 
+namespace data {
+namespace viewer {
+
+// separates filter type from contents (e.g. "numeric|12-25")
+#define kFilterSeparator "|"
+
+// indicates whether one filter string is a subset of another; e.g. if a column
+// is filtered for "abc" and then "abcd", the new state is a subset of the
+// previous state.
+bool isFilterSubset(const std::string& outer, const std::string& inner);
+
+// FrameIndex sorts, filters and searches a data frame natively, producing
+// the indices of the rows to show (in order) rather than a transformed copy
+// of the frame as .rs.applyTransform does. It reads integer, double,
+// logical and character columns (without a class) and factors directly;
+// other columns can still be sorted (by calling order() on the column),
+// but filtering or searching them isn't supported here.
+//
+// The index keeps the sort permutation for the last column ordered on and
+// a bitmap of the rows matching the last filters and search, so that
+// re-sorting doesn't re-filter (and vice versa), and narrowing a filter
+// only tests the rows which matched before.
+class FrameIndex : boost::noncopyable
+{
+public:
+   FrameIndex(SEXP frameSEXP, int nrow);
+   ~FrameIndex();
+
+   // COPYING: boost::noncopyable
+
+   SEXP frame() const;
+
+   // approximate bytes held by the index (not counting the frame)
+   std::size_t memoryUsage() const;
+
+   // get the (0-based) rows to show for the given filters (one per column),
+   // global search, and order column (1-based, or 0 for no ordering) and
+   // direction ("asc" or "desc"). returns NULL if the transform isn't
+   // supported for this frame (in which case the caller should apply it
+   // in R). the result is valid until the next call.
+   const std::vector<int>* rows(const std::vector<std::string>& filters,
+                                const std::string& search,
+                                int orderCol,
+                                const std::string& orderDir);
+
+private:
+   bool updateMatches(const std::vector<std::string>& filters,
+                      const std::string& search);
+
+   bool updateOrder(int orderCol, bool decreasing);
+
+   // the frame is preserved so that the pointer identifies it for as long
+   // as the index exists
+   boost::scoped_ptr<r::sexp::PreservedSEXP> pFrame_;
+   int nrow_;
+
+   // rows matching the current filters and search
+   bool hasMatches_;
+   std::vector<std::string> matchFilters_;
+   std::string matchSearch_;
+   std::vector<bool> matches_;
+
+   // rows in order of the current order column
+   int permutationCol_;
+   bool permutationDecreasing_;
+   std::vector<int> permutation_;
+
+   // the last set of rows returned
+   bool hasRows_;
+   std::vector<std::string> rowsFilters_;
+   std::string rowsSearch_;
+   int rowsOrderCol_;
+   std::string rowsOrderDir_;
+   std::vector<int> rows_;
+};
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_INDEX_HPP
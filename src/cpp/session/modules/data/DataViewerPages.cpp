@@ -0,0 +1,727 @@
+/*
+ * DataViewerPages.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataViewerPages.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <map>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/utility.hpp>
+
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+#include <core/Thread.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RSexp.hpp>
+#include <r/RExec.hpp>
+#include <r/ROptions.hpp>
+
+#include <session/SessionWorkerPool.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// the number of formatted pages kept for each view
+const std::size_t kMaxCachedPages = 8;
+
+typedef enum
+{
+   GRID_COLUMN_NUMBER,
+   GRID_COLUMN_LOGICAL,
+   GRID_COLUMN_CHARACTER,
+   GRID_COLUMN_FACTOR
+} GridColumnType;
+
+// a column's data, read from the worker pool. the pointers are into vectors
+// owned by the (preserved) frame; since the frame is also bound in the data
+// cache, R duplicates its columns rather than modify them in place.
+struct GridColumn
+{
+   GridColumn()
+      : type(GRID_COLUMN_NUMBER), pIntegers(NULL), pDoubles(NULL),
+        pStrings(NULL)
+   {
+   }
+
+   GridColumnType type;
+   const int* pIntegers;
+   const double* pDoubles;
+   const SEXP* pStrings;
+
+   // factor levels (translated to UTF-8 when the snapshot is made)
+   std::vector<std::string> levels;
+};
+
+bool isAscii(const char* value)
+{
+   for (const char* p = value; *p; p++)
+   {
+      if (static_cast<unsigned char>(*p) > 0x7F)
+         return false;
+   }
+   return true;
+}
+
+// reads a string as UTF-8 without calling into R's translation (which
+// isn't safe off the main thread); returns false for strings which need it
+bool readString(SEXP charSEXP, bool utf8Locale, std::string* pValue)
+{
+   const char* value = CHAR(charSEXP);
+   switch (Rf_getCharCE(charSEXP))
+   {
+   case CE_UTF8:
+      pValue->assign(value);
+      return true;
+
+   case CE_LATIN1:
+      pValue->clear();
+      for (const char* p = value; *p; p++)
+      {
+         unsigned char ch = static_cast<unsigned char>(*p);
+         if (ch < 0x80)
+         {
+            pValue->push_back(static_cast<char>(ch));
+         }
+         else
+         {
+            pValue->push_back(static_cast<char>(0xC0 | (ch >> 6)));
+            pValue->push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+         }
+      }
+      return true;
+
+   case CE_BYTES:
+      return false;
+
+   default:
+      if (!utf8Locale && !isAscii(value))
+         return false;
+      pValue->assign(value);
+      return true;
+   }
+}
+
+// the significant digits (up to the given number) and power of ten of a
+// finite value, as R's formatReal computes them
+void scientific(double value, int digits, int* pKPower, int* pNSig)
+{
+   char buffer[64];
+   std::snprintf(buffer, sizeof(buffer), "%.*e", digits - 1,
+                 std::fabs(value));
+   const char* pExponent = std::strchr(buffer, 'e');
+   if (pExponent == NULL)
+   {
+      *pKPower = 0;
+      *pNSig = digits;
+      return;
+   }
+   *pKPower = std::atoi(pExponent + 1);
+
+   // drop trailing zeros from the mantissa
+   int nsig = digits;
+   for (const char* p = pExponent - 1; nsig > 1 && *p == '0'; p--)
+      nsig--;
+   *pNSig = nsig;
+}
+
+// formats doubles with a common number of decimals (or in scientific
+// notation) in the way format() does for the same values, digits and
+// scipen. NA values are marked rather than formatted.
+void formatNumbers(const std::vector<double>& values,
+                   int digits,
+                   int scipen,
+                   std::string* pCells,
+                   std::vector<bool>::iterator na)
+{
+   bool neg = false, anyFinite = false;
+   int mxsl = 1, rgt = 0, mxe = 0, mne = 0, mxns = 1;
+   BOOST_FOREACH(double value, values)
+   {
+      if (!R_FINITE(value))
+         continue;
+
+      int kpower, nsig;
+      scientific(value, digits, &kpower, &nsig);
+      bool sgn = value < 0;
+      int sleft = (sgn ? 1 : 0) + ((kpower >= 1) ? kpower + 1 : 1);
+      if (!anyFinite)
+      {
+         mxsl = sleft;
+         mxe = mne = kpower;
+         mxns = nsig;
+      }
+      mxsl = std::max(mxsl, sleft);
+      rgt = std::max(rgt, std::max(0, nsig - kpower - 1));
+      mxe = std::max(mxe, kpower);
+      mne = std::min(mne, kpower);
+      mxns = std::max(mxns, nsig);
+      neg = neg || sgn;
+      anyFinite = true;
+   }
+
+   // use fixed notation unless it's wider than scientific (by more than
+   // the scipen penalty)
+   int e = (mxe >= 100 || mne <= -99) ? 2 : 1;
+   int d = mxns - 1;
+   int wE = (neg ? 1 : 0) + (d > 0 ? 1 : 0) + d + 4 + e;
+   int wF = mxsl + rgt + (rgt > 0 ? 1 : 0);
+   bool fixed = wF <= wE + scipen;
+
+   char buffer[512];
+   for (std::size_t i = 0; i < values.size(); i++, ++na)
+   {
+      double value = values[i];
+      if (R_IsNA(value))
+      {
+         *na = true;
+      }
+      else if (ISNAN(value))
+      {
+         pCells[i] = "NaN";
+      }
+      else if (!R_FINITE(value))
+      {
+         pCells[i] = value > 0 ? "Inf" : "-Inf";
+      }
+      else
+      {
+         // avoid showing negative zero
+         if (value == 0)
+            value = 0;
+         std::snprintf(buffer, sizeof(buffer),
+                       fixed ? "%.*f" : "%.*e",
+                       fixed ? rgt : d,
+                       value);
+         pCells[i] = buffer;
+      }
+   }
+}
+
+int integerOption(const std::string& name, int defaultValue)
+{
+   SEXP valueSEXP = r::options::getOption(name);
+   if (Rf_length(valueSEXP) == 0)
+      return defaultValue;
+   int value = Rf_asInteger(valueSEXP);
+   return value == NA_INTEGER ? defaultValue : value;
+}
+
+void formatInteger(int value, std::string* pValue)
+{
+   char buffer[32];
+   std::snprintf(buffer, sizeof(buffer), "%d", value);
+   pValue->assign(buffer);
+}
+
+// GridSnapshot reads the columns of a frame for formatting. it's made (and
+// destroyed) on the main thread, but pages can be formatted from it on any
+// thread.
+class GridSnapshot : boost::noncopyable
+{
+public:
+   // returns an empty pointer if the frame has columns we can't read
+   static boost::shared_ptr<GridSnapshot> create(SEXP dataSEXP,
+                                                 int ncol,
+                                                 int nrow,
+                                                 int filteredNRow,
+                                                 const std::vector<int>* pRows)
+   {
+      boost::shared_ptr<GridSnapshot> pSnapshot;
+      if (TYPEOF(dataSEXP) != VECSXP || Rf_length(dataSEXP) < ncol)
+         return pSnapshot;
+
+      // the rows in the data (pRows are indices into these)
+      int dataNRow = ncol > 0 ? Rf_length(VECTOR_ELT(dataSEXP, 0)) : 0;
+
+      std::vector<GridColumn> columns;
+      for (int i = 0; i < ncol; i++)
+      {
+         SEXP columnSEXP = VECTOR_ELT(dataSEXP, i);
+         if (Rf_length(columnSEXP) != dataNRow)
+            return pSnapshot;
+
+         GridColumn column;
+         if (OBJECT(columnSEXP))
+         {
+            if (TYPEOF(columnSEXP) != INTSXP ||
+                !Rf_inherits(columnSEXP, "factor"))
+            {
+               return pSnapshot;
+            }
+
+            column.type = GRID_COLUMN_FACTOR;
+            column.pIntegers = INTEGER(columnSEXP);
+            SEXP levelsSEXP = Rf_getAttrib(columnSEXP, R_LevelsSymbol);
+            if (TYPEOF(levelsSEXP) != STRSXP)
+               return pSnapshot;
+            for (int j = 0; j < Rf_length(levelsSEXP); j++)
+            {
+               SEXP levelSEXP = STRING_ELT(levelsSEXP, j);
+               column.levels.push_back(levelSEXP == NA_STRING ?
+                     std::string() : Rf_translateCharUTF8(levelSEXP));
+            }
+         }
+         else
+         {
+            switch (TYPEOF(columnSEXP))
+            {
+            case INTSXP:
+               column.type = GRID_COLUMN_NUMBER;
+               column.pIntegers = INTEGER(columnSEXP);
+               break;
+            case REALSXP:
+               column.type = GRID_COLUMN_NUMBER;
+               column.pDoubles = REAL(columnSEXP);
+               break;
+            case LGLSXP:
+               column.type = GRID_COLUMN_LOGICAL;
+               column.pIntegers = LOGICAL(columnSEXP);
+               break;
+            case STRSXP:
+               column.type = GRID_COLUMN_CHARACTER;
+               column.pStrings = STRING_PTR(columnSEXP);
+               break;
+            default:
+               return pSnapshot;
+            }
+         }
+         columns.push_back(column);
+      }
+
+      // row names are either automatic (stored compactly), integers or
+      // strings
+      r::sexp::Protect protect;
+      SEXP rowNamesSEXP = R_NilValue;
+      Error error = r::exec::RFunction(".row_names_info", dataSEXP, 0)
+            .call(&rowNamesSEXP, &protect);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return pSnapshot;
+      }
+      bool automaticRowNames = TYPEOF(rowNamesSEXP) == INTSXP &&
+                               Rf_length(rowNamesSEXP) == 2 &&
+                               INTEGER(rowNamesSEXP)[0] == NA_INTEGER;
+      if (!automaticRowNames &&
+          !((TYPEOF(rowNamesSEXP) == INTSXP ||
+             TYPEOF(rowNamesSEXP) == STRSXP) &&
+            Rf_length(rowNamesSEXP) == dataNRow))
+      {
+         return pSnapshot;
+      }
+
+      bool utf8Locale = false;
+      error = r::exec::evaluateString("l10n_info()[[\"UTF-8\"]]", &utf8Locale);
+      if (error)
+         LOG_ERROR(error);
+
+      pSnapshot.reset(new GridSnapshot(dataSEXP, nrow, filteredNRow));
+      pSnapshot->columns_ = columns;
+      if (pRows)
+      {
+         pSnapshot->hasRows_ = true;
+         pSnapshot->rows_ = *pRows;
+      }
+      if (!automaticRowNames)
+         pSnapshot->rowNames_.set(rowNamesSEXP);
+      pSnapshot->utf8Locale_ = utf8Locale;
+      pSnapshot->digits_ = std::min(std::max(integerOption("digits", 7), 1), 22);
+      pSnapshot->scipen_ = integerOption("scipen", 0);
+      return pSnapshot;
+   }
+
+   int nrow() const { return nrow_; }
+   int filteredNRow() const { return filteredNRow_; }
+   int ncol() const { return static_cast<int>(columns_.size()); }
+
+   // format the given (0-based) page of rows; returns false if the page has
+   // text we can't read off the main thread
+   bool formatPage(int start, int length, GridPage* pPage) const
+   {
+      int ncol = this->ncol();
+      pPage->start = start;
+      pPage->length = length;
+      pPage->ncol = ncol;
+      pPage->rowNumbers.resize(length);
+      pPage->rowNames.resize(length);
+      pPage->cells.assign(ncol * length, std::string());
+      pPage->na.assign(ncol * length, false);
+
+      // the rows of the data on the page
+      std::vector<int> rows(length);
+      for (int i = 0; i < length; i++)
+      {
+         rows[i] = hasRows_ ? rows_[start + i] : start + i;
+         pPage->rowNumbers[i] = hasRows_ ? rows[i] + 1 : start + i + 1;
+      }
+
+      // row names
+      SEXP rowNamesSEXP = rowNames_.get();
+      for (int i = 0; i < length; i++)
+      {
+         if (TYPEOF(rowNamesSEXP) == STRSXP)
+         {
+            SEXP nameSEXP = STRING_PTR(rowNamesSEXP)[rows[i]];
+            if (nameSEXP != NA_STRING &&
+                !readString(nameSEXP, utf8Locale_, &pPage->rowNames[i]))
+            {
+               return false;
+            }
+         }
+         else if (TYPEOF(rowNamesSEXP) == INTSXP)
+         {
+            formatInteger(INTEGER(rowNamesSEXP)[rows[i]],
+                          &pPage->rowNames[i]);
+         }
+         else
+         {
+            formatInteger(rows[i] + 1, &pPage->rowNames[i]);
+         }
+      }
+
+      // cells
+      std::vector<double> values(length);
+      for (int col = 0; col < ncol; col++)
+      {
+         const GridColumn& column = columns_[col];
+         std::string* pCells = &pPage->cells[col * length];
+         std::vector<bool>::iterator na = pPage->na.begin() + col * length;
+
+         switch (column.type)
+         {
+         case GRID_COLUMN_NUMBER:
+            for (int i = 0; i < length; i++)
+            {
+               if (column.pDoubles)
+                  values[i] = column.pDoubles[rows[i]];
+               else if (column.pIntegers[rows[i]] == NA_INTEGER)
+                  values[i] = NA_REAL;
+               else
+                  values[i] = column.pIntegers[rows[i]];
+            }
+            formatNumbers(values, digits_, scipen_, pCells, na);
+            break;
+
+         case GRID_COLUMN_LOGICAL:
+            for (int i = 0; i < length; i++, ++na)
+            {
+               int value = column.pIntegers[rows[i]];
+               if (value == NA_LOGICAL)
+                  *na = true;
+               else
+                  pCells[i] = value ? "TRUE" : "FALSE";
+            }
+            break;
+
+         case GRID_COLUMN_FACTOR:
+            for (int i = 0; i < length; i++, ++na)
+            {
+               int code = column.pIntegers[rows[i]];
+               if (code == NA_INTEGER || code < 1 ||
+                   code > static_cast<int>(column.levels.size()))
+                  *na = true;
+               else
+                  pCells[i] = column.levels[code - 1];
+            }
+            break;
+
+         case GRID_COLUMN_CHARACTER:
+            for (int i = 0; i < length; i++, ++na)
+            {
+               SEXP charSEXP = column.pStrings[rows[i]];
+               if (charSEXP == NA_STRING)
+                  *na = true;
+               else if (!readString(charSEXP, utf8Locale_, &pCells[i]))
+                  return false;
+            }
+            break;
+         }
+      }
+
+      return true;
+   }
+
+private:
+   GridSnapshot(SEXP dataSEXP, int nrow, int filteredNRow)
+      : data_(dataSEXP), nrow_(nrow), filteredNRow_(filteredNRow),
+        hasRows_(false), utf8Locale_(false), digits_(7), scipen_(0)
+   {
+   }
+
+   r::sexp::PreservedSEXP data_;
+   int nrow_;
+   int filteredNRow_;
+   std::vector<GridColumn> columns_;
+   bool hasRows_;
+   std::vector<int> rows_;
+   r::sexp::PreservedSEXP rowNames_;
+   bool utf8Locale_;
+   int digits_;
+   int scipen_;
+};
+
+// a view's snapshot and its most recently used pages. the snapshot is only
+// read with the view's mutex held, so the main thread can release it (and
+// the R objects it refers to) once it has taken it out of the view.
+struct GridView : boost::noncopyable
+{
+   GridView() : dataSEXP(NULL) {}
+
+   boost::mutex mutex;
+   GridQuery query;
+   SEXP dataSEXP;
+   boost::shared_ptr<GridSnapshot> pSnapshot;
+   std::list<boost::shared_ptr<const GridPage> > pages;
+};
+
+boost::mutex s_viewsMutex;
+std::map<std::string, boost::shared_ptr<GridView> > s_views;
+
+boost::shared_ptr<GridView> findView(const std::string& cacheKey,
+                                     bool create = false)
+{
+   LOCK_MUTEX(s_viewsMutex)
+   {
+      if (create)
+      {
+         boost::shared_ptr<GridView>& pView = s_views[cacheKey];
+         if (!pView)
+            pView.reset(new GridView());
+         return pView;
+      }
+
+      std::map<std::string, boost::shared_ptr<GridView> >::const_iterator it =
+            s_views.find(cacheKey);
+      if (it != s_views.end())
+         return it->second;
+   }
+   END_LOCK_MUTEX
+
+   return boost::shared_ptr<GridView>();
+}
+
+// finds (or formats) a page; requires the view's mutex
+bool viewPage(GridView* pView,
+              int start,
+              int length,
+              boost::shared_ptr<const GridPage>* pPage)
+{
+   typedef std::list<boost::shared_ptr<const GridPage> >::iterator iterator;
+   for (iterator it = pView->pages.begin(); it != pView->pages.end(); ++it)
+   {
+      if ((*it)->start == start && (*it)->length == length)
+      {
+         *pPage = *it;
+         pView->pages.splice(pView->pages.begin(), pView->pages, it);
+         return true;
+      }
+   }
+
+   boost::shared_ptr<GridPage> pNewPage(new GridPage());
+   if (!pView->pSnapshot->formatPage(start, length, pNewPage.get()))
+      return false;
+
+   // (empty pages, e.g. those past the end, aren't worth a place in the cache)
+   *pPage = pNewPage;
+   if (length == 0)
+      return true;
+
+   pView->pages.push_front(pNewPage);
+   if (pView->pages.size() > kMaxCachedPages)
+      pView->pages.pop_back();
+   return true;
+}
+
+void prefetchPage(const std::string& cacheKey,
+                  const GridQuery& query,
+                  int start,
+                  int length)
+{
+   boost::shared_ptr<const GridPage> pPage;
+   int nrow, filteredNRow;
+   readGridPage(cacheKey, query, start, length, &pPage, &nrow, &filteredNRow);
+}
+
+} // anonymous namespace
+
+void updateGridSnapshot(const std::string& cacheKey,
+                        const GridQuery& query,
+                        SEXP dataSEXP,
+                        int ncol,
+                        int nrow,
+                        int filteredNRow,
+                        const std::vector<int>* pRows)
+{
+   boost::shared_ptr<GridView> pView = findView(cacheKey, true);
+   if (!pView)
+      return;
+
+   boost::shared_ptr<GridSnapshot> pOldSnapshot;
+   LOCK_MUTEX(pView->mutex)
+   {
+      if (pView->dataSEXP == dataSEXP && pView->query == query &&
+          (!pView->pSnapshot || pView->pSnapshot->ncol() == ncol))
+      {
+         return;
+      }
+
+      // (views we can't snapshot keep an empty one, so that we don't try
+      // again for each page)
+      pOldSnapshot = pView->pSnapshot;
+      pView->pSnapshot = GridSnapshot::create(dataSEXP, ncol, nrow,
+                                              filteredNRow, pRows);
+      pView->query = query;
+      pView->dataSEXP = dataSEXP;
+      pView->pages.clear();
+   }
+   END_LOCK_MUTEX
+
+   // (the old snapshot is released here, on the main thread)
+}
+
+void removeGridSnapshot(const std::string& cacheKey)
+{
+   boost::shared_ptr<GridView> pView;
+   LOCK_MUTEX(s_viewsMutex)
+   {
+      std::map<std::string, boost::shared_ptr<GridView> >::iterator it =
+            s_views.find(cacheKey);
+      if (it == s_views.end())
+         return;
+      pView = it->second;
+      s_views.erase(it);
+   }
+   END_LOCK_MUTEX
+
+   if (!pView)
+      return;
+
+   boost::shared_ptr<GridSnapshot> pOldSnapshot;
+   LOCK_MUTEX(pView->mutex)
+   {
+      pOldSnapshot = pView->pSnapshot;
+      pView->pSnapshot.reset();
+      pView->dataSEXP = NULL;
+      pView->pages.clear();
+   }
+   END_LOCK_MUTEX
+}
+
+void evictGridPages()
+{
+   std::vector<boost::shared_ptr<GridView> > views;
+   LOCK_MUTEX(s_viewsMutex)
+   {
+      for (std::map<std::string, boost::shared_ptr<GridView> >::iterator it =
+              s_views.begin(); it != s_views.end(); ++it)
+      {
+         views.push_back(it->second);
+      }
+   }
+   END_LOCK_MUTEX
+
+   for (std::size_t i = 0; i < views.size(); i++)
+   {
+      LOCK_MUTEX(views[i]->mutex)
+      {
+         views[i]->pages.clear();
+      }
+      END_LOCK_MUTEX
+   }
+}
+
+int gridSnapshotColumns(const std::string& cacheKey)
+{
+   boost::shared_ptr<GridView> pView = findView(cacheKey);
+   if (!pView)
+      return -1;
+
+   LOCK_MUTEX(pView->mutex)
+   {
+      return pView->pSnapshot ? pView->pSnapshot->ncol() : -1;
+   }
+   END_LOCK_MUTEX
+
+   return -1;
+}
+
+bool readGridPage(const std::string& cacheKey,
+                  const GridQuery& query,
+                  int start,
+                  int length,
+                  boost::shared_ptr<const GridPage>* pPage,
+                  int* pNRow,
+                  int* pFilteredNRow)
+{
+   boost::shared_ptr<GridView> pView = findView(cacheKey);
+   if (!pView)
+      return false;
+
+   LOCK_MUTEX(pView->mutex)
+   {
+      if (!pView->pSnapshot || !(pView->query == query))
+         return false;
+
+      *pNRow = pView->pSnapshot->nrow();
+      *pFilteredNRow = pView->pSnapshot->filteredNRow();
+
+      // return the lesser of the rows available and rows requested
+      start = std::max(start, 0);
+      length = std::max(std::min(length, *pFilteredNRow - start), 0);
+      return viewPage(pView.get(), start, length, pPage);
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+void prefetchGridPages(const std::string& cacheKey,
+                       const GridQuery& query,
+                       int start,
+                       int length)
+{
+   if (length <= 0)
+      return;
+
+   // (the page after is the one usually wanted next)
+   worker_pool::execute(boost::bind(prefetchPage, cacheKey, query,
+                                    start + length, length),
+                        core::thread::TaskPriorityLow);
+   if (start > 0)
+      worker_pool::execute(boost::bind(prefetchPage, cacheKey, query,
+                                       std::max(start - length, 0), length),
+                           core::thread::TaskPriorityLow);
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,117 @@
+/*
+ * DataViewerPages.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_PAGES_HPP
+#define SESSION_DATA_VIEWER_PAGES_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// The parameters of a grid data request which determine the rows shown
+struct GridQuery
+{
+   GridQuery() : orderCol(-1) {}
+
+   std::vector<std::string> filters;
+   std::string search;
+   int orderCol;
+   std::string orderDir;
+
+   bool operator==(const GridQuery& other) const
+   {
+      return filters == other.filters &&
+             search == other.search &&
+             orderCol == other.orderCol &&
+             orderDir == other.orderDir;
+   }
+};
+
+// A page of formatted cells, ready to be written to the client
+struct GridPage
+{
+   int start;
+   int length;
+   int ncol;
+
+   // row numbers (1-based) and names; rows without a name show the number
+   std::vector<int> rowNumbers;
+   std::vector<std::string> rowNames;
+
+   // cell text and NA markers, by column (cells[col * length + row])
+   std::vector<std::string> cells;
+   std::vector<bool> na;
+};
+
+// Each grid view keeps a snapshot of the columns it shows: pointers to
+// their data (of integer, double, logical, character and factor columns)
+// along with the order of the rows. Pages are formatted from the snapshot
+// in C++ rather than with format() in R, so they can be formatted on the
+// worker pool, even while R is busy. The view keeps the most recently used
+// pages, and pages adjacent to those requested are formatted ahead of time.
+
+// (main thread) make sure the view's snapshot is of the given data with
+// the given (0-based) rows (or all rows if pRows is NULL). views whose
+// columns can't be snapshotted don't have pages.
+void updateGridSnapshot(const std::string& cacheKey,
+                        const GridQuery& query,
+                        SEXP dataSEXP,
+                        int ncol,
+                        int nrow,
+                        int filteredNRow,
+                        const std::vector<int>* pRows);
+
+// (main thread) drop the view's snapshot and pages
+void removeGridSnapshot(const std::string& cacheKey);
+
+// drop the formatted pages of all views (they're reformatted on demand)
+void evictGridPages();
+
+// the number of columns in the view's snapshot, or -1 if it has none
+int gridSnapshotColumns(const std::string& cacheKey);
+
+// get a page of the view (from the cache if it's there), along with its
+// row counts. returns false if the view has no snapshot for the query, or
+// the page can't be formatted off the main thread.
+bool readGridPage(const std::string& cacheKey,
+                  const GridQuery& query,
+                  int start,
+                  int length,
+                  boost::shared_ptr<const GridPage>* pPage,
+                  int* pNRow,
+                  int* pFilteredNRow);
+
+// format the pages before and after the given one on the worker pool
+void prefetchGridPages(const std::string& cacheKey,
+                       const GridQuery& query,
+                       int start,
+                       int length);
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_PAGES_HPP
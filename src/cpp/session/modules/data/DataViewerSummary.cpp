@@ -0,0 +1,275 @@
+/*
+ * DataViewerSummary.cpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "DataViewerSummary.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RSexp.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// estimates the number of distinct values added to it (a HyperLogLog
+// sketch, which is accurate to within a few percent in 4K of registers)
+class DistinctCounter
+{
+public:
+   DistinctCounter() : registers_(kRegisters, 0) {}
+
+   void add(boost::uint64_t value)
+   {
+      boost::uint64_t hash = mix(value);
+      std::size_t index = static_cast<std::size_t>(hash >> (64 - kPrecision));
+
+      // the position of the first set bit in the remaining bits
+      boost::uint64_t rest = hash << kPrecision;
+      unsigned char rank = 1;
+      while (rank <= 64 - kPrecision && !(rest & (1ULL << 63)))
+      {
+         rest <<= 1;
+         rank++;
+      }
+
+      if (rank > registers_[index])
+         registers_[index] = rank;
+   }
+
+   double estimate() const
+   {
+      double m = kRegisters;
+      double sum = 0;
+      int zeros = 0;
+      for (std::size_t i = 0; i < registers_.size(); i++)
+      {
+         sum += std::ldexp(1.0, -registers_[i]);
+         if (registers_[i] == 0)
+            zeros++;
+      }
+
+      // use linear counting for small cardinalities
+      double estimate = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+      if (estimate <= 2.5 * m && zeros > 0)
+         estimate = m * std::log(m / zeros);
+      return estimate;
+   }
+
+private:
+   static const int kPrecision = 12;
+   static const std::size_t kRegisters = 1 << kPrecision;
+
+   static boost::uint64_t mix(boost::uint64_t x)
+   {
+      x += 0x9E3779B97F4A7C15ULL;
+      x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+      return x ^ (x >> 31);
+   }
+
+   std::vector<unsigned char> registers_;
+};
+
+boost::uint64_t doubleBits(double value)
+{
+   // (so that 0 and -0 are the same value)
+   if (value == 0)
+      value = 0;
+   boost::uint64_t bits;
+   std::memcpy(&bits, &value, sizeof(bits));
+   return bits;
+}
+
+template <typename T>
+void summarizeNumbers(const T* pValues, int n, bool isInteger,
+                      ColumnSummary* pSummary)
+{
+   DistinctCounter distinct;
+   bool first = true;
+   for (int i = 0; i < n; i++)
+   {
+      double value;
+      if (isInteger)
+      {
+         if (pValues[i] == NA_INTEGER)
+         {
+            pSummary->naCount++;
+            continue;
+         }
+         value = pValues[i];
+      }
+      else
+      {
+         value = pValues[i];
+         if (ISNAN(value))
+         {
+            pSummary->naCount++;
+            continue;
+         }
+      }
+
+      distinct.add(doubleBits(value));
+      if (!R_FINITE(value))
+         continue;
+
+      if (first || value < pSummary->min)
+         pSummary->min = value;
+      if (first || value > pSummary->max)
+         pSummary->max = value;
+      first = false;
+      pSummary->finiteCount++;
+   }
+   pSummary->distinctCount = distinct.estimate();
+
+   // histogram of the finite values
+   pSummary->counts.assign(kSummaryHistogramBins, 0);
+   double width = (pSummary->max - pSummary->min) / kSummaryHistogramBins;
+   if (pSummary->finiteCount == 0 || width <= 0)
+   {
+      pSummary->counts[0] = pSummary->finiteCount;
+      return;
+   }
+   for (int i = 0; i < n; i++)
+   {
+      if (isInteger && pValues[i] == NA_INTEGER)
+         continue;
+      double value = pValues[i];
+      if (!R_FINITE(value))
+         continue;
+      int bin = static_cast<int>((value - pSummary->min) / width);
+      pSummary->counts[std::min(bin, kSummaryHistogramBins - 1)]++;
+   }
+}
+
+void summarizeFactor(SEXP columnSEXP, ColumnSummary* pSummary)
+{
+   int nlevels = Rf_length(Rf_getAttrib(columnSEXP, R_LevelsSymbol));
+   pSummary->counts.assign(nlevels, 0);
+
+   const int* pCodes = INTEGER(columnSEXP);
+   int n = Rf_length(columnSEXP);
+   for (int i = 0; i < n; i++)
+   {
+      int code = pCodes[i];
+      if (code == NA_INTEGER || code < 1 || code > nlevels)
+         pSummary->naCount++;
+      else
+         pSummary->counts[code - 1]++;
+   }
+
+   for (int i = 0; i < nlevels; i++)
+   {
+      if (pSummary->counts[i] > 0)
+         pSummary->distinctCount++;
+   }
+}
+
+void summarizeStrings(SEXP columnSEXP, ColumnSummary* pSummary)
+{
+   // strings are interned (in R's global CHARSXP cache), so each distinct
+   // string has a distinct address
+   DistinctCounter distinct;
+   int n = Rf_length(columnSEXP);
+   for (int i = 0; i < n; i++)
+   {
+      SEXP charSEXP = STRING_ELT(columnSEXP, i);
+      if (charSEXP == NA_STRING)
+         pSummary->naCount++;
+      else
+         distinct.add(reinterpret_cast<boost::uint64_t>(charSEXP));
+   }
+   pSummary->distinctCount = distinct.estimate();
+}
+
+void summarize(SEXP columnSEXP, ColumnSummary* pSummary)
+{
+   if (OBJECT(columnSEXP))
+   {
+      if (TYPEOF(columnSEXP) == INTSXP && Rf_inherits(columnSEXP, "factor"))
+      {
+         pSummary->supported = true;
+         summarizeFactor(columnSEXP, pSummary);
+      }
+      return;
+   }
+
+   switch (TYPEOF(columnSEXP))
+   {
+   case INTSXP:
+      pSummary->supported = pSummary->numeric = true;
+      summarizeNumbers(INTEGER(columnSEXP), Rf_length(columnSEXP), true,
+                       pSummary);
+      break;
+   case REALSXP:
+      pSummary->supported = pSummary->numeric = true;
+      summarizeNumbers(REAL(columnSEXP), Rf_length(columnSEXP), false,
+                       pSummary);
+      break;
+   case STRSXP:
+      pSummary->supported = true;
+      summarizeStrings(columnSEXP, pSummary);
+      break;
+   }
+}
+
+// a summary along with the column it summarizes (preserved, so that the
+// address can't be reused by another column while the summary is kept)
+struct CachedSummary
+{
+   explicit CachedSummary(SEXP sexp) : columnSEXP(sexp) {}
+
+   r::sexp::PreservedSEXP columnSEXP;
+   ColumnSummary summary;
+};
+
+typedef std::map<int, boost::shared_ptr<CachedSummary> > ViewSummaries;
+std::map<std::string, ViewSummaries> s_summaries;
+
+} // anonymous namespace
+
+const ColumnSummary& columnSummary(const std::string& cacheKey,
+                                   int column,
+                                   SEXP columnSEXP)
+{
+   boost::shared_ptr<CachedSummary>& pCached = s_summaries[cacheKey][column];
+   if (!pCached || pCached->columnSEXP.get() != columnSEXP)
+   {
+      pCached.reset(new CachedSummary(columnSEXP));
+      summarize(columnSEXP, &pCached->summary);
+   }
+   return pCached->summary;
+}
+
+void removeColumnSummaries(const std::string& cacheKey)
+{
+   s_summaries.erase(cacheKey);
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
@@ -0,0 +1,77 @@
+/*
+ * DataViewerSummary.hpp
+ *
+ * Copyright (C) 2009-16 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_VIEWER_SUMMARY_HPP
+#define SESSION_DATA_VIEWER_SUMMARY_HPP
+
+#include <string>
+#include <vector>
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// the number of bins in the histograms of numeric columns
+#define kSummaryHistogramBins 20
+
+// A summary of a column's values, used to describe the column's filter.
+// Summaries of integer and double columns have the range of their finite
+// values and a histogram over it; factors have a count of each level.
+struct ColumnSummary
+{
+   ColumnSummary()
+      : supported(false), numeric(false), min(0), max(0), finiteCount(0),
+        naCount(0), distinctCount(0)
+   {
+   }
+
+   bool supported;
+   bool numeric;
+
+   double min;
+   double max;
+   int finiteCount;
+   int naCount;
+
+   // an estimate of the number of distinct (non-NA) values
+   double distinctCount;
+
+   // counts of values in kSummaryHistogramBins equal bins from min to max
+   // (numeric columns), or of each level (factors)
+   std::vector<int> counts;
+};
+
+// get the summary of a column of the frame viewed with the given cache key.
+// summaries are computed natively (in one pass over the column, and another
+// to fill the histogram) and kept until the view's summaries are removed or
+// the column is replaced
+const ColumnSummary& columnSummary(const std::string& cacheKey,
+                                   int column,
+                                   SEXP columnSEXP);
+
+// remove the (cached) column summaries of a view
+void removeColumnSummaries(const std::string& cacheKey);
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namespace session
+} // namespace rstudio
+
+#endif // SESSION_DATA_VIEWER_SUMMARY_HPP
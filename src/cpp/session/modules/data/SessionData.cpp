@@ -19,6 +19,7 @@
 
 #include <session/SessionModuleContext.hpp>
 
+#include "DataImportPreview.hpp"
 #include "DataViewer.hpp"
 
 using namespace rstudio::core ;
@@ -35,6 +36,7 @@ Error initialize()
    ExecBlock initBlock ;
    initBlock.addFunctions()
       (data::viewer::initialize)
+      (data::import_preview::initialize)
       (bind(sourceModuleRFile, "SessionDataImport.R"));
 
    return initBlock.execute();
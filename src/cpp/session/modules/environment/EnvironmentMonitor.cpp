@@ -30,11 +30,11 @@ namespace modules {
 namespace environment {
 namespace {
 
-bool compareVarName(const r::sexp::Variable& var1,
-                    const r::sexp::Variable& var2)
-{
-   return var1.first < var2.first;
-}
+// when more than this many bindings change in a single check it's cheaper
+// for the client to re-list the environment once than to process an event
+// per binding (e.g. after loading a large workspace or sourcing a script
+// that creates thousands of objects)
+const std::size_t kMaxIncrementalChanges = 250;
 
 void enqueRefreshEvent()
 {
@@ -42,36 +42,10 @@ void enqueRefreshEvent()
    module_context::enqueClientEvent(refreshEvent);
 }
 
-// if the given variable is an unevaluated promise, add it to the given
-// list of variables
-void addUnevaledPromise(std::vector<r::sexp::Variable>* pEnv,
-                        const r::sexp::Variable& var)
-{
-   if (isUnevaluatedPromise(var.second))
-   {
-      pEnv->push_back(var);
-   }
-}
-
-// If the given variable exists in the given list, remove it. Compares on name
-// only.
-void removeVarFromList(std::vector<r::sexp::Variable>* pEnv,
-                       const r::sexp::Variable& var)
-{
-   for (std::vector<r::sexp::Variable>::iterator iter = pEnv->begin();
-        iter != pEnv->end(); iter++)
-   {
-      if (iter->first == var.first)
-      {
-         pEnv->erase(iter);
-         break;
-      }
-   }
-}
-
 } // anonymous namespace
 
 EnvironmentMonitor::EnvironmentMonitor() :
+   generation_(0),
    initialized_(false),
    refreshOnInit_(false)
 {}
@@ -85,7 +59,7 @@ void EnvironmentMonitor::enqueRemovedEvent(const r::sexp::Variable& variable)
 void EnvironmentMonitor::enqueAssignedEvent(const r::sexp::Variable& variable)
 {
    // get object info
-   json::Value objInfo = varToJson(getMonitoredEnvironment(), variable);
+   json::Value objInfo = cachedVarToJson(getMonitoredEnvironment(), variable);
 
    // enque event
    ClientEvent assignedEvent(client_events::kEnvironmentAssigned, objInfo);
@@ -130,8 +104,7 @@ void EnvironmentMonitor::listEnv(std::vector<r::sexp::Variable>* pEnv)
 void EnvironmentMonitor::checkForChanges()
 {
    // information about the current environment
-   std::vector<r::sexp::Variable> currentEnv ;
-   std::vector<r::sexp::Variable> currentPromises;
+   std::vector<r::sexp::Variable> currentEnv;
 
    // list of assigns/removes (includes both value changes and promise
    // evaluations)
@@ -141,100 +114,96 @@ void EnvironmentMonitor::checkForChanges()
    // get the set of variables and promises in the current environment
    listEnv(&currentEnv);
 
-   // R returns an environment list sorted in dictionary order. Since the
-   // set difference algorithms below use simple string comparisons to
-   // establish order, we need to re-sort the list into canonical order
-   // to avoid the algorithms detecting superfluous insertions.
-   std::sort(currentEnv.begin(), currentEnv.end(), compareVarName);
+   bool wasEmpty = bindings_.empty();
 
-   std::for_each(currentEnv.begin(), currentEnv.end(),
-                 boost::bind(addUnevaledPromise, &currentPromises, _1));
-
-   bool refreshEnqueued = false;
+   // a fresh monitor (or environment) has nothing to diff against
    if (!initialized_)
+      bindings_.clear();
+
+   // update the fingerprint of every current binding in place, collecting
+   // the ones that are new or whose value changed (this includes promises
+   // which have been forced since the last check)
+   generation_++;
+   for (std::vector<r::sexp::Variable>::const_iterator it = currentEnv.begin();
+        it != currentEnv.end(); ++it)
    {
-      if (refreshOnInit_ ||
-          getMonitoredEnvironment() == R_GlobalEnv)
+      Binding binding;
+      binding.fingerprint = bindingFingerprint(it->second);
+      binding.generation = generation_;
+
+      std::pair<Bindings::iterator, bool> result =
+            bindings_.insert(std::make_pair(it->first, binding));
+      if (!result.second)
       {
-         enqueRefreshEvent();
-         refreshEnqueued = true;
+         if (result.first->second.fingerprint != binding.fingerprint)
+            addedVars.push_back(*it);
+         result.first->second = binding;
+      }
+      else
+      {
+         addedVars.push_back(*it);
       }
-      initialized_ = true;
-      refreshOnInit_ = false;
    }
-   else
+
+   // any binding not seen in this pass was removed; names are unique so
+   // there's nothing to sweep unless the map outgrew the listing
+   if (bindings_.size() > currentEnv.size())
    {
-      if (currentEnv != lastEnv_)
+      for (Bindings::iterator it = bindings_.begin(); it != bindings_.end(); )
       {
-         // optimize for empty currentEnv (user reset workspace) or empty
-         // lastEnv_ (startup) by just sending a single refresh event
-         // only do this for the global environment--while debugging local
-         // environments, the environment object list is sent down as part of
-         // the context depth event.
-         if ((currentEnv.empty() || lastEnv_.empty())
-             && getMonitoredEnvironment() == R_GlobalEnv)
+         if (it->second.generation != generation_)
          {
-            enqueRefreshEvent();
-            refreshEnqueued = true;
+            removedVars.push_back(
+                     std::make_pair(it->first, it->second.fingerprint.value));
+            removeCachedVar(it->first);
+            it = bindings_.erase(it);
          }
          else
          {
-            std::set_difference(lastEnv_.begin(), lastEnv_.end(),
-                                currentEnv.begin(), currentEnv.end(),
-                                std::back_inserter(removedVars),
-                                compareVarName);
-
-            // fire removed event for deletes
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(&EnvironmentMonitor::enqueRemovedEvent,
-                                      this, _1));
-
-            // remove deleted objects from the list of uneval'ed promises
-            // so we'll stop monitoring them for evaluation
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
-            // find adds & assigns (all variable name/value combinations in the
-            // current environment but NOT in the previous environment)
-            std::set_difference(currentEnv.begin(), currentEnv.end(),
-                                lastEnv_.begin(), lastEnv_.end(),
-                                std::back_inserter(addedVars));
-
-            // remove assigned objects from the list of uneval'ed promises
-            // (otherwise, we double-assign in the case where a promise SEXP
-            // is simultaneously forced/evaluated and assigned a new value)
-            std::for_each(addedVars.begin(),
-                          addedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
+            ++it;
          }
       }
-      // if a refresh is scheduled there's no need to emit add events one by one
-      if (!refreshEnqueued)
-      {
-         // have any promises been evaluated since we last checked?
-         if (currentPromises != unevaledPromises_)
-         {
-            // for each promise that is in the set of promises we are monitoring
-            // for evaluation but not in the set of currently tracked promises,
-            // we assume this to be an eval--process as an assign
-            std::set_difference(unevaledPromises_.begin(), unevaledPromises_.end(),
-                                currentPromises.begin(), currentPromises.end(),
-                                std::back_inserter(addedVars));
-         }
+   }
 
-         // fire assigned event for adds, assigns, and promise evaluations
-         std::for_each(addedVars.begin(),
-                       addedVars.end(),
-                       boost::bind(&EnvironmentMonitor::enqueAssignedEvent,
-                                    this, _1));
+   if (!initialized_)
+   {
+      if (refreshOnInit_ ||
+          getMonitoredEnvironment() == R_GlobalEnv)
+      {
+         enqueRefreshEvent();
       }
+      initialized_ = true;
+      refreshOnInit_ = false;
+      return;
+   }
+
+   if (addedVars.empty() && removedVars.empty())
+      return;
+
+   // optimize for empty currentEnv (user reset workspace) or empty previous
+   // environment (startup) by just sending a single refresh event. only do
+   // this for the global environment--while debugging local environments,
+   // the environment object list is sent down as part of the context depth
+   // event. large batches of changes are also sent as a single refresh.
+   if (((currentEnv.empty() || wasEmpty) &&
+        getMonitoredEnvironment() == R_GlobalEnv) ||
+       (addedVars.size() + removedVars.size() > kMaxIncrementalChanges))
+   {
+      enqueRefreshEvent();
+      return;
    }
 
-   unevaledPromises_ = currentPromises;
-   lastEnv_ = currentEnv;
+   // fire removed event for deletes
+   std::for_each(removedVars.begin(),
+                 removedVars.end(),
+                 boost::bind(&EnvironmentMonitor::enqueRemovedEvent,
+                             this, _1));
+
+   // fire assigned event for adds, assigns, and promise evaluations
+   std::for_each(addedVars.begin(),
+                 addedVars.end(),
+                 boost::bind(&EnvironmentMonitor::enqueAssignedEvent,
+                             this, _1));
 }
 
 } // namespace environment
@@ -13,16 +13,22 @@
  *
  */
 
+#include <boost/unordered_map.hpp>
+
 #include <r/RSexp.hpp>
 #include <r/RInterface.hpp>
 
+#include "EnvironmentUtils.hpp"
+
 namespace rstudio {
 namespace session {
 namespace modules {
 namespace environment {
 
 // EnvironmentMonitor listens for changes to objects in the given environment
-// context, and emits object add/remove events.
+// context, and emits object add/remove events. Rather than diffing sorted
+// listings, it keeps a fingerprint of each binding keyed by name and emits
+// events only for the bindings whose fingerprint changed.
 class EnvironmentMonitor : boost::noncopyable
 {
 public:
@@ -32,12 +38,24 @@ public:
    bool hasEnvironment();
    void checkForChanges();
 private:
+   struct Binding
+   {
+      Binding() : generation(0) {}
+
+      BindingFingerprint fingerprint;
+
+      // check in which the binding was last seen
+      unsigned int generation;
+   };
+
+   typedef boost::unordered_map<std::string, Binding> Bindings;
+
    void listEnv(std::vector<r::sexp::Variable>* pEnvironment);
    void enqueRemovedEvent(const r::sexp::Variable& variable);
    void enqueAssignedEvent(const r::sexp::Variable& variable);
 
-   std::vector<r::sexp::Variable> lastEnv_;
-   std::vector<r::sexp::Variable> unevaledPromises_;
+   Bindings bindings_;
+   unsigned int generation_;
    r::sexp::PreservedSEXP environment_;
    bool initialized_;
    bool refreshOnInit_;
@@ -15,6 +15,9 @@
 
 #include "EnvironmentUtils.hpp"
 
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
 #include <r/RExec.hpp>
 #include <r/RJson.hpp>
 #include <core/FileSerializer.hpp>
@@ -33,6 +36,93 @@ namespace {
 // of a variable
 const char UNKNOWN_VALUE[] = "<unknown>";
 
+// number of elements sampled from each end of a vector when fingerprinting
+const int kFingerprintSampleSize = 4;
+
+struct CachedDescription
+{
+   BindingFingerprint fingerprint;
+   json::Value description;
+};
+
+// descriptions of the bindings in the most recently described environment
+SEXP s_cachedEnv = NULL;
+boost::unordered_map<std::string, CachedDescription> s_descriptionCache;
+
+void hashElement(SEXP value, int i, std::size_t* pHash)
+{
+   switch (TYPEOF(value))
+   {
+   case LGLSXP:
+      boost::hash_combine(*pHash, LOGICAL(value)[i]);
+      break;
+   case INTSXP:
+      boost::hash_combine(*pHash, INTEGER(value)[i]);
+      break;
+   case REALSXP:
+      boost::hash_combine(*pHash, REAL(value)[i]);
+      break;
+   case RAWSXP:
+      boost::hash_combine(*pHash, RAW(value)[i]);
+      break;
+   case STRSXP:
+      // CHARSXPs are cached, so equal strings share an address
+      boost::hash_combine(*pHash,
+                          static_cast<void*>(STRING_ELT(value, i)));
+      break;
+   case VECSXP:
+   case EXPRSXP:
+      boost::hash_combine(*pHash,
+                          static_cast<void*>(VECTOR_ELT(value, i)));
+      break;
+   default:
+      break;
+   }
+}
+
+// hash a few elements from each end of the vector; this catches the common
+// in-place modifications (e.g. x[1] <- 0, x[[n]] <- y) without walking the
+// whole vector
+std::size_t sampleHash(SEXP value, int length)
+{
+   std::size_t hash = 0;
+   if (length <= 2 * kFingerprintSampleSize)
+   {
+      for (int i = 0; i < length; i++)
+         hashElement(value, i, &hash);
+   }
+   else
+   {
+      for (int i = 0; i < kFingerprintSampleSize; i++)
+         hashElement(value, i, &hash);
+      for (int i = length - kFingerprintSampleSize; i < length; i++)
+         hashElement(value, i, &hash);
+   }
+   return hash;
+}
+
+// descriptions of these values are cheap or can change without anything
+// in the fingerprint changing (e.g. the contents of an environment)
+bool isCacheable(SEXP value)
+{
+   if (value == NULL ||
+       value == R_NilValue ||
+       value == R_UnboundValue ||
+       value == R_MissingArg)
+      return false;
+
+   switch (TYPEOF(value))
+   {
+   case ENVSXP:
+   case PROMSXP:
+   case EXTPTRSXP:
+   case WEAKREFSXP:
+      return false;
+   default:
+      return true;
+   }
+}
+
 json::Value descriptionOfVar(SEXP var)
 {
    std::string value;
@@ -82,6 +172,60 @@ json::Value languageVarToJson(SEXP env, std::string objectName)
    }
 }
 
+BindingFingerprint bindingFingerprint(SEXP value)
+{
+   BindingFingerprint fp;
+   fp.value = value;
+   if (value == NULL || value == R_NilValue)
+      return fp;
+
+   // NAMED catches values that became shared, length catches in-place
+   // growth, and the attribute and sample hashes catch attr<- and element
+   // assignment on an unshared value
+   fp.named = NAMED(value);
+   if (Rf_isVector(value))
+   {
+      fp.length = Rf_length(value);
+      fp.sampleHash = sampleHash(value, fp.length);
+   }
+   for (SEXP attrib = ATTRIB(value);
+        attrib != R_NilValue && TYPEOF(attrib) == LISTSXP;
+        attrib = CDR(attrib))
+   {
+      boost::hash_combine(fp.attribHash, static_cast<void*>(TAG(attrib)));
+      boost::hash_combine(fp.attribHash, static_cast<void*>(CAR(attrib)));
+   }
+   fp.unevaledPromise = isUnevaluatedPromise(value);
+   return fp;
+}
+
+json::Value cachedVarToJson(SEXP env, const r::sexp::Variable& var)
+{
+   // active bindings are listed with a NULL value, so aren't cached either
+   if (!isCacheable(var.second))
+      return varToJson(env, var);
+
+   if (env != s_cachedEnv)
+   {
+      s_descriptionCache.clear();
+      s_cachedEnv = env;
+   }
+
+   BindingFingerprint fp = bindingFingerprint(var.second);
+   CachedDescription& cached = s_descriptionCache[var.first];
+   if (cached.fingerprint != fp || cached.description.is_null())
+   {
+      cached.fingerprint = fp;
+      cached.description = varToJson(env, var);
+   }
+   return cached.description;
+}
+
+void removeCachedVar(const std::string& name)
+{
+   s_descriptionCache.erase(name);
+}
+
 json::Value varToJson(SEXP env, const r::sexp::Variable& var)
 {
    json::Object varJson;
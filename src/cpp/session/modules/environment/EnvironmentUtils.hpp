@@ -13,6 +13,9 @@
  *
  */
 
+#ifndef SESSION_ENVIRONMENT_UTILS_HPP
+#define SESSION_ENVIRONMENT_UTILS_HPP
+
 #include <core/json/Json.hpp>
 #include <r/RSexp.hpp>
 
@@ -21,7 +24,48 @@ namespace session {
 namespace modules {
 namespace environment {
 
+// cheap summary of a binding's value, used to detect changes without
+// describing the value. the SEXP is compared by address only and is never
+// dereferenced once the listing it came from goes out of scope.
+struct BindingFingerprint
+{
+   BindingFingerprint()
+      : value(NULL), named(0), length(0), attribHash(0), sampleHash(0),
+        unevaledPromise(false)
+   {
+   }
+
+   bool operator==(const BindingFingerprint& other) const
+   {
+      return value == other.value &&
+             named == other.named &&
+             length == other.length &&
+             attribHash == other.attribHash &&
+             sampleHash == other.sampleHash &&
+             unevaledPromise == other.unevaledPromise;
+   }
+
+   bool operator!=(const BindingFingerprint& other) const
+   {
+      return !(*this == other);
+   }
+
+   SEXP value;
+   int named;
+   int length;
+   std::size_t attribHash;
+   std::size_t sampleHash;
+   bool unevaledPromise;
+};
+
+BindingFingerprint bindingFingerprint(SEXP value);
+
 core::json::Value varToJson(SEXP env, const r::sexp::Variable& var);
+
+// same as varToJson, but reuses the description computed for the binding
+// the last time it was described if its fingerprint hasn't changed since
+core::json::Value cachedVarToJson(SEXP env, const r::sexp::Variable& var);
+void removeCachedVar(const std::string& name);
 bool isUnevaluatedPromise(SEXP var);
 bool functionDiffersFromSource(SEXP srcRef, const std::string& functionCode);
 void sourceRefToJson(const SEXP srcref, core::json::Object* pObject);
@@ -31,3 +75,5 @@ core::Error sourceFileFromRef(const SEXP srcref, std::string* pFileName);
 } // namespace modules
 } // namespace session
 } // namespace rstudio
+
+#endif // SESSION_ENVIRONMENT_UTILS_HPP
@@ -20,6 +20,7 @@
 
 #include <core/Exec.hpp>
 #include <core/RecursionGuard.hpp>
+#include <core/json/JsonWriter.hpp>
 
 #define INTERNAL_R_FUNCTIONS
 #include <r/RJson.hpp>
@@ -510,7 +511,7 @@ json::Array environmentListAsJson()
        std::transform(vars.begin(),
                       vars.end(),
                       std::back_inserter(listJson),
-                      boost::bind(varToJson, env, _1));
+                      boost::bind(cachedVarToJson, env, _1));
     }
 
     return listJson;
@@ -525,6 +526,48 @@ Error listEnvironment(boost::shared_ptr<int> pContextDepth,
    return Success();
 }
 
+// Returns descriptions of at most count objects in the monitored environment,
+// starting at offset, along with the total number of objects. Lets the client
+// describe only the rows it's showing when the environment is very large.
+Error listEnvironmentPage(const json::JsonRpcRequest& request,
+                          json::JsonRpcResponse* pResponse)
+{
+   using namespace rstudio::r::sexp;
+
+   int offset = 0, count = 0;
+   Error error = json::readParams(request.params, &offset, &count);
+   if (error)
+      return error;
+
+   Protect rProtect;
+   std::vector<Variable> vars;
+   json::Array listJson;
+   SEXP env = s_pEnvironmentMonitor->getMonitoredEnvironment();
+   if (env != NULL)
+   {
+      listEnvironment(env,
+                      false,
+                      userSettings().showLastDotValue(),
+                      &rProtect,
+                      &vars);
+
+      int total = static_cast<int>(vars.size());
+      int begin = std::min(std::max(offset, 0), total);
+      int end = std::min(begin + std::max(count, 0), total);
+      std::transform(vars.begin() + begin,
+                     vars.begin() + end,
+                     std::back_inserter(listJson),
+                     boost::bind(cachedVarToJson, env, _1));
+   }
+
+   json::Object result;
+   result["objects"] = listJson;
+   result["offset"] = offset;
+   result["total"] = static_cast<int>(vars.size());
+   pResponse->setResult(result);
+   return Success();
+}
+
 // Sets an environment by name. Used when the environment can be reliably
 // identified by its name (e.g. package environments).
 Error setEnvironmentName(int contextDepth,
@@ -1030,7 +1073,6 @@ Error getObjectContents(const json::JsonRpcRequest& request,
    std::string objectName;
    r::sexp::Protect protect;
    SEXP objContents;
-   json::Value contents;
    Error error = json::readParam(request.params, 0, &objectName);
    if (error)
       return error;
@@ -1041,13 +1083,16 @@ Error getObjectContents(const json::JsonRpcRequest& request,
    if (error)
       return error;
 
-   error = r::json::jsonValueFromObject(objContents, &contents);
+   // contents of large objects can be long, so write them straight to json
+   json::Writer writer;
+   writer.startObject();
+   writer.key("contents");
+   error = r::json::writeJsonFromObject(objContents, &writer);
    if (error)
       return error;
+   writer.endObject();
 
-   json::Object result;
-   result["contents"] = contents;
-   pResponse->setResult(result);
+   pResponse->setRawResult(writer.str());
    return Success();
 }
 
@@ -1091,6 +1136,23 @@ void onConsoleOutput(boost::shared_ptr<LineDebugState> pLineDebugState,
 }
 
 
+// estimate an object's size natively (object.size can take seconds for
+// large nested lists, and counts shared elements repeatedly). the result is
+// approximate if the walk exceeded its time budget
+SEXP rs_objectSize(SEXP objectSEXP)
+{
+   bool approximate = false;
+   double size = r::sexp::objectSize(objectSEXP,
+                                     boost::posix_time::milliseconds(100),
+                                     &approximate);
+
+   r::sexp::Protect protect;
+   SEXP sizeSEXP = r::sexp::create(size, &protect);
+   r::sexp::setAttrib(sizeSEXP, "approximate",
+                      r::sexp::create(approximate, &protect));
+   return sizeSEXP;
+}
+
 SEXP rs_jumpToFunction(SEXP file, SEXP line, SEXP col) 
 {
    json::Object funcLoc;
@@ -1147,6 +1209,11 @@ Error initialize()
             (DL_FUNC) rs_isBrowserActive,
             0);
 
+   r::routines::registerCallMethod(
+            "rs_objectSize",
+            (DL_FUNC) rs_objectSize,
+            1);
+
    R_CallMethodDef methodDef ;
    methodDef.name = "rs_jumpToFunction" ;
    methodDef.fun = (DL_FUNC) rs_jumpToFunction ;
@@ -1191,6 +1258,7 @@ Error initialize()
    initBlock.addFunctions()
       (bind(registerRBrowseFileHandler, handleRBrowseEnv))
       (bind(registerRpcMethod, "list_environment", listEnv))
+      (bind(registerRpcMethod, "list_environment_page", listEnvironmentPage))
       (bind(registerRpcMethod, "set_context_depth", setCtxDepth))
       (bind(registerRpcMethod, "set_environment", setEnvName))
       (bind(registerRpcMethod, "set_environment_frame", setEnvironmentFrame))
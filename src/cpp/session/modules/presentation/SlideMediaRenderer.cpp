@@ -146,7 +146,7 @@ void renderMedia(const std::string& type,
    boost::format fmt("slide%1%%2%");
    std::string mediaId = boost::str(fmt % slideNumber % type);
    fmt = boost::format(
-         "<%1% id=\"%2%\" controls preload=\"auto\" data-ignore>\n"
+         "<%1% id=\"%2%\" controls preload=\"metadata\" data-ignore>\n"
          "  %3%"
          "  The &lt;%1%&gt; tag is not supported in this context"
          " (however the %1% will still play correctly when the presentation"
@@ -25,6 +25,7 @@
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
 #include <core/SafeConvert.hpp>
 #include <core/StringUtils.hpp>
 #include <core/text/DcfParser.hpp>
@@ -219,6 +220,34 @@ std::vector<std::string> Slide::invalidFields() const
 
 namespace {
 
+void hashValue(const std::string& value, hash::Hasher* pHasher)
+{
+   // prefix with the length so adjacent values can't run together
+   pHasher->update(safe_convert::numberToString(value.size()) + ":");
+   pHasher->update(value);
+}
+
+} // anonymous namespace
+
+std::string Slide::sourceHash() const
+{
+   hash::Hasher hasher;
+   hashValue(title_, &hasher);
+   BOOST_FOREACH(const Field& field, fields_)
+   {
+      hashValue(field.first, &hasher);
+      hashValue(field.second, &hasher);
+   }
+   BOOST_FOREACH(const std::string& field, invalidFields_)
+   {
+      hashValue(field, &hasher);
+   }
+   hashValue(content_, &hasher);
+   return hasher.hexDigest();
+}
+
+namespace {
+
 bool insertField(std::vector<Slide::Field>* pFields, const Slide::Field& field)
 {
    // ignore empty records
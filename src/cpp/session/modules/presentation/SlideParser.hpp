@@ -135,6 +135,9 @@ public:
 
    const std::string& content() const { return content_; }
 
+   // hash of everything parsed from the slide's source
+   std::string sourceHash() const;
+
 private:
    std::string title_;
    std::vector<Field> fields_;
@@ -16,6 +16,8 @@
 
 #include "SlideRenderer.hpp"
 
+#include <map>
+
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 #include <boost/regex.hpp>
@@ -23,6 +25,8 @@
 
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
+#include <core/Hash.hpp>
+#include <core/SafeConvert.hpp>
 #include <core/StringUtils.hpp>
 #include <core/json/Json.hpp>
 
@@ -321,6 +325,30 @@ Error slideToHtml(const Slide& slide,
    return Success();
 }
 
+struct RenderedSlide
+{
+   std::string head;
+   std::string html;
+};
+
+typedef std::map<std::string,RenderedSlide> RenderedSlides;
+
+// the slides produced by the last render, keyed by their source and the
+// settings they were rendered with (so refreshing or navigating a deck
+// only renders the slides which have changed)
+RenderedSlides s_renderedSlides;
+
+std::string renderedSlideKey(const Slide& slide,
+                             int slideNumber,
+                             const std::string& extraContent,
+                             const std::string& incremental)
+{
+   return slide.sourceHash() + ":" +
+          safe_convert::numberToString(slideNumber) + ":" +
+          hash::xxHash64Hex(extraContent) + ":" +
+          incremental;
+}
+
 } // anonymous namespace
 
 
@@ -340,6 +368,9 @@ Error renderSlides(const SlideDeck& slideDeck,
    // track json version of slide list
    SlideNavigationList navigationList(slideDeck.navigation());
 
+   // slides rendered this time (replaces s_renderedSlides once complete)
+   RenderedSlides renderedSlides;
+
    // now the slides
    std::string cmdPad(8, ' ');
    int slideNumber = 0;
@@ -494,22 +525,37 @@ Error renderSlides(const SlideDeck& slideDeck,
       }
 
 
-      // render markdown
-      std::string headContent, htmlContent;
-      Error error = slideToHtml(slide,
-                                slideNumber,
-                                ostrMedia.str(),
-                                incremental,
-                                &headContent,
-                                &htmlContent);
-      if (error)
-         return error;
+      // render markdown (reusing the previous render if the slide and its
+      // settings are unchanged)
+      std::string key = renderedSlideKey(slide,
+                                         slideNumber,
+                                         ostrMedia.str(),
+                                         incremental);
+      RenderedSlides::const_iterator it = s_renderedSlides.find(key);
+      if (it != s_renderedSlides.end())
+      {
+         renderedSlides[key] = it->second;
+      }
+      else
+      {
+         RenderedSlide rendered;
+         Error error = slideToHtml(slide,
+                                   slideNumber,
+                                   ostrMedia.str(),
+                                   incremental,
+                                   &rendered.head,
+                                   &rendered.html);
+         if (error)
+            return error;
+         renderedSlides[key] = rendered;
+      }
+      const RenderedSlide& rendered = renderedSlides[key];
 
       // record head
-      pSlidesHead->append(headContent);
+      pSlidesHead->append(rendered.head);
 
       // record html
-      ostr << htmlContent << "\n";
+      ostr << rendered.html << "\n";
 
       // render end section
       ostr << "</section>" << "\n";
@@ -538,6 +584,9 @@ Error renderSlides(const SlideDeck& slideDeck,
       slideNumber++;
    }
 
+   // keep this render's slides for next time
+   s_renderedSlides.swap(renderedSlides);
+
    // init slide list as part of actions
    navigationList.complete();
    ostrInitActions << navigationList.asCall() << "\n";
@@ -561,9 +561,10 @@ bool readPresentation(SlideDeck* pSlideDeck,
    return true;
 }
 
+template <typename Filter>
 bool renderPresentation(
                    const std::map<std::string,std::string>& vars,
-                   const std::vector<boost::iostreams::regex_filter>& filters,
+                   const std::vector<Filter>& filters,
                    std::ostream& os,
                    ErrorResponse* pErrorResponse)
 {
@@ -784,7 +785,7 @@ bool createStandalonePresentation(const FilePath& targetFile,
 
    // create image filter
    FilePath dirPath = presentation::state::directory();
-   std::vector<boost::iostreams::regex_filter> filters;
+   std::vector<html_utils::Base64ImageFilter> filters;
    filters.push_back(html_utils::Base64ImageFilter(dirPath));
 
    // render presentation
@@ -23,6 +23,7 @@
 #include <boost/format.hpp>
 #include <boost/foreach.hpp>
 
+#include <core/DateTime.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/Exec.hpp>
 #include <core/system/Environment.hpp>
@@ -52,6 +53,9 @@
 
 #define kShinyContentWarning "Warning: Shiny application in a static R Markdown document"
 
+// how long an unused warm render process is kept
+#define kWarmRenderIdleMs (10 * 60 * 1000)
+
 using namespace rstudio::core;
 
 namespace rstudio {
@@ -78,6 +82,8 @@ enum RenderTerminateType
 std::string s_renderOutputs[kMaxRenderOutputs];
 int s_currentRenderOutput = 0;
 
+void warmRenderProcess(const FilePath& workingDir);
+
 class RenderRmd : public async_r::AsyncRProcess
 {
 public:
@@ -88,16 +94,57 @@ public:
                                               const std::string& paramsFile,
                                               bool sourceNavigation,
                                               bool asTempfile,
-                                              bool asShiny)
+                                              bool asShiny,
+                                              boost::shared_ptr<RenderRmd>
+                                                                  pWarmRender)
    {
-      boost::shared_ptr<RenderRmd> pRender(new RenderRmd(targetFile,
-                                                         sourceLine,
-                                                         sourceNavigation,
-                                                         asShiny));
+      // use the warm process if it was started for this render's directory
+      // (and with the same environment), otherwise start a new one
+      boost::shared_ptr<RenderRmd> pRender;
+      if (pWarmRender && pWarmRender->isWarmFor(targetFile.parent()))
+      {
+         pRender = pWarmRender;
+         pRender->targetFile_ = targetFile;
+         pRender->sourceLine_ = sourceLine;
+         pRender->sourceNavigation_ = sourceNavigation;
+         pRender->isShiny_ = asShiny;
+      }
+      else
+      {
+         if (pWarmRender && pWarmRender->isRunning())
+            pWarmRender->terminateProcess(renderTerminateQuiet);
+
+         pRender.reset(new RenderRmd(targetFile,
+                                     sourceLine,
+                                     sourceNavigation,
+                                     asShiny));
+      }
       pRender->start(format, encoding, paramsFile, asTempfile);
       return pRender;
    }
 
+   // start a process in the given directory which loads rmarkdown and then
+   // waits for a render command on its standard input, so that R startup
+   // and package loading are out of the way when the next render arrives.
+   // each process performs a single render (documents are free to modify
+   // global state, so processes aren't reused)
+   static boost::shared_ptr<RenderRmd> createWarm(const FilePath& workingDir)
+   {
+      boost::shared_ptr<RenderRmd> pRender(new RenderRmd(FilePath(),
+                                                         -1,
+                                                         false,
+                                                         false));
+      pRender->startWarm(workingDir);
+      return pRender;
+   }
+
+   bool isWarmFor(const FilePath& workingDir)
+   {
+      return isWarm_ && isRunning() &&
+             workingDir == warmWorkingDir_ &&
+             processStartupState() == warmStartupState_;
+   }
+
    void terminateProcess(RenderTerminateType terminateType)
    {
       terminateType_ = terminateType;
@@ -136,9 +183,54 @@ private:
       hasShinyContent_(false),
       targetFile_(targetFile),
       sourceLine_(sourceLine),
-      sourceNavigation_(sourceNavigation)
+      sourceNavigation_(sourceNavigation),
+      isWarm_(false),
+      warmStartedAt_(0)
    {}
 
+   void startWarm(const FilePath& workingDir)
+   {
+      isWarm_ = true;
+      warmWorkingDir_ = workingDir;
+      warmStartupState_ = processStartupState();
+      warmStartedAt_ = date_time::millisecondsSinceEpoch();
+
+      std::string cmd("invisible(lapply(c('knitr', 'rmarkdown'), "
+                                        "requireNamespace, quietly = TRUE)); "
+                      "eval(parse(text = readLines(file('stdin'), "
+                                                  "warn = FALSE)), "
+                           "envir = globalenv());");
+      async_r::AsyncRProcess::start(cmd.c_str(), renderEnvironment(),
+                                    workingDir, async_r::R_PROCESS_NO_RDATA);
+   }
+
+   // the environment and library paths a render process inherits when
+   // it's started (a warm process is only usable if these haven't changed)
+   static std::string processStartupState()
+   {
+      core::system::Options environment;
+      core::system::environment(&environment);
+      std::string state = module_context::libPathsString();
+      BOOST_FOREACH(const core::system::Option& var, environment)
+      {
+         state.append("\n");
+         state.append(var.first + "=" + var.second);
+      }
+      return state;
+   }
+
+   static core::system::Options renderEnvironment()
+   {
+      core::system::Options environment;
+      std::string tempDir;
+      Error error = r::exec::RFunction("tempdir").call(&tempDir);
+      if (!error)
+         environment.push_back(std::make_pair("RMARKDOWN_PREVIEW_DIR", tempDir));
+      else
+         LOG_ERROR(error);
+      return environment;
+   }
+
    void start(const std::string& format,
               const std::string& encoding,
               const std::string& paramsFile,
@@ -269,31 +361,63 @@ private:
                              extraParams %
                              renderOptions);
 
-      // environment
-      core::system::Options environment;
-      std::string tempDir;
-      error = r::exec::RFunction("tempdir").call(&tempDir);
-      if (!error)
-         environment.push_back(std::make_pair("RMARKDOWN_PREVIEW_DIR", tempDir));
+      allOutput_.clear();
+
+      // if we have a warm process then play back anything it wrote while
+      // starting up and send it the render command
+      if (isWarm_)
+      {
+         isWarm_ = false;
+         typedef std::pair<int,std::string> Output;
+         BOOST_FOREACH(const Output& output, warmOutput_)
+         {
+            onRenderOutput(output.first, output.second);
+         }
+         warmOutput_.clear();
+
+         writeInput(cmd + "\n", true);
+      }
+
+      // otherwise start the async R process with the render command
       else
-         LOG_ERROR(error);
+      {
+         async_r::AsyncRProcess::start(cmd.c_str(), renderEnvironment(),
+                                       targetFile_.parent(),
+                                       async_r::R_PROCESS_NO_RDATA);
+      }
+   }
 
-      // start the async R process with the render command
-      allOutput_.clear();
-      async_r::AsyncRProcess::start(cmd.c_str(), environment, targetFile_.parent(),
-                                    async_r::R_PROCESS_NO_RDATA);
+   bool onContinue()
+   {
+      // don't hold on to an unused warm process indefinitely
+      if (isWarm_ && (date_time::millisecondsSinceEpoch() - warmStartedAt_ >
+                      kWarmRenderIdleMs))
+      {
+         return false;
+      }
+
+      return async_r::AsyncRProcess::onContinue();
    }
 
    void onStdout(const std::string& output)
    {
-      onRenderOutput(module_context::kCompileOutputNormal,
-                     string_utils::systemToUtf8(output));
+      onProcessOutput(module_context::kCompileOutputNormal,
+                      string_utils::systemToUtf8(output));
    }
 
    void onStderr(const std::string& output)
    {
-      onRenderOutput(module_context::kCompileOutputError,
-                     string_utils::systemToUtf8(output));
+      onProcessOutput(module_context::kCompileOutputError,
+                      string_utils::systemToUtf8(output));
+   }
+
+   void onProcessOutput(int type, const std::string& output)
+   {
+      // output from a warm process is held until it has a render
+      if (isWarm_)
+         warmOutput_.push_back(std::make_pair(type, output));
+      else
+         onRenderOutput(type, output);
    }
 
    void onRenderOutput(int type, const std::string& output)
@@ -349,6 +473,10 @@ private:
 
    void onCompleted(int exitStatus)
    {
+      // a warm process which exits before it's used has nothing to report
+      if (isWarm_)
+         return;
+
       // check each line of the emitted output; if it starts with a token
       // indicating rendering is complete, store the remainder of the emitted
       // line as the file we rendered
@@ -461,6 +589,9 @@ private:
 
       ClientEvent event(client_events::kRmdRenderCompleted, resultJson);
       module_context::enqueClientEvent(event);
+
+      // get a process ready for the next render of this document
+      warmRenderProcess(targetFile_.parent());
    }
 
    void enqueFailureDiagnostics(const std::string& formatName)
@@ -565,9 +696,33 @@ private:
    json::Object outputFormat_;
    std::vector<module_context::SourceMarker> knitrErrors_;
    std::string allOutput_;
+
+   bool isWarm_;
+   FilePath warmWorkingDir_;
+   std::string warmStartupState_;
+   double warmStartedAt_;
+   std::vector<std::pair<int,std::string> > warmOutput_;
 };
 
 boost::shared_ptr<RenderRmd> s_pCurrentRender_;
+boost::shared_ptr<RenderRmd> s_pWarmRender_;
+
+void terminateWarmRenderProcess()
+{
+   if (s_pWarmRender_ && s_pWarmRender_->isRunning())
+      s_pWarmRender_->terminateProcess(renderTerminateQuiet);
+   s_pWarmRender_.reset();
+}
+
+void warmRenderProcess(const FilePath& workingDir)
+{
+   terminateWarmRenderProcess();
+
+   if (!r::options::getOption<bool>("rstudio.rmarkdown.warmRender", true))
+      return;
+
+   s_pWarmRender_ = RenderRmd::createWarm(workingDir);
+}
 
 // This class's job is to asynchronously read template locations from the R
 // Markdown package, and emit each template as a client event. This should
@@ -795,6 +950,12 @@ void onClientInit()
       s_pCurrentRender_->terminateProcess(renderTerminateQuiet);
 }
 
+void onPackageLibraryMutated()
+{
+   // the warm process may have loaded packages which have since changed
+   terminateWarmRenderProcess();
+}
+
 Error getRMarkdownContext(const json::JsonRpcRequest&,
                           json::JsonRpcResponse* pResponse)
 {
@@ -820,6 +981,9 @@ void doRenderRmd(const std::string& file,
    }
    else
    {
+      boost::shared_ptr<RenderRmd> pWarmRender = s_pWarmRender_;
+      s_pWarmRender_.reset();
+
       s_pCurrentRender_ = RenderRmd::create(
                module_context::resolveAliasedPath(file),
                line,
@@ -828,7 +992,8 @@ void doRenderRmd(const std::string& file,
                paramsFile,
                sourceNavigation,
                asTempfile,
-               asShiny);
+               asShiny,
+               pWarmRender);
       pResponse->setResult(true);
    }
 }
@@ -1152,6 +1317,8 @@ Error initialize()
    module_context::events().onDetectSourceExtendedType
                                         .connect(onDetectRmdSourceType);
    module_context::events().onClientInit.connect(onClientInit);
+   module_context::events().onPackageLibraryMutated
+                                        .connect(onPackageLibraryMutated);
 
    ExecBlock initBlock;
    initBlock.addFunctions()
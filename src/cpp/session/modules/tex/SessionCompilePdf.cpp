@@ -19,6 +19,7 @@
 
 #include <boost/format.hpp>
 #include <boost/foreach.hpp>
+#include <boost/algorithm/string/join.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
 #include <core/FilePath.hpp>
@@ -392,6 +393,20 @@ void removeExistingLatexAncillaryFiles(const FilePath& texFilePath)
    removeExistingAncillary(texFilePath, ".synctex.gz");
  }
 
+// e.g. " [pdflatex 3.1s, bibtex 0.2s, pdflatex 2.9s] "
+std::string texPassesMessage(const tex::pdflatex::TexPasses& passes)
+{
+   std::vector<std::string> timings;
+   BOOST_FOREACH(const tex::pdflatex::TexPass& pass, passes)
+   {
+      boost::format fmt("%1% %2$.1fs");
+      timings.push_back(boost::str(fmt % pass.program %
+                                         (pass.milliseconds / 1000)));
+   }
+
+   return " [" + boost::algorithm::join(timings, ", ") + "] ";
+}
+
 std::string buildIssuesMessage(const core::tex::LogEntries& logEntries)
 {
    if (logEntries.empty())
@@ -702,9 +717,11 @@ private:
       enqueOutputEvent("Running " + texProgramPath_.filename() +
                        " on " + texFilePath.filename() + "...");
 
+      pdflatex::TexPasses passes;
       error = tex::pdflatex::texToPdf(texProgramPath_,
                                       texFilePath,
                                       options,
+                                      &passes,
                                       &result);
 
       if (error)
@@ -713,6 +730,7 @@ private:
       }
       else
       {
+         enqueOutputEvent(texPassesMessage(passes));
          onLatexCompileCompleted(result.exitStatus,
                                  texFilePath,
                                  concordances);
@@ -15,11 +15,15 @@
 
 #include "SessionPdfLatex.hpp"
 
+#include <map>
+
 #include <boost/regex.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <core/system/Environment.hpp>
+#include <core/DateTime.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
 
 #include <session/projects/SessionProjects.hpp>
 
@@ -205,44 +209,184 @@ FilePath programPath(const std::string& name, const std::string& envOverride)
    return module_context::findProgram(program);
 }
 
-
-
-bool lineIncludes(const std::string& line, const boost::regex& regex)
+bool logIncludesRerun(const FilePath& logFilePath)
 {
-    boost::smatch match;
-    return boost::regex_search(line, match, regex);
+   std::string logContents;
+   Error error = core::readStringFromFile(logFilePath, &logContents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return false;
+   }
+
+   return logContents.find("Rerun to get") != std::string::npos;
 }
 
-int countCitationMisses(const FilePath& logFilePath)
+// the aux files for the document (including those of any \include'd files)
+std::vector<FilePath> auxFilePaths(const FilePath& baseFilePath)
 {
-   // read the log file
+   std::vector<FilePath> auxFiles;
+   FilePath auxFilePath(baseFilePath.absolutePath() + ".aux");
+   if (!auxFilePath.exists())
+      return auxFiles;
+   auxFiles.push_back(auxFilePath);
+
    std::vector<std::string> lines;
-   Error error = core::readStringVectorFromFile(logFilePath, &lines);
+   Error error = core::readStringVectorFromFile(auxFilePath, &lines, false);
    if (error)
    {
       LOG_ERROR(error);
-      return 0;
+      return auxFiles;
    }
 
-   // look for misses
-   boost::regex missRegex("Warning:.*Citation.*undefined");
-   int misses = std::count_if(lines.begin(),
-                              lines.end(),
-                              boost::bind(lineIncludes, _1, missRegex));
-   return misses;
+   BOOST_FOREACH(const std::string& line, lines)
+   {
+      if (boost::algorithm::starts_with(line, "\\@input{") &&
+          boost::algorithm::ends_with(line, "}"))
+      {
+         std::string name = line.substr(8, line.size() - 9);
+         FilePath inputAuxFilePath = baseFilePath.parent().complete(name);
+         if (inputAuxFilePath.exists())
+            auxFiles.push_back(inputAuxFilePath);
+      }
+   }
+
+   return auxFiles;
 }
 
-bool logIncludesRerun(const FilePath& logFilePath)
+void hashFile(const FilePath& filePath, hash::Hasher* pHasher)
 {
-   std::string logContents;
-   Error error = core::readStringFromFile(logFilePath, &logContents);
-   if (error)
+   pHasher->update(filePath.absolutePath());
+
+   std::string contents;
+   if (filePath.exists())
    {
-      LOG_ERROR(error);
-      return false;
+      Error error = core::readStringFromFile(filePath, &contents);
+      if (error)
+         LOG_ERROR(error);
    }
+   pHasher->update(contents);
+}
 
-   return logContents.find("Rerun to get") != std::string::npos;
+std::string fileState(const FilePath& filePath)
+{
+   hash::Hasher hasher;
+   hashFile(filePath, &hasher);
+   return hasher.hexDigest();
+}
+
+// the state of the files which latex writes during a pass and reads back in
+// on the next one (if a pass doesn't change them then another pass would
+// produce the same output)
+std::string latexInputsState(const FilePath& baseFilePath)
+{
+   const char* const kLatexInputExtensions[] = { ".toc", ".lof", ".lot",
+                                                 ".out", ".nav", ".snm",
+                                                 ".bbl", ".ind" };
+
+   hash::Hasher hasher;
+   BOOST_FOREACH(const FilePath& auxFilePath, auxFilePaths(baseFilePath))
+   {
+      hashFile(auxFilePath, &hasher);
+   }
+   BOOST_FOREACH(const char* extension, kLatexInputExtensions)
+   {
+      hashFile(FilePath(baseFilePath.absolutePath() + extension), &hasher);
+   }
+   return hasher.hexDigest();
+}
+
+// the state of the citations and bibliographies which bibtex reads (empty
+// if the document doesn't use bibtex)
+std::string citationsState(const FilePath& baseFilePath)
+{
+   hash::Hasher hasher;
+   std::vector<std::string> bibFiles;
+   BOOST_FOREACH(const FilePath& auxFilePath, auxFilePaths(baseFilePath))
+   {
+      std::vector<std::string> lines;
+      Error error = core::readStringVectorFromFile(auxFilePath, &lines, false);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      BOOST_FOREACH(const std::string& line, lines)
+      {
+         if (boost::algorithm::starts_with(line, "\\citation{") ||
+             boost::algorithm::starts_with(line, "\\bibstyle{"))
+         {
+            hasher.update(line);
+         }
+         else if (boost::algorithm::starts_with(line, "\\bibdata{") &&
+                  boost::algorithm::ends_with(line, "}"))
+         {
+            hasher.update(line);
+            std::vector<std::string> names;
+            std::string data = line.substr(9, line.size() - 10);
+            boost::algorithm::split(names, data, boost::is_any_of(","));
+            std::copy(names.begin(), names.end(), std::back_inserter(bibFiles));
+         }
+      }
+   }
+
+   if (bibFiles.empty())
+      return std::string();
+
+   BOOST_FOREACH(const std::string& bibFile, bibFiles)
+   {
+      std::string name = boost::algorithm::trim_copy(bibFile);
+      if (!boost::algorithm::ends_with(name, ".bib"))
+         name.append(".bib");
+      hashFile(baseFilePath.parent().complete(name), &hasher);
+   }
+
+   return hasher.hexDigest();
+}
+
+// the states of the citations and index the last time bibtex and makeindex
+// were run for a document (so they're only re-run when these change)
+struct AuxiliaryToolsState
+{
+   std::string citations;
+   std::string index;
+};
+std::map<std::string,AuxiliaryToolsState> s_auxiliaryToolsStates;
+
+Error runTimedProgram(const FilePath& programPath,
+                      const core::shell_utils::ShellArgs& args,
+                      const core::system::ProcessOptions& options,
+                      TexPasses* pPasses,
+                      core::system::ProcessResult* pResult)
+{
+   double startTime = date_time::millisecondsSinceEpoch();
+   Error error = core::system::runProgram(
+         string_utils::utf8ToSystem(programPath.absolutePath()),
+         args,
+         "",
+         options,
+         pResult);
+   pPasses->push_back(TexPass(programPath.stem(),
+                              date_time::millisecondsSinceEpoch() - startTime));
+   return error;
+}
+
+Error runTimedTexCompile(const FilePath& texProgramPath,
+                         const FilePath& texFilePath,
+                         const tex::pdflatex::PdfLatexOptions& options,
+                         TexPasses* pPasses,
+                         core::system::ProcessResult* pResult)
+{
+   double startTime = date_time::millisecondsSinceEpoch();
+   Error error = utils::runTexCompile(texProgramPath,
+                                      utils::rTexInputsEnvVars(),
+                                      shellArgs(options),
+                                      texFilePath,
+                                      pResult);
+   pPasses->push_back(TexPass(texProgramPath.stem(),
+                              date_time::millisecondsSinceEpoch() - startTime));
+   return error;
 }
 
 } // anonymous namespace
@@ -353,11 +497,14 @@ bool latexProgramForFile(const core::tex::TexMagicComments& magicComments,
 core::Error texToPdf(const core::FilePath& texProgramPath,
                      const core::FilePath& texFilePath,
                      const tex::pdflatex::PdfLatexOptions& options,
+                     TexPasses* pPasses,
                      core::system::ProcessResult* pResult)
 {
    // input file paths
    FilePath baseFilePath = texFilePath.parent().complete(texFilePath.stem());
    FilePath idxFilePath(baseFilePath.absolutePath() + ".idx");
+   FilePath indFilePath(baseFilePath.absolutePath() + ".ind");
+   FilePath bblFilePath(baseFilePath.absolutePath() + ".bbl");
    FilePath logFilePath(baseFilePath.absolutePath() + ".log");
 
    // bibtex and makeindex program paths
@@ -373,70 +520,79 @@ core::Error texToPdf(const core::FilePath& texProgramPath,
    procOptions.environment = utils::rTexInputsEnvVars();
    procOptions.workingDir = texFilePath.parent();
 
-   // run the initial compile
-   Error error = utils::runTexCompile(texProgramPath,
-                                      utils::rTexInputsEnvVars(),
-                                      shellArgs(options),
-                                      texFilePath,
-                                      pResult);
+   // run the initial compile (noting the state of the files it reads
+   // from the previous compile)
+   AuxiliaryToolsState& toolsState =
+                     s_auxiliaryToolsStates[baseFilePath.absolutePath()];
+   std::string inputsState = latexInputsState(baseFilePath);
+   Error error = runTimedTexCompile(texProgramPath,
+                                    texFilePath,
+                                    options,
+                                    pPasses,
+                                    pResult);
    if (error)
       return error;
 
-   // count misses
-   int misses = countCitationMisses(logFilePath);
-   int previousMisses = 0;
-
-   // resolve citation misses and index
-   for (int i=0; i<10; i++)
+   // resolve citations, index, and cross references (re-running latex only
+   // until the files it reads stop changing)
+   for (int i=0; i<10 && pResult->exitStatus == EXIT_SUCCESS; i++)
    {
-      // run bibtex if necessary
-      if (misses > 0 && !bibtexProgramPath.empty())
+      // run bibtex if the citations or bibliographies changed since we
+      // last ran it
+      std::string citations = citationsState(baseFilePath);
+      bool bibtexRequired = !citations.empty() &&
+            ((citations != toolsState.citations) || !bblFilePath.exists());
+      if (bibtexRequired && !bibtexProgramPath.empty())
       {
-         core::system::ProcessResult result;
-         Error error = core::system::runProgram(
-               string_utils::utf8ToSystem(bibtexProgramPath.absolutePath()),
-               bibtexArgs,
-               "",
-               procOptions,
-               pResult);
+         Error error = runTimedProgram(bibtexProgramPath,
+                                       bibtexArgs,
+                                       procOptions,
+                                       pPasses,
+                                       pResult);
          if (error)
             LOG_ERROR(error);
          else if (pResult->exitStatus != EXIT_SUCCESS)
             return Success(); // pass error state on to caller
+         else
+            toolsState.citations = citations;
       }
-      previousMisses = misses;
 
-      // run makeindex if necessary
+      // run makeindex if the index entries changed
       if (idxFilePath.exists() && !makeindexProgramPath.empty())
       {
-         Error error = core::system::runProgram(
-               string_utils::utf8ToSystem(makeindexProgramPath.absolutePath()),
-               makeindexArgs,
-               "",
-               procOptions,
-               pResult);
-         if (error)
-            LOG_ERROR(error);
-         else if (pResult->exitStatus != EXIT_SUCCESS)
-            return Success(); // pass error state on to caller
+         std::string index = fileState(idxFilePath);
+         if ((index != toolsState.index) || !indFilePath.exists())
+         {
+            Error error = runTimedProgram(makeindexProgramPath,
+                                          makeindexArgs,
+                                          procOptions,
+                                          pPasses,
+                                          pResult);
+            if (error)
+               LOG_ERROR(error);
+            else if (pResult->exitStatus != EXIT_SUCCESS)
+               return Success(); // pass error state on to caller
+            else
+               toolsState.index = index;
+         }
       }
 
+      // if the last pass (and bibtex/makeindex) didn't change anything the
+      // next pass would read and latex isn't asking for a rerun then we're
+      // done
+      std::string previousInputsState = inputsState;
+      inputsState = latexInputsState(baseFilePath);
+      if (inputsState == previousInputsState && !logIncludesRerun(logFilePath))
+         break;
+
       // re-run latex
-      Error error = utils::runTexCompile(texProgramPath,
-                                         utils::rTexInputsEnvVars(),
-                                         shellArgs(options),
-                                         texFilePath,
-                                         pResult);
+      Error error = runTimedTexCompile(texProgramPath,
+                                       texFilePath,
+                                       options,
+                                       pPasses,
+                                       pResult);
       if (error)
          return error;
-
-      // count misses
-      misses = countCitationMisses(logFilePath);
-
-      // if there is no change in misses and there is no "Rerun to get"
-      // in the log file then break
-      if ((misses == previousMisses) && !logIncludesRerun(logFilePath))
-         break;
    }
 
    return Success();
@@ -16,6 +16,9 @@
 #ifndef SESSION_MODULES_TEX_PDFLATEX_HPP
 #define SESSION_MODULES_TEX_PDFLATEX_HPP
 
+#include <string>
+#include <vector>
+
 #include <core/FilePath.hpp>
 
 #include <core/json/Json.hpp>
@@ -71,9 +74,24 @@ struct PdfLatexOptions
    std::string versionInfo;
 };
 
+// a program run while compiling a pdf and how long it took
+struct TexPass
+{
+   TexPass(const std::string& program, double milliseconds)
+      : program(program), milliseconds(milliseconds)
+   {
+   }
+
+   std::string program;
+   double milliseconds;
+};
+
+typedef std::vector<TexPass> TexPasses;
+
 core::Error texToPdf(const core::FilePath& texProgramPath,
                      const core::FilePath& texFilePath,
                      const tex::pdflatex::PdfLatexOptions& options,
+                     TexPasses* pPasses,
                      core::system::ProcessResult* pResult);
 
 bool isInstalled();
@@ -15,6 +15,11 @@
 
 #include "SessionSynctex.hpp"
 
+#include <ctime>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+
 #include <core/Error.hpp>
 #include <core/FilePath.hpp>
 #include <core/Exec.hpp>
@@ -38,6 +43,56 @@ namespace synctex {
 
 namespace {
 
+// parsing the synctex file of a long document is expensive, so we keep the
+// parsed data for the most recently searched pdfs (until they're recompiled)
+struct CachedSynctex
+{
+   CachedSynctex() : lastWriteTime(0), lastUsed(0) {}
+   std::time_t lastWriteTime;
+   boost::shared_ptr<core::tex::Synctex> pSynctex;
+   int lastUsed;
+};
+std::map<std::string,CachedSynctex> s_synctexCache;
+const std::size_t kMaxCachedSynctex = 4;
+
+boost::shared_ptr<core::tex::Synctex> synctexForPdf(const FilePath& pdfPath)
+{
+   static int s_useCounter = 0;
+
+   std::time_t lastWriteTime = pdfPath.exists() ? pdfPath.lastWriteTime() : 0;
+   CachedSynctex& cached = s_synctexCache[pdfPath.absolutePath()];
+   cached.lastUsed = ++s_useCounter;
+   if (cached.pSynctex && cached.lastWriteTime == lastWriteTime)
+      return cached.pSynctex;
+
+   boost::shared_ptr<core::tex::Synctex> pSynctex(new core::tex::Synctex());
+   if (!pSynctex->parse(pdfPath))
+   {
+      s_synctexCache.erase(pdfPath.absolutePath());
+      return boost::shared_ptr<core::tex::Synctex>();
+   }
+   cached.lastWriteTime = lastWriteTime;
+   cached.pSynctex = pSynctex;
+
+   // evict the least recently used pdf if we have too many
+   if (s_synctexCache.size() > kMaxCachedSynctex)
+   {
+      std::map<std::string,CachedSynctex>::iterator lruIt =
+                                                      s_synctexCache.begin();
+      for (std::map<std::string,CachedSynctex>::iterator it =
+                                                      s_synctexCache.begin();
+           it != s_synctexCache.end();
+           ++it)
+      {
+         if (it->second.lastUsed < lruIt->second.lastUsed)
+            lruIt = it;
+      }
+      s_synctexCache.erase(lruIt);
+   }
+
+   return pSynctex;
+}
+
 json::Value toJson(const FilePath& pdfFile,
                    const core::tex::PdfLocation& pdfLoc,
                    bool fromClick)
@@ -245,9 +300,10 @@ Error synctexInverseSearch(const json::JsonRpcRequest& request,
       return error;
    FilePath pdfPath = module_context::resolveAliasedPath(file);
 
-   core::tex::Synctex synctex;
-   if (synctex.parse(pdfPath))
+   boost::shared_ptr<core::tex::Synctex> pSynctex = synctexForPdf(pdfPath);
+   if (pSynctex)
    {
+      core::tex::Synctex& synctex = *pSynctex;
       if (!fromClick)
       {
          // find the top of the page content, however override it with
@@ -324,9 +380,10 @@ Error forwardSearch(const FilePath& rootFile,
    // determine pdf
    FilePath pdfFile = rootFile.parent().complete(rootFile.stem() + ".pdf");
 
-   core::tex::Synctex synctex;
-   if (synctex.parse(pdfFile))
+   boost::shared_ptr<core::tex::Synctex> pSynctex = synctexForPdf(pdfFile);
+   if (pSynctex)
    {
+      core::tex::Synctex& synctex = *pSynctex;
       core::tex::SourceLocation srcLoc(inputFile, line, column);
       applyForwardConcordance(rootFile, &srcLoc);
 
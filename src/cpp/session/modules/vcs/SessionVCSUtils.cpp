@@ -14,9 +14,17 @@
  */
 #include "SessionVCSUtils.hpp"
 
+#include <cctype>
+#include <map>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
 #include <boost/regex.hpp>
+#include <boost/shared_ptr.hpp>
 
+#include <core/SafeConvert.hpp>
 #include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
 
 #include <r/RUtil.hpp>
 
@@ -113,6 +121,45 @@ std::string convertToUtf8(const std::string& content, bool allowSubst)
 // This is implemented using a quick and dirty regex instead of with a proper
 // diff parser, so there might be edge cases where stuff gets transcoded that
 // should not be.
+namespace {
+
+// returns the position of the content within a diff line (i.e. after its
+// leading +, -, or space or @@ ... @@ hunk header), or npos if it isn't a
+// content line
+std::string::size_type diffContentStart(const std::string& diff,
+                                        std::string::size_type pos,
+                                        std::string::size_type lineEnd)
+{
+   if (lineEnd - pos < 2)
+      return std::string::npos;
+
+   // +++ and --- lines name the files being compared
+   if (diff.compare(pos, 4, "+++ ") == 0 || diff.compare(pos, 4, "--- ") == 0)
+      return std::string::npos;
+
+   char ch = diff[pos];
+   if (ch == '+' || ch == '-' || ch == ' ')
+      return pos + 1;
+
+   if (diff.compare(pos, 2, "@@") != 0)
+      return std::string::npos;
+
+   std::string::size_type i = pos + 2;
+   while (i < lineEnd && (std::isdigit(static_cast<unsigned char>(diff[i])) ||
+                          diff[i] == '+' || diff[i] == '-' ||
+                          diff[i] == ',' || diff[i] == ' '))
+   {
+      i++;
+   }
+
+   if (i == pos + 2 || diff.compare(i, 2, "@@") != 0 || i + 2 >= lineEnd)
+      return std::string::npos;
+
+   return i + 2;
+}
+
+} // anonymous namespace
+
 std::string convertDiff(const std::string& diff,
                         const std::string& fromEncoding,
                         const std::string& toEncoding,
@@ -139,36 +186,31 @@ std::string convertDiff(const std::string& diff,
    std::string transcoded;
    Error error;
 
-   std::string::const_iterator lastMatchEnd = diff.begin();
-
-   boost::regex contentLine("^(?:[+\\- ]|(?:@@[+\\-,\\d ]+@@))(.+?)$");
-   boost::sregex_iterator iter(diff.begin(), diff.end(), contentLine,
-                               boost::regex_constants::match_not_dot_newline);
-   boost::sregex_iterator end;
-   for (; iter != end; iter++)
+   // scan the diff a line at a time (treating \r and \f as line separators
+   // as boost::regex does) transcoding the content of each line
+   result.reserve(diff.size());
+   std::string::size_type pos = 0;
+   while (pos < diff.size())
    {
-      const boost::smatch m = *iter;
-
-      // Copy any lines we skipped over in getting here
-      std::copy(m.prefix().first, m.prefix().second,
-                std::back_inserter(result));
+      std::string::size_type lineEnd = diff.find_first_of("\n\r\f", pos);
+      if (lineEnd == std::string::npos)
+         lineEnd = diff.size();
 
-      std::string line = std::string(m[0].first, m[0].second);
-      if (boost::algorithm::starts_with(line, "+++ ") ||
-          boost::algorithm::starts_with(line, "--- "))
+      std::string::size_type contentPos = diffContentStart(diff, pos, lineEnd);
+      if (contentPos == std::string::npos)
       {
-         // This is a +++ or --- line, leave it alone
-         std::copy(m[0].first, m[0].second, std::back_inserter(result));
+         // not a content line, leave it alone
+         result.append(diff, pos, lineEnd - pos);
       }
       else
       {
          // This is a content line, replace it!
 
-         // Copy the leading part of the match verbatim
-         std::copy(m[0].first, m[1].first, std::back_inserter(result));
+         // Copy the leading part of the line verbatim
+         result.append(diff, pos, contentPos - pos);
 
          transcoded.clear();
-         error = r::util::iconvstr(std::string(m[1].first, m[1].second),
+         error = r::util::iconvstr(diff.substr(contentPos, lineEnd - contentPos),
                                    fromEncoding,
                                    toEncoding,
                                    allowSubst,
@@ -181,27 +223,194 @@ std::string convertDiff(const std::string& diff,
          if (transcoded.find('\n') != std::string::npos)
             return diff;
 
-         std::copy(transcoded.begin(), transcoded.end(),
-                   std::back_inserter(result));
-
-         // This should never copy any characters with the regex as it is
-         // written today, but keeping it for symmetry.
-         std::copy(m[1].second, m[0].second, std::back_inserter(result));
+         result.append(transcoded);
       }
 
-      lastMatchEnd = m[0].second;
+      if (lineEnd < diff.size())
+         result.push_back(diff[lineEnd]);
+      pos = lineEnd + 1;
    }
 
-   // Copy the last set of lines we skipped over (or if there were no matches,
-   // then we're actually copying the entire diff)
-   std::copy(lastMatchEnd, diff.end(), std::back_inserter(result));
-
    if (pSuccess)
       *pSuccess = true;
 
    return result;
 }
 
+namespace {
+
+const char * const kOutputSizeProperty = "output-size";
+
+struct AsyncOperation
+{
+   AsyncOperation() : finished(false), maxOutput(0), outputSize(0) {}
+   std::string params;
+   bool finished;
+   std::size_t maxOutput;
+   boost::uint64_t outputSize;
+   core::system::ProcessResult result;
+   std::vector<ProcResultCallback> callbacks;
+};
+
+typedef std::map<std::string, boost::shared_ptr<AsyncOperation> >
+                                                            AsyncOperations;
+AsyncOperations s_asyncOperations;
+
+void completeAsync(const std::string& channel,
+                   boost::shared_ptr<AsyncOperation> pOperation,
+                   const Error& error)
+{
+   pOperation->finished = true;
+
+   AsyncOperations::iterator it = s_asyncOperations.find(channel);
+   if (it != s_asyncOperations.end() && it->second == pOperation)
+      s_asyncOperations.erase(it);
+
+   // copy the callbacks since they may start new operations
+   std::vector<ProcResultCallback> callbacks = pOperation->callbacks;
+   BOOST_FOREACH(const ProcResultCallback& callback, callbacks)
+   {
+      callback(error, pOperation->result);
+   }
+}
+
+bool asyncContinue(boost::shared_ptr<AsyncOperation> pOperation,
+                   core::system::ProcessOperations&)
+{
+   return !pOperation->finished;
+}
+
+void asyncStdout(boost::shared_ptr<AsyncOperation> pOperation,
+                 core::system::ProcessOperations&,
+                 const std::string& output)
+{
+   // past the limit we only count the output (so we can report its size)
+   pOperation->outputSize += output.size();
+   if (pOperation->maxOutput == 0 ||
+       pOperation->outputSize <= pOperation->maxOutput)
+   {
+      pOperation->result.stdOut.append(output);
+   }
+   else if (!pOperation->result.stdOut.empty())
+   {
+      std::string().swap(pOperation->result.stdOut);
+   }
+}
+
+void asyncStderr(boost::shared_ptr<AsyncOperation> pOperation,
+                 core::system::ProcessOperations&,
+                 const std::string& output)
+{
+   pOperation->result.stdErr.append(output);
+}
+
+void asyncError(const std::string& channel,
+                boost::shared_ptr<AsyncOperation> pOperation,
+                core::system::ProcessOperations& ops,
+                const Error& error)
+{
+   if (pOperation->finished)
+      return;
+
+   completeAsync(channel, pOperation, error);
+
+   Error terminateError = ops.terminate();
+   if (terminateError)
+      LOG_ERROR(terminateError);
+}
+
+void asyncExit(const std::string& channel,
+               boost::shared_ptr<AsyncOperation> pOperation,
+               int exitStatus)
+{
+   // superseded or failed operations have already been completed
+   if (pOperation->finished)
+      return;
+
+   pOperation->result.exitStatus = exitStatus;
+
+   Error error;
+   if (pOperation->maxOutput != 0 &&
+       pOperation->outputSize > pOperation->maxOutput)
+   {
+      error = systemError(boost::system::errc::file_too_large, ERROR_LOCATION);
+      error.addProperty(kOutputSizeProperty,
+                        safe_convert::numberToString(pOperation->outputSize));
+   }
+
+   completeAsync(channel, pOperation, error);
+}
+
+} // anonymous namespace
+
+void runAsync(const std::string& channel,
+              const std::string& params,
+              const ProcLauncher& launcher,
+              const ProcResultCallback& onCompleted,
+              std::size_t maxOutput)
+{
+   boost::shared_ptr<AsyncOperation> pOperation(new AsyncOperation());
+   pOperation->params = params;
+   pOperation->maxOutput = maxOutput;
+
+   // supersede any operation in progress on this channel (its process is
+   // terminated the next time it's polled)
+   AsyncOperations::iterator it = s_asyncOperations.find(channel);
+   if (it != s_asyncOperations.end())
+   {
+      boost::shared_ptr<AsyncOperation> pPrevious = it->second;
+      pPrevious->finished = true;
+      s_asyncOperations.erase(it);
+
+      if (pPrevious->params == params)
+      {
+         pOperation->callbacks = pPrevious->callbacks;
+      }
+      else
+      {
+         Error error = systemError(boost::system::errc::operation_canceled,
+                                   ERROR_LOCATION);
+         BOOST_FOREACH(const ProcResultCallback& callback,
+                       pPrevious->callbacks)
+         {
+            callback(error, core::system::ProcessResult());
+         }
+      }
+   }
+   pOperation->callbacks.push_back(onCompleted);
+   s_asyncOperations[channel] = pOperation;
+
+   core::system::ProcessCallbacks callbacks;
+   callbacks.onContinue = boost::bind(asyncContinue, pOperation, _1);
+   callbacks.onStdout = boost::bind(asyncStdout, pOperation, _1, _2);
+   callbacks.onStderr = boost::bind(asyncStderr, pOperation, _1, _2);
+   callbacks.onError = boost::bind(asyncError, channel, pOperation, _1, _2);
+   callbacks.onExit = boost::bind(asyncExit, channel, pOperation, _1);
+
+   Error error = launcher(callbacks);
+   if (error)
+      completeAsync(channel, pOperation, error);
+}
+
+void continueWithError(const core::json::JsonRpcFunctionContinuation& cont,
+                       const core::Error& error)
+{
+   json::JsonRpcResponse response;
+
+   std::string outputSize = error.getProperty(kOutputSizeProperty);
+   if (!outputSize.empty())
+   {
+      // the client offers to show the output anyway
+      response.setError(error, json::Value(
+               safe_convert::stringTo<boost::uint64_t>(outputSize, 0)));
+      cont(Success(), &response);
+   }
+   else
+   {
+      cont(error, &response);
+   }
+}
+
 } // namespace vcs_utils
 } // namespace modules
 } // namespace session
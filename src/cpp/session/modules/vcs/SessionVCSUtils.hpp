@@ -16,9 +16,11 @@
 #ifndef SESSION_VCS_UTILS_HPP
 #define SESSION_VCS_UTILS_HPP
 
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
 
 #include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
 #include <core/system/Process.hpp>
 
 namespace rstudio {
@@ -55,6 +57,31 @@ std::string convertDiff(const std::string& diff,
                         bool allowSubst,
                         bool* pSuccess=NULL);
 
+typedef boost::function<void(const core::Error&,
+                             const core::system::ProcessResult&)>
+                                                            ProcResultCallback;
+
+typedef boost::function<core::Error(const core::system::ProcessCallbacks&)>
+                                                            ProcLauncher;
+
+// Run a (read-only) vcs command via the process supervisor rather than
+// blocking the main thread, calling onCompleted with its result once it
+// exits. Only one command per channel runs at a time: a newer request
+// terminates the one in progress, whose callbacks then either receive the
+// newer result (if their params are the same) or an operation_canceled error.
+// If maxOutput is non-zero then standard output beyond that size is counted
+// but not kept, and the command completes with a file_too_large error
+void runAsync(const std::string& channel,
+              const std::string& params,
+              const ProcLauncher& launcher,
+              const ProcResultCallback& onCompleted,
+              std::size_t maxOutput = 0);
+
+// Complete an async rpc with an error (errors from runAsync due to exceeding
+// maxOutput are returned along with the output size)
+void continueWithError(const core::json::JsonRpcFunctionContinuation& cont,
+                       const core::Error& error);
+
 struct RefreshOnExit : public boost::noncopyable
 {
    ~RefreshOnExit()
@@ -15,9 +15,16 @@
 
 #include "ViewerHistory.hpp"
 
+#include <algorithm>
+#include <set>
+
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 #include <boost/foreach.hpp>
+#include <boost/regex.hpp>
+#include <boost/algorithm/string/replace.hpp>
 
+#include <core/Hash.hpp>
 #include <core/SafeConvert.hpp>
 #include <core/FileSerializer.hpp>
 
@@ -30,6 +37,152 @@ namespace session {
 namespace modules { 
 namespace viewer {
 
+namespace {
+
+// directory (alongside the widget's html) that htmlwidgets copies each of
+// the widget's dependencies into
+const char * const kWidgetLibDir = "lib";
+
+FilePath viewerAssetsPath()
+{
+   return module_context::tempDir().complete(kViewerAssetsDir);
+}
+
+bool addDependencyFile(std::vector<FilePath>* pFiles,
+                       int,
+                       const FilePath& filePath)
+{
+   if (!filePath.isDirectory())
+      pFiles->push_back(filePath);
+   return true;
+}
+
+// hash of the relative paths and contents of a dependency's files (so
+// dependencies are only shared when every file is identical)
+Error hashDependency(const FilePath& dependencyPath, std::string* pHash)
+{
+   std::vector<FilePath> files;
+   Error error = dependencyPath.childrenRecursive(
+                              boost::bind(addDependencyFile, &files, _1, _2));
+   if (error)
+      return error;
+
+   std::vector<std::string> fileEntries;
+   BOOST_FOREACH(const FilePath& file, files)
+   {
+      std::string contentHash;
+      error = hash::fileHash(file, &contentHash);
+      if (error)
+         return error;
+      fileEntries.push_back(file.relativePath(dependencyPath) + '\0' +
+                            contentHash);
+   }
+   std::sort(fileEntries.begin(), fileEntries.end());
+
+   hash::Hasher hasher;
+   BOOST_FOREACH(const std::string& fileEntry, fileEntries)
+   {
+      hasher.update(fileEntry);
+      hasher.update("\n", 1);
+   }
+   *pHash = hasher.hexDigest();
+   return Success();
+}
+
+// move the widget's dependencies into the assets directory (or remove them
+// if an identical copy is already there) and point the widget's html at
+// them. the assets are named by their content so they can be served with
+// long lived cache headers
+void internWidgetDependencies(const FilePath& htmlPath)
+{
+   FilePath libPath = htmlPath.parent().complete(kWidgetLibDir);
+   if (!htmlPath.exists() || !libPath.isDirectory())
+      return;
+
+   std::string html;
+   Error error = readStringFromFile(htmlPath, &html);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   std::vector<FilePath> dependencies;
+   error = libPath.children(&dependencies);
+   if (!error)
+      error = viewerAssetsPath().ensureDirectory();
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   bool interned = false;
+   BOOST_FOREACH(const FilePath& dependency, dependencies)
+   {
+      if (!dependency.isDirectory())
+         continue;
+
+      std::string contentHash;
+      error = hashDependency(dependency, &contentHash);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      std::string assetName = dependency.filename() + "-" + contentHash;
+      FilePath assetPath = viewerAssetsPath().complete(assetName);
+      error = assetPath.exists() ? dependency.remove()
+                                 : dependency.move(assetPath);
+      if (error)
+      {
+         LOG_ERROR(error);
+         continue;
+      }
+
+      std::string libPrefix = std::string(kWidgetLibDir) + "/" +
+                              dependency.filename() + "/";
+      std::string assetPrefix = std::string("../") + kViewerAssetsDir + "/" +
+                                assetName + "/";
+      boost::algorithm::replace_all(html, "\"" + libPrefix, "\"" + assetPrefix);
+      boost::algorithm::replace_all(html, "'" + libPrefix, "'" + assetPrefix);
+      interned = true;
+   }
+
+   if (interned)
+   {
+      error = writeStringToFile(htmlPath, html);
+      if (error)
+         LOG_ERROR(error);
+   }
+}
+
+// names of the assets referenced by a widget's html
+void readAssetReferences(const FilePath& htmlPath,
+                         std::set<std::string>* pAssetNames)
+{
+   if (!htmlPath.exists())
+      return;
+
+   std::string html;
+   Error error = readStringFromFile(htmlPath, &html);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   static const boost::regex reAsset(std::string("\\.\\./") +
+                                     kViewerAssetsDir + "/([^/\"']+)/");
+   boost::sregex_iterator it(html.begin(), html.end(), reAsset);
+   boost::sregex_iterator end;
+   for (; it != end; ++it)
+      pAssetNames->insert((*it)[1]);
+}
+
+} // anonymous namespace
+
 ViewerHistory& viewerHistory()
 {
    static ViewerHistory instance;
@@ -44,14 +197,22 @@ ViewerHistory::ViewerHistory()
 
 void ViewerHistory::add(const module_context::ViewerHistoryEntry& entry)
 {
+   internWidgetDependencies(
+            module_context::tempDir().childPath(entry.sessionTempPath()));
+
+   bool evicting = entries_.full();
    entries_.push_back(entry);
    currentIndex_ = entries_.size() - 1;
+
+   if (evicting)
+      removeUnreferencedAssets();
 }
 
 void ViewerHistory::clear()
 {
    currentIndex_ = -1;
    entries_.clear();
+   removeUnreferencedAssets();
 }
 
 module_context::ViewerHistoryEntry ViewerHistory::current() const
@@ -71,6 +232,38 @@ void ViewerHistory::clearCurrent()
          currentIndex_ = std::max(0, currentIndex_ - 1);
       else
          currentIndex_ = -1;
+
+      removeUnreferencedAssets();
+   }
+}
+
+void ViewerHistory::removeUnreferencedAssets() const
+{
+   FilePath assetsPath = viewerAssetsPath();
+   if (!assetsPath.exists())
+      return;
+
+   std::set<std::string> referenced;
+   FilePath tempDir = module_context::tempDir();
+   BOOST_FOREACH(const module_context::ViewerHistoryEntry& entry, entries_)
+      readAssetReferences(tempDir.childPath(entry.sessionTempPath()), &referenced);
+
+   std::vector<FilePath> assets;
+   Error error = assetsPath.children(&assets);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   BOOST_FOREACH(const FilePath& asset, assets)
+   {
+      if (referenced.count(asset.filename()) == 0)
+      {
+         error = asset.remove();
+         if (error)
+            LOG_ERROR(error);
+      }
    }
 }
 
@@ -178,6 +371,15 @@ void ViewerHistory::saveTo(const core::FilePath& serializationPath) const
       if (error)
          LOG_ERROR(error);
    }
+
+   // copy the (shared) widget dependencies
+   if (viewerAssetsPath().exists())
+   {
+      error = module_context::recursiveCopyDirectory(viewerAssetsPath(),
+                                                     serializationPath);
+      if (error)
+         LOG_ERROR(error);
+   }
 }
 
 void ViewerHistory::restoreFrom(const core::FilePath& serializationPath)
@@ -229,6 +431,14 @@ void ViewerHistory::restoreFrom(const core::FilePath& serializationPath)
       if (error)
          LOG_ERROR(error);
    }
+
+   FilePath assetsPath = serializationPath.complete(kViewerAssetsDir);
+   if (assetsPath.exists())
+   {
+      error = module_context::recursiveCopyDirectory(assetsPath, tempDir);
+      if (error)
+         LOG_ERROR(error);
+   }
 }
 
 
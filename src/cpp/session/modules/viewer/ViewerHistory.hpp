@@ -32,6 +32,10 @@ namespace session {
 namespace modules { 
 namespace viewer {
 
+// directory within the session temp dir where the dependencies (js and css
+// libraries) of widgets in the history are stored once, by content
+const char * const kViewerAssetsDir = "viewer_assets";
+
 class ViewerHistory;
 ViewerHistory& viewerHistory();
 
@@ -57,6 +61,9 @@ public:
    void saveTo(const core::FilePath& serializationPath) const;
    void restoreFrom(const core::FilePath& serializationPath);
 
+private:
+   void removeUnreferencedAssets() const;
+
 private:
    int currentIndex_;
    boost::circular_buffer<module_context::ViewerHistoryEntry> entries_;
@@ -31,6 +31,8 @@
 
 #include <session/SessionUserSettings.hpp>
 #include <session/SessionModuleContext.hpp>
+#include <session/SessionSharedFileMonitor.hpp>
+#include <session/SessionWorkerPool.hpp>
 
 #include <session/projects/ProjectsSettings.hpp>
 #include <session/projects/SessionProjectSharing.hpp>
@@ -345,8 +347,14 @@ Error ProjectContext::initialize()
       // compute the default encoding
       updateDefaultEncoding();
 
-      // augmewnt .Rbuildignore if this is a package
-      augmentRbuildignore();
+      // augment .Rbuildignore if this is a package (this only touches the
+      // project directory so it needn't hold up the rest of startup)
+      if (!worker_pool::execute(
+               boost::bind(&ProjectContext::augmentRbuildignore, this),
+               core::thread::TaskPriorityLow))
+      {
+         augmentRbuildignore();
+      }
 
       // subscribe to deferred init (for initializing our file monitor)
       if (config().enableCodeIndexing)
@@ -380,7 +388,7 @@ void ProjectContext::onDeferredInit(bool newSession)
                             this, _1);
    cb.onUnregistered = bind(&ProjectContext::fileMonitorTermination,
                             this, Success());
-   core::system::file_monitor::registerMonitor(
+   session::shared_file_monitor::registerMonitor(
                                          directory(),
                                          true,
                                          module_context::fileListingFilter,
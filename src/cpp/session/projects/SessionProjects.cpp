@@ -19,6 +19,7 @@
 #include <core/Settings.hpp>
 #include <core/Exec.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Trace.hpp>
 #include <core/system/System.hpp>
 #include <core/http/URL.hpp>
 #include <core/r_util/RProjectFile.hpp>
@@ -568,6 +569,8 @@ FilePath resolveProjectSwitch(const std::string& projectPath)
 
 void startup()
 {
+   TRACE_SCOPE("projects.startup");
+
    // register suspend handler
    using namespace module_context;
    addSuspendHandler(SuspendHandler(boost::bind(onSuspend, _2), onResume));
@@ -141,8 +141,10 @@ import org.rstudio.studio.client.workbench.views.environment.model.DataPreviewRe
 import org.rstudio.studio.client.workbench.views.environment.model.DownloadInfo;
 import org.rstudio.studio.client.workbench.views.environment.model.EnvironmentContextData;
 import org.rstudio.studio.client.workbench.views.environment.model.EnvironmentFrame;
+import org.rstudio.studio.client.workbench.views.environment.model.EnvironmentPage;
 import org.rstudio.studio.client.workbench.views.environment.model.ObjectContents;
 import org.rstudio.studio.client.workbench.views.environment.model.RObject;
+import org.rstudio.studio.client.workbench.views.output.markers.model.MarkersSet;
 import org.rstudio.studio.client.workbench.views.files.model.DirectoryListing;
 import org.rstudio.studio.client.workbench.views.files.model.FileUploadToken;
 import org.rstudio.studio.client.workbench.views.help.model.HelpInfo;
@@ -3528,6 +3530,18 @@ public class RemoteServer implements Server
       sendRequest(RPC_SCOPE, LIST_ENVIRONMENT, callback);
    }
 
+   @Override
+   public void listEnvironmentPage(
+                 int offset,
+                 int count,
+                 ServerRequestCallback<EnvironmentPage> callback)
+   {
+      JSONArray params = new JSONArray();
+      params.set(0, new JSONNumber(offset));
+      params.set(1, new JSONNumber(count));
+      sendRequest(RPC_SCOPE, LIST_ENVIRONMENT_PAGE, params, callback);
+   }
+
    @Override
    public void setContextDepth(int newContextDepth,
                                ServerRequestCallback<Void> requestCallback)
@@ -4277,6 +4291,19 @@ public class RemoteServer implements Server
    {
       sendRequest(RPC_SCOPE, "clear_active_marker_set", requestCallback);
    }
+
+   @Override
+   public void getMarkerSetPage(String set,
+                                int offset,
+                                int count,
+                                ServerRequestCallback<MarkersSet> callback)
+   {
+      JSONArray params = new JSONArray();
+      params.set(0, new JSONString(set));
+      params.set(1, new JSONNumber(offset));
+      params.set(2, new JSONNumber(count));
+      sendRequest(RPC_SCOPE, "get_marker_set_page", params, callback);
+   }
    
    @Override
    public void lintRSourceDocument(String documentId,
@@ -4699,6 +4726,7 @@ public class RemoteServer implements Server
    private static final String DEVTOOLS_LOAD_ALL_PATH = "devtools_load_all_path";
 
    private static final String LIST_ENVIRONMENT = "list_environment";
+   private static final String LIST_ENVIRONMENT_PAGE = "list_environment_page";
    private static final String SET_CONTEXT_DEPTH = "set_context_depth";
    private static final String SET_ENVIRONMENT = "set_environment";
    private static final String SET_ENVIRONMENT_FRAME = "set_environment_frame";
@@ -125,14 +125,19 @@ public class BuildPresenter extends BasePresenter
          @Override
          public void onBuildErrors(BuildErrorsEvent event)
          {        
+            // only navigate once the build has completed (so we don't
+            // keep moving the cursor while errors are still arriving)
+            boolean navigate = event.isComplete() &&
+                               uiPrefs_.navigateToBuildError().getValue();
+            
             view_.showErrors(event.getBaseDirectory(),
                              event.getErrors(), 
                              true,
-                             uiPrefs_.navigateToBuildError().getValue() ?
+                             navigate ?
                                  SourceMarkerList.AUTO_SELECT_FIRST_ERROR :
                                  SourceMarkerList.AUTO_SELECT_NONE);
             
-            if (uiPrefs_.navigateToBuildError().getValue())
+            if (navigate)
             {
                SourceMarker error = SourceMarker.getFirstError(event.getErrors());
                if (error != null)
@@ -36,6 +36,10 @@ public class BuildErrorsEvent extends GwtEvent<BuildErrorsEvent.Handler>
       public final native JsArray<SourceMarker> getErrors() /*-{
          return this.errors;
       }-*/;
+      
+      public final native boolean isComplete() /*-{
+         return !!this.complete;
+      }-*/;
    }
 
    
@@ -58,6 +62,13 @@ public class BuildErrorsEvent extends GwtEvent<BuildErrorsEvent.Handler>
    {
       return data_.getErrors();
    }
+   
+   // errors are also sent while the build is running (in which case this
+   // is false and more errors may follow)
+   public boolean isComplete()
+   {
+      return data_.isComplete();
+   }
 
    @Override
    public Type<Handler> getAssociatedType()
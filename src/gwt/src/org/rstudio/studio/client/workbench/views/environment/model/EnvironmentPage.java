@@ -0,0 +1,35 @@
+/*
+ * EnvironmentPage.java
+ *
+ * Copyright (C) 2009-12 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+package org.rstudio.studio.client.workbench.views.environment.model;
+
+import com.google.gwt.core.client.JavaScriptObject;
+import com.google.gwt.core.client.JsArray;
+
+public class EnvironmentPage extends JavaScriptObject
+{
+   protected EnvironmentPage() {}
+
+   public native final JsArray<RObject> getObjects() /*-{
+      return this.objects;
+   }-*/;
+
+   public native final int getOffset() /*-{
+      return this.offset;
+   }-*/;
+
+   public native final int getTotal() /*-{
+      return this.total;
+   }-*/;
+}
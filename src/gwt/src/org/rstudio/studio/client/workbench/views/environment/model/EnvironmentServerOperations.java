@@ -25,6 +25,10 @@ public interface EnvironmentServerOperations
 {
    void listEnvironment(ServerRequestCallback<JsArray<RObject> > callback);
 
+   void listEnvironmentPage(int offset,
+                            int count,
+                            ServerRequestCallback<EnvironmentPage> callback);
+
    void removeAllObjects(boolean includeHidden,
                          ServerRequestCallback<Void> requestCallback);
 
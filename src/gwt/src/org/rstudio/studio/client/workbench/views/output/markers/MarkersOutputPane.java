@@ -70,6 +70,15 @@ public class MarkersOutputPane extends WorkbenchPane
    }
 
 
+   @Override
+   public void appendMarkers(MarkersSet markersSet)
+   {
+      markerList_.showMarkers(null,
+                              markersSet.getBasePath(),
+                              markersSet.getMarkers(),
+                              SourceMarkerList.AUTO_SELECT_NONE);
+   }
+
    @Override
    protected Toolbar createMainToolbar()
    {
@@ -24,6 +24,7 @@ import com.google.gwt.event.logical.shared.ValueChangeHandler;
 import com.google.inject.Inject;
 
 import org.rstudio.core.client.CodeNavigationTarget;
+import org.rstudio.core.client.Debug;
 import org.rstudio.core.client.FilePosition;
 import org.rstudio.core.client.events.HasEnsureHiddenHandlers;
 import org.rstudio.core.client.events.HasSelectionCommitHandlers;
@@ -34,6 +35,8 @@ import org.rstudio.studio.client.application.events.EventBus;
 import org.rstudio.studio.client.common.filetypes.FileTypeRegistry;
 import org.rstudio.studio.client.common.sourcemarkers.SourceMarker;
 import org.rstudio.studio.client.common.sourcemarkers.SourceMarkerList;
+import org.rstudio.studio.client.server.ServerError;
+import org.rstudio.studio.client.server.ServerRequestCallback;
 import org.rstudio.studio.client.server.VoidServerRequestCallback;
 import org.rstudio.studio.client.workbench.WorkbenchView;
 import org.rstudio.studio.client.workbench.views.BasePresenter;
@@ -51,6 +54,8 @@ public class MarkersOutputPresenter extends BasePresenter
         
       void update(MarkersState markerState, int autoSelect);
       
+      void appendMarkers(MarkersSet markersSet);
+      
       HasValueChangeHandlers<String> getMarkerSetList();
       
       HasSelectionCommitHandlers<CodeNavigationTarget> getMarkerList();
@@ -113,7 +118,7 @@ public class MarkersOutputPresenter extends BasePresenter
       if (state.hasMarkers())
       {
          view_.ensureVisible(false);
-         view_.update(state, SourceMarkerList.AUTO_SELECT_NONE);
+         showMarkers(state, SourceMarkerList.AUTO_SELECT_NONE);
       }
    }
    
@@ -125,11 +130,11 @@ public class MarkersOutputPresenter extends BasePresenter
       if (state.hasMarkers())
       {
          view_.ensureVisible(true);
-         view_.update(event.getMarkersState(), event.getAutoSelect());
+         showMarkers(state, event.getAutoSelect());
          
          // navigate to auto-selection if requested
          MarkersSet markersSet = state.getMarkersSet();
-         if (markersSet != null)
+         if (markersSet != null && markersSet.getOffset() == 0)
          {
             JsArray<SourceMarker> markers = markersSet.getMarkers();
             if (markers.length() > 0)
@@ -158,11 +163,94 @@ public class MarkersOutputPresenter extends BasePresenter
    }
    
    
+   // the server sends a page of markers at a time: markers which follow
+   // those already shown (e.g. as a check produces them) are appended and
+   // the rest of a large set is requested a page at a time
+   private void showMarkers(MarkersState state, int autoSelect)
+   {
+      MarkersSet markersSet = state.getMarkersSet();
+      if (markersSet.getOffset() > 0 &&
+          markersSet.getName().equals(markerSetName_))
+      {
+         // if we're still paging in earlier markers then these will be
+         // included in a later page
+         if (markersSet.getOffset() == loadedMarkers_)
+         {
+            view_.appendMarkers(markersSet);
+            loadedMarkers_ += markersSet.getMarkers().length();
+         }
+      }
+      else
+      {
+         view_.update(state, autoSelect);
+         markerSetName_ = markersSet.getName();
+         loadedMarkers_ = markersSet.getMarkers().length();
+         pageRequestPending_ = false;
+         pageRequestId_++;
+      }
+
+      totalMarkers_ = markersSet.getTotal();
+      loadMoreMarkers();
+   }
+   
+   private void loadMoreMarkers()
+   {
+      if (pageRequestPending_ || loadedMarkers_ >= totalMarkers_)
+         return;
+      
+      pageRequestPending_ = true;
+      final int requestId = pageRequestId_;
+      server_.getMarkerSetPage(
+            markerSetName_,
+            loadedMarkers_,
+            MARKERS_PAGE_SIZE,
+            new ServerRequestCallback<MarkersSet>() {
+               @Override
+               public void onResponseReceived(MarkersSet page)
+               {
+                  // ignore pages of sets which have since been replaced
+                  if (requestId != pageRequestId_)
+                     return;
+                  pageRequestPending_ = false;
+                  
+                  if (page == null)
+                     return;
+                  
+                  int count = page.getMarkers().length();
+                  if (page.getOffset() == loadedMarkers_)
+                  {
+                     view_.appendMarkers(page);
+                     loadedMarkers_ += count;
+                  }
+                  totalMarkers_ = page.getTotal();
+                  
+                  if (count > 0)
+                     loadMoreMarkers();
+               }
+               
+               @Override
+               public void onError(ServerError error)
+               {
+                  if (requestId == pageRequestId_)
+                     pageRequestPending_ = false;
+                  Debug.logError(error);
+               }
+            });
+   }
+   
    public void onClosing()
    {
       server_.markersTabClosed(new VoidServerRequestCallback());
    }
   
+   private String markerSetName_ = null;
+   private int loadedMarkers_ = 0;
+   private int totalMarkers_ = 0;
+   private boolean pageRequestPending_ = false;
+   private int pageRequestId_ = 0;
+   
+   private static final int MARKERS_PAGE_SIZE = 500;
+   
    private final Display view_;
    private final MarkersServerOperations server_;
    private final FileTypeRegistry fileTypeRegistry_;
@@ -25,4 +25,11 @@ public interface MarkersServerOperations
    void clearActiveMarkerSet(ServerRequestCallback<Void> requestCallback);
    
    void markersTabClosed(ServerRequestCallback<Void> requestCallback);
+
+   // get up to count markers of a set starting at offset (the result is
+   // null if there is no such set)
+   void getMarkerSetPage(String set,
+                         int offset,
+                         int count,
+                         ServerRequestCallback<MarkersSet> requestCallback);
 }
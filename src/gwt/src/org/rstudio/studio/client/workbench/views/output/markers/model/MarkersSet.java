@@ -36,4 +36,16 @@ public class MarkersSet extends JavaScriptObject
    public native final JsArray<SourceMarker> getMarkers() /*-{
       return this.markers;
    }-*/;
+
+   // the index of the first of these markers within the set
+   public native final int getOffset() /*-{
+      return this.offset || 0;
+   }-*/;
+
+   // the number of markers in the set (which may be more than were sent)
+   public native final int getTotal() /*-{
+      if (typeof this.total === "undefined")
+         return this.markers.length;
+      return this.total;
+   }-*/;
 }
@@ -364,6 +364,9 @@ public class HistoryPresenter
                @Override
                public void onError(ServerError error)
                {
+                  if (token.isInvalid())
+                     return;
+
                   commitShowing_ = null;
 
                   JSONNumber size = error.getClientInfo().isNumber();
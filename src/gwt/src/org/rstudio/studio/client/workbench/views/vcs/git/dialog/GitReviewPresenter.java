@@ -711,6 +711,9 @@ public class GitReviewPresenter implements ReviewPresenter
                @Override
                public void onError(ServerError error)
                {
+                  if (token.isInvalid())
+                     return;
+
                   JSONNumber size = error.getClientInfo().isNumber();
                   if (size != null)
                      view_.showSizeWarning((long) size.doubleValue());
@@ -437,6 +437,9 @@ public class SVNReviewPresenter implements ReviewPresenter
                @Override
                public void onError(ServerError error)
                {
+                  if (token.isInvalid())
+                     return;
+
                   JSONNumber size = error.getClientInfo().isNumber();
                   if (size != null)
                      view_.showSizeWarning((long) size.doubleValue());